@@ -27,6 +27,8 @@
 
 #include "actions-types.h"
 
+#include "base/tile-cache.h"
+
 #include "core/gimp.h"
 #include "core/gimp-utils.h"
 #include "core/gimpcontext.h"
@@ -34,6 +36,7 @@
 #include "core/gimplayer.h"
 #include "core/gimppickable.h"
 #include "core/gimpprojectable.h"
+#include "core/gimptempbuf.h"
 
 #include "file/file-utils.h"
 
@@ -81,6 +84,11 @@ debug_mem_profile_cmd_callback (GtkAction *action,
 {
   extern gboolean  gimp_debug_memsize;
   Gimp            *gimp;
+  guint64          compressed;
+  guint64          uncompressed;
+  gulong           hits;
+  gulong           misses;
+  guint64          pooled;
   return_if_no_gimp (gimp, data);
 
   gimp_debug_memsize = TRUE;
@@ -88,6 +96,26 @@ debug_mem_profile_cmd_callback (GtkAction *action,
   gimp_object_get_memsize (GIMP_OBJECT (gimp), NULL);
 
   gimp_debug_memsize = FALSE;
+
+  tile_cache_get_compression_stats (&compressed, &uncompressed,
+                                    &hits, &misses);
+
+  g_print ("Compressed tile cache: %" G_GUINT64_FORMAT
+           " bytes, holding %" G_GUINT64_FORMAT " bytes of tiles "
+           "(compression ratio %.1f)\n",
+           compressed, uncompressed,
+           compressed ? (gdouble) uncompressed / compressed : 0.0);
+  g_print ("Compressed tile cache hits: %lu, misses: %lu "
+           "(hit ratio %.1f%%)\n",
+           hits, misses,
+           hits + misses ? 100.0 * hits / (hits + misses) : 0.0);
+
+  gimp_temp_buf_get_pool_stats (&pooled, &hits, &misses);
+
+  g_print ("Temp buf pool: %" G_GUINT64_FORMAT " bytes kept for reuse, "
+           "hits: %lu, misses: %lu (hit ratio %.1f%%)\n",
+           pooled, hits, misses,
+           hits + misses ? 100.0 * hits / (hits + misses) : 0.0);
 }
 
 void
@@ -186,6 +214,8 @@ debug_dump_keyboard_shortcuts_cmd_callback (GtkAction *action,
 
   accel_group = gtk_ui_manager_get_accel_group (manager);
 
+  gimp_ui_manager_ensure_action_groups (GIMP_UI_MANAGER (manager));
+
   /* Gather formated strings of keyboard shortcuts */
   for (group_it = gtk_ui_manager_get_action_groups (manager);
        group_it;
@@ -223,7 +223,13 @@ const GimpStringActionEntry dialogs_dockable_actions[] =
     NC_("dialogs-action", "Error Co_nsole"), NULL,
     NC_("dialogs-action", "Open the error console"),
     "gimp-error-console",
-    GIMP_HELP_ERRORS_DIALOG }
+    GIMP_HELP_ERRORS_DIALOG },
+
+  { "dialogs-dashboard", GIMP_STOCK_TOOL_MEASURE,
+    NC_("dialogs-action", "_Dashboard"), NULL,
+    NC_("dialogs-action", "Open the dashboard"),
+    "gimp-dashboard",
+    GIMP_HELP_DASHBOARD_DIALOG }
 };
 
 gint n_dialogs_dockable_actions = G_N_ELEMENTS (dialogs_dockable_actions);
@@ -267,10 +267,10 @@ documents_recreate_preview_cmd_callback (GtkAction *action,
 
   if (imagefile && gimp_container_have (container, GIMP_OBJECT (imagefile)))
     {
-      gimp_imagefile_create_thumbnail (imagefile,
-                                       context, NULL,
-                                       context->gimp->config->thumbnail_size,
-                                       FALSE);
+      gimp_imagefile_queue_thumbnail (imagefile,
+                                      context->gimp->config->thumbnail_size,
+                                      FALSE,
+                                      GIMP_IMAGEFILE_THUMBNAIL_PRIORITY_SELECTED);
     }
 }
 
@@ -47,6 +47,7 @@
 #include "base/base.h"
 #include "base/tile-swap.h"
 
+#include "gegl/gimp-babl.h"
 #include "gegl/gimp-gegl.h"
 
 #include "core/gimp.h"
@@ -66,6 +67,7 @@
 #include "units.h"
 #include "language.h"
 #include "gimp-debug.h"
+#include "gimp-log.h"
 
 #include "gimp-intl.h"
 
@@ -132,6 +134,7 @@ app_run (const gchar         *full_prog_name,
          const gchar         *session_name,
          const gchar         *batch_interpreter,
          const gchar        **batch_commands,
+         const gchar         *batch_server,
          gboolean             as_new,
          gboolean             no_interface,
          gboolean             no_data,
@@ -246,6 +249,9 @@ app_run (const gchar         *full_prog_name,
 
   batch_run (gimp, batch_interpreter, batch_commands);
 
+  if (batch_server)
+    batch_serve (gimp, batch_interpreter, batch_server);
+
   loop = g_main_loop_new (NULL, FALSE);
 
   g_signal_connect_after (gimp, "exit",
@@ -261,8 +267,10 @@ app_run (const gchar         *full_prog_name,
   g_object_unref (gimp);
 
   gimp_debug_instances ();
+  gimp_trace_exit ();
 
   errors_exit ();
+  gimp_babl_exit ();
   gegl_exit ();
   base_exit ();
 }
@@ -301,11 +309,14 @@ app_exit_after_callback (Gimp      *gimp,
 
 #else
 
+  gimp_babl_exit ();
   gegl_exit ();
 
   /*  make sure that the swap files are removed before we quit */
   tile_swap_exit ();
 
+  gimp_trace_exit ();
+
   exit (EXIT_SUCCESS);
 
 #endif
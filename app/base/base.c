@@ -28,6 +28,7 @@
 #include "libgimpbase/gimpwin32-io.h"
 #endif
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpconfig/gimpconfig.h"
 
 #include "base-types.h"
@@ -40,11 +41,18 @@
 #include "tile-swap.h"
 
 
-static void   base_toast_old_swap_files   (const gchar *swap_path);
+static void   base_toast_old_swap_files    (const gchar *swap_path);
+static void   base_toast_old_swap_files_in (const gchar *dirname);
 
-static void   base_tile_cache_size_notify (GObject     *config,
-                                           GParamSpec  *param_spec,
-                                           gpointer     data);
+static void   base_tile_cache_size_notify  (GObject     *config,
+                                            GParamSpec  *param_spec,
+                                            gpointer     data);
+static void   base_tile_compression_notify (GObject     *config,
+                                            GParamSpec  *param_spec,
+                                            gpointer     data);
+static void   base_tile_dedup_notify       (GObject     *config,
+                                            GParamSpec  *param_spec,
+                                            gpointer     data);
 
 
 static GimpGeglConfig *base_config = NULL;
@@ -70,6 +78,16 @@ base_init (GimpGeglConfig *config,
                     G_CALLBACK (base_tile_cache_size_notify),
                     NULL);
 
+  tile_cache_set_compression (config->tile_compression);
+  g_signal_connect (config, "notify::tile-compression",
+                    G_CALLBACK (base_tile_compression_notify),
+                    NULL);
+
+  tile_cache_set_deduplication (config->tile_deduplication);
+  g_signal_connect (config, "notify::tile-deduplication",
+                    G_CALLBACK (base_tile_dedup_notify),
+                    NULL);
+
   if (! config->swap_path || ! *config->swap_path)
     gimp_config_reset_property (G_OBJECT (config), "swap-path");
 
@@ -111,6 +129,12 @@ base_exit (void)
   g_signal_handlers_disconnect_by_func (base_config,
                                         base_tile_cache_size_notify,
                                         NULL);
+  g_signal_handlers_disconnect_by_func (base_config,
+                                        base_tile_compression_notify,
+                                        NULL);
+  g_signal_handlers_disconnect_by_func (base_config,
+                                        base_tile_dedup_notify,
+                                        NULL);
 
   g_object_unref (base_config);
   base_config = NULL;
@@ -122,24 +146,36 @@ base_exit (void)
 static void
 base_toast_old_swap_files (const gchar *swap_path)
 {
-  GDir       *dir = NULL;
-  gchar      *dirname;
-  const char *entry;
+  gchar *expanded;
+  GList *dirs;
+  GList *list;
 
   if (! swap_path)
     return;
 
-  dirname = gimp_config_path_expand (swap_path, TRUE, NULL);
-  if (!dirname)
+  expanded = gimp_config_path_expand (swap_path, TRUE, NULL);
+  if (!expanded)
     return;
 
+  dirs = gimp_path_parse (expanded, TILE_SWAP_MAX_FILES, FALSE, NULL);
+
+  for (list = dirs; list; list = g_list_next (list))
+    base_toast_old_swap_files_in (list->data);
+
+  gimp_path_free (dirs);
+  g_free (expanded);
+}
+
+static void
+base_toast_old_swap_files_in (const gchar *dirname)
+{
+  GDir       *dir = NULL;
+  const char *entry;
+
   dir = g_dir_open (dirname, 0, NULL);
 
   if (!dir)
-    {
-      g_free (dirname);
-      return;
-    }
+    return;
 
   while ((entry = g_dir_read_name (dir)) != NULL)
     if (g_str_has_prefix (entry, "gimpswap."))
@@ -169,8 +205,6 @@ base_toast_old_swap_files (const gchar *swap_path)
       }
 
   g_dir_close (dir);
-
-  g_free (dirname);
 }
 
 static void
@@ -178,5 +212,25 @@ base_tile_cache_size_notify (GObject    *config,
                              GParamSpec *param_spec,
                              gpointer    data)
 {
+  /*  an adaptive cache size is managed from gimp-gegl-cache.c  */
+  if (GIMP_GEGL_CONFIG (config)->tile_cache_adaptive)
+    return;
+
   tile_cache_set_size (GIMP_GEGL_CONFIG (config)->tile_cache_size);
 }
+
+static void
+base_tile_compression_notify (GObject    *config,
+                              GParamSpec *param_spec,
+                              gpointer    data)
+{
+  tile_cache_set_compression (GIMP_GEGL_CONFIG (config)->tile_compression);
+}
+
+static void
+base_tile_dedup_notify (GObject    *config,
+                        GParamSpec *param_spec,
+                        gpointer    data)
+{
+  tile_cache_set_deduplication (GIMP_GEGL_CONFIG (config)->tile_deduplication);
+}
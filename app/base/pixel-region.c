@@ -29,6 +29,18 @@
 #include "pixel-region.h"
 #include "tile-manager.h"
 #include "tile.h"
+#include "tile-private.h"
+
+
+typedef struct
+{
+  PixelRegionsFunc     func;
+  gpointer             data;
+  gint                 num_regions;
+  PixelRegion        **regions;
+  PixelRegionIterator *PRI;
+  GMutex               mutex;
+} PixelRegionsJob;
 
 
 /*********************/
@@ -40,6 +52,16 @@ static void                  pixel_regions_free      (PixelRegionIterator *PRI);
 static PixelRegionIterator * pixel_regions_configure (PixelRegionIterator *PRI);
 static void                  pixel_region_configure  (PixelRegionHolder   *PRH,
                                                       PixelRegionIterator *PRI);
+static PixelRegionIterator * pixel_regions_register_valist
+                                                     (gint                 num_regions,
+                                                      va_list              ap);
+static void                  pixel_regions_process_worker
+                                                     (gint                 worker,
+                                                      gint                 n_workers,
+                                                      PixelRegionsJob     *job);
+
+
+static PixelRegionsDistributeFunc pixel_regions_distribute = NULL;
 
 
 /**************************/
@@ -289,55 +311,13 @@ pixel_regions_register (gint num_regions,
                         ...)
 {
   PixelRegionIterator *PRI;
-  gboolean             found;
   va_list              ap;
 
-  if (num_regions < 1)
-    return NULL;
-
-  PRI = g_slice_new0 (PixelRegionIterator);
-
   va_start (ap, num_regions);
-
-  found = FALSE;
-
-  while (num_regions --)
-    {
-      PixelRegionHolder *PRH;
-      PixelRegion       *PR;
-
-      PR = va_arg (ap, PixelRegion *);
-
-      PRH = g_slice_new0 (PixelRegionHolder);
-      PRH->PR = PR;
-
-      if (PR != NULL)
-        {
-          /*  If there is a defined value for data, make sure tiles is NULL  */
-          if (PR->data)
-            PR->tiles = NULL;
-
-          PRH->original_data     = PR->data;
-          PRH->startx            = PR->x;
-          PRH->starty            = PR->y;
-          PRH->PR->process_count = 0;
-
-          if (! found)
-            {
-              found = TRUE;
-
-              PRI->region_width  = PR->w;
-              PRI->region_height = PR->h;
-            }
-        }
-
-      /*  Add the pixel region holder to the list  */
-      PRI->pixel_regions = g_slist_prepend (PRI->pixel_regions, PRH);
-    }
-
+  PRI = pixel_regions_register_valist (num_regions, ap);
   va_end (ap);
 
-  return pixel_regions_configure (PRI);
+  return PRI;
 }
 
 
@@ -415,10 +395,197 @@ pixel_regions_process_stop (PixelRegionIterator *PRI)
   pixel_regions_free (PRI);
 }
 
+/**
+ * pixel_regions_process_parallel:
+ * @func:        the function to call for every portion
+ * @data:        user data passed to @func
+ * @num_regions: the number of pixel regions that follow
+ * @...:         @num_regions pointers to #PixelRegion, some may be %NULL
+ *
+ * Iterates over the pixel regions like pixel_regions_register() and
+ * pixel_regions_process(), but hands the portions to the threads of
+ * the function set with pixel_regions_set_distribute_func(), or
+ * processes them on the calling thread if there is none.  @func is
+ * called once for every portion, with an array of @num_regions
+ * regions in the order they were passed, each configured to that
+ * portion.  Calls of @func run concurrently, so @func must only touch
+ * the pixels it is passed and protect everything else it writes to.
+ *
+ * Fetching the tiles stays serialized, which makes this a win only if
+ * @func does some real work per pixel.
+ **/
+void
+pixel_regions_process_parallel (PixelRegionsFunc func,
+                                gpointer         data,
+                                gint             num_regions,
+                                ...)
+{
+  PixelRegionsJob  job;
+  va_list          ap;
+  gint             i;
+
+  g_return_if_fail (func != NULL);
+  g_return_if_fail (num_regions > 0);
+
+  job.func        = func;
+  job.data        = data;
+  job.num_regions = num_regions;
+  job.regions     = g_new (PixelRegion *, num_regions);
+
+  va_start (ap, num_regions);
+
+  for (i = 0; i < num_regions; i++)
+    job.regions[i] = va_arg (ap, PixelRegion *);
+
+  va_end (ap);
+
+  va_start (ap, num_regions);
+  job.PRI = pixel_regions_register_valist (num_regions, ap);
+  va_end (ap);
+
+  g_mutex_init (&job.mutex);
+
+  /*  every worker keeps taking portions until there are none left  */
+  if (pixel_regions_distribute)
+    pixel_regions_distribute ((PixelRegionsWorkerFunc) pixel_regions_process_worker,
+                              &job);
+  else
+    pixel_regions_process_worker (0, 1, &job);
+
+  g_mutex_clear (&job.mutex);
+
+  g_free (job.regions);
+}
+
+/**
+ * pixel_regions_set_distribute_func:
+ * @distribute: a function that calls its worker function on all
+ *              threads it has, or %NULL
+ *
+ * Sets how pixel_regions_process_parallel() runs the workers.  The
+ * core passes in its worker pool here, since app/base can't use it
+ * directly.
+ **/
+void
+pixel_regions_set_distribute_func (PixelRegionsDistributeFunc distribute)
+{
+  pixel_regions_distribute = distribute;
+}
+
 
 /*********************************/
 /*  Static Function Definitions  */
 
+static PixelRegionIterator *
+pixel_regions_register_valist (gint    num_regions,
+                               va_list ap)
+{
+  PixelRegionIterator *PRI;
+  gboolean             found;
+
+  if (num_regions < 1)
+    return NULL;
+
+  PRI = g_slice_new0 (PixelRegionIterator);
+
+  found = FALSE;
+
+  while (num_regions --)
+    {
+      PixelRegionHolder *PRH;
+      PixelRegion       *PR;
+
+      PR = va_arg (ap, PixelRegion *);
+
+      PRH = g_slice_new0 (PixelRegionHolder);
+      PRH->PR = PR;
+
+      if (PR != NULL)
+        {
+          /*  If there is a defined value for data, make sure tiles is NULL  */
+          if (PR->data)
+            PR->tiles = NULL;
+
+          PRH->original_data     = PR->data;
+          PRH->startx            = PR->x;
+          PRH->starty            = PR->y;
+          PRH->PR->process_count = 0;
+
+          if (! found)
+            {
+              found = TRUE;
+
+              PRI->region_width  = PR->w;
+              PRI->region_height = PR->h;
+            }
+        }
+
+      /*  Add the pixel region holder to the list  */
+      PRI->pixel_regions = g_slist_prepend (PRI->pixel_regions, PRH);
+    }
+
+  return pixel_regions_configure (PRI);
+}
+
+static void
+pixel_regions_process_worker (gint             worker,
+                              gint             n_workers,
+                              PixelRegionsJob *job)
+{
+  PixelRegion      *portion = g_new (PixelRegion, job->num_regions);
+  PixelRegion     **regions = g_new (PixelRegion *, job->num_regions);
+  gint              i;
+
+  g_mutex_lock (&job->mutex);
+
+  while (job->PRI)
+    {
+      /*  Take a private copy of the current portion, with our own
+       *  reference on its tiles, and let the others move on while we
+       *  work on it.  All tile access happens with the mutex held.
+       */
+      for (i = 0; i < job->num_regions; i++)
+        {
+          if (job->regions[i])
+            {
+              portion[i] = *job->regions[i];
+              regions[i] = &portion[i];
+
+              if (portion[i].tiles)
+                {
+                  tile_lock (portion[i].curtile);
+
+                  if (portion[i].dirty)
+                    portion[i].curtile->write_count++;
+                }
+            }
+          else
+            {
+              regions[i] = NULL;
+            }
+        }
+
+      job->PRI = pixel_regions_process (job->PRI);
+
+      g_mutex_unlock (&job->mutex);
+
+      job->func (regions, job->data);
+
+      g_mutex_lock (&job->mutex);
+
+      for (i = 0; i < job->num_regions; i++)
+        {
+          if (regions[i] && regions[i]->tiles)
+            tile_release (regions[i]->curtile, regions[i]->dirty);
+        }
+    }
+
+  g_mutex_unlock (&job->mutex);
+
+  g_free (regions);
+  g_free (portion);
+}
+
 static gint
 get_portion_height (PixelRegionIterator *PRI)
 {
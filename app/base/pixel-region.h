@@ -60,6 +60,16 @@ struct _PixelRegionIterator
 };
 
 
+typedef void (* PixelRegionsFunc)           (PixelRegion            **regions,
+                                             gpointer                 data);
+
+typedef void (* PixelRegionsWorkerFunc)     (gint                     worker,
+                                             gint                     n_workers,
+                                             gpointer                 data);
+typedef void (* PixelRegionsDistributeFunc) (PixelRegionsWorkerFunc   func,
+                                             gpointer                 data);
+
+
 /*  PixelRegion functions  */
 
 void     pixel_region_init          (PixelRegion         *PR,
@@ -117,5 +127,12 @@ PixelRegionIterator * pixel_regions_register     (gint    num_regions,
 PixelRegionIterator * pixel_regions_process      (PixelRegionIterator *PRI);
 void                  pixel_regions_process_stop (PixelRegionIterator *PRI);
 
+void          pixel_regions_process_parallel     (PixelRegionsFunc     func,
+                                                  gpointer             data,
+                                                  gint                 num_regions,
+                                                  ...);
+
+void          pixel_regions_set_distribute_func  (PixelRegionsDistributeFunc distribute);
+
 
 #endif /* __PIXEL_REGION_H__ */
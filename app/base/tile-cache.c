@@ -17,12 +17,15 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <glib-object.h>
 
 #include "base-types.h"
 
 #include "tile.h"
 #include "tile-cache.h"
+#include "tile-compress.h"
 #include "tile-swap.h"
 #include "tile-rowhints.h"
 #include "tile-private.h"
@@ -32,6 +35,18 @@
 #define IDLE_SWAPPER_INTERVAL_MS        20
 #define IDLE_SWAPPER_TILES_PER_INTERVAL 10
 
+/*  the number of independently locked shards of the tile cache,
+ *  must be a power of two
+ */
+#define TILE_CACHE_N_SHARDS             16
+
+/*  the compressed tier may use up to 1/TILE_CACHE_COMPRESSED_FRACTION
+ *  of the tile cache, and a tile is only kept compressed if it shrinks
+ *  to at most 1/TILE_CACHE_COMPRESSED_MIN_RATIO of its size
+ */
+#define TILE_CACHE_COMPRESSED_FRACTION  2
+#define TILE_CACHE_COMPRESSED_MIN_RATIO 4
+
 
 typedef struct _TileList
 {
@@ -39,14 +54,60 @@ typedef struct _TileList
   Tile *last;
 } TileList;
 
-
-static guint64       cur_cache_size   = 0;
-static guint64       max_cache_size   = 0;
-static guint64       cur_cache_dirty  = 0;
-static TileList      tile_list        = { NULL, NULL };
-static guint         idle_swapper     = 0;
-static guint         idle_delay       = 0;
-static Tile         *idle_scan_last   = NULL;
+/*  Each tile lives in exactly one shard, picked by hashing the tile's
+ *  address. A shard keeps its own LRU list and dirty accounting, so
+ *  touching a cached tile only takes that shard's lock. The total
+ *  cache size is kept in cur_cache_size, which is protected by its own
+ *  lock; that lock is a leaf lock and never held while taking a shard
+ *  lock.
+ */
+typedef struct _TileCacheShard
+{
+  TileList     tile_list;
+  guint64      cur_dirty;
+  Tile        *idle_scan_last;
+#ifdef ENABLE_MP
+  GMutex       mutex;
+#endif
+} TileCacheShard;
+
+
+static guint64         cur_cache_size   = 0;
+static guint64         max_cache_size   = 0;
+static guint64         target_size      = 0;  /*  max_cache_size shrinks
+                                               *  towards it when idle
+                                               */
+static TileCacheShard  shards[TILE_CACHE_N_SHARDS];
+static guint           zorch_shard      = 0;
+static guint           idle_swapper     = 0;
+static guint           idle_delay       = 0;
+static guint           idle_shard       = 0;
+
+/*  Tiles evicted from the shards are first offered to the compressed
+ *  tier, which keeps them RLE compressed in memory, linked into its own
+ *  LRU list through the tiles' next and prev pointers. The compressed
+ *  data counts towards cur_cache_size. Only when the tier is full, its
+ *  least recently used tiles are written to the swap file. The tier's
+ *  lock is taken after a shard lock, and before the swap's lock.
+ */
+static gboolean        compression_enabled  = TRUE;
+static TileList        compressed_list      = { NULL, NULL };
+static guint64         compressed_size      = 0;
+static guint64         compressed_orig_size = 0;
+static gulong          compressed_hits      = 0;
+static gulong          compressed_misses    = 0;
+
+/*  With deduplication, the compressed data of tiles is looked up by its
+ *  contents, and tiles with equal contents share one copy of it, which
+ *  is only counted once. The table maps the shared data to the number
+ *  of tiles using it and is protected by the compressed tier's lock.
+ *  Tiles which are written to get their own data back when they are
+ *  uncompressed, so the sharing is copy-on-write.
+ */
+static gboolean        dedup_enabled        = FALSE;
+static GHashTable     *dedup_table          = NULL;
+static guint64         dedup_saved          = 0;
+static gulong          dedup_shared         = 0;
 
 #ifdef TILE_PROFILING
 extern gulong        tile_idle_swapout;
@@ -61,22 +122,55 @@ extern gint          tile_exist_count;
 
 static GMutex        tile_cache_mutex;
 
-#define TILE_CACHE_LOCK    g_mutex_lock (&tile_cache_mutex)
-#define TILE_CACHE_UNLOCK  g_mutex_unlock (&tile_cache_mutex)
+#define TILE_CACHE_LOCK       g_mutex_lock (&tile_cache_mutex)
+#define TILE_CACHE_UNLOCK     g_mutex_unlock (&tile_cache_mutex)
+
+#define SHARD_LOCK(shard)     g_mutex_lock (&(shard)->mutex)
+#define SHARD_UNLOCK(shard)   g_mutex_unlock (&(shard)->mutex)
+
+static GMutex        compressed_mutex;
+
+#define COMPRESSED_LOCK       g_mutex_lock (&compressed_mutex)
+#define COMPRESSED_UNLOCK     g_mutex_unlock (&compressed_mutex)
 
 #else
 
-#define TILE_CACHE_LOCK   /* nothing */
-#define TILE_CACHE_UNLOCK /* nothing */
+#define TILE_CACHE_LOCK       /* nothing */
+#define TILE_CACHE_UNLOCK     /* nothing */
+
+#define SHARD_LOCK(shard)     /* nothing */
+#define SHARD_UNLOCK(shard)   /* nothing */
+
+#define COMPRESSED_LOCK       /* nothing */
+#define COMPRESSED_UNLOCK     /* nothing */
 
 #endif
 
-#define PENDING_WRITE(t) ((t)->dirty || (t)->swap_offset == -1)
+/*  uniform tiles are never written to the swap file  */
+#define PENDING_WRITE(t) (! (t)->uniform && \
+                          ((t)->dirty || (t)->swap_offset == -1))
 
+#define TILE_SHARD(t) \
+  (&shards[(((gsize) (t)) / sizeof (Tile)) & (TILE_CACHE_N_SHARDS - 1)])
 
+
+static gboolean  tile_cache_make_room      (gint            size);
+static void      tile_cache_add_size       (gint64          size);
+static void      tile_cache_start_swapper  (void);
 static gboolean  tile_cache_zorch_next     (void);
-static void      tile_cache_flush_internal (Tile     *tile);
-static gboolean  tile_idle_preswap         (gpointer  data);
+static gboolean  tile_cache_zorch_shard    (TileCacheShard *shard);
+static gboolean  tile_cache_zorch_tile     (TileCacheShard *shard,
+                                            Tile           *tile,
+                                            gboolean        oldest);
+static void      tile_cache_flush_internal (TileCacheShard *shard,
+                                            Tile           *tile);
+static gboolean  tile_cache_make_uniform   (Tile           *tile);
+static gboolean  tile_cache_compress       (Tile           *tile,
+                                            gboolean        oldest);
+static gboolean  tile_cache_spill_compressed (void);
+static gboolean  tile_cache_shrink_idle    (void);
+static gint      tile_compressed_unlink    (Tile           *tile);
+static gboolean  tile_idle_preswap         (gpointer        data);
 #ifdef TILE_PROFILING
 static void      tile_verify               (void);
 #endif
@@ -85,14 +179,33 @@ static void      tile_verify               (void);
 void
 tile_cache_init (guint64 tile_cache_size)
 {
+  gint i;
+
 #ifdef ENABLE_MP
   g_mutex_init (&tile_cache_mutex);
+  g_mutex_init (&compressed_mutex);
 #endif
 
-  tile_list.first = tile_list.last = NULL;
-  idle_scan_last = NULL;
+  compressed_list.first = compressed_list.last = NULL;
+
+  dedup_table = g_hash_table_new_full (g_bytes_hash, g_bytes_equal,
+                                       (GDestroyNotify) g_bytes_unref, NULL);
+
+  for (i = 0; i < TILE_CACHE_N_SHARDS; i++)
+    {
+      TileCacheShard *shard = &shards[i];
+
+      shard->tile_list.first = shard->tile_list.last = NULL;
+      shard->cur_dirty       = 0;
+      shard->idle_scan_last  = NULL;
+
+#ifdef ENABLE_MP
+      g_mutex_init (&shard->mutex);
+#endif
+    }
 
   max_cache_size = tile_cache_size;
+  target_size    = tile_cache_size;
 }
 
 void
@@ -109,6 +222,26 @@ tile_cache_exit (void)
                cur_cache_size);
 
   tile_cache_set_size (0);
+
+  g_hash_table_unref (dedup_table);
+  dedup_table = NULL;
+}
+
+void
+tile_cache_set_compression (gboolean enable)
+{
+  compression_enabled = enable ? TRUE : FALSE;
+}
+
+/*  turns on sharing of identical tiles in the compressed tier and the
+ *  swap file. Tiles which are already shared stay shared.
+ */
+void
+tile_cache_set_deduplication (gboolean enable)
+{
+  dedup_enabled = enable ? TRUE : FALSE;
+
+  tile_swap_set_deduplication (enable);
 }
 
 void
@@ -120,8 +253,9 @@ tile_cache_suspend_idle_swapper(void)
 void
 tile_cache_insert (Tile *tile)
 {
+  TileCacheShard *shard = TILE_SHARD (tile);
 
-  TILE_CACHE_LOCK;
+  SHARD_LOCK (shard);
 
   if (! tile->data)
     goto out;
@@ -139,117 +273,257 @@ tile_cache_insert (Tile *tile)
       if (tile->next)
         tile->next->prev = tile->prev;
       else
-        tile_list.last = tile->prev;
+        shard->tile_list.last = tile->prev;
 
-      if(tile->prev){
-	tile->prev->next = tile->next;
-      }else{
-	tile_list.first = tile->next;
-      }
-
-      if (PENDING_WRITE(tile))
-	cur_cache_dirty -= tile->size;
+      if (tile->prev)
+        tile->prev->next = tile->next;
+      else
+        shard->tile_list.first = tile->next;
 
-      if(tile == idle_scan_last)
-	idle_scan_last = tile->next;
+      if (PENDING_WRITE (tile))
+        shard->cur_dirty -= tile->size;
 
+      if (tile == shard->idle_scan_last)
+        shard->idle_scan_last = tile->next;
     }
   else
     {
       /* The tile was not in the cache. First check and see
        *  if there is room in the cache. If not then we'll have
-       *  to make room first. Note: it might be the case that the
-       *  cache is smaller than the size of a tile in which case
-       *  it won't be possible to put it in the cache.
+       *  to make room first, which may zorch tiles from any
+       *  shard, so our shard's lock is dropped meanwhile. Note:
+       *  it might be the case that the cache is smaller than the
+       *  size of a tile in which case it won't be possible to put
+       *  it in the cache.
        */
 
-#ifdef TILE_PROFILING
-      if ((cur_cache_size + tile->size) > max_cache_size)
-        {
-          GTimeVal now;
-          GTimeVal later;
+      SHARD_UNLOCK (shard);
 
-          g_get_current_time(&now);
-#endif
-          while ((cur_cache_size + tile->size) > max_cache_size)
-            {
-              if (! tile_cache_zorch_next ())
-                {
-                  g_warning ("cache: unable to find room for a tile");
-                  goto out;
-                }
-            }
+      if (! tile_cache_make_room (tile->size))
+        {
+          g_warning ("cache: unable to find room for a tile");
+          return;
+        }
 
-#ifdef TILE_PROFILING
-          g_get_current_time (&later);
-          tile_total_interactive_usec += later.tv_usec - now.tv_usec;
-          tile_total_interactive_sec += later.tv_sec - now.tv_sec;
+      SHARD_LOCK (shard);
 
-          if (tile_total_interactive_usec < 0)
-            {
-              tile_total_interactive_usec += 1000000;
-              tile_total_interactive_sec--;
-            }
+      if (tile->cached || ! tile->data || tile->ref_count > 0)
+        {
+          /* the tile was cached or locked meanwhile, give the room back */
+          tile_cache_add_size (- (gint64) tile->size);
 
-          if (tile_total_interactive_usec > 1000000)
-            {
-              tile_total_interactive_usec -= 1000000;
-              tile_total_interactive_sec++;
-            }
+          goto out;
         }
-#endif
-
-      cur_cache_size += tile->size;
     }
 
   /* Put the tile at the end of the proper list */
 
   tile->next = NULL;
-  tile->prev = tile_list.last;
+  tile->prev = shard->tile_list.last;
 
-  if (tile_list.last)
-    tile_list.last->next = tile;
+  if (shard->tile_list.last)
+    shard->tile_list.last->next = tile;
   else
-    tile_list.first = tile;
+    shard->tile_list.first = tile;
 
-  tile_list.last = tile;
+  shard->tile_list.last = tile;
   tile->cached = TRUE;
   idle_delay = 1;
 
-  if (PENDING_WRITE(tile))
+  if (PENDING_WRITE (tile))
     {
-      cur_cache_dirty += tile->size;
+      shard->cur_dirty += tile->size;
 
-      if (! idle_scan_last)
-	idle_scan_last=tile;
+      if (! shard->idle_scan_last)
+        shard->idle_scan_last = tile;
 
-      if (! idle_swapper)
-        {
-#ifdef TILE_PROFILING
-	  g_printerr("idle swapper -> started\n");
-	  g_printerr("idle swapper -> waiting");
-#endif
-	  idle_delay = 0;
-          idle_swapper = g_timeout_add_full (G_PRIORITY_LOW,
-                                             IDLE_SWAPPER_START,
-                                             tile_idle_preswap,
-                                             NULL, NULL);
-        }
+      tile_cache_start_swapper ();
     }
 
 out:
-  TILE_CACHE_UNLOCK;
+  SHARD_UNLOCK (shard);
 }
 
 void
 tile_cache_flush (Tile *tile)
 {
-  TILE_CACHE_LOCK;
+  TileCacheShard *shard = TILE_SHARD (tile);
+
+  SHARD_LOCK (shard);
 
   if (tile->cached)
-    tile_cache_flush_internal (tile);
+    tile_cache_flush_internal (shard, tile);
 
-  TILE_CACHE_UNLOCK;
+  SHARD_UNLOCK (shard);
+}
+
+/*  takes the tile out of the cache for good, dropping its compressed
+ *  data if it has any; the tile's contents don't matter any longer
+ */
+void
+tile_cache_discard (Tile *tile)
+{
+  tile_cache_flush (tile);
+
+  if (tile->compressed_data)
+    {
+      gint size;
+
+      COMPRESSED_LOCK;
+
+      size = tile_compressed_unlink (tile);
+
+      COMPRESSED_UNLOCK;
+
+      tile_cache_add_size (- (gint64) size);
+    }
+}
+
+/*  pushes an unlocked tile out of memory right away, instead of waiting
+ *  for it to age out of the cache. The tile enters the compressed tier
+ *  as its least recently used tile, so it is the first to go to the
+ *  swap file. Returns FALSE if the tile stays in memory.
+ */
+gboolean
+tile_cache_evict (Tile *tile)
+{
+  TileCacheShard *shard   = TILE_SHARD (tile);
+  gboolean        zorched = FALSE;
+
+  SHARD_LOCK (shard);
+
+  if (tile->cached && tile->ref_count == 0)
+    zorched = tile_cache_zorch_tile (shard, tile, TRUE);
+
+  SHARD_UNLOCK (shard);
+
+  /* a tile that couldn't be swapped out goes back into the cache */
+  if (! zorched && tile->data && ! tile->cached && tile->ref_count == 0)
+    tile_cache_insert (tile);
+
+  return zorched;
+}
+
+/*  restores the data of a tile from the compressed tier, returns FALSE
+ *  if the tile has no compressed data
+ */
+gboolean
+tile_cache_uncompress (Tile *tile)
+{
+  gboolean success;
+  gint     size;
+
+  COMPRESSED_LOCK;
+
+  if (! tile->compressed_data)
+    {
+      if (tile->swap_offset != -1)
+        compressed_misses++;
+
+      COMPRESSED_UNLOCK;
+
+      return FALSE;
+    }
+
+  tile_alloc (tile);
+
+  success = tile_decompress_rle (g_bytes_get_data (tile->compressed_data,
+                                                   NULL),
+                                 tile->compressed_size, tile->bpp,
+                                 tile->data, tile->size);
+
+  if (! success)
+    g_warning ("cache: unable to uncompress a tile");
+
+  size = tile_compressed_unlink (tile);
+
+  compressed_hits++;
+
+  COMPRESSED_UNLOCK;
+
+  tile_cache_add_size (- (gint64) size);
+
+  return TRUE;
+}
+
+void
+tile_cache_get_compression_stats (guint64 *compressed,
+                                  guint64 *uncompressed,
+                                  gulong  *n_hits,
+                                  gulong  *n_misses)
+{
+  COMPRESSED_LOCK;
+
+  if (compressed)   *compressed   = compressed_size;
+  if (uncompressed) *uncompressed = compressed_orig_size;
+  if (n_hits)       *n_hits       = compressed_hits;
+  if (n_misses)     *n_misses     = compressed_misses;
+
+  COMPRESSED_UNLOCK;
+}
+
+/**
+ * tile_cache_get_dedup_stats:
+ * @saved_size: return location for the bytes saved by sharing tile data
+ * @n_shared:   return location for the number of tiles sharing data
+ *              with another tile
+ *
+ * Adds up the savings of the compressed tier and the swap file. Any of
+ * the return locations may be %NULL.
+ **/
+void
+tile_cache_get_dedup_stats (guint64 *saved_size,
+                            gulong  *n_shared)
+{
+  guint64 swap_saved;
+  gulong  swap_shared;
+
+  tile_swap_get_dedup_stats (&swap_saved, &swap_shared);
+
+  COMPRESSED_LOCK;
+
+  if (saved_size) *saved_size = dedup_saved + swap_saved;
+  if (n_shared)   *n_shared   = dedup_shared + swap_shared;
+
+  COMPRESSED_UNLOCK;
+}
+
+/**
+ * tile_cache_get_usage:
+ * @cache_size: return location for the bytes of tile data in the cache
+ * @max_size:   return location for the cache size limit
+ * @dirty_size: return location for the bytes not written to swap yet
+ *
+ * Any of the return locations may be %NULL.
+ **/
+void
+tile_cache_get_usage (guint64 *cache_size,
+                      guint64 *max_size,
+                      guint64 *dirty_size)
+{
+  if (cache_size || max_size)
+    {
+      TILE_CACHE_LOCK;
+
+      if (cache_size) *cache_size = cur_cache_size;
+      if (max_size)   *max_size   = max_cache_size;
+
+      TILE_CACHE_UNLOCK;
+    }
+
+  if (dirty_size)
+    {
+      gint i;
+
+      *dirty_size = 0;
+
+      for (i = 0; i < TILE_CACHE_N_SHARDS; i++)
+        {
+          SHARD_LOCK (&shards[i]);
+          *dirty_size += shards[i].cur_dirty;
+          SHARD_UNLOCK (&shards[i]);
+        }
+    }
 }
 
 void
@@ -259,52 +533,212 @@ tile_cache_set_size (guint64 cache_size)
 
   idle_delay = 1;
   max_cache_size = cache_size;
+  target_size    = cache_size;
+
+  TILE_CACHE_UNLOCK;
+
+  tile_cache_make_room (0);
+}
+
+/*  like tile_cache_set_size(), but a smaller size doesn't zorch tiles
+ *  right away; the idle swapper evicts them, and lowers the cache size
+ *  as it goes, so nobody waits for the swap file meanwhile
+ */
+void
+tile_cache_set_target_size (guint64 cache_size)
+{
+  gboolean shrink;
+
+  TILE_CACHE_LOCK;
+
+  target_size = cache_size;
+
+  if (cache_size >= max_cache_size)
+    max_cache_size = cache_size;
+
+  shrink = (cur_cache_size > target_size);
 
-  while (cur_cache_size > max_cache_size)
+  TILE_CACHE_UNLOCK;
+
+  if (shrink)
+    tile_cache_start_swapper ();
+}
+
+/*  zorches tiles until @size more bytes fit into the cache, and
+ *  accounts for them in cur_cache_size
+ */
+static gboolean
+tile_cache_make_room (gint size)
+{
+  while (TRUE)
     {
+#ifndef TILE_PROFILING
+      gboolean zorched;
+#endif
+
+      TILE_CACHE_LOCK;
+
+      if (cur_cache_size + size <= max_cache_size)
+        {
+          cur_cache_size += size;
+
+          TILE_CACHE_UNLOCK;
+
+          return TRUE;
+        }
+
+      TILE_CACHE_UNLOCK;
+
+#ifdef TILE_PROFILING
+      {
+        GTimeVal now;
+        GTimeVal later;
+        gboolean zorched;
+
+        g_get_current_time (&now);
+
+        zorched = (tile_cache_zorch_next () ||
+                   tile_cache_spill_compressed ());
+
+        g_get_current_time (&later);
+        tile_total_interactive_usec += later.tv_usec - now.tv_usec;
+        tile_total_interactive_sec += later.tv_sec - now.tv_sec;
+
+        if (tile_total_interactive_usec < 0)
+          {
+            tile_total_interactive_usec += 1000000;
+            tile_total_interactive_sec--;
+          }
+
+        if (tile_total_interactive_usec > 1000000)
+          {
+            tile_total_interactive_usec -= 1000000;
+            tile_total_interactive_sec++;
+          }
+
+        if (! zorched)
+          return FALSE;
+      }
+#else
       if (! tile_cache_zorch_next ())
-        break;
+        zorched = tile_cache_spill_compressed ();
+      else
+        zorched = TRUE;
+
+      if (! zorched)
+        return FALSE;
+#endif
     }
+}
+
+static void
+tile_cache_add_size (gint64 size)
+{
+  TILE_CACHE_LOCK;
+
+  cur_cache_size += size;
 
   TILE_CACHE_UNLOCK;
 }
 
+/*  called with a shard lock held  */
 static void
-tile_cache_flush_internal (Tile *tile)
+tile_cache_start_swapper (void)
 {
+  TILE_CACHE_LOCK;
 
+  if (! idle_swapper)
+    {
+#ifdef TILE_PROFILING
+      g_printerr("idle swapper -> started\n");
+      g_printerr("idle swapper -> waiting");
+#endif
+      idle_delay = 0;
+      idle_swapper = g_timeout_add_full (G_PRIORITY_LOW,
+                                         IDLE_SWAPPER_START,
+                                         tile_idle_preswap,
+                                         NULL, NULL);
+    }
+
+  TILE_CACHE_UNLOCK;
+}
+
+static void
+tile_cache_flush_internal (TileCacheShard *shard,
+                           Tile           *tile)
+{
   tile->cached = FALSE;
 
-  if (PENDING_WRITE(tile))
-    cur_cache_dirty -= tile->size;
+  if (PENDING_WRITE (tile))
+    shard->cur_dirty -= tile->size;
 
-  cur_cache_size -= tile->size;
+  tile_cache_add_size (- (gint64) tile->size);
 
   if (tile->next)
     tile->next->prev = tile->prev;
   else
-    tile_list.last = tile->prev;
+    shard->tile_list.last = tile->prev;
 
   if (tile->prev)
     tile->prev->next = tile->next;
   else
-    tile_list.first = tile->next;
+    shard->tile_list.first = tile->next;
 
-  if (tile == idle_scan_last)
-    idle_scan_last = tile->next;
+  if (tile == shard->idle_scan_last)
+    shard->idle_scan_last = tile->next;
 
   tile->next = tile->prev = NULL;
 }
 
+/*  zorches the least recently used tile of the next non-empty shard,
+ *  going round-robin over the shards so all of them age evenly
+ */
 static gboolean
 tile_cache_zorch_next (void)
 {
+  gint i;
 
-  Tile *tile = tile_list.first;
+  for (i = 0; i < TILE_CACHE_N_SHARDS; i++)
+    {
+      guint           n     = g_atomic_int_add (&zorch_shard, 1);
+      TileCacheShard *shard = &shards[n & (TILE_CACHE_N_SHARDS - 1)];
+      gboolean        zorched;
+
+      SHARD_LOCK (shard);
+
+      if (! shard->tile_list.first)
+        {
+          SHARD_UNLOCK (shard);
+          continue;
+        }
+
+      zorched = tile_cache_zorch_shard (shard);
+
+      SHARD_UNLOCK (shard);
+
+      return zorched;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+tile_cache_zorch_shard (TileCacheShard *shard)
+{
+  Tile *tile = shard->tile_list.first;
 
   if (! tile)
     return FALSE;
 
+  return tile_cache_zorch_tile (shard, tile, FALSE);
+}
+
+/*  called with the tile's shard lock held  */
+static gboolean
+tile_cache_zorch_tile (TileCacheShard *shard,
+                       Tile           *tile,
+                       gboolean        oldest)
+{
 #ifdef TILE_PROFILING
   tile_total_zorched++;
   tile->zorched = TRUE;
@@ -316,12 +750,27 @@ tile_cache_zorch_next (void)
     }
 #endif
 
-  tile_cache_flush_internal (tile);
+  tile_cache_flush_internal (shard, tile);
+
+  if (tile->uniform || tile_cache_make_uniform (tile))
+    {
+      /*  the tile's pixel value is all we need to keep  */
+      g_free (tile->data);
+      tile->data = NULL;
+
+#ifdef TILE_PROFILING
+      tile_exist_count--;
+#endif
+      return TRUE;
+    }
+
+  if (compression_enabled && tile_cache_compress (tile, oldest))
+    return TRUE;
 
   if (PENDING_WRITE (tile))
     {
       idle_delay = 1;
-      tile_swap_out (tile);
+      tile_swap_evict (tile);
     }
 
   if (! tile->dirty)
@@ -339,11 +788,290 @@ tile_cache_zorch_next (void)
   return FALSE;
 }
 
+/*  marks an evicted tile as uniform if all of its pixels are equal, so
+ *  that it neither needs to be compressed nor written to the swap file
+ */
 static gboolean
-tile_idle_preswap_run (gpointer data)
+tile_cache_make_uniform (Tile *tile)
+{
+  if (! tile_data_is_uniform (tile->data, tile->size, tile->bpp))
+    return FALSE;
+
+  memcpy (tile->uniform_pixel, tile->data, tile->bpp);
+
+  tile->uniform = TRUE;
+  tile->dirty   = FALSE;
+
+  /*  whatever is in the swap file is outdated now  */
+  if (tile->swap_offset != -1)
+    tile_swap_delete (tile);
+
+  return TRUE;
+}
+
+/*  moves an evicted tile into the compressed tier, if it compresses
+ *  well enough and there is room; @oldest links it in as the least
+ *  recently used tile of the tier
+ */
+static gboolean
+tile_cache_compress (Tile     *tile,
+                     gboolean  oldest)
+{
+  guchar  buf[TILE_WIDTH * TILE_HEIGHT * TILE_MAX_BPP /
+              TILE_CACHE_COMPRESSED_MIN_RATIO];
+  GBytes *bytes;
+  gint    size;
+  gint    charged;
+
+  size = tile_compress_rle (tile->data, tile->size, tile->bpp,
+                            buf, tile->size / TILE_CACHE_COMPRESSED_MIN_RATIO);
+
+  if (size < 0)
+    return FALSE;
+
+  bytes = g_bytes_new (buf, size);
+
+  COMPRESSED_LOCK;
+
+  while (TRUE)
+    {
+      gpointer shared;
+      gpointer n_users;
+
+      if (dedup_enabled &&
+          g_hash_table_lookup_extended (dedup_table, bytes,
+                                        &shared, &n_users))
+        {
+          /*  the same data is in the tier already, use it  */
+          g_hash_table_insert (dedup_table, g_bytes_ref (shared),
+                               GUINT_TO_POINTER (GPOINTER_TO_UINT (n_users) + 1));
+          g_bytes_unref (bytes);
+          bytes = g_bytes_ref (shared);
+
+          dedup_saved  += size;
+          dedup_shared += 1;
+          charged       = 0;
+          break;
+        }
+
+      if (compressed_size + size <=
+          max_cache_size / TILE_CACHE_COMPRESSED_FRACTION)
+        {
+          if (dedup_enabled)
+            g_hash_table_insert (dedup_table, g_bytes_ref (bytes),
+                                 GUINT_TO_POINTER (1));
+
+          charged = size;
+          break;
+        }
+
+      COMPRESSED_UNLOCK;
+
+      if (! tile_cache_spill_compressed ())
+        {
+          g_bytes_unref (bytes);
+          return FALSE;
+        }
+
+      COMPRESSED_LOCK;
+    }
+
+  tile->compressed_data = bytes;
+  tile->compressed_size = size;
+
+  if (oldest)
+    {
+      tile->prev = NULL;
+      tile->next = compressed_list.first;
+
+      if (compressed_list.first)
+        compressed_list.first->prev = tile;
+      else
+        compressed_list.last = tile;
+
+      compressed_list.first = tile;
+    }
+  else
+    {
+      tile->next = NULL;
+      tile->prev = compressed_list.last;
+
+      if (compressed_list.last)
+        compressed_list.last->next = tile;
+      else
+        compressed_list.first = tile;
+
+      compressed_list.last = tile;
+    }
+
+  compressed_size      += charged;
+  compressed_orig_size += tile->size;
+
+  COMPRESSED_UNLOCK;
+
+  g_free (tile->data);
+  tile->data = NULL;
+
+#ifdef TILE_PROFILING
+  tile_exist_count--;
+#endif
+
+  tile_cache_add_size (charged);
+
+  return TRUE;
+}
+
+/*  drops the least recently used tile from the compressed tier, writing
+ *  it to the swap file first if its data isn't there yet
+ */
+static gboolean
+tile_cache_spill_compressed (void)
 {
   Tile *tile;
-  int count = 0;
+  gint  size;
+
+  COMPRESSED_LOCK;
+
+  tile = compressed_list.first;
+
+  if (! tile)
+    {
+      COMPRESSED_UNLOCK;
+
+      return FALSE;
+    }
+
+  if (PENDING_WRITE (tile))
+    {
+      tile_alloc (tile);
+      tile_decompress_rle (g_bytes_get_data (tile->compressed_data, NULL),
+                           tile->compressed_size, tile->bpp,
+                           tile->data, tile->size);
+
+      idle_delay = 1;
+      tile_swap_evict (tile);
+
+      if (tile->dirty)
+        {
+          /* unable to swap out tile for some reason, keep it compressed */
+          g_free (tile->data);
+          tile->data = NULL;
+
+#ifdef TILE_PROFILING
+          tile_exist_count--;
+#endif
+
+          COMPRESSED_UNLOCK;
+
+          return FALSE;
+        }
+
+#ifdef TILE_PROFILING
+      tile_exist_count--;
+#endif
+    }
+
+  size = tile_compressed_unlink (tile);
+
+  COMPRESSED_UNLOCK;
+
+  tile_cache_add_size (- (gint64) size);
+
+  return TRUE;
+}
+
+/*  called with the compressed tier's lock held, returns the number of
+ *  bytes freed, which is zero if other tiles still share the data
+ */
+static gint
+tile_compressed_unlink (Tile *tile)
+{
+  gpointer n_users = NULL;
+  gint     freed   = tile->compressed_size;
+
+  if (tile->next)
+    tile->next->prev = tile->prev;
+  else
+    compressed_list.last = tile->prev;
+
+  if (tile->prev)
+    tile->prev->next = tile->next;
+  else
+    compressed_list.first = tile->next;
+
+  tile->next = tile->prev = NULL;
+
+  if (g_hash_table_size (dedup_table) > 0)
+    n_users = g_hash_table_lookup (dedup_table, tile->compressed_data);
+
+  if (GPOINTER_TO_UINT (n_users) > 1)
+    {
+      g_hash_table_insert (dedup_table, g_bytes_ref (tile->compressed_data),
+                           GUINT_TO_POINTER (GPOINTER_TO_UINT (n_users) - 1));
+
+      dedup_saved  -= freed;
+      dedup_shared -= 1;
+      freed         = 0;
+    }
+  else if (n_users)
+    {
+      g_hash_table_remove (dedup_table, tile->compressed_data);
+    }
+
+  compressed_size      -= freed;
+  compressed_orig_size -= tile->size;
+
+  g_bytes_unref (tile->compressed_data);
+  tile->compressed_data = NULL;
+  tile->compressed_size = 0;
+
+  return freed;
+}
+
+/*  zorches a few tiles while the cache is larger than its target size,
+ *  returns TRUE if there are more to zorch
+ */
+static gboolean
+tile_cache_shrink_idle (void)
+{
+  gboolean zorched = TRUE;
+  gboolean more;
+  gint     count;
+
+  for (count = 0; count < IDLE_SWAPPER_TILES_PER_INTERVAL; count++)
+    {
+      gboolean over;
+
+      TILE_CACHE_LOCK;
+      over = (cur_cache_size > target_size);
+      TILE_CACHE_UNLOCK;
+
+      if (! over)
+        break;
+
+      zorched = (tile_cache_zorch_next () || tile_cache_spill_compressed ());
+
+      if (! zorched)
+        break;
+    }
+
+  TILE_CACHE_LOCK;
+
+  if (max_cache_size > target_size)
+    max_cache_size = MAX (target_size,
+                          MIN (max_cache_size, cur_cache_size));
+
+  more = (zorched && max_cache_size > target_size);
+
+  TILE_CACHE_UNLOCK;
+
+  return more;
+}
+
+static gboolean
+tile_idle_preswap_run (gpointer data)
+{
+  gint count = 0;
 
   if (idle_delay)
     {
@@ -359,52 +1087,67 @@ tile_idle_preswap_run (gpointer data)
       return FALSE;
     }
 
-  TILE_CACHE_LOCK;
-
 #ifdef TILE_PROFILING
   g_printerr(".");
 #endif
 
-  tile = idle_scan_last;
+  if (tile_cache_shrink_idle ())
+    return TRUE;
 
-  while (tile)
+  for (; idle_shard < TILE_CACHE_N_SHARDS; idle_shard++)
     {
-      if (PENDING_WRITE (tile))
+      TileCacheShard *shard = &shards[idle_shard];
+      Tile           *tile;
+
+      SHARD_LOCK (shard);
+
+      tile = shard->idle_scan_last;
+
+      while (tile)
         {
-          idle_scan_last = tile->next;
+          if (PENDING_WRITE (tile))
+            {
+              shard->idle_scan_last = tile->next;
 
 #ifdef TILE_PROFILING
-          tile_idle_swapout++;
+              tile_idle_swapout++;
 #endif
-          tile_swap_out (tile);
+              tile_swap_out (tile);
 
-          if (! PENDING_WRITE(tile))
-            cur_cache_dirty -= tile->size;
+              if (! PENDING_WRITE (tile))
+                shard->cur_dirty -= tile->size;
 
-          count++;
-          if (count >= IDLE_SWAPPER_TILES_PER_INTERVAL)
-            {
-              TILE_CACHE_UNLOCK;
-              return TRUE;
+              count++;
+              if (count >= IDLE_SWAPPER_TILES_PER_INTERVAL)
+                {
+                  SHARD_UNLOCK (shard);
+                  return TRUE;
+                }
             }
+
+          tile = tile->next;
         }
 
-      tile = tile->next;
+      shard->idle_scan_last = NULL;
+
+      SHARD_UNLOCK (shard);
     }
 
 #ifdef TILE_PROFILING
   g_printerr ("\nidle swapper -> stopped\n");
 #endif
 
-  idle_scan_last = NULL;
+  TILE_CACHE_LOCK;
+
+  idle_shard   = 0;
   idle_swapper = 0;
 
+  TILE_CACHE_UNLOCK;
+
 #ifdef TILE_PROFILING
   tile_verify ();
 #endif
 
-  TILE_CACHE_UNLOCK;
-
   return FALSE;
 }
 
@@ -425,6 +1168,7 @@ tile_idle_preswap (gpointer data)
   g_printerr("\nidle swapper -> running");
 #endif
 
+  idle_shard   = 0;
   idle_swapper = g_timeout_add_full (G_PRIORITY_LOW,
 				     IDLE_SWAPPER_INTERVAL_MS,
 				     tile_idle_preswap_run,
@@ -436,40 +1180,52 @@ tile_idle_preswap (gpointer data)
 static void
 tile_verify (void)
 {
-  /* scan list linearly, count metrics, compare to running totals */
-  const Tile *t;
-  guint64     local_size  = 0;
-  guint64     local_dirty = 0;
-  guint64     acc         = 0;
+  /* scan lists linearly, count metrics, compare to running totals */
+  guint64 local_size  = 0;
+  gint    i;
 
-  for (t = tile_list.first; t; t = t->next)
+  for (i = 0; i < TILE_CACHE_N_SHARDS; i++)
     {
-      local_size += t->size;
+      TileCacheShard *shard       = &shards[i];
+      const Tile     *t;
+      guint64         local_dirty = 0;
+      guint64         acc         = 0;
 
-      if (PENDING_WRITE (t))
-        local_dirty += t->size;
-    }
+      SHARD_LOCK (shard);
 
-  if (local_size != cur_cache_size)
-    g_printerr ("\nCache size mismatch: running=%"G_GUINT64_FORMAT
-                ", tested=%"G_GUINT64_FORMAT"\n",
-                cur_cache_size,local_size);
+      for (t = shard->tile_list.first; t; t = t->next)
+        {
+          local_size += t->size;
 
-  if (local_dirty != cur_cache_dirty)
-    g_printerr ("\nCache dirty mismatch: running=%"G_GUINT64_FORMAT
-                ", tested=%"G_GUINT64_FORMAT"\n",
-                cur_cache_dirty,local_dirty);
+          if (PENDING_WRITE (t))
+            local_dirty += t->size;
+        }
 
-  /* scan forward from scan list */
-  for (t = idle_scan_last; t; t = t->next)
-    {
-      if (PENDING_WRITE (t))
-        acc += t->size;
+      if (local_dirty != shard->cur_dirty)
+        g_printerr ("\nCache dirty mismatch in shard %d: "
+                    "running=%"G_GUINT64_FORMAT
+                    ", tested=%"G_GUINT64_FORMAT"\n",
+                    i, shard->cur_dirty, local_dirty);
+
+      /* scan forward from scan list */
+      for (t = shard->idle_scan_last; t; t = t->next)
+        {
+          if (PENDING_WRITE (t))
+            acc += t->size;
+        }
+
+      if (acc != local_dirty)
+        g_printerr ("\nDirty scan follower mismatch in shard %d: "
+                    "running=%"G_GUINT64_FORMAT
+                    ", tested=%"G_GUINT64_FORMAT"\n",
+                    i, acc, local_dirty);
+
+      SHARD_UNLOCK (shard);
     }
 
-  if (acc != local_dirty)
-    g_printerr ("\nDirty scan follower mismatch: running=%"G_GUINT64_FORMAT
+  if (local_size != cur_cache_size)
+    g_printerr ("\nCache size mismatch: running=%"G_GUINT64_FORMAT
                 ", tested=%"G_GUINT64_FORMAT"\n",
-                acc,local_dirty);
+                cur_cache_size,local_size);
 }
 #endif
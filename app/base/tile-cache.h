@@ -19,13 +19,29 @@
 #define __TILE_CACHE_H__
 
 
-void   tile_cache_init                 (guint64 cache_size);
-void   tile_cache_exit                 (void);
+void     tile_cache_init                 (guint64   cache_size);
+void     tile_cache_exit                 (void);
 
-void   tile_cache_set_size             (guint64 cache_size);
-void   tile_cache_suspend_idle_swapper (void);
+void     tile_cache_set_size             (guint64   cache_size);
+void     tile_cache_set_target_size      (guint64   cache_size);
+void     tile_cache_set_compression      (gboolean  enable);
+void     tile_cache_set_deduplication    (gboolean  enable);
+void     tile_cache_suspend_idle_swapper (void);
 
-void   tile_cache_insert               (Tile   *tile);
-void   tile_cache_flush                (Tile   *tile);
+void     tile_cache_insert               (Tile     *tile);
+void     tile_cache_flush                (Tile     *tile);
+void     tile_cache_discard              (Tile     *tile);
+gboolean tile_cache_evict                (Tile     *tile);
+gboolean tile_cache_uncompress           (Tile     *tile);
+
+void     tile_cache_get_usage             (guint64 *cache_size,
+                                           guint64 *max_size,
+                                           guint64 *dirty_size);
+void     tile_cache_get_compression_stats (guint64 *compressed_size,
+                                           guint64 *uncompressed_size,
+                                           gulong  *n_hits,
+                                           gulong  *n_misses);
+void     tile_cache_get_dedup_stats       (guint64 *saved_size,
+                                           gulong  *n_shared);
 
 #endif /* __TILE_CACHE_H__ */
@@ -0,0 +1,229 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base-types.h"
+
+#include "tile-compress.h"
+
+
+/*  A byte oriented run-length encoding, applied separately to each
+ *  channel of the pixel data, like the one used for XCF tiles. It is
+ *  cheap enough to be used when tiles are evicted from the tile cache,
+ *  and very effective on masks, selections and flat-colour areas.
+ *
+ *  Each run starts with a control byte n. For n < 128, n + 1 literal
+ *  bytes follow; otherwise the following byte is repeated n - 126
+ *  times.
+ */
+
+#define RLE_MAX_LITERAL 128
+#define RLE_MAX_REPEAT  129
+
+
+static gint
+tile_compress_channel (const guchar *src,
+                       gint          n_pixels,
+                       gint          bpp,
+                       guchar       *dest,
+                       gint          dest_size)
+{
+  gint i   = 0;
+  gint out = 0;
+
+  while (i < n_pixels)
+    {
+      guchar value = src[i * bpp];
+      gint   run   = 1;
+
+      while (i + run < n_pixels   &&
+             run < RLE_MAX_REPEAT &&
+             src[(i + run) * bpp] == value)
+        {
+          run++;
+        }
+
+      if (run > 1)
+        {
+          if (out + 2 > dest_size)
+            return -1;
+
+          dest[out++] = run + 126;
+          dest[out++] = value;
+
+          i += run;
+        }
+      else
+        {
+          gint start = i;
+          gint len   = 0;
+
+          do
+            {
+              i++;
+              len++;
+            }
+          while (i < n_pixels          &&
+                 len < RLE_MAX_LITERAL &&
+                 ! (i + 1 < n_pixels && src[i * bpp] == src[(i + 1) * bpp]));
+
+          if (out + 1 + len > dest_size)
+            return -1;
+
+          dest[out++] = len - 1;
+
+          for (; start < i; start++)
+            dest[out++] = src[start * bpp];
+        }
+    }
+
+  return out;
+}
+
+/**
+ * tile_compress_rle:
+ * @src:       the pixel data
+ * @src_size:  the size of @src in bytes
+ * @bpp:       the number of bytes per pixel of @src
+ * @dest:      the buffer to compress into
+ * @dest_size: the size of @dest
+ *
+ * Return value: the size of the compressed data, or -1 if it doesn't
+ *               fit into @dest_size bytes.
+ **/
+gint
+tile_compress_rle (const guchar *src,
+                   gint          src_size,
+                   gint          bpp,
+                   guchar       *dest,
+                   gint          dest_size)
+{
+  gint n_pixels = src_size / bpp;
+  gint out      = 0;
+  gint c;
+
+  for (c = 0; c < bpp; c++)
+    {
+      gint size = tile_compress_channel (src + c, n_pixels, bpp,
+                                         dest + out, dest_size - out);
+
+      if (size < 0)
+        return -1;
+
+      out += size;
+    }
+
+  return out;
+}
+
+/**
+ * tile_decompress_rle:
+ * @src:       data returned by tile_compress_rle()
+ * @src_size:  the size of @src in bytes
+ * @bpp:       the number of bytes per pixel of the pixel data
+ * @dest:      the buffer to decompress into
+ * @dest_size: the size of the pixel data
+ *
+ * Return value: %TRUE if @src could be decompressed completely.
+ **/
+gboolean
+tile_decompress_rle (const guchar *src,
+                     gint          src_size,
+                     gint          bpp,
+                     guchar       *dest,
+                     gint          dest_size)
+{
+  const guchar *end      = src + src_size;
+  gint          n_pixels = dest_size / bpp;
+  gint          c;
+
+  for (c = 0; c < bpp; c++)
+    {
+      guchar *d = dest + c;
+      gint    i = 0;
+
+      while (i < n_pixels)
+        {
+          gint n;
+
+          if (src >= end)
+            return FALSE;
+
+          n = *src++;
+
+          if (n < RLE_MAX_LITERAL)
+            {
+              n++;
+
+              if (i + n > n_pixels || src + n > end)
+                return FALSE;
+
+              i += n;
+
+              while (n--)
+                {
+                  *d = *src++;
+                  d += bpp;
+                }
+            }
+          else
+            {
+              guchar value;
+
+              n -= 126;
+
+              if (i + n > n_pixels || src >= end)
+                return FALSE;
+
+              value = *src++;
+
+              i += n;
+
+              while (n--)
+                {
+                  *d = value;
+                  d += bpp;
+                }
+            }
+        }
+    }
+
+  return TRUE;
+}
+
+/**
+ * tile_data_is_uniform:
+ * @src:      the pixel data
+ * @src_size: the size of @src in bytes
+ * @bpp:      the number of bytes per pixel of @src
+ *
+ * Return value: %TRUE if all pixels of @src have the same value.
+ **/
+gboolean
+tile_data_is_uniform (const guchar *src,
+                      gint          src_size,
+                      gint          bpp)
+{
+  /*  the data is uniform if it equals itself shifted by one pixel  */
+  return (src_size <= bpp ||
+          memcmp (src, src + bpp, src_size - bpp) == 0);
+}
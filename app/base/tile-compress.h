@@ -0,0 +1,38 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TILE_COMPRESS_H__
+#define __TILE_COMPRESS_H__
+
+
+gint       tile_compress_rle    (const guchar *src,
+                                 gint          src_size,
+                                 gint          bpp,
+                                 guchar       *dest,
+                                 gint          dest_size);
+gboolean   tile_decompress_rle  (const guchar *src,
+                                 gint          src_size,
+                                 gint          bpp,
+                                 guchar       *dest,
+                                 gint          dest_size);
+
+gboolean   tile_data_is_uniform (const guchar *src,
+                                 gint          src_size,
+                                 gint          bpp);
+
+
+#endif /* __TILE_COMPRESS_H__ */
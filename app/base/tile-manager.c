@@ -154,6 +154,9 @@ tile_manager_unref (TileManager *tm)
           g_free (tm->tiles);
         }
 
+      if (tm->user_data_destroy)
+        tm->user_data_destroy (tm->user_data);
+
       g_slice_free (TileManager, tm);
     }
 }
@@ -178,22 +181,119 @@ tile_manager_duplicate (TileManager *tm)
       Tile *tile;
 
       tile = tile_manager_get (tm, i, TRUE, FALSE);
-      tile_manager_map (copy, i, tile);
+
+      /*  tiles that are locked for writing may be changed in place,
+       *  like the ones GEGL uses directly, so they are copied
+       */
+      if (tile->write_count == 0)
+        {
+          tile_manager_map (copy, i, tile);
+        }
+      else
+        {
+          Tile *dest = tile_manager_get (copy, i, TRUE, TRUE);
+
+          memcpy (dest->data, tile->data, tile->size);
+          tile_release (dest, TRUE);
+        }
+
       tile_release (tile, FALSE);
     }
 
   return copy;
 }
 
+TileManager *
+tile_manager_duplicate_area (TileManager *tm,
+                             gint         x,
+                             gint         y,
+                             gint         width,
+                             gint         height)
+{
+  TileManager *copy;
+  gboolean     aligned;
+  gint         row, col;
+  gint         i;
+
+  g_return_val_if_fail (tm != NULL, NULL);
+  g_return_val_if_fail (x >= 0 && y >= 0, NULL);
+  g_return_val_if_fail (width > 0 && x + width <= tm->width, NULL);
+  g_return_val_if_fail (height > 0 && y + height <= tm->height, NULL);
+
+  if (x == 0 && y == 0 && width == tm->width && height == tm->height)
+    return tile_manager_duplicate (tm);
+
+  copy = tile_manager_new (width, height, tm->bpp);
+
+  tile_manager_allocate_tiles (copy);
+
+  aligned = (x % TILE_WIDTH == 0 && y % TILE_HEIGHT == 0);
+
+  for (row = 0, i = 0; row < copy->ntile_rows; row++)
+    for (col = 0; col < copy->ntile_cols; col++, i++)
+      {
+        gint  src_x = x + col * TILE_WIDTH;
+        gint  src_y = y + row * TILE_HEIGHT;
+        Tile *tile;
+
+        if (aligned)
+          {
+            tile = tile_manager_get_tile (tm, src_x, src_y, TRUE, FALSE);
+
+            /*  edge tiles can only be shared if they end at the same
+             *  place in both tile managers, and tiles that are locked
+             *  for writing not at all, see tile_manager_duplicate()
+             */
+            if (tile->write_count == 0                  &&
+                tile->ewidth  == copy->tiles[i]->ewidth &&
+                tile->eheight == copy->tiles[i]->eheight)
+              {
+                tile_manager_map (copy, i, tile);
+                tile_release (tile, FALSE);
+                continue;
+              }
+
+            tile_release (tile, FALSE);
+          }
+
+        tile = tile_manager_get (copy, i, TRUE, TRUE);
+
+        tile_manager_read_pixel_data (tm,
+                                      src_x,
+                                      src_y,
+                                      src_x + tile->ewidth  - 1,
+                                      src_y + tile->eheight - 1,
+                                      tile->data,
+                                      tile->ewidth * tile->bpp);
+
+        tile_release (tile, TRUE);
+      }
+
+  return copy;
+}
+
 void
 tile_manager_set_validate_proc (TileManager      *tm,
                                 TileValidateProc  proc,
                                 gpointer          user_data)
+{
+  tile_manager_set_validate_proc_full (tm, proc, user_data, NULL);
+}
+
+void
+tile_manager_set_validate_proc_full (TileManager      *tm,
+                                     TileValidateProc  proc,
+                                     gpointer          user_data,
+                                     GDestroyNotify    destroy)
 {
   g_return_if_fail (tm != NULL);
 
-  tm->validate_proc = proc;
-  tm->user_data     = user_data;
+  if (tm->user_data_destroy)
+    tm->user_data_destroy (tm->user_data);
+
+  tm->validate_proc     = proc;
+  tm->user_data         = user_data;
+  tm->user_data_destroy = destroy;
 }
 
 Tile *
@@ -298,7 +398,8 @@ tile_manager_get (TileManager *tm,
 	  /* must lock before marking dirty */
 	  tile_lock (tile);
           tile->write_count++;
-          tile->dirty = TRUE;
+          tile->dirty   = TRUE;
+          tile->uniform = FALSE;
         }
       else
         {
@@ -409,8 +510,8 @@ tile_manager_invalidate_tile (TileManager  *tm,
       tm->cached_num  = -1;
     }
 
-  if (tile->cached)
-    tile_cache_flush (tile);
+  if (tile->cached || tile->compressed_data)
+    tile_cache_discard (tile);
 
   if (G_UNLIKELY (tile->share_count > 1))
     {
@@ -428,7 +529,8 @@ tile_manager_invalidate_tile (TileManager  *tm,
       tm->tiles[tile_num] = tile;
     }
 
-  tile->valid = FALSE;
+  tile->valid   = FALSE;
+  tile->uniform = FALSE;
 
   if (tile->data)
     {
@@ -614,6 +716,105 @@ tile_manager_get_memsize (const TileManager *tm,
   return memsize;
 }
 
+gint64
+tile_manager_get_shared_memsize (const TileManager *tm)
+{
+  gint64 memsize = sizeof (TileManager);
+
+  if (! tm)
+    return 0;
+
+  memsize += (gint64) tm->ntile_rows * tm->ntile_cols * (sizeof (Tile) +
+                                                         sizeof (gpointer));
+
+  if (tm->tiles)
+    {
+      Tile **tiles = tm->tiles;
+      gint   i;
+
+      for (i = 0; i < tm->ntile_rows * tm->ntile_cols; i++, tiles++)
+        {
+          if (tile_is_valid (*tiles))
+            memsize += (*tiles)->size / MAX ((*tiles)->share_count, 1);
+        }
+    }
+
+  return memsize;
+}
+
+gint64
+tile_manager_get_resident_memsize (const TileManager *tm)
+{
+  gint64 memsize = sizeof (TileManager);
+
+  if (! tm)
+    return 0;
+
+  memsize += (gint64) tm->ntile_rows * tm->ntile_cols * (sizeof (Tile) +
+                                                         sizeof (gpointer));
+
+  if (tm->tiles)
+    {
+      Tile **tiles = tm->tiles;
+      gint   i;
+
+      for (i = 0; i < tm->ntile_rows * tm->ntile_cols; i++, tiles++)
+        {
+          Tile *tile = *tiles;
+          gint  size;
+
+          if (! tile_is_valid (tile))
+            continue;
+
+          if (tile->data)
+            size = tile->size;
+          else if (tile->compressed_data)
+            size = tile->compressed_size;
+          else
+            continue;
+
+          memsize += size / MAX (tile->share_count, 1);
+        }
+    }
+
+  return memsize;
+}
+
+/*  pushes the tiles only this tile manager holds out of memory, into
+ *  the tile cache's compressed tier or the swap file, without waiting
+ *  for them to age out of the cache. They are brought back the next
+ *  time they are locked. Returns the number of bytes freed.
+ */
+gint64
+tile_manager_evict (TileManager *tm)
+{
+  gint64 freed = 0;
+
+  g_return_val_if_fail (tm != NULL, 0);
+
+  if (tm->tiles)
+    {
+      Tile **tiles = tm->tiles;
+      gint   i;
+
+      for (i = 0; i < tm->ntile_rows * tm->ntile_cols; i++, tiles++)
+        {
+          Tile *tile = *tiles;
+
+          if (tile_is_valid (tile) &&
+              tile->share_count == 1 &&
+              tile->ref_count   == 0 &&
+              tile->data        &&
+              tile_cache_evict (tile))
+            {
+              freed += tile->size - tile->compressed_size;
+            }
+        }
+    }
+
+  return freed;
+}
+
 static inline gint
 tile_manager_locate_tile (TileManager *tm,
                           Tile        *tile)
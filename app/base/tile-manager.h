@@ -43,10 +43,21 @@ TileManager * tile_manager_new               (gint width,
 TileManager * tile_manager_ref               (TileManager *tm);
 void          tile_manager_unref             (TileManager *tm);
 
-/* Make a copy of the tile manager.
+/* Make a copy of the tile manager.  The copy shares the tiles with
+ *  the original until either of them is written to.
  */
 TileManager * tile_manager_duplicate         (TileManager *tm);
 
+/* Make a copy of an area of the tile manager.  If the area starts at
+ *  a tile boundary, the tiles are shared like in tile_manager_duplicate(),
+ *  otherwise their contents are copied.
+ */
+TileManager * tile_manager_duplicate_area    (TileManager *tm,
+                                              gint         x,
+                                              gint         y,
+                                              gint         width,
+                                              gint         height);
+
 /* Set the validate procedure for the tile manager.  The validate
  *  procedure is called when an invalid tile is referenced. If the
  *  procedure is NULL, then the tile is set to valid and its memory is
@@ -56,6 +67,16 @@ void          tile_manager_set_validate_proc (TileManager      *tm,
                                               TileValidateProc  proc,
                                               gpointer          user_data);
 
+/* Like tile_manager_set_validate_proc(), but user_data is freed using
+ *  destroy when the tile manager is destroyed or another validate
+ *  procedure is set. Such procedures must not use GEGL, so the GEGL
+ *  tile backend can always call them.
+ */
+void    tile_manager_set_validate_proc_full  (TileManager      *tm,
+                                              TileValidateProc  proc,
+                                              gpointer          user_data,
+                                              GDestroyNotify    destroy);
+
 /* Get a specified tile from a tile manager.
  */
 Tile        * tile_manager_get_tile          (TileManager *tm,
@@ -104,6 +125,18 @@ gint          tile_manager_bpp               (const TileManager *tm);
 gint64        tile_manager_get_memsize       (const TileManager *tm,
                                               gboolean           sparse);
 
+/* Like the sparse tile_manager_get_memsize(), but tiles shared with
+ *  other tile managers only count with their share of the memory.
+ */
+gint64        tile_manager_get_shared_memsize (const TileManager *tm);
+
+/* Like tile_manager_get_shared_memsize(), but only counts what is
+ *  currently in memory, compressed tiles with their compressed size.
+ */
+gint64        tile_manager_get_resident_memsize (const TileManager *tm);
+
+gint64        tile_manager_evict              (TileManager       *tm);
+
 void          tile_manager_get_tile_coordinates (TileManager *tm,
                                                  Tile        *tile,
                                                  gint        *x,
@@ -52,6 +52,10 @@ struct _Tile
   guint   dirty : 1;    /* is the tile dirty? has it been modified? */
   guint   valid : 1;    /* is the tile valid? */
   guint  cached : 1;    /* is the tile cached */
+  guint uniform : 1;    /* are all pixels equal to uniform_pixel? such a
+                         *  tile keeps no data while it is out of use,
+                         *  it is expanded again when it is locked
+                         */
 
 #ifdef TILE_PROFILING
 
@@ -64,7 +68,10 @@ struct _Tile
 
 #endif
 
-  guchar  bpp;          /* the bytes per pixel (1, 2, 3 or 4) */
+  guchar  bpp;          /* the bytes per pixel (1 to TILE_MAX_BPP) */
+  guchar  uniform_pixel[TILE_MAX_BPP]; /* the value of all pixels of a
+                                        *  uniform tile
+                                        */
   gushort ewidth;       /* the effective width of the tile */
   gushort eheight;      /* the effective height of the tile
                          *  a tile's effective width and height may be smaller
@@ -84,6 +91,13 @@ struct _Tile
                          * to -1.
                          */
 
+  GBytes *compressed_data; /* the compressed tile data while the tile is
+                            * in the tile cache's compressed tier, or NULL.
+                            * with deduplication, tiles with the same
+                            * contents share it
+                            */
+  gint    compressed_size;
+
   TileLink *tlink;
 
   Tile     *next;       /* List pointers for the tile cache lists */
@@ -17,14 +17,22 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <glib-object.h>
 
+#include "libgimpbase/gimpbase.h"
+
 #include "base-types.h"
 
 #include "tile.h"
 #include "tile-manager.h"
 #include "tile-pyramid.h"
 
+#ifdef TILE_PYRAMID_SSE2
+#include <emmintrin.h>
+#endif
+
 
 #define PYRAMID_MAX_LEVELS  10
 
@@ -36,6 +44,7 @@ struct _TilePyramid
   gint           bytes;
   TileManager   *tiles[PYRAMID_MAX_LEVELS];
   gint           top_level;
+  gboolean       shared_base;  /*  the bottom level belongs to someone else  */
 };
 
 
@@ -97,6 +106,38 @@ tile_pyramid_new (gint bytes,
   return pyramid;
 }
 
+/**
+ * tile_pyramid_new_for_tiles:
+ * @tiles: the bottom level
+ *
+ * Creates a new #TilePyramid on top of existing pixel data, like a
+ * drawable's tiles. The pyramid keeps a reference on @tiles, but
+ * never invalidates or validates them; it is up to the owner of
+ * @tiles to call tile_pyramid_invalidate_area() for the areas it
+ * changes, which then only drops the affected tiles on the upper
+ * levels.
+ *
+ * Return value: a newly allocate #TilePyramid
+ **/
+TilePyramid *
+tile_pyramid_new_for_tiles (TileManager *tiles)
+{
+  TilePyramid *pyramid;
+
+  g_return_val_if_fail (tiles != NULL, NULL);
+
+  pyramid = g_slice_new0 (TilePyramid);
+
+  pyramid->bytes       = tile_manager_bpp (tiles);
+  pyramid->width       = tile_manager_width (tiles);
+  pyramid->height      = tile_manager_height (tiles);
+  pyramid->shared_base = TRUE;
+
+  pyramid->tiles[0] = tile_manager_ref (tiles);
+
+  return pyramid;
+}
+
 /**
  * tile_pyramid_destroy:
  * @pyramid: a #TilePyramid
@@ -194,7 +235,9 @@ tile_pyramid_get_tiles (TilePyramid *pyramid,
  * @width:
  * @height:
  *
- * Invalidates the tiles in the given area on all levels.
+ * Invalidates the tiles in the given area on all levels, except for
+ * the bottom level of a pyramid created with
+ * tile_pyramid_new_for_tiles().
  **/
 void
 tile_pyramid_invalidate_area (TilePyramid *pyramid,
@@ -217,8 +260,9 @@ tile_pyramid_invalidate_area (TilePyramid *pyramid,
       /* Tile invalidation must propagate all the way up in the pyramid,
        * so keep width and height > 0.
        */
-      tile_manager_invalidate_area (pyramid->tiles[level],
-                                    x, y, MAX (width, 1), MAX (height, 1));
+      if (level > 0 || ! pyramid->shared_base)
+        tile_manager_invalidate_area (pyramid->tiles[level],
+                                      x, y, MAX (width, 1), MAX (height, 1));
 
       x      >>= 1;
       y      >>= 1;
@@ -301,12 +345,397 @@ tile_pyramid_get_memsize (const TilePyramid *pyramid)
 
   g_return_val_if_fail (pyramid != NULL, 0);
 
-  for (level = 0; level <= pyramid->top_level; level++)
+  for (level = pyramid->shared_base ? 1 : 0;
+       level <= pyramid->top_level;
+       level++)
     memsize += tile_manager_get_memsize (pyramid->tiles[level], TRUE);
 
   return memsize;
 }
 
+/**
+ * tile_pyramid_validate_area:
+ * @pyramid: a #TilePyramid
+ * @x:
+ * @y:
+ * @width:
+ * @height:
+ *
+ * Validates the tiles in the given area on all levels above the
+ * bottom level, so that they don't need to be computed when the
+ * display first asks for them.  Levels that have not been allocated
+ * yet are left alone.
+ **/
+void
+tile_pyramid_validate_area (TilePyramid *pyramid,
+                            gint         x,
+                            gint         y,
+                            gint         width,
+                            gint         height)
+{
+  gint level;
+
+  g_return_if_fail (pyramid != NULL);
+  g_return_if_fail (x >= 0 && y >= 0);
+  g_return_if_fail (width >= 0 && height >= 0);
+
+  if (width == 0 || height == 0)
+    return;
+
+  for (level = 1; level <= pyramid->top_level; level++)
+    {
+      TileManager *tm = pyramid->tiles[level];
+      gint         x1 = x >> level;
+      gint         y1 = y >> level;
+      gint         x2 = MIN ((x + width  - 1) >> level,
+                             tile_manager_width  (tm) - 1);
+      gint         y2 = MIN ((y + height - 1) >> level,
+                             tile_manager_height (tm) - 1);
+      gint         col, row;
+
+      for (row = y1 / TILE_HEIGHT; row <= y2 / TILE_HEIGHT; row++)
+        for (col = x1 / TILE_WIDTH; col <= x2 / TILE_WIDTH; col++)
+          {
+            Tile *tile = tile_manager_get_at (tm, col, row, TRUE, FALSE);
+
+            if (tile)
+              tile_release (tile, FALSE);
+          }
+    }
+}
+
+/**
+ * tile_pyramid_reduce_row_scalar:
+ * @src0:        the upper source row
+ * @src1:        the lower source row
+ * @dest:        the destination row
+ * @n_pixels:    number of destination pixels
+ * @bpp:         bytes per pixel
+ * @premultiply: whether the source is not pre-multiplied yet
+ *
+ * Averages each 2x2 block of source pixels into one destination
+ * pixel. If @premultiply is %TRUE, the alpha channel is
+ * pre-multiplied while doing so. Exposed for testing.
+ **/
+void
+tile_pyramid_reduce_row_scalar (const guchar *src0,
+                                const guchar *src1,
+                                guchar       *dest,
+                                gint          n_pixels,
+                                gint          bpp,
+                                gboolean      premultiply)
+{
+  const guchar *src2 = src1;
+  const guchar *src3 = src1 + bpp;
+  guchar       *dst  = dest;
+  gint          x;
+
+  src1 = src0 + bpp;
+
+  switch (bpp)
+    {
+    case 1:
+      for (x = 0; x < n_pixels; x++)
+        {
+          dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
+
+          dst += 1;
+
+          src0 += 2;
+          src1 += 2;
+          src2 += 2;
+          src3 += 2;
+        }
+      break;
+
+    case 2:
+      for (x = 0; x < n_pixels; x++)
+        {
+          if (premultiply)
+            {
+              const guint a = src0[1] + src1[1] + src2[1] + src3[1];
+
+              switch (a)
+                {
+                case 0:    /* all transparent */
+                  dst[0] = dst[1] = 0;
+                  break;
+
+                case 1020: /* all opaque */
+                  dst[0] = (src0[0]  + src1[0] + src2[0] + src3[0] + 2) >> 2;
+                  dst[1] = 255;
+                  break;
+
+                default:
+                  dst[0] = ((src0[0] * (src0[1] + 1) +
+                             src1[0] * (src1[1] + 1) +
+                             src2[0] * (src2[1] + 1) +
+                             src3[0] * (src3[1] + 1)) >> 10);
+                  dst[1] = (a + 2) >> 2;
+                  break;
+                }
+            }
+          else
+            {
+              dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
+              dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
+            }
+
+          dst += 2;
+
+          src0 += 4;
+          src1 += 4;
+          src2 += 4;
+          src3 += 4;
+        }
+      break;
+
+    case 3:
+      for (x = 0; x < n_pixels; x++)
+        {
+          dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
+          dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
+          dst[2] = (src0[2] + src1[2] + src2[2] + src3[2] + 2) >> 2;
+
+          dst += 3;
+
+          src0 += 6;
+          src1 += 6;
+          src2 += 6;
+          src3 += 6;
+        }
+      break;
+
+    case 4:
+      for (x = 0; x < n_pixels; x++)
+        {
+          if (premultiply)
+            {
+              const guint a = src0[3] + src1[3] + src2[3] + src3[3];
+
+              switch (a)
+                {
+                case 0:    /* all transparent */
+                  dst[0] = dst[1] = dst[2] = dst[3] = 0;
+                  break;
+
+                case 1020: /* all opaque */
+                  dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
+                  dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
+                  dst[2] = (src0[2] + src1[2] + src2[2] + src3[2] + 2) >> 2;
+                  dst[3] = 255;
+                  break;
+
+                default:
+                  {
+                    const guint a0 = src0[3] + 1;
+                    const guint a1 = src1[3] + 1;
+                    const guint a2 = src2[3] + 1;
+                    const guint a3 = src3[3] + 1;
+
+                    dst[0] = (src0[0] * a0 +
+                              src1[0] * a1 +
+                              src2[0] * a2 +
+                              src3[0] * a3) >> 10;
+                    dst[1] = (src0[1] * a0 +
+                              src1[1] * a1 +
+                              src2[1] * a2 +
+                              src3[1] * a3) >> 10;
+                    dst[2] = (src0[2] * a0 +
+                              src1[2] * a1 +
+                              src2[2] * a2 +
+                              src3[2] * a3) >> 10;
+                    dst[3] = (a + 2) >> 2;
+                  }
+                  break;
+                }
+            }
+          else
+            {
+              dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
+              dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
+              dst[2] = (src0[2] + src1[2] + src2[2] + src3[2] + 2) >> 2;
+              dst[3] = (src0[3] + src1[3] + src2[3] + src3[3] + 2) >> 2;
+            }
+
+          dst += 4;
+
+          src0 += 8;
+          src1 += 8;
+          src2 += 8;
+          src3 += 8;
+        }
+      break;
+    }
+}
+
+#ifdef TILE_PYRAMID_SSE2
+
+/*  plain 2x2 average of 16 source bytes per row into 8 destination
+ *  bytes, for 1, 2 and 4 bytes per pixel
+ */
+static inline __m128i
+tile_pyramid_average_sse2 (const guchar *src0,
+                           const guchar *src1,
+                           gint          bpp)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i r0   = _mm_loadu_si128 ((const __m128i *) src0);
+  const __m128i r1   = _mm_loadu_si128 ((const __m128i *) src1);
+  __m128i       lo;
+  __m128i       hi;
+  __m128i       sum;
+
+  /*  vertical sums of the first and second 8 bytes  */
+  lo = _mm_add_epi16 (_mm_unpacklo_epi8 (r0, zero),
+                      _mm_unpacklo_epi8 (r1, zero));
+  hi = _mm_add_epi16 (_mm_unpackhi_epi8 (r0, zero),
+                      _mm_unpackhi_epi8 (r1, zero));
+
+  /*  add up horizontal neighbours  */
+  switch (bpp)
+    {
+    case 1:
+      {
+        const __m128i ones = _mm_set1_epi16 (1);
+
+        sum = _mm_packs_epi32 (_mm_madd_epi16 (lo, ones),
+                               _mm_madd_epi16 (hi, ones));
+      }
+      break;
+
+    case 2:
+      {
+        const __m128 lo_ps = _mm_castsi128_ps (lo);
+        const __m128 hi_ps = _mm_castsi128_ps (hi);
+
+        sum = _mm_add_epi16 (_mm_castps_si128 (_mm_shuffle_ps (lo_ps, hi_ps,
+                                                               _MM_SHUFFLE (2, 0, 2, 0))),
+                             _mm_castps_si128 (_mm_shuffle_ps (lo_ps, hi_ps,
+                                                               _MM_SHUFFLE (3, 1, 3, 1))));
+      }
+      break;
+
+    default:
+      sum = _mm_add_epi16 (_mm_unpacklo_epi64 (lo, hi),
+                           _mm_unpackhi_epi64 (lo, hi));
+      break;
+    }
+
+  sum = _mm_srli_epi16 (_mm_add_epi16 (sum, _mm_set1_epi16 (2)), 2);
+
+  return _mm_packus_epi16 (sum, zero);
+}
+
+/*  2x2 average of one pair of RGBA columns, pre-multiplying the
+ *  alpha channel, as four 32 bit channels
+ */
+static inline __m128i
+tile_pyramid_premultiply_rgba_sse2 (const __m128i r0,
+                                    const __m128i r1)
+{
+  const __m128i one        = _mm_set1_epi16 (1);
+  const __m128i alpha_lane = _mm_set_epi32 (-1, 0, 0, 0);
+  __m128i       w0, w1;
+  __m128i       left, right;
+  __m128i       wleft, wright;
+  __m128i       plain, weighted;
+  __m128i       opaque;
+
+  /*  alpha + 1 of every pixel in all of its channels  */
+  w0 = _mm_add_epi16 (_mm_shufflehi_epi16 (_mm_shufflelo_epi16 (r0, _MM_SHUFFLE (3, 3, 3, 3)),
+                                           _MM_SHUFFLE (3, 3, 3, 3)),
+                      one);
+  w1 = _mm_add_epi16 (_mm_shufflehi_epi16 (_mm_shufflelo_epi16 (r1, _MM_SHUFFLE (3, 3, 3, 3)),
+                                           _MM_SHUFFLE (3, 3, 3, 3)),
+                      one);
+
+  /*  pair each channel with the one of the pixel below  */
+  left   = _mm_unpacklo_epi16 (r0, r1);
+  right  = _mm_unpackhi_epi16 (r0, r1);
+  wleft  = _mm_unpacklo_epi16 (w0, w1);
+  wright = _mm_unpackhi_epi16 (w0, w1);
+
+  plain    = _mm_add_epi32 (_mm_madd_epi16 (left,  one),
+                            _mm_madd_epi16 (right, one));
+  weighted = _mm_add_epi32 (_mm_madd_epi16 (left,  wleft),
+                            _mm_madd_epi16 (right, wright));
+
+  /*  the sum of the four alphas is 1020 for opaque blocks  */
+  opaque = _mm_cmpeq_epi32 (_mm_shuffle_epi32 (plain, _MM_SHUFFLE (3, 3, 3, 3)),
+                            _mm_set1_epi32 (1020));
+  opaque = _mm_or_si128 (opaque, alpha_lane);
+
+  plain    = _mm_srli_epi32 (_mm_add_epi32 (plain, _mm_set1_epi32 (2)), 2);
+  weighted = _mm_srli_epi32 (weighted, 10);
+
+  return _mm_or_si128 (_mm_and_si128    (opaque, plain),
+                       _mm_andnot_si128 (opaque, weighted));
+}
+
+/**
+ * tile_pyramid_reduce_row_sse2:
+ * @src0:        the upper source row
+ * @src1:        the lower source row
+ * @dest:        the destination row
+ * @n_pixels:    number of destination pixels
+ * @bpp:         bytes per pixel
+ * @premultiply: whether the source is not pre-multiplied yet
+ *
+ * SSE2 version of tile_pyramid_reduce_row_scalar(), with exactly the
+ * same results. Exposed for testing.
+ **/
+void
+tile_pyramid_reduce_row_sse2 (const guchar *src0,
+                              const guchar *src1,
+                              guchar       *dest,
+                              gint          n_pixels,
+                              gint          bpp,
+                              gboolean      premultiply)
+{
+  gint x = 0;
+
+  if (premultiply && bpp == 4)
+    {
+      const __m128i zero = _mm_setzero_si128 ();
+
+      for (; x + 2 <= n_pixels; x += 2)
+        {
+          const __m128i r0 = _mm_loadu_si128 ((const __m128i *) (src0 + x * 8));
+          const __m128i r1 = _mm_loadu_si128 ((const __m128i *) (src1 + x * 8));
+          __m128i       a, b;
+
+          a = tile_pyramid_premultiply_rgba_sse2 (_mm_unpacklo_epi8 (r0, zero),
+                                                  _mm_unpacklo_epi8 (r1, zero));
+          b = tile_pyramid_premultiply_rgba_sse2 (_mm_unpackhi_epi8 (r0, zero),
+                                                  _mm_unpackhi_epi8 (r1, zero));
+
+          _mm_storel_epi64 ((__m128i *) (dest + x * 4),
+                            _mm_packus_epi16 (_mm_packs_epi32 (a, b), zero));
+        }
+    }
+  else if (bpp != 3 && ! (premultiply && bpp == 2))
+    {
+      const gint step = 8 / bpp;
+
+      for (; x + step <= n_pixels; x += step)
+        {
+          _mm_storel_epi64 ((__m128i *) (dest + x * bpp),
+                            tile_pyramid_average_sse2 (src0 + x * 2 * bpp,
+                                                       src1 + x * 2 * bpp,
+                                                       bpp));
+        }
+    }
+
+  if (x < n_pixels)
+    tile_pyramid_reduce_row_scalar (src0 + x * 2 * bpp,
+                                    src1 + x * 2 * bpp,
+                                    dest + x * bpp,
+                                    n_pixels - x, bpp, premultiply);
+}
+
+#endif /* TILE_PYRAMID_SSE2 */
+
 
 /* This function make sure that levels are allocated up to the level
  * it returns. The return value may be smaller than the level that
@@ -414,158 +843,108 @@ tile_pyramid_validate_upper_tile (TileManager *tm,
       }
 }
 
-/* Average the src tile to one quarter of the destination tile.  The
- * source tile doesn't have pre-multiplied alpha, but the destination
- * tile does.
+/* Returns the row reduction kernel to use, picking the SSE2 version
+ * if the CPU supports it.
  */
-static void
-tile_pyramid_write_quarter (Tile       *dest,
-                            Tile       *src,
-                            const gint  i,
-                            const gint  j)
+static TilePyramidReduceRowFunc
+tile_pyramid_get_reduce_row_func (void)
 {
-  const guchar *src_data    = tile_data_pointer (src, 0, 0);
-  guchar       *dest_data   = tile_data_pointer (dest,
-                                                 i * TILE_WIDTH / 2,
-                                                 j * TILE_WIDTH / 2);
-  const gint    src_ewidth  = tile_ewidth  (src);
-  const gint    src_eheight = tile_eheight (src);
-  const gint    dest_ewidth = tile_ewidth  (dest);
-  const gint    bpp         = tile_bpp     (dest);
-  gint          y;
+  static TilePyramidReduceRowFunc func = NULL;
 
-  for (y = 0; y < src_eheight / 2; y++)
+  if (! func)
     {
-      const guchar *src0 = src_data;
-      const guchar *src1 = src_data + bpp;
-      const guchar *src2 = src0 + bpp * src_ewidth;
-      const guchar *src3 = src1 + bpp * src_ewidth;
-      guchar       *dst  = dest_data;
-      gint          x;
-
-      switch (bpp)
-        {
-        case 1:
-          for (x = 0; x < src_ewidth / 2; x++)
-            {
-              dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
-
-              dst += 1;
-
-              src0 += 2;
-              src1 += 2;
-              src2 += 2;
-              src3 += 2;
-            }
-          break;
+      func = tile_pyramid_reduce_row_scalar;
 
-        case 2:
-          for (x = 0; x < src_ewidth / 2; x++)
-            {
-              const guint a = src0[1] + src1[1] + src2[1] + src3[1];
-
-              switch (a)
-                {
-                case 0:    /* all transparent */
-                  dst[0] = dst[1] = 0;
-                  break;
-
-                case 1020: /* all opaque */
-                  dst[0] = (src0[0]  + src1[0] + src2[0] + src3[0] + 2) >> 2;
-                  dst[1] = 255;
-                  break;
-
-                default:
-                  dst[0] = ((src0[0] * (src0[1] + 1) +
-                             src1[0] * (src1[1] + 1) +
-                             src2[0] * (src2[1] + 1) +
-                             src3[0] * (src3[1] + 1)) >> 10);
-                  dst[1] = (a + 2) >> 2;
-                  break;
-                }
+#ifdef TILE_PYRAMID_SSE2
+      if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+        func = tile_pyramid_reduce_row_sse2;
+#endif
+    }
 
-              dst += 2;
+  return func;
+}
 
-              src0 += 4;
-              src1 += 4;
-              src2 += 4;
-              src3 += 4;
-            }
-          break;
+/* Average the src tile to one quarter of the destination tile.  If
+ * premultiply is TRUE, the source tile doesn't have pre-multiplied
+ * alpha, but the destination tile does. Otherwise both have.
+ */
+static void
+tile_pyramid_write_quarter_rows (Tile       *dest,
+                                 Tile       *src,
+                                 const gint  i,
+                                 const gint  j,
+                                 gboolean    premultiply)
+{
+  TilePyramidReduceRowFunc  reduce_row  = tile_pyramid_get_reduce_row_func ();
+  const guchar             *src_data    = tile_data_pointer (src, 0, 0);
+  guchar                   *dest_data   = tile_data_pointer (dest,
+                                                             i * TILE_WIDTH / 2,
+                                                             j * TILE_WIDTH / 2);
+  const gint                src_ewidth  = tile_ewidth  (src);
+  const gint                src_eheight = tile_eheight (src);
+  const gint                dest_ewidth = tile_ewidth  (dest);
+  const gint                bpp         = tile_bpp     (dest);
+  guchar                    pixel[TILE_MAX_BPP];
+  gint                      y;
+
+  if (tile_is_uniform (src, pixel))
+    {
+      /*  there is nothing to average, only the alpha channel may need
+       *  to be pre-multiplied
+       */
+      if (premultiply && (bpp == 2 || bpp == 4))
+        {
+          const guint a = pixel[bpp - 1];
+          gint        c;
 
-        case 3:
-          for (x = 0; x < src_ewidth / 2; x++)
+          if (a == 0)
             {
-              dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
-              dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
-              dst[2] = (src0[2] + src1[2] + src2[2] + src3[2] + 2) >> 2;
-
-              dst += 3;
-
-              src0 += 6;
-              src1 += 6;
-              src2 += 6;
-              src3 += 6;
+              memset (pixel, 0, bpp);
             }
-          break;
-
-        case 4:
-          for (x = 0; x < src_ewidth / 2; x++)
+          else if (a != 255)
             {
-              const guint a = src0[3] + src1[3] + src2[3] + src3[3];
-
-              switch (a)
-                {
-                case 0:    /* all transparent */
-                  dst[0] = dst[1] = dst[2] = dst[3] = 0;
-                  break;
+              for (c = 0; c < bpp - 1; c++)
+                pixel[c] = (pixel[c] * (a + 1)) >> 8;
+            }
+        }
 
-                case 1020: /* all opaque */
-                  dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
-                  dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
-                  dst[2] = (src0[2] + src1[2] + src2[2] + src3[2] + 2) >> 2;
-                  dst[3] = 255;
-                  break;
+      for (y = 0; y < src_eheight / 2; y++)
+        {
+          guchar *dst = dest_data;
+          gint    x;
 
-                default:
-                  {
-                    const guint a0 = src0[3] + 1;
-                    const guint a1 = src1[3] + 1;
-                    const guint a2 = src2[3] + 1;
-                    const guint a3 = src3[3] + 1;
+          for (x = 0; x < src_ewidth / 2; x++, dst += bpp)
+            memcpy (dst, pixel, bpp);
 
-                    dst[0] = (src0[0] * a0 +
-                              src1[0] * a1 +
-                              src2[0] * a2 +
-                              src3[0] * a3) >> 10;
-                    dst[1] = (src0[1] * a0 +
-                              src1[1] * a1 +
-                              src2[1] * a2 +
-                              src3[1] * a3) >> 10;
-                    dst[2] = (src0[2] * a0 +
-                              src1[2] * a1 +
-                              src2[2] * a2 +
-                              src3[2] * a3) >> 10;
-                    dst[3] = (a + 2) >> 2;
-                  }
-                  break;
-                }
+          dest_data += dest_ewidth * bpp;
+        }
 
-              dst += 4;
+      return;
+    }
 
-              src0 += 8;
-              src1 += 8;
-              src2 += 8;
-              src3 += 8;
-            }
-          break;
-        }
+  for (y = 0; y < src_eheight / 2; y++)
+    {
+      reduce_row (src_data, src_data + bpp * src_ewidth, dest_data,
+                  src_ewidth / 2, bpp, premultiply);
 
       dest_data += dest_ewidth * bpp;
       src_data += src_ewidth * bpp * 2;
     }
 }
 
+/* Average the src tile to one quarter of the destination tile.  The
+ * source tile doesn't have pre-multiplied alpha, but the destination
+ * tile does.
+ */
+static void
+tile_pyramid_write_quarter (Tile       *dest,
+                            Tile       *src,
+                            const gint  i,
+                            const gint  j)
+{
+  tile_pyramid_write_quarter_rows (dest, src, i, j, TRUE);
+}
+
 /* Average the src tile to one quarter of the destination tile.
  * The source and destination tiles have pre-multiplied alpha.
  */
@@ -575,91 +954,5 @@ tile_pyramid_write_upper_quarter (Tile       *dest,
                                   const gint  i,
                                   const gint  j)
 {
-  const guchar *src_data    = tile_data_pointer (src, 0, 0);
-  guchar       *dest_data   = tile_data_pointer (dest,
-                                                 i * TILE_WIDTH / 2,
-                                                 j * TILE_WIDTH / 2);
-  const gint    src_ewidth  = tile_ewidth  (src);
-  const gint    src_eheight = tile_eheight (src);
-  const gint    dest_ewidth = tile_ewidth  (dest);
-  const gint    bpp         = tile_bpp     (dest);
-  gint          y;
-
-  for (y = 0; y < src_eheight / 2; y++)
-    {
-      const guchar *src0 = src_data;
-      const guchar *src1 = src_data + bpp;
-      const guchar *src2 = src0 + bpp * src_ewidth;
-      const guchar *src3 = src1 + bpp * src_ewidth;
-      guchar       *dst  = dest_data;
-      gint          x;
-
-      switch (bpp)
-        {
-        case 1:
-          for (x = 0; x < src_ewidth / 2; x++)
-            {
-              dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
-
-              dst += 1;
-
-              src0 += 2;
-              src1 += 2;
-              src2 += 2;
-              src3 += 2;
-            }
-          break;
-
-        case 2:
-          for (x = 0; x < src_ewidth / 2; x++)
-            {
-              dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
-              dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
-
-              dst += 2;
-
-              src0 += 4;
-              src1 += 4;
-              src2 += 4;
-              src3 += 4;
-            }
-          break;
-
-        case 3:
-          for (x = 0; x < src_ewidth / 2; x++)
-            {
-              dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
-              dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
-              dst[2] = (src0[2] + src1[2] + src2[2] + src3[2] + 2) >> 2;
-
-              dst += 3;
-
-              src0 += 6;
-              src1 += 6;
-              src2 += 6;
-              src3 += 6;
-            }
-          break;
-
-        case 4:
-          for (x = 0; x < src_ewidth / 2; x++)
-            {
-              dst[0] = (src0[0] + src1[0] + src2[0] + src3[0] + 2) >> 2;
-              dst[1] = (src0[1] + src1[1] + src2[1] + src3[1] + 2) >> 2;
-              dst[2] = (src0[2] + src1[2] + src2[2] + src3[2] + 2) >> 2;
-              dst[3] = (src0[3] + src1[3] + src2[3] + src3[3] + 2) >> 2;
-
-              dst += 4;
-
-              src0 += 8;
-              src1 += 8;
-              src2 += 8;
-              src3 += 8;
-            }
-          break;
-        }
-
-      dest_data += dest_ewidth * bpp;
-      src_data += src_ewidth * bpp * 2;
-    }
+  tile_pyramid_write_quarter_rows (dest, src, i, j, FALSE);
 }
@@ -19,6 +19,19 @@
 #define __TILE_PYRAMID_H__
 
 
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define TILE_PYRAMID_SSE2 1
+#endif
+
+
+typedef void (* TilePyramidReduceRowFunc) (const guchar *src0,
+                                           const guchar *src1,
+                                           guchar       *dest,
+                                           gint          n_pixels,
+                                           gint          bpp,
+                                           gboolean      premultiply);
+
+
 /* Creates a new tile pyramid with the specified size for the
  *  toplevel. The toplevel size is used to compute the number of
  *  levels and their size. Each level is 1/2 the width and height of
@@ -31,6 +44,7 @@
 TilePyramid * tile_pyramid_new               (gint               bytes,
                                               gint               width,
                                               gint               height);
+TilePyramid * tile_pyramid_new_for_tiles     (TileManager       *tiles);
 void          tile_pyramid_destroy           (TilePyramid       *pyramid);
 
 gint          tile_pyramid_get_level         (gint               width,
@@ -46,6 +60,11 @@ void          tile_pyramid_invalidate_area   (TilePyramid       *pyramid,
                                               gint               y,
                                               gint               width,
                                               gint               height);
+void          tile_pyramid_validate_area     (TilePyramid       *pyramid,
+                                              gint               x,
+                                              gint               y,
+                                              gint               width,
+                                              gint               height);
 
 void          tile_pyramid_set_validate_proc (TilePyramid       *pyramid,
                                               TileValidateProc   proc,
@@ -58,4 +77,22 @@ gint          tile_pyramid_get_bpp           (const TilePyramid *pyramid);
 gint64        tile_pyramid_get_memsize       (const TilePyramid *pyramid);
 
 
+/*  row kernels, exposed for testing  */
+
+void          tile_pyramid_reduce_row_scalar (const guchar      *src0,
+                                              const guchar      *src1,
+                                              guchar            *dest,
+                                              gint               n_pixels,
+                                              gint               bpp,
+                                              gboolean           premultiply);
+#ifdef TILE_PYRAMID_SSE2
+void          tile_pyramid_reduce_row_sse2   (const guchar      *src0,
+                                              const guchar      *src1,
+                                              guchar            *dest,
+                                              gint               n_pixels,
+                                              gint               bpp,
+                                              gboolean           premultiply);
+#endif
+
+
 #endif /* __TILE_PYRAMID_H__ */
@@ -17,14 +17,24 @@
 
 #include "config.h"
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  /* need fallocate() and FALLOC_FL_PUNCH_HOLE */
+#endif
+
 #include <errno.h>
 #include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
 
+#ifdef HAVE_PWRITEV
+#include <sys/uio.h>
+#endif
+
 #include <gegl.h>
 #include <glib/gstdio.h>
 
@@ -53,12 +63,15 @@
 
 #include "core/gimp-utils.h"
 
+#include "gimp-log.h"
+
 #include "gimp-intl.h"
 
 typedef enum
 {
   SWAP_IN = 1,
   SWAP_OUT,
+  SWAP_EVICT,
   SWAP_DELETE
 } SwapCommand;
 
@@ -68,30 +81,105 @@ typedef gint (* SwapFunc) (gint         fd,
 
 
 
-#define MAX_OPEN_SWAP_FILES  16
+#define MAX_OPEN_SWAP_FILES  TILE_SWAP_MAX_FILES
+
+/*  Tiles are striped over one swap file per folder in swap-path. The
+ *  top bits of a tile's swap_offset hold the index of its swap file,
+ *  the rest is the position within that file. With a single swap file,
+ *  the two are the same.
+ */
+#define SWAP_FILE_SHIFT      56
+#define SWAP_OFFSET(i,pos)   (((gint64) (i) << SWAP_FILE_SHIFT) | (pos))
+#define SWAP_OFFSET_FILE(o)  ((gint) ((o) >> SWAP_FILE_SHIFT))
+#define SWAP_OFFSET_POS(o)   ((o) & ((G_GINT64_CONSTANT (1) << SWAP_FILE_SHIFT) - 1))
+
+/*  Once SWAP_COMPACT_BYTES have been freed in a swap file, the free
+ *  ranges of it which are at least SWAP_PUNCH_MIN bytes large are given
+ *  back to the file system by punching holes into the file.
+ */
+#if defined (HAVE_FALLOCATE) && defined (FALLOC_FL_PUNCH_HOLE)
+#define TILE_SWAP_PUNCH_HOLES 1
+#endif
+
+#define SWAP_COMPACT_BYTES   (256 * TILE_WIDTH * TILE_HEIGHT * 4)
+#define SWAP_PUNCH_MIN       (16 * TILE_WIDTH * TILE_HEIGHT * 4)
+#define SWAP_PAGE_SIZE       4096
+
+/*  With multi processor support, tiles are written to the swap file by
+ *  a background writer thread, which collects queued tiles into batches
+ *  and writes runs of adjacent tiles with a single vectored write.
+ */
+#if defined (ENABLE_MP) && defined (HAVE_PWRITE)
+#define TILE_SWAP_ASYNC 1
+#endif
+
+/*  With deduplication, the swap slots of tiles are content-addressed:
+ *  a tile whose data is already in the swap file just refers to the
+ *  slot that holds it. Slots are identified by the SHA-1 digest of the
+ *  tile's size and data, and are reference counted. A shared slot is
+ *  never overwritten, a tile that is written to again gets a new one.
+ */
+#define SWAP_DIGEST_LEN       20
+
+#define SWAP_WRITE_MAX_BATCH  64
+#define SWAP_WRITE_MAX_QUEUED (64 * TILE_WIDTH * TILE_HEIGHT * 4 * 4)
 
 
 typedef struct _SwapFile     SwapFile;
 typedef struct _SwapFileGap  SwapFileGap;
+typedef struct _SwapWrite    SwapWrite;
+typedef struct _SwapSlot     SwapSlot;
 
 struct _SwapFile
 {
   gchar   *filename;
+  gint     index;          /* the index in swap_files                    */
   gint     fd;
   GList   *gaps;
   gint64   swap_file_end;
   gint64   cur_position;
+  gint64   allocated;      /* how much of the file is preallocated       */
+  gint64   freed;          /* bytes freed since the last compaction      */
+#ifdef TILE_SWAP_ASYNC
+  GQueue   queue;          /* the writes waiting for this file's writer  */
+  GThread *writer;
+#endif
 };
 
 struct _SwapFileGap
 {
-  gint64 start;
-  gint64 end;
+  gint64   start;
+  gint64   end;
+  gboolean punched;        /* the gap is a hole in the file              */
+};
+
+struct _SwapWrite
+{
+  gint64    offset;     /* the write's offset in the swap file, and the
+                         * key in the table of pending writes
+                         */
+  guchar   *data;       /* owned by the write, freed when it's done */
+  gint      size;
+  gboolean  in_flight;  /* the writer thread is working on it */
+  gboolean  cancelled;  /* the tile was deleted or rewritten meanwhile */
+};
+
+
+struct _SwapSlot
+{
+  gint64    offset;     /* the slot's swap offset, the key in swap_slots */
+  guint8    digest[SWAP_DIGEST_LEN];
+  gint      size;
+  gint      ref_count;  /* the number of tiles stored in the slot */
 };
 
 
 static void          tile_swap_command        (Tile        *tile,
                                                gint         command);
+static SwapFile    * tile_swap_file_new       (const gchar *dirname,
+                                               gint         index,
+                                               gint         n_files);
+static void          tile_swap_file_free      (SwapFile    *swap_file);
 static void          tile_swap_default_in     (SwapFile    *swap_file,
                                                Tile        *tile);
 static void          tile_swap_default_out    (SwapFile    *swap_file,
@@ -99,24 +187,85 @@ static void          tile_swap_default_out    (SwapFile    *swap_file,
 static void          tile_swap_default_delete (SwapFile    *swap_file,
                                                Tile        *tile);
 
+#ifdef TILE_SWAP_ASYNC
+static void          tile_swap_queue_out      (SwapFile    *swap_file,
+                                               Tile        *tile,
+                                               gboolean     evict);
+static gboolean      tile_swap_pending_in     (Tile        *tile);
+static void          tile_swap_pending_cancel (SwapFile    *swap_file,
+                                               gint64       offset);
+static gpointer      tile_swap_writer_thread  (gpointer     data);
+#endif
+
 static gint64        tile_swap_find_offset    (SwapFile    *swap_file,
                                                gint64       bytes);
 static void          tile_swap_open           (SwapFile    *swap_file);
 static void          tile_swap_resize         (SwapFile    *swap_file,
                                                gint64       new_size);
+static void          tile_swap_compact        (SwapFile    *swap_file);
+static void          tile_swap_digest         (Tile        *tile,
+                                               guint8      *digest);
+static void          tile_swap_slot_new       (gint64       offset,
+                                               const guint8 *digest,
+                                               gint         size);
+static void          tile_swap_slot_free      (SwapSlot    *slot);
+static void          tile_swap_slot_destroy   (SwapSlot    *slot);
+static guint         tile_swap_digest_hash    (gconstpointer key);
+static gboolean      tile_swap_digest_equal   (gconstpointer a,
+                                               gconstpointer b);
 static SwapFileGap * tile_swap_gap_new        (gint64       start,
                                                gint64       end);
 static void          tile_swap_gap_destroy    (SwapFileGap *gap);
 
 
-static SwapFile     * gimp_swap_file   = NULL;
+static SwapFile     * swap_files[MAX_OPEN_SWAP_FILES];
+static gint           n_swap_files     = 0;
+static gint           next_swap_file   = 0;
 
 static const gint64   swap_file_grow   = 1024 * TILE_WIDTH * TILE_HEIGHT * 4;
 
+#ifdef ENABLE_MP
+
+/*  the tile cache shards may swap out tiles concurrently  */
+static GMutex         swap_mutex;
+
+#define SWAP_LOCK     g_mutex_lock (&swap_mutex)
+#define SWAP_UNLOCK   g_mutex_unlock (&swap_mutex)
+
+#ifdef TILE_SWAP_ASYNC
+
+static GCond          swap_writer_cond;  /* new writes were queued   */
+static GCond          swap_done_cond;    /* a batch has been written */
+static GHashTable    *swap_pending       = NULL;
+static gint64         swap_queued_bytes  = 0;
+static gint           swap_queued_tiles  = 0;
+static gint           swap_writer_errno  = 0;
+static gboolean       swap_writer_quit   = FALSE;
+
+#endif
+
+#else
+
+#define SWAP_LOCK     /* nothing */
+#define SWAP_UNLOCK   /* nothing */
+
+#endif
+
 static gboolean       seek_err_msg     = TRUE;
 static gboolean       read_err_msg     = TRUE;
 static gboolean       write_err_msg    = TRUE;
 
+/*  for the dashboard, protected by the swap lock  */
+static gulong         swap_n_ins       = 0;
+static gulong         swap_n_outs      = 0;
+
+/*  the content-addressed swap slots, protected by the swap lock  */
+static gboolean       swap_dedup        = FALSE;
+static GHashTable   * swap_slots        = NULL;  /* by offset */
+static GHashTable   * swap_slot_digests = NULL;  /* by digest */
+static guint64        swap_dedup_saved  = 0;
+static gulong         swap_dedup_shared = 0;
+
 #ifdef TILE_PROFILING
 static gulong         tile_total_seek = 0;
 
@@ -191,40 +340,74 @@ tile_swap_print_gaps (SwapFile *swap_file)
 }
 #endif
 
+/**
+ * tile_swap_init:
+ * @path: a search path style list of swap folders
+ *
+ * Sets up one swap file in each folder of @path. Tiles are striped
+ * over the swap files, so that swapping can use several disks at once.
+ **/
 void
 tile_swap_init (const gchar *path)
 {
-  gchar *basename;
-  gchar *dirname;
+  gchar *expanded;
+  GList *dirs;
+  GList *list;
+  gint   n_files;
 
-  g_return_if_fail (gimp_swap_file == NULL);
+  g_return_if_fail (n_swap_files == 0);
   g_return_if_fail (path != NULL);
 
-  dirname  = gimp_config_path_expand (path, TRUE, NULL);
-  basename = g_strdup_printf ("gimpswap.%lu", (unsigned long) gimp_get_pid ());
+  expanded = gimp_config_path_expand (path, TRUE, NULL);
+  dirs     = gimp_path_parse (expanded, MAX_OPEN_SWAP_FILES, FALSE, NULL);
+  n_files  = g_list_length (dirs);
+
+  for (list = dirs; list; list = g_list_next (list))
+    {
+      /*  create the swap directory if it doesn't exist */
+      if (! g_file_test (list->data, G_FILE_TEST_EXISTS))
+        g_mkdir_with_parents (list->data,
+                              S_IRUSR | S_IXUSR | S_IWUSR |
+                              S_IRGRP | S_IXGRP |
+                              S_IROTH | S_IXOTH);
+
+      swap_files[n_swap_files] = tile_swap_file_new (list->data,
+                                                     n_swap_files, n_files);
+      n_swap_files++;
+    }
 
-  /*  create the swap directory if it doesn't exist */
-  if (! g_file_test (dirname, G_FILE_TEST_EXISTS))
-    g_mkdir_with_parents (dirname,
-                          S_IRUSR | S_IXUSR | S_IWUSR |
-                          S_IRGRP | S_IXGRP |
-                          S_IROTH | S_IXOTH);
+  gimp_path_free (dirs);
+  g_free (expanded);
 
-  gimp_swap_file = g_slice_new (SwapFile);
+  g_return_if_fail (n_swap_files > 0);
 
-  gimp_swap_file->filename      = g_build_filename (dirname, basename, NULL);
-  gimp_swap_file->gaps          = NULL;
-  gimp_swap_file->swap_file_end = 0;
-  gimp_swap_file->cur_position  = 0;
-  gimp_swap_file->fd            = -1;
+  next_swap_file = 0;
 
-  g_free (basename);
-  g_free (dirname);
+  swap_slots        = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                            NULL,
+                                            (GDestroyNotify) tile_swap_slot_destroy);
+  swap_slot_digests = g_hash_table_new (tile_swap_digest_hash,
+                                        tile_swap_digest_equal);
+
+#ifdef TILE_SWAP_ASYNC
+  swap_pending     = g_hash_table_new (g_int64_hash, g_int64_equal);
+  swap_writer_quit = FALSE;
+
+  {
+    gint i;
+
+    for (i = 0; i < n_swap_files; i++)
+      swap_files[i]->writer = g_thread_new ("swap-writer",
+                                            tile_swap_writer_thread,
+                                            swap_files[i]);
+  }
+#endif
 }
 
 void
 tile_swap_exit (void)
 {
+  gint i;
 
 #ifdef TILE_PROFILING
   extern int tile_exist_peak;
@@ -257,55 +440,65 @@ tile_swap_exit (void)
   if (tile_global_refcount () != 0)
     g_warning ("tile ref count balance: %d\n", tile_global_refcount ());
 
-  g_return_if_fail (gimp_swap_file != NULL);
+  g_return_if_fail (n_swap_files > 0);
 
-#ifdef GIMP_UNSTABLE
-  if (gimp_swap_file->swap_file_end != 0)
+#ifdef TILE_SWAP_ASYNC
+  /*  the writers drain their queues before they quit  */
+  SWAP_LOCK;
+  swap_writer_quit = TRUE;
+  g_cond_broadcast (&swap_writer_cond);
+  SWAP_UNLOCK;
+
+  for (i = 0; i < n_swap_files; i++)
     {
-      g_warning ("swap file not empty: \"%s\"\n",
-                 gimp_filename_to_utf8 (gimp_swap_file->filename));
-      tile_swap_print_gaps (gimp_swap_file);
+      g_thread_join (swap_files[i]->writer);
+      swap_files[i]->writer = NULL;
     }
+
+  g_hash_table_unref (swap_pending);
+  swap_pending = NULL;
 #endif
 
-#ifdef G_OS_WIN32
-  /* should close before unlink */
-  if (gimp_swap_file->fd > 0)
+  for (i = 0; i < n_swap_files; i++)
     {
-      close (gimp_swap_file->fd);
-      gimp_swap_file->fd = -1;
+      tile_swap_file_free (swap_files[i]);
+      swap_files[i] = NULL;
     }
-#endif
-
-  g_unlink (gimp_swap_file->filename);
 
-  g_free (gimp_swap_file->filename);
-  g_slice_free (SwapFile, gimp_swap_file);
+  n_swap_files = 0;
 
-  gimp_swap_file = NULL;
+  g_hash_table_unref (swap_slots);
+  g_hash_table_unref (swap_slot_digests);
+  swap_slots        = NULL;
+  swap_slot_digests = NULL;
 }
 
-/* check if we can open a swap file */
+/* check if we can open the swap files */
 gboolean
 tile_swap_test (void)
 {
-  g_return_val_if_fail (gimp_swap_file != NULL, FALSE);
+  gint i;
 
-  /* make sure this duplicates the open() call from tile_swap_open() */
-  gimp_swap_file->fd = g_open (gimp_swap_file->filename,
-                               O_CREAT | O_RDWR | _O_BINARY | _O_TEMPORARY,
-                               S_IRUSR | S_IWUSR);
+  g_return_val_if_fail (n_swap_files > 0, FALSE);
 
-  if (gimp_swap_file->fd != -1)
+  for (i = 0; i < n_swap_files; i++)
     {
-      close (gimp_swap_file->fd);
-      gimp_swap_file->fd = -1;
-      g_unlink (gimp_swap_file->filename);
+      SwapFile *swap_file = swap_files[i];
 
-      return TRUE;
+      /* make sure this duplicates the open() call from tile_swap_open() */
+      swap_file->fd = g_open (swap_file->filename,
+                              O_CREAT | O_RDWR | _O_BINARY | _O_TEMPORARY,
+                              S_IRUSR | S_IWUSR);
+
+      if (swap_file->fd == -1)
+        return FALSE;
+
+      close (swap_file->fd);
+      swap_file->fd = -1;
+      g_unlink (swap_file->filename);
     }
 
-  return FALSE;
+  return TRUE;
 }
 
 void
@@ -326,6 +519,122 @@ tile_swap_out (Tile *tile)
   tile_swap_command (tile, SWAP_OUT);
 }
 
+/**
+ * tile_swap_evict:
+ * @tile: a tile with data
+ *
+ * Like tile_swap_out(), but the tile's data is dropped afterwards. If
+ * the swap writes asynchronously, the data is handed over to the
+ * writer instead of being copied. On success, @tile is no longer dirty
+ * and its data is %NULL.
+ **/
+void
+tile_swap_evict (Tile *tile)
+{
+  tile_swap_command (tile, SWAP_EVICT);
+
+  if (! tile->dirty && tile->data)
+    {
+      g_free (tile->data);
+      tile->data = NULL;
+    }
+}
+
+/**
+ * tile_swap_get_queue_depth:
+ *
+ * Return value: the number of tiles waiting to be written to the swap
+ *               file by the background writer.
+ **/
+gint
+tile_swap_get_queue_depth (void)
+{
+#ifdef TILE_SWAP_ASYNC
+  return g_atomic_int_get (&swap_queued_tiles);
+#else
+  return 0;
+#endif
+}
+
+/**
+ * tile_swap_get_usage:
+ * @file_size:   return location for the size of the swap files
+ * @used_size:   return location for the bytes of it holding tiles
+ * @n_swap_ins:  return location for the number of tiles read so far
+ * @n_swap_outs: return location for the number of tiles written so far
+ *
+ * Any of the return locations may be %NULL.
+ **/
+void
+tile_swap_get_usage (guint64 *file_size,
+                     guint64 *used_size,
+                     gulong  *n_swap_ins,
+                     gulong  *n_swap_outs)
+{
+  guint64  end     = 0;
+  guint64  in_gaps = 0;
+  gint     i;
+
+  SWAP_LOCK;
+
+  for (i = 0; i < n_swap_files; i++)
+    {
+      GList *list;
+
+      end += swap_files[i]->swap_file_end;
+
+      for (list = swap_files[i]->gaps; list; list = g_list_next (list))
+        {
+          SwapFileGap *gap = list->data;
+
+          in_gaps += gap->end - gap->start;
+        }
+    }
+
+  if (file_size)   *file_size   = end;
+  if (used_size)   *used_size   = end - MIN (in_gaps, end);
+  if (n_swap_ins)  *n_swap_ins  = swap_n_ins;
+  if (n_swap_outs) *n_swap_outs = swap_n_outs;
+
+  SWAP_UNLOCK;
+}
+
+/**
+ * tile_swap_set_deduplication:
+ * @enable: whether tiles with equal contents should share swap slots
+ *
+ * Slots which are already shared stay shared when this is turned off.
+ **/
+void
+tile_swap_set_deduplication (gboolean enable)
+{
+  SWAP_LOCK;
+
+  swap_dedup = enable ? TRUE : FALSE;
+
+  SWAP_UNLOCK;
+}
+
+/**
+ * tile_swap_get_dedup_stats:
+ * @saved_size: return location for the bytes saved by sharing slots
+ * @n_shared:   return location for the number of tiles which share a
+ *              slot with another tile
+ *
+ * Any of the return locations may be %NULL.
+ **/
+void
+tile_swap_get_dedup_stats (guint64 *saved_size,
+                           gulong  *n_shared)
+{
+  SWAP_LOCK;
+
+  if (saved_size) *saved_size = swap_dedup_saved;
+  if (n_shared)   *n_shared   = swap_dedup_shared;
+
+  SWAP_UNLOCK;
+}
+
 void
 tile_swap_delete (Tile *tile)
 {
@@ -336,26 +645,119 @@ static void
 tile_swap_command (Tile *tile,
                    gint  command)
 {
-  if (gimp_swap_file->fd == -1)
+  SwapFile *swap_file;
+  guint8    digest[SWAP_DIGEST_LEN];
+  gboolean  is_write    = (command == SWAP_OUT || command == SWAP_EVICT);
+  gboolean  have_digest = FALSE;
+
+  /*  hash outside of the lock, the tile's data can't change meanwhile  */
+  if (is_write && swap_dedup && tile->data)
+    {
+      tile_swap_digest (tile, digest);
+      have_digest = TRUE;
+    }
+
+  SWAP_LOCK;
+
+  /*  a shared slot must not be overwritten, and the slot of an unshared
+   *  tile is looked up by contents which are about to change, so the
+   *  tile lets go of it and is written like a new one
+   */
+  if (is_write && tile->swap_offset != -1 &&
+      g_hash_table_lookup (swap_slots, &tile->swap_offset))
+    {
+      tile_swap_default_delete (swap_files[SWAP_OFFSET_FILE (tile->swap_offset)],
+                                tile);
+    }
+
+  if (have_digest)
+    {
+      SwapSlot *slot = g_hash_table_lookup (swap_slot_digests, digest);
+
+      if (slot)
+        {
+          slot->ref_count++;
+
+          swap_dedup_saved  += slot->size;
+          swap_dedup_shared += 1;
+          swap_n_outs++;
+
+          tile->swap_offset = slot->offset;
+          tile->dirty       = FALSE;
+
+          SWAP_UNLOCK;
+          return;
+        }
+    }
+
+  /*  a tile stays in its swap file until it is deleted from it, new
+   *  tiles are dealt out to the swap files in turn
+   */
+  if (tile->swap_offset != -1)
+    {
+      swap_file = swap_files[SWAP_OFFSET_FILE (tile->swap_offset)];
+    }
+  else
     {
-      tile_swap_open (gimp_swap_file);
+      swap_file = swap_files[next_swap_file];
+
+      if (command == SWAP_OUT || command == SWAP_EVICT)
+        next_swap_file = (next_swap_file + 1) % n_swap_files;
+    }
+
+  if (swap_file->fd == -1)
+    {
+      tile_swap_open (swap_file);
+
+      if (G_UNLIKELY (swap_file->fd == -1))
+        {
+          SWAP_UNLOCK;
+          return;
+        }
+    }
 
-      if (G_UNLIKELY (gimp_swap_file->fd == -1))
-        return;
+#ifdef TILE_SWAP_ASYNC
+  if (G_UNLIKELY (swap_writer_errno))
+    {
+      if (write_err_msg)
+        g_message ("unable to write tile data to disk: %s",
+                   g_strerror (swap_writer_errno));
+      write_err_msg     = FALSE;
+      swap_writer_errno = 0;
     }
+#endif
 
   switch (command)
     {
     case SWAP_IN:
-      tile_swap_default_in (gimp_swap_file, tile);
+      tile_swap_default_in (swap_file, tile);
+      swap_n_ins++;
       break;
     case SWAP_OUT:
-      tile_swap_default_out (gimp_swap_file, tile);
+      swap_n_outs++;
+#ifdef TILE_SWAP_ASYNC
+      tile_swap_queue_out (swap_file, tile, FALSE);
+#else
+      tile_swap_default_out (swap_file, tile);
+#endif
+      break;
+    case SWAP_EVICT:
+      swap_n_outs++;
+#ifdef TILE_SWAP_ASYNC
+      tile_swap_queue_out (swap_file, tile, TRUE);
+#else
+      tile_swap_default_out (swap_file, tile);
+#endif
       break;
     case SWAP_DELETE:
-      tile_swap_default_delete (gimp_swap_file, tile);
+      tile_swap_default_delete (swap_file, tile);
       break;
     }
+
+  if (have_digest && tile->swap_offset != -1 && ! tile->dirty)
+    tile_swap_slot_new (tile->swap_offset, digest, tile->size);
+
+  SWAP_UNLOCK;
 }
 
 /* The actual swap file code. The swap file consists of tiles
@@ -373,6 +775,8 @@ tile_swap_default_in (SwapFile *swap_file,
 {
   gint   nleft;
   gint64 offset;
+  gint64 position;
+  gint64 trace_start;
 #ifdef TILE_PROFILING
   GTimeVal now;
   GTimeVal later;
@@ -396,15 +800,24 @@ tile_swap_default_in (SwapFile *swap_file,
   tile->inonce = TRUE;
 #endif
 
-  if (swap_file->cur_position != tile->swap_offset)
+#ifdef TILE_SWAP_ASYNC
+  if (tile_swap_pending_in (tile))
+    return;
+#endif
+
+  trace_start = GIMP_TRACE_START ();
+
+  position = SWAP_OFFSET_POS (tile->swap_offset);
+
+  if (swap_file->cur_position != position)
     {
-      swap_file->cur_position = tile->swap_offset;
+      swap_file->cur_position = position;
 
 #ifdef TILE_PROFILING
       tile_total_seek++;
 #endif
 
-      offset = LARGE_SEEK (swap_file->fd, tile->swap_offset, SEEK_SET);
+      offset = LARGE_SEEK (swap_file->fd, position, SEEK_SET);
       if (offset == -1)
         {
           if (seek_err_msg)
@@ -441,6 +854,8 @@ tile_swap_default_in (SwapFile *swap_file,
       nleft -= err;
     }
 
+  GIMP_TRACE_END (trace_start, "tile-swap", "swap-in", NULL);
+
 #ifdef TILE_PROFILING
   g_get_current_time (&later);
   tile_total_swapwait_usec += later.tv_usec - now.tv_usec;
@@ -493,6 +908,7 @@ tile_swap_default_out (SwapFile *swap_file,
   gint   nleft;
   gint64 offset;
   gint64 newpos;
+  gint64 trace_start = GIMP_TRACE_START ();
 #ifdef TILE_PROFILING
   GTimeVal now;
   GTimeVal later;
@@ -511,7 +927,7 @@ tile_swap_default_out (SwapFile *swap_file,
   if (tile->swap_offset == -1)
     newpos = tile_swap_find_offset (swap_file, bytes);
   else
-    newpos = tile->swap_offset;
+    newpos = SWAP_OFFSET_POS (tile->swap_offset);
 
   if (swap_file->cur_position != newpos)
     {
@@ -552,6 +968,8 @@ tile_swap_default_out (SwapFile *swap_file,
       nleft -= err;
     }
 
+  GIMP_TRACE_END (trace_start, "tile-swap", "swap-out", NULL);
+
 #ifdef TILE_PROFILING
   g_get_current_time (&later);
   tile_total_swapwait_usec += later.tv_usec - now.tv_usec;
@@ -577,11 +995,311 @@ tile_swap_default_out (SwapFile *swap_file,
    * tile->data is freed in tile_cache_zorch_next
    */
   tile->dirty = FALSE;
-  tile->swap_offset = newpos;
+  tile->swap_offset = SWAP_OFFSET (swap_file->index, newpos);
 
   write_err_msg = seek_err_msg = TRUE;
 }
 
+#ifdef TILE_SWAP_ASYNC
+
+/*  Queues @tile's data for the writer thread. The tile's swap offset is
+ *  assigned right away, so tiles which are evicted in a row end up in
+ *  adjacent slots taken from the same gap, and the writer can write
+ *  them in one go. Must be called with the swap lock held.
+ */
+static void
+tile_swap_queue_out (SwapFile *swap_file,
+                     Tile     *tile,
+                     gboolean  evict)
+{
+  SwapWrite *write;
+  gint       bytes;
+
+#ifdef TILE_PROFILING
+  tile_total_swapout++;
+
+  if (!tile->outonce)
+    tile_unique_swapout++;
+
+  tile->outonce = TRUE;
+#endif
+
+  bytes = TILE_WIDTH * TILE_HEIGHT * tile->bpp;
+
+  /*  If there is already a valid swap_offset, use it  */
+  if (tile->swap_offset == -1)
+    tile->swap_offset = SWAP_OFFSET (swap_file->index,
+                                     tile_swap_find_offset (swap_file, bytes));
+  else
+    tile_swap_pending_cancel (swap_file, tile->swap_offset);
+
+  /*  don't let the queue grow without bounds  */
+  while (swap_queued_bytes > SWAP_WRITE_MAX_QUEUED)
+    g_cond_wait (&swap_done_cond, &swap_mutex);
+
+  write = g_slice_new (SwapWrite);
+
+  write->offset    = tile->swap_offset;
+  write->size      = tile->size;
+  write->in_flight = FALSE;
+  write->cancelled = FALSE;
+
+  if (evict)
+    {
+      write->data = tile->data;
+      tile->data  = NULL;
+    }
+  else
+    {
+      write->data = g_memdup (tile->data, tile->size);
+    }
+
+  g_hash_table_insert (swap_pending, &write->offset, write);
+  g_queue_push_tail (&swap_file->queue, write);
+
+  swap_queued_bytes += write->size;
+  g_atomic_int_inc (&swap_queued_tiles);
+
+  tile->dirty = FALSE;
+
+  /*  all writers wait on the same condition  */
+  g_cond_broadcast (&swap_writer_cond);
+}
+
+/*  Serves a swap-in of @tile from a write that hasn't hit the disk yet.
+ *  Must be called with the swap lock held.
+ */
+static gboolean
+tile_swap_pending_in (Tile *tile)
+{
+  SwapWrite *write = g_hash_table_lookup (swap_pending, &tile->swap_offset);
+
+  if (! write)
+    return FALSE;
+
+  tile_alloc (tile);
+  memcpy (tile->data, write->data, MIN (write->size, tile->size));
+
+  return TRUE;
+}
+
+/*  Forgets about a pending write at @offset, because the swap slot was
+ *  freed or is about to be rewritten. A write which is already in
+ *  flight is still completed, but it will be written before anything
+ *  that is queued later for the same slot. Must be called with the
+ *  swap lock held.
+ */
+static void
+tile_swap_pending_cancel (SwapFile *swap_file,
+                          gint64    offset)
+{
+  SwapWrite *write = g_hash_table_lookup (swap_pending, &offset);
+
+  if (! write)
+    return;
+
+  g_hash_table_remove (swap_pending, &offset);
+
+  if (write->in_flight)
+    {
+      write->cancelled = TRUE;
+    }
+  else
+    {
+      g_queue_remove (&swap_file->queue, write);
+
+      swap_queued_bytes -= write->size;
+      g_atomic_int_add (&swap_queued_tiles, -1);
+
+      g_free (write->data);
+      g_slice_free (SwapWrite, write);
+    }
+}
+
+static gint
+tile_swap_write_compare (gconstpointer a,
+                         gconstpointer b)
+{
+  const SwapWrite *write_a = *(SwapWrite * const *) a;
+  const SwapWrite *write_b = *(SwapWrite * const *) b;
+
+  if (write_a->offset < write_b->offset)
+    return -1;
+  else if (write_a->offset > write_b->offset)
+    return 1;
+
+  return 0;
+}
+
+/*  writes a run of writes with adjacent offsets, returns 0 or errno  */
+static gint
+tile_swap_write_run (gint        fd,
+                     SwapWrite **writes,
+                     gint        n_writes)
+{
+#ifdef HAVE_PWRITEV
+  struct iovec  iov[SWAP_WRITE_MAX_BATCH];
+  struct iovec *v      = iov;
+  gint64        offset = SWAP_OFFSET_POS (writes[0]->offset);
+  gint          n      = n_writes;
+  gint          i;
+
+  for (i = 0; i < n_writes; i++)
+    {
+      iov[i].iov_base = writes[i]->data;
+      iov[i].iov_len  = writes[i]->size;
+    }
+
+  while (n > 0)
+    {
+      gssize err = pwritev (fd, v, n, offset);
+
+      if (err == -1 && (errno == EAGAIN || errno == EINTR))
+        continue;
+
+      if (err <= 0)
+        return err == 0 ? EIO : errno;
+
+      offset += err;
+
+      /*  skip what has been written  */
+      while (n > 0 && err >= (gssize) v->iov_len)
+        {
+          err -= v->iov_len;
+          v++;
+          n--;
+        }
+
+      if (n > 0)
+        {
+          v->iov_base  = (guchar *) v->iov_base + err;
+          v->iov_len  -= err;
+        }
+    }
+#else
+  gint i;
+
+  for (i = 0; i < n_writes; i++)
+    {
+      gint nleft = writes[i]->size;
+
+      while (nleft > 0)
+        {
+          gssize err = pwrite (fd,
+                               writes[i]->data + writes[i]->size - nleft,
+                               nleft,
+                               SWAP_OFFSET_POS (writes[i]->offset) +
+                               writes[i]->size - nleft);
+
+          if (err == -1 && (errno == EAGAIN || errno == EINTR))
+            continue;
+
+          if (err <= 0)
+            return err == 0 ? EIO : errno;
+
+          nleft -= err;
+        }
+    }
+#endif
+
+  return 0;
+}
+
+static gpointer
+tile_swap_writer_thread (gpointer data)
+{
+  SwapFile *swap_file = data;
+
+  SWAP_LOCK;
+
+  while (TRUE)
+    {
+      SwapWrite *batch[SWAP_WRITE_MAX_BATCH];
+      SwapWrite *write;
+      gint       n_writes = 0;
+      gint       error    = 0;
+      gint       fd;
+      gint       i, j;
+      gint64     trace_start;
+
+      while (g_queue_is_empty (&swap_file->queue) && ! swap_writer_quit)
+        g_cond_wait (&swap_writer_cond, &swap_mutex);
+
+      if (g_queue_is_empty (&swap_file->queue))
+        break;
+
+      while (n_writes < SWAP_WRITE_MAX_BATCH &&
+             (write = g_queue_pop_head (&swap_file->queue)))
+        {
+          write->in_flight   = TRUE;
+          batch[n_writes++] = write;
+        }
+
+      fd = swap_file->fd;
+
+      /*  the data of in-flight writes is never touched by anybody else,
+       *  so we can write without holding the lock
+       */
+      SWAP_UNLOCK;
+
+      trace_start = GIMP_TRACE_START ();
+
+      qsort (batch, n_writes, sizeof (SwapWrite *), tile_swap_write_compare);
+
+      for (i = 0; i < n_writes; i = j)
+        {
+          gint err;
+
+          for (j = i + 1; j < n_writes; j++)
+            {
+              if (batch[j - 1]->offset + batch[j - 1]->size !=
+                  batch[j]->offset)
+                break;
+            }
+
+          err = tile_swap_write_run (fd, batch + i, j - i);
+
+          if (err)
+            error = err;
+        }
+
+      if (trace_start)
+        {
+          gchar *detail = g_strdup_printf ("%d tiles", n_writes);
+
+          gimp_trace_span ("tile-swap", "swap-out", trace_start, detail);
+          g_free (detail);
+        }
+
+      SWAP_LOCK;
+
+      if (error)
+        swap_writer_errno = error;
+
+      for (i = 0; i < n_writes; i++)
+        {
+          write = batch[i];
+
+          if (! write->cancelled)
+            g_hash_table_remove (swap_pending, &write->offset);
+
+          swap_queued_bytes -= write->size;
+          g_atomic_int_add (&swap_queued_tiles, -1);
+
+          g_free (write->data);
+          g_slice_free (SwapWrite, write);
+        }
+
+      g_cond_broadcast (&swap_done_cond);
+    }
+
+  SWAP_UNLOCK;
+
+  return NULL;
+}
+
+#endif /* TILE_SWAP_ASYNC */
+
 static void
 tile_swap_default_delete (SwapFile *swap_file,
                           Tile     *tile)
@@ -596,6 +1314,27 @@ tile_swap_default_delete (SwapFile *swap_file,
   if (tile->swap_offset == -1)
     return;
 
+  if (g_hash_table_size (swap_slots) > 0)
+    {
+      SwapSlot *slot = g_hash_table_lookup (swap_slots, &tile->swap_offset);
+
+      if (slot && slot->ref_count > 1)
+        {
+          /*  other tiles are still stored in the slot  */
+          slot->ref_count--;
+
+          swap_dedup_saved  -= slot->size;
+          swap_dedup_shared -= 1;
+
+          tile->swap_offset = -1;
+          return;
+        }
+      else if (slot)
+        {
+          tile_swap_slot_free (slot);
+        }
+    }
+
 #ifdef TILE_PROFILING
   if (tile->zorchout)
     tile_total_wasted_swapout++;
@@ -604,10 +1343,17 @@ tile_swap_default_delete (SwapFile *swap_file,
   tile->zorchout=FALSE;
 #endif
 
-  start = tile->swap_offset;
+  start = SWAP_OFFSET_POS (tile->swap_offset);
   end = start + TILE_WIDTH * TILE_HEIGHT * tile->bpp;
+
+#ifdef TILE_SWAP_ASYNC
+  tile_swap_pending_cancel (swap_file, tile->swap_offset);
+#endif
+
   tile->swap_offset = -1;
 
+  swap_file->freed += end - start;
+
   tmp = swap_file->gaps;
   while (tmp)
     {
@@ -615,7 +1361,8 @@ tile_swap_default_delete (SwapFile *swap_file,
 
       if (end == gap->start)
         {
-          gap->start = start;
+          gap->start   = start;
+          gap->punched = FALSE;
 
           if (tmp->prev)
             {
@@ -623,7 +1370,8 @@ tile_swap_default_delete (SwapFile *swap_file,
 
               if (gap->start == gap2->end)
                 {
-                  gap2->end = gap->end;
+                  gap2->end     = gap->end;
+                  gap2->punched = FALSE;
                   tile_swap_gap_destroy (gap);
                   swap_file->gaps =
                     g_list_remove_link (swap_file->gaps, tmp);
@@ -634,7 +1382,8 @@ tile_swap_default_delete (SwapFile *swap_file,
         }
       else if (start == gap->end)
         {
-          gap->end = end;
+          gap->end     = end;
+          gap->punched = FALSE;
 
           if (tmp->next)
             {
@@ -642,7 +1391,8 @@ tile_swap_default_delete (SwapFile *swap_file,
 
               if (gap->end == gap2->start)
                 {
-                  gap2->start = gap->start;
+                  gap2->start   = gap->start;
+                  gap2->punched = FALSE;
                   tile_swap_gap_destroy (gap);
                   swap_file->gaps =
                     g_list_remove_link (swap_file->gaps, tmp);
@@ -695,6 +1445,111 @@ tile_swap_default_delete (SwapFile *swap_file,
       swap_file->gaps = g_list_remove_link (swap_file->gaps, tmp);
       g_list_free (tmp);
     }
+
+  if (swap_file->freed >= SWAP_COMPACT_BYTES)
+    tile_swap_compact (swap_file);
+}
+
+/*  Gives the disk space of large gaps back to the file system, without
+ *  changing the size of the swap file, so the offsets of the tiles in
+ *  it stay valid. Gaps which are taken again simply get their blocks
+ *  back when they are written to.
+ */
+static void
+tile_swap_compact (SwapFile *swap_file)
+{
+#ifdef TILE_SWAP_PUNCH_HOLES
+  GList *list;
+
+  for (list = swap_file->gaps; list; list = g_list_next (list))
+    {
+      SwapFileGap *gap = list->data;
+      gint64       start;
+      gint64       end;
+
+      if (gap->punched || gap->end - gap->start < SWAP_PUNCH_MIN)
+        continue;
+
+      /*  only whole pages can be punched out  */
+      start = (gap->start + SWAP_PAGE_SIZE - 1) & ~((gint64) SWAP_PAGE_SIZE - 1);
+      end   = gap->end & ~((gint64) SWAP_PAGE_SIZE - 1);
+
+      if (end <= start)
+        continue;
+
+      if (fallocate (swap_file->fd,
+                     FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                     start, end - start) != 0)
+        {
+          /*  the file system doesn't support it, don't try again  */
+          if (errno == EOPNOTSUPP || errno == ENOSYS)
+            break;
+
+          continue;
+        }
+
+      gap->punched = TRUE;
+    }
+#endif
+
+  swap_file->freed = 0;
+}
+
+static SwapFile *
+tile_swap_file_new (const gchar *dirname,
+                    gint         index,
+                    gint         n_files)
+{
+  SwapFile *swap_file = g_slice_new0 (SwapFile);
+  gchar    *basename;
+
+  if (n_files == 1)
+    basename = g_strdup_printf ("gimpswap.%lu",
+                                (unsigned long) gimp_get_pid ());
+  else
+    basename = g_strdup_printf ("gimpswap.%lu.%d",
+                                (unsigned long) gimp_get_pid (), index);
+
+  swap_file->filename = g_build_filename (dirname, basename, NULL);
+  swap_file->index    = index;
+  swap_file->fd       = -1;
+
+#ifdef TILE_SWAP_ASYNC
+  g_queue_init (&swap_file->queue);
+#endif
+
+  g_free (basename);
+
+  return swap_file;
+}
+
+static void
+tile_swap_file_free (SwapFile *swap_file)
+{
+#ifdef GIMP_UNSTABLE
+  if (swap_file->swap_file_end != 0)
+    {
+      g_warning ("swap file not empty: \"%s\"\n",
+                 gimp_filename_to_utf8 (swap_file->filename));
+      tile_swap_print_gaps (swap_file);
+    }
+#endif
+
+#ifdef G_OS_WIN32
+  /* should close before unlink */
+  if (swap_file->fd > 0)
+    {
+      close (swap_file->fd);
+      swap_file->fd = -1;
+    }
+#endif
+
+  g_unlink (swap_file->filename);
+
+  g_list_free_full (swap_file->gaps, (GDestroyNotify) tile_swap_gap_destroy);
+
+  g_free (swap_file->filename);
+  g_slice_free (SwapFile, swap_file);
 }
 
 static void
@@ -726,6 +1581,26 @@ tile_swap_resize (SwapFile *swap_file,
           g_message (_("Failed to resize swap file: %s"), g_strerror (errno));
           return;
         }
+
+      swap_file->allocated = MIN (swap_file->allocated, new_size);
+    }
+  else if (new_size > swap_file->allocated)
+    {
+      /*  reserve the disk space up front, so the file doesn't end up in
+       *  many small fragments and running out of disk space is noticed
+       *  here rather than while writing tiles; a failure is not fatal
+       */
+      gint64 len = new_size - swap_file->allocated;
+      gint   err = -1;
+
+#if defined (HAVE_FALLOCATE)
+      err = fallocate (swap_file->fd, 0, swap_file->allocated, len);
+#elif defined (HAVE_POSIX_FALLOCATE)
+      err = posix_fallocate (swap_file->fd, swap_file->allocated, len);
+#endif
+
+      if (err == 0)
+        swap_file->allocated = new_size;
     }
 
   swap_file->swap_file_end = new_size;
@@ -764,7 +1639,10 @@ tile_swap_find_offset (SwapFile *swap_file,
 
   offset = swap_file->swap_file_end;
 
-  tile_swap_resize (swap_file, swap_file->swap_file_end + swap_file_grow);
+  /*  grow geometrically, so large images need only few resizes  */
+  tile_swap_resize (swap_file,
+                    swap_file->swap_file_end +
+                    MAX (swap_file_grow, swap_file->swap_file_end / 2));
 
   if ((offset + bytes) < (swap_file->swap_file_end))
     {
@@ -775,14 +1653,84 @@ tile_swap_find_offset (SwapFile *swap_file,
   return offset;
 }
 
+static void
+tile_swap_digest (Tile   *tile,
+                  guint8 *digest)
+{
+  GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  guchar     header[3];
+  gsize      len      = SWAP_DIGEST_LEN;
+
+  /*  the same bytes are different pixels in a tile of another size  */
+  header[0] = tile->ewidth;
+  header[1] = tile->eheight;
+  header[2] = tile->bpp;
+
+  g_checksum_update (checksum, header, sizeof (header));
+  g_checksum_update (checksum, tile->data, tile->size);
+  g_checksum_get_digest (checksum, digest, &len);
+
+  g_checksum_free (checksum);
+}
+
+static guint
+tile_swap_digest_hash (gconstpointer key)
+{
+  guint hash;
+
+  /*  the digest is as good a hash as any  */
+  memcpy (&hash, key, sizeof (hash));
+
+  return hash;
+}
+
+static gboolean
+tile_swap_digest_equal (gconstpointer a,
+                        gconstpointer b)
+{
+  return memcmp (a, b, SWAP_DIGEST_LEN) == 0;
+}
+
+/*  registers the slot at @offset, which has just been written  */
+static void
+tile_swap_slot_new (gint64        offset,
+                    const guint8 *digest,
+                    gint          size)
+{
+  SwapSlot *slot = g_slice_new (SwapSlot);
+
+  slot->offset    = offset;
+  slot->size      = size;
+  slot->ref_count = 1;
+  memcpy (slot->digest, digest, SWAP_DIGEST_LEN);
+
+  g_hash_table_insert (swap_slots, &slot->offset, slot);
+  g_hash_table_insert (swap_slot_digests, slot->digest, slot);
+}
+
+/*  the table by offset owns the slots  */
+static void
+tile_swap_slot_free (SwapSlot *slot)
+{
+  g_hash_table_remove (swap_slot_digests, slot->digest);
+  g_hash_table_remove (swap_slots, &slot->offset);
+}
+
+static void
+tile_swap_slot_destroy (SwapSlot *slot)
+{
+  g_slice_free (SwapSlot, slot);
+}
+
 static SwapFileGap *
 tile_swap_gap_new (gint64 start,
                    gint64 end)
 {
   SwapFileGap *gap = g_slice_new (SwapFileGap);
 
-  gap->start = start;
-  gap->end   = end;
+  gap->start   = start;
+  gap->end     = end;
+  gap->punched = FALSE;
 
   return gap;
 }
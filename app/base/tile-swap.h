@@ -19,6 +19,10 @@
 #define __TILE_SWAP_H__
 
 
+/*  the most folders of swap-path that get a swap file  */
+#define TILE_SWAP_MAX_FILES 16
+
+
 void     tile_swap_init     (const gchar *path);
 void     tile_swap_exit     (void);
 
@@ -26,7 +30,18 @@ gboolean tile_swap_test     (void);
 
 void     tile_swap_in       (Tile        *tile);
 void     tile_swap_out      (Tile        *tile);
+void     tile_swap_evict    (Tile        *tile);
 void     tile_swap_delete   (Tile        *tile);
 
+gint     tile_swap_get_queue_depth (void);
+void     tile_swap_get_usage       (guint64     *file_size,
+                                    guint64     *used_size,
+                                    gulong      *n_swap_ins,
+                                    gulong      *n_swap_outs);
+
+void     tile_swap_set_deduplication (gboolean   enable);
+void     tile_swap_get_dedup_stats   (guint64   *saved_size,
+                                      gulong    *n_shared);
+
 
 #endif /* __TILE_SWAP_H__ */
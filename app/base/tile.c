@@ -17,6 +17,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <glib-object.h>
 
 #include "base-types.h"
@@ -48,7 +50,8 @@ gint tile_exist_count         = 0;
 #endif
 
 
-static void  tile_destroy (Tile *tile);
+static void  tile_destroy      (Tile *tile);
+static void  tile_fill_uniform (Tile *tile);
 
 
 Tile *
@@ -91,8 +94,13 @@ tile_lock (Tile *tile)
 
   if (tile->data == NULL)
     {
-      /* There is no data, so the tile must be swapped out */
-      tile_swap_in (tile);
+      /* There is no data, so the tile must be uniform, compressed or
+       * swapped out
+       */
+      if (tile->uniform)
+        tile_fill_uniform (tile);
+      else if (! tile_cache_uncompress (tile))
+        tile_swap_in (tile);
     }
 
   /* Call 'tile_manager_validate' if the tile was invalid.
@@ -170,6 +178,32 @@ tile_alloc (Tile *tile)
 #endif
 }
 
+/* Expand the pixel value of a uniform tile into its data.
+ */
+static void
+tile_fill_uniform (Tile *tile)
+{
+  guchar *data;
+  gint    n_pixels;
+
+  tile_alloc (tile);
+
+  data     = tile->data;
+  n_pixels = tile->size / tile->bpp;
+
+  if (tile->bpp == 1)
+    {
+      memset (data, tile->uniform_pixel[0], n_pixels);
+    }
+  else
+    {
+      gint i;
+
+      for (i = 0; i < n_pixels; i++, data += tile->bpp)
+        memcpy (data, tile->uniform_pixel, tile->bpp);
+    }
+}
+
 static void
 tile_destroy (Tile *tile)
 {
@@ -200,8 +234,8 @@ tile_destroy (Tile *tile)
       tile->rowhint = NULL;
     }
 
-  /* must flush before deleting swap */
-  tile_cache_flush (tile);
+  /* must discard before deleting swap */
+  tile_cache_discard (tile);
 
   if (tile->swap_offset != -1)
     {
@@ -251,6 +285,25 @@ tile_is_valid (Tile *tile)
   return tile->valid;
 }
 
+gboolean
+tile_is_shared (Tile *tile)
+{
+  return tile->share_count > 1;
+}
+
+gboolean
+tile_is_uniform (Tile   *tile,
+                 guchar *pixel)
+{
+  if (! tile->uniform)
+    return FALSE;
+
+  if (pixel)
+    memcpy (pixel, tile->uniform_pixel, tile->bpp);
+
+  return TRUE;
+}
+
 void
 tile_attach (Tile *tile,
              void *tm,
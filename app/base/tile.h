@@ -22,6 +22,9 @@
 #define TILE_WIDTH   64
 #define TILE_HEIGHT  64
 
+/*  the largest number of bytes per pixel, that of float RGBA  */
+#define TILE_MAX_BPP 16
+
 
 /* Returns a newly allocated Tile with all fields initialized to "good" values.
  */
@@ -55,6 +58,19 @@ gint        tile_bpp             (Tile     *tile);
 
 gboolean    tile_is_valid        (Tile     *tile);
 
+/* Returns TRUE if more than one tile manager holds the tile, so it is
+ * copied when it is locked for writing.
+ */
+gboolean    tile_is_shared       (Tile     *tile);
+
+/* Returns TRUE if all pixels of the tile are known to have the same
+ * value, and stores that value in pixel if it is not NULL; pixel must
+ * have room for TILE_MAX_BPP bytes.  A tile stops being uniform when
+ * it is locked for writing.
+ */
+gboolean    tile_is_uniform      (Tile     *tile,
+                                  guchar   *pixel);
+
 void      * tile_data_pointer    (Tile     *tile,
                                   gint      xoff,
                                   gint      yoff);
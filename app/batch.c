@@ -21,6 +21,7 @@
 #include <stdlib.h>
 
 #include <gegl.h>
+#include <gio/gio.h>
 
 #include "libgimpbase/gimpbase.h"
 
@@ -28,7 +29,10 @@
 
 #include "base/tile-swap.h"
 
+#include "config/gimpgeglconfig.h"
+
 #include "core/gimp.h"
+#include "core/gimpcontext.h"
 #include "core/gimpparamspecs.h"
 
 #include "batch.h"
@@ -42,14 +46,61 @@
 #define BATCH_DEFAULT_EVAL_PROC   "plug-in-script-fu-eval"
 
 
+typedef struct _BatchServer BatchServer;
+typedef struct _BatchJob    BatchJob;
+
+struct _BatchServer
+{
+  Gimp          *gimp;
+  const gchar   *proc_name;
+  GimpProcedure *procedure;
+
+  GQueue         jobs;
+  gint           n_running;
+  gint           max_running;
+  gint           n_jobs;
+  gboolean       input_closed;
+};
+
+struct _BatchJob
+{
+  BatchServer   *server;
+  gint           id;
+  gchar         *cmd;
+  gint64         queued;
+  GOutputStream *reply;  /* NULL for jobs read from stdin */
+};
+
+
 static void  batch_exit_after_callback (Gimp          *gimp) G_GNUC_NORETURN;
 
-static void  batch_run_cmd             (Gimp          *gimp,
+static const gchar *
+             batch_get_interpreter     (Gimp          *gimp,
+                                        const gchar   *batch_interpreter);
+static GimpPDBStatusType
+             batch_run_cmd             (Gimp          *gimp,
+                                        GimpContext   *context,
                                         const gchar   *proc_name,
                                         GimpProcedure *procedure,
                                         GimpRunMode    run_mode,
                                         const gchar   *cmd);
 
+static void      batch_server_queue_job    (BatchServer   *server,
+                                            const gchar   *cmd,
+                                            GOutputStream *reply);
+static void      batch_server_dispatch     (BatchServer   *server);
+static gboolean  batch_server_run_job      (BatchJob      *job);
+static gboolean  batch_server_stdin_read   (GIOChannel    *channel,
+                                            GIOCondition   condition,
+                                            BatchServer   *server);
+static gboolean  batch_server_incoming     (GSocketService    *service,
+                                            GSocketConnection *connection,
+                                            GObject           *source_object,
+                                            BatchServer       *server);
+static void      batch_server_client_read  (GDataInputStream  *input,
+                                            GAsyncResult      *result,
+                                            GSocketConnection *connection);
+
 
 void
 batch_run (Gimp         *gimp,
@@ -65,19 +116,7 @@ batch_run (Gimp         *gimp,
                                     G_CALLBACK (batch_exit_after_callback),
                                     NULL);
 
-  if (! batch_interpreter)
-    {
-      batch_interpreter = g_getenv ("GIMP_BATCH_INTERPRETER");
-
-      if (! batch_interpreter)
-        {
-          batch_interpreter = BATCH_DEFAULT_EVAL_PROC;
-
-          if (gimp->be_verbose)
-            g_printerr (_("No batch interpreter specified, using the default "
-                          "'%s'.\n"), batch_interpreter);
-        }
-    }
+  batch_interpreter = batch_get_interpreter (gimp, batch_interpreter);
 
   /*  script-fu text console, hardcoded for backward compatibility  */
 
@@ -89,7 +128,7 @@ batch_run (Gimp         *gimp,
                                                             proc_name);
 
       if (procedure)
-        batch_run_cmd (gimp, proc_name, procedure,
+        batch_run_cmd (gimp, gimp_get_user_context (gimp), proc_name, procedure,
                        GIMP_RUN_NONINTERACTIVE, NULL);
       else
         g_message (_("The batch interpreter '%s' is not available. "
@@ -105,7 +144,8 @@ batch_run (Gimp         *gimp,
           gint i;
 
           for (i = 0; batch_commands[i]; i++)
-            batch_run_cmd (gimp, batch_interpreter, eval_proc,
+            batch_run_cmd (gimp, gimp_get_user_context (gimp),
+                           batch_interpreter, eval_proc,
                            GIMP_RUN_NONINTERACTIVE, batch_commands[i]);
         }
       else
@@ -118,6 +158,110 @@ batch_run (Gimp         *gimp,
   g_signal_handler_disconnect (gimp, exit_id);
 }
 
+/**
+ * batch_serve:
+ * @gimp:              a #Gimp instance
+ * @batch_interpreter: the procedure to evaluate jobs with, or %NULL
+ * @source:            "-" to read jobs from stdin, or a TCP port
+ *                     number to listen on at the loopback interface
+ *
+ * Sets up a long-lived batch server. Every line read from @source is
+ * a job that is passed to the batch interpreter. Jobs are queued and
+ * up to num-processors of them run at the same time, each with its
+ * own copy of the user context. For each job, a line with its id,
+ * status, queue and run times is printed to stdout or sent back to
+ * the client it came from.
+ *
+ * When reading from stdin, GIMP quits after the input was closed and
+ * all jobs are done.
+ **/
+void
+batch_serve (Gimp        *gimp,
+             const gchar *batch_interpreter,
+             const gchar *source)
+{
+  BatchServer   *server;
+  GimpProcedure *procedure;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+  g_return_if_fail (source != NULL);
+
+  batch_interpreter = batch_get_interpreter (gimp, batch_interpreter);
+
+  procedure = gimp_pdb_lookup_procedure (gimp->pdb, batch_interpreter);
+
+  if (! procedure)
+    {
+      g_message (_("The batch interpreter '%s' is not available. "
+                   "Batch mode disabled."), batch_interpreter);
+      return;
+    }
+
+  server = g_slice_new0 (BatchServer);
+
+  server->gimp        = gimp;
+  server->proc_name   = batch_interpreter;
+  server->procedure   = procedure;
+  server->max_running = MAX (1, GIMP_GEGL_CONFIG (gimp->config)->num_processors);
+
+  g_queue_init (&server->jobs);
+
+  if (! strcmp (source, "-"))
+    {
+      GIOChannel *channel = g_io_channel_unix_new (0);
+
+      g_io_add_watch (channel, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                      (GIOFunc) batch_server_stdin_read, server);
+      g_io_channel_unref (channel);
+    }
+  else
+    {
+      GSocketService *service = g_socket_service_new ();
+      GInetAddress   *address;
+      GSocketAddress *socket_address;
+      gchar          *end;
+      gulong          port;
+      GError         *error = NULL;
+
+      port = strtoul (source, &end, 10);
+
+      if (*end || port == 0 || port > 65535)
+        {
+          g_message (_("Invalid batch server port '%s'."), source);
+          g_object_unref (service);
+          g_slice_free (BatchServer, server);
+          return;
+        }
+
+      /*  local clients only, jobs can run arbitrary code  */
+      address        = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+      socket_address = g_inet_socket_address_new (address, port);
+
+      if (! g_socket_listener_add_address (G_SOCKET_LISTENER (service),
+                                           socket_address,
+                                           G_SOCKET_TYPE_STREAM,
+                                           G_SOCKET_PROTOCOL_TCP,
+                                           NULL, NULL, &error))
+        {
+          g_message (_("Could not start the batch server: %s"),
+                     error->message);
+          g_clear_error (&error);
+          g_object_unref (service);
+          g_slice_free (BatchServer, server);
+        }
+      else
+        {
+          g_signal_connect (service, "incoming",
+                            G_CALLBACK (batch_server_incoming),
+                            server);
+          g_socket_service_start (service);
+        }
+
+      g_object_unref (socket_address);
+      g_object_unref (address);
+    }
+}
+
 
 /*
  * The purpose of this handler is to exit GIMP cleanly when the batch
@@ -139,17 +283,40 @@ batch_exit_after_callback (Gimp *gimp)
   exit (EXIT_SUCCESS);
 }
 
-static void
+static const gchar *
+batch_get_interpreter (Gimp        *gimp,
+                       const gchar *batch_interpreter)
+{
+  if (! batch_interpreter)
+    {
+      batch_interpreter = g_getenv ("GIMP_BATCH_INTERPRETER");
+
+      if (! batch_interpreter)
+        {
+          batch_interpreter = BATCH_DEFAULT_EVAL_PROC;
+
+          if (gimp->be_verbose)
+            g_printerr (_("No batch interpreter specified, using the default "
+                          "'%s'.\n"), batch_interpreter);
+        }
+    }
+
+  return batch_interpreter;
+}
+
+static GimpPDBStatusType
 batch_run_cmd (Gimp          *gimp,
+               GimpContext   *context,
                const gchar   *proc_name,
                GimpProcedure *procedure,
                GimpRunMode    run_mode,
                const gchar   *cmd)
 {
-  GimpValueArray *args;
-  GimpValueArray *return_vals;
-  GError         *error = NULL;
-  gint            i     = 0;
+  GimpValueArray    *args;
+  GimpValueArray    *return_vals;
+  GimpPDBStatusType  status;
+  GError            *error = NULL;
+  gint               i     = 0;
 
   args = gimp_procedure_get_arguments (procedure);
 
@@ -162,12 +329,13 @@ batch_run_cmd (Gimp          *gimp,
     g_value_set_static_string (gimp_value_array_index (args, i++), cmd);
 
   return_vals =
-    gimp_pdb_execute_procedure_by_name_args (gimp->pdb,
-                                             gimp_get_user_context (gimp),
+    gimp_pdb_execute_procedure_by_name_args (gimp->pdb, context,
                                              NULL, &error,
                                              proc_name, args);
 
-  switch (g_value_get_enum (gimp_value_array_index (return_vals, 0)))
+  status = g_value_get_enum (gimp_value_array_index (return_vals, 0));
+
+  switch (status)
     {
     case GIMP_PDB_EXECUTION_ERROR:
       if (error)
@@ -204,5 +372,187 @@ batch_run_cmd (Gimp          *gimp,
   if (error)
     g_error_free (error);
 
-  return;
+  return status;
+}
+
+static void
+batch_server_queue_job (BatchServer   *server,
+                        const gchar   *cmd,
+                        GOutputStream *reply)
+{
+  BatchJob *job = g_slice_new0 (BatchJob);
+
+  job->server = server;
+  job->id     = ++server->n_jobs;
+  job->cmd    = g_strdup (cmd);
+  job->queued = g_get_monotonic_time ();
+  job->reply  = reply ? g_object_ref (reply) : NULL;
+
+  g_queue_push_tail (&server->jobs, job);
+
+  batch_server_dispatch (server);
+}
+
+static void
+batch_server_dispatch (BatchServer *server)
+{
+  /*  every job is started from its own idle source; a running job
+   *  waits for its plug-in in a nested main loop, which is where the
+   *  next jobs get started
+   */
+  while (server->n_running < server->max_running &&
+         ! g_queue_is_empty (&server->jobs))
+    {
+      server->n_running++;
+
+      g_idle_add ((GSourceFunc) batch_server_run_job,
+                  g_queue_pop_head (&server->jobs));
+    }
+
+  if (server->input_closed   &&
+      server->n_running == 0 &&
+      g_queue_is_empty (&server->jobs))
+    {
+      gimp_exit (server->gimp, TRUE);
+    }
+}
+
+static gboolean
+batch_server_run_job (BatchJob *job)
+{
+  BatchServer       *server = job->server;
+  GimpContext       *context;
+  GimpPDBStatusType  status;
+  gint64             started;
+  gint64             finished;
+  gchar             *name;
+  gchar             *report;
+
+  name = g_strdup_printf ("Batch job %d", job->id);
+  context = gimp_context_new (server->gimp, name,
+                              gimp_get_user_context (server->gimp));
+  g_free (name);
+
+  started = g_get_monotonic_time ();
+
+  status = batch_run_cmd (server->gimp, context,
+                          server->proc_name, server->procedure,
+                          GIMP_RUN_NONINTERACTIVE, job->cmd);
+
+  finished = g_get_monotonic_time ();
+
+  g_object_unref (context);
+
+  report = g_strdup_printf ("job %d: %s, queued %.3f s, ran %.3f s\n",
+                            job->id,
+                            status == GIMP_PDB_SUCCESS ? "success" : "error",
+                            (started  - job->queued) / (gdouble) G_USEC_PER_SEC,
+                            (finished - started)     / (gdouble) G_USEC_PER_SEC);
+
+  if (job->reply)
+    {
+      g_output_stream_write_all (job->reply, report, strlen (report),
+                                 NULL, NULL, NULL);
+      g_object_unref (job->reply);
+    }
+  else
+    {
+      g_print ("%s", report);
+    }
+
+  g_free (report);
+  g_free (job->cmd);
+  g_slice_free (BatchJob, job);
+
+  server->n_running--;
+
+  batch_server_dispatch (server);
+
+  return FALSE;
+}
+
+static gboolean
+batch_server_stdin_read (GIOChannel   *channel,
+                         GIOCondition  condition,
+                         BatchServer  *server)
+{
+  gchar     *line;
+  gsize      terminator;
+  GIOStatus  status;
+
+  status = g_io_channel_read_line (channel, &line, NULL, &terminator, NULL);
+
+  if (status == G_IO_STATUS_NORMAL)
+    {
+      line[terminator] = '\0';
+
+      if (*line)
+        batch_server_queue_job (server, line, NULL);
+
+      g_free (line);
+
+      return TRUE;
+    }
+
+  if (status == G_IO_STATUS_AGAIN)
+    return TRUE;
+
+  server->input_closed = TRUE;
+
+  batch_server_dispatch (server);
+
+  return FALSE;
+}
+
+static gboolean
+batch_server_incoming (GSocketService    *service,
+                       GSocketConnection *connection,
+                       GObject           *source_object,
+                       BatchServer       *server)
+{
+  GDataInputStream *input;
+
+  input = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+
+  g_object_set_data (G_OBJECT (connection), "batch-server", server);
+
+  g_data_input_stream_read_line_async (input, G_PRIORITY_DEFAULT, NULL,
+                                       (GAsyncReadyCallback) batch_server_client_read,
+                                       g_object_ref (connection));
+
+  return TRUE;
+}
+
+static void
+batch_server_client_read (GDataInputStream  *input,
+                          GAsyncResult      *result,
+                          GSocketConnection *connection)
+{
+  BatchServer *server = g_object_get_data (G_OBJECT (connection),
+                                           "batch-server");
+  gchar       *line;
+
+  line = g_data_input_stream_read_line_finish (input, result, NULL, NULL);
+
+  if (! line)
+    {
+      /*  the client is gone, queued jobs keep their own reference
+       *  on the output stream
+       */
+      g_object_unref (input);
+      g_object_unref (connection);
+      return;
+    }
+
+  g_strchomp (line);
+
+  if (*line)
+    batch_server_queue_job (server, line,
+                            g_io_stream_get_output_stream (G_IO_STREAM (connection)));
+
+  g_free (line);
+
+  g_data_input_stream_read_line_async (input, G_PRIORITY_DEFAULT, NULL,
+                                       (GAsyncReadyCallback) batch_server_client_read,
+                                       connection);
 }
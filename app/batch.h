@@ -23,9 +23,12 @@
 #endif
 
 
-void   batch_run (Gimp         *gimp,
-                  const gchar  *batch_interpreter,
-                  const gchar **batch_commands);
+void   batch_run   (Gimp         *gimp,
+                    const gchar  *batch_interpreter,
+                    const gchar **batch_commands);
+void   batch_serve (Gimp         *gimp,
+                    const gchar  *batch_interpreter,
+                    const gchar  *source);
 
 
 #endif /* __BATCH_H__ */
@@ -92,8 +92,11 @@ enum
   PROP_DEFAULT_GRID,
   PROP_UNDO_LEVELS,
   PROP_UNDO_SIZE,
+  PROP_UNDO_SWAP_SIZE,
   PROP_UNDO_PREVIEW_SIZE,
   PROP_PLUG_IN_HISTORY_SIZE,
+  PROP_PLUG_IN_RESIDENT_TIMEOUT,
+  PROP_PLUG_IN_RESIDENT_MEMORY,
   PROP_PLUGINRC_PATH,
   PROP_LAYER_PREVIEWS,
   PROP_LAYER_PREVIEW_SIZE,
@@ -103,6 +106,9 @@ enum
   PROP_COLOR_PROFILE_POLICY,
   PROP_SAVE_DOCUMENT_HISTORY,
   PROP_QUICK_MASK_COLOR,
+  PROP_XCF_COMPRESSION,
+  PROP_XCF_LAZY_LOADING,
+  PROP_XCF_INCREMENTAL_SAVE,
 
   /* ignored, only for backward compatibility: */
   PROP_INSTALL_COLORMAP,
@@ -390,6 +396,10 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                     0, GIMP_MAX_MEMSIZE, undo_size,
                                     GIMP_PARAM_STATIC_STRINGS |
                                     GIMP_CONFIG_PARAM_CONFIRM);
+  GIMP_CONFIG_INSTALL_PROP_MEMSIZE (object_class, PROP_UNDO_SWAP_SIZE,
+                                    "undo-swap-size", UNDO_SWAP_SIZE_BLURB,
+                                    0, GIMP_MAX_MEMSIZE, undo_size * 4,
+                                    GIMP_PARAM_STATIC_STRINGS);
   GIMP_CONFIG_INSTALL_PROP_ENUM (object_class, PROP_UNDO_PREVIEW_SIZE,
                                  "undo-preview-size", UNDO_PREVIEW_SIZE_BLURB,
                                  GIMP_TYPE_VIEW_SIZE,
@@ -402,6 +412,16 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                 0, 256, 10,
                                 GIMP_PARAM_STATIC_STRINGS |
                                 GIMP_CONFIG_PARAM_RESTART);
+  GIMP_CONFIG_INSTALL_PROP_INT (object_class, PROP_PLUG_IN_RESIDENT_TIMEOUT,
+                                "plug-in-resident-timeout",
+                                PLUG_IN_RESIDENT_TIMEOUT_BLURB,
+                                0, 3600, 60,
+                                GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_MEMSIZE (object_class, PROP_PLUG_IN_RESIDENT_MEMORY,
+                                    "plug-in-resident-memory",
+                                    PLUG_IN_RESIDENT_MEMORY_BLURB,
+                                    0, GIMP_MAX_MEMSIZE, 1 << 28,
+                                    GIMP_PARAM_STATIC_STRINGS);
   GIMP_CONFIG_INSTALL_PROP_PATH (object_class,
                                  PROP_PLUGINRC_PATH,
                                  "pluginrc-path", PLUGINRC_PATH_BLURB,
@@ -448,6 +468,19 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                 "quick-mask-color", QUICK_MASK_COLOR_BLURB,
                                 TRUE, &red,
                                 GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_COMPRESSION,
+                                    "xcf-compression", XCF_COMPRESSION_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_LAZY_LOADING,
+                                    "xcf-lazy-loading", XCF_LAZY_LOADING_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_INCREMENTAL_SAVE,
+                                    "xcf-incremental-save",
+                                    XCF_INCREMENTAL_SAVE_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
 
   /*  only for backward compatibility:  */
   GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_INSTALL_COLORMAP,
@@ -682,12 +715,21 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_PLUG_IN_HISTORY_SIZE:
       core_config->plug_in_history_size = g_value_get_int (value);
       break;
+    case PROP_PLUG_IN_RESIDENT_TIMEOUT:
+      core_config->plug_in_resident_timeout = g_value_get_int (value);
+      break;
+    case PROP_PLUG_IN_RESIDENT_MEMORY:
+      core_config->plug_in_resident_memory = g_value_get_uint64 (value);
+      break;
     case PROP_UNDO_LEVELS:
       core_config->levels_of_undo = g_value_get_int (value);
       break;
     case PROP_UNDO_SIZE:
       core_config->undo_size = g_value_get_uint64 (value);
       break;
+    case PROP_UNDO_SWAP_SIZE:
+      core_config->undo_swap_size = g_value_get_uint64 (value);
+      break;
     case PROP_UNDO_PREVIEW_SIZE:
       core_config->undo_preview_size = g_value_get_enum (value);
       break;
@@ -721,6 +763,15 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_QUICK_MASK_COLOR:
       gimp_value_get_rgb (value, &core_config->quick_mask_color);
       break;
+    case PROP_XCF_COMPRESSION:
+      core_config->xcf_compression = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_LAZY_LOADING:
+      core_config->xcf_lazy_loading = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_INCREMENTAL_SAVE:
+      core_config->xcf_incremental_save = g_value_get_boolean (value);
+      break;
 
     case PROP_INSTALL_COLORMAP:
     case PROP_MIN_COLORS:
@@ -854,12 +905,21 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_PLUG_IN_HISTORY_SIZE:
       g_value_set_int (value, core_config->plug_in_history_size);
       break;
+    case PROP_PLUG_IN_RESIDENT_TIMEOUT:
+      g_value_set_int (value, core_config->plug_in_resident_timeout);
+      break;
+    case PROP_PLUG_IN_RESIDENT_MEMORY:
+      g_value_set_uint64 (value, core_config->plug_in_resident_memory);
+      break;
     case PROP_UNDO_LEVELS:
       g_value_set_int (value, core_config->levels_of_undo);
       break;
     case PROP_UNDO_SIZE:
       g_value_set_uint64 (value, core_config->undo_size);
       break;
+    case PROP_UNDO_SWAP_SIZE:
+      g_value_set_uint64 (value, core_config->undo_swap_size);
+      break;
     case PROP_UNDO_PREVIEW_SIZE:
       g_value_set_enum (value, core_config->undo_preview_size);
       break;
@@ -890,6 +950,15 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_QUICK_MASK_COLOR:
       gimp_value_set_rgb (value, &core_config->quick_mask_color);
       break;
+    case PROP_XCF_COMPRESSION:
+      g_value_set_boolean (value, core_config->xcf_compression);
+      break;
+    case PROP_XCF_LAZY_LOADING:
+      g_value_set_boolean (value, core_config->xcf_lazy_loading);
+      break;
+    case PROP_XCF_INCREMENTAL_SAVE:
+      g_value_set_boolean (value, core_config->xcf_incremental_save);
+      break;
 
     case PROP_INSTALL_COLORMAP:
     case PROP_MIN_COLORS:
@@ -77,8 +77,11 @@ struct _GimpCoreConfig
   GimpGrid               *default_grid;
   gint                    levels_of_undo;
   guint64                 undo_size;
+  guint64                 undo_swap_size;
   GimpViewSize            undo_preview_size;
   gint                    plug_in_history_size;
+  gint                    plug_in_resident_timeout;
+  guint64                 plug_in_resident_memory;
   gchar                  *plug_in_rc_path;
   gboolean                layer_previews;
   GimpViewSize            layer_preview_size;
@@ -88,6 +91,9 @@ struct _GimpCoreConfig
   GimpColorProfilePolicy  color_profile_policy;
   gboolean                save_document_history;
   GimpRGB                 quick_mask_color;
+  gboolean                xcf_compression;
+  gboolean                xcf_lazy_loading;
+  gboolean                xcf_incremental_save;
 };
 
 struct _GimpCoreConfigClass
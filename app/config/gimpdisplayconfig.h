@@ -70,6 +70,8 @@ struct _GimpDisplayConfig
   GimpSpaceBarAction  space_bar_action;
   GimpZoomQuality     zoom_quality;
   gboolean            use_event_history;
+  gint                motion_coalescing;
+  gboolean            accelerated_canvas;
 };
 
 struct _GimpDisplayConfigClass
@@ -41,8 +41,6 @@
 #include "gimp-intl.h"
 
 
-#define GIMP_MAX_NUM_THREADS 16
-
 enum
 {
   PROP_0,
@@ -50,6 +48,11 @@ enum
   PROP_SWAP_PATH,
   PROP_NUM_PROCESSORS,
   PROP_TILE_CACHE_SIZE,
+  PROP_TILE_CACHE_ADAPTIVE,
+  PROP_TILE_CACHE_MIN_SIZE,
+  PROP_TILE_CACHE_MAX_SIZE,
+  PROP_TILE_COMPRESSION,
+  PROP_TILE_DEDUPLICATION,
 
   /* ignored, only for backward compatibility: */
   PROP_STINGY_MEMORY_USE
@@ -106,6 +109,7 @@ gimp_gegl_config_class_init (GimpGeglConfigClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   gint          num_processors;
+  guint64       physical_size;
   guint64       memory_size;
 
   parent_class = g_type_class_peek_parent (klass);
@@ -122,7 +126,7 @@ gimp_gegl_config_class_init (GimpGeglConfigClass *klass)
                                  GIMP_CONFIG_PARAM_RESTART);
   GIMP_CONFIG_INSTALL_PROP_PATH (object_class, PROP_SWAP_PATH,
                                  "swap-path", SWAP_PATH_BLURB,
-                                 GIMP_CONFIG_PATH_DIR,
+                                 GIMP_CONFIG_PATH_DIR_LIST,
                                  "${gimp_dir}",
                                  GIMP_PARAM_STATIC_STRINGS |
                                  GIMP_CONFIG_PARAM_RESTART);
@@ -140,10 +144,10 @@ gimp_gegl_config_class_init (GimpGeglConfigClass *klass)
                                  1, GIMP_MAX_NUM_THREADS, num_processors,
                                  GIMP_PARAM_STATIC_STRINGS);
 
-  memory_size = gimp_get_physical_memory_size ();
+  physical_size = gimp_get_physical_memory_size ();
 
-  if (memory_size > 0)
-    memory_size = memory_size / 2; /* half the memory */
+  if (physical_size > 0)
+    memory_size = physical_size / 2; /* half the memory */
   else
     memory_size = 1 << 30; /* 1GB */
 
@@ -163,6 +167,41 @@ gimp_gegl_config_class_init (GimpGeglConfigClass *klass)
                                     GIMP_PARAM_STATIC_STRINGS |
                                     GIMP_CONFIG_PARAM_CONFIRM);
 
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_TILE_CACHE_ADAPTIVE,
+                                    "tile-cache-adaptive",
+                                    TILE_CACHE_ADAPTIVE_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_INSTALL_PROP_MEMSIZE (object_class, PROP_TILE_CACHE_MIN_SIZE,
+                                    "tile-cache-min-size",
+                                    TILE_CACHE_MIN_SIZE_BLURB,
+                                    0, MIN (G_MAXINT, GIMP_MAX_MEMSIZE),
+                                    MIN (memory_size, 1 << 26), /* 64MB */
+                                    GIMP_PARAM_STATIC_STRINGS);
+
+  if (physical_size > 0)
+    memory_size = MIN (physical_size / 4 * 3, G_MAXINT);
+
+  GIMP_CONFIG_INSTALL_PROP_MEMSIZE (object_class, PROP_TILE_CACHE_MAX_SIZE,
+                                    "tile-cache-max-size",
+                                    TILE_CACHE_MAX_SIZE_BLURB,
+                                    0, MIN (G_MAXINT, GIMP_MAX_MEMSIZE),
+                                    memory_size,
+                                    GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_TILE_COMPRESSION,
+                                    "tile-compression",
+                                    TILE_COMPRESSION_BLURB,
+                                    TRUE,
+                                    GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_TILE_DEDUPLICATION,
+                                    "tile-deduplication",
+                                    TILE_DEDUPLICATION_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
+
   /*  only for backward compatibility:  */
   GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_STINGY_MEMORY_USE,
                                     "stingy-memory-use", NULL,
@@ -214,6 +253,21 @@ gimp_gegl_config_set_property (GObject      *object,
     case PROP_TILE_CACHE_SIZE:
       gegl_config->tile_cache_size = g_value_get_uint64 (value);
       break;
+    case PROP_TILE_CACHE_ADAPTIVE:
+      gegl_config->tile_cache_adaptive = g_value_get_boolean (value);
+      break;
+    case PROP_TILE_CACHE_MIN_SIZE:
+      gegl_config->tile_cache_min_size = g_value_get_uint64 (value);
+      break;
+    case PROP_TILE_CACHE_MAX_SIZE:
+      gegl_config->tile_cache_max_size = g_value_get_uint64 (value);
+      break;
+    case PROP_TILE_COMPRESSION:
+      gegl_config->tile_compression = g_value_get_boolean (value);
+      break;
+    case PROP_TILE_DEDUPLICATION:
+      gegl_config->tile_deduplication = g_value_get_boolean (value);
+      break;
 
     case PROP_STINGY_MEMORY_USE:
       /* ignored */
@@ -247,6 +301,21 @@ gimp_gegl_config_get_property (GObject    *object,
     case PROP_TILE_CACHE_SIZE:
       g_value_set_uint64 (value, gegl_config->tile_cache_size);
       break;
+    case PROP_TILE_CACHE_ADAPTIVE:
+      g_value_set_boolean (value, gegl_config->tile_cache_adaptive);
+      break;
+    case PROP_TILE_CACHE_MIN_SIZE:
+      g_value_set_uint64 (value, gegl_config->tile_cache_min_size);
+      break;
+    case PROP_TILE_CACHE_MAX_SIZE:
+      g_value_set_uint64 (value, gegl_config->tile_cache_max_size);
+      break;
+    case PROP_TILE_COMPRESSION:
+      g_value_set_boolean (value, gegl_config->tile_compression);
+      break;
+    case PROP_TILE_DEDUPLICATION:
+      g_value_set_boolean (value, gegl_config->tile_deduplication);
+      break;
 
     case PROP_STINGY_MEMORY_USE:
       /* ignored */
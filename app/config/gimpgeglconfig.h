@@ -29,6 +29,9 @@
 #define GIMP_IS_GEGL_CONFIG_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GIMP_TYPE_GEGL_CONFIG))
 
 
+#define GIMP_MAX_NUM_THREADS 64
+
+
 typedef struct _GimpGeglConfigClass GimpGeglConfigClass;
 
 struct _GimpGeglConfig
@@ -39,6 +42,11 @@ struct _GimpGeglConfig
   gchar    *swap_path;
   guint     num_processors;
   guint64   tile_cache_size;
+  gboolean  tile_cache_adaptive;
+  guint64   tile_cache_min_size;
+  guint64   tile_cache_max_size;
+  gboolean  tile_compression;
+  gboolean  tile_deduplication;
 };
 
 struct _GimpGeglConfigClass
@@ -265,6 +265,15 @@ N_("When enabled, the X server is queried for the mouse's current position " \
 #define PLUG_IN_HISTORY_SIZE_BLURB \
 "How many recently used plug-ins to keep on the Filters menu."
 
+#define PLUG_IN_RESIDENT_MEMORY_BLURB \
+"Plug-ins that support it are kept running between calls unless their " \
+"process uses more than this amount of memory."
+
+#define PLUG_IN_RESIDENT_TIMEOUT_BLURB \
+"How many seconds a plug-in that supports it is kept running after it " \
+"was last used, so that it doesn't have to be started again.  Zero " \
+"disables keeping plug-ins running."
+
 #define PLUG_IN_PATH_BLURB \
 "Sets the plug-in search path."
 
@@ -379,7 +388,9 @@ N_("Sets the swap file location. GIMP uses a tile based memory allocation " \
    "if GIMP is used with large images. " \
    "Also, things can get horribly slow if the swap file is created on " \
    "a folder that is mounted over NFS.  For these reasons, it may be " \
-   "desirable to put your swap file in \"/tmp\".")
+   "desirable to put your swap file in \"/tmp\". If a list of folders is " \
+   "given, a swap file is created in each of them and the tiles are spread " \
+   "over them, which is faster when the folders are on different disks.")
 
 #define TEAROFF_MENUS_BLURB \
 N_("When enabled, menus can be torn off.")
@@ -419,6 +430,31 @@ N_("When the amount of pixel data exceeds this limit, GIMP will start to " \
    "work on images that wouldn't fit into memory otherwise.  If you have a " \
    "lot of RAM, you may want to set this to a higher value.")
 
+#define TILE_CACHE_ADAPTIVE_BLURB \
+N_("When enabled, GIMP watches how much memory the system has to spare " \
+   "and grows or shrinks the tile cache between the minimum and maximum " \
+   "tile cache size, starting from the tile cache size.  This avoids that " \
+   "the system swaps GIMP's memory, which is much slower than GIMP " \
+   "swapping tiles itself.")
+
+#define TILE_CACHE_MIN_SIZE_BLURB \
+N_("The smallest size the tile cache shrinks to when the tile cache size " \
+   "is adaptive.")
+
+#define TILE_CACHE_MAX_SIZE_BLURB \
+N_("The largest size the tile cache grows to when the tile cache size " \
+   "is adaptive.")
+
+#define TILE_COMPRESSION_BLURB \
+N_("When enabled, tiles that don't fit into the tile cache any longer are " \
+   "kept compressed in memory, as long as they compress well, before they " \
+   "are swapped to disk.")
+
+#define TILE_DEDUPLICATION_BLURB \
+N_("When enabled, tiles with the same contents share their compressed " \
+   "data and their place in the swap file, which saves memory and disk " \
+   "space when the same image data is opened several times.")
+
 #define TOOLBOX_COLOR_AREA_BLURB \
 N_("Show the current foreground and background colors in the toolbox.")
 
@@ -450,6 +486,12 @@ N_("Sets an upper limit to the memory that is used per image to keep " \
    "operations on the undo stack. Regardless of this setting, at least " \
    "as many undo-levels as configured can be undone.")
 
+#define UNDO_SWAP_SIZE_BLURB \
+N_("When the undo-size limit is reached, the image data of the oldest " \
+   "undo steps is compressed and moved to the swap file instead of " \
+   "dropping the steps, up to this amount of data per image. Set it to " \
+   "zero to drop old undo steps right away.")
+
 #define UNDO_PREVIEW_SIZE_BLURB \
 N_("Sets the size of the previews in the Undo History.")
 
@@ -464,6 +506,22 @@ N_("When enabled, pressing F1 will open the help browser.")
 "The location of the online user manual. This is used if " \
 "'user-manual-online' is enabled."
 
+#define XCF_COMPRESSION_BLURB \
+N_("When enabled, XCF files are saved with zlib compressed tiles. Such " \
+   "files are smaller, but can't be opened by older versions of GIMP.")
+
+#define XCF_LAZY_LOADING_BLURB \
+N_("When enabled, the pixels of XCF files are only read from the file " \
+   "when they are first needed, which makes opening large files much " \
+   "faster. The file must not be changed by other programs while it " \
+   "is open.")
+
+#define XCF_INCREMENTAL_SAVE_BLURB \
+N_("When enabled, saving an XCF file again only appends the layers and " \
+   "channels whose pixels changed since the last save, instead of " \
+   "rewriting the whole file. The file is rewritten when too much of it " \
+   "is no longer used.")
+
 #define ZOOM_QUALITY_BLURB \
 "There's a tradeoff between speed and quality of the zoomed-out display."
 
@@ -471,4 +529,15 @@ N_("When enabled, pressing F1 will open the help browser.")
 "Bugs in event history buffer are frequent so in case of cursor " \
 "offset problems turning it off helps."
 
+#define MOTION_COALESCING_BLURB \
+"When set, the motion events of a stroke are collected for this many " \
+"milliseconds and handed to the tool at once, so that the image is only " \
+"updated once per batch. This keeps painting in step with tablets which " \
+"report many events per second. Zero delivers every event immediately."
+
+#define ACCELERATED_CANVAS_BLURB \
+"When enabled, the rendered image tiles are kept on the display server, " \
+"where many graphics drivers composite them in video memory. This makes " \
+"scrolling over already rendered parts of the image cheaper."
+
 #endif  /* __GIMP_RC_BLURBS_H__ */
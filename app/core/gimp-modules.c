@@ -150,6 +150,10 @@ gimp_modules_load (Gimp *gimp)
       g_free (module_load_inhibit);
     }
 
+  filename = gimp_personal_rc_file ("modulecache");
+  gimp_module_db_set_cache_file (gimp->module_db, filename);
+  g_free (filename);
+
   path = gimp_config_path_expand (gimp->config->module_path, TRUE, NULL);
   gimp_module_db_load (gimp->module_db, path);
   g_free (path);
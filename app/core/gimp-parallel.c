@@ -0,0 +1,620 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-parallel.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The core's worker pool.  All tasks share one GThreadPool of
+ * "num-processors" threads, whose queue is sorted by priority, so
+ * interactive work overtakes queued background work (but doesn't
+ * preempt running tasks).
+ *
+ * gimp_parallel_distribute() blocks and lets the calling thread work
+ * along; it only ever waits for jobs that are already running, never
+ * for queued helpers, so it can't deadlock when the pool is busy and
+ * may be nested.  All threads working on a distribute call take their
+ * jobs from one shared counter, there are no per-thread queues and no
+ * work stealing.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "core-types.h"
+
+#include "base/pixel-region.h"
+
+#include "config/gimpgeglconfig.h"
+
+#include "gimp.h"
+#include "gimp-parallel.h"
+#include "gimpprogress.h"
+
+
+/*  milliseconds between progress updates of asynchronous tasks  */
+#define GIMP_PARALLEL_PROGRESS_INTERVAL 100
+
+
+struct _GimpParallelTask
+{
+  gint                  ref_count;      /*  atomic                        */
+  GimpParallelPriority  priority;
+  gint                  serial;         /*  keeps the queue FIFO          */
+
+  GimpParallelRunFunc   func;
+  GimpParallelDoneFunc  done;
+  gpointer              user_data;
+
+  GimpProgress         *progress;
+  gulong                cancel_id;
+  guint                 progress_id;
+  gdouble               progress_value; /*  protected by parallel_mutex   */
+
+  gint                  canceled;       /*  atomic                        */
+  gboolean              finished;       /*  protected by parallel_mutex   */
+};
+
+typedef struct
+{
+  gint                        ref_count;  /*  atomic                      */
+
+  GimpParallelDistributeFunc  func;
+  gpointer                    user_data;
+
+  gint                        n_jobs;
+  gint                        next_job;   /*  atomic                      */
+  gint                        n_done;     /*  protected by parallel_mutex */
+} GimpParallelDistribute;
+
+typedef struct
+{
+  const GeglRectangle            *area;
+  gint                            x0;
+  gint                            y0;
+  gint                            tile_width;
+  gint                            tile_height;
+  gint                            n_cols;
+
+  GimpParallelDistributeAreaFunc  func;
+  gpointer                        user_data;
+} GimpParallelDistributeArea;
+
+
+/*  local function prototypes  */
+
+static void               gimp_parallel_notify_num_processors (GimpGeglConfig         *config);
+
+static GimpParallelTask * gimp_parallel_task_new              (GimpParallelPriority    priority,
+                                                               GimpParallelRunFunc     func,
+                                                               GimpParallelDoneFunc    done,
+                                                               gpointer                user_data);
+static void               gimp_parallel_task_push             (GimpParallelTask       *task);
+static gint               gimp_parallel_task_compare          (gconstpointer           a,
+                                                               gconstpointer           b,
+                                                               gpointer                data);
+static void               gimp_parallel_pool_func             (gpointer                data,
+                                                               gpointer                pool_data);
+static gboolean           gimp_parallel_task_progress_timeout (gpointer                data);
+static gboolean           gimp_parallel_task_idle_done        (gpointer                data);
+
+static void               gimp_parallel_distribute_work       (GimpParallelDistribute *distribute);
+static void               gimp_parallel_distribute_helper     (GimpParallelTask       *task,
+                                                               gpointer                data);
+static void               gimp_parallel_distribute_unref      (GimpParallelDistribute *distribute);
+static void               gimp_parallel_distribute_area_func  (gint                    i,
+                                                               gint                    n,
+                                                               gpointer                data);
+static void               gimp_parallel_distribute_regions    (PixelRegionsWorkerFunc  func,
+                                                               gpointer                data);
+
+
+static GThreadPool *parallel_pool      = NULL;
+static gint         parallel_n_threads = 1;
+static gint         parallel_serial    = 0;
+static GMutex       parallel_mutex;
+static GCond        parallel_cond;
+
+
+/*  public functions  */
+
+void
+gimp_parallel_init (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+  g_return_if_fail (parallel_pool == NULL);
+
+  parallel_pool = g_thread_pool_new (gimp_parallel_pool_func, NULL,
+                                     1, FALSE, NULL);
+  g_thread_pool_set_sort_function (parallel_pool,
+                                   gimp_parallel_task_compare, NULL);
+
+  gimp_parallel_notify_num_processors (GIMP_GEGL_CONFIG (gimp->config));
+
+  g_signal_connect (gimp->config, "notify::num-processors",
+                    G_CALLBACK (gimp_parallel_notify_num_processors),
+                    NULL);
+
+  pixel_regions_set_distribute_func (gimp_parallel_distribute_regions);
+}
+
+void
+gimp_parallel_exit (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  if (! parallel_pool)
+    return;
+
+  pixel_regions_set_distribute_func (NULL);
+
+  g_signal_handlers_disconnect_by_func (gimp->config,
+                                        gimp_parallel_notify_num_processors,
+                                        NULL);
+
+  /*  let the queued tasks finish, their owners may wait for them  */
+  g_thread_pool_free (parallel_pool, FALSE, TRUE);
+  parallel_pool = NULL;
+
+  parallel_n_threads = 1;
+}
+
+/**
+ * gimp_parallel_get_n_threads:
+ *
+ * Return value: the number of threads the pool runs tasks on, which
+ *               is 1 before gimp_parallel_init() and without
+ *               ENABLE_MP.
+ **/
+gint
+gimp_parallel_get_n_threads (void)
+{
+  return parallel_pool ? parallel_n_threads : 1;
+}
+
+/**
+ * gimp_parallel_distribute:
+ * @n_jobs:    the number of jobs
+ * @func:      the function to call for every job
+ * @user_data: user data passed to @func
+ *
+ * Calls @func once for every job number from 0 to @n_jobs - 1 and
+ * returns when all calls have returned.  The calls run concurrently on
+ * the calling thread and on the worker pool, in no particular order;
+ * each thread takes the next job from a shared counter when it is
+ * done with its last one, so jobs of uneven cost are balanced.
+ **/
+void
+gimp_parallel_distribute (gint                       n_jobs,
+                          GimpParallelDistributeFunc func,
+                          gpointer                   user_data)
+{
+  GimpParallelDistribute *distribute;
+  gint                    n_helpers;
+  gint                    i;
+
+  g_return_if_fail (n_jobs >= 0);
+  g_return_if_fail (func != NULL);
+
+  n_helpers = MIN (n_jobs, gimp_parallel_get_n_threads ()) - 1;
+
+  if (n_helpers < 1)
+    {
+      for (i = 0; i < n_jobs; i++)
+        func (i, n_jobs, user_data);
+
+      return;
+    }
+
+  distribute = g_slice_new (GimpParallelDistribute);
+
+  /*  one reference for every helper and one for us  */
+  distribute->ref_count = n_helpers + 1;
+  distribute->func      = func;
+  distribute->user_data = user_data;
+  distribute->n_jobs    = n_jobs;
+  distribute->next_job  = 0;
+  distribute->n_done    = 0;
+
+  for (i = 0; i < n_helpers; i++)
+    gimp_parallel_task_push (gimp_parallel_task_new (GIMP_PARALLEL_PRIORITY_INTERACTIVE,
+                                                     gimp_parallel_distribute_helper,
+                                                     NULL, distribute));
+
+  gimp_parallel_distribute_work (distribute);
+
+  g_mutex_lock (&parallel_mutex);
+
+  while (distribute->n_done < distribute->n_jobs)
+    g_cond_wait (&parallel_cond, &parallel_mutex);
+
+  g_mutex_unlock (&parallel_mutex);
+
+  gimp_parallel_distribute_unref (distribute);
+}
+
+/**
+ * gimp_parallel_distribute_area:
+ * @area:        the area to process
+ * @tile_width:  the width of the grid @area is split along
+ * @tile_height: the height of the grid @area is split along
+ * @func:        the function to call for every piece of @area
+ * @user_data:   user data passed to @func
+ *
+ * Splits @area along a grid of @tile_width x @tile_height rectangles
+ * aligned to 0,0 and processes the pieces like
+ * gimp_parallel_distribute().  Pass the tile size of the buffer that
+ * is processed to give every call whole tiles.
+ **/
+void
+gimp_parallel_distribute_area (const GeglRectangle            *area,
+                               gint                            tile_width,
+                               gint                            tile_height,
+                               GimpParallelDistributeAreaFunc  func,
+                               gpointer                        user_data)
+{
+  GimpParallelDistributeArea distribute_area;
+  gint                       n_rows;
+
+  g_return_if_fail (area != NULL);
+  g_return_if_fail (tile_width > 0 && tile_height > 0);
+  g_return_if_fail (func != NULL);
+
+  if (area->width < 1 || area->height < 1)
+    return;
+
+  distribute_area.area        = area;
+  distribute_area.x0          = area->x - (area->x % tile_width  + tile_width)  % tile_width;
+  distribute_area.y0          = area->y - (area->y % tile_height + tile_height) % tile_height;
+  distribute_area.tile_width  = tile_width;
+  distribute_area.tile_height = tile_height;
+  distribute_area.func        = func;
+  distribute_area.user_data   = user_data;
+
+  distribute_area.n_cols = (area->x + area->width - distribute_area.x0 +
+                            tile_width - 1) / tile_width;
+  n_rows                 = (area->y + area->height - distribute_area.y0 +
+                            tile_height - 1) / tile_height;
+
+  gimp_parallel_distribute (distribute_area.n_cols * n_rows,
+                            gimp_parallel_distribute_area_func,
+                            &distribute_area);
+}
+
+/**
+ * gimp_parallel_run_async:
+ * @priority:  the priority of the task
+ * @progress:  a #GimpProgress to report to, or %NULL
+ * @message:   the message to start @progress with
+ * @func:      the function to run on the worker pool
+ * @done:      the function to call on the main loop when @func is done
+ * @user_data: user data passed to @func and @done
+ *
+ * Queues @func to be run on the worker pool.  @done is called from
+ * the main loop afterwards, with @canceled telling whether the task
+ * was canceled; a task canceled before it got to run skips @func.
+ *
+ * If @progress is given, it is started with @message, cancels the
+ * task when canceled, shows the values of
+ * gimp_parallel_task_set_progress() and is ended before @done.
+ *
+ * Return value: a reference on the new task, release it with
+ *               gimp_parallel_task_unref().
+ **/
+GimpParallelTask *
+gimp_parallel_run_async (GimpParallelPriority  priority,
+                         GimpProgress         *progress,
+                         const gchar          *message,
+                         GimpParallelRunFunc   func,
+                         GimpParallelDoneFunc  done,
+                         gpointer              user_data)
+{
+  GimpParallelTask *task;
+
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  task = gimp_parallel_task_new (priority, func, done, user_data);
+
+  if (progress)
+    progress = gimp_progress_start (progress, message, TRUE);
+
+  if (progress)
+    {
+      task->progress = g_object_ref (progress);
+
+      task->cancel_id =
+        g_signal_connect_swapped (progress, "cancel",
+                                  G_CALLBACK (gimp_parallel_task_cancel),
+                                  task);
+      task->progress_id =
+        g_timeout_add (GIMP_PARALLEL_PROGRESS_INTERVAL,
+                       gimp_parallel_task_progress_timeout,
+                       task);
+    }
+
+  /*  the pool's reference is passed on to the done handler  */
+  gimp_parallel_task_ref (task);
+
+  gimp_parallel_task_push (task);
+
+  return task;
+}
+
+GimpParallelTask *
+gimp_parallel_task_ref (GimpParallelTask *task)
+{
+  g_return_val_if_fail (task != NULL, NULL);
+
+  g_atomic_int_inc (&task->ref_count);
+
+  return task;
+}
+
+void
+gimp_parallel_task_unref (GimpParallelTask *task)
+{
+  g_return_if_fail (task != NULL);
+
+  if (g_atomic_int_dec_and_test (&task->ref_count))
+    g_slice_free (GimpParallelTask, task);
+}
+
+/**
+ * gimp_parallel_task_cancel:
+ * @task: a #GimpParallelTask
+ *
+ * Asks @task to stop.  A task that didn't start yet won't run, a
+ * running task is expected to poll gimp_parallel_task_is_canceled()
+ * and return early.
+ **/
+void
+gimp_parallel_task_cancel (GimpParallelTask *task)
+{
+  g_return_if_fail (task != NULL);
+
+  g_atomic_int_set (&task->canceled, TRUE);
+}
+
+gboolean
+gimp_parallel_task_is_canceled (GimpParallelTask *task)
+{
+  g_return_val_if_fail (task != NULL, FALSE);
+
+  return g_atomic_int_get (&task->canceled);
+}
+
+/**
+ * gimp_parallel_task_set_progress:
+ * @task:  a #GimpParallelTask
+ * @value: the progress, between 0.0 and 1.0
+ *
+ * Sets the progress of @task, which is passed on to its #GimpProgress
+ * from the main loop.  May be called from the task's thread.
+ **/
+void
+gimp_parallel_task_set_progress (GimpParallelTask *task,
+                                 gdouble           value)
+{
+  g_return_if_fail (task != NULL);
+
+  g_mutex_lock (&parallel_mutex);
+  task->progress_value = CLAMP (value, 0.0, 1.0);
+  g_mutex_unlock (&parallel_mutex);
+}
+
+/**
+ * gimp_parallel_task_wait:
+ * @task: a #GimpParallelTask
+ *
+ * Waits until the function of @task has returned, or was skipped
+ * because the task was canceled.  The done handler still runs from
+ * the main loop later.  Don't call this from a task on the pool.
+ **/
+void
+gimp_parallel_task_wait (GimpParallelTask *task)
+{
+  g_return_if_fail (task != NULL);
+
+  g_mutex_lock (&parallel_mutex);
+
+  while (! task->finished)
+    g_cond_wait (&parallel_cond, &parallel_mutex);
+
+  g_mutex_unlock (&parallel_mutex);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_parallel_notify_num_processors (GimpGeglConfig *config)
+{
+#ifdef ENABLE_MP
+  parallel_n_threads = CLAMP (config->num_processors, 1, GIMP_MAX_NUM_THREADS);
+#endif
+
+  g_thread_pool_set_max_threads (parallel_pool, parallel_n_threads, NULL);
+}
+
+static GimpParallelTask *
+gimp_parallel_task_new (GimpParallelPriority priority,
+                        GimpParallelRunFunc  func,
+                        GimpParallelDoneFunc done,
+                        gpointer             user_data)
+{
+  GimpParallelTask *task = g_slice_new0 (GimpParallelTask);
+
+  task->ref_count = 1;
+  task->priority  = priority;
+  task->serial    = g_atomic_int_add (&parallel_serial, 1);
+  task->func      = func;
+  task->done      = done;
+  task->user_data = user_data;
+
+  return task;
+}
+
+static void
+gimp_parallel_task_push (GimpParallelTask *task)
+{
+  /*  before gimp_parallel_init(), run the task right away  */
+  if (parallel_pool)
+    g_thread_pool_push (parallel_pool, task, NULL);
+  else
+    gimp_parallel_pool_func (task, NULL);
+}
+
+static gint
+gimp_parallel_task_compare (gconstpointer a,
+                            gconstpointer b,
+                            gpointer      data)
+{
+  const GimpParallelTask *task1 = a;
+  const GimpParallelTask *task2 = b;
+
+  if (task1->priority != task2->priority)
+    return task1->priority < task2->priority ? -1 : 1;
+
+  return (task1->serial > task2->serial) - (task1->serial < task2->serial);
+}
+
+static void
+gimp_parallel_pool_func (gpointer data,
+                         gpointer pool_data)
+{
+  GimpParallelTask *task = data;
+
+  if (! gimp_parallel_task_is_canceled (task))
+    task->func (task, task->user_data);
+
+  g_mutex_lock (&parallel_mutex);
+  task->finished = TRUE;
+  g_cond_broadcast (&parallel_cond);
+  g_mutex_unlock (&parallel_mutex);
+
+  if (task->done || task->progress)
+    g_idle_add (gimp_parallel_task_idle_done, task);
+  else
+    gimp_parallel_task_unref (task);
+}
+
+static gboolean
+gimp_parallel_task_progress_timeout (gpointer data)
+{
+  GimpParallelTask *task = data;
+  gdouble           value;
+
+  g_mutex_lock (&parallel_mutex);
+  value = task->progress_value;
+  g_mutex_unlock (&parallel_mutex);
+
+  gimp_progress_set_value (task->progress, value);
+
+  return TRUE;
+}
+
+static gboolean
+gimp_parallel_task_idle_done (gpointer data)
+{
+  GimpParallelTask *task     = data;
+  gboolean          canceled = gimp_parallel_task_is_canceled (task);
+
+  if (task->progress)
+    {
+      g_source_remove (task->progress_id);
+      g_signal_handler_disconnect (task->progress, task->cancel_id);
+
+      gimp_progress_end (task->progress);
+
+      g_object_unref (task->progress);
+      task->progress = NULL;
+    }
+
+  if (task->done)
+    task->done (task, canceled, task->user_data);
+
+  gimp_parallel_task_unref (task);
+
+  return FALSE;
+}
+
+static void
+gimp_parallel_distribute_work (GimpParallelDistribute *distribute)
+{
+  gint i;
+
+  while ((i = g_atomic_int_add (&distribute->next_job, 1)) <
+         distribute->n_jobs)
+    {
+      distribute->func (i, distribute->n_jobs, distribute->user_data);
+
+      g_mutex_lock (&parallel_mutex);
+
+      if (++distribute->n_done == distribute->n_jobs)
+        g_cond_broadcast (&parallel_cond);
+
+      g_mutex_unlock (&parallel_mutex);
+    }
+}
+
+static void
+gimp_parallel_distribute_helper (GimpParallelTask *task,
+                                 gpointer          data)
+{
+  GimpParallelDistribute *distribute = data;
+
+  /*  a helper that starts late finds no more jobs and just returns  */
+  gimp_parallel_distribute_work (distribute);
+
+  gimp_parallel_distribute_unref (distribute);
+}
+
+static void
+gimp_parallel_distribute_unref (GimpParallelDistribute *distribute)
+{
+  if (g_atomic_int_dec_and_test (&distribute->ref_count))
+    g_slice_free (GimpParallelDistribute, distribute);
+}
+
+static void
+gimp_parallel_distribute_area_func (gint     i,
+                                    gint     n,
+                                    gpointer data)
+{
+  GimpParallelDistributeArea *distribute_area = data;
+  GeglRectangle               tile;
+  GeglRectangle               area;
+
+  tile.x      = distribute_area->x0 +
+                (i % distribute_area->n_cols) * distribute_area->tile_width;
+  tile.y      = distribute_area->y0 +
+                (i / distribute_area->n_cols) * distribute_area->tile_height;
+  tile.width  = distribute_area->tile_width;
+  tile.height = distribute_area->tile_height;
+
+  if (gegl_rectangle_intersect (&area, &tile, distribute_area->area))
+    distribute_area->func (&area, distribute_area->user_data);
+}
+
+/*  runs pixel_regions_process_parallel()'s workers on the pool  */
+static void
+gimp_parallel_distribute_regions (PixelRegionsWorkerFunc func,
+                                  gpointer               data)
+{
+  gimp_parallel_distribute (gimp_parallel_get_n_threads (),
+                            (GimpParallelDistributeFunc) func, data);
+}
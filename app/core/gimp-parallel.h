@@ -0,0 +1,76 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-parallel.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_PARALLEL_H__
+#define __GIMP_PARALLEL_H__
+
+
+typedef enum
+{
+  GIMP_PARALLEL_PRIORITY_INTERACTIVE,
+  GIMP_PARALLEL_PRIORITY_BACKGROUND
+} GimpParallelPriority;
+
+
+typedef struct _GimpParallelTask GimpParallelTask;
+
+typedef void (* GimpParallelDistributeFunc)     (gint                 i,
+                                                 gint                 n,
+                                                 gpointer             user_data);
+typedef void (* GimpParallelDistributeAreaFunc) (const GeglRectangle *area,
+                                                 gpointer             user_data);
+typedef void (* GimpParallelRunFunc)            (GimpParallelTask    *task,
+                                                 gpointer             user_data);
+typedef void (* GimpParallelDoneFunc)           (GimpParallelTask    *task,
+                                                 gboolean             canceled,
+                                                 gpointer             user_data);
+
+
+void               gimp_parallel_init              (Gimp                           *gimp);
+void               gimp_parallel_exit              (Gimp                           *gimp);
+
+gint               gimp_parallel_get_n_threads     (void);
+
+void               gimp_parallel_distribute        (gint                            n_jobs,
+                                                    GimpParallelDistributeFunc      func,
+                                                    gpointer                        user_data);
+void               gimp_parallel_distribute_area   (const GeglRectangle            *area,
+                                                    gint                            tile_width,
+                                                    gint                            tile_height,
+                                                    GimpParallelDistributeAreaFunc  func,
+                                                    gpointer                        user_data);
+
+GimpParallelTask * gimp_parallel_run_async         (GimpParallelPriority            priority,
+                                                    GimpProgress                   *progress,
+                                                    const gchar                    *message,
+                                                    GimpParallelRunFunc             func,
+                                                    GimpParallelDoneFunc            done,
+                                                    gpointer                        user_data);
+
+GimpParallelTask * gimp_parallel_task_ref          (GimpParallelTask               *task);
+void               gimp_parallel_task_unref        (GimpParallelTask               *task);
+
+void               gimp_parallel_task_cancel       (GimpParallelTask               *task);
+gboolean           gimp_parallel_task_is_canceled  (GimpParallelTask               *task);
+void               gimp_parallel_task_set_progress (GimpParallelTask               *task,
+                                                    gdouble                         value);
+void               gimp_parallel_task_wait         (GimpParallelTask               *task);
+
+
+#endif /* __GIMP_PARALLEL_H__ */
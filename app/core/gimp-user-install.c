@@ -532,6 +532,7 @@ user_install_migrate_files (GimpUserInstall *install)
           /*  skip these files for all old versions  */
           if (strcmp (basename, "documents") == 0      ||
               g_str_has_prefix (basename, "gimpswap.") ||
+              strcmp (basename, "modulecache") == 0    ||
               strcmp (basename, "pluginrc") == 0       ||
               strcmp (basename, "themerc") == 0        ||
               strcmp (basename, "toolrc") == 0)
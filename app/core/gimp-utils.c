@@ -57,6 +57,10 @@
 
 #include "core-types.h"
 
+#include "base/tile-manager.h"
+
+#include "gegl/gimp-gegl-utils.h"
+
 #include "gimp.h"
 #include "gimp-utils.h"
 #include "gimpcontainer.h"
@@ -64,7 +68,6 @@
 #include "gimpparamspecs.h"
 
 
-#define NUM_PROCESSORS_DEFAULT 1
 #define MAX_FUNC               100
 
 
@@ -291,7 +294,15 @@ gimp_gegl_buffer_get_memsize (GeglBuffer *buffer)
 {
   if (buffer)
     {
-      const Babl *format = gegl_buffer_get_format (buffer);
+      const Babl  *format = gegl_buffer_get_format (buffer);
+      TileManager *tiles  = gimp_gegl_buffer_peek_tiles (buffer);
+
+      /*  tiles shared with other buffers, e.g. between a drawable and
+       *  its undo steps, only count with their share
+       */
+      if (tiles)
+        return (tile_manager_get_shared_memsize (tiles) +
+                gimp_g_object_get_memsize (G_OBJECT (buffer)));
 
       return (babl_format_get_bytes_per_pixel (format) *
               gegl_buffer_get_width (buffer) *
@@ -330,27 +341,6 @@ gimp_get_pid (void)
   return (gint) getpid ();
 }
 
-gint
-gimp_get_number_of_processors (void)
-{
-  gint retval = NUM_PROCESSORS_DEFAULT;
-
-#ifdef G_OS_UNIX
-#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
-  retval = sysconf (_SC_NPROCESSORS_ONLN);
-#endif
-#endif
-#ifdef G_OS_WIN32
-  SYSTEM_INFO system_info;
-
-  GetSystemInfo (&system_info);
-
-  retval = system_info.dwNumberOfProcessors;
-#endif
-
-  return retval;
-}
-
 guint64
 gimp_get_physical_memory_size (void)
 {
@@ -39,12 +39,15 @@
 
 #include "text/gimp-fonts.h"
 
+#include "file/file-gegl.h"
+
 #include "xcf/xcf.h"
 
 #include "gimp.h"
 #include "gimp-contexts.h"
 #include "gimp-gradients.h"
 #include "gimp-modules.h"
+#include "gimp-parallel.h"
 #include "gimp-parasites.h"
 #include "gimp-templates.h"
 #include "gimp-units.h"
@@ -74,6 +77,7 @@
 #include "gimppattern.h"
 #include "gimppatternclipboard.h"
 #include "gimptagcache.h"
+#include "gimptempbuf.h"
 #include "gimptemplate.h"
 #include "gimptoolinfo.h"
 #include "gimptoolpreset.h"
@@ -254,6 +258,7 @@ gimp_init (Gimp *gimp)
   gimp->pdb                 = gimp_pdb_new (gimp);
 
   xcf_init (gimp);
+  file_gegl_init (gimp);
 
   gimp->tool_info_list      = gimp_list_new (GIMP_TYPE_TOOL_INFO, FALSE);
   gimp_object_set_static_name (GIMP_OBJECT (gimp->tool_info_list),
@@ -310,6 +315,8 @@ gimp_finalize (GObject *object)
   if (gimp->be_verbose)
     g_print ("EXIT: %s\n", G_STRFUNC);
 
+  gimp_parallel_exit (gimp);
+
   gimp_contexts_exit (gimp);
 
   if (gimp->image_new_last_template)
@@ -476,8 +483,9 @@ static gint64
 gimp_get_memsize (GimpObject *object,
                   gint64     *gui_size)
 {
-  Gimp   *gimp    = GIMP (object);
-  gint64  memsize = 0;
+  Gimp    *gimp    = GIMP (object);
+  gint64   memsize = 0;
+  guint64  pooled;
 
   memsize += gimp_g_list_get_memsize (gimp->user_units, 0 /* FIXME */);
 
@@ -519,6 +527,10 @@ gimp_get_memsize (GimpObject *object,
   memsize += gimp_object_get_memsize (GIMP_OBJECT (gimp->tag_cache),
                                       gui_size);
 
+  /*  freed temp buf data that is kept around for reuse  */
+  gimp_temp_buf_get_pool_stats (&pooled, NULL, NULL);
+  memsize += pooled;
+
   memsize += gimp_object_get_memsize (GIMP_OBJECT (gimp->pdb), gui_size);
 
   memsize += gimp_object_get_memsize (GIMP_OBJECT (gimp->tool_info_list),
@@ -549,41 +561,41 @@ gimp_real_initialize (Gimp               *gimp,
 {
   static const GimpDataFactoryLoaderEntry brush_loader_entries[] =
   {
-    { gimp_brush_load,           GIMP_BRUSH_FILE_EXTENSION,           FALSE },
-    { gimp_brush_load,           GIMP_BRUSH_PIXMAP_FILE_EXTENSION,    FALSE },
-    { gimp_brush_load_abr,       GIMP_BRUSH_PS_FILE_EXTENSION,        FALSE },
-    { gimp_brush_load_abr,       GIMP_BRUSH_PSP_FILE_EXTENSION,       FALSE },
-    { gimp_brush_generated_load, GIMP_BRUSH_GENERATED_FILE_EXTENSION, TRUE  },
-    { gimp_brush_pipe_load,      GIMP_BRUSH_PIPE_FILE_EXTENSION,      FALSE }
+    { gimp_brush_load,           GIMP_BRUSH_FILE_EXTENSION,           FALSE, TRUE  },
+    { gimp_brush_load,           GIMP_BRUSH_PIXMAP_FILE_EXTENSION,    FALSE, TRUE  },
+    { gimp_brush_load_abr,       GIMP_BRUSH_PS_FILE_EXTENSION,        FALSE, TRUE  },
+    { gimp_brush_load_abr,       GIMP_BRUSH_PSP_FILE_EXTENSION,       FALSE, TRUE  },
+    { gimp_brush_generated_load, GIMP_BRUSH_GENERATED_FILE_EXTENSION, TRUE,  TRUE  },
+    { gimp_brush_pipe_load,      GIMP_BRUSH_PIPE_FILE_EXTENSION,      FALSE, TRUE  }
   };
 
   static const GimpDataFactoryLoaderEntry dynamics_loader_entries[] =
   {
-    { gimp_dynamics_load,        GIMP_DYNAMICS_FILE_EXTENSION,        TRUE  }
+    { gimp_dynamics_load,        GIMP_DYNAMICS_FILE_EXTENSION,        TRUE,  FALSE }
   };
 
   static const GimpDataFactoryLoaderEntry pattern_loader_entries[] =
   {
-    { gimp_pattern_load,         GIMP_PATTERN_FILE_EXTENSION,         FALSE },
-    { gimp_pattern_load_pixbuf,  NULL,                                FALSE }
+    { gimp_pattern_load,         GIMP_PATTERN_FILE_EXTENSION,         FALSE, TRUE  },
+    { gimp_pattern_load_pixbuf,  NULL,                                FALSE, TRUE  }
   };
 
   static const GimpDataFactoryLoaderEntry gradient_loader_entries[] =
   {
-    { gimp_gradient_load,        GIMP_GRADIENT_FILE_EXTENSION,        TRUE  },
-    { gimp_gradient_load_svg,    GIMP_GRADIENT_SVG_FILE_EXTENSION,    FALSE },
-    { gimp_gradient_load,        NULL /* legacy loader */,            TRUE  }
+    { gimp_gradient_load,        GIMP_GRADIENT_FILE_EXTENSION,        TRUE,  TRUE  },
+    { gimp_gradient_load_svg,    GIMP_GRADIENT_SVG_FILE_EXTENSION,    FALSE, TRUE  },
+    { gimp_gradient_load,        NULL /* legacy loader */,            TRUE,  TRUE  }
   };
 
   static const GimpDataFactoryLoaderEntry palette_loader_entries[] =
   {
-    { gimp_palette_load,         GIMP_PALETTE_FILE_EXTENSION,         TRUE  },
-    { gimp_palette_load,         NULL /* legacy loader */,            TRUE  }
+    { gimp_palette_load,         GIMP_PALETTE_FILE_EXTENSION,         TRUE,  TRUE  },
+    { gimp_palette_load,         NULL /* legacy loader */,            TRUE,  TRUE  }
   };
 
   static const GimpDataFactoryLoaderEntry tool_preset_loader_entries[] =
   {
-    { gimp_tool_preset_load,     GIMP_TOOL_PRESET_FILE_EXTENSION,     TRUE  }
+    { gimp_tool_preset_load,     GIMP_TOOL_PRESET_FILE_EXTENSION,     TRUE,  FALSE }
   };
 
   GimpData *clipboard_brush;
@@ -594,6 +606,8 @@ gimp_real_initialize (Gimp               *gimp,
 
   status_callback (_("Initialization"), NULL, 0.0);
 
+  gimp_parallel_init (gimp);
+
   gimp_fonts_init (gimp);
 
   gimp->brush_factory =
@@ -26,14 +26,21 @@
 
 #include "core-types.h"
 
+#include "gimp-parallel.h"
 #include "gimpboundary.h"
 
 
 /* GimpBoundSeg array growth parameter */
 #define MAX_SEGS_INC  2048
 
+/* number of scanlines, and pixels, traced at once by generate_boundary() */
+#define SCAN_STRIP_HEIGHT  128
+#define SCAN_STRIP_PIXELS  (1 << 20)
 
-typedef struct _GimpBoundary GimpBoundary;
+
+typedef struct _GimpBoundary      GimpBoundary;
+typedef struct _GimpBoundaryScan  GimpBoundaryScan;
+typedef struct _GimpBoundaryStrip GimpBoundaryStrip;
 
 struct _GimpBoundary
 {
@@ -52,6 +59,43 @@ struct _GimpBoundary
   gint          max_empty_segs;
 };
 
+struct _GimpBoundaryScan
+{
+  const GeglRectangle *region;
+  GimpBoundaryType     type;
+  gint                 x1;
+  gint                 y1;
+  gint                 x2;
+  gint                 y2;
+  gfloat               threshold;
+
+  /*  the range of scanlines to trace and the width of a data row  */
+  gint                 start;
+  gint                 end;
+  gint                 width;
+  gint                 strip_height;
+};
+
+struct _GimpBoundaryStrip
+{
+  GimpBoundaryScan *scan;
+
+  /*  either the final boundary, or a boundary without vert_segs
+   *  which only records the horizontal segments of the strip
+   */
+  GimpBoundary     *boundary;
+
+  /*  the scanlines first - 1 to last of the buffer, clipped to the
+   *  scanned range
+   */
+  gfloat           *data;
+  gint              data_y;
+  gint              data_height;
+
+  gint              first;
+  gint              last;
+};
+
 
 /*  local function prototypes  */
 
@@ -91,6 +135,10 @@ static void           make_horiz_segs          (GimpBoundary        *boundary,
                                                 gint                 empty[],
                                                 gint                 num_empty,
                                                 gint                 top);
+static void           scan_strip               (GimpBoundaryStrip   *strip);
+static void           scan_strip_func          (gint                 i,
+                                                gint                 n,
+                                                GimpBoundaryStrip   *strips);
 static GimpBoundary * generate_boundary        (GeglBuffer          *buffer,
                                                 const GeglRectangle *region,
                                                 const Babl          *format,
@@ -604,6 +652,15 @@ process_horiz_seg (GimpBoundary *boundary,
                    gint          y2,
                    gboolean      open)
 {
+  if (! boundary->vert_segs)
+    {
+      /*  a strip boundary, the segments are processed in order
+       *  once all strips are traced
+       */
+      gimp_boundary_add_seg (boundary, x1, y1, x2, y2, open);
+      return;
+    }
+
   /*  This procedure accounts for any vertical segments that must be
       drawn to close in the horizontal segments.                     */
 
@@ -658,84 +715,51 @@ make_horiz_segs (GimpBoundary *boundary,
     }
 }
 
-static GimpBoundary *
-generate_boundary (GeglBuffer          *buffer,
-                   const GeglRectangle *region,
-                   const Babl          *format,
-                   GimpBoundaryType     type,
-                   gint                 x1,
-                   gint                 y1,
-                   gint                 x2,
-                   gint                 y2,
-                   gfloat               threshold)
+static inline const gfloat *
+scan_strip_get_row (GimpBoundaryStrip *strip,
+                    gint               scanline)
 {
-  GimpBoundary  *boundary;
-  GeglRectangle  line_rect = { 0, };
-  gfloat        *line_data;
-  gint           scanline;
-  gint           i;
-  gint           start, end;
-  gint          *tmp_segs;
+  if (scanline <  strip->data_y ||
+      scanline >= strip->data_y + strip->data_height)
+    return NULL;
+
+  return strip->data + (scanline - strip->data_y) * strip->scan->width;
+}
+
+static void
+scan_strip (GimpBoundaryStrip *strip)
+{
+  GimpBoundaryScan *scan     = strip->scan;
+  GimpBoundary     *boundary = strip->boundary;
+  gint              scanline;
+  gint              i;
+  gint             *tmp_segs;
 
   gint          num_empty_n = 0;
   gint          num_empty_c = 0;
   gint          num_empty_l = 0;
 
-  boundary = gimp_boundary_new (region);
-
-  line_rect.width  = gegl_buffer_get_width (buffer);
-  line_rect.height = 1;
-
-  line_data = g_alloca (sizeof (gfloat) * line_rect.width);
-
-  start = 0;
-  end   = 0;
-
-  if (type == GIMP_BOUNDARY_WITHIN_BOUNDS)
-    {
-      start = y1;
-      end   = y2;
-    }
-  else if (type == GIMP_BOUNDARY_IGNORE_BOUNDS)
-    {
-      start = region->y;
-      end   = region->y + region->height;
-    }
-
   /*  Find the empty segments for the previous and current scanlines  */
-  find_empty_segs (region, NULL,
-                   start - 1, boundary->empty_segs_l,
+  find_empty_segs (scan->region, scan_strip_get_row (strip, strip->first - 1),
+                   strip->first - 1, boundary->empty_segs_l,
                    boundary->max_empty_segs, &num_empty_l,
-                   type, x1, y1, x2, y2,
-                   threshold);
-
-  line_rect.y = start;
-  gegl_buffer_get (buffer, &line_rect, 1.0, format,
-                   line_data, GEGL_AUTO_ROWSTRIDE,
-                   GEGL_ABYSS_NONE);
+                   scan->type, scan->x1, scan->y1, scan->x2, scan->y2,
+                   scan->threshold);
 
-  find_empty_segs (region, line_data,
-                   start, boundary->empty_segs_c,
+  find_empty_segs (scan->region, scan_strip_get_row (strip, strip->first),
+                   strip->first, boundary->empty_segs_c,
                    boundary->max_empty_segs, &num_empty_c,
-                   type, x1, y1, x2, y2,
-                   threshold);
+                   scan->type, scan->x1, scan->y1, scan->x2, scan->y2,
+                   scan->threshold);
 
-  for (scanline = start; scanline < end; scanline++)
+  for (scanline = strip->first; scanline < strip->last; scanline++)
     {
       /*  find the empty segment list for the next scanline  */
-      line_rect.y = scanline + 1;
-      if (scanline + 1 == end)
-        line_data = NULL;
-      else
-        gegl_buffer_get (buffer, &line_rect, 1.0, format,
-                         line_data, GEGL_AUTO_ROWSTRIDE,
-                         GEGL_ABYSS_NONE);
-
-      find_empty_segs (region, line_data,
+      find_empty_segs (scan->region, scan_strip_get_row (strip, scanline + 1),
                        scanline + 1, boundary->empty_segs_n,
                        boundary->max_empty_segs, &num_empty_n,
-                       type, x1, y1, x2, y2,
-                       threshold);
+                       scan->type, scan->x1, scan->y1, scan->x2, scan->y2,
+                       scan->threshold);
 
       /*  process the segments on the current scanline  */
       for (i = 1; i < num_empty_c - 1; i += 2)
@@ -760,6 +784,165 @@ generate_boundary (GeglBuffer          *buffer,
       num_empty_c            = num_empty_n;
       boundary->empty_segs_n = tmp_segs;
     }
+}
+
+static void
+scan_strip_func (gint               i,
+                 gint               n,
+                 GimpBoundaryStrip *strips)
+{
+  scan_strip (&strips[i]);
+}
+
+static GimpBoundary *
+generate_boundary (GeglBuffer          *buffer,
+                   const GeglRectangle *region,
+                   const Babl          *format,
+                   GimpBoundaryType     type,
+                   gint                 x1,
+                   gint                 y1,
+                   gint                 x2,
+                   gint                 y2,
+                   gfloat               threshold)
+{
+  GimpBoundary      *boundary;
+  GimpBoundaryScan   scan;
+  GimpBoundaryStrip *strips;
+  gint               n_threads = 1;
+  gint               first;
+  gint               i;
+
+  boundary = gimp_boundary_new (region);
+
+  scan.region    = region;
+  scan.type      = type;
+  scan.x1        = x1;
+  scan.y1        = y1;
+  scan.x2        = x2;
+  scan.y2        = y2;
+  scan.threshold = threshold;
+  scan.width     = gegl_buffer_get_width (buffer);
+  scan.start     = 0;
+  scan.end       = 0;
+
+  scan.strip_height = CLAMP (SCAN_STRIP_PIXELS / MAX (scan.width, 1),
+                             1, SCAN_STRIP_HEIGHT);
+
+  if (type == GIMP_BOUNDARY_WITHIN_BOUNDS)
+    {
+      scan.start = y1;
+      scan.end   = y2;
+    }
+  else if (type == GIMP_BOUNDARY_IGNORE_BOUNDS)
+    {
+      scan.start = region->y;
+      scan.end   = region->y + region->height;
+    }
+
+  if (scan.end - scan.start > scan.strip_height)
+    {
+      n_threads = CLAMP (gimp_parallel_get_n_threads (), 1,
+                         (scan.end - scan.start + scan.strip_height - 1) /
+                         scan.strip_height);
+    }
+
+  strips = g_new0 (GimpBoundaryStrip, n_threads);
+
+  for (i = 0; i < n_threads; i++)
+    {
+      GimpBoundaryStrip *strip = &strips[i];
+
+      strip->scan = &scan;
+      strip->data = g_new (gfloat, scan.width * (scan.strip_height + 2));
+
+      if (n_threads == 1)
+        {
+          /*  trace straight into the result  */
+          strip->boundary = boundary;
+        }
+      else
+        {
+          strip->boundary = gimp_boundary_new (NULL);
+
+          strip->boundary->max_empty_segs = boundary->max_empty_segs;
+          strip->boundary->empty_segs_n   = g_new (gint, boundary->max_empty_segs);
+          strip->boundary->empty_segs_c   = g_new (gint, boundary->max_empty_segs);
+          strip->boundary->empty_segs_l   = g_new (gint, boundary->max_empty_segs);
+        }
+    }
+
+  /*  The buffer is read on this thread, since the tile managers
+   *  behind drawable buffers don't allow concurrent access; only
+   *  the tracing of empty segments is spread over the threads.
+   *  The vertical segments which close the horizontal ones depend on
+   *  all scanlines above, so they are added afterwards, replaying the
+   *  horizontal segments of each strip in order.  This produces
+   *  exactly the segments, and segment order, of a single pass.
+   */
+  for (first = scan.start; first < scan.end;)
+    {
+      gint n_strips;
+
+      for (n_strips = 0;
+           n_strips < n_threads && first < scan.end;
+           n_strips++)
+        {
+          GimpBoundaryStrip *strip = &strips[n_strips];
+          GeglRectangle      rect;
+
+          strip->first       = first;
+          strip->last        = MIN (first + scan.strip_height, scan.end);
+          strip->data_y      = MAX (first - 1, scan.start);
+          strip->data_height = (MIN (strip->last, scan.end - 1) -
+                                strip->data_y + 1);
+
+          rect.x      = 0;
+          rect.y      = strip->data_y;
+          rect.width  = scan.width;
+          rect.height = strip->data_height;
+
+          gegl_buffer_get (buffer, &rect, 1.0, format,
+                           strip->data, GEGL_AUTO_ROWSTRIDE,
+                           GEGL_ABYSS_NONE);
+
+          if (strip->boundary != boundary)
+            strip->boundary->num_segs = 0;
+
+          first = strip->last;
+        }
+
+      gimp_parallel_distribute (n_strips,
+                                (GimpParallelDistributeFunc) scan_strip_func,
+                                strips);
+
+      for (i = 0; i < n_strips; i++)
+        {
+          GimpBoundary *strip_boundary = strips[i].boundary;
+          gint          j;
+
+          if (strip_boundary == boundary)
+            continue;
+
+          for (j = 0; j < strip_boundary->num_segs; j++)
+            {
+              const GimpBoundSeg *seg = &strip_boundary->segs[j];
+
+              process_horiz_seg (boundary,
+                                 seg->x1, seg->y1, seg->x2, seg->y2,
+                                 seg->open);
+            }
+        }
+    }
+
+  for (i = 0; i < n_threads; i++)
+    {
+      if (strips[i].boundary != boundary)
+        gimp_boundary_free (strips[i].boundary, TRUE);
+
+      g_free (strips[i].data);
+    }
+
+  g_free (strips);
 
   return boundary;
 }
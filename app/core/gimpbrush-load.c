@@ -162,7 +162,7 @@ gimp_brush_load_brush (GimpContext  *context,
   BrushHeader  header;
   gchar       *name = NULL;
   guchar      *pixmap;
-  guchar      *mask;
+  guchar      *mask = NULL;
   gssize       i, size;
   gboolean     success = TRUE;
 
@@ -290,16 +290,57 @@ gimp_brush_load_brush (GimpContext  *context,
                         NULL);
   g_free (name);
 
-  brush->mask = gimp_temp_buf_new (header.width, header.height,
-                                   babl_format ("Y u8"));
-
-  mask = gimp_temp_buf_get_data (brush->mask);
   size = header.width * header.height * header.bytes;
 
+  if (header.bytes == 1 || header.bytes == 4)
+    {
+      struct stat st;
+      goffset     offset = lseek (fd, 0, SEEK_CUR);
+
+      /*  plain 8 bit masks and RGBA pixmaps are stored as-is, defer
+       *  reading them until the brush is actually used
+       */
+      if (offset != -1 && fstat (fd, &st) == 0 &&
+          offset + size <= st.st_size)
+        {
+          if (header.bytes == 1)
+            {
+              brush->mask = gimp_temp_buf_new_lazy (header.width,
+                                                    header.height,
+                                                    babl_format ("Y u8"),
+                                                    filename, offset);
+            }
+          else
+            {
+              brush->pixmap =
+                gimp_temp_buf_new_lazy_interleaved (header.width,
+                                                    header.height,
+                                                    babl_format ("R'G'B' u8"),
+                                                    filename, offset, 4, 0);
+              brush->mask =
+                gimp_temp_buf_new_lazy_interleaved (header.width,
+                                                    header.height,
+                                                    babl_format ("Y u8"),
+                                                    filename, offset, 4, 3);
+            }
+
+          success = (lseek (fd, size, SEEK_CUR) == offset + size);
+        }
+    }
+
+  if (! brush->mask)
+    {
+      brush->mask = gimp_temp_buf_new (header.width, header.height,
+                                       babl_format ("Y u8"));
+
+      mask = gimp_temp_buf_get_data (brush->mask);
+    }
+
   switch (header.bytes)
     {
     case 1:
-      success = (read (fd, mask, size) == size);
+      if (mask)
+        success = (read (fd, mask, size) == size);
       break;
 
     case 2:  /*  cinepaint brush, 16 bit floats  */
@@ -342,36 +383,37 @@ gimp_brush_load_brush (GimpContext  *context,
       break;
 
     case 4:
-      {
-        guchar buf[8 * 1024];
+      if (mask)
+        {
+          guchar buf[8 * 1024];
 
-        brush->pixmap = gimp_temp_buf_new (header.width, header.height,
-                                           babl_format ("R'G'B' u8"));
-        pixmap = gimp_temp_buf_get_data (brush->pixmap);
+          brush->pixmap = gimp_temp_buf_new (header.width, header.height,
+                                             babl_format ("R'G'B' u8"));
+          pixmap = gimp_temp_buf_get_data (brush->pixmap);
 
-        for (i = 0; success && i < size;)
-          {
-            gssize  bytes = MIN (size - i, sizeof (buf));
+          for (i = 0; success && i < size;)
+            {
+              gssize  bytes = MIN (size - i, sizeof (buf));
 
-            success = (read (fd, buf, bytes) == bytes);
+              success = (read (fd, buf, bytes) == bytes);
 
-            if (success)
-              {
-                guchar *b = buf;
+              if (success)
+                {
+                  guchar *b = buf;
 
-                i += bytes;
+                  i += bytes;
 
-                for (; bytes > 0; bytes -= 4, pixmap += 3, mask++, b += 4)
-                  {
-                    pixmap[0] = b[0];
-                    pixmap[1] = b[1];
-                    pixmap[2] = b[2];
+                  for (; bytes > 0; bytes -= 4, pixmap += 3, mask++, b += 4)
+                    {
+                      pixmap[0] = b[0];
+                      pixmap[1] = b[1];
+                      pixmap[2] = b[2];
 
-                    mask[0]   = b[3];
-                  }
-              }
-          }
-      }
+                      mask[0]   = b[3];
+                    }
+                }
+            }
+        }
       break;
 
     default:
@@ -19,24 +19,55 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
 
 #include "core-types.h"
 
-#include "gegl/gimp-gegl-loops.h"
-
 #include "gimpbrush.h"
 #include "gimpbrush-transform.h"
 #include "gimptempbuf.h"
 
+#ifdef GIMP_BRUSH_TRANSFORM_SSE2
+#include <emmintrin.h>
+#endif
+
 
 #define MAX_BLUR_KERNEL 15
 
+#define FRACTION_ONE    (1 << GIMP_BRUSH_TRANSFORM_FRACTION_BITS)
+#define FRACTION_MASK   (FRACTION_ONE - 1)
+
+/*  the destination is resampled in blocks of this size, so the source
+ *  pixels of a block stay in cache even for rotated brushes
+ */
+#define BLOCK_SIZE      64
+
+
+typedef void (* GimpResampleMaskRowFunc) (const guchar *src,
+                                          gint          src_stride,
+                                          gint          src_width,
+                                          gint          src_height,
+                                          guchar       *dest,
+                                          gint          n_pixels,
+                                          gint          x_i,
+                                          gint          y_i,
+                                          gint          ux_i,
+                                          gint          uy_i);
+
 
 /*  local function prototypes  */
 
+static GimpTempBuf * gimp_brush_transform_buf        (GimpTempBuf       *source,
+                                                      gdouble            scale,
+                                                      gdouble            aspect_ratio,
+                                                      gdouble            angle,
+                                                      gdouble            hardness);
+
 static void    gimp_brush_transform_bounding_box     (GimpTempBuf       *brush,
                                                       const GimpMatrix3 *matrix,
                                                       gint              *x,
@@ -44,14 +75,30 @@ static void    gimp_brush_transform_bounding_box     (GimpTempBuf       *brush,
                                                       gint              *width,
                                                       gint              *height);
 
-static gdouble gimp_brush_transform_array_sum        (gfloat            *arr,
-                                                      gint               len);
-static void    gimp_brush_transform_fill_blur_kernel (gfloat            *arr,
-                                                      gint               len);
+static void    gimp_brush_transform_blur             (guchar            *data,
+                                                      gint               width,
+                                                      gint               height,
+                                                      gint               bpp,
+                                                      gint               radius);
 static gint    gimp_brush_transform_blur_kernel_size (gint               height,
                                                       gint               width,
                                                       gdouble            hardness);
 
+static void    gimp_brush_transform_resample_mask_row_scalar
+                                                     (const guchar      *src,
+                                                      gint               src_stride,
+                                                      gint               src_width,
+                                                      gint               src_height,
+                                                      guchar            *dest,
+                                                      gint               n_pixels,
+                                                      gint               x_i,
+                                                      gint               y_i,
+                                                      gint               ux_i,
+                                                      gint               uy_i);
+
+
+static GimpResampleMaskRowFunc resample_mask_row_func = NULL;
+
 
 /*  public functions  */
 
@@ -73,32 +120,6 @@ gimp_brush_real_transform_size (GimpBrush *brush,
   gimp_brush_transform_bounding_box (brush->mask, &matrix, &x, &y, width, height);
 }
 
-/*
- * Transforms the brush mask with bilinear interpolation.
- *
- * Rather than calculating the inverse transform for each point in the
- * transformed image, this algorithm uses the inverse transformed
- * corner points of the destination image to work out the starting
- * position in the source image and the U and V deltas in the source
- * image space.  It then uses a scan-line approach, looping through
- * rows and colummns in the transformed (destination) image while
- * walking along the corresponding rows and columns (named U and V) in
- * the source image.
- *
- * The horizontal in destination space (transform result) is reverse
- * transformed into source image space to get U.  The vertical in
- * destination space (transform result) is reverse transformed into
- * source image space to get V.
- *
- * The strength of this particular algorithm is that calculation work
- * should depend more upon the final transformed brush size rather
- * than the input brush size.
- *
- * There are no floating point calculations in the inner loop for speed.
- *
- * Some variables end with the suffix _i to indicate they have been
- * premultiplied by int_multiple
- */
 GimpTempBuf *
 gimp_brush_real_transform_mask (GimpBrush *brush,
                                 gdouble    scale,
@@ -106,274 +127,271 @@ gimp_brush_real_transform_mask (GimpBrush *brush,
                                 gdouble    angle,
                                 gdouble    hardness)
 {
-  GimpTempBuf  *result;
-  GimpTempBuf  *source;
-  guchar       *dest;
-  const guchar *src;
-  GimpMatrix3   matrix;
-  gint          src_width;
-  gint          src_height;
-  gint          src_width_minus_one;
-  gint          src_height_minus_one;
-  gint          dest_width;
-  gint          dest_height;
-  gint          x, y;
-  gdouble       blx, brx, tlx, trx;
-  gdouble       bly, bry, tly, try;
-  gdouble       src_tl_to_tr_delta_x;
-  gdouble       src_tl_to_tr_delta_y;
-  gdouble       src_tl_to_bl_delta_x;
-  gdouble       src_tl_to_bl_delta_y;
-  gint          src_walk_ux_i;
-  gint          src_walk_uy_i;
-  gint          src_walk_vx_i;
-  gint          src_walk_vy_i;
-  gint          src_space_cur_pos_x;
-  gint          src_space_cur_pos_y;
-  gint          src_space_cur_pos_x_i;
-  gint          src_space_cur_pos_y_i;
-  gint          src_space_row_start_x_i;
-  gint          src_space_row_start_y_i;
-  const guchar *src_walker;
-  const guchar *pixel_next;
-  const guchar *pixel_below;
-  const guchar *pixel_below_next;
-  gint          opposite_x, distance_from_true_x;
-  gint          opposite_y, distance_from_true_y;
-
-  /*
-   * tl, tr etc are used because it is easier to visualize top left,
-   * top right etc corners of the forward transformed source image
-   * rectangle.
-   */
-  const gint fraction_bits = 12;
-  const gint int_multiple  = pow (2, fraction_bits);
-
-  /* In inner loop's bilinear calculation, two numbers that were each
-   * previously multiplied by int_multiple are multiplied together.
-   * To get back the right result, the multiplication result must be
-   * divided *twice* by 2^fraction_bits, equivalent to bit shift right
-   * by 2 * fraction_bits
-   */
-  const gint recovery_bits = 2 * fraction_bits;
-
-  /*
-   * example: suppose fraction_bits = 9
-   * a 9-bit mask looks like this: 0001 1111 1111
-   * and is given by:  2^fraction_bits - 1
-   * demonstration:
-   * 2^0     = 0000 0000 0001
-   * 2^1     = 0000 0000 0010
-   * :
-   * 2^8     = 0001 0000 0000
-   * 2^9     = 0010 0000 0000
-   * 2^9 - 1 = 0001 1111 1111
-   */
-  const guint fraction_bitmask = pow(2, fraction_bits) - 1 ;
+  return gimp_brush_transform_buf (brush->mask,
+                                   scale, aspect_ratio, angle, hardness);
+}
 
-  source = brush->mask;
+GimpTempBuf *
+gimp_brush_real_transform_pixmap (GimpBrush *brush,
+                                  gdouble    scale,
+                                  gdouble    aspect_ratio,
+                                  gdouble    angle,
+                                  gdouble    hardness)
+{
+  return gimp_brush_transform_buf (brush->pixmap,
+                                   scale, aspect_ratio, angle, hardness);
+}
 
-  src_width  = gimp_temp_buf_get_width  (source);
-  src_height = gimp_temp_buf_get_height (source);
+void
+gimp_brush_transform_matrix (gdouble      width,
+                             gdouble      height,
+                             gdouble      scale,
+                             gdouble      aspect_ratio,
+                             gdouble      angle,
+                             GimpMatrix3 *matrix)
+{
+  const gdouble center_x = width  / 2;
+  const gdouble center_y = height / 2;
+  gdouble scale_x = scale;
+  gdouble scale_y = scale;
 
-  gimp_brush_transform_matrix (src_width, src_height,
-                               scale, aspect_ratio, angle, &matrix);
+  if (aspect_ratio < 0.0)
+    {
+      scale_x = scale * (1.0 - (fabs (aspect_ratio) / 20.0));
+      scale_y = scale;
+    }
+  else if (aspect_ratio > 0.0)
+    {
+      scale_x = scale;
+      scale_y = scale * (1.0 - (aspect_ratio  / 20.0));
+    }
 
-  if (gimp_matrix3_is_identity (&matrix))
-    return gimp_temp_buf_copy (source);
+  gimp_matrix3_identity (matrix);
+  gimp_matrix3_scale (matrix, scale_x, scale_y);
+  gimp_matrix3_translate (matrix, - center_x * scale_x, - center_y * scale_y);
+  gimp_matrix3_rotate (matrix, -2 * G_PI * angle);
+  gimp_matrix3_translate (matrix, center_x * scale_x, center_y * scale_y);
+}
 
-  src_width_minus_one  = src_width  - 1;
-  src_height_minus_one = src_height - 1;
 
-  gimp_brush_transform_bounding_box (source, &matrix,
-                                     &x, &y, &dest_width, &dest_height);
-  gimp_matrix3_translate (&matrix, -x, -y);
-  gimp_matrix3_invert (&matrix);
+/**
+ * gimp_brush_transform_resample_row_scalar:
+ * @src:        the source, padded as described below
+ * @src_stride: the number of pixels per row of @src
+ * @src_width:  the width of the source, without padding
+ * @src_height: the height of the source, without padding
+ * @bpp:        the bytes per pixel of @src and @dest
+ * @dest:       the destination row
+ * @n_pixels:   the number of pixels to write to @dest
+ * @x_i:        the source x of the first pixel, fixed point
+ * @y_i:        the source y of the first pixel, fixed point
+ * @ux_i:       the source x step per destination pixel, fixed point
+ * @uy_i:       the source y step per destination pixel, fixed point
+ *
+ * Resamples a row of a transformed brush bilinearly.  @src needs one
+ * more column and one more row than the brush, repeating its last
+ * ones, so the neighbours of a source pixel always exist.  Positions
+ * have GIMP_BRUSH_TRANSFORM_FRACTION_BITS bits of fraction, source
+ * pixels they don't hit give 0.
+ **/
+void
+gimp_brush_transform_resample_row_scalar (const guchar *src,
+                                          gint          src_stride,
+                                          gint          src_width,
+                                          gint          src_height,
+                                          gint          bpp,
+                                          guchar       *dest,
+                                          gint          n_pixels,
+                                          gint          x_i,
+                                          gint          y_i,
+                                          gint          ux_i,
+                                          gint          uy_i)
+{
+  const gint below = src_stride * bpp;
 
-  result = gimp_temp_buf_new (dest_width, dest_height,
-                              gimp_temp_buf_get_format (brush->mask));
+  for (; n_pixels > 0; n_pixels--, dest += bpp, x_i += ux_i, y_i += uy_i)
+    {
+      const gint    x = x_i >> GIMP_BRUSH_TRANSFORM_FRACTION_BITS;
+      const gint    y = y_i >> GIMP_BRUSH_TRANSFORM_FRACTION_BITS;
+      const guchar *p;
+      guint32       dx, dy;
+      guint32       ox, oy;
+      gint          b;
+
+      if (x < 0 || x >= src_width || y < 0 || y >= src_height)
+        {
+          for (b = 0; b < bpp; b++)
+            dest[b] = 0;
 
-  dest = gimp_temp_buf_get_data (result);
-  src  = gimp_temp_buf_get_data (source);
+          continue;
+        }
 
-  /* prevent disappearance of 1x1 pixel brush at some rotations when
-     scaling < 1 */
-  /*
-  if (src_width == 1 && src_height == 1 && scale_x < 1 && scale_y < 1 )
-    {
-      *dest = src[0];
-      return result;
-    }*/
+      p = src + (y * src_stride + x) * bpp;
 
-  gimp_matrix3_transform_point (&matrix, 0,          0,           &tlx, &tly);
-  gimp_matrix3_transform_point (&matrix, dest_width, 0,           &trx, &try);
-  gimp_matrix3_transform_point (&matrix, 0,          dest_height, &blx, &bly);
-  gimp_matrix3_transform_point (&matrix, dest_width, dest_height, &brx, &bry);
+      dx = x_i & FRACTION_MASK;
+      dy = y_i & FRACTION_MASK;
+      ox = FRACTION_ONE - dx;
+      oy = FRACTION_ONE - dy;
 
+      /*  the sums reach 255 << 24, so this must be unsigned  */
+      for (b = 0; b < bpp; b++)
+        dest[b] = ((p[b]         * ox + p[b + bpp]         * dx) * oy +
+                   (p[b + below] * ox + p[b + below + bpp] * dx) * dy) >>
+                  (2 * GIMP_BRUSH_TRANSFORM_FRACTION_BITS);
+    }
+}
 
-  /* in image space, calc U (what was horizontal originally)
-   * note: double precision
-   */
-  src_tl_to_tr_delta_x = trx - tlx;
-  src_tl_to_tr_delta_y = try - tly;
+#ifdef GIMP_BRUSH_TRANSFORM_SSE2
 
-  /* in image space, calc V (what was vertical originally)
-   * note: double precision
-   */
-  src_tl_to_bl_delta_x = blx - tlx;
-  src_tl_to_bl_delta_y = bly - tly;
+/* low 32 bits of the product of each 32-bit lane of a with w */
+static inline __m128i
+mullo_epi32_sse2 (const __m128i a,
+                  const __m128i w)
+{
+  const __m128i even = _mm_mul_epu32 (a, w);
+  const __m128i odd  = _mm_mul_epu32 (_mm_srli_epi64 (a, 32),
+                                      _mm_srli_epi64 (w, 32));
 
-  /* speed optimized, note conversion to int precision */
-  src_walk_ux_i = (gint) ((src_tl_to_tr_delta_x / dest_width)  * int_multiple);
-  src_walk_uy_i = (gint) ((src_tl_to_tr_delta_y / dest_width)  * int_multiple);
-  src_walk_vx_i = (gint) ((src_tl_to_bl_delta_x / dest_height) * int_multiple);
-  src_walk_vy_i = (gint) ((src_tl_to_bl_delta_y / dest_height) * int_multiple);
+  return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)),
+                             _mm_shuffle_epi32 (odd,  _MM_SHUFFLE (0, 0, 2, 0)));
+}
 
-  /* initialize current position in source space to the start position (tl)
-   * speed optimized, note conversion to int precision
-   */
-  src_space_cur_pos_x_i   = (gint) (tlx* int_multiple);
-  src_space_cur_pos_y_i   = (gint) (tly* int_multiple);
-  src_space_cur_pos_x     = (gint) (src_space_cur_pos_x_i >> fraction_bits);
-  src_space_cur_pos_y     = (gint) (src_space_cur_pos_y_i >> fraction_bits);
-  src_space_row_start_x_i = (gint) (tlx* int_multiple);
-  src_space_row_start_y_i = (gint) (tly* int_multiple);
+/*  Same as gimp_brush_transform_resample_row_scalar() for masks,
+ *  producing identical results, four pixels at a time.  The source
+ *  pixels are gathered as (left, right) pairs of 16 bit lanes, so one
+ *  _mm_madd_epi16() does the horizontal interpolation; pixels outside
+ *  the source gather zeros.
+ */
+void
+gimp_brush_transform_resample_row_sse2 (const guchar *src,
+                                        gint          src_stride,
+                                        gint          src_width,
+                                        gint          src_height,
+                                        guchar       *dest,
+                                        gint          n_pixels,
+                                        gint          x_i,
+                                        gint          y_i,
+                                        gint          ux_i,
+                                        gint          uy_i)
+{
+  const __m128i fraction_mask = _mm_set1_epi32 (FRACTION_MASK);
+  const __m128i fraction_one  = _mm_set1_epi32 (FRACTION_ONE);
+  const __m128i step_x        = _mm_set1_epi32 (4 * ux_i);
+  const __m128i step_y        = _mm_set1_epi32 (4 * uy_i);
+  __m128i       vx;
+  __m128i       vy;
 
+  vx = _mm_setr_epi32 (x_i, x_i + ux_i, x_i + 2 * ux_i, x_i + 3 * ux_i);
+  vy = _mm_setr_epi32 (y_i, y_i + uy_i, y_i + 2 * uy_i, y_i + 3 * uy_i);
 
-  for (y = 0; y < dest_height; y++)
+  for (; n_pixels >= 4; n_pixels -= 4, dest += 4)
     {
-      for (x = 0; x < dest_width; x++)
+      gint32   pos_x[4];
+      gint32   pos_y[4];
+      guint32  top[4];
+      guint32  bottom[4];
+      __m128i  dx, dy;
+      __m128i  wx;
+      __m128i  sum;
+      guint32  result;
+      gint     i;
+
+      _mm_storeu_si128 ((__m128i *) pos_x, vx);
+      _mm_storeu_si128 ((__m128i *) pos_y, vy);
+
+      for (i = 0; i < 4; i++)
         {
-          if (src_space_cur_pos_x > src_width_minus_one ||
-              src_space_cur_pos_x < 0     ||
-              src_space_cur_pos_y > src_height_minus_one ||
-              src_space_cur_pos_y < 0)
-              /* no corresponding pixel in source space */
+          const gint x = pos_x[i] >> GIMP_BRUSH_TRANSFORM_FRACTION_BITS;
+          const gint y = pos_y[i] >> GIMP_BRUSH_TRANSFORM_FRACTION_BITS;
+
+          if (x < 0 || x >= src_width || y < 0 || y >= src_height)
             {
-              *dest = 0;
+              top[i]    = 0;
+              bottom[i] = 0;
             }
-          else /* reverse transformed point hits source pixel */
+          else
             {
-              src_walker = src
-                        + src_space_cur_pos_y * src_width
-                        + src_space_cur_pos_x;
-
-              /* bottom right corner
-               * no pixel below, reuse current pixel instead
-               * no next pixel to the right so reuse current pixel instead
-               */
-              if (src_space_cur_pos_y == src_height_minus_one &&
-                  src_space_cur_pos_x == src_width_minus_one )
-                {
-                  pixel_next       = src_walker;
-                  pixel_below      = src_walker;
-                  pixel_below_next = src_walker;
-                }
-
-              /* bottom edge pixel row, except rightmost corner
-               * no pixel below, reuse current pixel instead  */
-              else if (src_space_cur_pos_y == src_height_minus_one)
-                {
-                  pixel_next       = src_walker + 1;
-                  pixel_below      = src_walker;
-                  pixel_below_next = src_walker + 1;
-                }
-
-              /* right edge pixel column, except bottom corner
-               * no next pixel to the right so reuse current pixel instead */
-              else if (src_space_cur_pos_x == src_width_minus_one)
-                {
-                  pixel_next       = src_walker;
-                  pixel_below      = src_walker + src_width;
-                  pixel_below_next = pixel_below;
-                }
-
-              /* neither on bottom edge nor on right edge */
-              else
-                {
-                  pixel_next       = src_walker + 1;
-                  pixel_below      = src_walker + src_width;
-                  pixel_below_next = pixel_below + 1;
-                }
-
-              distance_from_true_x = src_space_cur_pos_x_i & fraction_bitmask;
-              distance_from_true_y = src_space_cur_pos_y_i & fraction_bitmask;
-              opposite_x =  int_multiple - distance_from_true_x;
-              opposite_y =  int_multiple - distance_from_true_y;
-
-              *dest = ((src_walker[0] * opposite_x +
-                        pixel_next[0] * distance_from_true_x) * opposite_y +
-                       (pixel_below[0] * opposite_x +
-                        pixel_below_next[0] *distance_from_true_x) * distance_from_true_y
-                       ) >> recovery_bits;
+              const guchar *p = src + y * src_stride + x;
+
+              top[i]    = p[0]          | (p[1]              << 16);
+              bottom[i] = p[src_stride] | (p[src_stride + 1] << 16);
             }
+        }
 
-          src_space_cur_pos_x_i+=src_walk_ux_i;
-          src_space_cur_pos_y_i+=src_walk_uy_i;
+      dx = _mm_and_si128 (vx, fraction_mask);
+      dy = _mm_and_si128 (vy, fraction_mask);
 
-          src_space_cur_pos_x = src_space_cur_pos_x_i >> fraction_bits;
-          src_space_cur_pos_y = src_space_cur_pos_y_i >> fraction_bits;
+      /*  (1 - dx, dx) pairs, matching the (left, right) pairs  */
+      wx = _mm_or_si128 (_mm_sub_epi32 (fraction_one, dx),
+                         _mm_slli_epi32 (dx, 16));
 
-          dest ++;
-        } /* end for x */
+      sum = _mm_add_epi32 (mullo_epi32_sse2 (_mm_madd_epi16 (_mm_loadu_si128 ((const __m128i *) top),
+                                                             wx),
+                                             _mm_sub_epi32 (fraction_one, dy)),
+                           mullo_epi32_sse2 (_mm_madd_epi16 (_mm_loadu_si128 ((const __m128i *) bottom),
+                                                             wx),
+                                             dy));
 
-        src_space_row_start_x_i +=src_walk_vx_i;
-        src_space_row_start_y_i +=src_walk_vy_i;
-        src_space_cur_pos_x_i = src_space_row_start_x_i;
-        src_space_cur_pos_y_i = src_space_row_start_y_i;
+      sum = _mm_srli_epi32 (sum, 2 * GIMP_BRUSH_TRANSFORM_FRACTION_BITS);
+      sum = _mm_packs_epi32 (sum, sum);
+      sum = _mm_packus_epi16 (sum, sum);
 
-        src_space_cur_pos_x = src_space_cur_pos_x_i >> fraction_bits;
-        src_space_cur_pos_y = src_space_cur_pos_y_i >> fraction_bits;
+      result = _mm_cvtsi128_si32 (sum);
+      memcpy (dest, &result, 4);
 
-    } /* end for y */
+      vx = _mm_add_epi32 (vx, step_x);
+      vy = _mm_add_epi32 (vy, step_y);
 
-  if (hardness < 1.0)
-    {
-      GimpTempBuf *blur_src;
-      GeglBuffer  *src_buffer;
-      GeglBuffer  *dest_buffer;
-      gint         kernel_size =
-        gimp_brush_transform_blur_kernel_size (gimp_temp_buf_get_height (result),
-                                               gimp_temp_buf_get_width  (result),
-                                               hardness);
-      gint         kernel_len  = kernel_size * kernel_size;
-      gfloat       blur_kernel[kernel_len];
+      x_i += 4 * ux_i;
+      y_i += 4 * uy_i;
+    }
+
+  gimp_brush_transform_resample_row_scalar (src, src_stride,
+                                            src_width, src_height, 1,
+                                            dest, n_pixels,
+                                            x_i, y_i, ux_i, uy_i);
+}
 
-      gimp_brush_transform_fill_blur_kernel (blur_kernel, kernel_len);
+#endif /* GIMP_BRUSH_TRANSFORM_SSE2 */
 
-      blur_src = gimp_temp_buf_copy (result);
+/*  private functions  */
+
+static void
+gimp_brush_transform_bounding_box (GimpTempBuf       *brush,
+                                   const GimpMatrix3 *matrix,
+                                   gint              *x,
+                                   gint              *y,
+                                   gint              *width,
+                                   gint              *height)
+{
+  const gdouble  w = gimp_temp_buf_get_width  (brush);
+  const gdouble  h = gimp_temp_buf_get_height (brush);
+  gdouble        x1, x2, x3, x4;
+  gdouble        y1, y2, y3, y4;
+  gdouble        temp_x;
+  gdouble        temp_y;
 
-      src_buffer  = gimp_temp_buf_create_buffer (blur_src);
-      dest_buffer = gimp_temp_buf_create_buffer (result);
+  gimp_matrix3_transform_point (matrix, 0, 0, &x1, &y1);
+  gimp_matrix3_transform_point (matrix, w, 0, &x2, &y2);
+  gimp_matrix3_transform_point (matrix, 0, h, &x3, &y3);
+  gimp_matrix3_transform_point (matrix, w, h, &x4, &y4);
 
-      gimp_temp_buf_unref (blur_src);
+  temp_x = MIN (MIN (x1, x2), MIN (x3, x4));
+  temp_y = MIN (MIN (y1, y2), MIN (y3, y4));
 
-      gimp_gegl_convolve (src_buffer,
-                          GEGL_RECTANGLE (0, 0,
-                                          gimp_temp_buf_get_width  (blur_src),
-                                          gimp_temp_buf_get_height (blur_src)),
-                          dest_buffer,
-                          GEGL_RECTANGLE (0, 0,
-                                          gimp_temp_buf_get_width  (result),
-                                          gimp_temp_buf_get_height (result)),
-                          blur_kernel, kernel_size,
-                          gimp_brush_transform_array_sum (blur_kernel,
-                                                          kernel_len),
-                          GIMP_NORMAL_CONVOL, FALSE);
+  *width  = (gint) ceil (MAX (MAX (x1, x2), MAX (x3, x4)) - temp_x);
+  *height = (gint) ceil (MAX (MAX (y1, y2), MAX (y3, y4)) - temp_y);
 
-      g_object_unref (src_buffer);
-      g_object_unref (dest_buffer);
-    }
+  *x = floor (temp_x);
+  *y = floor (temp_y);
 
-  return result;
+  /* Transform size can not be less than 1 px */
+  *width  = MAX (1, *width);
+  *height = MAX (1, *height);
 }
 
 /*
- * Transforms the brush pixmap with bilinear interpolation.
- *
- * The algorithm used is exactly the same as for the brush mask
- * (gimp_brush_real_transform_mask) except it accounts for 3 color channels
- *  instead of 1 greyscale channel.
+ * Transforms a brush mask or pixmap with bilinear interpolation.
  *
  * Rather than calculating the inverse transform for each point in the
  * transformed image, this algorithm uses the inverse transformed
@@ -393,85 +411,49 @@ gimp_brush_real_transform_mask (GimpBrush *brush,
  * should depend more upon the final transformed brush size rather
  * than the input brush size.
  *
- * There are no floating point calculations in the inner loop for speed.
+ * There are no floating point calculations in the inner loop for
+ * speed, and no edge cases either: the source is copied with its last
+ * column and row repeated, so every pixel hit has a right and a lower
+ * neighbour.  The walk is done in blocks of BLOCK_SIZE x BLOCK_SIZE
+ * destination pixels; the start of each block row is computed from
+ * the block origin, which gives the same positions as walking whole
+ * rows.
  *
  * Some variables end with the suffix _i to indicate they have been
- * premultiplied by int_multiple
+ * premultiplied by FRACTION_ONE.
  */
-GimpTempBuf *
-gimp_brush_real_transform_pixmap (GimpBrush *brush,
-                                  gdouble    scale,
-                                  gdouble    aspect_ratio,
-                                  gdouble    angle,
-                                  gdouble    hardness)
+static GimpTempBuf *
+gimp_brush_transform_buf (GimpTempBuf *source,
+                          gdouble      scale,
+                          gdouble      aspect_ratio,
+                          gdouble      angle,
+                          gdouble      hardness)
 {
   GimpTempBuf  *result;
-  GimpTempBuf  *source;
+  const Babl   *format;
   guchar       *dest;
   const guchar *src;
+  guchar       *padded;
   GimpMatrix3   matrix;
+  gint          bpp;
   gint          src_width;
   gint          src_height;
-  gint          src_width_minus_one;
-  gint          src_height_minus_one;
+  gint          padded_stride;
   gint          dest_width;
   gint          dest_height;
   gint          x, y;
-  gdouble       blx, brx, tlx, trx;
-  gdouble       bly, bry, tly, try;
-  gdouble       src_tl_to_tr_delta_x;
-  gdouble       src_tl_to_tr_delta_y;
-  gdouble       src_tl_to_bl_delta_x;
-  gdouble       src_tl_to_bl_delta_y;
+  gint          bx, by;
+  gdouble       blx, tlx, trx;
+  gdouble       bly, tly, try;
   gint          src_walk_ux_i;
   gint          src_walk_uy_i;
   gint          src_walk_vx_i;
   gint          src_walk_vy_i;
-  gint          src_space_cur_pos_x;
-  gint          src_space_cur_pos_y;
-  gint          src_space_cur_pos_x_i;
-  gint          src_space_cur_pos_y_i;
-  gint          src_space_row_start_x_i;
-  gint          src_space_row_start_y_i;
-  const guchar *src_walker;
-  const guchar *pixel_next;
-  const guchar *pixel_below;
-  const guchar *pixel_below_next;
-  gint          opposite_x, distance_from_true_x;
-  gint          opposite_y, distance_from_true_y;
-
-  /*
-   * tl, tr etc are used because it is easier to visualize top left,
-   * top right etc corners of the forward transformed source image
-   * rectangle.
-   */
-  const gint fraction_bits = 12;
-  const gint int_multiple  = pow(2,fraction_bits);
-
-  /* In inner loop's bilinear calculation, two numbers that were each
-   * previously multiplied by int_multiple are multiplied together.
-   * To get back the right result, the multiplication result must be
-   * divided *twice* by 2^fraction_bits, equivalent to bit shift right
-   * by 2 * fraction_bits
-   */
-  const gint recovery_bits = 2 * fraction_bits;
-
-  /*
-   * example: suppose fraction_bits = 9
-   * a 9-bit mask looks like this: 0001 1111 1111
-   * and is given by:  2^fraction_bits - 1
-   * demonstration:
-   * 2^0     = 0000 0000 0001
-   * 2^1     = 0000 0000 0010
-   * :
-   * 2^8     = 0001 0000 0000
-   * 2^9     = 0010 0000 0000
-   * 2^9 - 1 = 0001 1111 1111
-   */
-  const guint fraction_bitmask = pow(2, fraction_bits)- 1 ;
-
-  source = brush->pixmap;
+  gint          src_start_x_i;
+  gint          src_start_y_i;
 
+  format     = gimp_temp_buf_get_format (source);
+  bpp        = babl_format_get_bytes_per_pixel (format);
   src_width  = gimp_temp_buf_get_width  (source);
   src_height = gimp_temp_buf_get_height (source);
 
@@ -481,294 +463,193 @@ gimp_brush_real_transform_pixmap (GimpBrush *brush,
   if (gimp_matrix3_is_identity (&matrix))
     return gimp_temp_buf_copy (source);
 
-  src_width_minus_one  = src_width  - 1;
-  src_height_minus_one = src_height - 1;
-
   gimp_brush_transform_bounding_box (source, &matrix,
                                      &x, &y, &dest_width, &dest_height);
   gimp_matrix3_translate (&matrix, -x, -y);
   gimp_matrix3_invert (&matrix);
 
-  result = gimp_temp_buf_new (dest_width, dest_height,
-                              gimp_temp_buf_get_format (brush->pixmap));
+  result = gimp_temp_buf_new (dest_width, dest_height, format);
 
   dest = gimp_temp_buf_get_data (result);
   src  = gimp_temp_buf_get_data (source);
 
+  /*  tl, tr etc are the top left, top right etc corners of the
+   *  destination, reverse transformed into source image space
+   */
   gimp_matrix3_transform_point (&matrix, 0,          0,           &tlx, &tly);
   gimp_matrix3_transform_point (&matrix, dest_width, 0,           &trx, &try);
   gimp_matrix3_transform_point (&matrix, 0,          dest_height, &blx, &bly);
-  gimp_matrix3_transform_point (&matrix, dest_width, dest_height, &brx, &bry);
 
+  /*  U is tl to tr, V is tl to bl, per destination pixel  */
+  src_walk_ux_i = (gint) (((trx - tlx) / dest_width)  * FRACTION_ONE);
+  src_walk_uy_i = (gint) (((try - tly) / dest_width)  * FRACTION_ONE);
+  src_walk_vx_i = (gint) (((blx - tlx) / dest_height) * FRACTION_ONE);
+  src_walk_vy_i = (gint) (((bly - tly) / dest_height) * FRACTION_ONE);
 
-  /* in image space, calc U (what was horizontal originally)
-   * note: double precision
-   */
-  src_tl_to_tr_delta_x = trx - tlx;
-  src_tl_to_tr_delta_y = try - tly;
+  src_start_x_i = (gint) (tlx * FRACTION_ONE);
+  src_start_y_i = (gint) (tly * FRACTION_ONE);
 
-  /* in image space, calc V (what was vertical originally)
-   * note: double precision
-   */
-  src_tl_to_bl_delta_x = blx - tlx;
-  src_tl_to_bl_delta_y = bly - tly;
+  /*  copy the source with its last column and row repeated  */
+  padded_stride = src_width + 1;
+  padded        = g_new (guchar, padded_stride * (src_height + 1) * bpp);
 
-  /* speed optimized, note conversion to int precision */
-  src_walk_ux_i = (gint) ((src_tl_to_tr_delta_x / dest_width)* int_multiple);
-  src_walk_uy_i = (gint) ((src_tl_to_tr_delta_y / dest_width)* int_multiple);
-  src_walk_vx_i = (gint) ((src_tl_to_bl_delta_x / dest_height)* int_multiple);
-  src_walk_vy_i = (gint) ((src_tl_to_bl_delta_y / dest_height)* int_multiple);
+  for (y = 0; y < src_height; y++)
+    {
+      guchar *row = padded + y * padded_stride * bpp;
 
-  /* initialize current position in source space to the start position (tl)
-   * speed optimized, note conversion to int precision
-   */
-  src_space_cur_pos_x_i    = (gint) (tlx* int_multiple);
-  src_space_cur_pos_y_i    = (gint) (tly* int_multiple);
-  src_space_cur_pos_x      = (gint) (src_space_cur_pos_x_i >> fraction_bits);
-  src_space_cur_pos_y      = (gint) (src_space_cur_pos_y_i >> fraction_bits);
-  src_space_row_start_x_i  = (gint) (tlx* int_multiple);
-  src_space_row_start_y_i  = (gint) (tly* int_multiple);
+      memcpy (row, src + y * src_width * bpp, src_width * bpp);
+      memcpy (row + src_width * bpp, row + (src_width - 1) * bpp, bpp);
+    }
 
+  memcpy (padded + src_height * padded_stride * bpp,
+          padded + (src_height - 1) * padded_stride * bpp,
+          padded_stride * bpp);
 
-  for (y = 0; y < dest_height; y++)
+  if (bpp == 1 && ! resample_mask_row_func)
     {
-      for (x = 0; x < dest_width; x++)
-        {
-          if (src_space_cur_pos_x > src_width_minus_one  ||
-              src_space_cur_pos_x < 0     ||
-              src_space_cur_pos_y > src_height_minus_one ||
-              src_space_cur_pos_y < 0)
-              /* no corresponding pixel in source space */
-            {
-              dest[0] = 0;
-              dest[1] = 0;
-              dest[2] = 0;
-            }
-          else /* reverse transformed point hits source pixel */
-            {
-              src_walker = src
-                        + 3 * (
-                          src_space_cur_pos_y * src_width
-                        + src_space_cur_pos_x);
-
-              /* bottom right corner
-               * no pixel below, reuse current pixel instead
-               * no next pixel to the right so reuse current pixel instead
-               */
-              if (src_space_cur_pos_y == src_height_minus_one &&
-                  src_space_cur_pos_x == src_width_minus_one )
-                {
-                  pixel_next  = src_walker;
-                  pixel_below = src_walker;
-                  pixel_below_next = src_walker;
-                }
-
-              /* bottom edge pixel row, except rightmost corner
-               * no pixel below, reuse current pixel instead  */
-              else if (src_space_cur_pos_y == src_height_minus_one)
-                {
-                  pixel_next  = src_walker + 3;
-                  pixel_below = src_walker;
-                  pixel_below_next = src_walker + 3;
-                }
-
-              /* right edge pixel column, except bottom corner
-               * no next pixel to the right so reuse current pixel instead */
-              else if (src_space_cur_pos_x == src_width_minus_one)
-                {
-                  pixel_next  = src_walker;
-                  pixel_below = src_walker + src_width * 3;
-                  pixel_below_next = pixel_below;
-                }
-
-              /* neither on bottom edge nor on right edge */
-              else
-                {
-                  pixel_next  = src_walker + 3;
-                  pixel_below = src_walker + src_width * 3;
-                  pixel_below_next = pixel_below + 3;
-                }
-
-              distance_from_true_x = src_space_cur_pos_x_i & fraction_bitmask;
-              distance_from_true_y = src_space_cur_pos_y_i & fraction_bitmask;
-              opposite_x =  int_multiple - distance_from_true_x;
-              opposite_y =  int_multiple - distance_from_true_y;
-
-              dest[0] = ((src_walker[0] * opposite_x +
-                          pixel_next[0] * distance_from_true_x) * opposite_y +
-                         (pixel_below[0] * opposite_x +
-                          pixel_below_next[0] *distance_from_true_x) * distance_from_true_y
-                        ) >> recovery_bits;
-
-              dest[1] = ((src_walker[1] * opposite_x +
-                          pixel_next[1] * distance_from_true_x) * opposite_y +
-                         (pixel_below[1] * opposite_x +
-                          pixel_below_next[1] *distance_from_true_x) * distance_from_true_y
-                        ) >> recovery_bits;
-
-              dest[2] = ((src_walker[2] * opposite_x +
-                          pixel_next[2] * distance_from_true_x) * opposite_y +
-                         (pixel_below[2] * opposite_x +
-                          pixel_below_next[2] *distance_from_true_x) * distance_from_true_y
-                        ) >> recovery_bits;
-            }
+      resample_mask_row_func = gimp_brush_transform_resample_mask_row_scalar;
 
-          src_space_cur_pos_x_i += src_walk_ux_i;
-          src_space_cur_pos_y_i += src_walk_uy_i;
+#ifdef GIMP_BRUSH_TRANSFORM_SSE2
+      if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+        resample_mask_row_func = gimp_brush_transform_resample_row_sse2;
+#endif
+    }
 
-          src_space_cur_pos_x = src_space_cur_pos_x_i >> fraction_bits;
-          src_space_cur_pos_y = src_space_cur_pos_y_i >> fraction_bits;
+  for (by = 0; by < dest_height; by += BLOCK_SIZE)
+    {
+      const gint block_height = MIN (BLOCK_SIZE, dest_height - by);
 
-          dest += 3;
-        } /* end for x */
+      for (bx = 0; bx < dest_width; bx += BLOCK_SIZE)
+        {
+          const gint block_width = MIN (BLOCK_SIZE, dest_width - bx);
 
-        src_space_row_start_x_i +=src_walk_vx_i;
-        src_space_row_start_y_i +=src_walk_vy_i;
-        src_space_cur_pos_x_i = src_space_row_start_x_i;
-        src_space_cur_pos_y_i = src_space_row_start_y_i;
+          for (y = by; y < by + block_height; y++)
+            {
+              const gint x_i = (src_start_x_i +
+                                bx * src_walk_ux_i + y * src_walk_vx_i);
+              const gint y_i = (src_start_y_i +
+                                bx * src_walk_uy_i + y * src_walk_vy_i);
+              guchar    *d   = dest + (y * dest_width + bx) * bpp;
+
+              if (bpp == 1)
+                resample_mask_row_func (padded, padded_stride,
+                                        src_width, src_height,
+                                        d, block_width,
+                                        x_i, y_i,
+                                        src_walk_ux_i, src_walk_uy_i);
+              else
+                gimp_brush_transform_resample_row_scalar (padded,
+                                                          padded_stride,
+                                                          src_width,
+                                                          src_height,
+                                                          bpp,
+                                                          d, block_width,
+                                                          x_i, y_i,
+                                                          src_walk_ux_i,
+                                                          src_walk_uy_i);
+            }
+        }
+    }
 
-        src_space_cur_pos_x = src_space_cur_pos_x_i >> fraction_bits;
-        src_space_cur_pos_y = src_space_cur_pos_y_i >> fraction_bits;
-    } /* end for y */
+  g_free (padded);
 
   if (hardness < 1.0)
     {
-      GimpTempBuf *blur_src;
-      GeglBuffer  *src_buffer;
-      GeglBuffer  *dest_buffer;
-      gint         kernel_size =
-        gimp_brush_transform_blur_kernel_size (gimp_temp_buf_get_height (result),
-                                               gimp_temp_buf_get_width  (result),
+      gint kernel_size =
+        gimp_brush_transform_blur_kernel_size (dest_height, dest_width,
                                                hardness);
-      gint         kernel_len  = kernel_size * kernel_size;
-      gfloat       blur_kernel[kernel_len];
 
-      gimp_brush_transform_fill_blur_kernel (blur_kernel, kernel_len);
-
-      blur_src = gimp_temp_buf_copy (result);
-
-      src_buffer  = gimp_temp_buf_create_buffer (blur_src);
-      dest_buffer = gimp_temp_buf_create_buffer (result);
-
-      gimp_temp_buf_unref (blur_src);
-
-      gimp_gegl_convolve (src_buffer,
-                          GEGL_RECTANGLE (0, 0,
-                                          gimp_temp_buf_get_width  (blur_src),
-                                          gimp_temp_buf_get_height (blur_src)),
-                          dest_buffer,
-                          GEGL_RECTANGLE (0, 0,
-                                          gimp_temp_buf_get_width  (result),
-                                          gimp_temp_buf_get_height (result)),
-                          blur_kernel, kernel_size,
-                          gimp_brush_transform_array_sum (blur_kernel,
-                                                          kernel_len),
-                          GIMP_NORMAL_CONVOL, FALSE);
-
-      g_object_unref (src_buffer);
-      g_object_unref (dest_buffer);
+      gimp_brush_transform_blur (dest, dest_width, dest_height, bpp,
+                                 kernel_size / 2);
     }
 
   return result;
 }
 
-void
-gimp_brush_transform_matrix (gdouble      width,
-                             gdouble      height,
-                             gdouble      scale,
-                             gdouble      aspect_ratio,
-                             gdouble      angle,
-                             GimpMatrix3 *matrix)
+/*  A box blur of the given radius, done as two separable passes with
+ *  running sums, so its cost doesn't depend on the radius.  Pixels
+ *  outside the buffer count as 0, which makes the edges fade out.
+ */
+static void
+gimp_brush_transform_blur (guchar *data,
+                           gint    width,
+                           gint    height,
+                           gint    bpp,
+                           gint    radius)
 {
-  const gdouble center_x = width  / 2;
-  const gdouble center_y = height / 2;
-  gdouble scale_x = scale;
-  gdouble scale_y = scale;
+  const gint  n      = 2 * radius + 1;
+  const gint  stride = width * bpp;
+  guchar     *tmp;
+  guint      *sums;
+  gint        x, y, b;
 
-  if (aspect_ratio < 0.0)
-    {
-      scale_x = scale * (1.0 - (fabs (aspect_ratio) / 20.0));
-      scale_y = scale;
-    }
-  else if (aspect_ratio > 0.0)
-    {
-      scale_x = scale;
-      scale_y = scale * (1.0 - (aspect_ratio  / 20.0));
-    }
+  if (radius < 1)
+    return;
 
-  gimp_matrix3_identity (matrix);
-  gimp_matrix3_scale (matrix, scale_x, scale_y);
-  gimp_matrix3_translate (matrix, - center_x * scale_x, - center_y * scale_y);
-  gimp_matrix3_rotate (matrix, -2 * G_PI * angle);
-  gimp_matrix3_translate (matrix, center_x * scale_x, center_y * scale_y);
-}
+  tmp  = g_new (guchar, height * stride);
+  sums = g_new0 (guint, stride);
 
+  /*  horizontal pass, data to tmp  */
+  for (y = 0; y < height; y++)
+    {
+      const guchar *s = data + y * stride;
+      guchar       *d = tmp  + y * stride;
 
-/*  private functions  */
+      for (b = 0; b < bpp; b++)
+        {
+          guint sum = 0;
 
-static void
-gimp_brush_transform_bounding_box (GimpTempBuf       *brush,
-                                   const GimpMatrix3 *matrix,
-                                   gint              *x,
-                                   gint              *y,
-                                   gint              *width,
-                                   gint              *height)
-{
-  const gdouble  w = gimp_temp_buf_get_width  (brush);
-  const gdouble  h = gimp_temp_buf_get_height (brush);
-  gdouble        x1, x2, x3, x4;
-  gdouble        y1, y2, y3, y4;
-  gdouble        temp_x;
-  gdouble        temp_y;
+          for (x = 0; x < MIN (radius, width); x++)
+            sum += s[x * bpp + b];
 
-  gimp_matrix3_transform_point (matrix, 0, 0, &x1, &y1);
-  gimp_matrix3_transform_point (matrix, w, 0, &x2, &y2);
-  gimp_matrix3_transform_point (matrix, 0, h, &x3, &y3);
-  gimp_matrix3_transform_point (matrix, w, h, &x4, &y4);
-
-  temp_x = MIN (MIN (x1, x2), MIN (x3, x4));
-  temp_y = MIN (MIN (y1, y2), MIN (y3, y4));
+          for (x = 0; x < width; x++)
+            {
+              if (x + radius < width)
+                sum += s[(x + radius) * bpp + b];
 
-  *width  = (gint) ceil (MAX (MAX (x1, x2), MAX (x3, x4)) - temp_x);
-  *height = (gint) ceil (MAX (MAX (y1, y2), MAX (y3, y4)) - temp_y);
+              d[x * bpp + b] = (sum + n / 2) / n;
 
-  *x = floor (temp_x);
-  *y = floor (temp_y);
+              if (x - radius >= 0)
+                sum -= s[(x - radius) * bpp + b];
+            }
+        }
+    }
 
-  /* Transform size can not be less than 1 px */
-  *width  = MAX (1, *width);
-  *height = MAX (1, *height);
-}
+  /*  vertical pass, tmp back to data  */
+  for (y = 0; y < MIN (radius, height); y++)
+    {
+      const guchar *s = tmp + y * stride;
 
-static gdouble
-gimp_brush_transform_array_sum (gfloat *arr,
-                                gint    len)
-{
-  gfloat total = 0;
-  gint   i;
+      for (x = 0; x < stride; x++)
+        sums[x] += s[x];
+    }
 
-  for (i = 0; i < len; i++)
+  for (y = 0; y < height; y++)
     {
-      total += arr [i];
-    }
+      guchar *d = data + y * stride;
 
-  return total;
-}
+      if (y + radius < height)
+        {
+          const guchar *s = tmp + (y + radius) * stride;
 
-static void
-gimp_brush_transform_fill_blur_kernel (gfloat *arr,
-                                       gint    len)
-{
-  gint half_point = ((gint) len / 2) + 1;
-  gint i;
+          for (x = 0; x < stride; x++)
+            sums[x] += s[x];
+        }
 
-  for (i = 0; i < len; i++)
-    {
-      if (i < half_point)
-        arr [i] = half_point - i;
-      else
-        arr [i] = i - half_point;
+      for (x = 0; x < stride; x++)
+        d[x] = (sums[x] + n / 2) / n;
+
+      if (y - radius >= 0)
+        {
+          const guchar *s = tmp + (y - radius) * stride;
+
+          for (x = 0; x < stride; x++)
+            sums[x] -= s[x];
+        }
     }
+
+  g_free (sums);
+  g_free (tmp);
 }
 
 static gint
@@ -787,3 +668,21 @@ gimp_brush_transform_blur_kernel_size (gint    height,
 
   return kernel_size;
 }
+
+static void
+gimp_brush_transform_resample_mask_row_scalar (const guchar *src,
+                                               gint          src_stride,
+                                               gint          src_width,
+                                               gint          src_height,
+                                               guchar       *dest,
+                                               gint          n_pixels,
+                                               gint          x_i,
+                                               gint          y_i,
+                                               gint          ux_i,
+                                               gint          uy_i)
+{
+  gimp_brush_transform_resample_row_scalar (src, src_stride,
+                                            src_width, src_height, 1,
+                                            dest, n_pixels,
+                                            x_i, y_i, ux_i, uy_i);
+}
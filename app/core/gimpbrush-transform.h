@@ -21,6 +21,16 @@
 #define __GIMP_BRUSH_TRANSFORM_H__
 
 
+/*  source positions of the resampling loops have this many bits of
+ *  fraction
+ */
+#define GIMP_BRUSH_TRANSFORM_FRACTION_BITS 12
+
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define GIMP_BRUSH_TRANSFORM_SSE2 1
+#endif
+
+
 /*  virtual functions of GimpBrush, don't call directly  */
 
 void          gimp_brush_real_transform_size   (GimpBrush   *brush,
@@ -48,4 +58,32 @@ void          gimp_brush_transform_matrix      (gdouble      width,
                                                 GimpMatrix3 *matrix);
 
 
+/*  the resampling loops, exposed for testing  */
+
+void   gimp_brush_transform_resample_row_scalar (const guchar *src,
+                                                 gint          src_stride,
+                                                 gint          src_width,
+                                                 gint          src_height,
+                                                 gint          bpp,
+                                                 guchar       *dest,
+                                                 gint          n_pixels,
+                                                 gint          x_i,
+                                                 gint          y_i,
+                                                 gint          ux_i,
+                                                 gint          uy_i);
+
+#ifdef GIMP_BRUSH_TRANSFORM_SSE2
+void   gimp_brush_transform_resample_row_sse2   (const guchar *src,
+                                                 gint          src_stride,
+                                                 gint          src_width,
+                                                 gint          src_height,
+                                                 guchar       *dest,
+                                                 gint          n_pixels,
+                                                 gint          x_i,
+                                                 gint          y_i,
+                                                 gint          ux_i,
+                                                 gint          uy_i);
+#endif
+
+
 #endif  /*  __GIMP_BRUSH_TRANSFORM_H__  */
@@ -416,13 +416,18 @@ static void
 gimp_brush_real_begin_use (GimpBrush *brush)
 {
   brush->mask_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'M', 'm');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          (GimpBrushCacheSizeFunc) gimp_temp_buf_get_memsize,
+                          'M', 'm');
 
   brush->pixmap_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'P', 'p');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          (GimpBrushCacheSizeFunc) gimp_temp_buf_get_memsize,
+                          'P', 'p');
 
   brush->boundary_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free, 'B', 'b');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free,
+                          NULL, 'B', 'b');
 }
 
 static void
@@ -464,11 +469,9 @@ gimp_brush_get_checksum (GimpTagged *tagged)
     {
       GChecksum *checksum = g_checksum_new (G_CHECKSUM_MD5);
 
-      g_checksum_update (checksum, gimp_temp_buf_get_data (brush->mask),
-                         gimp_temp_buf_get_data_size (brush->mask));
+      gimp_temp_buf_update_checksum (brush->mask, checksum);
       if (brush->pixmap)
-        g_checksum_update (checksum, gimp_temp_buf_get_data (brush->pixmap),
-                           gimp_temp_buf_get_data_size (brush->pixmap));
+        gimp_temp_buf_update_checksum (brush->pixmap, checksum);
       g_checksum_update (checksum, (const guchar *) &brush->spacing, sizeof (brush->spacing));
       g_checksum_update (checksum, (const guchar *) &brush->x_axis, sizeof (brush->x_axis));
       g_checksum_update (checksum, (const guchar *) &brush->y_axis, sizeof (brush->y_axis));
@@ -22,18 +22,53 @@
 
 #include <gegl.h>
 
+#include "libgimpmath/gimpmath.h"
+
 #include "core-types.h"
 
+#include "gimp-utils.h"
 #include "gimpbrushcache.h"
 
 #include "gimp-log.h"
 #include "gimp-intl.h"
 
 
+/*  the cache keeps this many transformed brushes at most...  */
+#define MAX_N_UNITS  32
+
+/*  ...but not more memory than this, a single unit is always kept  */
+#define MAX_MEMSIZE  (16 * 1024 * 1024)
+
+/*  transform parameters closer than these steps share a cache unit  */
+#define SCALE_STEP         (1.0 / 256.0)
+#define ASPECT_RATIO_STEP  (1.0 / 64.0)
+#define ANGLE_STEP         (1.0 / 1024.0)
+#define HARDNESS_STEP      (1.0 / 256.0)
+
+#define QUANTIZE(value,step) ((gint) RINT ((value) / (step)))
+
+
 enum
 {
   PROP_0,
-  PROP_DATA_DESTROY
+  PROP_DATA_DESTROY,
+  PROP_DATA_SIZE
+};
+
+
+typedef struct _GimpBrushCacheUnit GimpBrushCacheUnit;
+
+struct _GimpBrushCacheUnit
+{
+  gpointer data;
+  gsize    memsize;
+
+  gint     width;
+  gint     height;
+  gint     scale;
+  gint     aspect_ratio;
+  gint     angle;
+  gint     hardness;
 };
 
 
@@ -48,6 +83,13 @@ static void   gimp_brush_cache_get_property (GObject      *object,
                                              GValue       *value,
                                              GParamSpec   *pspec);
 
+static gint64 gimp_brush_cache_get_memsize  (GimpObject   *object,
+                                             gint64       *gui_size);
+
+static void   gimp_brush_cache_unit_free    (GimpBrushCache     *cache,
+                                             GimpBrushCacheUnit *unit);
+static void   gimp_brush_cache_log_stats    (GimpBrushCache     *cache);
+
 
 G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
 
@@ -57,18 +99,27 @@ G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
 static void
 gimp_brush_cache_class_init (GimpBrushCacheClass *klass)
 {
-  GObjectClass  *object_class = G_OBJECT_CLASS (klass);
+  GObjectClass    *object_class      = G_OBJECT_CLASS (klass);
+  GimpObjectClass *gimp_object_class = GIMP_OBJECT_CLASS (klass);
+
+  object_class->constructed       = gimp_brush_cache_constructed;
+  object_class->finalize          = gimp_brush_cache_finalize;
+  object_class->set_property      = gimp_brush_cache_set_property;
+  object_class->get_property      = gimp_brush_cache_get_property;
 
-  object_class->constructed  = gimp_brush_cache_constructed;
-  object_class->finalize     = gimp_brush_cache_finalize;
-  object_class->set_property = gimp_brush_cache_set_property;
-  object_class->get_property = gimp_brush_cache_get_property;
+  gimp_object_class->get_memsize  = gimp_brush_cache_get_memsize;
 
   g_object_class_install_property (object_class, PROP_DATA_DESTROY,
                                    g_param_spec_pointer ("data-destroy",
                                                          NULL, NULL,
                                                          GIMP_PARAM_READWRITE |
                                                          G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_DATA_SIZE,
+                                   g_param_spec_pointer ("data-size",
+                                                         NULL, NULL,
+                                                         GIMP_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT_ONLY));
 }
 
 static void
@@ -92,11 +143,7 @@ gimp_brush_cache_finalize (GObject *object)
 {
   GimpBrushCache *cache = GIMP_BRUSH_CACHE (object);
 
-  if (cache->last_data)
-    {
-      cache->data_destroy (cache->last_data);
-      cache->last_data = NULL;
-    }
+  gimp_brush_cache_clear (cache);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -114,6 +161,9 @@ gimp_brush_cache_set_property (GObject      *object,
     case PROP_DATA_DESTROY:
       cache->data_destroy = g_value_get_pointer (value);
       break;
+    case PROP_DATA_SIZE:
+      cache->data_size = g_value_get_pointer (value);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -134,6 +184,9 @@ gimp_brush_cache_get_property (GObject    *object,
     case PROP_DATA_DESTROY:
       g_value_set_pointer (value, cache->data_destroy);
       break;
+    case PROP_DATA_SIZE:
+      g_value_set_pointer (value, cache->data_size);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -141,13 +194,29 @@ gimp_brush_cache_get_property (GObject    *object,
     }
 }
 
+static gint64
+gimp_brush_cache_get_memsize (GimpObject *object,
+                              gint64     *gui_size)
+{
+  GimpBrushCache *cache   = GIMP_BRUSH_CACHE (object);
+  gint64          memsize = 0;
+
+  memsize += gimp_g_list_get_memsize (cache->cached_units,
+                                      sizeof (GimpBrushCacheUnit));
+  memsize += cache->memsize;
+
+  return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
+                                                                  gui_size);
+}
+
 
 /*  public functions  */
 
 GimpBrushCache *
-gimp_brush_cache_new (GDestroyNotify  data_destroy,
-                      gchar           debug_hit,
-                      gchar           debug_miss)
+gimp_brush_cache_new (GDestroyNotify          data_destroy,
+                      GimpBrushCacheSizeFunc  data_size,
+                      gchar                   debug_hit,
+                      gchar                   debug_miss)
 {
   GimpBrushCache *cache;
 
@@ -155,6 +224,7 @@ gimp_brush_cache_new (GDestroyNotify  data_destroy,
 
   cache =  g_object_new (GIMP_TYPE_BRUSH_CACHE,
                          "data-destroy", data_destroy,
+                         "data-size",    data_size,
                          NULL);
 
   cache->debug_hit  = debug_hit;
@@ -168,11 +238,20 @@ gimp_brush_cache_clear (GimpBrushCache *cache)
 {
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
 
-  if (cache->last_data)
+  gimp_brush_cache_log_stats (cache);
+
+  while (cache->cached_units)
     {
-      cache->data_destroy (cache->last_data);
-      cache->last_data = NULL;
+      gimp_brush_cache_unit_free (cache, cache->cached_units->data);
+
+      cache->cached_units = g_list_delete_link (cache->cached_units,
+                                                cache->cached_units);
     }
+
+  cache->n_units  = 0;
+  cache->memsize  = 0;
+  cache->n_hits   = 0;
+  cache->n_misses = 0;
 }
 
 gconstpointer
@@ -184,22 +263,49 @@ gimp_brush_cache_get (GimpBrushCache *cache,
                       gdouble         angle,
                       gdouble         hardness)
 {
+  GList *list;
+  gint   q_scale;
+  gint   q_aspect_ratio;
+  gint   q_angle;
+  gint   q_hardness;
+
   g_return_val_if_fail (GIMP_IS_BRUSH_CACHE (cache), NULL);
 
-  if (cache->last_data                         &&
-      cache->last_width        == width        &&
-      cache->last_height       == height       &&
-      cache->last_scale        == scale        &&
-      cache->last_aspect_ratio == aspect_ratio &&
-      cache->last_angle        == angle        &&
-      cache->last_hardness     == hardness)
-    {
-      if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
-        g_printerr ("%c", cache->debug_hit);
+  q_scale        = QUANTIZE (scale,        SCALE_STEP);
+  q_aspect_ratio = QUANTIZE (aspect_ratio, ASPECT_RATIO_STEP);
+  q_angle        = QUANTIZE (angle,        ANGLE_STEP);
+  q_hardness     = QUANTIZE (hardness,     HARDNESS_STEP);
 
-      return (gconstpointer) cache->last_data;
+  for (list = cache->cached_units; list; list = g_list_next (list))
+    {
+      GimpBrushCacheUnit *unit = list->data;
+
+      if (unit->width        == width          &&
+          unit->height       == height         &&
+          unit->scale        == q_scale        &&
+          unit->aspect_ratio == q_aspect_ratio &&
+          unit->angle        == q_angle        &&
+          unit->hardness     == q_hardness)
+        {
+          /*  move the unit to the front, it is the most recently used  */
+          if (list != cache->cached_units)
+            {
+              cache->cached_units = g_list_remove_link (cache->cached_units,
+                                                        list);
+              cache->cached_units = g_list_concat (list, cache->cached_units);
+            }
+
+          cache->n_hits++;
+
+          if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
+            g_printerr ("%c", cache->debug_hit);
+
+          return (gconstpointer) unit->data;
+        }
     }
 
+  cache->n_misses++;
+
   if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
     g_printerr ("%c", cache->debug_miss);
 
@@ -216,20 +322,77 @@ gimp_brush_cache_add (GimpBrushCache *cache,
                       gdouble         angle,
                       gdouble         hardness)
 {
+  GimpBrushCacheUnit *unit;
+  GList              *list;
+
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
   g_return_if_fail (data != NULL);
 
-  if (data == cache->last_data)
-    return;
+  for (list = cache->cached_units; list; list = g_list_next (list))
+    {
+      unit = list->data;
+
+      if (unit->data == data)
+        return;
+    }
+
+  unit = g_slice_new (GimpBrushCacheUnit);
+
+  unit->data         = data;
+  unit->memsize      = cache->data_size ? cache->data_size (data) : 0;
+  unit->width        = width;
+  unit->height       = height;
+  unit->scale        = QUANTIZE (scale,        SCALE_STEP);
+  unit->aspect_ratio = QUANTIZE (aspect_ratio, ASPECT_RATIO_STEP);
+  unit->angle        = QUANTIZE (angle,        ANGLE_STEP);
+  unit->hardness     = QUANTIZE (hardness,     HARDNESS_STEP);
+
+  cache->cached_units = g_list_prepend (cache->cached_units, unit);
+  cache->n_units++;
+  cache->memsize += unit->memsize;
+
+  /*  drop the least recently used units, but never the one just added,
+   *  its data was returned to the caller
+   */
+  while (cache->n_units > MAX_N_UNITS ||
+         (cache->memsize > MAX_MEMSIZE && cache->n_units > 1))
+    {
+      GList *last = g_list_last (cache->cached_units);
+
+      gimp_brush_cache_unit_free (cache, last->data);
+
+      cache->cached_units = g_list_delete_link (cache->cached_units, last);
+      cache->n_units--;
+    }
+}
+
+
+/*  private functions  */
+
+static void
+gimp_brush_cache_unit_free (GimpBrushCache     *cache,
+                            GimpBrushCacheUnit *unit)
+{
+  cache->memsize -= unit->memsize;
 
-  if (cache->last_data)
-    cache->data_destroy (cache->last_data);
+  cache->data_destroy (unit->data);
 
-  cache->last_data         = data;
-  cache->last_width        = width;
-  cache->last_height       = height;
-  cache->last_scale        = scale;
-  cache->last_aspect_ratio = aspect_ratio;
-  cache->last_angle        = angle;
-  cache->last_hardness     = hardness;
+  g_slice_free (GimpBrushCacheUnit, unit);
+}
+
+static void
+gimp_brush_cache_log_stats (GimpBrushCache *cache)
+{
+  gint n_lookups = cache->n_hits + cache->n_misses;
+
+  if (n_lookups > 0)
+    {
+      GIMP_LOG (BRUSH_CACHE,
+                "\n'%c' cache: %d hits, %d misses (%.1f%% hit rate), "
+                "%d units, %" G_GSIZE_FORMAT " bytes",
+                cache->debug_hit,
+                cache->n_hits, cache->n_misses,
+                100.0 * cache->n_hits / n_lookups,
+                cache->n_units, cache->memsize);
+    }
 }
@@ -35,22 +35,24 @@
 
 typedef struct _GimpBrushCacheClass GimpBrushCacheClass;
 
+typedef gsize (* GimpBrushCacheSizeFunc) (gconstpointer data);
+
 struct _GimpBrushCache
 {
-  GimpObject      parent_instance;
+  GimpObject              parent_instance;
+
+  GDestroyNotify          data_destroy;
+  GimpBrushCacheSizeFunc  data_size;
 
-  GDestroyNotify  data_destroy;
+  GList                  *cached_units;  /* most recently used first */
+  gint                    n_units;
+  gsize                   memsize;
 
-  gpointer        last_data;
-  gint            last_width;
-  gint            last_height;
-  gdouble         last_scale;
-  gdouble         last_aspect_ratio;
-  gdouble         last_angle;
-  gdouble         last_hardness;
+  gint                    n_hits;
+  gint                    n_misses;
 
-  gchar           debug_hit;
-  gchar           debug_miss;
+  gchar                   debug_hit;
+  gchar                   debug_miss;
 };
 
 struct _GimpBrushCacheClass
@@ -61,9 +63,10 @@ struct _GimpBrushCacheClass
 
 GType            gimp_brush_cache_get_type (void) G_GNUC_CONST;
 
-GimpBrushCache * gimp_brush_cache_new      (GDestroyNotify  data_destory,
-                                            gchar           debug_hit,
-                                            gchar           debug_miss);
+GimpBrushCache * gimp_brush_cache_new      (GDestroyNotify          data_destory,
+                                            GimpBrushCacheSizeFunc  data_size,
+                                            gchar                   debug_hit,
+                                            gchar                   debug_miss);
 
 void             gimp_brush_cache_clear    (GimpBrushCache *cache);
 
@@ -19,6 +19,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 
 #include "libgimpbase/gimpbase.h"
@@ -104,6 +106,8 @@ G_DEFINE_TYPE (GimpBrushGenerated, gimp_brush_generated, GIMP_TYPE_BRUSH)
 
 #define parent_class gimp_brush_generated_parent_class
 
+G_LOCK_DEFINE_STATIC (lut_cache);
+
 
 static void
 gimp_brush_generated_class_init (GimpBrushGeneratedClass *klass)
@@ -395,8 +399,9 @@ gauss (gdouble f)
 
 /* set up lookup table */
 static guchar *
-gimp_brush_generated_calc_lut (gdouble radius,
-                               gdouble hardness)
+gimp_brush_generated_new_lut (gdouble  radius,
+                              gdouble  hardness,
+                              gint    *length_out)
 {
   guchar  *lookup;
   gint     length;
@@ -446,9 +451,100 @@ gimp_brush_generated_calc_lut (gdouble radius,
       lookup[x++] = 0;
     }
 
+  *length_out = length;
+
+  return lookup;
+}
+
+/*  the lookup table only depends on radius and hardness, which stay
+ *  the same while dynamics only change angle or aspect ratio, so keep
+ *  the last one around
+ */
+static guchar *
+gimp_brush_generated_calc_lut (gdouble radius,
+                               gdouble hardness)
+{
+  static gdouble  cached_radius   = -1.0;
+  static gdouble  cached_hardness = -1.0;
+  static guchar  *cached_lookup   = NULL;
+  static gint     cached_length   = 0;
+  guchar         *lookup;
+
+  G_LOCK (lut_cache);
+
+  if (! cached_lookup             ||
+      radius   != cached_radius   ||
+      hardness != cached_hardness)
+    {
+      g_free (cached_lookup);
+
+      cached_lookup   = gimp_brush_generated_new_lut (radius, hardness,
+                                                      &cached_length);
+      cached_radius   = radius;
+      cached_hardness = hardness;
+    }
+
+  lookup = g_memdup (cached_lookup, cached_length);
+
+  G_UNLOCK (lut_cache);
+
   return lookup;
 }
 
+static inline guchar
+gimp_brush_generated_calc_pixel (GimpBrushGeneratedShape  shape,
+                                 const guchar            *lookup,
+                                 gfloat                   radius,
+                                 gint                     spikes,
+                                 gfloat                   aspect_ratio,
+                                 gdouble                  c,
+                                 gdouble                  s,
+                                 gdouble                  cs,
+                                 gdouble                  ss,
+                                 gint                     x,
+                                 gint                     y)
+{
+  gdouble d  = 0;
+  gdouble tx = c * x - s * y;
+  gdouble ty = fabs (s * x + c * y);
+
+  if (spikes > 2)
+    {
+      gdouble angle = atan2 (ty, tx);
+
+      while (angle > G_PI / spikes)
+        {
+          gdouble sx = tx;
+          gdouble sy = ty;
+
+          tx = cs * sx - ss * sy;
+          ty = ss * sx + cs * sy;
+
+          angle -= 2 * G_PI / spikes;
+        }
+    }
+
+  ty *= aspect_ratio;
+
+  switch (shape)
+    {
+    case GIMP_BRUSH_GENERATED_CIRCLE:
+      d = sqrt (SQR (tx) + SQR (ty));
+      break;
+    case GIMP_BRUSH_GENERATED_SQUARE:
+      d = MAX (fabs (tx), fabs (ty));
+      break;
+    case GIMP_BRUSH_GENERATED_DIAMOND:
+      d = fabs (tx) + fabs (ty);
+      break;
+    }
+
+  if (d < radius + 1)
+    return lookup[(gint) RINT (d * OVERSAMPLING)];
+
+  return 0;
+}
+
 static GimpTempBuf *
 gimp_brush_generated_calc (GimpBrushGenerated      *brush,
                            GimpBrushGeneratedShape  shape,
@@ -496,55 +592,72 @@ gimp_brush_generated_calc (GimpBrushGenerated      *brush,
   cs = cos (- 2 * G_PI / spikes);
   ss = sin (- 2 * G_PI / spikes);
 
-  /* for an even number of spikes compute one half and mirror it */
-  for (y = (spikes % 2 ? -half_height : 0); y <= half_height; y++)
+  /*  snap multiples of 90 degrees, sin() and cos() return tiny
+   *  non-zero values there
+   */
+  if (fabs (s) < 1e-10)
+    {
+      s = 0.0;
+      c = c > 0.0 ? 1.0 : -1.0;
+    }
+  else if (fabs (c) < 1e-10)
+    {
+      c = 0.0;
+      s = s > 0.0 ? 1.0 : -1.0;
+    }
+
+  if (spikes <= 2 && (s == 0.0 || c == 0.0))
     {
-      for (x = -half_width; x <= half_width; x++)
+      /*  an axis-aligned brush is symmetric about both axes, compute
+       *  the lower right quadrant only, and with no aspect ratio only
+       *  the part of it above the diagonal.  The other half of each
+       *  row is mirrored as we go, the upper half of the brush is
+       *  copied row by row at the end.
+       */
+      gboolean octant = (aspect_ratio == 1.0 && half_width == half_height);
+
+      for (y = 0; y <= half_height; y++)
         {
-          gdouble d  = 0;
-          gdouble tx = c * x - s * y;
-          gdouble ty = fabs (s * x + c * y);
+          guchar *row = centerp + y * mask_width;
 
-          if (spikes > 2)
+          for (x = (octant ? y : 0); x <= half_width; x++)
             {
-              gdouble angle = atan2 (ty, tx);
+              a = gimp_brush_generated_calc_pixel (shape, lookup, radius,
+                                                   spikes, aspect_ratio,
+                                                   c, s, cs, ss, x, y);
 
-              while (angle > G_PI / spikes)
-                {
-                  gdouble sx = tx;
-                  gdouble sy = ty;
-
-                  tx = cs * sx - ss * sy;
-                  ty = ss * sx + cs * sy;
+              row[x]  = a;
+              row[-x] = a;
 
-                  angle -= 2 * G_PI / spikes;
+              if (octant)
+                {
+                  centerp[x * mask_width + y] = a;
+                  centerp[x * mask_width - y] = a;
                 }
             }
+        }
 
-          ty *= aspect_ratio;
-
-          switch (shape)
+      for (y = 1; y <= half_height; y++)
+        memcpy (centerp - y * mask_width - half_width,
+                centerp + y * mask_width - half_width,
+                mask_width);
+    }
+  else
+    {
+      /* for an even number of spikes compute one half and mirror it */
+      for (y = (spikes % 2 ? -half_height : 0); y <= half_height; y++)
+        {
+          for (x = -half_width; x <= half_width; x++)
             {
-            case GIMP_BRUSH_GENERATED_CIRCLE:
-              d = sqrt (SQR (tx) + SQR (ty));
-              break;
-            case GIMP_BRUSH_GENERATED_SQUARE:
-              d = MAX (fabs (tx), fabs (ty));
-              break;
-            case GIMP_BRUSH_GENERATED_DIAMOND:
-              d = fabs (tx) + fabs (ty);
-              break;
-            }
+              a = gimp_brush_generated_calc_pixel (shape, lookup, radius,
+                                                   spikes, aspect_ratio,
+                                                   c, s, cs, ss, x, y);
 
-          if (d < radius + 1)
-            a = lookup[(gint) RINT (d * OVERSAMPLING)];
-          else
-            a = 0;
+              centerp[y * mask_width + x] = a;
 
-          centerp[y * mask_width + x] = a;
-
-          if (spikes % 2 == 0)
-            centerp[-1 * y * mask_width - x] = a;
+              if (spikes % 2 == 0)
+                centerp[-1 * y * mask_width - x] = a;
+            }
         }
     }
 
@@ -24,6 +24,7 @@
 
 #include "core-types.h"
 
+#include "gimptempbuf.h"
 #include "gimpbrushpipe.h"
 #include "gimpbrushpipe-load.h"
 
@@ -50,6 +51,12 @@ static gboolean    gimp_brush_pipe_want_null_motion (GimpBrush        *brush,
                                                      const GimpCoords *current_coords);
 
 
+/*  the number of cells whose pixels are kept in memory, the others
+ *  are read from the file again when they get selected
+ */
+#define MAX_LOADED_CELLS 32
+
+
 G_DEFINE_TYPE (GimpBrushPipe, gimp_brush_pipe, GIMP_TYPE_BRUSH);
 
 #define parent_class gimp_brush_pipe_parent_class
@@ -86,6 +93,7 @@ gimp_brush_pipe_init (GimpBrushPipe *pipe)
   pipe->brushes   = NULL;
   pipe->select    = NULL;
   pipe->index     = NULL;
+  pipe->loaded    = g_queue_new ();
 }
 
 static void
@@ -126,6 +134,11 @@ gimp_brush_pipe_finalize (GObject *object)
       g_free (pipe->index);
       pipe->index = NULL;
     }
+  if (pipe->loaded)
+    {
+      g_queue_free (pipe->loaded);
+      pipe->loaded = NULL;
+    }
 
   GIMP_BRUSH (pipe)->mask   = NULL;
   GIMP_BRUSH (pipe)->pixmap = NULL;
@@ -255,7 +268,7 @@ gimp_brush_pipe_select_brush (GimpBrush        *brush,
   /* Make sure is inside bounds */
   brushix = CLAMP (brushix, 0, pipe->n_brushes - 1);
 
-  pipe->current = pipe->brushes[brushix];
+  pipe->current = gimp_brush_pipe_get_brush (pipe, brushix);
 
   return GIMP_BRUSH (pipe->current);
 }
@@ -277,3 +290,62 @@ gimp_brush_pipe_want_null_motion (GimpBrush        *brush,
 
   return TRUE;
 }
+
+
+/*  public functions  */
+
+/**
+ * gimp_brush_pipe_get_brush:
+ * @pipe:  a #GimpBrushPipe
+ * @index: the index of a cell
+ *
+ * Returns cell @index of @pipe. The cells' pixels are read from the
+ * brush file when they are first used; only the most recently
+ * requested cells are kept in memory, the pixels of older ones are
+ * dropped and read again when needed.
+ *
+ * Return value: the brush of cell @index.
+ **/
+GimpBrush *
+gimp_brush_pipe_get_brush (GimpBrushPipe *pipe,
+                           gint           index)
+{
+  GimpBrush *brush;
+  GList     *list;
+
+  g_return_val_if_fail (GIMP_IS_BRUSH_PIPE (pipe), NULL);
+  g_return_val_if_fail (index >= 0 && index < pipe->n_brushes, NULL);
+
+  brush = pipe->brushes[index];
+
+  if (pipe->n_brushes <= MAX_LOADED_CELLS)
+    return brush;
+
+  list = g_queue_find (pipe->loaded, brush);
+
+  if (list)
+    {
+      g_queue_unlink (pipe->loaded, list);
+      g_queue_push_head_link (pipe->loaded, list);
+    }
+  else
+    {
+      g_queue_push_head (pipe->loaded, brush);
+
+      if (g_queue_get_length (pipe->loaded) > MAX_LOADED_CELLS)
+        {
+          GimpBrush *old = g_queue_pop_tail (pipe->loaded);
+
+          /*  unloading is a no-op for buffers that are in use or that
+           *  were not read lazily
+           */
+          if (old->mask)
+            gimp_temp_buf_unload (old->mask);
+
+          if (old->pixmap)
+            gimp_temp_buf_unload (old->pixmap);
+        }
+    }
+
+  return brush;
+}
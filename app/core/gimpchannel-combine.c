@@ -475,22 +475,19 @@ gimp_channel_combine_mask (GimpChannel    *mask,
 
   switch (op)
     {
+    /*  the loops have no branches so the compiler can vectorize
+     *  them, the values are in [0, 1] already
+     */
     case GIMP_CHANNEL_OP_ADD:
     case GIMP_CHANNEL_OP_REPLACE:
       while (gegl_buffer_iterator_next (iter))
         {
           gfloat       *mask_data   = iter->data[0];
           const gfloat *add_on_data = iter->data[1];
+          gint          i;
 
-          while (iter->length--)
-            {
-              const gfloat val = *mask_data + *add_on_data;
-
-              *mask_data = CLAMP (val, 0.0, 1.0);
-
-              add_on_data++;
-              mask_data++;
-            }
+          for (i = 0; i < iter->length; i++)
+            mask_data[i] = MIN (mask_data[i] + add_on_data[i], 1.0f);
         }
       break;
 
@@ -499,17 +496,10 @@ gimp_channel_combine_mask (GimpChannel    *mask,
         {
           gfloat       *mask_data   = iter->data[0];
           const gfloat *add_on_data = iter->data[1];
+          gint          i;
 
-          while (iter->length--)
-            {
-              if (*add_on_data > *mask_data)
-                *mask_data = 0.0;
-              else
-                *mask_data -= *add_on_data;
-
-              add_on_data++;
-              mask_data++;
-            }
+          for (i = 0; i < iter->length; i++)
+            mask_data[i] = MAX (mask_data[i] - add_on_data[i], 0.0f);
         }
       break;
 
@@ -518,14 +508,10 @@ gimp_channel_combine_mask (GimpChannel    *mask,
         {
           gfloat       *mask_data   = iter->data[0];
           const gfloat *add_on_data = iter->data[1];
+          gint          i;
 
-          while (iter->length--)
-            {
-              *mask_data = MIN (*mask_data, *add_on_data);
-
-              add_on_data++;
-              mask_data++;
-            }
+          for (i = 0; i < iter->length; i++)
+            mask_data[i] = MIN (mask_data[i], add_on_data[i]);
         }
       break;
 
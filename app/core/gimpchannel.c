@@ -24,12 +24,14 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
 #include "libgimpcolor/gimpcolor.h"
+#include "libgimpmath/gimpmath.h"
 
 #include "core-types.h"
 
 #include "paint/gimppaintcore-stroke.h"
 #include "paint/gimppaintoptions.h"
 
+#include "gegl/gimp-gegl-loops.h"
 #include "gegl/gimp-gegl-nodes.h"
 
 #include "gegl/gimp-gegl-utils.h"
@@ -57,6 +59,12 @@
 #include "gimp-intl.h"
 
 
+/*  the boundary is cached in strips of this many rows, only the
+ *  strips touched by an update are traced again
+ */
+#define BOUNDARY_STRIP_HEIGHT 64
+
+
 enum
 {
   COLOR_CHANGED,
@@ -64,6 +72,16 @@ enum
 };
 
 
+struct _GimpBoundStrip
+{
+  gboolean      valid;
+  GimpBoundSeg *segs_in;
+  gint          num_segs_in;
+  GimpBoundSeg *segs_out;
+  gint          num_segs_out;
+};
+
+
 static void gimp_channel_pickable_iface_init (GimpPickableInterface *iface);
 
 static void       gimp_channel_finalize      (GObject           *object);
@@ -129,6 +147,11 @@ static void       gimp_channel_to_selection  (GimpItem          *item,
                                               gdouble            feather_radius_x,
                                               gdouble            feather_radius_y);
 
+static void gimp_channel_update               (GimpDrawable       *drawable,
+                                                gint                x,
+                                                gint                y,
+                                                gint                width,
+                                                gint                height);
 static void gimp_channel_invalidate_boundary   (GimpDrawable       *drawable);
 static void gimp_channel_get_active_components (const GimpDrawable *drawable,
                                                 gboolean           *active);
@@ -171,6 +194,8 @@ static gdouble   gimp_channel_get_opacity_at (GimpPickable        *pickable,
                                               gint                 x,
                                               gint                 y);
 
+static void       gimp_channel_free_strips   (GimpChannel         *channel);
+
 static gboolean   gimp_channel_real_boundary (GimpChannel         *channel,
                                               const GimpBoundSeg **segs_in,
                                               const GimpBoundSeg **segs_out,
@@ -281,6 +306,7 @@ gimp_channel_class_init (GimpChannelClass *klass)
   item_class->raise_failed         = _("Channel cannot be raised higher.");
   item_class->lower_failed         = _("Channel cannot be lowered more.");
 
+  drawable_class->update                = gimp_channel_update;
   drawable_class->invalidate_boundary   = gimp_channel_invalidate_boundary;
   drawable_class->get_active_components = gimp_channel_get_active_components;
   drawable_class->get_active_mask       = gimp_channel_get_active_mask;
@@ -324,6 +350,9 @@ gimp_channel_init (GimpChannel *channel)
   channel->segs_out       = NULL;
   channel->num_segs_in    = 0;
   channel->num_segs_out   = 0;
+  channel->boundary_stamp = 0;
+  channel->strips         = NULL;
+  channel->num_strips     = 0;
   channel->empty          = FALSE;
   channel->bounds_known   = FALSE;
   channel->x1             = 0;
@@ -355,6 +384,8 @@ gimp_channel_finalize (GObject *object)
       channel->segs_out = NULL;
     }
 
+  gimp_channel_free_strips (channel);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -367,6 +398,18 @@ gimp_channel_get_memsize (GimpObject *object,
   *gui_size += channel->num_segs_in  * sizeof (GimpBoundSeg);
   *gui_size += channel->num_segs_out * sizeof (GimpBoundSeg);
 
+  if (channel->strips)
+    {
+      gint i;
+
+      for (i = 0; i < channel->num_strips; i++)
+        *gui_size += ((channel->strips[i].num_segs_in +
+                       channel->strips[i].num_segs_out) *
+                      sizeof (GimpBoundSeg));
+
+      *gui_size += channel->num_strips * sizeof (GimpBoundStrip);
+    }
+
   return GIMP_OBJECT_CLASS (parent_class)->get_memsize (object, gui_size);
 }
 
@@ -786,6 +829,32 @@ gimp_channel_to_selection (GimpItem       *item,
                                feather, feather_radius_x, feather_radius_x);
 }
 
+static void
+gimp_channel_update (GimpDrawable *drawable,
+                     gint          x,
+                     gint          y,
+                     gint          width,
+                     gint          height)
+{
+  GimpChannel *channel = GIMP_CHANNEL (drawable);
+
+  if (channel->strips)
+    {
+      gint first, last, i;
+
+      /*  the changed rows affect the edges from y to y + height  */
+      first = CLAMP (y / BOUNDARY_STRIP_HEIGHT,
+                     0, channel->num_strips - 1);
+      last  = CLAMP ((y + height) / BOUNDARY_STRIP_HEIGHT,
+                     0, channel->num_strips - 1);
+
+      for (i = first; i <= last; i++)
+        channel->strips[i].valid = FALSE;
+    }
+
+  GIMP_DRAWABLE_CLASS (parent_class)->update (drawable, x, y, width, height);
+}
+
 static void
 gimp_channel_invalidate_boundary (GimpDrawable *drawable)
 {
@@ -870,6 +939,8 @@ gimp_channel_set_buffer (GimpDrawable *drawable,
                                                   offset_x, offset_y);
 
   GIMP_CHANNEL (drawable)->bounds_known = FALSE;
+
+  gimp_channel_free_strips (GIMP_CHANNEL (drawable));
 }
 
 static GeglNode *
@@ -973,6 +1044,219 @@ gimp_channel_get_opacity_at (GimpPickable *pickable,
   return value;
 }
 
+static void
+gimp_channel_free_strips (GimpChannel *channel)
+{
+  if (channel->strips)
+    {
+      gint i;
+
+      for (i = 0; i < channel->num_strips; i++)
+        {
+          g_free (channel->strips[i].segs_in);
+          g_free (channel->strips[i].segs_out);
+        }
+
+      g_free (channel->strips);
+
+      channel->strips     = NULL;
+      channel->num_strips = 0;
+    }
+}
+
+/*  Keep only the segments owned by the strip of rows y1 to y2: the
+ *  horizontal edges from y1 to y2 (the bottom edge only for the last
+ *  strip), and the vertical edges clipped to these rows.
+ */
+static gint
+gimp_channel_clip_strip_segs (GimpBoundSeg *segs,
+                              gint          num_segs,
+                              gint          y1,
+                              gint          y2,
+                              gboolean      last)
+{
+  gint i, j;
+
+  for (i = 0, j = 0; i < num_segs; i++)
+    {
+      GimpBoundSeg seg = segs[i];
+
+      if (seg.y1 == seg.y2)
+        {
+          if (seg.y1 < y1 || seg.y1 > y2 || (seg.y1 == y2 && ! last))
+            continue;
+        }
+      else
+        {
+          seg.y1 = CLAMP (seg.y1, y1, y2);
+          seg.y2 = CLAMP (seg.y2, y1, y2);
+
+          if (seg.y1 == seg.y2)
+            continue;
+        }
+
+      segs[j++] = seg;
+    }
+
+  return j;
+}
+
+static void
+gimp_channel_trace_strip (GimpChannel *channel,
+                          GeglBuffer  *buffer,
+                          gint         index,
+                          gint         x1,
+                          gint         y1,
+                          gint         x2,
+                          gint         y2,
+                          gint         x3,
+                          gint         y3,
+                          gint         x4,
+                          gint         y4)
+{
+  GimpBoundStrip *strip  = &channel->strips[index];
+  gint            height = gimp_item_get_height (GIMP_ITEM (channel));
+  gboolean        last   = (index == channel->num_strips - 1);
+  gint            sy1, sy2;
+  gint            wy1, wy2;
+  gint            bx1, by1, bx2, by2;
+
+  g_free (strip->segs_in);
+  g_free (strip->segs_out);
+
+  strip->segs_in      = NULL;
+  strip->segs_out     = NULL;
+  strip->num_segs_in  = 0;
+  strip->num_segs_out = 0;
+
+  sy1 = index * BOUNDARY_STRIP_HEIGHT;
+  sy2 = MIN (sy1 + BOUNDARY_STRIP_HEIGHT, height);
+
+  /*  the edges owned by the strip depend on the row above it too  */
+  wy1 = MAX (sy1 - 1, y3);
+  wy2 = MIN (sy2, y4);
+
+  if (wy2 > wy1)
+    {
+      GeglRectangle rect = { x3, wy1, x4 - x3, wy2 - wy1 };
+
+      strip->segs_out = gimp_boundary_find (buffer, &rect,
+                                            babl_format ("Y float"),
+                                            GIMP_BOUNDARY_IGNORE_BOUNDS,
+                                            x1, y1, x2, y2,
+                                            GIMP_BOUNDARY_HALF_WAY,
+                                            &strip->num_segs_out);
+
+      strip->num_segs_out = gimp_channel_clip_strip_segs (strip->segs_out,
+                                                          strip->num_segs_out,
+                                                          sy1, sy2, last);
+    }
+
+  bx1 = MAX (x1, x3);
+  by1 = MAX (MAX (y1, y3), sy1 - 1);
+  bx2 = MIN (x2, x4);
+  by2 = MIN (MIN (y2, y4), sy2);
+
+  if (bx2 > bx1 && by2 > by1)
+    {
+      strip->segs_in = gimp_boundary_find (buffer, NULL,
+                                           babl_format ("Y float"),
+                                           GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                           bx1, by1, bx2, by2,
+                                           GIMP_BOUNDARY_HALF_WAY,
+                                           &strip->num_segs_in);
+
+      strip->num_segs_in = gimp_channel_clip_strip_segs (strip->segs_in,
+                                                         strip->num_segs_in,
+                                                         sy1, sy2, last);
+    }
+
+  strip->valid = TRUE;
+}
+
+/*  Concatenate the segments of all strips, joining the vertical
+ *  segments which were cut at the strip borders.
+ */
+static GimpBoundSeg *
+gimp_channel_join_strips (GimpChannel *channel,
+                          gboolean     inner,
+                          gint        *num_segs)
+{
+  GimpBoundSeg *segs;
+  GHashTable   *ends = NULL;
+  gint          height = gimp_item_get_height (GIMP_ITEM (channel));
+  gint          total  = 0;
+  gint          n      = 0;
+  gint          i, j;
+
+  for (i = 0; i < channel->num_strips; i++)
+    total += (inner ?
+              channel->strips[i].num_segs_in :
+              channel->strips[i].num_segs_out);
+
+  *num_segs = 0;
+
+  if (total == 0)
+    return NULL;
+
+  segs = g_new (GimpBoundSeg, total);
+
+  for (i = 0; i < channel->num_strips; i++)
+    {
+      const GimpBoundStrip *strip  = &channel->strips[i];
+      const GimpBoundSeg   *src    = inner ? strip->segs_in : strip->segs_out;
+      gint                  count  = (inner ?
+                                      strip->num_segs_in :
+                                      strip->num_segs_out);
+      gint                  top    = i * BOUNDARY_STRIP_HEIGHT;
+      gint                  bottom = MIN (top + BOUNDARY_STRIP_HEIGHT, height);
+      GHashTable           *new_ends;
+
+      new_ends = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+      for (j = 0; j < count; j++)
+        {
+          const GimpBoundSeg *seg      = &src[j];
+          gboolean            vertical = (seg->x1 == seg->x2 &&
+                                          seg->y1 <  seg->y2);
+          gpointer            key      = GINT_TO_POINTER (seg->x1 * 2 +
+                                                          (seg->open ? 1 : 0));
+          gint                k        = -1;
+
+          if (vertical && seg->y1 == top && ends)
+            {
+              k = GPOINTER_TO_INT (g_hash_table_lookup (ends, key)) - 1;
+
+              if (k >= 0)
+                {
+                  segs[k].y2 = seg->y2;
+                  g_hash_table_remove (ends, key);
+                }
+            }
+
+          if (k < 0)
+            {
+              k = n++;
+              segs[k] = *seg;
+            }
+
+          if (vertical && segs[k].y2 == bottom)
+            g_hash_table_insert (new_ends, key, GINT_TO_POINTER (k + 1));
+        }
+
+      if (ends)
+        g_hash_table_destroy (ends);
+
+      ends = new_ends;
+    }
+
+  g_hash_table_destroy (ends);
+
+  *num_segs = n;
+
+  return segs;
+}
+
 static gboolean
 gimp_channel_real_boundary (GimpChannel         *channel,
                             const GimpBoundSeg **segs_in,
@@ -995,35 +1279,47 @@ gimp_channel_real_boundary (GimpChannel         *channel,
       if (gimp_channel_bounds (channel, &x3, &y3, &x4, &y4))
         {
           GeglBuffer *buffer;
-          GeglRectangle  rect = { x3, y3, x4 - x3, y4 - y3 };
+          gint        height;
+          gint        num_strips;
+          gint        i;
 
           buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
+          height = gimp_item_get_height (GIMP_ITEM (channel));
 
-          channel->segs_out = gimp_boundary_find (buffer, &rect,
-                                                  babl_format ("Y float"),
-                                                  GIMP_BOUNDARY_IGNORE_BOUNDS,
-                                                  x1, y1, x2, y2,
-                                                  GIMP_BOUNDARY_HALF_WAY,
-                                                  &channel->num_segs_out);
-          x1 = MAX (x1, x3);
-          y1 = MAX (y1, y3);
-          x2 = MIN (x2, x4);
-          y2 = MIN (y2, y4);
-
-          if (x2 > x1 && y2 > y1)
+          num_strips = ((height + BOUNDARY_STRIP_HEIGHT - 1) /
+                        BOUNDARY_STRIP_HEIGHT);
+
+          /*  only strips touched by updates since the last call need
+           *  to be traced again, unless the bounds changed
+           */
+          if (channel->num_strips != num_strips ||
+              channel->strips_x1  != x1         ||
+              channel->strips_y1  != y1         ||
+              channel->strips_x2  != x2         ||
+              channel->strips_y2  != y2)
             {
-              channel->segs_in = gimp_boundary_find (buffer, NULL,
-                                                     babl_format ("Y float"),
-                                                     GIMP_BOUNDARY_WITHIN_BOUNDS,
-                                                     x1, y1, x2, y2,
-                                                     GIMP_BOUNDARY_HALF_WAY,
-                                                     &channel->num_segs_in);
+              gimp_channel_free_strips (channel);
+
+              channel->strips     = g_new0 (GimpBoundStrip, num_strips);
+              channel->num_strips = num_strips;
+              channel->strips_x1  = x1;
+              channel->strips_y1  = y1;
+              channel->strips_x2  = x2;
+              channel->strips_y2  = y2;
             }
-          else
+
+          for (i = 0; i < num_strips; i++)
             {
-              channel->segs_in     = NULL;
-              channel->num_segs_in = 0;
+              if (! channel->strips[i].valid)
+                gimp_channel_trace_strip (channel, buffer, i,
+                                          x1, y1, x2, y2,
+                                          x3, y3, x4, y4);
             }
+
+          channel->segs_in  = gimp_channel_join_strips (channel, TRUE,
+                                                        &channel->num_segs_in);
+          channel->segs_out = gimp_channel_join_strips (channel, FALSE,
+                                                        &channel->num_segs_out);
         }
       else
         {
@@ -1034,6 +1330,7 @@ gimp_channel_real_boundary (GimpChannel         *channel,
         }
 
       channel->boundary_known = TRUE;
+      channel->boundary_stamp++;
     }
 
   *segs_in      = channel->segs_in;
@@ -1193,6 +1490,9 @@ gimp_channel_real_is_empty (GimpChannel *channel)
     }
 
   /*  The mask is empty, meaning we can set the bounds as known  */
+  if (! channel->boundary_known)
+    channel->boundary_stamp++;
+
   if (channel->segs_in)
     g_free (channel->segs_in);
   if (channel->segs_out)
@@ -1220,7 +1520,9 @@ gimp_channel_real_feather (GimpChannel *channel,
                            gboolean     push_undo)
 {
   GimpDrawable *drawable = GIMP_DRAWABLE (channel);
-  GeglNode     *node;
+  gdouble       std_dev_x;
+  gdouble       std_dev_y;
+  gint          x1, y1, x2, y2;
 
   if (push_undo)
     gimp_channel_push_undo (channel,
@@ -1231,17 +1533,26 @@ gimp_channel_real_feather (GimpChannel *channel,
   /* 3.5 is completely magic and picked to visually match the old
    * gaussian_blur_region() on a crappy laptop display
    */
-  node = gegl_node_new_child (NULL,
-                              "operation", "gegl:gaussian-blur",
-                              "std-dev-x", radius_x / 3.5,
-                              "std-dev-y", radius_y / 3.5,
-                              NULL);
+  std_dev_x = radius_x / 3.5;
+  std_dev_y = radius_y / 3.5;
+
+  /*  only the area the blur can reach from the selected pixels
+   *  changes, the rest of the channel stays 0
+   */
+  if (gimp_channel_bounds (channel, &x1, &y1, &x2, &y2))
+    {
+      gint pad_x = ceil (4.0 * std_dev_x);
+      gint pad_y = ceil (4.0 * std_dev_y);
 
-  gimp_drawable_apply_operation_to_buffer (drawable, NULL, NULL,
-                                           node,
-                                           gimp_drawable_get_buffer (drawable));
+      x1 = MAX (x1 - pad_x, 0);
+      y1 = MAX (y1 - pad_y, 0);
+      x2 = MIN (x2 + pad_x, gimp_item_get_width  (GIMP_ITEM (channel)));
+      y2 = MIN (y2 + pad_y, gimp_item_get_height (GIMP_ITEM (channel)));
 
-  g_object_unref (node);
+      gimp_gegl_gaussian_blur (gimp_drawable_get_buffer (drawable),
+                               GEGL_RECTANGLE (x1, y1, x2 - x1, y2 - y1),
+                               std_dev_x, std_dev_y);
+    }
 
   channel->bounds_known = FALSE;
 
@@ -1255,7 +1566,7 @@ gimp_channel_real_sharpen (GimpChannel *channel,
                            gboolean     push_undo)
 {
   GimpDrawable *drawable = GIMP_DRAWABLE (channel);
-  GeglNode     *node;
+  gint          x1, y1, x2, y2;
 
   if (push_undo)
     gimp_channel_push_undo (channel,
@@ -1263,16 +1574,24 @@ gimp_channel_real_sharpen (GimpChannel *channel,
   else
     gimp_drawable_invalidate_boundary (drawable);
 
-  node = gegl_node_new_child (NULL,
-                              "operation", "gegl:threshold",
-                              "value",     0.5,
-                              NULL);
+  /*  thresholding leaves the unselected pixels alone  */
+  if (gimp_channel_bounds (channel, &x1, &y1, &x2, &y2))
+    {
+      GeglBuffer    *buffer = gimp_drawable_get_buffer (drawable);
+      GeglRectangle  rect   = { x1, y1, x2 - x1, y2 - y1 };
+      GeglNode      *node;
 
-  gimp_drawable_apply_operation_to_buffer (drawable, NULL, NULL,
-                                           node,
-                                           gimp_drawable_get_buffer (drawable));
+      node = gegl_node_new_child (NULL,
+                                  "operation", "gegl:threshold",
+                                  "value",     0.5,
+                                  NULL);
 
-  g_object_unref (node);
+      gimp_apply_operation (buffer, NULL, NULL,
+                            node,
+                            buffer, &rect);
+
+      g_object_unref (node);
+    }
 
   channel->bounds_known = FALSE;
 
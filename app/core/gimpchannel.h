@@ -30,6 +30,7 @@
 
 
 typedef struct _GimpChannelClass GimpChannelClass;
+typedef struct _GimpBoundStrip   GimpBoundStrip;
 
 struct _GimpChannel
 {
@@ -49,6 +50,11 @@ struct _GimpChannel
   GimpBoundSeg *segs_out;          /*  outline of selected region     */
   gint          num_segs_in;       /*  number of lines in boundary    */
   gint          num_segs_out;      /*  number of lines in boundary    */
+  guint         boundary_stamp;    /*  changes with every new boundary */
+  GimpBoundStrip *strips;          /*  boundary per row of tiles      */
+  gint          num_strips;        /*  number of strips               */
+  gint          strips_x1, strips_y1; /*  bounds the strips are for   */
+  gint          strips_x2, strips_y2;
   gboolean      empty;             /*  is the region empty?           */
   gboolean      bounds_known;      /*  recalculate the bounds?        */
   gint          x1, y1;            /*  coordinates for bounding box   */
@@ -240,3 +240,43 @@ gimp_coords_direction (const GimpCoords *a,
 
   return direction;
 }
+
+
+/*  transforms the x and y members of an array of coords in place  */
+
+void
+gimp_coords_transform (const GimpMatrix3 *matrix,
+                       GimpCoords        *coords,
+                       gint               n_coords)
+{
+  gint i;
+
+  g_return_if_fail (matrix != NULL);
+  g_return_if_fail (n_coords == 0 || coords != NULL);
+
+  if (gimp_matrix3_is_affine (matrix))
+    {
+      const gdouble a = matrix->coeff[0][0];
+      const gdouble b = matrix->coeff[0][1];
+      const gdouble c = matrix->coeff[0][2];
+      const gdouble d = matrix->coeff[1][0];
+      const gdouble e = matrix->coeff[1][1];
+      const gdouble f = matrix->coeff[1][2];
+
+      for (i = 0; i < n_coords; i++)
+        {
+          gdouble x = coords[i].x;
+          gdouble y = coords[i].y;
+
+          coords[i].x = a * x + b * y + c;
+          coords[i].y = d * x + e * y + f;
+        }
+    }
+  else
+    {
+      for (i = 0; i < n_coords; i++)
+        gimp_matrix3_transform_point (matrix,
+                                      coords[i].x, coords[i].y,
+                                      &coords[i].x, &coords[i].y);
+    }
+}
@@ -53,5 +53,9 @@ gboolean gimp_coords_equal          (const GimpCoords *a,
 gdouble  gimp_coords_direction      (const GimpCoords *a,
                                      const GimpCoords *b);
 
+void     gimp_coords_transform      (const GimpMatrix3 *matrix,
+                                     GimpCoords        *coords,
+                                     gint               n_coords);
+
 
 #endif /* __GIMP_COORDS_H__ */
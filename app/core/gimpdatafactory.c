@@ -31,7 +31,10 @@
 
 #include "core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "gimp.h"
+#include "gimp-parallel.h"
 #include "gimpcontext.h"
 #include "gimpdata.h"
 #include "gimpdatafactory.h"
@@ -88,6 +91,12 @@ static void    gimp_data_factory_load_data  (const GimpDatafileData *file_data,
 
 static void    gimp_data_factory_load_data_recursive (const GimpDatafileData *file_data,
                                                       gpointer                data);
+static gboolean gimp_data_factory_can_load_threaded (GimpDataFactory        *factory);
+static void    gimp_data_factory_load_data_thread    (gint                    i,
+                                                      gint                    n,
+                                                      gpointer                data);
+static void    gimp_data_factory_load_data_finish    (gpointer                job,
+                                                      gpointer                data);
 
 G_DEFINE_TYPE (GimpDataFactory, gimp_data_factory, GIMP_TYPE_OBJECT)
 
@@ -310,8 +319,28 @@ typedef struct
   GimpContext     *context;
   GHashTable      *cache;
   const gchar     *top_directory;
+  gboolean         threaded;
+  GQueue           jobs;
+  GPtrArray       *threaded_jobs;
 } GimpDataLoadContext;
 
+/*  a data file found while scanning the data path; when loading in
+ *  parallel, the thread-safe loaders run on the core worker pool once
+ *  the scan is done, then the results are added to the containers on
+ *  the main thread in scanning order
+ */
+typedef struct
+{
+  const GimpDataFactoryLoaderEntry *loader;
+  gchar                            *filename;
+  gchar                            *dirname;
+  gchar                            *top_directory;
+  time_t                            mtime;
+
+  GList                            *data_list;
+  GError                           *error;
+} GimpDataLoadJob;
+
 static void
 gimp_data_factory_data_load (GimpDataFactory *factory,
                              GimpContext     *context,
@@ -351,6 +380,11 @@ gimp_data_factory_data_load (GimpDataFactory *factory,
                              WRITABLE_PATH_KEY, writable_list);
         }
 
+      g_queue_init (&load_context.jobs);
+
+      load_context.threaded      = gimp_data_factory_can_load_threaded (factory);
+      load_context.threaded_jobs = g_ptr_array_new ();
+
       gimp_datafiles_read_directories (path, G_FILE_TEST_IS_REGULAR,
                                        gimp_data_factory_load_data,
                                        &load_context);
@@ -359,6 +393,17 @@ gimp_data_factory_data_load (GimpDataFactory *factory,
                                        gimp_data_factory_load_data_recursive,
                                        &load_context);
 
+      gimp_parallel_distribute (load_context.threaded_jobs->len,
+                                gimp_data_factory_load_data_thread,
+                                load_context.threaded_jobs);
+
+      /*  add the data in the order the files were found  */
+      g_queue_foreach (&load_context.jobs,
+                       gimp_data_factory_load_data_finish, &load_context);
+      g_queue_clear (&load_context.jobs);
+
+      g_ptr_array_free (load_context.threaded_jobs, TRUE);
+
       if (writable_path)
         {
           gimp_path_free (writable_list);
@@ -835,8 +880,7 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
   GimpDataFactory                  *factory = context->factory;
   GHashTable                       *cache   = context->cache;
   const GimpDataFactoryLoaderEntry *loader  = NULL;
-  GError                           *error   = NULL;
-  GList                            *data_list;
+  GimpDataLoadJob                  *job;
   gint                              i;
 
   for (i = 0; i < factory->priv->n_loader_entries; i++)
@@ -866,25 +910,102 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
           gimp_data_get_mtime (cached_data->data) != 0 &&
           gimp_data_get_mtime (cached_data->data) == file_data->mtime)
         {
-          GList *list;
+          job = g_slice_new0 (GimpDataLoadJob);
 
-          for (list = cached_data; list; list = g_list_next (list))
-            gimp_container_add (factory->priv->container, list->data);
+          for (; cached_data; cached_data = g_list_next (cached_data))
+            job->data_list = g_list_prepend (job->data_list,
+                                             g_object_ref (cached_data->data));
+
+          job->data_list = g_list_reverse (job->data_list);
+
+          g_queue_push_tail (&context->jobs, job);
 
           return;
         }
     }
 
-  data_list = loader->load_func (context->context, file_data->filename, &error);
+  job = g_slice_new0 (GimpDataLoadJob);
+
+  job->loader        = loader;
+  job->filename      = g_strdup (file_data->filename);
+  job->dirname       = g_strdup (file_data->dirname);
+  job->top_directory = g_strdup (context->top_directory);
+  job->mtime         = file_data->mtime;
+
+  g_queue_push_tail (&context->jobs, job);
+
+  /*  everything else is loaded on the main thread when the job
+   *  is finished
+   */
+  if (context->threaded && loader->threadsafe)
+    g_ptr_array_add (context->threaded_jobs, job);
+}
+
+static gboolean
+gimp_data_factory_can_load_threaded (GimpDataFactory *factory)
+{
+  gint i;
+
+  if (gimp_parallel_get_n_threads () < 2)
+    return FALSE;
+
+  for (i = 0; i < factory->priv->n_loader_entries; i++)
+    {
+      if (factory->priv->loader_entries[i].threadsafe)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+gimp_data_factory_load_data_thread (gint     i,
+                                    gint     n,
+                                    gpointer data)
+{
+  GimpDataLoadJob *job = g_ptr_array_index ((GPtrArray *) data, i);
+
+  job->data_list = job->loader->load_func (NULL, job->filename, &job->error);
+}
+
+static void
+gimp_data_factory_load_data_finish (gpointer job_data,
+                                    gpointer data)
+{
+  GimpDataLoadJob     *job     = job_data;
+  GimpDataLoadContext *context = data;
+  GimpDataFactory     *factory = context->factory;
+  GList               *list;
+
+  if (! job->filename)
+    {
+      /*  unchanged data from the refresh cache  */
+      for (list = job->data_list; list; list = g_list_next (list))
+        {
+          gimp_container_add (factory->priv->container, list->data);
+          g_object_unref (list->data);
+        }
+
+      g_list_free (job->data_list);
+      g_slice_free (GimpDataLoadJob, job);
+
+      return;
+    }
+
+  /*  the thread-safe loaders already ran  */
+  if (! (context->threaded && job->loader->threadsafe))
+    {
+      job->data_list = job->loader->load_func (context->context,
+                                               job->filename, &job->error);
+    }
 
-  if (G_LIKELY (data_list))
+  if (G_LIKELY (job->data_list))
     {
-      GList    *list;
       gboolean  obsolete;
       gboolean  writable  = FALSE;
       gboolean  deletable = FALSE;
 
-      obsolete = (strstr (file_data->dirname,
+      obsolete = (strstr (job->dirname,
                           GIMP_OBSOLETE_DATA_DIR_NAME) != 0);
 
       /* obsolete files are immutable, don't check their writability */
@@ -895,20 +1016,20 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
           writable_list = g_object_get_data (G_OBJECT (factory),
                                              WRITABLE_PATH_KEY);
 
-          deletable = (g_list_length (data_list) == 1 &&
-                       gimp_data_factory_is_dir_writable (file_data->dirname,
+          deletable = (g_list_length (job->data_list) == 1 &&
+                       gimp_data_factory_is_dir_writable (job->dirname,
                                                           writable_list));
 
-          writable = (deletable && loader->writable);
+          writable = (deletable && job->loader->writable);
         }
 
-      for (list = data_list; list; list = g_list_next (list))
+      for (list = job->data_list; list; list = g_list_next (list))
         {
           GimpData *data = list->data;
 
-          gimp_data_set_filename (data, file_data->filename,
+          gimp_data_set_filename (data, job->filename,
                                   writable, deletable);
-          gimp_data_set_mtime (data, file_data->mtime);
+          gimp_data_set_mtime (data, job->mtime);
 
           gimp_data_clean (data);
 
@@ -919,7 +1040,7 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
             }
           else
             {
-              gimp_data_set_folder_tags (data, context->top_directory);
+              gimp_data_set_folder_tags (data, job->top_directory);
 
               gimp_container_add (factory->priv->container,
                                   GIMP_OBJECT (data));
@@ -928,13 +1049,19 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
           g_object_unref (data);
         }
 
-      g_list_free (data_list);
+      g_list_free (job->data_list);
     }
 
-  if (G_UNLIKELY (error))
+  if (G_UNLIKELY (job->error))
     {
       gimp_message (factory->priv->gimp, NULL, GIMP_MESSAGE_ERROR,
-                    _("Failed to load data:\n\n%s"), error->message);
-      g_clear_error (&error);
+                    _("Failed to load data:\n\n%s"), job->error->message);
+      g_clear_error (&job->error);
     }
+
+  g_free (job->filename);
+  g_free (job->dirname);
+  g_free (job->top_directory);
+
+  g_slice_free (GimpDataLoadJob, job);
 }
@@ -33,6 +33,7 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-parallel.h"
 #include "gimp-utils.h"
 #include "gimp-apply-operation.h"
 #include "gimpchannel.h"
@@ -45,7 +46,15 @@
 #include "gimp-intl.h"
 
 
-//#define USE_GRADIENT_CACHE 1
+/*  the gradient is evaluated through a lookup table of at least
+ *  BLEND_LUT_MIN_SIZE entries, or two per pixel of the blend's length
+ */
+#define BLEND_LUT_MIN_SIZE 4096
+#define BLEND_LUT_MAX_SIZE (1 << 16)
+
+#define BLEND_STRIP_PIXELS (1 << 16)
+
+#define SHAPEBURST_CACHE_KEY "gimp-blend-shapeburst-cache"
 
 
 typedef struct
@@ -53,10 +62,8 @@ typedef struct
   GimpGradient     *gradient;
   GimpContext      *context;
   gboolean          reverse;
-#ifdef USE_GRADIENT_CACHE
-  GimpRGB          *gradient_cache;
-  gint              gradient_cache_size;
-#endif
+  GimpRGB          *lut;
+  gint              lut_size;
   gdouble           offset;
   gdouble           sx, sy;
   GimpBlendMode     blend_mode;
@@ -65,17 +72,53 @@ typedef struct
   gdouble           dist;
   gdouble           vec[2];
   GimpRepeatMode    repeat;
-  GRand            *seed;
   GeglBuffer       *dist_buffer;
 } RenderBlendData;
 
+/*  the last distance map of an image, valid as long as its source
+ *  drawable is unchanged
+ */
 typedef struct
 {
-  GeglBuffer    *buffer;
-  gfloat        *row_data;
-  gint           width;
-  GRand         *dither_rand;
-} PutPixelData;
+  gboolean          white;       /*  made without any source       */
+  GimpDrawable     *source;      /*  weak, NULL if white or gone   */
+  guint             dirty_stamp;
+  GeglRectangle     rect;
+  GeglBuffer       *dist_buffer;
+} ShapeburstCache;
+
+typedef struct _BlendScan  BlendScan;
+typedef struct _BlendStrip BlendStrip;
+
+struct _BlendScan
+{
+  RenderBlendData  *rbd;
+  gboolean          supersample;
+  gint              max_depth;
+  gdouble           threshold;
+  gboolean          dither;
+
+  /*  size of rbd->dist_buffer  */
+  gint              dist_width;
+  gint              dist_height;
+};
+
+struct _BlendStrip
+{
+  BlendScan        *scan;
+
+  GeglRectangle     rect;
+  gfloat           *data;
+
+  /*  the shapeburst distances of the strip's rows, plus the row
+   *  below, which the supersampler's bottom corners need
+   */
+  gfloat           *dist;
+  gint              dist_y;
+  gint              dist_rows;
+
+  GRand            *dither_rand;
+};
 
 
 /*  local function prototypes  */
@@ -115,22 +158,23 @@ static gdouble  gradient_calc_spiral_factor       (gdouble   dist,
                                                    gdouble   y,
                                                    gboolean  clockwise);
 
-static gdouble  gradient_calc_shapeburst_angular_factor   (GeglBuffer *dist_buffer,
-                                                           gdouble     x,
-                                                           gdouble     y);
-static gdouble  gradient_calc_shapeburst_spherical_factor (GeglBuffer *dist_buffer,
-                                                           gdouble     x,
-                                                           gdouble     y);
-static gdouble  gradient_calc_shapeburst_dimpled_factor   (GeglBuffer *dist_buffer,
-                                                           gdouble     x,
-                                                           gdouble     y);
+static gdouble  gradient_calc_shapeburst_angular_factor   (gdouble     value);
+static gdouble  gradient_calc_shapeburst_spherical_factor (gdouble     value);
+static gdouble  gradient_calc_shapeburst_dimpled_factor   (gdouble     value);
 
+static void         gradient_shapeburst_cache_free (ShapeburstCache *cache);
 static GeglBuffer * gradient_precalc_shapeburst (GimpImage           *image,
                                                  GimpDrawable        *drawable,
                                                  const GeglRectangle *region,
                                                  gdouble              dist,
                                                  GimpProgress        *progress);
 
+static gdouble  gradient_calc_factor        (BlendStrip          *strip,
+                                             gdouble              x,
+                                             gdouble              y);
+static void     gradient_calc_color         (RenderBlendData     *rbd,
+                                             gdouble              factor,
+                                             GimpRGB             *color);
 static void     gradient_render_pixel       (gdouble              x,
                                              gdouble              y,
                                              GimpRGB             *color,
@@ -139,6 +183,10 @@ static void     gradient_put_pixel          (gint                 x,
                                              gint                 y,
                                              GimpRGB             *color,
                                              gpointer             put_pixel_data);
+static void     gradient_render_strip       (BlendStrip          *strip);
+static void     gradient_render_strip_func  (gint                 i,
+                                             gint                 n,
+                                             BlendStrip          *strips);
 
 static void     gradient_fill_region        (GimpImage           *image,
                                              GimpDrawable        *drawable,
@@ -474,59 +522,23 @@ gradient_calc_spiral_factor (gdouble   dist,
 }
 
 static gdouble
-gradient_calc_shapeburst_angular_factor (GeglBuffer *dist_buffer,
-                                         gdouble     x,
-                                         gdouble     y)
+gradient_calc_shapeburst_angular_factor (gdouble value)
 {
-  gint   ix = CLAMP (x, 0.0, gegl_buffer_get_width  (dist_buffer) - 0.7);
-  gint   iy = CLAMP (y, 0.0, gegl_buffer_get_height (dist_buffer) - 0.7);
-  gfloat value;
-
-  gegl_buffer_get (dist_buffer, GEGL_RECTANGLE (ix, iy, 1, 1), 1.0,
-                   NULL, &value,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  value = 1.0 - value;
-
-  return value;
+  return 1.0 - value;
 }
 
 
 static gdouble
-gradient_calc_shapeburst_spherical_factor (GeglBuffer *dist_buffer,
-                                           gdouble     x,
-                                           gdouble     y)
+gradient_calc_shapeburst_spherical_factor (gdouble value)
 {
-  gint   ix = CLAMP (x, 0.0, gegl_buffer_get_width  (dist_buffer) - 0.7);
-  gint   iy = CLAMP (y, 0.0, gegl_buffer_get_height (dist_buffer) - 0.7);
-  gfloat value;
-
-  gegl_buffer_get (dist_buffer, GEGL_RECTANGLE (ix, iy, 1, 1), 1.0,
-                   NULL, &value,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  value = 1.0 - sin (0.5 * G_PI * value);
-
-  return value;
+  return 1.0 - sin (0.5 * G_PI * value);
 }
 
 
 static gdouble
-gradient_calc_shapeburst_dimpled_factor (GeglBuffer *dist_buffer,
-                                         gdouble     x,
-                                         gdouble     y)
+gradient_calc_shapeburst_dimpled_factor (gdouble value)
 {
-  gint   ix = CLAMP (x, 0.0, gegl_buffer_get_width  (dist_buffer) - 0.7);
-  gint   iy = CLAMP (y, 0.0, gegl_buffer_get_height (dist_buffer) - 0.7);
-  gfloat value;
-
-  gegl_buffer_get (dist_buffer, GEGL_RECTANGLE (ix, iy, 1, 1), 1.0,
-                   NULL, &value,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  value = cos (0.5 * G_PI * value);
-
-  return value;
+  return cos (0.5 * G_PI * value);
 }
 
 static GeglBuffer *
@@ -536,12 +548,50 @@ gradient_precalc_shapeburst (GimpImage           *image,
                              gdouble              dist,
                              GimpProgress        *progress)
 {
-  GimpChannel *mask;
-  GeglBuffer  *dist_buffer;
-  GeglBuffer  *temp_buffer;
-  GeglNode    *shapeburst;
-  gdouble      max;
-  gfloat       max_iteration;
+  GimpChannel     *mask;
+  GimpDrawable    *source;
+  GeglRectangle    source_rect;
+  ShapeburstCache *cache;
+  GeglBuffer      *dist_buffer;
+  GeglBuffer      *temp_buffer;
+  GeglNode        *shapeburst;
+  gdouble          max;
+  gfloat           max_iteration;
+
+  mask = gimp_image_get_mask (image);
+
+  /*  If the image mask is not empty, it is the shape burst source,
+   *  otherwise the drawable's alpha is, if it has any. Without either,
+   *  the map only depends on the region's size.
+   */
+  if (! gimp_channel_is_empty (mask))
+    {
+      gint x, y, width, height;
+      gint off_x, off_y;
+
+      gimp_item_mask_intersect (GIMP_ITEM (drawable), &x, &y, &width, &height);
+      gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
+
+      source      = GIMP_DRAWABLE (mask);
+      source_rect = *GEGL_RECTANGLE (x + off_x, y + off_y, width, height);
+    }
+  else
+    {
+      source      = gimp_drawable_has_alpha (drawable) ? drawable : NULL;
+      source_rect = *region;
+    }
+
+  cache = g_object_get_data (G_OBJECT (image), SHAPEBURST_CACHE_KEY);
+
+  if (cache                                             &&
+      gegl_rectangle_equal (&cache->rect, &source_rect) &&
+      (source ?
+       (cache->source      == source &&
+        cache->dirty_stamp == gimp_drawable_get_dirty_stamp (source)) :
+       cache->white))
+    {
+      return g_object_ref (cache->dist_buffer);
+    }
 
   gimp_progress_set_text (progress, _("Calculating distance map"));
 
@@ -555,27 +605,18 @@ gradient_precalc_shapeburst (GimpImage           *image,
                                                  region->width, region->height),
                                  gimp_image_get_mask_format (image));
 
-  mask = gimp_image_get_mask (image);
-
-  /*  If the image mask is not empty, use it as the shape burst source  */
-  if (! gimp_channel_is_empty (mask))
+  if (source == GIMP_DRAWABLE (mask))
     {
-      gint x, y, width, height;
-      gint off_x, off_y;
-
-      gimp_item_mask_intersect (GIMP_ITEM (drawable), &x, &y, &width, &height);
-      gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
-
       /*  copy the mask to the temp mask  */
-      gegl_buffer_copy (gimp_drawable_get_buffer (GIMP_DRAWABLE (mask)),
-                        GEGL_RECTANGLE (x + off_x, y + off_y, width, height),
+      gegl_buffer_copy (gimp_drawable_get_buffer (source),
+                        &source_rect,
                         temp_buffer,
                         GEGL_RECTANGLE (0, 0, 0, 0));
     }
   else
     {
       /*  If the intended drawable has an alpha channel, use that  */
-      if (gimp_drawable_has_alpha (drawable))
+      if (source)
         {
           const Babl *component_format;
 
@@ -636,18 +677,55 @@ gradient_precalc_shapeburst (GimpImage           *image,
         }
     }
 
+  cache = g_slice_new (ShapeburstCache);
+
+  cache->white       = (source == NULL);
+  cache->source      = source;
+  cache->dirty_stamp = source ? gimp_drawable_get_dirty_stamp (source) : 0;
+  cache->rect        = source_rect;
+  cache->dist_buffer = g_object_ref (dist_buffer);
+
+  if (source)
+    g_object_add_weak_pointer (G_OBJECT (source), (gpointer) &cache->source);
+
+  g_object_set_data_full (G_OBJECT (image), SHAPEBURST_CACHE_KEY, cache,
+                          (GDestroyNotify) gradient_shapeburst_cache_free);
+
   return dist_buffer;
 }
 
-
 static void
-gradient_render_pixel (gdouble   x,
-                       gdouble   y,
-                       GimpRGB  *color,
-                       gpointer  render_data)
+gradient_shapeburst_cache_free (ShapeburstCache *cache)
+{
+  if (cache->source)
+    g_object_remove_weak_pointer (G_OBJECT (cache->source),
+                                  (gpointer) &cache->source);
+
+  g_object_unref (cache->dist_buffer);
+
+  g_slice_free (ShapeburstCache, cache);
+}
+
+
+static gdouble
+gradient_calc_factor (BlendStrip *strip,
+                      gdouble     x,
+                      gdouble     y)
 {
-  RenderBlendData *rbd = render_data;
+  RenderBlendData *rbd = strip->scan->rbd;
   gdouble          factor;
+  gdouble          value = 0.0;
+
+  if (strip->dist)
+    {
+      BlendScan *scan = strip->scan;
+      gint       ix   = CLAMP (x, 0.0, scan->dist_width  - 0.7);
+      gint       iy   = CLAMP (y, 0.0, scan->dist_height - 0.7);
+
+      iy = CLAMP (iy, strip->dist_y, strip->dist_y + strip->dist_rows - 1);
+
+      value = strip->dist[(iy - strip->dist_y) * scan->dist_width + ix];
+    }
 
   /* Calculate blending factor */
 
@@ -689,15 +767,15 @@ gradient_render_pixel (gdouble   x,
       break;
 
     case GIMP_GRADIENT_SHAPEBURST_ANGULAR:
-      factor = gradient_calc_shapeburst_angular_factor (rbd->dist_buffer, x, y);
+      factor = gradient_calc_shapeburst_angular_factor (value);
       break;
 
     case GIMP_GRADIENT_SHAPEBURST_SPHERICAL:
-      factor = gradient_calc_shapeburst_spherical_factor (rbd->dist_buffer, x, y);
+      factor = gradient_calc_shapeburst_spherical_factor (value);
       break;
 
     case GIMP_GRADIENT_SHAPEBURST_DIMPLED:
-      factor = gradient_calc_shapeburst_dimpled_factor (rbd->dist_buffer, x, y);
+      factor = gradient_calc_shapeburst_dimpled_factor (value);
       break;
 
     case GIMP_GRADIENT_SPIRAL_CLOCKWISE:
@@ -714,7 +792,7 @@ gradient_render_pixel (gdouble   x,
 
     default:
       g_assert_not_reached ();
-      return;
+      return 0.0;
     }
 
   /* Adjust for repeat */
@@ -745,16 +823,20 @@ gradient_render_pixel (gdouble   x,
       break;
     }
 
+  return factor;
+}
+
+static void
+gradient_calc_color (RenderBlendData *rbd,
+                     gdouble          factor,
+                     GimpRGB         *color)
+{
   /* Blend the colors */
 
   if (rbd->blend_mode == GIMP_CUSTOM_MODE)
     {
-#ifdef USE_GRADIENT_CACHE
-      *color = rbd->gradient_cache[(gint) (factor * (rbd->gradient_cache_size - 1))];
-#else
       gimp_gradient_get_color_at (rbd->gradient, rbd->context, NULL,
                                   factor, rbd->reverse, color);
-#endif
     }
   else
     {
@@ -777,18 +859,35 @@ gradient_render_pixel (gdouble   x,
     }
 }
 
+static void
+gradient_render_pixel (gdouble   x,
+                       gdouble   y,
+                       GimpRGB  *color,
+                       gpointer  render_data)
+{
+  BlendStrip      *strip  = render_data;
+  RenderBlendData *rbd    = strip->scan->rbd;
+  gdouble          factor = gradient_calc_factor (strip, x, y);
+
+  if (rbd->lut)
+    *color = rbd->lut[(gint) (factor * (rbd->lut_size - 1) + 0.5)];
+  else
+    gradient_calc_color (rbd, factor, color);
+}
+
 static void
 gradient_put_pixel (gint      x,
                     gint      y,
                     GimpRGB  *color,
                     gpointer  put_pixel_data)
 {
-  PutPixelData *ppd  = put_pixel_data;
-  gfloat       *dest = ppd->row_data + 4 * x;
+  BlendStrip *strip = put_pixel_data;
+  gfloat     *dest  = strip->data + 4 * ((y - strip->rect.y) * strip->rect.width +
+                                         (x - strip->rect.x));
 
-  if (ppd->dither_rand)
+  if (strip->dither_rand)
     {
-      gint i = g_rand_int (ppd->dither_rand);
+      gint i = g_rand_int (strip->dither_rand);
 
       *dest++ = color->r + (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
       *dest++ = color->g + (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
@@ -802,13 +901,46 @@ gradient_put_pixel (gint      x,
       *dest++ = color->b;
       *dest++ = color->a;
     }
+}
+
+static void
+gradient_render_strip (BlendStrip *strip)
+{
+  BlendScan           *scan = strip->scan;
+  const GeglRectangle *rect = &strip->rect;
+
+  if (scan->supersample)
+    {
+      gimp_adaptive_supersample_area (rect->x,
+                                      rect->y,
+                                      rect->x + rect->width  - 1,
+                                      rect->y + rect->height - 1,
+                                      scan->max_depth, scan->threshold,
+                                      gradient_render_pixel, strip,
+                                      gradient_put_pixel, strip,
+                                      NULL, NULL);
+    }
+  else
+    {
+      gint x, y;
 
-  /* Paint whole row if we are on the rightmost pixel */
+      for (y = rect->y; y < rect->y + rect->height; y++)
+        for (x = rect->x; x < rect->x + rect->width; x++)
+          {
+            GimpRGB color;
 
-  if (x == (ppd->width - 1))
-    gegl_buffer_set (ppd->buffer, GEGL_RECTANGLE (0, y, ppd->width, 1),
-                     0, babl_format ("R'G'B'A float"), ppd->row_data,
-                     GEGL_AUTO_ROWSTRIDE);
+            gradient_render_pixel (x, y, &color, strip);
+            gradient_put_pixel (x, y, &color, strip);
+          }
+    }
+}
+
+static void
+gradient_render_strip_func (gint        i,
+                            gint        n,
+                            BlendStrip *strips)
+{
+  gradient_render_strip (&strips[i]);
 }
 
 static void
@@ -832,7 +964,14 @@ gradient_fill_region (GimpImage           *image,
                       gdouble              ey,
                       GimpProgress        *progress)
 {
-  RenderBlendData rbd = { 0, };
+  RenderBlendData  rbd       = { 0, };
+  BlendScan        scan      = { 0, };
+  BlendStrip      *strips;
+  GRand           *seed      = NULL;
+  gint             n_threads = 1;
+  gint             strip_height;
+  gint             y;
+  gint             i;
 
   GIMP_TIMER_START();
 
@@ -840,24 +979,6 @@ gradient_fill_region (GimpImage           *image,
   rbd.context  = context;
   rbd.reverse  = reverse;
 
-#ifdef USE_GRADIENT_CACHE
-  {
-    gint i;
-
-    rbd.gradient_cache_size = ceil (sqrt (SQR (sx - ex) + SQR (sy - ey)));
-    rbd.gradient_cache      = g_new0 (GimpRGB, rbd.gradient_cache_size);
-
-    for (i = 0; i < rbd.gradient_cache_size; i++)
-      {
-        gdouble factor = (gdouble) i / (gdouble) (rbd.gradient_cache_size - 1);
-
-        gimp_gradient_get_color_at (rbd.gradient, rbd.context, NULL,
-                                    factor, rbd.reverse,
-                                    rbd.gradient_cache + i);
-      }
-  }
-#endif
-
   if (gimp_gradient_has_fg_bg_segments (rbd.gradient))
     rbd.gradient = gimp_gradient_flatten (rbd.gradient, context);
   else
@@ -954,100 +1075,130 @@ gradient_fill_region (GimpImage           *image,
 
   /* Render the gradient! */
 
-  if (supersample)
+  if (! supersample)
     {
-      PutPixelData  ppd;
-
-      ppd.buffer      = buffer;
-      ppd.row_data    = g_malloc (sizeof (float) * 4 * buffer_region->width);
-      ppd.width       = buffer_region->width;
-      ppd.dither_rand = g_rand_new ();
-
-      gimp_adaptive_supersample_area (0, 0,
-                                      (buffer_region->width  - 1),
-                                      (buffer_region->height - 1),
-                                      max_depth, threshold,
-                                      gradient_render_pixel, &rbd,
-                                      gradient_put_pixel, &ppd,
-                                      progress ?
-                                      gimp_progress_update_and_flush : NULL,
-                                      progress);
-
-      g_rand_free (ppd.dither_rand);
-      g_free (ppd.row_data);
+      /*  the supersampler compares samples against the threshold,
+       *  so only the plain path goes through the lookup table
+       */
+      rbd.lut_size = CLAMP (2.0 * ceil (rbd.dist),
+                            BLEND_LUT_MIN_SIZE, BLEND_LUT_MAX_SIZE);
+      rbd.lut      = g_new (GimpRGB, rbd.lut_size);
+
+      for (i = 0; i < rbd.lut_size; i++)
+        gradient_calc_color (&rbd, (gdouble) i / (rbd.lut_size - 1),
+                             &rbd.lut[i]);
     }
-  else
+
+  scan.rbd         = &rbd;
+  scan.supersample = supersample;
+  scan.max_depth   = max_depth;
+  scan.threshold   = threshold;
+  scan.dither      = dither;
+
+  if (rbd.dist_buffer)
     {
-      GeglBufferIterator *iter;
-      GeglRectangle      *roi;
-      gint                total = buffer_region->width * buffer_region->height;
-      gint                done  = 0;
+      scan.dist_width  = gegl_buffer_get_width  (rbd.dist_buffer);
+      scan.dist_height = gegl_buffer_get_height (rbd.dist_buffer);
+    }
 
-      iter = gegl_buffer_iterator_new (buffer, buffer_region, 0,
-                                       babl_format ("R'G'B'A float"),
-                                       GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
-      roi = &iter->roi[0];
+  /*  the supersampler always dithered  */
+  if (supersample || dither)
+    seed = g_rand_new ();
 
-      if (dither)
-        rbd.seed = g_rand_new ();
+  strip_height = CLAMP (BLEND_STRIP_PIXELS / buffer_region->width,
+                        1, buffer_region->height);
 
-      while (gegl_buffer_iterator_next (iter))
-        {
-          gfloat *dest = iter->data[0];
-          gint    endx  = roi->x + roi->width;
-          gint    endy  = roi->y + roi->height;
-          gint    x, y;
+  n_threads = CLAMP (gimp_parallel_get_n_threads (), 1,
+                     (buffer_region->height + strip_height - 1) /
+                     strip_height);
 
-          if (rbd.seed)
-            {
-              GRand *dither_rand = g_rand_new_with_seed (g_rand_int (rbd.seed));
+  strips = g_new0 (BlendStrip, n_threads);
 
-              for (y = roi->y; y < endy; y++)
-                for (x = roi->x; x < endx; x++)
-                  {
-                    GimpRGB  color;
-                    gint     i = g_rand_int (dither_rand);
+  for (i = 0; i < n_threads; i++)
+    {
+      BlendStrip *strip = &strips[i];
 
-                    gradient_render_pixel (x, y, &color, &rbd);
+      strip->scan = &scan;
+      strip->data = g_new (gfloat, 4 * buffer_region->width * strip_height);
 
-                    *dest++ = color.r + (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
-                    *dest++ = color.g + (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
-                    *dest++ = color.b + (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
-                    *dest++ = color.a + (gdouble) (i & 0xff) / 256.0 / 256.0;
-                  }
+      if (rbd.dist_buffer)
+        strip->dist = g_new (gfloat, scan.dist_width * (strip_height + 1));
 
-              g_rand_free (dither_rand);
-            }
-          else
+      if (seed)
+        strip->dither_rand = g_rand_new ();
+    }
+
+  for (y = buffer_region->y; y < buffer_region->y + buffer_region->height;)
+    {
+      gint n_strips;
+
+      /*  fetch all pixels that are read on the calling thread, and seed
+       *  the strips in order so the result doesn't depend on the number
+       *  of threads
+       */
+      for (n_strips = 0;
+           n_strips < n_threads &&
+           y < buffer_region->y + buffer_region->height;
+           n_strips++)
+        {
+          BlendStrip *strip = &strips[n_strips];
+
+          strip->rect.x      = buffer_region->x;
+          strip->rect.y      = y;
+          strip->rect.width  = buffer_region->width;
+          strip->rect.height = MIN (strip_height,
+                                    buffer_region->y + buffer_region->height - y);
+
+          if (strip->dist)
             {
-              for (y = roi->y; y < endy; y++)
-                for (x = roi->x; x < endx; x++)
-                  {
-                    GimpRGB  color;
-
-                    gradient_render_pixel (x, y, &color, &rbd);
-
-                    *dest++ = color.r;
-                    *dest++ = color.g;
-                    *dest++ = color.b;
-                    *dest++ = color.a;
-                  }
+              strip->dist_y    = CLAMP (y, 0, scan.dist_height - 1);
+              strip->dist_rows = MIN (strip->rect.height + 1,
+                                      scan.dist_height - strip->dist_y);
+
+              gegl_buffer_get (rbd.dist_buffer,
+                               GEGL_RECTANGLE (0, strip->dist_y,
+                                               scan.dist_width,
+                                               strip->dist_rows),
+                               1.0, NULL, strip->dist,
+                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
             }
 
-          done += roi->width * roi->height;
+          if (strip->dither_rand)
+            g_rand_set_seed (strip->dither_rand, g_rand_int (seed));
 
-          if (progress)
-            gimp_progress_set_value (progress,
-                                     (gdouble) done / (gdouble) total);
+          y += strip->rect.height;
         }
 
-      if (dither)
-        g_rand_free (rbd.seed);
+      gimp_parallel_distribute (n_strips,
+                                (GimpParallelDistributeFunc) gradient_render_strip_func,
+                                strips);
+
+      for (i = 0; i < n_strips; i++)
+        gegl_buffer_set (buffer, &strips[i].rect, 0,
+                         babl_format ("R'G'B'A float"), strips[i].data,
+                         GEGL_AUTO_ROWSTRIDE);
+
+      if (progress)
+        gimp_progress_set_value (progress,
+                                 (gdouble) (y - buffer_region->y) /
+                                 (gdouble) buffer_region->height);
+    }
+
+  for (i = 0; i < n_threads; i++)
+    {
+      g_free (strips[i].data);
+      g_free (strips[i].dist);
+
+      if (strips[i].dither_rand)
+        g_rand_free (strips[i].dither_rand);
     }
 
-#ifdef USE_GRADIENT_CACHE
-  g_free (rbd.gradient_cache);
-#endif
+  g_free (strips);
+
+  if (seed)
+    g_rand_free (seed);
+
+  g_free (rbd.lut);
 
   g_object_unref (rbd.gradient);
 
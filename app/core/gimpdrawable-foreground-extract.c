@@ -15,6 +15,15 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/* Disabled together with the Foreground Select tool: base/siox.c, which
+ * did the actual work on TileManagers, is gone and the GEGL based
+ * replacement doesn't exist yet.  When it is written, keep the colour
+ * signatures in the state between refinements and reclassify only the
+ * pixels near the parts of the trimap that changed, distributing the
+ * classification over tiles with gimp_parallel_distribute_area(),
+ * instead of redoing the whole region for every stroke.
+ */
+
 #if 0
 
 #include "config.h"
@@ -27,10 +27,44 @@
 
 #include "gimpchannel.h"
 #include "gimpdrawable-histogram.h"
+#include "gimpdrawable-private.h"
 #include "gimphistogram.h"
 #include "gimpimage.h"
 
 
+/*  the size of the blocks whose histograms are cached  */
+#define HISTOGRAM_BLOCK_SIZE 256
+
+
+/*  The histogram of a whole drawable is kept as the sum of the
+ *  histograms of HISTOGRAM_BLOCK_SIZE blocks. Updating a part of the
+ *  drawable only invalidates the blocks it touches, the next
+ *  calculation recounts them and adjusts the sum by their difference.
+ */
+typedef struct _GimpDrawableHistogramCache GimpDrawableHistogramCache;
+
+struct _GimpDrawableHistogramCache
+{
+  gint            width;
+  gint            height;
+  gint            n_cols;
+  gint            n_rows;
+  GimpHistogram **blocks;
+  gboolean       *valid;
+  gint            n_valid;
+  GimpHistogram  *total;
+};
+
+
+static GimpDrawableHistogramCache *
+            gimp_drawable_histogram_cache_new  (gint                        width,
+                                                gint                        height);
+static void gimp_drawable_histogram_cache_free (GimpDrawableHistogramCache *cache);
+static void gimp_drawable_histogram_cache_calculate
+                                               (GimpDrawable               *drawable,
+                                                GimpHistogram              *histogram);
+
+
 void
 gimp_drawable_calculate_histogram (GimpDrawable  *drawable,
                                    GimpHistogram *histogram)
@@ -113,10 +147,181 @@ gimp_drawable_calculate_histogram (GimpDrawable  *drawable,
         }
       else
         {
-          gimp_histogram_calculate (histogram,
-                                    gimp_drawable_get_buffer (drawable),
-                                    GEGL_RECTANGLE (x, y, width, height),
-                                    NULL, NULL);
+          gimp_drawable_histogram_cache_calculate (drawable, histogram);
+        }
+    }
+}
+
+/**
+ * gimp_drawable_invalidate_histogram:
+ * @drawable: a #GimpDrawable
+ * @rect:     the changed area, or %NULL if the whole drawable changed
+ *
+ * Invalidates the cached histograms of the parts of @drawable touched
+ * by @rect, or drops the cache altogether.
+ **/
+void
+gimp_drawable_invalidate_histogram (GimpDrawable        *drawable,
+                                    const GeglRectangle *rect)
+{
+  GimpDrawableHistogramCache *cache;
+  gint                        col1, col2;
+  gint                        row1, row2;
+  gint                        row;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+
+  cache = drawable->private->histogram_cache;
+
+  if (! cache)
+    return;
+
+  if (! rect)
+    {
+      gimp_drawable_histogram_cache_free (cache);
+      drawable->private->histogram_cache = NULL;
+
+      return;
+    }
+
+  if (rect->width < 1 || rect->height < 1)
+    return;
+
+  col1 = CLAMP (rect->x / HISTOGRAM_BLOCK_SIZE, 0, cache->n_cols);
+  row1 = CLAMP (rect->y / HISTOGRAM_BLOCK_SIZE, 0, cache->n_rows);
+  col2 = CLAMP ((rect->x + rect->width  + HISTOGRAM_BLOCK_SIZE - 1) /
+                HISTOGRAM_BLOCK_SIZE, 0, cache->n_cols);
+  row2 = CLAMP ((rect->y + rect->height + HISTOGRAM_BLOCK_SIZE - 1) /
+                HISTOGRAM_BLOCK_SIZE, 0, cache->n_rows);
+
+  for (row = row1; row < row2; row++)
+    {
+      gint col;
+
+      for (col = col1; col < col2; col++)
+        {
+          gint i = row * cache->n_cols + col;
+
+          if (cache->valid[i])
+            {
+              cache->valid[i] = FALSE;
+              cache->n_valid--;
+            }
         }
     }
 }
+
+
+/*  private functions  */
+
+static GimpDrawableHistogramCache *
+gimp_drawable_histogram_cache_new (gint width,
+                                   gint height)
+{
+  GimpDrawableHistogramCache *cache;
+
+  cache = g_slice_new0 (GimpDrawableHistogramCache);
+
+  cache->width  = width;
+  cache->height = height;
+  cache->n_cols = (width  + HISTOGRAM_BLOCK_SIZE - 1) / HISTOGRAM_BLOCK_SIZE;
+  cache->n_rows = (height + HISTOGRAM_BLOCK_SIZE - 1) / HISTOGRAM_BLOCK_SIZE;
+  cache->blocks = g_new0 (GimpHistogram *, cache->n_cols * cache->n_rows);
+  cache->valid  = g_new0 (gboolean, cache->n_cols * cache->n_rows);
+  cache->total  = gimp_histogram_new ();
+
+  return cache;
+}
+
+static void
+gimp_drawable_histogram_cache_free (GimpDrawableHistogramCache *cache)
+{
+  gint i;
+
+  for (i = 0; i < cache->n_cols * cache->n_rows; i++)
+    {
+      if (cache->blocks[i])
+        gimp_histogram_unref (cache->blocks[i]);
+    }
+
+  g_free (cache->blocks);
+  g_free (cache->valid);
+  gimp_histogram_unref (cache->total);
+
+  g_slice_free (GimpDrawableHistogramCache, cache);
+}
+
+static void
+gimp_drawable_histogram_cache_calculate (GimpDrawable  *drawable,
+                                         GimpHistogram *histogram)
+{
+  GimpDrawableHistogramCache *cache;
+  GeglBuffer                 *buffer;
+  gint                        width;
+  gint                        height;
+  gint                        n_blocks;
+  gboolean                    resum;
+  gint                        i;
+
+  buffer = gimp_drawable_get_buffer (drawable);
+  width  = gimp_item_get_width  (GIMP_ITEM (drawable));
+  height = gimp_item_get_height (GIMP_ITEM (drawable));
+
+  cache = drawable->private->histogram_cache;
+
+  if (cache && (cache->width != width || cache->height != height))
+    {
+      gimp_drawable_histogram_cache_free (cache);
+      cache = NULL;
+    }
+
+  if (! cache)
+    {
+      cache = gimp_drawable_histogram_cache_new (width, height);
+      drawable->private->histogram_cache = cache;
+    }
+
+  n_blocks = cache->n_cols * cache->n_rows;
+
+  /*  adjusting the sum by differences is only worth it for a few
+   *  blocks, and keeps rounding errors from piling up that way
+   */
+  resum = (n_blocks - cache->n_valid) * 2 > n_blocks;
+
+  for (i = 0; i < n_blocks; i++)
+    {
+      GeglRectangle rect;
+
+      if (cache->valid[i])
+        continue;
+
+      rect.x      = (i % cache->n_cols) * HISTOGRAM_BLOCK_SIZE;
+      rect.y      = (i / cache->n_cols) * HISTOGRAM_BLOCK_SIZE;
+      rect.width  = MIN (HISTOGRAM_BLOCK_SIZE, width  - rect.x);
+      rect.height = MIN (HISTOGRAM_BLOCK_SIZE, height - rect.y);
+
+      if (! cache->blocks[i])
+        cache->blocks[i] = gimp_histogram_new ();
+      else if (! resum)
+        gimp_histogram_add (cache->total, cache->blocks[i], -1.0);
+
+      gimp_histogram_calculate (cache->blocks[i], buffer, &rect, NULL, NULL);
+
+      if (! resum)
+        gimp_histogram_add (cache->total, cache->blocks[i], 1.0);
+
+      cache->valid[i] = TRUE;
+      cache->n_valid++;
+    }
+
+  if (resum)
+    {
+      gimp_histogram_clear_values (cache->total);
+
+      for (i = 0; i < n_blocks; i++)
+        gimp_histogram_add (cache->total, cache->blocks[i], 1.0);
+    }
+
+  gimp_histogram_clear_values (histogram);
+  gimp_histogram_add (histogram, cache->total, 1.0);
+}
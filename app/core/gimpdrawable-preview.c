@@ -21,12 +21,15 @@
 
 #include <gegl.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
 
 #include "core-types.h"
 
 #include "base/pixel-region.h"
+#include "base/tile-manager.h"
 #include "base/tile-manager-preview.h"
+#include "base/tile-pyramid.h"
 
 #include "paint-funcs/subsample-region.h"
 
@@ -49,6 +52,15 @@
 static GimpTempBuf * gimp_drawable_preview_private (GimpDrawable *drawable,
                                                     gint          width,
                                                     gint          height);
+static GimpTempBuf * gimp_drawable_pyramid_preview (GimpDrawable *drawable,
+                                                    gint          width,
+                                                    gint          height);
+static TileManager * gimp_drawable_pyramid_tiles   (GimpDrawable *drawable,
+                                                    gint          level,
+                                                    gboolean     *is_premult);
+static void          gimp_drawable_unpremultiply   (guchar       *data,
+                                                    gint          bpp,
+                                                    gint          n_pixels);
 static GimpTempBuf * gimp_drawable_indexed_preview (GimpDrawable *drawable,
                                                     const guchar *cmap,
                                                     gint          src_x,
@@ -75,25 +87,6 @@ gimp_drawable_get_preview (GimpViewable *viewable,
       gimp_drawable_get_precision (drawable) != GIMP_PRECISION_U8)
     return NULL;
 
-  /* Ok prime the cache with a large preview if the cache is invalid */
-  if (! drawable->private->preview_valid                        &&
-      width  <= PREVIEW_CACHE_PRIME_WIDTH                       &&
-      height <= PREVIEW_CACHE_PRIME_HEIGHT                      &&
-      image                                                     &&
-      gimp_image_get_width  (image) > PREVIEW_CACHE_PRIME_WIDTH &&
-      gimp_image_get_height (image) > PREVIEW_CACHE_PRIME_HEIGHT)
-    {
-      GimpTempBuf *tb = gimp_drawable_preview_private (drawable,
-                                                       PREVIEW_CACHE_PRIME_WIDTH,
-                                                       PREVIEW_CACHE_PRIME_HEIGHT);
-
-      /* Save the 2nd call */
-      if (width  == PREVIEW_CACHE_PRIME_WIDTH &&
-          height == PREVIEW_CACHE_PRIME_HEIGHT)
-        return tb;
-    }
-
-  /* Second call - should NOT visit the tile cache...*/
   return gimp_drawable_preview_private (drawable, width, height);
 }
 
@@ -121,6 +114,164 @@ gimp_drawable_get_preview_format (GimpDrawable *drawable)
   g_return_val_if_reached (NULL);
 }
 
+/**
+ * gimp_drawable_invalidate_preview_area:
+ * @drawable: a #GimpDrawable
+ * @x:        x coordinate of the changed area, in drawable coordinates
+ * @y:        y coordinate of the changed area
+ * @width:    width of the changed area
+ * @height:   height of the changed area
+ *
+ * Drops the tiles of the preview pyramid that are computed from the
+ * given area, so the next preview only revalidates what changed.
+ **/
+void
+gimp_drawable_invalidate_preview_area (GimpDrawable *drawable,
+                                       gint          x,
+                                       gint          y,
+                                       gint          width,
+                                       gint          height)
+{
+  GimpItem *item;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+
+  if (! drawable->private->preview_pyramid)
+    return;
+
+  item = GIMP_ITEM (drawable);
+
+  if (gimp_rectangle_intersect (x, y, width, height,
+                                0, 0,
+                                gimp_item_get_width  (item),
+                                gimp_item_get_height (item),
+                                &x, &y, &width, &height))
+    {
+      tile_pyramid_invalidate_area (drawable->private->preview_pyramid,
+                                    x, y, width, height);
+    }
+}
+
+void
+gimp_drawable_free_preview_pyramid (GimpDrawable *drawable)
+{
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+
+  if (drawable->private->preview_pyramid)
+    {
+      tile_pyramid_destroy (drawable->private->preview_pyramid);
+      drawable->private->preview_pyramid = NULL;
+    }
+}
+
+gint64
+gimp_drawable_get_preview_pyramid_memsize (GimpDrawable *drawable)
+{
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), 0);
+
+  if (drawable->private->preview_pyramid)
+    return tile_pyramid_get_memsize (drawable->private->preview_pyramid);
+
+  return 0;
+}
+
+/**
+ * gimp_drawable_get_preview_level:
+ * @drawable: a #GimpDrawable
+ * @scale:    the scale the drawable is going to be shown at
+ *
+ * Return value: the level of the drawable's preview pyramid to sample
+ *               from at @scale, or 0 if the drawable can't have one.
+ **/
+gint
+gimp_drawable_get_preview_level (GimpDrawable *drawable,
+                                 gdouble       scale)
+{
+  GimpItem *item;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), 0);
+
+  if (gimp_drawable_is_indexed (drawable) ||
+      gimp_drawable_get_precision (drawable) != GIMP_PRECISION_U8)
+    return 0;
+
+  item = GIMP_ITEM (drawable);
+
+  return tile_pyramid_get_level (gimp_item_get_width  (item),
+                                 gimp_item_get_height (item),
+                                 scale);
+}
+
+/**
+ * gimp_drawable_read_preview_level:
+ * @drawable: a #GimpDrawable
+ * @level:    a level returned by gimp_drawable_get_preview_level()
+ * @rect:     the area to read, in the coordinates of @level
+ * @format:   the format to read in
+ * @data:     the memory to read to
+ *
+ * Reads an area of the drawable at 1 / 2^@level of its size from the
+ * preview pyramid, with the alpha not pre-multiplied. Level 0 is read
+ * from the drawable's buffer.
+ **/
+void
+gimp_drawable_read_preview_level (GimpDrawable        *drawable,
+                                  gint                 level,
+                                  const GeglRectangle *rect,
+                                  const Babl          *format,
+                                  guchar              *data)
+{
+  const Babl  *src_format;
+  TileManager *tiles;
+  guchar      *buf;
+  gint         bpp;
+  gboolean     premult;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (level >= 0);
+  g_return_if_fail (rect != NULL);
+  g_return_if_fail (format != NULL);
+  g_return_if_fail (data != NULL);
+
+  if (level == 0)
+    {
+      gegl_buffer_get (gimp_drawable_get_buffer (drawable), rect, 1.0,
+                       format, data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      return;
+    }
+
+  tiles = gimp_drawable_pyramid_tiles (drawable, level, &premult);
+
+  g_return_if_fail (rect->x >= 0 && rect->y >= 0);
+  g_return_if_fail (rect->x + rect->width  <= tile_manager_width  (tiles));
+  g_return_if_fail (rect->y + rect->height <= tile_manager_height (tiles));
+
+  src_format = gimp_drawable_get_format (drawable);
+  bpp        = babl_format_get_bytes_per_pixel (src_format);
+
+  if (format == src_format)
+    buf = data;
+  else
+    buf = g_malloc (rect->width * rect->height * bpp);
+
+  tile_manager_read_pixel_data (tiles,
+                                rect->x, rect->y,
+                                rect->x + rect->width  - 1,
+                                rect->y + rect->height - 1,
+                                buf, rect->width * bpp);
+
+  if (premult && gimp_drawable_has_alpha (drawable))
+    gimp_drawable_unpremultiply (buf, bpp, rect->width * rect->height);
+
+  if (buf != data)
+    {
+      babl_process (babl_fish (src_format, format),
+                    buf, data, rect->width * rect->height);
+      g_free (buf);
+    }
+}
+
 GimpTempBuf *
 gimp_drawable_get_sub_preview (GimpDrawable *drawable,
                                gint          src_x,
@@ -178,18 +329,32 @@ gimp_drawable_preview_private (GimpDrawable *drawable,
 {
   GimpTempBuf *ret_buf = NULL;
 
-  if (! drawable->private->preview_valid ||
-      ! (ret_buf = gimp_preview_cache_get (&drawable->private->preview_cache,
-                                           width, height)))
+  if (drawable->private->preview_valid)
+    {
+      /*  other sizes of non-indexed previews are sampled from the
+       *  pyramid rather than scaled from a cached one
+       */
+      if (gimp_drawable_is_indexed (drawable))
+        ret_buf = gimp_preview_cache_get (&drawable->private->preview_cache,
+                                          width, height);
+      else
+        ret_buf = gimp_preview_cache_get_exact (&drawable->private->preview_cache,
+                                                width, height);
+    }
+
+  if (! ret_buf)
     {
       GimpItem *item = GIMP_ITEM (drawable);
 
-      ret_buf = gimp_drawable_get_sub_preview (drawable,
-                                               0, 0,
-                                               gimp_item_get_width (item),
-                                               gimp_item_get_height (item),
-                                               width,
-                                               height);
+      if (gimp_drawable_is_indexed (drawable))
+        ret_buf = gimp_drawable_get_sub_preview (drawable,
+                                                 0, 0,
+                                                 gimp_item_get_width (item),
+                                                 gimp_item_get_height (item),
+                                                 width,
+                                                 height);
+      else
+        ret_buf = gimp_drawable_pyramid_preview (drawable, width, height);
 
       if (! drawable->private->preview_valid)
         gimp_preview_cache_invalidate (&drawable->private->preview_cache);
@@ -202,6 +367,97 @@ gimp_drawable_preview_private (GimpDrawable *drawable,
   return ret_buf;
 }
 
+/*  Samples a preview from the level of the drawable's pyramid that is
+ *  just large enough, validating only the pyramid tiles that were
+ *  dropped since the last preview.  Indexed drawables can't be
+ *  averaged, they always take the colormap path.
+ */
+static GimpTempBuf *
+gimp_drawable_pyramid_preview (GimpDrawable *drawable,
+                               gint          width,
+                               gint          height)
+{
+  GimpItem    *item   = GIMP_ITEM (drawable);
+  GimpTempBuf *preview;
+  TileManager *tiles;
+  gint         item_width;
+  gint         item_height;
+  gint         level;
+  gboolean     premult;
+
+  item_width  = gimp_item_get_width  (item);
+  item_height = gimp_item_get_height (item);
+
+  level = tile_pyramid_get_level (item_width, item_height,
+                                  MAX ((gdouble) width  / item_width,
+                                       (gdouble) height / item_height));
+
+  tiles = gimp_drawable_pyramid_tiles (drawable, level, &premult);
+
+  preview = tile_manager_get_preview (tiles,
+                                      gimp_drawable_get_preview_format (drawable),
+                                      width, height);
+
+  /*  the upper pyramid levels have their alpha pre-multiplied  */
+  if (premult && gimp_drawable_has_alpha (drawable))
+    {
+      const Babl *format = gimp_temp_buf_get_format (preview);
+
+      gimp_drawable_unpremultiply (gimp_temp_buf_get_data (preview),
+                                   babl_format_get_bytes_per_pixel (format),
+                                   width * height);
+    }
+
+  return preview;
+}
+
+/*  Returns @level of the drawable's pyramid, validating only the
+ *  pyramid tiles that were dropped since it was last used.
+ */
+static TileManager *
+gimp_drawable_pyramid_tiles (GimpDrawable *drawable,
+                             gint          level,
+                             gboolean     *is_premult)
+{
+  TileManager *tiles;
+
+  tiles = gimp_gegl_buffer_get_tiles (gimp_drawable_get_buffer (drawable));
+
+  /*  the pyramid is built on top of the drawable's tiles, start over
+   *  when they were replaced
+   */
+  if (drawable->private->preview_pyramid &&
+      tile_pyramid_get_tiles (drawable->private->preview_pyramid,
+                              0, NULL) != tiles)
+    {
+      gimp_drawable_free_preview_pyramid (drawable);
+    }
+
+  if (! drawable->private->preview_pyramid)
+    drawable->private->preview_pyramid = tile_pyramid_new_for_tiles (tiles);
+
+  return tile_pyramid_get_tiles (drawable->private->preview_pyramid,
+                                 level, is_premult);
+}
+
+static void
+gimp_drawable_unpremultiply (guchar *data,
+                             gint    bpp,
+                             gint    n_pixels)
+{
+  for (; n_pixels--; data += bpp)
+    {
+      const guint alpha = data[bpp - 1];
+      gint        b;
+
+      if (alpha == 0 || alpha == 255)
+        continue;
+
+      for (b = 0; b < bpp - 1; b++)
+        data[b] = MIN (255, (data[b] * 255 + alpha / 2) / alpha);
+    }
+}
+
 static GimpTempBuf *
 gimp_drawable_indexed_preview (GimpDrawable *drawable,
                                const guchar *cmap,
@@ -39,5 +39,21 @@ GimpTempBuf * gimp_drawable_get_sub_preview    (GimpDrawable *drawable,
                                                 gint          dest_width,
                                                 gint          dest_height);
 
+gint          gimp_drawable_get_preview_level  (GimpDrawable        *drawable,
+                                                gdouble              scale);
+void          gimp_drawable_read_preview_level (GimpDrawable        *drawable,
+                                                gint                 level,
+                                                const GeglRectangle *rect,
+                                                const Babl          *format,
+                                                guchar              *data);
+
+void          gimp_drawable_invalidate_preview_area     (GimpDrawable *drawable,
+                                                         gint          x,
+                                                         gint          y,
+                                                         gint          width,
+                                                         gint          height);
+void          gimp_drawable_free_preview_pyramid        (GimpDrawable *drawable);
+gint64        gimp_drawable_get_preview_pyramid_memsize (GimpDrawable *drawable);
+
 
 #endif /* __GIMP_DRAWABLE__PREVIEW_H__ */
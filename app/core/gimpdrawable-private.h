@@ -22,6 +22,7 @@ struct _GimpDrawablePrivate
 {
   GeglBuffer    *buffer; /* buffer for drawable data */
   GeglBuffer    *shadow; /* shadow buffer            */
+  GeglBuffer    *scaled; /* buffer scaled in advance */
 
   GeglNode      *source_node;
   GeglNode      *buffer_source_node;
@@ -35,6 +36,11 @@ struct _GimpDrawablePrivate
 
   GSList        *preview_cache; /* preview caches of the channel */
   gboolean       preview_valid; /* is the preview valid?         */
+  TilePyramid   *preview_pyramid; /* mipmap all previews sample from */
+
+  guint          dirty_stamp;   /* changes with every update     */
+
+  struct _GimpDrawableHistogramCache *histogram_cache;
 };
 
 #endif /* __GIMP_DRAWABLE_PRIVATE_H__ */
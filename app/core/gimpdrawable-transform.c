@@ -34,7 +34,6 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
-#include "gimp-apply-operation.h"
 #include "gimp-transform-resize.h"
 #include "gimpchannel.h"
 #include "gimpcontext.h"
@@ -62,6 +61,34 @@
 #endif
 
 
+/*  the tile size of the tile managers behind our buffers, flips and
+ *  rotations move blocks of this size, affine transforms render them
+ */
+#define TRANSFORM_BLOCK_SIZE 64
+
+
+typedef enum
+{
+  TRANSFORM_REMAP_FLIP_HORIZONTAL,
+  TRANSFORM_REMAP_FLIP_VERTICAL,
+  TRANSFORM_REMAP_ROTATE_90,
+  TRANSFORM_REMAP_ROTATE_180,
+  TRANSFORM_REMAP_ROTATE_270
+} TransformRemap;
+
+
+static void   gimp_drawable_transform_render_affine (GeglBuffer          *src_buffer,
+                                                     GeglBuffer          *dest_buffer,
+                                                     GeglNode            *affine,
+                                                     const GimpMatrix3   *matrix,
+                                                     GimpProgress        *progress);
+static void   gimp_drawable_transform_remap         (GeglBuffer          *src_buffer,
+                                                     const GeglRectangle *src_rect,
+                                                     GeglBuffer          *dest_buffer,
+                                                     const GeglRectangle *dest_rect,
+                                                     TransformRemap       remap);
+
+
 /*  public functions  */
 
 GeglBuffer *
@@ -144,9 +171,9 @@ gimp_drawable_transform_buffer_affine (GimpDrawable           *drawable,
 
   gimp_gegl_node_set_matrix (affine, &gegl_matrix);
 
-  gimp_apply_operation (orig_buffer, progress, NULL,
-                        affine,
-                        new_buffer, NULL);
+  gimp_drawable_transform_render_affine (orig_buffer, new_buffer,
+                                         affine, &gegl_matrix,
+                                         progress);
 
   g_object_unref (affine);
 
@@ -175,7 +202,6 @@ gimp_drawable_transform_buffer_flip (GimpDrawable        *drawable,
   gint           orig_width, orig_height;
   gint           new_x, new_y;
   gint           new_width, new_height;
-  gint           i;
 
   g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
   g_return_val_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)), NULL);
@@ -259,48 +285,28 @@ gimp_drawable_transform_buffer_flip (GimpDrawable        *drawable,
   if (new_width == 0 && new_height == 0)
     return new_buffer;
 
+  src_rect.x      = orig_x;
+  src_rect.y      = orig_y;
+  src_rect.width  = orig_width;
+  src_rect.height = orig_height;
+
+  dest_rect.x      = new_x;
+  dest_rect.y      = new_y;
+  dest_rect.width  = new_width;
+  dest_rect.height = new_height;
+
   switch (flip_type)
     {
     case GIMP_ORIENTATION_HORIZONTAL:
-      src_rect.x      = orig_x;
-      src_rect.y      = orig_y;
-      src_rect.width  = 1;
-      src_rect.height = orig_height;
-
-      dest_rect.x      = new_x + new_width - 1;
-      dest_rect.y      = new_y;
-      dest_rect.width  = 1;
-      dest_rect.height = new_height;
-
-      for (i = 0; i < orig_width; i++)
-        {
-          src_rect.x  = i + orig_x;
-          dest_rect.x = new_x + new_width - i - 1;
-
-          gegl_buffer_copy (orig_buffer, &src_rect,
-                            new_buffer, &dest_rect);
-        }
+      gimp_drawable_transform_remap (orig_buffer, &src_rect,
+                                     new_buffer, &dest_rect,
+                                     TRANSFORM_REMAP_FLIP_HORIZONTAL);
       break;
 
     case GIMP_ORIENTATION_VERTICAL:
-      src_rect.x      = orig_x;
-      src_rect.y      = orig_y;
-      src_rect.width  = orig_width;
-      src_rect.height = 1;
-
-      dest_rect.x      = new_x;
-      dest_rect.y      = new_y + new_height - 1;
-      dest_rect.width  = new_width;
-      dest_rect.height = 1;
-
-      for (i = 0; i < orig_height; i++)
-        {
-          src_rect.y  = i + orig_y;
-          dest_rect.y = new_y + new_height - i - 1;
-
-          gegl_buffer_copy (orig_buffer, &src_rect,
-                            new_buffer, &dest_rect);
-        }
+      gimp_drawable_transform_remap (orig_buffer, &src_rect,
+                                     new_buffer, &dest_rect,
+                                     TRANSFORM_REMAP_FLIP_VERTICAL);
       break;
 
     case GIMP_ORIENTATION_UNKNOWN:
@@ -362,7 +368,6 @@ gimp_drawable_transform_buffer_rotate (GimpDrawable     *drawable,
   GeglRectangle  dest_rect;
   gint           orig_x, orig_y;
   gint           orig_width, orig_height;
-  gint           orig_bpp;
   gint           new_x, new_y;
   gint           new_width, new_height;
 
@@ -375,7 +380,6 @@ gimp_drawable_transform_buffer_rotate (GimpDrawable     *drawable,
   orig_y      = orig_offset_y;
   orig_width  = gegl_buffer_get_width (orig_buffer);
   orig_height = gegl_buffer_get_height (orig_buffer);
-  orig_bpp    = babl_format_get_bytes_per_pixel (gegl_buffer_get_format (orig_buffer));
 
   switch (rotate_type)
     {
@@ -526,101 +530,27 @@ gimp_drawable_transform_buffer_rotate (GimpDrawable     *drawable,
   switch (rotate_type)
     {
     case GIMP_ROTATE_90:
-      {
-        guchar *buf = g_new (guchar, new_height * orig_bpp);
-        gint    i;
-
-        g_assert (new_height == orig_width);
-
-        src_rect.y      = orig_y + orig_height - 1;
-        src_rect.height = 1;
+      g_assert (new_height == orig_width);
 
-        dest_rect.x     = new_x;
-        dest_rect.width = 1;
-
-        for (i = 0; i < orig_height; i++)
-          {
-            src_rect.y  = orig_y + orig_height - 1 - i;
-            dest_rect.x = new_x + i;
-
-            gegl_buffer_get (orig_buffer, &src_rect, 1.0, NULL, buf,
-                             GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-            gegl_buffer_set (new_buffer, &dest_rect, 0, NULL, buf,
-                             GEGL_AUTO_ROWSTRIDE);
-          }
-
-        g_free (buf);
-      }
+      gimp_drawable_transform_remap (orig_buffer, &src_rect,
+                                     new_buffer, &dest_rect,
+                                     TRANSFORM_REMAP_ROTATE_90);
       break;
 
     case GIMP_ROTATE_180:
-      {
-        guchar *buf = g_new (guchar, new_width * orig_bpp);
-        gint    i, j, k;
-
-        g_assert (new_width == orig_width);
-
-        src_rect.y      = orig_y + orig_height - 1;
-        src_rect.height = 1;
+      g_assert (new_width == orig_width);
 
-        dest_rect.y      = new_y;
-        dest_rect.height = 1;
-
-        for (i = 0; i < orig_height; i++)
-          {
-            src_rect.y  = orig_y + orig_height - 1 - i;
-            dest_rect.y = new_y + i;
-
-            gegl_buffer_get (orig_buffer, &src_rect, 1.0, NULL, buf,
-                             GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-            for (j = 0; j < orig_width / 2; j++)
-              {
-                guchar *left  = buf + j * orig_bpp;
-                guchar *right = buf + (orig_width - 1 - j) * orig_bpp;
-
-                for (k = 0; k < orig_bpp; k++)
-                  {
-                    guchar tmp = left[k];
-                    left[k]    = right[k];
-                    right[k]   = tmp;
-                  }
-              }
-
-            gegl_buffer_set (new_buffer, &dest_rect, 0, NULL, buf,
-                             GEGL_AUTO_ROWSTRIDE);
-          }
-
-        g_free (buf);
-      }
+      gimp_drawable_transform_remap (orig_buffer, &src_rect,
+                                     new_buffer, &dest_rect,
+                                     TRANSFORM_REMAP_ROTATE_180);
       break;
 
     case GIMP_ROTATE_270:
-      {
-        guchar *buf = g_new (guchar, new_width * orig_bpp);
-        gint    i;
-
-        g_assert (new_width == orig_height);
-
-        src_rect.x     = orig_x + orig_width - 1;
-        src_rect.width = 1;
-
-        dest_rect.y      = new_y;
-        dest_rect.height = 1;
+      g_assert (new_width == orig_height);
 
-        for (i = 0; i < orig_width; i++)
-          {
-            src_rect.x  = orig_x + orig_width - 1 - i;
-            dest_rect.y = new_y + i;
-
-            gegl_buffer_get (orig_buffer, &src_rect, 1.0, NULL, buf,
-                             GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-            gegl_buffer_set (new_buffer, &dest_rect, 0, NULL, buf,
-                             GEGL_AUTO_ROWSTRIDE);
-          }
-
-        g_free (buf);
-      }
+      gimp_drawable_transform_remap (orig_buffer, &src_rect,
+                                     new_buffer, &dest_rect,
+                                     TRANSFORM_REMAP_ROTATE_270);
       break;
     }
 
@@ -1004,3 +934,250 @@ gimp_drawable_transform_paste (GimpDrawable *drawable,
 
   return drawable;
 }
+
+
+/*  private functions  */
+
+typedef struct
+{
+  GeglRectangle rect;
+  gint          src_row;
+  gint          src_col;
+} TransformBlock;
+
+static gint
+gimp_drawable_transform_compare_blocks (const TransformBlock *block1,
+                                        const TransformBlock *block2)
+{
+  if (block1->src_row != block2->src_row)
+    return block1->src_row < block2->src_row ? -1 : 1;
+
+  if (block1->src_col != block2->src_col)
+    return block1->src_col < block2->src_col ? -1 : 1;
+
+  return 0;
+}
+
+/*  Renders @affine into @dest_buffer block by block, in the order of
+ *  where the blocks come from in @src_buffer, so that consecutive
+ *  blocks read the same or neighbouring source tiles while they are
+ *  still cached. Rendering the output row by row instead sweeps a
+ *  rotated footprint across many source tile rows at once.
+ */
+static void
+gimp_drawable_transform_render_affine (GeglBuffer        *src_buffer,
+                                       GeglBuffer        *dest_buffer,
+                                       GeglNode          *affine,
+                                       const GimpMatrix3 *matrix,
+                                       GimpProgress      *progress)
+{
+  GeglNode       *gegl;
+  GeglNode       *src_node;
+  GeglNode       *dest_node;
+  GeglProcessor  *processor = NULL;
+  GimpMatrix3     inverse   = *matrix;
+  GArray         *blocks;
+  gint            width     = gegl_buffer_get_width  (dest_buffer);
+  gint            height    = gegl_buffer_get_height (dest_buffer);
+  gint            x, y;
+  guint           i;
+
+  gimp_matrix3_invert (&inverse);
+
+  blocks = g_array_new (FALSE, FALSE, sizeof (TransformBlock));
+
+  for (y = 0; y < height; y += TRANSFORM_BLOCK_SIZE)
+    for (x = 0; x < width; x += TRANSFORM_BLOCK_SIZE)
+      {
+        TransformBlock block;
+        gdouble        u, v;
+
+        block.rect.x      = x;
+        block.rect.y      = y;
+        block.rect.width  = MIN (TRANSFORM_BLOCK_SIZE, width  - x);
+        block.rect.height = MIN (TRANSFORM_BLOCK_SIZE, height - y);
+
+        gimp_matrix3_transform_point (&inverse,
+                                      x + block.rect.width  / 2.0,
+                                      y + block.rect.height / 2.0,
+                                      &u, &v);
+
+        /*  blocks beyond the horizon of a perspective transform go last  */
+        u = FINITE (u) ? CLAMP (u, -G_MAXINT / 2, G_MAXINT / 2) : G_MAXINT / 2;
+        v = FINITE (v) ? CLAMP (v, -G_MAXINT / 2, G_MAXINT / 2) : G_MAXINT / 2;
+
+        block.src_row = floor (v / TRANSFORM_BLOCK_SIZE);
+        block.src_col = floor (u / TRANSFORM_BLOCK_SIZE);
+
+        g_array_append_val (blocks, block);
+      }
+
+  g_array_sort (blocks, (GCompareFunc) gimp_drawable_transform_compare_blocks);
+
+  gegl = gegl_node_new ();
+
+  src_node = gegl_node_new_child (gegl,
+                                  "operation", "gegl:buffer-source",
+                                  "buffer",    src_buffer,
+                                  NULL);
+  dest_node = gegl_node_new_child (gegl,
+                                   "operation", "gegl:write-buffer",
+                                   "buffer",    dest_buffer,
+                                   NULL);
+
+  gegl_node_add_child (gegl, affine);
+
+  gegl_node_link_many (src_node, affine, dest_node, NULL);
+
+  if (progress && ! gimp_progress_is_active (progress))
+    gimp_progress_start (progress, NULL, FALSE);
+
+  for (i = 0; i < blocks->len; i++)
+    {
+      TransformBlock *block = &g_array_index (blocks, TransformBlock, i);
+
+      if (! processor)
+        processor = gegl_node_new_processor (dest_node, &block->rect);
+      else
+        gegl_processor_set_rectangle (processor, &block->rect);
+
+      while (gegl_processor_work (processor, NULL));
+
+      if (progress)
+        gimp_progress_set_value (progress, (gdouble) (i + 1) / blocks->len);
+    }
+
+  if (processor)
+    g_object_unref (processor);
+
+  g_object_unref (gegl);
+
+  g_array_free (blocks, TRUE);
+
+  if (progress)
+    gimp_progress_end (progress);
+}
+
+/*  Moves the pixels of @src_rect to @dest_rect, flipped or rotated as
+ *  @remap says. Each block is read and written with one call, and is
+ *  transposed while it is in the cache, instead of reading the source
+ *  one row or column at a time.
+ */
+static void
+gimp_drawable_transform_remap (GeglBuffer          *src_buffer,
+                               const GeglRectangle *src_rect,
+                               GeglBuffer          *dest_buffer,
+                               const GeglRectangle *dest_rect,
+                               TransformRemap       remap)
+{
+  const Babl *format = gegl_buffer_get_format (src_buffer);
+  gint        bpp    = babl_format_get_bytes_per_pixel (format);
+  gint        src_width  = src_rect->width;
+  gint        src_height = src_rect->height;
+  guchar     *src;
+  guchar     *dest;
+  gint        x, y;
+
+  src  = g_new (guchar, TRANSFORM_BLOCK_SIZE * TRANSFORM_BLOCK_SIZE * bpp);
+  dest = g_new (guchar, TRANSFORM_BLOCK_SIZE * TRANSFORM_BLOCK_SIZE * bpp);
+
+  /*  the blocks follow the source's tile grid  */
+  for (y = src_rect->y; y < src_rect->y + src_height;
+       y += TRANSFORM_BLOCK_SIZE - y % TRANSFORM_BLOCK_SIZE)
+    {
+      for (x = src_rect->x; x < src_rect->x + src_width;
+           x += TRANSFORM_BLOCK_SIZE - x % TRANSFORM_BLOCK_SIZE)
+        {
+          GeglRectangle block;
+          GeglRectangle target;
+          gint          bx, by;
+          gint          w, h;
+          gint          i, j;
+
+          block.x      = x;
+          block.y      = y;
+          block.width  = MIN (TRANSFORM_BLOCK_SIZE - x % TRANSFORM_BLOCK_SIZE,
+                              src_rect->x + src_width - x);
+          block.height = MIN (TRANSFORM_BLOCK_SIZE - y % TRANSFORM_BLOCK_SIZE,
+                              src_rect->y + src_height - y);
+
+          bx = block.x - src_rect->x;
+          by = block.y - src_rect->y;
+          w  = block.width;
+          h  = block.height;
+
+          switch (remap)
+            {
+            case TRANSFORM_REMAP_FLIP_HORIZONTAL:
+              gegl_rectangle_set (&target, src_width - bx - w, by, w, h);
+              break;
+
+            case TRANSFORM_REMAP_FLIP_VERTICAL:
+              gegl_rectangle_set (&target, bx, src_height - by - h, w, h);
+              break;
+
+            case TRANSFORM_REMAP_ROTATE_90:
+              gegl_rectangle_set (&target, src_height - by - h, bx, h, w);
+              break;
+
+            case TRANSFORM_REMAP_ROTATE_180:
+              gegl_rectangle_set (&target,
+                                  src_width - bx - w, src_height - by - h,
+                                  w, h);
+              break;
+
+            case TRANSFORM_REMAP_ROTATE_270:
+              gegl_rectangle_set (&target, by, src_width - bx - w, h, w);
+              break;
+            }
+
+          target.x += dest_rect->x;
+          target.y += dest_rect->y;
+
+          gegl_buffer_get (src_buffer, &block, 1.0, NULL, src,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          for (j = 0; j < h; j++)
+            {
+              const guchar *s = src + j * w * bpp;
+
+              switch (remap)
+                {
+                case TRANSFORM_REMAP_FLIP_HORIZONTAL:
+                  for (i = 0; i < w; i++)
+                    memcpy (dest + (j * w + (w - 1 - i)) * bpp,
+                            s + i * bpp, bpp);
+                  break;
+
+                case TRANSFORM_REMAP_FLIP_VERTICAL:
+                  memcpy (dest + (h - 1 - j) * w * bpp, s, w * bpp);
+                  break;
+
+                case TRANSFORM_REMAP_ROTATE_90:
+                  for (i = 0; i < w; i++)
+                    memcpy (dest + (i * h + (h - 1 - j)) * bpp,
+                            s + i * bpp, bpp);
+                  break;
+
+                case TRANSFORM_REMAP_ROTATE_180:
+                  for (i = 0; i < w; i++)
+                    memcpy (dest + ((h - 1 - j) * w + (w - 1 - i)) * bpp,
+                            s + i * bpp, bpp);
+                  break;
+
+                case TRANSFORM_REMAP_ROTATE_270:
+                  for (i = 0; i < w; i++)
+                    memcpy (dest + ((w - 1 - i) * h + j) * bpp,
+                            s + i * bpp, bpp);
+                  break;
+                }
+            }
+
+          gegl_buffer_set (dest_buffer, &target, 0, NULL, dest,
+                           GEGL_AUTO_ROWSTRIDE);
+        }
+    }
+
+  g_free (src);
+  g_free (dest);
+}
@@ -35,6 +35,7 @@
 #include "gimpchannel.h"
 #include "gimpcontext.h"
 #include "gimpdrawable-combine.h"
+#include "gimpdrawable-histogram.h"
 #include "gimpdrawable-operation.h"
 #include "gimpdrawable-preview.h"
 #include "gimpdrawable-private.h"
@@ -289,6 +290,8 @@ gimp_drawable_finalize (GObject *object)
 
   gimp_drawable_free_shadow_buffer (drawable);
 
+  gimp_drawable_set_scaled_buffer (drawable, NULL);
+
   if (drawable->private->source_node)
     {
       g_object_unref (drawable->private->source_node);
@@ -298,6 +301,10 @@ gimp_drawable_finalize (GObject *object)
   if (drawable->private->preview_cache)
     gimp_preview_cache_invalidate (&drawable->private->preview_cache);
 
+  gimp_drawable_free_preview_pyramid (drawable);
+
+  gimp_drawable_invalidate_histogram (drawable, NULL);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -312,6 +319,7 @@ gimp_drawable_get_memsize (GimpObject *object,
   memsize += gimp_gegl_buffer_get_memsize (drawable->private->shadow);
 
   *gui_size += gimp_preview_cache_get_memsize (drawable->private->preview_cache);
+  *gui_size += gimp_drawable_get_preview_pyramid_memsize (drawable);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -430,6 +438,28 @@ gimp_drawable_scale (GimpItem              *item,
   GeglBuffer   *new_buffer;
   GeglNode     *scale;
 
+  new_buffer = drawable->private->scaled;
+  drawable->private->scaled = NULL;
+
+  if (new_buffer)
+    {
+      if (gegl_buffer_get_width  (new_buffer) == new_width  &&
+          gegl_buffer_get_height (new_buffer) == new_height &&
+          gegl_buffer_get_format (new_buffer) ==
+          gimp_drawable_get_format (drawable))
+        {
+          gimp_drawable_set_buffer_full (drawable,
+                                         gimp_item_is_attached (item), NULL,
+                                         new_buffer,
+                                         new_offset_x, new_offset_y);
+          g_object_unref (new_buffer);
+
+          return;
+        }
+
+      g_object_unref (new_buffer);
+    }
+
   new_buffer = gimp_gegl_buffer_new (GEGL_RECTANGLE (0, 0,
                                                      new_width, new_height),
                                      gimp_drawable_get_format (drawable));
@@ -678,6 +708,13 @@ gimp_drawable_real_update (GimpDrawable *drawable,
         }
     }
 
+  drawable->private->dirty_stamp++;
+
+  gimp_drawable_invalidate_histogram (drawable,
+                                      GEGL_RECTANGLE (x, y, width, height));
+
+  gimp_drawable_invalidate_preview_area (drawable, x, y, width, height);
+
   gimp_viewable_invalidate_preview (GIMP_VIEWABLE (drawable));
 }
 
@@ -712,8 +749,8 @@ gimp_drawable_real_convert_type (GimpDrawable      *drawable,
                                           gimp_item_get_height (GIMP_ITEM (drawable))),
                           format);
 
-  gegl_buffer_copy (gimp_drawable_get_buffer (drawable), NULL,
-                    dest_buffer, NULL);
+  gimp_gegl_buffer_convert (gimp_drawable_get_buffer (drawable),
+                            dest_buffer);
 
   gimp_drawable_set_buffer (drawable, push_undo, NULL, dest_buffer);
   g_object_unref (dest_buffer);
@@ -742,6 +779,9 @@ gimp_drawable_real_set_buffer (GimpDrawable *drawable,
   old_has_alpha = gimp_drawable_has_alpha (drawable);
 
   gimp_drawable_invalidate_boundary (drawable);
+  gimp_drawable_invalidate_histogram (drawable, NULL);
+
+  drawable->private->dirty_stamp++;
 
   if (push_undo)
     gimp_image_undo_push_drawable_mod (gimp_item_get_image (item), undo_desc,
@@ -755,6 +795,11 @@ gimp_drawable_real_set_buffer (GimpDrawable *drawable,
 
   drawable->private->buffer = buffer;
 
+  /*  the undo steps sharing tiles with the old buffer now own a
+   *  larger share of them
+   */
+  gimp_object_memsize_changed_all ();
+
   gimp_item_set_offset (item, offset_x, offset_y);
   gimp_item_set_size (item,
                       gegl_buffer_get_width  (buffer),
@@ -816,13 +861,10 @@ gimp_drawable_real_push_undo (GimpDrawable *drawable,
 {
   if (! buffer)
     {
-      buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
-                                gimp_drawable_get_format (drawable));
-
-      gegl_buffer_copy (gimp_drawable_get_buffer (drawable),
-                        GEGL_RECTANGLE (x, y, width, height),
-                        buffer,
-                        GEGL_RECTANGLE (0, 0, 0, 0));
+      /*  shares the unchanged tiles with the drawable  */
+      buffer = gimp_gegl_buffer_dup_area (gimp_drawable_get_buffer (drawable),
+                                          GEGL_RECTANGLE (x, y,
+                                                          width, height));
     }
   else
     {
@@ -1096,11 +1138,18 @@ gimp_drawable_update (GimpDrawable *drawable,
 {
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
 
+  /*  only drop the GEGL tiles of the updated area, so a group layer's
+   *  parents keep the cached rest of its projection
+   */
   if (drawable->private->buffer)
-    {
-      gegl_buffer_flush (drawable->private->buffer);
-      gimp_gegl_buffer_refetch_tiles (drawable->private->buffer);
-    }
+    gimp_gegl_buffer_refetch_area (drawable->private->buffer,
+                                   GEGL_RECTANGLE (x, y, width, height));
+
+  gimp_pickable_invalidate_area (GIMP_PICKABLE (drawable),
+                                 x, y, width, height);
+
+  /*  writing to the drawable unshares its tiles with the undo steps  */
+  gimp_object_memsize_changed_all ();
 
   g_signal_emit (drawable, gimp_drawable_signals[UPDATE], 0,
                  x, y, width, height);
@@ -1257,6 +1306,25 @@ gimp_drawable_set_buffer (GimpDrawable *drawable,
                                  offset_x, offset_y);
 }
 
+/*  a buffer scaled ahead of time, which the next gimp_item_scale() to
+ *  exactly its size installs instead of scaling again
+ */
+void
+gimp_drawable_set_scaled_buffer (GimpDrawable *drawable,
+                                 GeglBuffer   *buffer)
+{
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (buffer == NULL || GEGL_IS_BUFFER (buffer));
+
+  if (buffer)
+    g_object_ref (buffer);
+
+  if (drawable->private->scaled)
+    g_object_unref (drawable->private->scaled);
+
+  drawable->private->scaled = buffer;
+}
+
 void
 gimp_drawable_set_buffer_full (GimpDrawable *drawable,
                                gboolean      push_undo,
@@ -1301,6 +1369,14 @@ gimp_drawable_set_buffer_full (GimpDrawable *drawable,
                         gimp_item_get_height (item));
 }
 
+guint
+gimp_drawable_get_dirty_stamp (GimpDrawable *drawable)
+{
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), 0);
+
+  return drawable->private->dirty_stamp;
+}
+
 GeglNode *
 gimp_drawable_get_source_node (GimpDrawable *drawable)
 {
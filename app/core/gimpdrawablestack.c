@@ -24,8 +24,11 @@
 
 #include "core-types.h"
 
+#include "operations/gimpoperationlayerstack.h"
+
 #include "gimpdrawable.h"
 #include "gimpdrawablestack.h"
+#include "gimplayer.h"
 #include "gimpmarshal.h"
 
 
@@ -53,6 +56,7 @@ static void   gimp_drawable_stack_add_node         (GimpDrawableStack *stack,
                                                     GimpDrawable      *drawable);
 static void   gimp_drawable_stack_remove_node      (GimpDrawableStack *stack,
                                                     GimpDrawable      *drawable);
+static void   gimp_drawable_stack_sync_fused       (GimpDrawableStack *stack);
 
 static void   gimp_drawable_stack_update           (GimpDrawableStack *stack,
                                                     gint               x,
@@ -135,7 +139,14 @@ gimp_drawable_stack_finalize (GObject *object)
   if (stack->graph)
     {
       g_object_unref (stack->graph);
-      stack->graph = NULL;
+      stack->graph      = NULL;
+      stack->fused_node = NULL;
+    }
+
+  if (stack->fused_layers)
+    {
+      g_array_unref (stack->fused_layers);
+      stack->fused_layers = NULL;
     }
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -155,6 +166,7 @@ gimp_drawable_stack_add (GimpContainer *container,
                            gimp_item_get_node (GIMP_ITEM (object)));
 
       gimp_drawable_stack_add_node (stack, GIMP_DRAWABLE (object));
+      gimp_drawable_stack_sync_fused (stack);
     }
 
   if (gimp_item_get_visible (GIMP_ITEM (object)))
@@ -177,6 +189,8 @@ gimp_drawable_stack_remove (GimpContainer *container,
 
   GIMP_CONTAINER_CLASS (parent_class)->remove (container, object);
 
+  gimp_drawable_stack_sync_fused (stack);
+
   if (gimp_item_get_visible (GIMP_ITEM (object)))
     gimp_drawable_stack_drawable_visible (GIMP_ITEM (object), stack);
 }
@@ -194,7 +208,10 @@ gimp_drawable_stack_reorder (GimpContainer *container,
   GIMP_CONTAINER_CLASS (parent_class)->reorder (container, object, new_index);
 
   if (stack->graph)
-    gimp_drawable_stack_add_node (stack, GIMP_DRAWABLE (object));
+    {
+      gimp_drawable_stack_add_node (stack, GIMP_DRAWABLE (object));
+      gimp_drawable_stack_sync_fused (stack);
+    }
 
   if (gimp_item_get_visible (GIMP_ITEM (object)))
     gimp_drawable_stack_drawable_visible (GIMP_ITEM (object), stack);
@@ -261,6 +278,12 @@ gimp_drawable_stack_get_graph (GimpDrawableStack *stack)
     gegl_node_connect_to (previous, "output",
                           output,   "input");
 
+  stack->fused_node = gegl_node_new_child (stack->graph,
+                                           "operation", "gimp:layer-stack",
+                                           NULL);
+
+  gimp_drawable_stack_sync_fused (stack);
+
   return stack->graph;
 }
 
@@ -355,6 +378,126 @@ gimp_drawable_stack_remove_node (GimpDrawableStack *stack,
     }
 }
 
+/*  Returns the visible layers bottom to top, or NULL if any of them
+ *  needs more than a point layer mode node can do
+ */
+static GArray *
+gimp_drawable_stack_get_fused_layers (GimpDrawableStack *stack)
+{
+  GArray *layers;
+  GList  *list;
+
+  layers = gimp_operation_layer_stack_layers_new ();
+
+  for (list = g_list_last (GIMP_LIST (stack)->list);
+       list;
+       list = g_list_previous (list))
+    {
+      GimpDrawable  *drawable = list->data;
+      GimpLayer     *layer;
+      GimpLayerMask *mask;
+      gint           offset_x;
+      gint           offset_y;
+
+      if (! gimp_item_get_visible (GIMP_ITEM (drawable)))
+        continue;
+
+      if (! GIMP_IS_LAYER (drawable)                              ||
+          gimp_viewable_get_children (GIMP_VIEWABLE (drawable))   ||
+          gimp_layer_is_floating_sel (GIMP_LAYER (drawable))      ||
+          gimp_drawable_get_floating_sel (drawable))
+        break;
+
+      layer = GIMP_LAYER (drawable);
+      mask  = gimp_layer_get_mask (layer);
+
+      if (! gimp_operation_layer_stack_supports_mode (gimp_layer_get_mode (layer)) ||
+          (mask && (gimp_layer_get_show_mask (layer) ||
+                    gimp_drawable_get_floating_sel (GIMP_DRAWABLE (mask)))))
+        break;
+
+      if (mask && ! gimp_layer_get_apply_mask (layer))
+        mask = NULL;
+
+      gimp_item_get_offset (GIMP_ITEM (layer), &offset_x, &offset_y);
+
+      gimp_operation_layer_stack_layers_add (layers,
+                                             gimp_drawable_get_buffer (drawable),
+                                             mask ?
+                                             gimp_drawable_get_buffer (GIMP_DRAWABLE (mask)) :
+                                             NULL,
+                                             offset_x, offset_y,
+                                             gimp_layer_get_mode (layer),
+                                             gimp_layer_get_opacity (layer));
+    }
+
+  if (list || layers->len == 0)
+    {
+      g_array_unref (layers);
+
+      return NULL;
+    }
+
+  return layers;
+}
+
+/*  Composites the stack with one gimp:layer-stack node when all its
+ *  layers allow it, and through the node chain otherwise. The chain
+ *  stays connected, just the output is switched between the two.
+ */
+static void
+gimp_drawable_stack_sync_fused (GimpDrawableStack *stack)
+{
+  GArray   *layers;
+  GeglNode *output;
+  GeglNode *producer;
+
+  if (! stack->graph)
+    return;
+
+  layers = gimp_drawable_stack_get_fused_layers (stack);
+
+  if (gimp_operation_layer_stack_layers_equal (layers, stack->fused_layers))
+    {
+      if (layers)
+        g_array_unref (layers);
+    }
+  else
+    {
+      if (stack->fused_layers)
+        g_array_unref (stack->fused_layers);
+
+      stack->fused_layers = layers;
+
+      gegl_node_set (stack->fused_node,
+                     "layers", layers,
+                     NULL);
+    }
+
+  if (stack->fused_layers)
+    {
+      producer = stack->fused_node;
+    }
+  else
+    {
+      GimpObject *top = gimp_container_get_first_child (GIMP_CONTAINER (stack));
+
+      producer = top ? gimp_item_get_node (GIMP_ITEM (top)) : NULL;
+    }
+
+  /*  adding and removing nodes may have rewired the output  */
+  output = gegl_node_get_output_proxy (stack->graph, "output");
+
+  if (producer != gegl_node_get_producer (output, "input", NULL))
+    {
+      if (producer)
+        gegl_node_connect_to (producer, "output",
+                              output,   "input");
+      else
+        gegl_node_disconnect (output, "input");
+    }
+}
+
 static void
 gimp_drawable_stack_update (GimpDrawableStack *stack,
                             gint               x,
@@ -374,6 +517,9 @@ gimp_drawable_stack_drawable_update (GimpItem          *item,
                                      gint               height,
                                      GimpDrawableStack *stack)
 {
+  /*  mode, opacity, mask and offset changes all end up here  */
+  gimp_drawable_stack_sync_fused (stack);
+
   if (gimp_item_get_visible (item))
     {
       gint offset_x;
@@ -394,6 +540,8 @@ gimp_drawable_stack_drawable_visible (GimpItem          *item,
   gint offset_x;
   gint offset_y;
 
+  gimp_drawable_stack_sync_fused (stack);
+
   gimp_item_get_offset (item, &offset_x, &offset_y);
 
   gimp_drawable_stack_update (stack,
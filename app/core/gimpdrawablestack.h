@@ -38,6 +38,8 @@ struct _GimpDrawableStack
   GimpItemStack  parent_instance;
 
   GeglNode      *graph;
+  GeglNode      *fused_node;
+  GArray        *fused_layers;
 };
 
 struct _GimpDrawableStackClass
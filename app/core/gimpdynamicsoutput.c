@@ -28,7 +28,6 @@
 
 
 #include "gimpcurve.h"
-#include "gimpcurve-map.h"
 
 #include "gimpdynamicsoutput.h"
 
@@ -66,8 +65,33 @@ enum
 };
 
 
+typedef enum
+{
+  INPUT_PRESSURE,
+  INPUT_VELOCITY,
+  INPUT_DIRECTION,
+  INPUT_TILT,
+  INPUT_WHEEL,
+  INPUT_RANDOM,
+  INPUT_FADE,
+
+  N_INPUTS
+} DynamicsInput;
+
+
+typedef struct _DynamicsLut               DynamicsLut;
 typedef struct _GimpDynamicsOutputPrivate GimpDynamicsOutputPrivate;
 
+/*  a copy of an enabled input's curve, evaluated without going through
+ *  GimpCurve; samples is NULL for identity curves
+ */
+struct _DynamicsLut
+{
+  DynamicsInput  input;
+  gint           n_samples;
+  gdouble       *samples;
+};
+
 struct _GimpDynamicsOutputPrivate
 {
   GimpDynamicsOutputType  type;
@@ -87,6 +111,11 @@ struct _GimpDynamicsOutputPrivate
   GimpCurve              *wheel_curve;
   GimpCurve              *random_curve;
   GimpCurve              *fade_curve;
+
+  /*  the enabled inputs in evaluation order, compiled on demand  */
+  gboolean                luts_valid;
+  gint                    n_luts;
+  DynamicsLut             luts[N_INPUTS];
 };
 
 #define GET_PRIVATE(output) \
@@ -112,6 +141,18 @@ static GimpCurve *
                                                  const gchar        *name);
 static void   gimp_dynamics_output_curve_dirty  (GimpCurve          *curve,
                                                  GimpDynamicsOutput *output);
+static void   gimp_dynamics_output_curve_notify (GimpCurve          *curve,
+                                                 GParamSpec         *pspec,
+                                                 GimpDynamicsOutput *output);
+
+static void   gimp_dynamics_output_free_luts    (GimpDynamicsOutputPrivate *private);
+static void   gimp_dynamics_output_compile_luts (GimpDynamicsOutputPrivate *private);
+
+static inline GimpDynamicsOutputPrivate *
+              gimp_dynamics_output_get_luts     (GimpDynamicsOutput *output);
+static inline gdouble
+              gimp_dynamics_output_map          (const DynamicsLut  *lut,
+                                                 gdouble             value);
 
 
 G_DEFINE_TYPE_WITH_CODE (GimpDynamicsOutput, gimp_dynamics_output,
@@ -246,6 +287,8 @@ gimp_dynamics_output_finalize (GObject *object)
   g_object_unref (private->random_curve);
   g_object_unref (private->fade_curve);
 
+  gimp_dynamics_output_free_luts (private);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -330,6 +373,8 @@ gimp_dynamics_output_set_property (GObject      *object,
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
     }
+
+  private->luts_valid = FALSE;
 }
 
 static void
@@ -443,70 +488,57 @@ gimp_dynamics_output_get_linear_value (GimpDynamicsOutput *output,
                                        GimpPaintOptions   *options,
                                        gdouble             fade_point)
 {
-  GimpDynamicsOutputPrivate *private = GET_PRIVATE (output);
+  GimpDynamicsOutputPrivate *private = gimp_dynamics_output_get_luts (output);
   gdouble                    total   = 0.0;
   gdouble                    result  = 1.0;
-  gint                       factors = 0;
+  gint                       i;
 
-  if (private->use_pressure)
+  for (i = 0; i < private->n_luts; i++)
     {
-      total += gimp_curve_map_value (private->pressure_curve,
-                                     coords->pressure);
-      factors++;
-    }
+      const DynamicsLut *lut = &private->luts[i];
+      gdouble            value;
 
-  if (private->use_velocity)
-    {
-      total += gimp_curve_map_value (private->velocity_curve,
-                                    (1.0 - coords->velocity));
-      factors++;
-    }
-
-  if (private->use_direction)
-    {
-      total += gimp_curve_map_value (private->direction_curve,
-                                     fmod (coords->direction + 0.5, 1));
-      factors++;
-    }
-
-  if (private->use_tilt)
-    {
-      total += gimp_curve_map_value (private->tilt_curve,
-                                     (1.0 - sqrt (SQR (coords->xtilt) +
-                                      SQR (coords->ytilt))));
-      factors++;
-    }
-
-  if (private->use_wheel)
-    {
-      gdouble wheel;
-
-      wheel = coords->wheel;
-
-      total += gimp_curve_map_value (private->wheel_curve, wheel);
-      factors++;
-    }
-
-  if (private->use_random)
-    {
-      total += gimp_curve_map_value (private->random_curve,
-                                     g_random_double_range (0.0, 1.0));
-      factors++;
-    }
-
-  if (private->use_fade)
-    {
-      total += gimp_curve_map_value (private->fade_curve, fade_point);
+      switch (lut->input)
+        {
+        case INPUT_PRESSURE:
+          value = coords->pressure;
+          break;
+
+        case INPUT_VELOCITY:
+          value = 1.0 - coords->velocity;
+          break;
+
+        case INPUT_DIRECTION:
+          value = fmod (coords->direction + 0.5, 1);
+          break;
+
+        case INPUT_TILT:
+          value = 1.0 - sqrt (SQR (coords->xtilt) + SQR (coords->ytilt));
+          break;
+
+        case INPUT_WHEEL:
+          value = coords->wheel;
+          break;
+
+        case INPUT_RANDOM:
+          value = g_random_double_range (0.0, 1.0);
+          break;
+
+        case INPUT_FADE:
+        default:
+          value = fade_point;
+          break;
+        }
 
-      factors++;
+      total += gimp_dynamics_output_map (lut, value);
     }
 
-  if (factors > 0)
-    result = total / factors;
+  if (private->n_luts > 0)
+    result = total / private->n_luts;
 
 #if 0
   g_printerr ("Dynamics queried(linear). Result: %f, factors: %d, total: %f\n",
-              result, factors, total);
+              result, private->n_luts, total);
 #endif
 
   return result;
@@ -518,99 +550,92 @@ gimp_dynamics_output_get_angular_value (GimpDynamicsOutput *output,
                                         GimpPaintOptions   *options,
                                         gdouble             fade_point)
 {
-  GimpDynamicsOutputPrivate *private = GET_PRIVATE (output);
+  GimpDynamicsOutputPrivate *private = gimp_dynamics_output_get_luts (output);
   gdouble                    total   = 0.0;
   gdouble                    result  = 0.0; /* angles are additive, so we retun zero for no change. */
-  gint                       factors = 0;
-
-  if (private->use_pressure)
-    {
-      total += gimp_curve_map_value (private->pressure_curve,
-                                     coords->pressure);
-      factors++;
-    }
-
-  if (private->use_velocity)
-    {
-      total += gimp_curve_map_value (private->velocity_curve,
-                                    (1.0 - coords->velocity));
-      factors++;
-    }
-
-  if (private->use_direction)
-    {
-      total += gimp_curve_map_value (private->direction_curve,
-                                     coords->direction);
-      factors++;
-    }
+  gint                       i;
 
-  /* For tilt to make sense, it needs to be converted to an angle, not
-   * just a vector
-   */
-  if (private->use_tilt)
+  for (i = 0; i < private->n_luts; i++)
     {
-      gdouble tilt_x = coords->xtilt;
-      gdouble tilt_y = coords->ytilt;
-      gdouble tilt   = 0.0;
+      const DynamicsLut *lut = &private->luts[i];
+      gdouble            value;
 
-      if (tilt_x == 0.0)
+      switch (lut->input)
         {
-          if (tilt_y >= 0.0)
-            tilt = 0.5;
-          else if (tilt_y < 0.0)
-            tilt = 0.0;
-          else
-            tilt = -1.0;
-        }
-      else
-        {
-          tilt = atan ((- 1.0 * tilt_y) /
-                                tilt_x) / (2 * G_PI);
-
-          if (tilt_x > 0.0)
-            tilt = tilt + 0.5;
+        case INPUT_PRESSURE:
+          value = coords->pressure;
+          break;
+
+        case INPUT_VELOCITY:
+          value = 1.0 - coords->velocity;
+          break;
+
+        case INPUT_DIRECTION:
+          value = coords->direction;
+          break;
+
+          /* For tilt to make sense, it needs to be converted to an angle, not
+           * just a vector
+           */
+        case INPUT_TILT:
+          {
+            gdouble tilt_x = coords->xtilt;
+            gdouble tilt_y = coords->ytilt;
+            gdouble tilt   = 0.0;
+
+            if (tilt_x == 0.0)
+              {
+                if (tilt_y >= 0.0)
+                  tilt = 0.5;
+                else if (tilt_y < 0.0)
+                  tilt = 0.0;
+                else
+                  tilt = -1.0;
+              }
+            else
+              {
+                tilt = atan ((- 1.0 * tilt_y) /
+                                      tilt_x) / (2 * G_PI);
+
+                if (tilt_x > 0.0)
+                  tilt = tilt + 0.5;
+              }
+
+            tilt = tilt + 0.5; /* correct the angle, its wrong by 180 degrees */
+
+            while (tilt > 1.0)
+              tilt -= 1.0;
+
+            while (tilt < 0.0)
+              tilt += 1.0;
+
+            value = tilt;
+          }
+          break;
+
+        case INPUT_WHEEL:
+          value = 1.0 - fmod(0.5 + coords->wheel, 1);
+          break;
+
+        case INPUT_RANDOM:
+          value = g_random_double_range (0.0, 1.0);
+          break;
+
+        case INPUT_FADE:
+        default:
+          value = fade_point;
+          break;
         }
 
-      tilt = tilt + 0.5; /* correct the angle, its wrong by 180 degrees */
-
-      while (tilt > 1.0)
-        tilt -= 1.0;
-
-      while (tilt < 0.0)
-        tilt += 1.0;
-
-      total += gimp_curve_map_value (private->tilt_curve, tilt);
-      factors++;
+      total += gimp_dynamics_output_map (lut, value);
     }
 
-  if (private->use_wheel)
-    {
-      gdouble angle = 1.0 - fmod(0.5 + coords->wheel, 1);
-
-      total += gimp_curve_map_value (private->wheel_curve, angle);
-      factors++;
-    }
-
-  if (private->use_random)
-    {
-      total += gimp_curve_map_value (private->random_curve,
-                                     g_random_double_range (0.0, 1.0));
-      factors++;
-    }
-
-  if (private->use_fade)
-    {
-      total += gimp_curve_map_value (private->fade_curve, fade_point);
-
-      factors++;
-    }
-
-  if (factors > 0)
-    result = total / factors;
+  if (private->n_luts > 0)
+    result = total / private->n_luts;
 
 #if 0
   g_printerr ("Dynamics queried(angle). Result: %f, factors: %d, total: %f\n",
-              result, factors, total);
+              result, private->n_luts, total);
 #endif
 
    return result;
@@ -622,96 +647,79 @@ gimp_dynamics_output_get_aspect_value (GimpDynamicsOutput *output,
                                        GimpPaintOptions   *options,
                                        gdouble             fade_point)
 {
-  GimpDynamicsOutputPrivate *private = GET_PRIVATE (output);
+  GimpDynamicsOutputPrivate *private = gimp_dynamics_output_get_luts (output);
   gdouble                    total   = 0.0;
-  gint                       factors = 0;
   gdouble                    sign    = 1.0;
   gdouble                    result  = 1.0;
+  gint                       i;
 
-  if (private->use_pressure)
-    {
-      total += gimp_curve_map_value (private->pressure_curve,
-                                     coords->pressure);
-      factors++;
-    }
-
-  if (private->use_velocity)
-    {
-      total += gimp_curve_map_value (private->velocity_curve,
-                                     coords->velocity);
-      factors++;
-    }
-
-  if (private->use_direction)
+  for (i = 0; i < private->n_luts; i++)
     {
-      gdouble direction = gimp_curve_map_value (private->direction_curve,
-                                                coords->direction);
+      const DynamicsLut *lut = &private->luts[i];
 
-      if (((direction > 0.875) && (direction <= 1.0)) ||
-          ((direction > 0.0) && (direction < 0.125))  ||
-          ((direction > 0.375) && (direction < 0.625)))
-        sign = -1.0;
-
-      total += 1.0;
-      factors++;
-    }
-
-  if (private->use_tilt)
-    {
-      gdouble tilt_value =  MAX (fabs (coords->xtilt), fabs (coords->ytilt));
-
-      tilt_value = gimp_curve_map_value (private->tilt_curve,
-                                         tilt_value);
-
-      total += tilt_value;
-
-      factors++;
-    }
-
-  if (private->use_wheel)
-    {
-      gdouble wheel = gimp_curve_map_value (private->wheel_curve,
-                                            coords->wheel);
-
-      if (((wheel > 0.875) && (wheel <= 1.0)) ||
-          ((wheel > 0.0) && (wheel < 0.125))  ||
-          ((wheel > 0.375) && (wheel < 0.625)))
-        sign = -1.0;
-
-      total += 1.0;
-      factors++;
-
-    }
-
-  if (private->use_random)
-    {
-      gdouble random = gimp_curve_map_value (private->random_curve,
+      switch (lut->input)
+        {
+        case INPUT_PRESSURE:
+          total += gimp_dynamics_output_map (lut, coords->pressure);
+          break;
+
+        case INPUT_VELOCITY:
+          total += gimp_dynamics_output_map (lut, coords->velocity);
+          break;
+
+        case INPUT_DIRECTION:
+        case INPUT_WHEEL:
+          {
+            gdouble angle;
+
+            angle = gimp_dynamics_output_map (lut,
+                                              lut->input == INPUT_DIRECTION ?
+                                              coords->direction :
+                                              coords->wheel);
+
+            if (((angle > 0.875) && (angle <= 1.0)) ||
+                ((angle > 0.0) && (angle < 0.125))  ||
+                ((angle > 0.375) && (angle < 0.625)))
+              sign = -1.0;
+
+            total += 1.0;
+          }
+          break;
+
+        case INPUT_TILT:
+          total += gimp_dynamics_output_map (lut,
+                                             MAX (fabs (coords->xtilt),
+                                                  fabs (coords->ytilt)));
+          break;
+
+        case INPUT_RANDOM:
+          total += gimp_dynamics_output_map (lut,
                                              g_random_double_range (0.0, 1.0));
+          break;
 
-      total += random;
-      factors++;
-    }
-
-  if (private->use_fade)
-    {
-      total += gimp_curve_map_value (private->fade_curve, fade_point);
-
-      factors++;
+        case INPUT_FADE:
+        default:
+          total += gimp_dynamics_output_map (lut, fade_point);
+          break;
+        }
     }
 
-  if (factors > 0)
-    result = total / factors;
+  if (private->n_luts > 0)
+    result = total / private->n_luts;
 
 
 #if 0
   g_printerr ("Dynamics queried(aspect). Result: %f, factors: %d, total: %f sign: %f\n",
-              result, factors, total, sign);
+              result, private->n_luts, total, sign);
 #endif
   result = CLAMP (result * sign, -1.0, 1.0);
 
   return result;
 }
 
+
+/*  private functions  */
+
 static void
 gimp_dynamics_output_copy_curve (GimpCurve *src,
                                  GimpCurve *dest)
@@ -734,6 +742,11 @@ gimp_dynamics_output_create_curve (GimpDynamicsOutput *output,
                            G_CALLBACK (gimp_dynamics_output_curve_dirty),
                            output, 0);
 
+  /*  deserializing a curve changes it without emitting "dirty"  */
+  g_signal_connect_object (curve, "notify",
+                           G_CALLBACK (gimp_dynamics_output_curve_notify),
+                           output, 0);
+
   return curve;
 }
 
@@ -741,5 +754,118 @@ static void
 gimp_dynamics_output_curve_dirty (GimpCurve          *curve,
                                   GimpDynamicsOutput *output)
 {
+  GET_PRIVATE (output)->luts_valid = FALSE;
+
   g_object_notify (G_OBJECT (output), gimp_object_get_name (curve));
 }
+
+static void
+gimp_dynamics_output_curve_notify (GimpCurve          *curve,
+                                   GParamSpec         *pspec,
+                                   GimpDynamicsOutput *output)
+{
+  GET_PRIVATE (output)->luts_valid = FALSE;
+}
+
+static void
+gimp_dynamics_output_free_luts (GimpDynamicsOutputPrivate *private)
+{
+  gint i;
+
+  for (i = 0; i < private->n_luts; i++)
+    g_free (private->luts[i].samples);
+
+  private->n_luts     = 0;
+  private->luts_valid = FALSE;
+}
+
+static void
+gimp_dynamics_output_compile_luts (GimpDynamicsOutputPrivate *private)
+{
+  gboolean   use[N_INPUTS];
+  GimpCurve *curves[N_INPUTS];
+  gint       i;
+
+  use[INPUT_PRESSURE]     = private->use_pressure;
+  use[INPUT_VELOCITY]     = private->use_velocity;
+  use[INPUT_DIRECTION]    = private->use_direction;
+  use[INPUT_TILT]         = private->use_tilt;
+  use[INPUT_WHEEL]        = private->use_wheel;
+  use[INPUT_RANDOM]       = private->use_random;
+  use[INPUT_FADE]         = private->use_fade;
+
+  curves[INPUT_PRESSURE]  = private->pressure_curve;
+  curves[INPUT_VELOCITY]  = private->velocity_curve;
+  curves[INPUT_DIRECTION] = private->direction_curve;
+  curves[INPUT_TILT]      = private->tilt_curve;
+  curves[INPUT_WHEEL]     = private->wheel_curve;
+  curves[INPUT_RANDOM]    = private->random_curve;
+  curves[INPUT_FADE]      = private->fade_curve;
+
+  gimp_dynamics_output_free_luts (private);
+
+  for (i = 0; i < N_INPUTS; i++)
+    {
+      DynamicsLut *lut = &private->luts[private->n_luts];
+      GimpCurve   *curve;
+
+      if (! use[i])
+        continue;
+
+      curve = curves[i];
+
+      lut->input     = i;
+      lut->n_samples = curve->n_samples;
+      lut->samples   = NULL;
+
+      if (! curve->identity)
+        lut->samples = g_memdup (curve->samples,
+                                 curve->n_samples * sizeof (gdouble));
+
+      private->n_luts++;
+    }
+
+  private->luts_valid = TRUE;
+}
+
+static inline GimpDynamicsOutputPrivate *
+gimp_dynamics_output_get_luts (GimpDynamicsOutput *output)
+{
+  GimpDynamicsOutputPrivate *private = GET_PRIVATE (output);
+
+  if (G_UNLIKELY (! private->luts_valid))
+    gimp_dynamics_output_compile_luts (private);
+
+  return private;
+}
+
+/*  keep in sync with gimp_curve_map_value()  */
+static inline gdouble
+gimp_dynamics_output_map (const DynamicsLut *lut,
+                          gdouble            value)
+{
+  if (! lut->samples)
+    {
+      return value;
+    }
+
+  if (value < 0.0)
+    {
+      return lut->samples[0];
+    }
+  else if (value >= 1.0)
+    {
+      return lut->samples[lut->n_samples - 1];
+    }
+  else
+    {
+      gdouble f;
+      gint    index;
+
+      value = value * (lut->n_samples - 1);
+      index = (gint) value;
+      f     = value - index;
+
+      return (1.0 - f) * lut->samples[index] + f * lut->samples[index + 1];
+    }
+}
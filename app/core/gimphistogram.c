@@ -29,9 +29,14 @@
 
 #include "gegl/gimp-babl.h"
 
+#include "gimp-parallel.h"
 #include "gimphistogram.h"
 
 
+/*  the number of pixels read and counted in one go  */
+#define HISTOGRAM_STRIP_PIXELS  (1 << 14)
+
+
 struct _GimpHistogram
 {
   gint     ref_count;
@@ -39,11 +44,26 @@ struct _GimpHistogram
   gdouble *values;
 };
 
+typedef struct _GimpHistogramStrip GimpHistogramStrip;
+
+struct _GimpHistogramStrip
+{
+  gint     n_components;
+  guchar  *data;
+  gfloat  *mask;
+  gint     n_pixels;
+  gdouble *values;
+};
+
 
 /*  local function prototypes  */
 
-static void   gimp_histogram_alloc_values (GimpHistogram *histogram,
-                                           gint           bytes);
+static void   gimp_histogram_alloc_values     (GimpHistogram      *histogram,
+                                               gint                bytes);
+static void   gimp_histogram_calculate_strip  (GimpHistogramStrip *strip);
+static void   gimp_histogram_strip_func       (gint                i,
+                                               gint                n,
+                                               gpointer            data);
 
 
 /*  public functions  */
@@ -114,9 +134,14 @@ gimp_histogram_calculate (GimpHistogram       *histogram,
                           GeglBuffer          *mask,
                           const GeglRectangle *mask_rect)
 {
-  GeglBufferIterator *iter;
+  GimpHistogramStrip *strips;
   const Babl         *format;
   gint                n_components;
+  gint                n_threads;
+  gint                strip_height;
+  gint                bpp;
+  gint                y;
+  gint                i;
 
   g_return_if_fail (histogram != NULL);
   g_return_if_fail (GEGL_IS_BUFFER (buffer));
@@ -133,161 +158,132 @@ gimp_histogram_calculate (GimpHistogram       *histogram,
                                babl_format_has_alpha (format));
 
   n_components = babl_format_get_n_components (format);
+  bpp          = babl_format_get_bytes_per_pixel (format);
 
   gimp_histogram_alloc_values (histogram, n_components);
 
-  iter = gegl_buffer_iterator_new (buffer, buffer_rect, 0, format,
-                                   GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
+  if (buffer_rect->width < 1 || buffer_rect->height < 1)
+    return;
 
-  if (mask)
-    gegl_buffer_iterator_add (iter, mask, mask_rect, 0,
-                              babl_format ("Y float"),
-                              GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
+  strip_height = CLAMP (HISTOGRAM_STRIP_PIXELS / buffer_rect->width,
+                        1, buffer_rect->height);
 
-#define VALUE(c,i) (histogram->values[(c) * 256 + (i)])
+  n_threads = CLAMP (gimp_parallel_get_n_threads (), 1,
+                     (buffer_rect->height + strip_height - 1) / strip_height);
 
-  while (gegl_buffer_iterator_next (iter))
+  strips = g_new0 (GimpHistogramStrip, n_threads);
+
+  for (i = 0; i < n_threads; i++)
     {
-      const guchar *data = iter->data[0];
-      gint          max;
+      GimpHistogramStrip *strip = &strips[i];
+
+      strip->n_components = n_components;
+      strip->data         = g_new (guchar,
+                                   buffer_rect->width * strip_height * bpp);
 
       if (mask)
-        {
-          const gfloat *mask_data = iter->data[1];
+        strip->mask = g_new (gfloat, buffer_rect->width * strip_height);
 
-          switch (n_components)
-            {
-            case 1:
-              while (iter->length)
-                {
-                  const gdouble masked = *mask_data;
-
-                  VALUE (0, data[0]) += masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-
-            case 2:
-              while (iter->length--)
-                {
-                  const gdouble masked = *mask_data;
-                  const gdouble weight = data[1] / 255.0;
-
-                  VALUE (0, data[0]) += weight * masked;
-                  VALUE (1, data[1]) += masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-
-            case 3: /* calculate separate value values */
-              while (iter->length--)
-                {
-                  const gdouble masked = *mask_data;
-
-                  VALUE (1, data[0]) += masked;
-                  VALUE (2, data[1]) += masked;
-                  VALUE (3, data[2]) += masked;
-
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
-
-                  VALUE (0, max) += masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-
-            case 4: /* calculate separate value values */
-              while (iter->length--)
-                {
-                  const gdouble masked = *mask_data;
-                  const gdouble weight = data[3] / 255.0;
-
-                  VALUE (1, data[0]) += weight * masked;
-                  VALUE (2, data[1]) += weight * masked;
-                  VALUE (3, data[2]) += weight * masked;
-                  VALUE (4, data[3]) += masked;
-
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
-
-                  VALUE (0, max) += weight * masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-            }
-        }
-      else /* no mask */
-        {
-          switch (n_components)
-            {
-            case 1:
-              while (iter->length--)
-                {
-                  VALUE (0, data[0]) += 1.0;
+      /*  the first strip counts straight into the result  */
+      if (i == 0)
+        strip->values = histogram->values;
+      else
+        strip->values = g_new0 (gdouble, (n_components + 1) * 256);
+    }
 
-                  data += n_components;
-                }
-              break;
+  /*  The buffers are read on this thread, since the tile managers
+   *  behind drawable buffers don't allow concurrent access; only the
+   *  counting is spread over the threads, each into its own partial
+   *  histogram, which are summed up at the end.
+   */
+  for (y = 0; y < buffer_rect->height;)
+    {
+      gint n_strips;
 
-            case 2:
-              while (iter->length--)
-                {
-                  const gdouble weight = data[1] / 255;
+      for (n_strips = 0;
+           n_strips < n_threads && y < buffer_rect->height;
+           n_strips++)
+        {
+          GimpHistogramStrip *strip  = &strips[n_strips];
+          gint                height = MIN (strip_height,
+                                            buffer_rect->height - y);
+
+          gegl_buffer_get (buffer,
+                           GEGL_RECTANGLE (buffer_rect->x,
+                                           buffer_rect->y + y,
+                                           buffer_rect->width, height),
+                           1.0, format, strip->data,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          if (mask)
+            gegl_buffer_get (mask,
+                             GEGL_RECTANGLE (mask_rect->x,
+                                             mask_rect->y + y,
+                                             buffer_rect->width, height),
+                             1.0, babl_format ("Y float"), strip->mask,
+                             GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          strip->n_pixels = buffer_rect->width * height;
+
+          y += height;
+        }
 
-                  VALUE (0, data[0]) += weight;
-                  VALUE (1, data[1]) += 1.0;
+      gimp_parallel_distribute (n_strips, gimp_histogram_strip_func, strips);
+    }
+
+  for (i = 0; i < n_threads; i++)
+    {
+      GimpHistogramStrip *strip = &strips[i];
 
-                  data += n_components;
-                }
-              break;
+      if (i > 0)
+        {
+          gint j;
 
-            case 3: /* calculate separate value values */
-              while (iter->length--)
-                {
-                  VALUE (1, data[0]) += 1.0;
-                  VALUE (2, data[1]) += 1.0;
-                  VALUE (3, data[2]) += 1.0;
+          for (j = 0; j < (n_components + 1) * 256; j++)
+            histogram->values[j] += strip->values[j];
 
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
+          g_free (strip->values);
+        }
 
-                  VALUE (0, max) += 1.0;
+      g_free (strip->data);
+      g_free (strip->mask);
+    }
 
-                  data += n_components;
-                }
-              break;
+  g_free (strips);
+}
 
-            case 4: /* calculate separate value values */
-              while (iter->length--)
-                {
-                  const gdouble weight = data[3] / 255;
+/**
+ * gimp_histogram_add:
+ * @histogram: a %GimpHistogram
+ * @other:     a %GimpHistogram of pixels with the same number of channels
+ * @factor:    the factor @other's values are multiplied with
+ *
+ * Adds the values of @other, multiplied with @factor, to @histogram.
+ * This allows building a histogram from the histograms of parts of a
+ * buffer, and updating it when parts change, by passing a factor of
+ * -1.0 for their old histograms and 1.0 for their new ones. An empty
+ * @histogram takes @other's number of channels.
+ **/
+void
+gimp_histogram_add (GimpHistogram *histogram,
+                    GimpHistogram *other,
+                    gdouble        factor)
+{
+  gint i;
 
-                  VALUE (1, data[0]) += weight;
-                  VALUE (2, data[1]) += weight;
-                  VALUE (3, data[2]) += weight;
-                  VALUE (4, data[3]) += 1.0;
+  g_return_if_fail (histogram != NULL);
+  g_return_if_fail (other != NULL);
 
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
+  if (! other->values)
+    return;
 
-                  VALUE (0, max) += weight;
+  if (! histogram->values)
+    gimp_histogram_alloc_values (histogram, other->n_channels - 1);
 
-                  data += n_components;
-                }
-              break;
-            }
-        }
-    }
+  g_return_if_fail (histogram->n_channels == other->n_channels);
 
-#undef VALUE
+  for (i = 0; i < histogram->n_channels * 256; i++)
+    histogram->values[i] += factor * other->values[i];
 }
 
 void
@@ -691,3 +687,160 @@ gimp_histogram_alloc_values (GimpHistogram *histogram,
               0, histogram->n_channels * 256 * sizeof (gdouble));
     }
 }
+
+static void
+gimp_histogram_calculate_strip (GimpHistogramStrip *strip)
+{
+  const guchar *data         = strip->data;
+  const gfloat *mask_data    = strip->mask;
+  gint          n_components = strip->n_components;
+  gint          n_pixels     = strip->n_pixels;
+  gint          max;
+
+#define VALUE(c,i) (strip->values[(c) * 256 + (i)])
+
+  if (mask_data)
+    {
+      switch (n_components)
+        {
+        case 1:
+          while (n_pixels--)
+            {
+              const gdouble masked = *mask_data;
+
+              VALUE (0, data[0]) += masked;
+
+              data += n_components;
+              mask_data += 1;
+            }
+          break;
+
+        case 2:
+          while (n_pixels--)
+            {
+              const gdouble masked = *mask_data;
+              const gdouble weight = data[1] / 255.0;
+
+              VALUE (0, data[0]) += weight * masked;
+              VALUE (1, data[1]) += masked;
+
+              data += n_components;
+              mask_data += 1;
+            }
+          break;
+
+        case 3: /* calculate separate value values */
+          while (n_pixels--)
+            {
+              const gdouble masked = *mask_data;
+
+              VALUE (1, data[0]) += masked;
+              VALUE (2, data[1]) += masked;
+              VALUE (3, data[2]) += masked;
+
+              max = MAX (data[0], data[1]);
+              max = MAX (data[2], max);
+
+              VALUE (0, max) += masked;
+
+              data += n_components;
+              mask_data += 1;
+            }
+          break;
+
+        case 4: /* calculate separate value values */
+          while (n_pixels--)
+            {
+              const gdouble masked = *mask_data;
+              const gdouble weight = data[3] / 255.0;
+
+              VALUE (1, data[0]) += weight * masked;
+              VALUE (2, data[1]) += weight * masked;
+              VALUE (3, data[2]) += weight * masked;
+              VALUE (4, data[3]) += masked;
+
+              max = MAX (data[0], data[1]);
+              max = MAX (data[2], max);
+
+              VALUE (0, max) += weight * masked;
+
+              data += n_components;
+              mask_data += 1;
+            }
+          break;
+        }
+    }
+  else /* no mask */
+    {
+      switch (n_components)
+        {
+        case 1:
+          while (n_pixels--)
+            {
+              VALUE (0, data[0]) += 1.0;
+
+              data += n_components;
+            }
+          break;
+
+        case 2:
+          while (n_pixels--)
+            {
+              const gdouble weight = data[1] / 255.0;
+
+              VALUE (0, data[0]) += weight;
+              VALUE (1, data[1]) += 1.0;
+
+              data += n_components;
+            }
+          break;
+
+        case 3: /* calculate separate value values */
+          while (n_pixels--)
+            {
+              VALUE (1, data[0]) += 1.0;
+              VALUE (2, data[1]) += 1.0;
+              VALUE (3, data[2]) += 1.0;
+
+              max = MAX (data[0], data[1]);
+              max = MAX (data[2], max);
+
+              VALUE (0, max) += 1.0;
+
+              data += n_components;
+            }
+          break;
+
+        case 4: /* calculate separate value values */
+          while (n_pixels--)
+            {
+              const gdouble weight = data[3] / 255.0;
+
+              VALUE (1, data[0]) += weight;
+              VALUE (2, data[1]) += weight;
+              VALUE (3, data[2]) += weight;
+              VALUE (4, data[3]) += 1.0;
+
+              max = MAX (data[0], data[1]);
+              max = MAX (data[2], max);
+
+              VALUE (0, max) += weight;
+
+              data += n_components;
+            }
+          break;
+        }
+    }
+
+#undef VALUE
+}
+
+static void
+gimp_histogram_strip_func (gint     i,
+                           gint     n,
+                           gpointer data)
+{
+  GimpHistogramStrip *strips = data;
+
+  gimp_histogram_calculate_strip (&strips[i]);
+}
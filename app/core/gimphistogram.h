@@ -33,6 +33,9 @@ void            gimp_histogram_calculate     (GimpHistogram        *histogram,
                                               const GeglRectangle  *buffer_rect,
                                               GeglBuffer           *mask,
                                               const GeglRectangle  *mask_rect);
+void            gimp_histogram_add           (GimpHistogram        *histogram,
+                                              GimpHistogram        *other,
+                                              gdouble               factor);
 
 void            gimp_histogram_clear_values  (GimpHistogram        *histogram);
 
@@ -36,41 +36,73 @@
 #include "gimppickable.h"
 
 
+/*  the source is converted, and compared to the seed color, in
+ *  blocks of FILL_BLOCK_SIZE x FILL_BLOCK_SIZE pixels, the first time
+ *  the fill touches them
+ */
+#define FILL_BLOCK_SIZE 64
+
+
+typedef struct
+{
+  gfloat  *diff;                      /* the pixels' selection values, or
+                                       * NULL if not converted yet
+                                       */
+  guint64  visited[FILL_BLOCK_SIZE];  /* one bit per filled pixel       */
+} FillBlock;
+
+typedef struct
+{
+  gint y;
+  gint x1;
+  gint x2;
+} FillSpan;
+
+typedef struct
+{
+  GeglBuffer          *src_buffer;
+  const Babl          *format;
+  gint                 n_components;
+  gboolean             has_alpha;
+  gint                 width;
+  gint                 height;
+
+  const gfloat        *col;
+  gboolean             select_transparent;
+  GimpSelectCriterion  select_criterion;
+  gboolean             antialias;
+  gfloat               threshold;
+
+  gint                 n_cols;
+  gint                 n_rows;
+  FillBlock           *blocks;
+  gfloat              *src;           /* conversion scratch for a block */
+} ContiguousFill;
+
+
 /*  local function prototypes  */
 
-static gfloat   pixel_difference          (const gfloat        *col1,
-                                           const gfloat        *col2,
-                                           gboolean             antialias,
-                                           gfloat               threshold,
-                                           gint                 n_components,
-                                           gboolean             has_alpha,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion);
-static gboolean find_contiguous_segment   (const gfloat        *col,
-                                           GeglBuffer          *src_buffer,
-                                           GeglBuffer          *mask_buffer,
-                                           const Babl          *src_format,
-                                           gint                 n_components,
-                                           gboolean             has_alpha,
-                                           gint                 width,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion,
-                                           gboolean             antialias,
-                                           gfloat               threshold,
-                                           gint                 initial_x,
-                                           gint                 initial_y,
-                                           gint                *start,
-                                           gint                *end);
-static void find_contiguous_region_helper (GeglBuffer          *src_buffer,
-                                           GeglBuffer          *mask_buffer,
-                                           const Babl          *format,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion,
-                                           gboolean             antialias,
-                                           gfloat               threshold,
-                                           gint                 x,
-                                           gint                 y,
-                                           const gfloat        *col);
+static void   pixel_difference_row          (const gfloat        *col,
+                                             const gfloat        *src,
+                                             gfloat              *dest,
+                                             gint                 n_pixels,
+                                             gboolean             antialias,
+                                             gfloat               threshold,
+                                             gint                 n_components,
+                                             gboolean             has_alpha,
+                                             gboolean             select_transparent,
+                                             GimpSelectCriterion  select_criterion);
+
+static void   find_contiguous_region_helper (GeglBuffer          *src_buffer,
+                                             GeglBuffer          *mask_buffer,
+                                             const Babl          *format,
+                                             gboolean             select_transparent,
+                                             GimpSelectCriterion  select_criterion,
+                                             gboolean             antialias,
+                                             gfloat               threshold,
+                                             gint                 x,
+                                             gint                 y,
+                                             const gfloat        *col);
 
 
 /*  public functions  */
@@ -224,20 +256,14 @@ gimp_image_contiguous_region_by_color (GimpImage            *image,
       const gfloat *src  = iter->data[0];
       gfloat       *dest = iter->data[1];
 
-      while (iter->length--)
-        {
-          /*  Find how closely the colors match  */
-          *dest = pixel_difference (col, src,
-                                    antialias,
-                                    threshold,
-                                    has_alpha ? 4 : 3,
-                                    has_alpha,
-                                    select_transparent,
-                                    select_criterion);
-
-          src  += 4;
-          dest += 1;
-        }
+      /*  Find how closely the colors match  */
+      pixel_difference_row (col, src, dest, iter->length,
+                            antialias,
+                            threshold,
+                            4,
+                            has_alpha,
+                            select_transparent,
+                            select_criterion);
     }
 
   return mask;
@@ -246,205 +272,249 @@ gimp_image_contiguous_region_by_color (GimpImage            *image,
 
 /*  private functions  */
 
-static gfloat
-pixel_difference (const gfloat        *col1,
-                  const gfloat        *col2,
-                  gboolean             antialias,
-                  gfloat               threshold,
-                  gint                 n_components,
-                  gboolean             has_alpha,
-                  gboolean             select_transparent,
-                  GimpSelectCriterion  select_criterion)
+/*  Computes the selection values of a row of pixels. The loops are
+ *  kept free of per-pixel branches on the selection options, so the
+ *  compiler can vectorize them.
+ */
+static void
+pixel_difference_row (const gfloat        *col,
+                      const gfloat        *src,
+                      gfloat              *dest,
+                      gint                 n_pixels,
+                      gboolean             antialias,
+                      gfloat               threshold,
+                      gint                 n_components,
+                      gboolean             has_alpha,
+                      gboolean             select_transparent,
+                      GimpSelectCriterion  select_criterion)
 {
-  gfloat max = 0.0;
-
-  /*  if there is an alpha channel, never select transparent regions  */
-  if (! select_transparent && has_alpha && col2[n_components - 1] == 0.0)
-    return 0.0;
+  gint i;
 
+  /*  first the distances...  */
   if (select_transparent && has_alpha)
     {
-      max = fabs (col1[n_components - 1] - col2[n_components - 1]);
+      const gint   a     = n_components - 1;
+      const gfloat col_a = col[a];
+
+      for (i = 0; i < n_pixels; i++)
+        dest[i] = fabsf (col_a - src[i * n_components + a]);
     }
   else
     {
-      gfloat  diff;
-      gint    b;
-
-      if (has_alpha)
-        n_components--;
+      gint c = -1;
 
       switch (select_criterion)
         {
         case GIMP_SELECT_CRITERION_COMPOSITE:
-          for (b = 0; b < n_components; b++)
+          if (n_components - (has_alpha ? 1 : 0) >= 3)
+            {
+              const gfloat r = col[0];
+              const gfloat g = col[1];
+              const gfloat b = col[2];
+
+              for (i = 0; i < n_pixels; i++)
+                {
+                  const gfloat *s  = src + i * n_components;
+                  const gfloat  dr = fabsf (r - s[0]);
+                  const gfloat  dg = fabsf (g - s[1]);
+                  const gfloat  db = fabsf (b - s[2]);
+
+                  dest[i] = MAX (MAX (dr, dg), db);
+                }
+            }
+          else
             {
-              diff = fabs (col1[b] - col2[b]);
-              if (diff > max)
-                max = diff;
+              c = 0;
             }
           break;
 
         case GIMP_SELECT_CRITERION_R:
-          max = fabs (col1[0] - col2[0]);
+          c = 0;
           break;
 
         case GIMP_SELECT_CRITERION_G:
-          max = fabs (col1[1] - col2[1]);
+          c = 1;
           break;
 
         case GIMP_SELECT_CRITERION_B:
-          max = fabs (col1[2] - col2[2]);
+          c = 2;
           break;
 
-#if 0
-        case GIMP_SELECT_CRITERION_H:
-          av0 = (gint) col1[0];
-          av1 = (gint) col1[1];
-          av2 = (gint) col1[2];
-          bv0 = (gint) col2[0];
-          bv1 = (gint) col2[1];
-          bv2 = (gint) col2[2];
-          gimp_rgb_to_hsv_int (&av0, &av1, &av2);
-          gimp_rgb_to_hsv_int (&bv0, &bv1, &bv2);
-          /* wrap around candidates for the actual distance */
-          {
-            gint dist1 = abs (av0 - bv0);
-            gint dist2 = abs (av0 - 360 - bv0);
-            gint dist3 = abs (av0 - bv0 + 360);
-            max = MIN (dist1, dist2);
-            if (max > dist3)
-              max = dist3;
-          }
+        default:
+          for (i = 0; i < n_pixels; i++)
+            dest[i] = 0.0;
           break;
+        }
 
-        case GIMP_SELECT_CRITERION_S:
-          av0 = (gint) col1[0];
-          av1 = (gint) col1[1];
-          av2 = (gint) col1[2];
-          bv0 = (gint) col2[0];
-          bv1 = (gint) col2[1];
-          bv2 = (gint) col2[2];
-          gimp_rgb_to_hsv_int (&av0, &av1, &av2);
-          gimp_rgb_to_hsv_int (&bv0, &bv1, &bv2);
-          max = abs (av1 - bv1);
-          break;
+      if (c >= 0)
+        {
+          gfloat col_c;
 
-        case GIMP_SELECT_CRITERION_V:
-          av0 = (gint) col1[0];
-          av1 = (gint) col1[1];
-          av2 = (gint) col1[2];
-          bv0 = (gint) col2[0];
-          bv1 = (gint) col2[1];
-          bv2 = (gint) col2[2];
-          gimp_rgb_to_hsv_int (&av0, &av1, &av2);
-          gimp_rgb_to_hsv_int (&bv0, &bv1, &bv2);
-          max = abs (av2 - bv2);
-          break;
-#endif
+          /*  stay within the pixel for grayscale sources  */
+          c = MIN (c, n_components - (has_alpha ? 1 : 0) - 1);
+
+          col_c = col[c];
+
+          for (i = 0; i < n_pixels; i++)
+            dest[i] = fabsf (col_c - src[i * n_components + c]);
         }
     }
 
+  /*  ...then the selection values...  */
   if (antialias && threshold > 0.0)
     {
-      gfloat aa = 1.5 - (max / threshold);
-
-      if (aa <= 0.0)
-        return 0.0;
-      else if (aa < 0.5)
-        return aa * 2.0;
-      else
-        return 1.0;
+      const gfloat scale = 1.0 / threshold;
+
+      for (i = 0; i < n_pixels; i++)
+        {
+          gfloat aa = 1.5 - dest[i] * scale;
+
+          aa = CLAMP (aa * 2.0, 0.0, 1.0);
+
+          dest[i] = aa;
+        }
     }
   else
     {
-      if (max > threshold)
-        return 0.0;
-      else
-        return 1.0;
+      for (i = 0; i < n_pixels; i++)
+        dest[i] = (dest[i] > threshold) ? 0.0 : 1.0;
+    }
+
+  /*  ...and if there is an alpha channel, never select transparent
+   *  regions
+   */
+  if (! select_transparent && has_alpha)
+    {
+      const gint a = n_components - 1;
+
+      for (i = 0; i < n_pixels; i++)
+        if (src[i * n_components + a] == 0.0)
+          dest[i] = 0.0;
     }
 }
 
-static gboolean
-find_contiguous_segment (const gfloat        *col,
-                         GeglBuffer          *src_buffer,
-                         GeglBuffer          *mask_buffer,
-                         const Babl          *src_format,
-                         gint                 n_components,
-                         gboolean             has_alpha,
-                         gint                 width,
-                         gboolean             select_transparent,
-                         GimpSelectCriterion  select_criterion,
-                         gboolean             antialias,
-                         gfloat               threshold,
-                         gint                 initial_x,
-                         gint                 initial_y,
-                         gint                *start,
-                         gint                *end)
+static FillBlock *
+fill_get_block (ContiguousFill *fill,
+                gint            x,
+                gint            y)
 {
-  gfloat s[MAX_CHANNELS];
-  gfloat mask_row[width];
-  gfloat diff;
+  FillBlock *block = &fill->blocks[(y / FILL_BLOCK_SIZE) * fill->n_cols +
+                                   (x / FILL_BLOCK_SIZE)];
 
-  gegl_buffer_sample (src_buffer, initial_x, initial_y, NULL, s, src_format,
-                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+  if (G_UNLIKELY (! block->diff))
+    {
+      GeglRectangle rect;
 
-  diff = pixel_difference (col, s, antialias, threshold,
-                           n_components, has_alpha, select_transparent,
-                           select_criterion);
+      rect.x      = x - x % FILL_BLOCK_SIZE;
+      rect.y      = y - y % FILL_BLOCK_SIZE;
+      rect.width  = MIN (FILL_BLOCK_SIZE, fill->width  - rect.x);
+      rect.height = MIN (FILL_BLOCK_SIZE, fill->height - rect.y);
 
-  /* check the starting pixel */
-  if (! diff)
-    return FALSE;
+      gegl_buffer_get (fill->src_buffer, &rect, 1.0, fill->format,
+                       fill->src, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-  mask_row[initial_x] = diff;
+      block->diff = g_new (gfloat, rect.width * rect.height);
 
-  *start = initial_x - 1;
+      pixel_difference_row (fill->col, fill->src, block->diff,
+                            rect.width * rect.height,
+                            fill->antialias, fill->threshold,
+                            fill->n_components, fill->has_alpha,
+                            fill->select_transparent,
+                            fill->select_criterion);
+    }
 
-  while (*start >= 0 && diff)
-    {
-      gegl_buffer_sample (src_buffer, *start, initial_y, NULL, s, src_format,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+  return block;
+}
 
-      diff = pixel_difference (col, s, antialias, threshold,
-                               n_components, has_alpha, select_transparent,
-                               select_criterion);
+/*  returns the selection value of an unfilled pixel, or 0.0 if the
+ *  pixel is filled already
+ */
+static inline gfloat
+fill_get_diff (ContiguousFill *fill,
+               gint            x,
+               gint            y)
+{
+  FillBlock *block = fill_get_block (fill, x, y);
+  gint       bx    = x % FILL_BLOCK_SIZE;
+  gint       by    = y % FILL_BLOCK_SIZE;
+  gint       bw    = MIN (FILL_BLOCK_SIZE, fill->width - (x - bx));
 
-      mask_row[*start] = diff;
+  if (block->visited[by] & ((guint64) 1 << bx))
+    return 0.0;
 
-      if (diff)
-        (*start)--;
-    }
+  return block->diff[by * bw + bx];
+}
 
-  diff = 1;
-  *end = initial_x + 1;
+static inline void
+fill_set_visited (ContiguousFill *fill,
+                  gint            x,
+                  gint            y)
+{
+  FillBlock *block = &fill->blocks[(y / FILL_BLOCK_SIZE) * fill->n_cols +
+                                   (x / FILL_BLOCK_SIZE)];
 
-  while (*end < width && diff)
-    {
-      gegl_buffer_sample (src_buffer, *end, initial_y, NULL, s, src_format,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+  block->visited[y % FILL_BLOCK_SIZE] |= (guint64) 1 << (x % FILL_BLOCK_SIZE);
+}
+
+/*  fills the span of unfilled, selected pixels around (x, y), which
+ *  must be unfilled and selected itself
+ */
+static void
+fill_span (ContiguousFill *fill,
+           gint            x,
+           gint            y,
+           gint           *x1,
+           gint           *x2)
+{
+  gint start = x;
+  gint end   = x;
 
-      diff = pixel_difference (col, s, antialias, threshold,
-                               n_components, has_alpha, select_transparent,
-                               select_criterion);
+  fill_set_visited (fill, x, y);
 
-      mask_row[*end] = diff;
+  while (start > 0 && fill_get_diff (fill, start - 1, y) != 0.0)
+    fill_set_visited (fill, --start, y);
 
-      if (diff)
-        (*end)++;
-    }
+  while (end < fill->width - 1 && fill_get_diff (fill, end + 1, y) != 0.0)
+    fill_set_visited (fill, ++end, y);
+
+  *x1 = start;
+  *x2 = end;
+}
+
+/*  fills all spans in row @y touching the pixels x1..x2, and pushes
+ *  them to @stack
+ */
+static void
+fill_row (ContiguousFill *fill,
+          GArray         *stack,
+          gint            y,
+          gint            x1,
+          gint            x2)
+{
+  gint x;
 
-  gegl_buffer_set (mask_buffer, GEGL_RECTANGLE (*start, initial_y,
-                                                *end - *start, 1),
-                   0, babl_format ("Y float"), &mask_row[*start],
-                   GEGL_AUTO_ROWSTRIDE);
+  for (x = x1; x <= x2; x++)
+    {
+      FillSpan span;
+
+      if (fill_get_diff (fill, x, y) == 0.0)
+        continue;
+
+      span.y = y;
 
-  /* XXX this should now be needed and is a performance killer */
-  gegl_buffer_sample_cleanup (mask_buffer);
+      fill_span (fill, x, y, &span.x1, &span.x2);
 
-  return TRUE;
+      g_array_append_val (stack, span);
+
+      x = span.x2 + 1;
+    }
 }
 
+/*  A scanline fill: each filled span is pushed once, and when popped,
+ *  the rows above and below it are scanned for spans to fill. Filled
+ *  pixels are marked in a bitset, so nothing is read back from the
+ *  mask, which is only written once at the end, block by block.
+ */
 static void
 find_contiguous_region_helper (GeglBuffer          *src_buffer,
                                GeglBuffer          *mask_buffer,
@@ -457,63 +527,84 @@ find_contiguous_region_helper (GeglBuffer          *src_buffer,
                                gint                 y,
                                const gfloat        *col)
 {
-  gint    start, end;
-  gint    new_start, new_end;
-  GQueue *coord_stack;
+  ContiguousFill  fill;
+  GArray         *stack;
+  gfloat         *out;
+  gint            i;
+
+  fill.src_buffer         = src_buffer;
+  fill.format             = format;
+  fill.n_components       = babl_format_get_n_components (format);
+  fill.has_alpha          = babl_format_has_alpha (format);
+  fill.width              = gegl_buffer_get_width  (src_buffer);
+  fill.height             = gegl_buffer_get_height (src_buffer);
+  fill.col                = col;
+  fill.select_transparent = select_transparent;
+  fill.select_criterion   = select_criterion;
+  fill.antialias          = antialias;
+  fill.threshold          = threshold;
+
+  if (x < 0 || x >= fill.width || y < 0 || y >= fill.height)
+    return;
+
+  fill.n_cols = (fill.width  + FILL_BLOCK_SIZE - 1) / FILL_BLOCK_SIZE;
+  fill.n_rows = (fill.height + FILL_BLOCK_SIZE - 1) / FILL_BLOCK_SIZE;
+  fill.blocks = g_new0 (FillBlock, fill.n_cols * fill.n_rows);
+  fill.src    = g_new (gfloat, (FILL_BLOCK_SIZE * FILL_BLOCK_SIZE *
+                                fill.n_components));
+
+  stack = g_array_new (FALSE, FALSE, sizeof (FillSpan));
+
+  fill_row (&fill, stack, y, x, x);
+
+  while (stack->len > 0)
+    {
+      FillSpan span = g_array_index (stack, FillSpan, stack->len - 1);
 
-  coord_stack = g_queue_new ();
+      g_array_set_size (stack, stack->len - 1);
 
-  /* To avoid excessive memory allocation (y, start, end) tuples are
-   * stored in interleaved format:
-   *
-   * [y1] [start1] [end1] [y2] [start2] [end2]
-   */
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (y));
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (x - 1));
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (x + 1));
+      if (span.y > 0)
+        fill_row (&fill, stack, span.y - 1, span.x1, span.x2);
+
+      if (span.y < fill.height - 1)
+        fill_row (&fill, stack, span.y + 1, span.x1, span.x2);
+    }
 
-  do
+  g_array_free (stack, TRUE);
+
+  /*  write the filled pixels' selection values to the mask  */
+  out = fill.src;
+
+  for (i = 0; i < fill.n_cols * fill.n_rows; i++)
     {
-      y     = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
-      start = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
-      end   = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
+      FillBlock     *block = &fill.blocks[i];
+      GeglRectangle  rect;
+      gint           bx, by;
+
+      if (! block->diff)
+        continue;
 
-      for (x = start + 1; x < end; x++)
+      rect.x      = (i % fill.n_cols) * FILL_BLOCK_SIZE;
+      rect.y      = (i / fill.n_cols) * FILL_BLOCK_SIZE;
+      rect.width  = MIN (FILL_BLOCK_SIZE, fill.width  - rect.x);
+      rect.height = MIN (FILL_BLOCK_SIZE, fill.height - rect.y);
+
+      for (by = 0; by < rect.height; by++)
         {
-          gfloat val;
-
-          gegl_buffer_sample (mask_buffer, x, y, NULL, &val,
-                              babl_format ("Y float"),
-                              GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-          if (val != 0.0)
-            continue;
-
-          if (! find_contiguous_segment (col, src_buffer, mask_buffer,
-                                         format,
-                                         babl_format_get_n_components (format),
-                                         babl_format_has_alpha (format),
-                                         gegl_buffer_get_width (src_buffer),
-                                         select_transparent, select_criterion,
-                                         antialias, threshold, x, y,
-                                         &new_start, &new_end))
-            continue;
-
-          if (y + 1 < gegl_buffer_get_height (src_buffer))
-            {
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (y + 1));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_start));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_end));
-            }
+          const gfloat *diff    = block->diff + by * rect.width;
+          gfloat       *dest    = out + by * rect.width;
+          guint64       visited = block->visited[by];
 
-          if (y - 1 >= 0)
-            {
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (y - 1));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_start));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_end));
-            }
+          for (bx = 0; bx < rect.width; bx++)
+            dest[bx] = (visited & ((guint64) 1 << bx)) ? diff[bx] : 0.0;
         }
+
+      gegl_buffer_set (mask_buffer, &rect, 0, babl_format ("Y float"), out,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      g_free (block->diff);
     }
-  while (! g_queue_is_empty (coord_stack));
 
-  g_queue_free (coord_stack);
+  g_free (fill.blocks);
+  g_free (fill.src);
 }
@@ -121,8 +121,8 @@ gimp_image_convert_precision (GimpImage     *image,
                                                    gimp_image_get_height (image)),
                                    gimp_image_get_mask_format (image));
 
-    gegl_buffer_copy (gimp_drawable_get_buffer (GIMP_DRAWABLE (mask)), NULL,
-                      buffer, NULL);
+    gimp_gegl_buffer_convert (gimp_drawable_get_buffer (GIMP_DRAWABLE (mask)),
+                              buffer);
 
     gimp_drawable_set_buffer (GIMP_DRAWABLE (mask), FALSE, NULL, buffer);
     g_object_unref (buffer);
@@ -141,9 +141,11 @@
 
 #include "core-types.h"
 
+#include "gegl/gimp-babl.h"
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-parallel.h"
 #include "gimpcontainer.h"
 #include "gimpdrawable.h"
 #include "gimperror.h"
@@ -318,7 +320,7 @@ void rgb_to_unshifted_lin(const unsigned char r,
   float rgb[3] = {r/255.0, g/255.0, b/255.0};
   float lab[3];
 
-  babl_process (rgb_to_lab_fish, rgb, lab, 1);
+  gimp_babl_process (rgb_to_lab_fish, rgb, lab, 1);
 
   /* fprintf(stderr, " %d-%d-%d -> %0.3f,%0.3f,%0.3f ", r, g, b, sL, sa, sb);*/
 
@@ -437,7 +439,7 @@ void lin_to_rgb(const double hr, const double hg, const double hb,
   lab[1] = ig;
   lab[2] = ib;
 
-  babl_process (lab_to_rgb_fish, lab, rgb, 1);
+  gimp_babl_process (lab_to_rgb_fish, lab, rgb, 1);
 
   *r = RINT(CLAMP(rgb[0]*255, 0.0F, 255.0F));
   *g = RINT(CLAMP(rgb[1]*255, 0.0F, 255.0F));
@@ -816,10 +818,10 @@ gimp_image_convert (GimpImage               *image,
     {
       gint i;
 
-      rgb_to_lab_fish = babl_fish (babl_format ("R'G'B' float"),
-                                   babl_format ("CIE Lab float"));
-      lab_to_rgb_fish = babl_fish (babl_format ("CIE Lab float"),
-                                   babl_format ("R'G'B' float"));
+      rgb_to_lab_fish = gimp_babl_fish (babl_format ("R'G'B' float"),
+                                        babl_format ("CIE Lab float"));
+      lab_to_rgb_fish = gimp_babl_fish (babl_format ("CIE Lab float"),
+                                        babl_format ("R'G'B' float"));
 
       /* fprintf(stderr, " TO INDEXED(%d) ", num_cols); */
 
@@ -1112,6 +1114,189 @@ zero_histogram_rgb (CFHistogram histogram)
 }
 
 
+/*  Converting a layer in strips: the strips are read, and written back,
+ *  on the calling thread, since the tile managers behind drawable
+ *  buffers don't allow concurrent access; only the per-pixel work is
+ *  spread over the worker pool. Each strip slot counts the colormap
+ *  indices it emits, and optionally the colors it sees, separately;
+ *  the counts are summed up at the end.
+ */
+
+#define CONVERT_STRIP_PIXELS (1 << 16)
+
+typedef struct _ConvertScan  ConvertScan;
+typedef struct _ConvertStrip ConvertStrip;
+
+typedef void (* ConvertStripFunc) (ConvertStrip *strip,
+                                   gpointer      data);
+
+struct _ConvertScan
+{
+  ConvertStripFunc  func;
+  gpointer          data;
+};
+
+struct _ConvertStrip
+{
+  ConvertScan      *scan;
+  GeglRectangle     rect;              /* in layer coordinates     */
+  guchar           *src;
+  guchar           *dest;
+  gulong           *index_used_count;  /* this slot's index counts */
+  CFHistogram       histogram;         /* this slot's color counts */
+};
+
+static void
+convert_strip_func (gint          i,
+                    gint          n,
+                    ConvertStrip *strips)
+{
+  ConvertScan *scan = strips[i].scan;
+
+  scan->func (&strips[i], scan->data);
+}
+
+static void
+convert_layer_strips (GimpLayer        *layer,
+                      GeglBuffer       *dest_buffer,
+                      gulong           *index_used_count,
+                      CFHistogram       histogram,
+                      ConvertStripFunc  func,
+                      gpointer          data,
+                      GimpProgress     *progress,
+                      gint              nth_layer,
+                      gint              n_layers)
+{
+  ConvertScan   scan;
+  ConvertStrip *strips;
+  GeglBuffer   *buffer    = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  const Babl   *format    = gegl_buffer_get_format (buffer);
+  gint          width     = gegl_buffer_get_width  (buffer);
+  gint          height    = gegl_buffer_get_height (buffer);
+  gint          n_threads = 1;
+  gint          src_bpp;
+  gint          dest_bpp  = 0;
+  gint          strip_height;
+  gint          y;
+  gint          i;
+
+  if (width < 1 || height < 1)
+    return;
+
+  src_bpp = babl_format_get_bytes_per_pixel (format);
+
+  if (dest_buffer)
+    dest_bpp =
+      babl_format_get_bytes_per_pixel (gegl_buffer_get_format (dest_buffer));
+
+  scan.func = func;
+  scan.data = data;
+
+  strip_height = CLAMP (CONVERT_STRIP_PIXELS / width, 1, height);
+
+  n_threads = CLAMP (gimp_parallel_get_n_threads (), 1,
+                     (height + strip_height - 1) / strip_height);
+
+  strips = g_new0 (ConvertStrip, n_threads);
+
+  for (i = 0; i < n_threads; i++)
+    {
+      ConvertStrip *strip = &strips[i];
+
+      strip->scan = &scan;
+      strip->src  = g_new (guchar, width * strip_height * src_bpp);
+
+      if (dest_buffer)
+        strip->dest = g_new (guchar, width * strip_height * dest_bpp);
+
+      /*  the first slot counts straight into the results  */
+      if (i == 0)
+        {
+          strip->index_used_count = index_used_count;
+          strip->histogram        = histogram;
+        }
+      else
+        {
+          if (index_used_count)
+            strip->index_used_count = g_new0 (gulong, 256);
+
+          if (histogram)
+            strip->histogram = g_new0 (ColorFreq, (HIST_R_ELEMS *
+                                                   HIST_G_ELEMS *
+                                                   HIST_B_ELEMS));
+        }
+    }
+
+  for (y = 0; y < height;)
+    {
+      gint n_strips;
+
+      for (n_strips = 0; n_strips < n_threads && y < height; n_strips++)
+        {
+          ConvertStrip *strip = &strips[n_strips];
+
+          strip->rect.x      = 0;
+          strip->rect.y      = y;
+          strip->rect.width  = width;
+          strip->rect.height = MIN (strip_height, height - y);
+
+          gegl_buffer_get (buffer, &strip->rect, 1.0, format, strip->src,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          y += strip->rect.height;
+        }
+
+      gimp_parallel_distribute (n_strips,
+                                (GimpParallelDistributeFunc) convert_strip_func,
+                                strips);
+
+      if (dest_buffer)
+        {
+          for (i = 0; i < n_strips; i++)
+            gegl_buffer_set (dest_buffer, &strips[i].rect, 0,
+                             gegl_buffer_get_format (dest_buffer),
+                             strips[i].dest, GEGL_AUTO_ROWSTRIDE);
+        }
+
+      if (progress)
+        gimp_progress_set_value (progress,
+                                 (nth_layer + (gdouble) y / height) /
+                                 (gdouble) n_layers);
+    }
+
+  for (i = 0; i < n_threads; i++)
+    {
+      ConvertStrip *strip = &strips[i];
+
+      if (i > 0)
+        {
+          gint j;
+
+          if (index_used_count)
+            {
+              for (j = 0; j < 256; j++)
+                index_used_count[j] += strip->index_used_count[j];
+
+              g_free (strip->index_used_count);
+            }
+
+          if (histogram)
+            {
+              for (j = 0; j < HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS; j++)
+                histogram[j] += strip->histogram[j];
+
+              g_free (strip->histogram);
+            }
+        }
+
+      g_free (strip->src);
+      g_free (strip->dest);
+    }
+
+  g_free (strips);
+}
+
+
 static void
 generate_histogram_gray (CFHistogram  histogram,
                          GimpLayer   *layer,
@@ -1161,6 +1346,63 @@ generate_histogram_gray (CFHistogram  histogram,
 }
 
 
+typedef struct
+{
+  gint     bpp;
+  gboolean has_alpha;
+  gboolean alpha_dither;
+  gint     offsetx;
+  gint     offsety;
+} ConvertHistogram;
+
+/*  counts the colors of a strip once it is known that the image needs
+ *  to be quantized
+ */
+static void
+generate_histogram_rgb_strip (ConvertStrip     *strip,
+                              ConvertHistogram *hist)
+{
+  const guchar *data      = strip->src;
+  CFHistogram   histogram = strip->histogram;
+  gint          row;
+
+  for (row = 0; row < strip->rect.height; row++)
+    {
+      gint col;
+
+      for (col = 0; col < strip->rect.width; col++)
+        {
+          gboolean transparent = FALSE;
+
+          if (hist->has_alpha)
+            {
+              if (hist->alpha_dither)
+                {
+                  /* if alpha-dithering,
+                     we need to be deterministic w.r.t. offsets */
+                  gint dither_x = ((strip->rect.x + col + hist->offsetx) &
+                                   DM_WIDTHMASK);
+                  gint dither_y = ((strip->rect.y + row + hist->offsety) &
+                                   DM_HEIGHTMASK);
+
+                  if (data[ALPHA] < DM[dither_x][dither_y])
+                    transparent = TRUE;
+                }
+              else
+                {
+                  if (data[ALPHA] <= 127)
+                    transparent = TRUE;
+                }
+            }
+
+          if (! transparent)
+            (*HIST_RGB (histogram, data[RED], data[GREEN], data[BLUE]))++;
+
+          data += hist->bpp;
+        }
+    }
+}
+
 static void
 generate_histogram_rgb (CFHistogram   histogram,
                         GimpLayer    *layer,
@@ -1198,6 +1440,29 @@ generate_histogram_rgb (CFHistogram   histogram,
 
   /*  g_printerr ("col_limit = %d, nfc = %d\n", col_limit, num_found_cols); */
 
+  if (needs_quantize)
+    {
+      ConvertHistogram hist;
+
+      /*  only the plain counting is left, which doesn't depend on the
+       *  order the pixels are seen in
+       */
+      hist.bpp          = bpp;
+      hist.has_alpha    = has_alpha;
+      hist.alpha_dither = alpha_dither;
+      hist.offsetx      = offsetx;
+      hist.offsety      = offsety;
+
+      if (progress)
+        gimp_progress_set_value (progress,
+                                 nth_layer / (gdouble) n_layers);
+
+      convert_layer_strips (layer, NULL, NULL, histogram,
+                            (ConvertStripFunc) generate_histogram_rgb_strip,
+                            &hist, progress, nth_layer, n_layers);
+      return;
+    }
+
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
                                    NULL, 0, format,
                                    GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
@@ -3072,316 +3337,284 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
     }
 }
 
-static void
-median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
-                                GimpLayer   *layer,
-                                GeglBuffer  *new_buffer)
+typedef struct
 {
-  GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
-  const Babl         *src_format;
-  const Babl         *dest_format;
-  GeglRectangle      *src_roi;
-  gint                src_bpp;
-  gint                dest_bpp;
-  gint                has_alpha;
-  gint                R, G, B;
-  gint                red_pix          = RED;
-  gint                green_pix        = GREEN;
-  gint                blue_pix         = BLUE;
-  gint                alpha_pix        = ALPHA;
-  gboolean            alpha_dither     = quantobj->want_alpha_dither;
-  gint                offsetx, offsety;
-  gulong             *index_used_count = quantobj->index_used_count;
-  glong               total_size       = 0;
-  glong               layer_size;
-  gint                count            = 0;
-  gint                nth_layer        = quantobj->nth_layer;
-  gint                n_layers         = quantobj->n_layers;
-
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
+  QuantizeObj *quantobj;
+  gint         src_bpp;
+  gint         dest_bpp;
+  gboolean     has_alpha;
+  gint         red_pix;
+  gint         green_pix;
+  gint         blue_pix;
+  gint         alpha_pix;
+  gboolean     alpha_dither;
+  gint         offsetx;
+  gint         offsety;
+} ConvertRemap;
 
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
+static void
+convert_remap_init (ConvertRemap *remap,
+                    QuantizeObj  *quantobj,
+                    GimpLayer    *layer,
+                    GeglBuffer   *new_buffer)
+{
+  const Babl *src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+  const Babl *dest_format = gegl_buffer_get_format (new_buffer);
 
-  src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-  dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
+  remap->quantobj     = quantobj;
+  remap->src_bpp      = babl_format_get_bytes_per_pixel (src_format);
+  remap->dest_bpp     = babl_format_get_bytes_per_pixel (dest_format);
+  remap->has_alpha    = babl_format_has_alpha (src_format);
+  remap->red_pix      = RED;
+  remap->green_pix    = GREEN;
+  remap->blue_pix     = BLUE;
+  remap->alpha_pix    = ALPHA;
+  remap->alpha_dither = quantobj->want_alpha_dither;
 
-  has_alpha = babl_format_has_alpha (src_format);
+  gimp_item_get_offset (GIMP_ITEM (layer), &remap->offsetx, &remap->offsety);
 
   /*  In the case of web/mono palettes, we actually force
    *   grayscale drawables through the rgb pass2 functions
    */
   if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
     {
-      red_pix = green_pix = blue_pix = GRAY;
-      alpha_pix = ALPHA_G;
+      remap->red_pix = remap->green_pix = remap->blue_pix = GRAY;
+      remap->alpha_pix = ALPHA_G;
     }
+}
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
-                                   GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
-  src_roi = &iter->roi[0];
-
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
-                            GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
-
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
+/*  The strips of the remap passes share the inverse colormap cache in
+ *  quantobj->histogram. A cell is only ever set to the one colormap
+ *  index which is nearest to it, so when two threads fill in the same
+ *  cell, they store the same value, and the result doesn't depend on
+ *  which one is first.
+ */
 
-  while (gegl_buffer_iterator_next (iter))
+static void
+median_cut_pass2_no_dither_rgb_strip (ConvertStrip *strip,
+                                      ConvertRemap *remap)
+{
+  QuantizeObj  *quantobj         = remap->quantobj;
+  CFHistogram   histogram        = quantobj->histogram;
+  gulong       *index_used_count = strip->index_used_count;
+  const guchar *src              = strip->src;
+  guchar       *dest             = strip->dest;
+  const gint    red_pix          = remap->red_pix;
+  const gint    green_pix        = remap->green_pix;
+  const gint    blue_pix         = remap->blue_pix;
+  const gint    alpha_pix        = remap->alpha_pix;
+  gint          row;
+
+  for (row = 0; row < strip->rect.height; row++)
     {
-      const guchar *src  = iter->data[0];
-      guchar       *dest = iter->data[1];
-      gint          row;
-
-      total_size += src_roi->height * src_roi->width;
+      gint col;
 
-      for (row = 0; row < src_roi->height; row++)
+      for (col = 0; col < strip->rect.width; col++)
         {
-          gint col;
+          ColorFreq *cachep;
+          gint       R, G, B;
 
-          for (col = 0; col < src_roi->width; col++)
+          if (remap->has_alpha)
             {
-              if (has_alpha)
+              gboolean transparent = FALSE;
+
+              if (remap->alpha_dither)
                 {
-                  gboolean transparent = FALSE;
+                  gint dither_x = ((col + remap->offsetx + strip->rect.x) &
+                                   DM_WIDTHMASK);
+                  gint dither_y = ((row + remap->offsety + strip->rect.y) &
+                                   DM_HEIGHTMASK);
 
-                  if (alpha_dither)
-                    {
-                      gint dither_x = (col + offsetx + src_roi->x) & DM_WIDTHMASK;
-                      gint dither_y = (row + offsety + src_roi->y) & DM_HEIGHTMASK;
-                      if ((src[alpha_pix]) < DM[dither_x][dither_y])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[alpha_pix] <= 127)
-                        transparent = TRUE;
-                    }
+                  if ((src[alpha_pix]) < DM[dither_x][dither_y])
+                    transparent = TRUE;
+                }
+              else
+                {
+                  if (src[alpha_pix] <= 127)
+                    transparent = TRUE;
+                }
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                      goto next_pixel;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                    }
+              if (transparent)
+                {
+                  dest[ALPHA_I] = 0;
+                  goto next_pixel;
+                }
+              else
+                {
+                  dest[ALPHA_I] = 255;
                 }
+            }
 
-              /* get pixel value and index into the cache */
-              rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
-                          &R, &G, &B);
-              cachep = HIST_LIN(histogram,R,G,B);
-              /* If we have not seen this color before, find nearest
-                 colormap entry and update the cache */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+          /* get pixel value and index into the cache */
+          rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
+                      &R, &G, &B);
+          cachep = HIST_LIN(histogram,R,G,B);
+          /* If we have not seen this color before, find nearest
+             colormap entry and update the cache */
+          if (*cachep == 0)
+            fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
 
-              /* Now emit the colormap index for this cell, barfbarf */
-              index_used_count[dest[INDEXED] = *cachep - 1]++;
+          /* Now emit the colormap index for this cell, barfbarf */
+          index_used_count[dest[INDEXED] = *cachep - 1]++;
 
-            next_pixel:
+        next_pixel:
 
-              src  += src_bpp;
-              dest += dest_bpp;
-            }
+          src  += remap->src_bpp;
+          dest += remap->dest_bpp;
         }
-
-      if (quantobj->progress && (count % 16 == 0))
-         gimp_progress_set_value (quantobj->progress,
-                                  (nth_layer + ((gdouble) total_size)/
-                                   layer_size) / (gdouble) n_layers);
     }
 }
 
 static void
-median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
-                                   GimpLayer   *layer,
-                                   GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
+                                GimpLayer   *layer,
+                                GeglBuffer  *new_buffer)
 {
-  GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
-  const Babl         *src_format;
-  const Babl         *dest_format;
-  GeglRectangle      *src_roi;
-  gint                src_bpp;
-  gint                dest_bpp;
-  gint                has_alpha;
-  gint                pixval1 = 0;
-  gint                pixval2 = 0;
-  Color              *color1;
-  Color              *color2;
-  gint                R, G, B;
-  gint                err1;
-  gint                err2;
-  gint                red_pix          = RED;
-  gint                green_pix        = GREEN;
-  gint                blue_pix         = BLUE;
-  gint                alpha_pix        = ALPHA;
-  gboolean            alpha_dither     = quantobj->want_alpha_dither;
-  gint                offsetx, offsety;
-  gulong             *index_used_count = quantobj->index_used_count;
-  glong               total_size       = 0;
-  glong               layer_size;
-  gint                count            = 0;
-  gint                nth_layer        = quantobj->nth_layer;
-  gint                n_layers         = quantobj->n_layers;
-
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-  dest_format = gegl_buffer_get_format (new_buffer);
-
-  src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-  dest_bpp = babl_format_get_bytes_per_pixel (dest_format);
-
-  has_alpha = babl_format_has_alpha (src_format);
-
-  /*  In the case of web/mono palettes, we actually force
-   *   grayscale drawables through the rgb pass2 functions
-   */
-  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
-    {
-      red_pix = green_pix = blue_pix = GRAY;
-      alpha_pix = ALPHA_G;
-    }
-
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
-                                   GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
-  src_roi = &iter->roi[0];
+  ConvertRemap remap;
 
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
-                            GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
+  convert_remap_init (&remap, quantobj, layer, new_buffer);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
+  convert_layer_strips (layer, new_buffer,
+                        quantobj->index_used_count, NULL,
+                        (ConvertStripFunc) median_cut_pass2_no_dither_rgb_strip,
+                        &remap,
+                        quantobj->progress,
+                        quantobj->nth_layer, quantobj->n_layers);
+}
 
-  while (gegl_buffer_iterator_next (iter))
+static void
+median_cut_pass2_fixed_dither_rgb_strip (ConvertStrip *strip,
+                                         ConvertRemap *remap)
+{
+  QuantizeObj  *quantobj         = remap->quantobj;
+  CFHistogram   histogram        = quantobj->histogram;
+  gulong       *index_used_count = strip->index_used_count;
+  const guchar *src              = strip->src;
+  guchar       *dest             = strip->dest;
+  const gint    red_pix          = remap->red_pix;
+  const gint    green_pix        = remap->green_pix;
+  const gint    blue_pix         = remap->blue_pix;
+  const gint    alpha_pix        = remap->alpha_pix;
+  gint          row;
+
+  for (row = 0; row < strip->rect.height; row++)
     {
-      const guchar *src  = iter->data[0];
-      guchar       *dest = iter->data[1];
-      gint          row;
+      gint col;
 
-      total_size += src_roi->height * src_roi->width;
-
-      for (row = 0; row < src_roi->height; row++)
+      for (col = 0; col < strip->rect.width; col++)
         {
-          gint col;
-
-          for (col = 0; col < src_roi->width; col++)
+          ColorFreq *cachep;
+          gint       pixval1 = 0;
+          gint       pixval2 = 0;
+          Color     *color1;
+          Color     *color2;
+          gint       R, G, B;
+          gint       err1;
+          gint       err2;
+          const int  dmval =
+            DM[(col + remap->offsetx + strip->rect.x) & DM_WIDTHMASK]
+            [(row + remap->offsety + strip->rect.y) & DM_HEIGHTMASK];
+
+          if (remap->has_alpha)
             {
-              const int dmval =
-                DM[(col + offsetx + src_roi->x) & DM_WIDTHMASK]
-                [(row + offsety + src_roi->y) & DM_HEIGHTMASK];
+              gboolean transparent = FALSE;
 
-              if (has_alpha)
+              if (remap->alpha_dither)
                 {
-                  gboolean transparent = FALSE;
-
-                  if (alpha_dither)
-                    {
-                      if (src[alpha_pix] < dmval)
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[alpha_pix] <= 127)
-                        transparent = TRUE;
-                    }
-
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                      goto next_pixel;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                    }
+                  if (src[alpha_pix] < dmval)
+                    transparent = TRUE;
+                }
+              else
+                {
+                  if (src[alpha_pix] <= 127)
+                    transparent = TRUE;
                 }
 
-              /* get pixel value and index into the cache */
-              rgb_to_lin(src[red_pix], src[green_pix], src[blue_pix],
-                         &R, &G, &B);
-              cachep = HIST_LIN(histogram,R,G,B);
-              /* If we have not seen this color before, find nearest
-                 colormap entry and update the cache */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-
-              /* We now try to find a colour which, when mixed in some fashion
-                 with the closest match, yields something closer to the
-                 desired colour.  We do this by repeatedly extrapolating the
-                 colour vector from one to the other until we find another
-                 colour cell.  Then we assess the distance of both mixer
-                 colours from the intended colour to determine their relative
-                 probabilities of being chosen. */
-              pixval1 = *cachep - 1;
-              color1 = &quantobj->cmap[pixval1];
-
-              if (quantobj->actual_number_of_colors > 2)
+              if (transparent)
+                {
+                  dest[ALPHA_I] = 0;
+                  goto next_pixel;
+                }
+              else
                 {
-                  const int re = src[red_pix] - (int)color1->red;
-                  const int ge = src[green_pix] - (int)color1->green;
-                  const int be = src[blue_pix] - (int)color1->blue;
-                  int RV = src[red_pix] + re;
-                  int GV = src[green_pix] + ge;
-                  int BV = src[blue_pix] + be;
+                  dest[ALPHA_I] = 255;
+                }
+            }
 
-                  do
+          /* get pixel value and index into the cache */
+          rgb_to_lin(src[red_pix], src[green_pix], src[blue_pix],
+                     &R, &G, &B);
+          cachep = HIST_LIN(histogram,R,G,B);
+          /* If we have not seen this color before, find nearest
+             colormap entry and update the cache */
+          if (*cachep == 0)
+            fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+
+          /* We now try to find a colour which, when mixed in some fashion
+             with the closest match, yields something closer to the
+             desired colour.  We do this by repeatedly extrapolating the
+             colour vector from one to the other until we find another
+             colour cell.  Then we assess the distance of both mixer
+             colours from the intended colour to determine their relative
+             probabilities of being chosen. */
+          pixval1 = *cachep - 1;
+          color1 = &quantobj->cmap[pixval1];
+
+          if (quantobj->actual_number_of_colors > 2)
+            {
+              const int re = src[red_pix] - (int)color1->red;
+              const int ge = src[green_pix] - (int)color1->green;
+              const int be = src[blue_pix] - (int)color1->blue;
+              int RV = src[red_pix] + re;
+              int GV = src[green_pix] + ge;
+              int BV = src[blue_pix] + be;
+
+              do
+                {
+                  rgb_to_lin ((CLAMP0255(RV)),
+                              (CLAMP0255(GV)),
+                              (CLAMP0255(BV)),
+                              &R, &G, &B);
+                  cachep = HIST_LIN(histogram,R,G,B);
+
+                  /* If we have not seen this color before, find nearest
+                     colormap entry and update the cache */
+                  if (*cachep == 0)
                     {
-                      rgb_to_lin ((CLAMP0255(RV)),
-                                  (CLAMP0255(GV)),
-                                  (CLAMP0255(BV)),
-                                  &R, &G, &B);
-                      cachep = HIST_LIN(histogram,R,G,B);
-
-                      /* If we have not seen this color before, find nearest
-                         colormap entry and update the cache */
-                      if (*cachep == 0)
-                        {
-                          fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-                        }
-                      pixval2 = *cachep - 1;
-                      RV += re;  GV += ge;  BV += be;
+                      fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
                     }
-                  while ((pixval1 == pixval2) &&
-                         (!( (RV>255 || RV<0) || (GV>255 || GV<0) || (BV>255 || BV<0) )) &&
-                         (re || ge || be));
+                  pixval2 = *cachep - 1;
+                  RV += re;  GV += ge;  BV += be;
                 }
+              while ((pixval1 == pixval2) &&
+                     (!( (RV>255 || RV<0) || (GV>255 || GV<0) || (BV>255 || BV<0) )) &&
+                     (re || ge || be));
+            }
 
-              if (quantobj->actual_number_of_colors <= 2
-                  /* || pixval1 == pixval2 */) {
-                /* not enough colours to bother looking for an 'alternative'
-                   colour (we may fail to do so anyway), so decide that
-                   the alternative colour is simply the other cmap entry. */
-                pixval2 = (pixval1 + 1) %
-                  (quantobj->actual_number_of_colors);
-              }
+          if (quantobj->actual_number_of_colors <= 2
+              /* || pixval1 == pixval2 */) {
+            /* not enough colours to bother looking for an 'alternative'
+               colour (we may fail to do so anyway), so decide that
+               the alternative colour is simply the other cmap entry. */
+            pixval2 = (pixval1 + 1) %
+              (quantobj->actual_number_of_colors);
+          }
 
-              /* always deterministically sort pixval1 and pixval2, to
-                 avoid artifacts in the dither range due to inverting our
-                 relative colour viewpoint -- most obvious in 1-bit dither. */
-              if (pixval1 > pixval2)
-                {
-                  gint tmpval = pixval1;
-                  pixval1 = pixval2;
-                  pixval2 = tmpval;
-                  color1 = &quantobj->cmap[pixval1];
-                }
+          /* always deterministically sort pixval1 and pixval2, to
+             avoid artifacts in the dither range due to inverting our
+             relative colour viewpoint -- most obvious in 1-bit dither. */
+          if (pixval1 > pixval2)
+            {
+              gint tmpval = pixval1;
+              pixval1 = pixval2;
+              pixval2 = tmpval;
+              color1 = &quantobj->cmap[pixval1];
+            }
 
-              color2 = &quantobj->cmap[pixval2];
+          color2 = &quantobj->cmap[pixval2];
 
-              /* now figure out the relative probabilites of choosing
-                 either of our candidates. */
+          /* now figure out the relative probabilites of choosing
+             either of our candidates. */
 #define DISTP(R1,G1,B1,R2,G2,B2,D) do {D = sqrt( 30*SQR((R1)-(R2)) + \
                                                  59*SQR((G1)-(G2)) + \
                                                  11*SQR((B1)-(B2)) ); }while(0)
@@ -3395,41 +3628,52 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
                          B_SCALE * SQR((spaceb1)-(spaceb2))); \
               } while(0)
 
-              /* although LIN_DISTP is more correct, DISTP is much faster and
-                 barely distinguishable. */
-              DISTP (color1->red, color1->green, color1->blue,
-                     src[red_pix], src[green_pix], src[blue_pix],
-                     err1);
-              DISTP (color2->red, color2->green, color2->blue,
-                     src[red_pix], src[green_pix], src[blue_pix],
-                     err2);
+          /* although LIN_DISTP is more correct, DISTP is much faster and
+             barely distinguishable. */
+          DISTP (color1->red, color1->green, color1->blue,
+                 src[red_pix], src[green_pix], src[blue_pix],
+                 err1);
+          DISTP (color2->red, color2->green, color2->blue,
+                 src[red_pix], src[green_pix], src[blue_pix],
+                 err2);
 
-              if (err1 || err2)
+          if (err1 || err2)
+            {
+              const int proportion2 = (255 * err2) / (err1 + err2);
+              if (dmval > proportion2)
                 {
-                  const int proportion2 = (255 * err2) / (err1 + err2);
-                  if (dmval > proportion2)
-                    {
-                      pixval1 = pixval2; /* use color2 instead of color1*/
-                    }
+                  pixval1 = pixval2; /* use color2 instead of color1*/
                 }
+            }
 
-              /* Now emit the colormap index for this cell, barfbarf */
-              index_used_count[dest[INDEXED] = pixval1]++;
+          /* Now emit the colormap index for this cell, barfbarf */
+          index_used_count[dest[INDEXED] = pixval1]++;
 
-            next_pixel:
+        next_pixel:
 
-              src  += src_bpp;
-              dest += dest_bpp;
-            }
+          src  += remap->src_bpp;
+          dest += remap->dest_bpp;
         }
-
-      if (quantobj->progress && (count % 16 == 0))
-        gimp_progress_set_value (quantobj->progress,
-                                 (nth_layer + ((gdouble) total_size)/
-                                  layer_size) / (gdouble) n_layers);
     }
 }
 
+static void
+median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
+                                   GimpLayer   *layer,
+                                   GeglBuffer  *new_buffer)
+{
+  ConvertRemap remap;
+
+  convert_remap_init (&remap, quantobj, layer, new_buffer);
+
+  convert_layer_strips (layer, new_buffer,
+                        quantobj->index_used_count, NULL,
+                        (ConvertStripFunc) median_cut_pass2_fixed_dither_rgb_strip,
+                        &remap,
+                        quantobj->progress,
+                        quantobj->nth_layer, quantobj->n_layers);
+}
+
 static void
 median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
                                         GimpLayer   *layer,
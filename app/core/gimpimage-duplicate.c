@@ -21,6 +21,8 @@
 
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-utils.h"
+
 #include "gimp.h"
 #include "gimpchannel.h"
 #include "gimpguide.h"
@@ -185,6 +187,10 @@ gimp_image_duplicate_colormap (GimpImage *image,
                              FALSE);
 }
 
+/*  Drawables are duplicated with gimp_gegl_buffer_dup(), so the new
+ *  image shares all their tiles with @item's image until either of
+ *  them is painted on.
+ */
 static GimpItem *
 gimp_image_duplicate_item (GimpItem  *item,
                            GimpImage *new_image)
@@ -381,11 +387,17 @@ gimp_image_duplicate_mask (GimpImage *image,
   GimpDrawable *mask;
   GimpDrawable *new_mask;
 
+  GeglBuffer   *buffer;
+
   mask     = GIMP_DRAWABLE (gimp_image_get_mask (image));
   new_mask = GIMP_DRAWABLE (gimp_image_get_mask (new_image));
 
-  gegl_buffer_copy (gimp_drawable_get_buffer (mask), NULL,
-                    gimp_drawable_get_buffer (new_mask), NULL);
+  /*  share the tiles copy-on-write, like gimp_item_convert() does for
+   *  the layers and channels, instead of copying every pixel
+   */
+  buffer = gimp_gegl_buffer_dup (gimp_drawable_get_buffer (mask));
+  gimp_drawable_set_buffer (new_mask, FALSE, NULL, buffer);
+  g_object_unref (buffer);
 
   GIMP_CHANNEL (new_mask)->bounds_known   = FALSE;
   GIMP_CHANNEL (new_mask)->boundary_known = FALSE;
@@ -17,6 +17,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 
 #include "core-types.h"
@@ -31,6 +33,14 @@
 #include "gimp-intl.h"
 
 
+static void   gimp_image_guide_notify               (GimpGuide     *guide,
+                                                     GParamSpec    *pspec,
+                                                     GimpImage     *image);
+static void   gimp_image_invalidate_guide_positions (GimpImage     *image);
+static gint   gimp_image_guide_position_compare     (gconstpointer  a,
+                                                     gconstpointer  b);
+
+
 /*  public functions  */
 
 GimpGuide *
@@ -95,9 +105,15 @@ gimp_image_add_guide (GimpImage *image,
 
   private->guides = g_list_prepend (private->guides, guide);
 
+  g_signal_connect (guide, "notify",
+                    G_CALLBACK (gimp_image_guide_notify),
+                    image);
+
   gimp_guide_set_position (guide, position);
   g_object_ref (G_OBJECT (guide));
 
+  gimp_image_invalidate_guide_positions (image);
+
   gimp_image_guide_added (image, guide);
 }
 
@@ -119,6 +135,11 @@ gimp_image_remove_guide (GimpImage *image,
   private->guides = g_list_remove (private->guides, guide);
   gimp_guide_removed (guide);
 
+  g_signal_handlers_disconnect_by_func (guide,
+                                        gimp_image_guide_notify,
+                                        image);
+  gimp_image_invalidate_guide_positions (image);
+
   gimp_image_guide_removed (image, guide);
 
   gimp_guide_set_position (guide, -1);
@@ -156,6 +177,74 @@ gimp_image_get_guides (GimpImage *image)
   return GIMP_IMAGE_GET_PRIVATE (image)->guides;
 }
 
+/**
+ * gimp_image_get_guide_positions:
+ * @image:       a #GimpImage
+ * @orientation: which guides to return
+ * @n_positions: returns the number of positions
+ *
+ * Returns the positions of all guides of @image with @orientation,
+ * sorted in ascending order, so snapping can binary search them
+ * instead of walking the whole guide list on every motion event.
+ * The array is rebuilt lazily after guides were added, removed,
+ * moved or rotated.
+ *
+ * Return value: the sorted positions, owned by @image and valid until
+ *               the next change to its guides.
+ **/
+const gint *
+gimp_image_get_guide_positions (GimpImage           *image,
+                                GimpOrientationType  orientation,
+                                gint                *n_positions)
+{
+  GimpImagePrivate  *private;
+  GArray           **positions;
+  GList             *list;
+
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), NULL);
+  g_return_val_if_fail (n_positions != NULL, NULL);
+
+  private = GIMP_IMAGE_GET_PRIVATE (image);
+
+  switch (orientation)
+    {
+    case GIMP_ORIENTATION_HORIZONTAL:
+      positions = &private->hguide_positions;
+      break;
+
+    case GIMP_ORIENTATION_VERTICAL:
+      positions = &private->vguide_positions;
+      break;
+
+    default:
+      *n_positions = 0;
+      return NULL;
+    }
+
+  if (! *positions)
+    {
+      *positions = g_array_new (FALSE, FALSE, sizeof (gint));
+
+      for (list = private->guides; list; list = g_list_next (list))
+        {
+          GimpGuide *guide    = list->data;
+          gint       position = gimp_guide_get_position (guide);
+
+          if (position >= 0 &&
+              gimp_guide_get_orientation (guide) == orientation)
+            {
+              g_array_append_val (*positions, position);
+            }
+        }
+
+      g_array_sort (*positions, gimp_image_guide_position_compare);
+    }
+
+  *n_positions = (*positions)->len;
+
+  return (const gint *) (*positions)->data;
+}
+
 GimpGuide *
 gimp_image_get_guide (GimpImage *image,
                       guint32    id)
@@ -266,3 +355,49 @@ gimp_image_find_guide (GimpImage *image,
 
   return ret;
 }
+
+
+/*  private functions  */
+
+static void
+gimp_image_guide_notify (GimpGuide  *guide,
+                         GParamSpec *pspec,
+                         GimpImage  *image)
+{
+  /*  guides are also moved and rotated behind the image's back, by
+   *  undo and gimp_image_rotate(), so watch the guide itself
+   */
+  if (! strcmp (pspec->name, "position") ||
+      ! strcmp (pspec->name, "orientation"))
+    {
+      gimp_image_invalidate_guide_positions (image);
+    }
+}
+
+static void
+gimp_image_invalidate_guide_positions (GimpImage *image)
+{
+  GimpImagePrivate *private = GIMP_IMAGE_GET_PRIVATE (image);
+
+  if (private->hguide_positions)
+    {
+      g_array_free (private->hguide_positions, TRUE);
+      private->hguide_positions = NULL;
+    }
+
+  if (private->vguide_positions)
+    {
+      g_array_free (private->vguide_positions, TRUE);
+      private->vguide_positions = NULL;
+    }
+}
+
+static gint
+gimp_image_guide_position_compare (gconstpointer a,
+                                   gconstpointer b)
+{
+  gint pos_a = *(const gint *) a;
+  gint pos_b = *(const gint *) b;
+
+  return (pos_a > pos_b) - (pos_a < pos_b);
+}
@@ -56,5 +56,9 @@ GimpGuide * gimp_image_find_guide     (GimpImage *image,
                                        gdouble    epsilon_x,
                                        gdouble    epsilon_y);
 
+const gint * gimp_image_get_guide_positions (GimpImage           *image,
+                                             GimpOrientationType  orientation,
+                                             gint                *n_positions);
+
 
 #endif /* __GIMP_IMAGE_GUIDES_H__ */
@@ -46,6 +46,8 @@
 #include "gimplayermask.h"
 #include "gimpmarshal.h"
 #include "gimpparasitelist.h"
+#include "gimppickable.h"
+#include "gimpprojection.h"
 #include "gimpundostack.h"
 
 #include "gimp-intl.h"
@@ -205,6 +207,164 @@ gimp_image_flatten (GimpImage   *image,
   return layer;
 }
 
+/**
+ * gimp_image_flatten_projection:
+ * @image:      the image whose layers are replaced
+ * @source:     the image whose projection supplies the pixels
+ * @context:    a #GimpContext, for the background color
+ * @merge_type: %GIMP_FLATTEN_IMAGE or %GIMP_CLIP_TO_IMAGE
+ *
+ * Replaces all layers of @image with a single image-sized layer made
+ * from @source's projection.  @source usually is the image @image was
+ * duplicated from for exporting, its projection is the composite of
+ * the visible layers and mostly validated already for the display, so
+ * nothing needs to be composited again.
+ *
+ * With %GIMP_CLIP_TO_IMAGE the new layer shares the projection's
+ * tiles until either is modified, so the merged layer costs no memory
+ * of its own; %GIMP_FLATTEN_IMAGE composites the projection over the
+ * background color in a single pass.
+ *
+ * The projection is only used if it holds exactly what merging
+ * @image's visible layers would: both images must have the same size,
+ * the projection's format must be @image's layer format, and @image
+ * can't have visible channels or a floating selection.  Otherwise
+ * @image is left alone and %NULL is returned, and the caller should
+ * fall back to gimp_image_flatten() or
+ * gimp_image_merge_visible_layers().
+ *
+ * Return value: the new layer, or %NULL.
+ **/
+GimpLayer *
+gimp_image_flatten_projection (GimpImage     *image,
+                               GimpImage     *source,
+                               GimpContext   *context,
+                               GimpMergeType  merge_type)
+{
+  GimpPickable     *projection;
+  GeglBuffer       *proj_buffer;
+  GimpLayer        *bottom_layer = NULL;
+  GimpLayer        *layer;
+  GimpParasiteList *parasites;
+  GList            *list;
+  gint              width;
+  gint              height;
+
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), NULL);
+  g_return_val_if_fail (GIMP_IS_IMAGE (source), NULL);
+  g_return_val_if_fail (GIMP_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (merge_type == GIMP_FLATTEN_IMAGE ||
+                        merge_type == GIMP_CLIP_TO_IMAGE, NULL);
+
+  width  = gimp_image_get_width  (image);
+  height = gimp_image_get_height (image);
+
+  projection = GIMP_PICKABLE (gimp_image_get_projection (source));
+
+  if (width  != gimp_image_get_width  (source) ||
+      height != gimp_image_get_height (source) ||
+      gimp_pickable_get_format (projection) !=
+      gimp_image_get_layer_format (image, TRUE))
+    return NULL;
+
+  if (gimp_image_get_floating_selection (image))
+    return NULL;
+
+  for (list = gimp_image_get_channel_iter (image);
+       list;
+       list = g_list_next (list))
+    {
+      if (gimp_item_get_visible (list->data))
+        return NULL;
+    }
+
+  for (list = gimp_image_get_layer_iter (image);
+       list;
+       list = g_list_next (list))
+    {
+      if (gimp_item_get_visible (list->data))
+        bottom_layer = list->data;
+    }
+
+  if (! bottom_layer)
+    return NULL;
+
+  gimp_set_busy (image->gimp);
+
+  gimp_image_undo_group_start (image,
+                               GIMP_UNDO_GROUP_IMAGE_LAYERS_MERGE,
+                               merge_type == GIMP_FLATTEN_IMAGE ?
+                               C_("undo-type", "Flatten Image") :
+                               C_("undo-type", "Merge Visible Layers"));
+
+  /*  render whatever the display hasn't got to yet  */
+  gimp_pickable_flush (projection);
+  proj_buffer = gimp_pickable_get_buffer (projection);
+
+  if (merge_type == GIMP_FLATTEN_IMAGE)
+    {
+      GeglNode *flatten;
+      GimpRGB   bg;
+
+      layer = gimp_layer_new (image, width, height,
+                              gimp_image_get_layer_format (image, FALSE),
+                              gimp_object_get_name (bottom_layer),
+                              GIMP_OPACITY_OPAQUE, GIMP_NORMAL_MODE);
+
+      gimp_context_get_background (context, &bg);
+      flatten = gimp_gegl_create_flatten_node (&bg);
+
+      gimp_apply_operation (proj_buffer, NULL, NULL,
+                            flatten,
+                            gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                            NULL);
+
+      g_object_unref (flatten);
+    }
+  else
+    {
+      GeglBuffer *buffer;
+
+      layer = gimp_layer_new (image, width, height,
+                              gimp_image_get_layer_format (image, TRUE),
+                              gimp_object_get_name (bottom_layer),
+                              GIMP_OPACITY_OPAQUE, GIMP_NORMAL_MODE);
+
+      buffer = gimp_gegl_buffer_dup (proj_buffer);
+      gimp_drawable_set_buffer (GIMP_DRAWABLE (layer), FALSE, NULL, buffer);
+      g_object_unref (buffer);
+    }
+
+  /* Copy the tattoo and parasites of the bottom layer to the new layer */
+  gimp_item_set_tattoo (GIMP_ITEM (layer),
+                        gimp_item_get_tattoo (GIMP_ITEM (bottom_layer)));
+
+  parasites = gimp_item_get_parasites (GIMP_ITEM (bottom_layer));
+  parasites = gimp_parasite_list_copy (parasites);
+  gimp_item_set_parasites (GIMP_ITEM (layer), parasites);
+  g_object_unref (parasites);
+
+  list = gimp_image_get_layer_iter (image);
+  while (list)
+    {
+      GimpLayer *old_layer = list->data;
+
+      list = g_list_next (list);
+      gimp_image_remove_layer (image, old_layer, TRUE, NULL);
+    }
+
+  gimp_image_add_layer (image, layer, NULL, 0, TRUE);
+
+  if (merge_type == GIMP_FLATTEN_IMAGE)
+    gimp_image_alpha_changed (image);
+
+  gimp_image_undo_group_end (image);
+
+  gimp_unset_busy (image->gimp);
+
+  return layer;
+}
+
 GimpLayer *
 gimp_image_merge_down (GimpImage      *image,
                        GimpLayer      *current_layer,
@@ -34,6 +34,10 @@ GimpLayer   * gimp_image_merge_group_layer     (GimpImage      *image,
 
 GimpLayer   * gimp_image_flatten               (GimpImage      *image,
                                                 GimpContext    *context);
+GimpLayer   * gimp_image_flatten_projection    (GimpImage      *image,
+                                                GimpImage      *source,
+                                                GimpContext    *context,
+                                                GimpMergeType   merge_type);
 
 GimpVectors * gimp_image_merge_visible_vectors (GimpImage      *image,
                                                 GError        **error);
@@ -17,10 +17,13 @@
 
 #include "config.h"
 
+#include <math.h>
+
 #include <gegl.h>
 
 #include "core-types.h"
 
+#include "base/tile-manager.h"
 #include "base/tile-manager-preview.h"
 
 #include "gegl/gimp-babl.h"
@@ -129,18 +132,59 @@ gimp_image_get_new_preview (GimpViewable *viewable,
                             gint          width,
                             gint          height)
 {
-  GimpImage      *image      = GIMP_IMAGE (viewable);
-  GimpProjection *projection = gimp_image_get_projection (image);
+  return gimp_image_get_new_sub_preview (GIMP_IMAGE (viewable),
+                                         width, height,
+                                         0, 0, width, height);
+}
+
+/**
+ * gimp_image_get_new_sub_preview:
+ * @image:          a #GimpImage
+ * @preview_width:  width of the whole preview
+ * @preview_height: height of the whole preview
+ * @x:              left edge of the area, in preview coordinates
+ * @y:              top edge of the area, in preview coordinates
+ * @width:          width of the area
+ * @height:         height of the area
+ *
+ * Creates the part of a @preview_width x @preview_height preview of
+ * @image that lies within the given area, sampled from the same
+ * projection pyramid level as the full preview. This allows a view
+ * to redraw only the part of its preview that has changed.
+ *
+ * Return value: a new #GimpTempBuf of @width x @height pixels.
+ **/
+GimpTempBuf *
+gimp_image_get_new_sub_preview (GimpImage *image,
+                                gint       preview_width,
+                                gint       preview_height,
+                                gint       x,
+                                gint       y,
+                                gint       width,
+                                gint       height)
+{
+  GimpProjection *projection;
   const Babl     *format;
   GimpTempBuf    *buf;
   TileManager    *tiles;
   gdouble         scale_x;
   gdouble         scale_y;
   gint            level;
+  gint            level_width;
+  gint            level_height;
+  gint            x1, y1, x2, y2;
   gboolean        is_premult;
 
-  scale_x = (gdouble) width  / (gdouble) gimp_image_get_width  (image);
-  scale_y = (gdouble) height / (gdouble) gimp_image_get_height (image);
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), NULL);
+  g_return_val_if_fail (preview_width > 0 && preview_height > 0, NULL);
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+  g_return_val_if_fail (x >= 0 && x + width  <= preview_width,  NULL);
+  g_return_val_if_fail (y >= 0 && y + height <= preview_height, NULL);
+
+  projection = gimp_image_get_projection (image);
+
+  scale_x = (gdouble) preview_width  / (gdouble) gimp_image_get_width  (image);
+  scale_y = (gdouble) preview_height / (gdouble) gimp_image_get_height (image);
 
   level = gimp_projection_get_level (projection, scale_x, scale_y);
   tiles = gimp_projection_get_tiles_at_level (projection, level, &is_premult);
@@ -151,7 +195,30 @@ gimp_image_get_new_preview (GimpViewable *viewable,
                              GIMP_PRECISION_U8,
                              babl_format_has_alpha (format));
 
-  buf = tile_manager_get_preview (tiles, format, width, height);
+  level_width  = tile_manager_width  (tiles);
+  level_height = tile_manager_height (tiles);
+
+  if (x == 0 && y == 0 && width == preview_width && height == preview_height)
+    {
+      buf = tile_manager_get_preview (tiles, format, width, height);
+    }
+  else
+    {
+      /*  map the area to the pyramid level, rounding outwards  */
+      x1 = floor ((gdouble) x * level_width / preview_width);
+      y1 = floor ((gdouble) y * level_height / preview_height);
+      x2 = ceil ((gdouble) (x + width)  * level_width  / preview_width);
+      y2 = ceil ((gdouble) (y + height) * level_height / preview_height);
+
+      x1 = CLAMP (x1, 0, level_width  - 1);
+      y1 = CLAMP (y1, 0, level_height - 1);
+      x2 = CLAMP (x2, x1 + 1, level_width);
+      y2 = CLAMP (y2, y1 + 1, level_height);
+
+      buf = tile_manager_get_sub_preview (tiles, format,
+                                          x1, y1, x2 - x1, y2 - y1,
+                                          width, height);
+    }
 
   if (is_premult)
     {
@@ -45,4 +45,13 @@ GimpTempBuf * gimp_image_get_new_preview  (GimpViewable *viewable,
                                            gint          height);
 
 
+GimpTempBuf * gimp_image_get_new_sub_preview (GimpImage *image,
+                                              gint       preview_width,
+                                              gint       preview_height,
+                                              gint       x,
+                                              gint       y,
+                                              gint       width,
+                                              gint       height);
+
+
 #endif /* __GIMP_IMAGE_PREVIEW_H__ */
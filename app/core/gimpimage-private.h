@@ -69,6 +69,8 @@ struct _GimpImagePrivate
   GeglNode          *graph;                 /*  GEGL projection graph        */
 
   GList             *guides;                /*  guides                       */
+  GArray            *hguide_positions;      /*  sorted, NULL when outdated   */
+  GArray            *vguide_positions;      /*  sorted, NULL when outdated   */
   GimpGrid          *grid;                  /*  grid                         */
   GList             *sample_points;         /*  color sample points          */
 
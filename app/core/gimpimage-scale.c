@@ -19,9 +19,15 @@
 
 #include <gegl.h>
 
+#include "libgimpmath/gimpmath.h"
+
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-utils.h"
+
 #include "gimp.h"
+#include "gimp-parallel.h"
+#include "gimpchannel.h"
 #include "gimpcontainer.h"
 #include "gimpguide.h"
 #include "gimpimage.h"
@@ -32,6 +38,7 @@
 #include "gimpimage-undo.h"
 #include "gimpimage-undo-push.h"
 #include "gimplayer.h"
+#include "gimplayermask.h"
 #include "gimpprogress.h"
 #include "gimpprojection.h"
 #include "gimpsamplepoint.h"
@@ -41,6 +48,72 @@
 #include "gimp-intl.h"
 
 
+/*  With more than one thread, the pixels of all layers and channels are
+ *  scaled up front with gimp_parallel_distribute(), each job from the
+ *  drawable's buffer into a buffer of its own. The jobs only read the
+ *  drawables, and gimp_image_scale() installs the scaled buffers after
+ *  all of them are done, walking the items in their usual order. The
+ *  undo steps and all signal emission stay on the calling thread.
+ */
+
+typedef struct _ScaleScan ScaleScan;
+typedef struct _ScaleJob  ScaleJob;
+
+#ifdef ENABLE_MP
+struct _ScaleScan
+{
+  GimpInterpolationType  interpolation_type;
+
+  GPtrArray             *jobs;
+  GHashTable            *drawables;   /*  GimpDrawable -> ScaleJob  */
+  gint64                 total_pixels;
+
+  /*  only the calling thread updates the progress  */
+  GimpProgress          *progress;
+  GThread               *thread;
+
+  GMutex                 mutex;
+  gint64                 done_pixels; /*  protected by mutex  */
+};
+
+struct _ScaleJob
+{
+  GimpDrawable          *drawable;
+  GeglBuffer            *src_buffer;
+  GeglBuffer            *dest_buffer;
+  gint64                 n_pixels;
+};
+#endif
+
+
+/*  local function prototypes  */
+
+static ScaleScan * gimp_image_scale_scan_new     (GList                 *all_layers,
+                                                  GList                 *all_channels,
+                                                  GimpChannel           *mask,
+                                                  gint                   new_width,
+                                                  gint                   new_height,
+                                                  gdouble                img_scale_w,
+                                                  gdouble                img_scale_h,
+                                                  GimpInterpolationType  interpolation_type,
+                                                  GimpProgress          *progress);
+static void        gimp_image_scale_scan_install (ScaleScan             *scan,
+                                                  GimpItem              *item);
+static void        gimp_image_scale_scan_free    (ScaleScan             *scan);
+
+#ifdef ENABLE_MP
+static void        gimp_image_scale_scan_add     (ScaleScan             *scan,
+                                                  GimpDrawable          *drawable,
+                                                  gint                   new_width,
+                                                  gint                   new_height);
+static void        gimp_image_scale_job_func     (gint                   i,
+                                                  gint                   n,
+                                                  ScaleScan             *scan);
+#endif
+
+
+/*  public functions  */
+
 void
 gimp_image_scale (GimpImage             *image,
                   gint                   new_width,
@@ -61,6 +134,7 @@ gimp_image_scale (GimpImage             *image,
   gdouble       img_scale_h      = 1.0;
   gint          progress_steps;
   gint          progress_current = 0;
+  ScaleScan    *scan;
 
   g_return_if_fail (GIMP_IS_IMAGE (image));
   g_return_if_fail (new_width > 0 && new_height > 0);
@@ -92,6 +166,13 @@ gimp_image_scale (GimpImage             *image,
   offset_x = (old_width  - new_width)  / 2;
   offset_y = (old_height - new_height) / 2;
 
+  /*  Scale the pixels of all drawables up front, on all threads  */
+  scan = gimp_image_scale_scan_new (all_layers, all_channels,
+                                    gimp_image_get_mask (image),
+                                    new_width, new_height,
+                                    img_scale_w, img_scale_h,
+                                    interpolation_type, progress);
+
   /*  Push the image size to the stack  */
   gimp_image_undo_push_image_size (image,
                                    NULL,
@@ -117,9 +198,11 @@ gimp_image_scale (GimpImage             *image,
       gimp_sub_progress_set_step (GIMP_SUB_PROGRESS (sub_progress),
                                   progress_current++, progress_steps);
 
+      gimp_image_scale_scan_install (scan, item);
+
       gimp_item_scale (item,
                        new_width, new_height, 0, 0,
-                       interpolation_type, sub_progress);
+                       interpolation_type, scan ? NULL : sub_progress);
     }
 
   /*  Scale all vectors  */
@@ -139,9 +222,12 @@ gimp_image_scale (GimpImage             *image,
   gimp_sub_progress_set_step (GIMP_SUB_PROGRESS (sub_progress),
                               progress_current++, progress_steps);
 
+  gimp_image_scale_scan_install (scan,
+                                 GIMP_ITEM (gimp_image_get_mask (image)));
+
   gimp_item_scale (GIMP_ITEM (gimp_image_get_mask (image)),
                    new_width, new_height, 0, 0,
-                   interpolation_type, sub_progress);
+                   interpolation_type, scan ? NULL : sub_progress);
 
   /*  Scale all layers  */
   for (list = all_layers; list; list = g_list_next (list))
@@ -155,9 +241,12 @@ gimp_image_scale (GimpImage             *image,
       if (gimp_viewable_get_children (GIMP_VIEWABLE (item)))
         continue;
 
+      gimp_image_scale_scan_install (scan, item);
+
       if (! gimp_item_scale_by_factors (item,
                                         img_scale_w, img_scale_h,
-                                        interpolation_type, sub_progress))
+                                        interpolation_type,
+                                        scan ? NULL : sub_progress))
         {
           /* Since 0 < img_scale_w, img_scale_h, failure due to one or more
            * vanishing scaled layer dimensions. Implicit delete implemented
@@ -208,6 +297,8 @@ gimp_image_scale (GimpImage             *image,
                                     TRUE);
     }
 
+  gimp_image_scale_scan_free (scan);
+
   gimp_image_undo_group_end (image);
 
   g_list_free (all_layers);
@@ -356,3 +447,253 @@ gimp_image_scale_check (const GimpImage *image,
 
   return GIMP_IMAGE_SCALE_OK;
 }
+
+
+/*  private functions  */
+
+static ScaleScan *
+gimp_image_scale_scan_new (GList                 *all_layers,
+                           GList                 *all_channels,
+                           GimpChannel           *mask,
+                           gint                   new_width,
+                           gint                   new_height,
+                           gdouble                img_scale_w,
+                           gdouble                img_scale_h,
+                           GimpInterpolationType  interpolation_type,
+                           GimpProgress          *progress)
+{
+#ifdef ENABLE_MP
+  ScaleScan *scan;
+  GList     *list;
+
+  if (gimp_parallel_get_n_threads () < 2)
+    return NULL;
+
+  scan = g_slice_new0 (ScaleScan);
+
+  scan->interpolation_type = interpolation_type;
+  scan->jobs               = g_ptr_array_new ();
+  scan->drawables          = g_hash_table_new (NULL, NULL);
+  scan->progress           = progress;
+  scan->thread             = g_thread_self ();
+
+  g_mutex_init (&scan->mutex);
+
+  for (list = all_channels; list; list = g_list_next (list))
+    gimp_image_scale_scan_add (scan, list->data, new_width, new_height);
+
+  gimp_image_scale_scan_add (scan, GIMP_DRAWABLE (mask),
+                             new_width, new_height);
+
+  for (list = all_layers; list; list = g_list_next (list))
+    {
+      GimpItem  *item = list->data;
+      GimpLayer *layer;
+      gint       width;
+      gint       height;
+
+      if (gimp_viewable_get_children (GIMP_VIEWABLE (item)))
+        continue;
+
+      /*  same as gimp_item_scale_by_factors()  */
+      width  = ROUND (img_scale_w * (gdouble) gimp_item_get_width  (item));
+      height = ROUND (img_scale_h * (gdouble) gimp_item_get_height (item));
+
+      if (width == 0 || height == 0)
+        continue;
+
+      layer = GIMP_LAYER (item);
+
+      gimp_image_scale_scan_add (scan, GIMP_DRAWABLE (layer), width, height);
+
+      if (gimp_layer_get_mask (layer))
+        gimp_image_scale_scan_add (scan,
+                                   GIMP_DRAWABLE (gimp_layer_get_mask (layer)),
+                                   width, height);
+    }
+
+  if (scan->jobs->len == 0)
+    {
+      gimp_image_scale_scan_free (scan);
+
+      return NULL;
+    }
+
+  gimp_parallel_distribute (scan->jobs->len,
+                            (GimpParallelDistributeFunc) gimp_image_scale_job_func,
+                            scan);
+
+  return scan;
+#else
+  return NULL;
+#endif
+}
+
+static void
+gimp_image_scale_scan_install (ScaleScan *scan,
+                               GimpItem  *item)
+{
+#ifdef ENABLE_MP
+  ScaleJob *job;
+
+  if (! scan)
+    return;
+
+  job = g_hash_table_lookup (scan->drawables, item);
+
+  if (job)
+    gimp_drawable_set_scaled_buffer (job->drawable, job->dest_buffer);
+
+  /*  gimp_layer_scale() scales the layer mask along with the layer  */
+  if (GIMP_IS_LAYER (item) && gimp_layer_get_mask (GIMP_LAYER (item)))
+    {
+      job = g_hash_table_lookup (scan->drawables,
+                                 gimp_layer_get_mask (GIMP_LAYER (item)));
+
+      if (job)
+        gimp_drawable_set_scaled_buffer (job->drawable, job->dest_buffer);
+    }
+#endif
+}
+
+static void
+gimp_image_scale_scan_free (ScaleScan *scan)
+{
+#ifdef ENABLE_MP
+  gint i;
+
+  if (! scan)
+    return;
+
+  for (i = 0; i < scan->jobs->len; i++)
+    {
+      ScaleJob *job = g_ptr_array_index (scan->jobs, i);
+
+      /*  drop buffers that were not used, e.g. for a channel that
+       *  turned out to be empty
+       */
+      gimp_drawable_set_scaled_buffer (job->drawable, NULL);
+
+      g_object_unref (job->src_buffer);
+      g_object_unref (job->dest_buffer);
+
+      g_slice_free (ScaleJob, job);
+    }
+
+  g_ptr_array_free (scan->jobs, TRUE);
+  g_hash_table_unref (scan->drawables);
+
+  g_mutex_clear (&scan->mutex);
+
+  g_slice_free (ScaleScan, scan);
+#endif
+}
+
+#ifdef ENABLE_MP
+static void
+gimp_image_scale_scan_add (ScaleScan    *scan,
+                           GimpDrawable *drawable,
+                           gint          new_width,
+                           gint          new_height)
+{
+  ScaleJob *job;
+
+  /*  gimp_channel_scale() doesn't scale empty channels  */
+  if (GIMP_IS_CHANNEL (drawable)             &&
+      GIMP_CHANNEL (drawable)->bounds_known &&
+      GIMP_CHANNEL (drawable)->empty)
+    return;
+
+  job = g_slice_new0 (ScaleJob);
+
+  job->drawable    = drawable;
+  job->src_buffer  = g_object_ref (gimp_drawable_get_buffer (drawable));
+  job->dest_buffer = gimp_gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                           new_width,
+                                                           new_height),
+                                           gimp_drawable_get_format (drawable));
+  job->n_pixels    = (gint64) new_width * new_height;
+
+  scan->total_pixels += job->n_pixels;
+
+  g_ptr_array_add (scan->jobs, job);
+  g_hash_table_insert (scan->drawables, drawable, job);
+}
+
+static void
+gimp_image_scale_job_func (gint       i,
+                           gint       n,
+                           ScaleScan *scan)
+{
+  ScaleJob      *job = g_ptr_array_index (scan->jobs, i);
+  GeglNode      *gegl;
+  GeglNode      *src_node;
+  GeglNode      *scale;
+  GeglNode      *dest_node;
+  GeglProcessor *processor;
+  const gchar   *filter;
+  gdouble        x_factor;
+  gdouble        y_factor;
+  gdouble        value;
+  gboolean       show_progress;
+
+  filter   = gimp_interpolation_to_gegl_filter (scan->interpolation_type);
+  x_factor = ((gdouble) gegl_buffer_get_width  (job->dest_buffer) /
+              gegl_buffer_get_width  (job->src_buffer));
+  y_factor = ((gdouble) gegl_buffer_get_height (job->dest_buffer) /
+              gegl_buffer_get_height (job->src_buffer));
+
+  show_progress = (scan->progress && g_thread_self () == scan->thread);
+
+  gegl = gegl_node_new ();
+
+  src_node = gegl_node_new_child (gegl,
+                                  "operation", "gegl:buffer-source",
+                                  "buffer",    job->src_buffer,
+                                  NULL);
+
+  /*  same as gimp_drawable_scale()  */
+  scale = gegl_node_new_child (gegl,
+                               "operation",  "gegl:scale",
+                               "origin-x",   0.0,
+                               "origin-y",   0.0,
+                               "filter",     filter,
+                               "hard-edges", TRUE,
+                               "x",          x_factor,
+                               "y",          y_factor,
+                               NULL);
+
+  dest_node = gegl_node_new_child (gegl,
+                                   "operation", "gegl:write-buffer",
+                                   "buffer",    job->dest_buffer,
+                                   NULL);
+
+  gegl_node_link_many (src_node, scale, dest_node, NULL);
+
+  processor = gegl_node_new_processor (dest_node,
+                                       gegl_buffer_get_extent (job->dest_buffer));
+
+  while (gegl_processor_work (processor, &value))
+    {
+      if (show_progress)
+        {
+          gint64 done_pixels;
+
+          g_mutex_lock (&scan->mutex);
+          done_pixels = scan->done_pixels;
+          g_mutex_unlock (&scan->mutex);
+
+          gimp_progress_set_value (scan->progress,
+                                   (done_pixels + value * job->n_pixels) /
+                                   scan->total_pixels);
+        }
+    }
+
+  g_object_unref (processor);
+  g_object_unref (gegl);
+
+  g_mutex_lock (&scan->mutex);
+  scan->done_pixels += job->n_pixels;
+  g_mutex_unlock (&scan->mutex);
+}
+#endif
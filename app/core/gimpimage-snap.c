@@ -36,11 +36,42 @@
 #include "gimp-intl.h"
 
 
-static gboolean  gimp_image_snap_distance (const gdouble  unsnapped,
-                                           const gdouble  nearest,
-                                           const gdouble  epsilon,
-                                           gdouble       *mindist,
-                                           gdouble       *target);
+/*  the strokes' cached bounds come from an interpolation with this
+ *  precision, while the nearest point searches work on the curves
+ *  themselves, so allow for the difference
+ */
+#define SNAP_BOUNDS_MARGIN 1.0
+
+
+static gboolean  gimp_image_snap_distance    (const gdouble        unsnapped,
+                                              const gdouble        nearest,
+                                              const gdouble        epsilon,
+                                              gdouble             *mindist,
+                                              gdouble             *target);
+static gboolean  gimp_image_snap_guides      (GimpImage           *image,
+                                              GimpOrientationType  orientation,
+                                              const gdouble        unsnapped,
+                                              const gdouble        epsilon,
+                                              gdouble             *mindist,
+                                              gdouble             *target);
+static gboolean  gimp_image_snap_bounds_near (gboolean             have_bounds,
+                                              gdouble              bounds_x1,
+                                              gdouble              bounds_y1,
+                                              gdouble              bounds_x2,
+                                              gdouble              bounds_y2,
+                                              gdouble              x1,
+                                              gdouble              y1,
+                                              gdouble              x2,
+                                              gdouble              y2,
+                                              gdouble              epsilon_x,
+                                              gdouble              epsilon_y);
+static gboolean  gimp_image_snap_stroke_near (GimpStroke          *stroke,
+                                              gdouble              x1,
+                                              gdouble              y1,
+                                              gdouble              x2,
+                                              gdouble              y2,
+                                              gdouble              epsilon_x,
+                                              gdouble              epsilon_y);
 
 
 
@@ -74,23 +105,9 @@ gimp_image_snap_x (GimpImage *image,
 
   if (snap_to_guides)
     {
-      GList *list;
-
-      for (list = gimp_image_get_guides (image); list; list = g_list_next (list))
-        {
-          GimpGuide *guide    = list->data;
-          gint       position = gimp_guide_get_position (guide);
-
-          if (position < 0)
-            continue;
-
-          if (gimp_guide_get_orientation (guide) == GIMP_ORIENTATION_VERTICAL)
-            {
-              snapped |= gimp_image_snap_distance (x, position,
-                                                   epsilon_x,
-                                                   &mindist, tx);
-            }
-        }
+      snapped |= gimp_image_snap_guides (image, GIMP_ORIENTATION_VERTICAL,
+                                         x, epsilon_x,
+                                         &mindist, tx);
     }
 
   if (snap_to_grid)
@@ -161,23 +178,9 @@ gimp_image_snap_y (GimpImage *image,
 
   if (snap_to_guides)
     {
-      GList *list;
-
-      for (list = gimp_image_get_guides (image); list; list = g_list_next (list))
-        {
-          GimpGuide *guide    = list->data;
-          gint       position = gimp_guide_get_position (guide);
-
-          if (position < 0)
-            continue;
-
-          if (gimp_guide_get_orientation (guide) == GIMP_ORIENTATION_HORIZONTAL)
-            {
-              snapped |= gimp_image_snap_distance (y, position,
-                                                   epsilon_y,
-                                                   &mindist, ty);
-            }
-        }
+      snapped |= gimp_image_snap_guides (image, GIMP_ORIENTATION_HORIZONTAL,
+                                         y, epsilon_y,
+                                         &mindist, ty);
     }
 
   if (snap_to_grid)
@@ -258,34 +261,12 @@ gimp_image_snap_point (GimpImage *image,
 
   if (snap_to_guides)
     {
-      GList *list;
-
-      for (list = gimp_image_get_guides (image); list; list = g_list_next (list))
-        {
-          GimpGuide *guide    = list->data;
-          gint       position = gimp_guide_get_position (guide);
-
-          if (position < 0)
-            continue;
-
-          switch (gimp_guide_get_orientation (guide))
-            {
-            case GIMP_ORIENTATION_HORIZONTAL:
-              snapped |= gimp_image_snap_distance (y, position,
-                                                   epsilon_y,
-                                                   &mindist_y, ty);
-              break;
-
-            case GIMP_ORIENTATION_VERTICAL:
-              snapped |= gimp_image_snap_distance (x, position,
-                                                   epsilon_x,
-                                                   &mindist_x, tx);
-              break;
-
-            default:
-              break;
-            }
-        }
+      snapped |= gimp_image_snap_guides (image, GIMP_ORIENTATION_HORIZONTAL,
+                                         y, epsilon_y,
+                                         &mindist_y, ty);
+      snapped |= gimp_image_snap_guides (image, GIMP_ORIENTATION_VERTICAL,
+                                         x, epsilon_x,
+                                         &mindist_x, tx);
     }
 
   if (snap_to_grid)
@@ -352,13 +333,26 @@ gimp_image_snap_point (GimpImage *image,
       GimpStroke  *stroke  = NULL;
       GimpCoords   coords  = { 0, 0, 0, 0, 0 };
 
+      gdouble      bx1, by1, bx2, by2;
+      gboolean     have_bounds;
+
       coords.x = x;
       coords.y = y;
 
+      have_bounds = gimp_vectors_bounds (vectors, &bx1, &by1, &bx2, &by2);
+
+      if (! gimp_image_snap_bounds_near (have_bounds, bx1, by1, bx2, by2,
+                                         x, y, x, y, epsilon_x, epsilon_y))
+        return snapped;
+
       while ((stroke = gimp_vectors_stroke_get_next (vectors, stroke)))
         {
           GimpCoords nearest;
 
+          if (! gimp_image_snap_stroke_near (stroke, x, y, x, y,
+                                             epsilon_x, epsilon_y))
+            continue;
+
           if (gimp_stroke_nearest_point_get (stroke, &coords, 1.0,
                                              &nearest,
                                              NULL, NULL, NULL) >= 0)
@@ -490,12 +484,24 @@ gimp_image_snap_rectangle (GimpImage *image,
       GimpStroke  *stroke  = NULL;
       GimpCoords   coords1 = GIMP_COORDS_DEFAULT_VALUES;
       GimpCoords   coords2 = GIMP_COORDS_DEFAULT_VALUES;
+      gdouble      bx1, by1, bx2, by2;
+      gboolean     have_bounds;
+
+      have_bounds = gimp_vectors_bounds (vectors, &bx1, &by1, &bx2, &by2);
+
+      if (! gimp_image_snap_bounds_near (have_bounds, bx1, by1, bx2, by2,
+                                         x1, y1, x2, y2, epsilon_x, epsilon_y))
+        return snapped;
 
       while ((stroke = gimp_vectors_stroke_get_next (vectors, stroke)))
         {
           GimpCoords nearest;
           gdouble    dist;
 
+          if (! gimp_image_snap_stroke_near (stroke, x1, y1, x2, y2,
+                                             epsilon_x, epsilon_y))
+            continue;
+
           /*  top edge  */
 
           coords1.x = x1;
@@ -701,3 +707,119 @@ gimp_image_snap_distance (const gdouble  unsnapped,
 
   return FALSE;
 }
+
+/**
+ * gimp_image_snap_guides:
+ * @image:       a #GimpImage
+ * @orientation: the orientation of the guides to snap to
+ * @unsnapped:   One coordinate of the unsnapped position
+ * @epsilon:     The snapping threshold
+ * @mindist:     The distance to the currently closest snapping target
+ * @target:      The currently closest snapping target
+ *
+ * Like gimp_image_snap_distance() for all guides with @orientation,
+ * but only looks at the guides within @epsilon, found by a binary
+ * search in the image's sorted guide positions.
+ *
+ * Return value: %TRUE if snapping occured, %FALSE otherwise
+ */
+static gboolean
+gimp_image_snap_guides (GimpImage           *image,
+                        GimpOrientationType  orientation,
+                        const gdouble        unsnapped,
+                        const gdouble        epsilon,
+                        gdouble             *mindist,
+                        gdouble             *target)
+{
+  const gint *positions;
+  gint        n_positions;
+  gint        lo, hi;
+  gboolean    snapped = FALSE;
+
+  positions = gimp_image_get_guide_positions (image, orientation,
+                                              &n_positions);
+
+  /*  find the first guide that is not below unsnapped - epsilon  */
+  lo = 0;
+  hi = n_positions;
+
+  while (lo < hi)
+    {
+      gint mid = (lo + hi) / 2;
+
+      if (positions[mid] <= unsnapped - epsilon)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  for (; lo < n_positions && positions[lo] < unsnapped + epsilon; lo++)
+    {
+      snapped |= gimp_image_snap_distance (unsnapped, positions[lo],
+                                           epsilon,
+                                           mindist, target);
+    }
+
+  return snapped;
+}
+
+/**
+ * gimp_image_snap_bounds_near:
+ *
+ * Any point of a path that makes the rectangle (or point) given by
+ * @x1, @y1, @x2 and @y2 snap lies closer than @epsilon_x to one of
+ * its vertical edges, or closer than @epsilon_y to one of its
+ * horizontal edges. Returns %FALSE if no point within the bounds
+ * can do that, so the expensive nearest point searches can be
+ * skipped.
+ */
+static gboolean
+gimp_image_snap_bounds_near (gboolean  have_bounds,
+                             gdouble   bounds_x1,
+                             gdouble   bounds_y1,
+                             gdouble   bounds_x2,
+                             gdouble   bounds_y2,
+                             gdouble   x1,
+                             gdouble   y1,
+                             gdouble   x2,
+                             gdouble   y2,
+                             gdouble   epsilon_x,
+                             gdouble   epsilon_y)
+{
+  gdouble ex = epsilon_x + SNAP_BOUNDS_MARGIN;
+  gdouble ey = epsilon_y + SNAP_BOUNDS_MARGIN;
+
+  /*  no usable bounds, don't skip anything  */
+  if (! have_bounds)
+    return TRUE;
+
+#define NEAR(v, min, max, e) ((v) > (min) - (e) && (v) < (max) + (e))
+
+  return (NEAR (x1, bounds_x1, bounds_x2, ex) ||
+          NEAR (x2, bounds_x1, bounds_x2, ex) ||
+          NEAR (y1, bounds_y1, bounds_y2, ey) ||
+          NEAR (y2, bounds_y1, bounds_y2, ey));
+
+#undef NEAR
+}
+
+static gboolean
+gimp_image_snap_stroke_near (GimpStroke *stroke,
+                             gdouble     x1,
+                             gdouble     y1,
+                             gdouble     x2,
+                             gdouble     y2,
+                             gdouble     epsilon_x,
+                             gdouble     epsilon_y)
+{
+  gdouble  bx1, by1, bx2, by2;
+  gboolean have_bounds;
+
+  /*  the bounds are cached with the stroke's interpolation and only
+   *  recomputed after its anchors changed
+   */
+  have_bounds = gimp_stroke_get_bounds (stroke, 1.0, &bx1, &by1, &bx2, &by2);
+
+  return gimp_image_snap_bounds_near (have_bounds, bx1, by1, bx2, by2,
+                                      x1, y1, x2, y2, epsilon_x, epsilon_y);
+}
@@ -21,8 +21,12 @@
 
 #include "core-types.h"
 
+#include "base/tile-manager.h"
+
 #include "config/gimpcoreconfig.h"
 
+#include "gegl/gimp-gegl-utils.h"
+
 #include "gimp.h"
 #include "gimp-utils.h"
 #include "gimpdrawableundo.h"
@@ -31,6 +35,7 @@
 #include "gimpimage-undo.h"
 #include "gimpitem.h"
 #include "gimplist.h"
+#include "gimpmaskundo.h"
 #include "gimpundostack.h"
 
 
@@ -43,6 +48,12 @@ static void          gimp_image_undo_pop_stack       (GimpImage     *image,
 static void          gimp_image_undo_free_space      (GimpImage     *image);
 static void          gimp_image_undo_free_redo       (GimpImage     *image);
 
+static gint64        gimp_image_undo_get_spilled_size (GimpContainer *container);
+static gboolean      gimp_image_undo_spill_oldest    (GimpContainer *container);
+static void          gimp_image_undo_foreach_tiles   (GimpUndo      *undo,
+                                                      GFunc          func,
+                                                      gpointer       data);
+
 static GimpDirtyMask gimp_image_undo_dirty_from_type (GimpUndoType   undo_type);
 
 
@@ -541,12 +552,14 @@ gimp_image_undo_free_space (GimpImage *image)
   gint              min_undo_levels;
   gint              max_undo_levels;
   gint64            undo_size;
+  gint64            undo_swap_size;
 
   container = private->undo_stack->undos;
 
   min_undo_levels = image->gimp->config->levels_of_undo;
   max_undo_levels = 1024; /* FIXME */
   undo_size       = image->gimp->config->undo_size;
+  undo_swap_size  = image->gimp->config->undo_swap_size;
 
 #ifdef DEBUG_IMAGE_UNDO
   g_printerr ("undo_steps: %d    undo_bytes: %ld\n",
@@ -558,11 +571,42 @@ gimp_image_undo_free_space (GimpImage *image)
   if (gimp_container_get_n_children (container) <= min_undo_levels)
     return;
 
-  while ((gimp_object_get_memsize (GIMP_OBJECT (container), NULL) > undo_size) ||
-         (gimp_container_get_n_children (container) > max_undo_levels))
+  while (TRUE)
     {
-      GimpUndo *freed = gimp_undo_stack_free_bottom (private->undo_stack,
-                                                     GIMP_UNDO_MODE_UNDO);
+      GimpUndo *freed;
+      gint64    memsize;
+      gint64    spilled = 0;
+
+      memsize = gimp_object_get_memsize (GIMP_OBJECT (container), NULL);
+
+      if (undo_swap_size > 0)
+        spilled = gimp_image_undo_get_spilled_size (container);
+
+      if (gimp_container_get_n_children (container) <= max_undo_levels)
+        {
+          if (memsize - spilled <= undo_size && spilled <= undo_swap_size)
+            return;
+
+          /*  rather push the pixels of old steps out of memory than
+           *  lose the steps, as long as the swapped out undo data
+           *  stays within undo-swap-size
+           */
+          if (memsize - spilled > undo_size &&
+              spilled < undo_swap_size  &&
+              gimp_image_undo_spill_oldest (container))
+            {
+#ifdef DEBUG_IMAGE_UNDO
+              g_printerr ("spilled one step: undo_bytes: %ld    "
+                          "spilled_bytes: %ld\n",
+                          (glong) memsize,
+                          (glong) gimp_image_undo_get_spilled_size (container));
+#endif
+              continue;
+            }
+        }
+
+      freed = gimp_undo_stack_free_bottom (private->undo_stack,
+                                           GIMP_UNDO_MODE_UNDO);
 
 #ifdef DEBUG_IMAGE_UNDO
       g_printerr ("freed one step: undo_steps: %d    undo_bytes: %ld\n",
@@ -626,6 +670,105 @@ gimp_image_undo_free_redo (GimpImage *image)
     }
 }
 
+static void
+gimp_image_undo_add_spilled_size (TileManager *tiles,
+                                  gint64      *spilled)
+{
+  *spilled += (tile_manager_get_shared_memsize (tiles) -
+               tile_manager_get_resident_memsize (tiles));
+}
+
+/*  returns how much of the undo steps' pixel data is currently not
+ *  in memory, but compressed or in the swap file
+ */
+static gint64
+gimp_image_undo_get_spilled_size (GimpContainer *container)
+{
+  GList  *list;
+  gint64  spilled = 0;
+
+  for (list = GIMP_LIST (container)->list; list; list = g_list_next (list))
+    gimp_image_undo_foreach_tiles (list->data,
+                                   (GFunc) gimp_image_undo_add_spilled_size,
+                                   &spilled);
+
+  return spilled;
+}
+
+static void
+gimp_image_undo_evict_tiles (TileManager *tiles,
+                             gint64      *freed)
+{
+  *freed += tile_manager_evict (tiles);
+}
+
+/*  pushes the pixel data of the oldest undo step that still has some
+ *  in memory out to the compressed tier and the swap file, it is
+ *  brought back transparently when the step is undone. The most recent
+ *  step is left alone. Returns FALSE if there was nothing to spill.
+ */
+static gboolean
+gimp_image_undo_spill_oldest (GimpContainer *container)
+{
+  GList *list = GIMP_LIST (container)->list;
+  GList *last;
+
+  for (last = g_list_last (list);
+       last && last != list;
+       last = g_list_previous (last))
+    {
+      gint64 freed = 0;
+
+      gimp_image_undo_foreach_tiles (last->data,
+                                     (GFunc) gimp_image_undo_evict_tiles,
+                                     &freed);
+
+      if (freed > 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*  calls @func on the tile managers behind the pixel buffers kept by
+ *  @undo, or by the undo steps of an undo group
+ */
+static void
+gimp_image_undo_foreach_tiles (GimpUndo *undo,
+                               GFunc     func,
+                               gpointer  data)
+{
+  GeglBuffer *buffer = NULL;
+
+  if (GIMP_IS_UNDO_STACK (undo))
+    {
+      GList *list;
+
+      for (list = GIMP_LIST (GIMP_UNDO_STACK (undo)->undos)->list;
+           list;
+           list = g_list_next (list))
+        {
+          gimp_image_undo_foreach_tiles (list->data, func, data);
+        }
+    }
+  else if (GIMP_IS_DRAWABLE_UNDO (undo))
+    {
+      buffer = GIMP_DRAWABLE_UNDO (undo)->buffer;
+    }
+  else if (GIMP_IS_MASK_UNDO (undo))
+    {
+      buffer = GIMP_MASK_UNDO (undo)->buffer;
+    }
+
+  if (buffer)
+    {
+      TileManager *tiles = gimp_gegl_buffer_peek_tiles (buffer);
+
+      if (tiles)
+        func (tiles, data);
+    }
+}
+
 static GimpDirtyMask
 gimp_image_undo_dirty_from_type (GimpUndoType undo_type)
 {
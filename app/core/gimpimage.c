@@ -961,10 +961,29 @@ gimp_image_finalize (GObject *object)
 
   if (private->guides)
     {
+      GList *list;
+
+      for (list = private->guides; list; list = g_list_next (list))
+        g_signal_handlers_disconnect_matched (list->data,
+                                              G_SIGNAL_MATCH_DATA,
+                                              0, 0, NULL, NULL, image);
+
       g_list_free_full (private->guides, (GDestroyNotify) g_object_unref);
       private->guides = NULL;
     }
 
+  if (private->hguide_positions)
+    {
+      g_array_free (private->hguide_positions, TRUE);
+      private->hguide_positions = NULL;
+    }
+
+  if (private->vguide_positions)
+    {
+      g_array_free (private->vguide_positions, TRUE);
+      private->vguide_positions = NULL;
+    }
+
   if (private->grid)
     {
       g_object_unref (private->grid);
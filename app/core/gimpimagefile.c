@@ -34,10 +34,13 @@
 
 #include "config/gimpcoreconfig.h"
 
+#include "base/tile-manager.h"
+
 #include "gegl/gimp-babl.h"
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-parallel.h"
 #include "gimpcontainer.h"
 #include "gimpcontext.h"
 #include "gimpimage.h"
@@ -45,6 +48,8 @@
 #include "gimpmarshal.h"
 #include "gimppickable.h"
 #include "gimpprogress.h"
+#include "gimpprojectable.h"
+#include "gimpprojection.h"
 
 #include "file/file-open.h"
 #include "file/file-utils.h"
@@ -78,6 +83,43 @@ struct _GimpImagefilePrivate
                                                             GimpImagefilePrivate)
 
 
+/*  the most thumbnails waiting in the queue, the ones that were
+ *  requested first with the lowest priority are dropped
+ */
+#define MAX_QUEUED_THUMBNAILS 64
+
+typedef struct _GimpThumbnailJob GimpThumbnailJob;
+
+struct _GimpThumbnailJob
+{
+  Gimp     *gimp;
+  gchar    *uri;
+  GSList   *imagefiles;  /*  weak references  */
+  gint      size;
+  gboolean  replace;
+  gint      priority;
+};
+
+typedef struct _GimpThumbnailSaveJob GimpThumbnailSaveJob;
+
+struct _GimpThumbnailSaveJob
+{
+  GimpImagefile *imagefile;
+  GimpThumbnail *thumbnail;  /*  a copy only the worker thread uses  */
+  gint           size;
+
+  guchar        *pixels;     /*  snapshot of a projection pyramid level  */
+  const Babl    *format;
+  gint           level_width;
+  gint           level_height;
+  gint           width;
+  gint           height;
+
+  gboolean       success;
+  GError        *error;
+};
+
+
 static void        gimp_imagefile_dispose          (GObject        *object);
 static void        gimp_imagefile_finalize         (GObject        *object);
 
@@ -99,6 +141,16 @@ static gboolean    gimp_imagefile_save_thumb       (GimpImagefile  *imagefile,
                                                     gint            size,
                                                     gboolean        replace,
                                                     GError        **error);
+static void        gimp_imagefile_get_thumb_size   (GimpImage      *image,
+                                                    gint           *size,
+                                                    gint           *width,
+                                                    gint           *height);
+static void        gimp_imagefile_save_thumb_start (GimpThumbnailSaveJob *job);
+static void        gimp_imagefile_save_thumb_func  (GimpParallelTask     *task,
+                                                    GimpThumbnailSaveJob *job);
+static void        gimp_imagefile_save_thumb_done  (GimpParallelTask     *task,
+                                                    gboolean              canceled,
+                                                    GimpThumbnailSaveJob *job);
 
 static gchar     * gimp_imagefile_get_description  (GimpViewable   *viewable,
                                                     gchar         **tooltip);
@@ -107,6 +159,9 @@ static void        gimp_imagefile_icon_callback    (GObject        *source_objec
                                                     GAsyncResult   *result,
                                                     gpointer        data);
 
+static void     gimp_imagefile_queue_remove_job    (GimpThumbnailJob *job);
+static gboolean gimp_imagefile_queue_idle          (gpointer        data);
+
 static void     gimp_thumbnail_set_info_from_image (GimpThumbnail  *thumbnail,
                                                     const gchar    *mime_type,
                                                     GimpImage      *image);
@@ -124,6 +179,17 @@ G_DEFINE_TYPE (GimpImagefile, gimp_imagefile, GIMP_TYPE_VIEWABLE)
 
 static guint gimp_imagefile_signals[LAST_SIGNAL] = { 0 };
 
+/*  thumbnails waiting to be created, highest priority first  */
+static GQueue            thumbnail_queue   = G_QUEUE_INIT;
+static GimpThumbnailJob *thumbnail_job     = NULL;
+static guint             thumbnail_idle_id = 0;
+
+/*  thumbnails waiting to be saved, one at a time, so two saves of the
+ *  same thumbnail don't write the same temporary file
+ */
+static GQueue            thumbnail_save_queue   = G_QUEUE_INIT;
+static gboolean          thumbnail_save_running = FALSE;
+
 
 static void
 gimp_imagefile_class_init (GimpImagefileClass *klass)
@@ -180,6 +246,8 @@ gimp_imagefile_dispose (GObject *object)
 {
   GimpImagefilePrivate *private = GET_PRIVATE (object);
 
+  gimp_imagefile_cancel_thumbnail (GIMP_IMAGEFILE (object));
+
   if (private->icon_cancellable)
     {
       g_cancellable_cancel (private->icon_cancellable);
@@ -462,6 +530,139 @@ gimp_imagefile_create_thumbnail_weak (GimpImagefile *imagefile,
   g_object_unref (local);
 }
 
+/*  Queues the creation of the thumbnail, which is done in the
+ *  background, one after the other, highest priority first and most
+ *  recently requested first among equal priorities. Requests for a
+ *  uri that is already queued are merged into the queued one.
+ *
+ *  Thumbnails queued with GIMP_IMAGEFILE_THUMBNAIL_PRIORITY_VISIBLE
+ *  are only created if they are still missing when their turn comes.
+ */
+void
+gimp_imagefile_queue_thumbnail (GimpImagefile *imagefile,
+                                gint           size,
+                                gboolean       replace,
+                                gint           priority)
+{
+  GimpImagefilePrivate *private;
+  GimpThumbnailJob     *job = NULL;
+  const gchar          *uri;
+  GList                *list;
+
+  g_return_if_fail (GIMP_IS_IMAGEFILE (imagefile));
+
+  if (size < 1)
+    return;
+
+  private = GET_PRIVATE (imagefile);
+
+  uri = gimp_object_get_name (imagefile);
+  if (! uri)
+    return;
+
+  for (list = thumbnail_queue.head; list; list = g_list_next (list))
+    {
+      GimpThumbnailJob *queued = list->data;
+
+      if (queued->size == size && strcmp (queued->uri, uri) == 0)
+        {
+          job = queued;
+
+          g_queue_delete_link (&thumbnail_queue, list);
+          break;
+        }
+    }
+
+  if (! job)
+    {
+      job = g_slice_new0 (GimpThumbnailJob);
+
+      job->gimp     = private->gimp;
+      job->uri      = g_strdup (uri);
+      job->size     = size;
+      job->priority = priority;
+    }
+
+  if (! g_slist_find (job->imagefiles, imagefile))
+    {
+      job->imagefiles = g_slist_prepend (job->imagefiles, imagefile);
+
+      g_object_add_weak_pointer (G_OBJECT (imagefile),
+                                 (gpointer) &job->imagefiles->data);
+    }
+
+  job->replace  |= replace;
+  job->priority  = MAX (job->priority, priority);
+
+  for (list = thumbnail_queue.head; list; list = g_list_next (list))
+    {
+      GimpThumbnailJob *queued = list->data;
+
+      if (queued->priority <= job->priority)
+        break;
+    }
+
+  if (list)
+    g_queue_insert_before (&thumbnail_queue, list, job);
+  else
+    g_queue_push_tail (&thumbnail_queue, job);
+
+  while (g_queue_get_length (&thumbnail_queue) > MAX_QUEUED_THUMBNAILS)
+    gimp_imagefile_queue_remove_job (g_queue_pop_tail (&thumbnail_queue));
+
+  if (! thumbnail_idle_id && ! thumbnail_job)
+    thumbnail_idle_id = g_idle_add_full (G_PRIORITY_LOW,
+                                         gimp_imagefile_queue_idle,
+                                         NULL, NULL);
+}
+
+/*  Removes the imagefile's queued thumbnails, for example because the
+ *  imagefile isn't shown any longer. A thumbnail that is being created
+ *  is finished, but the imagefile isn't updated.
+ */
+void
+gimp_imagefile_cancel_thumbnail (GimpImagefile *imagefile)
+{
+  GList *list;
+
+  g_return_if_fail (GIMP_IS_IMAGEFILE (imagefile));
+
+  if (thumbnail_job)
+    {
+      GSList *link = g_slist_find (thumbnail_job->imagefiles, imagefile);
+
+      if (link)
+        {
+          g_object_remove_weak_pointer (G_OBJECT (imagefile),
+                                        (gpointer) &link->data);
+          link->data = NULL;
+        }
+    }
+
+  for (list = thumbnail_queue.head; list; )
+    {
+      GimpThumbnailJob *job  = list->data;
+      GList            *next = g_list_next (list);
+      GSList           *link = g_slist_find (job->imagefiles, imagefile);
+
+      if (link)
+        {
+          g_object_remove_weak_pointer (G_OBJECT (imagefile),
+                                        (gpointer) &link->data);
+
+          job->imagefiles = g_slist_delete_link (job->imagefiles, link);
+
+          if (! job->imagefiles)
+            {
+              g_queue_delete_link (&thumbnail_queue, list);
+              gimp_imagefile_queue_remove_job (job);
+            }
+        }
+
+      list = next;
+    }
+}
+
 gboolean
 gimp_imagefile_check_thumbnail (GimpImagefile *imagefile)
 {
@@ -522,6 +723,129 @@ gimp_imagefile_save_thumbnail (GimpImagefile *imagefile,
   return success;
 }
 
+/**
+ * gimp_imagefile_save_thumbnail_async:
+ * @imagefile: a #GimpImagefile
+ * @mime_type: the MIME type of the saved file
+ * @image:     the image that was saved
+ *
+ * Like gimp_imagefile_save_thumbnail(), but only takes a copy of
+ * the projection's pyramid level closest to the thumbnail size here.
+ * Scaling and writing the thumbnail happens on the core worker pool,
+ * and @imagefile is updated from the main loop when it is done.
+ **/
+void
+gimp_imagefile_save_thumbnail_async (GimpImagefile *imagefile,
+                                     const gchar   *mime_type,
+                                     GimpImage     *image)
+{
+  GimpImagefilePrivate *private;
+  GimpThumbnailSaveJob *job;
+  GimpProjection       *projection;
+  TileManager          *tiles;
+  const Babl           *format;
+  gchar                *uri;
+  gchar                *type;
+  gint64                mtime;
+  gint64                filesize;
+  gint                  num_layers;
+  gint                  size;
+  gint                  width, height;
+  gint                  level;
+  gboolean              is_premult;
+
+  g_return_if_fail (GIMP_IS_IMAGEFILE (imagefile));
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+
+  private = GET_PRIVATE (imagefile);
+
+  size = private->gimp->config->thumbnail_size;
+
+  if (size < 1)
+    return;
+
+  gimp_thumbnail_set_info_from_image (private->thumbnail, mime_type, image);
+
+  gimp_imagefile_get_thumb_size (image, &size, &width, &height);
+
+  projection = gimp_image_get_projection (image);
+
+  /*  we need the projection constructed NOW, not some time later  */
+  gimp_pickable_flush (GIMP_PICKABLE (projection));
+
+  level = gimp_projection_get_level (projection,
+                                     (gdouble) width /
+                                     (gdouble) gimp_image_get_width (image),
+                                     (gdouble) height /
+                                     (gdouble) gimp_image_get_height (image));
+  tiles = gimp_projection_get_tiles_at_level (projection, level, &is_premult);
+
+  format = gimp_projectable_get_format (GIMP_PROJECTABLE (image));
+  format = gimp_babl_format (gimp_babl_format_get_base_type (format),
+                             GIMP_PRECISION_U8,
+                             babl_format_has_alpha (format));
+
+  if (is_premult)
+    {
+      if (format == babl_format ("Y'A u8"))
+        format = babl_format ("Y'aA u8");
+      else if (format == babl_format ("R'G'B'A u8"))
+        format = babl_format ("R'aG'aB'aA u8");
+    }
+
+  job = g_slice_new0 (GimpThumbnailSaveJob);
+
+  job->imagefile    = g_object_ref (imagefile);
+  job->size         = size;
+  job->format       = format;
+  job->level_width  = tile_manager_width  (tiles);
+  job->level_height = tile_manager_height (tiles);
+  job->width        = width;
+  job->height       = height;
+
+  job->pixels = g_malloc (job->level_width * job->level_height *
+                          tile_manager_bpp (tiles));
+
+  tile_manager_read_pixel_data (tiles,
+                                0, 0,
+                                job->level_width  - 1,
+                                job->level_height - 1,
+                                job->pixels,
+                                job->level_width * tile_manager_bpp (tiles));
+
+  /*  the worker gets a thumbnail object of its own, so that nothing
+   *  it does can race with the main thread using private->thumbnail
+   */
+  g_object_get (private->thumbnail,
+                "image-uri",        &uri,
+                "image-mtime",      &mtime,
+                "image-filesize",   &filesize,
+                "image-type",       &type,
+                "image-num-layers", &num_layers,
+                NULL);
+
+  job->thumbnail = gimp_thumbnail_new ();
+
+  g_object_set (job->thumbnail,
+                "image-uri",        uri,
+                "image-mtime",      mtime,
+                "image-filesize",   filesize,
+                "image-mimetype",   mime_type,
+                "image-width",      gimp_image_get_width  (image),
+                "image-height",     gimp_image_get_height (image),
+                "image-type",       type,
+                "image-num-layers", num_layers,
+                NULL);
+
+  g_free (uri);
+  g_free (type);
+
+  if (thumbnail_save_running)
+    g_queue_push_tail (&thumbnail_save_queue, job);
+  else
+    gimp_imagefile_save_thumb_start (job);
+}
+
 
 /*  private functions  */
 
@@ -897,6 +1221,105 @@ gimp_imagefile_load_thumb (GimpImagefile *imagefile,
   return pixbuf;
 }
 
+static void
+gimp_imagefile_queue_remove_job (GimpThumbnailJob *job)
+{
+  GSList *list;
+
+  for (list = job->imagefiles; list; list = g_slist_next (list))
+    {
+      if (list->data)
+        g_object_remove_weak_pointer (list->data, (gpointer) &list->data);
+    }
+
+  g_slist_free (job->imagefiles);
+  g_free (job->uri);
+
+  g_slice_free (GimpThumbnailJob, job);
+}
+
+static gboolean
+gimp_imagefile_queue_idle (gpointer data)
+{
+  GimpThumbnailJob *job = g_queue_pop_head (&thumbnail_queue);
+  GSList           *list;
+
+  thumbnail_idle_id = 0;
+
+  if (! job)
+    return FALSE;
+
+  for (list = job->imagefiles; list; list = g_slist_next (list))
+    {
+      if (list->data)
+        break;
+    }
+
+  if (list)
+    {
+      GimpImagefile  *local = gimp_imagefile_new (job->gimp, job->uri);
+      GimpThumbnail  *thumbnail;
+      GimpThumbState  state;
+      gboolean        failed;
+
+      /*  creating the thumbnail runs plug-ins, which iterates the main
+       *  loop, don't run this idle again meanwhile
+       */
+      thumbnail_job = job;
+
+      thumbnail = gimp_imagefile_get_thumbnail (local);
+      state     = gimp_thumbnail_peek_thumb (thumbnail, job->size);
+      failed    = gimp_thumbnail_has_failed (thumbnail);
+
+      /*  somebody else might have created a visible item's thumbnail
+       *  meanwhile, the others are explicit requests
+       */
+      if (job->replace                                            ||
+          job->priority > GIMP_IMAGEFILE_THUMBNAIL_PRIORITY_VISIBLE ||
+          state != GIMP_THUMB_STATE_OK)
+        {
+          gimp_imagefile_create_thumbnail (local,
+                                           gimp_get_user_context (job->gimp),
+                                           NULL, job->size, job->replace);
+        }
+
+      /*  only update the imagefiles if something might have happened,
+       *  their views would queue the thumbnail again otherwise
+       */
+      if (job->replace                                             ||
+          gimp_thumbnail_peek_thumb (thumbnail, job->size) != state ||
+          gimp_thumbnail_has_failed (thumbnail)            != failed)
+        {
+          for (list = job->imagefiles; list; list = g_slist_next (list))
+            {
+              GimpImagefile *imagefile = list->data;
+              const gchar   *uri;
+
+              if (! imagefile)
+                continue;
+
+              uri = gimp_object_get_name (imagefile);
+
+              if (uri && strcmp (uri, job->uri) == 0)
+                gimp_imagefile_update (imagefile);
+            }
+        }
+
+      g_object_unref (local);
+
+      thumbnail_job = NULL;
+    }
+
+  gimp_imagefile_queue_remove_job (job);
+
+  if (! g_queue_is_empty (&thumbnail_queue))
+    thumbnail_idle_id = g_idle_add_full (G_PRIORITY_LOW,
+                                         gimp_imagefile_queue_idle,
+                                         NULL, NULL);
+
+  return FALSE;
+}
+
 static gboolean
 gimp_imagefile_save_thumb (GimpImagefile  *imagefile,
                            GimpImage      *image,
@@ -913,29 +1336,7 @@ gimp_imagefile_save_thumb (GimpImagefile  *imagefile,
   if (size < 1)
     return TRUE;
 
-  if (gimp_image_get_width  (image) <= size &&
-      gimp_image_get_height (image) <= size)
-    {
-      width  = gimp_image_get_width  (image);
-      height = gimp_image_get_height (image);
-
-      size = MAX (width, height);
-    }
-  else
-    {
-      if (gimp_image_get_width (image) < gimp_image_get_height (image))
-        {
-          height = size;
-          width  = MAX (1, (size * gimp_image_get_width (image) /
-                            gimp_image_get_height (image)));
-        }
-      else
-        {
-          width  = size;
-          height = MAX (1, (size * gimp_image_get_height (image) /
-                            gimp_image_get_width (image)));
-        }
-    }
+  gimp_imagefile_get_thumb_size (image, &size, &width, &height);
 
   /*  we need the projection constructed NOW, not some time later  */
   gimp_pickable_flush (GIMP_PICKABLE (gimp_image_get_projection (image)));
@@ -969,6 +1370,125 @@ gimp_imagefile_save_thumb (GimpImagefile  *imagefile,
   return success;
 }
 
+static void
+gimp_imagefile_get_thumb_size (GimpImage *image,
+                               gint      *size,
+                               gint      *width,
+                               gint      *height)
+{
+  if (gimp_image_get_width  (image) <= *size &&
+      gimp_image_get_height (image) <= *size)
+    {
+      *width  = gimp_image_get_width  (image);
+      *height = gimp_image_get_height (image);
+
+      *size = MAX (*width, *height);
+    }
+  else
+    {
+      if (gimp_image_get_width (image) < gimp_image_get_height (image))
+        {
+          *height = *size;
+          *width  = MAX (1, (*size * gimp_image_get_width (image) /
+                             gimp_image_get_height (image)));
+        }
+      else
+        {
+          *width  = *size;
+          *height = MAX (1, (*size * gimp_image_get_height (image) /
+                             gimp_image_get_width (image)));
+        }
+    }
+}
+
+static void
+gimp_imagefile_save_thumb_start (GimpThumbnailSaveJob *job)
+{
+  GimpParallelTask *task;
+
+  thumbnail_save_running = TRUE;
+
+  task = gimp_parallel_run_async (GIMP_PARALLEL_PRIORITY_BACKGROUND,
+                                  NULL, NULL,
+                                  (GimpParallelRunFunc) gimp_imagefile_save_thumb_func,
+                                  (GimpParallelDoneFunc) gimp_imagefile_save_thumb_done,
+                                  job);
+  gimp_parallel_task_unref (task);
+}
+
+static void
+gimp_imagefile_save_thumb_func (GimpParallelTask     *task,
+                                GimpThumbnailSaveJob *job)
+{
+  GeglBuffer *buffer;
+  GdkPixbuf  *pixbuf;
+  gboolean    has_alpha = babl_format_has_alpha (job->format);
+
+  buffer = gegl_buffer_linear_new_from_data (job->pixels, job->format,
+                                             GEGL_RECTANGLE (0, 0,
+                                                             job->level_width,
+                                                             job->level_height),
+                                             GEGL_AUTO_ROWSTRIDE,
+                                             NULL, NULL);
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, has_alpha, 8,
+                           job->width, job->height);
+
+  gegl_buffer_get (buffer,
+                   GEGL_RECTANGLE (0, 0, job->width, job->height),
+                   MIN ((gdouble) job->width  / (gdouble) job->level_width,
+                        (gdouble) job->height / (gdouble) job->level_height),
+                   has_alpha ?
+                   babl_format ("R'G'B'A u8") : babl_format ("R'G'B' u8"),
+                   gdk_pixbuf_get_pixels (pixbuf),
+                   gdk_pixbuf_get_rowstride (pixbuf),
+                   GEGL_ABYSS_NONE);
+
+  g_object_unref (buffer);
+
+  job->success = gimp_thumbnail_save_thumb (job->thumbnail,
+                                            pixbuf,
+                                            "GIMP " GIMP_VERSION,
+                                            &job->error);
+
+  g_object_unref (pixbuf);
+}
+
+static void
+gimp_imagefile_save_thumb_done (GimpParallelTask     *task,
+                                gboolean              canceled,
+                                GimpThumbnailSaveJob *job)
+{
+  GimpImagefilePrivate *private = GET_PRIVATE (job->imagefile);
+
+  if (job->success)
+    {
+      gimp_thumbnail_peek_thumb (private->thumbnail, job->size);
+      gimp_thumbnail_delete_failure (private->thumbnail);
+
+      gimp_imagefile_update (job->imagefile);
+    }
+  else
+    {
+      gimp_message_literal (private->gimp, NULL, GIMP_MESSAGE_ERROR,
+                            job->error->message);
+      g_clear_error (&job->error);
+    }
+
+  g_object_unref (job->imagefile);
+  g_object_unref (job->thumbnail);
+  g_free (job->pixels);
+
+  g_slice_free (GimpThumbnailSaveJob, job);
+
+  thumbnail_save_running = FALSE;
+
+  job = g_queue_pop_head (&thumbnail_save_queue);
+
+  if (job)
+    gimp_imagefile_save_thumb_start (job);
+}
+
 static void
 gimp_thumbnail_set_info_from_image (GimpThumbnail *thumbnail,
                                     const gchar   *mime_type,
@@ -38,6 +38,11 @@
 #define GIMP_IMAGEFILE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GIMP_TYPE_IMAGEFILE, GimpImagefileClass))
 
 
+/*  priorities for gimp_imagefile_queue_thumbnail()  */
+#define GIMP_IMAGEFILE_THUMBNAIL_PRIORITY_VISIBLE   0
+#define GIMP_IMAGEFILE_THUMBNAIL_PRIORITY_SELECTED  10
+
+
 typedef struct _GimpImagefileClass GimpImagefileClass;
 
 struct _GimpImagefile
@@ -74,10 +79,18 @@ void            gimp_imagefile_create_thumbnail_weak (GimpImagefile *imagefile,
                                                       GimpProgress  *progress,
                                                       gint           size,
                                                       gboolean       replace);
+void            gimp_imagefile_queue_thumbnail       (GimpImagefile *imagefile,
+                                                      gint           size,
+                                                      gboolean       replace,
+                                                      gint           priority);
+void            gimp_imagefile_cancel_thumbnail      (GimpImagefile *imagefile);
 gboolean        gimp_imagefile_check_thumbnail       (GimpImagefile *imagefile);
 gboolean        gimp_imagefile_save_thumbnail        (GimpImagefile *imagefile,
                                                       const gchar   *mime_type,
                                                       GimpImage     *image);
+void            gimp_imagefile_save_thumbnail_async  (GimpImagefile *imagefile,
+                                                      const gchar   *mime_type,
+                                                      GimpImage     *image);
 const gchar   * gimp_imagefile_get_desc_string       (GimpImagefile *imagefile);
 
 
@@ -33,6 +33,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <glib-object.h>
 #include <gegl.h>
 
@@ -49,6 +51,23 @@
 #include "gimpviewable.h"
 #include "gimpchannel.h"
 
+#include "gimp-log.h"
+
+
+/*  the size of the chunks the visible part is processed in, in
+ *  progressive mode
+ */
+#define PROGRESSIVE_TILE_SIZE      256
+
+/*  in progressive mode, how soon the first result should be visible,
+ *  in microseconds, and how coarse it may be for that
+ */
+#define PROGRESSIVE_FEEDBACK_TIME  50000
+#define PROGRESSIVE_MAX_SCALE      16
+
+/*  the coarse scale used before we know how expensive the operation is  */
+#define PROGRESSIVE_INITIAL_SCALE  4
+
 
 enum
 {
@@ -73,9 +92,32 @@ struct _GimpImageMap
   GeglNode      *translate;
   GeglNode      *operation;
   GeglNode      *output;
+  GeglNode      *scale_down;   /*  only for filter operations  */
+  GeglNode      *scale_up;
   GeglProcessor *processor;
+  GeglRectangle  processor_rect;
+  gint64         processor_time;
+
+  /*  the parts of the filtered area that are still to be processed,
+   *  the visible part first, in n_visible chunks
+   */
+  GArray        *pending;
+  gint           n_visible;
+
+  /*  in progressive mode, a coarse version of the visible part is
+   *  rendered first, then the chunks closest to the focus
+   */
+  gboolean       progressive;
+  gboolean       have_focus;
+  gint           focus_x;
+  gint           focus_y;
+  gint           coarse_scale; /*  still to render coarsely, or 1  */
+  GeglRectangle  coarse_rect;
+  gint           scale;        /*  the graph renders at 1 / scale  */
+  gdouble        time_per_pixel;
 
   guint          idle_id;
+  gboolean       idle_low;
 
   GTimer        *timer;
   guint64        pixel_count;
@@ -101,10 +143,21 @@ static gboolean        gimp_image_map_get_pixel_at    (GimpPickable        *pick
 static void            gimp_image_map_update_undo_buffer
                                                       (GimpImageMap        *image_map,
                                                        const GeglRectangle *rect);
+static void            gimp_image_map_queue           (GimpImageMap        *image_map,
+                                                       const GeglRectangle *rect,
+                                                       const GeglRectangle *visible);
+static void            gimp_image_map_queue_tiles     (GimpImageMap        *image_map,
+                                                       const GeglRectangle *visible);
+static gint            gimp_image_map_get_coarse_scale
+                                                      (GimpImageMap        *image_map,
+                                                       const GeglRectangle *visible);
+static void            gimp_image_map_set_scale       (GimpImageMap        *image_map,
+                                                       gint                 scale);
 static gboolean        gimp_image_map_do              (GimpImageMap        *image_map);
 static void            gimp_image_map_data_written    (GObject             *operation,
                                                        const GeglRectangle *extent,
                                                        GimpImageMap        *image_map);
+static void            gimp_image_map_stop_processor  (GimpImageMap        *image_map);
 static void            gimp_image_map_stop_idle       (GimpImageMap        *image_map);
 
 
@@ -153,6 +206,12 @@ gimp_image_map_init (GimpImageMap *image_map)
   image_map->undo_buffer   = NULL;
   image_map->undo_offset_x = 0;
   image_map->undo_offset_y = 0;
+  image_map->pending       = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
+  image_map->n_visible     = 0;
+  image_map->progressive   = FALSE;
+  image_map->have_focus    = FALSE;
+  image_map->coarse_scale  = 1;
+  image_map->scale         = 1;
   image_map->idle_id       = 0;
 
 #ifdef GIMP_UNSTABLE
@@ -200,10 +259,18 @@ gimp_image_map_finalize (GObject *object)
   if (image_map->gegl)
     {
       g_object_unref (image_map->gegl);
-      image_map->gegl      = NULL;
-      image_map->input     = NULL;
-      image_map->translate = NULL;
-      image_map->output    = NULL;
+      image_map->gegl       = NULL;
+      image_map->input      = NULL;
+      image_map->translate  = NULL;
+      image_map->output     = NULL;
+      image_map->scale_down = NULL;
+      image_map->scale_up   = NULL;
+    }
+
+  if (image_map->pending)
+    {
+      g_array_free (image_map->pending, TRUE);
+      image_map->pending = NULL;
     }
 
   if (image_map->operation)
@@ -398,6 +465,23 @@ gimp_image_map_apply (GimpImageMap        *image_map,
                                image_map->operation,
                                image_map->output,
                                NULL);
+
+          /*  used to render the coarse version in progressive mode  */
+          image_map->scale_down =
+            gegl_node_new_child (image_map->gegl,
+                                 "operation", "gegl:scale",
+                                 "origin-x",  0.0,
+                                 "origin-y",  0.0,
+                                 "filter",    "linear",
+                                 NULL);
+
+          image_map->scale_up =
+            gegl_node_new_child (image_map->gegl,
+                                 "operation", "gegl:scale",
+                                 "origin-x",  0.0,
+                                 "origin-y",  0.0,
+                                 "filter",    "linear",
+                                 NULL);
         }
       else if (gegl_node_has_pad (image_map->operation, "output"))
         {
@@ -442,7 +526,10 @@ gimp_image_map_apply (GimpImageMap        *image_map,
                  "buffer", output_buffer,
                  NULL);
 
-  image_map->processor = gegl_node_new_processor (image_map->output, &rect);
+  gimp_image_map_queue (image_map, &rect, visible);
+
+  /*  the focus is only good for one apply  */
+  image_map->have_focus = FALSE;
 
   if (image_map->timer)
     {
@@ -452,7 +539,9 @@ gimp_image_map_apply (GimpImageMap        *image_map,
     }
 
   /*  Start the intermittant work procedure  */
-  image_map->idle_id = g_idle_add ((GSourceFunc) gimp_image_map_do, image_map);
+  image_map->idle_low = FALSE;
+  image_map->idle_id  = g_idle_add ((GSourceFunc) gimp_image_map_do,
+                                    image_map);
 }
 
 void
@@ -465,6 +554,12 @@ gimp_image_map_commit (GimpImageMap *image_map)
       g_source_remove (image_map->idle_id);
       image_map->idle_id = 0;
 
+      /*  there is no point in a coarse version now  */
+      image_map->coarse_scale = 1;
+
+      if (image_map->scale > 1)
+        gimp_image_map_stop_processor (image_map);
+
       /*  Finish the changes  */
       while (gimp_image_map_do (image_map));
     }
@@ -543,6 +638,37 @@ gimp_image_map_abort (GimpImageMap *image_map)
   gimp_image_map_clear (image_map);
 }
 
+/*  In progressive mode, a coarse version of the visible part is
+ *  rendered first if rendering all of it would take too long, and
+ *  the visible part is then refined in chunks, those closest to the
+ *  focus first. Only filter operations render coarsely.
+ */
+void
+gimp_image_map_set_progressive (GimpImageMap *image_map,
+                                gboolean      progressive)
+{
+  g_return_if_fail (GIMP_IS_IMAGE_MAP (image_map));
+
+  image_map->progressive = progressive ? TRUE : FALSE;
+}
+
+/*  Sets the point, in drawable coordinates, that the next
+ *  gimp_image_map_apply() refines first in progressive mode,
+ *  usually the pointer. Without one, it is the middle of the
+ *  visible part.
+ */
+void
+gimp_image_map_set_focus (GimpImageMap *image_map,
+                          gint          x,
+                          gint          y)
+{
+  g_return_if_fail (GIMP_IS_IMAGE_MAP (image_map));
+
+  image_map->have_focus = TRUE;
+  image_map->focus_x    = x;
+  image_map->focus_y    = y;
+}
+
 
 /*  private functions  */
 
@@ -604,54 +730,341 @@ gimp_image_map_update_undo_buffer (GimpImageMap        *image_map,
     }
 }
 
+/*  Splits @rect into the part of it that is @visible, which is
+ *  processed first, and up to four bands around that, which are only
+ *  processed once nothing else is going on, or on commit.
+ */
+static void
+gimp_image_map_queue (GimpImageMap        *image_map,
+                      const GeglRectangle *rect,
+                      const GeglRectangle *visible)
+{
+  GArray        *pending = image_map->pending;
+  GeglRectangle  inter;
+  GeglRectangle  band;
+
+  g_array_set_size (pending, 0);
+
+  image_map->n_visible    = 0;
+  image_map->coarse_scale = 1;
+
+  if (! visible || ! gegl_rectangle_intersect (&inter, rect, visible))
+    {
+      g_array_append_val (pending, *rect);
+      return;
+    }
+
+  if (image_map->progressive)
+    {
+      image_map->coarse_scale = gimp_image_map_get_coarse_scale (image_map,
+                                                                 &inter);
+      image_map->coarse_rect  = inter;
+
+      gimp_image_map_queue_tiles (image_map, &inter);
+    }
+  else
+    {
+      g_array_append_val (pending, inter);
+      image_map->n_visible = 1;
+    }
+
+  /*  above and below the visible part, full width  */
+  if (inter.y > rect->y)
+    {
+      gegl_rectangle_set (&band,
+                          rect->x, rect->y,
+                          rect->width, inter.y - rect->y);
+      g_array_append_val (pending, band);
+    }
+
+  if (inter.y + inter.height < rect->y + rect->height)
+    {
+      gegl_rectangle_set (&band,
+                          rect->x, inter.y + inter.height,
+                          rect->width,
+                          rect->y + rect->height - inter.y - inter.height);
+      g_array_append_val (pending, band);
+    }
+
+  /*  left and right of it  */
+  if (inter.x > rect->x)
+    {
+      gegl_rectangle_set (&band,
+                          rect->x, inter.y,
+                          inter.x - rect->x, inter.height);
+      g_array_append_val (pending, band);
+    }
+
+  if (inter.x + inter.width < rect->x + rect->width)
+    {
+      gegl_rectangle_set (&band,
+                          inter.x + inter.width, inter.y,
+                          rect->x + rect->width - inter.x - inter.width,
+                          inter.height);
+      g_array_append_val (pending, band);
+    }
+}
+
+static gint
+gimp_image_map_compare_tiles (const GeglRectangle *tile1,
+                              const GeglRectangle *tile2,
+                              const gint          *focus)
+{
+  gint64 dx1 = 2 * tile1->x + tile1->width  - 2 * focus[0];
+  gint64 dy1 = 2 * tile1->y + tile1->height - 2 * focus[1];
+  gint64 dx2 = 2 * tile2->x + tile2->width  - 2 * focus[0];
+  gint64 dy2 = 2 * tile2->y + tile2->height - 2 * focus[1];
+  gint64 d1  = dx1 * dx1 + dy1 * dy1;
+  gint64 d2  = dx2 * dx2 + dy2 * dy2;
+
+  return d1 < d2 ? -1 : d1 > d2 ? 1 : 0;
+}
+
+/*  Splits @visible into chunks, sorted by how far they are from the
+ *  focus.
+ */
+static void
+gimp_image_map_queue_tiles (GimpImageMap        *image_map,
+                            const GeglRectangle *visible)
+{
+  GArray *tiles = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
+  gint    focus[2];
+  gint    x, y;
+
+  if (image_map->have_focus)
+    {
+      focus[0] = image_map->focus_x;
+      focus[1] = image_map->focus_y;
+    }
+  else
+    {
+      focus[0] = visible->x + visible->width  / 2;
+      focus[1] = visible->y + visible->height / 2;
+    }
+
+  for (y = visible->y; y < visible->y + visible->height;
+       y += PROGRESSIVE_TILE_SIZE)
+    {
+      for (x = visible->x; x < visible->x + visible->width;
+           x += PROGRESSIVE_TILE_SIZE)
+        {
+          GeglRectangle tile;
+
+          gegl_rectangle_set (&tile, x, y,
+                              MIN (PROGRESSIVE_TILE_SIZE,
+                                   visible->x + visible->width  - x),
+                              MIN (PROGRESSIVE_TILE_SIZE,
+                                   visible->y + visible->height - y));
+
+          g_array_append_val (tiles, tile);
+        }
+    }
+
+  g_array_sort_with_data (tiles,
+                          (GCompareDataFunc) gimp_image_map_compare_tiles,
+                          focus);
+
+  g_array_append_vals (image_map->pending, tiles->data, tiles->len);
+  image_map->n_visible = tiles->len;
+
+  g_array_free (tiles, TRUE);
+}
+
+/*  How coarsely the visible part has to be rendered first to show
+ *  something within PROGRESSIVE_FEEDBACK_TIME, judging by how long
+ *  the last chunks took, or 1 if no coarse version is needed.
+ */
+static gint
+gimp_image_map_get_coarse_scale (GimpImageMap        *image_map,
+                                 const GeglRectangle *visible)
+{
+  gdouble time;
+  gint    scale = 1;
+
+  if (! image_map->scale_down)
+    return 1;
+
+  /*  until we know better, assume the operation is expensive  */
+  if (image_map->time_per_pixel <= 0.0)
+    return PROGRESSIVE_INITIAL_SCALE;
+
+  time = image_map->time_per_pixel * visible->width * visible->height;
+
+  while (scale < PROGRESSIVE_MAX_SCALE &&
+         time / (scale * scale) > PROGRESSIVE_FEEDBACK_TIME)
+    {
+      scale *= 2;
+    }
+
+  return scale;
+}
+
+/*  Makes the graph render at 1 / @scale, upscaling the result  */
+static void
+gimp_image_map_set_scale (GimpImageMap *image_map,
+                          gint          scale)
+{
+  if (scale == image_map->scale)
+    return;
+
+  if (scale > 1)
+    {
+      gegl_node_set (image_map->scale_down,
+                     "x", 1.0 / scale,
+                     "y", 1.0 / scale,
+                     NULL);
+      gegl_node_set (image_map->scale_up,
+                     "x", (gdouble) scale,
+                     "y", (gdouble) scale,
+                     NULL);
+
+      gegl_node_link_many (image_map->translate,
+                           image_map->scale_down,
+                           image_map->operation,
+                           image_map->scale_up,
+                           image_map->output,
+                           NULL);
+    }
+  else
+    {
+      gegl_node_link_many (image_map->translate,
+                           image_map->operation,
+                           image_map->output,
+                           NULL);
+    }
+
+  image_map->scale = scale;
+}
+
 static gboolean
 gimp_image_map_do (GimpImageMap *image_map)
 {
   gboolean pending;
+  gint64   start_time;
+  gint64   trace_start;
 
   if (! gimp_item_is_attached (GIMP_ITEM (image_map->drawable)))
     {
-      image_map->idle_id = 0;
+      image_map->idle_id      = 0;
+      image_map->n_visible    = 0;
+      image_map->coarse_scale = 1;
+
+      g_array_set_size (image_map->pending, 0);
 
-      if (image_map->processor)
+      gimp_image_map_stop_processor (image_map);
+
+      return FALSE;
+    }
+
+  if (! image_map->processor)
+    {
+      if (image_map->coarse_scale > 1)
         {
-          g_object_unref (image_map->processor);
-          image_map->processor = NULL;
+          gimp_image_map_set_scale (image_map, image_map->coarse_scale);
+
+          image_map->processor_rect = image_map->coarse_rect;
+          image_map->coarse_scale   = 1;
         }
+      else
+        {
+          gimp_image_map_set_scale (image_map, 1);
 
-      return FALSE;
+          image_map->processor_rect = g_array_index (image_map->pending,
+                                                     GeglRectangle, 0);
+          g_array_remove_index (image_map->pending, 0);
+
+          if (image_map->n_visible > 0)
+            image_map->n_visible--;
+        }
+
+      image_map->processor =
+        gegl_node_new_processor (image_map->output,
+                                 &image_map->processor_rect);
+      image_map->processor_time = 0;
     }
 
   if (image_map->timer)
     g_timer_continue (image_map->timer);
 
+  start_time  = g_get_monotonic_time ();
+  trace_start = GIMP_TRACE_START ();
+
   pending = gegl_processor_work (image_map->processor, NULL);
 
+  image_map->processor_time += g_get_monotonic_time () - start_time;
+
+  if (trace_start)
+    {
+      gchar *detail = g_strdup_printf ("%s: %d,%d %dx%d",
+                                       image_map->undo_desc ?
+                                       image_map->undo_desc : "",
+                                       image_map->processor_rect.x,
+                                       image_map->processor_rect.y,
+                                       image_map->processor_rect.width,
+                                       image_map->processor_rect.height);
+
+      gimp_trace_span ("image-map", "process", trace_start, detail);
+      g_free (detail);
+    }
+
   if (image_map->timer)
     g_timer_stop (image_map->timer);
 
-  if (! pending)
+  if (pending)
     {
-      if (image_map->timer)
-        g_printerr ("%s: %g MPixels/sec\n",
-                    image_map->undo_desc,
-                    (gdouble) image_map->pixel_count /
-                    (1000000.0 *
-                     g_timer_elapsed (image_map->timer, NULL)));
+      g_signal_emit (image_map, image_map_signals[FLUSH], 0);
 
-      g_object_unref (image_map->processor);
-      image_map->processor = NULL;
+      return TRUE;
+    }
 
-      image_map->idle_id = 0;
+  /*  remember how expensive the operation is, for the next coarse scale  */
+  if (image_map->processor_rect.width  > 0 &&
+      image_map->processor_rect.height > 0)
+    {
+      image_map->time_per_pixel = ((gdouble) image_map->processor_time *
+                                   image_map->scale * image_map->scale /
+                                   ((gdouble) image_map->processor_rect.width *
+                                    image_map->processor_rect.height));
+    }
+
+  g_object_unref (image_map->processor);
+  image_map->processor = NULL;
 
+  if (image_map->pending->len > 0)
+    {
       g_signal_emit (image_map, image_map_signals[FLUSH], 0);
 
-      return FALSE;
+      /*  the rest is not visible, don't take time from display updates
+       *  and slider changes
+       */
+      if (image_map->idle_id     &&
+          image_map->n_visible == 0 &&
+          ! image_map->idle_low)
+        {
+          image_map->idle_low = TRUE;
+          image_map->idle_id  =
+            g_idle_add_full (G_PRIORITY_LOW,
+                             (GSourceFunc) gimp_image_map_do, image_map,
+                             NULL);
+
+          return FALSE;
+        }
+
+      return TRUE;
     }
 
+  if (image_map->timer)
+    g_printerr ("%s: %g MPixels/sec\n",
+                image_map->undo_desc,
+                (gdouble) image_map->pixel_count /
+                (1000000.0 *
+                 g_timer_elapsed (image_map->timer, NULL)));
+
+  image_map->idle_id = 0;
+
   g_signal_emit (image_map, image_map_signals[FLUSH], 0);
 
-  return TRUE;
+  return FALSE;
 }
 
 static void
@@ -690,6 +1103,19 @@ gimp_image_map_data_written (GObject             *operation,
     image_map->pixel_count += extent->width * extent->height;
 }
 
+static void
+gimp_image_map_stop_processor (GimpImageMap *image_map)
+{
+  if (image_map->processor)
+    {
+      g_object_unref (image_map->processor);
+      image_map->processor = NULL;
+    }
+
+  if (image_map->scale > 1)
+    gimp_image_map_set_scale (image_map, 1);
+}
+
 static void
 gimp_image_map_stop_idle (GimpImageMap *image_map)
 {
@@ -698,10 +1124,10 @@ gimp_image_map_stop_idle (GimpImageMap *image_map)
       g_source_remove (image_map->idle_id);
       image_map->idle_id = 0;
 
-      if (image_map->processor)
-        {
-          g_object_unref (image_map->processor);
-          image_map->processor = NULL;
-        }
+      gimp_image_map_stop_processor (image_map);
+
+      g_array_set_size (image_map->pending, 0);
+      image_map->n_visible    = 0;
+      image_map->coarse_scale = 1;
     }
 }
@@ -59,5 +59,13 @@ void           gimp_image_map_commit   (GimpImageMap        *image_map);
 void           gimp_image_map_clear    (GimpImageMap        *image_map);
 void           gimp_image_map_abort    (GimpImageMap        *image_map);
 
+void           gimp_image_map_set_progressive
+                                       (GimpImageMap        *image_map,
+                                        gboolean             progressive);
+void           gimp_image_map_set_focus
+                                       (GimpImageMap        *image_map,
+                                        gint                 x,
+                                        gint                 y);
+
 
 #endif /* __GIMP_IMAGE_MAP_H__ */
@@ -56,6 +56,7 @@ struct _GimpItemTreePrivate
   GimpItem   *active_item;
 
   GHashTable *name_hash;
+  GHashTable *suffix_hash;  /*  base name -> all of "base #1".."base #n" used  */
 };
 
 #define GIMP_ITEM_TREE_GET_PRIVATE(object) \
@@ -80,6 +81,10 @@ static void     gimp_item_tree_get_property  (GObject      *object,
 static gint64   gimp_item_tree_get_memsize   (GimpObject   *object,
                                               gint64       *gui_size);
 
+static gchar  * gimp_item_tree_split_name    (const gchar  *name,
+                                              gint         *number);
+static void     gimp_item_tree_remove_name   (GimpItemTree *tree,
+                                              const gchar  *name);
 static void     gimp_item_tree_uniquefy_name (GimpItemTree *tree,
                                               GimpItem     *item,
                                               const gchar  *new_name);
@@ -138,7 +143,9 @@ gimp_item_tree_init (GimpItemTree *tree)
 {
   GimpItemTreePrivate *private = GIMP_ITEM_TREE_GET_PRIVATE (tree);
 
-  private->name_hash = g_hash_table_new (g_str_hash, g_str_equal);
+  private->name_hash   = g_hash_table_new (g_str_hash, g_str_equal);
+  private->suffix_hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                g_free, NULL);
 }
 
 static void
@@ -174,6 +181,12 @@ gimp_item_tree_finalize (GObject *object)
       private->name_hash = NULL;
     }
 
+  if (private->suffix_hash)
+    {
+      g_hash_table_unref (private->suffix_hash);
+      private->suffix_hash = NULL;
+    }
+
   if (tree->container)
     {
       g_object_unref (tree->container);
@@ -477,8 +490,7 @@ gimp_item_tree_remove_item (GimpItemTree *tree,
 
   g_object_ref (item);
 
-  g_hash_table_remove (private->name_hash,
-                       gimp_object_get_name (item));
+  gimp_item_tree_remove_name (tree, gimp_object_get_name (item));
 
   children = gimp_viewable_get_children (GIMP_VIEWABLE (item));
 
@@ -488,8 +500,7 @@ gimp_item_tree_remove_item (GimpItemTree *tree,
 
       while (list)
         {
-          g_hash_table_remove (private->name_hash,
-                               gimp_object_get_name (list->data));
+          gimp_item_tree_remove_name (tree, gimp_object_get_name (list->data));
 
           list = g_list_remove (list, list->data);
         }
@@ -631,6 +642,71 @@ gimp_item_tree_rename_item (GimpItemTree *tree,
 
 /*  private functions  */
 
+/*  Returns the name without a " #<n>" extension, and the number of the
+ *  extension in number, or 0 if there is none.
+ */
+static gchar *
+gimp_item_tree_split_name (const gchar *name,
+                           gint        *number)
+{
+  gchar *base = g_strdup (name);
+  gchar *ext  = strrchr (base, '#');
+
+  *number = 0;
+
+  if (ext)
+    {
+      gchar ext_str[8];
+
+      *number = atoi (ext + 1);
+
+      g_snprintf (ext_str, sizeof (ext_str), "%d", *number);
+
+      /*  check if the extension really is of the form "#<n>"  */
+      if (! strcmp (ext_str, ext + 1))
+        {
+          if (ext > base && *(ext - 1) == ' ')
+            ext--;
+
+          *ext = '\0';
+        }
+      else
+        {
+          *number = 0;
+        }
+    }
+
+  return base;
+}
+
+static void
+gimp_item_tree_remove_name (GimpItemTree *tree,
+                            const gchar  *name)
+{
+  GimpItemTreePrivate *private = GIMP_ITEM_TREE_GET_PRIVATE (tree);
+  gchar               *base;
+  gint                 number;
+
+  g_hash_table_remove (private->name_hash, name);
+
+  /*  the name's number is free again, so the numbers below it are the
+   *  only ones still known to be used
+   */
+  base = gimp_item_tree_split_name (name, &number);
+
+  if (number > 0)
+    {
+      gint used = GPOINTER_TO_INT (g_hash_table_lookup (private->suffix_hash,
+                                                        base));
+
+      if (used >= number)
+        g_hash_table_insert (private->suffix_hash,
+                             g_strdup (base), GINT_TO_POINTER (number - 1));
+    }
+
+  g_free (base);
+}
+
 static void
 gimp_item_tree_uniquefy_name (GimpItemTree *tree,
                               GimpItem     *item,
@@ -640,8 +716,7 @@ gimp_item_tree_uniquefy_name (GimpItemTree *tree,
 
   if (new_name)
     {
-      g_hash_table_remove (private->name_hash,
-                           gimp_object_get_name (item));
+      gimp_item_tree_remove_name (tree, gimp_object_get_name (item));
 
       gimp_object_set_name (GIMP_OBJECT (item), new_name);
     }
@@ -649,32 +724,22 @@ gimp_item_tree_uniquefy_name (GimpItemTree *tree,
   if (g_hash_table_lookup (private->name_hash,
                            gimp_object_get_name (item)))
     {
-      gchar *name     = g_strdup (gimp_object_get_name (item));
-      gchar *ext      = strrchr (name, '#');
-      gchar *new_name = NULL;
-      gint   number   = 0;
-
-      if (ext)
-        {
-          gchar ext_str[8];
+      gchar    *name;
+      gchar    *new_name = NULL;
+      gint      number;
+      gint      used;
+      gboolean  contiguous;
 
-          number = atoi (ext + 1);
+      name = gimp_item_tree_split_name (gimp_object_get_name (item), &number);
 
-          g_snprintf (ext_str, sizeof (ext_str), "%d", number);
+      /*  "name #1" up to "name #<used>" are all taken, so start after
+       *  them instead of probing each one
+       */
+      used = GPOINTER_TO_INT (g_hash_table_lookup (private->suffix_hash,
+                                                   name));
 
-          /*  check if the extension really is of the form "#<n>"  */
-          if (! strcmp (ext_str, ext + 1))
-            {
-              if (ext > name && *(ext - 1) == ' ')
-                ext--;
-
-              *ext = '\0';
-            }
-          else
-            {
-              number = 0;
-            }
-        }
+      contiguous = (number <= used);
+      number     = MAX (number, used);
 
       do
         {
@@ -686,6 +751,13 @@ gimp_item_tree_uniquefy_name (GimpItemTree *tree,
         }
       while (g_hash_table_lookup (private->name_hash, new_name));
 
+      /*  if we started right after them, everything up to number is
+       *  taken now
+       */
+      if (contiguous)
+        g_hash_table_insert (private->suffix_hash,
+                             g_strdup (name), GINT_TO_POINTER (number));
+
       g_free (name);
 
       gimp_object_take_name (GIMP_OBJECT (item), new_name);
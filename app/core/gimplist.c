@@ -30,6 +30,12 @@
 #include "gimplist.h"
 
 
+/*  lists with at least this many children look names up in a hash
+ *  table, smaller lists are just scanned
+ */
+#define NAME_TABLE_THRESHOLD 32
+
+
 enum
 {
   PROP_0,
@@ -39,6 +45,7 @@ enum
 };
 
 
+static void         gimp_list_finalize           (GObject             *object);
 static void         gimp_list_set_property       (GObject             *object,
                                                   guint                property_id,
                                                   const GValue        *value,
@@ -76,6 +83,16 @@ static void         gimp_list_uniquefy_name      (GimpList            *gimp_list
 static void         gimp_list_object_renamed     (GimpObject          *object,
                                                   GimpList            *list);
 
+static gboolean     gimp_list_name_is_taken      (GimpList            *list,
+                                                  GimpObject          *object,
+                                                  const gchar         *name);
+static void         gimp_list_name_table_build   (GimpList            *list);
+static void         gimp_list_name_table_add     (GimpList            *list,
+                                                  GimpObject          *object);
+static void         gimp_list_name_table_remove  (GimpList            *list,
+                                                  GimpObject          *object);
+static void         gimp_list_invalidate_index   (GimpList            *list);
+
 
 G_DEFINE_TYPE (GimpList, gimp_list, GIMP_TYPE_CONTAINER)
 
@@ -89,6 +106,7 @@ gimp_list_class_init (GimpListClass *klass)
   GimpObjectClass    *gimp_object_class = GIMP_OBJECT_CLASS (klass);
   GimpContainerClass *container_class   = GIMP_CONTAINER_CLASS (klass);
 
+  object_class->finalize              = gimp_list_finalize;
   object_class->set_property          = gimp_list_set_property;
   object_class->get_property          = gimp_list_get_property;
 
@@ -132,6 +150,36 @@ gimp_list_init (GimpList *list)
   list->unique_names = FALSE;
   list->sort_func    = NULL;
   list->append       = FALSE;
+  list->name_table   = NULL;
+  list->child_names  = NULL;
+  list->index_array  = NULL;
+}
+
+static void
+gimp_list_finalize (GObject *object)
+{
+  GimpList *list = GIMP_LIST (object);
+
+  if (list->name_table)
+    {
+      GHashTableIter  iter;
+      gpointer        objects;
+
+      g_hash_table_iter_init (&iter, list->name_table);
+
+      while (g_hash_table_iter_next (&iter, NULL, &objects))
+        g_list_free (objects);
+
+      g_hash_table_unref (list->name_table);
+      g_hash_table_unref (list->child_names);
+
+      list->name_table  = NULL;
+      list->child_names = NULL;
+    }
+
+  gimp_list_invalidate_index (list);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -218,10 +266,10 @@ gimp_list_add (GimpContainer *container,
   if (list->unique_names)
     gimp_list_uniquefy_name (list, object);
 
-  if (list->unique_names || list->sort_func)
-    g_signal_connect (object, "name-changed",
-                      G_CALLBACK (gimp_list_object_renamed),
-                      list);
+  /*  also needed to keep the name table up to date  */
+  g_signal_connect (object, "name-changed",
+                    G_CALLBACK (gimp_list_object_renamed),
+                    list);
 
   if (list->sort_func)
     list->list = g_list_insert_sorted (list->list, object, list->sort_func);
@@ -230,6 +278,15 @@ gimp_list_add (GimpContainer *container,
   else
     list->list = g_list_prepend (list->list, object);
 
+  gimp_list_name_table_add (list, object);
+  gimp_list_invalidate_index (list);
+
+  /*  only a list owning its children counts their memsize  */
+  if (gimp_container_get_policy (container) == GIMP_CONTAINER_POLICY_STRONG)
+    gimp_object_set_memsize_parent (object, GIMP_OBJECT (list));
+
+  gimp_object_memsize_changed (GIMP_OBJECT (list));
+
   GIMP_CONTAINER_CLASS (parent_class)->add (container, object);
 }
 
@@ -239,13 +296,20 @@ gimp_list_remove (GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
-  if (list->unique_names || list->sort_func)
-    g_signal_handlers_disconnect_by_func (object,
-                                          gimp_list_object_renamed,
-                                          list);
+  g_signal_handlers_disconnect_by_func (object,
+                                        gimp_list_object_renamed,
+                                        list);
 
   list->list = g_list_remove (list->list, object);
 
+  gimp_list_name_table_remove (list, object);
+  gimp_list_invalidate_index (list);
+
+  if (gimp_container_get_policy (container) == GIMP_CONTAINER_POLICY_STRONG)
+    gimp_object_set_memsize_parent (object, NULL);
+
+  gimp_object_memsize_changed (GIMP_OBJECT (list));
+
   GIMP_CONTAINER_CLASS (parent_class)->remove (container, object);
 }
 
@@ -263,6 +327,8 @@ gimp_list_reorder (GimpContainer *container,
     list->list = g_list_append (list->list, object);
   else
     list->list = g_list_insert (list->list, object, new_index);
+
+  gimp_list_invalidate_index (list);
 }
 
 static void
@@ -300,6 +366,29 @@ gimp_list_get_child_by_name (const GimpContainer *container,
   GimpList *list = GIMP_LIST (container);
   GList    *glist;
 
+  if (! list->name_table &&
+      gimp_container_get_n_children (container) >= NAME_TABLE_THRESHOLD)
+    {
+      gimp_list_name_table_build (list);
+    }
+
+  if (list->name_table)
+    {
+      GList *objects = g_hash_table_lookup (list->name_table, name);
+
+      if (! objects || ! objects->next)
+        return objects ? objects->data : NULL;
+
+      /*  several children have this name, return the first one  */
+      for (glist = list->list; glist; glist = g_list_next (glist))
+        {
+          if (g_list_find (objects, glist->data))
+            return glist->data;
+        }
+
+      return NULL;
+    }
+
   for (glist = list->list; glist; glist = g_list_next (glist))
     {
       GimpObject *object = glist->data;
@@ -316,12 +405,26 @@ gimp_list_get_child_by_index (const GimpContainer *container,
                               gint                 index)
 {
   GimpList *list = GIMP_LIST (container);
-  GList    *glist;
 
-  glist = g_list_nth (list->list, index);
+  if (index < 0)
+    return NULL;
+
+  /*  the array is rebuilt after the list changed, so that looking up
+   *  all children by index is linear instead of quadratic
+   */
+  if (! list->index_array)
+    {
+      GList *glist;
+
+      list->index_array =
+        g_ptr_array_sized_new (gimp_container_get_n_children (container));
+
+      for (glist = list->list; glist; glist = g_list_next (glist))
+        g_ptr_array_add (list->index_array, glist->data);
+    }
 
-  if (glist)
-    return (GimpObject *) glist->data;
+  if ((guint) index < list->index_array->len)
+    return g_ptr_array_index (list->index_array, index);
 
   return NULL;
 }
@@ -418,6 +521,7 @@ gimp_list_reverse (GimpList *list)
     {
       gimp_container_freeze (GIMP_CONTAINER (list));
       list->list = g_list_reverse (list->list);
+      gimp_list_invalidate_index (list);
       gimp_container_thaw (GIMP_CONTAINER (list));
     }
 }
@@ -482,6 +586,7 @@ gimp_list_sort (GimpList     *list,
     {
       gimp_container_freeze (GIMP_CONTAINER (list));
       list->list = g_list_sort (list->list, sort_func);
+      gimp_list_invalidate_index (list);
       gimp_container_thaw (GIMP_CONTAINER (list));
     }
 }
@@ -508,23 +613,18 @@ gimp_list_uniquefy_name (GimpList   *gimp_list,
                          GimpObject *object)
 {
   gchar *name = (gchar *) gimp_object_get_name (object);
-  GList *list;
 
   if (! name)
     return;
 
-  for (list = gimp_list->list; list; list = g_list_next (list))
+  if (! gimp_list->name_table &&
+      gimp_container_get_n_children (GIMP_CONTAINER (gimp_list)) >=
+      NAME_TABLE_THRESHOLD)
     {
-      GimpObject  *object2 = list->data;
-      const gchar *name2   = gimp_object_get_name (object2);
-
-      if (object != object2 &&
-          name2             &&
-          ! strcmp (name, name2))
-        break;
+      gimp_list_name_table_build (gimp_list);
     }
 
-  if (list)
+  if (gimp_list_name_is_taken (gimp_list, object, name))
     {
       gchar *ext;
       gchar *new_name   = NULL;
@@ -563,19 +663,8 @@ gimp_list_uniquefy_name (GimpList   *gimp_list,
           g_free (new_name);
 
           new_name = g_strdup_printf ("%s #%d", name, unique_ext);
-
-          for (list = gimp_list->list; list; list = g_list_next (list))
-            {
-              GimpObject  *object2 = list->data;
-              const gchar *name2   = gimp_object_get_name (object2);
-
-              if (object != object2 &&
-                  name2             &&
-                  ! strcmp (new_name, name2))
-                break;
-            }
         }
-      while (list);
+      while (gimp_list_name_is_taken (gimp_list, object, new_name));
 
       g_free (name);
 
@@ -600,6 +689,12 @@ gimp_list_object_renamed (GimpObject *object,
                                          list);
     }
 
+  if (list->name_table)
+    {
+      gimp_list_name_table_remove (list, object);
+      gimp_list_name_table_add (list, object);
+    }
+
   if (list->sort_func)
     {
       GList *glist;
@@ -625,3 +720,110 @@ gimp_list_object_renamed (GimpObject *object,
         gimp_container_reorder (GIMP_CONTAINER (list), object, new_index);
     }
 }
+
+static gboolean
+gimp_list_name_is_taken (GimpList    *list,
+                         GimpObject  *object,
+                         const gchar *name)
+{
+  GList *glist;
+
+  if (list->name_table)
+    {
+      for (glist = g_hash_table_lookup (list->name_table, name);
+           glist;
+           glist = g_list_next (glist))
+        {
+          if (glist->data != object)
+            return TRUE;
+        }
+
+      return FALSE;
+    }
+
+  for (glist = list->list; glist; glist = g_list_next (glist))
+    {
+      GimpObject  *object2 = glist->data;
+      const gchar *name2   = gimp_object_get_name (object2);
+
+      if (object != object2 &&
+          name2             &&
+          ! strcmp (name, name2))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+gimp_list_name_table_build (GimpList *list)
+{
+  GList *glist;
+
+  list->name_table  = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free, NULL);
+  list->child_names = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                             NULL, g_free);
+
+  for (glist = list->list; glist; glist = g_list_next (glist))
+    gimp_list_name_table_add (list, glist->data);
+}
+
+static void
+gimp_list_name_table_add (GimpList   *list,
+                          GimpObject *object)
+{
+  const gchar *name;
+  GList       *objects;
+
+  if (! list->name_table)
+    return;
+
+  name = gimp_object_get_name (object);
+
+  if (! name)
+    return;
+
+  objects = g_hash_table_lookup (list->name_table, name);
+
+  g_hash_table_replace (list->name_table,
+                        g_strdup (name), g_list_prepend (objects, object));
+  g_hash_table_insert (list->child_names, object, g_strdup (name));
+}
+
+static void
+gimp_list_name_table_remove (GimpList   *list,
+                             GimpObject *object)
+{
+  const gchar *name;
+  GList       *objects;
+
+  if (! list->name_table)
+    return;
+
+  /*  the object may already have its new name, so use the old one  */
+  name = g_hash_table_lookup (list->child_names, object);
+
+  if (! name)
+    return;
+
+  objects = g_hash_table_lookup (list->name_table, name);
+  objects = g_list_remove (objects, object);
+
+  if (objects)
+    g_hash_table_replace (list->name_table, g_strdup (name), objects);
+  else
+    g_hash_table_remove (list->name_table, name);
+
+  g_hash_table_remove (list->child_names, object);
+}
+
+static void
+gimp_list_invalidate_index (GimpList *list)
+{
+  if (list->index_array)
+    {
+      g_ptr_array_free (list->index_array, TRUE);
+      list->index_array = NULL;
+    }
+}
@@ -43,6 +43,10 @@ struct _GimpList
   gboolean       unique_names;
   GCompareFunc   sort_func;
   gboolean       append;
+
+  GHashTable    *name_table;   /*  name -> GList of children, or NULL  */
+  GHashTable    *child_names;  /*  child -> its name in name_table     */
+  GPtrArray     *index_array;  /*  children by index, or NULL          */
 };
 
 struct _GimpListClass
@@ -107,14 +107,9 @@ gimp_mask_undo_constructed (GObject *object)
 
   if (gimp_channel_bounds (channel, &x1, &y1, &x2, &y2))
     {
-      mask_undo->buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                                           x2 - x1, y2 - y1),
-                                           gimp_drawable_get_format (drawable));
-
-      gegl_buffer_copy (gimp_drawable_get_buffer (drawable),
-                        GEGL_RECTANGLE (x1, y1, x2 - x1, y2 - y1),
-                        mask_undo->buffer,
-                        GEGL_RECTANGLE (0, 0, 0, 0));
+      mask_undo->buffer =
+        gimp_gegl_buffer_dup_area (gimp_drawable_get_buffer (drawable),
+                                   GEGL_RECTANGLE (x1, y1, x2 - x1, y2 - y1));
 
       mask_undo->x = x1;
       mask_undo->y = y1;
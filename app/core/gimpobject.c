@@ -48,10 +48,22 @@ enum
 
 struct _GimpObjectPrivate
 {
-  gchar *name;
-  gchar *normalized;
-  guint  static_name  : 1;
-  guint  disconnected : 1;
+  gchar      *name;
+  gchar      *normalized;
+  guint       static_name   : 1;
+  guint       disconnected  : 1;
+  guint       cache_memsize : 1;
+
+  /*  the cached result of get_memsize(), valid as long as the
+   *  object is not invalidated and memsize_stamp is current
+   */
+  guint       memsize_valid : 1;
+  guint       memsize_stamp;
+  gint64      memsize;
+  gint64      gui_memsize;
+
+  /*  the object whose memsize includes this one's  */
+  GimpObject *memsize_parent;
 };
 
 
@@ -77,6 +89,11 @@ static GObjectClass *parent_class = NULL;
 
 static guint object_signals[LAST_SIGNAL] = { 0 };
 
+/*  bumped whenever memory may have moved between objects in ways the
+ *  objects themselves don't notice, like tiles becoming unshared
+ */
+static guint memsize_stamp = 1;
+
 
 GType
 gimp_object_get_type (void)
@@ -369,6 +386,8 @@ gimp_object_name_free (GimpObject *object)
 
   if (object->p->name)
     {
+      gimp_object_memsize_changed (object);
+
       if (! object->p->static_name)
         g_free (object->p->name);
 
@@ -504,15 +523,110 @@ gimp_object_get_memsize (GimpObject *object,
     }
 #endif /* DEBUG_MEMSIZE */
 
+  if (object->p->memsize_valid &&
+      object->p->memsize_stamp == memsize_stamp)
+    {
+      if (gui_size)
+        *gui_size = object->p->gui_memsize;
+
+      return object->p->memsize;
+    }
+
   my_size = GIMP_OBJECT_GET_CLASS (object)->get_memsize (object,
                                                          &my_gui_size);
 
+  if (object->p->cache_memsize)
+    {
+      object->p->memsize       = my_size;
+      object->p->gui_memsize   = my_gui_size;
+      object->p->memsize_stamp = memsize_stamp;
+      object->p->memsize_valid = TRUE;
+    }
+
   if (gui_size)
     *gui_size = my_gui_size;
 
   return my_size;
 }
 
+/**
+ * gimp_object_set_memsize_cached:
+ * @object: a #GimpObject
+ * @cached: whether to cache the result of gimp_object_get_memsize()
+ *
+ * Only enable this for objects that call gimp_object_memsize_changed()
+ * whenever their size changes, and whose children are cached as well
+ * or never change size.
+ **/
+void
+gimp_object_set_memsize_cached (GimpObject *object,
+                                gboolean    cached)
+{
+  g_return_if_fail (GIMP_IS_OBJECT (object));
+
+  object->p->cache_memsize = cached ? TRUE : FALSE;
+  object->p->memsize_valid = FALSE;
+}
+
+/**
+ * gimp_object_set_memsize_parent:
+ * @object: a #GimpObject
+ * @parent: the object whose memsize includes @object's, or %NULL
+ *
+ * Makes gimp_object_memsize_changed() on @object invalidate @parent's
+ * cached size too. The parent is not referenced.
+ **/
+void
+gimp_object_set_memsize_parent (GimpObject *object,
+                                GimpObject *parent)
+{
+  g_return_if_fail (GIMP_IS_OBJECT (object));
+  g_return_if_fail (parent == NULL || GIMP_IS_OBJECT (parent));
+
+  object->p->memsize_parent = parent;
+}
+
+/**
+ * gimp_object_memsize_changed:
+ * @object: a #GimpObject
+ *
+ * Invalidates the cached size of @object and of its memsize parents.
+ **/
+void
+gimp_object_memsize_changed (GimpObject *object)
+{
+  g_return_if_fail (GIMP_IS_OBJECT (object));
+
+  while (object)
+    {
+      gboolean was_valid = object->p->memsize_valid;
+
+      object->p->memsize_valid = FALSE;
+
+      /*  a cached parent is never valid when its cached child isn't,
+       *  so we can stop at the first invalid one
+       */
+      if (! was_valid && object->p->cache_memsize)
+        break;
+
+      object = object->p->memsize_parent;
+    }
+}
+
+/**
+ * gimp_object_memsize_changed_all:
+ *
+ * Invalidates all cached sizes, for changes that can't be attributed
+ * to a single object, like a drawable unsharing tiles with its undo
+ * steps.
+ **/
+void
+gimp_object_memsize_changed_all (void)
+{
+  if (++memsize_stamp == 0)
+    memsize_stamp = 1;
+}
+
 static gint64
 gimp_object_real_get_memsize (GimpObject *object,
                               gint64     *gui_size)
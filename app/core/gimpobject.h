@@ -70,5 +70,12 @@ gint          gimp_object_name_collate    (GimpObject       *object1,
 gint64        gimp_object_get_memsize     (GimpObject       *object,
                                            gint64           *gui_size);
 
+void          gimp_object_set_memsize_cached  (GimpObject     *object,
+                                               gboolean        cached);
+void          gimp_object_set_memsize_parent  (GimpObject     *object,
+                                               GimpObject     *parent);
+void          gimp_object_memsize_changed     (GimpObject     *object);
+void          gimp_object_memsize_changed_all (void);
+
 
 #endif  /* __GIMP_OBJECT_H__ */
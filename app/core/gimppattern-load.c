@@ -23,6 +23,7 @@
 #include <stdio.h>
 
 #include <sys/types.h>
+#include <sys/stat.h>
 
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
@@ -69,6 +70,8 @@ gimp_pattern_load (GimpContext  *context,
   PatternHeader  header;
   gint           bn_size;
   gchar         *name    = NULL;
+  struct stat    st;
+  gssize         size;
 
   g_return_val_if_fail (filename != NULL, NULL);
   g_return_val_if_fail (g_path_is_absolute (filename), NULL);
@@ -165,17 +168,30 @@ gimp_pattern_load (GimpContext  *context,
     case 4: format = babl_format ("R'G'B'A u8"); break;
     }
 
-  pattern->mask = gimp_temp_buf_new (header.width, header.height, format);
+  size = header.width * header.height * header.bytes;
 
-  if (read (fd, gimp_temp_buf_get_data (pattern->mask),
-            header.width * header.height * header.bytes) <
-      header.width * header.height * header.bytes)
+  /*  the pixels are stored as-is, defer reading them until the
+   *  pattern is actually used
+   */
+  if (fstat (fd, &st) == 0 &&
+      header.header_size + size <= st.st_size)
     {
-      g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
-                   _("Fatal parse error in pattern file '%s': "
-                     "File appears truncated."),
-                   gimp_filename_to_utf8 (filename));
-      goto error;
+      pattern->mask = gimp_temp_buf_new_lazy (header.width, header.height,
+                                              format, filename,
+                                              header.header_size);
+    }
+  else
+    {
+      pattern->mask = gimp_temp_buf_new (header.width, header.height, format);
+
+      if (read (fd, gimp_temp_buf_get_data (pattern->mask), size) < size)
+        {
+          g_set_error (error, GIMP_DATA_ERROR, GIMP_DATA_ERROR_READ,
+                       _("Fatal parse error in pattern file '%s': "
+                         "File appears truncated."),
+                       gimp_filename_to_utf8 (filename));
+          goto error;
+        }
     }
 
   close (fd);
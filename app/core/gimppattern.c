@@ -204,8 +204,7 @@ gimp_pattern_get_checksum (GimpTagged *tagged)
     {
       GChecksum *checksum = g_checksum_new (G_CHECKSUM_MD5);
 
-      g_checksum_update (checksum, gimp_temp_buf_get_data (pattern->mask),
-                         gimp_temp_buf_get_data_size (pattern->mask));
+      gimp_temp_buf_update_checksum (pattern->mask, checksum);
 
       checksum_string = g_strdup (g_checksum_get_string (checksum));
 
@@ -34,9 +34,40 @@
 
 #include "core-types.h"
 
+#include "gimpdrawable.h"
 #include "gimpobject.h"
 #include "gimpimage.h"
 #include "gimppickable.h"
+#include "gimpprojection.h"
+
+
+/*  box averages of at least this radius are computed from summed-area
+ *  tables, smaller boxes are cheaper to sample directly
+ */
+#define SAT_MIN_RADIUS  4
+#define SAT_TILE_SIZE   64
+#define SAT_MAX_TILES   256
+
+
+typedef struct _SatTile  SatTile;
+typedef struct _SatCache SatCache;
+
+struct _SatTile
+{
+  GeglRectangle  rect;
+  guint32       *sums;  /*  (width + 1) * (height + 1) R'G'B'A sums  */
+};
+
+struct _SatCache
+{
+  GeglBuffer *buffer;   /*  weak pointer, the tiles are only valid for it  */
+  GHashTable *tiles;
+};
+
+
+static void   gimp_pickable_sat_average (GimpPickable        *pickable,
+                                         const GeglRectangle *area,
+                                         guchar              *pixel);
 
 
 GType
@@ -196,6 +227,45 @@ gimp_pickable_get_opacity_at (GimpPickable *pickable,
   return GIMP_OPACITY_TRANSPARENT;
 }
 
+/**
+ * gimp_pickable_invalidate_area:
+ * @pickable: a #GimpPickable
+ * @x:        the left edge of the changed area
+ * @y:        the top edge of the changed area
+ * @width:    the width of the changed area
+ * @height:   the height of the changed area
+ *
+ * Drops whatever @pickable has cached about the pixels of the area,
+ * this must be called whenever they change.
+ **/
+void
+gimp_pickable_invalidate_area (GimpPickable *pickable,
+                               gint          x,
+                               gint          y,
+                               gint          width,
+                               gint          height)
+{
+  SatCache      *cache;
+  GeglRectangle  area = { x, y, width, height };
+  GHashTableIter iter;
+  SatTile       *tile;
+
+  g_return_if_fail (GIMP_IS_PICKABLE (pickable));
+
+  cache = g_object_get_data (G_OBJECT (pickable), "gimp-pickable-sat");
+
+  if (! cache)
+    return;
+
+  g_hash_table_iter_init (&iter, cache->tiles);
+
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tile))
+    {
+      if (gegl_rectangle_intersect (NULL, &tile->rect, &area))
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
 gboolean
 gimp_pickable_pick_color (GimpPickable *pickable,
                           gint          x,
@@ -215,7 +285,25 @@ gimp_pickable_pick_color (GimpPickable *pickable,
   if (! gimp_pickable_get_pixel_at (pickable, x, y, format, pixel))
     return FALSE;
 
-  if (sample_average)
+  if (sample_average && (gint) average_radius >= SAT_MIN_RADIUS &&
+      (GIMP_IS_DRAWABLE (pickable) || GIMP_IS_PROJECTION (pickable)))
+    {
+      /*  drawables and projections call gimp_pickable_invalidate_area()
+       *  on every change, so they can keep summed-area tables
+       */
+      GeglBuffer    *buffer = gimp_pickable_get_buffer (pickable);
+      gint           radius = (gint) average_radius;
+      GeglRectangle  area   = { x - radius, y - radius,
+                                2 * radius + 1, 2 * radius + 1 };
+
+      gegl_rectangle_intersect (&area, &area,
+                                GEGL_RECTANGLE (0, 0,
+                                                gegl_buffer_get_width  (buffer),
+                                                gegl_buffer_get_height (buffer)));
+
+      gimp_pickable_sat_average (pickable, &area, pixel);
+    }
+  else if (sample_average)
     {
       gint count        = 0;
       gint color_avg[4] = { 0, 0, 0, 0 };
@@ -264,3 +352,154 @@ gimp_pickable_pick_color (GimpPickable *pickable,
 
   return TRUE;
 }
+
+
+/*  private functions  */
+
+static void
+gimp_pickable_sat_tile_free (SatTile *tile)
+{
+  g_free (tile->sums);
+  g_slice_free (SatTile, tile);
+}
+
+static void
+gimp_pickable_sat_cache_free (SatCache *cache)
+{
+  if (cache->buffer)
+    g_object_remove_weak_pointer (G_OBJECT (cache->buffer),
+                                  (gpointer) &cache->buffer);
+
+  g_hash_table_unref (cache->tiles);
+  g_slice_free (SatCache, cache);
+}
+
+static SatTile *
+gimp_pickable_sat_tile_new (GeglBuffer *buffer,
+                            gint        tile_x,
+                            gint        tile_y)
+{
+  SatTile *tile = g_slice_new (SatTile);
+  guchar  *data;
+  gint     stride;
+  gint     x, y, c;
+
+  tile->rect.x      = tile_x * SAT_TILE_SIZE;
+  tile->rect.y      = tile_y * SAT_TILE_SIZE;
+  tile->rect.width  = MIN (SAT_TILE_SIZE,
+                           gegl_buffer_get_width  (buffer) - tile->rect.x);
+  tile->rect.height = MIN (SAT_TILE_SIZE,
+                           gegl_buffer_get_height (buffer) - tile->rect.y);
+
+  stride = (tile->rect.width + 1) * 4;
+
+  data       = g_new (guchar, tile->rect.width * tile->rect.height * 4);
+  tile->sums = g_new0 (guint32, stride * (tile->rect.height + 1));
+
+  gegl_buffer_get (buffer, &tile->rect, 1.0, babl_format ("R'G'B'A u8"),
+                   data, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  /*  sums[y][x] is the sum of all pixels above and left of (x, y)  */
+  for (y = 0; y < tile->rect.height; y++)
+    {
+      const guchar  *src    = data + y * tile->rect.width * 4;
+      const guint32 *above  = tile->sums + y * stride + 4;
+      guint32       *dest   = tile->sums + (y + 1) * stride + 4;
+      guint32        row[4] = { 0, 0, 0, 0 };
+
+      for (x = 0; x < tile->rect.width; x++)
+        for (c = 0; c < 4; c++)
+          {
+            row[c] += *src++;
+
+            *dest++ = *above++ + row[c];
+          }
+    }
+
+  g_free (data);
+
+  return tile;
+}
+
+static void
+gimp_pickable_sat_average (GimpPickable        *pickable,
+                           const GeglRectangle *area,
+                           guchar              *pixel)
+{
+  GeglBuffer *buffer = gimp_pickable_get_buffer (pickable);
+  SatCache   *cache;
+  gint64      sum[4] = { 0, 0, 0, 0 };
+  gint        count  = area->width * area->height;
+  gint        tile_x, tile_y;
+  gint        c;
+
+  cache = g_object_get_data (G_OBJECT (pickable), "gimp-pickable-sat");
+
+  if (! cache)
+    {
+      cache = g_slice_new0 (SatCache);
+
+      cache->tiles = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL,
+                                            (GDestroyNotify) gimp_pickable_sat_tile_free);
+
+      g_object_set_data_full (G_OBJECT (pickable), "gimp-pickable-sat", cache,
+                              (GDestroyNotify) gimp_pickable_sat_cache_free);
+    }
+
+  if (cache->buffer != buffer ||
+      g_hash_table_size (cache->tiles) > SAT_MAX_TILES)
+    {
+      g_hash_table_remove_all (cache->tiles);
+
+      if (cache->buffer)
+        g_object_remove_weak_pointer (G_OBJECT (cache->buffer),
+                                      (gpointer) &cache->buffer);
+
+      cache->buffer = buffer;
+
+      g_object_add_weak_pointer (G_OBJECT (cache->buffer),
+                                 (gpointer) &cache->buffer);
+    }
+
+  for (tile_y = area->y / SAT_TILE_SIZE;
+       tile_y <= (area->y + area->height - 1) / SAT_TILE_SIZE;
+       tile_y++)
+    {
+      for (tile_x = area->x / SAT_TILE_SIZE;
+           tile_x <= (area->x + area->width - 1) / SAT_TILE_SIZE;
+           tile_x++)
+        {
+          gpointer       key  = GINT_TO_POINTER ((tile_y << 16) | tile_x);
+          SatTile       *tile = g_hash_table_lookup (cache->tiles, key);
+          GeglRectangle  rect;
+          gint           stride;
+          const guint32 *tl, *tr, *bl, *br;
+
+          if (! tile)
+            {
+              tile = gimp_pickable_sat_tile_new (buffer, tile_x, tile_y);
+
+              g_hash_table_insert (cache->tiles, key, tile);
+            }
+
+          gegl_rectangle_intersect (&rect, &tile->rect, area);
+
+          rect.x -= tile->rect.x;
+          rect.y -= tile->rect.y;
+
+          stride = (tile->rect.width + 1) * 4;
+
+          tl = tile->sums + rect.y * stride + rect.x * 4;
+          tr = tl + rect.width * 4;
+          bl = tl + rect.height * stride;
+          br = bl + rect.width * 4;
+
+          for (c = 0; c < 4; c++)
+            sum[c] += (gint64) br[c] - bl[c] - tr[c] + tl[c];
+        }
+    }
+
+  for (c = 0; c < 4; c++)
+    pixel[c] = (guchar) ((sum[c] + count / 2) / count);
+}
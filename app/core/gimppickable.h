@@ -54,6 +54,11 @@ struct _GimpPickableInterface
 GType           gimp_pickable_interface_get_type    (void) G_GNUC_CONST;
 
 void            gimp_pickable_flush                 (GimpPickable *pickable);
+void            gimp_pickable_invalidate_area       (GimpPickable *pickable,
+                                                     gint          x,
+                                                     gint          y,
+                                                     gint          width,
+                                                     gint          height);
 GimpImage     * gimp_pickable_get_image             (GimpPickable *pickable);
 const Babl    * gimp_pickable_get_format            (GimpPickable *pickable);
 const Babl    * gimp_pickable_get_format_with_alpha (GimpPickable *pickable);
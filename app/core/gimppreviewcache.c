@@ -281,6 +281,25 @@ gimp_preview_cache_get (GSList **plist,
   return NULL;
 }
 
+/*  like gimp_preview_cache_get(), but doesn't make up a preview from a
+ *  bigger one, for callers that have a better way of scaling
+ */
+GimpTempBuf *
+gimp_preview_cache_get_exact (GSList **plist,
+                              gint     width,
+                              gint     height)
+{
+  PreviewNearest pn;
+
+  pn.buf    = NULL;
+  pn.width  = width;
+  pn.height = height;
+
+  g_slist_foreach (*plist, preview_cache_find_exact, &pn);
+
+  return pn.buf;
+}
+
 gsize
 gimp_preview_cache_get_memsize (GSList *cache)
 {
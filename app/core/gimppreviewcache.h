@@ -19,13 +19,12 @@
 #define __GIMP_PREVIEW_CACHE_H__
 
 
-#define PREVIEW_CACHE_PRIME_WIDTH  112
-#define PREVIEW_CACHE_PRIME_HEIGHT 112
-
-
 GimpTempBuf * gimp_preview_cache_get         (GSList      **plist,
                                               gint          width,
                                               gint          height);
+GimpTempBuf * gimp_preview_cache_get_exact   (GSList      **plist,
+                                              gint          width,
+                                              gint          height);
 void          gimp_preview_cache_add         (GSList      **plist,
                                               GimpTempBuf  *buf);
 void          gimp_preview_cache_invalidate  (GSList      **plist);
@@ -19,6 +19,8 @@
 
 #include <gegl.h>
 
+#include "libgimpbase/gimpbase.h"
+
 #include "core-types.h"
 
 #include "base/tile.h"
@@ -38,10 +40,23 @@
 #include "gimpprojection.h"
 #include "gimpprojection-construct.h"
 
+#include "gimp-log.h"
+
 
 /*  halfway between G_PRIORITY_HIGH_IDLE and G_PRIORITY_DEFAULT_IDLE  */
 #define  GIMP_PROJECTION_IDLE_PRIORITY  150
 
+/*  render chunks are aligned to multiples of the tile size, so that no
+ *  tile is ever constructed by more than one chunk
+ */
+#define  GIMP_PROJECTION_CHUNK_WIDTH    (4 * TILE_WIDTH)
+#define  GIMP_PROJECTION_CHUNK_HEIGHT   (2 * TILE_HEIGHT)
+
+/*  how long a single idle render callback may keep rendering chunks
+ *  before returning to the main loop, in microseconds
+ */
+#define  GIMP_PROJECTION_CHUNK_TIME     (1000000 / 60)
+
 
 enum
 {
@@ -81,7 +96,10 @@ static void        gimp_projection_flush_whenever        (GimpProjection  *proj,
                                                           gboolean         now);
 static void        gimp_projection_idle_render_init      (GimpProjection  *proj);
 static gboolean    gimp_projection_idle_render_callback  (gpointer         data);
+static gboolean    gimp_projection_idle_render_chunk     (GimpProjection  *proj);
 static gboolean    gimp_projection_idle_render_next_area (GimpProjection  *proj);
+static void        gimp_projection_idle_render_split_area(GimpProjection  *proj,
+                                                          GimpArea        *area);
 static void        gimp_projection_paint_area            (GimpProjection  *proj,
                                                           gboolean         now,
                                                           gint             x,
@@ -153,6 +171,10 @@ gimp_projection_init (GimpProjection *proj)
   proj->update_areas             = NULL;
   proj->idle_render.idle_id      = 0;
   proj->idle_render.update_areas = NULL;
+  proj->priority_rect.x          = 0;
+  proj->priority_rect.y          = 0;
+  proj->priority_rect.width      = 0;
+  proj->priority_rect.height     = 0;
 }
 
 static void
@@ -457,6 +479,39 @@ gimp_projection_get_level (GimpProjection *proj,
   return tile_pyramid_get_level (width, height, MAX (scale_x, scale_y));
 }
 
+/**
+ * gimp_projection_set_priority_rect:
+ * @proj: a #GimpProjection
+ * @x:    x coordinate of the priority area, in image coordinates
+ * @y:    y coordinate of the priority area, in image coordinates
+ * @w:    width of the priority area
+ * @h:    height of the priority area
+ *
+ * Sets the area of the projection that is currently visible, usually
+ * the viewport of a display. When rendering on idle, the parts of the
+ * update areas inside this rectangle are rendered before all others.
+ * Pass an empty rectangle to render in plain update order.
+ **/
+void
+gimp_projection_set_priority_rect (GimpProjection *proj,
+                                   gint            x,
+                                   gint            y,
+                                   gint            w,
+                                   gint            h)
+{
+  gint off_x, off_y;
+
+  g_return_if_fail (GIMP_IS_PROJECTION (proj));
+
+  gimp_projectable_get_offset (proj->projectable, &off_x, &off_y);
+
+  /*  the idle render works in tile-pyramid coordinates  */
+  proj->priority_rect.x      = x - off_x;
+  proj->priority_rect.y      = y - off_y;
+  proj->priority_rect.width  = MAX (w, 0);
+  proj->priority_rect.height = MAX (h, 0);
+}
+
 void
 gimp_projection_flush (GimpProjection *proj)
 {
@@ -493,6 +548,47 @@ gimp_projection_finish_draw (GimpProjection *proj)
     }
 }
 
+/**
+ * gimp_projection_get_render_backlog:
+ * @proj: a #GimpProjection
+ *
+ * Return value: the number of pixels that were invalidated and are
+ *               still waiting for the idle renderer.
+ **/
+gint64
+gimp_projection_get_render_backlog (GimpProjection *proj)
+{
+  gint64  backlog = 0;
+  GSList *list;
+
+  g_return_val_if_fail (GIMP_IS_PROJECTION (proj), 0);
+
+  for (list = proj->update_areas; list; list = g_slist_next (list))
+    {
+      GimpArea *area = list->data;
+
+      backlog += (gint64) (area->x2 - area->x1) * (area->y2 - area->y1);
+    }
+
+  if (proj->idle_render.idle_id)
+    {
+      backlog += ((gint64) proj->idle_render.width *
+                  (proj->idle_render.base_y + proj->idle_render.height -
+                   proj->idle_render.y));
+
+      for (list = proj->idle_render.update_areas;
+           list;
+           list = g_slist_next (list))
+        {
+          GimpArea *area = list->data;
+
+          backlog += (gint64) (area->x2 - area->x1) * (area->y2 - area->y1);
+        }
+    }
+
+  return backlog;
+}
+
 
 /*  private functions  */
 
@@ -632,22 +728,64 @@ gimp_projection_idle_render_init (GimpProjection *proj)
  * them into bite-sized chunks which are chewed on in a low- priority
  * idle thread.  This greatly improves responsiveness for many GIMP
  * operations.  -- Adam
+ *
+ * The chunks are aligned to the tile grid, and the parts of the
+ * update areas which are visible in a display (the priority rect)
+ * are scheduled first. Each callback renders as many chunks as fit
+ * into GIMP_PROJECTION_CHUNK_TIME; the GEGL graph distributes the
+ * work of each chunk over its worker threads, and the finished tiles
+ * are handed to the displays via the "update" signal.
  */
 static gboolean
 gimp_projection_idle_render_callback (gpointer data)
 {
   GimpProjection *proj = data;
-  gint            workx, worky;
-  gint            workw, workh;
+  gint64          end_time;
+
+  end_time = g_get_monotonic_time () + GIMP_PROJECTION_CHUNK_TIME;
 
-#define CHUNK_WIDTH  256
-#define CHUNK_HEIGHT 128
+  do
+    {
+      if (! gimp_projection_idle_render_chunk (proj))
+        {
+          /* FINISHED */
+          proj->idle_render.idle_id = 0;
+
+          if (proj->invalidate_preview)
+            {
+              /* invalidate the preview here since it is constructed from
+               * the projection
+               */
+              proj->invalidate_preview = FALSE;
+
+              gimp_projectable_invalidate_preview (proj->projectable);
+            }
+
+          return FALSE;
+        }
+    }
+  while (g_get_monotonic_time () < end_time);
+
+  /* Still work to do. */
+  return TRUE;
+}
+
+static gboolean
+gimp_projection_idle_render_chunk (GimpProjection *proj)
+{
+  gint   workx, worky;
+  gint   workw, workh;
+  gint64 trace_start = GIMP_TRACE_START ();
 
-  workw = CHUNK_WIDTH;
-  workh = CHUNK_HEIGHT;
   workx = proj->idle_render.x;
   worky = proj->idle_render.y;
 
+  /*  end the chunk at the next chunk grid line  */
+  workw = (GIMP_PROJECTION_CHUNK_WIDTH -
+           workx % GIMP_PROJECTION_CHUNK_WIDTH);
+  workh = (GIMP_PROJECTION_CHUNK_HEIGHT -
+           worky % GIMP_PROJECTION_CHUNK_HEIGHT);
+
   if (workx + workw > proj->idle_render.base_x + proj->idle_render.width)
     {
       workw = proj->idle_render.base_x + proj->idle_render.width - workx;
@@ -661,38 +799,36 @@ gimp_projection_idle_render_callback (gpointer data)
   gimp_projection_paint_area (proj, TRUE /* sic! */,
                               workx, worky, workw, workh);
 
-  proj->idle_render.x += CHUNK_WIDTH;
+  /*  compute the upper pyramid levels of the chunk right away, so
+   *  the display doesn't have to when it zooms out
+   */
+  if (proj->pyramid)
+    tile_pyramid_validate_area (proj->pyramid, workx, worky, workw, workh);
+
+  if (trace_start)
+    {
+      gchar *detail = g_strdup_printf ("%d,%d %dx%d",
+                                       workx, worky, workw, workh);
+
+      gimp_trace_span ("projection", "render-chunk", trace_start, detail);
+      g_free (detail);
+    }
+
+  proj->idle_render.x += workw;
 
   if (proj->idle_render.x >=
       proj->idle_render.base_x + proj->idle_render.width)
     {
-      proj->idle_render.x = proj->idle_render.base_x;
-      proj->idle_render.y += CHUNK_HEIGHT;
+      proj->idle_render.x  = proj->idle_render.base_x;
+      proj->idle_render.y += workh;
 
       if (proj->idle_render.y >=
           proj->idle_render.base_y + proj->idle_render.height)
         {
-          if (! gimp_projection_idle_render_next_area (proj))
-            {
-              /* FINISHED */
-              proj->idle_render.idle_id = 0;
-
-              if (proj->invalidate_preview)
-                {
-                  /* invalidate the preview here since it is constructed from
-                   * the projection
-                   */
-                  proj->invalidate_preview = FALSE;
-
-                  gimp_projectable_invalidate_preview (proj->projectable);
-                }
-
-              return FALSE;
-            }
+          return gimp_projection_idle_render_next_area (proj);
         }
     }
 
-  /* Still work to do. */
   return TRUE;
 }
 
@@ -700,15 +836,36 @@ static gboolean
 gimp_projection_idle_render_next_area (GimpProjection *proj)
 {
   GimpArea *area;
+  GSList   *list;
 
   if (! proj->idle_render.update_areas)
     return FALSE;
 
   area = proj->idle_render.update_areas->data;
 
+  /*  prefer areas which are visible in a display  */
+  for (list = proj->idle_render.update_areas; list; list = g_slist_next (list))
+    {
+      GimpArea *this = list->data;
+
+      if (gimp_rectangle_intersect (this->x1, this->y1,
+                                    this->x2 - this->x1, this->y2 - this->y1,
+                                    proj->priority_rect.x,
+                                    proj->priority_rect.y,
+                                    proj->priority_rect.width,
+                                    proj->priority_rect.height,
+                                    NULL, NULL, NULL, NULL))
+        {
+          area = this;
+          break;
+        }
+    }
+
   proj->idle_render.update_areas =
     g_slist_remove (proj->idle_render.update_areas, area);
 
+  gimp_projection_idle_render_split_area (proj, area);
+
   proj->idle_render.x      = proj->idle_render.base_x = area->x1;
   proj->idle_render.y      = proj->idle_render.base_y = area->y1;
   proj->idle_render.width  = area->x2 - area->x1;
@@ -719,6 +876,65 @@ gimp_projection_idle_render_next_area (GimpProjection *proj)
   return TRUE;
 }
 
+/*  shrinks @area to its intersection with the priority rect, and
+ *  queues the invisible remainder for rendering after everything
+ *  that is visible
+ */
+static void
+gimp_projection_idle_render_split_area (GimpProjection *proj,
+                                        GimpArea       *area)
+{
+  gint x, y;
+  gint w, h;
+
+  if (! gimp_rectangle_intersect (area->x1, area->y1,
+                                  area->x2 - area->x1, area->y2 - area->y1,
+                                  proj->priority_rect.x,
+                                  proj->priority_rect.y,
+                                  proj->priority_rect.width,
+                                  proj->priority_rect.height,
+                                  &x, &y, &w, &h))
+    return;
+
+  /*  align the visible part to the tile grid  */
+  w += x % TILE_WIDTH;
+  h += y % TILE_HEIGHT;
+  x -= x % TILE_WIDTH;
+  y -= y % TILE_HEIGHT;
+
+  x = MAX (x, area->x1);
+  y = MAX (y, area->y1);
+  w = MIN (x + w, area->x2) - x;
+  h = MIN (y + h, area->y2) - y;
+
+  /*  above and below the visible part  */
+  if (y > area->y1)
+    proj->idle_render.update_areas =
+      g_slist_append (proj->idle_render.update_areas,
+                      gimp_area_new (area->x1, area->y1, area->x2, y));
+
+  if (y + h < area->y2)
+    proj->idle_render.update_areas =
+      g_slist_append (proj->idle_render.update_areas,
+                      gimp_area_new (area->x1, y + h, area->x2, area->y2));
+
+  /*  left and right of the visible part  */
+  if (x > area->x1)
+    proj->idle_render.update_areas =
+      g_slist_append (proj->idle_render.update_areas,
+                      gimp_area_new (area->x1, y, x, y + h));
+
+  if (x + w < area->x2)
+    proj->idle_render.update_areas =
+      g_slist_append (proj->idle_render.update_areas,
+                      gimp_area_new (x + w, y, area->x2, y + h));
+
+  area->x1 = x;
+  area->y1 = y;
+  area->x2 = x + w;
+  area->y2 = y + h;
+}
+
 static void
 gimp_projection_paint_area (GimpProjection *proj,
                             gboolean        now,
@@ -769,12 +985,17 @@ gimp_projection_invalidate (GimpProjection *proj,
 
           buffer = gimp_projection_get_buffer (GIMP_PICKABLE (proj));
 
-          /* makes the buffer drop all GimpTiles */
-          gimp_gegl_buffer_refetch_tiles (buffer);
+          /* makes the buffer drop the GimpTiles of the area, the
+           * cached rest of the projection stays valid
+           */
+          gimp_gegl_buffer_refetch_area (buffer,
+                                         GEGL_RECTANGLE (x, y, w, h));
         }
 
       tile_pyramid_invalidate_area (proj->pyramid, x, y, w, h);
     }
+
+  gimp_pickable_invalidate_area (GIMP_PICKABLE (proj), x, y, w, h);
 }
 
 static void
@@ -782,13 +1003,14 @@ gimp_projection_validate_tile (TileManager    *tm,
                                Tile           *tile,
                                GimpProjection *proj)
 {
-  Tile *additional[7];
-  gint  n_additional = 0;
-  gint  x, y;
-  gint  width, height;
-  gint  tile_width, tile_height;
-  gint  col, row;
-  gint  i;
+  Tile   *additional[7];
+  gint    n_additional = 0;
+  gint    x, y;
+  gint    width, height;
+  gint    tile_width, tile_height;
+  gint    col, row;
+  gint    i;
+  gint64  trace_start = GIMP_TRACE_START ();
 
   /*  Find the coordinates of this tile  */
   tile_manager_get_tile_coordinates (tm, tile, &x, &y);
@@ -836,6 +1058,14 @@ gimp_projection_validate_tile (TileManager    *tm,
       additional[i]->valid = TRUE;
       tile_release (additional[i], TRUE);
     }
+
+  if (trace_start)
+    {
+      gchar *detail = g_strdup_printf ("%d,%d %dx%d", x, y, width, height);
+
+      gimp_trace_span ("projection", "construct", trace_start, detail);
+      g_free (detail);
+    }
 }
 
 /*  image callbacks  */
@@ -64,6 +64,8 @@ struct _GimpProjection
   GSList                   *update_areas;
   GimpProjectionIdleRender  idle_render;
 
+  GeglRectangle             priority_rect;
+
   gboolean                  invalidate_preview;
 };
 
@@ -94,10 +96,20 @@ gint             gimp_projection_get_level        (GimpProjection       *proj,
                                                    gdouble               scale_x,
                                                    gdouble               scale_y);
 
+void             gimp_projection_set_priority_rect
+                                                  (GimpProjection       *proj,
+                                                   gint                  x,
+                                                   gint                  y,
+                                                   gint                  w,
+                                                   gint                  h);
+
 void             gimp_projection_flush            (GimpProjection       *proj);
 void             gimp_projection_flush_now        (GimpProjection       *proj);
 void             gimp_projection_finish_draw      (GimpProjection       *proj);
 
+gint64           gimp_projection_get_render_backlog
+                                                  (GimpProjection       *proj);
+
 gint64           gimp_projection_estimate_memsize (GimpImageBaseType     type,
                                                    gint                  width,
                                                    gint                  height);
@@ -28,6 +28,7 @@
 
 #include "core-types.h"
 
+#include "gimp-parallel.h"
 #include "gimpbezierdesc.h"
 #include "gimpscanconvert.h"
 
@@ -54,6 +55,76 @@ struct _GimpScanConvert
   GArray         *path_data;
 };
 
+/*  Renders are done tile by tile. Coverage masks of paths, whose area
+ *  is at most GIMP_SCAN_CONVERT_MAX_MASK pixels, are cached by the path
+ *  and stroke options, so the same path can be put on a buffer again
+ *  without rasterizing it.
+ */
+#define GIMP_SCAN_CONVERT_TILE_SIZE  64
+#define GIMP_SCAN_CONVERT_MAX_MASK   (4 * 1024 * 1024)
+#define GIMP_SCAN_CONVERT_MAX_CACHE  (16 * 1024 * 1024)
+
+
+typedef struct
+{
+  GBytes        *key;
+  GeglRectangle  rect;       /* in path coordinates */
+  gint           stride;
+  guchar        *data;       /* the coverage, A8 */
+  gint           ref_count;
+} GimpScanConvertMask;
+
+typedef struct
+{
+  GimpScanConvert     *sc;
+  GimpScanConvertMask *mask;
+  GeglBuffer          *buffer;
+  const Babl          *format;
+  gint                 off_x;
+  gint                 off_y;
+  gboolean             replace;
+  gboolean             antialias;
+  gint                 value;  /* 0..255 */
+} GimpScanConvertRender;
+
+
+static void     gimp_scan_convert_setup_cairo (GimpScanConvert       *sc,
+                                               cairo_t               *cr,
+                                               gboolean               antialias);
+static void     gimp_scan_convert_get_extents (GimpScanConvert       *sc,
+                                               GeglRectangle         *extents);
+static void     gimp_scan_convert_rasterize   (GimpScanConvert       *sc,
+                                               gboolean               antialias,
+                                               guchar                *data,
+                                               gint                   stride,
+                                               const GeglRectangle   *rect);
+static void     gimp_scan_convert_composite   (GimpScanConvertRender *render,
+                                               guchar                *dest,
+                                               gint                   dest_stride,
+                                               const guchar          *src,
+                                               gint                   src_stride,
+                                               gint                   width,
+                                               gint                   height);
+static void     gimp_scan_convert_render_mask (const GeglRectangle   *area,
+                                               GimpScanConvertRender *render);
+static void     gimp_scan_convert_render_area (const GeglRectangle   *area,
+                                               GimpScanConvertRender *render);
+
+static GBytes * gimp_scan_convert_get_key     (GimpScanConvert       *sc,
+                                               gboolean               antialias);
+
+static GimpScanConvertMask * gimp_scan_convert_mask_new    (GBytes              *key,
+                                                            const GeglRectangle *rect);
+static void                  gimp_scan_convert_mask_unref  (GimpScanConvertMask *mask);
+static GimpScanConvertMask * gimp_scan_convert_mask_lookup (GBytes              *key,
+                                                            const GeglRectangle *rect);
+static void                  gimp_scan_convert_mask_insert (GimpScanConvertMask *mask);
+
+
+static GQueue  mask_cache      = G_QUEUE_INIT;
+static gsize   mask_cache_size = 0;
+static GMutex  mask_cache_mutex;
+
 
 /*  public functions  */
 
@@ -437,6 +508,10 @@ gimp_scan_convert_compose_value (GimpScanConvert *sc,
  * top of existing content or replacing it completely. The @value
  * specifies the opacity value to be used for the objects in the @sc.
  *
+ * Only the tiles the path touches are rendered, in parallel. The
+ * coverage of paths which aren't too large is cached, so rendering the
+ * same path with the same options again doesn't rasterize it again.
+ *
  * You cannot add additional polygons after this command.
  */
 void
@@ -448,143 +523,469 @@ gimp_scan_convert_render_full (GimpScanConvert *sc,
                                gboolean         antialias,
                                gdouble          value)
 {
-  const Babl         *format;
-  GeglBufferIterator *iter;
-  GeglRectangle      *roi;
-  cairo_t            *cr;
-  cairo_surface_t    *surface;
-  cairo_path_t        path;
-  gint                bpp;
-  gint                x, y;
-  gint                width, height;
+  GimpScanConvertRender  render;
+  GimpScanConvertMask   *mask = NULL;
+  GeglRectangle          area;
+  GeglRectangle          extents;
+  GeglRectangle          needed;
+  gint                   tile_width;
+  gint                   tile_height;
 
   g_return_if_fail (sc != NULL);
   g_return_if_fail (GEGL_IS_BUFFER (buffer));
 
-  x      = 0;
-  y      = 0;
-  width  = gegl_buffer_get_width  (buffer);
-  height = gegl_buffer_get_height (buffer);
+  area.x      = 0;
+  area.y      = 0;
+  area.width  = gegl_buffer_get_width  (buffer);
+  area.height = gegl_buffer_get_height (buffer);
 
-  if (sc->clip && ! gimp_rectangle_intersect (x, y, width, height,
+  if (sc->clip && ! gimp_rectangle_intersect (area.x, area.y,
+                                              area.width, area.height,
                                               sc->clip_x, sc->clip_y,
                                               sc->clip_w, sc->clip_h,
-                                              &x, &y, &width, &height))
+                                              &area.x, &area.y,
+                                              &area.width, &area.height))
     return;
 
+  if (replace)
+    gegl_buffer_clear (buffer, NULL);
+
+  /*  only the part of the area the path can touch needs to be rendered,
+   *  in path coordinates, with x aligned for cairo
+   */
+  gimp_scan_convert_get_extents (sc, &extents);
+
+  needed    = area;
+  needed.x += off_x;
+  needed.y += off_y;
+
+  if (! gegl_rectangle_intersect (&needed, &needed, &extents))
+    return;
+
+  needed.width += needed.x & 3;
+  needed.x     -= needed.x & 3;
+
+  render.sc        = sc;
+  render.buffer    = buffer;
+  render.format    = babl_format ("Y u8");
+  render.off_x     = off_x;
+  render.off_y     = off_y;
+  render.replace   = replace;
+  render.antialias = antialias;
+  render.value     = ROUND (CLAMP (value, 0.0, 1.0) * 255.0);
+
+  /*  masks which are small enough are kept around, so rendering the
+   *  same path again, like for previews, only composites the mask
+   */
+  if ((gsize) needed.width * needed.height <= GIMP_SCAN_CONVERT_MAX_MASK)
+    {
+      GBytes *key = gimp_scan_convert_get_key (sc, antialias);
+
+      mask = gimp_scan_convert_mask_lookup (key, &needed);
+
+      if (! mask)
+        {
+          mask = gimp_scan_convert_mask_new (key, &needed);
+
+          render.mask = mask;
+
+          gimp_parallel_distribute_area (&needed,
+                                         GIMP_SCAN_CONVERT_TILE_SIZE,
+                                         GIMP_SCAN_CONVERT_TILE_SIZE,
+                                         (GimpParallelDistributeAreaFunc)
+                                         gimp_scan_convert_render_mask,
+                                         &render);
+
+          gimp_scan_convert_mask_insert (mask);
+        }
+
+      g_bytes_unref (key);
+    }
+
+  render.mask = mask;
+
+  /*  and the buffer is rendered into tile by tile, in parallel  */
+  needed.x -= off_x;
+  needed.y -= off_y;
+
+  gegl_rectangle_intersect (&needed, &needed, &area);
+
+  g_object_get (buffer,
+                "tile-width",  &tile_width,
+                "tile-height", &tile_height,
+                NULL);
+
+  gimp_parallel_distribute_area (&needed, tile_width, tile_height,
+                                 (GimpParallelDistributeAreaFunc)
+                                 gimp_scan_convert_render_area,
+                                 &render);
+
+  if (mask)
+    gimp_scan_convert_mask_unref (mask);
+}
+
+
+/*  private functions  */
+
+/*  sets up @cr to paint the path of @sc  */
+static void
+gimp_scan_convert_setup_cairo (GimpScanConvert *sc,
+                               cairo_t         *cr,
+                               gboolean         antialias)
+{
+  cairo_path_t path;
+
   path.status   = CAIRO_STATUS_SUCCESS;
   path.data     = (cairo_path_data_t *) sc->path_data->data;
   path.num_data = sc->path_data->len;
 
-  format = babl_format ("Y u8");
-  bpp    = babl_format_get_bytes_per_pixel (format);
+  cairo_set_source_rgba (cr, 0, 0, 0, 1.0);
+  cairo_append_path (cr, &path);
 
-  iter = gegl_buffer_iterator_new (buffer, NULL, 0, format,
-                                   GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
-  roi = &iter->roi[0];
+  cairo_set_antialias (cr, antialias ?
+                       CAIRO_ANTIALIAS_GRAY : CAIRO_ANTIALIAS_NONE);
+  cairo_set_miter_limit (cr, sc->miter);
 
-  while (gegl_buffer_iterator_next (iter))
+  if (sc->do_stroke)
     {
-      guchar     *data    = iter->data[0];
-      guchar     *tmp_buf = NULL;
-      const gint  stride  = cairo_format_stride_for_width (CAIRO_FORMAT_A8,
-                                                           roi->width);
-
-      /*  cairo rowstrides are always multiples of 4, whereas
-       *  maskPR.rowstride can be anything, so to be able to create an
-       *  image surface, we maybe have to create our own temporary
-       *  buffer
-       */
-      if (roi->width * bpp != stride)
-        {
-          const guchar *src = data;
-          guchar       *dest;
+      cairo_set_line_cap (cr,
+                          sc->cap == GIMP_CAP_BUTT ? CAIRO_LINE_CAP_BUTT :
+                          sc->cap == GIMP_CAP_ROUND ? CAIRO_LINE_CAP_ROUND :
+                          CAIRO_LINE_CAP_SQUARE);
+      cairo_set_line_join (cr,
+                           sc->join == GIMP_JOIN_MITER ? CAIRO_LINE_JOIN_MITER :
+                           sc->join == GIMP_JOIN_ROUND ? CAIRO_LINE_JOIN_ROUND :
+                           CAIRO_LINE_JOIN_BEVEL);
+
+      cairo_set_line_width (cr, sc->width);
+
+      if (sc->dash_info)
+        cairo_set_dash (cr,
+                        (double *) sc->dash_info->data,
+                        sc->dash_info->len,
+                        sc->dash_offset);
+
+      cairo_scale (cr, 1.0, sc->ratio_xy);
+    }
+  else
+    {
+      cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+    }
+}
+
+/*  the pixels the path can touch, in path coordinates  */
+static void
+gimp_scan_convert_get_extents (GimpScanConvert *sc,
+                               GeglRectangle   *extents)
+{
+  cairo_surface_t *surface;
+  cairo_t         *cr;
+  gdouble          x1, y1;
+  gdouble          x2, y2;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_A8, 1, 1);
+  cr      = cairo_create (surface);
+
+  gimp_scan_convert_setup_cairo (sc, cr, TRUE);
+
+  if (sc->do_stroke)
+    cairo_stroke_extents (cr, &x1, &y1, &x2, &y2);
+  else
+    cairo_fill_extents (cr, &x1, &y1, &x2, &y2);
+
+  cairo_user_to_device (cr, &x1, &y1);
+  cairo_user_to_device (cr, &x2, &y2);
 
-          dest = tmp_buf = g_alloca (stride * roi->height);
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
 
-          if (! replace)
+  if (x2 <= x1 || y2 <= y1)
+    {
+      extents->x = extents->y = extents->width = extents->height = 0;
+      return;
+    }
+
+  /*  one more pixel on each side for antialiasing  */
+  extents->x      = floor (x1) - 1;
+  extents->y      = floor (y1) - 1;
+  extents->width  = ceil (x2) + 1 - extents->x;
+  extents->height = ceil (y2) + 1 - extents->y;
+}
+
+/*  renders the coverage of the path in @rect, given in path coordinates,
+ *  to @data, which must be cleared, 4-byte aligned and have a stride
+ *  cairo accepts
+ */
+static void
+gimp_scan_convert_rasterize (GimpScanConvert     *sc,
+                             gboolean             antialias,
+                             guchar              *data,
+                             gint                 stride,
+                             const GeglRectangle *rect)
+{
+  cairo_surface_t *surface;
+  cairo_t         *cr;
+
+  surface = cairo_image_surface_create_for_data (data, CAIRO_FORMAT_A8,
+                                                 rect->width, rect->height,
+                                                 stride);
+  cairo_surface_set_device_offset (surface, -rect->x, -rect->y);
+
+  cr = cairo_create (surface);
+
+  gimp_scan_convert_setup_cairo (sc, cr, antialias);
+
+  if (sc->do_stroke)
+    cairo_stroke (cr);
+  else
+    cairo_fill (cr);
+
+  cairo_destroy (cr);
+  cairo_surface_flush (surface);
+  cairo_surface_destroy (surface);
+}
+
+/*  puts the coverage in @src on @dest, using the render's value  */
+static void
+gimp_scan_convert_composite (GimpScanConvertRender *render,
+                             guchar                *dest,
+                             gint                   dest_stride,
+                             const guchar          *src,
+                             gint                   src_stride,
+                             gint                   width,
+                             gint                   height)
+{
+  const gint value = render->value;
+  gint       x, y;
+
+  for (y = 0; y < height; y++)
+    {
+      guchar       *d = dest + y * dest_stride;
+      const guchar *s = src  + y * src_stride;
+
+      if (render->replace)
+        {
+          for (x = 0; x < width; x++)
             {
-              gint i;
+              gint t = s[x] * value + 128;
 
-              for (i = 0; i < roi->height; i++)
+              d[x] = (t + (t >> 8)) >> 8;
+            }
+        }
+      else
+        {
+          for (x = 0; x < width; x++)
+            {
+              if (s[x])
                 {
-                  memcpy (dest, src, roi->width * bpp);
+                  gint t = s[x] * value + (255 - s[x]) * d[x] + 128;
 
-                  src  += roi->width * bpp;
-                  dest += stride;
+                  d[x] = (t + (t >> 8)) >> 8;
                 }
             }
         }
+    }
+}
 
-      surface = cairo_image_surface_create_for_data (tmp_buf ?
-                                                     tmp_buf : data,
-                                                     CAIRO_FORMAT_A8,
-                                                     roi->width, roi->height,
-                                                     stride);
+/*  called for each tile of a new mask  */
+static void
+gimp_scan_convert_render_mask (const GeglRectangle   *area,
+                               GimpScanConvertRender *render)
+{
+  GimpScanConvertMask *mask = render->mask;
 
-      cairo_surface_set_device_offset (surface,
-                                       -off_x - roi->x,
-                                       -off_y - roi->y);
-      cr = cairo_create (surface);
-      cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  gimp_scan_convert_rasterize (render->sc, render->antialias,
+                               mask->data +
+                               (area->y - mask->rect.y) * mask->stride +
+                               (area->x - mask->rect.x),
+                               mask->stride, area);
+}
 
-      if (replace)
-        {
-          cairo_set_source_rgba (cr, 0, 0, 0, 0);
-          cairo_paint (cr);
-        }
+/*  called for each tile of the area of the buffer to render to  */
+static void
+gimp_scan_convert_render_area (const GeglRectangle   *area,
+                               GimpScanConvertRender *render)
+{
+  GeglBufferIterator *iter;
+  GeglRectangle      *roi;
 
-      cairo_set_source_rgba (cr, 0, 0, 0, value);
-      cairo_append_path (cr, &path);
+  iter = gegl_buffer_iterator_new (render->buffer, area, 0, render->format,
+                                   render->replace ?
+                                   GEGL_BUFFER_WRITE : GEGL_BUFFER_READWRITE,
+                                   GEGL_ABYSS_NONE);
+  roi = &iter->roi[0];
 
-      cairo_set_antialias (cr, antialias ?
-                           CAIRO_ANTIALIAS_GRAY : CAIRO_ANTIALIAS_NONE);
-      cairo_set_miter_limit (cr, sc->miter);
+  while (gegl_buffer_iterator_next (iter))
+    {
+      GimpScanConvertMask *mask = render->mask;
+      GeglRectangle        rect;
+
+      rect    = *roi;
+      rect.x += render->off_x;
+      rect.y += render->off_y;
 
-      if (sc->do_stroke)
+      if (mask)
         {
-          cairo_set_line_cap (cr,
-                              sc->cap == GIMP_CAP_BUTT ? CAIRO_LINE_CAP_BUTT :
-                              sc->cap == GIMP_CAP_ROUND ? CAIRO_LINE_CAP_ROUND :
-                              CAIRO_LINE_CAP_SQUARE);
-          cairo_set_line_join (cr,
-                               sc->join == GIMP_JOIN_MITER ? CAIRO_LINE_JOIN_MITER :
-                               sc->join == GIMP_JOIN_ROUND ? CAIRO_LINE_JOIN_ROUND :
-                               CAIRO_LINE_JOIN_BEVEL);
-
-          cairo_set_line_width (cr, sc->width);
-
-          if (sc->dash_info)
-            cairo_set_dash (cr,
-                            (double *) sc->dash_info->data,
-                            sc->dash_info->len,
-                            sc->dash_offset);
-
-          cairo_scale (cr, 1.0, sc->ratio_xy);
-          cairo_stroke (cr);
+          gimp_scan_convert_composite (render, iter->data[0], roi->width,
+                                       mask->data +
+                                       (rect.y - mask->rect.y) * mask->stride +
+                                       (rect.x - mask->rect.x),
+                                       mask->stride,
+                                       roi->width, roi->height);
         }
       else
         {
-          cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
-          cairo_fill (cr);
+          /*  the coverage of a single tile fits on the stack  */
+          const gint  stride = cairo_format_stride_for_width (CAIRO_FORMAT_A8,
+                                                              roi->width);
+          guchar     *cover  = g_alloca (stride * roi->height + 4);
+
+          cover = (guchar *) (((gsize) cover + 3) & ~(gsize) 3);
+          memset (cover, 0, stride * roi->height);
+
+          gimp_scan_convert_rasterize (render->sc, render->antialias,
+                                       cover, stride, &rect);
+
+          gimp_scan_convert_composite (render, iter->data[0], roi->width,
+                                       cover, stride,
+                                       roi->width, roi->height);
         }
+    }
+}
+
+/*  a key describing everything that makes up the coverage of the path  */
+static GBytes *
+gimp_scan_convert_get_key (GimpScanConvert *sc,
+                           gboolean         antialias)
+{
+  GByteArray *key = g_byte_array_new ();
+  gint        i;
 
-      cairo_destroy (cr);
-      cairo_surface_destroy (surface);
+#define APPEND(v) g_byte_array_append (key, (const guint8 *) &(v), sizeof (v))
 
-      if (tmp_buf)
+  /*  cairo_path_data_t headers have padding, so don't append them whole  */
+  for (i = 0; i < sc->path_data->len; )
+    {
+      const cairo_path_data_t *data = &g_array_index (sc->path_data,
+                                                      cairo_path_data_t, i);
+      gint                     j;
+
+      APPEND (data->header.type);
+      APPEND (data->header.length);
+
+      for (j = 1; j < data->header.length; j++)
         {
-          guchar       *dest = data;
-          const guchar *src  = tmp_buf;
-          gint          i;
+          APPEND (data[j].point.x);
+          APPEND (data[j].point.y);
+        }
 
-          for (i = 0; i < roi->height; i++)
-            {
-              memcpy (dest, src, roi->width * bpp);
+      i += MAX (data->header.length, 1);
+    }
 
-              src  += stride;
-              dest += roi->width * bpp;
-            }
+  APPEND (antialias);
+  APPEND (sc->do_stroke);
+
+  if (sc->do_stroke)
+    {
+      APPEND (sc->ratio_xy);
+      APPEND (sc->width);
+      APPEND (sc->join);
+      APPEND (sc->cap);
+      APPEND (sc->miter);
+
+      if (sc->dash_info)
+        {
+          APPEND (sc->dash_offset);
+          g_byte_array_append (key, (const guint8 *) sc->dash_info->data,
+                               sc->dash_info->len * sizeof (gdouble));
+        }
+    }
+
+#undef APPEND
+
+  return g_byte_array_free_to_bytes (key);
+}
+
+static GimpScanConvertMask *
+gimp_scan_convert_mask_new (GBytes              *key,
+                            const GeglRectangle *rect)
+{
+  GimpScanConvertMask *mask = g_slice_new (GimpScanConvertMask);
+
+  mask->key       = g_bytes_ref (key);
+  mask->rect      = *rect;
+  mask->stride    = cairo_format_stride_for_width (CAIRO_FORMAT_A8,
+                                                   rect->width);
+  mask->data      = g_malloc0 (mask->stride * rect->height);
+  mask->ref_count = 1;
+
+  return mask;
+}
+
+static void
+gimp_scan_convert_mask_unref (GimpScanConvertMask *mask)
+{
+  if (g_atomic_int_dec_and_test (&mask->ref_count))
+    {
+      g_bytes_unref (mask->key);
+      g_free (mask->data);
+      g_slice_free (GimpScanConvertMask, mask);
+    }
+}
+
+/*  returns a reference on a cached mask of the same path which covers
+ *  @rect, or NULL
+ */
+static GimpScanConvertMask *
+gimp_scan_convert_mask_lookup (GBytes              *key,
+                               const GeglRectangle *rect)
+{
+  GimpScanConvertMask *mask = NULL;
+  GList               *list;
+
+  g_mutex_lock (&mask_cache_mutex);
+
+  for (list = mask_cache.head; list; list = g_list_next (list))
+    {
+      GimpScanConvertMask *m = list->data;
+
+      if (gegl_rectangle_contains (&m->rect, rect) &&
+          g_bytes_equal (m->key, key))
+        {
+          /*  move it to the front  */
+          g_queue_unlink (&mask_cache, list);
+          g_queue_push_head_link (&mask_cache, list);
+
+          g_atomic_int_inc (&m->ref_count);
+          mask = m;
+          break;
         }
     }
+
+  g_mutex_unlock (&mask_cache_mutex);
+
+  return mask;
+}
+
+/*  adds a reference on @mask to the cache, dropping the least recently
+ *  used masks when the cache gets too large
+ */
+static void
+gimp_scan_convert_mask_insert (GimpScanConvertMask *mask)
+{
+  g_mutex_lock (&mask_cache_mutex);
+
+  g_atomic_int_inc (&mask->ref_count);
+  g_queue_push_head (&mask_cache, mask);
+  mask_cache_size += mask->stride * mask->rect.height;
+
+  while (mask_cache_size > GIMP_SCAN_CONVERT_MAX_CACHE)
+    {
+      GimpScanConvertMask *old = g_queue_pop_tail (&mask_cache);
+
+      mask_cache_size -= old->stride * old->rect.height;
+      gimp_scan_convert_mask_unref (old);
+    }
+
+  g_mutex_unlock (&mask_cache_mutex);
 }
@@ -24,6 +24,7 @@
 #include <string.h>
 
 #include <gegl.h>
+#include <glib/gstdio.h>
 
 #include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
@@ -44,7 +45,17 @@
 #include "gimp-intl.h"
 
 
-#define GIMP_TAG_CACHE_FILE  "tags.xml"
+#define GIMP_TAG_CACHE_FILE         "tags.xml"
+#define GIMP_TAG_CACHE_BINARY_FILE  "tags.bin"
+
+/*  the binary cache is a private, native-endian snapshot of tags.xml;
+ *  it is ignored if its header doesn't match or tags.xml is newer.
+ *
+ *  header, n_records * record, n_tags * guint32 tag string offset,
+ *  string table of nul-terminated strings
+ */
+#define GIMP_TAG_CACHE_BINARY_MAGIC    0x47544331  /* "GTC1" */
+#define GIMP_TAG_CACHE_BINARY_NO_STRING G_MAXUINT32
 
 /* #define DEBUG_GIMP_TAG_CACHE  1 */
 
@@ -70,10 +81,30 @@ typedef struct
   GimpTagCacheRecord  current_record;
 } GimpTagCacheParseData;
 
+typedef struct
+{
+  guint32 magic;
+  guint32 n_records;
+  guint32 n_tags;
+  guint32 strings_size;
+} GimpTagCacheBinaryHeader;
+
+typedef struct
+{
+  guint32 identifier;
+  guint32 checksum;
+  guint32 first_tag;
+  guint32 n_tags;
+} GimpTagCacheBinaryRecord;
+
 struct _GimpTagCachePriv
 {
-  GArray *records;
-  GList  *containers;
+  GArray     *records;
+  GList      *containers;
+
+  /*  quark => record index + 1  */
+  GHashTable *identifier_index;
+  GHashTable *checksum_index;
 };
 
 
@@ -111,6 +142,16 @@ static const gchar * gimp_tag_cache_attribute_name_to_value
 
 static GQuark        gimp_tag_cache_get_error_domain   (void);
 
+static void          gimp_tag_cache_build_index        (GimpTagCache           *cache);
+static GimpTagCacheRecord *
+                     gimp_tag_cache_lookup             (GimpTagCache           *cache,
+                                                        GHashTable             *index,
+                                                        GQuark                  quark);
+static gboolean      gimp_tag_cache_load_binary        (GimpTagCache           *cache,
+                                                        const gchar            *filename);
+static void          gimp_tag_cache_save_binary        (GList                  *records,
+                                                        const gchar            *filename);
+
 
 G_DEFINE_TYPE (GimpTagCache, gimp_tag_cache, GIMP_TYPE_OBJECT)
 
@@ -139,9 +180,13 @@ gimp_tag_cache_init (GimpTagCache *cache)
                                              GIMP_TYPE_TAG_CACHE,
                                              GimpTagCachePriv);
 
-  cache->priv->records    = g_array_new (FALSE, FALSE,
-                                         sizeof (GimpTagCacheRecord));
-  cache->priv->containers = NULL;
+  cache->priv->records          = g_array_new (FALSE, FALSE,
+                                               sizeof (GimpTagCacheRecord));
+  cache->priv->containers       = NULL;
+  cache->priv->identifier_index = g_hash_table_new (g_direct_hash,
+                                                    g_direct_equal);
+  cache->priv->checksum_index   = g_hash_table_new (g_direct_hash,
+                                                    g_direct_equal);
 }
 
 static void
@@ -171,6 +216,18 @@ gimp_tag_cache_finalize (GObject *object)
       cache->priv->containers = NULL;
     }
 
+  if (cache->priv->identifier_index)
+    {
+      g_hash_table_unref (cache->priv->identifier_index);
+      cache->priv->identifier_index = NULL;
+    }
+
+  if (cache->priv->checksum_index)
+    {
+      g_hash_table_unref (cache->priv->checksum_index);
+      cache->priv->checksum_index = NULL;
+    }
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -236,12 +293,12 @@ static void
 gimp_tag_cache_add_object (GimpTagCache *cache,
                            GimpTagged   *tagged)
 {
-  gchar  *identifier;
-  GQuark  identifier_quark = 0;
-  gchar  *checksum;
-  GQuark  checksum_quark = 0;
-  GList  *list;
-  gint    i;
+  GimpTagCacheRecord *rec;
+  gchar              *identifier;
+  GQuark              identifier_quark = 0;
+  gchar              *checksum;
+  GQuark              checksum_quark = 0;
+  GList              *list;
 
   identifier = gimp_tagged_get_identifier (tagged);
 
@@ -253,21 +310,18 @@ gimp_tag_cache_add_object (GimpTagCache *cache,
 
   if (identifier_quark)
     {
-      for (i = 0; i < cache->priv->records->len; i++)
-        {
-          GimpTagCacheRecord *rec = &g_array_index (cache->priv->records,
-                                                    GimpTagCacheRecord, i);
+      rec = gimp_tag_cache_lookup (cache, cache->priv->identifier_index,
+                                   identifier_quark);
 
-          if (rec->identifier == identifier_quark)
+      if (rec)
+        {
+          for (list = rec->tags; list; list = g_list_next (list))
             {
-              for (list = rec->tags; list; list = g_list_next (list))
-                {
-                  gimp_tagged_add_tag (tagged, GIMP_TAG (list->data));
-                }
-
-              rec->referenced = TRUE;
-              return;
+              gimp_tagged_add_tag (tagged, GIMP_TAG (list->data));
             }
+
+          rec->referenced = TRUE;
+          return;
         }
     }
 
@@ -281,32 +335,41 @@ gimp_tag_cache_add_object (GimpTagCache *cache,
 
   if (checksum_quark)
     {
-      for (i = 0; i < cache->priv->records->len; i++)
-        {
-          GimpTagCacheRecord *rec = &g_array_index (cache->priv->records,
-                                                    GimpTagCacheRecord, i);
+      rec = gimp_tag_cache_lookup (cache, cache->priv->checksum_index,
+                                   checksum_quark);
 
-          if (rec->checksum == checksum_quark)
-            {
+      if (rec)
+        {
 #if DEBUG_GIMP_TAG_CACHE
-              g_printerr ("remapping identifier: %s ==> %s\n",
-                          rec->identifier ? g_quark_to_string (rec->identifier) : "(NULL)",
-                          identifier_quark ? g_quark_to_string (identifier_quark) : "(NULL)");
+          g_printerr ("remapping identifier: %s ==> %s\n",
+                      rec->identifier ? g_quark_to_string (rec->identifier) : "(NULL)",
+                      identifier_quark ? g_quark_to_string (identifier_quark) : "(NULL)");
 #endif
 
-              rec->identifier = identifier_quark;
+          g_hash_table_remove (cache->priv->identifier_index,
+                               GUINT_TO_POINTER (rec->identifier));
 
-              for (list = rec->tags; list; list = g_list_next (list))
-                {
-                  gimp_tagged_add_tag (tagged, GIMP_TAG (list->data));
-                }
+          rec->identifier = identifier_quark;
+
+          if (identifier_quark)
+            {
+              guint index = rec - &g_array_index (cache->priv->records,
+                                                  GimpTagCacheRecord, 0);
 
-              rec->referenced = TRUE;
-              return;
+              g_hash_table_insert (cache->priv->identifier_index,
+                                   GUINT_TO_POINTER (identifier_quark),
+                                   GUINT_TO_POINTER (index + 1));
             }
+
+          for (list = rec->tags; list; list = g_list_next (list))
+            {
+              gimp_tagged_add_tag (tagged, GIMP_TAG (list->data));
+            }
+
+          rec->referenced = TRUE;
+          return;
         }
     }
-
 }
 
 static void
@@ -316,26 +379,46 @@ gimp_tag_cache_object_initialize (GimpTagged   *tagged,
   gimp_tag_cache_add_object (cache, tagged);
 }
 
+typedef struct
+{
+  GimpTagCache *cache;
+  GList        *records;
+} GimpTagCacheSaveData;
+
 static void
-gimp_tag_cache_tagged_to_cache_record_foreach (GimpTagged  *tagged,
-                                               GList      **cache_records)
+gimp_tag_cache_tagged_to_cache_record_foreach (GimpTagged           *tagged,
+                                               GimpTagCacheSaveData *data)
 {
   gchar *identifier = gimp_tagged_get_identifier (tagged);
 
   if (identifier)
     {
       GimpTagCacheRecord *cache_rec = g_new (GimpTagCacheRecord, 1);
-      gchar              *checksum;
-
-      checksum = gimp_tagged_get_checksum (tagged);
+      GimpTagCacheRecord *loaded_rec;
 
       cache_rec->identifier = g_quark_from_string (identifier);
-      cache_rec->checksum   = g_quark_from_string (checksum);
+      cache_rec->checksum   = 0;
       cache_rec->tags       = g_list_copy (gimp_tagged_get_tags (tagged));
 
-      g_free (checksum);
+      /*  don't compute the checksum again if the object was matched
+       *  against a loaded record, it may require loading its data
+       */
+      loaded_rec = gimp_tag_cache_lookup (data->cache,
+                                          data->cache->priv->identifier_index,
+                                          cache_rec->identifier);
+
+      if (loaded_rec && loaded_rec->referenced)
+        cache_rec->checksum = loaded_rec->checksum;
+
+      if (! cache_rec->checksum)
+        {
+          gchar *checksum = gimp_tagged_get_checksum (tagged);
 
-      *cache_records = g_list_prepend (*cache_records, cache_rec);
+          cache_rec->checksum = g_quark_from_string (checksum);
+          g_free (checksum);
+        }
+
+      data->records = g_list_prepend (data->records, cache_rec);
     }
 
   g_free (identifier);
@@ -350,12 +433,13 @@ gimp_tag_cache_tagged_to_cache_record_foreach (GimpTagged  *tagged,
 void
 gimp_tag_cache_save (GimpTagCache *cache)
 {
-  GString *buf;
-  GList   *saved_records;
-  GList   *iterator;
-  gchar   *filename;
-  GError  *error = NULL;
-  gint     i;
+  GimpTagCacheSaveData  data;
+  GString              *buf;
+  GList                *saved_records;
+  GList                *iterator;
+  gchar                *filename;
+  GError               *error = NULL;
+  gint                  i;
 
   g_return_if_fail (GIMP_IS_TAG_CACHE (cache));
 
@@ -380,16 +464,19 @@ gimp_tag_cache_save (GimpTagCache *cache)
         }
     }
 
+  data.cache   = cache;
+  data.records = saved_records;
+
   for (iterator = cache->priv->containers;
        iterator;
        iterator = g_list_next (iterator))
     {
       gimp_container_foreach (GIMP_CONTAINER (iterator->data),
                               (GFunc) gimp_tag_cache_tagged_to_cache_record_foreach,
-                              &saved_records);
+                              &data);
     }
 
-  saved_records = g_list_reverse (saved_records);
+  saved_records = g_list_reverse (data.records);
 
   buf = g_string_new ("");
   g_string_append (buf, "<?xml version='1.0' encoding='UTF-8'?>\n");
@@ -439,6 +526,11 @@ gimp_tag_cache_save (GimpTagCache *cache)
 
   g_string_free (buf, TRUE);
 
+  filename = g_build_filename (gimp_directory (), GIMP_TAG_CACHE_BINARY_FILE,
+                               NULL);
+  gimp_tag_cache_save_binary (saved_records, filename);
+  g_free (filename);
+
   for (iterator = saved_records;
        iterator;
        iterator = g_list_next (iterator))
@@ -472,6 +564,18 @@ gimp_tag_cache_load (GimpTagCache *cache)
   /* clear any previous priv->records */
   cache->priv->records = g_array_set_size (cache->priv->records, 0);
 
+  filename = g_build_filename (gimp_directory (), GIMP_TAG_CACHE_BINARY_FILE,
+                               NULL);
+
+  if (gimp_tag_cache_load_binary (cache, filename))
+    {
+      g_free (filename);
+      gimp_tag_cache_build_index (cache);
+      return;
+    }
+
+  g_free (filename);
+
   filename = g_build_filename (gimp_directory (), GIMP_TAG_CACHE_FILE, NULL);
 
   parse_data.records = g_array_new (FALSE, FALSE, sizeof (GimpTagCacheRecord));
@@ -500,6 +604,8 @@ gimp_tag_cache_load (GimpTagCache *cache)
   g_free (filename);
   gimp_xml_parser_free (xml_parser);
   g_array_free (parse_data.records, TRUE);
+
+  gimp_tag_cache_build_index (cache);
 }
 
 static  void
@@ -628,3 +734,288 @@ gimp_tag_cache_get_error_domain (void)
 {
   return g_quark_from_static_string ("gimp-tag-cache-error-quark");
 }
+
+static void
+gimp_tag_cache_build_index (GimpTagCache *cache)
+{
+  gint i;
+
+  g_hash_table_remove_all (cache->priv->identifier_index);
+  g_hash_table_remove_all (cache->priv->checksum_index);
+
+  /*  the first record with a given identifier or checksum wins, like
+   *  a linear search over the records would do
+   */
+  for (i = (gint) cache->priv->records->len - 1; i >= 0; i--)
+    {
+      GimpTagCacheRecord *rec = &g_array_index (cache->priv->records,
+                                                GimpTagCacheRecord, i);
+
+      if (rec->identifier)
+        g_hash_table_insert (cache->priv->identifier_index,
+                             GUINT_TO_POINTER (rec->identifier),
+                             GUINT_TO_POINTER (i + 1));
+
+      if (rec->checksum)
+        g_hash_table_insert (cache->priv->checksum_index,
+                             GUINT_TO_POINTER (rec->checksum),
+                             GUINT_TO_POINTER (i + 1));
+    }
+}
+
+static GimpTagCacheRecord *
+gimp_tag_cache_lookup (GimpTagCache *cache,
+                       GHashTable   *index,
+                       GQuark        quark)
+{
+  guint i = GPOINTER_TO_UINT (g_hash_table_lookup (index,
+                                                   GUINT_TO_POINTER (quark)));
+
+  if (i == 0)
+    return NULL;
+
+  return &g_array_index (cache->priv->records, GimpTagCacheRecord, i - 1);
+}
+
+static const gchar *
+gimp_tag_cache_binary_string (const gchar *strings,
+                              guint32      strings_size,
+                              guint32      offset)
+{
+  if (offset >= strings_size || ! memchr (strings + offset, '\0',
+                                          strings_size - offset))
+    return NULL;
+
+  return strings + offset;
+}
+
+static gboolean
+gimp_tag_cache_load_binary (GimpTagCache *cache,
+                            const gchar  *filename)
+{
+  GMappedFile                    *file;
+  const GimpTagCacheBinaryHeader *header;
+  const GimpTagCacheBinaryRecord *records;
+  const guint32                  *tags;
+  const gchar                    *strings;
+  gchar                          *xml_filename;
+  GStatBuf                        bin_stat;
+  GStatBuf                        xml_stat;
+  gsize                           size;
+  GArray                         *loaded;
+  gboolean                        success = TRUE;
+  guint32                         i;
+
+  /*  tags.xml may have been replaced to import tags, it always wins
+   *  over an older binary cache
+   */
+  xml_filename = g_build_filename (gimp_directory (), GIMP_TAG_CACHE_FILE,
+                                   NULL);
+
+  if (g_stat (filename, &bin_stat) != 0 ||
+      (g_stat (xml_filename, &xml_stat) == 0 &&
+       xml_stat.st_mtime > bin_stat.st_mtime))
+    {
+      g_free (xml_filename);
+      return FALSE;
+    }
+
+  g_free (xml_filename);
+
+  file = g_mapped_file_new (filename, FALSE, NULL);
+
+  if (! file)
+    return FALSE;
+
+  size   = g_mapped_file_get_length (file);
+  header = (const GimpTagCacheBinaryHeader *) g_mapped_file_get_contents (file);
+
+  if (size < sizeof (GimpTagCacheBinaryHeader)          ||
+      header->magic != GIMP_TAG_CACHE_BINARY_MAGIC      ||
+      header->n_records > size / sizeof (GimpTagCacheBinaryRecord) ||
+      header->n_tags    > size / sizeof (guint32)       ||
+      size != (sizeof (GimpTagCacheBinaryHeader)                        +
+               (gsize) header->n_records * sizeof (GimpTagCacheBinaryRecord) +
+               (gsize) header->n_tags    * sizeof (guint32)             +
+               header->strings_size))
+    {
+      g_mapped_file_unref (file);
+      return FALSE;
+    }
+
+  records = (const GimpTagCacheBinaryRecord *) (header + 1);
+  tags    = (const guint32 *) (records + header->n_records);
+  strings = (const gchar *) (tags + header->n_tags);
+
+  loaded = g_array_sized_new (FALSE, FALSE, sizeof (GimpTagCacheRecord),
+                              header->n_records);
+
+  for (i = 0; success && i < header->n_records; i++)
+    {
+      GimpTagCacheRecord  rec = { 0, };
+      const gchar        *identifier;
+      const gchar        *checksum = NULL;
+      guint32             j;
+
+      identifier = gimp_tag_cache_binary_string (strings, header->strings_size,
+                                                 records[i].identifier);
+
+      if (records[i].checksum != GIMP_TAG_CACHE_BINARY_NO_STRING)
+        checksum = gimp_tag_cache_binary_string (strings, header->strings_size,
+                                                 records[i].checksum);
+
+      if (! identifier ||
+          (! checksum &&
+           records[i].checksum != GIMP_TAG_CACHE_BINARY_NO_STRING) ||
+          records[i].first_tag > header->n_tags ||
+          records[i].n_tags    > header->n_tags - records[i].first_tag)
+        {
+          success = FALSE;
+          break;
+        }
+
+      rec.identifier = g_quark_from_string (identifier);
+      rec.checksum   = checksum ? g_quark_from_string (checksum) : 0;
+
+      for (j = 0; j < records[i].n_tags; j++)
+        {
+          const gchar *name;
+          GimpTag     *tag = NULL;
+
+          name = gimp_tag_cache_binary_string (strings, header->strings_size,
+                                               tags[records[i].first_tag + j]);
+
+          if (name)
+            tag = gimp_tag_new (name);
+
+          if (tag)
+            rec.tags = g_list_prepend (rec.tags, tag);
+        }
+
+      rec.tags = g_list_reverse (rec.tags);
+
+      g_array_append_val (loaded, rec);
+    }
+
+  if (success)
+    {
+      cache->priv->records = g_array_append_vals (cache->priv->records,
+                                                  loaded->data, loaded->len);
+    }
+  else
+    {
+      for (i = 0; i < loaded->len; i++)
+        g_list_free_full (g_array_index (loaded, GimpTagCacheRecord, i).tags,
+                          (GDestroyNotify) g_object_unref);
+
+      g_printerr ("Ignoring corrupt binary tag cache\n");
+    }
+
+  g_array_free (loaded, TRUE);
+  g_mapped_file_unref (file);
+
+  return success;
+}
+
+static guint32
+gimp_tag_cache_binary_add_string (GString     *strings,
+                                  GHashTable  *offsets,
+                                  const gchar *string)
+{
+  gpointer offset;
+
+  if (! string)
+    return GIMP_TAG_CACHE_BINARY_NO_STRING;
+
+  if (! g_hash_table_lookup_extended (offsets, string, NULL, &offset))
+    {
+      offset = GUINT_TO_POINTER (strings->len);
+
+      g_string_append_len (strings, string, strlen (string) + 1);
+      g_hash_table_insert (offsets, (gpointer) string, offset);
+    }
+
+  return GPOINTER_TO_UINT (offset);
+}
+
+static void
+gimp_tag_cache_save_binary (GList       *records,
+                            const gchar *filename)
+{
+  GimpTagCacheBinaryHeader  header;
+  GArray                   *bin_records;
+  GArray                   *bin_tags;
+  GString                  *strings;
+  GHashTable               *offsets;
+  GString                  *buf;
+  GList                    *iterator;
+  GError                   *error = NULL;
+
+  bin_records = g_array_new (FALSE, FALSE, sizeof (GimpTagCacheBinaryRecord));
+  bin_tags    = g_array_new (FALSE, FALSE, sizeof (guint32));
+  strings     = g_string_new (NULL);
+  offsets     = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (iterator = records; iterator; iterator = g_list_next (iterator))
+    {
+      GimpTagCacheRecord       *cache_rec = iterator->data;
+      GimpTagCacheBinaryRecord  bin_rec;
+      GList                    *list;
+
+      bin_rec.identifier =
+        gimp_tag_cache_binary_add_string (strings, offsets,
+                                          g_quark_to_string (cache_rec->identifier));
+      bin_rec.checksum   =
+        gimp_tag_cache_binary_add_string (strings, offsets,
+                                          g_quark_to_string (cache_rec->checksum));
+      bin_rec.first_tag  = bin_tags->len;
+      bin_rec.n_tags     = 0;
+
+      for (list = cache_rec->tags; list; list = g_list_next (list))
+        {
+          GimpTag *tag = GIMP_TAG (list->data);
+
+          if (! gimp_tag_get_internal (tag))
+            {
+              guint32 offset;
+
+              offset = gimp_tag_cache_binary_add_string (strings, offsets,
+                                                         gimp_tag_get_name (tag));
+
+              g_array_append_val (bin_tags, offset);
+              bin_rec.n_tags++;
+            }
+        }
+
+      g_array_append_val (bin_records, bin_rec);
+    }
+
+  header.magic        = GIMP_TAG_CACHE_BINARY_MAGIC;
+  header.n_records    = bin_records->len;
+  header.n_tags       = bin_tags->len;
+  header.strings_size = strings->len;
+
+  buf = g_string_sized_new (sizeof (header) +
+                            bin_records->len * sizeof (GimpTagCacheBinaryRecord) +
+                            bin_tags->len    * sizeof (guint32) +
+                            strings->len);
+
+  g_string_append_len (buf, (const gchar *) &header, sizeof (header));
+  g_string_append_len (buf, bin_records->data,
+                       bin_records->len * sizeof (GimpTagCacheBinaryRecord));
+  g_string_append_len (buf, bin_tags->data,
+                       bin_tags->len * sizeof (guint32));
+  g_string_append_len (buf, strings->str, strings->len);
+
+  if (! g_file_set_contents (filename, buf->str, buf->len, &error))
+    {
+      g_printerr ("Error while saving binary tag cache: %s\n", error->message);
+      g_error_free (error);
+    }
+
+  g_string_free (buf, TRUE);
+  g_hash_table_unref (offsets);
+  g_string_free (strings, TRUE);
+  g_array_free (bin_tags, TRUE);
+  g_array_free (bin_records, TRUE);
+}
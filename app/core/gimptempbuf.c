@@ -17,12 +17,31 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <string.h>
 
+#include <sys/types.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <fcntl.h>
+
 #include <cairo.h>
 #include <gegl.h>
 #include <glib/gstdio.h>
 
+#ifdef G_OS_WIN32
+#include <io.h>
+#endif
+
+#ifndef _O_BINARY
+#define _O_BINARY 0
+#endif
+
+#include "libgimpbase/gimpbase.h"
+
 #include "core-types.h"
 
 #include "gimptempbuf.h"
@@ -35,9 +54,51 @@ struct _GimpTempBuf
   gint        height;
   const Babl *format;
   guchar     *data;
+
+  /*  lazily loaded buffers  */
+  gchar      *filename;
+  goffset     offset;
+  gint        file_bpp;   /*  bytes per pixel in the file      */
+  gint        component;  /*  first byte of our pixel in there  */
 };
 
 
+/*  pixel data is allocated aligned to this many bytes, so SIMD code
+ *  can use aligned loads on the start of every buffer
+ */
+#define DATA_ALIGNMENT     64
+
+/*  freed pixel data of up to 1 MiB is kept in power-of-two size
+ *  classes for reuse, at most POOL_CLASS_BUDGET bytes per class
+ */
+#define POOL_MIN_SHIFT     6
+#define POOL_MAX_SHIFT     20
+#define POOL_N_CLASSES     (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
+#define POOL_CLASS_BUDGET  (2 << 20)
+
+
+typedef struct
+{
+  gpointer free_list;  /*  linked through the first word of each block  */
+  gsize    n_free;
+} PoolClass;
+
+
+static void     gimp_temp_buf_load       (GimpTempBuf *buf);
+
+static gint     gimp_temp_buf_pool_class (gsize        size);
+static guchar * gimp_temp_buf_data_alloc (gsize        size);
+static void     gimp_temp_buf_data_free  (guchar      *data,
+                                          gsize        size);
+
+
+static GMutex    pool_mutex;
+static PoolClass pool_classes[POOL_N_CLASSES];
+static guint64   pool_bytes  = 0;
+static gulong    pool_hits   = 0;
+static gulong    pool_misses = 0;
+
+
 GimpTempBuf *
 gimp_temp_buf_new (gint        width,
                    gint        height,
@@ -54,9 +115,92 @@ gimp_temp_buf_new (gint        width,
   temp->width     = width;
   temp->height    = height;
   temp->format    = format;
-  temp->data      = g_new (guchar,
-                           width * height *
-                           babl_format_get_bytes_per_pixel (format));
+  temp->data      = gimp_temp_buf_data_alloc (width * height *
+                                              babl_format_get_bytes_per_pixel (format));
+  temp->filename  = NULL;
+  temp->offset    = 0;
+  temp->file_bpp  = 0;
+  temp->component = 0;
+
+  return temp;
+}
+
+/**
+ * gimp_temp_buf_new_lazy:
+ * @width:    width of the buffer
+ * @height:   height of the buffer
+ * @format:   pixel format of the buffer
+ * @filename: file containing the raw pixel data
+ * @offset:   position of the pixel data in @filename
+ *
+ * Creates a temp buf whose pixels are read from @filename only when
+ * they are first accessed using gimp_temp_buf_get_data(). The pixel
+ * data must be stored in @format without any compression or padding.
+ *
+ * Return value: the new temp buf.
+ **/
+GimpTempBuf *
+gimp_temp_buf_new_lazy (gint         width,
+                        gint         height,
+                        const Babl  *format,
+                        const gchar *filename,
+                        goffset      offset)
+{
+  g_return_val_if_fail (format != NULL, NULL);
+
+  return gimp_temp_buf_new_lazy_interleaved (width, height, format,
+                                             filename, offset,
+                                             babl_format_get_bytes_per_pixel (format),
+                                             0);
+}
+
+/**
+ * gimp_temp_buf_new_lazy_interleaved:
+ * @width:     width of the buffer
+ * @height:    height of the buffer
+ * @format:    pixel format of the buffer
+ * @filename:  file containing the raw pixel data
+ * @offset:    position of the pixel data in @filename
+ * @file_bpp:  number of bytes per pixel in @filename
+ * @component: position of the buffer's bytes within each file pixel
+ *
+ * Like gimp_temp_buf_new_lazy(), but the file stores @file_bpp bytes
+ * per pixel of which only the ones starting at @component belong to
+ * this buffer. This allows to split e.g. an RGBA file lazily into a
+ * separate color and alpha buffer.
+ *
+ * Return value: the new temp buf.
+ **/
+GimpTempBuf *
+gimp_temp_buf_new_lazy_interleaved (gint         width,
+                                    gint         height,
+                                    const Babl  *format,
+                                    const gchar *filename,
+                                    goffset      offset,
+                                    gint         file_bpp,
+                                    gint         component)
+{
+  GimpTempBuf *temp;
+
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+  g_return_val_if_fail (format != NULL, NULL);
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (offset >= 0, NULL);
+  g_return_val_if_fail (component >= 0, NULL);
+  g_return_val_if_fail (component + babl_format_get_bytes_per_pixel (format) <=
+                        file_bpp, NULL);
+
+  temp = g_slice_new (GimpTempBuf);
+
+  temp->ref_count = 1;
+  temp->width     = width;
+  temp->height    = height;
+  temp->format    = format;
+  temp->data      = NULL;
+  temp->filename  = g_strdup (filename);
+  temp->offset    = offset;
+  temp->file_bpp  = file_bpp;
+  temp->component = component;
 
   return temp;
 }
@@ -98,7 +242,10 @@ gimp_temp_buf_unref (GimpTempBuf *buf)
   if (buf->ref_count < 1)
     {
       if (buf->data)
-        g_free (buf->data);
+        gimp_temp_buf_data_free (buf->data,
+                                 gimp_temp_buf_get_data_size (buf));
+
+      g_free (buf->filename);
 
       g_slice_free (GimpTempBuf, buf);
     }
@@ -190,6 +337,9 @@ gimp_temp_buf_set_format (GimpTempBuf *buf,
 guchar *
 gimp_temp_buf_get_data (const GimpTempBuf *buf)
 {
+  if (G_UNLIKELY (! buf->data))
+    gimp_temp_buf_load ((GimpTempBuf *) buf);
+
   return buf->data;
 }
 
@@ -202,20 +352,158 @@ gimp_temp_buf_get_data_size (const GimpTempBuf *buf)
 guchar *
 gimp_temp_buf_data_clear (GimpTempBuf *buf)
 {
+  if (! buf->data)
+    {
+      buf->data = gimp_temp_buf_data_alloc (gimp_temp_buf_get_data_size (buf));
+
+      g_free (buf->filename);
+      buf->filename = NULL;
+    }
+
   memset (buf->data, 0, gimp_temp_buf_get_data_size (buf));
 
   return buf->data;
 }
 
+gboolean
+gimp_temp_buf_is_loaded (const GimpTempBuf *buf)
+{
+  g_return_val_if_fail (buf != NULL, FALSE);
+
+  return buf->data != NULL;
+}
+
+/**
+ * gimp_temp_buf_unload:
+ * @buf: a #GimpTempBuf
+ *
+ * Frees the pixel data of a buffer created with
+ * gimp_temp_buf_new_lazy(), so it is read from its file again on the
+ * next access. Nothing happens if @buf is not backed by a file or if
+ * anybody else holds a reference, since a #GeglBuffer created with
+ * gimp_temp_buf_create_buffer() points right into the pixel data.
+ *
+ * The caller must make sure the pixels were not modified since they
+ * were loaded, and that no pointer returned by
+ * gimp_temp_buf_get_data() is still in use.
+ *
+ * Return value: %TRUE if the pixel data was freed.
+ **/
+gboolean
+gimp_temp_buf_unload (GimpTempBuf *buf)
+{
+  g_return_val_if_fail (buf != NULL, FALSE);
+
+  if (! buf->data || ! buf->filename || buf->ref_count > 1)
+    return FALSE;
+
+  gimp_temp_buf_data_free (buf->data, gimp_temp_buf_get_data_size (buf));
+  buf->data = NULL;
+
+  return TRUE;
+}
+
+/**
+ * gimp_temp_buf_update_checksum:
+ * @buf:      a #GimpTempBuf
+ * @checksum: a #GChecksum
+ *
+ * Feeds the pixel data of @buf into @checksum. If @buf was created
+ * with gimp_temp_buf_new_lazy() and has not been accessed yet, the
+ * data is streamed from its file without loading it into memory.
+ **/
+void
+gimp_temp_buf_update_checksum (const GimpTempBuf *buf,
+                               GChecksum         *checksum)
+{
+  g_return_if_fail (buf != NULL);
+  g_return_if_fail (checksum != NULL);
+
+  if (! buf->data &&
+      buf->file_bpp == babl_format_get_bytes_per_pixel (buf->format))
+    {
+      gsize size = gimp_temp_buf_get_data_size (buf);
+      gint  fd;
+
+      fd = g_open (buf->filename, O_RDONLY | _O_BINARY, 0);
+
+      if (fd != -1 && lseek (fd, buf->offset, SEEK_SET) == buf->offset)
+        {
+          guchar chunk[8 * 1024];
+
+          while (size > 0)
+            {
+              gssize n = read (fd, chunk, MIN (size, sizeof (chunk)));
+
+              if (n <= 0)
+                break;
+
+              g_checksum_update (checksum, chunk, n);
+              size -= n;
+            }
+        }
+
+      if (fd != -1)
+        close (fd);
+
+      if (size == 0)
+        return;
+
+      /*  the file changed under our feet, fall back to loading it,
+       *  which also takes care of reporting the error
+       */
+    }
+
+  g_checksum_update (checksum,
+                     gimp_temp_buf_get_data (buf),
+                     gimp_temp_buf_get_data_size (buf));
+}
+
 gsize
 gimp_temp_buf_get_memsize (const GimpTempBuf *buf)
 {
   if (buf)
-    return (sizeof (GimpTempBuf) + gimp_temp_buf_get_data_size (buf));
+    {
+      gsize memsize = sizeof (GimpTempBuf);
+
+      if (buf->data)
+        memsize += gimp_temp_buf_get_data_size (buf);
+
+      if (buf->filename)
+        memsize += strlen (buf->filename) + 1;
+
+      return memsize;
+    }
 
   return 0;
 }
 
+/**
+ * gimp_temp_buf_get_pool_stats:
+ * @pooled: return location for the number of bytes of freed pixel
+ *          data kept for reuse
+ * @hits:   return location for the number of allocations served from
+ *          the pool
+ * @misses: return location for the number of poolable allocations
+ *          that had to go to the system allocator
+ *
+ * Returns statistics about the pool that temp buf pixel data is
+ * recycled through.
+ **/
+void
+gimp_temp_buf_get_pool_stats (guint64 *pooled,
+                              gulong  *hits,
+                              gulong  *misses)
+{
+  g_mutex_lock (&pool_mutex);
+
+  if (pooled) *pooled = pool_bytes;
+  if (hits)   *hits   = pool_hits;
+  if (misses) *misses = pool_misses;
+
+  g_mutex_unlock (&pool_mutex);
+}
+
 GeglBuffer  *
 gimp_temp_buf_create_buffer (GimpTempBuf *temp_buf)
 {
@@ -245,3 +533,177 @@ gimp_gegl_buffer_get_temp_buf (GeglBuffer *buffer)
 
   return g_object_get_data (G_OBJECT (buffer), "gimp-temp-buf");
 }
+
+
+/*  private functions  */
+
+static void
+gimp_temp_buf_load (GimpTempBuf *buf)
+{
+  gsize  size = gimp_temp_buf_get_data_size (buf);
+  gint   bpp  = babl_format_get_bytes_per_pixel (buf->format);
+  gsize  done = 0;
+  gint   fd;
+
+  buf->data = gimp_temp_buf_data_alloc (size);
+  memset (buf->data, 0, size);
+
+  fd = g_open (buf->filename, O_RDONLY | _O_BINARY, 0);
+
+  if (fd != -1 && lseek (fd, buf->offset, SEEK_SET) == buf->offset)
+    {
+      if (buf->file_bpp == bpp)
+        {
+          while (done < size)
+            {
+              gssize n = read (fd, buf->data + done, size - done);
+
+              if (n <= 0)
+                break;
+
+              done += n;
+            }
+        }
+      else
+        {
+          guchar chunk[8 * 1024];
+          gsize  chunk_pixels = sizeof (chunk) / buf->file_bpp;
+
+          while (done < size)
+            {
+              gsize         n_pixels = MIN (chunk_pixels, (size - done) / bpp);
+              gssize        n_bytes  = n_pixels * buf->file_bpp;
+              const guchar *src      = chunk + buf->component;
+              guchar       *dest     = buf->data + done;
+
+              if (read (fd, chunk, n_bytes) != n_bytes)
+                break;
+
+              while (n_pixels--)
+                {
+                  memcpy (dest, src, bpp);
+
+                  src  += buf->file_bpp;
+                  dest += bpp;
+                }
+
+              done = dest - buf->data;
+            }
+        }
+    }
+
+  if (done < size)
+    g_printerr ("Could not read pixel data from '%s': %s\n",
+                gimp_filename_to_utf8 (buf->filename),
+                fd == -1 ? g_strerror (errno) : "File appears truncated.");
+
+  if (fd != -1)
+    close (fd);
+
+  /*  keep the filename around, so the data can be dropped again
+   *  using gimp_temp_buf_unload(), unless it was broken
+   */
+  if (done < size)
+    {
+      g_free (buf->filename);
+      buf->filename = NULL;
+    }
+}
+
+static gint
+gimp_temp_buf_pool_class (gsize size)
+{
+  gint shift = POOL_MIN_SHIFT;
+
+  while (((gsize) 1 << shift) < size)
+    shift++;
+
+  if (shift > POOL_MAX_SHIFT)
+    return -1;
+
+  return shift - POOL_MIN_SHIFT;
+}
+
+/*  The block in front of the aligned data stores the pointer that
+ *  was returned by g_malloc().
+ */
+static guchar *
+gimp_temp_buf_data_alloc (gsize size)
+{
+  gint     size_class = gimp_temp_buf_pool_class (size);
+  guchar  *raw;
+  guchar  *data;
+
+  if (size_class >= 0)
+    {
+      PoolClass *pool = &pool_classes[size_class];
+
+      g_mutex_lock (&pool_mutex);
+
+      if (pool->free_list)
+        {
+          data = pool->free_list;
+
+          pool->free_list = *(gpointer *) data;
+          pool->n_free--;
+
+          pool_bytes -= (gsize) 1 << (size_class + POOL_MIN_SHIFT);
+          pool_hits++;
+
+          g_mutex_unlock (&pool_mutex);
+
+          return data;
+        }
+
+      pool_misses++;
+
+      g_mutex_unlock (&pool_mutex);
+
+      /*  allocate the full class size, so the block can be reused for
+       *  any request of this class
+       */
+      size = (gsize) 1 << (size_class + POOL_MIN_SHIFT);
+    }
+
+  raw  = g_malloc (size + DATA_ALIGNMENT + sizeof (gpointer));
+  data = (guchar *) (((guintptr) raw + sizeof (gpointer) + DATA_ALIGNMENT - 1) &
+                     ~((guintptr) DATA_ALIGNMENT - 1));
+
+  ((gpointer *) data)[-1] = raw;
+
+  return data;
+}
+
+static void
+gimp_temp_buf_data_free (guchar *data,
+                         gsize   size)
+{
+  gint size_class = gimp_temp_buf_pool_class (size);
+
+  if (size_class >= 0)
+    {
+      PoolClass *pool       = &pool_classes[size_class];
+      gsize      class_size = (gsize) 1 << (size_class + POOL_MIN_SHIFT);
+
+      g_mutex_lock (&pool_mutex);
+
+      if ((pool->n_free + 1) * class_size <= POOL_CLASS_BUDGET ||
+          pool->n_free < 2)
+        {
+          *(gpointer *) data = pool->free_list;
+
+          pool->free_list = data;
+          pool->n_free++;
+
+          pool_bytes += class_size;
+
+          g_mutex_unlock (&pool_mutex);
+
+          return;
+        }
+
+      g_mutex_unlock (&pool_mutex);
+    }
+
+  g_free (((gpointer *) data)[-1]);
+}
@@ -22,6 +22,19 @@
 GimpTempBuf * gimp_temp_buf_new             (gint               width,
                                              gint               height,
                                              const Babl        *fomat) G_GNUC_WARN_UNUSED_RESULT;
+GimpTempBuf * gimp_temp_buf_new_lazy        (gint               width,
+                                             gint               height,
+                                             const Babl        *format,
+                                             const gchar       *filename,
+                                             goffset            offset) G_GNUC_WARN_UNUSED_RESULT;
+GimpTempBuf * gimp_temp_buf_new_lazy_interleaved
+                                            (gint               width,
+                                             gint               height,
+                                             const Babl        *format,
+                                             const gchar       *filename,
+                                             goffset            offset,
+                                             gint               file_bpp,
+                                             gint               component) G_GNUC_WARN_UNUSED_RESULT;
 GimpTempBuf * gimp_temp_buf_copy            (const GimpTempBuf *src) G_GNUC_WARN_UNUSED_RESULT;
 
 GimpTempBuf * gimp_temp_buf_ref             (GimpTempBuf       *buf);
@@ -43,8 +56,17 @@ gsize         gimp_temp_buf_get_data_size   (const GimpTempBuf *buf);
 
 guchar      * gimp_temp_buf_data_clear      (GimpTempBuf       *buf);
 
+gboolean      gimp_temp_buf_is_loaded       (const GimpTempBuf *buf);
+gboolean      gimp_temp_buf_unload          (GimpTempBuf       *buf);
+void          gimp_temp_buf_update_checksum (const GimpTempBuf *buf,
+                                             GChecksum         *checksum);
+
 gsize         gimp_temp_buf_get_memsize     (const GimpTempBuf *buf);
 
+void          gimp_temp_buf_get_pool_stats  (guint64           *pooled,
+                                             gulong            *hits,
+                                             gulong            *misses);
+
 GeglBuffer  * gimp_temp_buf_create_buffer   (GimpTempBuf       *temp_buf) G_GNUC_WARN_UNUSED_RESULT;
 GimpTempBuf * gimp_gegl_buffer_get_temp_buf (GeglBuffer        *buffer);
 
@@ -172,6 +172,12 @@ static void
 gimp_undo_init (GimpUndo *undo)
 {
   undo->time = time (NULL);
+
+  /*  undo steps don't change after they are pushed, so caching their
+   *  size keeps gimp_image_undo_free_space() from walking all their
+   *  tiles again and again
+   */
+  gimp_object_set_memsize_cached (GIMP_OBJECT (undo), TRUE);
 }
 
 static void
@@ -496,6 +502,8 @@ gimp_undo_create_preview_private (GimpUndo    *undo,
   undo->preview = gimp_viewable_get_new_preview (preview_viewable, context,
                                                  width, height);
 
+  gimp_object_memsize_changed (GIMP_OBJECT (undo));
+
   gimp_viewable_invalidate_preview (GIMP_VIEWABLE (undo));
 }
 
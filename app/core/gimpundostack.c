@@ -63,6 +63,10 @@ static void
 gimp_undo_stack_init (GimpUndoStack *stack)
 {
   stack->undos = gimp_list_new (GIMP_TYPE_UNDO, FALSE);
+
+  gimp_object_set_memsize_cached (GIMP_OBJECT (stack->undos), TRUE);
+  gimp_object_set_memsize_parent (GIMP_OBJECT (stack->undos),
+                                  GIMP_OBJECT (stack));
 }
 
 static void
@@ -72,6 +76,7 @@ gimp_undo_stack_finalize (GObject *object)
 
   if (stack->undos)
     {
+      gimp_object_set_memsize_parent (GIMP_OBJECT (stack->undos), NULL);
       g_object_unref (stack->undos);
       stack->undos = NULL;
     }
@@ -308,6 +308,10 @@ static const GimpDialogFactoryEntry entries[] =
             N_("Errors"), N_("Error Console"), GIMP_STOCK_WARNING,
             GIMP_HELP_ERRORS_DIALOG,
             dialogs_error_console_new, 0, TRUE),
+  DOCKABLE ("gimp-dashboard",
+            N_("Dashboard"), NULL, GIMP_STOCK_TOOL_MEASURE,
+            GIMP_HELP_DASHBOARD_DIALOG,
+            dialogs_dashboard_new, 0, TRUE),
   DOCKABLE ("gimp-cursor-view",
             N_("Pointer"), N_("Pointer Information"), GIMP_STOCK_CURSOR,
             GIMP_HELP_POINTER_INFO_DIALOG,
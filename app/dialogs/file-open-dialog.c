@@ -55,6 +55,11 @@ static GimpImage *file_open_dialog_open_image  (GtkWidget           *open_dialog
                                                 const gchar         *uri,
                                                 const gchar         *entered_filename,
                                                 GimpPlugInProcedure *load_proc);
+static void       file_open_dialog_image_opened (GimpImage         *image,
+                                                const gchar         *uri,
+                                                GimpPDBStatusType    status,
+                                                const GError        *error,
+                                                Gimp                *gimp);
 static gboolean   file_open_dialog_open_layers (GtkWidget           *open_dialog,
                                                 GimpImage           *image,
                                                 const gchar         *uri,
@@ -125,15 +130,6 @@ file_open_dialog_response (GtkWidget *open_dialog,
 
   gimp_file_dialog_set_sensitive (dialog, FALSE);
 
-  /* When we are going to open new image windows, unset the transient
-   * window. We don't need it since we will use gdk_window_raise() to
-   * keep the dialog on top. And if we don't do it, then the dialog
-   * will pull the image window it was invoked from on top of all the
-   * new opened image windows, and we don't want that to happen.
-   */
-  if (! dialog->open_as_layers)
-    gtk_window_set_transient_for (GTK_WINDOW (open_dialog), NULL);
-
   for (list = uris; list; list = g_slist_next (list))
     {
       gchar *filename = file_utils_filename_from_uri (list->data);
@@ -172,19 +168,20 @@ file_open_dialog_response (GtkWidget *open_dialog,
         }
       else
         {
-          if (file_open_dialog_open_image (open_dialog,
-                                           gimp,
-                                           list->data,
-                                           list->data,
-                                           dialog->file_proc))
-            {
-              success = TRUE;
-
-              /* Make the dialog stay on top of all images we open if
-               * we open say 10 at once
-               */
-              gdk_window_raise (gtk_widget_get_window (open_dialog));
-            }
+          /* Load all images at the same time, each with a progress
+           * of its own, and show them as they are done
+           */
+          file_open_with_proc_and_display_async (gimp,
+                                                 gimp_get_user_context (gimp),
+                                                 NULL,
+                                                 list->data,
+                                                 list->data,
+                                                 FALSE,
+                                                 dialog->file_proc,
+                                                 (GimpFileOpenCallback)
+                                                 file_open_dialog_image_opened,
+                                                 gimp);
+          success = TRUE;
         }
 
       if (dialog->canceled)
@@ -238,6 +235,25 @@ file_open_dialog_open_image (GtkWidget           *open_dialog,
   return image;
 }
 
+static void
+file_open_dialog_image_opened (GimpImage         *image,
+                               const gchar       *uri,
+                               GimpPDBStatusType  status,
+                               const GError      *error,
+                               Gimp              *gimp)
+{
+  if (! image && status != GIMP_PDB_CANCEL)
+    {
+      gchar *filename = file_utils_uri_display_name (uri);
+
+      gimp_message (gimp, NULL, GIMP_MESSAGE_ERROR,
+                    _("Opening '%s' failed:\n\n%s"), filename,
+                    error ? error->message : "");
+
+      g_free (filename);
+    }
+}
+
 static gboolean
 file_open_dialog_open_layers (GtkWidget           *open_dialog,
                               GimpImage           *image,
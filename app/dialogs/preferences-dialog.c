@@ -2691,11 +2691,6 @@ prefs_dialog_new (Gimp       *gimp,
         "temp-path",
         N_("Temporary folder:"),
         N_("Select Folder for Temporary Files")
-      },
-      {
-        "swap-path",
-        N_("Swap folder:"),
-        N_("Select Swap Folder")
       }
     };
 
@@ -2781,7 +2776,11 @@ prefs_dialog_new (Gimp       *gimp,
       { N_("Themes"), N_("Theme Folders"), "folders-themes",
         GIMP_HELP_PREFS_FOLDERS_THEMES,
         N_("Select Theme Folders"),
-        "theme-path", NULL }
+        "theme-path", NULL },
+      { N_("Swap"), N_("Swap Folders"), "folders",
+        GIMP_HELP_PREFS_FOLDERS_SWAP,
+        N_("Select Swap Folders"),
+        "swap-path", NULL }
     };
 
     for (i = 0; i < G_N_ELEMENTS (paths); i++)
@@ -41,13 +41,48 @@ enum
 };
 
 
+/*  the size of the cells of the spatial index, in display pixels  */
+#define INDEX_CELL_SIZE  128
+
+/*  items covering more cells than this are kept out of the grid  */
+#define INDEX_MAX_CELLS  32
+
+/*  hit tests are done with this much slack around an item's extents  */
+#define INDEX_HIT_MARGIN 1
+
+
+typedef struct _GimpCanvasGroupEntry   GimpCanvasGroupEntry;
 typedef struct _GimpCanvasGroupPrivate GimpCanvasGroupPrivate;
 
+struct _GimpCanvasGroupEntry
+{
+  GimpCanvasItem        *item;
+  cairo_region_t        *extents;
+  cairo_rectangle_int_t  bounds;
+  gboolean               in_grid;
+};
+
 struct _GimpCanvasGroupPrivate
 {
-  GList    *items;
-  gboolean  group_stroking;
-  gboolean  group_filling;
+  GList          *items;
+  gboolean        group_stroking;
+  gboolean        group_filling;
+
+  /*  spatial index of the items' extents, valid for one transform  */
+  GHashTable     *entries;
+  GHashTable     *grid;
+  GList          *unindexed;
+  gboolean        index_valid;
+  gdouble         index_scale_x;
+  gdouble         index_scale_y;
+  gint            index_offset_x;
+  gint            index_offset_y;
+  gint            index_width;
+  gint            index_height;
+
+  /*  the union of all extents, valid while the index is  */
+  cairo_region_t *extents;
+  gboolean        extents_valid;
 };
 
 #define GET_PRIVATE(group) \
@@ -55,10 +90,15 @@ struct _GimpCanvasGroupPrivate
                                      GIMP_TYPE_CANVAS_GROUP, \
                                      GimpCanvasGroupPrivate)
 
+#define INDEX_CELL_KEY(cx, cy) \
+        GUINT_TO_POINTER ((((guint) (gint) (cy)) << 16) ^ \
+                          (((guint) (gint) (cx)) & 0xffff))
+
 
 /*  local function prototypes  */
 
 static void             gimp_canvas_group_dispose      (GObject          *object);
+static void             gimp_canvas_group_finalize     (GObject          *object);
 static void             gimp_canvas_group_set_property (GObject          *object,
                                                         guint             property_id,
                                                         const GValue     *value,
@@ -81,6 +121,15 @@ static void             gimp_canvas_group_child_update (GimpCanvasItem   *item,
                                                         cairo_region_t   *region,
                                                         GimpCanvasGroup  *group);
 
+static void             gimp_canvas_group_entry_free   (GimpCanvasGroupEntry   *entry);
+static void             gimp_canvas_group_index_insert (GimpCanvasGroupPrivate *private,
+                                                        GimpCanvasGroupEntry   *entry);
+static void             gimp_canvas_group_index_remove (GimpCanvasGroupPrivate *private,
+                                                        GimpCanvasGroupEntry   *entry);
+static void             gimp_canvas_group_index_clear  (GimpCanvasGroupPrivate *private);
+static void             gimp_canvas_group_index_update (GimpCanvasGroupPrivate *private,
+                                                        GimpDisplayShell       *shell);
+
 
 G_DEFINE_TYPE (GimpCanvasGroup, gimp_canvas_group, GIMP_TYPE_CANVAS_ITEM)
 
@@ -94,6 +143,7 @@ gimp_canvas_group_class_init (GimpCanvasGroupClass *klass)
   GimpCanvasItemClass *item_class   = GIMP_CANVAS_ITEM_CLASS (klass);
 
   object_class->dispose      = gimp_canvas_group_dispose;
+  object_class->finalize     = gimp_canvas_group_finalize;
   object_class->set_property = gimp_canvas_group_set_property;
   object_class->get_property = gimp_canvas_group_get_property;
 
@@ -119,6 +169,14 @@ gimp_canvas_group_class_init (GimpCanvasGroupClass *klass)
 static void
 gimp_canvas_group_init (GimpCanvasGroup *group)
 {
+  GimpCanvasGroupPrivate *private = GET_PRIVATE (group);
+
+  private->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL,
+                                            (GDestroyNotify) gimp_canvas_group_entry_free);
+  private->grid    = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL,
+                                            (GDestroyNotify) g_slist_free);
 }
 
 static void
@@ -126,8 +184,12 @@ gimp_canvas_group_dispose (GObject *object)
 {
   GimpCanvasGroupPrivate *private = GET_PRIVATE (object);
 
+  gimp_canvas_group_index_clear (private);
+
   if (private->items)
     {
+      g_hash_table_remove_all (private->entries);
+
       g_list_free_full (private->items, (GDestroyNotify) g_object_unref);
       private->items = NULL;
     }
@@ -135,6 +197,17 @@ gimp_canvas_group_dispose (GObject *object)
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
+static void
+gimp_canvas_group_finalize (GObject *object)
+{
+  GimpCanvasGroupPrivate *private = GET_PRIVATE (object);
+
+  g_hash_table_unref (private->entries);
+  g_hash_table_unref (private->grid);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static void
 gimp_canvas_group_set_property (GObject      *object,
                                 guint         property_id,
@@ -208,26 +281,34 @@ gimp_canvas_group_get_extents (GimpCanvasItem   *item,
                                GimpDisplayShell *shell)
 {
   GimpCanvasGroupPrivate *private = GET_PRIVATE (item);
-  cairo_region_t         *region  = NULL;
   GList                  *list;
 
-  for (list = private->items; list; list = g_list_next (list))
-    {
-      GimpCanvasItem *sub_item   = list->data;
-      cairo_region_t *sub_region = gimp_canvas_item_get_extents (sub_item);
+  gimp_canvas_group_index_update (private, shell);
 
-      if (! region)
-        {
-          region = sub_region;
-        }
-      else if (sub_region)
+  if (! private->extents_valid)
+    {
+      for (list = private->items; list; list = g_list_next (list))
         {
-          cairo_region_union (region, sub_region);
-          cairo_region_destroy (sub_region);
+          GimpCanvasGroupEntry *entry;
+
+          entry = g_hash_table_lookup (private->entries, list->data);
+
+          if (! entry->extents)
+            continue;
+
+          if (! private->extents)
+            private->extents = cairo_region_copy (entry->extents);
+          else
+            cairo_region_union (private->extents, entry->extents);
         }
+
+      private->extents_valid = TRUE;
     }
 
-  return region;
+  if (private->extents)
+    return cairo_region_copy (private->extents);
+
+  return NULL;
 }
 
 static gboolean
@@ -237,11 +318,36 @@ gimp_canvas_group_hit (GimpCanvasItem   *item,
                        gdouble           y)
 {
   GimpCanvasGroupPrivate *private = GET_PRIVATE (item);
+  GSList                 *cell;
   GList                  *list;
+  gdouble                 tx, ty;
 
-  for (list = private->items; list; list = g_list_next (list))
+  gimp_canvas_group_index_update (private, shell);
+
+  gimp_display_shell_transform_xy_f (shell, x, y, &tx, &ty);
+
+  /*  only the items whose extents are around the point can be hit  */
+  cell = g_hash_table_lookup (private->grid,
+                              INDEX_CELL_KEY (floor (tx / INDEX_CELL_SIZE),
+                                              floor (ty / INDEX_CELL_SIZE)));
+
+  for (; cell; cell = g_slist_next (cell))
     {
-      if (gimp_canvas_item_hit (list->data, x, y))
+      GimpCanvasGroupEntry *entry = cell->data;
+
+      if (tx >= entry->bounds.x - INDEX_HIT_MARGIN                         &&
+          tx <  entry->bounds.x + entry->bounds.width  + INDEX_HIT_MARGIN  &&
+          ty >= entry->bounds.y - INDEX_HIT_MARGIN                         &&
+          ty <  entry->bounds.y + entry->bounds.height + INDEX_HIT_MARGIN  &&
+          gimp_canvas_item_hit (entry->item, x, y))
+        return TRUE;
+    }
+
+  for (list = private->unindexed; list; list = g_list_next (list))
+    {
+      GimpCanvasGroupEntry *entry = list->data;
+
+      if (gimp_canvas_item_hit (entry->item, x, y))
         return TRUE;
     }
 
@@ -253,10 +359,203 @@ gimp_canvas_group_child_update (GimpCanvasItem  *item,
                                 cairo_region_t  *region,
                                 GimpCanvasGroup *group)
 {
+  GimpCanvasGroupPrivate *private = GET_PRIVATE (group);
+
+  if (private->index_valid)
+    {
+      GimpCanvasGroupEntry *entry = g_hash_table_lookup (private->entries,
+                                                         item);
+
+      gimp_canvas_group_index_remove (private, entry);
+      gimp_canvas_group_index_insert (private, entry);
+
+      if (private->extents)
+        {
+          cairo_region_destroy (private->extents);
+          private->extents = NULL;
+        }
+
+      private->extents_valid = FALSE;
+    }
+
   if (_gimp_canvas_item_needs_update (GIMP_CANVAS_ITEM (group)))
     _gimp_canvas_item_update (GIMP_CANVAS_ITEM (group), region);
 }
 
+static void
+gimp_canvas_group_entry_free (GimpCanvasGroupEntry *entry)
+{
+  if (entry->extents)
+    cairo_region_destroy (entry->extents);
+
+  g_slice_free (GimpCanvasGroupEntry, entry);
+}
+
+static void
+gimp_canvas_group_index_insert (GimpCanvasGroupPrivate *private,
+                                GimpCanvasGroupEntry   *entry)
+{
+  gint cx1, cy1, cx2, cy2;
+  gint cx, cy;
+
+  entry->extents = gimp_canvas_item_get_extents (entry->item);
+
+  if (! entry->extents)
+    {
+      /*  invisible items can still be hit  */
+      entry->in_grid     = FALSE;
+      private->unindexed = g_list_prepend (private->unindexed, entry);
+      return;
+    }
+
+  cairo_region_get_extents (entry->extents, &entry->bounds);
+
+  cx1 = floor ((gdouble) (entry->bounds.x - INDEX_HIT_MARGIN) /
+               INDEX_CELL_SIZE);
+  cy1 = floor ((gdouble) (entry->bounds.y - INDEX_HIT_MARGIN) /
+               INDEX_CELL_SIZE);
+  cx2 = floor ((gdouble) (entry->bounds.x + entry->bounds.width +
+                          INDEX_HIT_MARGIN) / INDEX_CELL_SIZE);
+  cy2 = floor ((gdouble) (entry->bounds.y + entry->bounds.height +
+                          INDEX_HIT_MARGIN) / INDEX_CELL_SIZE);
+
+  entry->in_grid = ((cx2 - cx1 + 1) * (cy2 - cy1 + 1) <= INDEX_MAX_CELLS);
+
+  if (! entry->in_grid)
+    {
+      private->unindexed = g_list_prepend (private->unindexed, entry);
+      return;
+    }
+
+  for (cy = cy1; cy <= cy2; cy++)
+    for (cx = cx1; cx <= cx2; cx++)
+      {
+        gpointer  key  = INDEX_CELL_KEY (cx, cy);
+        GSList   *cell = g_hash_table_lookup (private->grid, key);
+
+        /*  steal the list so replacing it doesn't free it  */
+        if (cell)
+          g_hash_table_steal (private->grid, key);
+
+        g_hash_table_insert (private->grid, key,
+                             g_slist_prepend (cell, entry));
+      }
+}
+
+static void
+gimp_canvas_group_index_remove (GimpCanvasGroupPrivate *private,
+                                GimpCanvasGroupEntry   *entry)
+{
+  if (entry->in_grid)
+    {
+      gint cx1, cy1, cx2, cy2;
+      gint cx, cy;
+
+      cx1 = floor ((gdouble) (entry->bounds.x - INDEX_HIT_MARGIN) /
+                   INDEX_CELL_SIZE);
+      cy1 = floor ((gdouble) (entry->bounds.y - INDEX_HIT_MARGIN) /
+                   INDEX_CELL_SIZE);
+      cx2 = floor ((gdouble) (entry->bounds.x + entry->bounds.width +
+                              INDEX_HIT_MARGIN) / INDEX_CELL_SIZE);
+      cy2 = floor ((gdouble) (entry->bounds.y + entry->bounds.height +
+                              INDEX_HIT_MARGIN) / INDEX_CELL_SIZE);
+
+      for (cy = cy1; cy <= cy2; cy++)
+        for (cx = cx1; cx <= cx2; cx++)
+          {
+            gpointer  key  = INDEX_CELL_KEY (cx, cy);
+            GSList   *cell = g_hash_table_lookup (private->grid, key);
+
+            g_hash_table_steal (private->grid, key);
+
+            cell = g_slist_remove (cell, entry);
+
+            if (cell)
+              g_hash_table_insert (private->grid, key, cell);
+          }
+    }
+  else
+    {
+      private->unindexed = g_list_remove (private->unindexed, entry);
+    }
+
+  if (entry->extents)
+    {
+      cairo_region_destroy (entry->extents);
+      entry->extents = NULL;
+    }
+
+  entry->in_grid = FALSE;
+}
+
+static void
+gimp_canvas_group_index_clear (GimpCanvasGroupPrivate *private)
+{
+  GList *list;
+
+  for (list = private->items; list; list = g_list_next (list))
+    {
+      GimpCanvasGroupEntry *entry = g_hash_table_lookup (private->entries,
+                                                         list->data);
+
+      if (entry->extents)
+        {
+          cairo_region_destroy (entry->extents);
+          entry->extents = NULL;
+        }
+
+      entry->in_grid = FALSE;
+    }
+
+  g_hash_table_remove_all (private->grid);
+
+  g_list_free (private->unindexed);
+  private->unindexed = NULL;
+
+  if (private->extents)
+    {
+      cairo_region_destroy (private->extents);
+      private->extents = NULL;
+    }
+
+  private->extents_valid = FALSE;
+  private->index_valid   = FALSE;
+}
+
+static void
+gimp_canvas_group_index_update (GimpCanvasGroupPrivate *private,
+                                GimpDisplayShell       *shell)
+{
+  GList *list;
+
+  /*  the items' extents are in display coordinates, so the index
+   *  is dropped whenever the display is scrolled, zoomed or resized
+   */
+  if (private->index_valid                       &&
+      private->index_scale_x  == shell->scale_x  &&
+      private->index_scale_y  == shell->scale_y  &&
+      private->index_offset_x == shell->offset_x &&
+      private->index_offset_y == shell->offset_y &&
+      private->index_width    == shell->disp_width &&
+      private->index_height   == shell->disp_height)
+    return;
+
+  gimp_canvas_group_index_clear (private);
+
+  for (list = private->items; list; list = g_list_next (list))
+    gimp_canvas_group_index_insert (private,
+                                    g_hash_table_lookup (private->entries,
+                                                         list->data));
+
+  private->index_valid    = TRUE;
+  private->index_scale_x  = shell->scale_x;
+  private->index_scale_y  = shell->scale_y;
+  private->index_offset_x = shell->offset_x;
+  private->index_offset_y = shell->offset_y;
+  private->index_width    = shell->disp_width;
+  private->index_height   = shell->disp_height;
+}
+
 
 /*  public functions  */
 
@@ -275,6 +574,7 @@ gimp_canvas_group_add_item (GimpCanvasGroup *group,
                             GimpCanvasItem  *item)
 {
   GimpCanvasGroupPrivate *private;
+  GimpCanvasGroupEntry   *entry;
 
   g_return_if_fail (GIMP_IS_CANVAS_GROUP (group));
   g_return_if_fail (GIMP_IS_CANVAS_ITEM (item));
@@ -290,6 +590,21 @@ gimp_canvas_group_add_item (GimpCanvasGroup *group,
 
   private->items = g_list_append (private->items, g_object_ref (item));
 
+  entry = g_slice_new0 (GimpCanvasGroupEntry);
+  entry->item = item;
+
+  g_hash_table_insert (private->entries, item, entry);
+
+  if (private->index_valid)
+    {
+      gimp_canvas_group_index_insert (private, entry);
+
+      if (private->extents && entry->extents)
+        cairo_region_union (private->extents, entry->extents);
+      else if (entry->extents)
+        private->extents_valid = FALSE;
+    }
+
   if (_gimp_canvas_item_needs_update (GIMP_CANVAS_ITEM (group)))
     {
       cairo_region_t *region = gimp_canvas_item_get_extents (item);
@@ -319,6 +634,23 @@ gimp_canvas_group_remove_item (GimpCanvasGroup *group,
 
   g_return_if_fail (g_list_find (private->items, item));
 
+  if (private->index_valid)
+    {
+      gimp_canvas_group_index_remove (private,
+                                      g_hash_table_lookup (private->entries,
+                                                           item));
+
+      if (private->extents)
+        {
+          cairo_region_destroy (private->extents);
+          private->extents = NULL;
+        }
+
+      private->extents_valid = FALSE;
+    }
+
+  g_hash_table_remove (private->entries, item);
+
   private->items = g_list_remove (private->items, item);
 
   if (private->group_stroking)
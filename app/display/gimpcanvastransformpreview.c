@@ -30,13 +30,18 @@
 
 #include "display/display-types.h"
 
+#include "core/gimp-parallel.h"
 #include "core/gimpchannel.h"
+#include "core/gimpdrawable-preview.h"
 #include "core/gimpimage.h"
 #include "core/gimp-transform-utils.h"
 #include "core/gimp-utils.h"
 
+#include "config/gimpdisplayconfig.h"
+
 #include "gimpcanvas.h"
 #include "gimpcanvastransformpreview.h"
+#include "gimpdisplay.h"
 #include "gimpdisplayshell.h"
 #include "gimpdisplayshell-transform.h"
 
@@ -48,6 +53,8 @@
 #define MAX_SUB_COLS       6 /* number of columns and  */
 #define MAX_SUB_ROWS       6 /* rows to use in perspective preview subdivision */
 
+#define MIN_BAND_HEIGHT   32 /* rows of a band, at least */
+
 
 enum
 {
@@ -81,6 +88,51 @@ struct _GimpCanvasTransformPreviewPrivate
                                      GimpCanvasTransformPreviewPrivate)
 
 
+typedef struct _TransformRow     TransformRow;
+typedef struct _TransformTexture TransformTexture;
+typedef struct _TransformJob     TransformJob;
+
+/*  A row of a triangle, clipped to the visible area, with the texture
+ *  coordinates of its first pixel and their increments.
+ */
+struct _TransformRow
+{
+  gint    y;
+  gint    x;
+  gint    width;
+  gfloat  u, v;
+  gfloat  du, dv;
+};
+
+/*  The part of a drawable the rows are sampled from, fetched from the
+ *  mipmap level that matches the display scale.
+ */
+struct _TransformTexture
+{
+  guchar  *data;
+  gint     bpp;
+  gint     x, y;      /* in scaled coordinates */
+  gint     width;
+  gint     height;
+  gfloat   scale;
+};
+
+/*  The area being drawn, which is split into bands of rows  */
+struct _TransformJob
+{
+  GArray                 *rows;
+
+  guchar                 *area;
+  gint                    area_stride;
+  gint                    area_x, area_y;
+
+  const TransformTexture *texture;
+  const TransformTexture *mask;
+  gint                    mask_offx, mask_offy;
+  guchar                  opacity;
+};
+
+
 /*  local function prototypes  */
 
 static void             gimp_canvas_transform_preview_set_property (GObject          *object,
@@ -98,63 +150,59 @@ static void             gimp_canvas_transform_preview_draw         (GimpCanvasIt
 static cairo_region_t * gimp_canvas_transform_preview_get_extents  (GimpCanvasItem   *item,
                                                                     GimpDisplayShell *shell);
 
-static void   gimp_canvas_transform_preview_draw_quad         (GimpDrawable    *texture,
-                                                               cairo_t         *cr,
-                                                               GimpChannel     *mask,
-                                                               gint             mask_offx,
-                                                               gint             mask_offy,
-                                                               gint            *x,
-                                                               gint            *y,
-                                                               gfloat          *u,
-                                                               gfloat          *v,
-                                                               guchar           opacity);
-static void   gimp_canvas_transform_preview_draw_tri          (GimpDrawable    *texture,
-                                                               cairo_t         *cr,
-                                                               cairo_surface_t *area,
-                                                               gint             area_offx,
-                                                               gint             area_offy,
-                                                               GimpChannel     *mask,
-                                                               gint             mask_offx,
-                                                               gint             mask_offy,
-                                                               gint            *x,
-                                                               gint            *y,
-                                                               gfloat          *u,
-                                                               gfloat          *v,
-                                                               guchar           opacity);
-static void   gimp_canvas_transform_preview_draw_tri_row      (GimpDrawable    *texture,
-                                                               cairo_t         *cr,
-                                                               cairo_surface_t *area,
-                                                               gint             area_offx,
-                                                               gint             area_offy,
-                                                               gint             x1,
-                                                               gfloat           u1,
-                                                               gfloat           v1,
-                                                               gint             x2,
-                                                               gfloat           u2,
-                                                               gfloat           v2,
-                                                               gint             y,
-                                                               guchar           opacity);
-static void   gimp_canvas_transform_preview_draw_tri_row_mask (GimpDrawable    *texture,
-                                                               cairo_t         *cr,
-                                                               cairo_surface_t *area,
-                                                               gint             area_offx,
-                                                               gint             area_offy,
-                                                               GimpChannel     *mask,
-                                                               gint             mask_offx,
-                                                               gint             mask_offy,
-                                                               gint             x1,
-                                                               gfloat           u1,
-                                                               gfloat           v1,
-                                                               gint             x2,
-                                                               gfloat           u2,
-                                                               gfloat           v2,
-                                                               gint             y,
-                                                               guchar           opacity);
-static void   gimp_canvas_transform_preview_trace_tri_edge    (gint            *dest,
-                                                               gint             x1,
-                                                               gint             y1,
-                                                               gint             x2,
-                                                               gint             y2);
+static void   gimp_canvas_transform_preview_render            (GimpDisplayShell       *shell,
+                                                               cairo_t                *cr,
+                                                               GimpDrawable           *texture,
+                                                               GimpChannel            *mask,
+                                                               gint                    mask_offx,
+                                                               gint                    mask_offy,
+                                                               GArray                 *rows,
+                                                               gdouble                 scale,
+                                                               guchar                  opacity);
+
+static void   gimp_canvas_transform_preview_add_quad          (GArray                 *rows,
+                                                               cairo_rectangle_int_t  *clip,
+                                                               gint                   *x,
+                                                               gint                   *y,
+                                                               gfloat                 *u,
+                                                               gfloat                 *v);
+static void   gimp_canvas_transform_preview_add_tri           (GArray                 *rows,
+                                                               cairo_rectangle_int_t  *clip,
+                                                               gint                   *x,
+                                                               gint                   *y,
+                                                               gfloat                 *u,
+                                                               gfloat                 *v);
+static void   gimp_canvas_transform_preview_add_tri_row       (GArray                 *rows,
+                                                               cairo_rectangle_int_t  *clip,
+                                                               gint                    x1,
+                                                               gfloat                  u1,
+                                                               gfloat                  v1,
+                                                               gint                    x2,
+                                                               gfloat                  u2,
+                                                               gfloat                  v2,
+                                                               gint                    y);
+
+static void   gimp_canvas_transform_preview_texture_init      (TransformTexture       *texture,
+                                                               GimpDrawable           *drawable,
+                                                               const Babl             *format,
+                                                               gdouble                 scale,
+                                                               gfloat                  u1,
+                                                               gfloat                  v1,
+                                                               gfloat                  u2,
+                                                               gfloat                  v2);
+
+static void   gimp_canvas_transform_preview_draw_rows         (const GeglRectangle    *band,
+                                                               TransformJob           *job);
+static void   gimp_canvas_transform_preview_draw_tri_row      (TransformJob           *job,
+                                                               const TransformRow     *row);
+static void   gimp_canvas_transform_preview_draw_tri_row_mask (TransformJob           *job,
+                                                               const TransformRow     *row);
+
+static void   gimp_canvas_transform_preview_trace_tri_edge    (gint                   *dest,
+                                                               gint                    x1,
+                                                               gint                    y1,
+                                                               gint                    x2,
+                                                               gint                    y2);
 
 
 G_DEFINE_TYPE (GimpCanvasTransformPreview, gimp_canvas_transform_preview,
@@ -416,6 +464,10 @@ gimp_canvas_transform_preview_draw (GimpCanvasItem   *item,
   gint                               mask_offx, mask_offy;
   gint                               columns, rows;
   gint                               j, k, sub;
+  gdouble                            scale;
+  GArray                            *tri_rows;
+  cairo_rectangle_int_t              clip;
+  gdouble                            clip_x1, clip_y1, clip_x2, clip_y2;
 
    /* x and y get filled with the screen coordinates of each corner of
     * each quadrilateral subdivision of the transformed area. u and v
@@ -554,12 +606,48 @@ gimp_canvas_transform_preview_draw (GimpCanvasItem   *item,
 #undef CALC_VERTEX
 #undef COPY_VERTEX
 
+  /*  the average scale of the preview, going by the area of the
+   *  whole quad, to pick the mipmap levels with it
+   */
+  {
+    gint    tl = 0;
+    gint    tr = columns - 1;
+    gint    bl = (rows - 1) * columns;
+    gint    br = columns * rows - 1;
+    gdouble screen_area;
+    gdouble texture_area;
+
+    screen_area = 0.5 * fabs ((gdouble) (x[br][3] - x[tl][0]) *
+                              (gdouble) (y[tr][1] - y[bl][2]) -
+                              (gdouble) (x[tr][1] - x[bl][2]) *
+                              (gdouble) (y[br][3] - y[tl][0]));
+
+    texture_area = ((gdouble) (mask_x2 - mask_x1) *
+                    (gdouble) (mask_y2 - mask_y1));
+
+    scale = sqrt (MAX (screen_area, 1.0) / MAX (texture_area, 1.0));
+  }
+
+  cairo_clip_extents (cr, &clip_x1, &clip_y1, &clip_x2, &clip_y2);
+
+  clip.x      = floor (clip_x1);
+  clip.y      = floor (clip_y1);
+  clip.width  = ceil (clip_x2) - clip.x;
+  clip.height = ceil (clip_y2) - clip.y;
+
+  tri_rows = g_array_new (FALSE, FALSE, sizeof (TransformRow));
+
   k = columns * rows;
   for (j = 0; j < k; j++)
-    gimp_canvas_transform_preview_draw_quad (private->drawable, cr,
-                                             mask, mask_offx, mask_offy,
-                                             x[j], y[j], u[j], v[j],
-                                             opacity);
+    gimp_canvas_transform_preview_add_quad (tri_rows, &clip,
+                                            x[j], y[j], u[j], v[j]);
+
+  if (tri_rows->len > 0)
+    gimp_canvas_transform_preview_render (shell, cr, private->drawable,
+                                          mask, mask_offx, mask_offy,
+                                          tri_rows, scale, opacity);
+
+  g_array_free (tri_rows, TRUE);
 }
 
 static cairo_region_t *
@@ -606,112 +694,163 @@ gimp_canvas_transform_preview_new (GimpDisplayShell  *shell,
 /*  private functions  */
 
 /**
- * gimp_canvas_transform_preview_draw_quad:
- * @texture:   the #GimpDrawable to be previewed
+ * gimp_canvas_transform_preview_render:
+ * @shell:     the #GimpDisplayShell
  * @cr:        the #cairo_t to draw to
- * @mask:      a #GimpChannel
+ * @texture:   the #GimpDrawable to be previewed
+ * @mask:      a #GimpChannel, or %NULL
+ * @rows:      the visible triangle rows
+ * @scale:     the average scale from @texture to the display
  * @opacity:   the opacity of the preview
  *
- * Take a quadrilateral, divide it into two triangles, and draw those
- * with gimp_canvas_transform_preview_draw_tri().
+ * Fetch the parts of @texture and @mask the @rows are sampled from,
+ * draw the rows into an area surface, split into bands which are
+ * drawn on the core's worker pool, and paint the area to @cr.
  **/
 static void
-gimp_canvas_transform_preview_draw_quad (GimpDrawable *texture,
-                                         cairo_t      *cr,
-                                         GimpChannel  *mask,
-                                         gint          mask_offx,
-                                         gint          mask_offy,
-                                         gint         *x,
-                                         gint         *y,
-                                         gfloat       *u,
-                                         gfloat       *v,
-                                         guchar        opacity)
+gimp_canvas_transform_preview_render (GimpDisplayShell *shell,
+                                      cairo_t          *cr,
+                                      GimpDrawable     *texture,
+                                      GimpChannel      *mask,
+                                      gint              mask_offx,
+                                      gint              mask_offy,
+                                      GArray           *rows,
+                                      gdouble           scale,
+                                      guchar            opacity)
 {
-  gint    x2[3], y2[3];
-  gfloat  u2[3], v2[3];
-  gint    minx, maxx, miny, maxy; /* screen bounds of the quad        */
-  gdouble clip_x1, clip_y1, clip_x2, clip_y2;
-  gint    c;
+  TransformTexture  tex;
+  TransformTexture  mask_tex;
+  TransformJob      job;
+  cairo_surface_t  *area;
+  gint              area_x1, area_y1;
+  gint              area_x2, area_y2;
+  gfloat            u1, v1;
+  gfloat            u2, v2;
+  gint              n_threads;
+  gint              band_height;
+  gint              i;
+
+  area_x1 = area_y1 = G_MAXINT;
+  area_x2 = area_y2 = G_MININT;
+
+  u1 = v1 =  G_MAXFLOAT;
+  u2 = v2 = -G_MAXFLOAT;
+
+  for (i = 0; i < rows->len; i++)
+    {
+      const TransformRow *row = &g_array_index (rows, TransformRow, i);
+      gfloat              eu  = row->u + row->du * (row->width - 1);
+      gfloat              ev  = row->v + row->dv * (row->width - 1);
+
+      area_x1 = MIN (area_x1, row->x);
+      area_y1 = MIN (area_y1, row->y);
+      area_x2 = MAX (area_x2, row->x + row->width);
+      area_y2 = MAX (area_y2, row->y + 1);
+
+      u1 = MIN (u1, MIN (row->u, eu));
+      v1 = MIN (v1, MIN (row->v, ev));
+      u2 = MAX (u2, MAX (row->u, eu));
+      v2 = MAX (v2, MAX (row->v, ev));
+    }
 
-  x2[0] = x[3];  y2[0] = y[3];  u2[0] = u[3];  v2[0] = v[3];
-  x2[1] = x[2];  y2[1] = y[2];  u2[1] = u[2];  v2[1] = v[2];
-  x2[2] = x[1];  y2[2] = y[1];  u2[2] = u[1];  v2[2] = v[1];
+  gimp_canvas_transform_preview_texture_init (&tex, texture,
+                                              babl_format ("R'G'B'A u8"),
+                                              scale, u1, v1, u2, v2);
+
+  if (mask)
+    gimp_canvas_transform_preview_texture_init (&mask_tex, GIMP_DRAWABLE (mask),
+                                                babl_format ("Y u8"),
+                                                scale,
+                                                u1 + mask_offx, v1 + mask_offy,
+                                                u2 + mask_offx, v2 + mask_offy);
+
+  area = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                     area_x2 - area_x1,
+                                     area_y2 - area_y1);
+
+  job.rows        = rows;
+  job.area        = cairo_image_surface_get_data (area);
+  job.area_stride = cairo_image_surface_get_stride (area);
+  job.area_x      = area_x1;
+  job.area_y      = area_y1;
+  job.texture     = &tex;
+  job.mask        = mask ? &mask_tex : NULL;
+  job.mask_offx   = mask_offx;
+  job.mask_offy   = mask_offy;
+  job.opacity     = opacity;
+
+  /*  one band per thread, every band goes through all rows  */
+  n_threads   = gimp_parallel_get_n_threads ();
+  band_height = MAX ((area_y2 - area_y1 + n_threads - 1) / n_threads,
+                     MIN_BAND_HEIGHT);
 
-   /* Allocate a box around the quad to compute preview data into
-    * and fill it with the original window contents.
-    */
+  cairo_surface_flush (area);
 
-  cairo_clip_extents (cr, &clip_x1, &clip_y1, &clip_x2, &clip_y2);
+  gimp_parallel_distribute_area (GEGL_RECTANGLE (0, 0,
+                                                 area_x2 - area_x1,
+                                                 area_y2 - area_y1),
+                                 area_x2 - area_x1, band_height,
+                                 (GimpParallelDistributeAreaFunc) gimp_canvas_transform_preview_draw_rows,
+                                 &job);
 
-  /* find bounds of quad in order to only grab as much of dest as needed */
+  cairo_surface_mark_dirty (area);
 
-  minx = maxx = x[0];
-  miny = maxy = y[0];
-  for (c = 1; c < 4; c++)
-    {
-      if (x[c] < minx) minx = x[c];
-      else if (x[c] > maxx) maxx = x[c];
+  cairo_set_source_surface (cr, area, area_x1, area_y1);
+  cairo_paint (cr);
 
-      if (y[c] < miny) miny = y[c];
-      else if (y[c] > maxy) maxy = y[c];
-    }
-  if (minx < clip_x1) minx = clip_x1;
-  if (miny < clip_y1) miny = clip_y1;
-  if (maxx > clip_x2) maxx = clip_x2;
-  if (maxy > clip_y2) maxy = clip_y2;
+  cairo_surface_destroy (area);
 
-  if (minx <= maxx && miny <= maxy)
-    {
-      cairo_surface_t *area;
+  g_free (tex.data);
 
-      area = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-                                         maxx - minx + 1,
-                                         maxy - miny + 1);
+  if (mask)
+    g_free (mask_tex.data);
+}
 
-      g_return_if_fail (area != NULL);
+/**
+ * gimp_canvas_transform_preview_add_quad:
+ * @rows: the #GArray of #TransformRow to add to
+ * @clip: the visible area
+ *
+ * Take a quadrilateral, divide it into two triangles, and add the
+ * rows of those with gimp_canvas_transform_preview_add_tri().
+ **/
+static void
+gimp_canvas_transform_preview_add_quad (GArray                *rows,
+                                        cairo_rectangle_int_t *clip,
+                                        gint                  *x,
+                                        gint                  *y,
+                                        gfloat                *u,
+                                        gfloat                *v)
+{
+  gint    x2[3], y2[3];
+  gfloat  u2[3], v2[3];
 
-      gimp_canvas_transform_preview_draw_tri (texture, cr, area, minx, miny,
-                                              mask, mask_offx, mask_offy,
-                                              x, y, u, v, opacity);
-      gimp_canvas_transform_preview_draw_tri (texture, cr, area, minx, miny,
-                                              mask, mask_offx, mask_offy,
-                                              x2, y2, u2, v2, opacity);
+  x2[0] = x[3];  y2[0] = y[3];  u2[0] = u[3];  v2[0] = v[3];
+  x2[1] = x[2];  y2[1] = y[2];  u2[1] = u[2];  v2[1] = v[2];
+  x2[2] = x[1];  y2[2] = y[1];  u2[2] = u[1];  v2[2] = v[1];
 
-      cairo_surface_destroy (area);
-    }
+  gimp_canvas_transform_preview_add_tri (rows, clip, x,  y,  u,  v);
+  gimp_canvas_transform_preview_add_tri (rows, clip, x2, y2, u2, v2);
 }
 
 /**
- * gimp_canvas_transform_preview_draw_tri:
- * @texture:   the thing being transformed
- * @cr:        the #cairo_t to draw to
- * @area:      has prefetched pixel data of dest
- * @area_offx: x coordinate of area in dest
- * @area_offy: y coordinate of area in dest
- * @x:         Array of the three x coords of triangle
- * @y:         Array of the three y coords of triangle
+ * gimp_canvas_transform_preview_add_tri:
+ * @rows: the #GArray of #TransformRow to add to
+ * @clip: the visible area
+ * @x:    Array of the three x coords of triangle
+ * @y:    Array of the three y coords of triangle
  *
- * This draws a triangle onto dest by breaking it down into pixel
- * rows, and then calling gimp_canvas_transform_preview_draw_tri_row()
- * and gimp_canvas_transform_preview_draw_tri_row_mask() to do the
- * actual pixel changing.
+ * This breaks a triangle down into pixel rows, and adds the visible
+ * ones with gimp_canvas_transform_preview_add_tri_row().
  **/
 static void
-gimp_canvas_transform_preview_draw_tri (GimpDrawable    *texture,
-                                        cairo_t         *cr,
-                                        cairo_surface_t *area,
-                                        gint             area_offx,
-                                        gint             area_offy,
-                                        GimpChannel     *mask,
-                                        gint             mask_offx,
-                                        gint             mask_offy,
-                                        gint            *x,
-                                        gint            *y,
-                                        gfloat          *u, /* texture coords */
-                                        gfloat          *v, /* 0.0 ... tex width, height */
-                                        guchar           opacity)
+gimp_canvas_transform_preview_add_tri (GArray                *rows,
+                                       cairo_rectangle_int_t *clip,
+                                       gint                  *x,
+                                       gint                  *y,
+                                       gfloat                *u, /* texture coords */
+                                       gfloat                *v) /* 0.0 ... tex width, height */
 {
-  gdouble      clip_x1, clip_y1, clip_x2, clip_y2;
   gint         j, k;
   gint         ry;
   gint        *l_edge, *r_edge;    /* arrays holding x-coords of edge pixels */
@@ -719,13 +858,8 @@ gimp_canvas_transform_preview_draw_tri (GimpDrawable    *texture,
   gfloat       dul, dvl, dur, dvr; /* left and right texture coord deltas  */
   gfloat       u_l, v_l, u_r, v_r; /* left and right texture coord pairs  */
 
-  g_return_if_fail (GIMP_IS_DRAWABLE (texture));
-  g_return_if_fail (area != NULL);
-
   g_return_if_fail (x != NULL && y != NULL && u != NULL && v != NULL);
 
-  cairo_clip_extents (cr, &clip_x1, &clip_y1, &clip_x2, &clip_y2);
-
   /* sort vertices in order of y-coordinate */
 
   for (j = 0; j < 3; j++)
@@ -744,11 +878,12 @@ gimp_canvas_transform_preview_draw_tri (GimpDrawable    *texture,
   if (y[2] == y[0])
     return;
 
+  if (y[2] <= clip->y || y[0] >= clip->y + clip->height)
+    return;
+
   l_edge = g_new (gint, y[2] - y[0]);
   r_edge = g_new (gint, y[2] - y[0]);
 
-  /* draw the triangle */
-
   gimp_canvas_transform_preview_trace_tri_edge (l_edge, x[0], y[0], x[2], y[2]);
 
   left = l_edge;
@@ -767,35 +902,17 @@ gimp_canvas_transform_preview_draw_tri (GimpDrawable    *texture,
       u_r   = u[0];
       v_r   = v[0];
 
-      if (mask)
-        for (ry = y[0]; ry < y[1]; ry++)
-          {
-            if (ry >= clip_y1 && ry < clip_y2)
-              gimp_canvas_transform_preview_draw_tri_row_mask (texture, cr,
-                                                               area, area_offx, area_offy,
-                                                               mask, mask_offx, mask_offy,
-                                                               *left, u_l, v_l,
-                                                               *right, u_r, v_r,
-                                                               ry,
-                                                               opacity);
-            left ++;      right ++;
-            u_l += dul;   v_l += dvl;
-            u_r += dur;   v_r += dvr;
-          }
-      else
-        for (ry = y[0]; ry < y[1]; ry++)
-          {
-            if (ry >= clip_y1 && ry < clip_y2)
-              gimp_canvas_transform_preview_draw_tri_row (texture, cr,
-                                                          area, area_offx, area_offy,
-                                                          *left, u_l, v_l,
-                                                          *right, u_r, v_r,
-                                                          ry,
-                                                          opacity);
-            left ++;      right ++;
-            u_l += dul;   v_l += dvl;
-            u_r += dur;   v_r += dvr;
-          }
+      for (ry = y[0]; ry < y[1]; ry++)
+        {
+          if (ry >= clip->y && ry < clip->y + clip->height)
+            gimp_canvas_transform_preview_add_tri_row (rows, clip,
+                                                       *left, u_l, v_l,
+                                                       *right, u_r, v_r,
+                                                       ry);
+          left ++;      right ++;
+          u_l += dul;   v_l += dvl;
+          u_r += dur;   v_r += dvr;
+        }
     }
 
   if (y[1] != y[2])
@@ -808,35 +925,17 @@ gimp_canvas_transform_preview_draw_tri (GimpDrawable    *texture,
       u_r   = u[1];
       v_r   = v[1];
 
-      if (mask)
-        for (ry = y[1]; ry < y[2]; ry++)
-          {
-            if (ry >= clip_y1 && ry < clip_y2)
-              gimp_canvas_transform_preview_draw_tri_row_mask (texture, cr,
-                                                               area, area_offx, area_offy,
-                                                               mask, mask_offx, mask_offy,
-                                                               *left,  u_l, v_l,
-                                                               *right, u_r, v_r,
-                                                               ry,
-                                                               opacity);
-            left ++;      right ++;
-            u_l += dul;   v_l += dvl;
-            u_r += dur;   v_r += dvr;
-          }
-      else
-        for (ry = y[1]; ry < y[2]; ry++)
-          {
-            if (ry >= clip_y1 && ry < clip_y2)
-              gimp_canvas_transform_preview_draw_tri_row (texture, cr,
-                                                          area, area_offx, area_offy,
-                                                          *left,  u_l, v_l,
-                                                          *right, u_r, v_r,
-                                                          ry,
-                                                          opacity);
-            left ++;      right ++;
-            u_l += dul;   v_l += dvl;
-            u_r += dur;   v_r += dvr;
-          }
+      for (ry = y[1]; ry < y[2]; ry++)
+        {
+          if (ry >= clip->y && ry < clip->y + clip->height)
+            gimp_canvas_transform_preview_add_tri_row (rows, clip,
+                                                       *left,  u_l, v_l,
+                                                       *right, u_r, v_r,
+                                                       ry);
+          left ++;      right ++;
+          u_l += dul;   v_l += dvl;
+          u_r += dur;   v_r += dvr;
+        }
     }
 
   g_free (l_edge);
@@ -844,45 +943,31 @@ gimp_canvas_transform_preview_draw_tri (GimpDrawable    *texture,
 }
 
 /**
- * gimp_canvas_transform_preview_draw_tri_row:
- * @texture: the thing being transformed
- * @cr:      the #cairo_t to draw to
- * @area:    has prefetched pixel data of dest
+ * gimp_canvas_transform_preview_add_tri_row:
+ * @rows: the #GArray of #TransformRow to add to
+ * @clip: the visible area
  *
- * Called from gimp_canvas_transform_preview_draw_tri(), this draws a
- * single row of a triangle onto dest when there is not a mask. The
- * run (x1,y) to (x2,y) in dest corresponds to the run (u1,v1) to
- * (u2,v2) in texture.
+ * Called from gimp_canvas_transform_preview_add_tri(), this clips a
+ * single row of a triangle to the visible area and adds it to
+ * @rows. The run (x1,y) to (x2,y) in dest corresponds to the run
+ * (u1,v1) to (u2,v2) in texture.
  **/
 static void
-gimp_canvas_transform_preview_draw_tri_row (GimpDrawable    *texture,
-                                            cairo_t         *cr,
-                                            cairo_surface_t *area,
-                                            gint             area_offx,
-                                            gint             area_offy,
-                                            gint             x1,
-                                            gfloat           u1,
-                                            gfloat           v1,
-                                            gint             x2,
-                                            gfloat           u2,
-                                            gfloat           v2,
-                                            gint             y,
-                                            guchar           opacity)
+gimp_canvas_transform_preview_add_tri_row (GArray                *rows,
+                                           cairo_rectangle_int_t *clip,
+                                           gint                   x1,
+                                           gfloat                 u1,
+                                           gfloat                 v1,
+                                           gint                   x2,
+                                           gfloat                 u2,
+                                           gfloat                 v2,
+                                           gint                   y)
 {
-  GeglBuffer *buffer;
-  const Babl *format;
-  guchar     *pptr;      /* points into the pixels of a row of area */
-  gfloat      u, v;
-  gfloat      du, dv;
-  gint        dx;
+  TransformRow row;
 
   if (x2 == x1)
     return;
 
-  g_return_if_fail (GIMP_IS_DRAWABLE (texture));
-  g_return_if_fail (area != NULL);
-  g_return_if_fail (cairo_image_surface_get_format (area) == CAIRO_FORMAT_ARGB32);
-
   /* make sure the pixel run goes in the positive direction */
   if (x1 > x2)
     {
@@ -894,55 +979,166 @@ gimp_canvas_transform_preview_draw_tri_row (GimpDrawable    *texture,
       ftmp = v2;  v2 = v1;  v1 = ftmp;
     }
 
-  u = u1;
-  v = v1;
-  du = (u2 - u1) / (x2 - x1);
-  dv = (v2 - v1) / (x2 - x1);
+  row.u  = u1;
+  row.v  = v1;
+  row.du = (u2 - u1) / (x2 - x1);
+  row.dv = (v2 - v1) / (x2 - x1);
 
   /* don't calculate unseen pixels */
-  if (x1 < area_offx)
+  if (x1 < clip->x)
     {
-      u += du * (area_offx - x1);
-      v += dv * (area_offx - x1);
-      x1 = area_offx;
+      row.u += row.du * (clip->x - x1);
+      row.v += row.dv * (clip->x - x1);
+      x1 = clip->x;
     }
-  else if (x1 > area_offx + cairo_image_surface_get_width (area) - 1)
+  else if (x1 >= clip->x + clip->width)
     {
       return;
     }
 
-  if (x2 < area_offx)
-    {
-      return;
-    }
-  else if (x2 > area_offx + cairo_image_surface_get_width (area) - 1)
+  if (x2 <= clip->x)
+    return;
+  else if (x2 > clip->x + clip->width)
+    x2 = clip->x + clip->width;
+
+  row.y     = y;
+  row.x     = x1;
+  row.width = x2 - x1;
+
+  if (row.width > 0)
+    g_array_append_val (rows, row);
+}
+
+/**
+ * gimp_canvas_transform_preview_texture_init:
+ * @texture:  the #TransformTexture to initialize
+ * @drawable: the #GimpDrawable to sample from
+ * @format:   the format to sample in
+ * @scale:    the scale the texture is shown at
+ *
+ * Fetch the part of @drawable that covers the texture coordinates
+ * (u1,v1) to (u2,v2), from the level of its preview pyramid that
+ * matches @scale, so that zoomed out previews of large drawables
+ * only sample about as many pixels as they show.
+ **/
+static void
+gimp_canvas_transform_preview_texture_init (TransformTexture *texture,
+                                            GimpDrawable     *drawable,
+                                            const Babl       *format,
+                                            gdouble           scale,
+                                            gfloat            u1,
+                                            gfloat            v1,
+                                            gfloat            u2,
+                                            gfloat            v2)
+{
+  GimpItem *item  = GIMP_ITEM (drawable);
+  gint      level = gimp_drawable_get_preview_level (drawable, scale);
+  gint      width;
+  gint      height;
+  gint      x1, y1;
+  gint      x2, y2;
+
+  width  = MAX (gimp_item_get_width  (item) >> level, 1);
+  height = MAX (gimp_item_get_height (item) >> level, 1);
+
+  texture->scale = 1.0 / (1 << level);
+  texture->bpp   = babl_format_get_bytes_per_pixel (format);
+
+  x1 = CLAMP ((gint) floor (u1 * texture->scale), 0, width  - 1);
+  y1 = CLAMP ((gint) floor (v1 * texture->scale), 0, height - 1);
+  x2 = CLAMP ((gint) floor (u2 * texture->scale), x1, width  - 1);
+  y2 = CLAMP ((gint) floor (v2 * texture->scale), y1, height - 1);
+
+  texture->x      = x1;
+  texture->y      = y1;
+  texture->width  = x2 - x1 + 1;
+  texture->height = y2 - y1 + 1;
+  texture->data   = g_malloc (texture->width * texture->height *
+                              texture->bpp);
+
+  gimp_drawable_read_preview_level (drawable, level,
+                                    GEGL_RECTANGLE (texture->x,
+                                                    texture->y,
+                                                    texture->width,
+                                                    texture->height),
+                                    format, texture->data);
+}
+
+static inline const guchar *
+transform_texture_get_pixel (const TransformTexture *texture,
+                             gfloat                  u,
+                             gfloat                  v)
+{
+  gint x = CLAMP ((gint) u - texture->x, 0, texture->width  - 1);
+  gint y = CLAMP ((gint) v - texture->y, 0, texture->height - 1);
+
+  return texture->data + (y * texture->width + x) * texture->bpp;
+}
+
+/**
+ * gimp_canvas_transform_preview_draw_rows:
+ * @band: the band to draw, in area coordinates
+ * @job:  the area being drawn
+ *
+ * Draws the rows which fall into @band, this may run in any thread.
+ **/
+static void
+gimp_canvas_transform_preview_draw_rows (const GeglRectangle *band,
+                                         TransformJob        *job)
+{
+  gint y1 = job->area_y + band->y;
+  gint y2 = y1 + band->height;
+  gint i;
+
+  for (i = 0; i < job->rows->len; i++)
     {
-      x2 = area_offx + cairo_image_surface_get_width (area) - 1;
-    }
+      const TransformRow *row = &g_array_index (job->rows, TransformRow, i);
 
-  dx = x2 - x1;
-  if (! dx)
-    return;
+      if (row->y < y1 || row->y >= y2)
+        continue;
 
-  cairo_surface_flush (area);
-  pptr = (cairo_image_surface_get_data (area)
-          + (y - area_offy) * cairo_image_surface_get_stride (area)
-          + (x1 - area_offx) * 4);
+      if (job->mask)
+        gimp_canvas_transform_preview_draw_tri_row_mask (job, row);
+      else
+        gimp_canvas_transform_preview_draw_tri_row (job, row);
+    }
+}
 
-  buffer = gimp_drawable_get_buffer (texture);
-  format = babl_format ("R'G'B'A u8");
+/**
+ * gimp_canvas_transform_preview_draw_tri_row:
+ * @job: the area being drawn
+ * @row: the row to draw
+ *
+ * Called from gimp_canvas_transform_preview_draw_rows(), this draws
+ * a single row of a triangle into the area when there is not a mask.
+ **/
+static void
+gimp_canvas_transform_preview_draw_tri_row (TransformJob       *job,
+                                            const TransformRow *row)
+{
+  const TransformTexture *texture = job->texture;
+  guchar                 *pptr;  /* points into the pixels of a row of area */
+  gfloat                  u, v;
+  gfloat                  du, dv;
+  gint                    dx;
+
+  pptr = (job->area
+          + (row->y - job->area_y) * job->area_stride
+          + (row->x - job->area_x) * 4);
+
+  u  = row->u  * texture->scale;
+  v  = row->v  * texture->scale;
+  du = row->du * texture->scale;
+  dv = row->dv * texture->scale;
+  dx = row->width;
 
   while (dx--)
     {
-      guchar          pixel[4];
-      register gulong tmp;
-      guchar          alpha;
-
-      gegl_buffer_sample (buffer, (gint) u, (gint) v, NULL, pixel,
-                          format,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+      const guchar    *pixel = transform_texture_get_pixel (texture, u, v);
+      register gulong  tmp;
+      guchar           alpha;
 
-      alpha = INT_MULT (opacity, pixel[3], tmp);
+      alpha = INT_MULT (job->opacity, pixel[3], tmp);
 
       GIMP_CAIRO_ARGB32_SET_PIXEL (pptr,
                                    pixel[0],
@@ -955,125 +1151,51 @@ gimp_canvas_transform_preview_draw_tri_row (GimpDrawable    *texture,
       u += du;
       v += dv;
     }
-
-  cairo_surface_mark_dirty (area);
-
-  cairo_set_source_surface (cr, area, area_offx, area_offy);
-  cairo_rectangle (cr, x1, y, x2 - x1, 1);
-  cairo_fill (cr);
 }
 
 /**
  * gimp_canvas_transform_preview_draw_tri_row_mask:
+ * @job: the area being drawn
+ * @row: the row to draw
  *
- * Called from gimp_canvas_transform_preview_draw_tri(), this draws a
- * single row of a triangle onto dest, when there is a mask.
+ * Called from gimp_canvas_transform_preview_draw_rows(), this draws
+ * a single row of a triangle into the area, when there is a mask.
  **/
 static void
-gimp_canvas_transform_preview_draw_tri_row_mask (GimpDrawable    *texture,
-                                                 cairo_t         *cr,
-                                                 cairo_surface_t *area,
-                                                 gint             area_offx,
-                                                 gint             area_offy,
-                                                 GimpChannel     *mask,
-                                                 gint             mask_offx,
-                                                 gint             mask_offy,
-                                                 gint             x1,
-                                                 gfloat           u1,
-                                                 gfloat           v1,
-                                                 gint             x2,
-                                                 gfloat           u2,
-                                                 gfloat           v2,
-                                                 gint             y,
-                                                 guchar           opacity)
+gimp_canvas_transform_preview_draw_tri_row_mask (TransformJob       *job,
+                                                 const TransformRow *row)
 {
-  GeglBuffer *buffer;
-  const Babl *format;
-  GeglBuffer *mask_buffer;
-  const Babl *mask_format;
-  guchar     *pptr;              /* points into the pixels of area        */
-  gfloat      u, v;
-  gfloat      mu, mv;
-  gfloat      du, dv;
-  gint        dx;
-
-  if (x2 == x1)
-    return;
-
-  g_return_if_fail (GIMP_IS_DRAWABLE (texture));
-  g_return_if_fail (GIMP_IS_CHANNEL (mask));
-  g_return_if_fail (area != NULL);
-  g_return_if_fail (cairo_image_surface_get_format (area) == CAIRO_FORMAT_ARGB32);
-
-  /* make sure the pixel run goes in the positive direction */
-  if (x1 > x2)
-    {
-      gint   tmp;
-      gfloat ftmp;
-
-      tmp  = x2;  x2 = x1;  x1 = tmp;
-      ftmp = u2;  u2 = u1;  u1 = ftmp;
-      ftmp = v2;  v2 = v1;  v1 = ftmp;
-    }
-
-  u = u1;
-  v = v1;
-  du = (u2 - u1) / (x2 - x1);
-  dv = (v2 - v1) / (x2 - x1);
-
-  /* don't calculate unseen pixels */
-  if (x1 < area_offx)
-    {
-      u += du * (area_offx - x1);
-      v += dv * (area_offx - x1);
-      x1 = area_offx;
-    }
-  else if (x1 > area_offx + cairo_image_surface_get_width (area) - 1)
-    {
-      return;
-    }
-
-  if (x2 < area_offx)
-    {
-      return;
-    }
-  else if (x2 > area_offx + cairo_image_surface_get_width (area) - 1)
-    {
-      x2 = area_offx + cairo_image_surface_get_width (area) - 1;
-    }
-
-  dx = x2 - x1;
-  if (! dx)
-    return;
-
-  mu = u + mask_offx;
-  mv = v + mask_offy;
-
-  cairo_surface_flush (area);
-  pptr = (cairo_image_surface_get_data (area)
-          + (y - area_offy) * cairo_image_surface_get_stride (area)
-          + (x1 - area_offx) * 4);
-
-  buffer      = gimp_drawable_get_buffer (texture);
-  mask_buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (mask));
-  format      = babl_format ("R'G'B'A u8");
-  mask_format = babl_format ("Y u8");
+  const TransformTexture *texture = job->texture;
+  const TransformTexture *mask    = job->mask;
+  guchar                 *pptr;  /* points into the pixels of area */
+  gfloat                  u, v;
+  gfloat                  mu, mv;
+  gfloat                  du, dv;
+  gfloat                  mdu, mdv;
+  gint                    dx;
+
+  pptr = (job->area
+          + (row->y - job->area_y) * job->area_stride
+          + (row->x - job->area_x) * 4);
+
+  u  = row->u  * texture->scale;
+  v  = row->v  * texture->scale;
+  mu = (row->u + job->mask_offx) * mask->scale;
+  mv = (row->v + job->mask_offy) * mask->scale;
+  du  = row->du * texture->scale;
+  dv  = row->dv * texture->scale;
+  mdu = row->du * mask->scale;
+  mdv = row->dv * mask->scale;
+  dx  = row->width;
 
   while (dx--)
     {
-      guchar          pixel[4];
-      guchar          maskval;
-      register gulong tmp;
-      guchar          alpha;
+      const guchar    *pixel   = transform_texture_get_pixel (texture, u, v);
+      const guchar    *maskval = transform_texture_get_pixel (mask, mu, mv);
+      register gulong  tmp;
+      guchar           alpha;
 
-      gegl_buffer_sample (buffer, (gint) u, (gint) v, NULL, pixel,
-                          format,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-      gegl_buffer_sample (mask_buffer, (gint) mu, (gint) mv, NULL, &maskval,
-                          mask_format,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-
-      alpha = INT_MULT3 (opacity, maskval, pixel[3], tmp);
+      alpha = INT_MULT3 (job->opacity, *maskval, pixel[3], tmp);
 
       GIMP_CAIRO_ARGB32_SET_PIXEL (pptr,
                                    pixel[0],
@@ -1083,17 +1205,11 @@ gimp_canvas_transform_preview_draw_tri_row_mask (GimpDrawable    *texture,
 
       pptr += 4;
 
-      u += du;
-      v += dv;
-      mu += du;
-      mv += dv;
+      u  += du;
+      v  += dv;
+      mu += mdu;
+      mv += mdv;
     }
-
-  cairo_surface_mark_dirty (area);
-
-  cairo_set_source_surface (cr, area, area_offx, area_offy);
-  cairo_rectangle (cr, x1, y, x2 - x1, 1);
-  cairo_fill (cr);
 }
 
 /**
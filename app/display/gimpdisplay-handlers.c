@@ -26,6 +26,8 @@
 
 #include "gimpdisplay.h"
 #include "gimpdisplay-handlers.h"
+#include "gimpdisplayshell.h"
+#include "gimpdisplayshell-render.h"
 
 
 /*  local function prototypes  */
@@ -96,6 +98,12 @@ gimp_display_update_handler (GimpProjection *projection,
                              gint            h,
                              GimpDisplay    *display)
 {
+  GimpDisplayShell *shell = gimp_display_get_shell (display);
+
+  /*  drop the rendered tiles right away, the area is exposed later  */
+  if (shell)
+    gimp_display_shell_render_invalidate_area (shell, x, y, w, h);
+
   gimp_display_update_area (display, now, x, y, w, h);
 }
 
@@ -59,6 +59,7 @@
 #include "gimpdisplayshell-expose.h"
 #include "gimpdisplayshell-handlers.h"
 #include "gimpdisplayshell-icon.h"
+#include "gimpdisplayshell-render.h"
 #include "gimpdisplayshell-scale.h"
 #include "gimpdisplayshell-scroll.h"
 #include "gimpdisplayshell-selection.h"
@@ -163,6 +164,9 @@ static void   gimp_display_shell_ants_speed_notify_handler  (GObject          *c
 static void   gimp_display_shell_quality_notify_handler     (GObject          *config,
                                                              GParamSpec       *param_spec,
                                                              GimpDisplayShell *shell);
+static void   gimp_display_shell_coalescing_notify_handler  (GObject          *config,
+                                                             GParamSpec       *param_spec,
+                                                             GimpDisplayShell *shell);
 
 
 /*  public functions  */
@@ -349,7 +353,19 @@ gimp_display_shell_connect (GimpDisplayShell *shell)
                     G_CALLBACK (gimp_display_shell_quality_notify_handler),
                     shell);
 
+  g_signal_connect (shell->display->config,
+                    "notify::accelerated-canvas",
+                    G_CALLBACK (gimp_display_shell_quality_notify_handler),
+                    shell);
+
+  g_signal_connect (shell->display->config,
+                    "notify::motion-coalescing",
+                    G_CALLBACK (gimp_display_shell_coalescing_notify_handler),
+                    shell);
+
   gimp_display_shell_invalidate_preview_handler (image, shell);
+  gimp_display_shell_coalescing_notify_handler (G_OBJECT (shell->display->config),
+                                                NULL, shell);
   gimp_display_shell_quick_mask_changed_handler (image, shell);
 
   gimp_canvas_layer_boundary_set_layer (GIMP_CANVAS_LAYER_BOUNDARY (shell->layer_boundary),
@@ -374,9 +390,14 @@ gimp_display_shell_disconnect (GimpDisplayShell *shell)
 
   gimp_display_shell_icon_update_stop (shell);
 
+  gimp_display_shell_render_invalidate_full (shell);
+
   gimp_canvas_layer_boundary_set_layer (GIMP_CANVAS_LAYER_BOUNDARY (shell->layer_boundary),
                                         NULL);
 
+  g_signal_handlers_disconnect_by_func (shell->display->config,
+                                        gimp_display_shell_coalescing_notify_handler,
+                                        shell);
   g_signal_handlers_disconnect_by_func (shell->display->config,
                                         gimp_display_shell_quality_notify_handler,
                                         shell);
@@ -725,6 +746,8 @@ gimp_display_shell_size_changed_detailed_handler (GimpImage        *image,
                                                   gint              previous_height,
                                                   GimpDisplayShell *shell)
 {
+  gimp_display_shell_render_invalidate_full (shell);
+
   if (shell->display->config->resize_windows_on_resize)
     {
       GimpImageWindow *window = gimp_display_shell_get_window (shell);
@@ -1043,5 +1066,17 @@ gimp_display_shell_quality_notify_handler (GObject          *config,
                                            GParamSpec       *param_spec,
                                            GimpDisplayShell *shell)
 {
+  gimp_display_shell_render_invalidate_full (shell);
   gimp_display_shell_expose_full (shell);
 }
+
+static void
+gimp_display_shell_coalescing_notify_handler (GObject          *config,
+                                              GParamSpec       *param_spec,
+                                              GimpDisplayShell *shell)
+{
+  g_object_set (shell->motion_buffer,
+                "coalesce-interval",
+                GIMP_DISPLAY_CONFIG (config)->motion_coalescing,
+                NULL);
+}
@@ -17,9 +17,13 @@
 
 #include "config.h"
 
+#include <string.h>
+#include <math.h>
+
 #include <gegl.h>
 #include <gtk/gtk.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
 #include "libgimpwidgets/gimpwidgets.h"
 
@@ -32,6 +36,7 @@
 
 #include "gegl/gimp-gegl-utils.h"
 
+#include "core/gimp-parallel.h"
 #include "core/gimpdrawable.h"
 #include "core/gimpimage.h"
 #include "core/gimppickable.h"
@@ -43,6 +48,15 @@
 #include "gimpdisplayshell-render.h"
 #include "gimpdisplayshell-scroll.h"
 
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define GIMP_DISPLAY_RENDER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+/*  the number of rendered tiles each display keeps around  */
+#define GIMP_DISPLAY_RENDER_CACHE_SIZE 64
+
 
 #define GIMP_DISPLAY_ZOOM_FAST     (1 << 0) /* use the fastest possible code
                                                path trading quality for speed
@@ -52,15 +66,30 @@
                                                code only enables it between
                                                100% and 200% zoom)
                                              */
+#define GIMP_DISPLAY_ZOOM_SSE2     (1 << 2) /* use the SSE2 box filter for
+                                               pre-multiplied RGBA sources
+                                             */
 
 
-typedef struct _RenderInfo  RenderInfo;
+typedef struct _RenderInfo       RenderInfo;
+typedef struct _RenderTileTable  RenderTileTable;
 
 typedef void (* RenderFunc) (RenderInfo *info);
 
+/*  The source tiles needed for rendering an area, fetched and locked
+ *  up front so that the area can be rendered from several threads.
+ */
+struct _RenderTileTable
+{
+  gint          col0, row0;
+  gint          n_cols, n_rows;
+  Tile        **tiles;
+};
+
 struct _RenderInfo
 {
   TileManager  *src_tiles;
+  RenderTileTable *src_table; /* locked source tiles, or NULL            */
   const guchar *src;
   gboolean      src_is_premult;
   guchar       *dest;
@@ -91,10 +120,9 @@ struct _RenderInfo
   gint          footshift_y;
 
   gint64        dy;
-};
-
 
-static guchar tile_buf[GIMP_DISPLAY_RENDER_BUF_WIDTH * MAX_CHANNELS];
+  guchar        tile_buf[GIMP_DISPLAY_RENDER_BUF_WIDTH * MAX_CHANNELS];
+};
 
 
 static void  gimp_display_shell_render_info_init (RenderInfo       *info,
@@ -117,6 +145,34 @@ static void           render_image_rgb_a         (RenderInfo       *info);
 static const guchar * render_image_tile_fault    (RenderInfo       *info);
 
 
+/*  A cached tile of the rendered projection, in scaled image
+ *  coordinates at one particular zoom level.  Only the parts in the
+ *  valid region have been rendered and are up-to-date.  With the
+ *  "accelerated-canvas" option, the tile's surface is created similar
+ *  to the canvas' target, i.e. it lives on the display server, and it
+ *  is updated from the render buffer.
+ */
+typedef struct _RenderCacheTile RenderCacheTile;
+
+struct _RenderCacheTile
+{
+  gdouble          scale_x;
+  gdouble          scale_y;
+  gint             level;
+  gint             x, y;
+  cairo_surface_t *surface;
+  cairo_region_t  *valid;
+};
+
+
+static RenderCacheTile * render_cache_tile_lookup (GimpDisplayShell *shell,
+                                                   cairo_t          *cr,
+                                                   gint              x,
+                                                   gint              y,
+                                                   gint              level);
+static void              render_cache_tile_free   (RenderCacheTile  *tile);
+
+
 /*****************************************************************/
 /*  This function is the core of the display -- it offsets and   */
 /*  scales the image according to the current parameters in the  */
@@ -124,68 +180,363 @@ static const guchar * render_image_tile_fault    (RenderInfo       *info);
 /*  and renders them to an ARGB32 cairo surface.                 */
 /*****************************************************************/
 
-void
-gimp_display_shell_render (GimpDisplayShell *shell,
-                           cairo_t          *cr,
-                           gint              x,
-                           gint              y,
-                           gint              w,
-                           gint              h)
+/*  Rendering of an area is split into bands of at least this many
+ *  rows, which are distributed over the core's worker pool.
+ */
+#define GIMP_DISPLAY_RENDER_BAND_HEIGHT 32
+
+typedef struct _RenderJob RenderJob;
+
+struct _RenderJob
+{
+  RenderInfo  info;
+  RenderFunc  func;
+};
+
+
+static void
+render_job_run (gint       i,
+                gint       n,
+                RenderJob *jobs)
+{
+  jobs[i].func (&jobs[i].info);
+}
+
+static inline Tile *
+render_get_tile (RenderInfo *info,
+                 gint        x,
+                 gint        y)
+{
+  RenderTileTable *table = info->src_table;
+  gint             col, row;
+
+  if (! table)
+    return tile_manager_get_tile (info->src_tiles, x, y, TRUE, FALSE);
+
+  if (x < 0 || x >= tile_manager_width  (info->src_tiles) ||
+      y < 0 || y >= tile_manager_height (info->src_tiles))
+    return NULL;
+
+  col = x / TILE_WIDTH  - table->col0;
+  row = y / TILE_HEIGHT - table->row0;
+
+  if (col < 0 || col >= table->n_cols ||
+      row < 0 || row >= table->n_rows)
+    return NULL;
+
+  return table->tiles[row * table->n_cols + col];
+}
+
+static inline void
+render_release_tile (RenderInfo *info,
+                     Tile       *tile)
+{
+  /*  the tiles in the table are released by the caller  */
+  if (! info->src_table)
+    tile_release (tile, FALSE);
+}
+
+/*  Fetch and lock all source tiles that rendering the area set up in
+ *  @info can touch, including the neighbours used by the box filter.
+ */
+static RenderTileTable *
+render_tile_table_new (const RenderInfo *info)
+{
+  RenderTileTable *table;
+  TileManager     *tm     = info->src_tiles;
+  gint             width  = tile_manager_width  (tm);
+  gint             height = tile_manager_height (tm);
+  gint             x1, y1, x2, y2;
+  gint             row, col;
+
+  x1 = info->src_x - 1;
+  y1 = info->src_y - 1;
+  x2 = info->src_x + ((info->dx_start + (gint64) info->x_dest_inc * info->w) /
+                      info->x_src_dec) + 1;
+  y2 = info->src_y + ((info->dy_start + (gint64) info->y_dest_inc * info->h) /
+                      info->y_src_dec) + 1;
+
+  x1 = CLAMP (x1, 0, width  - 1);
+  y1 = CLAMP (y1, 0, height - 1);
+  x2 = CLAMP (x2, 0, width  - 1);
+  y2 = CLAMP (y2, 0, height - 1);
+
+  table = g_slice_new (RenderTileTable);
+
+  table->col0   = x1 / TILE_WIDTH;
+  table->row0   = y1 / TILE_HEIGHT;
+  table->n_cols = x2 / TILE_WIDTH  - table->col0 + 1;
+  table->n_rows = y2 / TILE_HEIGHT - table->row0 + 1;
+  table->tiles  = g_new (Tile *, table->n_cols * table->n_rows);
+
+  /*  this also validates the tiles, which must not happen in the
+   *  render threads
+   */
+  for (row = 0; row < table->n_rows; row++)
+    for (col = 0; col < table->n_cols; col++)
+      table->tiles[row * table->n_cols + col] =
+        tile_manager_get_tile (tm,
+                               (table->col0 + col) * TILE_WIDTH,
+                               (table->row0 + row) * TILE_HEIGHT,
+                               TRUE, FALSE);
+
+  return table;
+}
+
+static void
+render_tile_table_free (RenderTileTable *table)
+{
+  gint i;
+
+  for (i = 0; i < table->n_cols * table->n_rows; i++)
+    if (table->tiles[i])
+      tile_release (table->tiles[i], FALSE);
+
+  g_free (table->tiles);
+  g_slice_free (RenderTileTable, table);
+}
+
+/*  Render the projection area x, y, w, h (in render coordinates) to
+ *  @surface at dest_x, dest_y.  Large areas are split into bands of
+ *  rows rendered concurrently; the tiles they need are locked up front
+ *  in a RenderTileTable because tile access itself is not thread-safe.
+ */
+static void
+gimp_display_shell_render_projection (GimpDisplayShell *shell,
+                                      cairo_surface_t  *surface,
+                                      gint              dest_x,
+                                      gint              dest_y,
+                                      gint              x,
+                                      gint              y,
+                                      gint              w,
+                                      gint              h,
+                                      gint              level)
 {
   GimpProjection *projection;
   GimpImage      *image;
   TileManager    *tiles;
-  RenderInfo      info;
   const Babl     *format;
-  gint            level;
+  RenderFunc      func;
   gboolean        premult;
-
-  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
-  g_return_if_fail (cr != NULL);
-  g_return_if_fail (w > 0 && h > 0);
+  gint            n_bands;
 
   image = gimp_display_get_image (shell->display);
   projection = gimp_image_get_projection (image);
 
-  /* setup RenderInfo for rendering a GimpProjection level. */
-  level = gimp_projection_get_level (projection,
-                                     shell->scale_x, shell->scale_y);
-
   tiles = gimp_projection_get_tiles_at_level (projection, level, &premult);
 
-  gimp_display_shell_render_info_init (&info,
-                                       shell, x, y, w, h,
-                                       shell->render_surface,
-                                       tiles, level, premult);
-
   /* Currently, only RGBA and GRAYA projection types are used. */
   format = gimp_pickable_get_format (GIMP_PICKABLE (projection));
 
   if (format == babl_format ("R'G'B'A u8"))
     {
-      render_image_rgb_a (&info);
+      func = render_image_rgb_a;
     }
   else if (format == babl_format ("Y'A u8"))
     {
-      render_image_gray_a (&info);
+      func = render_image_gray_a;
     }
   else
     {
       g_warning ("%s: unsupported projection type (%s)", G_STRFUNC,
                  babl_get_name (format));
       g_assert_not_reached ();
+      return;
+    }
+
+  n_bands = CLAMP (h / GIMP_DISPLAY_RENDER_BAND_HEIGHT,
+                   1, gimp_parallel_get_n_threads ());
+
+  if (n_bands == 1)
+    {
+      RenderInfo info;
+
+      gimp_display_shell_render_info_init (&info,
+                                           shell, x, y, w, h,
+                                           surface,
+                                           tiles, level, premult);
+
+      info.dest += dest_y * info.dest_bpl + dest_x * 4;
+
+      func (&info);
     }
+  else
+    {
+      RenderInfo       info;
+      RenderTileTable *table;
+      RenderJob       *jobs;
+      gint             i;
+
+      gimp_display_shell_render_info_init (&info,
+                                           shell, x, y, w, h,
+                                           surface,
+                                           tiles, level, premult);
+
+      table = render_tile_table_new (&info);
+
+      jobs = g_new (RenderJob, n_bands);
+
+      for (i = 0; i < n_bands; i++)
+        {
+          RenderJob *job = &jobs[i];
+          gint       y1  = h * i / n_bands;
+          gint       y2  = h * (i + 1) / n_bands;
+
+          gimp_display_shell_render_info_init (&job->info,
+                                               shell, x, y + y1, w, y2 - y1,
+                                               surface,
+                                               tiles, level, premult);
+
+          job->info.src_table = table;
+          job->info.dest     += ((dest_y + y1) * job->info.dest_bpl +
+                                 dest_x * 4);
+          job->func           = func;
+        }
+
+      gimp_parallel_distribute (n_bands,
+                                (GimpParallelDistributeFunc) render_job_run,
+                                jobs);
+
+      g_free (jobs);
+      render_tile_table_free (table);
+    }
+
+  cairo_surface_mark_dirty_rectangle (surface, dest_x, dest_y, w, h);
+}
+
+void
+gimp_display_shell_render (GimpDisplayShell *shell,
+                           cairo_t          *cr,
+                           gint              x,
+                           gint              y,
+                           gint              w,
+                           gint              h)
+{
+  GimpProjection *projection;
+  GimpImage      *image;
+  gint            level;
+  gint            offset_x, offset_y;
+  gint            disp_xoffset, disp_yoffset;
+  gint            x1, y1, x2, y2;
+  gint            tx, ty;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+  g_return_if_fail (cr != NULL);
+  g_return_if_fail (w > 0 && h > 0);
+
+  image = gimp_display_get_image (shell->display);
+  projection = gimp_image_get_projection (image);
+
+  level = gimp_projection_get_level (projection,
+                                     shell->scale_x, shell->scale_y);
+
+  gimp_display_shell_scroll_get_render_start_offset (shell,
+                                                     &offset_x, &offset_y);
+  gimp_display_shell_scroll_get_disp_offset (shell,
+                                             &disp_xoffset, &disp_yoffset);
+
+  /*  the requested area in scaled image coordinates  */
+  x1 = x + offset_x;
+  y1 = y + offset_y;
+  x2 = x1 + w;
+  y2 = y1 + h;
+
+  cairo_save (cr);
+
+  cairo_rectangle (cr, x + disp_xoffset, y + disp_yoffset, w, h);
+  cairo_clip (cr);
 
-  cairo_surface_mark_dirty (shell->render_surface);
+  /*  bring the cached tiles up-to-date and put them to the screen  */
+  for (ty = y1 - y1 % GIMP_DISPLAY_RENDER_BUF_HEIGHT;
+       ty < y2;
+       ty += GIMP_DISPLAY_RENDER_BUF_HEIGHT)
+    {
+      for (tx = x1 - x1 % GIMP_DISPLAY_RENDER_BUF_WIDTH;
+           tx < x2;
+           tx += GIMP_DISPLAY_RENDER_BUF_WIDTH)
+        {
+          RenderCacheTile       *tile;
+          cairo_region_t        *dirty;
+          cairo_rectangle_int_t  rect;
+          gint                   i;
+
+          tile = render_cache_tile_lookup (shell, cr, tx, ty, level);
+
+          rect.x      = MAX (x1, tx);
+          rect.y      = MAX (y1, ty);
+          rect.width  = MIN (x2, tx + GIMP_DISPLAY_RENDER_BUF_WIDTH)  - rect.x;
+          rect.height = MIN (y2, ty + GIMP_DISPLAY_RENDER_BUF_HEIGHT) - rect.y;
+
+          dirty = cairo_region_create_rectangle (&rect);
+          cairo_region_subtract (dirty, tile->valid);
+
+          for (i = 0; i < cairo_region_num_rectangles (dirty); i++)
+            {
+              cairo_rectangle_int_t  r;
 
-  /*  apply filters to the rendered projection  */
-  if (shell->filter_stack)
-    gimp_color_display_stack_convert_surface (shell->filter_stack,
-                                              shell->render_surface);
+              cairo_region_get_rectangle (dirty, i, &r);
+
+              if (shell->filter_stack ||
+                  cairo_surface_get_type (tile->surface) !=
+                  CAIRO_SURFACE_TYPE_IMAGE)
+                {
+                  cairo_t *tile_cr;
+
+                  /*  the display filters convert whole surfaces, and
+                   *  server side tiles can't be rendered to directly,
+                   *  so render the area to the render buffer and copy
+                   *  it, which uploads it only once
+                   */
+                  gimp_display_shell_render_projection (shell,
+                                                        shell->render_surface,
+                                                        0, 0,
+                                                        r.x - offset_x,
+                                                        r.y - offset_y,
+                                                        r.width, r.height,
+                                                        level);
+
+                  if (shell->filter_stack)
+                    gimp_color_display_stack_convert_surface (shell->filter_stack,
+                                                              shell->render_surface);
+
+                  tile_cr = cairo_create (tile->surface);
+                  cairo_set_operator (tile_cr, CAIRO_OPERATOR_SOURCE);
+                  cairo_set_source_surface (tile_cr, shell->render_surface,
+                                            r.x - tx, r.y - ty);
+                  cairo_rectangle (tile_cr,
+                                   r.x - tx, r.y - ty, r.width, r.height);
+                  cairo_fill (tile_cr);
+                  cairo_destroy (tile_cr);
+                }
+              else
+                {
+                  gimp_display_shell_render_projection (shell,
+                                                        tile->surface,
+                                                        r.x - tx,
+                                                        r.y - ty,
+                                                        r.x - offset_x,
+                                                        r.y - offset_y,
+                                                        r.width, r.height,
+                                                        level);
+                }
+
+              cairo_region_union_rectangle (tile->valid, &r);
+            }
+
+          cairo_region_destroy (dirty);
+
+          cairo_set_source_surface (cr, tile->surface,
+                                    tx - offset_x + disp_xoffset,
+                                    ty - offset_y + disp_yoffset);
+          cairo_paint (cr);
+        }
+    }
 
   if (shell->mask)
     {
-      GeglBuffer *buffer;
+      GeglBuffer  *buffer;
+      TileManager *tiles;
+      RenderInfo   info;
 
       if (! shell->mask_surface)
         {
@@ -207,33 +558,162 @@ gimp_display_shell_render (GimpDisplayShell *shell,
       render_image_alpha (&info);
 
       cairo_surface_mark_dirty (shell->mask_surface);
+
+      gimp_cairo_set_source_rgba (cr, &shell->mask_color);
+      cairo_mask_surface (cr, shell->mask_surface,
+                          x + disp_xoffset, y + disp_yoffset);
+    }
+
+  cairo_restore (cr);
+}
+
+/**
+ * gimp_display_shell_render_invalidate_area:
+ * @shell: a #GimpDisplayShell
+ * @x:     left edge of the changed area, in image coordinates
+ * @y:     top edge of the changed area, in image coordinates
+ * @w:     width of the changed area
+ * @h:     height of the changed area
+ *
+ * Drops the parts of the cached rendered tiles, at all zoom levels,
+ * which depend on the given area of the projection.
+ **/
+void
+gimp_display_shell_render_invalidate_area (GimpDisplayShell *shell,
+                                           gint              x,
+                                           gint              y,
+                                           gint              w,
+                                           gint              h)
+{
+  GList *list;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (! shell->render_cache)
+    return;
+
+  for (list = shell->render_cache->head; list; list = g_list_next (list))
+    {
+      RenderCacheTile       *tile = list->data;
+      cairo_rectangle_int_t  rect;
+      gint                   margin;
+
+      /*  the box filter reaches into the neighbouring pixels of the
+       *  pyramid level the tile was rendered from
+       */
+      margin = 2 << tile->level;
+
+      rect.x = floor ((x - margin) * tile->scale_x) - 1;
+      rect.y = floor ((y - margin) * tile->scale_y) - 1;
+      rect.width  = ceil ((x + w + margin) * tile->scale_x) + 1 - rect.x;
+      rect.height = ceil ((y + h + margin) * tile->scale_y) + 1 - rect.y;
+
+      cairo_region_subtract_rectangle (tile->valid, &rect);
+    }
+}
+
+/**
+ * gimp_display_shell_render_invalidate_full:
+ * @shell: a #GimpDisplayShell
+ *
+ * Empties the cache of rendered tiles, to be called when the
+ * rendering itself changes, for example when the display filters or
+ * the zoom quality are changed.
+ **/
+void
+gimp_display_shell_render_invalidate_full (GimpDisplayShell *shell)
+{
+  RenderCacheTile *tile;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (! shell->render_cache)
+    return;
+
+  while ((tile = g_queue_pop_head (shell->render_cache)))
+    render_cache_tile_free (tile);
+}
+
+static RenderCacheTile *
+render_cache_tile_lookup (GimpDisplayShell *shell,
+                          cairo_t          *cr,
+                          gint              x,
+                          gint              y,
+                          gint              level)
+{
+  RenderCacheTile *tile;
+  GList           *list;
+
+  for (list = shell->render_cache->head; list; list = g_list_next (list))
+    {
+      tile = list->data;
+
+      if (tile->x       == x              &&
+          tile->y       == y              &&
+          tile->scale_x == shell->scale_x &&
+          tile->scale_y == shell->scale_y)
+        {
+          /*  keep the most recently used tiles at the head  */
+          if (list != shell->render_cache->head)
+            {
+              g_queue_unlink (shell->render_cache, list);
+              g_queue_push_head_link (shell->render_cache, list);
+            }
+
+          if (tile->level != level)
+            {
+              cairo_region_destroy (tile->valid);
+              tile->valid = cairo_region_create ();
+              tile->level = level;
+            }
+
+          return tile;
+        }
     }
 
-  /*  put it to the screen  */
-  {
-    gint disp_xoffset, disp_yoffset;
+  if (g_queue_get_length (shell->render_cache) >= GIMP_DISPLAY_RENDER_CACHE_SIZE)
+    {
+      /*  recycle the least recently used tile  */
+      tile = g_queue_pop_tail (shell->render_cache);
 
-    cairo_save (cr);
+      cairo_region_destroy (tile->valid);
+    }
+  else
+    {
+      tile = g_slice_new (RenderCacheTile);
 
-    gimp_display_shell_scroll_get_disp_offset (shell,
-                                               &disp_xoffset, &disp_yoffset);
+      if (shell->display->config->accelerated_canvas)
+        tile->surface =
+          cairo_surface_create_similar (cairo_get_target (cr),
+                                        CAIRO_CONTENT_COLOR_ALPHA,
+                                        GIMP_DISPLAY_RENDER_BUF_WIDTH,
+                                        GIMP_DISPLAY_RENDER_BUF_HEIGHT);
+      else
+        tile->surface =
+          cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                      GIMP_DISPLAY_RENDER_BUF_WIDTH,
+                                      GIMP_DISPLAY_RENDER_BUF_HEIGHT);
+    }
 
-    cairo_rectangle (cr, x + disp_xoffset, y + disp_yoffset, w, h);
-    cairo_clip (cr);
+  tile->scale_x = shell->scale_x;
+  tile->scale_y = shell->scale_y;
+  tile->level   = level;
+  tile->x       = x;
+  tile->y       = y;
+  tile->valid   = cairo_region_create ();
 
-    cairo_set_source_surface (cr, shell->render_surface,
-                              x + disp_xoffset, y + disp_yoffset);
-    cairo_paint (cr);
+  g_queue_push_head (shell->render_cache, tile);
 
-    if (shell->mask)
-      {
-        gimp_cairo_set_source_rgba (cr, &shell->mask_color);
-        cairo_mask_surface (cr, shell->mask_surface,
-                            x + disp_xoffset, y + disp_yoffset);
-      }
+  return tile;
+}
 
-    cairo_restore (cr);
-  }
+static void
+render_cache_tile_free (RenderCacheTile *tile)
+{
+  cairo_surface_destroy (tile->surface);
+  cairo_region_destroy (tile->valid);
+
+  g_slice_free (RenderCacheTile, tile);
 }
 
 /*  render a GRAY tile to an A8 cairo surface  */
@@ -382,6 +862,7 @@ gimp_display_shell_render_info_init (RenderInfo       *info,
   info->dest_bpl    = cairo_image_surface_get_stride (dest);
 
   info->src_tiles      = tiles;
+  info->src_table      = NULL;
   info->src_is_premult = is_premult;
 
   info->scalex      = shell->scale_x * (1 << level);
@@ -447,8 +928,111 @@ gimp_display_shell_render_info_init (RenderInfo       *info,
       info->zoom_quality = GIMP_DISPLAY_ZOOM_PIXEL_AA;
       break;
     }
+
+#ifdef GIMP_DISPLAY_RENDER_SSE2
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+    info->zoom_quality |= GIMP_DISPLAY_ZOOM_SSE2;
+#endif
+}
+
+#ifdef GIMP_DISPLAY_RENDER_SSE2
+
+/* low 32 bits of the product of each 32-bit lane of a with w */
+static inline __m128i
+mullo_epi32_sse2 (const __m128i a,
+                  const __m128i w)
+{
+  const __m128i even = _mm_mul_epu32 (a, w);
+  const __m128i odd  = _mm_mul_epu32 (_mm_srli_epi64 (a, 32), w);
+
+  return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)),
+                             _mm_shuffle_epi32 (odd,  _MM_SHUFFLE (0, 0, 2, 0)));
 }
 
+/* Same as box_filter() for 4 bpp pre-multiplied data, producing
+ * bit-identical results: all four channels are filtered at once and
+ * the integer division by the (constant) sum of weights is done as a
+ * multiplication with its reciprocal in double precision.  The sums
+ * are below 2^26, so the product is off by far less than the bias we
+ * add before truncating.
+ */
+static inline void
+box_filter_sse2 (const guint    left_weight,
+                 const guint    center_weight,
+                 const guint    right_weight,
+                 const guint    top_weight,
+                 const guint    middle_weight,
+                 const guint    bottom_weight,
+                 const guchar **src,
+                 guchar        *dest)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i tm   = _mm_set_epi16 (middle_weight, top_weight,
+                                      middle_weight, top_weight,
+                                      middle_weight, top_weight,
+                                      middle_weight, top_weight);
+  const __m128i b0   = _mm_set_epi16 (0, bottom_weight, 0, bottom_weight,
+                                      0, bottom_weight, 0, bottom_weight);
+  const __m128d inv  = _mm_set1_pd (1.0 /
+                                    ((left_weight + center_weight +
+                                      right_weight) *
+                                     (top_weight + middle_weight +
+                                      bottom_weight)));
+  const __m128d bias = _mm_set1_pd (1.0 / (1 << 20));
+  __m128i       col[3];
+  __m128i       sum;
+  __m128d       dlo, dhi;
+  __m128i       lo, hi;
+  guint32       result;
+  gint          i;
+
+  /*  vertical pass, one column of three pixels at a time  */
+  for (i = 0; i < 3; i++)
+    {
+      guint32 t, m, b;
+      __m128i tv, mv, bv;
+
+      memcpy (&t, src[i],     4);
+      memcpy (&m, src[i + 3], 4);
+      memcpy (&b, src[i + 6], 4);
+
+      tv = _mm_unpacklo_epi8 (_mm_cvtsi32_si128 (t), zero);
+      mv = _mm_unpacklo_epi8 (_mm_cvtsi32_si128 (m), zero);
+      bv = _mm_unpacklo_epi8 (_mm_cvtsi32_si128 (b), zero);
+
+      col[i] = _mm_add_epi32 (_mm_madd_epi16 (_mm_unpacklo_epi16 (tv, mv),
+                                              tm),
+                              _mm_madd_epi16 (_mm_unpacklo_epi16 (bv, zero),
+                                              b0));
+    }
+
+  /*  horizontal pass  */
+  sum = _mm_add_epi32 (mullo_epi32_sse2 (col[0],
+                                         _mm_set1_epi32 (left_weight)),
+                       mullo_epi32_sse2 (col[1],
+                                         _mm_set1_epi32 (center_weight)));
+  sum = _mm_add_epi32 (sum,
+                       mullo_epi32_sse2 (col[2],
+                                         _mm_set1_epi32 (right_weight)));
+
+  /*  divide by the sum of weights  */
+  dlo = _mm_add_pd (_mm_mul_pd (_mm_cvtepi32_pd (sum), inv), bias);
+  dhi = _mm_add_pd (_mm_mul_pd (_mm_cvtepi32_pd (_mm_srli_si128 (sum, 8)), inv),
+                    bias);
+
+  lo = _mm_cvttpd_epi32 (dlo);
+  hi = _mm_cvttpd_epi32 (dhi);
+
+  sum = _mm_unpacklo_epi64 (lo, hi);
+  sum = _mm_packs_epi32 (sum, sum);
+  sum = _mm_packus_epi16 (sum, sum);
+
+  result = _mm_cvtsi128_si32 (sum);
+  memcpy (dest, &result, 4);
+}
+
+#endif /* GIMP_DISPLAY_RENDER_SSE2 */
+
 /* This version assumes that the src data is already pre-multiplied. */
 static inline void
 box_filter (const guint    left_weight,
@@ -459,12 +1043,23 @@ box_filter (const guint    left_weight,
             const guint    bottom_weight,
             const guchar **src,   /* the 9 surrounding source pixels */
             guchar        *dest,
-            const gint     bpp)
+            const gint     bpp,
+            const gint     zoom_quality)
 {
   const guint sum = ((left_weight + center_weight + right_weight) *
                      (top_weight + middle_weight + bottom_weight));
   gint i;
 
+#ifdef GIMP_DISPLAY_RENDER_SSE2
+  if (bpp == 4 && (zoom_quality & GIMP_DISPLAY_ZOOM_SSE2))
+    {
+      box_filter_sse2 (left_weight, center_weight, right_weight,
+                       top_weight, middle_weight, bottom_weight,
+                       src, dest);
+      return;
+    }
+#endif
+
   for (i = 0; i < bpp; i++)
     {
       dest[i] = ( left_weight   * ((src[0][i] * top_weight) +
@@ -689,37 +1284,19 @@ render_image_tile_fault (RenderInfo *info)
 
   middle_weight = info->footprint_y - top_weight - bottom_weight;
 
-  tile[4] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x, info->src_y,
-                                   TRUE, FALSE);
-  tile[7] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x, info->src_y + 1,
-                                   TRUE, FALSE);
-  tile[1] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x, info->src_y - 1,
-                                   TRUE, FALSE);
-
-  tile[5] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x + 1, info->src_y,
-                                   TRUE, FALSE);
-  tile[8] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x + 1, info->src_y + 1,
-                                   TRUE, FALSE);
-  tile[2] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x + 1, info->src_y - 1,
-                                   TRUE, FALSE);
-
-  tile[3] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x - 1, info->src_y,
-                                   TRUE, FALSE);
-  tile[6] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x - 1, info->src_y + 1,
-                                   TRUE, FALSE);
-  tile[0] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x - 1, info->src_y - 1,
-                                   TRUE, FALSE);
-
-  g_return_val_if_fail (tile[4] != NULL, tile_buf);
+  tile[4] = render_get_tile (info, info->src_x, info->src_y);
+  tile[7] = render_get_tile (info, info->src_x, info->src_y + 1);
+  tile[1] = render_get_tile (info, info->src_x, info->src_y - 1);
+
+  tile[5] = render_get_tile (info, info->src_x + 1, info->src_y);
+  tile[8] = render_get_tile (info, info->src_x + 1, info->src_y + 1);
+  tile[2] = render_get_tile (info, info->src_x + 1, info->src_y - 1);
+
+  tile[3] = render_get_tile (info, info->src_x - 1, info->src_y);
+  tile[6] = render_get_tile (info, info->src_x - 1, info->src_y + 1);
+  tile[0] = render_get_tile (info, info->src_x - 1, info->src_y - 1);
+
+  g_return_val_if_fail (tile[4] != NULL, info->tile_buf);
 
   src[4] = tile_data_pointer (tile[4], info->src_x, info->src_y);
 
@@ -796,7 +1373,7 @@ render_image_tile_fault (RenderInfo *info)
     }
 
   bpp    = tile_manager_bpp (info->src_tiles);
-  dest   = tile_buf;
+  dest   = info->tile_buf;
 
   dx     = info->dx_start;
   src_x  = info->src_x;
@@ -840,7 +1417,7 @@ render_image_tile_fault (RenderInfo *info)
       if (info->src_is_premult)
         box_filter (left_weight, center_weight, right_weight,
                     top_weight, middle_weight, bottom_weight,
-                    src, dest, bpp);
+                    src, dest, bpp, info->zoom_quality);
       else
         box_filter_premult (left_weight, center_weight, right_weight,
                             top_weight, middle_weight, bottom_weight,
@@ -903,24 +1480,18 @@ render_image_tile_fault (RenderInfo *info)
 
           if ((src_x / TILE_WIDTH) != tilex0)
             {
-              tile_release (tile[4], FALSE);
+              render_release_tile (info, tile[4]);
 
               if (tile[7])
-                tile_release (tile[7], FALSE);
+                render_release_tile (info, tile[7]);
               if (tile[1])
-                tile_release (tile[1], FALSE);
+                render_release_tile (info, tile[1]);
 
               tilex0 += 1;
 
-              tile[4] = tile_manager_get_tile (info->src_tiles,
-                                               src_x, info->src_y,
-                                               TRUE, FALSE);
-              tile[7] = tile_manager_get_tile (info->src_tiles,
-                                               src_x, info->src_y + 1,
-                                               TRUE, FALSE);
-              tile[1] = tile_manager_get_tile (info->src_tiles,
-                                               src_x, info->src_y - 1,
-                                               TRUE, FALSE);
+              tile[4] = render_get_tile (info, src_x, info->src_y);
+              tile[7] = render_get_tile (info, src_x, info->src_y + 1);
+              tile[1] = render_get_tile (info, src_x, info->src_y - 1);
               if (! tile[4])
                 goto done;
 
@@ -950,23 +1521,17 @@ render_image_tile_fault (RenderInfo *info)
           if (((src_x + 1) / TILE_WIDTH) != tilex1)
             {
               if (tile[5])
-                tile_release (tile[5], FALSE);
+                render_release_tile (info, tile[5]);
               if (tile[8])
-                tile_release (tile[8], FALSE);
+                render_release_tile (info, tile[8]);
               if (tile[2])
-                tile_release (tile[2], FALSE);
+                render_release_tile (info, tile[2]);
 
               tilex1 += 1;
 
-              tile[5] = tile_manager_get_tile (info->src_tiles,
-                                               src_x + 1, info->src_y,
-                                               TRUE, FALSE);
-              tile[8] = tile_manager_get_tile (info->src_tiles,
-                                               src_x + 1, info->src_y + 1,
-                                               TRUE, FALSE);
-              tile[2] = tile_manager_get_tile (info->src_tiles,
-                                               src_x + 1, info->src_y - 1,
-                                               TRUE, FALSE);
+              tile[5] = render_get_tile (info, src_x + 1, info->src_y);
+              tile[8] = render_get_tile (info, src_x + 1, info->src_y + 1);
+              tile[2] = render_get_tile (info, src_x + 1, info->src_y - 1);
 
               if (! tile[5])
                 {
@@ -1002,23 +1567,17 @@ render_image_tile_fault (RenderInfo *info)
           if (((src_x - 1) / TILE_WIDTH) != tilexL)
             {
               if (tile[0])
-                tile_release (tile[0], FALSE);
+                render_release_tile (info, tile[0]);
               if (tile[3])
-                tile_release (tile[3], FALSE);
+                render_release_tile (info, tile[3]);
               if (tile[6])
-                tile_release (tile[6], FALSE);
+                render_release_tile (info, tile[6]);
 
               tilexL += 1;
 
-              tile[0] = tile_manager_get_tile (info->src_tiles,
-                                               src_x - 1, info->src_y - 1,
-                                               TRUE, FALSE);
-              tile[3] = tile_manager_get_tile (info->src_tiles,
-                                               src_x - 1, info->src_y,
-                                               TRUE, FALSE);
-              tile[6] = tile_manager_get_tile (info->src_tiles,
-                                               src_x - 1, info->src_y + 1,
-                                               TRUE, FALSE);
+              tile[0] = render_get_tile (info, src_x - 1, info->src_y - 1);
+              tile[3] = render_get_tile (info, src_x - 1, info->src_y);
+              tile[6] = render_get_tile (info, src_x - 1, info->src_y + 1);
 
               if (! tile[3])
                 {
@@ -1058,9 +1617,9 @@ render_image_tile_fault (RenderInfo *info)
 done:
   for (dx = 0; dx < 9; dx++)
     if (tile[dx])
-      tile_release (tile[dx], FALSE);
+      render_release_tile (info, tile[dx]);
 
-  return tile_buf;
+  return info->tile_buf;
 }
 
 static const guchar *
@@ -1112,16 +1671,13 @@ render_image_tile_fault_one_row (RenderInfo *info)
 
   middle_weight = info->footprint_y - top_weight - bottom_weight;
 
-  tile[0] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x, info->src_y, TRUE, FALSE);
+  tile[0] = render_get_tile (info, info->src_x, info->src_y);
 
-  tile[1] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x + 1, info->src_y, TRUE, FALSE);
+  tile[1] = render_get_tile (info, info->src_x + 1, info->src_y);
 
-  tile[2] = tile_manager_get_tile (info->src_tiles,
-                                   info->src_x - 1, info->src_y, TRUE, FALSE);
+  tile[2] = render_get_tile (info, info->src_x - 1, info->src_y);
 
-  g_return_val_if_fail (tile[0] != NULL, tile_buf);
+  g_return_val_if_fail (tile[0] != NULL, info->tile_buf);
 
   src[4] = tile_data_pointer (tile[0], info->src_x, info->src_y);
   src[7] = tile_data_pointer (tile[0], info->src_x, info->src_y + 1);
@@ -1176,7 +1732,7 @@ render_image_tile_fault_one_row (RenderInfo *info)
     }
 
   bpp    = tile_manager_bpp (info->src_tiles);
-  dest   = tile_buf;
+  dest   = info->tile_buf;
 
   dx     = info->dx_start;
   src_x  = info->src_x;
@@ -1212,7 +1768,7 @@ render_image_tile_fault_one_row (RenderInfo *info)
       if (info->src_is_premult)
         box_filter (left_weight, center_weight, right_weight,
                     top_weight, middle_weight, bottom_weight,
-                    src, dest, bpp);
+                    src, dest, bpp, info->zoom_quality);
       else
         box_filter_premult (left_weight, center_weight, right_weight,
                             top_weight, middle_weight, bottom_weight,
@@ -1275,12 +1831,11 @@ render_image_tile_fault_one_row (RenderInfo *info)
 
           if ((src_x / TILE_WIDTH) != tilex0)
             {
-              tile_release (tile[0], FALSE);
+              render_release_tile (info, tile[0]);
 
               tilex0 += 1;
 
-              tile[0] = tile_manager_get_tile (info->src_tiles,
-                                               src_x, info->src_y, TRUE, FALSE);
+              tile[0] = render_get_tile (info, src_x, info->src_y);
               if (! tile[0])
                 goto done;
 
@@ -1292,13 +1847,11 @@ render_image_tile_fault_one_row (RenderInfo *info)
           if (((src_x + 1) / TILE_WIDTH) != tilex1)
             {
               if (tile[1])
-                tile_release (tile[1], FALSE);
+                render_release_tile (info, tile[1]);
 
               tilex1 += 1;
 
-              tile[1] = tile_manager_get_tile (info->src_tiles,
-                                               src_x + 1, info->src_y,
-                                               TRUE, FALSE);
+              tile[1] = render_get_tile (info, src_x + 1, info->src_y);
 
               if (! tile[1])
                 {
@@ -1320,13 +1873,11 @@ render_image_tile_fault_one_row (RenderInfo *info)
           if (((src_x - 1) / TILE_WIDTH) != tilexL)
             {
               if (tile[2])
-                tile_release (tile[2], FALSE);
+                render_release_tile (info, tile[2]);
 
               tilexL += 1;
 
-              tile[2] = tile_manager_get_tile (info->src_tiles,
-                                               src_x - 1, info->src_y,
-                                               TRUE, FALSE);
+              tile[2] = render_get_tile (info, src_x - 1, info->src_y);
 
               if (! tile[2])
                 {
@@ -1351,9 +1902,9 @@ render_image_tile_fault_one_row (RenderInfo *info)
 done:
   for (dx = 0; dx < 3; dx++)
     if (tile[dx])
-      tile_release (tile[dx], FALSE);
+      render_release_tile (info, tile[dx]);
 
-  return tile_buf;
+  return info->tile_buf;
 }
 
 /* function to render a horizontal line of view data */
@@ -1369,10 +1920,9 @@ render_image_tile_fault_nearest (RenderInfo *info)
   gint          src_x;
   gint64        dx;
 
-  tile = tile_manager_get_tile (info->src_tiles,
-                                info->src_x, info->src_y, TRUE, FALSE);
+  tile = render_get_tile (info, info->src_x, info->src_y);
 
-  g_return_val_if_fail (tile != NULL, tile_buf);
+  g_return_val_if_fail (tile != NULL, info->tile_buf);
 
   src = tile_data_pointer (tile, info->src_x, info->src_y);
 
@@ -1385,7 +1935,7 @@ render_image_tile_fault_nearest (RenderInfo *info)
   src_x = info->src_x;
   tilex = info->src_x / TILE_WIDTH;
 
-  d     = tile_buf;
+  d     = info->tile_buf;
 
   do
     {
@@ -1451,13 +2001,12 @@ render_image_tile_fault_nearest (RenderInfo *info)
 
           if ((src_x / TILE_WIDTH) != tilex)
             {
-              tile_release (tile, FALSE);
+              render_release_tile (info, tile);
               tilex += 1;
 
-              tile = tile_manager_get_tile (info->src_tiles,
-                                            src_x, info->src_y, TRUE, FALSE);
+              tile = render_get_tile (info, src_x, info->src_y);
               if (! tile)
-                return tile_buf;
+                return info->tile_buf;
 
               src = tile_data_pointer (tile, src_x, info->src_y);
             }
@@ -1465,7 +2014,7 @@ render_image_tile_fault_nearest (RenderInfo *info)
     }
   while (--width);
 
-  tile_release (tile, FALSE);
+  render_release_tile (info, tile);
 
-  return tile_buf;
+  return info->tile_buf;
 }
@@ -55,6 +55,16 @@ struct _Selection
   gboolean          show_selection;   /*  is the selection visible?         */
   guint             timeout;          /*  timer for successive draws        */
   cairo_pattern_t  *segs_in_mask;     /*  cache for rendered segments       */
+
+  /*  what the current segments were generated from  */
+  gboolean          segs_cached;      /*  can they be reused?               */
+  guint             segs_stamp;       /*  boundary stamp of the mask        */
+  gdouble           segs_scale_x;
+  gdouble           segs_scale_y;
+  gint              segs_offset_x;
+  gint              segs_offset_y;
+  gint              segs_width;
+  gint              segs_height;
 };
 
 
@@ -350,18 +360,54 @@ selection_transform_segs (Selection          *selection,
 static void
 selection_generate_segs (Selection *selection)
 {
-  GimpImage          *image = gimp_display_get_image (selection->shell->display);
+  GimpDisplayShell   *shell = selection->shell;
+  GimpImage          *image = gimp_display_get_image (shell->display);
+  GimpChannel        *mask  = gimp_image_get_mask (image);
   const GimpBoundSeg *segs_in;
   const GimpBoundSeg *segs_out;
+  gint                n_segs_in;
+  gint                n_segs_out;
 
   /*  Ask the image for the boundary of its selected region...
    *  Then transform that information into a new buffer of GimpSegments
    */
-  gimp_channel_boundary (gimp_image_get_mask (image),
+  gimp_channel_boundary (mask,
                          &segs_in, &segs_out,
-                         &selection->n_segs_in, &selection->n_segs_out,
+                         &n_segs_in, &n_segs_out,
                          0, 0, 0, 0);
 
+  /*  Keep the transformed segments and the rendered mask if neither
+   *  the boundary nor the view changed.  The inner boundary of a
+   *  floating selection does not come from the mask, so it is never
+   *  reused.
+   */
+  if (selection->segs_cached                          &&
+      ! gimp_image_get_floating_selection (image)     &&
+      selection->segs_stamp    == mask->boundary_stamp &&
+      selection->segs_scale_x  == shell->scale_x      &&
+      selection->segs_scale_y  == shell->scale_y      &&
+      selection->segs_offset_x == shell->offset_x     &&
+      selection->segs_offset_y == shell->offset_y     &&
+      selection->segs_width    == shell->disp_width   &&
+      selection->segs_height   == shell->disp_height)
+    {
+      return;
+    }
+
+  selection_free_segs (selection);
+
+  selection->n_segs_in  = n_segs_in;
+  selection->n_segs_out = n_segs_out;
+
+  selection->segs_cached   = TRUE;
+  selection->segs_stamp    = mask->boundary_stamp;
+  selection->segs_scale_x  = shell->scale_x;
+  selection->segs_scale_y  = shell->scale_y;
+  selection->segs_offset_x = shell->offset_x;
+  selection->segs_offset_y = shell->offset_y;
+  selection->segs_width    = shell->disp_width;
+  selection->segs_height   = shell->disp_height;
+
   if (selection->n_segs_in)
     {
       selection->segs_in = g_new (GimpSegment, selection->n_segs_in);
@@ -391,6 +437,8 @@ selection_generate_segs (Selection *selection)
 static void
 selection_free_segs (Selection *selection)
 {
+  selection->segs_cached = FALSE;
+
   if (selection->segs_in)
     {
       g_free (selection->segs_in);
@@ -415,11 +463,13 @@ selection_free_segs (Selection *selection)
 static gboolean
 selection_start_timeout (Selection *selection)
 {
-  selection_free_segs (selection);
   selection->timeout = 0;
 
   if (! gimp_display_get_image (selection->shell->display))
-    return FALSE;
+    {
+      selection_free_segs (selection);
+      return FALSE;
+    }
 
   selection_generate_segs (selection);
 
@@ -158,6 +158,8 @@ static void   gimp_display_shell_transform_overlay (GimpDisplayShell *shell,
                                                     GtkWidget        *child,
                                                     gdouble          *x,
                                                     gdouble          *y);
+static void   gimp_display_shell_update_priority_rect
+                                                   (GimpDisplayShell *shell);
 
 
 G_DEFINE_TYPE_WITH_CODE (GimpDisplayShell, gimp_display_shell,
@@ -294,6 +296,7 @@ gimp_display_shell_init (GimpDisplayShell *shell)
   shell->render_surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
                                                       GIMP_DISPLAY_RENDER_BUF_WIDTH,
                                                       GIMP_DISPLAY_RENDER_BUF_HEIGHT);
+  shell->render_cache   = g_queue_new ();
 
   gimp_display_shell_items_init (shell);
 
@@ -770,6 +773,13 @@ gimp_display_shell_dispose (GObject *object)
       shell->filter_idle_id = 0;
     }
 
+  if (shell->render_cache)
+    {
+      gimp_display_shell_render_invalidate_full (shell);
+      g_queue_free (shell->render_cache);
+      shell->render_cache = NULL;
+    }
+
   if (shell->render_surface)
     {
       cairo_surface_destroy (shell->render_surface);
@@ -1152,6 +1162,27 @@ gimp_display_shell_transform_overlay (GimpDisplayShell *shell,
     }
 }
 
+static void
+gimp_display_shell_update_priority_rect (GimpDisplayShell *shell)
+{
+  GimpImage *image = NULL;
+
+  if (shell->display)
+    image = gimp_display_get_image (shell->display);
+
+  if (image)
+    {
+      gint x, y;
+      gint width, height;
+
+      gimp_display_shell_untransform_viewport (shell,
+                                               &x, &y, &width, &height);
+
+      gimp_projection_set_priority_rect (gimp_image_get_projection (image),
+                                         x, y, width, height);
+    }
+}
+
 
 /*  public functions  */
 
@@ -1448,6 +1479,8 @@ gimp_display_shell_scaled (GimpDisplayShell *shell)
                                            child, x, y);
     }
 
+  gimp_display_shell_update_priority_rect (shell);
+
   g_signal_emit (shell, display_shell_signals[SCALED], 0);
 }
 
@@ -1469,6 +1502,8 @@ gimp_display_shell_scrolled (GimpDisplayShell *shell)
                                            child, x, y);
     }
 
+  gimp_display_shell_update_priority_rect (shell);
+
   g_signal_emit (shell, display_shell_signals[SCROLLED], 0);
 }
 
@@ -115,6 +115,7 @@ struct _GimpDisplayShell
   GtkWidget         *statusbar;        /*  statusbar                          */
 
   cairo_surface_t   *render_surface;   /*  buffer for rendering the image     */
+  GQueue            *render_cache;     /*  rendered tiles, most recent first  */
   cairo_surface_t   *mask_surface;     /*  buffer for rendering the mask      */
   cairo_pattern_t   *checkerboard;     /*  checkerboard pattern               */
 
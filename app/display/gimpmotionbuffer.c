@@ -22,6 +22,7 @@
 #include <gegl.h>
 #include <gtk/gtk.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
 
 #include "display-types.h"
@@ -32,17 +33,21 @@
 
 #include "gimpmotionbuffer.h"
 
+#include "gimp-log.h"
+
 
 /* Velocity unit is screen pixels per millisecond we pass to tools as 1. */
 #define VELOCITY_UNIT        3.0
 #define EVENT_FILL_PRECISION 6.0
 #define DIRECTION_RADIUS     (1.5 / MAX (scale_x, scale_y))
 #define SMOOTH_FACTOR        0.3
+#define LATENCY_SMOOTH       0.1
 
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_COALESCE_INTERVAL
 };
 
 enum
@@ -75,6 +80,13 @@ static void     gimp_motion_buffer_interpolate_stroke  (GimpMotionBuffer *buffer
                                                         GimpCoords       *coords);
 static gboolean gimp_motion_buffer_event_queue_timeout (GimpMotionBuffer *buffer);
 
+static void     gimp_motion_buffer_emit_stroke         (GimpMotionBuffer *buffer,
+                                                        GdkModifierType   state,
+                                                        guint32           time,
+                                                        gint              keep);
+static gboolean gimp_motion_buffer_coalesce_timeout    (GimpMotionBuffer *buffer);
+static void     gimp_motion_buffer_flush_coalesced     (GimpMotionBuffer *buffer);
+
 
 G_DEFINE_TYPE (GimpMotionBuffer, gimp_motion_buffer, GIMP_TYPE_OBJECT)
 
@@ -118,6 +130,12 @@ gimp_motion_buffer_class_init (GimpMotionBufferClass *klass)
   object_class->finalize     = gimp_motion_buffer_finalize;
   object_class->set_property = gimp_motion_buffer_set_property;
   object_class->get_property = gimp_motion_buffer_get_property;
+
+  g_object_class_install_property (object_class, PROP_COALESCE_INTERVAL,
+                                   g_param_spec_int ("coalesce-interval",
+                                                     NULL, NULL,
+                                                     0, 100, 0,
+                                                     GIMP_PARAM_READWRITE));
 }
 
 static void
@@ -138,6 +156,12 @@ gimp_motion_buffer_dispose (GObject *object)
       buffer->event_delay_timeout = 0;
     }
 
+  if (buffer->coalesce_timeout)
+    {
+      g_source_remove (buffer->coalesce_timeout);
+      buffer->coalesce_timeout = 0;
+    }
+
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
@@ -167,8 +191,16 @@ gimp_motion_buffer_set_property (GObject      *object,
                                  const GValue *value,
                                  GParamSpec   *pspec)
 {
+  GimpMotionBuffer *buffer = GIMP_MOTION_BUFFER (object);
+
   switch (property_id)
     {
+    case PROP_COALESCE_INTERVAL:
+      buffer->coalesce_interval = g_value_get_int (value);
+      if (buffer->coalesce_interval == 0)
+        gimp_motion_buffer_flush_coalesced (buffer);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -181,8 +213,14 @@ gimp_motion_buffer_get_property (GObject    *object,
                                  GValue     *value,
                                  GParamSpec *pspec)
 {
+  GimpMotionBuffer *buffer = GIMP_MOTION_BUFFER (object);
+
   switch (property_id)
     {
+    case PROP_COALESCE_INTERVAL:
+      g_value_set_int (value, buffer->coalesce_interval);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -224,6 +262,9 @@ gimp_motion_buffer_end_stroke (GimpMotionBuffer *buffer)
     }
 
   gimp_motion_buffer_event_queue_timeout (buffer);
+
+  /*  the tool must have seen all motion before the button release  */
+  gimp_motion_buffer_flush_coalesced (buffer);
 }
 
 /**
@@ -400,6 +441,11 @@ gimp_motion_buffer_motion_event (GimpMotionBuffer *buffer,
         {
           if (buffer->event_delay)
             {
+              /*  the interpolation replaces the one held back event,
+               *  so send any others first
+               */
+              gimp_motion_buffer_flush_coalesced (buffer);
+
               gimp_motion_buffer_interpolate_stroke (buffer, coords);
             }
           else
@@ -428,6 +474,9 @@ gimp_motion_buffer_motion_event (GimpMotionBuffer *buffer,
 #endif
     }
 
+  if (buffer->event_queue->len == 0)
+    buffer->queue_time = g_get_monotonic_time ();
+
   g_array_append_val (buffer->event_queue, *coords);
 
   buffer->last_coords            = *coords;
@@ -479,14 +528,24 @@ gimp_motion_buffer_request_stroke (GimpMotionBuffer *buffer,
 
   buffer->last_active_state = state;
 
-  while (buffer->event_queue->len > keep)
+  if (buffer->coalesce_interval > 0)
     {
-      GimpCoords buf_coords;
-
-      gimp_motion_buffer_pop_event_queue (buffer, &buf_coords);
-
-      g_signal_emit (buffer, motion_buffer_signals[STROKE], 0,
-                     &buf_coords, time, event_state);
+      /*  collect the events for one batch, the state and time of
+       *  the last request are used for all of them
+       */
+      buffer->coalesce_state = event_state;
+      buffer->coalesce_time  = time;
+      buffer->coalesce_keep  = keep;
+
+      if (! buffer->coalesce_timeout)
+        buffer->coalesce_timeout =
+          g_timeout_add (buffer->coalesce_interval,
+                         (GSourceFunc) gimp_motion_buffer_coalesce_timeout,
+                         buffer);
+    }
+  else
+    {
+      gimp_motion_buffer_emit_stroke (buffer, event_state, time, keep);
     }
 
   if (buffer->event_delay)
@@ -519,6 +578,40 @@ gimp_motion_buffer_request_hover (GimpMotionBuffer *buffer,
 }
 
 
+/**
+ * gimp_motion_buffer_is_batch_pending:
+ * @buffer: a #GimpMotionBuffer
+ *
+ * While the "stroke" signal is emitted for a batch of events, this
+ * tells if more events of the batch follow, so the handler can leave
+ * expensive updates, like flushing the display, to the last one.
+ *
+ * Return value: %TRUE if more "stroke" emissions follow immediately.
+ **/
+gboolean
+gimp_motion_buffer_is_batch_pending (GimpMotionBuffer *buffer)
+{
+  g_return_val_if_fail (GIMP_IS_MOTION_BUFFER (buffer), FALSE);
+
+  return buffer->batch_remaining > 0;
+}
+
+/**
+ * gimp_motion_buffer_get_latency:
+ * @buffer: a #GimpMotionBuffer
+ *
+ * Return value: the smoothed time in milliseconds from the arrival of
+ *               a motion event until its "stroke" emission returned.
+ **/
+gdouble
+gimp_motion_buffer_get_latency (GimpMotionBuffer *buffer)
+{
+  g_return_val_if_fail (GIMP_IS_MOTION_BUFFER (buffer), 0.0);
+
+  return buffer->latency;
+}
+
+
 /*  private functions  */
 
 static void
@@ -598,3 +691,75 @@ gimp_motion_buffer_event_queue_timeout (GimpMotionBuffer *buffer)
 
   return FALSE;
 }
+
+static void
+gimp_motion_buffer_emit_stroke (GimpMotionBuffer *buffer,
+                                GdkModifierType   state,
+                                guint32           time,
+                                gint              keep)
+{
+  gint64 queue_time = buffer->queue_time;
+  gint   n_events   = buffer->event_queue->len - keep;
+
+  if (n_events <= 0)
+    return;
+
+  buffer->batch_remaining = n_events;
+
+  while (buffer->event_queue->len > keep)
+    {
+      GimpCoords buf_coords;
+
+      gimp_motion_buffer_pop_event_queue (buffer, &buf_coords);
+
+      buffer->batch_remaining--;
+
+      g_signal_emit (buffer, motion_buffer_signals[STROKE], 0,
+                     &buf_coords, time, state);
+    }
+
+  buffer->batch_remaining = 0;
+
+  if (queue_time)
+    {
+      gint64  now     = g_get_monotonic_time ();
+      gdouble latency = (now - queue_time) / 1000.0;
+
+      if (buffer->latency == 0.0)
+        buffer->latency = latency;
+      else
+        buffer->latency = (buffer->latency * (1.0 - LATENCY_SMOOTH) +
+                           latency * LATENCY_SMOOTH);
+
+      GIMP_LOG (TOOL_EVENTS,
+                "%d events in %.1f ms (smoothed latency %.1f ms)",
+                n_events, latency, buffer->latency);
+
+      /*  the held back event waits from now on  */
+      buffer->queue_time = buffer->event_queue->len > 0 ? now : 0;
+    }
+}
+
+static gboolean
+gimp_motion_buffer_coalesce_timeout (GimpMotionBuffer *buffer)
+{
+  buffer->coalesce_timeout = 0;
+
+  gimp_motion_buffer_emit_stroke (buffer,
+                                  buffer->coalesce_state,
+                                  buffer->coalesce_time,
+                                  buffer->coalesce_keep);
+
+  return FALSE;
+}
+
+static void
+gimp_motion_buffer_flush_coalesced (GimpMotionBuffer *buffer)
+{
+  if (buffer->coalesce_timeout)
+    {
+      g_source_remove (buffer->coalesce_timeout);
+
+      gimp_motion_buffer_coalesce_timeout (buffer);
+    }
+}
@@ -56,6 +56,21 @@ struct _GimpMotionBuffer
 
   gint               event_delay_timeout;
   GdkModifierType    last_active_state;
+
+  /*  motion event coalescing  */
+  gint               coalesce_interval; /* in ms, 0 means off             */
+  gint               coalesce_timeout;
+  GdkModifierType    coalesce_state;
+  guint32            coalesce_time;
+  gint               coalesce_keep;
+  gint               batch_remaining;   /* coords of the batch being sent */
+
+  gint64             queue_time;        /* arrival of the oldest queued
+                                         *  event
+                                         */
+  gdouble            latency;           /* smoothed event to screen time,
+                                         *  in ms
+                                         */
 };
 
 struct _GimpMotionBufferClass
@@ -97,5 +112,8 @@ void       gimp_motion_buffer_request_hover        (GimpMotionBuffer *buffer,
                                                     GdkModifierType   state,
                                                     gboolean          proximity);
 
+gboolean   gimp_motion_buffer_is_batch_pending     (GimpMotionBuffer *buffer);
+gdouble    gimp_motion_buffer_get_latency          (GimpMotionBuffer *buffer);
+
 
 #endif /* __GIMP_MOTION_BUFFER_H__ */
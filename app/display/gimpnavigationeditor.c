@@ -36,6 +36,7 @@
 #include "core/gimp.h"
 #include "core/gimpcontext.h"
 #include "core/gimpimage.h"
+#include "core/gimpprojection.h"
 
 #include "widgets/gimpdocked.h"
 #include "widgets/gimphelp-ids.h"
@@ -43,6 +44,7 @@
 #include "widgets/gimpnavigationview.h"
 #include "widgets/gimpuimanager.h"
 #include "widgets/gimpviewrenderer.h"
+#include "widgets/gimpviewrendererimage.h"
 
 #include "gimpdisplay.h"
 #include "gimpdisplayshell.h"
@@ -95,6 +97,16 @@ static void        gimp_navigation_editor_shell_reconnect   (GimpDisplayShell
                                                              GimpNavigationEditor *editor);
 static void        gimp_navigation_editor_update_marker     (GimpNavigationEditor *editor);
 
+static void        gimp_navigation_editor_set_image         (GimpNavigationEditor *editor,
+                                                             GimpImage            *image);
+static void        gimp_navigation_editor_projection_update (GimpProjection       *projection,
+                                                             gboolean              now,
+                                                             gint                  x,
+                                                             gint                  y,
+                                                             gint                  width,
+                                                             gint                  height,
+                                                             GimpNavigationEditor *editor);
+
 
 G_DEFINE_TYPE_WITH_CODE (GimpNavigationEditor, gimp_navigation_editor,
                          GIMP_TYPE_EDITOR,
@@ -479,8 +491,7 @@ gimp_navigation_editor_set_shell (GimpNavigationEditor *editor,
     {
       GimpImage *image = gimp_display_get_image (shell->display);
 
-      gimp_view_set_viewable (GIMP_VIEW (editor->view),
-                              GIMP_VIEWABLE (image));
+      gimp_navigation_editor_set_image (editor, image);
 
       g_signal_connect (editor->shell, "scaled",
                         G_CALLBACK (gimp_navigation_editor_shell_scaled),
@@ -496,7 +507,7 @@ gimp_navigation_editor_set_shell (GimpNavigationEditor *editor,
     }
   else
     {
-      gimp_view_set_viewable (GIMP_VIEW (editor->view), NULL);
+      gimp_navigation_editor_set_image (editor, NULL);
       gtk_widget_set_sensitive (GTK_WIDGET (editor), FALSE);
     }
 
@@ -687,8 +698,7 @@ gimp_navigation_editor_shell_reconnect (GimpDisplayShell     *shell,
 {
   GimpImage *image = gimp_display_get_image (shell->display);
 
-  gimp_view_set_viewable (GIMP_VIEW (editor->view),
-                          GIMP_VIEWABLE (image));
+  gimp_navigation_editor_set_image (editor, image);
 
   if (gimp_editor_get_ui_manager (GIMP_EDITOR (editor)))
     gimp_ui_manager_update (gimp_editor_get_ui_manager (GIMP_EDITOR (editor)),
@@ -715,3 +725,47 @@ gimp_navigation_editor_update_marker (GimpNavigationEditor *editor)
       gimp_navigation_view_set_marker (view, x, y, w, h);
     }
 }
+
+static void
+gimp_navigation_editor_set_image (GimpNavigationEditor *editor,
+                                  GimpImage            *image)
+{
+  if (editor->projection)
+    {
+      g_signal_handlers_disconnect_by_func (editor->projection,
+                                            gimp_navigation_editor_projection_update,
+                                            editor);
+      g_object_unref (editor->projection);
+      editor->projection = NULL;
+    }
+
+  gimp_view_set_viewable (GIMP_VIEW (editor->view), GIMP_VIEWABLE (image));
+
+  if (image)
+    {
+      editor->projection = g_object_ref (gimp_image_get_projection (image));
+
+      g_signal_connect (editor->projection, "update",
+                        G_CALLBACK (gimp_navigation_editor_projection_update),
+                        editor);
+    }
+}
+
+static void
+gimp_navigation_editor_projection_update (GimpProjection       *projection,
+                                          gboolean              now,
+                                          gint                  x,
+                                          gint                  y,
+                                          gint                  width,
+                                          gint                  height,
+                                          GimpNavigationEditor *editor)
+{
+  GimpViewRenderer *renderer = GIMP_VIEW (editor->view)->renderer;
+
+  /*  redraw only the changed part of the preview, instead of all of
+   *  it when the image's preview is invalidated after the flush
+   */
+  if (GIMP_IS_VIEW_RENDERER_IMAGE (renderer))
+    gimp_view_renderer_image_update_area (GIMP_VIEW_RENDERER_IMAGE (renderer),
+                                          x, y, width, height);
+}
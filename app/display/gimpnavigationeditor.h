@@ -44,6 +44,7 @@ struct _GimpNavigationEditor
 
   GimpContext      *context;
   GimpDisplayShell *shell;
+  GimpProjection   *projection;
 
   GtkWidget        *view;
   GtkWidget        *zoom_label;
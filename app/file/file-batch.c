@@ -0,0 +1,563 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * file-batch.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "config/gimpgeglconfig.h"
+
+#include "core/gimp.h"
+#include "core/gimp-gui.h"
+#include "core/gimpcontext.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-undo.h"
+#include "core/gimpparamspecs.h"
+#include "core/gimpprogress.h"
+
+#include "pdb/gimppdb.h"
+#include "pdb/gimpprocedure.h"
+
+#include "plug-in/gimppluginprocedure.h"
+
+#include "file-batch.h"
+#include "file-open.h"
+#include "file-save.h"
+
+#include "gimp-intl.h"
+
+
+typedef struct _FileBatch    FileBatch;
+typedef struct _FileBatchJob FileBatchJob;
+
+struct _FileBatch
+{
+  Gimp                *gimp;
+  GimpContext         *context;
+  GimpProgress        *progress;
+  GimpProcedure       *procedure;
+  const gchar         *dest_dir;
+  const gchar         *extension;
+  gboolean             merge_visible;
+
+  GimpFileBatchResult *results;
+  gint                 n_files;
+  gint                 next;
+  gint                 n_done;
+  gint                 n_running;
+  gint                 max_jobs;
+  gboolean             starting;
+
+  GMainLoop           *main_loop;
+};
+
+/*  one file on its way from being opened to being saved  */
+struct _FileBatchJob
+{
+  FileBatch           *batch;
+  GimpFileBatchResult *result;
+  GTimer              *timer;
+  GimpImage           *image;
+};
+
+
+static GPtrArray * file_batch_glob          (const gchar        *pattern,
+                                             GError            **error);
+static gboolean    file_batch_check_procedure
+                                            (GimpProcedure      *procedure,
+                                             GError            **error);
+static void        file_batch_start_jobs    (FileBatch          *batch);
+static void        file_batch_image_opened  (GimpImage          *image,
+                                             const gchar        *uri,
+                                             GimpPDBStatusType   status,
+                                             const GError       *error,
+                                             FileBatchJob       *job);
+static void        file_batch_image_processed
+                                            (GimpProcedure      *procedure,
+                                             GimpValueArray     *return_vals,
+                                             FileBatchJob       *job);
+static void        file_batch_save_image    (FileBatchJob       *job);
+static void        file_batch_image_saved   (GimpImage          *image,
+                                             const gchar        *uri,
+                                             GimpPDBStatusType   status,
+                                             const GError       *error,
+                                             FileBatchJob       *job);
+static void        file_batch_job_finish    (FileBatchJob       *job,
+                                             GimpPDBStatusType   status,
+                                             const gchar        *message);
+
+
+/*  public functions  */
+
+/**
+ * file_batch_run:
+ * @gimp:
+ * @context:
+ * @progress:       shows how many of the files are done
+ * @pattern:        the files to process, wildcards are allowed in the
+ *                  last path component
+ * @procedure_name: the procedure to run on each image, or %NULL
+ * @dest_dir:       the directory to save into, or %NULL for the
+ *                  directory of each file
+ * @extension:      the extension of the file type to save as
+ * @max_jobs:       the most files to work on at the same time, or 0
+ * @merge_visible:  whether to export the visible layers merged into one
+ * @n_results:      return location for the number of files
+ * @error:
+ *
+ * Opens each file matching @pattern, runs @procedure_name on it and
+ * saves it with @extension, with up to @max_jobs files on their way
+ * at the same time. @procedure_name must take the run mode, image
+ * and drawable as its first arguments, like filter plug-ins do, it
+ * is run non-interactively with the defaults for any others.
+ *
+ * Return value: the status and timing of each file, free them with
+ *               file_batch_results_free(). %NULL if @pattern or
+ *               @procedure_name are invalid.
+ **/
+GimpFileBatchResult *
+file_batch_run (Gimp          *gimp,
+                GimpContext   *context,
+                GimpProgress  *progress,
+                const gchar   *pattern,
+                const gchar   *procedure_name,
+                const gchar   *dest_dir,
+                const gchar   *extension,
+                gint           max_jobs,
+                gboolean       merge_visible,
+                gint          *n_results,
+                GError       **error)
+{
+  FileBatch      batch = { 0, };
+  GimpProcedure *procedure = NULL;
+  GPtrArray     *filenames;
+  gint           i;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
+  g_return_val_if_fail (GIMP_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
+  g_return_val_if_fail (pattern != NULL, NULL);
+  g_return_val_if_fail (extension != NULL, NULL);
+  g_return_val_if_fail (n_results != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  *n_results = 0;
+
+  if (procedure_name && *procedure_name)
+    {
+      procedure = gimp_pdb_lookup_procedure (gimp->pdb, procedure_name);
+
+      if (! procedure)
+        {
+          g_set_error (error, GIMP_PDB_ERROR,
+                       GIMP_PDB_ERROR_PROCEDURE_NOT_FOUND,
+                       _("Procedure '%s' not found"), procedure_name);
+          return NULL;
+        }
+
+      if (! file_batch_check_procedure (procedure, error))
+        return NULL;
+    }
+
+  filenames = file_batch_glob (pattern, error);
+
+  if (! filenames)
+    return NULL;
+
+  if (max_jobs < 1)
+    max_jobs = GIMP_GEGL_CONFIG (gimp->config)->num_processors;
+
+  batch.gimp          = gimp;
+  batch.context       = context;
+  batch.progress      = progress;
+  batch.procedure     = procedure;
+  batch.dest_dir      = (dest_dir && *dest_dir) ? dest_dir : NULL;
+  batch.extension     = extension;
+  batch.merge_visible = merge_visible;
+  batch.n_files       = filenames->len;
+  batch.max_jobs      = MAX (max_jobs, 1);
+  batch.results       = g_new0 (GimpFileBatchResult, MAX (batch.n_files, 1));
+
+  for (i = 0; i < batch.n_files; i++)
+    {
+      batch.results[i].filename = g_ptr_array_index (filenames, i);
+      batch.results[i].status   = GIMP_PDB_EXECUTION_ERROR;
+    }
+
+  /*  the results own the filenames now  */
+  g_ptr_array_free (filenames, TRUE);
+
+  if (progress && batch.n_files > 0)
+    gimp_progress_start (progress, _("Processing images"), FALSE);
+
+  file_batch_start_jobs (&batch);
+
+  if (batch.n_running > 0)
+    {
+      batch.main_loop = g_main_loop_new (NULL, FALSE);
+
+      gimp_threads_leave (gimp);
+      g_main_loop_run (batch.main_loop);
+      gimp_threads_enter (gimp);
+
+      g_main_loop_unref (batch.main_loop);
+    }
+
+  if (progress && batch.n_files > 0)
+    gimp_progress_end (progress);
+
+  *n_results = batch.n_files;
+
+  return batch.results;
+}
+
+void
+file_batch_results_free (GimpFileBatchResult *results,
+                         gint                 n_results)
+{
+  gint i;
+
+  for (i = 0; i < n_results; i++)
+    {
+      g_free (results[i].filename);
+      g_free (results[i].error);
+    }
+
+  g_free (results);
+}
+
+
+/*  private functions  */
+
+static gint
+file_batch_compare_filenames (gconstpointer a,
+                              gconstpointer b)
+{
+  return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+/*  the regular files matching pattern, sorted by name  */
+static GPtrArray *
+file_batch_glob (const gchar  *pattern,
+                 GError      **error)
+{
+  GPtrArray    *filenames;
+  GPatternSpec *spec;
+  GDir         *dir;
+  gchar        *dirname;
+  gchar        *basename;
+  const gchar  *name;
+
+  dirname  = g_path_get_dirname (pattern);
+  basename = g_path_get_basename (pattern);
+
+  dir = g_dir_open (dirname, 0, error);
+
+  if (! dir)
+    {
+      g_free (dirname);
+      g_free (basename);
+
+      return NULL;
+    }
+
+  filenames = g_ptr_array_new ();
+  spec      = g_pattern_spec_new (basename);
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      gchar *filename;
+
+      if (! g_pattern_match_string (spec, name))
+        continue;
+
+      filename = g_build_filename (dirname, name, NULL);
+
+      if (g_file_test (filename, G_FILE_TEST_IS_REGULAR))
+        g_ptr_array_add (filenames, filename);
+      else
+        g_free (filename);
+    }
+
+  g_ptr_array_sort (filenames, file_batch_compare_filenames);
+
+  g_pattern_spec_free (spec);
+  g_dir_close (dir);
+  g_free (dirname);
+  g_free (basename);
+
+  return filenames;
+}
+
+static gboolean
+file_batch_check_procedure (GimpProcedure  *procedure,
+                            GError        **error)
+{
+  if (procedure->num_args < 3                            ||
+      (! G_IS_PARAM_SPEC_INT (procedure->args[0]) &&
+       ! G_IS_PARAM_SPEC_ENUM (procedure->args[0]))      ||
+      ! GIMP_IS_PARAM_SPEC_IMAGE_ID (procedure->args[1]) ||
+      ! GIMP_IS_PARAM_SPEC_DRAWABLE_ID (procedure->args[2]))
+    {
+      g_set_error (error, GIMP_PDB_ERROR, GIMP_PDB_ERROR_INVALID_ARGUMENT,
+                   _("Procedure '%s' doesn't take a run mode, image and "
+                     "drawable as its first arguments"),
+                   gimp_object_get_name (procedure));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+file_batch_start_jobs (FileBatch *batch)
+{
+  /*  jobs that fail right away finish from in here, don't recurse  */
+  if (batch->starting)
+    return;
+
+  batch->starting = TRUE;
+
+  while (batch->n_running < batch->max_jobs &&
+         batch->next < batch->n_files)
+    {
+      FileBatchJob *job = g_slice_new0 (FileBatchJob);
+      gchar        *uri;
+
+      job->batch  = batch;
+      job->result = &batch->results[batch->next++];
+      job->timer  = g_timer_new ();
+
+      batch->n_running++;
+
+      uri = g_filename_to_uri (job->result->filename, NULL, NULL);
+
+      if (uri)
+        {
+          file_open_image_async (batch->gimp, batch->context, NULL,
+                                 uri, uri, FALSE, NULL,
+                                 GIMP_RUN_NONINTERACTIVE,
+                                 (GimpFileOpenCallback)
+                                 file_batch_image_opened,
+                                 job);
+          g_free (uri);
+        }
+      else
+        {
+          file_batch_job_finish (job, GIMP_PDB_EXECUTION_ERROR,
+                                 _("Invalid file name"));
+        }
+    }
+
+  batch->starting = FALSE;
+}
+
+static void
+file_batch_image_opened (GimpImage         *image,
+                         const gchar       *uri,
+                         GimpPDBStatusType  status,
+                         const GError      *error,
+                         FileBatchJob      *job)
+{
+  FileBatch      *batch = job->batch;
+  GimpProcedure  *procedure = batch->procedure;
+  GimpValueArray *args;
+  GimpDrawable   *drawable;
+
+  if (! image)
+    {
+      file_batch_job_finish (job, status, error ? error->message : NULL);
+      return;
+    }
+
+  job->image = g_object_ref (image);
+
+  gimp_image_undo_disable (image);
+
+  if (! procedure)
+    {
+      file_batch_save_image (job);
+      return;
+    }
+
+  drawable = gimp_image_get_active_drawable (image);
+
+  args = gimp_procedure_get_arguments (procedure);
+
+  if (G_VALUE_HOLDS_ENUM (gimp_value_array_index (args, 0)))
+    g_value_set_enum (gimp_value_array_index (args, 0),
+                      GIMP_RUN_NONINTERACTIVE);
+  else
+    g_value_set_int (gimp_value_array_index (args, 0),
+                     GIMP_RUN_NONINTERACTIVE);
+
+  gimp_value_set_image (gimp_value_array_index (args, 1), image);
+  gimp_value_set_drawable (gimp_value_array_index (args, 2), drawable);
+
+  if (GIMP_IS_PLUG_IN_PROCEDURE (procedure))
+    {
+      gimp_plug_in_procedure_execute_with_callback (GIMP_PLUG_IN_PROCEDURE (procedure),
+                                                    batch->gimp,
+                                                    batch->context,
+                                                    NULL, args,
+                                                    (GimpProcedureReturnFunc)
+                                                    file_batch_image_processed,
+                                                    job);
+    }
+  else
+    {
+      GimpValueArray *return_vals;
+      GError         *exec_error = NULL;
+
+      return_vals = gimp_procedure_execute (procedure, batch->gimp,
+                                            batch->context, NULL,
+                                            args, &exec_error);
+
+      if (exec_error)
+        {
+          gimp_value_array_unref (return_vals);
+
+          return_vals = gimp_procedure_get_return_values (procedure, FALSE,
+                                                          exec_error);
+          g_clear_error (&exec_error);
+        }
+
+      file_batch_image_processed (procedure, return_vals, job);
+      gimp_value_array_unref (return_vals);
+    }
+
+  gimp_value_array_unref (args);
+}
+
+static void
+file_batch_image_processed (GimpProcedure  *procedure,
+                            GimpValueArray *return_vals,
+                            FileBatchJob   *job)
+{
+  GimpPDBStatusType status;
+
+  status = g_value_get_enum (gimp_value_array_index (return_vals, 0));
+
+  if (status != GIMP_PDB_SUCCESS)
+    {
+      const gchar *message = NULL;
+
+      if (gimp_value_array_length (return_vals) > 1 &&
+          G_VALUE_HOLDS_STRING (gimp_value_array_index (return_vals, 1)))
+        message = g_value_get_string (gimp_value_array_index (return_vals, 1));
+
+      file_batch_job_finish (job, status, message);
+      return;
+    }
+
+  file_batch_save_image (job);
+}
+
+static void
+file_batch_save_image (FileBatchJob *job)
+{
+  FileBatch *batch = job->batch;
+  gchar     *basename;
+  gchar     *dirname;
+  gchar     *dot;
+  gchar     *filename;
+  gchar     *uri;
+
+  /*  the same name with the new extension, in dest_dir if given  */
+  basename = g_path_get_basename (job->result->filename);
+  dirname  = (batch->dest_dir ?
+              g_strdup (batch->dest_dir) :
+              g_path_get_dirname (job->result->filename));
+
+  dot = strrchr (basename, '.');
+  if (dot && dot != basename)
+    *dot = '\0';
+
+  filename = g_strdup_printf ("%s%c%s.%s",
+                              dirname, G_DIR_SEPARATOR, basename,
+                              batch->extension);
+  uri = g_filename_to_uri (filename, NULL, NULL);
+
+  g_free (basename);
+  g_free (dirname);
+  g_free (filename);
+
+  if (! uri)
+    {
+      file_batch_job_finish (job, GIMP_PDB_EXECUTION_ERROR,
+                             _("Invalid file name"));
+      return;
+    }
+
+  file_save_async (batch->gimp, batch->context, job->image, uri,
+                   GIMP_RUN_NONINTERACTIVE, batch->merge_visible,
+                   (GimpFileSaveCallback) file_batch_image_saved,
+                   job);
+
+  g_free (uri);
+}
+
+static void
+file_batch_image_saved (GimpImage         *image,
+                        const gchar       *uri,
+                        GimpPDBStatusType  status,
+                        const GError      *error,
+                        FileBatchJob      *job)
+{
+  file_batch_job_finish (job, status, error ? error->message : NULL);
+}
+
+static void
+file_batch_job_finish (FileBatchJob      *job,
+                       GimpPDBStatusType  status,
+                       const gchar       *message)
+{
+  FileBatch *batch = job->batch;
+
+  job->result->status = status;
+  job->result->time   = g_timer_elapsed (job->timer, NULL);
+
+  if (status != GIMP_PDB_SUCCESS && status != GIMP_PDB_CANCEL)
+    job->result->error = g_strdup (message ? message :
+                                   _("Unknown error"));
+
+  if (job->image)
+    g_object_unref (job->image);
+
+  g_timer_destroy (job->timer);
+  g_slice_free (FileBatchJob, job);
+
+  batch->n_running--;
+  batch->n_done++;
+
+  if (batch->progress)
+    gimp_progress_set_value (batch->progress,
+                             (gdouble) batch->n_done / batch->n_files);
+
+  file_batch_start_jobs (batch);
+
+  if (batch->n_running == 0 && batch->main_loop)
+    g_main_loop_quit (batch->main_loop);
+}
@@ -0,0 +1,49 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FILE_BATCH_H__
+#define __FILE_BATCH_H__
+
+
+typedef struct _GimpFileBatchResult GimpFileBatchResult;
+
+struct _GimpFileBatchResult
+{
+  gchar             *filename;
+  GimpPDBStatusType  status;
+  gdouble            time;     /*  seconds from the open to the save  */
+  gchar             *error;    /*  NULL unless status is an error     */
+};
+
+
+GimpFileBatchResult * file_batch_run          (Gimp                 *gimp,
+                                               GimpContext          *context,
+                                               GimpProgress         *progress,
+                                               const gchar          *pattern,
+                                               const gchar          *procedure_name,
+                                               const gchar          *dest_dir,
+                                               const gchar          *extension,
+                                               gint                  max_jobs,
+                                               gboolean              merge_visible,
+                                               gint                 *n_results,
+                                               GError              **error);
+
+void                  file_batch_results_free (GimpFileBatchResult  *results,
+                                               gint                  n_results);
+
+
+#endif /* __FILE_BATCH_H__ */
@@ -0,0 +1,408 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * file-gegl.c
+ * Copyright (C) 2012 Simon Budig
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  The load and save procedures for the file types GEGL handles
+ *  itself. They run in the core, so the pixels go from the GEGL load
+ *  op straight into the layer, without the round trip through a
+ *  plug-in process.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-undo.h"
+#include "core/gimplayer.h"
+#include "core/gimpparamspecs.h"
+#include "core/gimpprogress.h"
+
+#include "plug-in/gimppluginmanager.h"
+#include "plug-in/gimppluginprocedure.h"
+
+#include "file-gegl.h"
+
+#include "gimp-intl.h"
+
+
+static GimpValueArray * file_gegl_load_invoker (GimpProcedure         *procedure,
+                                                Gimp                  *gimp,
+                                                GimpContext           *context,
+                                                GimpProgress          *progress,
+                                                const GimpValueArray  *args,
+                                                GError               **error);
+static GimpValueArray * file_gegl_save_invoker (GimpProcedure         *procedure,
+                                                Gimp                  *gimp,
+                                                GimpContext           *context,
+                                                GimpProgress          *progress,
+                                                const GimpValueArray  *args,
+                                                GError               **error);
+
+
+void
+file_gegl_init (Gimp *gimp)
+{
+  GimpPlugInProcedure *proc;
+  GimpProcedure       *procedure;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  /*  file-gegl-load  */
+  procedure = gimp_plug_in_procedure_new (GIMP_PLUGIN, "file-gegl-load");
+  procedure->proc_type    = GIMP_INTERNAL;
+  procedure->marshal_func = file_gegl_load_invoker;
+
+  proc = GIMP_PLUG_IN_PROCEDURE (procedure);
+  proc->menu_label = g_strdup (N_("image via GEGL"));
+  gimp_plug_in_procedure_set_image_types (proc, NULL);
+  gimp_plug_in_procedure_set_file_proc (proc, "exr,hdr", "", "");
+  gimp_plug_in_procedure_set_mime_type (proc, "image/x-exr");
+
+  gimp_object_set_static_name (GIMP_OBJECT (procedure), "file-gegl-load");
+  gimp_procedure_set_static_strings (procedure,
+                                     "file-gegl-load",
+                                     "Loads images using GEGL.",
+                                     "The GEGL image loader.",
+                                     "Simon Budig",
+                                     "Simon Budig",
+                                     "2012",
+                                     NULL);
+
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32 ("run-mode",
+                                                      "Run mode",
+                                                      "The run mode",
+                                                      G_MININT32, G_MAXINT32, 0,
+                                                      GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("filename",
+                                                       "Filename",
+                                                       "The name of the file "
+                                                       "to load, in the "
+                                                       "on-disk character "
+                                                       "set and encoding",
+                                                       TRUE, FALSE, TRUE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("raw-filename",
+                                                       "Raw filename",
+                                                       "The basename of the "
+                                                       "file, in UTF-8",
+                                                       FALSE, FALSE, TRUE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_image_id ("image",
+                                                             "Image",
+                                                             "Output image",
+                                                             gimp, FALSE,
+                                                             GIMP_PARAM_READWRITE));
+  gimp_plug_in_manager_add_procedure (gimp->plug_in_manager, proc);
+  g_object_unref (procedure);
+
+  /*  file-gegl-save  */
+  procedure = gimp_plug_in_procedure_new (GIMP_PLUGIN, "file-gegl-save");
+  procedure->proc_type    = GIMP_INTERNAL;
+  procedure->marshal_func = file_gegl_save_invoker;
+
+  proc = GIMP_PLUG_IN_PROCEDURE (procedure);
+  proc->menu_label = g_strdup (N_("image via GEGL"));
+  gimp_plug_in_procedure_set_image_types (proc, "RGB*, GRAY*, INDEXED*");
+  gimp_plug_in_procedure_set_file_proc (proc, "exr,hdr", "", NULL);
+  gimp_plug_in_procedure_set_mime_type (proc, "image/x-exr");
+
+  gimp_object_set_static_name (GIMP_OBJECT (procedure), "file-gegl-save");
+  gimp_procedure_set_static_strings (procedure,
+                                     "file-gegl-save",
+                                     "Saves images using GEGL.",
+                                     "The GEGL image saver.",
+                                     "Simon Budig",
+                                     "Simon Budig",
+                                     "2012",
+                                     NULL);
+
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32 ("run-mode",
+                                                      "Run mode",
+                                                      "The run mode",
+                                                      G_MININT32, G_MAXINT32, 0,
+                                                      GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_image_id ("image",
+                                                         "Image",
+                                                         "Input image",
+                                                         gimp, FALSE,
+                                                         GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_drawable_id ("drawable",
+                                                            "Drawable",
+                                                            "Drawable to save",
+                                                            gimp, FALSE,
+                                                            GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("filename",
+                                                       "Filename",
+                                                       "The name of the file "
+                                                       "to save the image in, "
+                                                       "in the on-disk "
+                                                       "character set and "
+                                                       "encoding",
+                                                       TRUE, FALSE, TRUE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("raw-filename",
+                                                       "Raw filename",
+                                                       "The basename of the "
+                                                       "file, in UTF-8",
+                                                       FALSE, FALSE, TRUE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_plug_in_manager_add_procedure (gimp->plug_in_manager, proc);
+  g_object_unref (procedure);
+}
+
+
+/*  private functions  */
+
+static GimpImage *
+file_gegl_load_image (Gimp         *gimp,
+                      const gchar  *filename,
+                      GError      **error)
+{
+  GimpImage         *image;
+  GimpLayer         *layer;
+  GimpImageBaseType  base_type;
+  GimpPrecision      precision;
+  GeglNode          *graph;
+  GeglNode          *source;
+  GeglNode          *sink;
+  GeglBuffer        *buffer = NULL;
+  const Babl        *format;
+  const Babl        *model;
+  const Babl        *type;
+  gboolean           has_alpha;
+
+  graph  = gegl_node_new ();
+  source = gegl_node_new_child (graph,
+                                "operation", "gegl:load",
+                                "path",      filename,
+                                NULL);
+  sink   = gegl_node_new_child (graph,
+                                "operation", "gegl:buffer-sink",
+                                "buffer",    &buffer,
+                                NULL);
+
+  gegl_node_connect_to (source, "output",
+                        sink,   "input");
+
+  gegl_node_process (sink);
+  g_object_unref (graph);
+
+  if (! buffer)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   _("Could not open '%s'"),
+                   gimp_filename_to_utf8 (filename));
+      return NULL;
+    }
+
+  format    = gegl_buffer_get_format (buffer);
+  model     = babl_format_get_model (format);
+  type      = babl_format_get_type (format, 0);
+  has_alpha = babl_format_has_alpha (format);
+
+  if (model == babl_model ("Y")  ||
+      model == babl_model ("Y'") ||
+      model == babl_model ("YA") ||
+      model == babl_model ("Y'A"))
+    base_type = GIMP_GRAY;
+  else if (babl_format_is_palette (format))
+    base_type = GIMP_INDEXED;
+  else
+    base_type = GIMP_RGB;
+
+  if (type == babl_type ("u8"))
+    precision = GIMP_PRECISION_U8;
+  else if (type == babl_type ("u16"))
+    precision = GIMP_PRECISION_U16;
+  else if (type == babl_type ("u32"))
+    precision = GIMP_PRECISION_U32;
+  else if (type == babl_type ("half"))
+    precision = GIMP_PRECISION_HALF;
+  else
+    precision = GIMP_PRECISION_FLOAT;
+
+  /*  GIMP has no indexed images beyond 8 bit  */
+  if (base_type == GIMP_INDEXED)
+    {
+      base_type = GIMP_RGB;
+      precision = GIMP_PRECISION_U8;
+    }
+
+  image = gimp_create_image (gimp,
+                             gegl_buffer_get_width  (buffer),
+                             gegl_buffer_get_height (buffer),
+                             base_type, precision, FALSE);
+
+  gimp_image_undo_disable (image);
+
+  /*  the loaded buffer becomes the layer's if it has the right
+   *  format, which it has for the float and half images GEGL loads
+   */
+  if (format == gimp_image_get_layer_format (image, has_alpha) &&
+      gegl_buffer_get_x (buffer) == 0                          &&
+      gegl_buffer_get_y (buffer) == 0)
+    {
+      layer = gimp_layer_new (image,
+                              gegl_buffer_get_width  (buffer),
+                              gegl_buffer_get_height (buffer),
+                              format,
+                              _("Background"),
+                              GIMP_OPACITY_OPAQUE, GIMP_NORMAL_MODE);
+
+      gimp_drawable_set_buffer (GIMP_DRAWABLE (layer), FALSE, NULL, buffer);
+    }
+  else
+    {
+      layer = gimp_layer_new_from_buffer (buffer, image,
+                                          gimp_image_get_layer_format (image,
+                                                                       has_alpha),
+                                          _("Background"),
+                                          GIMP_OPACITY_OPAQUE,
+                                          GIMP_NORMAL_MODE);
+    }
+
+  g_object_unref (buffer);
+
+  gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+
+  gimp_image_undo_enable (image);
+
+  return image;
+}
+
+static GimpValueArray *
+file_gegl_load_invoker (GimpProcedure         *procedure,
+                        Gimp                  *gimp,
+                        GimpContext           *context,
+                        GimpProgress          *progress,
+                        const GimpValueArray  *args,
+                        GError               **error)
+{
+  GimpValueArray *return_vals;
+  GimpImage      *image;
+  const gchar    *filename;
+
+  gimp_set_busy (gimp);
+
+  filename = g_value_get_string (gimp_value_array_index (args, 1));
+
+  if (progress)
+    {
+      gchar *name = g_filename_display_name (filename);
+      gchar *msg  = g_strdup_printf (_("Opening '%s'"), name);
+
+      gimp_progress_start (progress, msg, FALSE);
+
+      g_free (msg);
+      g_free (name);
+    }
+
+  image = file_gegl_load_image (gimp, filename, error);
+
+  if (progress)
+    gimp_progress_end (progress);
+
+  return_vals = gimp_procedure_get_return_values (procedure, image != NULL,
+                                                  error ? *error : NULL);
+
+  if (image)
+    gimp_value_set_image (gimp_value_array_index (return_vals, 1), image);
+
+  gimp_unset_busy (gimp);
+
+  return return_vals;
+}
+
+static GimpValueArray *
+file_gegl_save_invoker (GimpProcedure         *procedure,
+                        Gimp                  *gimp,
+                        GimpContext           *context,
+                        GimpProgress          *progress,
+                        const GimpValueArray  *args,
+                        GError               **error)
+{
+  GimpDrawable *drawable;
+  const gchar  *filename;
+  GeglNode     *graph;
+  GeglNode     *source;
+  GeglNode     *sink;
+
+  gimp_set_busy (gimp);
+
+  drawable = gimp_value_get_drawable (gimp_value_array_index (args, 2), gimp);
+  filename = g_value_get_string (gimp_value_array_index (args, 3));
+
+  if (progress)
+    {
+      gchar *name = g_filename_display_name (filename);
+      gchar *msg  = g_strdup_printf (_("Saving '%s'"), name);
+
+      gimp_progress_start (progress, msg, FALSE);
+
+      g_free (msg);
+      g_free (name);
+    }
+
+  /*  the drawable's own buffer, no copy of its pixels is made  */
+  graph  = gegl_node_new ();
+  source = gegl_node_new_child (graph,
+                                "operation", "gegl:buffer-source",
+                                "buffer",    gimp_drawable_get_buffer (drawable),
+                                NULL);
+  sink   = gegl_node_new_child (graph,
+                                "operation", "gegl:save",
+                                "path",      filename,
+                                NULL);
+
+  gegl_node_connect_to (source, "output",
+                        sink,   "input");
+
+  gegl_node_process (sink);
+  g_object_unref (graph);
+
+  if (progress)
+    gimp_progress_end (progress);
+
+  gimp_unset_busy (gimp);
+
+  return gimp_procedure_get_return_values (procedure, TRUE, NULL);
+}
@@ -75,6 +75,54 @@
 #include "gimp-intl.h"
 
 
+typedef struct
+{
+  Gimp                 *gimp;
+  GimpContext          *context;
+  GimpProgress         *progress;
+  gchar                *uri;
+  gboolean              as_new;
+  GimpPlugInProcedure  *file_proc;
+  GimpRunMode           run_mode;
+  gboolean              display;
+  GimpFileOpenCallback  callback;
+  gpointer              user_data;
+} FileOpenJob;
+
+
+static gchar  * file_open_get_filename         (const gchar               *uri,
+                                                GError                   **error);
+static GimpImage * file_open_image_finish      (Gimp                      *gimp,
+                                                GimpContext               *context,
+                                                GimpProgress              *progress,
+                                                const gchar               *uri,
+                                                gboolean                   as_new,
+                                                GimpPlugInProcedure       *file_proc,
+                                                GimpRunMode                run_mode,
+                                                GimpValueArray            *return_vals,
+                                                GimpPDBStatusType         *status,
+                                                const gchar              **mime_type,
+                                                GError                   **error);
+static void     file_open_async                (Gimp                      *gimp,
+                                                GimpContext               *context,
+                                                GimpProgress              *progress,
+                                                const gchar               *uri,
+                                                const gchar               *entered_filename,
+                                                gboolean                   as_new,
+                                                GimpPlugInProcedure       *file_proc,
+                                                GimpRunMode                run_mode,
+                                                gboolean                   display,
+                                                GimpFileOpenCallback       callback,
+                                                gpointer                   user_data);
+static void     file_open_display_image        (Gimp                      *gimp,
+                                                GimpImage                 *image,
+                                                const gchar               *uri,
+                                                gboolean                   as_new,
+                                                GimpPlugInProcedure       *file_proc,
+                                                const gchar               *mime_type);
+static void     file_open_job_done             (GimpProcedure             *procedure,
+                                                GimpValueArray            *return_vals,
+                                                FileOpenJob               *job);
 static void     file_open_sanitize_image       (GimpImage                 *image,
                                                 gboolean                   as_new);
 static void     file_open_convert_items        (GimpImage                 *dest_image,
@@ -107,7 +155,7 @@ file_open_image (Gimp                *gimp,
 {
   GimpValueArray *return_vals;
   gchar          *filename;
-  GimpImage      *image = NULL;
+  GimpImage      *image;
 
   g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
   g_return_val_if_fail (GIMP_IS_CONTEXT (context), NULL);
@@ -124,34 +172,10 @@ file_open_image (Gimp                *gimp,
   if (! file_proc)
     return NULL;
 
-  filename = file_utils_filename_from_uri (uri);
-
-  if (filename)
-    {
-      /* check if we are opening a file */
-      if (g_file_test (filename, G_FILE_TEST_EXISTS))
-        {
-          if (! g_file_test (filename, G_FILE_TEST_IS_REGULAR))
-            {
-              g_free (filename);
-              g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-				   _("Not a regular file"));
-              return NULL;
-            }
+  filename = file_open_get_filename (uri, error);
 
-          if (g_access (filename, R_OK) != 0)
-            {
-              g_free (filename);
-              g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_ACCES,
-				   g_strerror (errno));
-              return NULL;
-            }
-        }
-    }
-  else
-    {
-      filename = g_strdup (uri);
-    }
+  if (! filename)
+    return NULL;
 
   return_vals =
     gimp_pdb_execute_procedure_by_name (gimp->pdb,
@@ -164,61 +188,12 @@ file_open_image (Gimp                *gimp,
 
   g_free (filename);
 
-  *status = g_value_get_enum (gimp_value_array_index (return_vals, 0));
-
-  if (*status == GIMP_PDB_SUCCESS)
-    {
-      image = gimp_value_get_image (gimp_value_array_index (return_vals, 1),
-                                    gimp);
-
-      if (image)
-        {
-          file_open_sanitize_image (image, as_new);
-
-          /* Only set the load procedure if it hasn't already been set. */
-          if (! gimp_image_get_load_proc (image))
-            gimp_image_set_load_proc (image, file_proc);
-
-          file_proc = gimp_image_get_load_proc (image);
-
-          if (mime_type)
-            *mime_type = file_proc->mime_type;
-        }
-      else
-        {
-          if (error && ! *error)
-            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                         _("%s plug-in returned SUCCESS but did not "
-                           "return an image"),
-                         gimp_plug_in_procedure_get_label (file_proc));
-
-          *status = GIMP_PDB_EXECUTION_ERROR;
-        }
-    }
-  else if (*status != GIMP_PDB_CANCEL)
-    {
-      if (error && ! *error)
-        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                     _("%s plug-In could not open image"),
-                     gimp_plug_in_procedure_get_label (file_proc));
-    }
+  image = file_open_image_finish (gimp, context, progress, uri, as_new,
+                                  file_proc, run_mode, return_vals,
+                                  status, mime_type, error);
 
   gimp_value_array_unref (return_vals);
 
-  if (image)
-    {
-      file_open_handle_color_profile (image, context, progress, run_mode);
-
-      if (file_open_file_proc_is_import (file_proc))
-        {
-          /* Remember the import source */
-          gimp_image_set_imported_uri (image, uri);
-
-          /* We shall treat this file as an Untitled file */
-          gimp_image_set_uri (image, NULL);
-        }
-    }
-
   return image;
 }
 
@@ -442,62 +417,89 @@ file_open_with_proc_and_display (Gimp                *gimp,
                            error);
 
   if (image)
-    {
-      /* If the file was imported we want to set the layer name to the
-       * file name. For now, assume that multi-layered imported images
-       * have named the layers already, so only rename the layer of
-       * single-layered imported files. Note that this will also
-       * rename already named layers from e.g. single-layered PSD
-       * files. To solve this properly, we would need new file plug-in
-       * API.
-       */
-      if (! file_proc)
-        file_proc = gimp_image_get_load_proc (image);
-
-      if (file_open_file_proc_is_import (file_proc) &&
-          gimp_image_get_n_layers (image) == 1)
-        {
-          GimpObject *layer    = gimp_image_get_layer_iter (image)->data;
-          gchar      *basename = file_utils_uri_display_basename (uri);
+    file_open_display_image (gimp, image, uri, as_new, file_proc, mime_type);
 
-          gimp_item_rename (GIMP_ITEM (layer), basename, NULL);
-          gimp_image_undo_free (image);
-          gimp_image_clean_all (image);
-
-          g_free (basename);
-        }
-
-      if (gimp_create_display (image->gimp, image, GIMP_UNIT_PIXEL, 1.0))
-        {
-          /*  the display owns the image now  */
-          g_object_unref (image);
-        }
-
-      if (! as_new)
-        {
-          GimpDocumentList *documents = GIMP_DOCUMENT_LIST (gimp->documents);
-          GimpImagefile    *imagefile;
-
-          imagefile = gimp_document_list_add_uri (documents, uri, mime_type);
-
-          /*  can only create a thumbnail if the passed uri and the
-           *  resulting image's uri match.
-           */
-          if (strcmp (uri, gimp_image_get_uri_or_untitled (image)) == 0)
-            {
-              /*  no need to save a thumbnail if there's a good one already  */
-              if (! gimp_imagefile_check_thumbnail (imagefile))
-                {
-                  gimp_imagefile_save_thumbnail (imagefile, mime_type, image);
-                }
-            }
-        }
+  return image;
+}
 
-      /*  announce that we opened this image  */
-      gimp_image_opened (image->gimp, uri);
-    }
+/**
+ * file_open_with_proc_and_display_async:
+ * @gimp:
+ * @context:
+ * @progress:         the progress to use, or %NULL for one of its own
+ * @uri:
+ * @entered_filename:
+ * @as_new:
+ * @file_proc:        the load procedure, or %NULL to find one
+ * @callback:         called when the image is displayed or the load failed,
+ *                    may be %NULL
+ * @user_data:
+ *
+ * Like file_open_with_proc_and_display(), but returns before the load
+ * procedure is done, so that several images can be loaded at the same
+ * time. @callback is called with the new image, or %NULL and an error
+ * when opening it failed or was canceled. Each load without a
+ * @progress shows a progress of its own that can cancel it.
+ **/
+void
+file_open_with_proc_and_display_async (Gimp                 *gimp,
+                                       GimpContext          *context,
+                                       GimpProgress         *progress,
+                                       const gchar          *uri,
+                                       const gchar          *entered_filename,
+                                       gboolean              as_new,
+                                       GimpPlugInProcedure  *file_proc,
+                                       GimpFileOpenCallback  callback,
+                                       gpointer              user_data)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+  g_return_if_fail (GIMP_IS_CONTEXT (context));
+  g_return_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress));
+  g_return_if_fail (uri != NULL);
+
+  file_open_async (gimp, context, progress, uri, entered_filename, as_new,
+                   file_proc, GIMP_RUN_INTERACTIVE, TRUE,
+                   callback, user_data);
+}
 
-  return image;
+/**
+ * file_open_image_async:
+ * @gimp:
+ * @context:
+ * @progress:         the progress to use, or %NULL for one of its own
+ * @uri:
+ * @entered_filename:
+ * @as_new:
+ * @file_proc:        the load procedure, or %NULL to find one
+ * @run_mode:
+ * @callback:         called when the load is done or failed
+ * @user_data:
+ *
+ * Like file_open_image(), but returns before the load procedure is
+ * done. The image passed to @callback is not displayed, and only
+ * lives on if @callback adds a reference to it.
+ **/
+void
+file_open_image_async (Gimp                 *gimp,
+                       GimpContext          *context,
+                       GimpProgress         *progress,
+                       const gchar          *uri,
+                       const gchar          *entered_filename,
+                       gboolean              as_new,
+                       GimpPlugInProcedure  *file_proc,
+                       GimpRunMode           run_mode,
+                       GimpFileOpenCallback  callback,
+                       gpointer              user_data)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+  g_return_if_fail (GIMP_IS_CONTEXT (context));
+  g_return_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress));
+  g_return_if_fail (uri != NULL);
+  g_return_if_fail (callback != NULL);
+
+  file_open_async (gimp, context, progress, uri, entered_filename, as_new,
+                   file_proc, run_mode, FALSE,
+                   callback, user_data);
 }
 
 GList *
@@ -638,6 +640,293 @@ file_open_from_command_line (Gimp        *gimp,
 
 /*  private functions  */
 
+/*  returns the filename to pass to the load procedure, after checking
+ *  that a local file can be read
+ */
+static gchar *
+file_open_get_filename (const gchar  *uri,
+                        GError      **error)
+{
+  gchar *filename = file_utils_filename_from_uri (uri);
+
+  if (filename)
+    {
+      /* check if we are opening a file */
+      if (g_file_test (filename, G_FILE_TEST_EXISTS))
+        {
+          if (! g_file_test (filename, G_FILE_TEST_IS_REGULAR))
+            {
+              g_free (filename);
+              g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+				   _("Not a regular file"));
+              return NULL;
+            }
+
+          if (g_access (filename, R_OK) != 0)
+            {
+              g_free (filename);
+              g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_ACCES,
+				   g_strerror (errno));
+              return NULL;
+            }
+        }
+    }
+  else
+    {
+      filename = g_strdup (uri);
+    }
+
+  return filename;
+}
+
+/*  turns the return values of the load procedure into an image  */
+static GimpImage *
+file_open_image_finish (Gimp                *gimp,
+                        GimpContext         *context,
+                        GimpProgress        *progress,
+                        const gchar         *uri,
+                        gboolean             as_new,
+                        GimpPlugInProcedure *file_proc,
+                        GimpRunMode          run_mode,
+                        GimpValueArray      *return_vals,
+                        GimpPDBStatusType   *status,
+                        const gchar        **mime_type,
+                        GError             **error)
+{
+  GimpImage *image = NULL;
+
+  *status = g_value_get_enum (gimp_value_array_index (return_vals, 0));
+
+  if (*status == GIMP_PDB_SUCCESS)
+    {
+      image = gimp_value_get_image (gimp_value_array_index (return_vals, 1),
+                                    gimp);
+
+      if (image)
+        {
+          file_open_sanitize_image (image, as_new);
+
+          /* Only set the load procedure if it hasn't already been set. */
+          if (! gimp_image_get_load_proc (image))
+            gimp_image_set_load_proc (image, file_proc);
+
+          file_proc = gimp_image_get_load_proc (image);
+
+          if (mime_type)
+            *mime_type = file_proc->mime_type;
+        }
+      else
+        {
+          if (error && ! *error)
+            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                         _("%s plug-in returned SUCCESS but did not "
+                           "return an image"),
+                         gimp_plug_in_procedure_get_label (file_proc));
+
+          *status = GIMP_PDB_EXECUTION_ERROR;
+        }
+    }
+  else if (*status != GIMP_PDB_CANCEL)
+    {
+      /*  asynchronous runs only pass the error message along with the
+       *  return values
+       */
+      if (error && ! *error &&
+          gimp_value_array_length (return_vals) > 1 &&
+          G_VALUE_HOLDS_STRING (gimp_value_array_index (return_vals, 1)))
+        {
+          GValue *value = gimp_value_array_index (return_vals, 1);
+
+          if (g_value_get_string (value))
+            g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                 g_value_get_string (value));
+        }
+
+      if (error && ! *error)
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                     _("%s plug-In could not open image"),
+                     gimp_plug_in_procedure_get_label (file_proc));
+    }
+
+  if (image)
+    {
+      file_open_handle_color_profile (image, context, progress, run_mode);
+
+      if (file_open_file_proc_is_import (file_proc))
+        {
+          /* Remember the import source */
+          gimp_image_set_imported_uri (image, uri);
+
+          /* We shall treat this file as an Untitled file */
+          gimp_image_set_uri (image, NULL);
+        }
+    }
+
+  return image;
+}
+
+static void
+file_open_async (Gimp                 *gimp,
+                 GimpContext          *context,
+                 GimpProgress         *progress,
+                 const gchar          *uri,
+                 const gchar          *entered_filename,
+                 gboolean              as_new,
+                 GimpPlugInProcedure  *file_proc,
+                 GimpRunMode           run_mode,
+                 gboolean              display,
+                 GimpFileOpenCallback  callback,
+                 gpointer              user_data)
+{
+  GimpValueArray *args;
+  FileOpenJob    *job;
+  gchar          *filename;
+  GError         *error = NULL;
+
+  if (! file_proc)
+    file_proc = file_procedure_find (gimp->plug_in_manager->load_procs, uri,
+                                     &error);
+
+  filename = file_proc ? file_open_get_filename (uri, &error) : NULL;
+
+  if (! filename)
+    {
+      if (callback)
+        callback (NULL, uri, GIMP_PDB_EXECUTION_ERROR, error, user_data);
+
+      g_clear_error (&error);
+
+      return;
+    }
+
+  job = g_slice_new0 (FileOpenJob);
+
+  job->gimp      = gimp;
+  job->context   = g_object_ref (context);
+  job->progress  = progress ? g_object_ref (progress) : NULL;
+  job->uri       = g_strdup (uri);
+  job->as_new    = as_new;
+  job->run_mode  = run_mode;
+  job->display   = display;
+  job->file_proc = g_object_ref (file_proc);
+  job->callback  = callback;
+  job->user_data = user_data;
+
+  args = gimp_procedure_get_arguments (GIMP_PROCEDURE (file_proc));
+
+  g_value_set_int    (gimp_value_array_index (args, 0), run_mode);
+  g_value_set_string (gimp_value_array_index (args, 1), filename);
+  g_value_set_string (gimp_value_array_index (args, 2), entered_filename);
+
+  gimp_plug_in_procedure_execute_with_callback (file_proc, gimp,
+                                                context, progress, args,
+                                                (GimpProcedureReturnFunc)
+                                                file_open_job_done,
+                                                job);
+
+  gimp_value_array_unref (args);
+  g_free (filename);
+}
+
+/*  shows a newly opened image and adds it to the document history  */
+static void
+file_open_display_image (Gimp                *gimp,
+                         GimpImage           *image,
+                         const gchar         *uri,
+                         gboolean             as_new,
+                         GimpPlugInProcedure *file_proc,
+                         const gchar         *mime_type)
+{
+  /* If the file was imported we want to set the layer name to the
+   * file name. For now, assume that multi-layered imported images
+   * have named the layers already, so only rename the layer of
+   * single-layered imported files. Note that this will also
+   * rename already named layers from e.g. single-layered PSD
+   * files. To solve this properly, we would need new file plug-in
+   * API.
+   */
+  if (! file_proc)
+    file_proc = gimp_image_get_load_proc (image);
+
+  if (file_open_file_proc_is_import (file_proc) &&
+      gimp_image_get_n_layers (image) == 1)
+    {
+      GimpObject *layer    = gimp_image_get_layer_iter (image)->data;
+      gchar      *basename = file_utils_uri_display_basename (uri);
+
+      gimp_item_rename (GIMP_ITEM (layer), basename, NULL);
+      gimp_image_undo_free (image);
+      gimp_image_clean_all (image);
+
+      g_free (basename);
+    }
+
+  if (gimp_create_display (image->gimp, image, GIMP_UNIT_PIXEL, 1.0))
+    {
+      /*  the display owns the image now  */
+      g_object_unref (image);
+    }
+
+  if (! as_new)
+    {
+      GimpDocumentList *documents = GIMP_DOCUMENT_LIST (gimp->documents);
+      GimpImagefile    *imagefile;
+
+      imagefile = gimp_document_list_add_uri (documents, uri, mime_type);
+
+      /*  can only create a thumbnail if the passed uri and the
+       *  resulting image's uri match.
+       */
+      if (strcmp (uri, gimp_image_get_uri_or_untitled (image)) == 0)
+        {
+          /*  no need to save a thumbnail if there's a good one already  */
+          if (! gimp_imagefile_check_thumbnail (imagefile))
+            {
+              gimp_imagefile_save_thumbnail (imagefile, mime_type, image);
+            }
+        }
+    }
+
+  /*  announce that we opened this image  */
+  gimp_image_opened (image->gimp, uri);
+}
+
+static void
+file_open_job_done (GimpProcedure  *procedure,
+                    GimpValueArray *return_vals,
+                    FileOpenJob    *job)
+{
+  GimpImage         *image;
+  GimpPDBStatusType  status;
+  const gchar       *mime_type = NULL;
+  GError            *error     = NULL;
+
+  image = file_open_image_finish (job->gimp, job->context, job->progress,
+                                  job->uri, job->as_new, job->file_proc,
+                                  job->run_mode, return_vals,
+                                  &status, &mime_type, &error);
+
+  if (image && job->display)
+    file_open_display_image (job->gimp, image, job->uri, job->as_new,
+                             job->file_proc, mime_type);
+
+  if (job->callback)
+    job->callback (image, job->uri, status, error, job->user_data);
+
+  if (image && ! job->display)
+    g_object_unref (image);
+
+  g_clear_error (&error);
+
+  g_object_unref (job->context);
+  if (job->progress)
+    g_object_unref (job->progress);
+  g_object_unref (job->file_proc);
+  g_free (job->uri);
+
+  g_slice_free (FileOpenJob, job);
+}
+
 static void
 file_open_sanitize_image (GimpImage *image,
                           gboolean   as_new)
@@ -21,6 +21,13 @@
 #define __FILE_OPEN_H__
 
 
+typedef void (* GimpFileOpenCallback) (GimpImage         *image,
+                                       const gchar       *uri,
+                                       GimpPDBStatusType  status,
+                                       const GError      *error,
+                                       gpointer           user_data);
+
+
 GimpImage * file_open_image                 (Gimp                *gimp,
                                              GimpContext         *context,
                                              GimpProgress        *progress,
@@ -62,6 +69,28 @@ GimpImage * file_open_with_proc_and_display (Gimp                *gimp,
                                              GimpPDBStatusType   *status,
                                              GError             **error);
 
+void        file_open_with_proc_and_display_async
+                                            (Gimp                 *gimp,
+                                             GimpContext          *context,
+                                             GimpProgress         *progress,
+                                             const gchar          *uri,
+                                             const gchar          *entered_filename,
+                                             gboolean              as_new,
+                                             GimpPlugInProcedure  *file_proc,
+                                             GimpFileOpenCallback  callback,
+                                             gpointer              user_data);
+
+void        file_open_image_async           (Gimp                 *gimp,
+                                             GimpContext          *context,
+                                             GimpProgress         *progress,
+                                             const gchar          *uri,
+                                             const gchar          *entered_filename,
+                                             gboolean              as_new,
+                                             GimpPlugInProcedure  *file_proc,
+                                             GimpRunMode           run_mode,
+                                             GimpFileOpenCallback  callback,
+                                             gpointer              user_data);
+
 GList     * file_open_layers                (Gimp                *gimp,
                                              GimpContext         *context,
                                              GimpProgress        *progress,
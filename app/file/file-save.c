@@ -45,13 +45,20 @@
 #include "core/core-types.h"
 
 #include "config/gimpcoreconfig.h"
+#include "config/gimpgeglconfig.h"
 
 #include "core/gimp.h"
+#include "core/gimp-gui.h"
 #include "core/gimpcontext.h"
 #include "core/gimpdocumentlist.h"
 #include "core/gimpdrawable.h"
 #include "core/gimpimage.h"
+#include "core/gimpimage-convert.h"
+#include "core/gimpimage-duplicate.h"
+#include "core/gimpimage-merge.h"
+#include "core/gimpimage-undo.h"
 #include "core/gimpimagefile.h"
+#include "core/gimplayer.h"
 #include "core/gimpparamspecs.h"
 #include "core/gimpprogress.h"
 
@@ -59,6 +66,7 @@
 
 #include "plug-in/gimppluginprocedure.h"
 
+#include "file-procedure.h"
 #include "file-save.h"
 #include "file-utils.h"
 #include "gimp-file.h"
@@ -66,6 +74,69 @@
 #include "gimp-intl.h"
 
 
+typedef struct
+{
+  Gimp                 *gimp;
+  GimpImage            *image;
+  GimpImage            *export_image;
+  gchar                *uri;
+  GimpPlugInProcedure  *file_proc;
+  gboolean              export;
+  GimpFileSaveCallback  callback;
+  gpointer              user_data;
+} FileSaveJob;
+
+typedef struct _FileSaveBatch FileSaveBatch;
+
+typedef struct
+{
+  FileSaveBatch        *batch;
+  gint                  index;
+} FileSaveBatchItem;
+
+struct _FileSaveBatch
+{
+  Gimp                 *gimp;
+  GimpContext          *context;
+  GimpProgress         *progress;
+  GimpImage           **images;
+  const gchar         **uris;
+  GimpPDBStatusType    *statuses;
+  GimpRunMode           run_mode;
+  gboolean              merge_visible;
+
+  gint                  n_images;
+  gint                  next;
+  gint                  n_done;
+  gint                  n_running;
+  gint                  max_jobs;
+  gboolean              starting;
+
+  FileSaveBatchItem    *items;
+  GString              *errors;
+  GMainLoop            *main_loop;
+};
+
+
+static gchar     * file_save_get_filename       (const gchar          *uri,
+                                                 GError              **error);
+static GimpImage * file_save_prepare_export     (GimpImage            *image,
+                                                 GimpContext          *context,
+                                                 GimpPlugInProcedure  *file_proc,
+                                                 gboolean              merge_visible,
+                                                 GError              **error);
+static void        file_save_job_done           (GimpProcedure        *procedure,
+                                                 GimpValueArray       *return_vals,
+                                                 FileSaveJob          *job);
+static void        file_save_job_free           (FileSaveJob          *job);
+static void        file_save_batch_start_jobs   (FileSaveBatch        *batch);
+static void        file_save_batch_image_saved  (GimpImage            *image,
+                                                 const gchar          *uri,
+                                                 GimpPDBStatusType     status,
+                                                 const GError         *error,
+                                                 gpointer              user_data);
+
+
 /*  public functions  */
 
 GimpPDBStatusType
@@ -104,34 +175,10 @@ file_save (Gimp                *gimp,
   if (! drawable)
     return GIMP_PDB_EXECUTION_ERROR;
 
-  filename = file_utils_filename_from_uri (uri);
+  filename = file_save_get_filename (uri, error);
 
-  if (filename)
-    {
-      /* check if we are saving to a file */
-      if (g_file_test (filename, G_FILE_TEST_EXISTS))
-        {
-          if (! g_file_test (filename, G_FILE_TEST_IS_REGULAR))
-            {
-              g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-				   _("Not a regular file"));
-              status = GIMP_PDB_EXECUTION_ERROR;
-              goto out;
-            }
-
-          if (g_access (filename, W_OK) != 0)
-            {
-              g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_ACCES,
-                                   g_strerror (errno));
-              status = GIMP_PDB_EXECUTION_ERROR;
-              goto out;
-            }
-        }
-    }
-  else
-    {
-      filename = g_strdup (uri);
-    }
+  if (! filename)
+    return GIMP_PDB_EXECUTION_ERROR;
 
   /* ref the image, so it can't get deleted during save */
   g_object_ref (image);
@@ -210,8 +257,9 @@ file_save (Gimp                *gimp,
                                               file_proc->mime_type);
 
       /* only save a thumbnail if we are saving as XCF, see bug #25272 */
-      if (GIMP_PROCEDURE (file_proc)->proc_type == GIMP_INTERNAL)
-        gimp_imagefile_save_thumbnail (imagefile, file_proc->mime_type, image);
+      if (! strcmp (gimp_object_get_name (file_proc), "gimp-xcf-save"))
+        gimp_imagefile_save_thumbnail_async (imagefile, file_proc->mime_type,
+                                             image);
     }
   else if (status != GIMP_PDB_CANCEL)
     {
@@ -227,8 +275,535 @@ file_save (Gimp                *gimp,
 
   g_object_unref (image);
 
- out:
   g_free (filename);
 
   return status;
 }
+
+/**
+ * file_save_async:
+ * @gimp:
+ * @context:
+ * @image:
+ * @uri:
+ * @run_mode:
+ * @merge_visible: whether to export the visible layers merged into one
+ * @callback:      called when the save is done or failed
+ * @user_data:
+ *
+ * Saves @image with the save or export procedure @uri picks, and
+ * returns before the procedure is done. Exports work on a copy that
+ * is converted and flattened in the core as far as the export
+ * procedure requires it, and merged with @merge_visible, so that the
+ * plug-in gets a drawable it can handle without calling back into
+ * the core. @image itself only gets its save or export state
+ * updated. Each save shows a progress of its own.
+ **/
+void
+file_save_async (Gimp                 *gimp,
+                 GimpContext          *context,
+                 GimpImage            *image,
+                 const gchar          *uri,
+                 GimpRunMode           run_mode,
+                 gboolean              merge_visible,
+                 GimpFileSaveCallback  callback,
+                 gpointer              user_data)
+{
+  FileSaveJob    *job;
+  GimpImage      *save_image;
+  GimpDrawable   *drawable;
+  GimpProcedure  *procedure;
+  GimpValueArray *args;
+  gchar          *filename;
+  GError         *error = NULL;
+  gint            i;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+  g_return_if_fail (GIMP_IS_CONTEXT (context));
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+  g_return_if_fail (uri != NULL);
+  g_return_if_fail (callback != NULL);
+
+  job = g_slice_new0 (FileSaveJob);
+
+  job->gimp      = gimp;
+  job->image     = g_object_ref (image);
+  job->uri       = g_strdup (uri);
+  job->callback  = callback;
+  job->user_data = user_data;
+
+  job->file_proc = file_procedure_find (gimp->plug_in_manager->save_procs,
+                                        uri, NULL);
+
+  if (! job->file_proc)
+    {
+      job->file_proc = file_procedure_find (gimp->plug_in_manager->export_procs,
+                                            uri, &error);
+      job->export    = TRUE;
+    }
+
+  filename = job->file_proc ? file_save_get_filename (uri, &error) : NULL;
+
+  /*  only exports work on a copy, saves are of the image itself  */
+  if (filename && job->export)
+    {
+      job->export_image = file_save_prepare_export (image, context,
+                                                    job->file_proc,
+                                                    merge_visible,
+                                                    &error);
+
+      if (! job->export_image)
+        {
+          g_free (filename);
+          filename = NULL;
+        }
+    }
+
+  save_image = job->export_image ? job->export_image : image;
+  drawable   = gimp_image_get_active_drawable (save_image);
+
+  if (! drawable && gimp_image_get_n_layers (save_image) > 0)
+    drawable = gimp_image_get_layer_iter (save_image)->data;
+
+  if (! filename || ! drawable)
+    {
+      if (filename && ! error)
+        g_set_error_literal (&error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                             _("There is no drawable to save"));
+
+      callback (image, uri, GIMP_PDB_EXECUTION_ERROR, error, user_data);
+
+      g_clear_error (&error);
+      g_free (filename);
+
+      file_save_job_free (job);
+
+      return;
+    }
+
+  procedure = GIMP_PROCEDURE (job->file_proc);
+  args      = gimp_procedure_get_arguments (procedure);
+
+  g_value_set_int (gimp_value_array_index (args, 0), run_mode);
+  gimp_value_set_image (gimp_value_array_index (args, 1), save_image);
+  gimp_value_set_drawable (gimp_value_array_index (args, 2), drawable);
+  g_value_set_string (gimp_value_array_index (args, 3), filename);
+  g_value_set_string (gimp_value_array_index (args, 4), uri);
+
+  for (i = 5; i < procedure->num_args; i++)
+    if (G_IS_PARAM_SPEC_STRING (procedure->args[i]))
+      g_value_set_static_string (gimp_value_array_index (args, i), "");
+
+  gimp_plug_in_procedure_execute_with_callback (job->file_proc, gimp,
+                                                context, NULL, args,
+                                                (GimpProcedureReturnFunc)
+                                                file_save_job_done,
+                                                job);
+
+  gimp_value_array_unref (args);
+  g_free (filename);
+}
+
+/**
+ * file_save_batch:
+ * @gimp:
+ * @context:
+ * @progress:      shows how many of the images are done
+ * @images:        the images to save
+ * @uris:          where to save each of them
+ * @n_images:
+ * @run_mode:
+ * @merge_visible: whether to export the visible layers merged into one
+ * @max_jobs:      the most plug-ins to run at the same time, or 0
+ * @statuses:      return location for the status of each image
+ * @error:
+ *
+ * Saves several images at the same time with file_save_async(),
+ * keeping up to @max_jobs save procedures busy, and waits for them.
+ *
+ * Return value: %GIMP_PDB_SUCCESS if all images were saved.
+ **/
+GimpPDBStatusType
+file_save_batch (Gimp               *gimp,
+                 GimpContext        *context,
+                 GimpProgress       *progress,
+                 GimpImage         **images,
+                 const gchar       **uris,
+                 gint                n_images,
+                 GimpRunMode         run_mode,
+                 gboolean            merge_visible,
+                 gint                max_jobs,
+                 GimpPDBStatusType  *statuses,
+                 GError            **error)
+{
+  FileSaveBatch batch = { 0, };
+  gint          i;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), GIMP_PDB_CALLING_ERROR);
+  g_return_val_if_fail (GIMP_IS_CONTEXT (context), GIMP_PDB_CALLING_ERROR);
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress),
+                        GIMP_PDB_CALLING_ERROR);
+  g_return_val_if_fail (n_images == 0 || (images && uris && statuses),
+                        GIMP_PDB_CALLING_ERROR);
+  g_return_val_if_fail (error == NULL || *error == NULL,
+                        GIMP_PDB_CALLING_ERROR);
+
+  if (max_jobs < 1)
+    max_jobs = GIMP_GEGL_CONFIG (gimp->config)->num_processors;
+
+  batch.gimp          = gimp;
+  batch.context       = context;
+  batch.progress      = progress;
+  batch.images        = images;
+  batch.uris          = uris;
+  batch.statuses      = statuses;
+  batch.run_mode      = run_mode;
+  batch.merge_visible = merge_visible;
+  batch.n_images      = n_images;
+  batch.max_jobs      = MAX (max_jobs, 1);
+  batch.items         = g_new (FileSaveBatchItem, n_images);
+  batch.errors        = g_string_new (NULL);
+
+  for (i = 0; i < n_images; i++)
+    {
+      batch.items[i].batch = &batch;
+      batch.items[i].index = i;
+
+      statuses[i] = GIMP_PDB_EXECUTION_ERROR;
+    }
+
+  if (progress && n_images > 0)
+    gimp_progress_start (progress, _("Exporting images"), FALSE);
+
+  file_save_batch_start_jobs (&batch);
+
+  /*  wait for the plug-ins still running  */
+  if (batch.n_running > 0)
+    {
+      batch.main_loop = g_main_loop_new (NULL, FALSE);
+
+      gimp_threads_leave (gimp);
+      g_main_loop_run (batch.main_loop);
+      gimp_threads_enter (gimp);
+
+      g_main_loop_unref (batch.main_loop);
+    }
+
+  if (progress && n_images > 0)
+    gimp_progress_end (progress);
+
+  if (batch.errors->len > 0)
+    g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                         batch.errors->str);
+
+  g_string_free (batch.errors, TRUE);
+  g_free (batch.items);
+
+  for (i = 0; i < n_images; i++)
+    if (statuses[i] != GIMP_PDB_SUCCESS)
+      return GIMP_PDB_EXECUTION_ERROR;
+
+  return GIMP_PDB_SUCCESS;
+}
+
+
+/*  private functions  */
+
+static gchar *
+file_save_get_filename (const gchar  *uri,
+                        GError      **error)
+{
+  gchar *filename = file_utils_filename_from_uri (uri);
+
+  if (filename)
+    {
+      /* check if we are saving to a file */
+      if (g_file_test (filename, G_FILE_TEST_EXISTS))
+        {
+          if (! g_file_test (filename, G_FILE_TEST_IS_REGULAR))
+            {
+              g_free (filename);
+              g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+				   _("Not a regular file"));
+              return NULL;
+            }
+
+          if (g_access (filename, W_OK) != 0)
+            {
+              g_free (filename);
+              g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_ACCES,
+                                   g_strerror (errno));
+              return NULL;
+            }
+        }
+    }
+  else
+    {
+      filename = g_strdup (uri);
+    }
+
+  return filename;
+}
+
+/*  Makes a copy of image that the export procedure can save as it is:
+ *  converted to a base type it supports, with the visible layers merged
+ *  if asked for, and flattened if it can't save alpha.
+ */
+static GimpImage *
+file_save_prepare_export (GimpImage            *image,
+                          GimpContext          *context,
+                          GimpPlugInProcedure  *file_proc,
+                          gboolean              merge_visible,
+                          GError              **error)
+{
+  GimpPlugInImageType  types = file_proc->image_types_val;
+  GimpImage           *export_image;
+  GimpImageBaseType    base_type;
+  gboolean             has_alpha;
+  gboolean             supported;
+
+  /*  procedures that don't tell get the image as it is  */
+  if (! types)
+    types = (GIMP_PLUG_IN_RGB_IMAGE  | GIMP_PLUG_IN_RGBA_IMAGE  |
+             GIMP_PLUG_IN_GRAY_IMAGE | GIMP_PLUG_IN_GRAYA_IMAGE |
+             GIMP_PLUG_IN_INDEXED_IMAGE | GIMP_PLUG_IN_INDEXEDA_IMAGE);
+
+  export_image = gimp_image_duplicate (image);
+
+  gimp_image_undo_disable (export_image);
+
+  base_type = gimp_image_get_base_type (export_image);
+
+  switch (base_type)
+    {
+    case GIMP_RGB:
+      has_alpha = (types & GIMP_PLUG_IN_RGBA_IMAGE) != 0;
+      supported = (types & (GIMP_PLUG_IN_RGB_IMAGE |
+                            GIMP_PLUG_IN_RGBA_IMAGE)) != 0;
+      break;
+
+    case GIMP_GRAY:
+      has_alpha = (types & GIMP_PLUG_IN_GRAYA_IMAGE) != 0;
+      supported = (types & (GIMP_PLUG_IN_GRAY_IMAGE |
+                            GIMP_PLUG_IN_GRAYA_IMAGE)) != 0;
+      break;
+
+    default:
+      has_alpha = (types & GIMP_PLUG_IN_INDEXEDA_IMAGE) != 0;
+      supported = (types & (GIMP_PLUG_IN_INDEXED_IMAGE |
+                            GIMP_PLUG_IN_INDEXEDA_IMAGE)) != 0;
+      break;
+    }
+
+  if (! supported)
+    {
+      if (types & (GIMP_PLUG_IN_RGB_IMAGE | GIMP_PLUG_IN_RGBA_IMAGE))
+        {
+          base_type = GIMP_RGB;
+          has_alpha = (types & GIMP_PLUG_IN_RGBA_IMAGE) != 0;
+        }
+      else if (types & (GIMP_PLUG_IN_GRAY_IMAGE | GIMP_PLUG_IN_GRAYA_IMAGE))
+        {
+          base_type = GIMP_GRAY;
+          has_alpha = (types & GIMP_PLUG_IN_GRAYA_IMAGE) != 0;
+        }
+      else
+        {
+          base_type = GIMP_INDEXED;
+          has_alpha = (types & GIMP_PLUG_IN_INDEXEDA_IMAGE) != 0;
+        }
+
+      if (! gimp_image_convert (export_image, base_type,
+                                MAXNUMCOLORS, GIMP_NO_DITHER, FALSE, FALSE,
+                                GIMP_MAKE_PALETTE, NULL, NULL, error))
+        {
+          g_object_unref (export_image);
+
+          return NULL;
+        }
+    }
+
+  if (merge_visible)
+    {
+      gboolean merged = FALSE;
+
+      /*  an export in the image's own type can take the merged pixels
+       *  straight from the projection the display already rendered,
+       *  instead of compositing the layer stack a second time
+       */
+      if (supported &&
+          (! has_alpha || gimp_image_get_n_layers (export_image) > 1))
+        merged = gimp_image_flatten_projection (export_image, image, context,
+                                                has_alpha ?
+                                                GIMP_CLIP_TO_IMAGE :
+                                                GIMP_FLATTEN_IMAGE) != NULL;
+
+      if (merged)
+        {
+          /*  done  */
+        }
+      else if (! has_alpha)
+        {
+          gimp_image_flatten (export_image, context);
+        }
+      else if (gimp_image_get_n_layers (export_image) > 1)
+        {
+          gimp_image_merge_visible_layers (export_image, context,
+                                           GIMP_CLIP_TO_IMAGE, FALSE, TRUE);
+        }
+    }
+  else if (! has_alpha)
+    {
+      GList *list;
+
+      for (list = gimp_image_get_layer_iter (export_image);
+           list;
+           list = g_list_next (list))
+        {
+          GimpLayer *layer = list->data;
+
+          if (gimp_drawable_has_alpha (GIMP_DRAWABLE (layer)))
+            gimp_layer_flatten (layer, context);
+        }
+    }
+
+  return export_image;
+}
+
+static void
+file_save_job_done (GimpProcedure  *procedure,
+                    GimpValueArray *return_vals,
+                    FileSaveJob    *job)
+{
+  GimpPDBStatusType  status;
+  GError            *error = NULL;
+
+  status = g_value_get_enum (gimp_value_array_index (return_vals, 0));
+
+  if (status == GIMP_PDB_SUCCESS)
+    {
+      GimpDocumentList *documents = GIMP_DOCUMENT_LIST (job->gimp->documents);
+
+      if (job->export)
+        {
+          gimp_image_set_exported_uri (job->image, job->uri);
+          gimp_image_set_imported_uri (job->image, NULL);
+          gimp_image_export_clean_all (job->image);
+
+          gimp_image_exported (job->image, job->uri);
+        }
+      else
+        {
+          gimp_image_set_uri (job->image, job->uri);
+          gimp_image_set_save_proc (job->image, job->file_proc);
+          gimp_image_set_imported_uri (job->image, NULL);
+          gimp_image_clean_all (job->image);
+
+          gimp_image_saved (job->image, job->uri);
+        }
+
+      gimp_document_list_add_uri (documents, job->uri,
+                                  job->file_proc->mime_type);
+    }
+  else if (status != GIMP_PDB_CANCEL)
+    {
+      const gchar *message = NULL;
+
+      if (gimp_value_array_length (return_vals) > 1 &&
+          G_VALUE_HOLDS_STRING (gimp_value_array_index (return_vals, 1)))
+        message = g_value_get_string (gimp_value_array_index (return_vals, 1));
+
+      if (message)
+        error = g_error_new_literal (G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                     message);
+      else
+        error = g_error_new (G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                             _("%s plug-in could not save image"),
+                             gimp_plug_in_procedure_get_label (job->file_proc));
+    }
+
+  gimp_image_flush (job->image);
+
+  job->callback (job->image, job->uri, status, error, job->user_data);
+
+  g_clear_error (&error);
+
+  file_save_job_free (job);
+}
+
+static void
+file_save_job_free (FileSaveJob *job)
+{
+  if (job->export_image)
+    g_object_unref (job->export_image);
+
+  g_object_unref (job->image);
+  g_free (job->uri);
+
+  g_slice_free (FileSaveJob, job);
+}
+
+static void
+file_save_batch_start_jobs (FileSaveBatch *batch)
+{
+  /*  saves that fail right away finish from in here, don't recurse  */
+  if (batch->starting)
+    return;
+
+  batch->starting = TRUE;
+
+  while (batch->n_running < batch->max_jobs &&
+         batch->next < batch->n_images)
+    {
+      gint i = batch->next++;
+
+      batch->n_running++;
+
+      file_save_async (batch->gimp, batch->context,
+                       batch->images[i], batch->uris[i],
+                       batch->run_mode, batch->merge_visible,
+                       file_save_batch_image_saved, &batch->items[i]);
+    }
+
+  batch->starting = FALSE;
+}
+
+static void
+file_save_batch_image_saved (GimpImage         *image,
+                             const gchar       *uri,
+                             GimpPDBStatusType  status,
+                             const GError      *error,
+                             gpointer           user_data)
+{
+  FileSaveBatchItem *item  = user_data;
+  FileSaveBatch     *batch = item->batch;
+
+  batch->statuses[item->index] = status;
+
+  if (status != GIMP_PDB_SUCCESS && status != GIMP_PDB_CANCEL)
+    {
+      gchar *filename = file_utils_uri_display_name (uri);
+
+      if (batch->errors->len > 0)
+        g_string_append_c (batch->errors, '\n');
+
+      g_string_append_printf (batch->errors,
+                              _("Saving '%s' failed: %s"),
+                              filename, error ? error->message : "");
+
+      g_free (filename);
+    }
+
+  batch->n_running--;
+  batch->n_done++;
+
+  if (batch->progress)
+    gimp_progress_set_value (batch->progress,
+                             (gdouble) batch->n_done / batch->n_images);
+
+  /*  keep the plug-ins busy  */
+  file_save_batch_start_jobs (batch);
+
+  if (batch->n_running == 0 && batch->main_loop)
+    g_main_loop_quit (batch->main_loop);
+}
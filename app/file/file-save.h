@@ -21,6 +21,13 @@
 #define __FILE_SAVE_H__
 
 
+typedef void (* GimpFileSaveCallback) (GimpImage         *image,
+                                       const gchar       *uri,
+                                       GimpPDBStatusType  status,
+                                       const GError      *error,
+                                       gpointer           user_data);
+
+
 GimpPDBStatusType   file_save (Gimp                 *gimp,
                                GimpImage            *image,
                                GimpProgress         *progress,
@@ -32,5 +39,26 @@ GimpPDBStatusType   file_save (Gimp                 *gimp,
                                gboolean              export_forward,
                                GError              **error);
 
+void                file_save_async (Gimp                 *gimp,
+                                     GimpContext          *context,
+                                     GimpImage            *image,
+                                     const gchar          *uri,
+                                     GimpRunMode           run_mode,
+                                     gboolean              merge_visible,
+                                     GimpFileSaveCallback  callback,
+                                     gpointer              user_data);
+
+GimpPDBStatusType   file_save_batch (Gimp               *gimp,
+                                     GimpContext        *context,
+                                     GimpProgress       *progress,
+                                     GimpImage         **images,
+                                     const gchar       **uris,
+                                     gint                n_images,
+                                     GimpRunMode         run_mode,
+                                     gboolean            merge_visible,
+                                     gint                max_jobs,
+                                     GimpPDBStatusType  *statuses,
+                                     GError            **error);
+
 
 #endif /* __FILE_SAVE_H__ */
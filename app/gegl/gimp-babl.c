@@ -20,15 +20,56 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 
 #include "gimp-gegl-types.h"
 
 #include "gimp-babl.h"
 
+#include "gimp-log.h"
 #include "gimp-intl.h"
 
 
+/*  the pixels converted by each fish when warming the cache, and
+ *  with babl-stats logging, the pixels timed to find slow fishes
+ */
+#define FISH_WARM_PIXELS         64
+#define FISH_TIMED_PIXELS        4096
+
+/*  fishes slower than this are most likely babl's reference
+ *  conversion, the fast paths stay well below it
+ */
+#define FISH_SLOW_NS_PER_PIXEL   50.0
+
+
+typedef struct _GimpBablFish GimpBablFish;
+
+struct _GimpBablFish
+{
+  const Babl *source_format;
+  const Babl *destination_format;
+  const Babl *fish;
+
+  guint       n_lookups;
+  guint       n_calls;
+  guint64     n_pixels;
+  gint64      time;        /*  µs spent in gimp_babl_process()  */
+  gdouble     warm_ns;     /*  ns per pixel when warming, or 0.0  */
+};
+
+
+static void           gimp_babl_fish_cache_init (void);
+static GimpBablFish * gimp_babl_fish_lookup     (const Babl *source_format,
+                                                 const Babl *destination_format);
+
+
+static GHashTable *babl_fish_hash      = NULL;  /*  formats -> GimpBablFish  */
+static GHashTable *babl_fish_stats     = NULL;  /*  fish    -> GimpBablFish  */
+static GMutex      babl_fish_mutex;
+
+
 void
 gimp_babl_init (void)
 {
@@ -142,6 +183,24 @@ gimp_babl_init (void)
                    babl_type ("double"),
                    babl_component ("A"),
                    NULL);
+
+  gimp_babl_fish_cache_init ();
+}
+
+void
+gimp_babl_exit (void)
+{
+  if (! babl_fish_hash)
+    return;
+
+  if (gimp_log_flags & GIMP_LOG_BABL_STATS)
+    gimp_babl_print_stats ();
+
+  g_hash_table_destroy (babl_fish_stats);
+  babl_fish_stats = NULL;
+
+  g_hash_table_destroy (babl_fish_hash);
+  babl_fish_hash = NULL;
 }
 
 static const struct
@@ -527,3 +586,268 @@ gimp_babl_component_format (GimpImageBaseType base_type,
 
   g_return_val_if_reached (NULL);
 }
+
+/**
+ * gimp_babl_fish:
+ * @source_format:      the format to convert from
+ * @destination_format: the format to convert to
+ *
+ * Like babl_fish(), but looks the fish up in a cache that
+ * gimp_babl_init() fills with the conversions GIMP uses most, so
+ * callers can ask for it per row or per tile.
+ *
+ * Return value: the fish converting @source_format to @destination_format.
+ **/
+const Babl *
+gimp_babl_fish (const Babl *source_format,
+                const Babl *destination_format)
+{
+  GimpBablFish *entry;
+
+  g_return_val_if_fail (source_format != NULL, NULL);
+  g_return_val_if_fail (destination_format != NULL, NULL);
+
+  entry = gimp_babl_fish_lookup (source_format, destination_format);
+
+  return entry->fish;
+}
+
+/**
+ * gimp_babl_process:
+ * @fish:     a fish returned by gimp_babl_fish()
+ * @source:   the pixels to convert
+ * @dest:     the converted pixels
+ * @n_pixels: the number of pixels
+ *
+ * Like babl_process(), with the pixel counts and times reported by
+ * the "babl-stats" log domain.
+ **/
+void
+gimp_babl_process (const Babl    *fish,
+                   gconstpointer  source,
+                   gpointer       dest,
+                   glong          n_pixels)
+{
+  gint64 start_time;
+
+  if (G_LIKELY (! (gimp_log_flags & GIMP_LOG_BABL_STATS)))
+    {
+      babl_process (fish, (gpointer) source, dest, n_pixels);
+      return;
+    }
+
+  start_time = g_get_monotonic_time ();
+
+  babl_process (fish, (gpointer) source, dest, n_pixels);
+
+  g_mutex_lock (&babl_fish_mutex);
+
+  if (babl_fish_stats)
+    {
+      GimpBablFish *entry = g_hash_table_lookup (babl_fish_stats, fish);
+
+      if (entry)
+        {
+          entry->n_calls++;
+          entry->n_pixels += n_pixels;
+          entry->time     += g_get_monotonic_time () - start_time;
+        }
+    }
+
+  g_mutex_unlock (&babl_fish_mutex);
+}
+
+static gint
+gimp_babl_compare_fish_time (const GimpBablFish *fish1,
+                             const GimpBablFish *fish2)
+{
+  if (fish1->time != fish2->time)
+    return fish1->time < fish2->time ? 1 : -1;
+
+  return (gint) fish2->n_lookups - (gint) fish1->n_lookups;
+}
+
+void
+gimp_babl_print_stats (void)
+{
+  GList *fishes;
+  GList *list;
+
+  g_return_if_fail (babl_fish_hash != NULL);
+
+  g_mutex_lock (&babl_fish_mutex);
+
+  fishes = g_hash_table_get_values (babl_fish_hash);
+  fishes = g_list_sort (fishes, (GCompareFunc) gimp_babl_compare_fish_time);
+
+  g_printerr ("\nbabl conversion statistics (lookups, calls, pixels, "
+              "total ms, ns per pixel, warm ns per pixel):\n\n");
+
+  for (list = fishes; list; list = g_list_next (list))
+    {
+      GimpBablFish *entry = list->data;
+      gdouble       ns    = 0.0;
+
+      if (entry->n_pixels > 0)
+        ns = entry->time * 1000.0 / entry->n_pixels;
+
+      g_printerr ("%-20s -> %-20s %6u %8u %12" G_GUINT64_FORMAT
+                  " %10.3f %8.1f %8.1f%s\n",
+                  babl_get_name (entry->source_format),
+                  babl_get_name (entry->destination_format),
+                  entry->n_lookups,
+                  entry->n_calls,
+                  entry->n_pixels,
+                  entry->time / 1000.0,
+                  ns,
+                  entry->warm_ns,
+                  MAX (ns, entry->warm_ns) > FISH_SLOW_NS_PER_PIXEL ?
+                  "  SLOW" : "");
+    }
+
+  g_mutex_unlock (&babl_fish_mutex);
+
+  g_list_free (fishes);
+}
+
+
+/*  private functions  */
+
+static guint
+gimp_babl_fish_hash (const GimpBablFish *entry)
+{
+  return (g_direct_hash (entry->source_format) * 31 +
+          g_direct_hash (entry->destination_format));
+}
+
+static gboolean
+gimp_babl_fish_equal (const GimpBablFish *entry1,
+                      const GimpBablFish *entry2)
+{
+  return (entry1->source_format      == entry2->source_format &&
+          entry1->destination_format == entry2->destination_format);
+}
+
+static GimpBablFish *
+gimp_babl_fish_lookup (const Babl *source_format,
+                       const Babl *destination_format)
+{
+  GimpBablFish  key;
+  GimpBablFish *entry;
+
+  key.source_format      = source_format;
+  key.destination_format = destination_format;
+
+  g_mutex_lock (&babl_fish_mutex);
+
+  if (G_UNLIKELY (! babl_fish_hash))
+    {
+      babl_fish_hash  = g_hash_table_new_full ((GHashFunc) gimp_babl_fish_hash,
+                                               (GEqualFunc) gimp_babl_fish_equal,
+                                               NULL,
+                                               (GDestroyNotify) g_free);
+      babl_fish_stats = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
+
+  entry = g_hash_table_lookup (babl_fish_hash, &key);
+
+  if (! entry)
+    {
+      entry = g_new0 (GimpBablFish, 1);
+
+      entry->source_format      = source_format;
+      entry->destination_format = destination_format;
+      entry->fish               = babl_fish (source_format,
+                                             destination_format);
+
+      g_hash_table_insert (babl_fish_hash, entry, entry);
+      g_hash_table_insert (babl_fish_stats, (gpointer) entry->fish, entry);
+    }
+
+  entry->n_lookups++;
+
+  g_mutex_unlock (&babl_fish_mutex);
+
+  return entry;
+}
+
+/*  builds the fishes between GIMP's drawable formats and the formats
+ *  GEGL operations and the display work in, babl's path search is
+ *  slow enough that doing it at startup beats doing it on the first
+ *  paint stroke or redraw
+ */
+static void
+gimp_babl_fish_cache_init (void)
+{
+  static const gchar *work_formats[] =
+  {
+    "R'G'B'A float",
+    "RGBA float",
+    "cairo-ARGB32"
+  };
+
+  static const GimpImageBaseType base_types[] =
+  {
+    GIMP_RGB,
+    GIMP_GRAY
+  };
+
+  static const GimpPrecision precisions[] =
+  {
+    GIMP_PRECISION_U8,
+    GIMP_PRECISION_U16,
+    GIMP_PRECISION_U32,
+    GIMP_PRECISION_HALF,
+    GIMP_PRECISION_FLOAT
+  };
+
+  gboolean  timed = (gimp_log_flags & GIMP_LOG_BABL_STATS) != 0;
+  gint      n_pixels;
+  guchar   *src;
+  guchar   *dest;
+  gint      b, p, a, w, d;
+
+  /*  16 bytes is the biggest pixel in the lists above  */
+  n_pixels = timed ? FISH_TIMED_PIXELS : FISH_WARM_PIXELS;
+  src      = g_new0 (guchar, n_pixels * 16);
+  dest     = g_new0 (guchar, n_pixels * 16);
+
+  for (b = 0; b < G_N_ELEMENTS (base_types); b++)
+    for (p = 0; p < G_N_ELEMENTS (precisions); p++)
+      for (a = 0; a < 2; a++)
+        for (w = 0; w < G_N_ELEMENTS (work_formats); w++)
+          for (d = 0; d < 2; d++)
+            {
+              const Babl   *format = gimp_babl_format (base_types[b],
+                                                       precisions[p], a);
+              const Babl   *work   = babl_format (work_formats[w]);
+              GimpBablFish *entry;
+              gint64        start_time;
+
+              /*  nothing converts from what the display shows  */
+              if (d && ! strcmp (work_formats[w], "cairo-ARGB32"))
+                continue;
+
+              entry = (d ?
+                       gimp_babl_fish_lookup (work, format) :
+                       gimp_babl_fish_lookup (format, work));
+
+              entry->n_lookups = 0;
+
+              /*  the first conversion sets up babl's lookup tables  */
+              babl_process (entry->fish, src, dest, FISH_WARM_PIXELS);
+
+              if (timed)
+                {
+                  start_time = g_get_monotonic_time ();
+
+                  babl_process (entry->fish, src, dest, n_pixels);
+
+                  entry->warm_ns = ((g_get_monotonic_time () - start_time) *
+                                    1000.0 / n_pixels);
+                }
+            }
+
+  g_free (src);
+  g_free (dest);
+}
@@ -23,6 +23,7 @@
 
 
 void                gimp_babl_init                  (void);
+void                gimp_babl_exit                  (void);
 
 const gchar       * gimp_babl_get_description       (const Babl        *babl);
 
@@ -36,5 +37,13 @@ const Babl        * gimp_babl_component_format      (GimpImageBaseType  base_typ
                                                      GimpPrecision      precision,
                                                      gint               index);
 
+const Babl        * gimp_babl_fish                  (const Babl        *source_format,
+                                                     const Babl        *destination_format);
+void                gimp_babl_process               (const Babl        *fish,
+                                                     gconstpointer      source,
+                                                     gpointer           dest,
+                                                     glong              n_pixels);
+void                gimp_babl_print_stats           (void);
+
 
 #endif /* __GIMP_BABL_H__ */
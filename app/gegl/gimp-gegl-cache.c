@@ -0,0 +1,294 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-gegl-cache.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <gegl.h>
+
+#include "gimp-gegl-types.h"
+
+#include "base/tile-cache.h"
+
+#include "config/gimpgeglconfig.h"
+
+#include "gimp-gegl-cache.h"
+
+
+/*  With "tile-cache-adaptive", the size of both the legacy tile cache
+ *  and GEGL's cache follows the memory the system has to spare,
+ *  between "tile-cache-min-size" and "tile-cache-max-size".  Memory
+ *  pressure is taken from /proc/pressure/memory (the share of time
+ *  tasks stalled waiting for memory) where the kernel provides it,
+ *  and from MemAvailable in /proc/meminfo.  Shrinking the legacy
+ *  cache is left to its idle swapper.
+ */
+
+#define MONITOR_INTERVAL   5         /*  seconds                          */
+
+#define PRESSURE_HIGH      10.0      /*  percent stalled, shrink above    */
+#define PRESSURE_LOW       1.0       /*  percent stalled, may grow below  */
+
+#define AVAILABLE_LOW      5         /*  percent of RAM, shrink below     */
+#define AVAILABLE_HIGH     20        /*  percent of RAM, may grow above   */
+
+#define MIN_STEP           (16 << 20)
+
+
+static void      gimp_gegl_cache_notify       (GimpGeglConfig *config);
+static void      gimp_gegl_cache_set_size     (guint64         size,
+                                               gboolean        adaptive);
+static gboolean  gimp_gegl_cache_monitor      (gpointer        data);
+static gboolean  gimp_gegl_cache_get_pressure (gdouble        *pressure);
+static gboolean  gimp_gegl_cache_get_meminfo  (guint64        *total,
+                                               guint64        *available);
+
+
+static GimpGeglConfig *cache_config     = NULL;
+static guint64         cache_size       = 0;
+static gboolean        cache_adaptive   = FALSE;
+static guint           cache_monitor_id = 0;
+
+
+/*  public functions  */
+
+void
+gimp_gegl_cache_init (GimpGeglConfig *config)
+{
+  g_return_if_fail (GIMP_IS_GEGL_CONFIG (config));
+  g_return_if_fail (cache_config == NULL);
+
+  cache_config = config;
+
+  g_signal_connect (config, "notify::tile-cache-size",
+                    G_CALLBACK (gimp_gegl_cache_notify),
+                    NULL);
+  g_signal_connect (config, "notify::tile-cache-adaptive",
+                    G_CALLBACK (gimp_gegl_cache_notify),
+                    NULL);
+  g_signal_connect (config, "notify::tile-cache-min-size",
+                    G_CALLBACK (gimp_gegl_cache_notify),
+                    NULL);
+  g_signal_connect (config, "notify::tile-cache-max-size",
+                    G_CALLBACK (gimp_gegl_cache_notify),
+                    NULL);
+
+  gimp_gegl_cache_notify (config);
+}
+
+
+/*  private functions  */
+
+/*  starts over from "tile-cache-size" whenever one of the options
+ *  changes
+ */
+static void
+gimp_gegl_cache_notify (GimpGeglConfig *config)
+{
+  gboolean was_adaptive = cache_adaptive;
+
+  cache_adaptive = config->tile_cache_adaptive;
+
+  if (cache_monitor_id)
+    {
+      g_source_remove (cache_monitor_id);
+      cache_monitor_id = 0;
+    }
+
+  if (config->tile_cache_adaptive)
+    {
+      guint64 min_size = config->tile_cache_min_size;
+      guint64 max_size = MAX (config->tile_cache_max_size, min_size);
+
+      gimp_gegl_cache_set_size (CLAMP (config->tile_cache_size,
+                                       min_size, max_size),
+                                TRUE);
+
+      cache_monitor_id = g_timeout_add_seconds (MONITOR_INTERVAL,
+                                                gimp_gegl_cache_monitor,
+                                                NULL);
+    }
+  else
+    {
+      /*  base.c takes care of the legacy tile cache, unless it was
+       *  left at an adaptive size
+       */
+      if (was_adaptive)
+        tile_cache_set_size (config->tile_cache_size);
+
+      gimp_gegl_cache_set_size (config->tile_cache_size, FALSE);
+    }
+}
+
+static void
+gimp_gegl_cache_set_size (guint64  size,
+                          gboolean adaptive)
+{
+  cache_size = size;
+
+  if (adaptive)
+    tile_cache_set_target_size (size);
+
+#ifdef __GNUC__
+#warning limiting tile cache size to G_MAXINT
+#endif
+
+  g_object_set (gegl_config (),
+                "cache-size", (gint) MIN (size, G_MAXINT),
+                NULL);
+}
+
+static gboolean
+gimp_gegl_cache_monitor (gpointer data)
+{
+  GimpGeglConfig *config    = cache_config;
+  guint64         min_size  = config->tile_cache_min_size;
+  guint64         max_size  = MAX (config->tile_cache_max_size, min_size);
+  guint64         size      = cache_size;
+  gdouble         pressure  = 0.0;
+  guint64         total     = 0;
+  guint64         available = 0;
+  gboolean        have_pressure;
+  gboolean        have_meminfo;
+
+  have_pressure = gimp_gegl_cache_get_pressure (&pressure);
+  have_meminfo  = gimp_gegl_cache_get_meminfo (&total, &available);
+
+  if (! have_pressure && ! have_meminfo)
+    {
+      /*  nothing to go by on this system, stay where we are  */
+      cache_monitor_id = 0;
+
+      return FALSE;
+    }
+
+  if ((have_pressure && pressure > PRESSURE_HIGH) ||
+      (have_meminfo  && available < total / 100 * AVAILABLE_LOW))
+    {
+      guint64 step = MAX (size / 4, MIN_STEP);
+
+      size = (size > min_size + step) ? size - step : min_size;
+    }
+  else if ((! have_pressure || pressure < PRESSURE_LOW) &&
+           (! have_meminfo  || available > total / 100 * AVAILABLE_HIGH))
+    {
+      guint64 used;
+      guint64 limit;
+
+      tile_cache_get_usage (&used, &limit, NULL);
+
+      /*  only grow a cache that is actually used up  */
+      if (used >= limit / 10 * 9)
+        {
+          guint64 step = MAX (size / 8, MIN_STEP);
+
+          if (have_meminfo)
+            step = MIN (step, available / 4);
+
+          size = MIN (size + step, max_size);
+        }
+    }
+
+  size = CLAMP (size, min_size, max_size);
+
+  if (size != cache_size)
+    gimp_gegl_cache_set_size (size, TRUE);
+
+  return TRUE;
+}
+
+/*  the "some avg10" value of /proc/pressure/memory, the percentage of
+ *  the last ten seconds in which at least one task waited for memory
+ */
+static gboolean
+gimp_gegl_cache_get_pressure (gdouble *pressure)
+{
+  gboolean  success = FALSE;
+#ifdef G_OS_UNIX
+  FILE     *file;
+  gchar     line[256];
+
+  file = fopen ("/proc/pressure/memory", "r");
+
+  if (! file)
+    return FALSE;
+
+  while (fgets (line, sizeof (line), file))
+    {
+      const gchar *avg10;
+
+      if (strncmp (line, "some ", 5))
+        continue;
+
+      avg10 = strstr (line, "avg10=");
+
+      if (avg10)
+        {
+          *pressure = g_ascii_strtod (avg10 + strlen ("avg10="), NULL);
+          success   = TRUE;
+        }
+
+      break;
+    }
+
+  fclose (file);
+#endif
+
+  return success;
+}
+
+static gboolean
+gimp_gegl_cache_get_meminfo (guint64 *total,
+                             guint64 *available)
+{
+  gboolean  have_total     = FALSE;
+  gboolean  have_available = FALSE;
+#ifdef G_OS_UNIX
+  FILE     *file;
+  gchar     line[256];
+
+  file = fopen ("/proc/meminfo", "r");
+
+  if (! file)
+    return FALSE;
+
+  while (fgets (line, sizeof (line), file) &&
+         ! (have_total && have_available))
+    {
+      gulong kbytes;
+
+      if (sscanf (line, "MemTotal: %lu kB", &kbytes) == 1)
+        {
+          *total     = (guint64) kbytes << 10;
+          have_total = TRUE;
+        }
+      else if (sscanf (line, "MemAvailable: %lu kB", &kbytes) == 1)
+        {
+          *available     = (guint64) kbytes << 10;
+          have_available = TRUE;
+        }
+    }
+
+  fclose (file);
+#endif
+
+  return have_total && have_available;
+}
@@ -22,8 +22,13 @@
 #define __GIMP_GEGL_LOOPS_H__
 
 
-/*  this is a pretty stupid port of concolve_region() that only works
- *  on a linear source buffer
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define GIMP_GEGL_LOOPS_SSE2 1
+#endif
+
+
+/*  a port of convolve_region(), src_rect and dest_rect must have the
+ *  same size
  */
 void   gimp_gegl_convolve           (GeglBuffer          *src_buffer,
                                      const GeglRectangle *src_rect,
@@ -43,12 +48,15 @@ void   gimp_gegl_dodgeburn          (GeglBuffer          *src_buffer,
                                      GimpDodgeBurnType    type,
                                      GimpTransferMode     mode);
 
+/*  if copy_buffer is not NULL, the result is written to it as well  */
 void   gimp_gegl_smudge_blend       (GeglBuffer          *top_buffer,
                                      const GeglRectangle *top_rect,
                                      GeglBuffer          *bottom_buffer,
                                      const GeglRectangle *bottom_rect,
                                      GeglBuffer          *dest_buffer,
                                      const GeglRectangle *dest_rect,
+                                     GeglBuffer          *copy_buffer,
+                                     const GeglRectangle *copy_rect,
                                      guchar               blend);
 
 void   gimp_gegl_apply_mask         (GeglBuffer          *mask_buffer,
@@ -81,5 +89,35 @@ void   gimp_gegl_replace            (GeglBuffer          *top_buffer,
                                      gdouble              opacity,
                                      const gboolean      *affect);
 
+void   gimp_gegl_gaussian_blur      (GeglBuffer          *buffer,
+                                     const GeglRectangle *rect,
+                                     gdouble              std_dev_x,
+                                     gdouble              std_dev_y);
+
+
+/*  the row loops behind the above, for testing  */
+
+void   gimp_gegl_convolve_row_scalar      (gdouble       *accum,
+                                           const gdouble *src,
+                                           gdouble        weight,
+                                           gint           n);
+void   gimp_gegl_smudge_blend_loop_scalar (const guchar  *top,
+                                           const guchar  *bottom,
+                                           guchar        *dest,
+                                           gint           n_pixels,
+                                           guchar         blend);
+
+#ifdef GIMP_GEGL_LOOPS_SSE2
+void   gimp_gegl_convolve_row_sse2        (gdouble       *accum,
+                                           const gdouble *src,
+                                           gdouble        weight,
+                                           gint           n);
+void   gimp_gegl_smudge_blend_loop_sse2   (const guchar  *top,
+                                           const guchar  *bottom,
+                                           guchar        *dest,
+                                           gint           n_pixels,
+                                           guchar         blend);
+#endif
+
 
 #endif /* __GIMP_GEGL_LOOPS_H__ */
@@ -20,18 +20,40 @@
 
 #include "config.h"
 
+#include <math.h>
+
 #include <gegl.h>
 
 #include "gimp-gegl-types.h"
 
+#include "base/tile.h"
 #include "base/tile-manager.h"
 
+#include "core/gimp-parallel.h"
 #include "core/gimpprogress.h"
 
 #include "gimp-gegl-utils.h"
 #include "gimptilebackendtilemanager.h"
 
 
+/*  the deepest mipmap level gimp_gegl_buffer_refetch_area() drops  */
+#define GIMP_GEGL_MAX_MIPMAP_LEVEL 8
+
+/*  gimp_gegl_buffer_convert() locks at most this many source and
+ *  destination tiles at a time
+ */
+#define GIMP_GEGL_CONVERT_BATCH    256
+
+
+typedef struct
+{
+  const Babl  *fish;
+  Tile       **src_tiles;
+  Tile       **dest_tiles;
+  gint         n_tiles;
+} ConvertBatch;
+
+
 const gchar *
 gimp_interpolation_to_gegl_filter (GimpInterpolationType interpolation)
 {
@@ -66,6 +88,55 @@ gimp_gegl_buffer_new (const GeglRectangle *rect,
   return buffer;
 }
 
+/* temp hack */
+GeglTileBackend * gegl_buffer_backend (GeglBuffer *buffer);
+
+/*  Whether @buffer covers all of its tile manager, so that buffer and
+ *  tile coordinates are the same
+ */
+static gboolean
+gimp_gegl_buffer_can_share_tiles (GeglBuffer *buffer)
+{
+  TileManager         *tiles  = gimp_gegl_buffer_peek_tiles (buffer);
+  const GeglRectangle *extent = gegl_buffer_get_extent (buffer);
+
+  return (tiles                                         &&
+          extent->x      == 0                           &&
+          extent->y      == 0                           &&
+          extent->width  == tile_manager_width  (tiles) &&
+          extent->height == tile_manager_height (tiles));
+}
+
+/*  Makes a buffer whose tiles are shared with @buffer's tile manager
+ *  until either of them is written to.
+ */
+static GeglBuffer *
+gimp_gegl_buffer_dup_shared (GeglBuffer          *buffer,
+                             const GeglRectangle *rect)
+{
+  TileManager *tiles;
+  TileManager *dup_tiles;
+  GeglBuffer  *dup;
+
+  /*  flushes pending writes into the tiles  */
+  tiles = gimp_gegl_buffer_get_tiles (buffer);
+
+  /*  GEGL may hold on to the tiles' memory directly, which keeps
+   *  them locked for writing, drop that so they can be shared
+   */
+  gimp_gegl_buffer_refetch_tiles (buffer);
+
+  dup_tiles = tile_manager_duplicate_area (tiles,
+                                           rect->x, rect->y,
+                                           rect->width, rect->height);
+
+  dup = gimp_tile_manager_create_buffer (dup_tiles,
+                                         gegl_buffer_get_format (buffer));
+  tile_manager_unref (dup_tiles);
+
+  return dup;
+}
+
 GeglBuffer *
 gimp_gegl_buffer_dup (GeglBuffer *buffer)
 {
@@ -73,6 +144,10 @@ gimp_gegl_buffer_dup (GeglBuffer *buffer)
   TileManager *tiles;
   GeglBuffer  *dup;
 
+  if (gimp_gegl_buffer_can_share_tiles (buffer))
+    return gimp_gegl_buffer_dup_shared (buffer,
+                                        gegl_buffer_get_extent (buffer));
+
   tiles = tile_manager_new (gegl_buffer_get_width (buffer),
                             gegl_buffer_get_height (buffer),
                             babl_format_get_bytes_per_pixel (format));
@@ -85,6 +160,39 @@ gimp_gegl_buffer_dup (GeglBuffer *buffer)
   return dup;
 }
 
+/**
+ * gimp_gegl_buffer_dup_area:
+ * @buffer: a #GeglBuffer
+ * @rect:   the area of @buffer to copy
+ *
+ * Copies @rect of @buffer into a new buffer of the same size, at
+ * 0, 0.  If @buffer is backed by a tile manager, the tiles are shared
+ * copy-on-write wherever the tile grids line up, so the copy only
+ * costs memory for tiles that are modified later.
+ *
+ * Return value: the new buffer.
+ **/
+GeglBuffer *
+gimp_gegl_buffer_dup_area (GeglBuffer          *buffer,
+                           const GeglRectangle *rect)
+{
+  GeglBuffer *dup;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (rect != NULL, NULL);
+
+  if (gimp_gegl_buffer_can_share_tiles (buffer) &&
+      gegl_rectangle_contains (gegl_buffer_get_extent (buffer), rect))
+    return gimp_gegl_buffer_dup_shared (buffer, rect);
+
+  dup = gimp_gegl_buffer_new (GEGL_RECTANGLE (0, 0, rect->width, rect->height),
+                              gegl_buffer_get_format (buffer));
+
+  gegl_buffer_copy (buffer, rect, dup, GEGL_RECTANGLE (0, 0, 0, 0));
+
+  return dup;
+}
+
 GeglBuffer *
 gimp_tile_manager_create_buffer (TileManager *tm,
                                  const Babl  *format)
@@ -99,9 +207,6 @@ gimp_tile_manager_create_buffer (TileManager *tm,
   return buffer;
 }
 
-/* temp hack */
-GeglTileBackend * gegl_buffer_backend (GeglBuffer *buffer);
-
 TileManager *
 gimp_gegl_buffer_get_tiles (GeglBuffer *buffer)
 {
@@ -118,6 +223,30 @@ gimp_gegl_buffer_get_tiles (GeglBuffer *buffer)
   return gimp_tile_backend_tile_manager_get_tiles (backend);
 }
 
+/**
+ * gimp_gegl_buffer_peek_tiles:
+ * @buffer: a #GeglBuffer
+ *
+ * Like gimp_gegl_buffer_get_tiles(), but returns %NULL for buffers
+ * that are not backed by a tile manager, and does not flush @buffer.
+ *
+ * Return value: @buffer's tile manager, or %NULL.
+ **/
+TileManager *
+gimp_gegl_buffer_peek_tiles (GeglBuffer *buffer)
+{
+  GeglTileBackend *backend;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+
+  backend = gegl_buffer_backend (buffer);
+
+  if (! GIMP_IS_TILE_BACKEND_TILE_MANAGER (backend))
+    return NULL;
+
+  return gimp_tile_backend_tile_manager_get_tiles (backend);
+}
+
 void
 gimp_gegl_buffer_refetch_tiles (GeglBuffer *buffer)
 {
@@ -126,6 +255,156 @@ gimp_gegl_buffer_refetch_tiles (GeglBuffer *buffer)
   gegl_tile_source_reinit (GEGL_TILE_SOURCE (buffer));
 }
 
+/*  like gimp_gegl_buffer_refetch_tiles(), but only drops the tiles
+ *  that intersect @rect, on all mipmap levels, so the rest of what
+ *  GEGL caches for @buffer stays valid. Pending writes are flushed
+ *  first.
+ */
+void
+gimp_gegl_buffer_refetch_area (GeglBuffer          *buffer,
+                               const GeglRectangle *rect)
+{
+  GeglTileSource *source;
+  gint            tile_width;
+  gint            tile_height;
+  gint            shift_x;
+  gint            shift_y;
+  gint            x1, y1;
+  gint            x2, y2;
+  gint            z;
+
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (rect != NULL);
+
+  if (rect->width < 1 || rect->height < 1)
+    return;
+
+  g_object_get (buffer,
+                "tile-width",  &tile_width,
+                "tile-height", &tile_height,
+                "shift-x",     &shift_x,
+                "shift-y",     &shift_y,
+                NULL);
+
+  gegl_buffer_flush (buffer);
+
+  source = GEGL_TILE_SOURCE (buffer);
+
+  x1 = floor ((gdouble) (rect->x + shift_x) / tile_width);
+  y1 = floor ((gdouble) (rect->y + shift_y) / tile_height);
+  x2 = floor ((gdouble) (rect->x + shift_x + rect->width  - 1) / tile_width);
+  y2 = floor ((gdouble) (rect->y + shift_y + rect->height - 1) / tile_height);
+
+  for (z = 0; z <= GIMP_GEGL_MAX_MIPMAP_LEVEL; z++)
+    {
+      gint x, y;
+
+      for (y = y1 >> z; y <= y2 >> z; y++)
+        for (x = x1 >> z; x <= x2 >> z; x++)
+          gegl_tile_source_command (source, GEGL_TILE_VOID, x, y, z, NULL);
+    }
+}
+
+static void
+gimp_gegl_buffer_convert_tile (gint          i,
+                               gint          n,
+                               ConvertBatch *batch)
+{
+  Tile *src  = batch->src_tiles[i];
+  Tile *dest = batch->dest_tiles[i];
+
+  babl_process (batch->fish,
+                tile_data_pointer (src, 0, 0),
+                tile_data_pointer (dest, 0, 0),
+                tile_ewidth (src) * tile_eheight (src));
+}
+
+/**
+ * gimp_gegl_buffer_convert:
+ * @src_buffer:  a #GeglBuffer
+ * @dest_buffer: a #GeglBuffer of the same size, in the target format
+ *
+ * Copies all of @src_buffer to @dest_buffer, like gegl_buffer_copy()
+ * with both rectangles %NULL. If both buffers are backed by tile
+ * managers, the tiles are converted with babl directly, and in
+ * parallel: the tiles are fetched and locked in batches on the
+ * calling thread, because tile access is not thread-safe, and only
+ * the pixel conversion is spread over the core's worker pool.
+ **/
+void
+gimp_gegl_buffer_convert (GeglBuffer *src_buffer,
+                          GeglBuffer *dest_buffer)
+{
+  TileManager  *src_tiles;
+  TileManager  *dest_tiles;
+  ConvertBatch  batch;
+  gint          n_cols, n_rows;
+  gint          n;
+
+  g_return_if_fail (GEGL_IS_BUFFER (src_buffer));
+  g_return_if_fail (GEGL_IS_BUFFER (dest_buffer));
+
+  if (! gimp_gegl_buffer_can_share_tiles (src_buffer) ||
+      ! gimp_gegl_buffer_can_share_tiles (dest_buffer))
+    {
+      gegl_buffer_copy (src_buffer, NULL, dest_buffer, NULL);
+      return;
+    }
+
+  /*  flushes pending writes into the tiles  */
+  src_tiles  = gimp_gegl_buffer_get_tiles (src_buffer);
+  dest_tiles = gimp_gegl_buffer_get_tiles (dest_buffer);
+
+  if (tile_manager_width  (src_tiles) != tile_manager_width  (dest_tiles) ||
+      tile_manager_height (src_tiles) != tile_manager_height (dest_tiles))
+    {
+      gegl_buffer_copy (src_buffer, NULL, dest_buffer, NULL);
+      return;
+    }
+
+  n_cols = (tile_manager_width  (src_tiles) + TILE_WIDTH  - 1) / TILE_WIDTH;
+  n_rows = (tile_manager_height (src_tiles) + TILE_HEIGHT - 1) / TILE_HEIGHT;
+
+  batch.fish       = babl_fish (gegl_buffer_get_format (src_buffer),
+                                gegl_buffer_get_format (dest_buffer));
+  batch.src_tiles  = g_new (Tile *, GIMP_GEGL_CONVERT_BATCH);
+  batch.dest_tiles = g_new (Tile *, GIMP_GEGL_CONVERT_BATCH);
+
+  for (n = 0; n < n_cols * n_rows; n += batch.n_tiles)
+    {
+      gint i;
+
+      batch.n_tiles = MIN (GIMP_GEGL_CONVERT_BATCH, n_cols * n_rows - n);
+
+      for (i = 0; i < batch.n_tiles; i++)
+        {
+          gint col = (n + i) % n_cols;
+          gint row = (n + i) / n_cols;
+
+          batch.src_tiles[i]  = tile_manager_get_at (src_tiles, col, row,
+                                                     TRUE, FALSE);
+          batch.dest_tiles[i] = tile_manager_get_at (dest_tiles, col, row,
+                                                     TRUE, TRUE);
+        }
+
+      gimp_parallel_distribute (batch.n_tiles,
+                                (GimpParallelDistributeFunc) gimp_gegl_buffer_convert_tile,
+                                &batch);
+
+      for (i = 0; i < batch.n_tiles; i++)
+        {
+          tile_release (batch.src_tiles[i],  FALSE);
+          tile_release (batch.dest_tiles[i], TRUE);
+        }
+    }
+
+  g_free (batch.src_tiles);
+  g_free (batch.dest_tiles);
+
+  /*  GEGL may have cached the old contents of @dest_buffer  */
+  gimp_gegl_buffer_refetch_tiles (dest_buffer);
+}
+
 GeglColor *
 gimp_gegl_color_new (const GimpRGB *rgb)
 {
@@ -27,11 +27,19 @@ const gchar * gimp_interpolation_to_gegl_filter  (GimpInterpolationType  interpo
 GeglBuffer  * gimp_gegl_buffer_new               (const GeglRectangle   *rect,
                                                   const Babl            *format);
 GeglBuffer  * gimp_gegl_buffer_dup               (GeglBuffer            *buffer);
+GeglBuffer  * gimp_gegl_buffer_dup_area          (GeglBuffer            *buffer,
+                                                  const GeglRectangle   *rect);
 
 GeglBuffer  * gimp_tile_manager_create_buffer    (TileManager           *tm,
                                                   const Babl            *format);
 TileManager * gimp_gegl_buffer_get_tiles         (GeglBuffer            *buffer);
+TileManager * gimp_gegl_buffer_peek_tiles        (GeglBuffer            *buffer);
 void          gimp_gegl_buffer_refetch_tiles     (GeglBuffer            *buffer);
+void          gimp_gegl_buffer_refetch_area      (GeglBuffer            *buffer,
+                                                  const GeglRectangle   *rect);
+
+void          gimp_gegl_buffer_convert           (GeglBuffer            *src_buffer,
+                                                  GeglBuffer            *dest_buffer);
 
 GeglColor   * gimp_gegl_color_new                (const GimpRGB         *rgb);
 
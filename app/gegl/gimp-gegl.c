@@ -34,10 +34,7 @@
 
 #include "gimp-babl.h"
 #include "gimp-gegl.h"
-
-
-static void  gimp_gegl_notify_tile_cache_size (GimpGeglConfig *config);
-static void  gimp_gegl_notify_num_processors  (GimpGeglConfig *config);
+#include "gimp-gegl-cache.h"
 
 
 void
@@ -49,23 +46,19 @@ gimp_gegl_init (Gimp *gimp)
 
   config = GIMP_GEGL_CONFIG (gimp->config);
 
-#ifdef __GNUC__
-#warning limiting tile cache size to G_MAXINT
-#endif
-
-#ifdef __GNUC__
-#warning not setting GeglConfig:threads
-#endif
-
+  /*  GEGL stays single-threaded, the tile managers behind
+   *  GimpTileBackendTileManager are not safe for it, see there.  The
+   *  core runs its own work on several threads through gimp-parallel
+   */
   g_object_set (gegl_config (),
                 "tile-width",  TILE_WIDTH,
                 "tile-height", TILE_HEIGHT,
-                "cache-size",  (gint) MIN (config->tile_cache_size, G_MAXINT),
-#if 0
-                "threads",     config->num_processors,
-#endif
+                "threads",     1,
                 NULL);
 
+  /*  sets "cache-size", and keeps it up to date  */
+  gimp_gegl_cache_init (config);
+
   /* turn down the precision of babl - permitting use of lookup tables for
    * gamma conversions, this precision is anyways high enough for both 8bit
    * and 16bit operation
@@ -74,32 +67,8 @@ gimp_gegl_init (Gimp *gimp)
                 "babl-tolerance", 0.00015,
                 NULL);
 
-  g_signal_connect (config, "notify::tile-cache-size",
-                    G_CALLBACK (gimp_gegl_notify_tile_cache_size),
-                    NULL);
-  g_signal_connect (config, "notify::num-processors",
-                    G_CALLBACK (gimp_gegl_notify_num_processors),
-                    NULL);
-
   gimp_babl_init ();
 
   gimp_operations_init (gimp);
 }
 
-static void
-gimp_gegl_notify_tile_cache_size (GimpGeglConfig *config)
-{
-  g_object_set (gegl_config (),
-                "cache-size", (gint) MIN (config->tile_cache_size, G_MAXINT),
-                NULL);
-}
-
-static void
-gimp_gegl_notify_num_processors (GimpGeglConfig *config)
-{
-#if 0
-  g_object_set (gegl_config (),
-                "threads", config->num_processors,
-                NULL);
-#endif
-}
@@ -46,9 +46,47 @@ struct _GimpTileBackendTileManagerPrivate
   int          mul;
 };
 
+
+/*  TileManager, Tile and the tile cache are not thread-safe, so when
+ *  GEGL is used from multiple threads, all access to them from the
+ *  tile backend is serialized. The multi-tile code paths also swap
+ *  out the shared TileManager's validate_proc while they run.
+ *
+ *  Validate procs like the projection's render their tiles through
+ *  GEGL, into this very backend, so the lock is not held while they
+ *  run, see gimp_tile_lock_at().
+ *
+ *  This only serializes the backend against itself. Code that uses a
+ *  TileManager directly, and the validate procs, don't take the lock,
+ *  and GEGL writes to the tiles it uses directly without it. So GEGL
+ *  itself runs on a single thread, see gimp_gegl_init(), and the core
+ *  only processes a buffer on several threads while nothing else
+ *  touches its tile manager.
+ */
+#ifdef ENABLE_MP
+
+static GMutex      backend_mutex;
+static GCond       backend_cond;
+static GHashTable *backend_validating = NULL; /*  TileManager -> GThread  */
+
+#define BACKEND_LOCK    g_mutex_lock (&backend_mutex)
+#define BACKEND_UNLOCK  g_mutex_unlock (&backend_mutex)
+
+#else
+
+#define BACKEND_LOCK    /* nothing */
+#define BACKEND_UNLOCK  /* nothing */
+
+#endif
+
+/*  By default each GEGL tile is one TileManager tile, so GEGL can use
+ *  the tile's data directly instead of a copy. GIMP_GEGL_TILE_MUL
+ *  batches mul x mul TileManager tiles into each GEGL tile instead,
+ *  which means fewer tile commands but a copy of every tile.
+ */
 static int gimp_gegl_tile_mul (void)
 {
-  static int mul = 2;
+  static int mul = 1;
   static gboolean inited = 0;
   if (G_LIKELY (inited))
     return mul;
@@ -78,6 +116,11 @@ static GeglTile * gimp_tile_read (GimpTileBackendTileManager *backend_tm,
                                   gint                        x,
                                   gint                        y);
 
+static Tile     * gimp_tile_lock_at (GimpTileBackendTileManager *backend_tm,
+                                     gint                        x,
+                                     gint                        y,
+                                     gboolean                    wantwrite);
+
 
 static void       gimp_tile_write_mul (GimpTileBackendTileManager *backend_tm,
                                        gint                        x,
@@ -140,7 +183,9 @@ gimp_tile_backend_tile_manager_finalize (GObject *object)
 static void
 tile_done_writing (void *data)
 {
+  BACKEND_LOCK;
   tile_release (data, TRUE);
+  BACKEND_UNLOCK;
 }
 
 static gpointer
@@ -152,20 +197,28 @@ gimp_tile_backend_tile_manager_command (GeglTileSource  *tile_store,
                                         gpointer         data)
 {
   GimpTileBackendTileManager *backend_tm;
+  GeglTile                   *tile;
 
   backend_tm = GIMP_TILE_BACKEND_TILE_MANAGER (tile_store);
 
   switch (command)
     {
     case GEGL_TILE_GET:
+      BACKEND_LOCK;
       if (backend_tm->priv->mul > 1)
-        return gimp_tile_read_mul (backend_tm, x, y);
-      return gimp_tile_read (backend_tm, x, y);
+        tile = gimp_tile_read_mul (backend_tm, x, y);
+      else
+        tile = gimp_tile_read (backend_tm, x, y);
+      BACKEND_UNLOCK;
+      return tile;
+
     case GEGL_TILE_SET:
+      BACKEND_LOCK;
       if (backend_tm->priv->mul > 1)
         gimp_tile_write_mul (backend_tm, x, y, gegl_tile_get_data (data));
       else
         gimp_tile_write (backend_tm, x, y, gegl_tile_get_data (data));
+      BACKEND_UNLOCK;
 
       gegl_tile_mark_as_stored (data);
       return NULL;
@@ -182,6 +235,78 @@ gimp_tile_backend_tile_manager_command (GeglTileSource  *tile_store,
   return NULL;
 }
 
+/*  locks the tile at @x, @y, called with the backend lock held.  If
+ *  the tile needs to be validated by a proc which may use GEGL (one
+ *  that doesn't own its user data), the lock is dropped while the proc
+ *  runs, so its own GEGL access to the tile manager doesn't deadlock.
+ *  Meanwhile, other threads wait for the whole tile manager, since the
+ *  proc also touches neighbouring tiles without the lock.
+ */
+static Tile *
+gimp_tile_lock_at (GimpTileBackendTileManager *backend_tm,
+                   gint                        x,
+                   gint                        y,
+                   gboolean                    wantwrite)
+{
+  TileManager *tm = backend_tm->priv->tile_manager;
+
+#ifdef ENABLE_MP
+  if (! backend_validating)
+    backend_validating = g_hash_table_new (NULL, NULL);
+
+  while (TRUE)
+    {
+      GThread *owner = g_hash_table_lookup (backend_validating, tm);
+      Tile    *tile;
+
+      if (owner && owner != g_thread_self ())
+        {
+          g_cond_wait (&backend_cond, &backend_mutex);
+          continue;
+        }
+
+      /*  get the tile without any access, so it isn't validated  */
+      tile = tile_manager_get_at (tm, x, y, FALSE, FALSE);
+
+      if (! tile || tile_is_valid (tile) ||
+          ! tm->validate_proc || tm->user_data_destroy)
+        break;
+
+      /*  validations may nest, the outermost one owns the manager  */
+      if (! owner)
+        g_hash_table_insert (backend_validating, tm, g_thread_self ());
+
+      BACKEND_UNLOCK;
+      tile = tile_manager_get_at (tm, x, y, TRUE, TRUE);
+      BACKEND_LOCK;
+
+      tile_release (tile, TRUE);
+
+      if (! owner)
+        {
+          g_hash_table_remove (backend_validating, tm);
+          g_cond_broadcast (&backend_cond);
+        }
+    }
+#endif
+
+  return tile_manager_get_at (tm, x, y, TRUE, wantwrite);
+}
+
+/*  only whole tiles have the layout of a GEGL tile, the tiles on the
+ *  right and bottom edge may be smaller
+ */
+static gboolean
+gimp_tile_can_alias (GimpTileBackendTileManager *backend_tm,
+                     gint                        x,
+                     gint                        y)
+{
+  TileManager *tm = backend_tm->priv->tile_manager;
+
+  return ((x + 1) * TILE_WIDTH  <= tile_manager_width  (tm) &&
+          (y + 1) * TILE_HEIGHT <= tile_manager_height (tm));
+}
+
 static GeglTile *
 gimp_tile_read (GimpTileBackendTileManager *backend_tm,
                 gint                        x,
@@ -196,27 +321,36 @@ gimp_tile_read (GimpTileBackendTileManager *backend_tm,
   int       row;
 
   backend    = GEGL_TILE_BACKEND (backend_tm);
-  gimp_tile = tile_manager_get_at (backend_tm->priv->tile_manager,
-                                   x, y, TRUE, TRUE);
+  tile_size  = gegl_tile_backend_get_tile_size (backend);
+
+  gimp_tile = gimp_tile_lock_at (backend_tm, x, y, FALSE);
   if (!gimp_tile)
     return NULL;
-  g_return_val_if_fail (gimp_tile != NULL, NULL);
-
-  tile_size        = gegl_tile_backend_get_tile_size (backend);
-  tile_stride      = TILE_WIDTH * tile_bpp (gimp_tile);
-  gimp_tile_stride = tile_ewidth (gimp_tile) * tile_bpp (gimp_tile);
 
-  if (tile_stride == gimp_tile_stride && 
-      TILE_HEIGHT == tile_eheight (gimp_tile))
+  if (gimp_tile_can_alias (backend_tm, x, y) && ! tile_is_shared (gimp_tile))
     {
-      /* use the GimpTile directly as GEGL tile */
+      /* use the GimpTile directly as GEGL tile. GEGL writes to it in
+       * place, so it is locked for writing until GEGL drops the tile,
+       * which marks it dirty and keeps tile_manager_duplicate() from
+       * sharing it meanwhile
+       */
+      tile_release (gimp_tile, FALSE);
+      gimp_tile = gimp_tile_lock_at (backend_tm, x, y, TRUE);
+
       tile = gegl_tile_new_bare ();
       gegl_tile_set_data_full (tile, tile_data_pointer (gimp_tile, 0, 0),
                                tile_size, tile_done_writing, gimp_tile);
     }
   else
     {
-      /* create a copy of the tile */
+      /* create a copy of edge tiles, which don't have the layout of a
+       * GEGL tile, and of shared tiles, so reading them doesn't copy
+       * them. Changes come back through GEGL_TILE_SET, which locks the
+       * tile for writing and so copies it first
+       */
+      tile_stride      = TILE_WIDTH * tile_bpp (gimp_tile);
+      gimp_tile_stride = tile_ewidth (gimp_tile) * tile_bpp (gimp_tile);
+
       tile = gegl_tile_new (tile_size);
       for (row = 0; row < tile_eheight (gimp_tile); row++)
         {
@@ -224,7 +358,7 @@ gimp_tile_read (GimpTileBackendTileManager *backend_tm,
                   tile_data_pointer (gimp_tile, 0, row),
                   gimp_tile_stride);
         }
-      tile_release (gimp_tile, TRUE);
+      tile_release (gimp_tile, FALSE);
     }
   return tile;
 }
@@ -240,8 +374,7 @@ gimp_tile_write (GimpTileBackendTileManager *backend_tm,
   gint  gimp_tile_stride;
   int   row;
 
-  gimp_tile = tile_manager_get_at (backend_tm->priv->tile_manager,
-                                   x, y, TRUE, TRUE);
+  gimp_tile = gimp_tile_lock_at (backend_tm, x, y, TRUE);
 
   if (!gimp_tile)
     return;
@@ -282,8 +415,10 @@ gimp_tile_read_mul (GimpTileBackendTileManager *backend_tm,
   x *= mul;
   y *= mul;
 
+  /*  validate procs that own their data don't use GEGL and can stay  */
   validate_proc = backend_tm->priv->tile_manager->validate_proc;
-  backend_tm->priv->tile_manager->validate_proc = NULL;
+  if (! backend_tm->priv->tile_manager->user_data_destroy)
+    backend_tm->priv->tile_manager->validate_proc = NULL;
 
   backend    = GEGL_TILE_BACKEND (backend_tm);
   tile_size  = gegl_tile_backend_get_tile_size (backend);
@@ -333,8 +468,10 @@ gimp_tile_write_mul (GimpTileBackendTileManager *backend_tm,
   x *= mul;
   y *= mul;
 
+  /*  validate procs that own their data don't use GEGL and can stay  */
   validate_proc = backend_tm->priv->tile_manager->validate_proc;
-  backend_tm->priv->tile_manager->validate_proc = NULL;
+  if (! backend_tm->priv->tile_manager->user_data_destroy)
+    backend_tm->priv->tile_manager->validate_proc = NULL;
 
   for (v = 0; v < mul; v++)
     for (u = 0; u < mul; u++)
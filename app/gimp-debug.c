@@ -31,6 +31,9 @@
 
 static GHashTable *class_hash = NULL;
 
+/*  data factories create objects from worker threads  */
+G_LOCK_DEFINE_STATIC (class_hash);
+
 
 void
 gimp_debug_enable_instances (void)
@@ -52,6 +55,8 @@ gimp_debug_add_instance (GObject      *instance,
       GHashTable  *instance_hash;
       const gchar *type_name;
 
+      G_LOCK (class_hash);
+
       type_name = g_type_name (G_TYPE_FROM_CLASS (klass));
 
       instance_hash = g_hash_table_lookup (class_hash, type_name);
@@ -64,6 +69,8 @@ gimp_debug_add_instance (GObject      *instance,
         }
 
       g_hash_table_insert (instance_hash, instance, instance);
+
+      G_UNLOCK (class_hash);
     }
 }
 
@@ -75,6 +82,8 @@ gimp_debug_remove_instance (GObject *instance)
       GHashTable  *instance_hash;
       const gchar *type_name;
 
+      G_LOCK (class_hash);
+
       type_name = g_type_name (G_OBJECT_TYPE (instance));
 
       instance_hash = g_hash_table_lookup (class_hash, type_name);
@@ -86,6 +95,8 @@ gimp_debug_remove_instance (GObject *instance)
           if (g_hash_table_size (instance_hash) == 0)
             g_hash_table_remove (class_hash, type_name);
         }
+
+      G_UNLOCK (class_hash);
     }
 }
 
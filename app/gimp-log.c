@@ -17,7 +17,12 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
 #include "glib-object.h"
+#include <glib/gstdio.h>
 
 #include "gimp-debug.h"
 #include "gimp-log.h"
@@ -43,11 +48,23 @@ static const GDebugKey log_keys[] =
   { "auto-tab-style",     GIMP_LOG_AUTO_TAB_STYLE     },
   { "instances",          GIMP_LOG_INSTANCES          },
   { "rectangle-tool",     GIMP_LOG_RECTANGLE_TOOL     },
-  { "brush-cache",        GIMP_LOG_BRUSH_CACHE        }
+  { "brush-cache",        GIMP_LOG_BRUSH_CACHE        },
+  { "pdb-stats",          GIMP_LOG_PDB_STATS          },
+  { "babl-stats",         GIMP_LOG_BABL_STATS         }
 };
 
 
-GimpLogFlags gimp_log_flags = 0;
+GimpLogFlags gimp_log_flags     = 0;
+gboolean     gimp_trace_enabled = FALSE;
+
+static FILE     *trace_file   = NULL;
+static gint64    trace_origin = 0;
+static gint      trace_n_tids = 0;
+static GMutex    trace_mutex;
+static GPrivate  trace_tid;
+
+
+static void   gimp_trace_init (const gchar *filename);
 
 
 void
@@ -76,6 +93,9 @@ gimp_log_init (void)
       if (gimp_log_flags & GIMP_LOG_INSTANCES)
         gimp_debug_enable_instances ();
     }
+
+  if (g_getenv ("GIMP_TRACE"))
+    gimp_trace_init (g_getenv ("GIMP_TRACE"));
 }
 
 void
@@ -120,3 +140,148 @@ gimp_logv (GimpLogFlags  flags,
 
   g_free (message);
 }
+
+
+/*  tracing  */
+
+static gint
+gimp_trace_get_tid (void)
+{
+  gint tid = GPOINTER_TO_INT (g_private_get (&trace_tid));
+
+  if (! tid)
+    {
+      tid = g_atomic_int_add (&trace_n_tids, 1) + 1;
+
+      g_private_set (&trace_tid, GINT_TO_POINTER (tid));
+    }
+
+  return tid;
+}
+
+static void
+gimp_trace_init (const gchar *filename)
+{
+  trace_file = g_fopen (filename, "w");
+
+  if (! trace_file)
+    {
+      g_printerr ("Could not open '%s' for writing the trace: %s\n",
+                  filename, g_strerror (errno));
+      return;
+    }
+
+  trace_origin       = g_get_monotonic_time ();
+  gimp_trace_enabled = TRUE;
+
+  /*  the JSON array format, a missing "]" at the end is allowed, so
+   *  the trace is usable even if GIMP doesn't exit cleanly
+   */
+  fprintf (trace_file,
+           "[\n"
+           "{\"name\": \"thread_name\", \"ph\": \"M\", "
+           "\"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"main\"}}",
+           gimp_trace_get_tid ());
+}
+
+void
+gimp_trace_exit (void)
+{
+  if (! trace_file)
+    return;
+
+  g_mutex_lock (&trace_mutex);
+
+  gimp_trace_enabled = FALSE;
+
+  fprintf (trace_file, "\n]\n");
+  fclose (trace_file);
+  trace_file = NULL;
+
+  g_mutex_unlock (&trace_mutex);
+}
+
+/*  name and detail are procedure names and file names, which need
+ *  escaping, the categories are fixed strings
+ */
+static gchar *
+gimp_trace_escape (const gchar *str)
+{
+  GString *escaped = g_string_sized_new (strlen (str) + 8);
+
+  for (; *str; str++)
+    {
+      switch (*str)
+        {
+        case '"':
+        case '\\':
+          g_string_append_c (escaped, '\\');
+          g_string_append_c (escaped, *str);
+          break;
+
+        default:
+          if ((guchar) *str < 0x20)
+            g_string_append_printf (escaped, "\\u%04x", (guchar) *str);
+          else
+            g_string_append_c (escaped, *str);
+          break;
+        }
+    }
+
+  return g_string_free (escaped, FALSE);
+}
+
+/**
+ * gimp_trace_span:
+ * @category: the span's category, such as "xcf"
+ * @name:     the span's name
+ * @start:    what GIMP_TRACE_START() returned when the span began
+ * @detail:   an optional string shown with the span, or %NULL
+ *
+ * Writes a complete event from @start to now on the calling thread.
+ * GIMP_TRACE_END() does this if tracing is enabled; callers that
+ * build the detail only for the trace check @start themselves.
+ **/
+void
+gimp_trace_span (const gchar *category,
+                 const gchar *name,
+                 gint64       start,
+                 const gchar *detail)
+{
+  gint64  end = g_get_monotonic_time ();
+  gint    tid = gimp_trace_get_tid ();
+  gchar  *escaped_name;
+  gchar  *escaped_detail = NULL;
+
+  g_return_if_fail (category != NULL);
+  g_return_if_fail (name != NULL);
+
+  escaped_name = gimp_trace_escape (name);
+
+  if (detail)
+    escaped_detail = gimp_trace_escape (detail);
+
+  g_mutex_lock (&trace_mutex);
+
+  if (trace_file)
+    {
+      fprintf (trace_file,
+               ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+               "\"ts\": %" G_GINT64_FORMAT ", \"dur\": %" G_GINT64_FORMAT ", "
+               "\"pid\": 1, \"tid\": %d",
+               escaped_name, category,
+               start - trace_origin, end - start,
+               tid);
+
+      if (escaped_detail)
+        fprintf (trace_file,
+                 ", \"args\": {\"detail\": \"%s\"}", escaped_detail);
+
+      fputc ('}', trace_file);
+    }
+
+  g_mutex_unlock (&trace_mutex);
+
+  g_free (escaped_name);
+  g_free (escaped_detail);
+}
@@ -39,11 +39,14 @@ typedef enum
   GIMP_LOG_AUTO_TAB_STYLE     = 1 << 15,
   GIMP_LOG_INSTANCES          = 1 << 16,
   GIMP_LOG_RECTANGLE_TOOL     = 1 << 17,
-  GIMP_LOG_BRUSH_CACHE        = 1 << 18
+  GIMP_LOG_BRUSH_CACHE        = 1 << 18,
+  GIMP_LOG_PDB_STATS          = 1 << 19,
+  GIMP_LOG_BABL_STATS         = 1 << 20
 } GimpLogFlags;
 
 
 extern GimpLogFlags gimp_log_flags;
+extern gboolean     gimp_trace_enabled;
 
 
 void   gimp_log_init (void);
@@ -58,6 +61,32 @@ void   gimp_logv     (GimpLogFlags  flags,
                       const gchar  *format,
                       va_list       args);
 
+void   gimp_trace_exit (void);
+void   gimp_trace_span (const gchar  *category,
+                        const gchar  *name,
+                        gint64        start,
+                        const gchar  *detail);
+
+
+/*  Timed spans in Chrome trace-event JSON, written to the file named
+ *  by GIMP_TRACE:
+ *
+ *    gint64 start = GIMP_TRACE_START ();
+ *    ...
+ *    GIMP_TRACE_END (start, "xcf", "load", filename);
+ *
+ *  start is 0 unless tracing is enabled, so a disabled trace costs a
+ *  single test.
+ */
+#define GIMP_TRACE_START() \
+        (G_UNLIKELY (gimp_trace_enabled) ? g_get_monotonic_time () : 0)
+
+#define GIMP_TRACE_END(start, category, name, detail) \
+        G_STMT_START { \
+        if (G_UNLIKELY (start)) \
+          gimp_trace_span ((category), (name), (start), (detail)); \
+        } G_STMT_END
+
 
 #ifdef G_HAVE_ISO_VARARGS
 
@@ -115,6 +115,7 @@ static const gchar        *user_gimprc       = NULL;
 static const gchar        *session_name      = NULL;
 static const gchar        *batch_interpreter = NULL;
 static const gchar       **batch_commands    = NULL;
+static const gchar        *batch_server      = NULL;
 static const gchar       **filenames         = NULL;
 static gboolean            as_new            = FALSE;
 static gboolean            no_interface      = FALSE;
@@ -222,6 +223,12 @@ static const GOptionEntry main_entries[] =
     G_OPTION_ARG_STRING, &batch_interpreter,
     N_("The procedure to process batch commands with"), "<proc>"
   },
+  {
+    "batch-server", 0, 0,
+    G_OPTION_ARG_STRING, &batch_server,
+    N_("Keep running and process batch jobs from stdin (-) "
+       "or a local TCP port"), "<source>"
+  },
   {
     "console-messages", 'c', 0,
     G_OPTION_ARG_NONE, &console_messages,
@@ -410,7 +417,8 @@ main (int    argc,
       app_exit (EXIT_FAILURE);
     }
 
-  if (no_interface || be_verbose || console_messages || batch_commands != NULL)
+  if (no_interface || be_verbose || console_messages ||
+      batch_commands != NULL || batch_server != NULL)
     gimp_open_console_window ();
 
   if (no_interface)
@@ -442,6 +450,7 @@ main (int    argc,
            session_name,
            batch_interpreter,
            batch_commands,
+           batch_server,
            as_new,
            no_interface,
            no_data,
@@ -33,6 +33,7 @@
 #include "gimpoperationequalize.h"
 #include "gimpoperationgrow.h"
 #include "gimpoperationhistogramsink.h"
+#include "gimpoperationlayerstack.h"
 #include "gimpoperationmaskcomponents.h"
 #include "gimpoperationsemiflatten.h"
 #include "gimpoperationsetalpha.h"
@@ -90,6 +91,7 @@ gimp_operations_init (Gimp *gimp)
   g_type_class_ref (GIMP_TYPE_OPERATION_EQUALIZE);
   g_type_class_ref (GIMP_TYPE_OPERATION_GROW);
   g_type_class_ref (GIMP_TYPE_OPERATION_HISTOGRAM_SINK);
+  g_type_class_ref (GIMP_TYPE_OPERATION_LAYER_STACK);
   g_type_class_ref (GIMP_TYPE_OPERATION_MASK_COMPONENTS);
   g_type_class_ref (GIMP_TYPE_OPERATION_SEMI_FLATTEN);
   g_type_class_ref (GIMP_TYPE_OPERATION_SET_ALPHA);
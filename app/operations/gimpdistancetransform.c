@@ -0,0 +1,312 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpdistancetransform.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  The separable exact Euclidean distance transform of Felzenszwalb
+ *  and Huttenlocher, "Distance Transforms of Sampled Functions": a
+ *  vertical pass finds the nearest feature in each column, a
+ *  horizontal pass takes the lower envelope of the parabolas these
+ *  distances define. Both are linear in the number of pixels, so
+ *  the cost doesn't depend on the radius.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "operations-types.h"
+
+#include "gimpdistancetransform.h"
+
+
+/*  where the parabolas of columns p < q, scaled by a, intersect  */
+static inline gdouble
+intersect (gdouble a,
+           gint    p,
+           gdouble fp,
+           gint    q,
+           gdouble fq)
+{
+  return ((fq + a * q * q) - (fp + a * p * p)) / (2.0 * a * (q - p));
+}
+
+
+void
+gimp_distance_transform_rows (const guchar *src,
+                              gint          width,
+                              gint          src_rows,
+                              gint          first_row,
+                              gint          n_rows,
+                              guchar        threshold,
+                              gboolean      features_above,
+                              gboolean      features_below,
+                              gboolean      features_beside,
+                              gint          radius_x,
+                              gint          radius_y,
+                              gfloat       *dist)
+{
+  /*  columns farther away than this can't reach distance 1.0  */
+  const guint16  limit = radius_y + 1;
+  const gdouble  ax    = 1.0 / ((radius_x + 0.5) * (radius_x + 0.5));
+  const gdouble  ay    = 1.0 / ((radius_y + 0.5) * (radius_y + 0.5));
+  guint16       *column;
+  guint16       *d;
+  gint          *v;
+  gdouble       *f;
+  gdouble       *z;
+  gint           x, y;
+
+  column = g_new (guint16, width * n_rows);
+  d      = g_new (guint16, width);
+  v      = g_new (gint,    width + 2);
+  f      = g_new (gdouble, width + 2);
+  z      = g_new (gdouble, width + 3);
+
+  /*  vertical distances, downwards then upwards  */
+  for (x = 0; x < width; x++)
+    d[x] = features_above ? 0 : limit;
+
+  for (y = 0; y < first_row + n_rows; y++)
+    {
+      const guchar *s = src + y * width;
+
+      for (x = 0; x < width; x++)
+        d[x] = s[x] >= threshold ? 0 : MIN (d[x] + 1, limit);
+
+      if (y >= first_row)
+        memcpy (column + (y - first_row) * width, d, width * sizeof (guint16));
+    }
+
+  for (x = 0; x < width; x++)
+    d[x] = features_below ? 0 : limit;
+
+  for (y = src_rows - 1; y >= first_row; y--)
+    {
+      const guchar *s = src + y * width;
+
+      for (x = 0; x < width; x++)
+        d[x] = s[x] >= threshold ? 0 : MIN (d[x] + 1, limit);
+
+      if (y < first_row + n_rows)
+        {
+          guint16 *c = column + (y - first_row) * width;
+
+          for (x = 0; x < width; x++)
+            c[x] = MIN (c[x], d[x]);
+        }
+    }
+
+  /*  horizontally, the lower envelope of ax * (x - i)^2 + f(i)  */
+  for (y = 0; y < n_rows; y++)
+    {
+      const guint16 *c    = column + y * width;
+      gfloat        *out  = dist   + y * width;
+      gint           k    = -1;
+      gint           i;
+
+      for (i = (features_beside ? -1 : 0);
+           i < (features_beside ? width + 1 : width);
+           i++)
+        {
+          gdouble fi;
+          gdouble s;
+
+          if (i < 0 || i >= width)
+            fi = 0.0;
+          else if (c[i] < limit)
+            fi = ay * c[i] * c[i];
+          else
+            continue;
+
+          if (k < 0)
+            {
+              k    = 0;
+              v[0] = i;
+              f[0] = fi;
+              z[0] = -G_MAXDOUBLE;
+              z[1] =  G_MAXDOUBLE;
+              continue;
+            }
+
+          /*  z[0] is -G_MAXDOUBLE, so this stops at k == 0  */
+          s = intersect (ax, v[k], f[k], i, fi);
+
+          while (s <= z[k])
+            {
+              k--;
+              s = intersect (ax, v[k], f[k], i, fi);
+            }
+
+          k++;
+          v[k]     = i;
+          f[k]     = fi;
+          z[k]     = s;
+          z[k + 1] = G_MAXDOUBLE;
+        }
+
+      if (k < 0)
+        {
+          for (x = 0; x < width; x++)
+            out[x] = G_MAXFLOAT;
+
+          continue;
+        }
+
+      k = 0;
+
+      for (x = 0; x < width; x++)
+        {
+          while (z[k + 1] < x)
+            k++;
+
+          out[x] = ax * (x - v[k]) * (x - v[k]) + f[k];
+        }
+    }
+
+  g_free (column);
+  g_free (d);
+  g_free (v);
+  g_free (f);
+  g_free (z);
+}
+
+gboolean
+gimp_distance_transform_dilate (GeglBuffer          *input,
+                                GeglBuffer          *output,
+                                const GeglRectangle *roi,
+                                gint                 radius_x,
+                                gint                 radius_y,
+                                gboolean             invert,
+                                gboolean             outside_set)
+{
+  const Babl         *format = babl_format ("Y u8");
+  GeglBufferIterator *iter;
+  gint                histogram[256] = { 0, };
+  guchar              levels[GIMP_DISTANCE_TRANSFORM_MAX_LEVELS];
+  gint                n_levels = 0;
+  guchar             *window;
+  guchar             *dest;
+  gfloat             *dist;
+  gint                strip_rows;
+  gint                i, y;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (input), FALSE);
+  g_return_val_if_fail (GEGL_IS_BUFFER (output), FALSE);
+  g_return_val_if_fail (roi != NULL, FALSE);
+
+  if (roi->width < 1 || roi->height < 1)
+    return TRUE;
+
+  iter = gegl_buffer_iterator_new (input, roi, 0, format,
+                                   GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const guchar *data = iter->data[0];
+      gint          n    = iter->length;
+
+      while (n--)
+        histogram[*data++]++;
+    }
+
+  if (outside_set)
+    histogram[invert ? 0 : 255]++;
+
+  /*  the values to dilate, brightest first  */
+  for (i = 255; i > 0; i--)
+    {
+      if (histogram[invert ? 255 - i : i])
+        {
+          if (n_levels == GIMP_DISTANCE_TRANSFORM_MAX_LEVELS)
+            return FALSE;
+
+          levels[n_levels++] = i;
+        }
+    }
+
+  /*  strips are read with the radius_y + 1 rows above and below them
+   *  that can reach into them, keep that overhead small
+   */
+  strip_rows = MAX (64, 2 * (radius_y + 1));
+  strip_rows = MIN (strip_rows, roi->height);
+
+  window = g_new (guchar, roi->width * (strip_rows + 2 * (radius_y + 1)));
+  dest   = g_new (guchar, roi->width * strip_rows);
+  dist   = g_new (gfloat, roi->width * strip_rows);
+
+  for (y = 0; y < roi->height; y += strip_rows)
+    {
+      gint n_rows = MIN (strip_rows, roi->height - y);
+      gint top    = MAX (0, y - (radius_y + 1));
+      gint bottom = MIN (roi->height, y + n_rows + radius_y + 1);
+      gint n      = roi->width * n_rows;
+      gint l;
+
+      gegl_buffer_get (input,
+                       GEGL_RECTANGLE (roi->x, roi->y + top,
+                                       roi->width, bottom - top),
+                       1.0, format, window,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      if (invert)
+        {
+          for (i = 0; i < roi->width * (bottom - top); i++)
+            window[i] = 255 - window[i];
+        }
+
+      memset (dest, 0, n);
+
+      for (l = 0; l < n_levels; l++)
+        {
+          gimp_distance_transform_rows (window, roi->width, bottom - top,
+                                        y - top, n_rows,
+                                        levels[l],
+                                        outside_set && top    == 0,
+                                        outside_set && bottom == roi->height,
+                                        outside_set,
+                                        radius_x, radius_y,
+                                        dist);
+
+          for (i = 0; i < n; i++)
+            {
+              if (! dest[i] && dist[i] <= 1.0)
+                dest[i] = levels[l];
+            }
+        }
+
+      if (invert)
+        {
+          for (i = 0; i < n; i++)
+            dest[i] = 255 - dest[i];
+        }
+
+      gegl_buffer_set (output,
+                       GEGL_RECTANGLE (roi->x, roi->y + y,
+                                       roi->width, n_rows),
+                       0, format, dest,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (window);
+  g_free (dest);
+  g_free (dist);
+
+  return TRUE;
+}
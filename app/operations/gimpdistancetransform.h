@@ -0,0 +1,75 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpdistancetransform.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_DISTANCE_TRANSFORM_H__
+#define __GIMP_DISTANCE_TRANSFORM_H__
+
+
+/*  below this radius, the neighbourhood scans of grow, shrink and
+ *  border are faster than the distance transform
+ */
+#define GIMP_DISTANCE_TRANSFORM_MIN_RADIUS 8
+
+/*  the most distinct mask values gimp_distance_transform_dilate()
+ *  handles, it runs one distance transform per value
+ */
+#define GIMP_DISTANCE_TRANSFORM_MAX_LEVELS 4
+
+
+/*  Computes, for rows [first_row, first_row + n_rows) of the width x
+ *  src_rows pixels in src, the distance to the nearest pixel >=
+ *  threshold, scaled so that the ellipse with radii radius_x + 0.5 and
+ *  radius_y + 0.5 is at distance 1.0. Distances beyond 1.0 are only
+ *  exact up to radius_y + 1 rows, they are meant to be compared to 1.0.
+ *
+ *  The features_* flags tell whether the pixels just outside src count
+ *  as >= threshold.
+ */
+void       gimp_distance_transform_rows   (const guchar        *src,
+                                           gint                 width,
+                                           gint                 src_rows,
+                                           gint                 first_row,
+                                           gint                 n_rows,
+                                           guchar               threshold,
+                                           gboolean             features_above,
+                                           gboolean             features_below,
+                                           gboolean             features_beside,
+                                           gint                 radius_x,
+                                           gint                 radius_y,
+                                           gfloat              *dist);
+
+/*  Writes the maximum of input over an ellipse around each pixel of
+ *  roi to output, "Y u8". With invert, it is the minimum instead.
+ *  With outside_set, pixels outside roi count as 255 (0 with invert),
+ *  otherwise they are ignored.
+ *
+ *  Returns FALSE without touching output if input has more than
+ *  GIMP_DISTANCE_TRANSFORM_MAX_LEVELS distinct values besides 0 (255
+ *  with invert).
+ */
+gboolean   gimp_distance_transform_dilate (GeglBuffer          *input,
+                                           GeglBuffer          *output,
+                                           const GeglRectangle *roi,
+                                           gint                 radius_x,
+                                           gint                 radius_y,
+                                           gboolean             invert,
+                                           gboolean             outside_set);
+
+
+#endif /* __GIMP_DISTANCE_TRANSFORM_H__ */
@@ -29,6 +29,7 @@
 
 #include "operations-types.h"
 
+#include "gimpdistancetransform.h"
 #include "gimpoperationborder.h"
 
 
@@ -326,6 +327,100 @@ compute_transition (guchar    *transition,
     }
 }
 
+/* For large radii: marks the transitional pixels of strips of rows,
+   and a distance transform finds how far each pixel is from them. */
+static void
+gimp_operation_border_process_distance (GimpOperationBorder *self,
+                                        GeglBuffer          *input,
+                                        GeglBuffer          *output,
+                                        const GeglRectangle *roi)
+{
+  const Babl *format = babl_format ("Y u8");
+  guchar     *source;
+  guchar     *transition;
+  guchar     *out;
+  gfloat     *dist;
+  guchar     *above;
+  guchar     *below;
+  gint        strip_rows;
+  gint        i, y;
+
+  strip_rows = MAX (64, 2 * (self->radius_y + 1));
+  strip_rows = MIN (strip_rows, roi->height);
+
+  /*  the transitions of radius_y + 1 rows above and below a strip
+   *  reach into it, and finding those needs one more row each way
+   */
+  source     = g_new (guchar,
+                      roi->width * (strip_rows + 2 * (self->radius_y + 2)));
+  transition = g_new (guchar,
+                      roi->width * (strip_rows + 2 * (self->radius_y + 1)));
+  out        = g_new (guchar, roi->width * strip_rows);
+  dist       = g_new (gfloat, roi->width * strip_rows);
+
+  above = g_new (guchar, roi->width);
+  below = g_new (guchar, roi->width);
+
+  /*  the rows above and below the image, as in the radius 1 case  */
+  memset (above, self->edge_lock ? 255 : 0, roi->width);
+  memset (below, self->edge_lock ? 255 : 0, roi->width);
+
+  for (y = 0; y < roi->height; y += strip_rows)
+    {
+      gint    n_rows = MIN (strip_rows, roi->height - y);
+      gint    top    = MAX (0, y - (self->radius_y + 1));
+      gint    bottom = MIN (roi->height, y + n_rows + self->radius_y + 1);
+      gint    first  = MAX (0, top - 1);
+      gint    last   = MIN (roi->height, bottom + 1);
+      guchar *rows[3];
+
+      gegl_buffer_get (input,
+                       GEGL_RECTANGLE (roi->x, roi->y + first,
+                                       roi->width, last - first),
+                       1.0, format, source,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      for (i = top; i < bottom; i++)
+        {
+          rows[0] = i > 0 ?
+                    source + (i - 1 - first) * roi->width : above;
+          rows[1] = source + (i - first) * roi->width;
+          rows[2] = i + 1 < roi->height ?
+                    source + (i + 1 - first) * roi->width : below;
+
+          compute_transition (transition + (i - top) * roi->width,
+                              rows, roi->width, self->edge_lock);
+        }
+
+      gimp_distance_transform_rows (transition, roi->width, bottom - top,
+                                    y - top, n_rows, 128,
+                                    FALSE, FALSE, FALSE,
+                                    self->radius_x, self->radius_y,
+                                    dist);
+
+      for (i = 0; i < roi->width * n_rows; i++)
+        {
+          if (dist[i] < 1.0)
+            out[i] = self->feather ? 255 * (1.0 - sqrt (dist[i])) : 255;
+          else
+            out[i] = 0;
+        }
+
+      gegl_buffer_set (output,
+                       GEGL_RECTANGLE (roi->x, roi->y + y,
+                                       roi->width, n_rows),
+                       0, format, out,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (source);
+  g_free (transition);
+  g_free (out);
+  g_free (dist);
+  g_free (above);
+  g_free (below);
+}
+
 static gboolean
 gimp_operation_border_process (GeglOperation       *operation,
                                GeglBuffer          *input,
@@ -438,6 +533,14 @@ gimp_operation_border_process (GeglOperation       *operation,
       return TRUE;
     }
 
+  if (MAX (self->radius_x, self->radius_y) >=
+      GIMP_DISTANCE_TRANSFORM_MIN_RADIUS)
+    {
+      gimp_operation_border_process_distance (self, input, output, roi);
+
+      return TRUE;
+    }
+
   max = g_new (gint16, roi->width + 2 * self->radius_x);
 
   for (i = 0; i < (roi->width + 2 * self->radius_x); i++)
@@ -19,18 +19,45 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 
 #include "libgimpmath/gimpmath.h"
 
 #include "operations-types.h"
 
+#include "core/gimp-parallel.h"
+
 #include "gimpoperationcagecoefcalc.h"
 #include "gimpcageconfig.h"
 
 #include "gimp-intl.h"
 
 
+/*  the pixels per strip the coefficients are computed in, one strip
+ *  per thread at a time
+ */
+#define CAGE_COEF_STRIP_PIXELS 4096
+
+
+typedef struct _CoefScan  CoefScan;
+typedef struct _CoefStrip CoefStrip;
+
+struct _CoefScan
+{
+  GimpCageConfig *config;
+};
+
+struct _CoefStrip
+{
+  CoefScan       *scan;
+
+  GeglRectangle   rect;
+  gfloat         *data;
+};
+
+
 static void           gimp_operation_cage_coef_calc_finalize         (GObject              *object);
 static void           gimp_operation_cage_coef_calc_get_property     (GObject              *object,
                                                                       guint                 property_id,
@@ -48,6 +75,11 @@ static gboolean       gimp_operation_cage_coef_calc_process          (GeglOperat
                                                                       const GeglRectangle  *roi,
                                                                       gint                  level);
 
+static void           gimp_operation_cage_coef_calc_strip            (CoefStrip            *strip);
+static void           gimp_operation_cage_coef_calc_strip_func       (gint                  i,
+                                                                      gint                  n,
+                                                                      CoefStrip            *strips);
+
 
 G_DEFINE_TYPE (GimpOperationCageCoefCalc, gimp_operation_cage_coef_calc,
                GEGL_TYPE_OPERATION_SOURCE)
@@ -192,40 +224,22 @@ gimp_operation_cage_coef_calc_get_bounding_box (GeglOperation *operation)
   return gimp_cage_config_get_bounding_box (config);
 }
 
-static gboolean
-gimp_operation_cage_coef_calc_process (GeglOperation       *operation,
-                                       GeglBuffer          *output,
-                                       const GeglRectangle *roi,
-                                       gint                 level)
+static void
+gimp_operation_cage_coef_calc_strip (CoefStrip *strip)
 {
-  GimpOperationCageCoefCalc *occc   = GIMP_OPERATION_CAGE_COEF_CALC (operation);
-  GimpCageConfig            *config = GIMP_CAGE_CONFIG (occc->config);
-
-  const Babl *format = babl_format_n (babl_type ("float"), 2 * gimp_cage_config_get_n_points (config));
-
-  GeglBufferIterator *it;
-  guint               n_cage_vertices;
-  GimpCagePoint      *current, *last;
-
-  if (! config)
-    return FALSE;
-
-  n_cage_vertices   = gimp_cage_config_get_n_points (config);
+  GimpCageConfig *config          = strip->scan->config;
+  guint           n_cage_vertices = gimp_cage_config_get_n_points (config);
+  gfloat         *coef            = strip->data;
+  GimpCagePoint  *current, *last;
+  gint            x, y, j;
 
-  it = gegl_buffer_iterator_new (output, roi, 0, format,
-                                 GEGL_BUFFER_READWRITE, GEGL_ABYSS_NONE);
+  memset (coef, 0,
+          sizeof (gfloat) * 2 * n_cage_vertices *
+          strip->rect.width * strip->rect.height);
 
-  while (gegl_buffer_iterator_next (it))
+  for (y = strip->rect.y; y < strip->rect.y + strip->rect.height; y++)
     {
-      /* iterate inside the roi */
-      gint  n_pixels = it->length;
-      gint  x = it->roi->x; /* initial x                   */
-      gint  y = it->roi->y; /*           and y coordinates */
-      gint  j;
-
-      gfloat      *coef = it->data[0];
-
-      while(n_pixels--)
+      for (x = strip->rect.x; x < strip->rect.x + strip->rect.width; x++)
         {
           if (gimp_cage_config_point_inside(config, x, y))
             {
@@ -280,16 +294,90 @@ gimp_operation_cage_coef_calc_process (GeglOperation       *operation,
             }
 
           coef += 2 * n_cage_vertices;
+        }
+    }
+}
 
-          /* update x and y coordinates */
-          x++;
-          if (x >= (it->roi->x + it->roi->width))
-            {
-              x = it->roi->x;
-              y++;
-            }
+static void
+gimp_operation_cage_coef_calc_strip_func (gint       i,
+                                          gint       n,
+                                          CoefStrip *strips)
+{
+  gimp_operation_cage_coef_calc_strip (&strips[i]);
+}
+
+static gboolean
+gimp_operation_cage_coef_calc_process (GeglOperation       *operation,
+                                       GeglBuffer          *output,
+                                       const GeglRectangle *roi,
+                                       gint                 level)
+{
+  GimpOperationCageCoefCalc *occc      = GIMP_OPERATION_CAGE_COEF_CALC (operation);
+  GimpCageConfig            *config    = GIMP_CAGE_CONFIG (occc->config);
+  CoefScan                   scan      = { 0, };
+  CoefStrip                 *strips;
+  const Babl                *format;
+  guint                      n_cage_vertices;
+  gint                       strip_height;
+  gint                       n_threads = 1;
+  gint                       i, y;
+
+  if (! config)
+    return FALSE;
+
+  if (roi->width < 1 || roi->height < 1)
+    return TRUE;
+
+  n_cage_vertices = gimp_cage_config_get_n_points (config);
+  format          = babl_format_n (babl_type ("float"), 2 * n_cage_vertices);
+
+  scan.config = config;
+
+  strip_height = CLAMP (CAGE_COEF_STRIP_PIXELS / roi->width, 1, roi->height);
+
+  n_threads = CLAMP (gimp_parallel_get_n_threads (), 1,
+                     (roi->height + strip_height - 1) / strip_height);
+
+  strips = g_new0 (CoefStrip, n_threads);
+
+  for (i = 0; i < n_threads; i++)
+    {
+      strips[i].scan = &scan;
+      strips[i].data = g_new (gfloat, (2 * n_cage_vertices *
+                                       roi->width * strip_height));
+    }
+
+  for (y = roi->y; y < roi->y + roi->height;)
+    {
+      gint n_strips;
+
+      for (n_strips = 0;
+           n_strips < n_threads && y < roi->y + roi->height;
+           n_strips++)
+        {
+          CoefStrip *strip = &strips[n_strips];
+
+          strip->rect.x      = roi->x;
+          strip->rect.y      = y;
+          strip->rect.width  = roi->width;
+          strip->rect.height = MIN (strip_height, roi->y + roi->height - y);
+
+          y += strip->rect.height;
         }
+
+      gimp_parallel_distribute (n_strips,
+                                (GimpParallelDistributeFunc) gimp_operation_cage_coef_calc_strip_func,
+                                strips);
+
+      for (i = 0; i < n_strips; i++)
+        gegl_buffer_set (output, &strips[i].rect, 0, format,
+                         strips[i].data, GEGL_AUTO_ROWSTRIDE);
     }
 
+  for (i = 0; i < n_threads; i++)
+    g_free (strips[i].data);
+
+  g_free (strips);
+
   return TRUE;
 }
@@ -38,6 +38,7 @@ enum
   PROP_0,
   PROP_CONFIG,
   PROP_FILL,
+  PROP_GRID_SIZE,
   PROP_PROGRESS
 };
 
@@ -130,6 +131,13 @@ gimp_operation_cage_transform_class_init (GimpOperationCageTransformClass *klass
                                                          FALSE,
                                                          G_PARAM_READWRITE));
 
+  g_object_class_install_property (object_class, PROP_GRID_SIZE,
+                                   g_param_spec_int ("grid-size",
+                                                     "Grid size",
+                                                     "The deformation is computed exactly on a grid of this spacing, and interpolated in between",
+                                                     1, 8, 1,
+                                                     G_PARAM_READWRITE));
+
   g_object_class_install_property (object_class, PROP_PROGRESS,
                                    g_param_spec_double ("progress",
                                                         "Progress",
@@ -142,6 +150,7 @@ static void
 gimp_operation_cage_transform_init (GimpOperationCageTransform *self)
 {
   self->format_coords = babl_format_n(babl_type("float"), 2);
+  self->grid_size     = 1;
 }
 
 static void
@@ -174,6 +183,9 @@ gimp_operation_cage_transform_get_property (GObject    *object,
     case PROP_FILL:
       g_value_set_boolean (value, self->fill_plain_color);
       break;
+    case PROP_GRID_SIZE:
+      g_value_set_int (value, self->grid_size);
+      break;
     case PROP_PROGRESS:
       g_value_set_double (value, self->progress);
       break;
@@ -202,6 +214,9 @@ gimp_operation_cage_transform_set_property (GObject      *object,
     case PROP_FILL:
       self->fill_plain_color = g_value_get_boolean (value);
       break;
+    case PROP_GRID_SIZE:
+      self->grid_size = g_value_get_int (value);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -242,6 +257,8 @@ gimp_operation_cage_transform_process (GeglOperation       *operation,
   gboolean                    output_set;
   GimpCagePoint              *point;
   guint                       n_cage_vertices;
+  gint                        step   = MAX (oct->grid_size, 1);
+  gint                        x_max, y_max;
 
   /* pre-fill the out buffer with no-displacement coordinate */
   it      = gegl_buffer_iterator_new (out_buf, roi, 0, NULL,
@@ -307,15 +324,21 @@ gimp_operation_cage_transform_process (GeglOperation       *operation,
   coef        = g_malloc (n_cage_vertices * 2 * sizeof (gfloat));
   format_coef = babl_format_n (babl_type ("float"), 2 * n_cage_vertices);
 
-  /* compute, reverse and interpolate the transformation */
-  for (y = cage_bb.y; y < cage_bb.y + cage_bb.height - 1; y++)
+  x_max = cage_bb.x + cage_bb.width  - 1;
+  y_max = cage_bb.y + cage_bb.height - 1;
+
+  /* compute, reverse and interpolate the transformation, on a grid
+   * coarser than the pixels if requested. The recursive interpolation
+   * fills the pixels between the grid points
+   */
+  for (y = cage_bb.y; y < y_max; y += step)
     {
       GimpVector2 p1_d, p2_d, p3_d, p4_d;
       GimpVector2 p1_s, p2_s, p3_s, p4_s;
 
       p1_s.y = y;
-      p2_s.y = y+1;
-      p3_s.y = y+1;
+      p2_s.y = MIN (y + step, y_max);
+      p3_s.y = p2_s.y;
       p3_s.x = cage_bb.x;
       p4_s.y = y;
       p4_s.x = cage_bb.x;
@@ -323,12 +346,12 @@ gimp_operation_cage_transform_process (GeglOperation       *operation,
       p3_d = gimp_cage_transform_compute_destination (config, coef, format_coef, aux_buf, p3_s);
       p4_d = gimp_cage_transform_compute_destination (config, coef, format_coef, aux_buf, p4_s);
 
-      for (x = cage_bb.x; x < cage_bb.x + cage_bb.width - 1; x++)
+      for (x = cage_bb.x; x < x_max; x += step)
         {
           p1_s = p4_s;
           p2_s = p3_s;
-          p3_s.x = x+1;
-          p4_s.x = x+1;
+          p3_s.x = MIN (x + step, x_max);
+          p4_s.x = p3_s.x;
 
           p1_d = p4_d;
           p2_d = p3_d;
@@ -357,7 +380,7 @@ gimp_operation_cage_transform_process (GeglOperation       *operation,
             }
         }
 
-      if ((y - cage_bb.y) % 20 == 0)
+      if ((y - cage_bb.y) % (20 * step) == 0)
         {
           gdouble fraction = ((gdouble) (y - cage_bb.y) /
                               (gdouble) (cage_bb.height));
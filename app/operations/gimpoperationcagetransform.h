@@ -42,6 +42,7 @@ struct _GimpOperationCageTransform
 
   GimpCageConfig        *config;
   gboolean               fill_plain_color;
+  gint                   grid_size;
 
   const Babl            *format_coords;
 
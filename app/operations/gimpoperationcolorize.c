@@ -32,6 +32,10 @@
 #include "gimpoperationcolorize.h"
 
 
+/*  the pixels converted from HSL at once, small enough for the stack  */
+#define COLORIZE_BLOCK_PIXELS 256
+
+
 static gboolean gimp_operation_colorize_process (GeglOperation       *operation,
                                                  void                *in_buf,
                                                  void                *out_buf,
@@ -91,48 +95,51 @@ gimp_operation_colorize_process (GeglOperation       *operation,
   GimpColorizeConfig       *config = GIMP_COLORIZE_CONFIG (point->config);
   gfloat                   *src    = in_buf;
   gfloat                   *dest   = out_buf;
-  GimpHSL                   hsl;
 
   if (! config)
     return FALSE;
 
-  hsl.h = config->hue;
-  hsl.s = config->saturation;
-
-  while (samples--)
+  while (samples > 0)
     {
-      GimpRGB rgb;
-      gfloat  lum = GIMP_RGB_LUMINANCE (src[RED],
-                                        src[GREEN],
-                                        src[BLUE]);
-
-      if (config->lightness > 0)
-        {
-          lum = lum * (1.0 - config->lightness);
+      gfloat block[COLORIZE_BLOCK_PIXELS * 4];
+      gint   n = MIN (samples, COLORIZE_BLOCK_PIXELS);
+      gint   i;
 
-          lum += 1.0 - (1.0 - config->lightness);
-        }
-      else if (config->lightness < 0)
+      for (i = 0; i < n; i++)
         {
-          lum = lum * (config->lightness + 1.0);
+          gfloat *hsl = block + i * 4;
+          gfloat  lum = GIMP_RGB_LUMINANCE (src[RED],
+                                            src[GREEN],
+                                            src[BLUE]);
+
+          if (config->lightness > 0)
+            {
+              lum = lum * (1.0 - config->lightness);
+
+              lum += 1.0 - (1.0 - config->lightness);
+            }
+          else if (config->lightness < 0)
+            {
+              lum = lum * (config->lightness + 1.0);
+            }
+
+          hsl[0] = config->hue;
+          hsl[1] = config->saturation;
+          hsl[2] = lum;
+          hsl[3] = src[ALPHA];
+
+          src += 4;
         }
 
-      hsl.l = lum;
-
-      gimp_hsl_to_rgb (&hsl, &rgb);
-
       /*  the code in base/colorize.c would multiply r,b,g with lum,
        *  but this is a bug since it should multiply with 255. We
        *  don't repeat this bug here (this is the reason why the gegl
        *  colorize is brighter than the legacy one).
        */
-      dest[RED]   = rgb.r; /* * lum; */
-      dest[GREEN] = rgb.g; /* * lum; */
-      dest[BLUE]  = rgb.b; /* * lum */;
-      dest[ALPHA] = src[ALPHA];
+      gimp_hsl_to_rgb_pixels (block, dest, n);
 
-      src  += 4;
-      dest += 4;
+      dest    += n * 4;
+      samples -= n;
     }
 
   return TRUE;
@@ -33,6 +33,10 @@
 #include "gimpoperationcolormode.h"
 
 
+/*  the pixels converted to HSL at once, small enough for the stack  */
+#define COLOR_MODE_BLOCK_PIXELS 256
+
+
 static void     gimp_operation_color_mode_prepare (GeglOperation       *operation);
 static gboolean gimp_operation_color_mode_process (GeglOperation       *operation,
                                                    void                *in_buf,
@@ -99,58 +103,64 @@ gimp_operation_color_mode_process (GeglOperation       *operation,
   gfloat        *out      = out_buf;
   const gboolean has_mask = mask != NULL;
 
-  while (samples--)
+  while (samples > 0)
     {
-      GimpHSL layer_hsl, out_hsl;
-      GimpRGB layer_rgb = {layer[0], layer[1], layer[2]};
-      GimpRGB out_rgb   = {in[0], in[1], in[2]};
-      gfloat  comp_alpha, new_alpha;
+      gfloat layer_hsl[COLOR_MODE_BLOCK_PIXELS * 4];
+      gfloat out_hsl[COLOR_MODE_BLOCK_PIXELS * 4];
+      gint   n = MIN (samples, COLOR_MODE_BLOCK_PIXELS);
+      gint   i;
 
-      comp_alpha = MIN (in[ALPHA], layer[ALPHA]) * opacity;
-      if (has_mask)
-        comp_alpha *= *mask;
+      gimp_rgb_to_hsl_pixels (layer, layer_hsl, n);
+      gimp_rgb_to_hsl_pixels (in,    out_hsl,   n);
 
-      new_alpha = in[ALPHA] + (1.0 - in[ALPHA]) * comp_alpha;
-
-      if (comp_alpha && new_alpha)
+      for (i = 0; i < n; i++)
         {
-          gint   b;
-          gfloat ratio = comp_alpha / new_alpha;
+          out_hsl[i * 4]     = layer_hsl[i * 4];
+          out_hsl[i * 4 + 1] = layer_hsl[i * 4 + 1];
+        }
 
-          gimp_rgb_to_hsl (&layer_rgb, &layer_hsl);
-          gimp_rgb_to_hsl (&out_rgb, &out_hsl);
+      gimp_hsl_to_rgb_pixels (out_hsl, out_hsl, n);
 
-          out_hsl.h = layer_hsl.h;
-          out_hsl.s = layer_hsl.s;
-          gimp_hsl_to_rgb (&out_hsl, &out_rgb);
+      for (i = 0; i < n; i++)
+        {
+          const gfloat *comp = out_hsl + i * 4;
+          gfloat        comp_alpha, new_alpha;
+          gint          b;
+
+          comp_alpha = MIN (in[ALPHA], layer[ALPHA]) * opacity;
+          if (has_mask)
+            comp_alpha *= *mask;
 
-          out[0] = out_rgb.r;
-          out[1] = out_rgb.g;
-          out[2] = out_rgb.b;
+          new_alpha = in[ALPHA] + (1.0 - in[ALPHA]) * comp_alpha;
 
-          for (b = RED; b < ALPHA; b++)
+          if (comp_alpha && new_alpha)
             {
-              out[b] = out[b] * ratio + in[b] * (1.0 - ratio);
-            }
-        }
-      else
-        {
-          gint b;
+              gfloat ratio = comp_alpha / new_alpha;
 
-          for (b = RED; b < ALPHA; b++)
+              for (b = RED; b < ALPHA; b++)
+                {
+                  out[b] = comp[b] * ratio + in[b] * (1.0 - ratio);
+                }
+            }
+          else
             {
-              out[b] = in[b];
+              for (b = RED; b < ALPHA; b++)
+                {
+                  out[b] = in[b];
+                }
             }
-        }
 
-      out[ALPHA] = in[ALPHA];
+          out[ALPHA] = in[ALPHA];
+
+          in    += 4;
+          layer += 4;
+          out   += 4;
 
-      in    += 4;
-      layer += 4;
-      out   += 4;
+          if (has_mask)
+            mask++;
+        }
 
-      if (has_mask)
-        mask++;
+      samples -= n;
     }
 
   return TRUE;
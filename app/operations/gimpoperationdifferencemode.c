@@ -27,6 +27,7 @@
 #include "operations-types.h"
 
 #include "gimpoperationdifferencemode.h"
+#include "gimpoperationpointlayermode-loops.h"
 
 
 static void     gimp_operation_difference_mode_prepare (GeglOperation       *operation);
@@ -88,55 +89,11 @@ gimp_operation_difference_mode_process (GeglOperation       *operation,
                                         const GeglRectangle *roi,
                                         gint                 level)
 {
-  gdouble        opacity  = GIMP_OPERATION_POINT_LAYER_MODE (operation)->opacity;
-  gfloat        *in       = in_buf;
-  gfloat        *layer    = aux_buf;
-  gfloat        *mask     = aux2_buf;
-  gfloat        *out      = out_buf;
-  const gboolean has_mask = mask != NULL;
-
-  while (samples--)
-    {
-      gfloat comp_alpha, new_alpha;
-
-      comp_alpha = MIN (in[ALPHA], layer[ALPHA]) * opacity;
-      if (has_mask)
-        comp_alpha *= *mask;
-
-      new_alpha = in[ALPHA] + (1.0 - in[ALPHA]) * comp_alpha;
-
-      if (comp_alpha && new_alpha)
-        {
-          gfloat ratio = comp_alpha / new_alpha;
-          gint   b;
-
-          for (b = RED; b < ALPHA; b++)
-            {
-              gfloat comp = in[b] - layer[b];
-              comp = (comp < 0) ? -comp : comp;
-
-              out[b] = comp * ratio + in[b] * (1.0 - ratio);
-            }
-        }
-      else
-        {
-          gint b;
-
-          for (b = RED; b < ALPHA; b++)
-            {
-              out[b] = in[b];
-            }
-        }
-
-      out[ALPHA] = in[ALPHA];
-
-      in    += 4;
-      layer += 4;
-      out   += 4;
-
-      if (has_mask)
-        mask++;
-    }
+  gdouble opacity = GIMP_OPERATION_POINT_LAYER_MODE (operation)->opacity;
+
+  gimp_operation_point_layer_mode_loop (GIMP_DIFFERENCE_MODE,
+                                        in_buf, aux_buf, aux2_buf, out_buf,
+                                        samples, opacity);
 
   return TRUE;
 }
@@ -71,6 +71,7 @@ gimp_operation_equalize_class_init (GimpOperationEqualizeClass *klass)
   GObjectClass                  *object_class    = G_OBJECT_CLASS (klass);
   GeglOperationClass            *operation_class = GEGL_OPERATION_CLASS (klass);
   GeglOperationPointFilterClass *point_class     = GEGL_OPERATION_POINT_FILTER_CLASS (klass);
+  GimpOperationPointFilterClass *filter_class    = GIMP_OPERATION_POINT_FILTER_CLASS (klass);
 
   object_class->finalize       = gimp_operation_equalize_finalize;
   object_class->set_property   = gimp_operation_equalize_set_property;
@@ -84,6 +85,8 @@ gimp_operation_equalize_class_init (GimpOperationEqualizeClass *klass)
 
   point_class->process = gimp_operation_equalize_process;
 
+  filter_class->per_channel = TRUE;
+
   g_object_class_install_property (object_class, PROP_HISTOGRAM,
                                    g_param_spec_pointer ("histogram",
                                                          "Histogram",
@@ -107,6 +110,8 @@ gimp_operation_equalize_finalize (GObject *object)
       gimp_histogram_unref (self->histogram);
       self->histogram = NULL;
     }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -143,6 +148,7 @@ gimp_operation_equalize_set_property (GObject      *object,
       if (self->histogram)
         gimp_histogram_unref (self->histogram);
       self->histogram = g_value_get_pointer (value);
+      gimp_operation_point_filter_invalidate_lut (GIMP_OPERATION_POINT_FILTER (self));
       if (self->histogram)
         {
           gdouble pixels;
@@ -213,6 +219,10 @@ gimp_operation_equalize_process (GeglOperation       *operation,
   gfloat                *src  = in_buf;
   gfloat                *dest = out_buf;
 
+  if (gimp_operation_point_filter_process_lut (GIMP_OPERATION_POINT_FILTER (self),
+                                               in_buf, out_buf, samples))
+    return TRUE;
+
   while (samples--)
     {
       dest[RED]   = gimp_operation_equalize_map (self, RED,   src[RED]);
@@ -29,6 +29,7 @@
 
 #include "operations-types.h"
 
+#include "gimpdistancetransform.h"
 #include "gimpoperationgrow.h"
 
 
@@ -244,6 +245,13 @@ gimp_operation_grow_process (GeglOperation       *operation,
   gint16             last_max, last_index;
   guchar            *buffer;
 
+  if (MAX (self->radius_x, self->radius_y) >=
+      GIMP_DISTANCE_TRANSFORM_MIN_RADIUS &&
+      gimp_distance_transform_dilate (input, output, roi,
+                                      self->radius_x, self->radius_y,
+                                      FALSE, FALSE))
+    return TRUE;
+
   max = g_new (guchar *, roi->width + 2 * self->radius_x);
   buf = g_new (guchar *, self->radius_y + 1);
 
@@ -0,0 +1,396 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayerstack.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "operations-types.h"
+
+#include "gimpoperationlayerstack.h"
+#include "gimpoperationpointlayermode-loops.h"
+
+
+/*  the pixels composited per band, small enough that the band and the
+ *  layer pixels read for it stay in the cache
+ */
+#define LAYER_STACK_BAND_PIXELS (1 << 14)
+
+
+enum
+{
+  PROP_0,
+  PROP_LAYERS
+};
+
+
+static void           gimp_operation_layer_stack_finalize         (GObject             *object);
+static void           gimp_operation_layer_stack_get_property     (GObject             *object,
+                                                                   guint                property_id,
+                                                                   GValue              *value,
+                                                                   GParamSpec          *pspec);
+static void           gimp_operation_layer_stack_set_property     (GObject             *object,
+                                                                   guint                property_id,
+                                                                   const GValue        *value,
+                                                                   GParamSpec          *pspec);
+
+static void           gimp_operation_layer_stack_prepare          (GeglOperation       *operation);
+static GeglRectangle  gimp_operation_layer_stack_get_bounding_box (GeglOperation       *operation);
+static gboolean       gimp_operation_layer_stack_process          (GeglOperation       *operation,
+                                                                   GeglBuffer          *output,
+                                                                   const GeglRectangle *roi,
+                                                                   gint                 level);
+
+static void           gimp_layer_stack_layer_clear                (GimpLayerStackLayer *layer);
+
+
+G_DEFINE_TYPE (GimpOperationLayerStack, gimp_operation_layer_stack,
+               GEGL_TYPE_OPERATION_SOURCE)
+
+#define parent_class gimp_operation_layer_stack_parent_class
+
+
+static void
+gimp_operation_layer_stack_class_init (GimpOperationLayerStackClass *klass)
+{
+  GObjectClass             *object_class    = G_OBJECT_CLASS (klass);
+  GeglOperationClass       *operation_class = GEGL_OPERATION_CLASS (klass);
+  GeglOperationSourceClass *source_class    = GEGL_OPERATION_SOURCE_CLASS (klass);
+
+  object_class->finalize         = gimp_operation_layer_stack_finalize;
+  object_class->set_property     = gimp_operation_layer_stack_set_property;
+  object_class->get_property     = gimp_operation_layer_stack_get_property;
+
+  gegl_operation_class_set_keys (operation_class,
+                                 "name",        "gimp:layer-stack",
+                                 "categories",  "compositors",
+                                 "description", "Composites a stack of layers in one pass",
+                                 NULL);
+
+  operation_class->prepare          = gimp_operation_layer_stack_prepare;
+  operation_class->get_bounding_box = gimp_operation_layer_stack_get_bounding_box;
+
+  /*  the layer buffers are read behind GEGL's back, a cache would not
+   *  notice when they change
+   */
+  operation_class->no_cache         = TRUE;
+
+  source_class->process             = gimp_operation_layer_stack_process;
+
+  g_object_class_install_property (object_class, PROP_LAYERS,
+                                   g_param_spec_pointer ("layers",
+                                                         "Layers",
+                                                         "A GArray of GimpLayerStackLayer, bottom to top",
+                                                         G_PARAM_READWRITE));
+}
+
+static void
+gimp_operation_layer_stack_init (GimpOperationLayerStack *self)
+{
+}
+
+static void
+gimp_operation_layer_stack_finalize (GObject *object)
+{
+  GimpOperationLayerStack *self = GIMP_OPERATION_LAYER_STACK (object);
+
+  if (self->layers)
+    {
+      g_array_unref (self->layers);
+      self->layers = NULL;
+    }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gimp_operation_layer_stack_get_property (GObject    *object,
+                                         guint       property_id,
+                                         GValue     *value,
+                                         GParamSpec *pspec)
+{
+  GimpOperationLayerStack *self = GIMP_OPERATION_LAYER_STACK (object);
+
+  switch (property_id)
+    {
+    case PROP_LAYERS:
+      g_value_set_pointer (value, self->layers);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+gimp_operation_layer_stack_set_property (GObject      *object,
+                                         guint         property_id,
+                                         const GValue *value,
+                                         GParamSpec   *pspec)
+{
+  GimpOperationLayerStack *self = GIMP_OPERATION_LAYER_STACK (object);
+
+  switch (property_id)
+    {
+    case PROP_LAYERS:
+      {
+        GArray *layers = g_value_get_pointer (value);
+
+        if (layers)
+          g_array_ref (layers);
+
+        if (self->layers)
+          g_array_unref (self->layers);
+
+        self->layers = layers;
+      }
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+gimp_operation_layer_stack_prepare (GeglOperation *operation)
+{
+  gegl_operation_set_format (operation, "output",
+                             babl_format ("R'G'B'A float"));
+}
+
+static GeglRectangle
+gimp_operation_layer_stack_get_bounding_box (GeglOperation *operation)
+{
+  GimpOperationLayerStack *self   = GIMP_OPERATION_LAYER_STACK (operation);
+  GeglRectangle            result = { 0, 0, 0, 0 };
+  gint                     i;
+
+  if (! self->layers)
+    return result;
+
+  for (i = 0; i < self->layers->len; i++)
+    {
+      GimpLayerStackLayer *layer = &g_array_index (self->layers,
+                                                   GimpLayerStackLayer, i);
+      GeglRectangle        extent;
+
+      extent.x      = layer->offset_x;
+      extent.y      = layer->offset_y;
+      extent.width  = gegl_buffer_get_width  (layer->buffer);
+      extent.height = gegl_buffer_get_height (layer->buffer);
+
+      gegl_rectangle_bounding_box (&result, &result, &extent);
+    }
+
+  return result;
+}
+
+static gboolean
+gimp_operation_layer_stack_process (GeglOperation       *operation,
+                                    GeglBuffer          *output,
+                                    const GeglRectangle *roi,
+                                    gint                 level)
+{
+  GimpOperationLayerStack *self        = GIMP_OPERATION_LAYER_STACK (operation);
+  const Babl              *format      = babl_format ("R'G'B'A float");
+  const Babl              *mask_format = babl_format ("Y float");
+  gfloat                  *band_data;
+  gfloat                  *layer_data;
+  gfloat                  *mask_data;
+  gint                     band_rows;
+  gint                     y;
+
+  if (! self->layers || roi->width < 1 || roi->height < 1)
+    return TRUE;
+
+  band_rows  = CLAMP (LAYER_STACK_BAND_PIXELS / roi->width, 1, roi->height);
+
+  band_data  = g_new (gfloat, roi->width * band_rows * 4);
+  layer_data = g_new (gfloat, roi->width * band_rows * 4);
+  mask_data  = g_new (gfloat, roi->width * band_rows);
+
+  for (y = roi->y; y < roi->y + roi->height; y += band_rows)
+    {
+      GeglRectangle band;
+      gint          i;
+
+      band.x      = roi->x;
+      band.y      = y;
+      band.width  = roi->width;
+      band.height = MIN (band_rows, roi->y + roi->height - y);
+
+      /*  the bottom layer is composited onto transparency, like the
+       *  unconnected input of the bottom mode node in the node chain
+       */
+      memset (band_data, 0, sizeof (gfloat) * band.width * band.height * 4);
+
+      for (i = 0; i < self->layers->len; i++)
+        {
+          GimpLayerStackLayer *layer = &g_array_index (self->layers,
+                                                       GimpLayerStackLayer, i);
+          GeglRectangle        extent;
+          GeglRectangle        rect;
+          GeglRectangle        src;
+          gint                 row;
+
+          extent.x      = layer->offset_x;
+          extent.y      = layer->offset_y;
+          extent.width  = gegl_buffer_get_width  (layer->buffer);
+          extent.height = gegl_buffer_get_height (layer->buffer);
+
+          /*  outside of the layer, every point mode leaves in alone  */
+          if (! gegl_rectangle_intersect (&rect, &band, &extent))
+            continue;
+
+          src        = rect;
+          src.x     -= layer->offset_x;
+          src.y     -= layer->offset_y;
+
+          gegl_buffer_get (layer->buffer, &src, 1.0, format,
+                           layer_data, GEGL_AUTO_ROWSTRIDE,
+                           GEGL_ABYSS_NONE);
+
+          if (layer->mask)
+            gegl_buffer_get (layer->mask, &src, 1.0, mask_format,
+                             mask_data, GEGL_AUTO_ROWSTRIDE,
+                             GEGL_ABYSS_NONE);
+
+          for (row = 0; row < rect.height; row++)
+            {
+              gfloat *dest = (band_data +
+                              ((rect.y - band.y + row) * band.width +
+                               (rect.x - band.x)) * 4);
+
+              gimp_operation_point_layer_mode_loop (layer->mode,
+                                                    dest,
+                                                    layer_data +
+                                                    row * rect.width * 4,
+                                                    layer->mask ?
+                                                    mask_data +
+                                                    row * rect.width : NULL,
+                                                    dest,
+                                                    rect.width,
+                                                    layer->opacity);
+            }
+        }
+
+      gegl_buffer_set (output, &band, 0, format,
+                       band_data, GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (band_data);
+  g_free (layer_data);
+  g_free (mask_data);
+
+  return TRUE;
+}
+
+
+/*  public functions  */
+
+gboolean
+gimp_operation_layer_stack_supports_mode (GimpLayerModeEffects mode)
+{
+  return gimp_operation_point_layer_mode_loop_scalar (mode) != NULL;
+}
+
+GArray *
+gimp_operation_layer_stack_layers_new (void)
+{
+  GArray *layers = g_array_new (FALSE, TRUE, sizeof (GimpLayerStackLayer));
+
+  g_array_set_clear_func (layers,
+                          (GDestroyNotify) gimp_layer_stack_layer_clear);
+
+  return layers;
+}
+
+void
+gimp_operation_layer_stack_layers_add (GArray               *layers,
+                                       GeglBuffer           *buffer,
+                                       GeglBuffer           *mask,
+                                       gint                  offset_x,
+                                       gint                  offset_y,
+                                       GimpLayerModeEffects  mode,
+                                       gdouble               opacity)
+{
+  GimpLayerStackLayer layer;
+
+  g_return_if_fail (layers != NULL);
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (mask == NULL || GEGL_IS_BUFFER (mask));
+  g_return_if_fail (gimp_operation_layer_stack_supports_mode (mode));
+
+  layer.buffer   = g_object_ref (buffer);
+  layer.mask     = mask ? g_object_ref (mask) : NULL;
+  layer.offset_x = offset_x;
+  layer.offset_y = offset_y;
+  layer.mode     = mode;
+  layer.opacity  = opacity;
+
+  g_array_append_val (layers, layer);
+}
+
+gboolean
+gimp_operation_layer_stack_layers_equal (GArray *layers1,
+                                         GArray *layers2)
+{
+  gint i;
+
+  if (layers1 == layers2)
+    return TRUE;
+
+  if (! layers1 || ! layers2 || layers1->len != layers2->len)
+    return FALSE;
+
+  for (i = 0; i < layers1->len; i++)
+    {
+      GimpLayerStackLayer *layer1 = &g_array_index (layers1,
+                                                    GimpLayerStackLayer, i);
+      GimpLayerStackLayer *layer2 = &g_array_index (layers2,
+                                                    GimpLayerStackLayer, i);
+
+      if (layer1->buffer   != layer2->buffer   ||
+          layer1->mask     != layer2->mask     ||
+          layer1->offset_x != layer2->offset_x ||
+          layer1->offset_y != layer2->offset_y ||
+          layer1->mode     != layer2->mode     ||
+          layer1->opacity  != layer2->opacity)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+/*  private functions  */
+
+static void
+gimp_layer_stack_layer_clear (GimpLayerStackLayer *layer)
+{
+  if (layer->buffer)
+    g_object_unref (layer->buffer);
+
+  if (layer->mask)
+    g_object_unref (layer->mask);
+}
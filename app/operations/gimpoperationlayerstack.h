@@ -0,0 +1,80 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayerstack.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_OPERATION_LAYER_STACK_H__
+#define __GIMP_OPERATION_LAYER_STACK_H__
+
+
+#include <gegl-plugin.h>
+#include <operation/gegl-operation-source.h>
+
+
+#define GIMP_TYPE_OPERATION_LAYER_STACK            (gimp_operation_layer_stack_get_type ())
+#define GIMP_OPERATION_LAYER_STACK(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_OPERATION_LAYER_STACK, GimpOperationLayerStack))
+#define GIMP_OPERATION_LAYER_STACK_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GIMP_TYPE_OPERATION_LAYER_STACK, GimpOperationLayerStackClass))
+#define GIMP_IS_OPERATION_LAYER_STACK(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_OPERATION_LAYER_STACK))
+#define GIMP_IS_OPERATION_LAYER_STACK_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GIMP_TYPE_OPERATION_LAYER_STACK))
+#define GIMP_OPERATION_LAYER_STACK_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_OPERATION_LAYER_STACK, GimpOperationLayerStackClass))
+
+
+/*  one layer of the stack, the layers are composited bottom to top  */
+struct _GimpLayerStackLayer
+{
+  GeglBuffer           *buffer;
+  GeglBuffer           *mask;      /*  applied mask, or NULL  */
+  gint                  offset_x;
+  gint                  offset_y;
+  GimpLayerModeEffects  mode;
+  gdouble               opacity;
+};
+
+
+typedef struct _GimpOperationLayerStack      GimpOperationLayerStack;
+typedef struct _GimpOperationLayerStackClass GimpOperationLayerStackClass;
+
+struct _GimpOperationLayerStack
+{
+  GeglOperationSource  parent_instance;
+
+  GArray              *layers;
+};
+
+struct _GimpOperationLayerStackClass
+{
+  GeglOperationSourceClass  parent_class;
+};
+
+
+GType      gimp_operation_layer_stack_get_type       (void) G_GNUC_CONST;
+
+gboolean   gimp_operation_layer_stack_supports_mode  (GimpLayerModeEffects  mode);
+
+GArray   * gimp_operation_layer_stack_layers_new     (void);
+void       gimp_operation_layer_stack_layers_add     (GArray               *layers,
+                                                      GeglBuffer           *buffer,
+                                                      GeglBuffer           *mask,
+                                                      gint                  offset_x,
+                                                      gint                  offset_y,
+                                                      GimpLayerModeEffects  mode,
+                                                      gdouble               opacity);
+gboolean   gimp_operation_layer_stack_layers_equal   (GArray               *layers1,
+                                                      GArray               *layers2);
+
+
+#endif /* __GIMP_OPERATION_LAYER_STACK_H__ */
@@ -26,6 +26,7 @@
 #include "operations-types.h"
 
 #include "gimpoperationnormalmode.h"
+#include "gimpoperationpointlayermode-loops.h"
 
 
 static gboolean gimp_operation_normal_parent_process (GeglOperation        *operation,
@@ -168,42 +169,9 @@ gimp_operation_normal_mode_process (GeglOperation       *operation,
     }
   else
     {
-      while (samples--)
-        {
-          gfloat aux_alpha;
-
-          aux_alpha = aux[ALPHA] * opacity;
-          if (has_mask)
-            aux_alpha *= *mask;
-
-          out[ALPHA] = aux_alpha + in[ALPHA] - aux_alpha * in[ALPHA];
-
-          if (out[ALPHA])
-            {
-              gint b;
-
-              for (b = RED; b < ALPHA; b++)
-                {
-                  out[b] = (aux[b] * aux_alpha + in[b] * in[ALPHA] * (1.0f - aux_alpha)) / out[ALPHA];
-                }
-            }
-          else
-            {
-              gint b;
-
-              for (b = RED; b < ALPHA; b++)
-                {
-                  out[b] = in[b];
-                }
-            }
-
-          in   += 4;
-          aux  += 4;
-          out  += 4;
-
-          if (has_mask)
-            mask++;
-        }
+      gimp_operation_point_layer_mode_loop (GIMP_NORMAL_MODE,
+                                            in_buf, aux_buf, aux2_buf, out_buf,
+                                            samples, opacity);
     }
 
   return TRUE;
@@ -22,13 +22,35 @@
 
 #include <gegl.h>
 
+#include "libgimpmath/gimpmath.h"
+
 #include "operations-types.h"
 
 #include "gimpoperationpointfilter.h"
 
 
-static void   gimp_operation_point_filter_finalize (GObject       *object);
-static void   gimp_operation_point_filter_prepare  (GeglOperation *operation);
+typedef struct _GimpPointFilterLut GimpPointFilterLut;
+
+struct _GimpPointFilterLut
+{
+  gint        ref_count;  /*  atomic  */
+  const Babl *format;
+  gint        size;
+  gint        serial;     /*  the filter's lut_serial it was built for  */
+  gpointer    data;
+};
+
+
+static void   gimp_operation_point_filter_finalize       (GObject                  *object);
+static void   gimp_operation_point_filter_prepare        (GeglOperation            *operation);
+
+static void   gimp_operation_point_filter_config_notify  (GObject                  *config,
+                                                          GParamSpec               *pspec,
+                                                          GimpOperationPointFilter *filter);
+static GimpPointFilterLut *
+              gimp_operation_point_filter_build_lut      (GimpOperationPointFilter *filter,
+                                                          const Babl               *format);
+static void   gimp_point_filter_lut_unref                (GimpPointFilterLut       *lut);
 
 
 G_DEFINE_ABSTRACT_TYPE (GimpOperationPointFilter, gimp_operation_point_filter,
@@ -37,6 +59,10 @@ G_DEFINE_ABSTRACT_TYPE (GimpOperationPointFilter, gimp_operation_point_filter,
 #define parent_class gimp_operation_point_filter_parent_class
 
 
+/*  set while a thread runs process() to build a table  */
+static GPrivate building_lut = G_PRIVATE_INIT (NULL);
+
+
 static void
 gimp_operation_point_filter_class_init (GimpOperationPointFilterClass *klass)
 {
@@ -51,6 +77,7 @@ gimp_operation_point_filter_class_init (GimpOperationPointFilterClass *klass)
 static void
 gimp_operation_point_filter_init (GimpOperationPointFilter *self)
 {
+  g_mutex_init (&self->lut_mutex);
 }
 
 static void
@@ -60,10 +87,21 @@ gimp_operation_point_filter_finalize (GObject *object)
 
   if (self->config)
     {
+      g_signal_handlers_disconnect_by_func (self->config,
+                                            gimp_operation_point_filter_config_notify,
+                                            self);
       g_object_unref (self->config);
       self->config = NULL;
     }
 
+  if (self->lut)
+    {
+      gimp_point_filter_lut_unref (self->lut);
+      self->lut = NULL;
+    }
+
+  g_mutex_clear (&self->lut_mutex);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -99,8 +137,20 @@ gimp_operation_point_filter_set_property (GObject      *object,
     {
     case GIMP_OPERATION_POINT_FILTER_PROP_CONFIG:
       if (self->config)
-        g_object_unref (self->config);
+        {
+          g_signal_handlers_disconnect_by_func (self->config,
+                                                gimp_operation_point_filter_config_notify,
+                                                self);
+          g_object_unref (self->config);
+        }
+
       self->config = g_value_dup_object (value);
+      gimp_operation_point_filter_invalidate_lut (self);
+
+      if (self->config)
+        g_signal_connect (self->config, "notify",
+                          G_CALLBACK (gimp_operation_point_filter_config_notify),
+                          self);
       break;
 
    default:
@@ -109,11 +159,249 @@ gimp_operation_point_filter_set_property (GObject      *object,
     }
 }
 
+/*  makes the next prepare() build new tables, call this when the
+ *  result of process() changes
+ */
+void
+gimp_operation_point_filter_invalidate_lut (GimpOperationPointFilter *filter)
+{
+  g_return_if_fail (GIMP_IS_OPERATION_POINT_FILTER (filter));
+
+  g_atomic_int_inc (&filter->lut_serial);
+}
+
+gboolean
+gimp_operation_point_filter_process_lut (GimpOperationPointFilter *filter,
+                                         gpointer                  in_buf,
+                                         gpointer                  out_buf,
+                                         glong                     samples)
+{
+  GimpPointFilterLut *lut;
+
+  if (! filter->lut_format || g_private_get (&building_lut) == filter)
+    return FALSE;
+
+  g_mutex_lock (&filter->lut_mutex);
+
+  lut = filter->lut;
+
+  if (lut && lut->format == filter->lut_format)
+    g_atomic_int_inc (&lut->ref_count);
+  else
+    lut = NULL;
+
+  g_mutex_unlock (&filter->lut_mutex);
+
+  if (! lut)
+    return FALSE;
+
+  if (lut->size == 256)
+    {
+      const guint8 *table = lut->data;
+      const guint8 *src   = in_buf;
+      guint8       *dest  = out_buf;
+
+      while (samples--)
+        {
+          dest[0] = table[      src[0]];
+          dest[1] = table[256 + src[1]];
+          dest[2] = table[512 + src[2]];
+          dest[3] = table[768 + src[3]];
+
+          src  += 4;
+          dest += 4;
+        }
+    }
+  else
+    {
+      const guint16 *table = lut->data;
+      const guint16 *src   = in_buf;
+      guint16       *dest  = out_buf;
+
+      while (samples--)
+        {
+          dest[0] = table[          src[0]];
+          dest[1] = table[0x10000 + src[1]];
+          dest[2] = table[0x20000 + src[2]];
+          dest[3] = table[0x30000 + src[3]];
+
+          src  += 4;
+          dest += 4;
+        }
+    }
+
+  gimp_point_filter_lut_unref (lut);
+
+  return TRUE;
+}
+
 static void
 gimp_operation_point_filter_prepare (GeglOperation *operation)
 {
-  const Babl *format = babl_format ("R'G'B'A float");
+  GimpOperationPointFilter      *filter     = GIMP_OPERATION_POINT_FILTER (operation);
+  GimpOperationPointFilterClass *klass      = GIMP_OPERATION_POINT_FILTER_GET_CLASS (filter);
+  const Babl                    *format     = babl_format ("R'G'B'A float");
+  const Babl                    *lut_format = NULL;
+
+  /*  perceptual integer input has few enough values to look every
+   *  result up; linear integer input would lose precision on the way
+   *  to R'G'B'A u8 or u16, so it keeps being processed in float, like
+   *  all more precise input
+   */
+  if (klass->per_channel)
+    {
+      const Babl *source = gegl_operation_get_source_format (operation,
+                                                             "input");
+
+      if (source)
+        {
+          const Babl *model = babl_format_get_model (source);
+          const Babl *type  = babl_format_get_type (source, 0);
+
+          if (model == babl_model ("R'G'B'A") ||
+              model == babl_model ("R'G'B'")  ||
+              model == babl_model ("Y'A")     ||
+              model == babl_model ("Y'"))
+            {
+              if (type == babl_type ("u8"))
+                lut_format = babl_format ("R'G'B'A u8");
+              else if (type == babl_type ("u16"))
+                lut_format = babl_format ("R'G'B'A u16");
+            }
+        }
+    }
+
+  if (lut_format)
+    {
+      GimpPointFilterLut *lut;
+      gint                serial = g_atomic_int_get (&filter->lut_serial);
+
+      g_mutex_lock (&filter->lut_mutex);
+
+      lut = filter->lut;
+
+      if (lut && (lut->format != lut_format || lut->serial != serial))
+        lut = NULL;
+
+      g_mutex_unlock (&filter->lut_mutex);
+
+      /*  built without the lock, the swap only replaces the pointer  */
+      if (! lut)
+        {
+          lut = gimp_operation_point_filter_build_lut (filter, lut_format);
+
+          if (lut)
+            {
+              GimpPointFilterLut *old;
+
+              g_mutex_lock (&filter->lut_mutex);
+              old         = filter->lut;
+              filter->lut = lut;
+              g_mutex_unlock (&filter->lut_mutex);
+
+              if (old)
+                gimp_point_filter_lut_unref (old);
+            }
+        }
+
+      if (! lut)
+        lut_format = NULL;
+    }
+
+  filter->lut_format = lut_format;
+
+  if (lut_format)
+    format = lut_format;
 
   gegl_operation_set_format (operation, "input",  format);
   gegl_operation_set_format (operation, "output", format);
 }
+
+static void
+gimp_operation_point_filter_config_notify (GObject                  *config,
+                                           GParamSpec               *pspec,
+                                           GimpOperationPointFilter *filter)
+{
+  gimp_operation_point_filter_invalidate_lut (filter);
+}
+
+/*  Runs the filter's own float process() over a ramp of all input
+ *  values, so the tables can't drift from the float code
+ */
+static GimpPointFilterLut *
+gimp_operation_point_filter_build_lut (GimpOperationPointFilter *filter,
+                                       const Babl               *format)
+{
+  GeglOperationPointFilterClass *point_class;
+  GimpPointFilterLut            *lut = NULL;
+  GeglRectangle                  roi;
+  gfloat                        *ramp;
+  gfloat                        *mapped;
+  gint                           serial;
+  gint                           size;
+  gint                           i;
+  gint                           c;
+  gboolean                       success;
+
+  point_class = GEGL_OPERATION_POINT_FILTER_GET_CLASS (filter);
+
+  serial = g_atomic_int_get (&filter->lut_serial);
+  size   = (format == babl_format ("R'G'B'A u8")) ? 256 : 0x10000;
+
+  ramp   = g_new (gfloat, size * 4);
+  mapped = g_new (gfloat, size * 4);
+
+  for (i = 0; i < size; i++)
+    for (c = 0; c < 4; c++)
+      ramp[i * 4 + c] = (gfloat) i / (size - 1);
+
+  roi.x      = 0;
+  roi.y      = 0;
+  roi.width  = size;
+  roi.height = 1;
+
+  /*  makes process() take the float path on this thread  */
+  g_private_set (&building_lut, filter);
+
+  success = point_class->process (GEGL_OPERATION (filter),
+                                  ramp, mapped, size, &roi, 0);
+
+  g_private_set (&building_lut, NULL);
+
+  if (success)
+    {
+      lut = g_slice_new (GimpPointFilterLut);
+
+      lut->ref_count = 1;
+      lut->format    = format;
+      lut->size      = size;
+      lut->serial    = serial;
+      lut->data      = g_malloc (size * 4 * (size == 256 ? 1 : 2));
+
+      for (c = 0; c < 4; c++)
+        for (i = 0; i < size; i++)
+          {
+            gfloat value = CLAMP (mapped[i * 4 + c], 0.0, 1.0);
+
+            if (size == 256)
+              ((guint8 *)  lut->data)[c * size + i] = RINT (value * 255.0);
+            else
+              ((guint16 *) lut->data)[c * size + i] = RINT (value * 65535.0);
+          }
+    }
+
+  g_free (ramp);
+  g_free (mapped);
+
+  return lut;
+}
+
+static void
+gimp_point_filter_lut_unref (GimpPointFilterLut *lut)
+{
+  if (g_atomic_int_dec_and_test (&lut->ref_count))
+    {
+      g_free (lut->data);
+      g_slice_free (GimpPointFilterLut, lut);
+    }
+}
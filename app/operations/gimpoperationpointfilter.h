@@ -48,24 +48,47 @@ struct _GimpOperationPointFilter
   GeglOperationPointFilter  parent_instance;
 
   GObject                  *config;
+
+  /*  lookup tables for 8 and 16 bit input, see per_channel. A new
+   *  table replaces the old one as a whole, so process() calls on
+   *  other threads keep using the table they picked up
+   */
+  GMutex                    lut_mutex;
+  gpointer                  lut;         /*  protected by lut_mutex  */
+  gint                      lut_serial;  /*  atomic                  */
+  const Babl               *lut_format;
 };
 
 struct _GimpOperationPointFilterClass
 {
   GeglOperationPointFilterClass  parent_class;
+
+  /*  TRUE if every output channel only depends on the same input
+   *  channel, the filter then runs through per-channel lookup tables
+   *  for 8 and 16 bit input, and process() has to start with
+   *  gimp_operation_point_filter_process_lut()
+   */
+  gboolean                       per_channel;
 };
 
 
-GType   gimp_operation_point_filter_get_type     (void) G_GNUC_CONST;
+GType      gimp_operation_point_filter_get_type     (void) G_GNUC_CONST;
+
+void       gimp_operation_point_filter_get_property (GObject                  *object,
+                                                     guint                     property_id,
+                                                     GValue                   *value,
+                                                     GParamSpec               *pspec);
+void       gimp_operation_point_filter_set_property (GObject                  *object,
+                                                     guint                     property_id,
+                                                     const GValue             *value,
+                                                     GParamSpec               *pspec);
 
-void    gimp_operation_point_filter_get_property (GObject      *object,
-                                                  guint         property_id,
-                                                  GValue       *value,
-                                                  GParamSpec   *pspec);
-void    gimp_operation_point_filter_set_property (GObject      *object,
-                                                  guint         property_id,
-                                                  const GValue *value,
-                                                  GParamSpec   *pspec);
+void       gimp_operation_point_filter_invalidate_lut
+                                                    (GimpOperationPointFilter *filter);
+gboolean   gimp_operation_point_filter_process_lut  (GimpOperationPointFilter *filter,
+                                                     gpointer                  in_buf,
+                                                     gpointer                  out_buf,
+                                                     glong                     samples);
 
 
 #endif /* __GIMP_OPERATION_POINT_FILTER_H__ */
@@ -0,0 +1,391 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationpointlayermode-loops.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "operations-types.h"
+
+#include "gimpoperationpointlayermode-loops.h"
+
+#ifdef GIMP_LAYER_MODE_LOOPS_SSE2
+#include <emmintrin.h>
+#endif
+
+
+#define N_LOOP_MODES (GIMP_ANTI_ERASE_MODE + 1)
+
+
+static void   gimp_operation_point_layer_mode_loops_init (void);
+
+
+static GimpLayerModeLoopFunc loop_funcs[N_LOOP_MODES] = { NULL, };
+
+
+/*  public functions  */
+
+void
+gimp_operation_point_layer_mode_loop (GimpLayerModeEffects  mode,
+                                      const gfloat         *in,
+                                      const gfloat         *layer,
+                                      const gfloat         *mask,
+                                      gfloat               *out,
+                                      glong                 samples,
+                                      gdouble               opacity)
+{
+  static gsize initialized = 0;
+
+  g_return_if_fail (mode >= 0 && mode < N_LOOP_MODES);
+
+  if (g_once_init_enter (&initialized))
+    {
+      gimp_operation_point_layer_mode_loops_init ();
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  g_return_if_fail (loop_funcs[mode] != NULL);
+
+  loop_funcs[mode] (in, layer, mask, out, samples, opacity);
+}
+
+
+/*  scalar implementations  */
+
+static void
+gimp_layer_mode_normal_loop_scalar (const gfloat *in,
+                                    const gfloat *aux,
+                                    const gfloat *mask,
+                                    gfloat       *out,
+                                    glong         samples,
+                                    gdouble       opacity)
+{
+  const gboolean has_mask = mask != NULL;
+
+  while (samples--)
+    {
+      gfloat in_alpha = in[ALPHA];
+      gfloat aux_alpha;
+
+      aux_alpha = aux[ALPHA] * opacity;
+      if (has_mask)
+        aux_alpha *= *mask;
+
+      /*  in_alpha is kept aside, out may be in  */
+      out[ALPHA] = aux_alpha + in_alpha - aux_alpha * in_alpha;
+
+      if (out[ALPHA])
+        {
+          gint b;
+
+          for (b = RED; b < ALPHA; b++)
+            {
+              out[b] = (aux[b] * aux_alpha + in[b] * in_alpha * (1.0f - aux_alpha)) / out[ALPHA];
+            }
+        }
+      else
+        {
+          gint b;
+
+          for (b = RED; b < ALPHA; b++)
+            {
+              out[b] = in[b];
+            }
+        }
+
+      in   += 4;
+      aux  += 4;
+      out  += 4;
+
+      if (has_mask)
+        mask++;
+    }
+}
+
+/*  All the modes below composite the same way and only differ in how
+ *  they combine a channel of in with the same channel of layer.
+ */
+#define LAYER_MODE_LOOP_SCALAR(name, blend)                             \
+static void                                                             \
+gimp_layer_mode_##name##_loop_scalar (const gfloat *in,                 \
+                                      const gfloat *layer,              \
+                                      const gfloat *mask,               \
+                                      gfloat       *out,                \
+                                      glong         samples,            \
+                                      gdouble       opacity)            \
+{                                                                       \
+  const gboolean has_mask = mask != NULL;                               \
+                                                                        \
+  while (samples--)                                                     \
+    {                                                                   \
+      gfloat comp_alpha, new_alpha;                                     \
+      gint   b;                                                         \
+                                                                        \
+      comp_alpha = MIN (in[ALPHA], layer[ALPHA]) * opacity;             \
+      if (has_mask)                                                     \
+        comp_alpha *= *mask;                                            \
+                                                                        \
+      new_alpha = in[ALPHA] + (1.0 - in[ALPHA]) * comp_alpha;           \
+                                                                        \
+      if (comp_alpha && new_alpha)                                      \
+        {                                                               \
+          gfloat ratio = comp_alpha / new_alpha;                        \
+                                                                        \
+          for (b = RED; b < ALPHA; b++)                                 \
+            {                                                           \
+              gfloat comp = blend (in[b], layer[b]);                    \
+                                                                        \
+              out[b] = comp * ratio + in[b] * (1.0 - ratio);            \
+            }                                                           \
+        }                                                               \
+      else                                                              \
+        {                                                               \
+          for (b = RED; b < ALPHA; b++)                                 \
+            out[b] = in[b];                                             \
+        }                                                               \
+                                                                        \
+      out[ALPHA] = in[ALPHA];                                           \
+                                                                        \
+      in    += 4;                                                       \
+      layer += 4;                                                       \
+      out   += 4;                                                       \
+                                                                        \
+      if (has_mask)                                                     \
+        mask++;                                                         \
+    }                                                                   \
+}
+
+#define BLEND_MULTIPLY(i, l)   CLAMP ((l) * (i), 0.0, 1.0)
+#define BLEND_SCREEN(i, l)     (1.0 - (1.0 - (i)) * (1.0 - (l)))
+#define BLEND_DIFFERENCE(i, l) (((i) - (l)) < 0 ? (l) - (i) : (i) - (l))
+#define BLEND_ADDITION(i, l)   CLAMP ((i) + (l), 0.0, 1.0)
+#define BLEND_SUBTRACT(i, l)   (((i) - (l)) < 0 ? 0 : (i) - (l))
+#define BLEND_DARKEN(i, l)     MIN ((i), (l))
+#define BLEND_LIGHTEN(i, l)    MAX ((l), (i))
+
+LAYER_MODE_LOOP_SCALAR (multiply,     BLEND_MULTIPLY)
+LAYER_MODE_LOOP_SCALAR (screen,       BLEND_SCREEN)
+LAYER_MODE_LOOP_SCALAR (difference,   BLEND_DIFFERENCE)
+LAYER_MODE_LOOP_SCALAR (addition,     BLEND_ADDITION)
+LAYER_MODE_LOOP_SCALAR (subtract,     BLEND_SUBTRACT)
+LAYER_MODE_LOOP_SCALAR (darken_only,  BLEND_DARKEN)
+LAYER_MODE_LOOP_SCALAR (lighten_only, BLEND_LIGHTEN)
+
+GimpLayerModeLoopFunc
+gimp_operation_point_layer_mode_loop_scalar (GimpLayerModeEffects mode)
+{
+  switch (mode)
+    {
+    case GIMP_NORMAL_MODE:       return gimp_layer_mode_normal_loop_scalar;
+    case GIMP_MULTIPLY_MODE:     return gimp_layer_mode_multiply_loop_scalar;
+    case GIMP_SCREEN_MODE:       return gimp_layer_mode_screen_loop_scalar;
+    case GIMP_DIFFERENCE_MODE:   return gimp_layer_mode_difference_loop_scalar;
+    case GIMP_ADDITION_MODE:     return gimp_layer_mode_addition_loop_scalar;
+    case GIMP_SUBTRACT_MODE:     return gimp_layer_mode_subtract_loop_scalar;
+    case GIMP_DARKEN_ONLY_MODE:  return gimp_layer_mode_darken_only_loop_scalar;
+    case GIMP_LIGHTEN_ONLY_MODE: return gimp_layer_mode_lighten_only_loop_scalar;
+
+    default:
+      return NULL;
+    }
+}
+
+
+/*  SSE2 implementations  */
+
+#ifdef GIMP_LAYER_MODE_LOOPS_SSE2
+
+/*  One RGBA pixel fits an SSE register, so the loops work a pixel at
+ *  a time with the alpha broadcast to all lanes, and select in's
+ *  channels with a mask where the scalar code branches.
+ */
+
+#define SPLAT_ALPHA(v) _mm_shuffle_ps ((v), (v), _MM_SHUFFLE (3, 3, 3, 3))
+
+static void
+gimp_layer_mode_normal_loop_sse2 (const gfloat *in,
+                                  const gfloat *aux,
+                                  const gfloat *mask,
+                                  gfloat       *out,
+                                  glong         samples,
+                                  gdouble       opacity)
+{
+  const __m128 zero     = _mm_setzero_ps ();
+  const __m128 one      = _mm_set1_ps (1.0f);
+  const __m128 color    = _mm_castsi128_ps (_mm_set_epi32 (0, -1, -1, -1));
+  const __m128 opacityv = _mm_set1_ps (opacity);
+
+  while (samples--)
+    {
+      __m128 i         = _mm_loadu_ps (in);
+      __m128 l         = _mm_loadu_ps (aux);
+      __m128 in_alpha  = SPLAT_ALPHA (i);
+      __m128 aux_alpha = _mm_mul_ps (SPLAT_ALPHA (l), opacityv);
+      __m128 out_alpha;
+      __m128 valid;
+      __m128 o;
+
+      if (mask)
+        aux_alpha = _mm_mul_ps (aux_alpha, _mm_set1_ps (*mask++));
+
+      out_alpha = _mm_sub_ps (_mm_add_ps (aux_alpha, in_alpha),
+                              _mm_mul_ps (aux_alpha, in_alpha));
+      valid     = _mm_cmpneq_ps (out_alpha, zero);
+
+      o = _mm_add_ps (_mm_mul_ps (l, aux_alpha),
+                      _mm_mul_ps (_mm_mul_ps (i, in_alpha),
+                                  _mm_sub_ps (one, aux_alpha)));
+      o = _mm_div_ps (o, _mm_or_ps (_mm_and_ps    (valid, out_alpha),
+                                    _mm_andnot_ps (valid, one)));
+      o = _mm_or_ps (_mm_and_ps (valid, o), _mm_andnot_ps (valid, i));
+      o = _mm_or_ps (_mm_and_ps (color, o), _mm_andnot_ps (color, out_alpha));
+
+      _mm_storeu_ps (out, o);
+
+      in  += 4;
+      aux += 4;
+      out += 4;
+    }
+}
+
+#define LAYER_MODE_LOOP_SSE2(name, blend)                               \
+static void                                                             \
+gimp_layer_mode_##name##_loop_sse2 (const gfloat *in,                   \
+                                    const gfloat *layer,                \
+                                    const gfloat *mask,                 \
+                                    gfloat       *out,                  \
+                                    glong         samples,              \
+                                    gdouble       opacity)              \
+{                                                                       \
+  const __m128 zero     = _mm_setzero_ps ();                            \
+  const __m128 one      = _mm_set1_ps (1.0f);                           \
+  const __m128 color    = _mm_castsi128_ps (_mm_set_epi32 (0, -1, -1, -1)); \
+  const __m128 opacityv = _mm_set1_ps (opacity);                        \
+                                                                        \
+  while (samples--)                                                     \
+    {                                                                   \
+      __m128 i          = _mm_loadu_ps (in);                            \
+      __m128 l          = _mm_loadu_ps (layer);                         \
+      __m128 in_alpha   = SPLAT_ALPHA (i);                              \
+      __m128 comp_alpha = _mm_mul_ps (_mm_min_ps (in_alpha,             \
+                                                  SPLAT_ALPHA (l)),     \
+                                      opacityv);                        \
+      __m128 new_alpha;                                                 \
+      __m128 valid;                                                     \
+      __m128 ratio;                                                     \
+      __m128 o;                                                         \
+                                                                        \
+      if (mask)                                                         \
+        comp_alpha = _mm_mul_ps (comp_alpha, _mm_set1_ps (*mask++));    \
+                                                                        \
+      new_alpha = _mm_add_ps (in_alpha,                                 \
+                              _mm_mul_ps (_mm_sub_ps (one, in_alpha),   \
+                                          comp_alpha));                 \
+      valid     = _mm_and_ps (_mm_cmpneq_ps (comp_alpha, zero),         \
+                              _mm_cmpneq_ps (new_alpha,  zero));        \
+      ratio     = _mm_div_ps (_mm_and_ps (valid, comp_alpha),           \
+                              _mm_or_ps (_mm_and_ps    (valid, new_alpha), \
+                                         _mm_andnot_ps (valid, one)));  \
+                                                                        \
+      o = _mm_add_ps (_mm_mul_ps (blend (i, l), ratio),                 \
+                      _mm_mul_ps (i, _mm_sub_ps (one, ratio)));         \
+                                                                        \
+      valid = _mm_and_ps (valid, color);                                \
+      o = _mm_or_ps (_mm_and_ps (valid, o), _mm_andnot_ps (valid, i));  \
+                                                                        \
+      _mm_storeu_ps (out, o);                                           \
+                                                                        \
+      in    += 4;                                                       \
+      layer += 4;                                                       \
+      out   += 4;                                                       \
+    }                                                                   \
+}
+
+#define BLEND_MULTIPLY_SSE2(i, l) \
+  _mm_min_ps (_mm_max_ps (_mm_mul_ps ((l), (i)), zero), one)
+#define BLEND_SCREEN_SSE2(i, l) \
+  _mm_sub_ps (one, _mm_mul_ps (_mm_sub_ps (one, (i)), _mm_sub_ps (one, (l))))
+#define BLEND_DIFFERENCE_SSE2(i, l) \
+  _mm_max_ps (_mm_sub_ps ((i), (l)), _mm_sub_ps ((l), (i)))
+#define BLEND_ADDITION_SSE2(i, l) \
+  _mm_min_ps (_mm_max_ps (_mm_add_ps ((i), (l)), zero), one)
+#define BLEND_SUBTRACT_SSE2(i, l) \
+  _mm_max_ps (_mm_sub_ps ((i), (l)), zero)
+#define BLEND_DARKEN_SSE2(i, l) \
+  _mm_min_ps ((i), (l))
+#define BLEND_LIGHTEN_SSE2(i, l) \
+  _mm_max_ps ((l), (i))
+
+LAYER_MODE_LOOP_SSE2 (multiply,     BLEND_MULTIPLY_SSE2)
+LAYER_MODE_LOOP_SSE2 (screen,       BLEND_SCREEN_SSE2)
+LAYER_MODE_LOOP_SSE2 (difference,   BLEND_DIFFERENCE_SSE2)
+LAYER_MODE_LOOP_SSE2 (addition,     BLEND_ADDITION_SSE2)
+LAYER_MODE_LOOP_SSE2 (subtract,     BLEND_SUBTRACT_SSE2)
+LAYER_MODE_LOOP_SSE2 (darken_only,  BLEND_DARKEN_SSE2)
+LAYER_MODE_LOOP_SSE2 (lighten_only, BLEND_LIGHTEN_SSE2)
+
+GimpLayerModeLoopFunc
+gimp_operation_point_layer_mode_loop_sse2 (GimpLayerModeEffects mode)
+{
+  switch (mode)
+    {
+    case GIMP_NORMAL_MODE:       return gimp_layer_mode_normal_loop_sse2;
+    case GIMP_MULTIPLY_MODE:     return gimp_layer_mode_multiply_loop_sse2;
+    case GIMP_SCREEN_MODE:       return gimp_layer_mode_screen_loop_sse2;
+    case GIMP_DIFFERENCE_MODE:   return gimp_layer_mode_difference_loop_sse2;
+    case GIMP_ADDITION_MODE:     return gimp_layer_mode_addition_loop_sse2;
+    case GIMP_SUBTRACT_MODE:     return gimp_layer_mode_subtract_loop_sse2;
+    case GIMP_DARKEN_ONLY_MODE:  return gimp_layer_mode_darken_only_loop_sse2;
+    case GIMP_LIGHTEN_ONLY_MODE: return gimp_layer_mode_lighten_only_loop_sse2;
+
+    default:
+      return NULL;
+    }
+}
+
+#endif /* GIMP_LAYER_MODE_LOOPS_SSE2 */
+
+
+/*  private functions  */
+
+static void
+gimp_operation_point_layer_mode_loops_init (void)
+{
+  gint mode;
+
+  for (mode = 0; mode < N_LOOP_MODES; mode++)
+    {
+      loop_funcs[mode] = gimp_operation_point_layer_mode_loop_scalar (mode);
+
+#ifdef GIMP_LAYER_MODE_LOOPS_SSE2
+      if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+        {
+          GimpLayerModeLoopFunc func;
+
+          func = gimp_operation_point_layer_mode_loop_sse2 (mode);
+
+          if (func)
+            loop_funcs[mode] = func;
+        }
+#endif
+    }
+}
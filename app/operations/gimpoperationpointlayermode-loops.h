@@ -0,0 +1,64 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationpointlayermode-loops.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_OPERATION_POINT_LAYER_MODE_LOOPS_H__
+#define __GIMP_OPERATION_POINT_LAYER_MODE_LOOPS_H__
+
+
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define GIMP_LAYER_MODE_LOOPS_SSE2 1
+#endif
+
+
+/*  Composites samples pixels of "R'G'B'A float" layer over in, into
+ *  out. mask is "Y float" or NULL. in and out may be the same buffer.
+ */
+typedef void (* GimpLayerModeLoopFunc) (const gfloat *in,
+                                        const gfloat *layer,
+                                        const gfloat *mask,
+                                        gfloat       *out,
+                                        glong         samples,
+                                        gdouble       opacity);
+
+
+/*  Runs the fastest available loop for mode, which must be one of
+ *  the modes gimp_operation_point_layer_mode_loop_scalar() knows.
+ *  The normal mode loop is the one for non-premultiplied input.
+ */
+void                  gimp_operation_point_layer_mode_loop        (GimpLayerModeEffects  mode,
+                                                                   const gfloat         *in,
+                                                                   const gfloat         *layer,
+                                                                   const gfloat         *mask,
+                                                                   gfloat               *out,
+                                                                   glong                 samples,
+                                                                   gdouble               opacity);
+
+
+/*  the implementations behind the above, for testing, NULL if the
+ *  mode has no such loop
+ */
+
+GimpLayerModeLoopFunc gimp_operation_point_layer_mode_loop_scalar (GimpLayerModeEffects  mode);
+
+#ifdef GIMP_LAYER_MODE_LOOPS_SSE2
+GimpLayerModeLoopFunc gimp_operation_point_layer_mode_loop_sse2   (GimpLayerModeEffects  mode);
+#endif
+
+
+#endif /* __GIMP_OPERATION_POINT_LAYER_MODE_LOOPS_H__ */
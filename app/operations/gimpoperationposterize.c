@@ -51,6 +51,7 @@ gimp_operation_posterize_class_init (GimpOperationPosterizeClass *klass)
   GObjectClass                  *object_class    = G_OBJECT_CLASS (klass);
   GeglOperationClass            *operation_class = GEGL_OPERATION_CLASS (klass);
   GeglOperationPointFilterClass *point_class     = GEGL_OPERATION_POINT_FILTER_CLASS (klass);
+  GimpOperationPointFilterClass *filter_class    = GIMP_OPERATION_POINT_FILTER_CLASS (klass);
 
   object_class->set_property   = gimp_operation_point_filter_set_property;
   object_class->get_property   = gimp_operation_point_filter_get_property;
@@ -63,6 +64,8 @@ gimp_operation_posterize_class_init (GimpOperationPosterizeClass *klass)
 
   point_class->process = gimp_operation_posterize_process;
 
+  filter_class->per_channel = TRUE;
+
   g_object_class_install_property (object_class,
                                    GIMP_OPERATION_POINT_FILTER_PROP_CONFIG,
                                    g_param_spec_object ("config",
@@ -95,6 +98,9 @@ gimp_operation_posterize_process (GeglOperation       *operation,
   if (! config)
     return FALSE;
 
+  if (gimp_operation_point_filter_process_lut (point, in_buf, out_buf, samples))
+    return TRUE;
+
   levels = config->levels - 1.0;
 
   while (samples--)
@@ -182,6 +182,12 @@ gimp_operation_shapeburst_get_cached_region (GeglOperation       *self,
   return *gegl_operation_source_get_bounding_box (self, "input");
 }
 
+/*  The distance of a pixel is the cheapest 4-connected path to a
+ *  pixel that is off or outside the input, where entering a pixel of
+ *  value v costs v / 255. For a hard-edged input this is the city
+ *  block distance. It is computed in two linear passes, top-left to
+ *  bottom-right and back, keeping only two rows in memory.
+ */
 static gboolean
 gimp_operation_shapeburst_process (GeglOperation       *operation,
                                    GeglBuffer          *input,
@@ -192,125 +198,103 @@ gimp_operation_shapeburst_process (GeglOperation       *operation,
   const Babl *input_format   = babl_format ("Y u8");
   const Babl *output_format  = babl_format ("Y float");
   gfloat      max_iterations = 0.0;
-  gfloat     *distp_cur;
-  gfloat     *distp_prev;
-  gfloat     *memory;
-  gint        length;
+  guchar     *src;
+  gfloat     *dist_cur;
+  gfloat     *dist_prev;
   gint        i;
 
-  length = roi->width + 1;
-  memory = g_new (gfloat, length * 2);
-
-  distp_prev = memory;
-  for (i = 0; i < length; i++)
-    distp_prev[i] = 0.0;
-
-  distp_prev += 1;
-  distp_cur = distp_prev + length;
+  src       = g_new (guchar, roi->width);
+  dist_cur  = g_new (gfloat, roi->width);
+  dist_prev = g_new (gfloat, roi->width);
 
+  /*  forward pass, distances to the left and top  */
   for (i = 0; i < roi->height; i++)
     {
       gfloat *tmp;
-      gint    src = 0;
       gint    j;
 
-      /*  set the current dist row to 0's  */
-      memset (distp_cur - 1, 0, sizeof (gfloat) * (length - 1));
+      gegl_buffer_get (input,
+                       GEGL_RECTANGLE (roi->x, roi->y + i, roi->width, 1),
+                       1.0, input_format, src,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
       for (j = 0; j < roi->width; j++)
         {
-          gfloat float_tmp;
-          gfloat min_prev = MIN (distp_cur[j-1], distp_prev[j]);
-          gint   min_left = MIN ((roi->width - j - 1), (roi->height - i - 1));
-          gint   min      = (gint) MIN (min_left, min_prev);
-          gint   fraction = 255;
-          gint   k;
-
-          /*  This might need to be changed to 0
-              instead of k = (min) ? (min - 1) : 0  */
+          if (src[j])
+            {
+              gfloat left = j > 0 ? dist_cur[j - 1] : 0.0;
+              gfloat top  = i > 0 ? dist_prev[j]    : 0.0;
 
-          for (k = (min) ? (min - 1) : 0; k <= min; k++)
+              dist_cur[j] = MIN (left, top) + src[j] / 255.0;
+            }
+          else
             {
-              gint x   = j;
-              gint y   = i + k;
-              gint end = y - k;
-
-              while (y >= end)
-                {
-                  guchar src_uchar;
-
-#if 1
-                  /* FIXME: this should be much faster, it converts
-                   * to 32 bit rgba intermediately, bah...
-                   */
-                  gegl_buffer_sample (input, x, y, NULL, &src_uchar,
-                                      input_format,
-                                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-#else
-                  gegl_buffer_get (input, GEGL_RECTANGLE (x, y, 1, 1), 1.0,
-                                   input_format, &src_uchar,
-                                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-#endif
-
-                  src = src_uchar;
-
-                  if (src == 0)
-                    {
-                      min = k;
-                      y = -1;
-                      break;
-                    }
-
-                  if (src < fraction)
-                    fraction = src;
-
-                  x++;
-                  y--;
-                }
+              dist_cur[j] = 0.0;
             }
+        }
 
-          if (src != 0)
-            {
-              /*  If min_left != min_prev use the previous fraction
-               *   if it is less than the one found
-               */
-              if (min_left != min)
-                {
-                  gint prev_frac = (int) (255 * (min_prev - min));
+      gegl_buffer_set (output,
+                       GEGL_RECTANGLE (roi->x, roi->y + i, roi->width, 1),
+                       0, output_format, dist_cur,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      tmp       = dist_prev;
+      dist_prev = dist_cur;
+      dist_cur  = tmp;
 
-                  if (prev_frac == 255)
-                    prev_frac = 0;
+      g_object_set (operation,
+                    "progress", 0.5 * i / roi->height,
+                    NULL);
+    }
 
-                  fraction = MIN (fraction, prev_frac);
-                }
+  /*  backward pass, distances to the right and bottom  */
+  for (i = roi->height - 1; i >= 0; i--)
+    {
+      gfloat *tmp;
+      gint    j;
 
-              min++;
-            }
+      gegl_buffer_get (input,
+                       GEGL_RECTANGLE (roi->x, roi->y + i, roi->width, 1),
+                       1.0, input_format, src,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      gegl_buffer_get (output,
+                       GEGL_RECTANGLE (roi->x, roi->y + i, roi->width, 1),
+                       1.0, output_format, dist_cur,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-          float_tmp = distp_cur[j] = min + fraction / 256.0;
+      for (j = roi->width - 1; j >= 0; j--)
+        {
+          if (src[j])
+            {
+              gfloat right  = j < roi->width  - 1 ? dist_cur[j + 1] : 0.0;
+              gfloat bottom = i < roi->height - 1 ? dist_prev[j]    : 0.0;
+              gfloat dist   = MIN (right, bottom) + src[j] / 255.0;
 
-          if (float_tmp > max_iterations)
-            max_iterations = float_tmp;
+              if (dist < dist_cur[j])
+                dist_cur[j] = dist;
+
+              if (dist_cur[j] > max_iterations)
+                max_iterations = dist_cur[j];
+            }
         }
 
-      /*  set the dist row  */
       gegl_buffer_set (output,
-                       GEGL_RECTANGLE (roi->x, roi->y + i,
-                                       roi->width, 1),
-                       1.0, output_format, distp_cur,
+                       GEGL_RECTANGLE (roi->x, roi->y + i, roi->width, 1),
+                       0, output_format, dist_cur,
                        GEGL_AUTO_ROWSTRIDE);
 
-      /*  swap pointers around  */
-      tmp = distp_prev;
-      distp_prev = distp_cur;
-      distp_cur = tmp;
+      tmp       = dist_prev;
+      dist_prev = dist_cur;
+      dist_cur  = tmp;
 
       g_object_set (operation,
-                    "progress", (gdouble) i / roi->height,
+                    "progress", 0.5 + 0.5 * (roi->height - i) / roi->height,
                     NULL);
     }
 
-  g_free (memory);
+  g_free (src);
+  g_free (dist_cur);
+  g_free (dist_prev);
 
   g_object_set (operation,
                 "max-iterations", (gdouble) max_iterations,
@@ -29,6 +29,7 @@
 
 #include "operations-types.h"
 
+#include "gimpdistancetransform.h"
 #include "gimpoperationshrink.h"
 
 
@@ -266,6 +267,13 @@ gimp_operation_shrink_process (GeglOperation       *operation,
   guchar              *buffer;
   gint                 buffer_size;
 
+  if (MAX (self->radius_x, self->radius_y) >=
+      GIMP_DISTANCE_TRANSFORM_MIN_RADIUS &&
+      gimp_distance_transform_dilate (input, output, roi,
+                                      self->radius_x, self->radius_y,
+                                      TRUE, ! self->edge_lock))
+    return TRUE;
+
   max = g_new (guchar *, roi->width + 2 * self->radius_x);
   buf = g_new (guchar *, self->radius_y + 1);
 
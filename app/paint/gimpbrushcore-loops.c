@@ -0,0 +1,317 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpbrushcore-loops.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "gimpbrushcore-kernels.h"
+#include "gimpbrushcore-loops.h"
+
+#ifdef GIMP_BRUSH_CORE_LOOPS_SSE2
+#include <emmintrin.h>
+#endif
+
+
+typedef void (* GimpSubsampleFunc) (const guchar *src,
+                                    gint          src_width,
+                                    gint          src_height,
+                                    guchar       *dest,
+                                    gint          dest_width,
+                                    gint          dest_height,
+                                    gint          dest_offset_x,
+                                    gint          dest_offset_y,
+                                    const gint   *kernel);
+typedef void (* GimpSolidifyFunc)  (const guchar *src,
+                                    guchar       *dest,
+                                    gint          n_pixels);
+
+
+static void   gimp_brush_core_loops_init (void);
+
+
+static GimpSubsampleFunc subsample_func = NULL;
+static GimpSolidifyFunc  solidify_func  = NULL;
+
+
+/*  public functions  */
+
+void
+gimp_brush_core_subsample_loop (const guchar *src,
+                                gint          src_width,
+                                gint          src_height,
+                                guchar       *dest,
+                                gint          dest_width,
+                                gint          dest_height,
+                                gint          dest_offset_x,
+                                gint          dest_offset_y,
+                                gint          kernel_x,
+                                gint          kernel_y)
+{
+  g_return_if_fail (kernel_x >= 0 && kernel_x <= KERNEL_SUBSAMPLE);
+  g_return_if_fail (kernel_y >= 0 && kernel_y <= KERNEL_SUBSAMPLE);
+
+  if (G_UNLIKELY (! subsample_func))
+    gimp_brush_core_loops_init ();
+
+  subsample_func (src, src_width, src_height,
+                  dest, dest_width, dest_height,
+                  dest_offset_x, dest_offset_y,
+                  subsample[kernel_y][kernel_x]);
+}
+
+void
+gimp_brush_core_solidify_loop (const guchar *src,
+                               guchar       *dest,
+                               gint          n_pixels)
+{
+  if (G_UNLIKELY (! solidify_func))
+    gimp_brush_core_loops_init ();
+
+  solidify_func (src, dest, n_pixels);
+}
+
+
+/*  scalar implementations  */
+
+static inline void
+rotate_pointers (gulong  **p,
+                 guint32   n)
+{
+  guint32  i;
+  gulong  *tmp;
+
+  tmp = p[0];
+
+  for (i = 0; i < n-1; i++)
+    p[i] = p[i+1];
+
+  p[i] = tmp;
+}
+
+void
+gimp_brush_core_subsample_loop_scalar (const guchar *src,
+                                       gint          src_width,
+                                       gint          src_height,
+                                       guchar       *dest,
+                                       gint          dest_width,
+                                       gint          dest_height,
+                                       gint          dest_offset_x,
+                                       gint          dest_offset_y,
+                                       const gint   *kernel)
+{
+  const guchar *m = src;
+  guchar       *d;
+  const gint   *k;
+  gulong       *accum[KERNEL_HEIGHT];
+  gint          offs;
+  gint          i, j;
+  gint          r, s;
+
+  /* Allocate and initialize the accum buffer */
+  for (i = 0; i < KERNEL_HEIGHT ; i++)
+    accum[i] = g_new0 (gulong, dest_width + 1);
+
+  for (i = 0; i < src_height; i++)
+    {
+      for (j = 0; j < src_width; j++)
+        {
+          k = kernel;
+          for (r = 0; r < KERNEL_HEIGHT; r++)
+            {
+              offs = j + dest_offset_x;
+              s = KERNEL_WIDTH;
+              while (s--)
+                accum[r][offs++] += *m * *k++;
+            }
+          m++;
+        }
+
+      /* store the accum buffer into the destination mask */
+      d = dest + (i + dest_offset_y) * dest_width;
+      for (j = 0; j < dest_width; j++)
+        *d++ = (accum[0][j] + 127) / KERNEL_SUM;
+
+      rotate_pointers (accum, KERNEL_HEIGHT);
+
+      memset (accum[KERNEL_HEIGHT - 1], 0, sizeof (gulong) * dest_width);
+    }
+
+  /* store the rest of the accum buffer into the dest mask */
+  while (i + dest_offset_y < dest_height)
+    {
+      d = dest + (i + dest_offset_y) * dest_width;
+      for (j = 0; j < dest_width; j++)
+        *d++ = (accum[0][j] + (KERNEL_SUM / 2)) / KERNEL_SUM;
+
+      rotate_pointers (accum, KERNEL_HEIGHT);
+      i++;
+    }
+
+  for (i = 0; i < KERNEL_HEIGHT ; i++)
+    g_free (accum[i]);
+}
+
+void
+gimp_brush_core_solidify_loop_scalar (const guchar *src,
+                                      guchar       *dest,
+                                      gint          n_pixels)
+{
+  while (n_pixels--)
+    *dest++ = (*src++) ? 255 : 0;
+}
+
+
+/*  SSE2 implementations  */
+
+#ifdef GIMP_BRUSH_CORE_LOOPS_SSE2
+
+/*  Instead of scattering every source pixel into three accumulator
+ *  rows, this gathers the (at most) nine contributions for each
+ *  destination row. The kernels sum up to KERNEL_SUM, so 8 bit pixels
+ *  times kernel weights fit into 16 bit lanes, and the result is the
+ *  same as the scalar code's, including its rounding.
+ */
+void
+gimp_brush_core_subsample_loop_sse2 (const guchar *src,
+                                     gint          src_width,
+                                     gint          src_height,
+                                     guchar       *dest,
+                                     gint          dest_width,
+                                     gint          dest_height,
+                                     gint          dest_offset_x,
+                                     gint          dest_offset_y,
+                                     const gint   *kernel)
+{
+  const __m128i  zero = _mm_setzero_si128 ();
+  guint16       *accum;
+  gint           y;
+
+  accum = g_new (guint16, dest_width + 1);
+
+  for (y = dest_offset_y; y < dest_height; y++)
+    {
+      gint     i    = y - dest_offset_y;
+      guint16  bias = (i < src_height) ? 127 : (KERNEL_SUM / 2);
+      guchar  *d    = dest + y * dest_width;
+      __m128i  vbias;
+      gint     r, s, j;
+
+      memset (accum, 0, sizeof (guint16) * (dest_width + 1));
+
+      for (r = 0; r < KERNEL_HEIGHT; r++)
+        {
+          const guchar *m;
+
+          if (i - r < 0 || i - r >= src_height)
+            continue;
+
+          m = src + (i - r) * src_width;
+
+          for (s = 0; s < KERNEL_WIDTH; s++)
+            {
+              guint16  weight = kernel[r * KERNEL_WIDTH + s];
+              guint16 *a      = accum + dest_offset_x + s;
+              __m128i  vweight;
+
+              if (! weight)
+                continue;
+
+              vweight = _mm_set1_epi16 (weight);
+
+              for (j = 0; j + 8 <= src_width; j += 8)
+                {
+                  __m128i pixels = _mm_loadl_epi64 ((const __m128i *) (m + j));
+                  __m128i sum    = _mm_loadu_si128 ((const __m128i *) (a + j));
+
+                  pixels = _mm_unpacklo_epi8 (pixels, zero);
+                  sum    = _mm_add_epi16 (sum, _mm_mullo_epi16 (pixels,
+                                                                vweight));
+
+                  _mm_storeu_si128 ((__m128i *) (a + j), sum);
+                }
+
+              for (; j < src_width; j++)
+                a[j] += m[j] * weight;
+            }
+        }
+
+      vbias = _mm_set1_epi16 (bias);
+
+      for (j = 0; j + 16 <= dest_width; j += 16)
+        {
+          __m128i lo = _mm_loadu_si128 ((const __m128i *) (accum + j));
+          __m128i hi = _mm_loadu_si128 ((const __m128i *) (accum + j + 8));
+
+          lo = _mm_srli_epi16 (_mm_adds_epu16 (lo, vbias), 8);
+          hi = _mm_srli_epi16 (_mm_adds_epu16 (hi, vbias), 8);
+
+          _mm_storeu_si128 ((__m128i *) (d + j), _mm_packus_epi16 (lo, hi));
+        }
+
+      for (; j < dest_width; j++)
+        d[j] = (accum[j] + bias) / KERNEL_SUM;
+    }
+
+  g_free (accum);
+}
+
+void
+gimp_brush_core_solidify_loop_sse2 (const guchar *src,
+                                    guchar       *dest,
+                                    gint          n_pixels)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i ones = _mm_set1_epi8 (-1);
+
+  for (; n_pixels >= 16; n_pixels -= 16, src += 16, dest += 16)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) src);
+
+      pixels = _mm_andnot_si128 (_mm_cmpeq_epi8 (pixels, zero), ones);
+
+      _mm_storeu_si128 ((__m128i *) dest, pixels);
+    }
+
+  gimp_brush_core_solidify_loop_scalar (src, dest, n_pixels);
+}
+
+#endif /* GIMP_BRUSH_CORE_LOOPS_SSE2 */
+
+
+/*  private functions  */
+
+static void
+gimp_brush_core_loops_init (void)
+{
+  subsample_func = gimp_brush_core_subsample_loop_scalar;
+  solidify_func  = gimp_brush_core_solidify_loop_scalar;
+
+#ifdef GIMP_BRUSH_CORE_LOOPS_SSE2
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+    {
+      subsample_func = gimp_brush_core_subsample_loop_sse2;
+      solidify_func  = gimp_brush_core_solidify_loop_sse2;
+    }
+#endif
+}
@@ -0,0 +1,82 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpbrushcore-loops.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_BRUSH_CORE_LOOPS_H__
+#define __GIMP_BRUSH_CORE_LOOPS_H__
+
+
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define GIMP_BRUSH_CORE_LOOPS_SSE2 1
+#endif
+
+
+/*  Applies the subsampling kernel for the subpixel position
+ *  (kernel_x, kernel_y), both in [0, BRUSH_CORE_SUBSAMPLE], to a
+ *  src_width x src_height mask. dest must be cleared and
+ *  (src_width + 2) x (src_height + 2) pixels.
+ */
+void   gimp_brush_core_subsample_loop        (const guchar *src,
+                                              gint          src_width,
+                                              gint          src_height,
+                                              guchar       *dest,
+                                              gint          dest_width,
+                                              gint          dest_height,
+                                              gint          dest_offset_x,
+                                              gint          dest_offset_y,
+                                              gint          kernel_x,
+                                              gint          kernel_y);
+
+/*  Sets every non-zero pixel of a row to 255  */
+void   gimp_brush_core_solidify_loop         (const guchar *src,
+                                              guchar       *dest,
+                                              gint          n_pixels);
+
+
+/*  the implementations behind the above, for testing  */
+
+void   gimp_brush_core_subsample_loop_scalar (const guchar *src,
+                                              gint          src_width,
+                                              gint          src_height,
+                                              guchar       *dest,
+                                              gint          dest_width,
+                                              gint          dest_height,
+                                              gint          dest_offset_x,
+                                              gint          dest_offset_y,
+                                              const gint   *kernel);
+void   gimp_brush_core_solidify_loop_scalar  (const guchar *src,
+                                              guchar       *dest,
+                                              gint          n_pixels);
+
+#ifdef GIMP_BRUSH_CORE_LOOPS_SSE2
+void   gimp_brush_core_subsample_loop_sse2   (const guchar *src,
+                                              gint          src_width,
+                                              gint          src_height,
+                                              guchar       *dest,
+                                              gint          dest_width,
+                                              gint          dest_height,
+                                              gint          dest_offset_x,
+                                              gint          dest_offset_y,
+                                              const gint   *kernel);
+void   gimp_brush_core_solidify_loop_sse2    (const guchar *src,
+                                              guchar       *dest,
+                                              gint          n_pixels);
+#endif
+
+
+#endif /* __GIMP_BRUSH_CORE_LOOPS_H__ */
@@ -37,7 +37,7 @@
 #include "core/gimptempbuf.h"
 
 #include "gimpbrushcore.h"
-#include "gimpbrushcore-kernels.h"
+#include "gimpbrushcore-loops.h"
 
 #include "gimppaintoptions.h"
 
@@ -219,11 +219,9 @@ gimp_brush_core_init (GimpBrushCore *core)
                                                     BRUSH_CORE_JITTER_LUTSIZE));
     }
 
-  g_assert (BRUSH_CORE_SUBSAMPLE == KERNEL_SUBSAMPLE);
-
-  for (i = 0; i < KERNEL_SUBSAMPLE + 1; i++)
+  for (i = 0; i < BRUSH_CORE_SUBSAMPLE + 1; i++)
     {
-      for (j = 0; j < KERNEL_SUBSAMPLE + 1; j++)
+      for (j = 0; j < BRUSH_CORE_SUBSAMPLE + 1; j++)
         {
           core->subsample_brushes[i][j] = NULL;
         }
@@ -256,8 +254,8 @@ gimp_brush_core_finalize (GObject *object)
       core->rand = NULL;
     }
 
-  for (i = 0; i < KERNEL_SUBSAMPLE + 1; i++)
-    for (j = 0; j < KERNEL_SUBSAMPLE + 1; j++)
+  for (i = 0; i < BRUSH_CORE_SUBSAMPLE + 1; i++)
+    for (j = 0; j < BRUSH_CORE_SUBSAMPLE + 1; j++)
       if (core->subsample_brushes[i][j])
         {
           gimp_temp_buf_unref (core->subsample_brushes[i][j]);
@@ -1024,21 +1022,6 @@ gimp_brush_core_invalidate_cache (GimpBrush     *brush,
  *             LOCAL FUNCTION DEFINITIONS                   *
  ************************************************************/
 
-static inline void
-rotate_pointers (gulong  **p,
-                 guint32   n)
-{
-  guint32  i;
-  gulong  *tmp;
-
-  tmp = p[0];
-
-  for (i = 0; i < n-1; i++)
-    p[i] = p[i+1];
-
-  p[i] = tmp;
-}
-
 static const GimpTempBuf *
 gimp_brush_core_subsample_mask (GimpBrushCore     *core,
                                 const GimpTempBuf *mask,
@@ -1047,18 +1030,11 @@ gimp_brush_core_subsample_mask (GimpBrushCore     *core,
 {
   GimpTempBuf  *dest;
   gdouble       left;
-  const guchar *m;
-  guchar       *d;
-  const gint   *k;
   gint          index1;
   gint          index2;
   gint          dest_offset_x = 0;
   gint          dest_offset_y = 0;
-  const gint   *kernel;
   gint          i, j;
-  gint          r, s;
-  gulong       *accum[KERNEL_HEIGHT];
-  gint          offs;
   gint          mask_width  = gimp_temp_buf_get_width  (mask);
   gint          mask_height = gimp_temp_buf_get_height (mask);
   gint          dest_width;
@@ -1068,40 +1044,38 @@ gimp_brush_core_subsample_mask (GimpBrushCore     *core,
     x += mask_width;
 
   left = x - floor (x);
-  index1 = (gint) (left * (gdouble) (KERNEL_SUBSAMPLE + 1));
+  index1 = (gint) (left * (gdouble) (BRUSH_CORE_SUBSAMPLE + 1));
 
   while (y < 0)
     y += mask_height;
 
   left = y - floor (y);
-  index2 = (gint) (left * (gdouble) (KERNEL_SUBSAMPLE + 1));
+  index2 = (gint) (left * (gdouble) (BRUSH_CORE_SUBSAMPLE + 1));
 
 
   if ((mask_width % 2) == 0)
     {
-      index1 += KERNEL_SUBSAMPLE >> 1;
+      index1 += BRUSH_CORE_SUBSAMPLE >> 1;
 
-      if (index1 > KERNEL_SUBSAMPLE)
+      if (index1 > BRUSH_CORE_SUBSAMPLE)
         {
-          index1 -= KERNEL_SUBSAMPLE + 1;
+          index1 -= BRUSH_CORE_SUBSAMPLE + 1;
           dest_offset_x = 1;
         }
     }
 
   if ((mask_height % 2) == 0)
     {
-      index2 += KERNEL_SUBSAMPLE >> 1;
+      index2 += BRUSH_CORE_SUBSAMPLE >> 1;
 
-      if (index2 > KERNEL_SUBSAMPLE)
+      if (index2 > BRUSH_CORE_SUBSAMPLE)
         {
-          index2 -= KERNEL_SUBSAMPLE + 1;
+          index2 -= BRUSH_CORE_SUBSAMPLE + 1;
           dest_offset_y = 1;
         }
     }
 
 
-  kernel = subsample[index2][index1];
-
   if (mask == core->last_subsample_brush_mask &&
       ! core->subsample_cache_invalid)
     {
@@ -1110,8 +1084,8 @@ gimp_brush_core_subsample_mask (GimpBrushCore     *core,
     }
   else
     {
-      for (i = 0; i < KERNEL_SUBSAMPLE + 1; i++)
-        for (j = 0; j < KERNEL_SUBSAMPLE + 1; j++)
+      for (i = 0; i < BRUSH_CORE_SUBSAMPLE + 1; i++)
+        for (j = 0; j < BRUSH_CORE_SUBSAMPLE + 1; j++)
           if (core->subsample_brushes[i][j])
             {
               gimp_temp_buf_unref (core->subsample_brushes[i][j]);
@@ -1130,51 +1104,14 @@ gimp_brush_core_subsample_mask (GimpBrushCore     *core,
   dest_width  = gimp_temp_buf_get_width  (dest);
   dest_height = gimp_temp_buf_get_height (dest);
 
-  /* Allocate and initialize the accum buffer */
-  for (i = 0; i < KERNEL_HEIGHT ; i++)
-    accum[i] = g_new0 (gulong, dest_width + 1);
-
   core->subsample_brushes[index2][index1] = dest;
 
-  m = gimp_temp_buf_get_data (mask);
-  for (i = 0; i < mask_height; i++)
-    {
-      for (j = 0; j < mask_width; j++)
-        {
-          k = kernel;
-          for (r = 0; r < KERNEL_HEIGHT; r++)
-            {
-              offs = j + dest_offset_x;
-              s = KERNEL_WIDTH;
-              while (s--)
-                accum[r][offs++] += *m * *k++;
-            }
-          m++;
-        }
-
-      /* store the accum buffer into the destination mask */
-      d = gimp_temp_buf_get_data (dest) + (i + dest_offset_y) * dest_width;
-      for (j = 0; j < dest_width; j++)
-        *d++ = (accum[0][j] + 127) / KERNEL_SUM;
-
-      rotate_pointers (accum, KERNEL_HEIGHT);
-
-      memset (accum[KERNEL_HEIGHT - 1], 0, sizeof (gulong) * dest_width);
-    }
-
-  /* store the rest of the accum buffer into the dest mask */
-  while (i + dest_offset_y < dest_height)
-    {
-      d = gimp_temp_buf_get_data (dest) + (i + dest_offset_y) * dest_width;
-      for (j = 0; j < dest_width; j++)
-        *d++ = (accum[0][j] + (KERNEL_SUM / 2)) / KERNEL_SUM;
-
-      rotate_pointers (accum, KERNEL_HEIGHT);
-      i++;
-    }
-
-  for (i = 0; i < KERNEL_HEIGHT ; i++)
-    g_free (accum[i]);
+  gimp_brush_core_subsample_loop (gimp_temp_buf_get_data (mask),
+                                  mask_width, mask_height,
+                                  gimp_temp_buf_get_data (dest),
+                                  dest_width, dest_height,
+                                  dest_offset_x, dest_offset_y,
+                                  index1, index2);
 
   return dest;
 }
@@ -1366,10 +1303,10 @@ gimp_brush_core_solidify_mask (GimpBrushCore     *core,
 
   for (i = 0; i < brush_mask_height; i++)
     {
-      for (j = 0; j < brush_mask_width; j++)
-        *d++ = (*m++) ? 255 : 0;
+      gimp_brush_core_solidify_loop (m, d, brush_mask_width);
 
-      d += 2;
+      m += brush_mask_width;
+      d += brush_mask_width + 2;
     }
 
   return dest;
@@ -1656,9 +1593,9 @@ gimp_brush_core_paint_line_pixmap_mask (GimpDrawable             *drawable,
       guchar       *l        = line_buf;
       gint          i;
 
-      fish = babl_fish (gimp_babl_format (pixmap_base_type, pixmap_precision,
-                                          TRUE),
-                        gimp_drawable_get_format_with_alpha (drawable));
+      fish = gimp_babl_fish (gimp_babl_format (pixmap_base_type,
+                                               pixmap_precision, TRUE),
+                             gimp_drawable_get_format_with_alpha (drawable));
 
       /* put the source pixmap's pixels, plus the mask's alpha, into
        * one line, so we can use one single call to babl_process() to
@@ -1676,7 +1613,7 @@ gimp_brush_core_paint_line_pixmap_mask (GimpDrawable             *drawable,
           *l++ = mask[x_index];
         }
 
-      babl_process (fish, line_buf, d, width);
+      gimp_babl_process (fish, line_buf, d, width);
     }
   else
     {
@@ -1685,8 +1622,8 @@ gimp_brush_core_paint_line_pixmap_mask (GimpDrawable             *drawable,
       guchar     *l        = line_buf;
       gint        i;
 
-      fish = babl_fish (pixmap_format,
-                        gimp_drawable_get_format_with_alpha (drawable));
+      fish = gimp_babl_fish (pixmap_format,
+                             gimp_drawable_get_format_with_alpha (drawable));
 
       /* put the source pixmap's pixels into one line, so we can use
        * one single call to babl_process() to convert the entire line
@@ -1701,6 +1638,6 @@ gimp_brush_core_paint_line_pixmap_mask (GimpDrawable             *drawable,
             *l++ = *p++;
         }
 
-      babl_process (fish, line_buf, d, width);
+      gimp_babl_process (fish, line_buf, d, width);
     }
 }
@@ -48,10 +48,11 @@
  * but substract them I2 = I0 - I1, where I0 is the sample image to be
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
- * mask. The solver is a unoptimized red/black checker Gauss-Siedel
- * with an over-relaxation factor of 1.8. It can benefit from a
- * multi-grid evaluation of an initial solution before the main
- * iteration loop.
+ * mask. The solver is a multigrid one: V-cycles smooth the error with
+ * a few red/black checker Gauss-Siedel iterations, then solve for the
+ * remaining, smooth part of it at half the resolution, recursively.
+ * Each cycle reduces the error by about a factor of ten, whatever the
+ * size of the brush, so a few cycles are enough.
  *
  * I reduced the convergence criteria to 0.1% (0.001) as we are
  * dealing here with RGB integer components, more is overkill.
@@ -143,7 +144,7 @@ gimp_heal_start (GimpPaintCore     *paint_core,
   return TRUE;
 }
 
-/* Subtract bottom from top and store in result as a double
+/* Subtract bottom from top and store in result as a float
  */
 static void
 gimp_heal_sub (GeglBuffer          *top_buffer,
@@ -167,18 +168,18 @@ gimp_heal_sub (GeglBuffer          *top_buffer,
                             GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
 
   gegl_buffer_iterator_add (iter, result_buffer, result_rect, 0,
-                            babl_format_n (babl_type ("double"), bpp),
+                            babl_format_n (babl_type ("float"), bpp),
                             GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
     {
       guchar  *t      = iter->data[0];
       guchar  *b      = iter->data[1];
-      gdouble *r      = iter->data[2];
+      gfloat  *r      = iter->data[2];
       gint     length = iter->length * bpp;
 
       while (length--)
-        *r++ = (gdouble) *t++ - (gdouble) *b++;
+        *r++ = (gfloat) *t++ - (gfloat) *b++;
     }
 
   gegl_buffer_set_format (top_buffer, NULL);
@@ -203,7 +204,7 @@ gimp_heal_add (GeglBuffer          *first_buffer,
   gegl_buffer_set_format (result_buffer, babl_format_n (babl_type ("u8"), bpp));
 
   iter = gegl_buffer_iterator_new (first_buffer, first_rect, 0,
-                                   babl_format_n (babl_type ("double"), bpp),
+                                   babl_format_n (babl_type ("float"), bpp),
                                    GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
 
   gegl_buffer_iterator_add (iter, second_buffer, second_rect, 0, NULL,
@@ -214,14 +215,14 @@ gimp_heal_add (GeglBuffer          *first_buffer,
 
   while (gegl_buffer_iterator_next (iter))
     {
-      gdouble *f      = iter->data[0];
+      gfloat  *f      = iter->data[0];
       guchar  *s      = iter->data[1];
       guchar  *r      = iter->data[2];
       gint     length = iter->length * bpp;
 
       while (length--)
         {
-          gdouble tmp = ROUND (*f++ + (gdouble) *s++);
+          gfloat tmp = ROUND (*f++ + (gfloat) *s++);
 
           *r++ = (guchar) CLAMP0255 (tmp);
         }
@@ -231,112 +232,125 @@ gimp_heal_add (GeglBuffer          *first_buffer,
   gegl_buffer_set_format (result_buffer, NULL);
 }
 
-/* Perform one iteration of the laplace solver for matrix.  Store the
- * result in solution and return the square of the cummulative error
- * of the solution.
+/* One level of the multigrid solver, the finest level holds the
+ * image, each coarser one half the resolution of the one before it.
  */
-static gdouble
-gimp_heal_laplace_iteration (gdouble *matrix,
-                             gint     height,
-                             gint     depth,
-                             gint     width,
-                             gdouble *solution,
-                             guchar  *mask)
+typedef struct
 {
-  const gint    rowstride = width * depth;
-  gint          i, j, k, off, offm, offm0, off0;
-  gdouble       tmp, diff;
-  gdouble       err       = 0.0;
-  const gdouble w         = 1.80 * 0.25; /* Over-relaxation = 1.8 */
-
-  /* we use a red/black checker model of the discretization grid */
+  gint    width;
+  gint    height;
+  gfloat *solution;  /* the correction to the level above on coarse levels */
+  gfloat *rhs;       /* NULL on the finest level, where it is 0            */
+  gfloat *residual;
+  guchar *interior;  /* where the solution is unknown                      */
+} HealLevel;
+
+#define MIN_LEVEL_SIZE  8
+#define MAX_LEVELS      16
+#define N_SMOOTH        2    /* red/black sweeps before and after each cycle */
+#define N_COARSE        32   /* red/black sweeps on the coarsest level       */
+#define OMEGA_SMOOTH    1.2f
+#define OMEGA_COARSE    1.5f
+#define EPSILON         0.001
+#define MAX_CYCLES      10
+
+
+/* Perform n_sweeps red/black Gauss-Seidel iterations of the laplace
+ * solver for level, in place.
+ */
+static void
+gimp_heal_laplace_iteration (HealLevel *level,
+                             gint       depth,
+                             gint       n_sweeps,
+                             gfloat     omega)
+{
+  const gint   rowstride = level->width * depth;
+  const gfloat w         = omega * 0.25f;
+  gint         sweep;
+  gint         color;
+  gint         i, j, k;
 
-  /* do reds */
-  for (i = 0; i < height; i++)
+  for (sweep = 0; sweep < n_sweeps; sweep++)
     {
-      off0  = i * rowstride;
-      offm0 = i * width;
-
-      for (j = i % 2; j < width; j += 2)
+      /* we use a red/black checker model of the discretization grid,
+       * the blacks use the reds updated just before them
+       */
+      for (color = 0; color < 2; color++)
         {
-          off  = off0 + j * depth;
-          offm = offm0 + j;
-
-          if ((0 == mask[offm]) ||
-              (i == 0) || (i == (height - 1)) ||
-              (j == 0) || (j == (width - 1)))
+          for (i = 1; i < level->height - 1; i++)
             {
-              /* do nothing at the boundary or outside mask */
-              for (k = 0; k < depth; k++)
-                solution[off + k] = matrix[off + k];
-            }
-          else
-            {
-              /* Use Gauss Siedel to get the correction factor then
-               * over-relax it
-               */
-              for (k = 0; k < depth; k++)
+              const guchar *m = level->interior + i * level->width;
+              gfloat       *s = level->solution + i * rowstride;
+              const gfloat *r = level->rhs ? level->rhs + i * rowstride : NULL;
+
+              for (j = 1 + ((i + color + 1) & 1); j < level->width - 1; j += 2)
                 {
-                  tmp = solution[off + k];
-                  solution[off + k] = (matrix[off + k] +
-                                       w *
-                                       (matrix[off - depth + k] +     /* west */
-                                        matrix[off + depth + k] +     /* east */
-                                        matrix[off - rowstride + k] + /* north */
-                                        matrix[off + rowstride + k] - 4.0 *
-                                        matrix[off+k]));              /* south */
-
-                  diff = solution[off + k] - tmp;
-                  err += diff * diff;
+                  gfloat *p = s + j * depth;
+
+                  if (! m[j])
+                    continue;
+
+                  /* Use Gauss Siedel to get the correction factor then
+                   * over-relax it
+                   */
+                  for (k = 0; k < depth; k++)
+                    {
+                      gfloat laplace = (p[k - depth] +     /* west  */
+                                        p[k + depth] +     /* east  */
+                                        p[k - rowstride] + /* north */
+                                        p[k + rowstride] - /* south */
+                                        4.0f * p[k]);
+
+                      if (r)
+                        laplace -= r[j * depth + k];
+
+                      p[k] += w * laplace;
+                    }
                 }
             }
         }
     }
+}
 
+/* Store rhs - laplace (solution) of level in its residual and return
+ * the square of the cummulative residual.
+ */
+static gfloat
+gimp_heal_laplace_residual (HealLevel *level,
+                            gint       depth)
+{
+  const gint rowstride = level->width * depth;
+  gfloat     err       = 0.0f;
+  gint       i, j, k;
 
-  /* Do blacks
-   *
-   * As we've done the reds earlier, we can use them right now to
-   * accelerate the convergence. So we have "solution" in the solver
-   * instead of "matrix" above
-   */
-  for (i = 0; i < height; i++)
+  memset (level->residual, 0,
+          level->width * level->height * depth * sizeof (gfloat));
+
+  for (i = 1; i < level->height - 1; i++)
     {
-      off0 =  i * rowstride;
-      offm0 = i * width;
+      const guchar *m    = level->interior + i * level->width;
+      const gfloat *s    = level->solution + i * rowstride;
+      gfloat       *res  = level->residual + i * rowstride;
+      const gfloat *r    = level->rhs ? level->rhs + i * rowstride : NULL;
 
-      for (j = (i % 2) ? 0 : 1; j < width; j += 2)
+      for (j = 1; j < level->width - 1; j++)
         {
-          off = off0 + j * depth;
-          offm = offm0 + j;
+          const gfloat *p = s + j * depth;
 
-          if ((0 == mask[offm]) ||
-              (i == 0) || (i == (height - 1)) ||
-              (j == 0) || (j == (width - 1)))
-            {
-              /* do nothing at the boundary or outside mask */
-              for (k = 0; k < depth; k++)
-                solution[off + k] = matrix[off + k];
-            }
-          else
+          if (! m[j])
+            continue;
+
+          for (k = 0; k < depth; k++)
             {
-              /* Use Gauss Siedel to get the correction factor then
-               * over-relax it
-               */
-              for (k = 0; k < depth; k++)
-                {
-                  tmp = solution[off + k];
-                  solution[off + k] = (matrix[off + k] +
-                                       w *
-                                       (solution[off - depth + k] +     /* west */
-                                        solution[off + depth + k] +     /* east */
-                                        solution[off - rowstride + k] + /* north */
-                                        solution[off + rowstride + k] - 4.0 *
-                                        matrix[off+k]));                /* south */
-
-                  diff = solution[off + k] - tmp;
-                  err += diff*diff;
-                }
+              gfloat tmp = - (p[k - depth] + p[k + depth] +
+                              p[k - rowstride] + p[k + rowstride] -
+                              4.0f * p[k]);
+
+              if (r)
+                tmp += r[j * depth + k];
+
+              res[j * depth + k] = tmp;
+              err += tmp * tmp;
             }
         }
     }
@@ -344,34 +358,139 @@ gimp_heal_laplace_iteration (gdouble *matrix,
   return err;
 }
 
-/* Solve the laplace equation for matrix and store the result in solution.
+/* Perform one multigrid V-cycle on levels: smooth, solve for the
+ * correction of the residual at half the resolution, add it and
+ * smooth again.
  */
 static void
-gimp_heal_laplace_loop (gdouble *matrix,
-                        gint     height,
-                        gint     depth,
-                        gint     width,
-                        gdouble *solution,
-                        guchar  *mask)
+gimp_heal_laplace_cycle (HealLevel *levels,
+                         gint       n_levels,
+                         gint       depth)
 {
-#define EPSILON   0.001
-#define MAX_ITER  500
-  gint i;
+  HealLevel *fine   = &levels[0];
+  HealLevel *coarse = &levels[1];
+  gint       x, y, k;
+
+  if (n_levels == 1)
+    {
+      gimp_heal_laplace_iteration (fine, depth, N_COARSE, OMEGA_COARSE);
+      return;
+    }
+
+  gimp_heal_laplace_iteration (fine, depth, N_SMOOTH, OMEGA_SMOOTH);
+  gimp_heal_laplace_residual (fine, depth);
 
-  /* repeat until convergence or max iterations */
-  for (i = 0; i < MAX_ITER; i++)
+  memset (coarse->solution, 0,
+          coarse->width * coarse->height * depth * sizeof (gfloat));
+  memset (coarse->rhs, 0,
+          coarse->width * coarse->height * depth * sizeof (gfloat));
+
+  /* the laplacian of the coarse grid is four times the one of the
+   * fine grid, so its right hand side is the sum of the residuals,
+   * not their mean
+   */
+  for (y = 0; y < fine->height; y++)
+    {
+      const gfloat *res = fine->residual + y * fine->width * depth;
+      gfloat       *r   = coarse->rhs + (y / 2) * coarse->width * depth;
+
+      for (x = 0; x < fine->width; x++)
+        for (k = 0; k < depth; k++)
+          r[(x / 2) * depth + k] += res[x * depth + k];
+    }
+
+  gimp_heal_laplace_cycle (levels + 1, n_levels - 1, depth);
+
+  for (y = 0; y < fine->height; y++)
     {
-      gdouble sqr_err;
+      const guchar *m = fine->interior + y * fine->width;
+      gfloat       *s = fine->solution + y * fine->width * depth;
+      const gfloat *c = coarse->solution + (y / 2) * coarse->width * depth;
+
+      for (x = 0; x < fine->width; x++)
+        if (m[x])
+          for (k = 0; k < depth; k++)
+            s[x * depth + k] += c[(x / 2) * depth + k];
+    }
 
-      /* do one iteration and store the amount of error */
-      sqr_err = gimp_heal_laplace_iteration (matrix, height, depth, width,
-                                             solution, mask);
+  gimp_heal_laplace_iteration (fine, depth, N_SMOOTH, OMEGA_SMOOTH);
+}
 
-      /* copy solution to matrix */
-      memcpy (matrix, solution, width * height * depth * sizeof (double));
+/* Solve the laplace equation for solution inside mask, in place,
+ * with the values of solution outside of mask as the boundary.
+ */
+static void
+gimp_heal_laplace_loop (gfloat       *solution,
+                        const guchar *mask,
+                        gint          width,
+                        gint          height,
+                        gint          depth)
+{
+  HealLevel levels[MAX_LEVELS];
+  gint      n_levels;
+  gint      i, x, y;
+
+  levels[0].width    = width;
+  levels[0].height   = height;
+  levels[0].solution = solution;
+  levels[0].rhs      = NULL;
+  levels[0].residual = g_new (gfloat, width * height * depth);
+  levels[0].interior = g_new (guchar, width * height);
+
+  /* do nothing at the boundary or outside mask */
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      levels[0].interior[y * width + x] = (mask[y * width + x] &&
+                                           y > 0 && y < height - 1 &&
+                                           x > 0 && x < width  - 1);
+
+  /* a coarse pixel is unknown where all of its fine pixels are, the
+   * correction is 0 on the boundary of the fine level
+   */
+  for (n_levels = 1; n_levels < MAX_LEVELS; n_levels++)
+    {
+      HealLevel *fine   = &levels[n_levels - 1];
+      HealLevel *coarse = &levels[n_levels];
 
-      if (sqr_err < EPSILON)
+      if (fine->width  < 2 * MIN_LEVEL_SIZE ||
+          fine->height < 2 * MIN_LEVEL_SIZE)
         break;
+
+      coarse->width    = (fine->width  + 1) / 2;
+      coarse->height   = (fine->height + 1) / 2;
+      coarse->solution = g_new (gfloat, coarse->width * coarse->height * depth);
+      coarse->rhs      = g_new (gfloat, coarse->width * coarse->height * depth);
+      coarse->residual = g_new (gfloat, coarse->width * coarse->height * depth);
+      coarse->interior = g_new0 (guchar, coarse->width * coarse->height);
+
+      for (y = 0; y < fine->height / 2; y++)
+        for (x = 0; x < fine->width / 2; x++)
+          {
+            const guchar *m = fine->interior + 2 * y * fine->width + 2 * x;
+
+            coarse->interior[y * coarse->width + x] =
+              (m[0] && m[1] && m[fine->width] && m[fine->width + 1]);
+          }
+    }
+
+  /* repeat until convergence or max cycles */
+  for (i = 0; i < MAX_CYCLES; i++)
+    {
+      gimp_heal_laplace_cycle (levels, n_levels, depth);
+
+      if (gimp_heal_laplace_residual (&levels[0], depth) < EPSILON)
+        break;
+    }
+
+  g_free (levels[0].residual);
+  g_free (levels[0].interior);
+
+  for (i = 1; i < n_levels; i++)
+    {
+      g_free (levels[i].solution);
+      g_free (levels[i].rhs);
+      g_free (levels[i].residual);
+      g_free (levels[i].interior);
     }
 }
 
@@ -394,10 +513,8 @@ gimp_heal (GeglBuffer          *src_buffer,
   gint        dest_bpp;
   gint        width;
   gint        height;
-  gdouble    *i_1;
-  gdouble    *i_2;
+  gfloat     *i_1;
   GeglBuffer *i_1_buffer;
-  GeglBuffer *i_2_buffer;
   guchar     *mask;
 
   src_format  = gegl_buffer_get_format (src_buffer);
@@ -411,25 +528,17 @@ gimp_heal (GeglBuffer          *src_buffer,
 
   g_return_if_fail (src_bpp == dest_bpp);
 
-  i_1  = g_new (gdouble, width * height * src_bpp);
-  i_2  = g_new (gdouble, width * height * src_bpp);
+  i_1 = g_new (gfloat, width * height * src_bpp);
 
   i_1_buffer =
     gegl_buffer_linear_new_from_data (i_1,
-                                      babl_format_n (babl_type ("double"),
+                                      babl_format_n (babl_type ("float"),
                                                      src_bpp),
                                       GEGL_RECTANGLE (0, 0, width, height),
                                       GEGL_AUTO_ROWSTRIDE,
                                       (GDestroyNotify) g_free, i_1);
-  i_2_buffer =
-    gegl_buffer_linear_new_from_data (i_2,
-                                      babl_format_n (babl_type ("double"),
-                                                     src_bpp),
-                                      GEGL_RECTANGLE (0, 0, width, height),
-                                      GEGL_AUTO_ROWSTRIDE,
-                                      (GDestroyNotify) g_free, i_2);
 
-  /* substract pattern from image and store the result as a double in i_1 */
+  /* substract pattern from image and store the result as a float in i_1 */
   gimp_heal_sub (dest_buffer, dest_rect,
                  src_buffer, src_rect,
                  i_1_buffer, GEGL_RECTANGLE (0, 0, width, height));
@@ -439,18 +548,17 @@ gimp_heal (GeglBuffer          *src_buffer,
   gegl_buffer_get (mask_buffer, mask_rect, 1.0, babl_format ("Y u8"),
                    mask, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-  /* FIXME: is a faster implementation needed? */
-  gimp_heal_laplace_loop (i_1, height, src_bpp, width, i_2, mask);
+  /* solve in place, the boundary values of the solution are in i_1 */
+  gimp_heal_laplace_loop (i_1, mask, width, height, src_bpp);
 
   g_free (mask);
 
   /* add solution to original image and store in dest */
-  gimp_heal_add (i_2_buffer, GEGL_RECTANGLE (0, 0, width, height),
+  gimp_heal_add (i_1_buffer, GEGL_RECTANGLE (0, 0, width, height),
                  src_buffer, src_rect,
                  dest_buffer, dest_rect);
 
   g_object_unref (i_1_buffer);
-  g_object_unref (i_2_buffer);
 }
 
 static void
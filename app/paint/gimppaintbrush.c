@@ -80,6 +80,8 @@ gimp_paintbrush_class_init (GimpPaintbrushClass *klass)
 static void
 gimp_paintbrush_init (GimpPaintbrush *paintbrush)
 {
+  /*  the paintbrush doesn't read back what it painted during a stroke  */
+  GIMP_PAINT_CORE (paintbrush)->batch_dabs = TRUE;
 }
 
 static void
@@ -17,8 +17,11 @@
 
 #include "config.h"
 
+#include <stdlib.h>
+
 #include <gegl.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
 
 #include "paint-types.h"
@@ -38,8 +41,14 @@
 #include "gimp-intl.h"
 
 
-static void gimp_paint_core_stroke_emulate_dynamics (GimpCoords *coords,
-                                                     gint        length);
+static void     gimp_paint_core_stroke_emulate_dynamics (GimpCoords    *coords,
+                                                         gint           length);
+static gboolean gimp_paint_core_replay_parse            (const gchar   *line,
+                                                         gchar         *type,
+                                                         gint64        *usec,
+                                                         GimpCoords    *coords);
+static gint     gimp_paint_core_replay_compare          (gconstpointer  a,
+                                                         gconstpointer  b);
 
 
 static const GimpCoords default_coords = GIMP_COORDS_DEFAULT_VALUES;
@@ -336,6 +345,237 @@ gimp_paint_core_stroke_vectors (GimpPaintCore     *core,
   return initialized;
 }
 
+/**
+ * gimp_paint_core_replay:
+ * @core:          a #GimpPaintCore
+ * @drawable:      the drawable to paint on
+ * @paint_options: the paint options to use
+ * @filename:      a stroke recording
+ * @push_undo:     whether to push an undo step for each stroke
+ * @stats:         return location for the replay statistics, or %NULL
+ * @error:         return location for an error
+ *
+ * Replays the strokes recorded with GIMP_STROKE_RECORD. A recording
+ * is a text file of one event per line: "s" starts a stroke, "m" is a
+ * motion event and "e" ends the stroke. Each event is followed by its
+ * time in microseconds since the start of the stroke; "s" and "m"
+ * also carry the x, y, pressure, xtilt, ytilt, wheel, velocity and
+ * direction of the coords. Lines starting with '#' are ignored.
+ *
+ * The events are fed to the paint core as fast as possible, the
+ * recorded time is only passed on to the paint core.
+ *
+ * Return value: %TRUE if all strokes of the recording were replayed.
+ **/
+gboolean
+gimp_paint_core_replay (GimpPaintCore         *core,
+                        GimpDrawable          *drawable,
+                        GimpPaintOptions      *paint_options,
+                        const gchar           *filename,
+                        gboolean               push_undo,
+                        GimpPaintReplayStats  *stats,
+                        GError               **error)
+{
+  GimpPaintReplayStats  replay_stats = { 0, };
+  GArray               *latencies;
+  gchar                *contents;
+  gchar               **lines;
+  gboolean              painting = FALSE;
+  gboolean              success  = TRUE;
+  gint                  i;
+
+  g_return_val_if_fail (GIMP_IS_PAINT_CORE (core), FALSE);
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), FALSE);
+  g_return_val_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)), FALSE);
+  g_return_val_if_fail (GIMP_IS_PAINT_OPTIONS (paint_options), FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (! g_file_get_contents (filename, &contents, NULL, error))
+    return FALSE;
+
+  lines     = g_strsplit (contents, "\n", -1);
+  latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+  g_free (contents);
+
+  core->replaying = TRUE;
+
+  for (i = 0; success && lines[i]; i++)
+    {
+      GimpCoords coords = default_coords;
+      gchar      type;
+      gint64     usec;
+      guint32    time;
+      gint64     start;
+      gdouble    latency;
+
+      if (lines[i][0] == '\0' || lines[i][0] == '#')
+        continue;
+
+      if (! gimp_paint_core_replay_parse (lines[i], &type, &usec, &coords) ||
+          (type == 's') == painting)
+        {
+          g_set_error (error, GIMP_ERROR, GIMP_FAILED,
+                       _("Invalid stroke event in line %d of '%s'"),
+                       i + 1, gimp_filename_to_utf8 (filename));
+          success = FALSE;
+          break;
+        }
+
+      time  = usec / 1000;
+      start = g_get_monotonic_time ();
+
+      switch (type)
+        {
+        case 's':
+          if (! gimp_paint_core_start (core, drawable, paint_options,
+                                       &coords, error))
+            {
+              success = FALSE;
+              break;
+            }
+
+          painting = TRUE;
+
+          core->start_coords = coords;
+          core->last_coords  = coords;
+
+          gimp_paint_core_paint (core, drawable, paint_options,
+                                 GIMP_PAINT_STATE_INIT, time);
+
+          gimp_paint_core_paint (core, drawable, paint_options,
+                                 GIMP_PAINT_STATE_MOTION, time);
+          break;
+
+        case 'm':
+          gimp_paint_core_interpolate (core, drawable, paint_options,
+                                       &coords, time);
+          break;
+
+        case 'e':
+          gimp_paint_core_paint (core, drawable, paint_options,
+                                 GIMP_PAINT_STATE_FINISH, time);
+
+          gimp_paint_core_finish (core, drawable, push_undo);
+
+          painting = FALSE;
+
+          replay_stats.n_strokes++;
+          replay_stats.n_dabs += core->n_dabs;
+
+          gimp_paint_core_cleanup (core);
+          break;
+        }
+
+      latency = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+      g_array_append_val (latencies, latency);
+
+      replay_stats.time += latency;
+    }
+
+  if (painting)
+    {
+      if (success)
+        g_set_error (error, GIMP_ERROR, GIMP_FAILED,
+                     _("Unterminated stroke in '%s'"),
+                     gimp_filename_to_utf8 (filename));
+
+      gimp_paint_core_cancel (core, drawable);
+      gimp_paint_core_cleanup (core);
+
+      success = FALSE;
+    }
+
+  core->replaying = FALSE;
+
+  if (success && stats)
+    {
+      replay_stats.n_events = latencies->len;
+
+      if (latencies->len > 0)
+        {
+          gdouble *values = (gdouble *) latencies->data;
+          gint     n      = latencies->len;
+
+          qsort (values, n, sizeof (gdouble), gimp_paint_core_replay_compare);
+
+          replay_stats.latency_p50 = values[MIN (n - 1, n * 50 / 100)];
+          replay_stats.latency_p95 = values[MIN (n - 1, n * 95 / 100)];
+          replay_stats.latency_p99 = values[MIN (n - 1, n * 99 / 100)];
+          replay_stats.latency_max = values[n - 1];
+        }
+
+      *stats = replay_stats;
+    }
+
+  g_array_free (latencies, TRUE);
+  g_strfreev (lines);
+
+  return success;
+}
+
+
+/*  private functions  */
+
+static gboolean
+gimp_paint_core_replay_parse (const gchar *line,
+                              gchar       *type,
+                              gint64      *usec,
+                              GimpCoords  *coords)
+{
+  gdouble  values[8];
+  gchar   *end;
+  gint     i;
+
+  *type = line[0];
+
+  if (*type != 's' && *type != 'm' && *type != 'e')
+    return FALSE;
+
+  line++;
+
+  *usec = g_ascii_strtoll (line, &end, 10);
+
+  if (end == line)
+    return FALSE;
+
+  if (*type == 'e')
+    return TRUE;
+
+  for (i = 0; i < G_N_ELEMENTS (values); i++)
+    {
+      line = end;
+
+      values[i] = g_ascii_strtod (line, &end);
+
+      if (end == line)
+        return FALSE;
+    }
+
+  coords->x         = values[0];
+  coords->y         = values[1];
+  coords->pressure  = values[2];
+  coords->xtilt     = values[3];
+  coords->ytilt     = values[4];
+  coords->wheel     = values[5];
+  coords->velocity  = values[6];
+  coords->direction = values[7];
+
+  return TRUE;
+}
+
+static gint
+gimp_paint_core_replay_compare (gconstpointer a,
+                                gconstpointer b)
+{
+  gdouble x = *(const gdouble *) a;
+  gdouble y = *(const gdouble *) b;
+
+  return (x > y) - (x < y);
+}
+
 static void
 gimp_paint_core_stroke_emulate_dynamics (GimpCoords *coords,
                                          gint        length)
@@ -19,6 +19,23 @@
 #define __GIMP_PAINT_CORE_STROKE_H__
 
 
+typedef struct _GimpPaintReplayStats GimpPaintReplayStats;
+
+struct _GimpPaintReplayStats
+{
+  gint     n_strokes;
+  gint     n_events;
+  gint     n_dabs;
+
+  gdouble  time;          /*  seconds spent in the paint core       */
+
+  gdouble  latency_p50;   /*  seconds spent per event, percentiles  */
+  gdouble  latency_p95;
+  gdouble  latency_p99;
+  gdouble  latency_max;
+};
+
+
 gboolean   gimp_paint_core_stroke          (GimpPaintCore      *core,
                                             GimpDrawable       *drawable,
                                             GimpPaintOptions   *paint_options,
@@ -44,5 +61,13 @@ gboolean   gimp_paint_core_stroke_vectors  (GimpPaintCore      *core,
                                             gboolean            push_undo,
                                             GError            **error);
 
+gboolean   gimp_paint_core_replay          (GimpPaintCore        *core,
+                                            GimpDrawable         *drawable,
+                                            GimpPaintOptions     *paint_options,
+                                            const gchar          *filename,
+                                            gboolean              push_undo,
+                                            GimpPaintReplayStats *stats,
+                                            GError              **error);
+
 
 #endif  /*  __GIMP_PAINT_CORE_STROKE_H__  */
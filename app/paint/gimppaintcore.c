@@ -17,9 +17,12 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
 
 #include <gegl.h>
+#include <glib/gstdio.h>
 
 #include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
@@ -107,6 +110,19 @@ static GimpUndo* gimp_paint_core_real_push_undo      (GimpPaintCore    *core,
                                                       GimpImage        *image,
                                                       const gchar      *undo_desc);
 
+static void      gimp_paint_core_batch_dab           (GimpPaintCore    *core,
+                                                      GimpDrawable     *drawable,
+                                                      gdouble           image_opacity,
+                                                      GimpLayerModeEffects paint_mode);
+static void      gimp_paint_core_flush_batch         (GimpPaintCore    *core,
+                                                      GimpDrawable     *drawable);
+static void      gimp_paint_core_clear_batch         (GimpPaintCore    *core);
+
+static FILE    * gimp_paint_core_get_record_file     (void);
+static void      gimp_paint_core_record_event        (GimpPaintCore    *core,
+                                                      gchar             type,
+                                                      const GimpCoords *coords);
+
 
 G_DEFINE_TYPE (GimpPaintCore, gimp_paint_core, GIMP_TYPE_OBJECT)
 
@@ -298,6 +314,8 @@ gimp_paint_core_paint (GimpPaintCore    *core,
 
   core_class = GIMP_PAINT_CORE_GET_CLASS (core);
 
+  core->batch_level++;
+
   if (core_class->pre_paint (core, drawable,
                              paint_options,
                              paint_state, time))
@@ -308,6 +326,8 @@ gimp_paint_core_paint (GimpPaintCore    *core,
           /* Save coordinates for gimp_paint_core_interpolate() */
           core->last_paint.x = core->cur_coords.x;
           core->last_paint.y = core->cur_coords.y;
+
+          core->n_dabs++;
         }
 
       core_class->paint (core, drawable,
@@ -319,6 +339,9 @@ gimp_paint_core_paint (GimpPaintCore    *core,
                               paint_options,
                               paint_state, time);
     }
+
+  if (--core->batch_level == 0)
+    gimp_paint_core_flush_batch (core, drawable);
 }
 
 gboolean
@@ -362,7 +385,7 @@ gimp_paint_core_start (GimpPaintCore     *core,
   if (core->undo_buffer)
     g_object_unref (core->undo_buffer);
 
-  core->undo_buffer = gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+  core->undo_buffer = gimp_gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
 
   /*  Allocate the saved proj structure  */
   if (core->saved_proj_buffer)
@@ -398,6 +421,8 @@ gimp_paint_core_start (GimpPaintCore     *core,
   core->last_paint.x = -1e6;
   core->last_paint.y = -1e6;
 
+  core->n_dabs = 0;
+
   {
     GimpImage   *image;
     GimpChannel *mask;
@@ -429,6 +454,13 @@ gimp_paint_core_start (GimpPaintCore     *core,
   /*  Freeze the drawable preview so that it isn't constantly updated.  */
   gimp_viewable_preview_freeze (GIMP_VIEWABLE (drawable));
 
+  if (! core->replaying && gimp_paint_core_get_record_file ())
+    {
+      core->record_start = g_get_monotonic_time ();
+
+      gimp_paint_core_record_event (core, 's', coords);
+    }
+
   return TRUE;
 }
 
@@ -443,6 +475,11 @@ gimp_paint_core_finish (GimpPaintCore *core,
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
   g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
 
+  gimp_paint_core_record_event (core, 'e', NULL);
+
+  gimp_paint_core_flush_batch (core, drawable);
+  gimp_paint_core_clear_batch (core);
+
   if (core->applicator)
     {
       g_object_unref (core->applicator);
@@ -483,13 +520,8 @@ gimp_paint_core_finish (GimpPaintCore *core,
 
       GIMP_PAINT_CORE_GET_CLASS (core)->push_undo (core, image, NULL);
 
-      buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
-                                gimp_drawable_get_format (drawable));
-
-      gegl_buffer_copy (core->undo_buffer,
-                        GEGL_RECTANGLE (x, y, width, height),
-                        buffer,
-                        GEGL_RECTANGLE (0, 0, 0, 0));
+      buffer = gimp_gegl_buffer_dup_area (core->undo_buffer,
+                                          GEGL_RECTANGLE (x, y, width, height));
 
       gimp_drawable_push_undo (drawable, NULL,
                                buffer, x, y, width, height);
@@ -522,6 +554,11 @@ gimp_paint_core_cancel (GimpPaintCore *core,
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
   g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
 
+  gimp_paint_core_record_event (core, 'e', NULL);
+
+  /*  pending dabs are dropped, the drawable is restored anyway  */
+  gimp_paint_core_clear_batch (core);
+
   /*  Determine if any part of the image has been altered--
    *  if nothing has, then just return...
    */
@@ -561,6 +598,8 @@ gimp_paint_core_cleanup (GimpPaintCore *core)
 {
   g_return_if_fail (GIMP_IS_PAINT_CORE (core));
 
+  gimp_paint_core_clear_batch (core);
+
   if (core->undo_buffer)
     {
       g_object_unref (core->undo_buffer);
@@ -601,8 +640,15 @@ gimp_paint_core_interpolate (GimpPaintCore    *core,
 
   core->cur_coords = *coords;
 
+  gimp_paint_core_record_event (core, 'm', coords);
+
+  core->batch_level++;
+
   GIMP_PAINT_CORE_GET_CLASS (core)->interpolate (core, drawable,
                                                  paint_options, time);
+
+  if (--core->batch_level == 0)
+    gimp_paint_core_flush_batch (core, drawable);
 }
 
 void
@@ -748,6 +794,13 @@ gimp_paint_core_paste (GimpPaintCore            *core,
   gint        width       = gegl_buffer_get_width  (core->paint_buffer);
   gint        height      = gegl_buffer_get_height (core->paint_buffer);
 
+  if (! core->batch_dabs || core->batch_level == 0 ||
+      mode != GIMP_PAINT_CONSTANT)
+    {
+      /*  everything painted before has to be on the drawable  */
+      gimp_paint_core_flush_batch (core, drawable);
+    }
+
   /*  If the mode is CONSTANT:
    *   combine the canvas buf, the paint mask to the canvas buffer
    */
@@ -767,6 +820,13 @@ gimp_paint_core_paste (GimpPaintCore            *core,
                                         GIMP_IS_AIRBRUSH (core));
         }
 
+      if (core->batch_dabs && core->batch_level > 0)
+        {
+          gimp_paint_core_batch_dab (core, drawable,
+                                     image_opacity, paint_mode);
+          return;
+        }
+
       gimp_gegl_apply_mask (core->canvas_buffer,
                             GEGL_RECTANGLE (core->paint_buffer_x,
                                             core->paint_buffer_y,
@@ -841,6 +901,8 @@ gimp_paint_core_replace (GimpPaintCore            *core,
       return;
     }
 
+  gimp_paint_core_flush_batch (core, drawable);
+
   width  = gegl_buffer_get_width  (core->paint_buffer);
   height = gegl_buffer_get_height (core->paint_buffer);
 
@@ -960,3 +1022,181 @@ gimp_paint_core_smooth_coords (GimpPaintCore    *core,
         }
     }
 }
+
+
+/*  private functions  */
+
+/*  In GIMP_PAINT_CONSTANT mode every dab is composited over the
+ *  unchanged undo_buffer, masked by the whole canvas_buffer. The last
+ *  dab's paint pixels win where dabs overlap, so compositing the union
+ *  of a motion event's dabs once gives the same result as compositing
+ *  each of them, as long as opacity and mode don't change.
+ */
+static void
+gimp_paint_core_batch_dab (GimpPaintCore        *core,
+                           GimpDrawable         *drawable,
+                           gdouble               image_opacity,
+                           GimpLayerModeEffects  paint_mode)
+{
+  GeglRectangle rect;
+
+  if (core->batch_rect.width > 0 &&
+      (core->batch_opacity != image_opacity ||
+       core->batch_mode    != paint_mode))
+    {
+      gimp_paint_core_flush_batch (core, drawable);
+    }
+
+  if (! core->batch_buffer)
+    core->batch_buffer =
+      gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                       gimp_item_get_width  (GIMP_ITEM (drawable)),
+                                       gimp_item_get_height (GIMP_ITEM (drawable))),
+                       gegl_buffer_get_format (core->paint_buffer));
+
+  rect = *GEGL_RECTANGLE (core->paint_buffer_x,
+                          core->paint_buffer_y,
+                          gegl_buffer_get_width  (core->paint_buffer),
+                          gegl_buffer_get_height (core->paint_buffer));
+
+  gegl_buffer_copy (core->paint_buffer, NULL,
+                    core->batch_buffer, &rect);
+
+  if (core->batch_rect.width > 0)
+    gegl_rectangle_bounding_box (&core->batch_rect, &core->batch_rect, &rect);
+  else
+    core->batch_rect = rect;
+
+  core->batch_opacity = image_opacity;
+  core->batch_mode    = paint_mode;
+
+  /*  Update the undo extents  */
+  core->x1 = MIN (core->x1, rect.x);
+  core->y1 = MIN (core->y1, rect.y);
+  core->x2 = MAX (core->x2, rect.x + rect.width);
+  core->y2 = MAX (core->y2, rect.y + rect.height);
+}
+
+static void
+gimp_paint_core_flush_batch (GimpPaintCore *core,
+                             GimpDrawable  *drawable)
+{
+  GeglRectangle  rect = core->batch_rect;
+  GeglBuffer    *buffer;
+
+  if (rect.width <= 0 || rect.height <= 0)
+    return;
+
+  core->batch_rect.width  = 0;
+  core->batch_rect.height = 0;
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, rect.width, rect.height),
+                            gegl_buffer_get_format (core->batch_buffer));
+
+  gegl_buffer_copy (core->batch_buffer, &rect,
+                    buffer, GEGL_RECTANGLE (0, 0, 0, 0));
+
+  gimp_gegl_apply_mask (core->canvas_buffer, &rect,
+                        buffer,
+                        GEGL_RECTANGLE (0, 0, rect.width, rect.height),
+                        1.0);
+
+  gimp_applicator_apply (core->applicator,
+                         core->undo_buffer,
+                         buffer,
+                         rect.x, rect.y,
+                         core->batch_opacity, core->batch_mode);
+
+  g_object_unref (buffer);
+
+  gimp_drawable_update (drawable, rect.x, rect.y, rect.width, rect.height);
+}
+
+static void
+gimp_paint_core_clear_batch (GimpPaintCore *core)
+{
+  core->batch_rect.width  = 0;
+  core->batch_rect.height = 0;
+
+  if (core->batch_buffer)
+    {
+      g_object_unref (core->batch_buffer);
+      core->batch_buffer = NULL;
+    }
+}
+
+/*  Stroke recording: if GIMP_STROKE_RECORD names a file, every stroke
+ *  is appended to it in the format read by gimp_paint_core_replay().
+ *  The coords are recorded as the paint core receives them, that is
+ *  in drawable coordinates and after the tool's smoothing.
+ */
+static FILE *
+gimp_paint_core_get_record_file (void)
+{
+  static gboolean  initialized = FALSE;
+  static FILE     *file        = NULL;
+
+  if (! initialized)
+    {
+      const gchar *filename = g_getenv ("GIMP_STROKE_RECORD");
+
+      initialized = TRUE;
+
+      if (filename && *filename)
+        {
+          file = g_fopen (filename, "a");
+
+          if (file)
+            fprintf (file, "# GIMP stroke recording 1\n");
+          else
+            g_printerr ("Could not open '%s' for recording strokes: %s\n",
+                        gimp_filename_to_utf8 (filename),
+                        g_strerror (errno));
+        }
+    }
+
+  return file;
+}
+
+static void
+gimp_paint_core_record_event (GimpPaintCore    *core,
+                              gchar             type,
+                              const GimpCoords *coords)
+{
+  FILE   *file;
+  gint64  usec;
+
+  if (! core->record_start)
+    return;
+
+  file = gimp_paint_core_get_record_file ();
+  usec = g_get_monotonic_time () - core->record_start;
+
+  fprintf (file, "%c %" G_GINT64_FORMAT, type, usec);
+
+  if (coords)
+    {
+      const gdouble values[] = { coords->x,
+                                 coords->y,
+                                 coords->pressure,
+                                 coords->xtilt,
+                                 coords->ytilt,
+                                 coords->wheel,
+                                 coords->velocity,
+                                 coords->direction };
+      gchar         buf[G_ASCII_DTOSTR_BUF_SIZE];
+      gint          i;
+
+      for (i = 0; i < G_N_ELEMENTS (values); i++)
+        fprintf (file, " %s", g_ascii_dtostr (buf, sizeof (buf), values[i]));
+    }
+
+  fprintf (file, "\n");
+
+  if (type == 'e')
+    {
+      fflush (file);
+
+      core->record_start = 0;
+    }
+}
@@ -66,6 +66,17 @@ struct _GimpPaintCore
   GArray      *stroke_buffer;
 
   GimpApplicator *applicator;
+
+  gboolean              batch_dabs;     /*  composite dabs per motion event  */
+  gint                  batch_level;    /*  nesting of paint calls           */
+  GeglBuffer           *batch_buffer;   /*  paint pixels of pending dabs     */
+  GeglRectangle         batch_rect;     /*  extents of the pending dabs      */
+  gdouble               batch_opacity;
+  GimpLayerModeEffects  batch_mode;
+
+  gint         n_dabs;            /*  dabs painted in the current stroke  */
+  gboolean     replaying;         /*  don't record a replayed stroke      */
+  gint64       record_start;      /*  start time of the recorded stroke   */
 };
 
 struct _GimpPaintCoreClass
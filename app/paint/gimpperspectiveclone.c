@@ -69,12 +69,20 @@ static GeglBuffer * gimp_perspective_clone_get_source (GimpSourceCore   *source_
 static void         gimp_perspective_clone_get_matrix (GimpPerspectiveClone *clone,
                                                        GimpMatrix3          *matrix);
 
+static void         gimp_perspective_clone_cache_free (GimpPerspectiveClone *clone);
+static void         gimp_perspective_clone_cache_render
+                                                      (GimpPerspectiveClone *clone,
+                                                       const GeglRectangle  *rect);
+
 
 G_DEFINE_TYPE (GimpPerspectiveClone, gimp_perspective_clone,
                GIMP_TYPE_CLONE)
 
 #define parent_class gimp_perspective_clone_parent_class
 
+/*  the size of the blocks the transformed source is rendered in  */
+#define CACHE_TILE_SIZE 64
+
 
 void
 gimp_perspective_clone_register (Gimp                      *gimp,
@@ -277,6 +285,8 @@ gimp_perspective_clone_paint (GimpPaintCore    *paint_core,
       break;
 
     case GIMP_PAINT_STATE_FINISH:
+      gimp_perspective_clone_cache_free (clone);
+
       if (clone->node)
         {
           g_object_unref (clone->node);
@@ -315,13 +325,11 @@ gimp_perspective_clone_get_source (GimpSourceCore   *source_core,
 {
   GimpPerspectiveClone *clone = GIMP_PERSPECTIVE_CLONE (source_core);
   GeglBuffer           *src_buffer;
-  GeglBuffer           *dest_buffer;
   const Babl           *src_format_alpha;
   gint                  x1d, y1d, x2d, y2d;
   gdouble               x1s, y1s, x2s, y2s, x3s, y3s, x4s, y4s;
   gint                  xmin, ymin, xmax, ymax;
   GimpMatrix3           matrix;
-  GimpMatrix3           gegl_matrix;
 
   src_buffer       = gimp_pickable_get_buffer (src_pickable);
   src_format_alpha = gimp_pickable_get_format_with_alpha (src_pickable);
@@ -357,29 +365,46 @@ gimp_perspective_clone_get_source (GimpSourceCore   *source_core,
       return FALSE;
     }
 
-  dest_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, x2d - x1d, y2d - y1d),
-                                 src_format_alpha);
-
   gimp_perspective_clone_get_matrix (clone, &matrix);
 
-  gimp_matrix3_identity (&gegl_matrix);
-  gimp_matrix3_mult (&matrix, &gegl_matrix);
-  gimp_matrix3_translate (&gegl_matrix, -x1d, -y1d);
+  /*  the cache is only good for the matrix it was rendered with, which
+   *  changes when the source is moved or the destination set
+   */
+  if (clone->cache_buffer &&
+      (gegl_buffer_get_format (clone->cache_buffer) != src_format_alpha ||
+       memcmp (&matrix, &clone->cache_matrix, sizeof (GimpMatrix3))))
+    {
+      gimp_perspective_clone_cache_free (clone);
+    }
+
+  if (! clone->cache_buffer)
+    {
+      gint width  = gimp_item_get_width  (GIMP_ITEM (drawable));
+      gint height = gimp_item_get_height (GIMP_ITEM (drawable));
 
-  gimp_gegl_node_set_matrix (clone->transform_node, &gegl_matrix);
+      clone->cache_buffer =
+        gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
+                         src_format_alpha);
 
-  gegl_node_set (clone->dest_node,
-                 "buffer", dest_buffer,
-                 NULL);
+      clone->cache_n_tiles_x = (width  + CACHE_TILE_SIZE - 1) / CACHE_TILE_SIZE;
+      clone->cache_n_tiles_y = (height + CACHE_TILE_SIZE - 1) / CACHE_TILE_SIZE;
+      clone->cache_tiles     = g_new0 (guchar,
+                                       clone->cache_n_tiles_x *
+                                       clone->cache_n_tiles_y);
+      clone->cache_matrix    = matrix;
 
-  gegl_processor_set_rectangle (clone->processor,
-                                GEGL_RECTANGLE (0, 0,
-                                                x2d - x1d, y2d - y1d));
-  while (gegl_processor_work (clone->processor, NULL));
+      gimp_gegl_node_set_matrix (clone->transform_node, &matrix);
+
+      gegl_node_set (clone->dest_node,
+                     "buffer", clone->cache_buffer,
+                     NULL);
+    }
 
-  *src_rect = *GEGL_RECTANGLE (0, 0, x2d - x1d, y2d - y1d);
+  *src_rect = *GEGL_RECTANGLE (x1d, y1d, x2d - x1d, y2d - y1d);
 
-  return dest_buffer;
+  gimp_perspective_clone_cache_render (clone, src_rect);
+
+  return g_object_ref (clone->cache_buffer);
 }
 
 
@@ -397,6 +422,8 @@ gimp_perspective_clone_set_transform (GimpPerspectiveClone *clone,
   clone->transform_inv = clone->transform;
   gimp_matrix3_invert (&clone->transform_inv);
 
+  gimp_perspective_clone_cache_free (clone);
+
 #if 0
   g_printerr ("%f\t%f\t%f\n%f\t%f\t%f\n%f\t%f\t%f\n\n",
               clone->transform.coeff[0][0],
@@ -465,3 +492,73 @@ gimp_perspective_clone_get_matrix (GimpPerspectiveClone *clone,
   gimp_matrix3_mult (&temp, matrix);
   gimp_matrix3_mult (&clone->transform, matrix);
 }
+
+static void
+gimp_perspective_clone_cache_free (GimpPerspectiveClone *clone)
+{
+  if (clone->cache_buffer)
+    {
+      g_object_unref (clone->cache_buffer);
+      clone->cache_buffer = NULL;
+    }
+
+  if (clone->cache_tiles)
+    {
+      g_free (clone->cache_tiles);
+      clone->cache_tiles = NULL;
+    }
+
+  clone->cache_n_tiles_x = 0;
+  clone->cache_n_tiles_y = 0;
+}
+
+/*  renders the tiles of the cache under rect which weren't rendered
+ *  yet, so each source pixel is transformed once per stroke, not once
+ *  per dab
+ */
+static void
+gimp_perspective_clone_cache_render (GimpPerspectiveClone *clone,
+                                     const GeglRectangle  *rect)
+{
+  gint x1 = MAX (rect->x / CACHE_TILE_SIZE, 0);
+  gint y1 = MAX (rect->y / CACHE_TILE_SIZE, 0);
+  gint x2 = MIN ((rect->x + rect->width  - 1) / CACHE_TILE_SIZE + 1,
+                 clone->cache_n_tiles_x);
+  gint y2 = MIN ((rect->y + rect->height - 1) / CACHE_TILE_SIZE + 1,
+                 clone->cache_n_tiles_y);
+  gint tx, ty;
+
+  for (ty = y1; ty < y2; ty++)
+    {
+      guchar *tile = clone->cache_tiles + ty * clone->cache_n_tiles_x + x1;
+
+      for (tx = x1; tx < x2; tx++, tile++)
+        {
+          GeglRectangle tile_rect;
+
+          if (*tile)
+            continue;
+
+          /*  merge the run of missing tiles, one processor run each  */
+          tile_rect.x      = tx * CACHE_TILE_SIZE;
+          tile_rect.y      = ty * CACHE_TILE_SIZE;
+          tile_rect.width  = 0;
+          tile_rect.height = CACHE_TILE_SIZE;
+
+          while (tx < x2 && ! *tile)
+            {
+              *tile = TRUE;
+              tile_rect.width += CACHE_TILE_SIZE;
+
+              tx++;
+              tile++;
+            }
+
+          gegl_rectangle_intersect (&tile_rect, &tile_rect,
+                                    gegl_buffer_get_extent (clone->cache_buffer));
+
+          gegl_processor_set_rectangle (clone->processor, &tile_rect);
+          while (gegl_processor_work (clone->processor, NULL));
+        }
+    }
+}
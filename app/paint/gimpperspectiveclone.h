@@ -50,6 +50,15 @@ struct _GimpPerspectiveClone
   GeglNode      *transform_node;
   GeglNode      *dest_node;
   GeglProcessor *processor;
+
+  /*  the transformed source, in destination coordinates, rendered
+   *  tile by tile as the dabs need it
+   */
+  GeglBuffer    *cache_buffer;
+  guchar        *cache_tiles;
+  gint           cache_n_tiles_x;
+  gint           cache_n_tiles_y;
+  GimpMatrix3    cache_matrix;
 };
 
 struct _GimpPerspectiveCloneClass
@@ -64,6 +64,12 @@ static void       gimp_smudge_accumulator_coords (GimpPaintCore    *paint_core,
 static void       gimp_smudge_accumulator_size   (GimpPaintOptions *paint_options,
                                                   gint             *accumulator_size);
 
+static gboolean   gimp_smudge_brush_bounds       (GimpBrushCore            *core,
+                                                  const GimpCoords         *coords,
+                                                  GimpBrushApplicationMode  brush_mode,
+                                                  gdouble                   hardness,
+                                                  GeglRectangle            *bounds);
+
 
 G_DEFINE_TYPE (GimpSmudge, gimp_smudge, GIMP_TYPE_BRUSH_CORE)
 
@@ -140,11 +146,9 @@ gimp_smudge_paint (GimpPaintCore    *paint_core,
       break;
 
     case GIMP_PAINT_STATE_FINISH:
-      if (smudge->accum_buffer)
-        {
-          g_object_unref (smudge->accum_buffer);
-          smudge->accum_buffer = NULL;
-        }
+      /*  keep the accumulator for the next stroke, which will most
+       *  likely want one of the same size
+       */
       smudge->initialized = FALSE;
       break;
 
@@ -175,11 +179,21 @@ gimp_smudge_start (GimpPaintCore    *paint_core,
 
   gimp_smudge_accumulator_size (paint_options, &accum_size);
 
-  /*  Allocate the accumulation buffer */
-  smudge->accum_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
-                                                          accum_size,
-                                                          accum_size),
-                                          gimp_drawable_get_format (drawable));
+  /*  Allocate the accumulation buffer, unless the last stroke's fits  */
+  if (smudge->accum_buffer &&
+      (gegl_buffer_get_width  (smudge->accum_buffer) != accum_size ||
+       gegl_buffer_get_height (smudge->accum_buffer) != accum_size ||
+       gegl_buffer_get_format (smudge->accum_buffer) !=
+       gimp_drawable_get_format (drawable)))
+    {
+      g_object_unref (smudge->accum_buffer);
+      smudge->accum_buffer = NULL;
+    }
+
+  if (! smudge->accum_buffer)
+    smudge->accum_buffer =
+      gegl_buffer_new (GEGL_RECTANGLE (0, 0, accum_size, accum_size),
+                       gimp_drawable_get_format (drawable));
 
   /*  adjust the x and y coordinates to the upper left corner of the
    *  accumulator
@@ -239,8 +253,7 @@ gimp_smudge_motion (GimpPaintCore    *paint_core,
   GeglBuffer        *paint_buffer;
   gint               paint_buffer_x;
   gint               paint_buffer_y;
-  gint               paint_buffer_width;
-  gint               paint_buffer_height;
+  GeglRectangle      area;
   gdouble            fade_point;
   gdouble            opacity;
   gdouble            rate;
@@ -266,8 +279,31 @@ gimp_smudge_motion (GimpPaintCore    *paint_core,
   if (! paint_buffer)
     return;
 
-  paint_buffer_width  = gegl_buffer_get_width  (paint_buffer);
-  paint_buffer_height = gegl_buffer_get_height (paint_buffer);
+  hardness = gimp_dynamics_get_linear_value (dynamics,
+                                             GIMP_DYNAMICS_OUTPUT_HARDNESS,
+                                             coords,
+                                             paint_options,
+                                             fade_point);
+
+  /*  Only the pixels under the brush are painted, so only they need
+   *  to be blended
+   */
+  if (! gimp_smudge_brush_bounds (GIMP_BRUSH_CORE (paint_core), coords,
+                                  gimp_paint_options_get_brush_mode (paint_options),
+                                  hardness, &area) ||
+      ! gegl_rectangle_intersect (&area, &area,
+                                  GEGL_RECTANGLE (paint_buffer_x,
+                                                  paint_buffer_y,
+                                                  gegl_buffer_get_width  (paint_buffer),
+                                                  gegl_buffer_get_height (paint_buffer))))
+    return;
+
+  /*  the rest of the paint buffer is replaced through a zero mask, it
+   *  only needs to be free of garbage
+   */
+  if (area.width  != gegl_buffer_get_width  (paint_buffer) ||
+      area.height != gegl_buffer_get_height (paint_buffer))
+    gegl_buffer_clear (paint_buffer, NULL);
 
   /*  Get the unclipped acumulator coordinates  */
   gimp_smudge_accumulator_coords (paint_core, coords, &x, &y);
@@ -287,39 +323,28 @@ gimp_smudge_motion (GimpPaintCore    *paint_core,
    *  where I is the pixels under the current painthit.
    *  Then the paint area (paint_area) is built as
    *    (Accum,1) (if no alpha),
+   *  in the same pass.
    */
 
   gimp_gegl_smudge_blend (smudge->accum_buffer,
-                          GEGL_RECTANGLE (paint_buffer_x - x,
-                                          paint_buffer_y - y,
-                                          paint_buffer_width,
-                                          paint_buffer_height),
+                          GEGL_RECTANGLE (area.x - x,
+                                          area.y - y,
+                                          area.width,
+                                          area.height),
                           gimp_drawable_get_buffer (drawable),
-                          GEGL_RECTANGLE (paint_buffer_x,
-                                          paint_buffer_y,
-                                          paint_buffer_width,
-                                          paint_buffer_height),
+                          &area,
                           smudge->accum_buffer,
-                          GEGL_RECTANGLE (paint_buffer_x - x,
-                                          paint_buffer_y - y,
-                                          paint_buffer_width,
-                                          paint_buffer_height),
+                          GEGL_RECTANGLE (area.x - x,
+                                          area.y - y,
+                                          area.width,
+                                          area.height),
+                          paint_buffer,
+                          GEGL_RECTANGLE (area.x - paint_buffer_x,
+                                          area.y - paint_buffer_y,
+                                          area.width,
+                                          area.height),
                           ROUND (rate * 255.0));
 
-  gegl_buffer_copy (smudge->accum_buffer,
-                    GEGL_RECTANGLE (paint_buffer_x - x,
-                                    paint_buffer_y - y,
-                                    paint_buffer_width,
-                                    paint_buffer_height),
-                    paint_buffer,
-                    GEGL_RECTANGLE (0, 0, 0, 0));
-
-  hardness = gimp_dynamics_get_linear_value (dynamics,
-                                             GIMP_DYNAMICS_OUTPUT_HARDNESS,
-                                             coords,
-                                             paint_options,
-                                             fade_point);
-
   gimp_brush_core_replace_canvas (GIMP_BRUSH_CORE (paint_core), drawable,
                                   coords,
                                   MIN (opacity, GIMP_OPACITY_OPAQUE),
@@ -350,3 +375,78 @@ gimp_smudge_accumulator_size (GimpPaintOptions *paint_options,
    */
   *accumulator_size = ceil (sqrt (2 * SQR (paint_options->brush_size + 1)) + 2);
 }
+
+/*  The bounds of the non-zero pixels of the brush mask that
+ *  gimp_brush_core_replace_canvas() is going to use, in drawable
+ *  coordinates
+ */
+static gboolean
+gimp_smudge_brush_bounds (GimpBrushCore            *core,
+                          const GimpCoords         *coords,
+                          GimpBrushApplicationMode  brush_mode,
+                          gdouble                   hardness,
+                          GeglRectangle            *bounds)
+{
+  const GimpTempBuf *brush_mask;
+  const guchar      *data;
+  gint               width;
+  gint               height;
+  gint               x1, y1, x2, y2;
+  gint               x, y;
+
+  brush_mask = gimp_brush_core_get_brush_mask (core, coords,
+                                               brush_mode, hardness);
+
+  if (! brush_mask)
+    return FALSE;
+
+  width  = gimp_temp_buf_get_width  (brush_mask);
+  height = gimp_temp_buf_get_height (brush_mask);
+
+  bounds->x = (gint) floor (coords->x) - (width  >> 1);
+  bounds->y = (gint) floor (coords->y) - (height >> 1);
+
+  if (babl_format_get_bytes_per_pixel (gimp_temp_buf_get_format (brush_mask)) != 1)
+    {
+      bounds->width  = width;
+      bounds->height = height;
+
+      return TRUE;
+    }
+
+  data = gimp_temp_buf_get_data (brush_mask);
+
+  x1 = width;
+  y1 = height;
+  x2 = -1;
+  y2 = -1;
+
+  for (y = 0; y < height; y++)
+    {
+      const guchar *row = data + y * width;
+      gint          left;
+      gint          right;
+
+      for (left = 0; left < width && ! row[left]; left++);
+
+      if (left == width)
+        continue;
+
+      for (right = width - 1; ! row[right]; right--);
+
+      x1 = MIN (x1, left);
+      x2 = MAX (x2, right);
+      y1 = MIN (y1, y);
+      y2 = y;
+    }
+
+  if (x2 < 0)
+    return FALSE;
+
+  bounds->x     += x1;
+  bounds->y     += y1;
+  bounds->width  = x2 - x1 + 1;
+  bounds->height = y2 - y1 + 1;
+
+  return TRUE;
+}
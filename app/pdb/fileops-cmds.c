@@ -37,6 +37,7 @@
 #include "core/gimpimage.h"
 #include "core/gimplayer.h"
 #include "core/gimpparamspecs.h"
+#include "file/file-batch.h"
 #include "file/file-open.h"
 #include "file/file-procedure.h"
 #include "file/file-save.h"
@@ -296,6 +297,183 @@ file_save_invoker (GimpProcedure         *procedure,
   return return_vals;
 }
 
+static GimpValueArray *
+file_save_batch_invoker (GimpProcedure         *procedure,
+                         Gimp                  *gimp,
+                         GimpContext           *context,
+                         GimpProgress          *progress,
+                         const GimpValueArray  *args,
+                         GError               **error)
+{
+  gboolean success = TRUE;
+  GimpValueArray *return_vals;
+  gint32 run_mode;
+  gint32 num_images;
+  const gint32 *image_ids;
+  gint32 num_filenames;
+  const gchar **filenames;
+  gint32 max_jobs;
+  gboolean merge_visible;
+  gint32 num_statuses = 0;
+  gint32 *statuses = NULL;
+
+  run_mode = g_value_get_enum (gimp_value_array_index (args, 0));
+  num_images = g_value_get_int (gimp_value_array_index (args, 1));
+  image_ids = gimp_value_get_int32array (gimp_value_array_index (args, 2));
+  num_filenames = g_value_get_int (gimp_value_array_index (args, 3));
+  filenames = gimp_value_get_stringarray (gimp_value_array_index (args, 4));
+  max_jobs = g_value_get_int (gimp_value_array_index (args, 5));
+  merge_visible = g_value_get_boolean (gimp_value_array_index (args, 6));
+
+  if (success)
+    {
+      if (num_images == num_filenames)
+        {
+          GimpImage         **images = g_new0 (GimpImage *, num_images);
+          gchar             **uris   = g_new0 (gchar *, num_images);
+          GimpPDBStatusType  *status = g_new0 (GimpPDBStatusType, num_images);
+          gint                i;
+
+          for (i = 0; success && i < num_images; i++)
+            {
+              images[i] = gimp_image_get_by_ID (gimp, image_ids[i]);
+              uris[i]   = file_utils_filename_to_uri (gimp, filenames[i], error);
+
+              if (! images[i] || ! uris[i])
+                success = FALSE;
+            }
+
+          if (success)
+            {
+              GError *save_error = NULL;
+
+              file_save_batch (gimp, context, progress,
+                               images, (const gchar **) uris, num_images,
+                               run_mode, merge_visible, max_jobs,
+                               status, &save_error);
+
+              if (save_error)
+                {
+                  gimp_message_literal (gimp, G_OBJECT (progress),
+                                        GIMP_MESSAGE_WARNING,
+                                        save_error->message);
+                  g_clear_error (&save_error);
+                }
+
+              num_statuses = num_images;
+              statuses     = g_new (gint32, num_statuses);
+
+              for (i = 0; i < num_statuses; i++)
+                statuses[i] = status[i];
+            }
+
+          for (i = 0; i < num_images; i++)
+            g_free (uris[i]);
+
+          g_free (images);
+          g_free (uris);
+          g_free (status);
+        }
+      else
+        success = FALSE;
+    }
+
+  return_vals = gimp_procedure_get_return_values (procedure, success,
+                                                  error ? *error : NULL);
+
+  if (success)
+    {
+      g_value_set_int (gimp_value_array_index (return_vals, 1), num_statuses);
+      gimp_value_take_int32array (gimp_value_array_index (return_vals, 2), statuses, num_statuses);
+    }
+
+  return return_vals;
+}
+
+static GimpValueArray *
+file_batch_run_invoker (GimpProcedure         *procedure,
+                        Gimp                  *gimp,
+                        GimpContext           *context,
+                        GimpProgress          *progress,
+                        const GimpValueArray  *args,
+                        GError               **error)
+{
+  gboolean success = TRUE;
+  GimpValueArray *return_vals;
+  const gchar *pattern;
+  const gchar *procedure_name;
+  const gchar *dest_dir;
+  const gchar *extension;
+  gint32 max_jobs;
+  gboolean merge_visible;
+  gint32 num_files = 0;
+  gchar **filenames = NULL;
+  gint32 num_statuses = 0;
+  gint32 *statuses = NULL;
+  gint32 num_times = 0;
+  gdouble *times = NULL;
+  gint32 num_errors = 0;
+  gchar **errors = NULL;
+
+  pattern = g_value_get_string (gimp_value_array_index (args, 0));
+  procedure_name = g_value_get_string (gimp_value_array_index (args, 1));
+  dest_dir = g_value_get_string (gimp_value_array_index (args, 2));
+  extension = g_value_get_string (gimp_value_array_index (args, 3));
+  max_jobs = g_value_get_int (gimp_value_array_index (args, 4));
+  merge_visible = g_value_get_boolean (gimp_value_array_index (args, 5));
+
+  if (success)
+    {
+      GimpFileBatchResult *results;
+      gint                 n_results;
+
+      results = file_batch_run (gimp, context, progress,
+                                pattern, procedure_name, dest_dir, extension,
+                                max_jobs, merge_visible, &n_results, error);
+
+      if (results)
+        {
+          gint i;
+
+          num_files = num_statuses = num_times = num_errors = n_results;
+
+          filenames = g_new (gchar *, n_results);
+          statuses  = g_new (gint32,  n_results);
+          times     = g_new (gdouble, n_results);
+          errors    = g_new (gchar *, n_results);
+
+          for (i = 0; i < n_results; i++)
+            {
+              filenames[i] = g_strdup (results[i].filename);
+              statuses[i]  = results[i].status;
+              times[i]     = results[i].time;
+              errors[i]    = g_strdup (results[i].error ? results[i].error : "");
+            }
+
+          file_batch_results_free (results, n_results);
+        }
+      else
+        success = FALSE;
+    }
+
+  return_vals = gimp_procedure_get_return_values (procedure, success,
+                                                  error ? *error : NULL);
+
+  if (success)
+    {
+      g_value_set_int (gimp_value_array_index (return_vals, 1), num_files);
+      gimp_value_take_stringarray (gimp_value_array_index (return_vals, 2), filenames, num_files);
+      g_value_set_int (gimp_value_array_index (return_vals, 3), num_statuses);
+      gimp_value_take_int32array (gimp_value_array_index (return_vals, 4), statuses, num_statuses);
+      g_value_set_int (gimp_value_array_index (return_vals, 5), num_times);
+      gimp_value_take_floatarray (gimp_value_array_index (return_vals, 6), times, num_times);
+      g_value_set_int (gimp_value_array_index (return_vals, 7), num_errors);
+      gimp_value_take_stringarray (gimp_value_array_index (return_vals, 8), errors, num_errors);
+    }
+
+  return return_vals;
+}
+
 static GimpValueArray *
 file_load_thumbnail_invoker (GimpProcedure         *procedure,
                              Gimp                  *gimp,
@@ -753,6 +931,176 @@ register_fileops_procs (GimpPDB *pdb)
   gimp_pdb_register_procedure (pdb, procedure);
   g_object_unref (procedure);
 
+  /*
+   * gimp-file-save-batch
+   */
+  procedure = gimp_procedure_new (file_save_batch_invoker);
+  gimp_object_set_static_name (GIMP_OBJECT (procedure),
+                               "gimp-file-save-batch");
+  gimp_procedure_set_static_strings (procedure,
+                                     "gimp-file-save-batch",
+                                     "Saves several images at the same time.",
+                                     "This procedure saves each of the images to the file with the same index, using the save or export handler that file-save would use. Up to 'max_jobs' handlers run at the same time, 0 means one for each processor. Exported images are converted and flattened as the handler requires first, with 'merge_visible' they are saved as a single layer of their visible layers. The status of each save is returned in 'statuses', the procedure itself only fails on invalid arguments.",
+                                     "Michael Natterer <mitch@gimp.org>",
+                                     "Michael Natterer",
+                                     "2012",
+                                     NULL);
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_enum ("run-mode",
+                                                     "run mode",
+                                                     "The run mode",
+                                                     GIMP_TYPE_RUN_MODE,
+                                                     GIMP_RUN_INTERACTIVE,
+                                                     GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32 ("num-images",
+                                                      "num images",
+                                                      "The number of images",
+                                                      0, G_MAXINT32, 0,
+                                                      GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32_array ("image-ids",
+                                                            "image ids",
+                                                            "The images to save",
+                                                            GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32 ("num-filenames",
+                                                      "num filenames",
+                                                      "The number of file names",
+                                                      0, G_MAXINT32, 0,
+                                                      GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string_array ("filenames",
+                                                             "filenames",
+                                                             "The names of the files to save the images in",
+                                                             GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32 ("max-jobs",
+                                                      "max jobs",
+                                                      "The most images to save at the same time, or 0",
+                                                      0, G_MAXINT32, 0,
+                                                      GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               g_param_spec_boolean ("merge-visible",
+                                                     "merge visible",
+                                                     "Export the visible layers merged",
+                                                     FALSE,
+                                                     GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("num-statuses",
+                                                          "num statuses",
+                                                          "The number of statuses",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32_array ("statuses",
+                                                                "statuses",
+                                                                "The GimpPDBStatusType of each save",
+                                                                GIMP_PARAM_READWRITE));
+  gimp_pdb_register_procedure (pdb, procedure);
+  g_object_unref (procedure);
+
+  /*
+   * gimp-file-batch-run
+   */
+  procedure = gimp_procedure_new (file_batch_run_invoker);
+  gimp_object_set_static_name (GIMP_OBJECT (procedure),
+                               "gimp-file-batch-run");
+  gimp_procedure_set_static_strings (procedure,
+                                     "gimp-file-batch-run",
+                                     "Opens, processes and saves all files matching a pattern.",
+                                     "This procedure opens each file matching 'pattern', which may contain wildcards in its last path component, runs 'procedure_name' on it and saves it with the same name and 'extension' to 'dest_dir', or next to the original if 'dest_dir' is empty. 'procedure_name' must take the run mode, image and drawable as its first arguments like filter plug-ins do, it runs non-interactively with the defaults for its other arguments. An empty 'procedure_name' only converts the files. Up to 'max_jobs' files are worked on at the same time, 0 means one for each processor. The status, time in seconds and error message of each file are returned.",
+                                     "Michael Natterer <mitch@gimp.org>",
+                                     "Michael Natterer",
+                                     "2012",
+                                     NULL);
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("pattern",
+                                                       "pattern",
+                                                       "The glob pattern of the files to process",
+                                                       TRUE, FALSE, FALSE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("procedure-name",
+                                                       "procedure name",
+                                                       "The procedure to run on each image, or an empty string",
+                                                       FALSE, FALSE, FALSE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("dest-dir",
+                                                       "dest dir",
+                                                       "The directory to save into, or an empty string",
+                                                       TRUE, FALSE, FALSE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("extension",
+                                                       "extension",
+                                                       "The extension of the file type to save as",
+                                                       FALSE, FALSE, TRUE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32 ("max-jobs",
+                                                      "max jobs",
+                                                      "The most files to work on at the same time, or 0",
+                                                      0, G_MAXINT32, 0,
+                                                      GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               g_param_spec_boolean ("merge-visible",
+                                                     "merge visible",
+                                                     "Export the visible layers merged",
+                                                     FALSE,
+                                                     GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("num-files",
+                                                          "num files",
+                                                          "The number of files",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_string_array ("filenames",
+                                                                 "filenames",
+                                                                 "The files processed",
+                                                                 GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("num-statuses",
+                                                          "num statuses",
+                                                          "The number of statuses",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32_array ("statuses",
+                                                                "statuses",
+                                                                "The GimpPDBStatusType of each file",
+                                                                GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("num-times",
+                                                          "num times",
+                                                          "The number of times",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_float_array ("times",
+                                                                "times",
+                                                                "The seconds each file took from being opened to being saved",
+                                                                GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("num-errors",
+                                                          "num errors",
+                                                          "The number of error messages",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_string_array ("errors",
+                                                                 "errors",
+                                                                 "The error message of each file, empty if there was none",
+                                                                 GIMP_PARAM_READWRITE));
+  gimp_pdb_register_procedure (pdb, procedure);
+  g_object_unref (procedure);
+
   /*
    * gimp-file-load-thumbnail
    */
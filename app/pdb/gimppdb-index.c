@@ -0,0 +1,235 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995-2003 Spencer Kimball and Peter Mattis
+ *
+ * gimppdb-index.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  A trigram index over one string field of the registered procedures.
+ *  It maps each lowercase three-byte sequence to the set of procedures
+ *  whose field contains it, so that queries for a literal substring
+ *  only need to run their regex on a few candidates.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "pdb-types.h"
+
+#include "gimppdb-index.h"
+
+
+#define TRIGRAM(s) (((guint) g_ascii_tolower ((s)[0]) << 16) | \
+                    ((guint) g_ascii_tolower ((s)[1]) <<  8) | \
+                    ((guint) g_ascii_tolower ((s)[2])))
+
+
+/*  local function prototypes  */
+
+static gchar * gimp_pdb_index_get_literal (const gchar *pattern);
+
+
+/*  public functions  */
+
+GHashTable *
+gimp_pdb_index_new (void)
+{
+  return g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                NULL,
+                                (GDestroyNotify) g_hash_table_unref);
+}
+
+void
+gimp_pdb_index_add (GHashTable    *index,
+                    GimpProcedure *procedure,
+                    const gchar   *text)
+{
+  gsize len;
+  gsize i;
+
+  g_return_if_fail (index != NULL);
+  g_return_if_fail (procedure != NULL);
+
+  if (! text)
+    return;
+
+  len = strlen (text);
+
+  for (i = 0; i + 3 <= len; i++)
+    {
+      guint       trigram = TRIGRAM (text + i);
+      GHashTable *set;
+
+      set = g_hash_table_lookup (index, GUINT_TO_POINTER (trigram));
+
+      if (! set)
+        {
+          set = g_hash_table_new (g_direct_hash, g_direct_equal);
+          g_hash_table_insert (index, GUINT_TO_POINTER (trigram), set);
+        }
+
+      g_hash_table_insert (set, procedure, procedure);
+    }
+}
+
+void
+gimp_pdb_index_remove (GHashTable    *index,
+                       GimpProcedure *procedure,
+                       const gchar   *text)
+{
+  gsize len;
+  gsize i;
+
+  g_return_if_fail (index != NULL);
+  g_return_if_fail (procedure != NULL);
+
+  if (! text)
+    return;
+
+  len = strlen (text);
+
+  for (i = 0; i + 3 <= len; i++)
+    {
+      guint       trigram = TRIGRAM (text + i);
+      GHashTable *set;
+
+      set = g_hash_table_lookup (index, GUINT_TO_POINTER (trigram));
+
+      if (set)
+        {
+          g_hash_table_remove (set, procedure);
+
+          if (g_hash_table_size (set) == 0)
+            g_hash_table_remove (index, GUINT_TO_POINTER (trigram));
+        }
+    }
+}
+
+/**
+ * gimp_pdb_index_candidates:
+ * @index:   a trigram index
+ * @pattern: a regular expression as passed to gimp_pdb_query()
+ *
+ * Returns: a new set of the procedures that can possibly match
+ *          @pattern, or %NULL if @pattern is not a plain substring
+ *          and all procedures have to be checked.
+ **/
+GHashTable *
+gimp_pdb_index_candidates (GHashTable  *index,
+                           const gchar *pattern)
+{
+  GHashTable *result = NULL;
+  gchar      *literal;
+  gsize       len;
+  gsize       i;
+
+  g_return_val_if_fail (index != NULL, NULL);
+  g_return_val_if_fail (pattern != NULL, NULL);
+
+  literal = gimp_pdb_index_get_literal (pattern);
+
+  if (! literal)
+    return NULL;
+
+  len = strlen (literal);
+
+  for (i = 0; i + 3 <= len; i++)
+    {
+      GHashTable     *set;
+      GHashTableIter  iter;
+      gpointer        key;
+
+      set = g_hash_table_lookup (index,
+                                 GUINT_TO_POINTER (TRIGRAM (literal + i)));
+
+      if (! set)
+        {
+          /*  no procedure has this trigram  */
+          if (result)
+            g_hash_table_remove_all (result);
+          else
+            result = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+          break;
+        }
+
+      if (! result)
+        {
+          result = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+          g_hash_table_iter_init (&iter, set);
+
+          while (g_hash_table_iter_next (&iter, &key, NULL))
+            g_hash_table_insert (result, key, key);
+        }
+      else
+        {
+          g_hash_table_iter_init (&iter, result);
+
+          while (g_hash_table_iter_next (&iter, &key, NULL))
+            if (! g_hash_table_lookup (set, key))
+              g_hash_table_iter_remove (&iter);
+        }
+
+      if (g_hash_table_size (result) == 0)
+        break;
+    }
+
+  g_free (literal);
+
+  return result;
+}
+
+
+/*  private functions  */
+
+/*  Returns the substring that every match of @pattern has to contain,
+ *  if @pattern is a simple literal, optionally anchored or surrounded
+ *  by ".*". Only ASCII literals of at least three bytes are returned,
+ *  the index is case-folded in ASCII only.
+ */
+static gchar *
+gimp_pdb_index_get_literal (const gchar *pattern)
+{
+  const gchar *start = pattern;
+  const gchar *end   = pattern + strlen (pattern);
+  const gchar *p;
+
+  if (*start == '^')
+    start++;
+  else if (g_str_has_prefix (start, ".*"))
+    start += 2;
+
+  if (end - start >= 1 && end[-1] == '$' &&
+      (end - start < 2 || end[-2] != '\\'))
+    end--;
+  else if (end - start >= 2 && end[-2] == '.' && end[-1] == '*' &&
+           (end - start < 3 || end[-3] != '\\'))
+    end -= 2;
+
+  if (end - start < 3)
+    return NULL;
+
+  for (p = start; p < end; p++)
+    {
+      if ((guchar) *p >= 0x80 || strchr (".^$*+?()[]{}|\\", *p))
+        return NULL;
+    }
+
+  return g_strndup (start, end - start);
+}
@@ -0,0 +1,35 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995-2003 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_PDB_INDEX_H__
+#define __GIMP_PDB_INDEX_H__
+
+
+GHashTable * gimp_pdb_index_new        (void);
+
+void         gimp_pdb_index_add        (GHashTable    *index,
+                                        GimpProcedure *procedure,
+                                        const gchar   *text);
+void         gimp_pdb_index_remove     (GHashTable    *index,
+                                        GimpProcedure *procedure,
+                                        const gchar   *text);
+
+GHashTable * gimp_pdb_index_candidates (GHashTable    *index,
+                                        const gchar   *pattern);
+
+
+#endif /* __GIMP_PDB_INDEX_H__ */
@@ -30,6 +30,7 @@
 #include "core/gimpparamspecs-desc.h"
 
 #include "gimppdb.h"
+#include "gimppdb-index.h"
 #include "gimppdb-query.h"
 #include "gimppdberror.h"
 #include "gimp-pdb-compat.h"
@@ -67,6 +68,8 @@ struct _PDBQuery
   GRegex   *date_regex;
   GRegex   *proc_type_regex;
 
+  GEnumClass *proc_type_class;
+
   gchar   **list_of_procs;
   gint      num_procs;
   gboolean  querying_compat;
@@ -88,16 +91,18 @@ struct _PDBStrings
 
 /*  local function prototypes  */
 
-static void   gimp_pdb_query_entry  (gpointer       key,
-                                     gpointer       value,
-                                     gpointer       user_data);
-static void   gimp_pdb_print_entry  (gpointer       key,
-                                     gpointer       value,
-                                     gpointer       user_data);
-static void   gimp_pdb_get_strings  (PDBStrings    *strings,
-                                     GimpProcedure *procedure,
-                                     gboolean       compat);
-static void   gimp_pdb_free_strings (PDBStrings    *strings);
+static GRegex * gimp_pdb_query_regex  (const gchar   *pattern,
+                                       GError       **error);
+static void     gimp_pdb_query_entry  (gpointer       key,
+                                       gpointer       value,
+                                       gpointer       user_data);
+static void     gimp_pdb_print_entry  (gpointer       key,
+                                       gpointer       value,
+                                       gpointer       user_data);
+static void     gimp_pdb_get_strings  (PDBStrings    *strings,
+                                       GimpProcedure *procedure,
+                                       gboolean       compat);
+static void     gimp_pdb_free_strings (PDBStrings    *strings);
 
 
 /*  public functions  */
@@ -147,8 +152,10 @@ gimp_pdb_query (GimpPDB       *pdb,
                 gchar       ***procs,
                 GError       **error)
 {
-  PDBQuery pdb_query = { 0, };
-  gboolean success   = FALSE;
+  PDBQuery    pdb_query   = { 0, };
+  GHashTable *candidates  = NULL;
+  GError     *regex_error = NULL;
+  gboolean    success     = FALSE;
 
   g_return_val_if_fail (GIMP_IS_PDB (pdb), FALSE);
   g_return_val_if_fail (name != NULL, FALSE);
@@ -165,43 +172,76 @@ gimp_pdb_query (GimpPDB       *pdb,
   *num_procs = 0;
   *procs     = NULL;
 
-  pdb_query.name_regex = g_regex_new (name, PDB_REGEX_FLAGS, 0, error);
-  if (! pdb_query.name_regex)
+  pdb_query.name_regex = gimp_pdb_query_regex (name, &regex_error);
+  if (regex_error)
     goto cleanup;
 
-  pdb_query.blurb_regex = g_regex_new (blurb, PDB_REGEX_FLAGS, 0, error);
-  if (! pdb_query.blurb_regex)
+  pdb_query.blurb_regex = gimp_pdb_query_regex (blurb, &regex_error);
+  if (regex_error)
     goto cleanup;
 
-  pdb_query.help_regex = g_regex_new (help, PDB_REGEX_FLAGS, 0, error);
-  if (! pdb_query.help_regex)
+  pdb_query.help_regex = gimp_pdb_query_regex (help, &regex_error);
+  if (regex_error)
     goto cleanup;
 
-  pdb_query.author_regex = g_regex_new (author, PDB_REGEX_FLAGS, 0, error);
-  if (! pdb_query.author_regex)
+  pdb_query.author_regex = gimp_pdb_query_regex (author, &regex_error);
+  if (regex_error)
     goto cleanup;
 
-  pdb_query.copyright_regex = g_regex_new (copyright, PDB_REGEX_FLAGS, 0, error);
-  if (! pdb_query.copyright_regex)
+  pdb_query.copyright_regex = gimp_pdb_query_regex (copyright, &regex_error);
+  if (regex_error)
     goto cleanup;
 
-  pdb_query.date_regex = g_regex_new (date, PDB_REGEX_FLAGS, 0, error);
-  if (! pdb_query.date_regex)
+  pdb_query.date_regex = gimp_pdb_query_regex (date, &regex_error);
+  if (regex_error)
     goto cleanup;
 
-  pdb_query.proc_type_regex = g_regex_new (proc_type, PDB_REGEX_FLAGS, 0, error);
-  if (! pdb_query.proc_type_regex)
+  pdb_query.proc_type_regex = gimp_pdb_query_regex (proc_type, &regex_error);
+  if (regex_error)
     goto cleanup;
 
   success = TRUE;
 
   pdb_query.pdb             = pdb;
+  pdb_query.proc_type_class = g_type_class_ref (GIMP_TYPE_PDB_PROC_TYPE);
   pdb_query.list_of_procs   = NULL;
   pdb_query.num_procs       = 0;
   pdb_query.querying_compat = FALSE;
 
-  g_hash_table_foreach (pdb->procedures,
-                        gimp_pdb_query_entry, &pdb_query);
+  /*  if the name or blurb is searched for a plain substring, only the
+   *  procedures found in the trigram index need to be matched
+   */
+  candidates = gimp_pdb_index_candidates (pdb->name_index, name);
+
+  if (! candidates)
+    candidates = gimp_pdb_index_candidates (pdb->blurb_index, blurb);
+
+  if (candidates)
+    {
+      GHashTableIter  iter;
+      gpointer        key;
+
+      g_hash_table_iter_init (&iter, candidates);
+
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        {
+          const gchar *proc_name = gimp_object_get_name (key);
+          GList       *list;
+
+          list = g_hash_table_lookup (pdb->procedures, proc_name);
+
+          /*  only the most recently registered procedure is queried  */
+          if (list && list->data == key)
+            gimp_pdb_query_entry ((gpointer) proc_name, list, &pdb_query);
+        }
+
+      g_hash_table_unref (candidates);
+    }
+  else
+    {
+      g_hash_table_foreach (pdb->procedures,
+                            gimp_pdb_query_entry, &pdb_query);
+    }
 
   pdb_query.querying_compat = TRUE;
 
@@ -210,6 +250,12 @@ gimp_pdb_query (GimpPDB       *pdb,
 
  cleanup:
 
+  if (regex_error)
+    g_propagate_error (error, regex_error);
+
+  if (pdb_query.proc_type_class)
+    g_type_class_unref (pdb_query.proc_type_class);
+
   if (pdb_query.proc_type_regex)
     g_regex_unref (pdb_query.proc_type_regex);
 
@@ -304,10 +350,26 @@ gimp_pdb_proc_info (GimpPDB          *pdb,
 
 /*  private functions  */
 
+/*  Returns NULL without setting @error for patterns that match any
+ *  string, so that they don't have to be run at all.
+ */
+static GRegex *
+gimp_pdb_query_regex (const gchar  *pattern,
+                      GError      **error)
+{
+  if (! *pattern || ! strcmp (pattern, ".*") || ! strcmp (pattern, "^.*$"))
+    return NULL;
+
+  return g_regex_new (pattern, PDB_REGEX_FLAGS, 0, error);
+}
+
 static gboolean
 match_string (GRegex      *regex,
               const gchar *string)
 {
+  if (! regex)
+    return TRUE;
+
   if (! string)
     string = "";
 
@@ -324,7 +386,6 @@ gimp_pdb_query_entry (gpointer key,
   GimpProcedure *procedure;
   const gchar   *proc_name;
   PDBStrings     strings;
-  GEnumClass    *enum_class;
   GimpEnumDesc  *type_desc;
 
   proc_name = key;
@@ -341,9 +402,8 @@ gimp_pdb_query_entry (gpointer key,
 
   gimp_pdb_get_strings (&strings, procedure, pdb_query->querying_compat);
 
-  enum_class = g_type_class_ref (GIMP_TYPE_PDB_PROC_TYPE);
-  type_desc = gimp_enum_get_desc (enum_class, procedure->proc_type);
-  g_type_class_unref  (enum_class);
+  type_desc = gimp_enum_get_desc (pdb_query->proc_type_class,
+                                  procedure->proc_type);
 
   if (match_string (pdb_query->name_regex,      proc_name)         &&
       match_string (pdb_query->blurb_regex,     strings.blurb)     &&
@@ -34,7 +34,10 @@
 #include "core/gimpmarshal.h"
 #include "core/gimpprogress.h"
 
+#include "gimp-log.h"
+
 #include "gimppdb.h"
+#include "gimppdb-index.h"
 #include "gimppdberror.h"
 #include "gimpprocedure.h"
 
@@ -56,6 +59,7 @@ static void     gimp_pdb_real_register_procedure   (GimpPDB       *pdb,
                                                     GimpProcedure *procedure);
 static void     gimp_pdb_real_unregister_procedure (GimpPDB       *pdb,
                                                     GimpProcedure *procedure);
+static void     gimp_pdb_print_stats               (GimpPDB       *pdb);
 static void     gimp_pdb_entry_free                (gpointer       key,
                                                     gpointer       value,
                                                     gpointer       user_data);
@@ -109,6 +113,8 @@ gimp_pdb_init (GimpPDB *pdb)
 {
   pdb->procedures        = g_hash_table_new (g_str_hash, g_str_equal);
   pdb->compat_proc_names = g_hash_table_new (g_str_hash, g_str_equal);
+  pdb->name_index        = gimp_pdb_index_new ();
+  pdb->blurb_index       = gimp_pdb_index_new ();
 }
 
 static void
@@ -118,6 +124,9 @@ gimp_pdb_finalize (GObject *object)
 
   if (pdb->procedures)
     {
+      if (gimp_log_flags & GIMP_LOG_PDB_STATS)
+        gimp_pdb_print_stats (pdb);
+
       g_hash_table_foreach (pdb->procedures, gimp_pdb_entry_free, NULL);
       g_hash_table_destroy (pdb->procedures);
       pdb->procedures = NULL;
@@ -129,6 +138,18 @@ gimp_pdb_finalize (GObject *object)
       pdb->compat_proc_names = NULL;
     }
 
+  if (pdb->name_index)
+    {
+      g_hash_table_destroy (pdb->name_index);
+      pdb->name_index = NULL;
+    }
+
+  if (pdb->blurb_index)
+    {
+      g_hash_table_destroy (pdb->blurb_index);
+      pdb->blurb_index = NULL;
+    }
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -162,6 +183,9 @@ gimp_pdb_real_register_procedure (GimpPDB       *pdb,
 
   g_hash_table_replace (pdb->procedures, (gpointer) name,
                         g_list_prepend (list, g_object_ref (procedure)));
+
+  gimp_pdb_index_add (pdb->name_index,  procedure, name);
+  gimp_pdb_index_add (pdb->blurb_index, procedure, procedure->blurb);
 }
 
 static void
@@ -177,6 +201,9 @@ gimp_pdb_real_unregister_procedure (GimpPDB       *pdb,
 
   if (list)
     {
+      gimp_pdb_index_remove (pdb->name_index,  procedure, name);
+      gimp_pdb_index_remove (pdb->blurb_index, procedure, procedure->blurb);
+
       list = g_list_remove (list, procedure);
 
       if (list)
@@ -497,6 +524,66 @@ gimp_pdb_get_deprecated_procedures (GimpPDB *pdb)
 
 /*  private functions  */
 
+static gint
+gimp_pdb_compare_call_time (GimpProcedure *proc1,
+                            GimpProcedure *proc2)
+{
+  if (proc1->call_time > proc2->call_time)
+    return -1;
+  else if (proc1->call_time < proc2->call_time)
+    return 1;
+
+  return 0;
+}
+
+static void
+gimp_pdb_print_stats (GimpPDB *pdb)
+{
+  GHashTableIter  iter;
+  gpointer        value;
+  GList          *procs = NULL;
+  GList          *list;
+
+  g_hash_table_iter_init (&iter, pdb->procedures);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      for (list = value; list; list = g_list_next (list))
+        {
+          GimpProcedure *procedure = list->data;
+
+          if (procedure->n_calls > 0)
+            procs = g_list_prepend (procs, procedure);
+        }
+    }
+
+  procs = g_list_sort (procs, (GCompareFunc) gimp_pdb_compare_call_time);
+
+  g_printerr ("\nPDB call statistics (calls, total ms, mean µs, "
+              "calls per power-of-two µs):\n\n");
+
+  for (list = procs; list; list = g_list_next (list))
+    {
+      GimpProcedure *procedure = list->data;
+      GString       *bins      = g_string_new (NULL);
+      gint           i;
+
+      for (i = 0; i < GIMP_PROCEDURE_N_TIME_BINS; i++)
+        g_string_append_printf (bins, " %u", procedure->call_times[i]);
+
+      g_printerr ("%-40s %8u %10.3f %10.1f  %s\n",
+                  gimp_object_get_name (procedure),
+                  procedure->n_calls,
+                  procedure->call_time / 1000.0,
+                  (gdouble) procedure->call_time / procedure->n_calls,
+                  bins->str);
+
+      g_string_free (bins, TRUE);
+    }
+
+  g_list_free (procs);
+}
+
 static void
 gimp_pdb_entry_free (gpointer key,
                      gpointer value,
@@ -40,6 +40,9 @@ struct _GimpPDB
 
   GHashTable *procedures;
   GHashTable *compat_proc_names;
+
+  GHashTable *name_index;   /*  trigram indexes for gimp_pdb_query()  */
+  GHashTable *blurb_index;
 };
 
 struct _GimpPDBClass
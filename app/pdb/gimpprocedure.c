@@ -35,6 +35,8 @@
 
 #include "vectors/gimpvectors.h"
 
+#include "gimp-log.h"
+
 #include "gimppdbcontext.h"
 #include "gimppdberror.h"
 #include "gimpprocedure.h"
@@ -67,6 +69,9 @@ static gboolean         gimp_procedure_validate_args (GimpProcedure   *procedure
                                                       GimpValueArray  *args,
                                                       gboolean         return_vals,
                                                       GError         **error);
+static gboolean         gimp_procedure_type_is_scalar (GType           type);
+static void             gimp_procedure_add_call_time (GimpProcedure   *procedure,
+                                                      gint64           time);
 
 
 G_DEFINE_TYPE (GimpProcedure, gimp_procedure, GIMP_TYPE_OBJECT)
@@ -303,7 +308,8 @@ gimp_procedure_execute (GimpProcedure   *procedure,
                         GError         **error)
 {
   GimpValueArray *return_vals;
-  GError         *pdb_error = NULL;
+  GError         *pdb_error  = NULL;
+  gint64          start_time = 0;
 
   g_return_val_if_fail (GIMP_IS_PROCEDURE (procedure), NULL);
   g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
@@ -312,6 +318,9 @@ gimp_procedure_execute (GimpProcedure   *procedure,
   g_return_val_if_fail (args != NULL, NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
+  if (gimp_log_flags & GIMP_LOG_PDB_STATS)
+    start_time = g_get_monotonic_time ();
+
   if (! gimp_procedure_validate_args (procedure,
                                       procedure->args, procedure->num_args,
                                       args, FALSE, &pdb_error))
@@ -338,6 +347,10 @@ gimp_procedure_execute (GimpProcedure   *procedure,
 
   g_object_unref (context);
 
+  if (gimp_log_flags & GIMP_LOG_PDB_STATS)
+    gimp_procedure_add_call_time (procedure,
+                                  g_get_monotonic_time () - start_time);
+
   if (return_vals)
     {
       switch (g_value_get_enum (gimp_value_array_index (return_vals, 0)))
@@ -619,6 +632,49 @@ gimp_procedure_free_strings (GimpProcedure *procedure)
   procedure->static_strings = FALSE;
 }
 
+static gboolean
+gimp_procedure_type_is_scalar (GType type)
+{
+  switch (G_TYPE_FUNDAMENTAL (type))
+    {
+    case G_TYPE_CHAR:
+    case G_TYPE_UCHAR:
+    case G_TYPE_BOOLEAN:
+    case G_TYPE_INT:
+    case G_TYPE_UINT:
+    case G_TYPE_LONG:
+    case G_TYPE_ULONG:
+    case G_TYPE_INT64:
+    case G_TYPE_UINT64:
+    case G_TYPE_ENUM:
+    case G_TYPE_FLAGS:
+    case G_TYPE_FLOAT:
+    case G_TYPE_DOUBLE:
+      return TRUE;
+
+    default:
+      return FALSE;
+    }
+}
+
+static void
+gimp_procedure_add_call_time (GimpProcedure *procedure,
+                              gint64         time)
+{
+  gint bin = 0;
+
+  procedure->n_calls++;
+  procedure->call_time += time;
+
+  while (time > 1 && bin < GIMP_PROCEDURE_N_TIME_BINS - 1)
+    {
+      time >>= 1;
+      bin++;
+    }
+
+  procedure->call_times[bin]++;
+}
+
 static gboolean
 gimp_procedure_validate_args (GimpProcedure  *procedure,
                               GParamSpec    **param_specs,
@@ -667,18 +723,43 @@ gimp_procedure_validate_args (GimpProcedure  *procedure,
         }
       else if (! (pspec->flags & GIMP_PARAM_NO_VALIDATE))
         {
-          GValue string_value = { 0, };
+          GValue   string_value = { 0, };
+          GValue   orig_value   = { 0, };
+          gboolean scalar       = gimp_procedure_type_is_scalar (arg_type);
 
           g_value_init (&string_value, G_TYPE_STRING);
 
-          if (g_value_type_transformable (arg_type, G_TYPE_STRING))
-            g_value_transform (arg, &string_value);
+          /*  The original value is only needed for the error message.
+           *  Turning every argument into a string up front is costly
+           *  for plug-ins making many small calls, so plain numbers
+           *  are copied and only transformed if validation fails.
+           */
+          if (scalar)
+            {
+              g_value_init (&orig_value, arg_type);
+              g_value_copy (arg, &orig_value);
+            }
+          else if (g_value_type_transformable (arg_type, G_TYPE_STRING))
+            {
+              g_value_transform (arg, &string_value);
+            }
           else
-            g_value_set_static_string (&string_value,
-                                       "<not transformable to string>");
+            {
+              g_value_set_static_string (&string_value,
+                                         "<not transformable to string>");
+            }
 
           if (g_param_value_validate (pspec, arg))
             {
+              if (scalar)
+                {
+                  if (g_value_type_transformable (arg_type, G_TYPE_STRING))
+                    g_value_transform (&orig_value, &string_value);
+                  else
+                    g_value_set_static_string (&string_value,
+                                               "<not transformable to string>");
+                }
+
               if (GIMP_IS_PARAM_SPEC_DRAWABLE_ID (pspec) &&
                   g_value_get_int (arg) == -1)
                 {
@@ -778,10 +859,16 @@ gimp_procedure_validate_args (GimpProcedure  *procedure,
 
               g_value_unset (&string_value);
 
+              if (scalar)
+                g_value_unset (&orig_value);
+
               return FALSE;
             }
 
           g_value_unset (&string_value);
+
+          if (scalar)
+            g_value_unset (&orig_value);
         }
     }
 
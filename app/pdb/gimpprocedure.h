@@ -40,6 +40,9 @@ typedef GimpValueArray * (* GimpMarshalFunc) (GimpProcedure         *procedure,
 
 typedef struct _GimpProcedureClass GimpProcedureClass;
 
+#define GIMP_PROCEDURE_N_TIME_BINS 16
+
+
 struct _GimpProcedure
 {
   GimpObject        parent_instance;
@@ -63,6 +66,12 @@ struct _GimpProcedure
   GParamSpec      **values;         /* Array of return values         */
 
   GimpMarshalFunc   marshal_func;   /* Marshaller for internal procs  */
+
+  /*  only counted with GIMP_LOG=pdb-stats  */
+  guint             n_calls;        /* Number of calls                */
+  gint64            call_time;      /* Total time of all calls, in µs */
+  guint             call_times[GIMP_PROCEDURE_N_TIME_BINS];
+                                    /* Calls by log2 of their µs      */
 };
 
 struct _GimpProcedureClass
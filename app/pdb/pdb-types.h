@@ -28,6 +28,11 @@ typedef struct _GimpPlugInProcedure    GimpPlugInProcedure;
 typedef struct _GimpTemporaryProcedure GimpTemporaryProcedure;
 
 
+typedef void (* GimpProcedureReturnFunc) (GimpProcedure  *procedure,
+                                          GimpValueArray *return_vals,
+                                          gpointer        user_data);
+
+
 typedef enum
 {
   GIMP_PDB_COMPAT_OFF,
@@ -45,6 +45,7 @@
 #include "gimpplugin-cleanup.h"
 #include "gimpplugin-message.h"
 #include "gimppluginmanager.h"
+#include "gimppluginmanager-resident.h"
 #include "gimpplugindef.h"
 #include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
@@ -62,6 +63,11 @@ static void gimp_plug_in_handle_tile_put         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
 static void gimp_plug_in_handle_tile_get         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
+static void gimp_plug_in_handle_region_request   (GimpPlugIn      *plug_in,
+                                                  GPRegionReq     *request);
+static void gimp_plug_in_handle_region_put       (GimpPlugIn      *plug_in);
+static void gimp_plug_in_handle_region_get       (GimpPlugIn      *plug_in,
+                                                  GPRegionReq     *request);
 static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
                                                   GPProcRun       *proc_run);
 static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
@@ -74,6 +80,7 @@ static void gimp_plug_in_handle_proc_uninstall   (GimpPlugIn      *plug_in,
                                                   GPProcUninstall *proc_uninstall);
 static void gimp_plug_in_handle_extension_ack    (GimpPlugIn      *plug_in);
 static void gimp_plug_in_handle_has_init         (GimpPlugIn      *plug_in);
+static void gimp_plug_in_handle_resident         (GimpPlugIn      *plug_in);
 
 
 /*  public functions  */
@@ -159,6 +166,23 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_REGION_REQ:
+      gimp_plug_in_handle_region_request (plug_in, msg->data);
+      break;
+
+    case GP_REGION_DATA:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent a REGION_DATA message.  This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
+
+    case GP_RESIDENT:
+      gimp_plug_in_handle_resident (plug_in);
+      break;
     }
 }
 
@@ -194,6 +218,8 @@ gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
   GeglBuffer      *buffer;
   const Babl      *format;
   GeglRectangle    tile_rect;
+  gsize            slot_size;
+  guint            i;
 
   tile_data.drawable_ID = -1;
   tile_data.tile_num    = 0;
@@ -202,6 +228,7 @@ gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
   tile_data.width       = 0;
   tile_data.height      = 0;
   tile_data.use_shm     = (plug_in->manager->shm != NULL);
+  tile_data.n_tiles     = 0;
   tile_data.data        = NULL;
 
   if (! gp_tile_data_write (plug_in->my_write, &tile_data, plug_in))
@@ -297,39 +324,61 @@ gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
       buffer = gimp_drawable_get_buffer (drawable);
     }
 
-  if (! gimp_gegl_buffer_get_tile_rect (buffer,
-                                        GIMP_PLUG_IN_TILE_WIDTH,
-                                        GIMP_PLUG_IN_TILE_HEIGHT,
-                                        tile_info->tile_num,
-                                        &tile_rect))
+  format = gegl_buffer_get_format (buffer);
+
+  if (! gimp_plug_in_precision_enabled (plug_in))
+    {
+      format = gimp_babl_compat_u8_format (format);
+    }
+
+  slot_size = (babl_format_get_bytes_per_pixel (format) *
+               GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT);
+
+  if (tile_info->n_tiles < 1 ||
+      (tile_info->n_tiles > 1 &&
+       (! tile_data.use_shm ||
+        tile_info->n_tiles >
+        gimp_plug_in_shm_get_size (plug_in->manager->shm) / slot_size)))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                     "Plug-In \"%s\"\n(%s)\n\n"
-                    "requested invalid tile (killing)",
+                    "sent an invalid number of tiles (killing)",
                     gimp_object_get_name (plug_in),
                     gimp_filename_to_utf8 (plug_in->prog));
       gimp_plug_in_close (plug_in, TRUE);
       return;
     }
 
-  format = gegl_buffer_get_format (buffer);
-
-  if (! gimp_plug_in_precision_enabled (plug_in))
+  for (i = 0; i < tile_info->n_tiles; i++)
     {
-      format = gimp_babl_compat_u8_format (format);
-    }
+      if (! gimp_gegl_buffer_get_tile_rect (buffer,
+                                            GIMP_PLUG_IN_TILE_WIDTH,
+                                            GIMP_PLUG_IN_TILE_HEIGHT,
+                                            tile_info->tile_num + i,
+                                            &tile_rect))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "requested invalid tile (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog));
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
 
-  if (tile_data.use_shm)
-    {
-      gegl_buffer_set (buffer, &tile_rect, 0, format,
-                       gimp_plug_in_shm_get_addr (plug_in->manager->shm),
-                       GEGL_AUTO_ROWSTRIDE);
-    }
-  else
-    {
-      gegl_buffer_set (buffer, &tile_rect, 0, format,
-                       tile_info->data,
-                       GEGL_AUTO_ROWSTRIDE);
+      if (tile_data.use_shm)
+        {
+          gegl_buffer_set (buffer, &tile_rect, 0, format,
+                           gimp_plug_in_shm_get_addr (plug_in->manager->shm) +
+                           i * slot_size,
+                           GEGL_AUTO_ROWSTRIDE);
+        }
+      else
+        {
+          gegl_buffer_set (buffer, &tile_rect, 0, format,
+                           tile_info->data,
+                           GEGL_AUTO_ROWSTRIDE);
+        }
     }
 
   gimp_wire_destroy (&msg);
@@ -354,6 +403,8 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
   const Babl      *format;
   GeglRectangle    tile_rect;
   gint             tile_size;
+  gsize            slot_size;
+  guint            n_tiles;
 
   drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
                                                    request->drawable_ID);
@@ -425,12 +476,43 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
   tile_data.width       = tile_rect.width;
   tile_data.height      = tile_rect.height;
   tile_data.use_shm     = (plug_in->manager->shm != NULL);
+  tile_data.n_tiles     = 1;
 
   if (tile_data.use_shm)
     {
+      guchar *shm_addr = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
+
       gegl_buffer_get (buffer, &tile_rect, 1.0, format,
-                       gimp_plug_in_shm_get_addr (plug_in->manager->shm),
+                       shm_addr,
                        GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      /*  fill the rest of the batch the plug-in asked for, as far as
+       *  the segment and the drawable go
+       */
+      slot_size = (babl_format_get_bytes_per_pixel (format) *
+                   GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT);
+      n_tiles   = MIN (request->n_tiles,
+                       gimp_plug_in_shm_get_size (plug_in->manager->shm) /
+                       slot_size);
+
+      while (tile_data.n_tiles < n_tiles)
+        {
+          GeglRectangle rect;
+
+          if (! gimp_gegl_buffer_get_tile_rect (buffer,
+                                                GIMP_PLUG_IN_TILE_WIDTH,
+                                                GIMP_PLUG_IN_TILE_HEIGHT,
+                                                request->tile_num +
+                                                tile_data.n_tiles,
+                                                &rect))
+            break;
+
+          gegl_buffer_get (buffer, &rect, 1.0, format,
+                           shm_addr + tile_data.n_tiles * slot_size,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          tile_data.n_tiles++;
+        }
     }
   else
     {
@@ -503,6 +585,310 @@ gimp_plug_in_handle_proc_error (GimpPlugIn          *plug_in,
     }
 }
 
+static void
+gimp_plug_in_handle_region_request (GimpPlugIn  *plug_in,
+                                    GPRegionReq *request)
+{
+  g_return_if_fail (request != NULL);
+
+  if (request->drawable_ID == -1)
+    gimp_plug_in_handle_region_put (plug_in);
+  else
+    gimp_plug_in_handle_region_get (plug_in, request);
+}
+
+/*  Looks up the buffer a region message refers to, and the format the
+ *  plug-in sees it in. Kills the plug-in and returns NULL if the
+ *  region is not valid.
+ */
+static GeglBuffer *
+gimp_plug_in_get_region_buffer (GimpPlugIn           *plug_in,
+                                gint32                drawable_ID,
+                                gboolean              shadow,
+                                const GeglRectangle  *rect,
+                                gboolean              writing,
+                                const Babl          **format)
+{
+  GimpDrawable *drawable;
+  GeglBuffer   *buffer;
+
+  drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
+                                                   drawable_ID);
+
+  if (! GIMP_IS_DRAWABLE (drawable))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried accessing invalid drawable %d (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return NULL;
+    }
+  else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried accessing drawable %d which was removed "
+                    "from the image (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return NULL;
+    }
+
+  if (shadow)
+    {
+      /*  see gimp_plug_in_handle_tile_put()  */
+      buffer = gimp_drawable_get_shadow_buffer (drawable);
+
+      gimp_plug_in_cleanup_add_shadow (plug_in, drawable);
+    }
+  else
+    {
+      if (writing && gimp_item_is_content_locked (GIMP_ITEM (drawable)))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "tried writing to a locked drawable %d (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog),
+                        drawable_ID);
+          gimp_plug_in_close (plug_in, TRUE);
+          return NULL;
+        }
+      else if (writing && gimp_viewable_get_children (GIMP_VIEWABLE (drawable)))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "tried writing to a group layer %d (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog),
+                        drawable_ID);
+          gimp_plug_in_close (plug_in, TRUE);
+          return NULL;
+        }
+
+      buffer = gimp_drawable_get_buffer (drawable);
+    }
+
+  if (rect->width < 1 || rect->height < 1 ||
+      ! gegl_rectangle_contains (gegl_buffer_get_extent (buffer), rect))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "requested invalid region (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+      return NULL;
+    }
+
+  *format = gegl_buffer_get_format (buffer);
+
+  if (! gimp_plug_in_precision_enabled (plug_in))
+    {
+      *format = gimp_babl_compat_u8_format (*format);
+    }
+
+  return buffer;
+}
+
+static void
+gimp_plug_in_handle_region_put (GimpPlugIn *plug_in)
+{
+  GPRegionData     region_data = { 0, };
+  GPRegionData    *region_info;
+  GimpWireMessage  msg;
+  GeglBuffer      *buffer;
+  const Babl      *format;
+  GeglRectangle    rect;
+  gsize            size;
+
+  region_data.drawable_ID = -1;
+  region_data.use_shm     = (plug_in->manager->shm != NULL);
+
+  if (! gp_region_data_write (plug_in->my_write, &region_data, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (msg.type != GP_REGION_DATA)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected region data and received: %d", msg.type);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  region_info = msg.data;
+
+  rect.x      = region_info->x;
+  rect.y      = region_info->y;
+  rect.width  = region_info->width;
+  rect.height = region_info->height;
+
+  buffer = gimp_plug_in_get_region_buffer (plug_in,
+                                           region_info->drawable_ID,
+                                           region_info->shadow,
+                                           &rect, TRUE, &format);
+  if (! buffer)
+    {
+      gimp_wire_destroy (&msg);
+      return;
+    }
+
+  size = ((gsize) rect.width * rect.height *
+          babl_format_get_bytes_per_pixel (format));
+
+  if (region_info->bpp != babl_format_get_bytes_per_pixel (format) ||
+      (region_info->use_shm &&
+       (! region_data.use_shm ||
+        size > gimp_plug_in_shm_get_size (plug_in->manager->shm))))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent invalid region data (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_wire_destroy (&msg);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (region_info->use_shm)
+    {
+      gegl_buffer_set (buffer, &rect, 0, format,
+                       gimp_plug_in_shm_get_addr (plug_in->manager->shm),
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+  else
+    {
+      gegl_buffer_set (buffer, &rect, 0, format,
+                       region_info->data,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  gimp_wire_destroy (&msg);
+
+  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+}
+
+static void
+gimp_plug_in_handle_region_get (GimpPlugIn  *plug_in,
+                                GPRegionReq *request)
+{
+  GPRegionData     region_data;
+  GimpWireMessage  msg;
+  GeglBuffer      *buffer;
+  const Babl      *format;
+  GeglRectangle    rect;
+  gsize            size;
+
+  rect.x      = request->x;
+  rect.y      = request->y;
+  rect.width  = request->width;
+  rect.height = request->height;
+
+  buffer = gimp_plug_in_get_region_buffer (plug_in,
+                                           request->drawable_ID,
+                                           request->shadow,
+                                           &rect, FALSE, &format);
+  if (! buffer)
+    return;
+
+  size = ((gsize) rect.width * rect.height *
+          babl_format_get_bytes_per_pixel (format));
+
+  region_data.drawable_ID = request->drawable_ID;
+  region_data.shadow      = request->shadow;
+  region_data.x           = rect.x;
+  region_data.y           = rect.y;
+  region_data.width       = rect.width;
+  region_data.height      = rect.height;
+  region_data.bpp         = babl_format_get_bytes_per_pixel (format);
+  region_data.use_shm     = FALSE;
+  region_data.data        = NULL;
+
+  if (plug_in->manager->shm &&
+      size <= gimp_plug_in_shm_get_size (plug_in->manager->shm))
+    region_data.use_shm = TRUE;
+
+  if (! region_data.use_shm && size > G_MAXINT)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "requested a too large region (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (region_data.use_shm)
+    {
+      gegl_buffer_get (buffer, &rect, 1.0, format,
+                       gimp_plug_in_shm_get_addr (plug_in->manager->shm),
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+    }
+  else
+    {
+      region_data.data = g_malloc (size);
+
+      gegl_buffer_get (buffer, &rect, 1.0, format,
+                       region_data.data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+    }
+
+  if (! gp_region_data_write (plug_in->my_write, &region_data, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      g_free (region_data.data);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  g_free (region_data.data);
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (msg.type != GP_TILE_ACK)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile ack and received: %d", msg.type);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  gimp_wire_destroy (&msg);
+}
+
 static void
 gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
                               GPProcRun  *proc_run)
@@ -639,7 +1025,11 @@ static void
 gimp_plug_in_handle_proc_return (GimpPlugIn   *plug_in,
                                  GPProcReturn *proc_return)
 {
-  GimpPlugInProcFrame *proc_frame = &plug_in->main_proc_frame;
+  GimpPlugInProcFrame     *proc_frame  = &plug_in->main_proc_frame;
+  GimpProcedureReturnFunc  return_func = NULL;
+  gpointer                 return_data = NULL;
+  GimpProcedure           *procedure   = NULL;
+  GimpValueArray          *return_vals = NULL;
 
   g_return_if_fail (proc_return != NULL);
 
@@ -654,6 +1044,19 @@ gimp_plug_in_handle_proc_return (GimpPlugIn   *plug_in,
     {
       g_main_loop_quit (proc_frame->main_loop);
     }
+  else if (proc_frame->return_func)
+    {
+      /*  the caller of an asynchronous run wants the return values,
+       *  pass them on once the plug-in is done below
+       */
+      return_func = proc_frame->return_func;
+      return_data = proc_frame->return_data;
+      procedure   = g_object_ref (proc_frame->procedure);
+      return_vals = gimp_plug_in_proc_frame_get_return_values (proc_frame);
+
+      proc_frame->return_func = NULL;
+      proc_frame->return_data = NULL;
+    }
   else
     {
       /*  the plug-in is run asynchronously, so display its error
@@ -665,7 +1068,18 @@ gimp_plug_in_handle_proc_return (GimpPlugIn   *plug_in,
                                                    proc_frame->return_vals);
     }
 
-  gimp_plug_in_close (plug_in, FALSE);
+  if (plug_in->resident)
+    gimp_plug_in_manager_add_resident (plug_in->manager, plug_in);
+  else
+    gimp_plug_in_close (plug_in, FALSE);
+
+  if (return_func)
+    {
+      return_func (procedure, return_vals, return_data);
+
+      gimp_value_array_unref (return_vals);
+      g_object_unref (procedure);
+    }
 }
 
 static void
@@ -961,3 +1375,27 @@ gimp_plug_in_handle_has_init (GimpPlugIn *plug_in)
       gimp_plug_in_close (plug_in, TRUE);
     }
 }
+
+static void
+gimp_plug_in_handle_resident (GimpPlugIn *plug_in)
+{
+  GimpProcedure *procedure = plug_in->main_proc_frame.procedure;
+
+  if (plug_in->call_mode == GIMP_PLUG_IN_CALL_RUN &&
+      GIMP_IS_PLUG_IN_PROCEDURE (procedure)       &&
+      gimp_plug_in_manager_resident_enabled (plug_in->manager,
+                                             GIMP_PLUG_IN_PROCEDURE (procedure)))
+    {
+      plug_in->resident = TRUE;
+    }
+  else
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent a RESIDENT message although it may not stay "
+                    "resident.  This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+}
@@ -342,7 +342,7 @@ gimp_plug_in_progress_cancel_callback (GimpProgress *progress,
   GimpPlugInProcFrame *proc_frame = &plug_in->main_proc_frame;
   GList               *list;
 
-  if (proc_frame->main_loop)
+  if (proc_frame->main_loop || proc_frame->return_func)
     {
       proc_frame->return_vals =
         get_cancel_return_values (proc_frame->procedure);
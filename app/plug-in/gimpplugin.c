@@ -93,6 +93,7 @@
 #include "gimppluginmanager.h"
 #include "gimppluginmanager-help-domain.h"
 #include "gimppluginmanager-locale-domain.h"
+#include "gimppluginmanager-resident.h"
 #include "gimptemporaryprocedure.h"
 #include "plug-in-params.h"
 
@@ -156,6 +157,7 @@ gimp_plug_in_init (GimpPlugIn *plug_in)
   plug_in->his_write          = NULL;
 
   plug_in->input_id           = 0;
+  plug_in->resident_timeout_id = 0;
   plug_in->write_buffer_index = 0;
 
   plug_in->temp_procedures    = NULL;
@@ -425,7 +427,10 @@ gimp_plug_in_close (GimpPlugIn *plug_in,
   g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
   g_return_if_fail (plug_in->open);
 
-  plug_in->open = FALSE;
+  plug_in->open     = FALSE;
+  plug_in->resident = FALSE;
+
+  gimp_plug_in_manager_remove_resident (plug_in->manager, plug_in);
 
   if (plug_in->pid)
     {
@@ -579,6 +584,26 @@ gimp_plug_in_close (GimpPlugIn *plug_in,
     gimp_plug_in_remove_temp_proc (plug_in, plug_in->temp_procedures->data);
 
   gimp_plug_in_manager_remove_open_plug_in (plug_in->manager, plug_in);
+
+  /*  An asynchronous caller still waiting for return values gets
+   *  the cancel values, or an error if the plug-in went away
+   */
+  if (plug_in->main_proc_frame.return_func)
+    {
+      GimpPlugInProcFrame     *proc_frame  = &plug_in->main_proc_frame;
+      GimpProcedureReturnFunc  return_func = proc_frame->return_func;
+      GimpProcedure           *procedure   = g_object_ref (proc_frame->procedure);
+      GimpValueArray          *return_vals;
+
+      return_vals = gimp_plug_in_proc_frame_get_return_values (proc_frame);
+
+      proc_frame->return_func = NULL;
+
+      return_func (procedure, return_vals, proc_frame->return_data);
+
+      gimp_value_array_unref (return_vals);
+      g_object_unref (procedure);
+    }
 }
 
 static gboolean
@@ -656,29 +681,25 @@ gimp_plug_in_write (GIOChannel   *channel,
                     gpointer      data)
 {
   GimpPlugIn *plug_in = data;
-  gulong      bytes;
 
-  while (count > 0)
+  if ((plug_in->write_buffer_index + count) >= WRITE_BUFFER_SIZE)
     {
-      if ((plug_in->write_buffer_index + count) >= WRITE_BUFFER_SIZE)
-        {
-          bytes = WRITE_BUFFER_SIZE - plug_in->write_buffer_index;
-          memcpy (&plug_in->write_buffer[plug_in->write_buffer_index],
-                  buf, bytes);
-          plug_in->write_buffer_index += bytes;
-          if (! gimp_wire_flush (channel, plug_in))
-            return FALSE;
-        }
-      else
-        {
-          bytes = count;
-          memcpy (&plug_in->write_buffer[plug_in->write_buffer_index],
-                  buf, bytes);
-          plug_in->write_buffer_index += bytes;
-        }
+      /*  send what we have buffered together with the new data,
+       *  instead of pushing the new data through the buffer
+       */
+      if (! gimp_wire_writev (channel,
+                              (const guint8 *) plug_in->write_buffer,
+                              plug_in->write_buffer_index,
+                              buf, count))
+        return FALSE;
 
-      buf += bytes;
-      count -= bytes;
+      plug_in->write_buffer_index = 0;
+    }
+  else
+    {
+      memcpy (&plug_in->write_buffer[plug_in->write_buffer_index],
+              buf, count);
+      plug_in->write_buffer_index += count;
     }
 
   return TRUE;
@@ -692,45 +713,11 @@ gimp_plug_in_flush (GIOChannel *channel,
 
   if (plug_in->write_buffer_index > 0)
     {
-      GIOStatus  status;
-      GError    *error = NULL;
-      gint       count;
-      gsize      bytes;
-
-      count = 0;
-      while (count != plug_in->write_buffer_index)
-        {
-          do
-            {
-              bytes = 0;
-              status = g_io_channel_write_chars (channel,
-                                                 &plug_in->write_buffer[count],
-                                                 (plug_in->write_buffer_index - count),
-                                                 &bytes,
-                                                 &error);
-            }
-          while (status == G_IO_STATUS_AGAIN);
-
-          if (status != G_IO_STATUS_NORMAL)
-            {
-              if (error)
-                {
-                  g_warning ("%s: plug_in_flush(): error: %s",
-                             gimp_filename_to_utf8 (g_get_prgname ()),
-                             error->message);
-                  g_error_free (error);
-                }
-              else
-                {
-                  g_warning ("%s: plug_in_flush(): error",
-                             gimp_filename_to_utf8 (g_get_prgname ()));
-                }
-
-              return FALSE;
-            }
-
-          count += bytes;
-        }
+      if (! gimp_wire_writev (channel,
+                              (const guint8 *) plug_in->write_buffer,
+                              plug_in->write_buffer_index,
+                              NULL, 0))
+        return FALSE;
 
       plug_in->write_buffer_index = 0;
     }
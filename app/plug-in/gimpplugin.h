@@ -25,7 +25,7 @@
 #include "gimppluginprocframe.h"
 
 
-#define WRITE_BUFFER_SIZE  512
+#define WRITE_BUFFER_SIZE  4096
 
 
 #define GIMP_TYPE_PLUG_IN            (gimp_plug_in_get_type ())
@@ -48,6 +48,7 @@ struct _GimpPlugIn
   guint                open : 1;        /*  Is the plug-in open?              */
   guint                hup : 1;         /*  Did we receive a G_IO_HUP         */
   guint                precision : 1;   /*  True drawable precision enabled   */
+  guint                resident : 1;    /*  Will serve another GP_PROC_RUN    */
   GPid                 pid;             /*  Plug-in's process id              */
 
   GIOChannel          *my_read;         /*  App's read and write channels     */
@@ -56,6 +57,7 @@ struct _GimpPlugIn
   GIOChannel          *his_write;
 
   guint                input_id;        /*  Id of input proc                  */
+  guint                resident_timeout_id; /*  Idle timeout while resident   */
 
   gchar                write_buffer[WRITE_BUFFER_SIZE]; /* Buffer for writing */
   gint                 write_buffer_index;              /* Buffer index       */
@@ -46,6 +46,7 @@ struct _GimpPlugInDef
   gchar      *help_domain_name;
   gchar      *help_domain_uri;
   time_t      mtime;
+  gchar      *checksum;     /* SHA-1 of the executable, if known         */
   gboolean    needs_query;  /* Does the plug-in need to be queried ?     */
   gboolean    has_init;     /* Does the plug-in need to be initialized ? */
 };
@@ -75,6 +76,9 @@ void   gimp_plug_in_def_set_help_domain   (GimpPlugInDef       *plug_in_def,
 
 void   gimp_plug_in_def_set_mtime         (GimpPlugInDef       *plug_in_def,
                                            time_t               mtime);
+void   gimp_plug_in_def_set_checksum      (GimpPlugInDef       *plug_in_def,
+                                           const gchar         *checksum);
+gchar * gimp_plug_in_def_compute_checksum (GimpPlugInDef       *plug_in_def);
 void   gimp_plug_in_def_set_needs_query   (GimpPlugInDef       *plug_in_def,
                                            gboolean             needs_query);
 void   gimp_plug_in_def_set_has_init      (GimpPlugInDef       *plug_in_def,
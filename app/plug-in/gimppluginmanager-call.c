@@ -19,6 +19,8 @@
 
 #include "config.h"
 
+#include <errno.h>
+
 #include <gegl.h>
 
 #include "libgimpbase/gimpbase.h"
@@ -41,6 +43,7 @@
 #include "gimppluginmanager.h"
 #define __YES_I_NEED_GIMP_PLUG_IN_MANAGER_CALL__
 #include "gimppluginmanager-call.h"
+#include "gimppluginmanager-resident.h"
 #include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
 #include "plug-in-params.h"
@@ -48,6 +51,18 @@
 #include "gimp-intl.h"
 
 
+static GimpValueArray * gimp_plug_in_manager_call_run_internal
+                                          (GimpPlugInManager       *manager,
+                                           GimpContext             *context,
+                                           GimpProgress            *progress,
+                                           GimpPlugInProcedure     *procedure,
+                                           GimpValueArray          *args,
+                                           gboolean                 synchronous,
+                                           GimpObject              *display,
+                                           GimpProcedureReturnFunc  return_func,
+                                           gpointer                 return_data);
+
+
 /*  public functions  */
 
 void
@@ -90,6 +105,169 @@ gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
     }
 }
 
+void
+gimp_plug_in_manager_call_query_parallel (GimpPlugInManager  *manager,
+                                          GimpContext        *context,
+                                          GSList             *plug_in_defs,
+                                          gint                n_parallel,
+                                          GimpInitStatusFunc  status_callback)
+{
+  GSList *running = NULL;
+  gint    n_plugins;
+  gint    nth     = 0;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
+  g_return_if_fail (status_callback != NULL);
+
+  n_plugins = g_slist_length (plug_in_defs);
+
+#ifdef G_OS_WIN32
+  /*  g_poll() can't wait on the plug-in pipes here  */
+  n_parallel = 1;
+#endif
+
+  if (n_parallel <= 1)
+    {
+      for (; plug_in_defs; plug_in_defs = plug_in_defs->next)
+        {
+          GimpPlugInDef *plug_in_def = plug_in_defs->data;
+          gchar         *basename;
+
+          basename = g_filename_display_basename (plug_in_def->prog);
+          status_callback (NULL, basename,
+                           (gdouble) nth++ / (gdouble) n_plugins);
+          g_free (basename);
+
+          gimp_plug_in_manager_call_query (manager, context, plug_in_def);
+        }
+
+      return;
+    }
+
+  while (plug_in_defs || running)
+    {
+      GPollFD *fds;
+      GSList  *list;
+      gint     n_fds;
+      gint     i;
+
+      /*  fill up the free slots  */
+      while (plug_in_defs && g_slist_length (running) < n_parallel)
+        {
+          GimpPlugInDef *plug_in_def = plug_in_defs->data;
+          GimpPlugIn    *plug_in;
+          gchar         *basename;
+
+          plug_in_defs = plug_in_defs->next;
+
+          basename = g_filename_display_basename (plug_in_def->prog);
+          status_callback (NULL, basename,
+                           (gdouble) nth++ / (gdouble) n_plugins);
+          g_free (basename);
+
+          plug_in = gimp_plug_in_new (manager, context, NULL,
+                                      NULL, plug_in_def->prog);
+
+          if (! plug_in)
+            continue;
+
+          plug_in->plug_in_def = plug_in_def;
+
+          if (gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_QUERY, TRUE))
+            running = g_slist_append (running, plug_in);
+          else
+            g_object_unref (plug_in);
+        }
+
+      if (! running)
+        break;
+
+      n_fds = g_slist_length (running);
+      fds   = g_new0 (GPollFD, n_fds);
+
+      for (list = running, i = 0; list; list = list->next, i++)
+        {
+          GimpPlugIn *plug_in = list->data;
+
+          fds[i].fd     = g_io_channel_unix_get_fd (plug_in->my_read);
+          fds[i].events = G_IO_IN | G_IO_HUP | G_IO_ERR;
+        }
+
+      if (g_poll (fds, n_fds, -1) < 0)
+        {
+          g_free (fds);
+
+          if (errno == EINTR)
+            continue;
+
+          /*  fall back to finishing the running plug-ins one by one  */
+          break;
+        }
+
+      /*  handle one message from each plug-in that has something to say,
+       *  each message is processed completely before the next one, so
+       *  manager->current_plug_in is always right for PDB calls
+       */
+      for (list = running, i = 0; list; i++)
+        {
+          GimpPlugIn *plug_in = list->data;
+
+          list = list->next;
+
+          if (fds[i].revents)
+            {
+              GimpWireMessage msg;
+
+              if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+                {
+                  gimp_plug_in_close (plug_in, TRUE);
+                }
+              else
+                {
+                  gimp_plug_in_handle_message (plug_in, &msg);
+                  gimp_wire_destroy (&msg);
+                }
+            }
+
+          if (! plug_in->open)
+            {
+              running = g_slist_remove (running, plug_in);
+              g_object_unref (plug_in);
+            }
+        }
+
+      g_free (fds);
+    }
+
+  /*  only reached if polling failed  */
+  while (running)
+    {
+      GimpPlugIn *plug_in = running->data;
+
+      while (plug_in->open)
+        {
+          GimpWireMessage msg;
+
+          if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+            {
+              gimp_plug_in_close (plug_in, TRUE);
+            }
+          else
+            {
+              gimp_plug_in_handle_message (plug_in, &msg);
+              gimp_wire_destroy (&msg);
+            }
+        }
+
+      running = g_slist_remove (running, plug_in);
+      g_object_unref (plug_in);
+    }
+
+  for (; plug_in_defs; plug_in_defs = plug_in_defs->next)
+    gimp_plug_in_manager_call_query (manager, context, plug_in_defs->data);
+}
+
 void
 gimp_plug_in_manager_call_init (GimpPlugInManager *manager,
                                 GimpContext       *context,
@@ -138,6 +316,62 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
                                GimpValueArray      *args,
                                gboolean             synchronous,
                                GimpObject          *display)
+{
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
+  g_return_val_if_fail (GIMP_IS_PDB_CONTEXT (context), NULL);
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (procedure), NULL);
+  g_return_val_if_fail (args != NULL, NULL);
+  g_return_val_if_fail (display == NULL || GIMP_IS_OBJECT (display), NULL);
+
+  return gimp_plug_in_manager_call_run_internal (manager, context, progress,
+                                                 procedure, args,
+                                                 synchronous, display,
+                                                 NULL, NULL);
+}
+
+void
+gimp_plug_in_manager_call_run_async (GimpPlugInManager       *manager,
+                                     GimpContext             *context,
+                                     GimpProgress            *progress,
+                                     GimpPlugInProcedure     *procedure,
+                                     GimpValueArray          *args,
+                                     GimpObject              *display,
+                                     GimpProcedureReturnFunc  return_func,
+                                     gpointer                 return_data)
+{
+  GimpValueArray *return_vals;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
+  g_return_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress));
+  g_return_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (procedure));
+  g_return_if_fail (args != NULL);
+  g_return_if_fail (display == NULL || GIMP_IS_OBJECT (display));
+  g_return_if_fail (return_func != NULL);
+
+  return_vals = gimp_plug_in_manager_call_run_internal (manager, context,
+                                                        progress,
+                                                        procedure, args,
+                                                        FALSE, display,
+                                                        return_func,
+                                                        return_data);
+
+  /*  the plug-in couldn't be started  */
+  if (return_vals)
+    {
+      return_func (GIMP_PROCEDURE (procedure), return_vals, return_data);
+
+      gimp_value_array_unref (return_vals);
+    }
+}
+
+GimpValueArray *
+gimp_plug_in_manager_call_run_temp (GimpPlugInManager      *manager,
+                                    GimpContext            *context,
+                                    GimpProgress           *progress,
+                                    GimpTemporaryProcedure *procedure,
+                                    GimpValueArray         *args)
 {
   GimpValueArray *return_vals = NULL;
   GimpPlugIn     *plug_in;
@@ -145,11 +379,89 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
   g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
   g_return_val_if_fail (GIMP_IS_PDB_CONTEXT (context), NULL);
   g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
-  g_return_val_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (procedure), NULL);
+  g_return_val_if_fail (GIMP_IS_TEMPORARY_PROCEDURE (procedure), NULL);
   g_return_val_if_fail (args != NULL, NULL);
-  g_return_val_if_fail (display == NULL || GIMP_IS_OBJECT (display), NULL);
 
-  plug_in = gimp_plug_in_new (manager, context, progress, procedure, NULL);
+  plug_in = procedure->plug_in;
+
+  if (plug_in)
+    {
+      GimpPlugInProcFrame *proc_frame;
+      GPProcRun            proc_run;
+
+      proc_frame = gimp_plug_in_proc_frame_push (plug_in, context, progress,
+                                                 procedure);
+
+      proc_run.name    = GIMP_PROCEDURE (procedure)->original_name;
+      proc_run.nparams = gimp_value_array_length (args);
+      proc_run.params  = plug_in_args_to_params (args, FALSE);
+
+      if (! gp_temp_proc_run_write (plug_in->my_write, &proc_run, plug_in) ||
+          ! gimp_wire_flush (plug_in->my_write, plug_in))
+        {
+          const gchar *name  = gimp_object_get_name (plug_in);
+          GError      *error = g_error_new (GIMP_PLUG_IN_ERROR,
+                                            GIMP_PLUG_IN_EXECUTION_FAILED,
+                                            _("Failed to run plug-in \"%s\""),
+                                            name);
+
+          g_free (proc_run.params);
+          gimp_plug_in_proc_frame_pop (plug_in);
+
+          return_vals = gimp_procedure_get_return_values (GIMP_PROCEDURE (procedure),
+                                                          FALSE, error);
+          g_error_free (error);
+
+          return return_vals;
+        }
+
+      g_free (proc_run.params);
+
+      g_object_ref (plug_in);
+      gimp_plug_in_proc_frame_ref (proc_frame);
+
+      gimp_plug_in_main_loop (plug_in);
+
+      /*  main_loop is quit and proc_frame is popped in
+       *  gimp_plug_in_handle_temp_proc_return()
+       */
+
+      return_vals = gimp_plug_in_proc_frame_get_return_values (proc_frame);
+
+      gimp_plug_in_proc_frame_unref (proc_frame, plug_in);
+      g_object_unref (plug_in);
+    }
+
+  return return_vals;
+}
+
+
+/*  private functions  */
+
+static GimpValueArray *
+gimp_plug_in_manager_call_run_internal (GimpPlugInManager       *manager,
+                                        GimpContext             *context,
+                                        GimpProgress            *progress,
+                                        GimpPlugInProcedure     *procedure,
+                                        GimpValueArray          *args,
+                                        gboolean                 synchronous,
+                                        GimpObject              *display,
+                                        GimpProcedureReturnFunc  return_func,
+                                        gpointer                 return_data)
+{
+  GimpValueArray *return_vals = NULL;
+  GimpPlugIn     *plug_in     = NULL;
+  gboolean        resident;
+
+  resident = gimp_plug_in_manager_resident_enabled (manager, procedure);
+
+  /*  reuse an idle process of the plug-in if there is one  */
+  if (resident)
+    plug_in = gimp_plug_in_manager_take_resident (manager, context, progress,
+                                                  procedure);
+
+  if (! plug_in)
+    plug_in = gimp_plug_in_new (manager, context, progress, procedure, NULL);
 
   if (plug_in)
     {
@@ -161,7 +473,8 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
       gint               display_ID;
       gint               monitor;
 
-      if (! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_RUN, FALSE))
+      if (! plug_in->open &&
+          ! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_RUN, FALSE))
         {
           const gchar *name  = gimp_object_get_name (plug_in);
           GError      *error = g_error_new (GIMP_PLUG_IN_ERROR,
@@ -185,6 +498,8 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
       config.tile_height      = GIMP_PLUG_IN_TILE_HEIGHT;
       config.shm_ID           = (manager->shm ?
                                  gimp_plug_in_shm_get_ID (manager->shm) : -1);
+      config.shm_size         = (manager->shm ?
+                                 gimp_plug_in_shm_get_size (manager->shm) : 0);
       config.check_size       = display_config->transparency_size;
       config.check_type       = display_config->transparency_type;
       config.show_help_button = (gui_config->use_help &&
@@ -193,7 +508,7 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
 #warning FIXME what to do with config.use_cpu_accel
 #endif
       config.use_cpu_accel    = FALSE;
-      config.gimp_reserved_5  = 0;
+      config.resident         = resident;
       config.gimp_reserved_6  = 0;
       config.gimp_reserved_7  = 0;
       config.gimp_reserved_8  = 0;
@@ -237,6 +552,15 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
       g_free (config.display_name);
       g_free (proc_run.params);
 
+      /*  the return values arrive later, in gimp_plug_in_handle_proc_return()
+       *  or gimp_plug_in_close()
+       */
+      if (! synchronous && return_func)
+        {
+          plug_in->main_proc_frame.return_func = return_func;
+          plug_in->main_proc_frame.return_data = return_data;
+        }
+
       /* If this is an extension,
        * wait for an installation-confirmation message
        */
@@ -280,72 +604,3 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
 
   return return_vals;
 }
-
-GimpValueArray *
-gimp_plug_in_manager_call_run_temp (GimpPlugInManager      *manager,
-                                    GimpContext            *context,
-                                    GimpProgress           *progress,
-                                    GimpTemporaryProcedure *procedure,
-                                    GimpValueArray         *args)
-{
-  GimpValueArray *return_vals = NULL;
-  GimpPlugIn     *plug_in;
-
-  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
-  g_return_val_if_fail (GIMP_IS_PDB_CONTEXT (context), NULL);
-  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
-  g_return_val_if_fail (GIMP_IS_TEMPORARY_PROCEDURE (procedure), NULL);
-  g_return_val_if_fail (args != NULL, NULL);
-
-  plug_in = procedure->plug_in;
-
-  if (plug_in)
-    {
-      GimpPlugInProcFrame *proc_frame;
-      GPProcRun            proc_run;
-
-      proc_frame = gimp_plug_in_proc_frame_push (plug_in, context, progress,
-                                                 procedure);
-
-      proc_run.name    = GIMP_PROCEDURE (procedure)->original_name;
-      proc_run.nparams = gimp_value_array_length (args);
-      proc_run.params  = plug_in_args_to_params (args, FALSE);
-
-      if (! gp_temp_proc_run_write (plug_in->my_write, &proc_run, plug_in) ||
-          ! gimp_wire_flush (plug_in->my_write, plug_in))
-        {
-          const gchar *name  = gimp_object_get_name (plug_in);
-          GError      *error = g_error_new (GIMP_PLUG_IN_ERROR,
-                                            GIMP_PLUG_IN_EXECUTION_FAILED,
-                                            _("Failed to run plug-in \"%s\""),
-                                            name);
-
-          g_free (proc_run.params);
-          gimp_plug_in_proc_frame_pop (plug_in);
-
-          return_vals = gimp_procedure_get_return_values (GIMP_PROCEDURE (procedure),
-                                                          FALSE, error);
-          g_error_free (error);
-
-          return return_vals;
-        }
-
-      g_free (proc_run.params);
-
-      g_object_ref (plug_in);
-      gimp_plug_in_proc_frame_ref (proc_frame);
-
-      gimp_plug_in_main_loop (plug_in);
-
-      /*  main_loop is quit and proc_frame is popped in
-       *  gimp_plug_in_handle_temp_proc_return()
-       */
-
-      return_vals = gimp_plug_in_proc_frame_get_return_values (proc_frame);
-
-      gimp_plug_in_proc_frame_unref (proc_frame, plug_in);
-      g_object_unref (plug_in);
-    }
-
-  return return_vals;
-}
@@ -31,6 +31,16 @@ void             gimp_plug_in_manager_call_query    (GimpPlugInManager      *man
                                                      GimpContext            *context,
                                                      GimpPlugInDef          *plug_in_def);
 
+/*  Call the query() functions of several plug-ins, running up to
+ *  n_parallel of them at the same time
+ */
+void             gimp_plug_in_manager_call_query_parallel
+                                                    (GimpPlugInManager      *manager,
+                                                     GimpContext            *context,
+                                                     GSList                 *plug_in_defs,
+                                                     gint                    n_parallel,
+                                                     GimpInitStatusFunc      status_callback);
+
 /*  Call the plug-in's init() function
  */
 void             gimp_plug_in_manager_call_init     (GimpPlugInManager      *manager,
@@ -47,6 +57,19 @@ GimpValueArray * gimp_plug_in_manager_call_run      (GimpPlugInManager      *man
                                                      gboolean                synchronous,
                                                      GimpObject             *display);
 
+/*  Run a plug-in without waiting for it, return_func is called with
+ *  its return values when it is done, crashed or canceled
+ */
+void             gimp_plug_in_manager_call_run_async
+                                                    (GimpPlugInManager      *manager,
+                                                     GimpContext            *context,
+                                                     GimpProgress           *progress,
+                                                     GimpPlugInProcedure    *procedure,
+                                                     GimpValueArray         *args,
+                                                     GimpObject             *display,
+                                                     GimpProcedureReturnFunc return_func,
+                                                     gpointer                return_data);
+
 /*  Run a temp plug-in proc as if it were a procedure database procedure
  */
 GimpValueArray * gimp_plug_in_manager_call_run_temp (GimpPlugInManager      *manager,
@@ -0,0 +1,249 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppluginmanager-resident.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "plug-in-types.h"
+
+#include "config/gimpcoreconfig.h"
+
+#include "core/gimp.h"
+#include "core/gimpprogress.h"
+
+#include "pdb/gimppdbcontext.h"
+
+#include "gimpplugin.h"
+#include "gimpplugin-cleanup.h"
+#include "gimpplugin-progress.h"
+#include "gimppluginmanager.h"
+#include "gimppluginmanager-resident.h"
+#include "gimppluginprocedure.h"
+
+
+/*  Resident plug-ins are plug-in processes which told us with
+ *  GP_RESIDENT that they can serve another GP_PROC_RUN. They stay
+ *  open (and in manager->open_plug_ins) between calls, and are
+ *  kept in manager->resident_plug_ins while idle.
+ */
+
+
+static gboolean  gimp_plug_in_manager_resident_timeout (gpointer    data);
+static guint64   gimp_plug_in_get_memory_usage         (GimpPlugIn *plug_in);
+
+
+/*  public functions  */
+
+gboolean
+gimp_plug_in_manager_resident_enabled (GimpPlugInManager   *manager,
+                                       GimpPlugInProcedure *procedure)
+{
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), FALSE);
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (procedure), FALSE);
+
+  /*  extensions and debugged plug-ins are never reused  */
+  return (manager->gimp->config->plug_in_resident_timeout > 0 &&
+          GIMP_PROCEDURE (procedure)->proc_type == GIMP_PLUG_IN &&
+          manager->debug == NULL);
+}
+
+GimpPlugIn *
+gimp_plug_in_manager_take_resident (GimpPlugInManager   *manager,
+                                    GimpContext         *context,
+                                    GimpProgress        *progress,
+                                    GimpPlugInProcedure *procedure)
+{
+  const gchar *prog;
+  GSList      *list;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
+  g_return_val_if_fail (GIMP_IS_PDB_CONTEXT (context), NULL);
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (procedure), NULL);
+
+  prog = gimp_plug_in_procedure_get_progname (procedure);
+
+  for (list = manager->resident_plug_ins; list; list = g_slist_next (list))
+    {
+      GimpPlugIn *plug_in = list->data;
+
+      if (! strcmp (plug_in->prog, prog))
+        {
+          manager->resident_plug_ins =
+            g_slist_remove (manager->resident_plug_ins, plug_in);
+
+          if (plug_in->resident_timeout_id)
+            {
+              g_source_remove (plug_in->resident_timeout_id);
+              plug_in->resident_timeout_id = 0;
+            }
+
+          plug_in->resident  = FALSE;
+          plug_in->precision = FALSE;
+
+          gimp_plug_in_proc_frame_dispose (&plug_in->main_proc_frame,
+                                           plug_in);
+          gimp_plug_in_proc_frame_init (&plug_in->main_proc_frame,
+                                        context, progress, procedure);
+
+          /*  the reference of the list now belongs to the caller  */
+          return plug_in;
+        }
+    }
+
+  return NULL;
+}
+
+void
+gimp_plug_in_manager_add_resident (GimpPlugInManager *manager,
+                                   GimpPlugIn        *plug_in)
+{
+  GimpCoreConfig      *config;
+  GimpPlugInProcFrame *proc_frame;
+  guint64              memory;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+  g_return_if_fail (plug_in->open);
+
+  config     = manager->gimp->config;
+  proc_frame = &plug_in->main_proc_frame;
+
+  /*  finish the call like gimp_plug_in_close() would  */
+  if (proc_frame->progress)
+    {
+      gimp_plug_in_progress_end (plug_in, proc_frame);
+
+      if (proc_frame->progress)
+        {
+          g_object_unref (proc_frame->progress);
+          proc_frame->progress = NULL;
+        }
+    }
+
+  if (proc_frame->image_cleanups || proc_frame->item_cleanups)
+    gimp_plug_in_cleanup (plug_in, proc_frame);
+
+  memory = gimp_plug_in_get_memory_usage (plug_in);
+
+  if (plug_in->temp_procedures                ||
+      config->plug_in_resident_timeout == 0   ||
+      memory > config->plug_in_resident_memory)
+    {
+      if (manager->gimp->be_verbose && memory > config->plug_in_resident_memory)
+        g_print ("Not keeping plug-in '%s' resident, it uses %"
+                 G_GUINT64_FORMAT " bytes\n",
+                 gimp_filename_to_utf8 (plug_in->prog), memory);
+
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  manager->resident_plug_ins = g_slist_prepend (manager->resident_plug_ins,
+                                                g_object_ref (plug_in));
+
+  plug_in->resident_timeout_id =
+    g_timeout_add_seconds (config->plug_in_resident_timeout,
+                           gimp_plug_in_manager_resident_timeout,
+                           plug_in);
+}
+
+void
+gimp_plug_in_manager_remove_resident (GimpPlugInManager *manager,
+                                      GimpPlugIn        *plug_in)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+
+  if (! g_slist_find (manager->resident_plug_ins, plug_in))
+    return;
+
+  manager->resident_plug_ins = g_slist_remove (manager->resident_plug_ins,
+                                               plug_in);
+
+  if (plug_in->resident_timeout_id)
+    {
+      g_source_remove (plug_in->resident_timeout_id);
+      plug_in->resident_timeout_id = 0;
+    }
+
+  g_object_unref (plug_in);
+}
+
+
+/*  private functions  */
+
+static gboolean
+gimp_plug_in_manager_resident_timeout (gpointer data)
+{
+  GimpPlugIn *plug_in = data;
+
+  plug_in->resident_timeout_id = 0;
+
+  g_object_ref (plug_in);
+
+  if (plug_in->open)
+    gimp_plug_in_close (plug_in, TRUE);
+
+  g_object_unref (plug_in);
+
+  return FALSE;
+}
+
+/*  Returns the resident set size of the plug-in process in bytes,
+ *  or 0 if it can't be determined.
+ */
+static guint64
+gimp_plug_in_get_memory_usage (GimpPlugIn *plug_in)
+{
+  guint64 memory = 0;
+
+#if defined(G_OS_UNIX) && defined(_SC_PAGESIZE)
+  gchar *filename;
+  FILE  *file;
+
+  filename = g_strdup_printf ("/proc/%d/statm", (gint) plug_in->pid);
+  file     = fopen (filename, "r");
+
+  if (file)
+    {
+      gulong size;
+      gulong resident;
+
+      if (fscanf (file, "%lu %lu", &size, &resident) == 2)
+        memory = (guint64) resident * sysconf (_SC_PAGESIZE);
+
+      fclose (file);
+    }
+
+  g_free (filename);
+#endif
+
+  return memory;
+}
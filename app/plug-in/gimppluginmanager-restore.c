@@ -42,6 +42,7 @@
 #include "gimppluginmanager-call.h"
 #include "gimppluginmanager-help-domain.h"
 #include "gimppluginmanager-locale-domain.h"
+#include "gimppluginmanager-menu-branch.h"
 #include "gimppluginmanager-restore.h"
 #include "gimppluginprocedure.h"
 #include "plug-in-rc.h"
@@ -67,6 +68,15 @@ static void    gimp_plug_in_manager_run_extensions    (GimpPlugInManager      *m
 static void    gimp_plug_in_manager_bind_text_domains (GimpPlugInManager      *manager);
 static void    gimp_plug_in_manager_add_from_file     (const GimpDatafileData *file_data,
                                                        gpointer                data);
+static gboolean gimp_plug_in_manager_rc_def_is_current (GimpPlugInManager      *manager,
+                                                       GimpPlugInDef          *rc_def,
+                                                       GimpPlugInDef          *ondisk_def);
+static gint    gimp_plug_in_manager_def_index         (GimpPlugInManager      *manager,
+                                                       const gchar            *prog);
+static gint    gimp_plug_in_manager_menu_branch_compare
+                                                      (gconstpointer           a,
+                                                       gconstpointer           b,
+                                                       gpointer                data);
 static void    gimp_plug_in_manager_add_from_rc       (GimpPlugInManager      *manager,
                                                        GimpPlugInDef          *plug_in_def);
 static void     gimp_plug_in_manager_add_to_db         (GimpPlugInManager      *manager,
@@ -126,6 +136,18 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
   /* write the pluginrc file if necessary */
   if (manager->write_pluginrc)
     {
+      /*  remember what the executables looked like, so that a changed
+       *  mtime alone doesn't make us query them again
+       */
+      for (list = manager->plug_in_defs; list; list = list->next)
+        {
+          GimpPlugInDef *plug_in_def = list->data;
+
+          if (! plug_in_def->checksum)
+            plug_in_def->checksum =
+              gimp_plug_in_def_compute_checksum (plug_in_def);
+        }
+
       if (gimp->be_verbose)
         g_print ("Writing '%s'\n", gimp_filename_to_utf8 (pluginrc));
 
@@ -329,30 +351,47 @@ gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
 
   if (n_plugins)
     {
-      gint nth;
+      GimpGeglConfig *config = GIMP_GEGL_CONFIG (manager->gimp->config);
+      GSList         *query  = NULL;
+      GSList         *branches;
 
       manager->write_pluginrc = TRUE;
 
-      for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
+      for (list = manager->plug_in_defs; list; list = list->next)
         {
           GimpPlugInDef *plug_in_def = list->data;
 
           if (plug_in_def->needs_query)
             {
-              gchar *basename;
-
-              basename = g_filename_display_basename (plug_in_def->prog);
-              status_callback (NULL, basename,
-                               (gdouble) nth++ / (gdouble) n_plugins);
-              g_free (basename);
-
               if (manager->gimp->be_verbose)
                 g_print ("Querying plug-in: '%s'\n",
                          gimp_filename_to_utf8 (plug_in_def->prog));
 
-              gimp_plug_in_manager_call_query (manager, context, plug_in_def);
+              query = g_slist_prepend (query, plug_in_def);
             }
         }
+
+      query = g_slist_reverse (query);
+
+      branches = g_slist_last (manager->menu_branches);
+
+      gimp_plug_in_manager_call_query_parallel (manager, context, query,
+                                                config->num_processors,
+                                                status_callback);
+
+      /*  plug-ins finish their queries in random order, keep the menu
+       *  branches they registered in plug-in order
+       */
+      if (branches)
+        branches->next = g_slist_sort_with_data (branches->next,
+                                                 gimp_plug_in_manager_menu_branch_compare,
+                                                 manager);
+      else
+        manager->menu_branches = g_slist_sort_with_data (manager->menu_branches,
+                                                         gimp_plug_in_manager_menu_branch_compare,
+                                                         manager);
+
+      g_slist_free (query);
     }
 
   status_callback (NULL, "", 1.0);
@@ -582,6 +621,72 @@ gimp_plug_in_manager_add_from_file (const GimpDatafileData *file_data,
   manager->plug_in_defs = g_slist_prepend (manager->plug_in_defs, plug_in_def);
 }
 
+static gint
+gimp_plug_in_manager_def_index (GimpPlugInManager *manager,
+                                const gchar       *prog)
+{
+  GSList *list;
+  gint    index;
+
+  for (list = manager->plug_in_defs, index = 0;
+       list;
+       list = list->next, index++)
+    {
+      GimpPlugInDef *plug_in_def = list->data;
+
+      if (! strcmp (plug_in_def->prog, prog))
+        return index;
+    }
+
+  return index;
+}
+
+static gint
+gimp_plug_in_manager_menu_branch_compare (gconstpointer a,
+                                          gconstpointer b,
+                                          gpointer      data)
+{
+  const GimpPlugInMenuBranch *branch_a = a;
+  const GimpPlugInMenuBranch *branch_b = b;
+
+  return (gimp_plug_in_manager_def_index (data, branch_a->prog_name) -
+          gimp_plug_in_manager_def_index (data, branch_b->prog_name));
+}
+
+/*  A pluginrc entry is still valid if the executable's mtime didn't
+ *  change, or if it did but its contents are the same.
+ */
+static gboolean
+gimp_plug_in_manager_rc_def_is_current (GimpPlugInManager *manager,
+                                        GimpPlugInDef     *rc_def,
+                                        GimpPlugInDef     *ondisk_def)
+{
+  gchar    *checksum;
+  gboolean  current;
+
+  if (rc_def->mtime == ondisk_def->mtime)
+    return TRUE;
+
+  if (! rc_def->checksum)
+    return FALSE;
+
+  checksum = gimp_plug_in_def_compute_checksum (ondisk_def);
+  current  = checksum && ! strcmp (checksum, rc_def->checksum);
+  g_free (checksum);
+
+  if (current)
+    {
+      if (manager->gimp->be_verbose)
+        g_print ("Plug-in '%s' was touched but is unchanged\n",
+                 gimp_filename_to_utf8 (ondisk_def->prog));
+
+      gimp_plug_in_def_set_mtime (rc_def, ondisk_def->mtime);
+      manager->write_pluginrc = TRUE;
+    }
+
+  return current;
+}
+
 static void
 gimp_plug_in_manager_add_from_rc (GimpPlugInManager *manager,
                                   GimpPlugInDef     *plug_in_def)
@@ -637,7 +742,8 @@ gimp_plug_in_manager_add_from_rc (GimpPlugInManager *manager,
         {
           if (! g_ascii_strcasecmp (plug_in_def->prog,
                                     ondisk_plug_in_def->prog) &&
-              (plug_in_def->mtime == ondisk_plug_in_def->mtime))
+              gimp_plug_in_manager_rc_def_is_current (manager, plug_in_def,
+                                                      ondisk_plug_in_def))
             {
               /* Use pluginrc entry, deleting on-disk entry */
               list->data = plug_in_def;
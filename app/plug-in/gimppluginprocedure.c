@@ -36,6 +36,8 @@
 #include "core/gimpmarshal.h"
 #include "core/gimpparamspecs.h"
 
+#include "pdb/gimppdbcontext.h"
+
 #define __YES_I_NEED_GIMP_PLUG_IN_MANAGER_CALL__
 #include "gimppluginmanager-call.h"
 
@@ -1004,3 +1006,54 @@ gimp_plug_in_procedure_handle_return_values (GimpPlugInProcedure *proc,
       break;
     }
 }
+
+/*  Runs the procedure without waiting for it, and calls return_func
+ *  with its return values once it is done. Core procedures are simply
+ *  run right away. Unlike gimp_procedure_execute_async(), the args are
+ *  not validated, the caller has to make sure they are right.
+ */
+void
+gimp_plug_in_procedure_execute_with_callback (GimpPlugInProcedure     *proc,
+                                              Gimp                    *gimp,
+                                              GimpContext             *context,
+                                              GimpProgress            *progress,
+                                              GimpValueArray          *args,
+                                              GimpProcedureReturnFunc  return_func,
+                                              gpointer                 return_data)
+{
+  GimpProcedure *procedure;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (proc));
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+  g_return_if_fail (GIMP_IS_CONTEXT (context));
+  g_return_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress));
+  g_return_if_fail (args != NULL);
+  g_return_if_fail (return_func != NULL);
+
+  procedure = GIMP_PROCEDURE (proc);
+
+  if (procedure->proc_type == GIMP_INTERNAL)
+    {
+      GimpValueArray *return_vals;
+
+      return_vals = gimp_procedure_execute (procedure, gimp, context,
+                                            progress, args, NULL);
+
+      return_func (procedure, return_vals, return_data);
+
+      gimp_value_array_unref (return_vals);
+    }
+  else
+    {
+      if (GIMP_IS_PDB_CONTEXT (context))
+        context = g_object_ref (context);
+      else
+        context = gimp_pdb_context_new (gimp, context, TRUE);
+
+      gimp_plug_in_manager_call_run_async (gimp->plug_in_manager,
+                                           context, progress, proc, args,
+                                           NULL, return_func, return_data);
+
+      g_object_unref (context);
+    }
+}
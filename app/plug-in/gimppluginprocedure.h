@@ -135,5 +135,14 @@ void     gimp_plug_in_procedure_handle_return_values (GimpPlugInProcedure
 
                                                       GimpValueArray            *return_vals);
 
+void     gimp_plug_in_procedure_execute_with_callback
+                                                     (GimpPlugInProcedure       *proc,
+                                                      Gimp                      *gimp,
+                                                      GimpContext               *context,
+                                                      GimpProgress              *progress,
+                                                      GimpValueArray            *args,
+                                                      GimpProcedureReturnFunc    return_func,
+                                                      gpointer                   return_data);
+
 
 #endif /* __GIMP_PLUG_IN_PROCEDURE_H__ */
@@ -37,6 +37,8 @@
 #include "gimpplugin-progress.h"
 #include "gimppluginprocedure.h"
 
+#include "gimp-log.h"
+
 #include "gimp-intl.h"
 
 
@@ -79,10 +81,13 @@ gimp_plug_in_proc_frame_init (GimpPlugInProcFrame *proc_frame,
   proc_frame->procedure          = procedure ? g_object_ref (procedure) : NULL;
   proc_frame->main_loop          = NULL;
   proc_frame->return_vals        = NULL;
+  proc_frame->return_func        = NULL;
+  proc_frame->return_data        = NULL;
   proc_frame->progress           = progress ? g_object_ref (progress) : NULL;
   proc_frame->progress_created   = FALSE;
   proc_frame->progress_cancel_id = 0;
   proc_frame->error_handler      = GIMP_PDB_ERROR_HANDLER_INTERNAL;
+  proc_frame->trace_start        = procedure ? GIMP_TRACE_START () : 0;
 
   if (progress)
     gimp_plug_in_progress_attach (progress);
@@ -134,6 +139,11 @@ gimp_plug_in_proc_frame_dispose (GimpPlugInProcFrame *proc_frame,
   if (proc_frame->image_cleanups || proc_frame->item_cleanups)
     gimp_plug_in_cleanup (plug_in, proc_frame);
 
+  GIMP_TRACE_END (proc_frame->trace_start, "plug-in",
+                  gimp_object_get_name (proc_frame->procedure),
+                  gimp_object_get_name (plug_in));
+  proc_frame->trace_start = 0;
+
   if (proc_frame->procedure)
     {
       g_object_unref (proc_frame->procedure);
@@ -33,6 +33,10 @@ struct _GimpPlugInProcFrame
 
   GimpValueArray      *return_vals;
 
+  /*  called with the return values of an asynchronous run  */
+  GimpProcedureReturnFunc  return_func;
+  gpointer                 return_data;
+
   GimpProgress        *progress;
   gboolean             progress_created;
   gulong               progress_cancel_id;
@@ -42,6 +46,9 @@ struct _GimpPlugInProcFrame
   /*  lists of things to clean up on dispose  */
   GList               *image_cleanups;
   GList               *item_cleanups;
+
+  /*  when the call began, for GIMP_TRACE  */
+  gint64               trace_start;
 };
 
 
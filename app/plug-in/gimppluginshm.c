@@ -72,6 +72,11 @@
 
 #define TILE_MAP_SIZE (GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT * 16)
 
+/*  the segment holds this many tiles of the largest pixel size, so
+ *  plug-ins can transfer a batch of tiles per message
+ */
+#define TILE_MAP_N_TILES 32
+
 #define ERRMSG_SHM_DISABLE "Disabling shared memory tile transport"
 
 
@@ -79,6 +84,7 @@ struct _GimpPlugInShm
 {
   gint    shm_ID;
   guchar *shm_addr;
+  gsize   shm_size;
 
 #if defined(USE_WIN32_SHM)
   HANDLE  shm_handle;
@@ -96,13 +102,26 @@ gimp_plug_in_shm_new (void)
 
   GimpPlugInShm *shm = g_slice_new0 (GimpPlugInShm);
 
-  shm->shm_ID = -1;
+  shm->shm_ID   = -1;
+  shm->shm_size = TILE_MAP_SIZE * TILE_MAP_N_TILES;
 
 #if defined(USE_SYSV_SHM)
 
   /* Use SysV shared memory mechanisms for transferring tile data. */
   {
-    shm->shm_ID = shmget (IPC_PRIVATE, TILE_MAP_SIZE, IPC_CREAT | 0600);
+    /*  the system's segment size limit may be lower than what we
+     *  want, fall back to fewer tiles down to a single one
+     */
+    while (TRUE)
+      {
+        shm->shm_ID = shmget (IPC_PRIVATE, shm->shm_size, IPC_CREAT | 0600);
+
+        if (shm->shm_ID != -1 || errno != EINVAL ||
+            shm->shm_size <= TILE_MAP_SIZE)
+          break;
+
+        shm->shm_size /= 2;
+      }
 
     if (shm->shm_ID != -1)
       {
@@ -144,7 +163,7 @@ gimp_plug_in_shm_new (void)
     /* Create the file mapping into paging space */
     shm->shm_handle = CreateFileMapping (INVALID_HANDLE_VALUE, NULL,
                                          PAGE_READWRITE, 0,
-                                         TILE_MAP_SIZE,
+                                         shm->shm_size,
                                          fileMapName);
 
     if (shm->shm_handle)
@@ -152,7 +171,7 @@ gimp_plug_in_shm_new (void)
         /* Map the shared memory into our address space for use */
         shm->shm_addr = (guchar *) MapViewOfFile (shm->shm_handle,
                                                   FILE_MAP_ALL_ACCESS,
-                                                  0, 0, TILE_MAP_SIZE);
+                                                  0, 0, shm->shm_size);
 
         /* Verify that we mapped our view */
         if (shm->shm_addr)
@@ -191,10 +210,10 @@ gimp_plug_in_shm_new (void)
 
     if (shm_fd != -1)
       {
-        if (ftruncate (shm_fd, TILE_MAP_SIZE) != -1)
+        if (ftruncate (shm_fd, shm->shm_size) != -1)
           {
             /* Map the shared memory into our address space for use */
-            shm->shm_addr = (guchar *) mmap (NULL, TILE_MAP_SIZE,
+            shm->shm_addr = (guchar *) mmap (NULL, shm->shm_size,
                                              PROT_READ | PROT_WRITE, MAP_SHARED,
                                              shm_fd, 0);
 
@@ -237,7 +256,8 @@ gimp_plug_in_shm_new (void)
     }
   else
     {
-      GIMP_LOG (SHM, "attached shared memory segment ID = %d", shm->shm_ID);
+      GIMP_LOG (SHM, "attached shared memory segment ID = %d, size = %"
+                G_GSIZE_FORMAT, shm->shm_ID, shm->shm_size);
     }
 
   return shm;
@@ -268,7 +288,7 @@ gimp_plug_in_shm_free (GimpPlugInShm *shm)
 
       gchar shm_handle[32];
 
-      munmap (shm->shm_addr, TILE_MAP_SIZE);
+      munmap (shm->shm_addr, shm->shm_size);
 
       g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d",
                   shm->shm_ID);
@@ -298,3 +318,11 @@ gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
 
   return shm->shm_addr;
 }
+
+gsize
+gimp_plug_in_shm_get_size (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, 0);
+
+  return shm->shm_size;
+}
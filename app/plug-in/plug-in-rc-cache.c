@@ -0,0 +1,625 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * plug-in-rc-cache.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  The pluginrc cache is a binary copy of what parsing the text
+ *  pluginrc gave, written next to it.  It is only used while the
+ *  pluginrc's modification time and size are the ones recorded in
+ *  the cache, so the text file stays the source of truth.  The cache
+ *  is read from a memory mapping, without any tokenising.
+ *
+ *  All numbers are stored in the machine's byte order, strings and
+ *  data as their length followed by the bytes, with a length of -1
+ *  for NULL strings.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
+#include "plug-in-types.h"
+
+#include "core/gimp.h"
+
+#include "pdb/gimp-pdb-compat.h"
+
+#include "gimpplugindef.h"
+#include "gimppluginprocedure.h"
+#include "plug-in-rc-cache.h"
+
+
+#define PLUG_IN_RC_CACHE_MAGIC       "GIMP pluginrc cache"
+#define PLUG_IN_RC_CACHE_VERSION     1
+#define PLUG_IN_RC_CACHE_BYTE_ORDER  0x01020304
+
+
+typedef struct
+{
+  const guchar *data;
+  gsize         size;
+  gsize         pos;
+  gboolean      valid;
+} PlugInRcCache;
+
+
+static gchar               * plug_in_rc_cache_get_filename  (const gchar   *rc_filename);
+
+static gint32                plug_in_rc_cache_get_int       (PlugInRcCache *cache);
+static gint64                plug_in_rc_cache_get_int64     (PlugInRcCache *cache);
+static gchar               * plug_in_rc_cache_get_string    (PlugInRcCache *cache);
+static guint8              * plug_in_rc_cache_get_data      (PlugInRcCache *cache,
+                                                             gint           length);
+static GimpPlugInDef       * plug_in_rc_cache_get_def       (PlugInRcCache *cache,
+                                                             Gimp          *gimp);
+static GimpPlugInProcedure * plug_in_rc_cache_get_procedure (PlugInRcCache *cache,
+                                                             Gimp          *gimp,
+                                                             const gchar   *prog);
+
+static void                  plug_in_rc_cache_put_int       (GString       *buffer,
+                                                             gint32         value);
+static void                  plug_in_rc_cache_put_int64     (GString       *buffer,
+                                                             gint64         value);
+static void                  plug_in_rc_cache_put_string    (GString       *buffer,
+                                                             const gchar   *str);
+static void                  plug_in_rc_cache_put_def       (GString       *buffer,
+                                                             GimpPlugInDef *plug_in_def);
+static void                  plug_in_rc_cache_put_procedure (GString       *buffer,
+                                                             GimpPlugInProcedure *proc);
+
+
+/*  public functions  */
+
+/*  Returns the plug-in defs stored in the cache of @rc_filename, or
+ *  NULL if there is no cache, or if it doesn't match @rc_filename.
+ */
+GSList *
+plug_in_rc_cache_read (Gimp        *gimp,
+                       const gchar *rc_filename)
+{
+  GMappedFile   *file;
+  PlugInRcCache  cache;
+  GStatBuf       info;
+  GSList        *plug_in_defs = NULL;
+  gchar         *filename;
+  gchar         *magic;
+  gint           n_defs;
+  gint           i;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
+  g_return_val_if_fail (rc_filename != NULL, NULL);
+
+  if (g_stat (rc_filename, &info) != 0)
+    return NULL;
+
+  filename = plug_in_rc_cache_get_filename (rc_filename);
+  file     = g_mapped_file_new (filename, FALSE, NULL);
+  g_free (filename);
+
+  if (! file)
+    return NULL;
+
+  cache.data  = (const guchar *) g_mapped_file_get_contents (file);
+  cache.size  = g_mapped_file_get_length (file);
+  cache.pos   = 0;
+  cache.valid = TRUE;
+
+  magic = plug_in_rc_cache_get_string (&cache);
+
+  if (g_strcmp0 (magic, PLUG_IN_RC_CACHE_MAGIC)                          ||
+      plug_in_rc_cache_get_int (&cache)   != PLUG_IN_RC_CACHE_BYTE_ORDER ||
+      plug_in_rc_cache_get_int (&cache)   != PLUG_IN_RC_CACHE_VERSION    ||
+      plug_in_rc_cache_get_int (&cache)   != GIMP_PROTOCOL_VERSION       ||
+      plug_in_rc_cache_get_int64 (&cache) != (gint64) info.st_mtime      ||
+      plug_in_rc_cache_get_int64 (&cache) != (gint64) info.st_size)
+    {
+      cache.valid = FALSE;
+    }
+
+  g_free (magic);
+
+  n_defs = plug_in_rc_cache_get_int (&cache);
+
+  for (i = 0; i < n_defs && cache.valid; i++)
+    {
+      GimpPlugInDef *plug_in_def = plug_in_rc_cache_get_def (&cache, gimp);
+
+      if (plug_in_def)
+        plug_in_defs = g_slist_prepend (plug_in_defs, plug_in_def);
+    }
+
+  if (! cache.valid || cache.pos != cache.size)
+    {
+      g_slist_free_full (plug_in_defs, (GDestroyNotify) g_object_unref);
+      plug_in_defs = NULL;
+    }
+
+  g_mapped_file_unref (file);
+
+  return g_slist_reverse (plug_in_defs);
+}
+
+/*  Writes @plug_in_defs, which must be what parsing @rc_filename gave,
+ *  to the cache of @rc_filename.
+ */
+gboolean
+plug_in_rc_cache_write (GSList       *plug_in_defs,
+                        const gchar  *rc_filename,
+                        GError      **error)
+{
+  GString  *buffer;
+  GStatBuf  info;
+  GSList   *list;
+  gchar    *filename;
+  gboolean  success;
+
+  g_return_val_if_fail (rc_filename != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (g_stat (rc_filename, &info) != 0)
+    return TRUE;
+
+  buffer = g_string_new (NULL);
+
+  plug_in_rc_cache_put_string (buffer, PLUG_IN_RC_CACHE_MAGIC);
+  plug_in_rc_cache_put_int    (buffer, PLUG_IN_RC_CACHE_BYTE_ORDER);
+  plug_in_rc_cache_put_int    (buffer, PLUG_IN_RC_CACHE_VERSION);
+  plug_in_rc_cache_put_int    (buffer, GIMP_PROTOCOL_VERSION);
+  plug_in_rc_cache_put_int64  (buffer, info.st_mtime);
+  plug_in_rc_cache_put_int64  (buffer, info.st_size);
+
+  plug_in_rc_cache_put_int (buffer, g_slist_length (plug_in_defs));
+
+  for (list = plug_in_defs; list; list = g_slist_next (list))
+    plug_in_rc_cache_put_def (buffer, list->data);
+
+  filename = plug_in_rc_cache_get_filename (rc_filename);
+
+  success = g_file_set_contents (filename, buffer->str, buffer->len, error);
+
+  g_free (filename);
+  g_string_free (buffer, TRUE);
+
+  return success;
+}
+
+/*  Removes the cache of @rc_filename, call this when @rc_filename is
+ *  rewritten.
+ */
+void
+plug_in_rc_cache_remove (const gchar *rc_filename)
+{
+  gchar *filename;
+
+  g_return_if_fail (rc_filename != NULL);
+
+  filename = plug_in_rc_cache_get_filename (rc_filename);
+  g_unlink (filename);
+  g_free (filename);
+}
+
+
+/*  private functions  */
+
+static gchar *
+plug_in_rc_cache_get_filename (const gchar *rc_filename)
+{
+  return g_strconcat (rc_filename, ".cache", NULL);
+}
+
+static gint32
+plug_in_rc_cache_get_int (PlugInRcCache *cache)
+{
+  gint32 value = 0;
+
+  if (cache->valid && cache->size - cache->pos >= sizeof (value))
+    {
+      memcpy (&value, cache->data + cache->pos, sizeof (value));
+      cache->pos += sizeof (value);
+    }
+  else
+    {
+      cache->valid = FALSE;
+    }
+
+  return value;
+}
+
+static gint64
+plug_in_rc_cache_get_int64 (PlugInRcCache *cache)
+{
+  gint64 value = 0;
+
+  if (cache->valid && cache->size - cache->pos >= sizeof (value))
+    {
+      memcpy (&value, cache->data + cache->pos, sizeof (value));
+      cache->pos += sizeof (value);
+    }
+  else
+    {
+      cache->valid = FALSE;
+    }
+
+  return value;
+}
+
+static gchar *
+plug_in_rc_cache_get_string (PlugInRcCache *cache)
+{
+  gint   length = plug_in_rc_cache_get_int (cache);
+  gchar *str;
+
+  if (! cache->valid || length < 0)
+    return NULL;
+
+  if (cache->size - cache->pos < (gsize) length)
+    {
+      cache->valid = FALSE;
+      return NULL;
+    }
+
+  str = g_strndup ((const gchar *) cache->data + cache->pos, length);
+  cache->pos += length;
+
+  return str;
+}
+
+static guint8 *
+plug_in_rc_cache_get_data (PlugInRcCache *cache,
+                           gint           length)
+{
+  guint8 *data;
+
+  if (! cache->valid || length < 0 ||
+      cache->size - cache->pos < (gsize) length)
+    {
+      cache->valid = FALSE;
+      return NULL;
+    }
+
+  data = g_memdup (cache->data + cache->pos, length);
+  cache->pos += length;
+
+  return data;
+}
+
+/*  Sets up the plug-in def in the same order as plug_in_rc_parse()
+ *  does, so that the procedures end up the same.
+ */
+static GimpPlugInDef *
+plug_in_rc_cache_get_def (PlugInRcCache *cache,
+                          Gimp          *gimp)
+{
+  GimpPlugInDef *plug_in_def;
+  gchar         *prog;
+  gchar         *name;
+  gchar         *path;
+  gint           n_procedures;
+  gint           i;
+
+  prog = plug_in_rc_cache_get_string (cache);
+
+  if (! prog)
+    {
+      cache->valid = FALSE;
+      return NULL;
+    }
+
+  plug_in_def = gimp_plug_in_def_new (prog);
+  g_free (prog);
+
+  plug_in_def->mtime = plug_in_rc_cache_get_int64 (cache);
+
+  name = plug_in_rc_cache_get_string (cache);
+  gimp_plug_in_def_set_checksum (plug_in_def, name);
+  g_free (name);
+
+  n_procedures = plug_in_rc_cache_get_int (cache);
+
+  for (i = 0; i < n_procedures && cache->valid; i++)
+    {
+      GimpPlugInProcedure *proc;
+
+      proc = plug_in_rc_cache_get_procedure (cache, gimp, plug_in_def->prog);
+
+      if (cache->valid)
+        gimp_plug_in_def_add_procedure (plug_in_def, proc);
+
+      g_object_unref (proc);
+    }
+
+  name = plug_in_rc_cache_get_string (cache);
+  path = plug_in_rc_cache_get_string (cache);
+
+  if (name)
+    gimp_plug_in_def_set_locale_domain (plug_in_def, name, path);
+
+  g_free (name);
+  g_free (path);
+
+  name = plug_in_rc_cache_get_string (cache);
+  path = plug_in_rc_cache_get_string (cache);
+
+  if (name)
+    gimp_plug_in_def_set_help_domain (plug_in_def, name, path);
+
+  g_free (name);
+  g_free (path);
+
+  gimp_plug_in_def_set_has_init (plug_in_def,
+                                 plug_in_rc_cache_get_int (cache));
+
+  if (! cache->valid)
+    {
+      g_object_unref (plug_in_def);
+      return NULL;
+    }
+
+  return plug_in_def;
+}
+
+static GimpPlugInProcedure *
+plug_in_rc_cache_get_procedure (PlugInRcCache *cache,
+                                Gimp          *gimp,
+                                const gchar   *prog)
+{
+  GimpProcedure       *procedure;
+  GimpPlugInProcedure *proc;
+  gchar               *str;
+  gint                 proc_type;
+  gint                 n_menu_paths;
+  gint                 n_args;
+  gint                 n_return_vals;
+  gint                 i;
+
+  str       = plug_in_rc_cache_get_string (cache);
+  proc_type = plug_in_rc_cache_get_int (cache);
+
+  procedure = gimp_plug_in_procedure_new (proc_type, prog);
+  proc      = GIMP_PLUG_IN_PROCEDURE (procedure);
+
+  if (! str)
+    {
+      cache->valid = FALSE;
+      return proc;
+    }
+
+  gimp_object_take_name (GIMP_OBJECT (procedure),
+                         gimp_canonicalize_identifier (str));
+
+  procedure->original_name = str;
+
+  procedure->blurb     = plug_in_rc_cache_get_string (cache);
+  procedure->help      = plug_in_rc_cache_get_string (cache);
+  procedure->author    = plug_in_rc_cache_get_string (cache);
+  procedure->copyright = plug_in_rc_cache_get_string (cache);
+  procedure->date      = plug_in_rc_cache_get_string (cache);
+  proc->menu_label     = plug_in_rc_cache_get_string (cache);
+
+  n_menu_paths = plug_in_rc_cache_get_int (cache);
+
+  for (i = 0; i < n_menu_paths && cache->valid; i++)
+    proc->menu_paths = g_list_append (proc->menu_paths,
+                                      plug_in_rc_cache_get_string (cache));
+
+  proc->icon_type        = plug_in_rc_cache_get_int (cache);
+  proc->icon_data_length = plug_in_rc_cache_get_int (cache);
+
+  switch (proc->icon_type)
+    {
+    case GIMP_ICON_TYPE_STOCK_ID:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      proc->icon_data_length = -1;
+      proc->icon_data = (guint8 *) plug_in_rc_cache_get_string (cache);
+      break;
+
+    case GIMP_ICON_TYPE_INLINE_PIXBUF:
+      proc->icon_data = plug_in_rc_cache_get_data (cache,
+                                                   proc->icon_data_length);
+      break;
+
+    default:
+      cache->valid = FALSE;
+      return proc;
+    }
+
+  proc->file_proc = plug_in_rc_cache_get_int (cache);
+
+  if (proc->file_proc)
+    {
+      proc->extensions = plug_in_rc_cache_get_string (cache);
+      proc->prefixes   = plug_in_rc_cache_get_string (cache);
+      proc->magics     = plug_in_rc_cache_get_string (cache);
+
+      str = plug_in_rc_cache_get_string (cache);
+      if (str)
+        gimp_plug_in_procedure_set_mime_type (proc, str);
+      g_free (str);
+
+      str = plug_in_rc_cache_get_string (cache);
+      if (str)
+        gimp_plug_in_procedure_set_thumb_loader (proc, str);
+      g_free (str);
+    }
+
+  str = plug_in_rc_cache_get_string (cache);
+  gimp_plug_in_procedure_set_image_types (proc, str);
+  g_free (str);
+
+  n_args        = plug_in_rc_cache_get_int (cache);
+  n_return_vals = plug_in_rc_cache_get_int (cache);
+
+  for (i = 0; i < n_args + n_return_vals && cache->valid; i++)
+    {
+      GParamSpec *pspec;
+      gint        arg_type;
+      gchar      *name;
+      gchar      *desc;
+
+      arg_type = plug_in_rc_cache_get_int (cache);
+      name     = plug_in_rc_cache_get_string (cache);
+      desc     = plug_in_rc_cache_get_string (cache);
+
+      if (cache->valid && name)
+        {
+          pspec = gimp_pdb_compat_param_spec (gimp, arg_type, name, desc);
+
+          if (i < n_args)
+            gimp_procedure_add_argument (procedure, pspec);
+          else
+            gimp_procedure_add_return_value (procedure, pspec);
+        }
+      else
+        {
+          cache->valid = FALSE;
+        }
+
+      g_free (name);
+      g_free (desc);
+    }
+
+  return proc;
+}
+
+static void
+plug_in_rc_cache_put_int (GString *buffer,
+                          gint32   value)
+{
+  g_string_append_len (buffer, (const gchar *) &value, sizeof (value));
+}
+
+static void
+plug_in_rc_cache_put_int64 (GString *buffer,
+                            gint64   value)
+{
+  g_string_append_len (buffer, (const gchar *) &value, sizeof (value));
+}
+
+static void
+plug_in_rc_cache_put_string (GString     *buffer,
+                             const gchar *str)
+{
+  if (str)
+    {
+      gint length = strlen (str);
+
+      plug_in_rc_cache_put_int (buffer, length);
+      g_string_append_len (buffer, str, length);
+    }
+  else
+    {
+      plug_in_rc_cache_put_int (buffer, -1);
+    }
+}
+
+static void
+plug_in_rc_cache_put_def (GString       *buffer,
+                          GimpPlugInDef *plug_in_def)
+{
+  GSList *list;
+
+  plug_in_rc_cache_put_string (buffer, plug_in_def->prog);
+  plug_in_rc_cache_put_int64  (buffer, plug_in_def->mtime);
+  plug_in_rc_cache_put_string (buffer, plug_in_def->checksum);
+
+  plug_in_rc_cache_put_int (buffer, g_slist_length (plug_in_def->procedures));
+
+  for (list = plug_in_def->procedures; list; list = g_slist_next (list))
+    plug_in_rc_cache_put_procedure (buffer, list->data);
+
+  plug_in_rc_cache_put_string (buffer, plug_in_def->locale_domain_name);
+  plug_in_rc_cache_put_string (buffer, plug_in_def->locale_domain_path);
+  plug_in_rc_cache_put_string (buffer, plug_in_def->help_domain_name);
+  plug_in_rc_cache_put_string (buffer, plug_in_def->help_domain_uri);
+  plug_in_rc_cache_put_int    (buffer, plug_in_def->has_init);
+}
+
+static void
+plug_in_rc_cache_put_procedure (GString             *buffer,
+                                GimpPlugInProcedure *proc)
+{
+  GimpProcedure *procedure = GIMP_PROCEDURE (proc);
+  GList         *list;
+  gint           i;
+
+  plug_in_rc_cache_put_string (buffer, procedure->original_name);
+  plug_in_rc_cache_put_int    (buffer, procedure->proc_type);
+  plug_in_rc_cache_put_string (buffer, procedure->blurb);
+  plug_in_rc_cache_put_string (buffer, procedure->help);
+  plug_in_rc_cache_put_string (buffer, procedure->author);
+  plug_in_rc_cache_put_string (buffer, procedure->copyright);
+  plug_in_rc_cache_put_string (buffer, procedure->date);
+  plug_in_rc_cache_put_string (buffer, proc->menu_label);
+
+  plug_in_rc_cache_put_int (buffer, g_list_length (proc->menu_paths));
+
+  for (list = proc->menu_paths; list; list = g_list_next (list))
+    plug_in_rc_cache_put_string (buffer, list->data);
+
+  plug_in_rc_cache_put_int (buffer, proc->icon_type);
+  plug_in_rc_cache_put_int (buffer, proc->icon_data_length);
+
+  switch (proc->icon_type)
+    {
+    case GIMP_ICON_TYPE_STOCK_ID:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      plug_in_rc_cache_put_string (buffer, (const gchar *) proc->icon_data);
+      break;
+
+    case GIMP_ICON_TYPE_INLINE_PIXBUF:
+      g_string_append_len (buffer, (const gchar *) proc->icon_data,
+                           proc->icon_data_length);
+      break;
+    }
+
+  plug_in_rc_cache_put_int (buffer, proc->file_proc);
+
+  if (proc->file_proc)
+    {
+      plug_in_rc_cache_put_string (buffer, proc->extensions);
+      plug_in_rc_cache_put_string (buffer, proc->prefixes);
+      plug_in_rc_cache_put_string (buffer, proc->magics);
+      plug_in_rc_cache_put_string (buffer, proc->mime_type);
+      plug_in_rc_cache_put_string (buffer, proc->thumb_loader);
+    }
+
+  plug_in_rc_cache_put_string (buffer, proc->image_types);
+
+  plug_in_rc_cache_put_int (buffer, procedure->num_args);
+  plug_in_rc_cache_put_int (buffer, procedure->num_values);
+
+  for (i = 0; i < procedure->num_args + procedure->num_values; i++)
+    {
+      GParamSpec *pspec;
+
+      if (i < procedure->num_args)
+        pspec = procedure->args[i];
+      else
+        pspec = procedure->values[i - procedure->num_args];
+
+      plug_in_rc_cache_put_int (buffer,
+                                gimp_pdb_compat_arg_type_from_gtype (G_PARAM_SPEC_VALUE_TYPE (pspec)));
+      plug_in_rc_cache_put_string (buffer, g_param_spec_get_name (pspec));
+      plug_in_rc_cache_put_string (buffer, g_param_spec_get_blurb (pspec));
+    }
+}
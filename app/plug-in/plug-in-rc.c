@@ -35,6 +35,7 @@
 #include "gimpplugindef.h"
 #include "gimppluginprocedure.h"
 #include "plug-in-rc.h"
+#include "plug-in-rc-cache.h"
 
 #include "gimp-intl.h"
 
@@ -67,6 +68,8 @@ static GTokenType plug_in_help_def_deserialize   (GScanner             *scanner,
                                                   GimpPlugInDef        *plug_in_def);
 static GTokenType plug_in_has_init_deserialize   (GScanner             *scanner,
                                                   GimpPlugInDef        *plug_in_def);
+static GTokenType plug_in_checksum_deserialize   (GScanner             *scanner,
+                                                  GimpPlugInDef        *plug_in_def);
 
 
 enum
@@ -77,6 +80,7 @@ enum
   LOCALE_DEF,
   HELP_DEF,
   HAS_INIT,
+  CHECKSUM,
   PROC_ARG,
   MENU_PATH,
   ICON,
@@ -105,6 +109,12 @@ plug_in_rc_parse (Gimp         *gimp,
   g_return_val_if_fail (filename != NULL, NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
+  /*  use the binary copy of the file if it is still up to date  */
+  plug_in_defs = plug_in_rc_cache_read (gimp, filename);
+
+  if (plug_in_defs)
+    return plug_in_defs;
+
   scanner = gimp_scanner_new_file (filename, error);
 
   if (! scanner)
@@ -126,6 +136,8 @@ plug_in_rc_parse (Gimp         *gimp,
                               "help-def", GINT_TO_POINTER (HELP_DEF));
   g_scanner_scope_add_symbol (scanner, PLUG_IN_DEF,
                               "has-init", GINT_TO_POINTER (HAS_INIT));
+  g_scanner_scope_add_symbol (scanner, PLUG_IN_DEF,
+                              "checksum", GINT_TO_POINTER (CHECKSUM));
   g_scanner_scope_add_symbol (scanner, PLUG_IN_DEF,
                               "proc-arg", GINT_TO_POINTER (PROC_ARG));
   g_scanner_scope_add_symbol (scanner, PLUG_IN_DEF,
@@ -220,7 +232,12 @@ plug_in_rc_parse (Gimp         *gimp,
 
   gimp_scanner_destroy (scanner);
 
-  return g_slist_reverse (plug_in_defs);
+  plug_in_defs = g_slist_reverse (plug_in_defs);
+
+  if (plug_in_defs)
+    plug_in_rc_cache_write (plug_in_defs, filename, NULL);
+
+  return plug_in_defs;
 }
 
 static GTokenType
@@ -291,6 +308,10 @@ plug_in_def_deserialize (Gimp      *gimp,
               token = plug_in_has_init_deserialize (scanner, plug_in_def);
               break;
 
+            case CHECKSUM:
+              token = plug_in_checksum_deserialize (scanner, plug_in_def);
+              break;
+
             default:
               break;
             }
@@ -746,6 +767,24 @@ plug_in_has_init_deserialize (GScanner      *scanner,
   return G_TOKEN_LEFT_PAREN;
 }
 
+static GTokenType
+plug_in_checksum_deserialize (GScanner      *scanner,
+                              GimpPlugInDef *plug_in_def)
+{
+  gchar *checksum;
+
+  if (! gimp_scanner_parse_string (scanner, &checksum))
+    return G_TOKEN_STRING;
+
+  gimp_plug_in_def_set_checksum (plug_in_def, checksum);
+  g_free (checksum);
+
+  if (! gimp_scanner_parse_token (scanner, G_TOKEN_RIGHT_PAREN))
+    return G_TOKEN_RIGHT_PAREN;
+
+  return G_TOKEN_LEFT_PAREN;
+}
+
 
 /* serialize functions */
 
@@ -768,6 +807,9 @@ plug_in_rc_write (GSList       *plug_in_defs,
   if (!writer)
     return FALSE;
 
+  /*  the cache is written again when the new file is parsed  */
+  plug_in_rc_cache_remove (filename);
+
   enum_class = g_type_class_ref (GIMP_TYPE_ICON_TYPE);
 
   gimp_config_writer_open (writer, "protocol-version");
@@ -795,6 +837,13 @@ plug_in_rc_write (GSList       *plug_in_defs,
 
           g_free (utf8);
 
+          if (plug_in_def->checksum)
+            {
+              gimp_config_writer_open (writer, "checksum");
+              gimp_config_writer_string (writer, plug_in_def->checksum);
+              gimp_config_writer_close (writer);
+            }
+
           for (list2 = plug_in_def->procedures; list2; list2 = list2->next)
             {
               GimpPlugInProcedure *proc      = list2->data;
@@ -0,0 +1,146 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "gegl/gimp-gegl-types.h"
+
+#include "gegl/gimp-babl.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/gimp-babl/" #function, function);
+
+/*  the number of pixels converted per benchmark run  */
+#define BENCHMARK_PIXELS      (1 << 20)
+#define BENCHMARK_ITERATIONS  10
+
+
+static const gchar *formats[] =
+{
+  "R'G'B'A u8",
+  "R'G'B' u8",
+  "RGBA u16",
+  "RGBA u32",
+  "RGBA half",
+  "RGBA float",
+  "Y'A u8",
+  "Y' u8",
+  "YA u16",
+  "YA float"
+};
+
+static const gchar *work_formats[] =
+{
+  "R'G'B'A float",
+  "RGBA float",
+  "cairo-ARGB32"
+};
+
+
+/**
+ * fish_cache:
+ *
+ * gimp_babl_fish() must hand out the fish babl_fish() would, and keep
+ * handing out the same one.
+ **/
+static void
+fish_cache (void)
+{
+  gint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++)
+    for (j = 0; j < G_N_ELEMENTS (work_formats); j++)
+      {
+        const Babl *format = babl_format (formats[i]);
+        const Babl *work   = babl_format (work_formats[j]);
+        const Babl *fish   = gimp_babl_fish (format, work);
+
+        g_assert (fish != NULL);
+        g_assert (fish == babl_fish (format, work));
+        g_assert (fish == gimp_babl_fish (format, work));
+        g_assert (gimp_babl_fish (work, format) != fish);
+      }
+}
+
+/**
+ * conversion_benchmark:
+ *
+ * Reports the megapixels per second of converting each drawable
+ * format to the working formats, only run with -m perf.
+ **/
+static void
+conversion_benchmark (void)
+{
+  guchar *src;
+  guchar *dest;
+  gint    i, j;
+
+  if (! g_test_perf ())
+    return;
+
+  /*  16 bytes is the biggest pixel in the lists above  */
+  src  = g_new (guchar, BENCHMARK_PIXELS * 16);
+  dest = g_new (guchar, BENCHMARK_PIXELS * 16);
+
+  for (i = 0; i < BENCHMARK_PIXELS * 16; i++)
+    src[i] = g_test_rand_int_range (0, 256);
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++)
+    for (j = 0; j < G_N_ELEMENTS (work_formats); j++)
+      {
+        const Babl *fish = gimp_babl_fish (babl_format (formats[i]),
+                                           babl_format (work_formats[j]));
+        gdouble     time;
+        gint        k;
+
+        g_test_timer_start ();
+        for (k = 0; k < BENCHMARK_ITERATIONS; k++)
+          gimp_babl_process (fish, src, dest, BENCHMARK_PIXELS);
+        time = g_test_timer_elapsed ();
+
+        g_test_maximized_result (BENCHMARK_PIXELS * BENCHMARK_ITERATIONS /
+                                 MAX (time, 1e-9) / 1e6,
+                                 "%s -> %s: %.1f MP/s",
+                                 formats[i], work_formats[j],
+                                 BENCHMARK_PIXELS * BENCHMARK_ITERATIONS /
+                                 MAX (time, 1e-9) / 1e6);
+      }
+
+  g_free (src);
+  g_free (dest);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  gegl_init (&argc, &argv);
+  gimp_babl_init ();
+
+  ADD_TEST (fish_cache);
+  ADD_TEST (conversion_benchmark);
+
+  return g_test_run ();
+}
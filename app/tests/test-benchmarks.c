@@ -0,0 +1,753 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Synthetic workloads for tracking performance across releases. All
+ *  of them only run with -m perf, see "make bench", and the input is
+ *  generated from a fixed seed so runs are comparable.
+ */
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpbrush.h"
+#include "core/gimpbrush-load.h"
+#include "core/gimpbrushgenerated.h"
+#include "core/gimpchannel.h"
+#include "core/gimpchannel-select.h"
+#include "core/gimpcontext.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpdrawable-operation.h"
+#include "core/gimpdynamics.h"
+#include "core/gimpdynamics-load.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-convert.h"
+#include "core/gimpimage-undo.h"
+#include "core/gimplayer.h"
+#include "core/gimppaintinfo.h"
+#include "core/gimpparamspecs.h"
+#include "core/gimppickable.h"
+#include "core/gimpprojection.h"
+
+#include "paint/gimppaintcore.h"
+#include "paint/gimppaintcore-stroke.h"
+#include "paint/gimppaintoptions.h"
+
+#include "pdb/gimppdb.h"
+#include "pdb/gimppdb-utils.h"
+
+#include "file/file-open.h"
+#include "file/file-procedure.h"
+#include "file/file-save.h"
+#include "file/file-utils.h"
+
+#include "plug-in/gimppluginmanager.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-benchmarks/" #function, gimp, function);
+
+#define BENCHMARK_SEED        4711
+#define BENCHMARK_WIDTH       2048
+#define BENCHMARK_HEIGHT      1536
+#define BENCHMARK_ITERATIONS  3
+
+#define XCF_LAYERS            16
+#define PROJECTION_LAYERS     8
+#define STROKE_POINTS         400
+#define IPC_PROCEDURE         "plug-in-max-rgb"
+
+
+static const GimpCoords default_coords = GIMP_COORDS_DEFAULT_VALUES;
+
+
+static GimpLayer *
+gimp_benchmark_add_layer (GimpImage            *image,
+                          GRand                *rand,
+                          GimpLayerModeEffects  mode)
+{
+  GimpLayer  *layer;
+  GeglBuffer *buffer;
+  guint32    *data;
+  gint        n_pixels = BENCHMARK_WIDTH * BENCHMARK_HEIGHT;
+  gint        i;
+
+  layer = gimp_layer_new (image, BENCHMARK_WIDTH, BENCHMARK_HEIGHT,
+                          gimp_image_get_layer_format (image, TRUE),
+                          "benchmark", 1.0, mode);
+
+  data = g_new (guint32, n_pixels);
+
+  for (i = 0; i < n_pixels; i++)
+    data[i] = g_rand_int (rand);
+
+  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+
+  gegl_buffer_set (buffer, NULL, 0,
+                   gimp_drawable_get_format (GIMP_DRAWABLE (layer)),
+                   data, GEGL_AUTO_ROWSTRIDE);
+
+  g_free (data);
+
+  gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+
+  return layer;
+}
+
+static GimpImage *
+gimp_benchmark_new_image (Gimp *gimp,
+                          gint  n_layers)
+{
+  GimpImage *image;
+  GRand     *rand = g_rand_new_with_seed (BENCHMARK_SEED);
+  gint       i;
+
+  image = gimp_image_new (gimp, BENCHMARK_WIDTH, BENCHMARK_HEIGHT,
+                          GIMP_RGB, GIMP_PRECISION_U8);
+
+  /*  the workloads are about the operations, not about undo  */
+  gimp_image_undo_disable (image);
+
+  for (i = 0; i < n_layers; i++)
+    gimp_benchmark_add_layer (image, rand, GIMP_NORMAL_MODE);
+
+  g_rand_free (rand);
+
+  return image;
+}
+
+static void
+gimp_benchmark_smooth (GimpDrawable *drawable,
+                       gdouble       std_dev)
+{
+  GeglNode *node = gegl_node_new_child (NULL,
+                                        "operation", "gegl:gaussian-blur",
+                                        "std-dev-x", std_dev,
+                                        "std-dev-y", std_dev,
+                                        NULL);
+
+  gimp_drawable_apply_operation (drawable, NULL, "Gaussian Blur", node);
+
+  g_object_unref (node);
+}
+
+/*  invalidates and then pulls the whole projection, which is what a
+ *  display showing the entire image at 100% does
+ */
+static void
+gimp_benchmark_render_projection (GimpImage *image)
+{
+  GimpProjection *projection = gimp_image_get_projection (image);
+  GeglBuffer     *buffer;
+  guchar         *data;
+
+  gimp_image_invalidate (image, 0, 0, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+  gimp_projection_flush_now (projection);
+
+  buffer = gimp_pickable_get_buffer (GIMP_PICKABLE (projection));
+  data   = g_malloc (BENCHMARK_WIDTH * BENCHMARK_HEIGHT * 4);
+
+  gegl_buffer_get (buffer, NULL, 1.0, babl_format ("R'G'B'A u8"),
+                   data, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_free (data);
+}
+
+static gdouble
+gimp_benchmark_megapixels (gint    n_pixels,
+                           gdouble time)
+{
+  return n_pixels / MAX (time, 1e-9) / 1e6;
+}
+
+/**
+ * xcf_benchmark:
+ *
+ * Saves and loads an image of XCF_LAYERS full size layers.
+ **/
+static void
+xcf_benchmark (gconstpointer data)
+{
+  Gimp                *gimp = GIMP (data);
+  GimpImage           *image;
+  GimpImage           *loaded;
+  GimpPlugInProcedure *proc;
+  GimpPDBStatusType    status;
+  gchar               *uri;
+  gdouble              save_time;
+  gdouble              load_time;
+
+  if (! g_test_perf ())
+    return;
+
+  image = gimp_benchmark_new_image (gimp, XCF_LAYERS);
+
+  uri  = g_build_filename (g_get_tmp_dir (), "gimp-benchmark.xcf", NULL);
+  proc = file_procedure_find (gimp->plug_in_manager->save_procs, uri, NULL);
+
+  g_test_timer_start ();
+  file_save (gimp, image, NULL, uri, proc, GIMP_RUN_NONINTERACTIVE,
+             FALSE, FALSE, FALSE, NULL);
+  save_time = g_test_timer_elapsed ();
+
+  proc = file_procedure_find (gimp->plug_in_manager->load_procs, uri, NULL);
+
+  g_test_timer_start ();
+  loaded = file_open_image (gimp, gimp_get_user_context (gimp), NULL,
+                            uri, uri, FALSE, proc, GIMP_RUN_NONINTERACTIVE,
+                            &status, NULL, NULL);
+  load_time = g_test_timer_elapsed ();
+
+  g_assert (loaded != NULL);
+
+  g_test_minimized_result (save_time,
+                           "xcf save, %d layers %dx%d: %.3f s",
+                           XCF_LAYERS, BENCHMARK_WIDTH, BENCHMARK_HEIGHT,
+                           save_time);
+  g_test_minimized_result (load_time,
+                           "xcf load, %d layers %dx%d: %.3f s",
+                           XCF_LAYERS, BENCHMARK_WIDTH, BENCHMARK_HEIGHT,
+                           load_time);
+
+  g_object_unref (loaded);
+  g_object_unref (image);
+
+  g_unlink (uri);
+  g_free (uri);
+}
+
+/**
+ * projection_benchmark:
+ *
+ * Renders the projection of PROJECTION_LAYERS normal mode layers.
+ **/
+static void
+projection_benchmark (gconstpointer data)
+{
+  Gimp      *gimp = GIMP (data);
+  GimpImage *image;
+  gdouble    time;
+  gint       i;
+
+  if (! g_test_perf ())
+    return;
+
+  image = gimp_benchmark_new_image (gimp, PROJECTION_LAYERS);
+
+  /*  build the graph outside of the timing  */
+  gimp_benchmark_render_projection (image);
+
+  g_test_timer_start ();
+  for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+    gimp_benchmark_render_projection (image);
+  time = g_test_timer_elapsed ();
+
+  g_test_maximized_result (gimp_benchmark_megapixels (BENCHMARK_WIDTH *
+                                                      BENCHMARK_HEIGHT *
+                                                      BENCHMARK_ITERATIONS,
+                                                      time),
+                           "projection, %d layers: %.1f MP/s",
+                           PROJECTION_LAYERS,
+                           gimp_benchmark_megapixels (BENCHMARK_WIDTH *
+                                                      BENCHMARK_HEIGHT *
+                                                      BENCHMARK_ITERATIONS,
+                                                      time));
+
+  g_object_unref (image);
+}
+
+/**
+ * layer_modes_benchmark:
+ *
+ * Renders the projection of two layers with the top one in each of
+ * the layer modes.
+ **/
+static void
+layer_modes_benchmark (gconstpointer data)
+{
+  Gimp       *gimp = GIMP (data);
+  GimpImage  *image;
+  GimpLayer  *top;
+  GRand      *rand;
+  GEnumClass *enum_class;
+  gint        mode;
+
+  if (! g_test_perf ())
+    return;
+
+  image = gimp_benchmark_new_image (gimp, 1);
+  rand  = g_rand_new_with_seed (BENCHMARK_SEED + 1);
+  top   = gimp_benchmark_add_layer (image, rand, GIMP_NORMAL_MODE);
+
+  g_rand_free (rand);
+
+  enum_class = g_type_class_ref (GIMP_TYPE_LAYER_MODE_EFFECTS);
+
+  /*  the modes after color erase are paint modes only  */
+  for (mode = GIMP_NORMAL_MODE; mode <= GIMP_COLOR_ERASE_MODE; mode++)
+    {
+      GEnumValue *value = g_enum_get_value (enum_class, mode);
+      gdouble     time;
+      gint        i;
+
+      gimp_layer_set_mode (top, mode, FALSE);
+      gimp_benchmark_render_projection (image);
+
+      g_test_timer_start ();
+      for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        gimp_benchmark_render_projection (image);
+      time = g_test_timer_elapsed ();
+
+      g_test_maximized_result (gimp_benchmark_megapixels (BENCHMARK_WIDTH *
+                                                          BENCHMARK_HEIGHT *
+                                                          BENCHMARK_ITERATIONS,
+                                                          time),
+                               "layer mode %s: %.1f MP/s",
+                               value->value_nick,
+                               gimp_benchmark_megapixels (BENCHMARK_WIDTH *
+                                                          BENCHMARK_HEIGHT *
+                                                          BENCHMARK_ITERATIONS,
+                                                          time));
+    }
+
+  g_type_class_unref (enum_class);
+
+  g_object_unref (image);
+}
+
+/**
+ * gaussian_blur_benchmark:
+ *
+ * Applies a gaussian blur with a standard deviation of 10 to a layer.
+ **/
+static void
+gaussian_blur_benchmark (gconstpointer data)
+{
+  Gimp      *gimp = GIMP (data);
+  GimpImage *image;
+  GimpLayer *layer;
+  gdouble    time;
+
+  if (! g_test_perf ())
+    return;
+
+  image = gimp_benchmark_new_image (gimp, 1);
+  layer = gimp_image_get_active_layer (image);
+
+  g_test_timer_start ();
+  gimp_benchmark_smooth (GIMP_DRAWABLE (layer), 10.0);
+  time = g_test_timer_elapsed ();
+
+  g_test_maximized_result (gimp_benchmark_megapixels (BENCHMARK_WIDTH *
+                                                      BENCHMARK_HEIGHT,
+                                                      time),
+                           "gaussian blur, std-dev 10: %.1f MP/s",
+                           gimp_benchmark_megapixels (BENCHMARK_WIDTH *
+                                                      BENCHMARK_HEIGHT,
+                                                      time));
+
+  g_object_unref (image);
+}
+
+/**
+ * stroke_benchmark:
+ *
+ * Replays a seeded random paintbrush stroke of STROKE_POINTS points
+ * with a 51 pixel generated brush.
+ **/
+static void
+stroke_benchmark (gconstpointer data)
+{
+  Gimp             *gimp    = GIMP (data);
+  GimpContext      *context = gimp_get_user_context (gimp);
+  GimpImage        *image;
+  GimpLayer        *layer;
+  GimpData         *brush;
+  GimpPaintInfo    *paint_info;
+  GimpPaintOptions *options;
+  GimpPaintCore    *core;
+  GimpCoords       *coords;
+  GRand            *rand;
+  gdouble           time;
+  gint              i;
+
+  if (! g_test_perf ())
+    return;
+
+  image = gimp_benchmark_new_image (gimp, 1);
+  layer = gimp_image_get_active_layer (image);
+
+  brush = gimp_brush_generated_new ("benchmark",
+                                    GIMP_BRUSH_GENERATED_CIRCLE,
+                                    25.0, 2, 0.5, 1.0, 0.0);
+  gimp_context_set_brush (context, GIMP_BRUSH (brush));
+
+  paint_info = gimp_pdb_get_paint_info (gimp, "gimp-paintbrush", NULL);
+  options    = gimp_paint_options_new (paint_info);
+
+  g_object_set (options,
+                "brush-size", 51.0,
+                NULL);
+
+  gimp_context_define_properties (GIMP_CONTEXT (options),
+                                  GIMP_CONTEXT_PAINT_PROPS_MASK,
+                                  FALSE);
+  gimp_context_set_parent (GIMP_CONTEXT (options), context);
+
+  core = g_object_new (paint_info->paint_type, NULL);
+
+  rand   = g_rand_new_with_seed (BENCHMARK_SEED);
+  coords = g_new (GimpCoords, STROKE_POINTS);
+
+  for (i = 0; i < STROKE_POINTS; i++)
+    {
+      coords[i]   = default_coords;
+      coords[i].x = g_rand_double_range (rand, 0, BENCHMARK_WIDTH);
+      coords[i].y = g_rand_double_range (rand, 0, BENCHMARK_HEIGHT);
+    }
+
+  g_rand_free (rand);
+
+  g_test_timer_start ();
+  gimp_paint_core_stroke (core, GIMP_DRAWABLE (layer), options,
+                          coords, STROKE_POINTS, FALSE, NULL);
+  time = g_test_timer_elapsed ();
+
+  g_test_minimized_result (time,
+                           "paintbrush stroke, %d points: %.3f s",
+                           STROKE_POINTS, time);
+
+  g_free (coords);
+  g_object_unref (core);
+  g_object_unref (options);
+  g_object_unref (brush);
+  g_object_unref (image);
+}
+
+/**
+ * stroke_replay_benchmark:
+ *
+ * Replays the stroke recording named by GIMP_BENCHMARK_STROKE, see
+ * GIMP_STROKE_RECORD and gimp_paint_core_replay(). The strokes are
+ * painted with the paintbrush on the active drawable of the image
+ * named by GIMP_BENCHMARK_IMAGE, with the brush file and dynamics
+ * file named by GIMP_BENCHMARK_BRUSH and GIMP_BENCHMARK_DYNAMICS; if
+ * unset, a noise layer, a 51 pixel generated brush and the default
+ * dynamics are used.
+ **/
+static void
+stroke_replay_benchmark (gconstpointer data)
+{
+  Gimp                 *gimp    = GIMP (data);
+  GimpContext          *context = gimp_get_user_context (gimp);
+  const gchar          *stroke  = g_getenv ("GIMP_BENCHMARK_STROKE");
+  const gchar          *filename;
+  GimpImage            *image;
+  GimpDrawable         *drawable;
+  GimpData             *brush   = NULL;
+  GimpData             *dynamics;
+  GimpPaintInfo        *paint_info;
+  GimpPaintOptions     *options;
+  GimpPaintCore        *core;
+  GimpPaintReplayStats  stats;
+  GError               *error   = NULL;
+
+  if (! g_test_perf ())
+    return;
+
+  if (! stroke)
+    {
+      g_test_message ("GIMP_BENCHMARK_STROKE not set, skipping");
+      return;
+    }
+
+  filename = g_getenv ("GIMP_BENCHMARK_IMAGE");
+
+  if (filename)
+    {
+      GimpPlugInProcedure *proc;
+      GimpPDBStatusType    status;
+      gchar               *uri;
+
+      uri  = file_utils_filename_to_uri (gimp, filename, NULL);
+      proc = file_procedure_find (gimp->plug_in_manager->load_procs, uri,
+                                  NULL);
+
+      image = file_open_image (gimp, context, NULL,
+                               uri, filename, FALSE, proc,
+                               GIMP_RUN_NONINTERACTIVE,
+                               &status, NULL, &error);
+      g_free (uri);
+
+      g_assert_no_error (error);
+      g_assert (image != NULL);
+    }
+  else
+    {
+      image = gimp_benchmark_new_image (gimp, 1);
+    }
+
+  drawable = gimp_image_get_active_drawable (image);
+
+  filename = g_getenv ("GIMP_BENCHMARK_BRUSH");
+
+  if (filename)
+    {
+      GList *list = gimp_brush_load (context, filename, &error);
+
+      g_assert_no_error (error);
+
+      brush = g_object_ref (list->data);
+      g_list_free_full (list, (GDestroyNotify) g_object_unref);
+    }
+  else
+    {
+      brush = gimp_brush_generated_new ("benchmark",
+                                        GIMP_BRUSH_GENERATED_CIRCLE,
+                                        25.0, 2, 0.5, 1.0, 0.0);
+    }
+
+  gimp_context_set_brush (context, GIMP_BRUSH (brush));
+
+  filename = g_getenv ("GIMP_BENCHMARK_DYNAMICS");
+
+  if (filename)
+    {
+      GList *list = gimp_dynamics_load (context, filename, &error);
+
+      g_assert_no_error (error);
+
+      dynamics = g_object_ref (list->data);
+      g_list_free_full (list, (GDestroyNotify) g_object_unref);
+    }
+  else
+    {
+      dynamics = g_object_ref (gimp_dynamics_get_standard (context));
+    }
+
+  gimp_context_set_dynamics (context, GIMP_DYNAMICS (dynamics));
+
+  paint_info = gimp_pdb_get_paint_info (gimp, "gimp-paintbrush", NULL);
+  options    = gimp_paint_options_new (paint_info);
+
+  gimp_context_define_properties (GIMP_CONTEXT (options),
+                                  GIMP_CONTEXT_PAINT_PROPS_MASK,
+                                  FALSE);
+  gimp_context_set_parent (GIMP_CONTEXT (options), context);
+
+  core = g_object_new (paint_info->paint_type, NULL);
+
+  gimp_paint_core_replay (core, drawable, options, stroke, FALSE,
+                          &stats, &error);
+
+  g_assert_no_error (error);
+
+  g_test_maximized_result (stats.n_dabs / stats.time,
+                           "stroke replay, %d strokes, %d events: "
+                           "%.0f dabs/s",
+                           stats.n_strokes, stats.n_events,
+                           stats.n_dabs / stats.time);
+  g_test_minimized_result (stats.latency_p50 * 1000.0,
+                           "stroke replay latency, 50%%: %.3f ms",
+                           stats.latency_p50 * 1000.0);
+  g_test_minimized_result (stats.latency_p95 * 1000.0,
+                           "stroke replay latency, 95%%: %.3f ms",
+                           stats.latency_p95 * 1000.0);
+  g_test_minimized_result (stats.latency_p99 * 1000.0,
+                           "stroke replay latency, 99%%: %.3f ms",
+                           stats.latency_p99 * 1000.0);
+  g_test_minimized_result (stats.latency_max * 1000.0,
+                           "stroke replay latency, max: %.3f ms",
+                           stats.latency_max * 1000.0);
+
+  g_object_unref (core);
+  g_object_unref (options);
+  g_object_unref (dynamics);
+  g_object_unref (brush);
+  g_object_unref (image);
+}
+
+/**
+ * fuzzy_select_benchmark:
+ *
+ * Seed fills a smoothed noise layer from its center.
+ **/
+static void
+fuzzy_select_benchmark (gconstpointer data)
+{
+  Gimp      *gimp = GIMP (data);
+  GimpImage *image;
+  GimpLayer *layer;
+  gdouble    time;
+
+  if (! g_test_perf ())
+    return;
+
+  image = gimp_benchmark_new_image (gimp, 1);
+  layer = gimp_image_get_active_layer (image);
+
+  /*  plain noise would stop the fill right at the seed  */
+  gimp_benchmark_smooth (GIMP_DRAWABLE (layer), 20.0);
+
+  g_test_timer_start ();
+  gimp_channel_select_fuzzy (gimp_image_get_mask (image),
+                             GIMP_DRAWABLE (layer), FALSE,
+                             BENCHMARK_WIDTH / 2, BENCHMARK_HEIGHT / 2,
+                             0.25, FALSE,
+                             GIMP_SELECT_CRITERION_COMPOSITE,
+                             GIMP_CHANNEL_OP_REPLACE,
+                             TRUE, FALSE, 0.0, 0.0);
+  time = g_test_timer_elapsed ();
+
+  g_test_minimized_result (time,
+                           "fuzzy select, threshold 0.25: %.3f s", time);
+
+  g_object_unref (image);
+}
+
+/**
+ * convert_indexed_benchmark:
+ *
+ * Converts a noise image to 256 colors with Floyd-Steinberg dithering.
+ **/
+static void
+convert_indexed_benchmark (gconstpointer data)
+{
+  Gimp      *gimp = GIMP (data);
+  GimpImage *image;
+  gdouble    time;
+
+  if (! g_test_perf ())
+    return;
+
+  image = gimp_benchmark_new_image (gimp, 1);
+
+  g_test_timer_start ();
+  gimp_image_convert (image, GIMP_INDEXED, 256, GIMP_FS_DITHER,
+                      FALSE, FALSE, GIMP_MAKE_PALETTE, NULL, NULL, NULL);
+  time = g_test_timer_elapsed ();
+
+  g_test_minimized_result (time,
+                           "indexed conversion, 256 colors: %.3f s", time);
+
+  g_object_unref (image);
+}
+
+/**
+ * plug_in_ipc_benchmark:
+ *
+ * Runs IPC_PROCEDURE, which reads and writes every tile of the layer
+ * and does hardly anything else, so mostly the tile transfer between
+ * the core and the plug-in is measured.
+ **/
+static void
+plug_in_ipc_benchmark (gconstpointer data)
+{
+  Gimp           *gimp = GIMP (data);
+  GimpImage      *image;
+  GimpLayer      *layer;
+  GimpValueArray *return_vals;
+  gdouble         time;
+
+  if (! g_test_perf ())
+    return;
+
+  if (! gimp_pdb_lookup_procedure (gimp->pdb, IPC_PROCEDURE))
+    {
+      g_test_message ("%s not installed, skipping", IPC_PROCEDURE);
+      return;
+    }
+
+  image = gimp_benchmark_new_image (gimp, 1);
+  layer = gimp_image_get_active_layer (image);
+
+  g_test_timer_start ();
+  return_vals =
+    gimp_pdb_execute_procedure_by_name (gimp->pdb,
+                                        gimp_get_user_context (gimp),
+                                        NULL, NULL,
+                                        IPC_PROCEDURE,
+                                        GIMP_TYPE_INT32, GIMP_RUN_NONINTERACTIVE,
+                                        GIMP_TYPE_IMAGE_ID,
+                                        gimp_image_get_ID (image),
+                                        GIMP_TYPE_DRAWABLE_ID,
+                                        gimp_item_get_ID (GIMP_ITEM (layer)),
+                                        GIMP_TYPE_INT32, 0,
+                                        G_TYPE_NONE);
+  time = g_test_timer_elapsed ();
+
+  gimp_value_array_unref (return_vals);
+
+  g_test_maximized_result (gimp_benchmark_megapixels (BENCHMARK_WIDTH *
+                                                      BENCHMARK_HEIGHT,
+                                                      time),
+                           "plug-in tile IPC (%s): %.1f MP/s",
+                           IPC_PROCEDURE,
+                           gimp_benchmark_megapixels (BENCHMARK_WIDTH *
+                                                      BENCHMARK_HEIGHT,
+                                                      time));
+
+  g_object_unref (image);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (xcf_benchmark);
+  ADD_TEST (projection_benchmark);
+  ADD_TEST (layer_modes_benchmark);
+  ADD_TEST (gaussian_blur_benchmark);
+  ADD_TEST (stroke_benchmark);
+  ADD_TEST (stroke_replay_benchmark);
+  ADD_TEST (fuzzy_select_benchmark);
+  ADD_TEST (convert_indexed_benchmark);
+  ADD_TEST (plug_in_ipc_benchmark);
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  result = g_test_run ();
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,215 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpboundary.h"
+
+#include "tests.h"
+#include "gimp-app-test-utils.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/gimp-boundary/" #function, function);
+
+/*  the size of the mask used for benchmarking  */
+#define BENCHMARK_SIZE        4096
+#define BENCHMARK_ITERATIONS  3
+
+
+static Gimp *gimp = NULL;
+
+
+static GeglBuffer *
+gimp_test_boundary_new_mask (gint width,
+                             gint height)
+{
+  GeglBuffer *buffer;
+  gfloat     *data = g_new (gfloat, width * height);
+  gint        i;
+
+  for (i = 0; i < width * height; i++)
+    data[i] = g_test_rand_int_range (0, 3) ? 0.0 : 1.0;
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
+                            babl_format ("Y float"));
+
+  gegl_buffer_set (buffer, NULL, 0, babl_format ("Y float"),
+                   data, GEGL_AUTO_ROWSTRIDE);
+
+  g_free (data);
+
+  return buffer;
+}
+
+static GimpBoundSeg *
+gimp_test_boundary_find (GeglBuffer       *buffer,
+                         GimpBoundaryType  type,
+                         gint              n_threads,
+                         gint             *num_segs)
+{
+  gint width  = gegl_buffer_get_width  (buffer);
+  gint height = gegl_buffer_get_height (buffer);
+
+  /*  the strips are spread over the core's worker pool  */
+  g_object_set (gimp->config,
+                "num-processors", n_threads,
+                NULL);
+
+  if (type == GIMP_BOUNDARY_WITHIN_BOUNDS)
+    return gimp_boundary_find (buffer, NULL, babl_format ("Y float"),
+                               type,
+                               width / 8, height / 8,
+                               width - width / 8, height - height / 8,
+                               0.5, num_segs);
+
+  return gimp_boundary_find (buffer, NULL, babl_format ("Y float"),
+                             type,
+                             width / 4, height / 4,
+                             width / 2, height / 2,
+                             0.5, num_segs);
+}
+
+/**
+ * threads_match_single_thread:
+ *
+ * Tracing the boundary in parallel strips must produce the same
+ * segments, in the same order, as a single pass.
+ **/
+static void
+threads_match_single_thread (void)
+{
+  static const gint sizes[][2] = { { 1, 1 }, { 7, 300 }, { 300, 7 },
+                                   { 513, 1031 }, { 2000, 600 } };
+  static const GimpBoundaryType types[] = { GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                            GIMP_BOUNDARY_IGNORE_BOUNDS };
+  gint n, t, i;
+
+  for (n = 0; n < G_N_ELEMENTS (sizes); n++)
+    {
+      GeglBuffer *buffer = gimp_test_boundary_new_mask (sizes[n][0],
+                                                        sizes[n][1]);
+
+      for (t = 0; t < G_N_ELEMENTS (types); t++)
+        {
+          GimpBoundSeg *expected;
+          GimpBoundSeg *actual;
+          gint          num_expected;
+          gint          num_actual;
+
+          expected = gimp_test_boundary_find (buffer, types[t], 1,
+                                              &num_expected);
+          actual   = gimp_test_boundary_find (buffer, types[t], 5,
+                                              &num_actual);
+
+          g_assert_cmpint (num_expected, ==, num_actual);
+
+          for (i = 0; i < num_expected; i++)
+            {
+              g_assert_cmpint (expected[i].x1,   ==, actual[i].x1);
+              g_assert_cmpint (expected[i].y1,   ==, actual[i].y1);
+              g_assert_cmpint (expected[i].x2,   ==, actual[i].x2);
+              g_assert_cmpint (expected[i].y2,   ==, actual[i].y2);
+              g_assert_cmpint (expected[i].open, ==, actual[i].open);
+            }
+
+          g_free (expected);
+          g_free (actual);
+        }
+
+      g_object_unref (buffer);
+    }
+}
+
+/**
+ * find_benchmark:
+ *
+ * Times gimp_boundary_find() on a large noisy mask with one and with
+ * all threads, only run with -m perf.
+ **/
+static void
+find_benchmark (void)
+{
+  GeglBuffer *buffer;
+  gdouble     single_time;
+  gdouble     time;
+  gint        n_threads = gimp_get_number_of_processors ();
+  gint        num_segs;
+  gint        i;
+
+  if (! g_test_perf ())
+    return;
+
+  buffer = gimp_test_boundary_new_mask (BENCHMARK_SIZE, BENCHMARK_SIZE);
+
+  g_test_timer_start ();
+  for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+    g_free (gimp_test_boundary_find (buffer, GIMP_BOUNDARY_WITHIN_BOUNDS, 1,
+                                     &num_segs));
+  single_time = g_test_timer_elapsed ();
+
+  g_test_timer_start ();
+  for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+    g_free (gimp_test_boundary_find (buffer, GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                     n_threads, &num_segs));
+  time = g_test_timer_elapsed ();
+
+  g_test_minimized_result (time / BENCHMARK_ITERATIONS,
+                           "boundary %dx%d, %d segs: %.3f ms "
+                           "(1 thread %.3f ms, %d threads %.1fx)",
+                           BENCHMARK_SIZE, BENCHMARK_SIZE, num_segs,
+                           1000.0 * time / BENCHMARK_ITERATIONS,
+                           1000.0 * single_time / BENCHMARK_ITERATIONS,
+                           n_threads, single_time / MAX (time, 1e-9));
+
+  g_object_unref (buffer);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  int result;
+
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (threads_match_single_thread);
+  ADD_TEST (find_benchmark);
+
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,256 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "core/gimpbrush-transform.h"
+
+#include "paint/gimpbrushcore-kernels.h"
+#include "paint/gimpbrushcore-loops.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/gimp-brush-kernels/" #function, function);
+
+/*  the size of the brush used for benchmarking  */
+#define BENCHMARK_SIZE        512
+#define BENCHMARK_ITERATIONS  50
+
+
+static guchar *
+gimp_test_brush_kernels_new_mask (gint width,
+                                  gint height)
+{
+  guchar *mask = g_new (guchar, width * height);
+  gint    i;
+
+  for (i = 0; i < width * height; i++)
+    mask[i] = g_test_rand_int_range (0, 4) ? g_test_rand_int_range (0, 256) : 0;
+
+  return mask;
+}
+
+/**
+ * subsample_matches_scalar:
+ *
+ * The optimized subsample loops must produce exactly the same masks
+ * as the scalar code, for all kernels and odd sizes.
+ **/
+static void
+subsample_matches_scalar (void)
+{
+#ifdef GIMP_BRUSH_CORE_LOOPS_SSE2
+  static const gint sizes[][2] = { { 1, 1 }, { 3, 5 }, { 17, 9 },
+                                   { 64, 64 }, { 101, 33 } };
+  gint              n;
+
+  if (! (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2))
+    return;
+
+  for (n = 0; n < G_N_ELEMENTS (sizes); n++)
+    {
+      gint    width       = sizes[n][0];
+      gint    height      = sizes[n][1];
+      gint    dest_width  = width  + 2;
+      gint    dest_height = height + 2;
+      guchar *mask        = gimp_test_brush_kernels_new_mask (width, height);
+      guchar *expected    = g_new (guchar, dest_width * dest_height);
+      guchar *actual      = g_new (guchar, dest_width * dest_height);
+      gint    kx, ky, offset;
+
+      for (ky = 0; ky <= KERNEL_SUBSAMPLE; ky++)
+        for (kx = 0; kx <= KERNEL_SUBSAMPLE; kx++)
+          for (offset = 0; offset < 4; offset++)
+            {
+              memset (expected, 0, dest_width * dest_height);
+              memset (actual,   0, dest_width * dest_height);
+
+              gimp_brush_core_subsample_loop_scalar (mask, width, height,
+                                                     expected,
+                                                     dest_width, dest_height,
+                                                     offset & 1, offset >> 1,
+                                                     subsample[ky][kx]);
+              gimp_brush_core_subsample_loop_sse2 (mask, width, height,
+                                                   actual,
+                                                   dest_width, dest_height,
+                                                   offset & 1, offset >> 1,
+                                                   subsample[ky][kx]);
+
+              g_assert (memcmp (expected, actual,
+                                dest_width * dest_height) == 0);
+            }
+
+      g_free (mask);
+      g_free (expected);
+      g_free (actual);
+    }
+#endif
+}
+
+/**
+ * solidify_matches_scalar:
+ *
+ * The optimized solidify loops must match the scalar code.
+ **/
+static void
+solidify_matches_scalar (void)
+{
+#ifdef GIMP_BRUSH_CORE_LOOPS_SSE2
+  guchar *mask;
+  guchar  expected[37];
+  guchar  actual[37];
+
+  if (! (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2))
+    return;
+
+  mask = gimp_test_brush_kernels_new_mask (37, 1);
+
+  gimp_brush_core_solidify_loop_scalar (mask, expected, 37);
+  gimp_brush_core_solidify_loop_sse2   (mask, actual,   37);
+
+  g_assert (memcmp (expected, actual, 37) == 0);
+
+  g_free (mask);
+#endif
+}
+
+/**
+ * transform_matches_scalar:
+ *
+ * The optimized brush transform rows must match the scalar code, for
+ * walks that enter and leave the source in all directions.
+ **/
+static void
+transform_matches_scalar (void)
+{
+#ifdef GIMP_BRUSH_TRANSFORM_SSE2
+  static const gint sizes[][2] = { { 1, 1 }, { 3, 5 }, { 17, 9 },
+                                   { 64, 64 }, { 101, 33 } };
+  const gint        one        = 1 << GIMP_BRUSH_TRANSFORM_FRACTION_BITS;
+  gint              n;
+
+  if (! (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2))
+    return;
+
+  for (n = 0; n < G_N_ELEMENTS (sizes); n++)
+    {
+      gint    width    = sizes[n][0];
+      gint    height   = sizes[n][1];
+      gint    n_pixels = 2 * MAX (width, height) + 3;
+      guchar *mask     = gimp_test_brush_kernels_new_mask (width + 1,
+                                                           height + 1);
+      guchar *expected = g_new (guchar, n_pixels);
+      guchar *actual   = g_new (guchar, n_pixels);
+      gint    i;
+
+      for (i = 0; i < 64; i++)
+        {
+          gint x_i  = g_test_rand_int_range (-width  * one, 2 * width  * one);
+          gint y_i  = g_test_rand_int_range (-height * one, 2 * height * one);
+          gint ux_i = g_test_rand_int_range (-2 * one, 2 * one);
+          gint uy_i = g_test_rand_int_range (-2 * one, 2 * one);
+
+          gimp_brush_transform_resample_row_scalar (mask, width + 1,
+                                                    width, height, 1,
+                                                    expected, n_pixels,
+                                                    x_i, y_i, ux_i, uy_i);
+          gimp_brush_transform_resample_row_sse2 (mask, width + 1,
+                                                  width, height,
+                                                  actual, n_pixels,
+                                                  x_i, y_i, ux_i, uy_i);
+
+          g_assert (memcmp (expected, actual, n_pixels) == 0);
+        }
+
+      g_free (mask);
+      g_free (expected);
+      g_free (actual);
+    }
+#endif
+}
+
+/**
+ * subsample_benchmark:
+ *
+ * Times the scalar and the dispatched subsample loop on a large brush,
+ * only run with -m perf.
+ **/
+static void
+subsample_benchmark (void)
+{
+  gint    dest_width  = BENCHMARK_SIZE + 2;
+  gint    dest_height = BENCHMARK_SIZE + 2;
+  guchar *mask;
+  guchar *dest;
+  gdouble scalar_time;
+  gdouble time;
+  gint    i;
+
+  if (! g_test_perf ())
+    return;
+
+  mask = gimp_test_brush_kernels_new_mask (BENCHMARK_SIZE, BENCHMARK_SIZE);
+  dest = g_new0 (guchar, dest_width * dest_height);
+
+  g_test_timer_start ();
+  for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+    gimp_brush_core_subsample_loop_scalar (mask,
+                                           BENCHMARK_SIZE, BENCHMARK_SIZE,
+                                           dest, dest_width, dest_height,
+                                           1, 0, subsample[1][3]);
+  scalar_time = g_test_timer_elapsed ();
+
+  g_test_timer_start ();
+  for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+    gimp_brush_core_subsample_loop (mask,
+                                    BENCHMARK_SIZE, BENCHMARK_SIZE,
+                                    dest, dest_width, dest_height,
+                                    1, 0, 3, 1);
+  time = g_test_timer_elapsed ();
+
+  g_test_minimized_result (time / BENCHMARK_ITERATIONS,
+                           "subsample %dx%d: %.3f ms (scalar %.3f ms, %.1fx)",
+                           BENCHMARK_SIZE, BENCHMARK_SIZE,
+                           1000.0 * time / BENCHMARK_ITERATIONS,
+                           1000.0 * scalar_time / BENCHMARK_ITERATIONS,
+                           scalar_time / MAX (time, 1e-9));
+
+  g_free (mask);
+  g_free (dest);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (subsample_matches_scalar);
+  ADD_TEST (solidify_matches_scalar);
+  ADD_TEST (transform_matches_scalar);
+  ADD_TEST (subsample_benchmark);
+
+  return g_test_run ();
+}
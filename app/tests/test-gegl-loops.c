@@ -0,0 +1,350 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "gegl/gimp-gegl-types.h"
+
+#include "gegl/gimp-babl.h"
+#include "gegl/gimp-gegl-loops.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/gimp-gegl-loops/" #function, function);
+
+/*  the size of the brush used for benchmarking  */
+#define BENCHMARK_SIZE        512
+#define BENCHMARK_ITERATIONS  10
+
+
+static guchar *
+gimp_test_gegl_loops_new_pixels (gint n_bytes)
+{
+  guchar *pixels = g_new (guchar, n_bytes);
+  gint    i;
+
+  for (i = 0; i < n_bytes; i++)
+    pixels[i] = g_test_rand_int_range (0, 256);
+
+  return pixels;
+}
+
+static GeglBuffer *
+gimp_test_gegl_loops_new_buffer (gint     width,
+                                 gint     height,
+                                 gboolean linear)
+{
+  const Babl *format = babl_format ("R'G'B'A u8");
+  guchar     *pixels = gimp_test_gegl_loops_new_pixels (width * height * 4);
+  GeglBuffer *buffer;
+
+  if (linear)
+    {
+      buffer = gegl_buffer_linear_new_from_data (pixels, format,
+                                                 GEGL_RECTANGLE (0, 0,
+                                                                 width, height),
+                                                 GEGL_AUTO_ROWSTRIDE,
+                                                 (GDestroyNotify) g_free,
+                                                 pixels);
+    }
+  else
+    {
+      buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height), format);
+
+      gegl_buffer_set (buffer, NULL, 0, format, pixels, GEGL_AUTO_ROWSTRIDE);
+      g_free (pixels);
+    }
+
+  return buffer;
+}
+
+/**
+ * convolve_row_matches_scalar:
+ *
+ * The optimized convolve row loops must match the scalar code.
+ **/
+static void
+convolve_row_matches_scalar (void)
+{
+#ifdef GIMP_GEGL_LOOPS_SSE2
+  gdouble src[37];
+  gdouble expected[37];
+  gdouble actual[37];
+  gint    i;
+
+  if (! (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2))
+    return;
+
+  for (i = 0; i < 37; i++)
+    {
+      src[i]      = g_test_rand_int_range (0, 256 * 256);
+      expected[i] = actual[i] = g_test_rand_int_range (0, 256);
+    }
+
+  gimp_gegl_convolve_row_scalar (expected, src, -0.125, 37);
+  gimp_gegl_convolve_row_sse2   (actual,   src, -0.125, 37);
+
+  for (i = 0; i < 37; i++)
+    g_assert_cmpfloat (ABS (expected[i] - actual[i]), <, 1e-9);
+#endif
+}
+
+/**
+ * smudge_blend_matches_scalar:
+ *
+ * The optimized smudge blend loops must produce exactly the same
+ * pixels as the scalar code, for all blend factors.
+ **/
+static void
+smudge_blend_matches_scalar (void)
+{
+#ifdef GIMP_GEGL_LOOPS_SSE2
+  guchar *top;
+  guchar *bottom;
+  guchar  expected[37 * 4];
+  guchar  actual[37 * 4];
+  gint    blend;
+
+  if (! (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2))
+    return;
+
+  top    = gimp_test_gegl_loops_new_pixels (37 * 4);
+  bottom = gimp_test_gegl_loops_new_pixels (37 * 4);
+
+  /*  include the transparent pixels, which blend to 0  */
+  top[3] = bottom[3] = 0;
+
+  for (blend = 0; blend < 256; blend++)
+    {
+      gimp_gegl_smudge_blend_loop_scalar (top, bottom, expected, 37, blend);
+      gimp_gegl_smudge_blend_loop_sse2   (top, bottom, actual,   37, blend);
+
+      g_assert (memcmp (expected, actual, 37 * 4) == 0);
+    }
+
+  g_free (top);
+  g_free (bottom);
+#endif
+}
+
+/**
+ * convolve_across_tiles:
+ *
+ * gimp_gegl_convolve() must give the same result for a tiled source
+ * as for a linear one.
+ **/
+static void
+convolve_across_tiles (void)
+{
+  static const gfloat  kernel[9] = { 1, 2, 1,
+                                     2, 4, 2,
+                                     1, 2, 1 };
+  const GeglRectangle  rect      = { 0, 0, 300, 200 };
+  GeglBuffer          *tiled     = gimp_test_gegl_loops_new_buffer (300, 200,
+                                                                    FALSE);
+  GeglBuffer          *linear    = gimp_test_gegl_loops_new_buffer (300, 200,
+                                                                    TRUE);
+  GeglBuffer          *expected  = gegl_buffer_new (&rect,
+                                                    babl_format ("R'G'B'A u8"));
+  GeglBuffer          *actual    = gegl_buffer_new (&rect,
+                                                    babl_format ("R'G'B'A u8"));
+  guchar              *expected_pixels;
+  guchar              *actual_pixels;
+  gsize                size      = rect.width * rect.height * 4;
+
+  gegl_buffer_copy (tiled, NULL, linear, NULL);
+
+  gimp_gegl_convolve (linear, &rect, expected, &rect,
+                      kernel, 3, 16, GIMP_NORMAL_CONVOL, TRUE);
+  gimp_gegl_convolve (tiled,  &rect, actual,   &rect,
+                      kernel, 3, 16, GIMP_NORMAL_CONVOL, TRUE);
+
+  expected_pixels = g_new (guchar, size);
+  actual_pixels   = g_new (guchar, size);
+
+  gegl_buffer_get (expected, NULL, 1.0, babl_format ("R'G'B'A u8"),
+                   expected_pixels, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (actual, NULL, 1.0, babl_format ("R'G'B'A u8"),
+                   actual_pixels, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_assert (memcmp (expected_pixels, actual_pixels, size) == 0);
+
+  g_free (expected_pixels);
+  g_free (actual_pixels);
+
+  g_object_unref (tiled);
+  g_object_unref (linear);
+  g_object_unref (expected);
+  g_object_unref (actual);
+}
+
+/**
+ * gaussian_blur_keeps_mass:
+ *
+ * gimp_gegl_gaussian_blur() must spread a block's mass symmetrically
+ * without losing any of it, when the block is far enough from the
+ * edges.
+ **/
+static void
+gaussian_blur_keeps_mass (void)
+{
+  const GeglRectangle  rect   = { 0, 0, 201, 151 };
+  GeglBuffer          *buffer = gegl_buffer_new (&rect,
+                                                 babl_format ("Y float"));
+  GeglColor           *white  = gegl_color_new ("#fff");
+  gfloat              *pixels;
+  gdouble              sum    = 0.0;
+  gint                 x, y;
+
+  gegl_buffer_set_color (buffer, GEGL_RECTANGLE (90, 65, 21, 21), white);
+  g_object_unref (white);
+
+  gimp_gegl_gaussian_blur (buffer, &rect, 8.0, 5.0);
+
+  pixels = g_new (gfloat, rect.width * rect.height);
+
+  gegl_buffer_get (buffer, NULL, 1.0, babl_format ("Y float"),
+                   pixels, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  for (y = 0; y < rect.height; y++)
+    for (x = 0; x < rect.width; x++)
+      {
+        gfloat value  = pixels[y * rect.width + x];
+        gfloat mirror = pixels[(rect.height - 1 - y) * rect.width +
+                               rect.width - 1 - x];
+
+        g_assert_cmpfloat (ABS (value - mirror), <, 1e-5);
+
+        sum += value;
+      }
+
+  g_assert_cmpfloat (ABS (sum - 21 * 21), <, 0.01 * 21 * 21);
+
+  g_free (pixels);
+  g_object_unref (buffer);
+}
+
+/**
+ * loops_benchmark:
+ *
+ * Times the Blur/Sharpen, Dodge/Burn and Smudge loops on a large
+ * brush, and a selection feather, only run with -m perf.
+ **/
+static void
+loops_benchmark (void)
+{
+  static const gfloat  kernel[25] = { 1, 1, 1, 1, 1,
+                                      1, 2, 2, 2, 1,
+                                      1, 2, 4, 2, 1,
+                                      1, 2, 2, 2, 1,
+                                      1, 1, 1, 1, 1 };
+  const GeglRectangle  rect       = { 0, 0, BENCHMARK_SIZE, BENCHMARK_SIZE };
+  GeglBuffer          *top;
+  GeglBuffer          *bottom;
+  GeglBuffer          *dest;
+  GeglBuffer          *float_dest;
+  GeglBuffer          *mask;
+  gdouble              time;
+  gint                 i;
+
+  if (! g_test_perf ())
+    return;
+
+  top        = gimp_test_gegl_loops_new_buffer (BENCHMARK_SIZE,
+                                                BENCHMARK_SIZE, TRUE);
+  bottom     = gimp_test_gegl_loops_new_buffer (BENCHMARK_SIZE,
+                                                BENCHMARK_SIZE, FALSE);
+  dest       = gegl_buffer_new (&rect, babl_format ("R'G'B'A u8"));
+  float_dest = gegl_buffer_new (&rect, babl_format ("R'G'B'A float"));
+
+  g_test_timer_start ();
+  for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+    gimp_gegl_convolve (top, &rect, dest, &rect,
+                        kernel, 5, 36, GIMP_NORMAL_CONVOL, TRUE);
+  time = g_test_timer_elapsed ();
+
+  g_test_minimized_result (time / BENCHMARK_ITERATIONS,
+                           "convolve %dx%d, 5x5 kernel: %.3f ms",
+                           BENCHMARK_SIZE, BENCHMARK_SIZE,
+                           1000.0 * time / BENCHMARK_ITERATIONS);
+
+  g_test_timer_start ();
+  for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+    gimp_gegl_dodgeburn (bottom, &rect, float_dest, &rect,
+                         0.5, GIMP_DODGE, GIMP_MIDTONES);
+  time = g_test_timer_elapsed ();
+
+  g_test_minimized_result (time / BENCHMARK_ITERATIONS,
+                           "dodgeburn %dx%d, midtones: %.3f ms",
+                           BENCHMARK_SIZE, BENCHMARK_SIZE,
+                           1000.0 * time / BENCHMARK_ITERATIONS);
+
+  g_test_timer_start ();
+  for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+    gimp_gegl_smudge_blend (top, &rect, bottom, &rect, dest, &rect,
+                            NULL, NULL, 128);
+  time = g_test_timer_elapsed ();
+
+  g_test_minimized_result (time / BENCHMARK_ITERATIONS,
+                           "smudge blend %dx%d: %.3f ms",
+                           BENCHMARK_SIZE, BENCHMARK_SIZE,
+                           1000.0 * time / BENCHMARK_ITERATIONS);
+
+  mask = gegl_buffer_new (&rect, babl_format ("Y float"));
+  gegl_buffer_copy (top, NULL, mask, NULL);
+
+  g_test_timer_start ();
+  for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+    gimp_gegl_gaussian_blur (mask, &rect, 100 / 3.5, 100 / 3.5);
+  time = g_test_timer_elapsed ();
+
+  g_test_minimized_result (time / BENCHMARK_ITERATIONS,
+                           "gaussian blur %dx%d, 100 px feather: %.3f ms",
+                           BENCHMARK_SIZE, BENCHMARK_SIZE,
+                           1000.0 * time / BENCHMARK_ITERATIONS);
+
+  g_object_unref (top);
+  g_object_unref (bottom);
+  g_object_unref (dest);
+  g_object_unref (float_dest);
+  g_object_unref (mask);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  gegl_init (&argc, &argv);
+  gimp_babl_init ();
+
+  ADD_TEST (convolve_row_matches_scalar);
+  ADD_TEST (smudge_blend_matches_scalar);
+  ADD_TEST (convolve_across_tiles);
+  ADD_TEST (gaussian_blur_keeps_mass);
+  ADD_TEST (loops_benchmark);
+
+  return g_test_run ();
+}
@@ -0,0 +1,216 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "operations/operations-types.h"
+
+#include "operations/gimpoperationpointlayermode-loops.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/gimp-layer-modes/" #function, function);
+
+/*  the number of pixels used for testing and benchmarking  */
+#define TEST_PIXELS           (1 << 14)
+#define BENCHMARK_PIXELS      (1 << 20)
+#define BENCHMARK_ITERATIONS  20
+
+/*  float rounding differs a bit from the double math of the scalar code  */
+#define EPSILON               1e-5
+
+
+static const GimpLayerModeEffects modes[] =
+{
+  GIMP_NORMAL_MODE,
+  GIMP_MULTIPLY_MODE,
+  GIMP_SCREEN_MODE,
+  GIMP_DIFFERENCE_MODE,
+  GIMP_ADDITION_MODE,
+  GIMP_SUBTRACT_MODE,
+  GIMP_DARKEN_ONLY_MODE,
+  GIMP_LIGHTEN_ONLY_MODE
+};
+
+
+/*  random RGBA pixels, with plenty of fully transparent and opaque ones  */
+static gfloat *
+gimp_test_layer_modes_new_pixels (gint n_pixels,
+                                  gint n_components)
+{
+  gfloat *pixels = g_new (gfloat, n_pixels * n_components);
+  gint    i;
+
+  for (i = 0; i < n_pixels * n_components; i++)
+    {
+      switch (g_test_rand_int_range (0, 8))
+        {
+        case 0:  pixels[i] = 0.0; break;
+        case 1:  pixels[i] = 1.0; break;
+        default: pixels[i] = g_test_rand_double_range (0.0, 1.0); break;
+        }
+    }
+
+  return pixels;
+}
+
+static const gchar *
+gimp_test_layer_modes_get_name (GimpLayerModeEffects mode)
+{
+  const gchar *name = NULL;
+
+  gimp_enum_get_value (GIMP_TYPE_LAYER_MODE_EFFECTS, mode,
+                       NULL, NULL, &name, NULL);
+
+  return name;
+}
+
+/**
+ * loops_match_scalar:
+ *
+ * The optimized layer mode loops must produce the same pixels as the
+ * scalar code, with and without a mask.
+ **/
+static void
+loops_match_scalar (void)
+{
+#ifdef GIMP_LAYER_MODE_LOOPS_SSE2
+  gfloat *in;
+  gfloat *layer;
+  gfloat *mask;
+  gfloat *expected;
+  gfloat *actual;
+  gint    n;
+
+  if (! (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2))
+    return;
+
+  in       = gimp_test_layer_modes_new_pixels (TEST_PIXELS, 4);
+  layer    = gimp_test_layer_modes_new_pixels (TEST_PIXELS, 4);
+  mask     = gimp_test_layer_modes_new_pixels (TEST_PIXELS, 1);
+  expected = g_new (gfloat, TEST_PIXELS * 4);
+  actual   = g_new (gfloat, TEST_PIXELS * 4);
+
+  for (n = 0; n < G_N_ELEMENTS (modes); n++)
+    {
+      GimpLayerModeLoopFunc scalar;
+      GimpLayerModeLoopFunc sse2;
+      gint                  m;
+
+      scalar = gimp_operation_point_layer_mode_loop_scalar (modes[n]);
+      sse2   = gimp_operation_point_layer_mode_loop_sse2   (modes[n]);
+
+      g_assert (scalar != NULL);
+      g_assert (sse2   != NULL);
+
+      for (m = 0; m < 2; m++)
+        {
+          gint i;
+
+          scalar (in, layer, m ? mask : NULL, expected, TEST_PIXELS, 0.7);
+          sse2   (in, layer, m ? mask : NULL, actual,   TEST_PIXELS, 0.7);
+
+          for (i = 0; i < TEST_PIXELS * 4; i++)
+            g_assert_cmpfloat (ABS (expected[i] - actual[i]), <, EPSILON);
+        }
+    }
+
+  g_free (in);
+  g_free (layer);
+  g_free (mask);
+  g_free (expected);
+  g_free (actual);
+#endif
+}
+
+/**
+ * loops_benchmark:
+ *
+ * Reports the megapixels per second of the scalar and the dispatched
+ * loop of each mode, only run with -m perf.
+ **/
+static void
+loops_benchmark (void)
+{
+  gfloat *in;
+  gfloat *layer;
+  gfloat *mask;
+  gfloat *out;
+  gint    n;
+
+  if (! g_test_perf ())
+    return;
+
+  in    = gimp_test_layer_modes_new_pixels (BENCHMARK_PIXELS, 4);
+  layer = gimp_test_layer_modes_new_pixels (BENCHMARK_PIXELS, 4);
+  mask  = gimp_test_layer_modes_new_pixels (BENCHMARK_PIXELS, 1);
+  out   = g_new (gfloat, BENCHMARK_PIXELS * 4);
+
+  for (n = 0; n < G_N_ELEMENTS (modes); n++)
+    {
+      GimpLayerModeLoopFunc scalar;
+      gdouble               scalar_time;
+      gdouble               time;
+      gint                  i;
+
+      scalar = gimp_operation_point_layer_mode_loop_scalar (modes[n]);
+
+      g_test_timer_start ();
+      for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        scalar (in, layer, mask, out, BENCHMARK_PIXELS, 0.7);
+      scalar_time = g_test_timer_elapsed ();
+
+      g_test_timer_start ();
+      for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        gimp_operation_point_layer_mode_loop (modes[n],
+                                              in, layer, mask, out,
+                                              BENCHMARK_PIXELS, 0.7);
+      time = g_test_timer_elapsed ();
+
+      g_test_maximized_result (BENCHMARK_PIXELS * BENCHMARK_ITERATIONS /
+                               MAX (time, 1e-9) / 1e6,
+                               "%s: %.1f MP/s (scalar %.1f MP/s, %.1fx)",
+                               gimp_test_layer_modes_get_name (modes[n]),
+                               BENCHMARK_PIXELS * BENCHMARK_ITERATIONS /
+                               MAX (time, 1e-9) / 1e6,
+                               BENCHMARK_PIXELS * BENCHMARK_ITERATIONS /
+                               MAX (scalar_time, 1e-9) / 1e6,
+                               scalar_time / MAX (time, 1e-9));
+    }
+
+  g_free (in);
+  g_free (layer);
+  g_free (mask);
+  g_free (out);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (loops_match_scalar);
+  ADD_TEST (loops_benchmark);
+
+  return g_test_run ();
+}
@@ -0,0 +1,222 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "base/base-types.h"
+
+#include "base/tile.h"
+#include "base/tile-cache.h"
+#include "base/tile-manager.h"
+#include "base/tile-pyramid.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/gimp-tiles/" #function, function);
+
+
+static guchar
+gimp_test_tiles_rand_byte (void)
+{
+  /*  favour the extremes so that the special alpha cases are hit
+   *  often enough
+   */
+  switch (g_test_rand_int_range (0, 4))
+    {
+    case 0:  return 0;
+    case 1:  return 255;
+    default: return g_test_rand_int_range (0, 256);
+    }
+}
+
+/**
+ * reduce_row_matches_scalar:
+ *
+ * Make sure the SSE2 version of the pyramid row kernel gives the same
+ * results as the scalar one, for all pixel sizes, with and without
+ * pre-multiplication, and for odd row lengths.
+ **/
+static void
+reduce_row_matches_scalar (void)
+{
+#ifdef TILE_PYRAMID_SSE2
+  guchar src0[2 * TILE_WIDTH * 4];
+  guchar src1[2 * TILE_WIDTH * 4];
+  guchar expected[TILE_WIDTH * 4];
+  guchar actual[TILE_WIDTH * 4];
+  gint   n;
+
+  if (! (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2))
+    return;
+
+  for (n = 0; n < 1000; n++)
+    {
+      gint     bpp         = g_test_rand_int_range (1, 5);
+      gint     n_pixels    = g_test_rand_int_range (0, TILE_WIDTH + 1);
+      gboolean premultiply = g_test_rand_bit ();
+      gint     i;
+
+      for (i = 0; i < G_N_ELEMENTS (src0); i++)
+        {
+          src0[i] = gimp_test_tiles_rand_byte ();
+          src1[i] = gimp_test_tiles_rand_byte ();
+        }
+
+      memset (expected, 0, sizeof (expected));
+      memset (actual,   0, sizeof (actual));
+
+      tile_pyramid_reduce_row_scalar (src0, src1, expected,
+                                      n_pixels, bpp, premultiply);
+      tile_pyramid_reduce_row_sse2   (src0, src1, actual,
+                                      n_pixels, bpp, premultiply);
+
+      g_assert (memcmp (expected, actual, sizeof (expected)) == 0);
+    }
+#endif
+}
+
+/**
+ * uniform_tiles:
+ *
+ * Make sure single-coloured tiles are detected when they are evicted
+ * from the tile cache, come back with the right contents and stop
+ * being uniform when they are written to.
+ **/
+static void
+uniform_tiles (void)
+{
+  const guchar  magenta[4] = { 255, 0, 255, 255 };
+  TileManager  *tm;
+  Tile         *tile;
+  guchar        pixel[4];
+  gint          i;
+
+  /*  a 36x36 edge tile on the bottom right  */
+  tm = tile_manager_new (100, 100, 4);
+
+  tile = tile_manager_get_at (tm, 1, 1, TRUE, TRUE);
+
+  for (i = 0; i < tile_size (tile); i += 4)
+    memcpy ((guchar *) tile_data_pointer (tile, 0, 0) + i, magenta, 4);
+
+  tile_release (tile, TRUE);
+
+  g_assert_cmpint (tile_manager_evict (tm), >, 0);
+
+  tile = tile_manager_get_at (tm, 1, 1, TRUE, FALSE);
+  g_assert (tile_is_uniform (tile, pixel));
+  g_assert (memcmp (pixel, magenta, 4) == 0);
+  g_assert (memcmp (tile_data_pointer (tile, 35, 35), magenta, 4) == 0);
+  tile_release (tile, FALSE);
+
+  tile = tile_manager_get_at (tm, 1, 1, TRUE, TRUE);
+  g_assert (! tile_is_uniform (tile, NULL));
+  ((guchar *) tile_data_pointer (tile, 0, 0))[0] = 0;
+  tile_release (tile, TRUE);
+
+  tile_manager_evict (tm);
+
+  tile = tile_manager_get_at (tm, 1, 1, TRUE, FALSE);
+  g_assert (! tile_is_uniform (tile, NULL));
+  g_assert (memcmp (tile_data_pointer (tile, 35, 35), magenta, 4) == 0);
+  tile_release (tile, FALSE);
+
+  tile_manager_unref (tm);
+}
+
+static TileManager *
+gimp_test_tiles_new_halves (void)
+{
+  TileManager *tm   = tile_manager_new (TILE_WIDTH, TILE_HEIGHT, 1);
+  Tile        *tile = tile_manager_get_at (tm, 0, 0, TRUE, TRUE);
+  guchar      *data = tile_data_pointer (tile, 0, 0);
+
+  /*  not uniform, but compresses well  */
+  memset (data, 0, tile_size (tile) / 2);
+  memset (data + tile_size (tile) / 2, 255, tile_size (tile) / 2);
+
+  tile_release (tile, TRUE);
+
+  return tm;
+}
+
+/**
+ * dedup_tiles:
+ *
+ * Make sure tiles with equal contents share their compressed data,
+ * and that writing to one of them doesn't change the other.
+ **/
+static void
+dedup_tiles (void)
+{
+  TileManager *tm1;
+  TileManager *tm2;
+  Tile        *tile;
+  guint64      saved;
+  gulong       n_shared;
+
+  tile_cache_set_deduplication (TRUE);
+
+  tm1 = gimp_test_tiles_new_halves ();
+  tm2 = gimp_test_tiles_new_halves ();
+
+  g_assert_cmpint (tile_manager_evict (tm1), >, 0);
+  g_assert_cmpint (tile_manager_evict (tm2), >, 0);
+
+  tile_cache_get_dedup_stats (&saved, &n_shared);
+  g_assert_cmpuint (saved, >, 0);
+  g_assert_cmpuint (n_shared, ==, 1);
+
+  tile = tile_manager_get_at (tm2, 0, 0, TRUE, TRUE);
+  ((guchar *) tile_data_pointer (tile, 0, 0))[0] = 255;
+  tile_release (tile, TRUE);
+
+  tile_cache_get_dedup_stats (&saved, &n_shared);
+  g_assert_cmpuint (saved, ==, 0);
+  g_assert_cmpuint (n_shared, ==, 0);
+
+  tile = tile_manager_get_at (tm1, 0, 0, TRUE, FALSE);
+  g_assert_cmpint (*(guchar *) tile_data_pointer (tile, 0, 0), ==, 0);
+  g_assert_cmpint (*(guchar *) tile_data_pointer (tile, 63, 63), ==, 255);
+  tile_release (tile, FALSE);
+
+  tile_manager_unref (tm1);
+  tile_manager_unref (tm2);
+
+  tile_cache_set_deduplication (FALSE);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_type_init ();
+  tile_cache_init (G_MAXUINT32);
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (reduce_row_matches_scalar);
+  ADD_TEST (uniform_tiles);
+  ADD_TEST (dedup_tiles);
+
+  return g_test_run ();
+}
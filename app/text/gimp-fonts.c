@@ -20,7 +20,11 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <glib-object.h>
+#include <glib/gstdio.h>
+#include <pango/pango.h>
 
 #include <fontconfig/fontconfig.h>
 
@@ -32,18 +36,60 @@
 #include "config/gimpcoreconfig.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
+#include "core/gimplist.h"
 
 #include "gimp-fonts.h"
 #include "gimpfontlist.h"
 
 
-#define CONF_FNAME "fonts.conf"
+#define CONF_FNAME  "fonts.conf"
+#define CACHE_FNAME "fontcache"
+
+#define LOAD_KEY    "gimp-fonts-load"
+
+/*  the number of fonts added to the list per idle callback  */
+#define N_FONTS_PER_IDLE 256
+
+/*  fontconfig is thread-safe since version 2.11  */
+#define FC_THREADSAFE_VERSION 21100
+
+
+typedef struct
+{
+  Gimp             *gimp;
+  FcConfig         *config;
+  gchar            *stamp;
+  gboolean          restored;  /* the font list was restored from the cache  */
+
+  gboolean          threaded;
+  GimpParallelTask *task;
+  gboolean          success;
+  guint             idle_id;
+
+  GPtrArray        *names;
+  guint             n_added;
+} GimpFontsLoad;
 
 
-static gboolean gimp_fonts_load_fonts_conf (FcConfig    *config,
-                                            gchar       *fonts_conf);
-static void     gimp_fonts_add_directories (FcConfig    *config,
-                                            const gchar *path_str);
+static gboolean gimp_fonts_load_fonts_conf (FcConfig      *config,
+                                            gchar         *fonts_conf);
+static void     gimp_fonts_add_directories (FcConfig      *config,
+                                            const gchar   *path_str);
+
+static gchar  * gimp_fonts_get_stamp       (FcConfig      *config,
+                                            const gchar   *path_str);
+static void     gimp_fonts_update_stamp    (GChecksum     *checksum,
+                                            const gchar   *filename);
+static gboolean gimp_fonts_cache_restore   (GimpFontsLoad *load);
+static void     gimp_fonts_cache_save      (GimpFontsLoad *load);
+
+static void     gimp_fonts_load_func       (GimpParallelTask *task,
+                                            GimpFontsLoad    *load);
+static gboolean gimp_fonts_load_idle       (GimpFontsLoad *load);
+static gboolean gimp_fonts_load_step       (GimpFontsLoad *load,
+                                            gint           n_fonts);
+static void     gimp_fonts_load_finish     (GimpFontsLoad *load);
 
 
 void
@@ -58,15 +104,28 @@ gimp_fonts_init (Gimp *gimp)
                             G_CALLBACK (gimp_fonts_load), gimp);
 }
 
+/**
+ * gimp_fonts_load:
+ * @gimp: a #Gimp instance
+ *
+ * Starts (re)loading the font list. Fontconfig scans the font
+ * directories on the core worker pool and the fonts are added to
+ * gimp->fonts from idle callbacks. If the font setup did not change
+ * since the last time, the list is restored from a cache right away.
+ * Use gimp_fonts_wait() before rendering any text.
+ **/
 void
 gimp_fonts_load (Gimp *gimp)
 {
-  FcConfig *config;
-  gchar    *fonts_conf;
-  gchar    *path;
+  GimpFontsLoad *load;
+  FcConfig      *config;
+  gchar         *fonts_conf;
+  gchar         *path;
 
   g_return_if_fail (GIMP_IS_FONT_LIST (gimp->fonts));
 
+  gimp_fonts_wait (gimp);
+
   gimp_set_busy (gimp);
 
   if (gimp->be_verbose)
@@ -91,23 +150,79 @@ gimp_fonts_load (Gimp *gimp)
 
   path = gimp_config_path_expand (gimp->config->font_path, TRUE, NULL);
   gimp_fonts_add_directories (config, path);
+
+  load = g_slice_new0 (GimpFontsLoad);
+
+  load->gimp   = gimp;
+  load->config = config;
+  load->stamp  = gimp_fonts_get_stamp (config, path);
+
   g_free (path);
 
-  if (! FcConfigBuildFonts (config))
-    {
-      FcConfigDestroy (config);
-      goto cleanup;
-    }
+  g_object_set_data (G_OBJECT (gimp->fonts), LOAD_KEY, load);
 
-  FcConfigSetCurrent (config);
+  load->restored = gimp_fonts_cache_restore (load);
 
-  gimp_font_list_restore (GIMP_FONT_LIST (gimp->fonts));
+  load->threaded = (FcGetVersion () >= FC_THREADSAFE_VERSION);
+
+  if (load->threaded)
+    {
+      load->task =
+        gimp_parallel_run_async (GIMP_PARALLEL_PRIORITY_BACKGROUND,
+                                 NULL, NULL,
+                                 (GimpParallelRunFunc) gimp_fonts_load_func,
+                                 NULL, load);
+    }
+  else
+    {
+      gimp_fonts_load_func (NULL, load);
+      gimp_fonts_wait (gimp);
+    }
 
  cleanup:
   gimp_container_thaw (GIMP_CONTAINER (gimp->fonts));
   gimp_unset_busy (gimp);
 }
 
+/**
+ * gimp_fonts_wait:
+ * @gimp: a #Gimp instance
+ *
+ * Blocks until a font list load started by gimp_fonts_load() has
+ * completed. After this call, the font list is complete and
+ * fontconfig uses GIMP's font configuration.
+ **/
+void
+gimp_fonts_wait (Gimp *gimp)
+{
+  GimpFontsLoad *load;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  if (! gimp->fonts)
+    return;
+
+  load = g_object_get_data (G_OBJECT (gimp->fonts), LOAD_KEY);
+
+  if (! load)
+    return;
+
+  if (load->task)
+    {
+      gimp_parallel_task_wait (load->task);
+      gimp_parallel_task_unref (load->task);
+      load->task = NULL;
+    }
+
+  if (load->idle_id)
+    {
+      g_source_remove (load->idle_id);
+      load->idle_id = 0;
+    }
+
+  gimp_fonts_load_finish (load);
+}
+
 void
 gimp_fonts_reset (Gimp *gimp)
 {
@@ -116,6 +231,8 @@ gimp_fonts_reset (Gimp *gimp)
   if (gimp->no_fonts)
     return;
 
+  gimp_fonts_wait (gimp);
+
   /* We clear the default config here, so any subsequent fontconfig use will
    * reinit the library with defaults. (Maybe we should call FcFini here too?)
    */
@@ -156,3 +273,229 @@ gimp_fonts_add_directories (FcConfig    *config,
 
   gimp_path_free (path);
 }
+
+static gchar *
+gimp_fonts_get_stamp (FcConfig    *config,
+                      const gchar *path_str)
+{
+  GChecksum *checksum = g_checksum_new (G_CHECKSUM_MD5);
+  FcStrList *list;
+  FcChar8   *file;
+  GList     *path;
+  GList     *iter;
+  gchar     *stamp;
+
+  /*  fontconfig considers its configuration up to date as long as
+   *  none of its config files and font directories changed, do the
+   *  same for the list of font names
+   */
+  list = FcConfigGetConfigFiles (config);
+  while ((file = FcStrListNext (list)))
+    gimp_fonts_update_stamp (checksum, (const gchar *) file);
+  FcStrListDone (list);
+
+  list = FcConfigGetFontDirs (config);
+  while ((file = FcStrListNext (list)))
+    gimp_fonts_update_stamp (checksum, (const gchar *) file);
+  FcStrListDone (list);
+
+  path = gimp_path_parse (path_str, 256, TRUE, NULL);
+  for (iter = path; iter; iter = g_list_next (iter))
+    gimp_fonts_update_stamp (checksum, iter->data);
+  gimp_path_free (path);
+
+  stamp = g_strdup_printf ("%d %s",
+                           FcGetVersion (), g_checksum_get_string (checksum));
+
+  g_checksum_free (checksum);
+
+  return stamp;
+}
+
+static void
+gimp_fonts_update_stamp (GChecksum   *checksum,
+                         const gchar *filename)
+{
+  GStatBuf  st;
+  gchar    *line;
+
+  if (g_stat (filename, &st) != 0)
+    st.st_mtime = 0;
+
+  line = g_strdup_printf ("%s %" G_GINT64_FORMAT "\n",
+                          filename, (gint64) st.st_mtime);
+  g_checksum_update (checksum, (const guchar *) line, -1);
+  g_free (line);
+}
+
+static gboolean
+gimp_fonts_cache_restore (GimpFontsLoad *load)
+{
+  gchar     *filename;
+  gchar     *contents;
+  gchar    **lines;
+  gboolean   success = FALSE;
+
+  filename = gimp_personal_rc_file (CACHE_FNAME);
+
+  if (g_file_get_contents (filename, &contents, NULL, NULL))
+    {
+      lines = g_strsplit (contents, "\n", -1);
+
+      if (lines[0] && ! strcmp (lines[0], load->stamp))
+        {
+          GimpFontList *fonts = GIMP_FONT_LIST (load->gimp->fonts);
+          gint          n_names;
+
+          /*  drop the empty string after the final newline  */
+          n_names = g_strv_length (lines) - 1;
+          if (n_names > 0 && ! *lines[n_names])
+            n_names--;
+
+          gimp_font_list_add_names (fonts, (const gchar **) lines + 1, n_names);
+          gimp_list_sort_by_name (GIMP_LIST (fonts));
+
+          success = TRUE;
+        }
+
+      g_strfreev (lines);
+      g_free (contents);
+    }
+
+  g_free (filename);
+
+  return success;
+}
+
+static void
+gimp_fonts_cache_save (GimpFontsLoad *load)
+{
+  GString *buf;
+  gchar   *filename;
+  GList   *list;
+  GError  *error = NULL;
+
+  buf = g_string_new (load->stamp);
+  g_string_append_c (buf, '\n');
+
+  for (list = GIMP_LIST (load->gimp->fonts)->list;
+       list;
+       list = g_list_next (list))
+    {
+      g_string_append (buf, gimp_object_get_name (list->data));
+      g_string_append_c (buf, '\n');
+    }
+
+  filename = gimp_personal_rc_file (CACHE_FNAME);
+
+  if (! g_file_set_contents (filename, buf->str, buf->len, &error))
+    {
+      g_printerr ("Error while saving font cache: %s\n", error->message);
+      g_clear_error (&error);
+    }
+
+  g_free (filename);
+  g_string_free (buf, TRUE);
+}
+
+static void
+gimp_fonts_load_func (GimpParallelTask *task,
+                      GimpFontsLoad    *load)
+{
+  /*  this is the expensive part, fontconfig scans all font files
+   *  that are not in its own caches yet
+   */
+  load->success = FcConfigBuildFonts (load->config);
+
+  if (load->threaded)
+    load->idle_id = g_idle_add ((GSourceFunc) gimp_fonts_load_idle, load);
+}
+
+static gboolean
+gimp_fonts_load_idle (GimpFontsLoad *load)
+{
+  if (load->task)
+    {
+      gimp_parallel_task_wait (load->task);
+      gimp_parallel_task_unref (load->task);
+      load->task = NULL;
+    }
+
+  if (gimp_fonts_load_step (load, N_FONTS_PER_IDLE))
+    return TRUE;
+
+  load->idle_id = 0;
+
+  gimp_fonts_load_finish (load);
+
+  return FALSE;
+}
+
+/*  returns TRUE if there are more fonts to add  */
+static gboolean
+gimp_fonts_load_step (GimpFontsLoad *load,
+                      gint           n_fonts)
+{
+  GimpFontList *fonts = GIMP_FONT_LIST (load->gimp->fonts);
+
+  if (! load->success)
+    return FALSE;
+
+  if (load->config)
+    {
+      FcConfigSetCurrent (load->config);
+      load->config = NULL;
+
+      gimp_font_list_update_context (fonts);
+
+      if (! load->restored)
+        load->names = gimp_font_list_get_names ();
+    }
+
+  if (! load->names)
+    return FALSE;
+
+  n_fonts = MIN (n_fonts, load->names->len - load->n_added);
+
+  gimp_font_list_add_names (fonts,
+                            (const gchar **) load->names->pdata + load->n_added,
+                            n_fonts);
+
+  load->n_added += n_fonts;
+
+  return load->n_added < load->names->len;
+}
+
+static void
+gimp_fonts_load_finish (GimpFontsLoad *load)
+{
+  GimpContainer *fonts = load->gimp->fonts;
+
+  gimp_container_freeze (fonts);
+
+  if (load->success)
+    {
+      gimp_fonts_load_step (load, G_MAXINT);
+
+      if (load->names)
+        {
+          gimp_list_sort_by_name (GIMP_LIST (fonts));
+          gimp_fonts_cache_save (load);
+
+          g_ptr_array_unref (load->names);
+        }
+    }
+  else
+    {
+      FcConfigDestroy (load->config);
+
+      gimp_container_clear (fonts);
+    }
+
+  g_object_set_data (G_OBJECT (fonts), LOAD_KEY, NULL);
+
+  gimp_container_thaw (fonts);
+
+  g_free (load->stamp);
+  g_slice_free (GimpFontsLoad, load);
+}
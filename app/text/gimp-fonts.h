@@ -21,6 +21,7 @@
 
 void   gimp_fonts_init  (Gimp *gimp);
 void   gimp_fonts_load  (Gimp *gimp);
+void   gimp_fonts_wait  (Gimp *gimp);
 void   gimp_fonts_reset (Gimp *gimp);
 
 
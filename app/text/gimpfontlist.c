@@ -46,26 +46,45 @@
 #endif
 
 
-static void   gimp_font_list_add_font   (GimpFontList         *list,
-                                         PangoContext         *context,
+static void   gimp_font_list_finalize   (GObject              *object);
+
+static void   gimp_font_list_add_name   (GPtrArray            *names,
                                          PangoFontDescription *desc);
 
-static void   gimp_font_list_load_names (GimpFontList         *list,
-                                         PangoFontMap         *fontmap,
-                                         PangoContext         *context);
+static void   gimp_font_list_load_names (GPtrArray            *names);
 
 
 G_DEFINE_TYPE (GimpFontList, gimp_font_list, GIMP_TYPE_LIST)
 
+#define parent_class gimp_font_list_parent_class
+
 
 static void
 gimp_font_list_class_init (GimpFontListClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gimp_font_list_finalize;
 }
 
 static void
 gimp_font_list_init (GimpFontList *list)
 {
+  list->pango_context = NULL;
+}
+
+static void
+gimp_font_list_finalize (GObject *object)
+{
+  GimpFontList *list = GIMP_FONT_LIST (object);
+
+  if (list->pango_context)
+    {
+      g_object_unref (list->pango_context);
+      list->pango_context = NULL;
+    }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 GimpContainer *
@@ -88,11 +107,73 @@ gimp_font_list_new (gdouble xresolution,
   return GIMP_CONTAINER (list);
 }
 
+/**
+ * gimp_font_list_get_names:
+ *
+ * Queries the names of all fonts known to the current fontconfig
+ * configuration. This function does not touch any GimpFontList and
+ * may be called from any thread.
+ *
+ * Return value: a #GPtrArray of font names, free it with
+ *               g_ptr_array_unref().
+ **/
+GPtrArray *
+gimp_font_list_get_names (void)
+{
+  GPtrArray *names = g_ptr_array_new_with_free_func (g_free);
+
+  gimp_font_list_load_names (names);
+
+  return names;
+}
+
+/**
+ * gimp_font_list_add_names:
+ * @list:    a #GimpFontList
+ * @names:   font names as returned by gimp_font_list_get_names()
+ * @n_names: the number of @names to add
+ *
+ * Adds a #GimpFont for each of @names. Until
+ * gimp_font_list_update_context() is called, the fonts are added
+ * without a #PangoContext and have no previews.
+ **/
 void
-gimp_font_list_restore (GimpFontList *list)
+gimp_font_list_add_names (GimpFontList  *list,
+                          const gchar  **names,
+                          gint           n_names)
+{
+  gint i;
+
+  g_return_if_fail (GIMP_IS_FONT_LIST (list));
+  g_return_if_fail (names != NULL || n_names == 0);
+
+  for (i = 0; i < n_names; i++)
+    {
+      GimpFont *font;
+
+      font = g_object_new (GIMP_TYPE_FONT,
+                           "name",          names[i],
+                           "pango-context", list->pango_context,
+                           NULL);
+
+      gimp_container_add (GIMP_CONTAINER (list), GIMP_OBJECT (font));
+      g_object_unref (font);
+    }
+}
+
+/**
+ * gimp_font_list_update_context:
+ * @list: a #GimpFontList
+ *
+ * Creates a new #PangoContext for the current fontconfig configuration
+ * and assigns it to all fonts in @list. Call this whenever the
+ * configuration was replaced using FcConfigSetCurrent().
+ **/
+void
+gimp_font_list_update_context (GimpFontList *list)
 {
   PangoFontMap *fontmap;
-  PangoContext *context;
+  GList        *iter;
 
   g_return_if_fail (GIMP_IS_FONT_LIST (list));
 
@@ -103,22 +184,25 @@ gimp_font_list_restore (GimpFontList *list)
 
   pango_cairo_font_map_set_resolution (PANGO_CAIRO_FONT_MAP (fontmap),
                                        list->yresolution);
-  context = pango_font_map_create_context (fontmap);
-  g_object_unref (fontmap);
 
-  gimp_container_freeze (GIMP_CONTAINER (list));
+  if (list->pango_context)
+    g_object_unref (list->pango_context);
 
-  gimp_font_list_load_names (list, PANGO_FONT_MAP (fontmap), context);
-  g_object_unref (context);
+  list->pango_context = pango_font_map_create_context (fontmap);
+  g_object_unref (fontmap);
 
-  gimp_list_sort_by_name (GIMP_LIST (list));
+  for (iter = GIMP_LIST (list)->list; iter; iter = g_list_next (iter))
+    {
+      g_object_set (iter->data,
+                    "pango-context", list->pango_context,
+                    NULL);
 
-  gimp_container_thaw (GIMP_CONTAINER (list));
+      gimp_viewable_invalidate_preview (iter->data);
+    }
 }
 
 static void
-gimp_font_list_add_font (GimpFontList         *list,
-                         PangoContext         *context,
+gimp_font_list_add_name (GPtrArray            *names,
                          PangoFontDescription *desc)
 {
   gchar *name;
@@ -129,19 +213,9 @@ gimp_font_list_add_font (GimpFontList         *list,
   name = pango_font_description_to_string (desc);
 
   if (g_utf8_validate (name, -1, NULL))
-    {
-      GimpFont *font;
-
-      font = g_object_new (GIMP_TYPE_FONT,
-                           "name",          name,
-                           "pango-context", context,
-                           NULL);
-
-      gimp_container_add (GIMP_CONTAINER (list), GIMP_OBJECT (font));
-      g_object_unref (font);
-    }
-
-  g_free (name);
+    g_ptr_array_add (names, name);
+  else
+    g_free (name);
 }
 
 #ifdef USE_FONTCONFIG_DIRECTLY
@@ -151,8 +225,7 @@ gimp_font_list_add_font (GimpFontList         *list,
  * the gimp_font_list_add_font bits.
  */
 static void
-gimp_font_list_make_alias (GimpFontList *list,
-                           PangoContext *context,
+gimp_font_list_make_alias (GPtrArray    *names,
                            const gchar  *family,
                            gboolean      bold,
                            gboolean      italic)
@@ -169,31 +242,28 @@ gimp_font_list_make_alias (GimpFontList *list,
                                      PANGO_WEIGHT_BOLD : PANGO_WEIGHT_NORMAL);
   pango_font_description_set_stretch (desc, PANGO_STRETCH_NORMAL);
 
-  gimp_font_list_add_font (list, context, desc);
+  gimp_font_list_add_name (names, desc);
 
   pango_font_description_free (desc);
 }
 
 static void
-gimp_font_list_load_aliases (GimpFontList *list,
-                             PangoContext *context)
+gimp_font_list_load_aliases (GPtrArray *names)
 {
   const gchar *families[] = { "Sans", "Serif", "Monospace" };
   gint         i;
 
   for (i = 0; i < 3; i++)
     {
-      gimp_font_list_make_alias (list, context, families[i], FALSE, FALSE);
-      gimp_font_list_make_alias (list, context, families[i], TRUE,  FALSE);
-      gimp_font_list_make_alias (list, context, families[i], FALSE, TRUE);
-      gimp_font_list_make_alias (list, context, families[i], TRUE,  TRUE);
+      gimp_font_list_make_alias (names, families[i], FALSE, FALSE);
+      gimp_font_list_make_alias (names, families[i], TRUE,  FALSE);
+      gimp_font_list_make_alias (names, families[i], FALSE, TRUE);
+      gimp_font_list_make_alias (names, families[i], TRUE,  TRUE);
     }
 }
 
 static void
-gimp_font_list_load_names (GimpFontList *list,
-                           PangoFontMap *fontmap,
-                           PangoContext *context)
+gimp_font_list_load_names (GPtrArray *names)
 {
   FcObjectSet *os;
   FcPattern   *pat;
@@ -216,13 +286,13 @@ gimp_font_list_load_names (GimpFontList *list,
       PangoFontDescription *desc;
 
       desc = pango_fc_font_description_from_pattern (fontset->fonts[i], FALSE);
-      gimp_font_list_add_font (list, context, desc);
+      gimp_font_list_add_name (names, desc);
       pango_font_description_free (desc);
     }
 
   /*  only create aliases if there is at least one font available  */
   if (fontset->nfont > 0)
-    gimp_font_list_load_aliases (list, context);
+    gimp_font_list_load_aliases (names);
 
   FcFontSetDestroy (fontset);
 }
@@ -230,16 +300,17 @@ gimp_font_list_load_names (GimpFontList *list,
 #else  /* ! USE_FONTCONFIG_DIRECTLY */
 
 static void
-gimp_font_list_load_names (GimpFontList *list,
-                           PangoFontMap *fontmap,
-                           PangoContext *context)
+gimp_font_list_load_names (GPtrArray *names)
 {
+  PangoFontMap     *fontmap;
   PangoFontFamily **families;
   PangoFontFace   **faces;
   gint              n_families;
   gint              n_faces;
   gint              i, j;
 
+  fontmap = pango_cairo_font_map_new_for_font_type (CAIRO_FONT_TYPE_FT);
+
   pango_font_map_list_families (fontmap, &families, &n_families);
 
   for (i = 0; i < n_families; i++)
@@ -251,12 +322,13 @@ gimp_font_list_load_names (GimpFontList *list,
           PangoFontDescription *desc;
 
           desc = pango_font_face_describe (faces[j]);
-          gimp_font_list_add_font (list, context, desc);
+          gimp_font_list_add_name (names, desc);
           pango_font_description_free (desc);
         }
     }
 
   g_free (families);
+  g_object_unref (fontmap);
 }
 
 #endif /* USE_FONTCONFIG_DIRECTLY */
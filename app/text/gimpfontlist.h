@@ -40,8 +40,10 @@ struct _GimpFontList
 {
   GimpList  parent_instance;
 
-  gdouble   xresolution;
-  gdouble   yresolution;
+  gdouble       xresolution;
+  gdouble       yresolution;
+
+  PangoContext *pango_context;
 };
 
 struct _GimpFontListClass
@@ -50,11 +52,16 @@ struct _GimpFontListClass
 };
 
 
-GType           gimp_font_list_get_type (void) G_GNUC_CONST;
+GType           gimp_font_list_get_type       (void) G_GNUC_CONST;
+
+GimpContainer * gimp_font_list_new            (gdouble        xresolution,
+                                               gdouble        yresolution);
 
-GimpContainer * gimp_font_list_new      (gdouble       xresolution,
-                                         gdouble       yresolution);
-void            gimp_font_list_restore  (GimpFontList *list);
+GPtrArray     * gimp_font_list_get_names      (void);
+void            gimp_font_list_add_names      (GimpFontList  *list,
+                                               const gchar  **names,
+                                               gint           n_names);
+void            gimp_font_list_update_context (GimpFontList  *list);
 
 
 #endif  /*  __GIMP_FONT_LIST_H__  */
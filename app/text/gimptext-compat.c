@@ -37,6 +37,7 @@
 #include "core/gimpimage-undo.h"
 #include "core/gimplayer-floating-sel.h"
 
+#include "gimp-fonts.h"
 #include "gimptext.h"
 #include "gimptext-compat.h"
 #include "gimptextlayer.h"
@@ -133,7 +134,8 @@ text_render (GimpImage    *image,
 }
 
 gboolean
-text_get_extents (const gchar *fontname,
+text_get_extents (Gimp        *gimp,
+                  const gchar *fontname,
                   const gchar *text,
                   gint        *width,
                   gint        *height,
@@ -146,9 +148,12 @@ text_get_extents (const gchar *fontname,
   PangoFontMap         *fontmap;
   PangoRectangle        rect;
 
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), FALSE);
   g_return_val_if_fail (fontname != NULL, FALSE);
   g_return_val_if_fail (text != NULL, FALSE);
 
+  gimp_fonts_wait (gimp);
+
   fontmap = pango_cairo_font_map_new_for_font_type (CAIRO_FONT_TYPE_FT);
   if (! fontmap)
     g_error ("You are using a Pango that has been built against a cairo "
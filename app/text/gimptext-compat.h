@@ -33,7 +33,8 @@ GimpLayer * text_render      (GimpImage    *image,
                               const gchar  *text,
                               gint          border,
                               gboolean      antialias);
-gboolean    text_get_extents (const gchar  *fontname,
+gboolean    text_get_extents (Gimp         *gimp,
+                              const gchar  *fontname,
                               const gchar  *text,
                               gint         *width,
                               gint         *height,
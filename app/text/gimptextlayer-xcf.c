@@ -23,6 +23,8 @@
 #include <gegl.h>
 
 #include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
+
 #include "text-types.h"
 
 #include "core/gimp.h"
@@ -46,8 +48,9 @@ enum
 };
 
 
-static GimpLayer * gimp_text_layer_from_layer (GimpLayer *layer,
-                                               GimpText  *text);
+static GimpLayer * gimp_text_layer_from_layer (GimpLayer     *layer,
+                                               GimpText      *text);
+static gboolean    gimp_text_layer_xcf_stale  (GimpTextLayer *layer);
 
 
 gboolean
@@ -153,6 +156,16 @@ gimp_text_layer_set_xcf_flags (GimpTextLayer *text_layer,
 {
   g_return_if_fail (GIMP_IS_TEXT_LAYER (text_layer));
 
+  /*  the pixels are kept and not rendered again on load, if they
+   *  can't have been rendered from the text, flag the layer as
+   *  modified so editing the text asks before replacing them
+   */
+  if (! (flags & TEXT_LAYER_XCF_MODIFIED) &&
+      gimp_text_layer_xcf_stale (text_layer))
+    {
+      flags |= TEXT_LAYER_XCF_MODIFIED;
+    }
+
   g_object_set (text_layer,
                 "auto-rename", (flags & TEXT_LAYER_XCF_DONT_AUTO_RENAME) == 0,
                 "modified",    (flags & TEXT_LAYER_XCF_MODIFIED)         != 0,
@@ -204,6 +217,9 @@ gimp_text_layer_from_layer (GimpLayer *layer,
   gimp_layer_set_lock_alpha (GIMP_LAYER (text_layer),
                              gimp_layer_get_lock_alpha (layer), FALSE);
 
+  /*  this doesn't render, the pixels loaded from the XCF are kept
+   *  until the text is changed, so loading doesn't lay out any text
+   */
   gimp_text_layer_set_text (text_layer, text);
 
   g_object_unref (text);
@@ -211,3 +227,36 @@ gimp_text_layer_from_layer (GimpLayer *layer,
 
   return GIMP_LAYER (text_layer);
 }
+
+/*  Checks the text loaded from the parasite against the loaded layer,
+ *  without laying out the text.  A fixed text box is always rendered
+ *  to the size of the box, so a layer of another size was changed
+ *  after the text was rendered, even if it wasn't flagged as modified.
+ */
+static gboolean
+gimp_text_layer_xcf_stale (GimpTextLayer *layer)
+{
+  GimpText  *text = layer->text;
+  GimpImage *image;
+  gdouble    xres;
+  gdouble    yres;
+  gint       width;
+  gint       height;
+
+  if (! text || text->box_mode != GIMP_TEXT_BOX_FIXED)
+    return FALSE;
+
+  image = gimp_item_get_image (GIMP_ITEM (layer));
+
+  gimp_image_get_resolution (image, &xres, &yres);
+
+  width  = ceil (gimp_units_to_pixels (text->box_width,  text->box_unit, xres));
+  height = ceil (gimp_units_to_pixels (text->box_height, text->box_unit, yres));
+
+  /*  an empty box renders nothing, and keeps the layer's size  */
+  if (width <= 0 || height <= 0)
+    return FALSE;
+
+  return (width  != gimp_item_get_width  (GIMP_ITEM (layer)) ||
+          height != gimp_item_get_height (GIMP_ITEM (layer)));
+}
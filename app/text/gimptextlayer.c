@@ -45,6 +45,7 @@
 #include "core/gimpitemtree.h"
 #include "core/gimpparasitelist.h"
 
+#include "gimp-fonts.h"
 #include "gimptext.h"
 #include "gimptextlayer.h"
 #include "gimptextlayer-transform.h"
@@ -98,6 +99,7 @@ static void       gimp_text_layer_push_undo      (GimpDrawable    *drawable,
                                                   gint             height);
 
 static void       gimp_text_layer_text_changed   (GimpTextLayer   *layer);
+static void       gimp_text_layer_clear_layout   (GimpTextLayer   *layer);
 static gboolean   gimp_text_layer_render         (GimpTextLayer   *layer);
 static void       gimp_text_layer_render_layout  (GimpTextLayer   *layer,
                                                   GimpTextLayout  *layout);
@@ -168,6 +170,8 @@ gimp_text_layer_init (GimpTextLayer *layer)
 {
   layer->text          = NULL;
   layer->text_parasite = NULL;
+  layer->layout        = NULL;
+  layer->layout_text   = NULL;
 }
 
 static void
@@ -175,6 +179,8 @@ gimp_text_layer_finalize (GObject *object)
 {
   GimpTextLayer *layer = GIMP_TEXT_LAYER (object);
 
+  gimp_text_layer_clear_layout (layer);
+
   if (layer->text)
     {
       g_object_unref (layer->text);
@@ -411,6 +417,8 @@ gimp_text_layer_set_text (GimpTextLayer *layer,
   if (layer->text == text)
     return;
 
+  gimp_text_layer_clear_layout (layer);
+
   if (layer->text)
     {
       g_signal_handlers_disconnect_by_func (layer->text,
@@ -518,6 +526,72 @@ gimp_text_layer_discard (GimpTextLayer *layer)
   gimp_text_layer_set_text (layer, NULL);
 }
 
+/**
+ * gimp_text_layer_get_layout:
+ * @layer: a #GimpTextLayer
+ *
+ * Returns the layout of @layer's text at the image's resolution. It
+ * is kept until the text or the resolution change, so the layer and
+ * the text tool share it.
+ *
+ * Return value: a #GimpTextLayout owned by @layer, or %NULL
+ **/
+GimpTextLayout *
+gimp_text_layer_get_layout (GimpTextLayer *layer)
+{
+  GimpImage *image;
+  gdouble    xres;
+  gdouble    yres;
+
+  g_return_val_if_fail (GIMP_IS_TEXT_LAYER (layer), NULL);
+
+  if (! layer->text)
+    return NULL;
+
+  image = gimp_item_get_image (GIMP_ITEM (layer));
+
+  gimp_image_get_resolution (image, &xres, &yres);
+
+  /*  "changed" is emitted for properties that are set to the value
+   *  they had, compare the text to what the layout was made from
+   */
+  if (layer->layout)
+    {
+      gdouble layout_xres;
+      gdouble layout_yres;
+
+      gimp_text_layout_get_resolution (layer->layout,
+                                       &layout_xres, &layout_yres);
+
+      if (layout_xres != xres                              ||
+          layout_yres != yres                              ||
+          layer->layout_text->border != layer->text->border ||
+          ! gimp_config_is_equal_to (GIMP_CONFIG (layer->layout_text),
+                                     GIMP_CONFIG (layer->text)))
+        {
+          gimp_text_layer_clear_layout (layer);
+        }
+    }
+
+  if (! layer->layout)
+    {
+      gimp_fonts_wait (image->gimp);
+
+      layer->layout = gimp_text_layout_new (layer->text, xres, yres);
+
+      if (layer->layout)
+        {
+          layer->layout_text =
+            GIMP_TEXT (gimp_config_duplicate (GIMP_CONFIG (layer->text)));
+
+          /*  border is not readable, so not duplicated  */
+          layer->layout_text->border = layer->text->border;
+        }
+    }
+
+  return layer->layout;
+}
+
 gboolean
 gimp_item_is_text_layer (GimpItem *item)
 {
@@ -548,6 +622,22 @@ gimp_text_layer_text_changed (GimpTextLayer *layer)
   gimp_text_layer_render (layer);
 }
 
+static void
+gimp_text_layer_clear_layout (GimpTextLayer *layer)
+{
+  if (layer->layout)
+    {
+      g_object_unref (layer->layout);
+      layer->layout = NULL;
+    }
+
+  if (layer->layout_text)
+    {
+      g_object_unref (layer->layout_text);
+      layer->layout_text = NULL;
+    }
+}
+
 static gboolean
 gimp_text_layer_render (GimpTextLayer *layer)
 {
@@ -555,8 +645,6 @@ gimp_text_layer_render (GimpTextLayer *layer)
   GimpItem       *item;
   GimpImage      *image;
   GimpTextLayout *layout;
-  gdouble         xres;
-  gdouble         yres;
   gint            width;
   gint            height;
 
@@ -567,6 +655,8 @@ gimp_text_layer_render (GimpTextLayer *layer)
   item     = GIMP_ITEM (layer);
   image    = gimp_item_get_image (item);
 
+  gimp_fonts_wait (image->gimp);
+
   if (gimp_container_is_empty (image->gimp->fonts))
     {
       gimp_message_literal (image->gimp, NULL, GIMP_MESSAGE_ERROR,
@@ -575,9 +665,10 @@ gimp_text_layer_render (GimpTextLayer *layer)
       return FALSE;
     }
 
-  gimp_image_get_resolution (image, &xres, &yres);
+  layout = gimp_text_layer_get_layout (layer);
 
-  layout = gimp_text_layout_new (layer->text, xres, yres);
+  if (! layout)
+    return FALSE;
 
   g_object_freeze_notify (G_OBJECT (drawable));
 
@@ -638,8 +729,6 @@ gimp_text_layer_render (GimpTextLayer *layer)
 
   gimp_text_layer_render_layout (layer, layout);
 
-  g_object_unref (layout);
-
   g_object_thaw_notify (G_OBJECT (drawable));
 
   return (width > 0 && height > 0);
@@ -37,15 +37,21 @@ typedef struct _GimpTextLayerClass GimpTextLayerClass;
 
 struct _GimpTextLayer
 {
-  GimpLayer     layer;
-
-  GimpText     *text;
-  const gchar  *text_parasite;  /*  parasite name that this text was set from,
-                                 *  and that should be removed when the text
-                                 *  is changed.
-                                 */
-  gboolean      auto_rename;
-  gboolean      modified;
+  GimpLayer       layer;
+
+  GimpText       *text;
+  const gchar    *text_parasite;  /*  parasite name that this text was set
+                                   *  from, and that should be removed when
+                                   *  the text is changed.
+                                   */
+  gboolean        auto_rename;
+  gboolean        modified;
+
+  /*  the layout of the last rendering, and a copy of the text it was
+   *  made from, to tell whether it can be reused
+   */
+  GimpTextLayout *layout;
+  GimpText       *layout_text;
 };
 
 struct _GimpTextLayerClass
@@ -62,6 +68,8 @@ GimpText  * gimp_text_layer_get_text    (GimpTextLayer *layer);
 void        gimp_text_layer_set_text    (GimpTextLayer *layer,
                                          GimpText      *text);
 void        gimp_text_layer_discard     (GimpTextLayer *layer);
+GimpTextLayout *
+            gimp_text_layer_get_layout  (GimpTextLayer *layer);
 void        gimp_text_layer_set         (GimpTextLayer *layer,
                                          const gchar   *undo_desc,
                                          const gchar   *first_property_name,
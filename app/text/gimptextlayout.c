@@ -26,6 +26,8 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <pango/pangocairo.h>
 
+#include <fontconfig/fontconfig.h>
+
 #include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
 #include "libgimpmath/gimpmath.h"
@@ -36,6 +38,10 @@
 #include "gimptextlayout.h"
 
 
+/*  the most font maps kept for reuse, one per resolution  */
+#define MAX_FONT_MAPS 4
+
+
 struct _GimpTextLayout
 {
   GObject         object;
@@ -47,12 +53,20 @@ struct _GimpTextLayout
   PangoRectangle  extents;
 };
 
+typedef struct
+{
+  gdouble       resolution;
+  FcConfig     *config;
+  PangoFontMap *fontmap;
+} GimpTextFontMap;
+
 
 static void           gimp_text_layout_finalize   (GObject        *object);
 
 static void           gimp_text_layout_position   (GimpTextLayout *layout);
 static void           gimp_text_layout_set_markup (GimpTextLayout *layout);
 
+static PangoFontMap * gimp_text_get_font_map      (gdouble         resolution);
 static PangoContext * gimp_text_get_pango_context (GimpText       *text,
                                                    gdouble         xres,
                                                    gdouble         yres);
@@ -63,6 +77,10 @@ G_DEFINE_TYPE (GimpTextLayout, gimp_text_layout, G_TYPE_OBJECT)
 #define parent_class gimp_text_layout_parent_class
 
 
+/*  most recently used first  */
+static GList *font_maps = NULL;
+
+
 static void
 gimp_text_layout_class_init (GimpTextLayoutClass *klass)
 {
@@ -665,6 +683,71 @@ gimp_text_get_font_options (GimpText *text)
   return options;
 }
 
+/*  The fonts, and the glyphs cairo renders from them, are cached by
+ *  the font map. Layouts at the same resolution share one, instead of
+ *  loading every font again for each layout.
+ */
+static PangoFontMap *
+gimp_text_get_font_map (gdouble resolution)
+{
+  FcConfig        *config = FcConfigGetCurrent ();
+  GimpTextFontMap *font_map;
+  GList           *list;
+  GList           *next;
+  gint             n_font_maps;
+
+  for (list = font_maps; list; list = g_list_next (list))
+    {
+      font_map = list->data;
+
+      if (font_map->resolution == resolution &&
+          font_map->config     == config)
+        {
+          font_maps = g_list_remove_link (font_maps, list);
+          font_maps = g_list_concat (list, font_maps);
+
+          return font_map->fontmap;
+        }
+    }
+
+  /*  font maps of a replaced fontconfig configuration are stale  */
+  for (list = font_maps, n_font_maps = 0; list; list = next)
+    {
+      next     = g_list_next (list);
+      font_map = list->data;
+
+      if (font_map->config != config || n_font_maps == MAX_FONT_MAPS - 1)
+        {
+          g_object_unref (font_map->fontmap);
+          g_slice_free (GimpTextFontMap, font_map);
+
+          font_maps = g_list_delete_link (font_maps, list);
+        }
+      else
+        {
+          n_font_maps++;
+        }
+    }
+
+  font_map = g_slice_new (GimpTextFontMap);
+
+  font_map->resolution = resolution;
+  font_map->config     = config;
+  font_map->fontmap    =
+    pango_cairo_font_map_new_for_font_type (CAIRO_FONT_TYPE_FT);
+
+  if (! font_map->fontmap)
+    g_error ("You are using a Pango that has been built against a cairo "
+             "that lacks the Freetype font backend");
+
+  pango_cairo_font_map_set_resolution (PANGO_CAIRO_FONT_MAP (font_map->fontmap),
+                                       resolution);
+
+  font_maps = g_list_prepend (font_maps, font_map);
+
+  return font_map->fontmap;
+}
+
 static PangoContext *
 gimp_text_get_pango_context (GimpText *text,
                              gdouble   xres,
@@ -674,15 +757,9 @@ gimp_text_get_pango_context (GimpText *text,
   PangoFontMap         *fontmap;
   cairo_font_options_t *options;
 
-  fontmap = pango_cairo_font_map_new_for_font_type (CAIRO_FONT_TYPE_FT);
-  if (! fontmap)
-    g_error ("You are using a Pango that has been built against a cairo "
-             "that lacks the Freetype font backend");
-
-  pango_cairo_font_map_set_resolution (PANGO_CAIRO_FONT_MAP (fontmap), yres);
+  fontmap = gimp_text_get_font_map (yres);
 
   context = pango_font_map_create_context (fontmap);
-  g_object_unref (fontmap);
 
   options = gimp_text_get_font_options (text);
   pango_cairo_context_set_font_options (context, options);
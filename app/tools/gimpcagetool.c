@@ -58,6 +58,13 @@
 #include "gimp-intl.h"
 
 
+/*  cages covering more pixels than this are previewed on a coarse grid
+ *  before the full resolution render
+ */
+#define CAGE_PREVIEW_MIN_PIXELS (512 * 512)
+#define CAGE_PREVIEW_GRID_SIZE  4
+
+
 enum
 {
   CAGE_STATE_INIT,
@@ -130,6 +137,10 @@ static void       gimp_cage_tool_create_image_map   (GimpCageTool          *ct,
 static void       gimp_cage_tool_image_map_flush    (GimpImageMap          *image_map,
                                                      GimpTool              *tool);
 static void       gimp_cage_tool_image_map_update   (GimpCageTool          *ct);
+static void       gimp_cage_tool_image_map_apply    (GimpCageTool          *ct,
+                                                     gint                   grid_size);
+static gboolean   gimp_cage_tool_image_map_refine   (GimpCageTool          *ct);
+static void       gimp_cage_tool_stop_refine        (GimpCageTool          *ct);
 
 static void       gimp_cage_tool_create_render_node (GimpCageTool          *ct);
 static void       gimp_cage_tool_render_node_update (GimpCageTool          *ct);
@@ -199,6 +210,7 @@ gimp_cage_tool_init (GimpCageTool *self)
   self->coef_node       = NULL;
   self->cage_node       = NULL;
   self->image_map       = NULL;
+  self->refine_idle_id  = 0;
 }
 
 static void
@@ -215,6 +227,8 @@ gimp_cage_tool_control (GimpTool       *tool,
       break;
 
     case GIMP_TOOL_ACTION_HALT:
+      gimp_cage_tool_stop_refine (ct);
+
       if (ct->config)
         {
           g_object_unref (ct->config);
@@ -286,6 +300,8 @@ gimp_cage_tool_start (GimpCageTool *ct,
       ct->coef = NULL;
     }
 
+  gimp_cage_tool_stop_refine (ct);
+
   if (ct->image_map)
     {
       gimp_image_map_abort (ct->image_map);
@@ -375,6 +391,7 @@ gimp_cage_tool_options_notify (GimpTool         *tool,
       else
         {
           /* switch to edit mode */
+          gimp_cage_tool_stop_refine (ct);
           gimp_image_map_clear (ct->image_map);
           gimp_cage_tool_image_map_flush (ct->image_map, tool);
 
@@ -428,6 +445,13 @@ gimp_cage_tool_key_press (GimpTool    *tool,
         {
           gimp_tool_control_set_preserve (tool->control, TRUE);
 
+          /*  don't commit a preview  */
+          if (ct->refine_idle_id)
+            {
+              gimp_cage_tool_stop_refine (ct);
+              gimp_cage_tool_image_map_apply (ct, 1);
+            }
+
           gimp_image_map_commit (ct->image_map);
           g_object_unref (ct->image_map);
           ct->image_map = NULL;
@@ -1260,6 +1284,32 @@ gimp_cage_tool_image_map_flush (GimpImageMap *image_map,
 
 static void
 gimp_cage_tool_image_map_update (GimpCageTool *ct)
+{
+  GeglRectangle bounds = gimp_cage_config_get_bounding_box (ct->config);
+
+  gimp_cage_tool_stop_refine (ct);
+
+  /*  on big cages, show a preview computed on a coarse grid first,
+   *  and render at full resolution once it is on the canvas
+   */
+  if (bounds.width * bounds.height >= CAGE_PREVIEW_MIN_PIXELS)
+    {
+      gimp_cage_tool_image_map_apply (ct, CAGE_PREVIEW_GRID_SIZE);
+
+      ct->refine_idle_id =
+        g_idle_add_full (G_PRIORITY_LOW,
+                         (GSourceFunc) gimp_cage_tool_image_map_refine, ct,
+                         NULL);
+    }
+  else
+    {
+      gimp_cage_tool_image_map_apply (ct, 1);
+    }
+}
+
+static void
+gimp_cage_tool_image_map_apply (GimpCageTool *ct,
+                                gint          grid_size)
 {
   GimpTool         *tool  = GIMP_TOOL (ct);
   GimpDisplayShell *shell = gimp_display_get_shell (tool->display);
@@ -1286,5 +1336,29 @@ gimp_cage_tool_image_map_update (GimpCageTool *ct)
   visible.x -= off_x;
   visible.y -= off_y;
 
+  gegl_node_set (ct->cage_node,
+                 "grid-size", grid_size,
+                 NULL);
+
   gimp_image_map_apply (ct->image_map, &visible);
 }
+
+static gboolean
+gimp_cage_tool_image_map_refine (GimpCageTool *ct)
+{
+  ct->refine_idle_id = 0;
+
+  gimp_cage_tool_image_map_apply (ct, 1);
+
+  return FALSE;
+}
+
+static void
+gimp_cage_tool_stop_refine (GimpCageTool *ct)
+{
+  if (ct->refine_idle_id)
+    {
+      g_source_remove (ct->refine_idle_id);
+      ct->refine_idle_id = 0;
+    }
+}
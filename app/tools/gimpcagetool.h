@@ -69,6 +69,7 @@ struct _GimpCageTool
   gint            tool_state; /* Current state in statemachine */
 
   GimpImageMap   *image_map; /* For preview */
+  guint           refine_idle_id; /* Full resolution render after a preview */
 };
 
 struct _GimpCageToolClass
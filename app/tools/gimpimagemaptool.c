@@ -182,6 +182,7 @@ gimp_image_map_tool_class_init (GimpImageMapToolClass *klass)
   klass->settings_name       = NULL;
   klass->import_dialog_title = NULL;
   klass->export_dialog_title = NULL;
+  klass->progressive         = FALSE;
 
   klass->get_operation       = NULL;
   klass->map                 = NULL;
@@ -612,6 +613,7 @@ gimp_image_map_tool_map (GimpImageMapTool *tool)
   gint              x, y;
   gint              w, h;
   gint              off_x, off_y;
+  gint              pointer_x, pointer_y;
   GeglRectangle     visible;
 
   if (GIMP_IMAGE_MAP_TOOL_GET_CLASS (tool)->map)
@@ -634,6 +636,20 @@ gimp_image_map_tool_map (GimpImageMapTool *tool)
   visible.x -= off_x;
   visible.y -= off_y;
 
+  /*  progressive image maps refine around the pointer first, when it
+   *  is on the canvas rather than on the dialog
+   */
+  gtk_widget_get_pointer (shell->canvas, &pointer_x, &pointer_y);
+
+  if (pointer_x >= 0 && pointer_x < shell->disp_width &&
+      pointer_y >= 0 && pointer_y < shell->disp_height)
+    {
+      gimp_display_shell_untransform_xy (shell, pointer_x, pointer_y,
+                                         &x, &y, FALSE);
+
+      gimp_image_map_set_focus (tool->image_map, x - off_x, y - off_y);
+    }
+
   gimp_image_map_apply (tool->image_map, &visible);
 }
 
@@ -695,6 +711,9 @@ gimp_image_map_tool_create_map (GimpImageMapTool *tool)
                                         GIMP_TOOL (tool)->tool_info->blurb,
                                         tool->operation);
 
+  gimp_image_map_set_progressive (tool->image_map,
+                                  GIMP_IMAGE_MAP_TOOL_GET_CLASS (tool)->progressive);
+
   g_signal_connect (tool->image_map, "flush",
                     G_CALLBACK (gimp_image_map_tool_flush),
                     tool);
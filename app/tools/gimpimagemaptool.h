@@ -64,6 +64,11 @@ struct _GimpImageMapToolClass
   const gchar        *import_dialog_title;
   const gchar        *export_dialog_title;
 
+  /*  render expensive operations coarsely first, see
+   *  gimp_image_map_set_progressive()
+   */
+  gboolean            progressive;
+
   GimpContainer      *recent_settings;
 
   /* virtual functions */
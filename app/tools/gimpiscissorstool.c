@@ -42,6 +42,18 @@
 
 /* Livewire boundary implementation done by Laramie Leavitt */
 
+/* This tool is disabled until it is ported to GEGL.  When porting,
+ * don't carry over the search below as it is: gradient_map_value()
+ * does a tile lookup for every neighbour of every pixel, and
+ * find_optimal_path() relaxes the whole expanded bounding box of a
+ * segment even when the optimal path hugs one edge.  The gradient map
+ * should become a GeglBuffer whose tiles are filled on demand, using
+ * gimp_parallel_distribute_area() for the blur and derivative passes,
+ * and the path search a Dijkstra/A* over a priority queue that stops
+ * once the end point is settled, so the cost depends on the length of
+ * the path rather than on the area of the box.
+ */
+
 #if 0
 
 #include "config.h"
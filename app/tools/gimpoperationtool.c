@@ -117,6 +117,7 @@ gimp_operation_tool_class_init (GimpOperationToolClass *klass)
   tool_class->initialize         = gimp_operation_tool_initialize;
 
   im_tool_class->dialog_desc     = _("GEGL Operation");
+  im_tool_class->progressive     = TRUE;
 
   im_tool_class->get_operation   = gimp_operation_tool_get_operation;
   im_tool_class->map             = gimp_operation_tool_map;
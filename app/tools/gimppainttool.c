@@ -43,6 +43,7 @@
 #include "display/gimpdisplay.h"
 #include "display/gimpdisplayshell.h"
 #include "display/gimpdisplayshell-selection.h"
+#include "display/gimpmotionbuffer.h"
 
 #include "gimpcoloroptions.h"
 #include "gimppainttool.h"
@@ -405,6 +406,7 @@ gimp_paint_tool_motion (GimpTool         *tool,
   GimpPaintTool    *paint_tool    = GIMP_PAINT_TOOL (tool);
   GimpPaintOptions *paint_options = GIMP_PAINT_TOOL_GET_OPTIONS (tool);
   GimpPaintCore    *core          = paint_tool->core;
+  GimpDisplayShell *shell         = gimp_display_get_shell (display);
   GimpImage        *image         = gimp_display_get_image (display);
   GimpDrawable     *drawable      = gimp_image_get_active_drawable (image);
   GimpCoords        curr_coords;
@@ -436,8 +438,14 @@ gimp_paint_tool_motion (GimpTool         *tool,
   gimp_paint_core_interpolate (core, drawable, paint_options,
                                &curr_coords, time);
 
-  gimp_projection_flush_now (gimp_image_get_projection (image));
-  gimp_display_flush_now (display);
+  /*  when the motion buffer sends a batch of events, only show the
+   *  result of the last one
+   */
+  if (! gimp_motion_buffer_is_batch_pending (shell->motion_buffer))
+    {
+      gimp_projection_flush_now (gimp_image_get_projection (image));
+      gimp_display_flush_now (display);
+    }
 
   gimp_draw_tool_resume (GIMP_DRAW_TOOL (tool));
 }
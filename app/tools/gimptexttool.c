@@ -1761,14 +1761,11 @@ gimp_text_tool_ensure_layout (GimpTextTool *text_tool)
 {
   if (! text_tool->layout && text_tool->text)
     {
-      GimpImage *image = gimp_item_get_image (GIMP_ITEM (text_tool->layer));
-      gdouble    xres;
-      gdouble    yres;
+      /*  share the layout the layer renders from  */
+      text_tool->layout = gimp_text_layer_get_layout (text_tool->layer);
 
-      gimp_image_get_resolution (image, &xres, &yres);
-
-      text_tool->layout = gimp_text_layout_new (text_tool->layer->text,
-                                                xres, yres);
+      if (text_tool->layout)
+        g_object_ref (text_tool->layout);
     }
 
   return text_tool->layout != NULL;
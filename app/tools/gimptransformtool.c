@@ -33,6 +33,7 @@
 #include "core/gimpboundary.h"
 #include "core/gimpcontext.h"
 #include "core/gimpchannel.h"
+#include "core/gimpcoords.h"
 #include "core/gimpdrawable-transform.h"
 #include "core/gimperror.h"
 #include "core/gimpimage.h"
@@ -923,16 +924,10 @@ gimp_transform_tool_draw (GimpDrawTool *draw_tool)
 
               if (coords && coords->len)
                 {
-                  gint i;
-
-                  for (i = 0; i < coords->len; i++)
-                    {
-                      GimpCoords *curr = &g_array_index (coords, GimpCoords, i);
-
-                      gimp_matrix3_transform_point (&matrix,
-                                                    curr->x, curr->y,
-                                                    &curr->x, &curr->y);
-                    }
+                  gimp_coords_transform (&matrix,
+                                         &g_array_index (coords,
+                                                         GimpCoords, 0),
+                                         coords->len);
 
                   gimp_draw_tool_add_strokes (draw_tool,
                                               &g_array_index (coords,
@@ -20,6 +20,9 @@
 
 #include "config.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include <glib-object.h>
 #include <cairo.h>
 
@@ -35,8 +38,72 @@
 #include "gimpbezierstroke.h"
 
 
+/*  the most segments in a leaf of the bounding volume hierarchy  */
+#define BVH_LEAF_SIZE 4
+
+
+typedef struct
+{
+  GimpCoords  coords[4];
+  GimpAnchor *start;
+  GimpAnchor *end;
+  gint        index;  /* the position along the stroke, for ties */
+
+  gdouble     x1, y1;
+  gdouble     x2, y2;
+} BVHSegment;
+
+typedef struct
+{
+  gdouble     x1, y1;
+  gdouble     x2, y2;
+
+  /*  leaves hold n_segments > 0 segments from segments[first], inner
+   *  nodes have their two children at nodes[first]
+   */
+  gint        first;
+  gint        n_segments;
+} BVHNode;
+
+struct _GimpBezierStrokeBVH
+{
+  BVHSegment *segments;
+  gint        n_segments;
+
+  BVHNode    *nodes;
+  gint        n_nodes;
+};
+
+typedef struct
+{
+  const GimpCoords *coord1;
+  const GimpCoords *coord2;
+  gdouble           precision;
+
+  gdouble           dist;  /* < 0 until a segment was found */
+  gint              index;
+  GimpCoords        point;
+  gdouble           pos;
+  GimpAnchor       *start;
+  GimpAnchor       *end;
+} BVHQuery;
+
+
 /*  local prototypes  */
 
+static void     gimp_bezier_stroke_changed         (GimpStroke          *stroke);
+static GimpBezierStrokeBVH *
+                gimp_bezier_stroke_get_bvh         (const GimpStroke    *stroke);
+static void     gimp_bezier_stroke_bvh_free        (GimpBezierStrokeBVH *bvh);
+static void     gimp_bezier_stroke_bvh_nearest_point
+                                                   (GimpBezierStrokeBVH *bvh,
+                                                    gint                 node,
+                                                    BVHQuery            *query);
+static void     gimp_bezier_stroke_bvh_nearest_tangent
+                                                   (GimpBezierStrokeBVH *bvh,
+                                                    gint                 node,
+                                                    BVHQuery            *query);
+
 static gdouble
     gimp_bezier_stroke_nearest_point_get   (const GimpStroke      *stroke,
                                             const GimpCoords      *coord,
@@ -155,6 +222,7 @@ gimp_bezier_stroke_class_init (GimpBezierStrokeClass *klass)
 
   object_class->finalize             = gimp_bezier_stroke_finalize;
 
+  stroke_class->changed              = gimp_bezier_stroke_changed;
   stroke_class->nearest_point_get    = gimp_bezier_stroke_nearest_point_get;
   stroke_class->nearest_tangent_get  = gimp_bezier_stroke_nearest_tangent_get;
   stroke_class->nearest_intersection_get = NULL;
@@ -179,14 +247,35 @@ gimp_bezier_stroke_class_init (GimpBezierStrokeClass *klass)
 static void
 gimp_bezier_stroke_init (GimpBezierStroke *stroke)
 {
+  stroke->bvh = NULL;
 }
 
 static void
 gimp_bezier_stroke_finalize (GObject *object)
 {
+  GimpBezierStroke *bezier_stroke = GIMP_BEZIER_STROKE (object);
+
+  if (bezier_stroke->bvh)
+    {
+      gimp_bezier_stroke_bvh_free (bezier_stroke->bvh);
+      bezier_stroke->bvh = NULL;
+    }
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gimp_bezier_stroke_changed (GimpStroke *stroke)
+{
+  GimpBezierStroke *bezier_stroke = GIMP_BEZIER_STROKE (stroke);
+
+  if (bezier_stroke->bvh)
+    {
+      gimp_bezier_stroke_bvh_free (bezier_stroke->bvh);
+      bezier_stroke->bvh = NULL;
+    }
+}
+
 
 /* Bezier specific functions */
 
@@ -554,101 +643,34 @@ gimp_bezier_stroke_nearest_point_get (const GimpStroke     *stroke,
                                       GimpAnchor          **ret_segment_end,
                                       gdouble              *ret_pos)
 {
-  gdouble     min_dist, dist, pos;
-  GimpCoords  point;
-  GimpCoords  segmentcoords[4];
-  GList      *anchorlist;
-  GimpAnchor *segment_start;
-  GimpAnchor *segment_end = NULL;
-  GimpAnchor *anchor;
-  gint        count;
+  GimpBezierStrokeBVH *bvh;
+  BVHQuery             query = { 0, };
 
   if (!stroke->anchors)
     return -1.0;
 
-  count = 0;
-  min_dist = -1;
+  bvh = gimp_bezier_stroke_get_bvh (stroke);
 
-  for (anchorlist = stroke->anchors;
-       anchorlist && GIMP_ANCHOR (anchorlist->data)->type != GIMP_ANCHOR_ANCHOR;
-       anchorlist = g_list_next (anchorlist));
+  query.coord1    = coord;
+  query.precision = precision;
+  query.dist      = -1;
 
-  segment_start = anchorlist->data;
+  if (bvh->n_nodes > 0)
+    gimp_bezier_stroke_bvh_nearest_point (bvh, 0, &query);
 
-  for ( ; anchorlist; anchorlist = g_list_next (anchorlist))
+  if (query.dist >= 0)
     {
-      anchor = anchorlist->data;
-
-      segmentcoords[count] = anchor->position;
-      count++;
-
-      if (count == 4)
-        {
-          segment_end = anchorlist->data;
-          dist = gimp_bezier_stroke_segment_nearest_point_get (segmentcoords,
-                                                               coord, precision,
-                                                               &point, &pos,
-                                                               10);
-
-          if (dist < min_dist || min_dist < 0)
-            {
-              min_dist = dist;
-
-              if (ret_pos)
-                *ret_pos = pos;
-              if (ret_point)
-                *ret_point = point;
-              if (ret_segment_start)
-                *ret_segment_start = segment_start;
-              if (ret_segment_end)
-                *ret_segment_end = segment_end;
-            }
-
-          segment_start = anchorlist->data;
-          segmentcoords[0] = segmentcoords[3];
-          count = 1;
-        }
+      if (ret_pos)
+        *ret_pos = query.pos;
+      if (ret_point)
+        *ret_point = query.point;
+      if (ret_segment_start)
+        *ret_segment_start = query.start;
+      if (ret_segment_end)
+        *ret_segment_end = query.end;
     }
 
-  if (stroke->closed && stroke->anchors)
-    {
-      anchorlist = stroke->anchors;
-
-      while (count < 3)
-        {
-          segmentcoords[count] = GIMP_ANCHOR (anchorlist->data)->position;
-          count++;
-        }
-
-      anchorlist = g_list_next (anchorlist);
-
-      if (anchorlist)
-        {
-          segment_end = GIMP_ANCHOR (anchorlist->data);
-          segmentcoords[3] = segment_end->position;
-        }
-
-      dist = gimp_bezier_stroke_segment_nearest_point_get (segmentcoords,
-                                                           coord, precision,
-                                                           &point, &pos,
-                                                           10);
-
-      if (dist < min_dist || min_dist < 0)
-        {
-          min_dist = dist;
-
-          if (ret_pos)
-            *ret_pos = pos;
-          if (ret_point)
-            *ret_point = point;
-          if (ret_segment_start)
-            *ret_segment_start = segment_start;
-          if (ret_segment_end)
-            *ret_segment_end = segment_end;
-        }
-    }
-
-  return min_dist;
+  return query.dist;
 }
 
 
@@ -790,101 +812,35 @@ gimp_bezier_stroke_nearest_tangent_get (const GimpStroke  *stroke,
                                         GimpAnchor       **ret_segment_end,
                                         gdouble           *ret_pos)
 {
-  gdouble     min_dist, dist, pos;
-  GimpCoords  point;
-  GimpCoords  segmentcoords[4];
-  GList      *anchorlist;
-  GimpAnchor *segment_start;
-  GimpAnchor *segment_end = NULL;
-  GimpAnchor *anchor;
-  gint        count;
+  GimpBezierStrokeBVH *bvh;
+  BVHQuery             query = { 0, };
 
   if (!stroke->anchors)
     return -1.0;
 
-  count = 0;
-  min_dist = -1;
+  bvh = gimp_bezier_stroke_get_bvh (stroke);
 
-  for (anchorlist = stroke->anchors;
-       anchorlist && GIMP_ANCHOR (anchorlist->data)->type != GIMP_ANCHOR_ANCHOR;
-       anchorlist = g_list_next (anchorlist));
+  query.coord1    = coord1;
+  query.coord2    = coord2;
+  query.precision = precision;
+  query.dist      = -1;
 
-  segment_start = anchorlist->data;
+  if (bvh->n_nodes > 0)
+    gimp_bezier_stroke_bvh_nearest_tangent (bvh, 0, &query);
 
-  for ( ; anchorlist; anchorlist = g_list_next (anchorlist))
+  if (query.dist >= 0)
     {
-      anchor = anchorlist->data;
-
-      segmentcoords[count] = anchor->position;
-      count++;
-
-      if (count == 4)
-        {
-          segment_end = anchorlist->data;
-          dist = gimp_bezier_stroke_segment_nearest_tangent_get (segmentcoords,
-                                                                 coord1, coord2,
-                                                                 precision,
-                                                                 &point, &pos);
-
-          if (dist >= 0 && (dist < min_dist || min_dist < 0))
-            {
-              min_dist = dist;
-
-              if (ret_pos)
-                *ret_pos = pos;
-              if (nearest)
-                *nearest = point;
-              if (ret_segment_start)
-                *ret_segment_start = segment_start;
-              if (ret_segment_end)
-                *ret_segment_end = segment_end;
-            }
-
-          segment_start = anchorlist->data;
-          segmentcoords[0] = segmentcoords[3];
-          count = 1;
-        }
+      if (ret_pos)
+        *ret_pos = query.pos;
+      if (nearest)
+        *nearest = query.point;
+      if (ret_segment_start)
+        *ret_segment_start = query.start;
+      if (ret_segment_end)
+        *ret_segment_end = query.end;
     }
 
-  if (stroke->closed && stroke->anchors)
-    {
-      anchorlist = stroke->anchors;
-
-      while (count < 3)
-        {
-          segmentcoords[count] = GIMP_ANCHOR (anchorlist->data)->position;
-          count++;
-        }
-
-      anchorlist = g_list_next (anchorlist);
-
-      if (anchorlist)
-        {
-          segment_end = GIMP_ANCHOR (anchorlist->data);
-          segmentcoords[3] = segment_end->position;
-        }
-
-      dist = gimp_bezier_stroke_segment_nearest_tangent_get (segmentcoords,
-                                                             coord1, coord2,
-                                                             precision,
-                                                             &point, &pos);
-
-      if (dist >= 0 && (dist < min_dist || min_dist < 0))
-        {
-          min_dist = dist;
-
-          if (ret_pos)
-            *ret_pos = pos;
-          if (nearest)
-            *nearest = point;
-          if (ret_segment_start)
-            *ret_segment_start = segment_start;
-          if (ret_segment_end)
-            *ret_segment_end = segment_end;
-        }
-    }
-
-  return min_dist;
+  return query.dist;
 }
 
 static gdouble
@@ -1084,6 +1040,8 @@ gimp_bezier_stroke_extend (GimpStroke           *stroke,
 
       stroke->anchors = g_list_append (stroke->anchors, anchor);
 
+      gimp_stroke_invalidate (stroke);
+
       switch (extend_mode)
         {
         case EXTEND_SIMPLE:
@@ -1234,6 +1192,8 @@ gimp_bezier_stroke_extend (GimpStroke           *stroke,
 
               if (loose_end == -1)
                 stroke->anchors = g_list_prepend (stroke->anchors, anchor);
+
+              gimp_stroke_invalidate (stroke);
               break;
 
             case EXTEND_EDITABLE:
@@ -1656,6 +1616,8 @@ gimp_bezier_stroke_lineto (GimpStroke       *stroke,
   stroke->anchors = g_list_prepend (stroke->anchors,
                                     gimp_anchor_new (GIMP_ANCHOR_CONTROL,
                                                      end));
+
+  gimp_stroke_invalidate (stroke);
 }
 
 void
@@ -1687,6 +1649,8 @@ gimp_bezier_stroke_conicto (GimpStroke       *stroke,
   stroke->anchors = g_list_prepend (stroke->anchors,
                                     gimp_anchor_new (GIMP_ANCHOR_CONTROL,
                                                      end));
+
+  gimp_stroke_invalidate (stroke);
 }
 
 void
@@ -1710,6 +1674,50 @@ gimp_bezier_stroke_cubicto (GimpStroke       *stroke,
   stroke->anchors = g_list_prepend (stroke->anchors,
                                     gimp_anchor_new (GIMP_ANCHOR_CONTROL,
                                                      end));
+
+  gimp_stroke_invalidate (stroke);
+}
+
+/*  appends the n_coords / 3 cubic segments in coords, each given as
+ *  control1, control2 and end point, like gimp_bezier_stroke_cubicto()
+ */
+void
+gimp_bezier_stroke_cubicto_coords (GimpStroke       *bez_stroke,
+                                   const GimpCoords *coords,
+                                   gint              n_coords)
+{
+  GList *anchors;
+  gint   i;
+
+  g_return_if_fail (GIMP_IS_BEZIER_STROKE (bez_stroke));
+  g_return_if_fail (bez_stroke->closed == FALSE);
+  g_return_if_fail (bez_stroke->anchors != NULL);
+  g_return_if_fail (coords != NULL || n_coords == 0);
+  g_return_if_fail ((n_coords % 3) == 0);
+
+  if (n_coords == 0)
+    return;
+
+  anchors = bez_stroke->anchors;
+
+  for (i = 0; i < n_coords; i += 3)
+    {
+      GIMP_ANCHOR (anchors->data)->position = coords[i];
+
+      anchors = g_list_prepend (anchors,
+                                gimp_anchor_new (GIMP_ANCHOR_CONTROL,
+                                                 &coords[i + 1]));
+      anchors = g_list_prepend (anchors,
+                                gimp_anchor_new (GIMP_ANCHOR_ANCHOR,
+                                                 &coords[i + 2]));
+      anchors = g_list_prepend (anchors,
+                                gimp_anchor_new (GIMP_ANCHOR_CONTROL,
+                                                 &coords[i + 2]));
+    }
+
+  bez_stroke->anchors = anchors;
+
+  gimp_stroke_invalidate (bez_stroke);
 }
 
 static gdouble
@@ -1967,18 +1975,7 @@ gimp_bezier_stroke_arcto (GimpStroke       *bez_stroke,
                                 MAX (phi0, phi1), MIN (phi0 + G_PI_2, phi2),
                                 ellips);
 
-          gimp_matrix3_transform_point (&anglerot, ellips[0].x, ellips[0].y,
-                                        &tmpx, &tmpy);
-          ellips[0].x = tmpx; ellips[0].y = tmpy;
-          gimp_matrix3_transform_point (&anglerot, ellips[1].x, ellips[1].y,
-                                        &tmpx, &tmpy);
-          ellips[1].x = tmpx; ellips[1].y = tmpy;
-          gimp_matrix3_transform_point (&anglerot, ellips[2].x, ellips[2].y,
-                                        &tmpx, &tmpy);
-          ellips[2].x = tmpx; ellips[2].y = tmpy;
-          gimp_matrix3_transform_point (&anglerot, ellips[3].x, ellips[3].y,
-                                        &tmpx, &tmpy);
-          ellips[3].x = tmpx; ellips[3].y = tmpy;
+          gimp_coords_transform (&anglerot, ellips, 4);
 
           gimp_coords_add (&center, &(ellips[1]), &(ctrl[1]));
           gimp_coords_add (&center, &(ellips[2]), &(ctrl[2]));
@@ -2002,18 +1999,7 @@ gimp_bezier_stroke_arcto (GimpStroke       *bez_stroke,
                                 MIN (phi0, phi1), MAX (phi0 - G_PI_2, phi2),
                                 ellips);
 
-          gimp_matrix3_transform_point (&anglerot, ellips[0].x, ellips[0].y,
-                                        &tmpx, &tmpy);
-          ellips[0].x = tmpx; ellips[0].y = tmpy;
-          gimp_matrix3_transform_point (&anglerot, ellips[1].x, ellips[1].y,
-                                        &tmpx, &tmpy);
-          ellips[1].x = tmpx; ellips[1].y = tmpy;
-          gimp_matrix3_transform_point (&anglerot, ellips[2].x, ellips[2].y,
-                                        &tmpx, &tmpy);
-          ellips[2].x = tmpx; ellips[2].y = tmpy;
-          gimp_matrix3_transform_point (&anglerot, ellips[3].x, ellips[3].y,
-                                        &tmpx, &tmpy);
-          ellips[3].x = tmpx; ellips[3].y = tmpy;
+          gimp_coords_transform (&anglerot, ellips, 4);
 
           gimp_coords_add (&center, &(ellips[1]), &(ctrl[1]));
           gimp_coords_add (&center, &(ellips[2]), &(ctrl[2]));
@@ -2097,3 +2083,376 @@ gimp_bezier_stroke_get_anchor_listitem (GList *list)
 
   return NULL;
 }
+
+
+/* the bounding volume hierarchy of the segments */
+
+static void
+gimp_bezier_stroke_bvh_add_segment (GArray      *segments,
+                                    GimpCoords  *coords,
+                                    GimpAnchor  *start,
+                                    GimpAnchor  *end)
+{
+  BVHSegment segment;
+  gint       i;
+
+  memcpy (segment.coords, coords, sizeof (segment.coords));
+
+  segment.start = start;
+  segment.end   = end;
+  segment.index = segments->len;
+
+  /*  the curve, and every point the subdivisions return, lies in the
+   *  convex hull of the control points
+   */
+  segment.x1 = segment.x2 = coords[0].x;
+  segment.y1 = segment.y2 = coords[0].y;
+
+  for (i = 1; i < 4; i++)
+    {
+      segment.x1 = MIN (segment.x1, coords[i].x);
+      segment.y1 = MIN (segment.y1, coords[i].y);
+      segment.x2 = MAX (segment.x2, coords[i].x);
+      segment.y2 = MAX (segment.y2, coords[i].y);
+    }
+
+  g_array_append_val (segments, segment);
+}
+
+static gint
+gimp_bezier_stroke_bvh_compare_x (const BVHSegment *a,
+                                  const BVHSegment *b)
+{
+  gdouble ca = a->x1 + a->x2;
+  gdouble cb = b->x1 + b->x2;
+
+  return ca < cb ? -1 : ca > cb ? 1 : 0;
+}
+
+static gint
+gimp_bezier_stroke_bvh_compare_y (const BVHSegment *a,
+                                  const BVHSegment *b)
+{
+  gdouble ca = a->y1 + a->y2;
+  gdouble cb = b->y1 + b->y2;
+
+  return ca < cb ? -1 : ca > cb ? 1 : 0;
+}
+
+static void
+gimp_bezier_stroke_bvh_build (GimpBezierStrokeBVH *bvh,
+                              gint                 node_index,
+                              gint                 first,
+                              gint                 n_segments)
+{
+  BVHNode    *node     = &bvh->nodes[node_index];
+  BVHSegment *segments = bvh->segments + first;
+  gdouble     cx1, cy1, cx2, cy2;
+  gint        i;
+
+  node->x1 = segments[0].x1;
+  node->y1 = segments[0].y1;
+  node->x2 = segments[0].x2;
+  node->y2 = segments[0].y2;
+
+  cx1 = cx2 = segments[0].x1 + segments[0].x2;
+  cy1 = cy2 = segments[0].y1 + segments[0].y2;
+
+  for (i = 1; i < n_segments; i++)
+    {
+      node->x1 = MIN (node->x1, segments[i].x1);
+      node->y1 = MIN (node->y1, segments[i].y1);
+      node->x2 = MAX (node->x2, segments[i].x2);
+      node->y2 = MAX (node->y2, segments[i].y2);
+
+      cx1 = MIN (cx1, segments[i].x1 + segments[i].x2);
+      cy1 = MIN (cy1, segments[i].y1 + segments[i].y2);
+      cx2 = MAX (cx2, segments[i].x1 + segments[i].x2);
+      cy2 = MAX (cy2, segments[i].y1 + segments[i].y2);
+    }
+
+  if (n_segments <= BVH_LEAF_SIZE)
+    {
+      node->first      = first;
+      node->n_segments = n_segments;
+
+      return;
+    }
+
+  /*  split at the median of the segment centers, along the axis they
+   *  spread most on
+   */
+  qsort (segments, n_segments, sizeof (BVHSegment),
+         (GCompareFunc) (cx2 - cx1 >= cy2 - cy1 ?
+                         gimp_bezier_stroke_bvh_compare_x :
+                         gimp_bezier_stroke_bvh_compare_y));
+
+  node->first      = bvh->n_nodes;
+  node->n_segments = 0;
+
+  bvh->n_nodes += 2;
+
+  gimp_bezier_stroke_bvh_build (bvh, node->first,
+                                first, n_segments / 2);
+  gimp_bezier_stroke_bvh_build (bvh, node->first + 1,
+                                first + n_segments / 2,
+                                n_segments - n_segments / 2);
+}
+
+static GimpBezierStrokeBVH *
+gimp_bezier_stroke_get_bvh (const GimpStroke *stroke)
+{
+  /*  the hierarchy doesn't change what the stroke looks like  */
+  GimpBezierStroke *bezier_stroke = GIMP_BEZIER_STROKE (stroke);
+  GArray           *segments;
+  GimpCoords        segmentcoords[4];
+  GList            *anchorlist;
+  GimpAnchor       *segment_start;
+  gint              count;
+
+  if (bezier_stroke->bvh)
+    return bezier_stroke->bvh;
+
+  segments = g_array_new (FALSE, FALSE, sizeof (BVHSegment));
+
+  /*  collect the segments the way the nearest point queries used to
+   *  walk them
+   */
+  count = 0;
+
+  for (anchorlist = stroke->anchors;
+       anchorlist && GIMP_ANCHOR (anchorlist->data)->type != GIMP_ANCHOR_ANCHOR;
+       anchorlist = g_list_next (anchorlist));
+
+  segment_start = anchorlist ? anchorlist->data : NULL;
+
+  for ( ; anchorlist; anchorlist = g_list_next (anchorlist))
+    {
+      segmentcoords[count] = GIMP_ANCHOR (anchorlist->data)->position;
+      count++;
+
+      if (count == 4)
+        {
+          gimp_bezier_stroke_bvh_add_segment (segments, segmentcoords,
+                                              segment_start,
+                                              anchorlist->data);
+
+          segment_start = anchorlist->data;
+          segmentcoords[0] = segmentcoords[3];
+          count = 1;
+        }
+    }
+
+  if (stroke->closed && stroke->anchors && count > 0)
+    {
+      GimpAnchor *segment_end = NULL;
+
+      anchorlist = stroke->anchors;
+
+      while (count < 3)
+        {
+          segmentcoords[count] = GIMP_ANCHOR (anchorlist->data)->position;
+          count++;
+        }
+
+      anchorlist = g_list_next (anchorlist);
+
+      if (anchorlist)
+        {
+          segment_end = GIMP_ANCHOR (anchorlist->data);
+          segmentcoords[3] = segment_end->position;
+        }
+
+      gimp_bezier_stroke_bvh_add_segment (segments, segmentcoords,
+                                          segment_start, segment_end);
+    }
+
+  bezier_stroke->bvh = g_slice_new0 (GimpBezierStrokeBVH);
+
+  bezier_stroke->bvh->n_segments = segments->len;
+  bezier_stroke->bvh->segments   = (BVHSegment *) g_array_free (segments,
+                                                                FALSE);
+
+  if (bezier_stroke->bvh->n_segments > 0)
+    {
+      /*  a binary tree with leaves of at least one segment  */
+      bezier_stroke->bvh->nodes   = g_new (BVHNode,
+                                           2 * bezier_stroke->bvh->n_segments);
+      bezier_stroke->bvh->n_nodes = 1;
+
+      gimp_bezier_stroke_bvh_build (bezier_stroke->bvh, 0,
+                                    0, bezier_stroke->bvh->n_segments);
+    }
+
+  return bezier_stroke->bvh;
+}
+
+static void
+gimp_bezier_stroke_bvh_free (GimpBezierStrokeBVH *bvh)
+{
+  g_free (bvh->segments);
+  g_free (bvh->nodes);
+
+  g_slice_free (GimpBezierStrokeBVH, bvh);
+}
+
+/*  the distance between a node's box and the box around coord1 and
+ *  coord2, a lower bound of the distance between anything inside them
+ */
+static inline gdouble
+gimp_bezier_stroke_bvh_distance (const BVHNode    *node,
+                                 const GimpCoords *coord1,
+                                 const GimpCoords *coord2)
+{
+  gdouble dx = MAX (0.0, MAX (node->x1 - MAX (coord1->x, coord2->x),
+                              MIN (coord1->x, coord2->x) - node->x2));
+  gdouble dy = MAX (0.0, MAX (node->y1 - MAX (coord1->y, coord2->y),
+                              MIN (coord1->y, coord2->y) - node->y2));
+
+  return sqrt (dx * dx + dy * dy);
+}
+
+static inline void
+gimp_bezier_stroke_bvh_update (BVHQuery         *query,
+                               const BVHSegment *segment,
+                               gdouble           dist,
+                               const GimpCoords *point,
+                               gdouble           pos)
+{
+  /*  on ties, the segment first along the stroke wins  */
+  if (query->dist < 0 || dist < query->dist ||
+      (dist == query->dist && segment->index < query->index))
+    {
+      query->dist  = dist;
+      query->index = segment->index;
+      query->point = *point;
+      query->pos   = pos;
+      query->start = segment->start;
+      query->end   = segment->end;
+    }
+}
+
+static void
+gimp_bezier_stroke_bvh_nearest_point (GimpBezierStrokeBVH *bvh,
+                                      gint                 node_index,
+                                      BVHQuery            *query)
+{
+  const BVHNode *node = &bvh->nodes[node_index];
+
+  if (node->n_segments > 0)
+    {
+      gint i;
+
+      for (i = 0; i < node->n_segments; i++)
+        {
+          const BVHSegment *segment = &bvh->segments[node->first + i];
+          GimpCoords        point;
+          gdouble           pos;
+          gdouble           dist;
+
+          dist = gimp_bezier_stroke_segment_nearest_point_get (segment->coords,
+                                                               query->coord1,
+                                                               query->precision,
+                                                               &point, &pos,
+                                                               10);
+
+          gimp_bezier_stroke_bvh_update (query, segment, dist, &point, pos);
+        }
+    }
+  else
+    {
+      gint    near = node->first;
+      gint    far  = node->first + 1;
+      gdouble near_dist;
+      gdouble far_dist;
+
+      near_dist = gimp_bezier_stroke_bvh_distance (&bvh->nodes[near],
+                                                   query->coord1,
+                                                   query->coord1);
+      far_dist  = gimp_bezier_stroke_bvh_distance (&bvh->nodes[far],
+                                                   query->coord1,
+                                                   query->coord1);
+
+      if (far_dist < near_dist)
+        {
+          gint    tmp      = near;
+          gdouble tmp_dist = near_dist;
+
+          near      = far;
+          near_dist = far_dist;
+          far       = tmp;
+          far_dist  = tmp_dist;
+        }
+
+      /*  equal distances are visited, they might win the tie  */
+      if (query->dist < 0 || near_dist <= query->dist)
+        gimp_bezier_stroke_bvh_nearest_point (bvh, near, query);
+
+      if (query->dist < 0 || far_dist <= query->dist)
+        gimp_bezier_stroke_bvh_nearest_point (bvh, far, query);
+    }
+}
+
+static void
+gimp_bezier_stroke_bvh_nearest_tangent (GimpBezierStrokeBVH *bvh,
+                                        gint                 node_index,
+                                        BVHQuery            *query)
+{
+  const BVHNode *node = &bvh->nodes[node_index];
+
+  if (node->n_segments > 0)
+    {
+      gint i;
+
+      for (i = 0; i < node->n_segments; i++)
+        {
+          const BVHSegment *segment = &bvh->segments[node->first + i];
+          GimpCoords        point;
+          gdouble           pos;
+          gdouble           dist;
+
+          dist = gimp_bezier_stroke_segment_nearest_tangent_get (segment->coords,
+                                                                 query->coord1,
+                                                                 query->coord2,
+                                                                 query->precision,
+                                                                 &point, &pos);
+
+          if (dist >= 0)
+            gimp_bezier_stroke_bvh_update (query, segment, dist, &point, pos);
+        }
+    }
+  else
+    {
+      /*  the tangent points lie on the curve, their distance is
+       *  measured to the line between coord1 and coord2
+       */
+      gint    near = node->first;
+      gint    far  = node->first + 1;
+      gdouble near_dist;
+      gdouble far_dist;
+
+      near_dist = gimp_bezier_stroke_bvh_distance (&bvh->nodes[near],
+                                                   query->coord1,
+                                                   query->coord2);
+      far_dist  = gimp_bezier_stroke_bvh_distance (&bvh->nodes[far],
+                                                   query->coord1,
+                                                   query->coord2);
+
+      if (far_dist < near_dist)
+        {
+          gint    tmp      = near;
+          gdouble tmp_dist = near_dist;
+
+          near      = far;
+          near_dist = far_dist;
+          far       = tmp;
+          far_dist  = tmp_dist;
+        }
+
+      if (query->dist < 0 || near_dist <= query->dist)
+        gimp_bezier_stroke_bvh_nearest_tangent (bvh, near, query);
+
+      if (query->dist < 0 || far_dist <= query->dist)
+        gimp_bezier_stroke_bvh_nearest_tangent (bvh, far, query);
+    }
+}
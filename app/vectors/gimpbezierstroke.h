@@ -33,10 +33,16 @@
 
 
 typedef struct _GimpBezierStrokeClass GimpBezierStrokeClass;
+typedef struct _GimpBezierStrokeBVH   GimpBezierStrokeBVH;
 
 struct _GimpBezierStroke
 {
-  GimpStroke  parent_instance;
+  GimpStroke           parent_instance;
+
+  /*  the control hulls of the segments, in a bounding volume hierarchy
+   *  for the nearest point queries, built when first needed
+   */
+  GimpBezierStrokeBVH *bvh;
 };
 
 struct _GimpBezierStrokeClass
@@ -62,6 +68,9 @@ void         gimp_bezier_stroke_cubicto         (GimpStroke       *bez_stroke,
                                                  const GimpCoords *control1,
                                                  const GimpCoords *control2,
                                                  const GimpCoords *end);
+void         gimp_bezier_stroke_cubicto_coords  (GimpStroke       *bez_stroke,
+                                                 const GimpCoords *coords,
+                                                 gint              n_coords);
 void         gimp_bezier_stroke_arcto           (GimpStroke       *bez_stroke,
                                                  gdouble           radius_x,
                                                  gdouble           radius_y,
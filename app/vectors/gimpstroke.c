@@ -44,6 +44,26 @@ enum
   PROP_CLOSED
 };
 
+/*  how many interpolations with different precisions a stroke keeps,
+ *  the display and the stroking code tend to ask for a few
+ */
+#define N_INTERPOLATIONS 3
+
+
+typedef struct _GimpStrokeInterpolation GimpStrokeInterpolation;
+
+struct _GimpStrokeInterpolation
+{
+  gdouble   precision;
+  GArray   *coords;
+  gboolean  closed;
+
+  gboolean  bounds_empty;
+  gdouble   x1, y1;
+  gdouble   x2, y2;
+};
+
+
 /* Prototypes */
 
 static void    gimp_stroke_set_property              (GObject      *object,
@@ -59,6 +79,11 @@ static void    gimp_stroke_finalize                  (GObject      *object);
 static gint64  gimp_stroke_get_memsize               (GimpObject   *object,
                                                       gint64       *gui_size);
 
+static GimpStrokeInterpolation *
+               gimp_stroke_get_interpolation         (const GimpStroke *stroke,
+                                                      gdouble           precision);
+static void    gimp_stroke_interpolation_free        (GimpStrokeInterpolation *interpolation);
+
 static GimpAnchor * gimp_stroke_real_anchor_get      (const GimpStroke *stroke,
                                                       const GimpCoords *coord);
 static GimpAnchor * gimp_stroke_real_anchor_get_next (const GimpStroke *stroke,
@@ -264,9 +289,10 @@ gimp_stroke_class_init (GimpStrokeClass *klass)
 static void
 gimp_stroke_init (GimpStroke *stroke)
 {
-  stroke->ID      = 0;
-  stroke->anchors = NULL;
-  stroke->closed  = FALSE;
+  stroke->ID             = 0;
+  stroke->anchors        = NULL;
+  stroke->closed         = FALSE;
+  stroke->interpolations = NULL;
 }
 
 static void
@@ -345,6 +371,8 @@ gimp_stroke_finalize (GObject *object)
       stroke->anchors = NULL;
     }
 
+  gimp_stroke_invalidate (stroke);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -354,9 +382,20 @@ gimp_stroke_get_memsize (GimpObject *object,
 {
   GimpStroke *stroke  = GIMP_STROKE (object);
   gint64      memsize = 0;
+  GList      *list;
 
   memsize += gimp_g_list_get_memsize (stroke->anchors, sizeof (GimpAnchor));
 
+  for (list = stroke->interpolations; list; list = g_list_next (list))
+    {
+      GimpStrokeInterpolation *interpolation = list->data;
+
+      memsize += sizeof (GList) + sizeof (GimpStrokeInterpolation);
+
+      if (interpolation->coords)
+        memsize += interpolation->coords->len * sizeof (GimpCoords);
+    }
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -594,6 +633,8 @@ gimp_stroke_anchor_move_relative (GimpStroke            *stroke,
 
   GIMP_STROKE_GET_CLASS (stroke)->anchor_move_relative (stroke, anchor,
                                                         delta, feature);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -619,6 +660,8 @@ gimp_stroke_anchor_move_absolute (GimpStroke            *stroke,
 
   GIMP_STROKE_GET_CLASS (stroke)->anchor_move_absolute (stroke, anchor,
                                                         coord, feature);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -664,6 +707,8 @@ gimp_stroke_point_move_relative (GimpStroke            *stroke,
   GIMP_STROKE_GET_CLASS (stroke)->point_move_relative (stroke, predec,
                                                        position, deltacoord,
                                                        feature);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 
@@ -690,6 +735,8 @@ gimp_stroke_point_move_absolute (GimpStroke            *stroke,
   GIMP_STROKE_GET_CLASS (stroke)->point_move_absolute (stroke, predec,
                                                        position, coord,
                                                        feature);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -710,6 +757,8 @@ gimp_stroke_close (GimpStroke *stroke)
   g_return_if_fail (stroke->anchors != NULL);
 
   GIMP_STROKE_GET_CLASS (stroke)->close (stroke);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -728,6 +777,8 @@ gimp_stroke_anchor_convert (GimpStroke            *stroke,
   g_return_if_fail (GIMP_IS_STROKE (stroke));
 
   GIMP_STROKE_GET_CLASS (stroke)->anchor_convert (stroke, anchor, feature);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -747,6 +798,8 @@ gimp_stroke_anchor_delete (GimpStroke *stroke,
   g_return_if_fail (anchor && anchor->type == GIMP_ANCHOR_ANCHOR);
 
   GIMP_STROKE_GET_CLASS (stroke)->anchor_delete (stroke, anchor);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -760,11 +813,17 @@ GimpStroke *
 gimp_stroke_open (GimpStroke *stroke,
                   GimpAnchor *end_anchor)
 {
+  GimpStroke *new_stroke;
+
   g_return_val_if_fail (GIMP_IS_STROKE (stroke), NULL);
   g_return_val_if_fail (end_anchor &&
                         end_anchor->type == GIMP_ANCHOR_ANCHOR, NULL);
 
-  return GIMP_STROKE_GET_CLASS (stroke)->open (stroke, end_anchor);
+  new_stroke = GIMP_STROKE_GET_CLASS (stroke)->open (stroke, end_anchor);
+
+  gimp_stroke_invalidate (stroke);
+
+  return new_stroke;
 }
 
 static GimpStroke *
@@ -802,11 +861,17 @@ gimp_stroke_anchor_insert (GimpStroke *stroke,
                            GimpAnchor *predec,
                            gdouble     position)
 {
+  GimpAnchor *anchor;
+
   g_return_val_if_fail (GIMP_IS_STROKE (stroke), NULL);
   g_return_val_if_fail (predec->type == GIMP_ANCHOR_ANCHOR, NULL);
 
-  return GIMP_STROKE_GET_CLASS (stroke)->anchor_insert (stroke,
-                                                        predec, position);
+  anchor = GIMP_STROKE_GET_CLASS (stroke)->anchor_insert (stroke,
+                                                          predec, position);
+
+  gimp_stroke_invalidate (stroke);
+
+  return anchor;
 }
 
 static GimpAnchor *
@@ -843,11 +908,17 @@ gimp_stroke_extend (GimpStroke           *stroke,
                     GimpAnchor           *neighbor,
                     GimpVectorExtendMode  extend_mode)
 {
+  GimpAnchor *anchor;
+
   g_return_val_if_fail (GIMP_IS_STROKE (stroke), NULL);
   g_return_val_if_fail (!stroke->closed, NULL);
 
-  return GIMP_STROKE_GET_CLASS (stroke)->extend (stroke, coords,
-                                                 neighbor, extend_mode);
+  anchor = GIMP_STROKE_GET_CLASS (stroke)->extend (stroke, coords,
+                                                   neighbor, extend_mode);
+
+  gimp_stroke_invalidate (stroke);
+
+  return anchor;
 }
 
 static GimpAnchor *
@@ -866,13 +937,21 @@ gimp_stroke_connect_stroke (GimpStroke *stroke,
                             GimpStroke *extension,
                             GimpAnchor *neighbor)
 {
+  gboolean success;
+
   g_return_val_if_fail (GIMP_IS_STROKE (stroke), FALSE);
   g_return_val_if_fail (GIMP_IS_STROKE (extension), FALSE);
   g_return_val_if_fail (stroke->closed == FALSE &&
                         extension->closed == FALSE, FALSE);
 
-  return GIMP_STROKE_GET_CLASS (stroke)->connect_stroke (stroke, anchor,
-                                                         extension, neighbor);
+  success = GIMP_STROKE_GET_CLASS (stroke)->connect_stroke (stroke, anchor,
+                                                            extension,
+                                                            neighbor);
+
+  gimp_stroke_invalidate (stroke);
+  gimp_stroke_invalidate (extension);
+
+  return success;
 }
 
 gboolean
@@ -899,6 +978,23 @@ gimp_stroke_real_is_empty (const GimpStroke *stroke)
   return stroke->anchors == NULL;
 }
 
+void
+gimp_stroke_invalidate (GimpStroke *stroke)
+{
+  g_return_if_fail (GIMP_IS_STROKE (stroke));
+
+  if (stroke->interpolations)
+    {
+      g_list_free_full (stroke->interpolations,
+                        (GDestroyNotify) gimp_stroke_interpolation_free);
+      stroke->interpolations = NULL;
+    }
+
+  /*  let subclasses drop what they cache  */
+  if (GIMP_STROKE_GET_CLASS (stroke)->changed)
+    GIMP_STROKE_GET_CLASS (stroke)->changed (stroke);
+}
+
 
 gdouble
 gimp_stroke_get_length (const GimpStroke *stroke,
@@ -965,10 +1061,48 @@ gimp_stroke_interpolate (const GimpStroke *stroke,
                          gdouble           precision,
                          gboolean         *ret_closed)
 {
+  GimpStrokeInterpolation *interpolation;
+
   g_return_val_if_fail (GIMP_IS_STROKE (stroke), NULL);
 
-  return GIMP_STROKE_GET_CLASS (stroke)->interpolate (stroke, precision,
-                                                      ret_closed);
+  interpolation = gimp_stroke_get_interpolation (stroke, precision);
+
+  if (ret_closed)
+    *ret_closed = interpolation->closed;
+
+  if (! interpolation->coords)
+    return NULL;
+
+  /*  callers own and may modify the array, hand out a copy  */
+  return g_array_append_vals (g_array_sized_new (FALSE, FALSE,
+                                                 sizeof (GimpCoords),
+                                                 interpolation->coords->len),
+                              interpolation->coords->data,
+                              interpolation->coords->len);
+}
+
+gboolean
+gimp_stroke_get_bounds (const GimpStroke *stroke,
+                        const gdouble     precision,
+                        gdouble          *x1,
+                        gdouble          *y1,
+                        gdouble          *x2,
+                        gdouble          *y2)
+{
+  GimpStrokeInterpolation *interpolation;
+
+  g_return_val_if_fail (GIMP_IS_STROKE (stroke), FALSE);
+  g_return_val_if_fail (x1 != NULL && y1 != NULL &&
+                        x2 != NULL && y2 != NULL, FALSE);
+
+  interpolation = gimp_stroke_get_interpolation (stroke, precision);
+
+  *x1 = interpolation->x1;
+  *y1 = interpolation->y1;
+  *x2 = interpolation->x2;
+  *y2 = interpolation->y2;
+
+  return ! interpolation->bounds_empty;
 }
 
 static GArray *
@@ -1038,6 +1172,8 @@ gimp_stroke_translate (GimpStroke *stroke,
   g_return_if_fail (GIMP_IS_STROKE (stroke));
 
   GIMP_STROKE_GET_CLASS (stroke)->translate (stroke, offset_x, offset_y);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -1065,6 +1201,8 @@ gimp_stroke_scale (GimpStroke *stroke,
   g_return_if_fail (GIMP_IS_STROKE (stroke));
 
   GIMP_STROKE_GET_CLASS (stroke)->scale (stroke, scale_x, scale_y);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -1092,6 +1230,8 @@ gimp_stroke_rotate (GimpStroke *stroke,
   g_return_if_fail (GIMP_IS_STROKE (stroke));
 
   GIMP_STROKE_GET_CLASS (stroke)->rotate (stroke, center_x, center_y, angle);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -1117,6 +1257,8 @@ gimp_stroke_flip   (GimpStroke          *stroke,
   g_return_if_fail (GIMP_IS_STROKE (stroke));
 
   GIMP_STROKE_GET_CLASS (stroke)->flip (stroke, flip_type, axis);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -1141,6 +1283,8 @@ gimp_stroke_flip_free   (GimpStroke          *stroke,
   g_return_if_fail (GIMP_IS_STROKE (stroke));
 
   GIMP_STROKE_GET_CLASS (stroke)->flip_free (stroke, x1, y1, x2, y2);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -1166,6 +1310,8 @@ gimp_stroke_transform (GimpStroke        *stroke,
   g_return_if_fail (GIMP_IS_STROKE (stroke));
 
   GIMP_STROKE_GET_CLASS (stroke)->transform (stroke, matrix);
+
+  gimp_stroke_invalidate (stroke);
 }
 
 static void
@@ -1414,3 +1560,83 @@ gimp_stroke_real_get_point_at_dist (const GimpStroke *stroke,
 
   return ret;
 }
+
+
+/*  private functions  */
+
+static GimpStrokeInterpolation *
+gimp_stroke_get_interpolation (const GimpStroke *stroke,
+                               gdouble           precision)
+{
+  /*  the cache doesn't change what the stroke looks like  */
+  GimpStroke              *mutable_stroke = (GimpStroke *) stroke;
+  GimpStrokeInterpolation *interpolation;
+  GList                   *list;
+  gint                     i;
+
+  for (list = stroke->interpolations; list; list = g_list_next (list))
+    {
+      interpolation = list->data;
+
+      if (interpolation->precision == precision)
+        {
+          /*  keep the most recently used one first  */
+          mutable_stroke->interpolations =
+            g_list_remove_link (mutable_stroke->interpolations, list);
+          mutable_stroke->interpolations =
+            g_list_concat (list, mutable_stroke->interpolations);
+
+          return interpolation;
+        }
+    }
+
+  interpolation = g_slice_new0 (GimpStrokeInterpolation);
+
+  interpolation->precision    = precision;
+  interpolation->coords       =
+    GIMP_STROKE_GET_CLASS (stroke)->interpolate (stroke, precision,
+                                                 &interpolation->closed);
+  interpolation->bounds_empty = TRUE;
+
+  if (interpolation->coords && interpolation->coords->len > 0)
+    {
+      GimpCoords *coords = (GimpCoords *) interpolation->coords->data;
+
+      interpolation->x1 = interpolation->x2 = coords[0].x;
+      interpolation->y1 = interpolation->y2 = coords[0].y;
+
+      for (i = 1; i < interpolation->coords->len; i++)
+        {
+          interpolation->x1 = MIN (interpolation->x1, coords[i].x);
+          interpolation->y1 = MIN (interpolation->y1, coords[i].y);
+          interpolation->x2 = MAX (interpolation->x2, coords[i].x);
+          interpolation->y2 = MAX (interpolation->y2, coords[i].y);
+        }
+
+      interpolation->bounds_empty = FALSE;
+    }
+
+  mutable_stroke->interpolations =
+    g_list_prepend (mutable_stroke->interpolations, interpolation);
+
+  list = g_list_nth (mutable_stroke->interpolations, N_INTERPOLATIONS);
+
+  if (list)
+    {
+      list->prev->next = NULL;
+      list->prev       = NULL;
+
+      g_list_free_full (list, (GDestroyNotify) gimp_stroke_interpolation_free);
+    }
+
+  return interpolation;
+}
+
+static void
+gimp_stroke_interpolation_free (GimpStrokeInterpolation *interpolation)
+{
+  if (interpolation->coords)
+    g_array_free (interpolation->coords, TRUE);
+
+  g_slice_free (GimpStrokeInterpolation, interpolation);
+}
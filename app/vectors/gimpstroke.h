@@ -42,6 +42,11 @@ struct _GimpStroke
   GList      *anchors;
 
   gboolean    closed;
+
+  /*  the last few results of gimp_stroke_interpolate(), most recent
+   *  first, dropped whenever the anchors change
+   */
+  GList      *interpolations;
 };
 
 struct _GimpStrokeClass
@@ -288,6 +293,11 @@ gboolean     gimp_stroke_connect_stroke       (GimpStroke            *stroke,
 
 gboolean     gimp_stroke_is_empty             (const GimpStroke      *stroke);
 
+/* drops the cached interpolations, call this after changing the
+ * anchors by other means than the functions above
+ */
+void         gimp_stroke_invalidate           (GimpStroke            *stroke);
+
 /* accessing the shape of the curve */
 
 gdouble      gimp_stroke_get_length           (const GimpStroke      *stroke,
@@ -306,6 +316,14 @@ GArray     * gimp_stroke_interpolate          (const GimpStroke      *stroke,
                                                const gdouble          precision,
                                                gboolean              *closed);
 
+/* the bounding box of the interpolated stroke */
+gboolean     gimp_stroke_get_bounds           (const GimpStroke      *stroke,
+                                               const gdouble          precision,
+                                               gdouble               *x1,
+                                               gdouble               *y1,
+                                               gdouble               *x2,
+                                               gdouble               *y2);
+
 GimpStroke * gimp_stroke_duplicate            (const GimpStroke      *stroke);
 
 /* creates a bezier approximation. */
@@ -42,6 +42,7 @@
 
 #include "config/gimpxmlparser.h"
 
+#include "core/gimpcoords.h"
 #include "core/gimperror.h"
 #include "core/gimpimage.h"
 #include "core/gimpimage-undo.h"
@@ -1356,6 +1357,7 @@ typedef struct
 {
   GList       *strokes;
   GimpStroke  *stroke;
+  GArray      *segments;  /* cubic segments not added to stroke yet      */
   gdouble      cpx, cpy;  /* current point                               */
   gdouble      rpx, rpy;  /* reflection point (for 's' and 't' commands) */
   gchar        cmd;       /* current command (lowercase)                 */
@@ -1365,10 +1367,22 @@ typedef struct
 } ParsePathContext;
 
 
-static void  parse_path_default_xy (ParsePathContext *ctx,
-                                    gint              n_params);
-static void  parse_path_do_cmd     (ParsePathContext *ctx,
-                                    gboolean          final);
+static void      parse_path_default_xy    (ParsePathContext *ctx,
+                                           gint              n_params);
+static void      parse_path_do_cmd        (ParsePathContext *ctx,
+                                           gboolean          final);
+static gboolean  parse_path_current_point (ParsePathContext *ctx,
+                                           GimpCoords       *point);
+static void      parse_path_lineto        (ParsePathContext *ctx,
+                                           const GimpCoords *end);
+static void      parse_path_conicto       (ParsePathContext *ctx,
+                                           const GimpCoords *control,
+                                           const GimpCoords *end);
+static void      parse_path_cubicto       (ParsePathContext *ctx,
+                                           const GimpCoords *control1,
+                                           const GimpCoords *control2,
+                                           const GimpCoords *end);
+static void      parse_path_flush         (ParsePathContext *ctx);
 
 
 static GList *
@@ -1390,6 +1404,8 @@ parse_path_data (const gchar *data)
 
   memset (&ctx, 0, sizeof (ParsePathContext));
 
+  ctx.segments = g_array_new (FALSE, FALSE, sizeof (GimpCoords));
+
   for (i = 0; ; i++)
     {
       c = data[i];
@@ -1516,6 +1532,8 @@ parse_path_data (const gchar *data)
           if (ctx.param)
             parse_path_do_cmd (&ctx, TRUE);
 
+          parse_path_flush (&ctx);
+
           if (ctx.stroke)
             gimp_stroke_close (ctx.stroke);
         }
@@ -1538,6 +1556,10 @@ parse_path_data (const gchar *data)
       /* else c _should_ be whitespace or , */
     }
 
+  parse_path_flush (&ctx);
+
+  g_array_free (ctx.segments, TRUE);
+
   return g_list_reverse (ctx.strokes);
 }
 
@@ -1586,6 +1608,8 @@ parse_path_do_cmd (ParsePathContext *ctx,
           coords.x = ctx->cpx = ctx->rpx = ctx->params[0];
           coords.y = ctx->cpy = ctx->rpy = ctx->params[1];
 
+          parse_path_flush (ctx);
+
           ctx->stroke = gimp_bezier_stroke_new_moveto (&coords);
           ctx->strokes = g_list_prepend (ctx->strokes, ctx->stroke);
 
@@ -1607,7 +1631,7 @@ parse_path_do_cmd (ParsePathContext *ctx,
           coords.x = ctx->cpx = ctx->rpx = ctx->params[0];
           coords.y = ctx->cpy = ctx->rpy = ctx->params[1];
 
-          gimp_bezier_stroke_lineto (ctx->stroke, &coords);
+          parse_path_lineto (ctx, &coords);
 
           ctx->param = 0;
         }
@@ -1629,7 +1653,7 @@ parse_path_do_cmd (ParsePathContext *ctx,
           coords.x = ctx->cpx = ctx->params[4];
           coords.y = ctx->cpy = ctx->params[5];
 
-          gimp_bezier_stroke_cubicto (ctx->stroke, &ctrl1, &ctrl2, &coords);
+          parse_path_cubicto (ctx, &ctrl1, &ctrl2, &coords);
 
           ctx->param = 0;
         }
@@ -1651,7 +1675,7 @@ parse_path_do_cmd (ParsePathContext *ctx,
           coords.x = ctx->cpx = ctx->params[2];
           coords.y = ctx->cpy = ctx->params[3];
 
-          gimp_bezier_stroke_cubicto (ctx->stroke, &ctrl1, &ctrl2, &coords);
+          parse_path_cubicto (ctx, &ctrl1, &ctrl2, &coords);
 
           ctx->param = 0;
         }
@@ -1664,7 +1688,7 @@ parse_path_do_cmd (ParsePathContext *ctx,
           coords.x = ctx->cpx = ctx->rpx = ctx->params[0];
           coords.y = ctx->cpy;
 
-          gimp_bezier_stroke_lineto (ctx->stroke, &coords);
+          parse_path_lineto (ctx, &coords);
 
           ctx->param = 0;
         }
@@ -1677,7 +1701,7 @@ parse_path_do_cmd (ParsePathContext *ctx,
           coords.x = ctx->cpx;
           coords.y = ctx->cpy = ctx->rpy = ctx->params[0];
 
-          gimp_bezier_stroke_lineto (ctx->stroke, &coords);
+          parse_path_lineto (ctx, &coords);
 
           ctx->param = 0;
         }
@@ -1696,7 +1720,7 @@ parse_path_do_cmd (ParsePathContext *ctx,
           coords.x = ctx->cpx = ctx->params[2];
           coords.y = ctx->cpy = ctx->params[3];
 
-          gimp_bezier_stroke_conicto (ctx->stroke, &ctrl, &coords);
+          parse_path_conicto (ctx, &ctrl, &coords);
 
           ctx->param = 0;
         }
@@ -1715,7 +1739,7 @@ parse_path_do_cmd (ParsePathContext *ctx,
           coords.x = ctx->cpx = ctx->params[0];
           coords.y = ctx->cpy = ctx->params[1];
 
-          gimp_bezier_stroke_conicto (ctx->stroke, &ctrl, &coords);
+          parse_path_conicto (ctx, &ctrl, &coords);
 
           ctx->param = 0;
         }
@@ -1732,7 +1756,7 @@ parse_path_do_cmd (ParsePathContext *ctx,
               coords.x = ctx->cpx = ctx->params[2];
               coords.y = ctx->cpy = ctx->params[3];
 
-              gimp_bezier_stroke_conicto (ctx->stroke, &ctrl, &coords);
+              parse_path_conicto (ctx, &ctrl, &coords);
             }
           else
             {
@@ -1741,7 +1765,7 @@ parse_path_do_cmd (ParsePathContext *ctx,
               coords.x = ctx->cpx = ctx->rpx = ctx->params[0];
               coords.y = ctx->cpy = ctx->rpy = ctx->params[1];
 
-              gimp_bezier_stroke_lineto (ctx->stroke, &coords);
+              parse_path_lineto (ctx, &coords);
             }
 
           ctx->param = 0;
@@ -1754,6 +1778,8 @@ parse_path_do_cmd (ParsePathContext *ctx,
           coords.x = ctx->cpx = ctx->rpx = ctx->params[5];
           coords.y = ctx->cpy = ctx->rpy = ctx->params[6];
 
+          parse_path_flush (ctx);
+
           gimp_bezier_stroke_arcto (ctx->stroke,
                                     ctx->params[0], ctx->params[1],
                                     gimp_deg_to_rad (ctx->params[2]),
@@ -1768,3 +1794,80 @@ parse_path_do_cmd (ParsePathContext *ctx,
       break;
     }
 }
+
+/*  the drawing commands collect the segments of a subpath as cubic
+ *  segments, they are added to the stroke in one go when it ends
+ */
+static gboolean
+parse_path_current_point (ParsePathContext *ctx,
+                          GimpCoords       *point)
+{
+  if (ctx->segments->len > 0)
+    {
+      *point = g_array_index (ctx->segments, GimpCoords,
+                              ctx->segments->len - 1);
+    }
+  else if (ctx->stroke && ctx->stroke->anchors && ctx->stroke->anchors->next)
+    {
+      *point = GIMP_ANCHOR (ctx->stroke->anchors->next->data)->position;
+    }
+  else
+    {
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+parse_path_lineto (ParsePathContext *ctx,
+                   const GimpCoords *end)
+{
+  GimpCoords start;
+
+  if (parse_path_current_point (ctx, &start))
+    parse_path_cubicto (ctx, &start, end, end);
+}
+
+static void
+parse_path_conicto (ParsePathContext *ctx,
+                    const GimpCoords *control,
+                    const GimpCoords *end)
+{
+  GimpCoords start;
+  GimpCoords control1;
+  GimpCoords control2;
+
+  if (parse_path_current_point (ctx, &start))
+    {
+      gimp_coords_mix (2.0 / 3.0, control, 1.0 / 3.0, &start, &control1);
+      gimp_coords_mix (2.0 / 3.0, control, 1.0 / 3.0, end,    &control2);
+
+      parse_path_cubicto (ctx, &control1, &control2, end);
+    }
+}
+
+static void
+parse_path_cubicto (ParsePathContext *ctx,
+                    const GimpCoords *control1,
+                    const GimpCoords *control2,
+                    const GimpCoords *end)
+{
+  if (! ctx->stroke)
+    return;
+
+  g_array_append_vals (ctx->segments, control1, 1);
+  g_array_append_vals (ctx->segments, control2, 1);
+  g_array_append_vals (ctx->segments, end,      1);
+}
+
+static void
+parse_path_flush (ParsePathContext *ctx)
+{
+  if (ctx->stroke && ctx->segments->len > 0)
+    gimp_bezier_stroke_cubicto_coords (ctx->stroke,
+                                       (GimpCoords *) ctx->segments->data,
+                                       ctx->segments->len);
+
+  g_array_set_size (ctx->segments, 0);
+}
@@ -618,6 +618,14 @@ gimp_vectors_to_selection (GimpItem       *item,
 static void
 gimp_vectors_real_freeze (GimpVectors *vectors)
 {
+  GList *list;
+
+  /*  release the strokes' cached interpolations, the anchors are
+   *  about to change
+   */
+  for (list = vectors->strokes; list; list = g_list_next (list))
+    gimp_stroke_invalidate (list->data);
+
   /*  release cached bezier representation  */
   if (vectors->bezier_desc)
     {
@@ -1054,37 +1062,26 @@ gimp_vectors_bounds (GimpVectors *vectors,
            stroke;
            stroke = gimp_vectors_stroke_get_next (vectors, stroke))
         {
-          GArray   *stroke_coords;
-          gboolean  closed;
+          gdouble sx1, sy1, sx2, sy2;
 
-          stroke_coords = gimp_stroke_interpolate (stroke, 1.0, &closed);
+          if (! gimp_stroke_get_bounds (stroke, 1.0, &sx1, &sy1, &sx2, &sy2))
+            continue;
 
-          if (stroke_coords)
+          if (vectors->bounds_empty)
             {
-              GimpCoords point;
-              gint       i;
-
-              if (vectors->bounds_empty && stroke_coords->len > 0)
-                {
-                  point = g_array_index (stroke_coords, GimpCoords, 0);
-
-                  vectors->bounds_x1 = vectors->bounds_x2 = point.x;
-                  vectors->bounds_y1 = vectors->bounds_y2 = point.y;
+              vectors->bounds_x1 = sx1;
+              vectors->bounds_y1 = sy1;
+              vectors->bounds_x2 = sx2;
+              vectors->bounds_y2 = sy2;
 
-                  vectors->bounds_empty = FALSE;
-                }
-
-              for (i = 0; i < stroke_coords->len; i++)
-                {
-                  point = g_array_index (stroke_coords, GimpCoords, i);
-
-                  vectors->bounds_x1 = MIN (vectors->bounds_x1, point.x);
-                  vectors->bounds_y1 = MIN (vectors->bounds_y1, point.y);
-                  vectors->bounds_x2 = MAX (vectors->bounds_x2, point.x);
-                  vectors->bounds_y2 = MAX (vectors->bounds_y2, point.y);
-                }
-
-              g_array_free (stroke_coords, TRUE);
+              vectors->bounds_empty = FALSE;
+            }
+          else
+            {
+              vectors->bounds_x1 = MIN (vectors->bounds_x1, sx1);
+              vectors->bounds_y1 = MIN (vectors->bounds_y1, sy1);
+              vectors->bounds_x2 = MAX (vectors->bounds_x2, sx2);
+              vectors->bounds_y2 = MAX (vectors->bounds_y2, sy2);
             }
         }
 
@@ -217,6 +217,8 @@ gimp_action_view_new (GimpUIManager *manager,
 
   accel_group = gtk_ui_manager_get_accel_group (GTK_UI_MANAGER (manager));
 
+  gimp_ui_manager_ensure_action_groups (manager);
+
   for (list = gtk_ui_manager_get_action_groups (GTK_UI_MANAGER (manager));
        list;
        list = g_list_next (list))
@@ -627,7 +627,9 @@ gimp_container_icon_view_button_press (GtkWidget             *widget,
                                        GdkEventButton        *bevent,
                                        GimpContainerIconView *icon_view)
 {
-  GtkTreePath *path;
+  GimpContainerView *container_view = GIMP_CONTAINER_VIEW (icon_view);
+  GtkTreePath       *path;
+  gboolean           handled        = FALSE;
 
   icon_view->priv->dnd_renderer = NULL;
 
@@ -647,12 +649,38 @@ gimp_container_icon_view_button_press (GtkWidget             *widget,
 
       icon_view->priv->dnd_renderer = renderer;
 
+      if (gdk_event_triggers_context_menu ((GdkEvent *) bevent))
+        {
+          /*  ref the view because calling gimp_container_view_item_selected()
+           *  may destroy the widget
+           */
+          g_object_ref (icon_view);
+
+          if (gimp_container_view_item_selected (container_view,
+                                                 renderer->viewable))
+            {
+              if (gimp_container_view_get_container (container_view))
+                gimp_container_view_item_context (container_view,
+                                                  renderer->viewable);
+            }
+
+          g_object_unref (icon_view);
+
+          handled = TRUE;
+        }
+
       g_object_unref (renderer);
 
       gtk_tree_path_free (path);
     }
+  else if (gdk_event_triggers_context_menu ((GdkEvent *) bevent))
+    {
+      gimp_editor_popup_menu (GIMP_EDITOR (icon_view), NULL, NULL);
+
+      handled = TRUE;
+    }
 
-  return FALSE;
+  return handled;
 }
 
 static gboolean
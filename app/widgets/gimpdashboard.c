@@ -0,0 +1,476 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995-1999 Spencer Kimball and Peter Mattis
+ *
+ * gimpdashboard.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "libgimpwidgets/gimpwidgets.h"
+
+#include "widgets-types.h"
+
+#include "base/tile-cache.h"
+#include "base/tile-swap.h"
+
+#include "core/gimp.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-undo.h"
+#include "core/gimpprojection.h"
+#include "core/gimpundostack.h"
+
+#include "gimpdashboard.h"
+
+#include "gimp-intl.h"
+
+
+#define UPDATE_INTERVAL 500 /* milliseconds between two samples */
+#define GRAPH_HEIGHT    40
+
+
+enum
+{
+  PROP_0,
+  PROP_GIMP
+};
+
+
+static void       gimp_dashboard_dispose        (GObject        *object);
+static void       gimp_dashboard_set_property   (GObject        *object,
+                                                 guint           property_id,
+                                                 const GValue   *value,
+                                                 GParamSpec     *pspec);
+
+static void       gimp_dashboard_map            (GtkWidget      *widget);
+static void       gimp_dashboard_unmap          (GtkWidget      *widget);
+
+static gboolean   gimp_dashboard_sample         (GimpDashboard  *dashboard);
+static void       gimp_dashboard_update_labels  (GimpDashboard  *dashboard);
+static gboolean   gimp_dashboard_graph_expose   (GtkWidget      *widget,
+                                                 GdkEventExpose *event,
+                                                 GimpDashboard  *dashboard);
+
+
+G_DEFINE_TYPE (GimpDashboard, gimp_dashboard, GIMP_TYPE_EDITOR)
+
+#define parent_class gimp_dashboard_parent_class
+
+
+static const gchar * const graph_names[GIMP_DASHBOARD_N_GRAPHS] =
+{
+  N_("Tile Cache"),
+  N_("Swap"),
+  N_("Undo Memory"),
+  N_("Render Backlog")
+};
+
+
+static void
+gimp_dashboard_class_init (GimpDashboardClass *klass)
+{
+  GObjectClass   *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->dispose      = gimp_dashboard_dispose;
+  object_class->set_property = gimp_dashboard_set_property;
+
+  widget_class->map          = gimp_dashboard_map;
+  widget_class->unmap        = gimp_dashboard_unmap;
+
+  g_object_class_install_property (object_class, PROP_GIMP,
+                                   g_param_spec_object ("gimp", NULL, NULL,
+                                                        GIMP_TYPE_GIMP,
+                                                        GIMP_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY));
+}
+
+static void
+gimp_dashboard_init (GimpDashboard *dashboard)
+{
+  GtkWidget *vbox;
+  gint       i;
+
+  vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 4);
+  gtk_container_set_border_width (GTK_CONTAINER (vbox), 2);
+  gtk_box_pack_start (GTK_BOX (dashboard), vbox, TRUE, TRUE, 0);
+  gtk_widget_show (vbox);
+
+  for (i = 0; i < GIMP_DASHBOARD_N_GRAPHS; i++)
+    {
+      GimpDashboardGraph *graph = &dashboard->graphs[i];
+      GtkWidget          *frame;
+
+      graph->label = gtk_label_new (gettext (graph_names[i]));
+      gtk_misc_set_alignment (GTK_MISC (graph->label), 0.0, 0.5);
+      gtk_label_set_ellipsize (GTK_LABEL (graph->label), PANGO_ELLIPSIZE_END);
+      gimp_label_set_attributes (GTK_LABEL (graph->label),
+                                 PANGO_ATTR_SCALE, PANGO_SCALE_SMALL,
+                                 -1);
+      gtk_box_pack_start (GTK_BOX (vbox), graph->label, FALSE, FALSE, 0);
+      gtk_widget_show (graph->label);
+
+      frame = gtk_frame_new (NULL);
+      gtk_frame_set_shadow_type (GTK_FRAME (frame), GTK_SHADOW_IN);
+      gtk_box_pack_start (GTK_BOX (vbox), frame, FALSE, FALSE, 0);
+      gtk_widget_show (frame);
+
+      graph->area = gtk_drawing_area_new ();
+      gtk_widget_set_size_request (graph->area, -1, GRAPH_HEIGHT);
+      gtk_container_add (GTK_CONTAINER (frame), graph->area);
+      gtk_widget_show (graph->area);
+
+      g_signal_connect (graph->area, "expose-event",
+                        G_CALLBACK (gimp_dashboard_graph_expose),
+                        dashboard);
+    }
+
+  /*  GEGL has no API to query how much of its cache is in use, so
+   *  only its limit is shown
+   */
+  dashboard->gegl_label = gtk_label_new (NULL);
+  gtk_misc_set_alignment (GTK_MISC (dashboard->gegl_label), 0.0, 0.5);
+  gimp_label_set_attributes (GTK_LABEL (dashboard->gegl_label),
+                             PANGO_ATTR_SCALE, PANGO_SCALE_SMALL,
+                             -1);
+  gtk_box_pack_start (GTK_BOX (vbox), dashboard->gegl_label, FALSE, FALSE, 0);
+  gtk_widget_show (dashboard->gegl_label);
+
+  dashboard->dedup_label = gtk_label_new (NULL);
+  gtk_misc_set_alignment (GTK_MISC (dashboard->dedup_label), 0.0, 0.5);
+  gimp_label_set_attributes (GTK_LABEL (dashboard->dedup_label),
+                             PANGO_ATTR_SCALE, PANGO_SCALE_SMALL,
+                             -1);
+  gtk_box_pack_start (GTK_BOX (vbox), dashboard->dedup_label, FALSE, FALSE, 0);
+  gtk_widget_show (dashboard->dedup_label);
+}
+
+static void
+gimp_dashboard_dispose (GObject *object)
+{
+  GimpDashboard *dashboard = GIMP_DASHBOARD (object);
+
+  if (dashboard->timeout_id)
+    {
+      g_source_remove (dashboard->timeout_id);
+      dashboard->timeout_id = 0;
+    }
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gimp_dashboard_set_property (GObject      *object,
+                             guint         property_id,
+                             const GValue *value,
+                             GParamSpec   *pspec)
+{
+  GimpDashboard *dashboard = GIMP_DASHBOARD (object);
+
+  switch (property_id)
+    {
+    case PROP_GIMP:
+      dashboard->gimp = g_value_get_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+    }
+}
+
+static void
+gimp_dashboard_map (GtkWidget *widget)
+{
+  GimpDashboard *dashboard = GIMP_DASHBOARD (widget);
+
+  GTK_WIDGET_CLASS (parent_class)->map (widget);
+
+  /*  only sample while the dashboard can actually be seen  */
+  if (! dashboard->timeout_id)
+    {
+      gimp_dashboard_sample (dashboard);
+
+      dashboard->timeout_id =
+        g_timeout_add (UPDATE_INTERVAL,
+                       (GSourceFunc) gimp_dashboard_sample,
+                       dashboard);
+    }
+}
+
+static void
+gimp_dashboard_unmap (GtkWidget *widget)
+{
+  GimpDashboard *dashboard = GIMP_DASHBOARD (widget);
+
+  if (dashboard->timeout_id)
+    {
+      g_source_remove (dashboard->timeout_id);
+      dashboard->timeout_id = 0;
+    }
+
+  GTK_WIDGET_CLASS (parent_class)->unmap (widget);
+}
+
+
+/*  public functions  */
+
+GtkWidget *
+gimp_dashboard_new (Gimp *gimp)
+{
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
+
+  return g_object_new (GIMP_TYPE_DASHBOARD,
+                       "gimp", gimp,
+                       NULL);
+}
+
+
+/*  private functions  */
+
+static gboolean
+gimp_dashboard_sample (GimpDashboard *dashboard)
+{
+  gdouble  values[GIMP_DASHBOARD_N_GRAPHS];
+  guint64  cache_size;
+  guint64  cache_max;
+  guint64  dirty_size;
+  guint64  swap_file_size;
+  guint64  swap_used;
+  gint64   undo_size = 0;
+  gint64   backlog   = 0;
+  GList   *list;
+  gint     i;
+
+  tile_cache_get_usage (&cache_size, &cache_max, &dirty_size);
+  tile_swap_get_usage (&swap_file_size, &swap_used,
+                       &dashboard->n_swap_ins, &dashboard->n_swap_outs);
+  tile_cache_get_dedup_stats (&dashboard->dedup_saved,
+                              &dashboard->n_dedup_shared);
+
+  for (list = gimp_get_image_iter (dashboard->gimp);
+       list;
+       list = g_list_next (list))
+    {
+      GimpImage *image = list->data;
+
+      undo_size +=
+        gimp_object_get_memsize (GIMP_OBJECT (gimp_image_get_undo_stack (image)),
+                                 NULL);
+      undo_size +=
+        gimp_object_get_memsize (GIMP_OBJECT (gimp_image_get_redo_stack (image)),
+                                 NULL);
+
+      backlog +=
+        gimp_projection_get_render_backlog (gimp_image_get_projection (image));
+    }
+
+  values[GIMP_DASHBOARD_TILE_CACHE]     = cache_size;
+  values[GIMP_DASHBOARD_SWAP]           = swap_used;
+  values[GIMP_DASHBOARD_UNDO]           = undo_size;
+  values[GIMP_DASHBOARD_RENDER_BACKLOG] = backlog;
+
+  dashboard->graphs[GIMP_DASHBOARD_TILE_CACHE].limit = cache_max;
+  dashboard->graphs[GIMP_DASHBOARD_SWAP].limit       = swap_file_size;
+
+  dashboard->last_sample = ((dashboard->last_sample + 1) %
+                            GIMP_DASHBOARD_N_SAMPLES);
+  dashboard->n_samples   = MIN (dashboard->n_samples + 1,
+                                GIMP_DASHBOARD_N_SAMPLES);
+
+  for (i = 0; i < GIMP_DASHBOARD_N_GRAPHS; i++)
+    {
+      GimpDashboardGraph *graph = &dashboard->graphs[i];
+
+      graph->samples[dashboard->last_sample] = values[i];
+
+      gtk_widget_queue_draw (graph->area);
+    }
+
+  gimp_dashboard_update_labels (dashboard);
+
+  return TRUE;
+}
+
+static void
+gimp_dashboard_update_labels (GimpDashboard *dashboard)
+{
+  gint  i;
+
+  for (i = 0; i < GIMP_DASHBOARD_N_GRAPHS; i++)
+    {
+      GimpDashboardGraph *graph = &dashboard->graphs[i];
+      gdouble             value = graph->samples[dashboard->last_sample];
+      gchar              *text;
+
+      if (i == GIMP_DASHBOARD_RENDER_BACKLOG)
+        {
+          text = g_strdup_printf (_("%s: %.1f megapixels"),
+                                  gettext (graph_names[i]),
+                                  value / 1000000.0);
+        }
+      else if (i == GIMP_DASHBOARD_SWAP)
+        {
+          gchar *size  = g_format_size ((guint64) value);
+          gchar *limit = g_format_size ((guint64) graph->limit);
+
+          text = g_strdup_printf (_("%s: %s of %s (%lu in, %lu out)"),
+                                  gettext (graph_names[i]), size, limit,
+                                  dashboard->n_swap_ins,
+                                  dashboard->n_swap_outs);
+
+          g_free (size);
+          g_free (limit);
+        }
+      else if (graph->limit > 0.0)
+        {
+          gchar *size  = g_format_size ((guint64) value);
+          gchar *limit = g_format_size ((guint64) graph->limit);
+
+          text = g_strdup_printf (_("%s: %s of %s"),
+                                  gettext (graph_names[i]), size, limit);
+
+          g_free (size);
+          g_free (limit);
+        }
+      else
+        {
+          gchar *size = g_format_size ((guint64) value);
+
+          text = g_strdup_printf ("%s: %s", gettext (graph_names[i]), size);
+
+          g_free (size);
+        }
+
+      gtk_label_set_text (GTK_LABEL (graph->label), text);
+      g_free (text);
+    }
+
+  {
+    gint   gegl_cache_size;
+    gchar *size;
+    gchar *text;
+
+    g_object_get (gegl_config (), "cache-size", &gegl_cache_size, NULL);
+
+    size = g_format_size (gegl_cache_size);
+    text = g_strdup_printf (_("GEGL cache limit: %s"), size);
+
+    gtk_label_set_text (GTK_LABEL (dashboard->gegl_label), text);
+
+    g_free (size);
+    g_free (text);
+  }
+
+  {
+    gchar *size;
+    gchar *text;
+
+    size = g_format_size (dashboard->dedup_saved);
+    text = g_strdup_printf (_("Shared tiles: %lu, saving %s"),
+                            dashboard->n_dedup_shared, size);
+
+    gtk_label_set_text (GTK_LABEL (dashboard->dedup_label), text);
+
+    g_free (size);
+    g_free (text);
+  }
+}
+
+static gboolean
+gimp_dashboard_graph_expose (GtkWidget      *widget,
+                             GdkEventExpose *event,
+                             GimpDashboard  *dashboard)
+{
+  GimpDashboardGraph *graph = NULL;
+  GtkStyle           *style = gtk_widget_get_style (widget);
+  GtkAllocation       allocation;
+  cairo_t            *cr;
+  gdouble             max;
+  gint                i;
+
+  for (i = 0; i < GIMP_DASHBOARD_N_GRAPHS; i++)
+    {
+      if (dashboard->graphs[i].area == widget)
+        {
+          graph = &dashboard->graphs[i];
+          break;
+        }
+    }
+
+  g_return_val_if_fail (graph != NULL, FALSE);
+
+  gtk_widget_get_allocation (widget, &allocation);
+
+  cr = gdk_cairo_create (gtk_widget_get_window (widget));
+
+  gdk_cairo_region (cr, event->region);
+  cairo_clip (cr);
+
+  gdk_cairo_set_source_color (cr, &style->base[GTK_STATE_NORMAL]);
+  cairo_paint (cr);
+
+  if (dashboard->n_samples == 0)
+    {
+      cairo_destroy (cr);
+      return FALSE;
+    }
+
+  /*  scale to the variable's limit if it has one, otherwise to the
+   *  largest sample in the history
+   */
+  max = graph->limit;
+
+  for (i = 0; i < dashboard->n_samples; i++)
+    max = MAX (max, graph->samples[i]);
+
+  if (max <= 0.0)
+    max = 1.0;
+
+  /*  the newest sample is at the right edge  */
+  cairo_move_to (cr, allocation.width, allocation.height);
+
+  for (i = 0; i < dashboard->n_samples; i++)
+    {
+      gint    index = ((dashboard->last_sample - i + GIMP_DASHBOARD_N_SAMPLES) %
+                       GIMP_DASHBOARD_N_SAMPLES);
+      gdouble x     = (allocation.width *
+                       (GIMP_DASHBOARD_N_SAMPLES - 1 - i) /
+                       (gdouble) (GIMP_DASHBOARD_N_SAMPLES - 1));
+      gdouble y     = (allocation.height *
+                       (1.0 - graph->samples[index] / max));
+
+      cairo_line_to (cr, x, y);
+
+      if (i == dashboard->n_samples - 1)
+        cairo_line_to (cr, x, allocation.height);
+    }
+
+  cairo_close_path (cr);
+
+  gdk_cairo_set_source_color (cr, &style->text_aa[GTK_STATE_NORMAL]);
+  cairo_fill_preserve (cr);
+
+  cairo_set_line_width (cr, 1.0);
+  gdk_cairo_set_source_color (cr, &style->text[GTK_STATE_NORMAL]);
+  cairo_stroke (cr);
+
+  cairo_destroy (cr);
+
+  return FALSE;
+}
@@ -0,0 +1,93 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpdashboard.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_DASHBOARD_H__
+#define __GIMP_DASHBOARD_H__
+
+
+#include "gimpeditor.h"
+
+
+#define GIMP_DASHBOARD_N_SAMPLES 120
+
+
+#define GIMP_TYPE_DASHBOARD            (gimp_dashboard_get_type ())
+#define GIMP_DASHBOARD(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_DASHBOARD, GimpDashboard))
+#define GIMP_DASHBOARD_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GIMP_TYPE_DASHBOARD, GimpDashboardClass))
+#define GIMP_IS_DASHBOARD(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_DASHBOARD))
+#define GIMP_IS_DASHBOARD_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GIMP_TYPE_DASHBOARD))
+#define GIMP_DASHBOARD_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GIMP_TYPE_DASHBOARD, GimpDashboardClass))
+
+
+typedef enum
+{
+  GIMP_DASHBOARD_TILE_CACHE,
+  GIMP_DASHBOARD_SWAP,
+  GIMP_DASHBOARD_UNDO,
+  GIMP_DASHBOARD_RENDER_BACKLOG,
+
+  GIMP_DASHBOARD_N_GRAPHS
+} GimpDashboardGraphType;
+
+
+typedef struct _GimpDashboardGraph GimpDashboardGraph;
+typedef struct _GimpDashboardClass GimpDashboardClass;
+
+struct _GimpDashboardGraph
+{
+  GtkWidget *label;
+  GtkWidget *area;
+
+  gdouble    samples[GIMP_DASHBOARD_N_SAMPLES];
+  gdouble    limit;   /*  0.0 if the variable has no upper bound  */
+};
+
+struct _GimpDashboard
+{
+  GimpEditor          parent_instance;
+
+  Gimp               *gimp;
+
+  GimpDashboardGraph  graphs[GIMP_DASHBOARD_N_GRAPHS];
+  GtkWidget          *gegl_label;
+  GtkWidget          *dedup_label;
+
+  gulong              n_swap_ins;
+  gulong              n_swap_outs;
+  guint64             dedup_saved;
+  gulong              n_dedup_shared;
+
+  gint                n_samples;
+  gint                last_sample;
+
+  guint               timeout_id;
+};
+
+struct _GimpDashboardClass
+{
+  GimpEditorClass  parent_class;
+};
+
+
+GType       gimp_dashboard_get_type (void) G_GNUC_CONST;
+
+GtkWidget * gimp_dashboard_new      (Gimp *gimp);
+
+
+#endif  /*  __GIMP_DASHBOARD_H__  */
@@ -127,6 +127,8 @@ static void            gimp_dock_window_style_set                 (GtkWidget
                                                                    GtkStyle                   *prev_style);
 static gboolean        gimp_dock_window_delete_event              (GtkWidget                  *widget,
                                                                    GdkEventAny                *event);
+static gboolean        gimp_dock_window_key_press_event           (GtkWidget                  *widget,
+                                                                   GdkEventKey                *kevent);
 static GList         * gimp_dock_window_get_docks                 (GimpDockContainer          *dock_container);
 static GimpUIManager * gimp_dock_window_get_ui_manager            (GimpDockContainer          *dock_container);
 static void            gimp_dock_window_add_dock_from_session     (GimpDockContainer          *dock_container,
@@ -185,8 +187,9 @@ gimp_dock_window_class_init (GimpDockWindowClass *klass)
   object_class->set_property = gimp_dock_window_set_property;
   object_class->get_property = gimp_dock_window_get_property;
 
-  widget_class->style_set    = gimp_dock_window_style_set;
-  widget_class->delete_event = gimp_dock_window_delete_event;
+  widget_class->style_set       = gimp_dock_window_style_set;
+  widget_class->delete_event    = gimp_dock_window_delete_event;
+  widget_class->key_press_event = gimp_dock_window_key_press_event;
 
   g_object_class_install_property (object_class, PROP_CONTEXT,
                                    g_param_spec_object ("context", NULL, NULL,
@@ -699,6 +702,22 @@ gimp_dock_window_delete_event (GtkWidget   *widget,
   return FALSE;
 }
 
+static gboolean
+gimp_dock_window_key_press_event (GtkWidget   *widget,
+                                  GdkEventKey *kevent)
+{
+  GimpDockWindow *dock_window = GIMP_DOCK_WINDOW (widget);
+
+  /*  the action groups of the image window's shortcuts are created
+   *  when they are first used, make sure the pressed one exists
+   */
+  if (gimp_ui_manager_ensure_accel_groups (dock_window->p->ui_manager, kevent))
+    gimp_ui_manager_update (dock_window->p->ui_manager,
+                            gimp_context_get_display (dock_window->p->context));
+
+  return GTK_WIDGET_CLASS (parent_class)->key_press_event (widget, kevent);
+}
+
 static GList *
 gimp_dock_window_get_docks (GimpDockContainer *dock_container)
 {
@@ -423,6 +423,8 @@
 #define GIMP_HELP_TOOL_OPTIONS_DELETE             "gimp-tool-options-delete"
 #define GIMP_HELP_TOOL_OPTIONS_RESET              "gimp-tool-options-reset"
 
+#define GIMP_HELP_DASHBOARD_DIALOG                "gimp-dashboard-dialog"
+
 #define GIMP_HELP_ERRORS_DIALOG                   "gimp-errors-dialog"
 #define GIMP_HELP_ERRORS_CLEAR                    "gimp-errors-clear"
 #define GIMP_HELP_ERRORS_SAVE                     "gimp-errors-save"
@@ -461,6 +463,7 @@
 #define GIMP_HELP_PREFS_FOLDERS_INTERPRETERS      "gimp-prefs-folders-interpreters"
 #define GIMP_HELP_PREFS_FOLDERS_ENVIRONMENT       "gimp-prefs-folders-environment"
 #define GIMP_HELP_PREFS_FOLDERS_THEMES            "gimp-prefs-folders-themes"
+#define GIMP_HELP_PREFS_FOLDERS_SWAP              "gimp-prefs-folders-swap"
 
 #define GIMP_HELP_INPUT_DEVICES                   "gimp-help-input-devices"
 #define GIMP_HELP_KEYBOARD_SHORTCUTS              "gimp-help-keyboard-shortcuts"
@@ -455,6 +455,8 @@ gimp_thumb_box_take_uri (GimpThumbBox *box,
       box->idle_id = 0;
     }
 
+  gimp_imagefile_cancel_thumbnail (box->imagefile);
+
   gimp_object_take_name (GIMP_OBJECT (box->imagefile), uri);
 
   if (uri)
@@ -741,10 +743,10 @@ gimp_thumb_box_auto_thumbnail (GimpThumbBox *box)
                                   _("Creating preview..."));
             }
 
-          gimp_imagefile_create_thumbnail_weak (box->imagefile, box->context,
-                                                GIMP_PROGRESS (box),
-                                                gimp->config->thumbnail_size,
-                                                TRUE);
+          gimp_imagefile_queue_thumbnail (box->imagefile,
+                                          gimp->config->thumbnail_size,
+                                          TRUE,
+                                          GIMP_IMAGEFILE_THUMBNAIL_PRIORITY_SELECTED);
         }
       break;
 
@@ -35,6 +35,7 @@
 #include "core/gimp.h"
 #include "core/gimpmarshal.h"
 
+#include "gimpactionfactory.h"
 #include "gimpactiongroup.h"
 #include "gimphelp.h"
 #include "gimphelp-ids.h"
@@ -59,6 +60,16 @@ enum
 };
 
 
+typedef struct _GimpUIManagerGroupEntry GimpUIManagerGroupEntry;
+
+struct _GimpUIManagerGroupEntry
+{
+  gchar             *name;
+  GimpActionFactory *factory;
+  gpointer           callback_data;
+};
+
+
 static void       gimp_ui_manager_constructed         (GObject        *object);
 static void       gimp_ui_manager_dispose             (GObject        *object);
 static void       gimp_ui_manager_finalize            (GObject        *object);
@@ -108,6 +119,25 @@ static void       gimp_ui_manager_menu_item_deselect  (GtkWidget      *widget,
 static gboolean   gimp_ui_manager_item_key_press      (GtkWidget      *widget,
                                                        GdkEventKey    *kevent,
                                                        GimpUIManager  *manager);
+static GimpActionGroup *
+                  gimp_ui_manager_group_insert        (GimpUIManager     *manager,
+                                                       GimpActionFactory *factory,
+                                                       const gchar       *name,
+                                                       gpointer           callback_data);
+static GimpActionGroup *
+                  gimp_ui_manager_group_create        (GimpUIManager  *manager,
+                                                       const gchar    *name);
+static void       gimp_ui_manager_group_entry_free    (GimpUIManagerGroupEntry *entry);
+static void       gimp_ui_manager_accel_groups_clear  (void);
+static void       gimp_ui_manager_accel_map_changed   (GtkAccelMap    *accel_map,
+                                                       const gchar    *accel_path,
+                                                       guint           accel_key,
+                                                       GdkModifierType accel_mods);
+static void       gimp_ui_manager_accel_groups_add    (gpointer        data,
+                                                       const gchar    *accel_path,
+                                                       guint           accel_key,
+                                                       GdkModifierType accel_mods,
+                                                       gboolean        changed);
 static GtkWidget *find_widget_under_pointer           (GdkWindow      *window,
                                                        gint           *x,
                                                        gint           *y);
@@ -119,6 +149,16 @@ G_DEFINE_TYPE (GimpUIManager, gimp_ui_manager, GTK_TYPE_UI_MANAGER)
 
 static guint manager_signals[LAST_SIGNAL] = { 0 };
 
+/*  the names of all action groups that have been created at least
+ *  once, and whose accelerators are therefore in the GtkAccelMap
+ */
+static GHashTable *created_groups = NULL;
+
+/*  maps lower-case accelerator keys to the names of the action groups
+ *  using them, built from the GtkAccelMap when it is needed
+ */
+static GHashTable *accel_groups   = NULL;
+
 
 static void
 gimp_ui_manager_class_init (GimpUIManagerClass *klass)
@@ -184,6 +224,10 @@ gimp_ui_manager_class_init (GimpUIManagerClass *klass)
 
   klass->managers = g_hash_table_new_full (g_str_hash, g_str_equal,
                                            g_free, NULL);
+
+  g_signal_connect (gtk_accel_map_get (), "changed",
+                    G_CALLBACK (gimp_ui_manager_accel_map_changed),
+                    NULL);
 }
 
 static void
@@ -268,6 +312,10 @@ gimp_ui_manager_finalize (GObject *object)
   g_list_free (manager->registered_uis);
   manager->registered_uis = NULL;
 
+  g_list_free_full (manager->pending_groups,
+                    (GDestroyNotify) gimp_ui_manager_group_entry_free);
+  manager->pending_groups = NULL;
+
   if (manager->name)
     {
       g_free (manager->name);
@@ -443,6 +491,48 @@ gimp_ui_manager_update (GimpUIManager *manager,
   g_signal_emit (manager, manager_signals[UPDATE], 0, update_data);
 }
 
+/**
+ * gimp_ui_manager_add_action_group:
+ * @manager:       a #GimpUIManager
+ * @factory:       the #GimpActionFactory to create the group with
+ * @name:          the name of the action group
+ * @callback_data: the data passed to the group's actions
+ *
+ * Adds the action group @name to @manager. The group is only created
+ * when it is first asked for, when @manager builds its widgets, or
+ * when one of its accelerators is pressed, see
+ * gimp_ui_manager_ensure_accel_groups().
+ **/
+void
+gimp_ui_manager_add_action_group (GimpUIManager     *manager,
+                                  GimpActionFactory *factory,
+                                  const gchar       *name,
+                                  gpointer           callback_data)
+{
+  GimpUIManagerGroupEntry *entry;
+
+  g_return_if_fail (GIMP_IS_UI_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_ACTION_FACTORY (factory));
+  g_return_if_fail (name != NULL);
+
+  /*  the accelerators of a group that was never created are unknown,
+   *  so it can't wait for one of them to be pressed
+   */
+  if (! created_groups || ! g_hash_table_lookup (created_groups, name))
+    {
+      gimp_ui_manager_group_insert (manager, factory, name, callback_data);
+      return;
+    }
+
+  entry = g_slice_new0 (GimpUIManagerGroupEntry);
+
+  entry->name          = g_strdup (name);
+  entry->factory       = factory;
+  entry->callback_data = callback_data;
+
+  manager->pending_groups = g_list_append (manager->pending_groups, entry);
+}
+
 GimpActionGroup *
 gimp_ui_manager_get_action_group (GimpUIManager *manager,
                                   const gchar   *name)
@@ -462,7 +552,96 @@ gimp_ui_manager_get_action_group (GimpUIManager *manager,
         return group;
     }
 
-  return NULL;
+  return gimp_ui_manager_group_create (manager, name);
+}
+
+/**
+ * gimp_ui_manager_ensure_action_groups:
+ * @manager: a #GimpUIManager
+ *
+ * Creates all action groups of @manager that haven't been created yet.
+ * Call this before using gtk_ui_manager_get_action_groups().
+ **/
+void
+gimp_ui_manager_ensure_action_groups (GimpUIManager *manager)
+{
+  g_return_if_fail (GIMP_IS_UI_MANAGER (manager));
+
+  while (manager->pending_groups)
+    {
+      GimpUIManagerGroupEntry *entry = manager->pending_groups->data;
+
+      gimp_ui_manager_group_create (manager, entry->name);
+    }
+}
+
+/**
+ * gimp_ui_manager_ensure_accel_groups:
+ * @manager: a #GimpUIManager
+ * @kevent:  a key press event
+ *
+ * Creates the action groups of @manager which have an accelerator
+ * on the key of @kevent, so that the accelerator can be activated.
+ * The groups are looked up in a map of the GtkAccelMap's keys.
+ *
+ * Returns: %TRUE if any action group was created.
+ **/
+gboolean
+gimp_ui_manager_ensure_accel_groups (GimpUIManager     *manager,
+                                     const GdkEventKey *kevent)
+{
+  guint    keyvals[2];
+  gboolean created = FALSE;
+  gint     i;
+
+  g_return_val_if_fail (GIMP_IS_UI_MANAGER (manager), FALSE);
+  g_return_val_if_fail (kevent != NULL, FALSE);
+
+  if (! manager->pending_groups)
+    return FALSE;
+
+  if (! accel_groups)
+    {
+      accel_groups = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL,
+                                            (GDestroyNotify) g_slist_free);
+
+      gtk_accel_map_foreach_unfiltered (accel_groups,
+                                        gimp_ui_manager_accel_groups_add);
+    }
+
+  /*  the accelerator may be on the key itself, or on its unshifted
+   *  version, like GTK+ matches them
+   */
+  keyvals[0] = kevent->keyval;
+  keyvals[1] = kevent->keyval;
+
+  gdk_keymap_translate_keyboard_state (gdk_keymap_get_default (),
+                                       kevent->hardware_keycode, 0,
+                                       kevent->group,
+                                       &keyvals[1], NULL, NULL, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (keyvals); i++)
+    {
+      GSList *names;
+      GSList *list;
+
+      names = g_hash_table_lookup (accel_groups,
+                                   GUINT_TO_POINTER (gdk_keyval_to_lower (keyvals[i])));
+
+      /*  creating groups may rebuild the map  */
+      names = g_slist_copy (names);
+
+      for (list = names; list; list = g_slist_next (list))
+        {
+          if (gimp_ui_manager_group_create (manager, list->data))
+            created = TRUE;
+        }
+
+      g_slist_free (names);
+    }
+
+  return created;
 }
 
 GtkAction *
@@ -488,6 +667,8 @@ gimp_ui_manager_find_action (GimpUIManager *manager,
     {
       GList *list;
 
+      gimp_ui_manager_ensure_action_groups (manager);
+
       for (list = gtk_ui_manager_get_action_groups (GTK_UI_MANAGER (manager));
            list;
            list = g_list_next (list))
@@ -728,6 +909,9 @@ gimp_ui_manager_entry_ensure (GimpUIManager *manager,
       return NULL;
     }
 
+  /*  the widgets need all actions  */
+  gimp_ui_manager_ensure_action_groups (manager);
+
   if (! entry->merge_id)
     {
       GError *error = NULL;
@@ -792,6 +976,151 @@ gimp_ui_manager_entry_ensure (GimpUIManager *manager,
   return entry;
 }
 
+static GimpActionGroup *
+gimp_ui_manager_group_insert (GimpUIManager     *manager,
+                              GimpActionFactory *factory,
+                              const gchar       *name,
+                              gpointer           callback_data)
+{
+  GimpActionGroup *group;
+  GtkAccelGroup   *accel_group;
+  GList           *actions;
+  GList           *list;
+
+  group = gimp_action_factory_group_new (factory, name, callback_data);
+
+  accel_group = gtk_ui_manager_get_accel_group (GTK_UI_MANAGER (manager));
+
+  actions = gtk_action_group_list_actions (GTK_ACTION_GROUP (group));
+
+  for (list = actions; list; list = g_list_next (list))
+    {
+      GtkAction *action = list->data;
+
+      gtk_action_set_accel_group (action, accel_group);
+      gtk_action_connect_accelerator (action);
+    }
+
+  g_list_free (actions);
+
+  gtk_ui_manager_insert_action_group (GTK_UI_MANAGER (manager),
+                                      GTK_ACTION_GROUP (group),
+                                      -1);
+
+  g_object_unref (group);
+
+  if (! created_groups)
+    created_groups = g_hash_table_new (g_str_hash, g_str_equal);
+
+  if (! g_hash_table_lookup (created_groups, name))
+    {
+      const gchar *key = g_intern_string (name);
+
+      g_hash_table_insert (created_groups, (gpointer) key, (gpointer) key);
+
+      /*  the group's accelerators were just added to the GtkAccelMap  */
+      gimp_ui_manager_accel_groups_clear ();
+    }
+
+  return group;
+}
+
+static GimpActionGroup *
+gimp_ui_manager_group_create (GimpUIManager *manager,
+                              const gchar   *name)
+{
+  GList *list;
+
+  for (list = manager->pending_groups; list; list = g_list_next (list))
+    {
+      GimpUIManagerGroupEntry *entry = list->data;
+
+      if (! strcmp (entry->name, name))
+        {
+          GimpActionGroup *group;
+
+          manager->pending_groups = g_list_delete_link (manager->pending_groups,
+                                                        list);
+
+          group = gimp_ui_manager_group_insert (manager,
+                                                entry->factory,
+                                                entry->name,
+                                                entry->callback_data);
+
+          gimp_ui_manager_group_entry_free (entry);
+
+          return group;
+        }
+    }
+
+  return NULL;
+}
+
+static void
+gimp_ui_manager_group_entry_free (GimpUIManagerGroupEntry *entry)
+{
+  g_free (entry->name);
+
+  g_slice_free (GimpUIManagerGroupEntry, entry);
+}
+
+static void
+gimp_ui_manager_accel_groups_clear (void)
+{
+  if (accel_groups)
+    {
+      g_hash_table_unref (accel_groups);
+      accel_groups = NULL;
+    }
+}
+
+static void
+gimp_ui_manager_accel_map_changed (GtkAccelMap     *accel_map,
+                                   const gchar     *accel_path,
+                                   guint            accel_key,
+                                   GdkModifierType  accel_mods)
+{
+  gimp_ui_manager_accel_groups_clear ();
+}
+
+static void
+gimp_ui_manager_accel_groups_add (gpointer         data,
+                                  const gchar     *accel_path,
+                                  guint            accel_key,
+                                  GdkModifierType  accel_mods,
+                                  gboolean         changed)
+{
+  GHashTable  *groups = data;
+  const gchar *group_name;
+  const gchar *end;
+  gchar       *name;
+  GSList      *list;
+
+  if (! accel_key || ! g_str_has_prefix (accel_path, "<Actions>/"))
+    return;
+
+  group_name = accel_path + strlen ("<Actions>/");
+  end        = strchr (group_name, '/');
+
+  if (! end)
+    return;
+
+  name       = g_strndup (group_name, end - group_name);
+  group_name = g_intern_string (name);
+  g_free (name);
+
+  accel_key = gdk_keyval_to_lower (accel_key);
+
+  list = g_hash_table_lookup (groups, GUINT_TO_POINTER (accel_key));
+
+  if (! g_slist_find (list, group_name))
+    {
+      g_hash_table_steal (groups, GUINT_TO_POINTER (accel_key));
+      g_hash_table_insert (groups, GUINT_TO_POINTER (accel_key),
+                           g_slist_prepend (list, (gpointer) group_name));
+    }
+}
+
 static void
 gimp_ui_manager_menu_position (GtkMenu  *menu,
                                gint     *x,
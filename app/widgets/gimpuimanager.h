@@ -55,6 +55,7 @@ struct _GimpUIManager
   gchar        *name;
   Gimp         *gimp;
   GList        *registered_uis;
+  GList        *pending_groups;
 };
 
 struct _GimpUIManagerClass
@@ -80,8 +81,15 @@ GList         * gimp_ui_managers_from_name  (const gchar            *name);
 
 void            gimp_ui_manager_update      (GimpUIManager          *manager,
                                              gpointer                update_data);
+void            gimp_ui_manager_add_action_group (GimpUIManager     *manager,
+                                                  GimpActionFactory *factory,
+                                                  const gchar       *name,
+                                                  gpointer           callback_data);
 GimpActionGroup * gimp_ui_manager_get_action_group (GimpUIManager   *manager,
                                                     const gchar     *name);
+void            gimp_ui_manager_ensure_action_groups (GimpUIManager *manager);
+gboolean        gimp_ui_manager_ensure_accel_groups  (GimpUIManager *manager,
+                                                      const GdkEventKey *kevent);
 
 GtkAction     * gimp_ui_manager_find_action     (GimpUIManager      *manager,
                                                  const gchar        *group_name,
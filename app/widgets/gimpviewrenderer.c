@@ -33,6 +33,8 @@
 
 #include "widgets-types.h"
 
+#include "gegl/gimp-babl.h"
+
 #include "core/gimpcontext.h"
 #include "core/gimpmarshal.h"
 #include "core/gimptempbuf.h"
@@ -853,6 +855,69 @@ gimp_view_renderer_render_temp_buf (GimpViewRenderer *renderer,
   renderer->needs_render = FALSE;
 }
 
+/**
+ * gimp_view_renderer_render_temp_buf_area:
+ * @renderer:  a #GimpViewRenderer that has already been rendered
+ * @temp_buf:  the new contents of part of the view
+ * @x:         where to put @temp_buf in the view
+ * @y:         where to put @temp_buf in the view
+ * @inside_bg: the background to show through transparent pixels
+ *
+ * Replaces the area of the rendered view that is covered by
+ * @temp_buf and leaves the rest untouched.
+ **/
+void
+gimp_view_renderer_render_temp_buf_area (GimpViewRenderer *renderer,
+                                         GimpTempBuf      *temp_buf,
+                                         gint              x,
+                                         gint              y,
+                                         GimpViewBG        inside_bg)
+{
+  cairo_surface_t *surface;
+  cairo_t         *cr;
+  cairo_matrix_t   matrix;
+  gint             width;
+  gint             height;
+
+  g_return_if_fail (GIMP_IS_VIEW_RENDERER (renderer));
+  g_return_if_fail (temp_buf != NULL);
+  g_return_if_fail (renderer->surface != NULL);
+
+  width  = gimp_temp_buf_get_width  (temp_buf);
+  height = gimp_temp_buf_get_height (temp_buf);
+
+  cr = cairo_create (renderer->surface);
+
+  if (! renderer->pattern)
+    renderer->pattern =
+      gimp_cairo_checkerboard_create (cr, GIMP_CHECK_SIZE_SM,
+                                      gimp_render_light_check_color (),
+                                      gimp_render_dark_check_color ());
+
+  /*  keep the checks lined up with the rest of the view  */
+  cairo_matrix_init_translate (&matrix, x, y);
+  cairo_pattern_set_matrix (renderer->pattern, &matrix);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, width, height);
+
+  gimp_view_render_temp_buf_to_surface (renderer,
+                                        temp_buf, 0, 0,
+                                        -1,
+                                        inside_bg,
+                                        inside_bg,
+                                        surface,
+                                        width, height);
+
+  cairo_matrix_init_identity (&matrix);
+  cairo_pattern_set_matrix (renderer->pattern, &matrix);
+
+  cairo_set_source_surface (cr, surface, x, y);
+  cairo_paint (cr);
+
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+}
+
 
 void
 gimp_view_renderer_render_pixbuf (GimpViewRenderer *renderer,
@@ -1102,8 +1167,8 @@ gimp_view_render_temp_buf_to_surface (GimpViewRenderer *renderer,
 
       dest += y * dest_stride + x * 4;
 
-      fish = babl_fish (temp_buf_format,
-                        babl_format ("cairo-RGB24"));
+      fish = gimp_babl_fish (temp_buf_format,
+                             babl_format ("cairo-RGB24"));
 
       for (i = y; i < (y + height); i++)
         {
@@ -1117,13 +1182,13 @@ gimp_view_render_temp_buf_to_surface (GimpViewRenderer *renderer,
                 {
                   guchar pixel[4] = { s[channel], s[channel], s[channel], 255 };
 
-                  babl_process (fish, pixel, d, 1);
+                  gimp_babl_process (fish, pixel, d, 1);
                 }
               else
                 {
                   guchar pixel[2] = { s[channel], 255 };
 
-                  babl_process (fish, pixel, d, 1);
+                  gimp_babl_process (fish, pixel, d, 1);
                 }
             }
 
@@ -149,6 +149,11 @@ void   gimp_view_renderer_render_temp_buf        (GimpViewRenderer *renderer,
                                                   gint              channel,
                                                   GimpViewBG        inside_bg,
                                                   GimpViewBG        outside_bg);
+void   gimp_view_renderer_render_temp_buf_area   (GimpViewRenderer *renderer,
+                                                  GimpTempBuf      *temp_buf,
+                                                  gint              x,
+                                                  gint              y,
+                                                  GimpViewBG        inside_bg);
 void   gimp_view_renderer_render_pixbuf          (GimpViewRenderer *renderer,
                                                   GdkPixbuf        *pixbuf);
 void   gimp_view_renderer_render_stock           (GimpViewRenderer *renderer,
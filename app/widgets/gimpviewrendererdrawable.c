@@ -36,9 +36,24 @@
 #include "gimpviewrendererdrawable.h"
 
 
+/*  how long one idle iteration may spend on rendering queued previews,
+ *  in microseconds
+ */
+#define RENDER_QUEUE_BUDGET 10000
+
+
+static void   gimp_view_renderer_drawable_draw   (GimpViewRenderer *renderer,
+                                                  GtkWidget        *widget,
+                                                  cairo_t          *cr,
+                                                  gint              available_width,
+                                                  gint              available_height);
 static void   gimp_view_renderer_drawable_render (GimpViewRenderer *renderer,
                                                   GtkWidget        *widget);
 
+static void   gimp_view_renderer_drawable_queue  (GimpViewRendererDrawable *renderer,
+                                                  GtkWidget                *widget);
+static gboolean gimp_view_renderer_drawable_queue_idle (gpointer data);
+
 
 G_DEFINE_TYPE (GimpViewRendererDrawable, gimp_view_renderer_drawable,
                GIMP_TYPE_VIEW_RENDERER)
@@ -46,11 +61,17 @@ G_DEFINE_TYPE (GimpViewRendererDrawable, gimp_view_renderer_drawable,
 #define parent_class gimp_view_renderer_drawable_parent_class
 
 
+/*  renderers waiting for their preview, in the order they were drawn  */
+static GQueue render_queue   = G_QUEUE_INIT;
+static guint  render_idle_id = 0;
+
+
 static void
 gimp_view_renderer_drawable_class_init (GimpViewRendererDrawableClass *klass)
 {
   GimpViewRendererClass *renderer_class = GIMP_VIEW_RENDERER_CLASS (klass);
 
+  renderer_class->draw   = gimp_view_renderer_drawable_draw;
   renderer_class->render = gimp_view_renderer_drawable_render;
 }
 
@@ -59,6 +80,39 @@ gimp_view_renderer_drawable_init (GimpViewRendererDrawable *renderer)
 {
 }
 
+static void
+gimp_view_renderer_drawable_draw (GimpViewRenderer *renderer,
+                                  GtkWidget        *widget,
+                                  cairo_t          *cr,
+                                  gint              available_width,
+                                  gint              available_height)
+{
+  /*  instead of rendering all visible previews from within one expose,
+   *  which stalls the UI for large images with many layers, keep
+   *  showing the old preview, or a placeholder, and render the new one
+   *  later.  Popups are what the user is looking at, so they are
+   *  rendered right away.
+   */
+  if (renderer->needs_render && ! renderer->is_popup)
+    {
+      if (! renderer->surface && ! renderer->pixbuf)
+        {
+          const gchar *stock_id = gimp_viewable_get_stock_id (renderer->viewable);
+
+          gimp_view_renderer_render_stock (renderer, widget, stock_id);
+        }
+
+      gimp_view_renderer_drawable_queue (GIMP_VIEW_RENDERER_DRAWABLE (renderer),
+                                         widget);
+
+      renderer->needs_render = FALSE;
+    }
+
+  GIMP_VIEW_RENDERER_CLASS (parent_class)->draw (renderer, widget, cr,
+                                                 available_width,
+                                                 available_height);
+}
+
 static void
 gimp_view_renderer_drawable_render (GimpViewRenderer *renderer,
                                     GtkWidget        *widget)
@@ -244,3 +298,74 @@ gimp_view_renderer_drawable_render (GimpViewRenderer *renderer,
       gimp_view_renderer_render_stock (renderer, widget, stock_id);
     }
 }
+
+static void
+gimp_view_renderer_drawable_queue (GimpViewRendererDrawable *renderer,
+                                   GtkWidget                *widget)
+{
+  /*  a renderer that is invalidated again while it is waiting keeps its
+   *  place in the queue, and is rendered only once from whatever the
+   *  drawable looks like by then
+   */
+  if (renderer->render_queued)
+    return;
+
+  renderer->render_queued = TRUE;
+  renderer->render_widget = widget;
+  g_object_add_weak_pointer (G_OBJECT (widget),
+                             (gpointer) &renderer->render_widget);
+
+  g_queue_push_tail (&render_queue, g_object_ref (renderer));
+
+  if (! render_idle_id)
+    render_idle_id = g_idle_add_full (GIMP_VIEWABLE_PRIORITY_IDLE,
+                                      gimp_view_renderer_drawable_queue_idle,
+                                      NULL, NULL);
+}
+
+static gboolean
+gimp_view_renderer_drawable_queue_idle (gpointer data)
+{
+  gint64 start_time = g_get_monotonic_time ();
+
+  while (! g_queue_is_empty (&render_queue))
+    {
+      GimpViewRendererDrawable *drawable_renderer;
+      GimpViewRenderer         *renderer;
+      GtkWidget                *widget;
+
+      drawable_renderer = g_queue_pop_head (&render_queue);
+      renderer          = GIMP_VIEW_RENDERER (drawable_renderer);
+      widget            = drawable_renderer->render_widget;
+
+      if (widget)
+        g_object_remove_weak_pointer (G_OBJECT (widget),
+                                      (gpointer) &drawable_renderer->render_widget);
+
+      drawable_renderer->render_queued = FALSE;
+      drawable_renderer->render_widget = NULL;
+
+      /*  a renderer whose widget is gone, or that lost its viewable,
+       *  is queued again when it is drawn the next time
+       */
+      if (widget && renderer->viewable)
+        {
+          GIMP_VIEW_RENDERER_GET_CLASS (renderer)->render (renderer, widget);
+
+          gimp_view_renderer_update (renderer);
+        }
+      else
+        {
+          renderer->needs_render = TRUE;
+        }
+
+      g_object_unref (drawable_renderer);
+
+      if (g_get_monotonic_time () - start_time > RENDER_QUEUE_BUDGET)
+        return TRUE;
+    }
+
+  render_idle_id = 0;
+
+  return FALSE;
+}
@@ -36,6 +36,10 @@ typedef struct _GimpViewRendererDrawableClass  GimpViewRendererDrawableClass;
 struct _GimpViewRendererDrawable
 {
   GimpViewRenderer  parent_instance;
+
+  /*< private >*/
+  gboolean          render_queued;
+  GtkWidget        *render_widget;
 };
 
 struct _GimpViewRendererDrawableClass
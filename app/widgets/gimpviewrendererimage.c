@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <math.h>
+
 #include <gegl.h>
 #include <gtk/gtk.h>
 
@@ -28,13 +30,24 @@
 #include "widgets-types.h"
 
 #include "core/gimpimage.h"
+#include "core/gimpimage-preview.h"
 #include "core/gimptempbuf.h"
 
 #include "gimpviewrendererimage.h"
 
 
-static void   gimp_view_renderer_image_render (GimpViewRenderer *renderer,
-                                               GtkWidget        *widget);
+/*  area updates are collected and rendered at most this often  */
+#define UPDATE_INTERVAL 66  /* milliseconds, about 15 frames per second */
+
+
+static void     gimp_view_renderer_image_finalize       (GObject          *object);
+
+static void     gimp_view_renderer_image_invalidate     (GimpViewRenderer *renderer);
+static void     gimp_view_renderer_image_render         (GimpViewRenderer *renderer,
+                                                         GtkWidget        *widget);
+
+static void     gimp_view_renderer_image_cancel_update  (GimpViewRendererImage *renderer);
+static gboolean gimp_view_renderer_image_update_timeout (GimpViewRendererImage *renderer);
 
 
 G_DEFINE_TYPE (GimpViewRendererImage, gimp_view_renderer_image,
@@ -46,9 +59,13 @@ G_DEFINE_TYPE (GimpViewRendererImage, gimp_view_renderer_image,
 static void
 gimp_view_renderer_image_class_init (GimpViewRendererImageClass *klass)
 {
+  GObjectClass          *object_class   = G_OBJECT_CLASS (klass);
   GimpViewRendererClass *renderer_class = GIMP_VIEW_RENDERER_CLASS (klass);
 
-  renderer_class->render = gimp_view_renderer_image_render;
+  object_class->finalize     = gimp_view_renderer_image_finalize;
+
+  renderer_class->invalidate = gimp_view_renderer_image_invalidate;
+  renderer_class->render     = gimp_view_renderer_image_render;
 }
 
 static void
@@ -57,6 +74,35 @@ gimp_view_renderer_image_init (GimpViewRendererImage *renderer)
   renderer->channel = -1;
 }
 
+static void
+gimp_view_renderer_image_finalize (GObject *object)
+{
+  gimp_view_renderer_image_cancel_update (GIMP_VIEW_RENDERER_IMAGE (object));
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gimp_view_renderer_image_invalidate (GimpViewRenderer *renderer)
+{
+  GimpViewRendererImage *rendererimage = GIMP_VIEW_RENDERER_IMAGE (renderer);
+
+  /*  the image's preview is invalidated after each projection flush;
+   *  if the flushed area has been handed to us already, the pending
+   *  area update will take care of it
+   */
+  if (rendererimage->update_timeout &&
+      rendererimage->dirty_image == (GimpImage *) renderer->viewable &&
+      renderer->surface)
+    {
+      return;
+    }
+
+  gimp_view_renderer_image_cancel_update (rendererimage);
+
+  GIMP_VIEW_RENDERER_CLASS (parent_class)->invalidate (renderer);
+}
+
 static void
 gimp_view_renderer_image_render (GimpViewRenderer *renderer,
                                  GtkWidget        *widget)
@@ -81,6 +127,8 @@ gimp_view_renderer_image_render (GimpViewRenderer *renderer,
       gboolean     scaling_up;
       GimpTempBuf *render_buf = NULL;
 
+      rendererimage->can_update_area = FALSE;
+
       gimp_image_get_resolution (image, &xres, &yres);
 
       gimp_viewable_calc_preview_size (gimp_image_get_width  (image),
@@ -144,6 +192,16 @@ gimp_view_renderer_image_render (GimpViewRenderer *renderer,
           if (rendererimage->channel != -1)
             component_index =
               gimp_image_get_component_index (image, rendererimage->channel);
+          else if (! scaling_up                      &&
+                   view_width  <= renderer->width &&
+                   view_height <= renderer->height)
+            {
+              rendererimage->can_update_area = TRUE;
+              rendererimage->view_x          = render_buf_x;
+              rendererimage->view_y          = render_buf_y;
+              rendererimage->view_width      = view_width;
+              rendererimage->view_height     = view_height;
+            }
 
           gimp_view_renderer_render_temp_buf (renderer, render_buf,
                                               render_buf_x, render_buf_y,
@@ -172,3 +230,172 @@ gimp_view_renderer_image_render (GimpViewRenderer *renderer,
 
   gimp_view_renderer_render_stock (renderer, widget, stock_id);
 }
+
+
+/*  public functions  */
+
+/**
+ * gimp_view_renderer_image_update_area:
+ * @renderer: a #GimpViewRendererImage
+ * @x:        left edge of the changed area, in image coordinates
+ * @y:        top edge of the changed area, in image coordinates
+ * @width:    width of the changed area
+ * @height:   height of the changed area
+ *
+ * Tells @renderer which part of its image changed, so that only the
+ * matching part of the view is redrawn, instead of the whole preview
+ * on the next "invalidate-preview". Areas are collected and rendered
+ * at a fixed rate, so a view showing an image that is being painted
+ * on costs a bounded amount of time per frame.
+ **/
+void
+gimp_view_renderer_image_update_area (GimpViewRendererImage *renderer,
+                                      gint                   x,
+                                      gint                   y,
+                                      gint                   width,
+                                      gint                   height)
+{
+  GimpViewRenderer *view_renderer;
+  GeglRectangle     area = { x, y, width, height };
+
+  g_return_if_fail (GIMP_IS_VIEW_RENDERER_IMAGE (renderer));
+
+  view_renderer = GIMP_VIEW_RENDERER (renderer);
+
+  if (! GIMP_IS_IMAGE (view_renderer->viewable) ||
+      width <= 0 || height <= 0)
+    return;
+
+  if (renderer->dirty_image != (GimpImage *) view_renderer->viewable)
+    gimp_view_renderer_image_cancel_update (renderer);
+
+  if (renderer->update_timeout)
+    {
+      gegl_rectangle_bounding_box (&renderer->dirty, &renderer->dirty, &area);
+    }
+  else
+    {
+      renderer->dirty_image = GIMP_IMAGE (view_renderer->viewable);
+      renderer->dirty       = area;
+
+      renderer->update_timeout =
+        g_timeout_add (UPDATE_INTERVAL,
+                       (GSourceFunc) gimp_view_renderer_image_update_timeout,
+                       renderer);
+    }
+}
+
+
+/*  private functions  */
+
+static void
+gimp_view_renderer_image_cancel_update (GimpViewRendererImage *renderer)
+{
+  if (renderer->update_timeout)
+    {
+      g_source_remove (renderer->update_timeout);
+      renderer->update_timeout = 0;
+    }
+
+  renderer->dirty_image = NULL;
+}
+
+static gboolean
+gimp_view_renderer_image_update_timeout (GimpViewRendererImage *renderer)
+{
+  GimpViewRenderer *view_renderer = GIMP_VIEW_RENDERER (renderer);
+  GimpImage        *image         = renderer->dirty_image;
+  GimpTempBuf      *temp_buf;
+  gint              image_width;
+  gint              image_height;
+  gint              view_width;
+  gint              view_height;
+  gint              x1, y1, x2, y2;
+
+  renderer->update_timeout = 0;
+  renderer->dirty_image    = NULL;
+
+  if (image != (GimpImage *) view_renderer->viewable ||
+      ! view_renderer->surface                       ||
+      view_renderer->needs_render)
+    {
+      gimp_view_renderer_invalidate (view_renderer);
+      return FALSE;
+    }
+
+  image_width  = gimp_image_get_width  (image);
+  image_height = gimp_image_get_height (image);
+
+  if (renderer->can_update_area)
+    {
+      gdouble  xres;
+      gdouble  yres;
+      gboolean scaling_up;
+
+      gimp_image_get_resolution (image, &xres, &yres);
+
+      gimp_viewable_calc_preview_size (image_width,
+                                       image_height,
+                                       view_renderer->width,
+                                       view_renderer->height,
+                                       view_renderer->dot_for_dot,
+                                       xres,
+                                       yres,
+                                       &view_width,
+                                       &view_height,
+                                       &scaling_up);
+
+      if (scaling_up                          ||
+          view_width  != renderer->view_width ||
+          view_height != renderer->view_height)
+        {
+          renderer->can_update_area = FALSE;
+        }
+    }
+
+  if (! renderer->can_update_area)
+    {
+      gimp_view_renderer_invalidate (view_renderer);
+      return FALSE;
+    }
+
+  /*  the dirty area in view coordinates, rounded outwards  */
+  x1 = floor ((gdouble) renderer->dirty.x * view_width / image_width);
+  y1 = floor ((gdouble) renderer->dirty.y * view_height / image_height);
+  x2 = ceil ((gdouble) (renderer->dirty.x + renderer->dirty.width) *
+             view_width / image_width);
+  y2 = ceil ((gdouble) (renderer->dirty.y + renderer->dirty.height) *
+             view_height / image_height);
+
+  x1 = CLAMP (x1, 0, view_width);
+  y1 = CLAMP (y1, 0, view_height);
+  x2 = CLAMP (x2, 0, view_width);
+  y2 = CLAMP (y2, 0, view_height);
+
+  if (x1 >= x2 || y1 >= y2)
+    return FALSE;
+
+  /*  a full render is cheaper than several large area updates  */
+  if ((x2 - x1) * (y2 - y1) > view_width * view_height / 2)
+    {
+      gimp_view_renderer_invalidate (view_renderer);
+      return FALSE;
+    }
+
+  temp_buf = gimp_image_get_new_sub_preview (image,
+                                             view_width, view_height,
+                                             x1, y1, x2 - x1, y2 - y1);
+
+  if (temp_buf)
+    {
+      gimp_view_renderer_render_temp_buf_area (view_renderer, temp_buf,
+                                               renderer->view_x + x1,
+                                               renderer->view_y + y1,
+                                               GIMP_VIEW_BG_CHECKS);
+      gimp_temp_buf_unref (temp_buf);
+
+      gimp_view_renderer_update (view_renderer);
+    }
+
+  return FALSE;
+}
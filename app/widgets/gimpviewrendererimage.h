@@ -38,6 +38,18 @@ struct _GimpViewRendererImage
   GimpViewRenderer parent_instance;
 
   GimpChannelType     channel;
+
+  /*  incremental updates, see gimp_view_renderer_image_update_area()  */
+  GimpImage          *dirty_image;
+  GeglRectangle       dirty;
+  guint               update_timeout;
+
+  /*  placement of the last full render, if area updates can use it  */
+  gboolean            can_update_area;
+  gint                view_x;
+  gint                view_y;
+  gint                view_width;
+  gint                view_height;
 };
 
 struct _GimpViewRendererImageClass
@@ -46,7 +58,13 @@ struct _GimpViewRendererImageClass
 };
 
 
-GType   gimp_view_renderer_image_get_type (void) G_GNUC_CONST;
+GType   gimp_view_renderer_image_get_type    (void) G_GNUC_CONST;
+
+void    gimp_view_renderer_image_update_area (GimpViewRendererImage *renderer,
+                                              gint                   x,
+                                              gint                   y,
+                                              gint                   width,
+                                              gint                   height);
 
 
 #endif /* __GIMP_VIEW_RENDERER_IMAGE_H__ */
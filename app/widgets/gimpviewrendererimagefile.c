@@ -30,8 +30,16 @@
 
 #include "widgets-types.h"
 
+#include "config/gimpcoreconfig.h"
+
+#include "core/gimp.h"
+#include "core/gimpcontext.h"
 #include "core/gimpimagefile.h"
 
+#include "plug-in/gimppluginmanager.h"
+
+#include "file/file-procedure.h"
+
 #include "gimpviewrendererimagefile.h"
 #include "gimpviewrenderer-frame.h"
 
@@ -42,6 +50,8 @@ static void        gimp_view_renderer_imagefile_render   (GimpViewRenderer *rend
 static GdkPixbuf * gimp_view_renderer_imagefile_get_icon (GimpImagefile    *imagefile,
                                                           GtkWidget        *widget,
                                                           gint              size);
+static void   gimp_view_renderer_imagefile_queue_thumbnail (GimpImagefile *imagefile,
+                                                            GimpContext   *context);
 
 
 G_DEFINE_TYPE (GimpViewRendererImagefile, gimp_view_renderer_imagefile,
@@ -75,6 +85,10 @@ gimp_view_renderer_imagefile_render (GimpViewRenderer *renderer,
     {
       GimpImagefile *imagefile = GIMP_IMAGEFILE (renderer->viewable);
 
+      if (renderer->context)
+        gimp_view_renderer_imagefile_queue_thumbnail (imagefile,
+                                                      renderer->context);
+
       pixbuf = gimp_view_renderer_imagefile_get_icon (imagefile,
                                                       widget,
                                                       MIN (renderer->width,
@@ -95,6 +109,46 @@ gimp_view_renderer_imagefile_render (GimpViewRenderer *renderer,
 }
 
 
+/*  Only views that are actually drawn get here, so this creates the
+ *  missing thumbnails of the visible items, in the background, with
+ *  the same limits as the automatic thumbnails of the file dialog.
+ */
+static void
+gimp_view_renderer_imagefile_queue_thumbnail (GimpImagefile *imagefile,
+                                              GimpContext   *context)
+{
+  Gimp          *gimp      = context->gimp;
+  GimpThumbnail *thumbnail = gimp_imagefile_get_thumbnail (imagefile);
+  const gchar   *uri       = gimp_object_get_name (imagefile);
+  gint           size      = gimp->config->thumbnail_size;
+
+  if (! uri || size == GIMP_THUMBNAIL_SIZE_NONE)
+    return;
+
+  if (gimp_thumbnail_peek_image (thumbnail) != GIMP_THUMB_STATE_EXISTS)
+    return;
+
+  switch (gimp_thumbnail_peek_thumb (thumbnail, size))
+    {
+    case GIMP_THUMB_STATE_NOT_FOUND:
+    case GIMP_THUMB_STATE_OLD:
+      break;
+
+    default:
+      return;
+    }
+
+  if (thumbnail->image_filesize >= gimp->config->thumbnail_filesize_limit ||
+      gimp_thumbnail_has_failed (thumbnail)                               ||
+      ! file_procedure_find_by_extension (gimp->plug_in_manager->load_procs,
+                                          uri))
+    return;
+
+  gimp_imagefile_queue_thumbnail (imagefile, size, FALSE,
+                                  GIMP_IMAGEFILE_THUMBNAIL_PRIORITY_VISIBLE);
+}
+
+
 /* The code to get an icon for a mime-type is lifted from GtkRecentManager. */
 
 static GdkPixbuf *
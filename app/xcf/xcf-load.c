@@ -20,6 +20,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <cairo.h>
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
@@ -29,11 +33,17 @@
 
 #include "core/core-types.h"
 
+#include "base/tile.h"
+#include "base/tile-manager.h"
+
 #include "config/gimpcoreconfig.h"
 
 #include "gegl/gimp-gegl-tile-compat.h"
+#include "gegl/gimp-gegl-utils.h"
+#include "gegl/gimptilebackendtilemanager.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
 #include "core/gimpcontainer.h"
 #include "core/gimpdrawable-private.h" /* eek */
 #include "core/gimpgrid.h"
@@ -110,6 +120,45 @@ static gboolean        xcf_load_tile_rle      (XcfInfo       *info,
                                                GeglRectangle *tile_rect,
                                                const Babl    *format,
                                                gint           data_length);
+#ifdef HAVE_ZLIB
+static gboolean        xcf_load_tile_zlib     (XcfInfo       *info,
+                                               GeglBuffer    *buffer,
+                                               GeglRectangle *tile_rect,
+                                               const Babl    *format,
+                                               gint           data_length);
+static gboolean        xcf_load_decode_zlib   (const guchar  *xcfdata,
+                                               gint           data_length,
+                                               guchar        *tile_data,
+                                               gint           tile_size);
+#endif
+static gboolean        xcf_load_decode_rle    (const guchar  *xcfdata,
+                                               gint           data_length,
+                                               gint           bpp,
+                                               gint           n_pixels,
+                                               guchar        *tile_data);
+#ifdef ENABLE_MP
+static gboolean        xcf_load_level_parallel
+                                              (XcfInfo       *info,
+                                               GeglBuffer    *buffer,
+                                               goffset        offset,
+                                               guint          ntiles,
+                                               gint           n_threads);
+#endif
+static guint           xcf_read_offset        (XcfInfo       *info,
+                                               goffset       *data,
+                                               gint           count);
+static const guchar  * xcf_load_tile_data     (XcfInfo       *info,
+                                               goffset        offset,
+                                               gint          *data_length,
+                                               guchar        *buffer);
+static goffset       * xcf_load_level_offsets (XcfInfo       *info,
+                                               goffset        offset,
+                                               guint          ntiles,
+                                               gint           tile_size);
+static gboolean        xcf_load_level_lazy    (XcfInfo       *info,
+                                               GeglBuffer    *buffer,
+                                               goffset        offset,
+                                               guint          ntiles);
 static GimpParasite  * xcf_load_parasite      (XcfInfo       *info);
 static gboolean        xcf_load_old_paths     (XcfInfo       *info,
                                                GimpImage     *image);
@@ -138,8 +187,8 @@ xcf_load_image (Gimp     *gimp,
 {
   GimpImage          *image;
   const GimpParasite *parasite;
-  guint32             saved_pos;
-  guint32             offset;
+  goffset             saved_pos;
+  goffset             offset;
   gint                width;
   gint                height;
   gint                image_type;
@@ -192,7 +241,7 @@ xcf_load_image (Gimp     *gimp,
       GList     *item_path = NULL;
 
       /* read in the offset of the next layer */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
+      info->cp += xcf_read_offset (info, &offset, 1);
 
       /* if the offset is 0 then we are at the end
        *  of the layer list.
@@ -276,7 +325,7 @@ xcf_load_image (Gimp     *gimp,
       GimpChannel *channel;
 
       /* read in the offset of the next channel */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
+      info->cp += xcf_read_offset (info, &offset, 1);
 
       /* if the offset is 0 then we are at the end
        *  of the channel list.
@@ -489,6 +538,17 @@ xcf_load_image_props (XcfInfo   *info,
                 return FALSE;
               }
 
+#ifndef HAVE_ZLIB
+            if (compression == COMPRESS_ZLIB)
+              {
+                gimp_message (info->gimp, G_OBJECT (info->progress),
+                              GIMP_MESSAGE_ERROR,
+                              "Unsupported compression type: %d",
+			      (gint) compression);
+                return FALSE;
+              }
+#endif
+
             info->compression = compression;
           }
           break;
@@ -585,7 +645,7 @@ xcf_load_image_props (XcfInfo   *info,
 
         case PROP_PARASITES:
           {
-            glong         base = info->cp;
+            goffset       base = info->cp;
             GimpParasite *p;
 
             while (info->cp - base < prop_size)
@@ -678,7 +738,7 @@ xcf_load_image_props (XcfInfo   *info,
 
         case PROP_VECTORS:
           {
-            guint32 base = info->cp;
+            goffset base = info->cp;
 
             if (xcf_load_vectors (info, image))
               {
@@ -686,7 +746,7 @@ xcf_load_image_props (XcfInfo   *info,
                   {
                     g_printerr ("Mismatch in PROP_VECTORS size: "
                                 "skipping %d bytes.\n",
-                                base + prop_size - info->cp);
+                                (gint) (base + prop_size - info->cp));
                     xcf_seek_pos (info, base + prop_size, NULL);
                   }
               }
@@ -744,9 +804,7 @@ xcf_load_layer_props (XcfInfo    *info,
 
         case PROP_FLOATING_SELECTION:
           info->floating_sel = *layer;
-          info->cp +=
-            xcf_read_int32 (info->fp,
-                            (guint32 *) &info->floating_sel_offset, 1);
+          info->cp += xcf_read_offset (info, &info->floating_sel_offset, 1);
           break;
 
         case PROP_OPACITY:
@@ -843,7 +901,7 @@ xcf_load_layer_props (XcfInfo    *info,
 
         case PROP_PARASITES:
           {
-            glong         base = info->cp;
+            goffset       base = info->cp;
             GimpParasite *p;
 
             while (info->cp - base < prop_size)
@@ -881,8 +939,8 @@ xcf_load_layer_props (XcfInfo    *info,
 
         case PROP_ITEM_PATH:
           {
-            glong  base = info->cp;
-            GList *path = NULL;
+            goffset  base = info->cp;
+            GList   *path = NULL;
 
             while (info->cp - base < prop_size)
               {
@@ -1026,7 +1084,7 @@ xcf_load_channel_props (XcfInfo      *info,
 
         case PROP_PARASITES:
           {
-            glong         base = info->cp;
+            goffset       base = info->cp;
             GimpParasite *p;
 
             while ((info->cp - base) < prop_size)
@@ -1082,8 +1140,8 @@ xcf_load_layer (XcfInfo    *info,
 {
   GimpLayer         *layer;
   GimpLayerMask     *layer_mask;
-  guint32            hierarchy_offset;
-  guint32            layer_mask_offset;
+  goffset            hierarchy_offset;
+  goffset            layer_mask_offset;
   gboolean           apply_mask = TRUE;
   gboolean           edit_mask  = FALSE;
   gboolean           show_mask  = FALSE;
@@ -1185,8 +1243,8 @@ xcf_load_layer (XcfInfo    *info,
     }
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->fp, &hierarchy_offset, 1);
-  info->cp += xcf_read_int32 (info->fp, &layer_mask_offset, 1);
+  info->cp += xcf_read_offset (info, &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info, &layer_mask_offset, 1);
 
   /* read in the hierarchy (ignore it for group layers, both as an
    * optimization and because the hierarchy's extents don't match
@@ -1253,7 +1311,7 @@ xcf_load_channel (XcfInfo   *info,
                   GimpImage *image)
 {
   GimpChannel *channel;
-  guint32      hierarchy_offset;
+  goffset      hierarchy_offset;
   gint         width;
   gint         height;
   gboolean     is_fs_drawable;
@@ -1283,7 +1341,7 @@ xcf_load_channel (XcfInfo   *info,
   xcf_progress_update (info);
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->fp, &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info, &hierarchy_offset, 1);
 
   /* read in the hierarchy */
   if (!xcf_seek_pos (info, hierarchy_offset, NULL))
@@ -1311,7 +1369,7 @@ xcf_load_layer_mask (XcfInfo   *info,
 {
   GimpLayerMask *layer_mask;
   GimpChannel   *channel;
-  guint32        hierarchy_offset;
+  goffset        hierarchy_offset;
   gint           width;
   gint           height;
   gboolean       is_fs_drawable;
@@ -1342,7 +1400,7 @@ xcf_load_layer_mask (XcfInfo   *info,
   xcf_progress_update (info);
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->fp, &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info, &hierarchy_offset, 1);
 
   /* read in the hierarchy */
   if (! xcf_seek_pos (info, hierarchy_offset, NULL))
@@ -1370,9 +1428,9 @@ xcf_load_buffer (XcfInfo    *info,
                  GeglBuffer *buffer)
 {
   const Babl *format;
-  guint32     saved_pos;
-  guint32     offset;
-  guint32     junk;
+  goffset     saved_pos;
+  goffset     offset;
+  goffset     junk;
   gint        width;
   gint        height;
   gint        bpp;
@@ -1396,13 +1454,13 @@ xcf_load_buffer (XcfInfo    *info,
    *  as the number of levels found in the file.
    */
 
-  info->cp += xcf_read_int32 (info->fp, &offset, 1); /* top level */
+  info->cp += xcf_read_offset (info, &offset, 1); /* top level */
 
   /* discard offsets for layers below first, if any.
    */
   do
     {
-      info->cp += xcf_read_int32 (info->fp, &junk, 1);
+      info->cp += xcf_read_offset (info, &junk, 1);
     }
   while (junk != 0);
 
@@ -1434,8 +1492,8 @@ xcf_load_level (XcfInfo    *info,
                 GeglBuffer *buffer)
 {
   const Babl *format;
-  guint32     saved_pos;
-  guint32     offset, offset2;
+  goffset     saved_pos;
+  goffset     offset, offset2;
   gint        n_tile_rows;
   gint        n_tile_cols;
   guint       ntiles;
@@ -1443,6 +1501,9 @@ xcf_load_level (XcfInfo    *info,
   gint        height;
   gint        i;
   gint        fail;
+#ifdef ENABLE_MP
+  gint        n_threads;
+#endif
 
   format = gegl_buffer_get_format (buffer);
 
@@ -1457,7 +1518,7 @@ xcf_load_level (XcfInfo    *info,
    *  if it is '0', then this tile level is empty
    *  and we can simply return.
    */
-  info->cp += xcf_read_int32 (info->fp, &offset, 1);
+  info->cp += xcf_read_offset (info, &offset, 1);
   if (offset == 0)
     return TRUE;
 
@@ -1465,6 +1526,21 @@ xcf_load_level (XcfInfo    *info,
   n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
 
   ntiles = n_tile_rows * n_tile_cols;
+
+  if (GIMP_CORE_CONFIG (info->gimp->config)->xcf_lazy_loading &&
+      info->compression != COMPRESS_FRACTAL &&
+      GIMP_IS_TILE_BACKEND_TILE_MANAGER (gegl_buffer_backend (buffer)))
+    return xcf_load_level_lazy (info, buffer, offset, ntiles);
+
+#ifdef ENABLE_MP
+  n_threads = gimp_parallel_get_n_threads ();
+
+  if ((info->compression == COMPRESS_RLE ||
+       info->compression == COMPRESS_ZLIB) && n_threads > 1 && ntiles > 1)
+    return xcf_load_level_parallel (info, buffer, offset,
+                                    ntiles, n_threads);
+#endif
+
   for (i = 0; i < ntiles; i++)
     {
       GeglRectangle rect;
@@ -1486,19 +1562,16 @@ xcf_load_level (XcfInfo    *info,
 
       /* read in the offset of the next tile so we can calculate the amount
          of data needed for this tile*/
-      info->cp += xcf_read_int32 (info->fp, &offset2, 1);
+      info->cp += xcf_read_offset (info, &offset2, 1);
 
       /* if the offset is 0 then we need to read in the maximum possible
          allowing for negative compression */
       if (offset2 == 0)
-        offset2 = offset + XCF_TILE_WIDTH * XCF_TILE_WIDTH * 4 * 1.5;
+        offset2 = offset + XCF_TILE_WIDTH * XCF_TILE_HEIGHT *
+                  babl_format_get_bytes_per_pixel (format) * 1.5;
                                         /* 1.5 is probably more
                                            than we need to allow */
 
-      /* seek to the tile offset */
-      if (! xcf_seek_pos (info, offset, NULL))
-        return FALSE;
-
       /* get the tile from the tile manager */
       gimp_gegl_buffer_get_tile_rect (buffer,
                                       XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
@@ -1508,17 +1581,23 @@ xcf_load_level (XcfInfo    *info,
       switch (info->compression)
         {
         case COMPRESS_NONE:
-          if (!xcf_load_tile (info, buffer, &rect, format))
+          if (!xcf_load_tile (info, buffer, &rect, format, offset))
             fail = TRUE;
           break;
         case COMPRESS_RLE:
           if (!xcf_load_tile_rle (info, buffer, &rect, format,
-                                  offset2 - offset))
+                                  offset, offset2 - offset))
             fail = TRUE;
           break;
         case COMPRESS_ZLIB:
+#ifdef HAVE_ZLIB
+          if (!xcf_load_tile_zlib (info, buffer, &rect, format,
+                                   offset, offset2 - offset))
+            fail = TRUE;
+#else
           g_error ("xcf: zlib compression unimplemented");
           fail = TRUE;
+#endif
           break;
         case COMPRESS_FRACTAL:
           g_error ("xcf: fractal compression unimplemented");
@@ -1536,32 +1615,84 @@ xcf_load_level (XcfInfo    *info,
         return FALSE;
 
       /* read in the offset of the next tile */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
+      info->cp += xcf_read_offset (info, &offset, 1);
     }
 
   if (offset != 0)
     {
       gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
-                    "encountered garbage after reading level: %d", offset);
+                    "encountered garbage after reading level: %"
+                    G_GOFFSET_FORMAT, offset);
       return FALSE;
     }
 
   return TRUE;
 }
 
+/*  Returns the data_length bytes of tile data at offset, data_length
+ *  is reduced if the file ends earlier. If the file is mapped, the
+ *  data is returned in place, otherwise it is read into buffer.
+ */
+static const guchar *
+xcf_load_tile_data (XcfInfo *info,
+                    goffset  offset,
+                    gint    *data_length,
+                    guchar  *buffer)
+{
+  if (info->mapped_file)
+    {
+      const guchar *contents;
+      goffset       length;
+
+      contents = (const guchar *) g_mapped_file_get_contents (info->mapped_file);
+      length   = g_mapped_file_get_length (info->mapped_file);
+
+      if (offset >= length)
+        {
+          *data_length = 0;
+          return contents;
+        }
+
+      *data_length = MIN (*data_length, length - offset);
+
+      return contents + offset;
+    }
+
+  if (! xcf_seek_pos (info, offset, NULL))
+    return NULL;
+
+  /* we may be reading past the end of the file here */
+  *data_length = xcf_read_int8 (info->fp, buffer, *data_length);
+  info->cp += *data_length;
+
+  return buffer;
+}
+
 static gboolean
 xcf_load_tile (XcfInfo       *info,
                GeglBuffer    *buffer,
                GeglRectangle *tile_rect,
-               const Babl    *format)
+               const Babl    *format,
+               goffset        offset)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
+  gint          bpp         = babl_format_get_bytes_per_pixel (format);
+  gint          tile_size   = bpp * tile_rect->width * tile_rect->height;
+  guchar       *tile_data   = g_alloca (tile_size);
+  gint          data_length = tile_size;
+  const guchar *xcfdata;
+
+  xcfdata = xcf_load_tile_data (info, offset, &data_length, tile_data);
+  if (! xcfdata)
+    return FALSE;
 
-  info->cp += xcf_read_int8 (info->fp, tile_data, tile_size);
+  /*  a truncated mapped file  */
+  if (data_length < tile_size && xcfdata != tile_data)
+    {
+      memcpy (tile_data, xcfdata, data_length);
+      xcfdata = tile_data;
+    }
 
-  gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
+  gegl_buffer_set (buffer, tile_rect, 0, format, xcfdata,
                    GEGL_AUTO_ROWSTRIDE);
 
   return TRUE;
@@ -1572,16 +1703,13 @@ xcf_load_tile_rle (XcfInfo       *info,
                    GeglBuffer    *buffer,
                    GeglRectangle *tile_rect,
                    const Babl    *format,
+                   goffset        offset,
                    gint           data_length)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  gint    i;
-  gint    nmemb_read_successfully;
-  guchar *xcfdata;
-  guchar *xcfodata;
-  guchar *xcfdatalimit;
+  gint          bpp       = babl_format_get_bytes_per_pixel (format);
+  gint          tile_size = bpp * tile_rect->width * tile_rect->height;
+  guchar       *tile_data = g_alloca (tile_size);
+  const guchar *xcfdata;
 
   /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
    * this tile (return TRUE without storing data) as if it did not
@@ -1592,21 +1720,106 @@ xcf_load_tile_rle (XcfInfo       *info,
   if (data_length <= 0)
     return TRUE;
 
-  xcfdata = xcfodata = g_alloca (data_length);
+  xcfdata = xcf_load_tile_data (info, offset, &data_length,
+                                info->mapped_file ?
+                                NULL : g_alloca (data_length));
+  if (! xcfdata)
+    return FALSE;
 
-  /* we have to use fread instead of xcf_read_* because we may be
-   * reading past the end of the file here
-   */
-  nmemb_read_successfully = fread ((gchar *) xcfdata, sizeof (gchar),
-                                   data_length, info->fp);
-  info->cp += nmemb_read_successfully;
+  if (! xcf_load_decode_rle (xcfdata, data_length, bpp,
+                             tile_rect->width * tile_rect->height,
+                             tile_data))
+    return FALSE;
+
+  gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
+                   GEGL_AUTO_ROWSTRIDE);
+
+  return TRUE;
+}
+
+#ifdef HAVE_ZLIB
+
+static gboolean
+xcf_load_tile_zlib (XcfInfo       *info,
+                    GeglBuffer    *buffer,
+                    GeglRectangle *tile_rect,
+                    const Babl    *format,
+                    goffset        offset,
+                    gint           data_length)
+{
+  gint          bpp       = babl_format_get_bytes_per_pixel (format);
+  gint          tile_size = bpp * tile_rect->width * tile_rect->height;
+  guchar       *tile_data = g_alloca (tile_size);
+  const guchar *xcfdata;
+
+  /* see bug #357809 in xcf_load_tile_rle() */
+  if (data_length <= 0)
+    return TRUE;
+
+  xcfdata = xcf_load_tile_data (info, offset, &data_length,
+                                info->mapped_file ?
+                                NULL : g_alloca (data_length));
+  if (! xcfdata)
+    return FALSE;
+
+  if (! xcf_load_decode_zlib (xcfdata, data_length,
+                              tile_data, tile_size))
+    return FALSE;
+
+  gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
+                   GEGL_AUTO_ROWSTRIDE);
+
+  return TRUE;
+}
+
+/*  Inflates one tile into tile_data, which must come out at exactly
+ *  tile_size bytes. data_length may include bytes of the following
+ *  tile, they are ignored.
+ */
+static gboolean
+xcf_load_decode_zlib (const guchar *xcfdata,
+                      gint          data_length,
+                      guchar       *tile_data,
+                      gint          tile_size)
+{
+  z_stream strm = { 0, };
+  gint     status;
+
+  if (inflateInit (&strm) != Z_OK)
+    return FALSE;
 
-  xcfdatalimit = &xcfodata[nmemb_read_successfully - 1];
+  strm.next_in   = (Bytef *) xcfdata;
+  strm.avail_in  = data_length;
+  strm.next_out  = tile_data;
+  strm.avail_out = tile_size;
+
+  status = inflate (&strm, Z_FINISH);
+
+  inflateEnd (&strm);
+
+  return (status == Z_STREAM_END && strm.avail_out == 0);
+}
+
+#endif /* HAVE_ZLIB */
+
+/*  Decodes one RLE tile of data_length bytes into tile_data. This only
+ *  touches the passed memory so it can be run from the load worker
+ *  threads.
+ */
+static gboolean
+xcf_load_decode_rle (const guchar *xcfdata,
+                     gint          data_length,
+                     gint          bpp,
+                     gint          n_pixels,
+                     guchar       *tile_data)
+{
+  const guchar *xcfdatalimit = &xcfdata[data_length - 1];
+  gint          i;
 
   for (i = 0; i < bpp; i++)
     {
       guchar *data  = tile_data + i;
-      gint    size  = tile_rect->width * tile_rect->height;
+      gint    size  = n_pixels;
       gint    count = 0;
       guchar  val;
       gint    length;
@@ -1693,15 +1906,617 @@ xcf_load_tile_rle (XcfInfo       *info,
         }
     }
 
-  gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                   GEGL_AUTO_ROWSTRIDE);
-
   return TRUE;
 
  bogus_rle:
   return FALSE;
 }
 
+#ifdef ENABLE_MP
+
+/*  The parallel load pipeline: the calling thread reads the tile
+ *  ranges given by the offset table for a batch of tiles, the batch is
+ *  decoded on the core worker pool, and the calling thread stores the
+ *  decoded tiles in the buffer in tile order.
+ */
+
+#define XCF_LOAD_JOBS_PER_THREAD 4
+
+typedef struct _XcfLoadJob      XcfLoadJob;
+typedef struct _XcfLoadPipeline XcfLoadPipeline;
+
+struct _XcfLoadJob
+{
+  GeglRectangle  rect;
+  const guchar  *data;         /*  xcfdata or the mapped file  */
+  guchar        *xcfdata;
+  gint           xcfdata_size;
+  gint           data_length;
+  guchar        *tile_data;
+  gboolean       success;
+};
+
+struct _XcfLoadPipeline
+{
+  XcfCompressionType  compression;
+  gint                bpp;
+  XcfLoadJob         *jobs;
+};
+
+static void
+xcf_load_decode_job (gint             i,
+                     gint             n,
+                     XcfLoadPipeline *pipeline)
+{
+  XcfLoadJob *job      = &pipeline->jobs[i];
+  gint        n_pixels = job->rect.width * job->rect.height;
+
+  if (job->data_length == 0)
+    return;
+
+  switch (pipeline->compression)
+    {
+    case COMPRESS_RLE:
+      job->success = xcf_load_decode_rle (job->data, job->data_length,
+                                          pipeline->bpp, n_pixels,
+                                          job->tile_data);
+      break;
+
+#ifdef HAVE_ZLIB
+    case COMPRESS_ZLIB:
+      job->success = xcf_load_decode_zlib (job->data, job->data_length,
+                                           job->tile_data,
+                                           n_pixels * pipeline->bpp);
+      break;
+#endif
+
+    default:
+      job->success = FALSE;
+      break;
+    }
+}
+
+static gboolean
+xcf_load_level_parallel (XcfInfo    *info,
+                         GeglBuffer *buffer,
+                         goffset     offset,
+                         guint       ntiles,
+                         gint        n_threads)
+{
+  const Babl      *format    = gegl_buffer_get_format (buffer);
+  XcfLoadPipeline  pipeline;
+  XcfLoadJob      *jobs;
+  goffset         *offsets;
+  gint             tile_size;
+  guint            n_jobs;
+  guint            next_tile = 0;
+  guint            i;
+  gboolean         success   = TRUE;
+
+  pipeline.compression = info->compression;
+  pipeline.bpp         = babl_format_get_bytes_per_pixel (format);
+
+  tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * pipeline.bpp;
+
+  offsets = xcf_load_level_offsets (info, offset, ntiles, tile_size);
+  if (! offsets)
+    return FALSE;
+
+  n_jobs = MIN (ntiles, n_threads * XCF_LOAD_JOBS_PER_THREAD);
+  jobs   = g_new0 (XcfLoadJob, n_jobs);
+
+  for (i = 0; i < n_jobs; i++)
+    jobs[i].tile_data = g_malloc (tile_size);
+
+  pipeline.jobs = jobs;
+
+  while (success && next_tile < ntiles)
+    {
+      guint n_batch = MIN (n_jobs, ntiles - next_tile);
+
+      for (i = 0; i < n_batch; i++)
+        {
+          XcfLoadJob *job         = &jobs[i];
+          guint       tile        = next_tile + i;
+          gint        data_length = offsets[tile + 1] - offsets[tile];
+
+          gimp_gegl_buffer_get_tile_rect (buffer,
+                                          XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                          tile, &job->rect);
+
+          job->data_length = 0;
+          job->success     = TRUE;
+
+          /* see bug #357809 in xcf_load_tile_rle() */
+          if (data_length > 0)
+            {
+              if (! info->mapped_file && data_length > job->xcfdata_size)
+                {
+                  job->xcfdata      = g_realloc (job->xcfdata, data_length);
+                  job->xcfdata_size = data_length;
+                }
+
+              job->data_length = data_length;
+              job->data        = xcf_load_tile_data (info, offsets[tile],
+                                                     &job->data_length,
+                                                     job->xcfdata);
+
+              if (! job->data)
+                {
+                  success = FALSE;
+                  break;
+                }
+            }
+        }
+
+      if (! success)
+        break;
+
+      gimp_parallel_distribute (n_batch,
+                                (GimpParallelDistributeFunc) xcf_load_decode_job,
+                                &pipeline);
+
+      for (i = 0; i < n_batch; i++)
+        {
+          XcfLoadJob *job = &jobs[i];
+
+          if (! job->success)
+            {
+              success = FALSE;
+              break;
+            }
+
+          if (job->data_length > 0)
+            gegl_buffer_set (buffer, &job->rect, 0, format, job->tile_data,
+                             GEGL_AUTO_ROWSTRIDE);
+        }
+
+      next_tile += n_batch;
+    }
+
+  for (i = 0; i < n_jobs; i++)
+    {
+      g_free (jobs[i].xcfdata);
+      g_free (jobs[i].tile_data);
+    }
+
+  g_free (jobs);
+  g_free (offsets);
+
+  return success;
+}
+
+#endif /* ENABLE_MP */
+
+/*  Reads the rest of a level's tile offset table, the first offset
+ *  has been read already. The returned table has one more entry than
+ *  the level has tiles, holding the maximum possible end of the last
+ *  tile.
+ */
+static goffset *
+xcf_load_level_offsets (XcfInfo *info,
+                        goffset  offset,
+                        guint    ntiles,
+                        gint     tile_size)
+{
+  goffset *offsets;
+  guint    i;
+
+  offsets = g_new (goffset, ntiles + 1);
+  offsets[0] = offset;
+  info->cp += xcf_read_offset (info, offsets + 1, ntiles);
+
+  for (i = 0; i < ntiles; i++)
+    {
+      if (offsets[i] == 0)
+        {
+          gimp_message_literal (info->gimp, G_OBJECT (info->progress),
+                                GIMP_MESSAGE_ERROR,
+                                "not enough tiles found in level");
+          g_free (offsets);
+          return NULL;
+        }
+    }
+
+  if (offsets[ntiles] != 0)
+    {
+      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
+                    "encountered garbage after reading level: %"
+                    G_GOFFSET_FORMAT, offsets[ntiles]);
+      g_free (offsets);
+      return NULL;
+    }
+
+  /* if the offset is 0 then we need to read in the maximum possible
+     allowing for negative compression */
+  offsets[ntiles] = offsets[ntiles - 1] + tile_size * 1.5;
+
+  return offsets;
+}
+
+
+/*  Lazy loading: instead of decoding a level's tiles, its offset table
+ *  is kept together with a reference on the mapped or reopened XCF
+ *  file, and a validate proc on the level's TileManager decodes each
+ *  tile when it is first accessed. Once all tiles of a level are
+ *  loaded, its reference on the file is dropped.
+ */
+
+struct _XcfLazySource
+{
+  gint                ref_count;
+  GMappedFile        *mapped_file; /*  either the file is mapped  */
+  FILE               *fp;          /*  or it is read from a copy  */
+  gchar              *filename;
+};
+
+typedef struct _XcfLazyLevel XcfLazyLevel;
+
+struct _XcfLazyLevel
+{
+  XcfLazySource      *source;
+  TileManager        *tiles;       /*  not referenced  */
+  XcfCompressionType  compression;
+  gint                bpp;
+  gint                n_tile_cols;
+  guint               ntiles;
+  goffset            *offsets;
+  guint8             *pending;
+  guint               n_pending;
+};
+
+/*  protects all lazy sources and levels, and serializes file access  */
+static GMutex  lazy_mutex;
+static GList  *lazy_levels = NULL;
+
+static XcfLazySource *
+xcf_lazy_source_new (XcfInfo *info)
+{
+  XcfLazySource *source;
+  FILE          *fp = NULL;
+
+  if (! info->mapped_file)
+    {
+      fp = g_fopen (info->filename, "rb");
+
+      if (! fp)
+        return NULL;
+    }
+
+  source = g_slice_new0 (XcfLazySource);
+
+  source->ref_count = 1;
+  source->fp        = fp;
+  source->filename  = g_strdup (info->filename);
+
+  if (info->mapped_file)
+    source->mapped_file = g_mapped_file_ref (info->mapped_file);
+
+  return source;
+}
+
+/*  must be called with lazy_mutex held  */
+static void
+xcf_lazy_source_unref (XcfLazySource *source)
+{
+  source->ref_count--;
+
+  if (source->ref_count < 1)
+    {
+      if (source->mapped_file)
+        g_mapped_file_unref (source->mapped_file);
+
+      if (source->fp)
+        fclose (source->fp);
+
+      g_free (source->filename);
+
+      g_slice_free (XcfLazySource, source);
+    }
+}
+
+static void
+xcf_lazy_level_free (XcfLazyLevel *level)
+{
+  g_mutex_lock (&lazy_mutex);
+
+  lazy_levels = g_list_remove (lazy_levels, level);
+
+  if (level->source)
+    xcf_lazy_source_unref (level->source);
+
+  g_mutex_unlock (&lazy_mutex);
+
+  g_free (level->offsets);
+  g_free (level->pending);
+
+  g_slice_free (XcfLazyLevel, level);
+}
+
+static void
+xcf_lazy_level_validate (TileManager  *tm,
+                         Tile         *tile,
+                         XcfLazyLevel *level)
+{
+  guchar        *tile_data   = tile_data_pointer (tile, 0, 0);
+  gint           size        = tile_size (tile);
+  XcfLazySource *source      = NULL;
+  const guchar  *data        = NULL;
+  guchar        *xcfdata     = NULL;
+  gint           data_length = 0;
+  gboolean       success     = FALSE;
+  gint           tile_col;
+  gint           tile_row;
+  guint          num;
+
+  tile_manager_get_tile_col_row (tm, tile, &tile_col, &tile_row);
+  num = tile_row * level->n_tile_cols + tile_col;
+
+  g_mutex_lock (&lazy_mutex);
+
+  if (level->source && num < level->ntiles && level->pending[num])
+    {
+      data_length = level->offsets[num + 1] - level->offsets[num];
+
+      if (level->compression == COMPRESS_NONE)
+        data_length = size;
+
+      /* see bug #357809 in xcf_load_tile_rle() */
+      if (data_length > 0 && level->source->mapped_file)
+        {
+          GMappedFile *mapped_file = level->source->mapped_file;
+          goffset      length      = g_mapped_file_get_length (mapped_file);
+
+          if (level->offsets[num] < length)
+            {
+              /*  keep the mapping around while decoding  */
+              source = level->source;
+              source->ref_count++;
+
+              data = ((const guchar *) g_mapped_file_get_contents (mapped_file) +
+                      level->offsets[num]);
+              data_length = MIN (data_length, length - level->offsets[num]);
+            }
+        }
+      else if (data_length > 0)
+        {
+          xcfdata = g_malloc (data_length);
+
+          /* we may be reading past the end of the file here */
+          if (fseeko (level->source->fp, level->offsets[num], SEEK_SET) == 0)
+            data_length = fread ((gchar *) xcfdata, sizeof (gchar),
+                                 data_length, level->source->fp);
+          else
+            data_length = 0;
+
+          data = xcfdata;
+        }
+
+      level->pending[num] = FALSE;
+      level->n_pending--;
+
+      if (level->n_pending == 0)
+        {
+          xcf_lazy_source_unref (level->source);
+          level->source = NULL;
+        }
+    }
+
+  g_mutex_unlock (&lazy_mutex);
+
+  if (! data)
+    {
+      memset (tile_data, 0, size);
+      return;
+    }
+
+  switch (level->compression)
+    {
+    case COMPRESS_NONE:
+      success = (data_length == size);
+      if (success)
+        memcpy (tile_data, data, size);
+      break;
+
+    case COMPRESS_RLE:
+      success = xcf_load_decode_rle (data, data_length, level->bpp,
+                                     size / level->bpp, tile_data);
+      break;
+
+#ifdef HAVE_ZLIB
+    case COMPRESS_ZLIB:
+      success = xcf_load_decode_zlib (data, data_length, tile_data, size);
+      break;
+#endif
+
+    default:
+      break;
+    }
+
+  if (! success)
+    {
+      g_printerr ("xcf: failed to load tile %d of a lazily loaded level\n",
+                  num);
+      memset (tile_data, 0, size);
+    }
+
+  if (source)
+    {
+      g_mutex_lock (&lazy_mutex);
+      xcf_lazy_source_unref (source);
+      g_mutex_unlock (&lazy_mutex);
+    }
+
+  g_free (xcfdata);
+}
+
+static gboolean
+xcf_load_level_lazy (XcfInfo    *info,
+                     GeglBuffer *buffer,
+                     goffset     offset,
+                     guint       ntiles)
+{
+  const Babl   *format = gegl_buffer_get_format (buffer);
+  TileManager  *tiles  = gimp_gegl_buffer_get_tiles (buffer);
+  XcfLazyLevel *level;
+  goffset      *offsets;
+  gint          bpp;
+
+  bpp = babl_format_get_bytes_per_pixel (format);
+
+  offsets = xcf_load_level_offsets (info, offset, ntiles,
+                                    XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp);
+  if (! offsets)
+    return FALSE;
+
+  if (! info->lazy_source)
+    {
+      info->lazy_source = xcf_lazy_source_new (info);
+
+      if (! info->lazy_source)
+        {
+          gimp_message (info->gimp, G_OBJECT (info->progress),
+                        GIMP_MESSAGE_ERROR,
+                        "could not reopen '%s' for lazy loading",
+                        gimp_filename_to_utf8 (info->filename));
+          g_free (offsets);
+          return FALSE;
+        }
+    }
+
+  level = g_slice_new0 (XcfLazyLevel);
+
+  level->tiles       = tiles;
+  level->compression = info->compression;
+  level->bpp         = bpp;
+  level->n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer,
+                                                         XCF_TILE_WIDTH);
+  level->ntiles      = ntiles;
+  level->offsets     = offsets;
+  level->pending     = g_new (guint8, ntiles);
+  level->n_pending   = ntiles;
+
+  memset (level->pending, TRUE, ntiles);
+
+  g_mutex_lock (&lazy_mutex);
+
+  level->source = info->lazy_source;
+  level->source->ref_count++;
+
+  lazy_levels = g_list_prepend (lazy_levels, level);
+
+  g_mutex_unlock (&lazy_mutex);
+
+  tile_manager_invalidate_area (tiles, 0, 0,
+                                tile_manager_width (tiles),
+                                tile_manager_height (tiles));
+  tile_manager_set_validate_proc_full (tiles,
+                                       (TileValidateProc) xcf_lazy_level_validate,
+                                       level,
+                                       (GDestroyNotify) xcf_lazy_level_free);
+
+  return TRUE;
+}
+
+/**
+ * xcf_load_lazy_finish:
+ * @info: the #XcfInfo of a finished load
+ *
+ * Drops the load's own reference on the file used for lazy loading.
+ * The file stays open as long as lazily loaded tiles are pending.
+ */
+void
+xcf_load_lazy_finish (XcfInfo *info)
+{
+  if (info->lazy_source)
+    {
+      g_mutex_lock (&lazy_mutex);
+      xcf_lazy_source_unref (info->lazy_source);
+      g_mutex_unlock (&lazy_mutex);
+
+      info->lazy_source = NULL;
+    }
+}
+
+/**
+ * xcf_load_lazy_flush:
+ * @filename: the file that is about to be overwritten
+ *
+ * Loads all pending tiles that are lazily loaded from @filename, so
+ * the file can be overwritten safely.
+ */
+void
+xcf_load_lazy_flush (const gchar *filename)
+{
+  GList *flush = NULL;
+  GList *list;
+
+  g_mutex_lock (&lazy_mutex);
+
+  for (list = lazy_levels; list; list = g_list_next (list))
+    {
+      XcfLazyLevel *level = list->data;
+
+      if (level->source && ! strcmp (level->source->filename, filename))
+        flush = g_list_prepend (flush, tile_manager_ref (level->tiles));
+    }
+
+  g_mutex_unlock (&lazy_mutex);
+
+  for (list = flush; list; list = g_list_next (list))
+    {
+      TileManager *tiles  = list->data;
+      gint         width  = tile_manager_width (tiles);
+      gint         height = tile_manager_height (tiles);
+      gint         x, y;
+
+      /*  locking validates the tiles that were not loaded yet  */
+      for (y = 0; y < height; y += TILE_HEIGHT)
+        for (x = 0; x < width; x += TILE_WIDTH)
+          {
+            Tile *tile = tile_manager_get_tile (tiles, x, y, TRUE, FALSE);
+
+            tile_release (tile, FALSE);
+          }
+
+      tile_manager_unref (tiles);
+    }
+
+  g_list_free (flush);
+}
+
+/*  Reads file offsets, which are 64 bit values since version 5 of the
+ *  file format and 32 bit values before.
+ */
+static guint
+xcf_read_offset (XcfInfo *info,
+                 goffset *data,
+                 gint     count)
+{
+  guint total = 0;
+  gint  i;
+
+  for (i = 0; i < count; i++)
+    {
+      if (info->bytes_per_offset == 8)
+        {
+          guint64 tmp = 0;
+
+          total += xcf_read_int64 (info->fp, &tmp, 1);
+          data[i] = tmp;
+        }
+      else
+        {
+          guint32 tmp = 0;
+
+          total += xcf_read_int32 (info->fp, &tmp, 1);
+          data[i] = tmp;
+        }
+    }
+
+  return total;
+}
+
 static GimpParasite *
 xcf_load_parasite (XcfInfo *info)
 {
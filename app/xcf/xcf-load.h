@@ -23,5 +23,8 @@ GimpImage * xcf_load_image (Gimp     *gimp,
                             XcfInfo  *info,
                             GError  **error);
 
+void        xcf_load_lazy_finish (XcfInfo     *info);
+void        xcf_load_lazy_flush  (const gchar *filename);
+
 
 #endif  /* __XCF_LOAD_H__ */
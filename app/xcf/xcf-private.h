@@ -22,6 +22,11 @@
 #define XCF_TILE_WIDTH  64
 #define XCF_TILE_HEIGHT 64
 
+#ifdef G_OS_WIN32
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#endif
+
 typedef enum
 {
   PROP_END                =  0,
@@ -62,7 +67,7 @@ typedef enum
 {
   COMPRESS_NONE              =  0,
   COMPRESS_RLE               =  1,
-  COMPRESS_ZLIB              =  2,  /* unused */
+  COMPRESS_ZLIB              =  2,
   COMPRESS_FRACTAL           =  3   /* unused */
 } XcfCompressionType;
 
@@ -83,25 +88,31 @@ typedef enum
   XCF_GROUP_ITEM_EXPANDED      = 1
 } XcfGroupItemFlagsType;
 
-typedef struct _XcfInfo  XcfInfo;
+typedef struct _XcfInfo       XcfInfo;
+typedef struct _XcfLazySource XcfLazySource;
+typedef struct _XcfSaveState  XcfSaveState;
 
 struct _XcfInfo
 {
   Gimp               *gimp;
   GimpProgress       *progress;
   FILE               *fp;
-  guint               cp;
+  goffset             cp;
   const gchar        *filename;
   GimpTattoo          tattoo_state;
   GimpLayer          *active_layer;
   GimpChannel        *active_channel;
   GimpDrawable       *floating_sel_drawable;
   GimpLayer          *floating_sel;
-  guint               floating_sel_offset;
+  goffset             floating_sel_offset;
   gint                swap_num;
   gint               *ref_count;
   XcfCompressionType  compression;
   gint                file_version;
+  gint                bytes_per_offset;
+  XcfLazySource      *lazy_source;
+  GMappedFile        *mapped_file;
+  XcfSaveState       *save_state;
 };
 
 
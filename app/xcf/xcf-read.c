@@ -19,6 +19,9 @@
 
 #include <stdio.h>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
 #include <glib-object.h>
 
 #include "libgimpbase/gimpbase.h"
@@ -50,6 +53,27 @@ xcf_read_int32 (FILE    *fp,
   return total;
 }
 
+guint
+xcf_read_int64 (FILE    *fp,
+                guint64 *data,
+                gint     count)
+{
+  guint total = 0;
+
+  if (count > 0)
+    {
+      total += xcf_read_int8 (fp, (guint8 *) data, count * 8);
+
+      while (count--)
+        {
+          *data = GUINT64_FROM_BE (*data);
+          data++;
+        }
+    }
+
+  return total;
+}
+
 guint
 xcf_read_float (FILE   *fp,
                 gfloat *data,
@@ -81,6 +105,23 @@ xcf_read_int8 (FILE   *fp,
   return total;
 }
 
+/*  Maps the whole file read by fp into memory, so tile data can be
+ *  used without reading it. Returns NULL if fp is not a regular file
+ *  or can't be mapped, reading has to go through fp then.
+ */
+GMappedFile *
+xcf_read_map (FILE *fp)
+{
+  struct stat st;
+
+  if (fstat (fileno (fp), &st) == -1 ||
+      ! S_ISREG (st.st_mode)          ||
+      st.st_size == 0)
+    return NULL;
+
+  return g_mapped_file_new_from_fd (fileno (fp), FALSE, NULL);
+}
+
 guint
 xcf_read_string (FILE   *fp,
                  gchar **data,
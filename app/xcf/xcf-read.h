@@ -22,6 +22,9 @@
 guint   xcf_read_int32  (FILE     *fp,
                          guint32  *data,
                          gint      count);
+guint   xcf_read_int64  (FILE     *fp,
+                         guint64  *data,
+                         gint      count);
 guint   xcf_read_float  (FILE     *fp,
                          gfloat   *data,
                          gint      count);
@@ -32,5 +35,7 @@ guint   xcf_read_string (FILE     *fp,
                          gchar   **data,
                          gint      count);
 
+GMappedFile * xcf_read_map (FILE  *fp);
+
 
 #endif  /* __XCF_READ_H__ */
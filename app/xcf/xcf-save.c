@@ -20,19 +20,27 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <cairo.h>
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include <glib/gstdio.h>
 
 #include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "gegl/gimp-babl-compat.h"
 #include "gegl/gimp-gegl-tile-compat.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
 #include "core/gimpcontainer.h"
 #include "core/gimpchannel.h"
 #include "core/gimpdrawable.h"
@@ -68,6 +76,49 @@
 #include "gimp-intl.h"
 
 
+/*  the space a full save leaves after the image properties and offset
+ *  tables at least, so later incremental saves can rewrite them in place
+ */
+#define XCF_SAVE_MIN_RESERVE 4096
+
+/*  an incremental save rewrites the whole file instead once more than
+ *  this part of it is no longer referenced
+ */
+#define XCF_SAVE_MAX_GARBAGE 0.5
+
+#define XCF_SAVE_STATE_KEY   "gimp-xcf-save-state"
+
+
+typedef struct _XcfSavedHierarchy XcfSavedHierarchy;
+
+struct _XcfSavedHierarchy
+{
+  GimpDrawable *drawable;     /*  weak pointer                          */
+  guint         dirty_stamp;  /*  the drawable's stamp when it was saved */
+  goffset       offset;
+  goffset       size;
+};
+
+struct _XcfSaveState
+{
+  gchar              *filename;
+  gint                file_version;
+  XcfCompressionType  compression;
+
+  goffset             props_pos;        /*  start of the image properties   */
+  goffset             header_end;       /*  end of the space reserved for
+                                         *  them and the offset tables
+                                         */
+  goffset             headers_size;     /*  of all layer and channel headers */
+  goffset             file_size;
+  gint64              mtime;
+
+  GHashTable         *hierarchies;      /*  of the last save                */
+  GHashTable         *new_hierarchies;  /*  of the save in progress         */
+  gboolean            append;
+};
+
+
 static gboolean xcf_save_image_props   (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
@@ -109,6 +160,41 @@ static gboolean xcf_save_tile_rle      (XcfInfo           *info,
                                         const Babl        *format,
                                         guchar            *rlebuf,
                                         GError           **error);
+#ifdef HAVE_ZLIB
+static gboolean xcf_save_tile_zlib     (XcfInfo           *info,
+                                        GeglBuffer        *buffer,
+                                        GeglRectangle     *tile_rect,
+                                        const Babl        *format,
+                                        guchar            *zlibbuf,
+                                        gint               zlibbuf_size,
+                                        GError           **error);
+static gint     xcf_save_encode_zlib   (const guchar      *tile_data,
+                                        gint               tile_size,
+                                        guchar            *zlibbuf,
+                                        gint               zlibbuf_size);
+#endif
+static gint     xcf_save_encode_rle    (const guchar      *tile_data,
+                                        gint               bpp,
+                                        gint               n_pixels,
+                                        guchar            *rlebuf,
+                                        gboolean          *valid);
+#ifdef ENABLE_MP
+static gboolean xcf_save_level_parallel
+                                       (XcfInfo           *info,
+                                        GeglBuffer        *buffer,
+                                        guint              ntiles,
+                                        gint               n_threads,
+                                        goffset           *saved_pos,
+                                        GError           **error);
+#endif
+static guint    xcf_write_offset       (XcfInfo           *info,
+                                        const goffset     *data,
+                                        gint               count,
+                                        GError           **error);
+static gboolean xcf_save_tile_offset   (XcfInfo           *info,
+                                        goffset            offset,
+                                        goffset           *saved_pos,
+                                        GError           **error);
 static gboolean xcf_save_parasite      (XcfInfo           *info,
                                         GimpParasite      *parasite,
                                         GError           **error);
@@ -122,6 +208,24 @@ static gboolean xcf_save_vectors       (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
 
+static XcfSaveState * xcf_save_state_new           (XcfInfo            *info);
+static void           xcf_save_state_free          (XcfSaveState       *state);
+static GHashTable   * xcf_save_hierarchies_new     (void);
+static void           xcf_saved_hierarchy_free     (XcfSavedHierarchy  *hierarchy);
+static GList        * xcf_save_get_channel_list    (GimpImage          *image);
+static goffset        xcf_save_measure_image_props (XcfInfo            *info,
+                                                    GimpImage          *image);
+static gboolean       xcf_save_stat                (const gchar        *filename,
+                                                    goffset            *size,
+                                                    gint64             *mtime);
+static gboolean       xcf_save_reuse_hierarchy     (XcfInfo            *info,
+                                                    GimpDrawable       *drawable,
+                                                    goffset            *offset);
+static gboolean       xcf_save_add_hierarchy       (XcfInfo            *info,
+                                                    GimpDrawable       *drawable,
+                                                    goffset             offset,
+                                                    GError            **error);
+
 
 /* private convenience macros */
 #define xcf_write_int32_check_error(info, data, count) G_STMT_START { \
@@ -133,6 +237,15 @@ static gboolean xcf_save_vectors       (XcfInfo           *info,
     }                                                              \
   } G_STMT_END
 
+#define xcf_write_offset_check_error(info, data, count) G_STMT_START { \
+  info->cp += xcf_write_offset (info, data, count, &tmp_error);     \
+  if (tmp_error)                                                    \
+    {                                                               \
+      g_propagate_error (error, tmp_error);                         \
+      return FALSE;                                                 \
+    }                                                               \
+  } G_STMT_END
+
 #define xcf_write_int8_check_error(info, data, count) G_STMT_START { \
   info->cp += xcf_write_int8 (info->fp, data, count, &tmp_error); \
   if (tmp_error)                                                  \
@@ -218,7 +331,156 @@ xcf_save_choose_format (XcfInfo   *info,
   if (gimp_image_get_precision (image) != GIMP_PRECISION_U8)
     save_version = MAX (4, save_version);
 
-  info->file_version = save_version;
+#ifdef HAVE_ZLIB
+  /* need version 5 for zlib compressed tiles */
+  if (GIMP_CORE_CONFIG (info->gimp->config)->xcf_compression)
+    {
+      info->compression = COMPRESS_ZLIB;
+      save_version = MAX (5, save_version);
+    }
+#endif
+
+  /* need version 5 for 64 bit offsets, the image's memsize is a
+   * generous estimate of the file size
+   */
+  if (gimp_object_get_memsize (GIMP_OBJECT (image), NULL) > G_MAXUINT32 / 2)
+    save_version = MAX (5, save_version);
+
+  info->file_version     = save_version;
+  info->bytes_per_offset = (save_version >= 5) ? 8 : 4;
+}
+
+/**
+ * xcf_save_begin_incremental:
+ * @info:  an #XcfInfo set up by xcf_save_choose_format()
+ * @image: the image that is about to be saved
+ *
+ * Sets up @info for an incremental save of @image. If @image was
+ * incrementally saved to the same file before, the file was not
+ * touched since, and the image properties and offset tables still
+ * fit into the space reserved at the start of the file, the save
+ * can append the layers and channels whose pixels changed to the
+ * file, and reuse the hierarchies of all others.
+ *
+ * Otherwise, and once too much of the file is no longer referenced,
+ * the save rewrites the whole file.
+ *
+ * Return value: %TRUE if the file must be opened for appending.
+ **/
+gboolean
+xcf_save_begin_incremental (XcfInfo   *info,
+                            GimpImage *image)
+{
+  XcfSaveState *state;
+  goffset       file_size;
+  gint64        mtime;
+
+  state = g_object_get_data (G_OBJECT (image), XCF_SAVE_STATE_KEY);
+
+  if (state                                             &&
+      ! strcmp (state->filename, info->filename)        &&
+      state->file_version == info->file_version         &&
+      state->compression  == info->compression          &&
+      xcf_save_stat (info->filename, &file_size, &mtime) &&
+      file_size == state->file_size                     &&
+      mtime     == state->mtime)
+    {
+      GHashTableIter     iter;
+      XcfSavedHierarchy *hierarchy;
+      GList             *layers;
+      GList             *channels;
+      goffset            live;
+      goffset            tables_size;
+      goffset            props_size;
+
+      live = state->header_end + state->headers_size;
+
+      g_hash_table_iter_init (&iter, state->hierarchies);
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &hierarchy))
+        live += hierarchy->size;
+
+      layers   = gimp_image_get_layer_list (image);
+      channels = xcf_save_get_channel_list (image);
+
+      tables_size = ((g_list_length (layers) + g_list_length (channels) + 2) *
+                     info->bytes_per_offset);
+
+      g_list_free (layers);
+      g_list_free (channels);
+
+      props_size = xcf_save_measure_image_props (info, image);
+
+      if (file_size - live <= file_size * XCF_SAVE_MAX_GARBAGE             &&
+          props_size > 0                                                  &&
+          state->props_pos + props_size + tables_size <= state->header_end &&
+          /*  don't append past what 32 bit offsets can address  */
+          (info->bytes_per_offset == 8 ||
+           file_size + gimp_object_get_memsize (GIMP_OBJECT (image),
+                                                NULL) <= G_MAXUINT32 / 2))
+        {
+          state->headers_size    = 0;
+          state->new_hierarchies = xcf_save_hierarchies_new ();
+          state->append          = TRUE;
+
+          info->save_state = state;
+
+          return TRUE;
+        }
+    }
+
+  info->save_state = xcf_save_state_new (info);
+
+  return FALSE;
+}
+
+/**
+ * xcf_save_end_incremental:
+ * @info:    the #XcfInfo passed to xcf_save_begin_incremental()
+ * @image:   the saved image
+ * @success: whether the save succeeded
+ *
+ * Remembers where the hierarchies of @image ended up, for the next
+ * incremental save. After a failed save the next save is a full one.
+ **/
+void
+xcf_save_end_incremental (XcfInfo   *info,
+                          GimpImage *image,
+                          gboolean   success)
+{
+  XcfSaveState *state = info->save_state;
+  XcfSaveState *old_state;
+
+  g_return_if_fail (state != NULL);
+
+  info->save_state = NULL;
+
+  old_state = g_object_get_data (G_OBJECT (image), XCF_SAVE_STATE_KEY);
+
+  if (success)
+    success = xcf_save_stat (state->filename,
+                             &state->file_size, &state->mtime);
+
+  if (success)
+    {
+      if (state->hierarchies)
+        g_hash_table_unref (state->hierarchies);
+
+      state->hierarchies     = state->new_hierarchies;
+      state->new_hierarchies = NULL;
+      state->append          = FALSE;
+
+      if (state != old_state)
+        g_object_set_data_full (G_OBJECT (image), XCF_SAVE_STATE_KEY, state,
+                                (GDestroyNotify) xcf_save_state_free);
+    }
+  else if (state == old_state)
+    {
+      g_object_set_data (G_OBJECT (image), XCF_SAVE_STATE_KEY, NULL);
+    }
+  else
+    {
+      xcf_save_state_free (state);
+    }
 }
 
 gint
@@ -229,14 +491,15 @@ xcf_save_image (XcfInfo    *info,
   GList   *all_layers;
   GList   *all_channels;
   GList   *list;
-  guint32  saved_pos;
-  guint32  offset;
+  goffset  props_pos;
+  goffset  saved_pos;
+  goffset  tables_size;
+  goffset  offset;
   guint32  value;
   guint    n_layers;
   guint    n_channels;
   guint    progress = 0;
   guint    max_progress;
-  gint     t1, t2, t3, t4;
   gchar    version_tag[16];
   GError  *tmp_error = NULL;
 
@@ -270,14 +533,7 @@ xcf_save_image (XcfInfo    *info,
 
   /* determine the number of layers and channels in the image */
   all_layers   = gimp_image_get_layer_list (image);
-  all_channels = gimp_image_get_channel_list (image);
-
-  /* check and see if we have to save out the selection */
-  if (gimp_channel_bounds (gimp_image_get_mask (image),
-                           &t1, &t2, &t3, &t4))
-    {
-      all_channels = g_list_append (all_channels, gimp_image_get_mask (image));
-    }
+  all_channels = xcf_save_get_channel_list (image);
 
   n_layers   = (guint) g_list_length (all_layers);
   n_channels = (guint) g_list_length (all_channels);
@@ -286,6 +542,7 @@ xcf_save_image (XcfInfo    *info,
 
   /* write the property information for the image.
    */
+  props_pos = info->cp;
 
   xcf_check_error (xcf_save_image_props (info, image, error));
 
@@ -294,12 +551,36 @@ xcf_save_image (XcfInfo    *info,
   /* save the current file position as it is the start of where
    *  we place the layer offset information.
    */
-  saved_pos = info->cp;
+  saved_pos   = info->cp;
+  tables_size = (n_layers + n_channels + 2) * info->bytes_per_offset;
 
-  /* seek to after the offset lists */
-  xcf_check_error (xcf_seek_pos (info,
-                                 info->cp + (n_layers + n_channels + 2) * 4,
-                                 error));
+  if (info->save_state && info->save_state->append)
+    {
+      /* xcf_save_begin_incremental() made sure that the offset lists
+       *  fit, everything else goes after what is already in the file
+       */
+      xcf_check_error (xcf_seek_end (info, error));
+    }
+  else
+    {
+      goffset reserve = 0;
+
+      /* leave room for the image properties and offset lists to
+       *  grow in later incremental saves
+       */
+      if (info->save_state)
+        {
+          reserve = MAX (XCF_SAVE_MIN_RESERVE,
+                         saved_pos - props_pos + tables_size);
+
+          info->save_state->props_pos  = props_pos;
+          info->save_state->header_end = saved_pos + tables_size + reserve;
+        }
+
+      /* seek to after the offset lists */
+      xcf_check_error (xcf_seek_pos (info, saved_pos + tables_size + reserve,
+                                     error));
+    }
 
   for (list = all_layers; list; list = g_list_next (list))
     {
@@ -319,7 +600,7 @@ xcf_save_image (XcfInfo    *info,
        *  layer offset and write it out.
        */
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
+      xcf_write_offset_check_error (info, &offset, 1);
 
       /* increment the location we are to write out the
        *  next offset.
@@ -337,7 +618,7 @@ xcf_save_image (XcfInfo    *info,
    */
   offset = 0;
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
   saved_pos = info->cp;
   xcf_check_error (xcf_seek_end (info, error));
 
@@ -359,7 +640,7 @@ xcf_save_image (XcfInfo    *info,
        *  channel offset and write it out.
        */
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
+      xcf_write_offset_check_error (info, &offset, 1);
 
       /* increment the location we are to write out the
        *  next offset.
@@ -380,7 +661,7 @@ xcf_save_image (XcfInfo    *info,
    */
   offset = 0;
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
   saved_pos = info->cp;
 
   return !ferror (info->fp);
@@ -669,15 +950,15 @@ xcf_save_prop (XcfInfo    *info,
 
     case PROP_FLOATING_SELECTION:
       {
-        guint32 dummy;
+        goffset dummy;
 
         dummy = 0;
-        size = 4;
+        size = info->bytes_per_offset;
 
         xcf_write_prop_type_check_error (info, prop_type);
         xcf_write_int32_check_error (info, &size, 1);
         info->floating_sel_offset = info->cp;
-        xcf_write_int32_check_error (info, &dummy, 1);
+        xcf_write_offset_check_error (info, &dummy, 1);
       }
       break;
 
@@ -958,8 +1239,9 @@ xcf_save_prop (XcfInfo    *info,
     case PROP_PARASITES:
       {
         GimpParasiteList *list;
-        guint32           base, length;
-        long              pos;
+        goffset           base;
+        guint32           length;
+        goffset           pos;
 
         list = va_arg (args, GimpParasiteList *);
 
@@ -1007,8 +1289,9 @@ xcf_save_prop (XcfInfo    *info,
 
     case PROP_PATHS:
       {
-        guint32 base, length;
-        glong   pos;
+        goffset base;
+        guint32 length;
+        goffset pos;
 
         xcf_write_prop_type_check_error (info, prop_type);
 
@@ -1073,8 +1356,9 @@ xcf_save_prop (XcfInfo    *info,
 
     case PROP_VECTORS:
       {
-        guint32 base, length;
-        glong   pos;
+        goffset base;
+        guint32 length;
+        goffset pos;
 
         xcf_write_prop_type_check_error (info, prop_type);
 
@@ -1162,8 +1446,9 @@ xcf_save_layer (XcfInfo    *info,
                 GimpLayer  *layer,
                 GError    **error)
 {
-  guint32      saved_pos;
-  guint32      offset;
+  goffset      start;
+  goffset      saved_pos;
+  goffset      offset;
   guint32      value;
   const gchar *string;
   GError      *tmp_error = NULL;
@@ -1175,10 +1460,12 @@ xcf_save_layer (XcfInfo    *info,
     {
       saved_pos = info->cp;
       xcf_check_error (xcf_seek_pos (info, info->floating_sel_offset, error));
-      xcf_write_int32_check_error (info, &saved_pos, 1);
+      xcf_write_offset_check_error (info, &saved_pos, 1);
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
     }
 
+  start = info->cp;
+
   /* write out the width, height and image type information for the layer */
   value = gimp_item_get_width (GIMP_ITEM (layer));
   xcf_write_int32_check_error (info, &value, 1);
@@ -1201,16 +1488,39 @@ xcf_save_layer (XcfInfo    *info,
    */
   saved_pos = info->cp;
 
-  /*  write out the layer tile hierarchy  */
-  xcf_check_error (xcf_seek_pos (info, info->cp + 8, error));
-  offset = info->cp;
+  if (info->save_state)
+    info->save_state->headers_size += (saved_pos - start +
+                                       2 * info->bytes_per_offset);
 
-  xcf_check_error (xcf_save_buffer (info,
-                                    gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                    error));
+  if (xcf_save_reuse_hierarchy (info, GIMP_DRAWABLE (layer), &offset))
+    {
+      goffset offsets[2] = { offset, 0 };
 
-  xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+      /*  the mask offset is filled in below, but must not be
+       *  overwritten by the mask itself
+       */
+      xcf_write_offset_check_error (info, offsets, 2);
+      xcf_check_error (xcf_seek_pos (info,
+                                     saved_pos + info->bytes_per_offset,
+                                     error));
+    }
+  else
+    {
+      /*  write out the layer tile hierarchy  */
+      xcf_check_error (xcf_seek_pos (info,
+                                     info->cp + 2 * info->bytes_per_offset,
+                                     error));
+      offset = info->cp;
+
+      xcf_check_error (xcf_save_buffer (info,
+                                        gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                                        error));
+      xcf_check_error (xcf_save_add_hierarchy (info, GIMP_DRAWABLE (layer),
+                                               offset, error));
+
+      xcf_check_error (xcf_seek_pos (info, saved_pos, error));
+      xcf_write_offset_check_error (info, &offset, 1);
+    }
 
   /*  save the current position which is where the layer mask offset
    *  will be stored.
@@ -1232,7 +1542,7 @@ xcf_save_layer (XcfInfo    *info,
     offset = 0;
 
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
 
   return TRUE;
 }
@@ -1243,8 +1553,9 @@ xcf_save_channel (XcfInfo      *info,
                   GimpChannel  *channel,
                   GError      **error)
 {
-  guint32      saved_pos;
-  guint32      offset;
+  goffset      start;
+  goffset      saved_pos;
+  goffset      offset;
   guint32      value;
   const gchar *string;
   GError      *tmp_error = NULL;
@@ -1256,10 +1567,12 @@ xcf_save_channel (XcfInfo      *info,
     {
       saved_pos = info->cp;
       xcf_check_error (xcf_seek_pos (info, info->floating_sel_offset, error));
-      xcf_write_int32_check_error (info, &saved_pos, 1);
+      xcf_write_offset_check_error (info, &saved_pos, 1);
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
     }
 
+  start = info->cp;
+
   /* write out the width and height information for the channel */
   value = gimp_item_get_width (GIMP_ITEM (channel));
   xcf_write_int32_check_error (info, &value, 1);
@@ -1279,16 +1592,30 @@ xcf_save_channel (XcfInfo      *info,
    */
   saved_pos = info->cp;
 
+  if (info->save_state)
+    info->save_state->headers_size += (saved_pos - start +
+                                       info->bytes_per_offset);
+
+  if (xcf_save_reuse_hierarchy (info, GIMP_DRAWABLE (channel), &offset))
+    {
+      xcf_write_offset_check_error (info, &offset, 1);
+
+      return TRUE;
+    }
+
   /* write out the channel tile hierarchy */
-  xcf_check_error (xcf_seek_pos (info, info->cp + 4, error));
+  xcf_check_error (xcf_seek_pos (info, info->cp + info->bytes_per_offset,
+                                 error));
   offset = info->cp;
 
   xcf_check_error (xcf_save_buffer (info,
                                     gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)),
                                     error));
+  xcf_check_error (xcf_save_add_hierarchy (info, GIMP_DRAWABLE (channel),
+                                           offset, error));
 
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
   saved_pos = info->cp;
 
   return TRUE;
@@ -1317,8 +1644,8 @@ xcf_save_buffer (XcfInfo     *info,
                  GError     **error)
 {
   const Babl *format;
-  guint32     saved_pos;
-  guint32     offset;
+  goffset     saved_pos;
+  goffset     offset;
   guint32     width;
   guint32     height;
   guint32     bpp;
@@ -1343,7 +1670,9 @@ xcf_save_buffer (XcfInfo     *info,
   tmp2 = xcf_calc_levels (height, XCF_TILE_HEIGHT);
   nlevels = MAX (tmp1, tmp2);
 
-  xcf_check_error (xcf_seek_pos (info, info->cp + (1 + nlevels) * 4, error));
+  xcf_check_error (xcf_seek_pos (info,
+                                 info->cp + (1 + nlevels) * info->bytes_per_offset,
+                                 error));
 
   for (i = 0; i < nlevels; i++)
     {
@@ -1356,20 +1685,21 @@ xcf_save_buffer (XcfInfo     *info,
         }
       else
         {
+          goffset empty = 0;
+
           /* fake an empty level */
-          tmp1 = 0;
           width  /= 2;
           height /= 2;
-          xcf_write_int32_check_error (info, (guint32 *) &width,  1);
-          xcf_write_int32_check_error (info, (guint32 *) &height, 1);
-          xcf_write_int32_check_error (info, (guint32 *) &tmp1,   1);
+          xcf_write_int32_check_error  (info, (guint32 *) &width,  1);
+          xcf_write_int32_check_error  (info, (guint32 *) &height, 1);
+          xcf_write_offset_check_error (info, &empty,              1);
         }
 
       /* seek back to where we are to write out the next
        *  level offset and write it out.
        */
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
+      xcf_write_offset_check_error (info, &offset, 1);
 
       /* increment the location we are to write out the
        *  next offset.
@@ -1387,7 +1717,7 @@ xcf_save_buffer (XcfInfo     *info,
    */
   offset = 0;
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
 
   return TRUE;
 }
@@ -1398,8 +1728,8 @@ xcf_save_level (XcfInfo     *info,
                 GError     **error)
 {
   const Babl *format;
-  guint32     saved_pos;
-  guint32     offset;
+  goffset     saved_pos;
+  goffset     offset;
   guint32     width;
   guint32     height;
   gint        bpp;
@@ -1408,6 +1738,10 @@ xcf_save_level (XcfInfo     *info,
   guint       ntiles;
   gint        i;
   guchar     *rlebuf;
+  gint        rlebuf_size;
+#ifdef ENABLE_MP
+  gint        n_threads;
+#endif
   GError     *tmp_error = NULL;
 
   format = gegl_buffer_get_format (buffer);
@@ -1421,16 +1755,32 @@ xcf_save_level (XcfInfo     *info,
 
   saved_pos = info->cp;
 
-  /* allocate a temporary buffer to store the rle data before it is
-   * written to disk
+  /* allocate a temporary buffer to store the rle or zlib data before
+   * it is written to disk
    */
-  rlebuf = g_alloca (XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp * 1.5);
+  rlebuf_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp * 1.5;
+  rlebuf      = g_alloca (rlebuf_size);
 
   n_tile_rows = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT);
   n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
 
   ntiles = n_tile_rows * n_tile_cols;
-  xcf_check_error (xcf_seek_pos (info, info->cp + (ntiles + 1) * 4, error));
+  xcf_check_error (xcf_seek_pos (info,
+                                 info->cp + (ntiles + 1) * info->bytes_per_offset,
+                                 error));
+
+#ifdef ENABLE_MP
+  n_threads = gimp_parallel_get_n_threads ();
+
+  if ((info->compression == COMPRESS_RLE ||
+       info->compression == COMPRESS_ZLIB) && n_threads > 1 && ntiles > 1)
+    {
+      xcf_check_error (xcf_save_level_parallel (info, buffer, ntiles,
+                                                n_threads, &saved_pos,
+                                                error));
+      ntiles = 0; /* all tiles written */
+    }
+#endif
 
   for (i = 0; i < ntiles; i++)
     {
@@ -1457,28 +1807,19 @@ xcf_save_level (XcfInfo     *info,
                                               rlebuf, error));
           break;
         case COMPRESS_ZLIB:
+#ifdef HAVE_ZLIB
+          xcf_check_error (xcf_save_tile_zlib (info, buffer, &rect, format,
+                                               rlebuf, rlebuf_size, error));
+#else
           g_error ("xcf: zlib compression unimplemented");
+#endif
           break;
         case COMPRESS_FRACTAL:
           g_error ("xcf: fractal compression unimplemented");
           break;
         }
 
-      /* seek back to where we are to write out the next
-       *  tile offset and write it out.
-       */
-      xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
-
-      /* increment the location we are to write out the
-       *  next offset.
-       */
-      saved_pos = info->cp;
-
-      /* seek to the end of the file which is where
-       *  we will write out the next tile.
-       */
-      xcf_check_error (xcf_seek_end (info, error));
+      xcf_check_error (xcf_save_tile_offset (info, offset, &saved_pos, error));
     }
 
   /* write out a '0' offset position to indicate the end
@@ -1486,7 +1827,7 @@ xcf_save_level (XcfInfo     *info,
    */
   offset = 0;
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
 
   return TRUE;
 
@@ -1519,24 +1860,133 @@ xcf_save_tile_rle (XcfInfo        *info,
                    const Babl     *format,
                    guchar         *rlebuf,
                    GError        **error)
+{
+  gint     bpp       = babl_format_get_bytes_per_pixel (format);
+  gint     tile_size = bpp * tile_rect->width * tile_rect->height;
+  guchar  *tile_data = g_alloca (tile_size);
+  gint     len;
+  gboolean valid;
+  GError  *tmp_error = NULL;
+
+  gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  len = xcf_save_encode_rle (tile_data, bpp,
+                             tile_rect->width * tile_rect->height,
+                             rlebuf, &valid);
+
+  if (! valid)
+    g_message ("xcf: uh oh! xcf rle tile saving error");
+
+  xcf_write_int8_check_error (info, rlebuf, len);
+
+  return TRUE;
+}
+
+#ifdef HAVE_ZLIB
+
+static gboolean
+xcf_save_tile_zlib (XcfInfo        *info,
+                    GeglBuffer     *buffer,
+                    GeglRectangle  *tile_rect,
+                    const Babl     *format,
+                    guchar         *zlibbuf,
+                    gint            zlibbuf_size,
+                    GError        **error)
 {
   gint    bpp       = babl_format_get_bytes_per_pixel (format);
   gint    tile_size = bpp * tile_rect->width * tile_rect->height;
   guchar *tile_data = g_alloca (tile_size);
-  gint    len       = 0;
-  gint    i, j;
-  GError *tmp_error  = NULL;
+  gint    len;
+  GError *tmp_error = NULL;
 
   gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
                    GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
+  len = xcf_save_encode_zlib (tile_data, tile_size, zlibbuf, zlibbuf_size);
+
+  if (len < 0)
+    {
+      g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("Error compressing XCF tile data"));
+      return FALSE;
+    }
+
+  xcf_write_int8_check_error (info, zlibbuf, len);
+
+  return TRUE;
+}
+
+/*  Deflates one tile from tile_data into zlibbuf and returns the
+ *  compressed length, or -1 if it doesn't fit. Like the RLE encoder
+ *  below this can be run from the save worker threads.
+ */
+static gint
+xcf_save_encode_zlib (const guchar *tile_data,
+                      gint          tile_size,
+                      guchar       *zlibbuf,
+                      gint          zlibbuf_size)
+{
+  uLongf len = zlibbuf_size;
+
+  if (compress2 (zlibbuf, &len, tile_data, tile_size,
+                 Z_DEFAULT_COMPRESSION) != Z_OK)
+    return -1;
+
+  return len;
+}
+
+#endif /* HAVE_ZLIB */
+
+/*  RLE-encodes one tile from tile_data into rlebuf and returns the
+ *  encoded length. This only touches the passed memory so it can be
+ *  run from the save worker threads.
+ */
+static gint
+xcf_save_encode_rle (const guchar *tile_data,
+                     gint          bpp,
+                     gint          n_pixels,
+                     guchar       *rlebuf,
+                     gboolean     *valid)
+{
+  gint len = 0;
+  gint i, j;
+
+  *valid = TRUE;
+
+  /*  uniform tiles, like the transparent parts of layers, encode to
+   *  a single run per channel, which doesn't need the state machine
+   *  below
+   */
+  if (n_pixels > 0 && n_pixels <= 32768 &&
+      memcmp (tile_data, tile_data + bpp, (n_pixels - 1) * bpp) == 0)
+    {
+      for (i = 0; i < bpp; i++)
+        {
+          if (n_pixels >= 128)
+            {
+              rlebuf[len++] = 127;
+              rlebuf[len++] = (n_pixels >> 8);
+              rlebuf[len++] = n_pixels & 0x00FF;
+              rlebuf[len++] = tile_data[i];
+            }
+          else
+            {
+              rlebuf[len++] = n_pixels - 1;
+              rlebuf[len++] = tile_data[i];
+            }
+        }
+
+      return len;
+    }
+
   for (i = 0; i < bpp; i++)
     {
       const guchar *data   = tile_data + i;
       gint          state  = 0;
       gint          length = 0;
       gint          count  = 0;
-      gint          size   = tile_rect->width * tile_rect->height;
+      gint          size   = n_pixels;
       guint         last   = -1;
 
       while (size > 0)
@@ -1622,15 +2072,247 @@ xcf_save_tile_rle (XcfInfo        *info,
             }
         }
 
-      if (count != (tile_rect->width * tile_rect->height))
-        g_message ("xcf: uh oh! xcf rle tile saving error: %d", count);
+      if (count != n_pixels)
+        *valid = FALSE;
     }
 
-  xcf_write_int8_check_error (info, rlebuf, len);
+  return len;
+}
+
+/*  Writes file offsets, which are 64 bit values since version 5 of the
+ *  file format and 32 bit values before.
+ */
+static guint
+xcf_write_offset (XcfInfo        *info,
+                  const goffset  *data,
+                  gint            count,
+                  GError        **error)
+{
+  GError *tmp_error = NULL;
+  guint   total     = 0;
+  gint    i;
+
+  for (i = 0; i < count; i++)
+    {
+      if (info->bytes_per_offset == 8)
+        {
+          guint64 tmp = data[i];
+
+          total += xcf_write_int64 (info->fp, &tmp, 1, &tmp_error);
+        }
+      else if (data[i] <= G_MAXUINT32)
+        {
+          guint32 tmp = data[i];
+
+          total += xcf_write_int32 (info->fp, &tmp, 1, &tmp_error);
+        }
+      else
+        {
+          g_set_error_literal (&tmp_error, G_FILE_ERROR, G_FILE_ERROR_FBIG,
+                               _("XCF file is too large for this "
+                                 "file format version"));
+        }
+
+      if (tmp_error)
+        {
+          g_propagate_error (error, tmp_error);
+          break;
+        }
+    }
+
+  return total;
+}
+
+/*  Seek back to the offset table, write the offset of the tile that
+ *  was just written, and seek to the end again for the next tile.
+ */
+static gboolean
+xcf_save_tile_offset (XcfInfo  *info,
+                      goffset   offset,
+                      goffset  *saved_pos,
+                      GError  **error)
+{
+  GError *tmp_error = NULL;
+
+  xcf_check_error (xcf_seek_pos (info, *saved_pos, error));
+  xcf_write_offset_check_error (info, &offset, 1);
+
+  *saved_pos = info->cp;
+
+  xcf_check_error (xcf_seek_end (info, error));
 
   return TRUE;
 }
 
+#ifdef ENABLE_MP
+
+/*  The parallel save pipeline: the calling thread fetches a batch of
+ *  tiles from the buffer, the batch is encoded on the core worker
+ *  pool, and the calling thread writes the encoded tiles strictly in
+ *  tile order, so file layout and offset table match the serial path.
+ */
+
+#define XCF_SAVE_JOBS_PER_THREAD 4
+
+typedef struct _XcfSaveJob      XcfSaveJob;
+typedef struct _XcfSavePipeline XcfSavePipeline;
+
+struct _XcfSaveJob
+{
+  GeglRectangle       rect;
+  guchar             *tile_data;
+  guchar             *encbuf;
+  gint                len;
+  gboolean            valid;
+};
+
+struct _XcfSavePipeline
+{
+  XcfCompressionType  compression;
+  gint                bpp;
+  gint                encbuf_size;
+  XcfSaveJob         *jobs;
+};
+
+static void
+xcf_save_encode_job (gint             i,
+                     gint             n,
+                     XcfSavePipeline *pipeline)
+{
+  XcfSaveJob *job      = &pipeline->jobs[i];
+  gint        n_pixels = job->rect.width * job->rect.height;
+
+  switch (pipeline->compression)
+    {
+    case COMPRESS_RLE:
+      job->len = xcf_save_encode_rle (job->tile_data, pipeline->bpp,
+                                      n_pixels, job->encbuf, &job->valid);
+      break;
+
+#ifdef HAVE_ZLIB
+    case COMPRESS_ZLIB:
+      job->len   = xcf_save_encode_zlib (job->tile_data,
+                                         n_pixels * pipeline->bpp,
+                                         job->encbuf, pipeline->encbuf_size);
+      job->valid = (job->len >= 0);
+      break;
+#endif
+
+    default:
+      job->len   = 0;
+      job->valid = FALSE;
+      break;
+    }
+}
+
+static gboolean
+xcf_save_level_parallel (XcfInfo     *info,
+                         GeglBuffer  *buffer,
+                         guint        ntiles,
+                         gint         n_threads,
+                         goffset     *saved_pos,
+                         GError     **error)
+{
+  const Babl      *format    = gegl_buffer_get_format (buffer);
+  XcfSavePipeline  pipeline;
+  XcfSaveJob      *jobs;
+  gint             tile_size;
+  guint            n_jobs;
+  guint            next_tile = 0;
+  guint            i;
+  gboolean         success   = TRUE;
+  GError          *tmp_error = NULL;
+
+  pipeline.compression = info->compression;
+  pipeline.bpp         = babl_format_get_bytes_per_pixel (format);
+
+  tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * pipeline.bpp;
+
+  pipeline.encbuf_size = tile_size * 1.5;
+
+  n_jobs = MIN (ntiles, n_threads * XCF_SAVE_JOBS_PER_THREAD);
+  jobs   = g_new0 (XcfSaveJob, n_jobs);
+
+  for (i = 0; i < n_jobs; i++)
+    {
+      jobs[i].tile_data = g_malloc (tile_size);
+      jobs[i].encbuf    = g_malloc (pipeline.encbuf_size);
+    }
+
+  pipeline.jobs = jobs;
+
+  while (success && next_tile < ntiles)
+    {
+      guint n_batch = MIN (n_jobs, ntiles - next_tile);
+
+      for (i = 0; i < n_batch; i++)
+        {
+          XcfSaveJob *job = &jobs[i];
+
+          gimp_gegl_buffer_get_tile_rect (buffer,
+                                          XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                          next_tile + i, &job->rect);
+
+          gegl_buffer_get (buffer, &job->rect, 1.0, format, job->tile_data,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+        }
+
+      gimp_parallel_distribute (n_batch,
+                                (GimpParallelDistributeFunc) xcf_save_encode_job,
+                                &pipeline);
+
+      for (i = 0; i < n_batch; i++)
+        {
+          XcfSaveJob *job = &jobs[i];
+          goffset     offset;
+
+          if (! job->valid)
+            {
+              if (info->compression != COMPRESS_RLE)
+                {
+                  g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                       _("Error compressing XCF tile data"));
+                  success = FALSE;
+                  break;
+                }
+
+              g_message ("xcf: uh oh! xcf rle tile saving error");
+            }
+
+          offset = info->cp;
+
+          info->cp += xcf_write_int8 (info->fp, job->encbuf, job->len,
+                                      &tmp_error);
+          if (tmp_error)
+            {
+              g_propagate_error (error, tmp_error);
+              success = FALSE;
+              break;
+            }
+
+          if (! xcf_save_tile_offset (info, offset, saved_pos, error))
+            {
+              success = FALSE;
+              break;
+            }
+        }
+
+      next_tile += n_batch;
+    }
+
+  for (i = 0; i < n_jobs; i++)
+    {
+      g_free (jobs[i].tile_data);
+      g_free (jobs[i].encbuf);
+    }
+
+  g_free (jobs);
+
+  return success;
+}
+
+#endif /* ENABLE_MP */
+
 static gboolean
 xcf_save_parasite (XcfInfo       *info,
                    GimpParasite  *parasite,
@@ -1957,3 +2639,166 @@ xcf_save_vectors (XcfInfo    *info,
 
   return TRUE;
 }
+
+static XcfSaveState *
+xcf_save_state_new (XcfInfo *info)
+{
+  XcfSaveState *state = g_slice_new0 (XcfSaveState);
+
+  state->filename        = g_strdup (info->filename);
+  state->file_version    = info->file_version;
+  state->compression     = info->compression;
+  state->new_hierarchies = xcf_save_hierarchies_new ();
+
+  return state;
+}
+
+static void
+xcf_save_state_free (XcfSaveState *state)
+{
+  if (state->hierarchies)
+    g_hash_table_unref (state->hierarchies);
+
+  if (state->new_hierarchies)
+    g_hash_table_unref (state->new_hierarchies);
+
+  g_free (state->filename);
+
+  g_slice_free (XcfSaveState, state);
+}
+
+static GHashTable *
+xcf_save_hierarchies_new (void)
+{
+  return g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                NULL,
+                                (GDestroyNotify) xcf_saved_hierarchy_free);
+}
+
+static void
+xcf_saved_hierarchy_free (XcfSavedHierarchy *hierarchy)
+{
+  if (hierarchy->drawable)
+    g_object_remove_weak_pointer (G_OBJECT (hierarchy->drawable),
+                                  (gpointer *) &hierarchy->drawable);
+
+  g_slice_free (XcfSavedHierarchy, hierarchy);
+}
+
+static GList *
+xcf_save_get_channel_list (GimpImage *image)
+{
+  GList *channels = gimp_image_get_channel_list (image);
+  gint   x1, y1, x2, y2;
+
+  /* check and see if we have to save out the selection */
+  if (gimp_channel_bounds (gimp_image_get_mask (image), &x1, &y1, &x2, &y2))
+    channels = g_list_append (channels, gimp_image_get_mask (image));
+
+  return channels;
+}
+
+/*  returns the number of bytes the image properties take in the file,
+ *  or -1 if they could not be written
+ */
+static goffset
+xcf_save_measure_image_props (XcfInfo   *info,
+                              GimpImage *image)
+{
+  XcfInfo measure = *info;
+  goffset size    = -1;
+
+  measure.fp = tmpfile ();
+  measure.cp = 0;
+
+  if (measure.fp)
+    {
+      if (xcf_save_image_props (&measure, image, NULL))
+        size = measure.cp;
+
+      fclose (measure.fp);
+    }
+
+  return size;
+}
+
+static gboolean
+xcf_save_stat (const gchar *filename,
+               goffset     *size,
+               gint64      *mtime)
+{
+  GStatBuf st;
+
+  if (g_stat (filename, &st) != 0)
+    return FALSE;
+
+  *size  = st.st_size;
+  *mtime = st.st_mtime;
+
+  return TRUE;
+}
+
+/*  an incremental save can point the header of @drawable at the
+ *  hierarchy the last save wrote, if its pixels did not change since
+ */
+static gboolean
+xcf_save_reuse_hierarchy (XcfInfo      *info,
+                          GimpDrawable *drawable,
+                          goffset      *offset)
+{
+  XcfSaveState      *state = info->save_state;
+  XcfSavedHierarchy *hierarchy;
+
+  if (! state || ! state->append)
+    return FALSE;
+
+  hierarchy = g_hash_table_lookup (state->hierarchies, drawable);
+
+  /*  the drawable is NULL if the saved one was destroyed, and
+   *  @drawable was only allocated at the same address
+   */
+  if (! hierarchy                       ||
+      hierarchy->drawable != drawable   ||
+      hierarchy->dirty_stamp != gimp_drawable_get_dirty_stamp (drawable))
+    return FALSE;
+
+  g_hash_table_steal (state->hierarchies, drawable);
+  g_hash_table_insert (state->new_hierarchies, drawable, hierarchy);
+
+  *offset = hierarchy->offset;
+
+  return TRUE;
+}
+
+static gboolean
+xcf_save_add_hierarchy (XcfInfo       *info,
+                        GimpDrawable  *drawable,
+                        goffset        offset,
+                        GError       **error)
+{
+  XcfSaveState      *state = info->save_state;
+  XcfSavedHierarchy *hierarchy;
+
+  if (! state)
+    return TRUE;
+
+  /*  the hierarchy was the last thing written, it ends where the
+   *  file does
+   */
+  if (! xcf_seek_end (info, error))
+    return FALSE;
+
+  hierarchy = g_slice_new (XcfSavedHierarchy);
+
+  hierarchy->drawable    = drawable;
+  hierarchy->dirty_stamp = gimp_drawable_get_dirty_stamp (drawable);
+  hierarchy->offset      = offset;
+  hierarchy->size        = info->cp - offset;
+
+  g_object_add_weak_pointer (G_OBJECT (drawable),
+                             (gpointer *) &hierarchy->drawable);
+
+  g_hash_table_insert (state->new_hierarchies, drawable, hierarchy);
+
+  return TRUE;
+}
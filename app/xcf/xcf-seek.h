@@ -20,7 +20,7 @@
 
 
 gboolean   xcf_seek_pos (XcfInfo *info,
-                         guint    pos,
+                         goffset  pos,
                          GError **error);
 gboolean   xcf_seek_end (XcfInfo *info,
                          GError **error);
@@ -28,6 +28,8 @@
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpimage.h"
 #include "core/gimpparamspecs.h"
@@ -42,6 +44,8 @@
 #include "xcf-read.h"
 #include "xcf-save.h"
 
+#include "gimp-log.h"
+
 #include "gimp-intl.h"
 
 
@@ -70,7 +74,8 @@ static GimpXcfLoaderFunc * const xcf_loaders[] =
   xcf_load_image,   /* version 1 */
   xcf_load_image,   /* version 2 */
   xcf_load_image,   /* version 3 */
-  xcf_load_image    /* version 4 */
+  xcf_load_image,   /* version 4 */
+  xcf_load_image    /* version 5 */
 };
 
 
@@ -243,6 +248,7 @@ xcf_load_invoker (GimpProcedure         *procedure,
   const gchar    *filename;
   gboolean        success = FALSE;
   gchar           id[14];
+  gint64          trace_start = GIMP_TRACE_START ();
 
   gimp_set_busy (gimp);
 
@@ -265,6 +271,9 @@ xcf_load_invoker (GimpProcedure         *procedure,
       info.swap_num              = 0;
       info.ref_count             = NULL;
       info.compression           = COMPRESS_NONE;
+      info.lazy_source           = NULL;
+      info.mapped_file           = xcf_read_map (info.fp);
+      info.save_state            = NULL;
 
       if (progress)
         {
@@ -303,6 +312,8 @@ xcf_load_invoker (GimpProcedure         *procedure,
           if (info.file_version >= 0 &&
               info.file_version < G_N_ELEMENTS (xcf_loaders))
             {
+              info.bytes_per_offset = (info.file_version >= 5) ? 8 : 4;
+
               image = (*(xcf_loaders[info.file_version])) (gimp, &info, error);
 
               if (! image)
@@ -319,6 +330,11 @@ xcf_load_invoker (GimpProcedure         *procedure,
 
       fclose (info.fp);
 
+      xcf_load_lazy_finish (&info);
+
+      if (info.mapped_file)
+        g_mapped_file_unref (info.mapped_file);
+
       if (progress)
         gimp_progress_end (progress);
     }
@@ -339,6 +355,8 @@ xcf_load_invoker (GimpProcedure         *procedure,
 
   gimp_unset_busy (gimp);
 
+  GIMP_TRACE_END (trace_start, "xcf", "load", filename);
+
   return return_vals;
 }
 
@@ -354,30 +372,46 @@ xcf_save_invoker (GimpProcedure         *procedure,
   GimpValueArray *return_vals;
   GimpImage      *image;
   const gchar    *filename;
+  gboolean        append  = FALSE;
   gboolean        success = FALSE;
+  gint64          trace_start = GIMP_TRACE_START ();
 
   gimp_set_busy (gimp);
 
   image    = gimp_value_get_image (gimp_value_array_index (args, 1), gimp);
   filename = g_value_get_string (gimp_value_array_index (args, 3));
 
-  info.fp = g_fopen (filename, "wb");
+  info.gimp                  = gimp;
+  info.progress              = progress;
+  info.cp                    = 0;
+  info.filename              = filename;
+  info.active_layer          = NULL;
+  info.active_channel        = NULL;
+  info.floating_sel_drawable = NULL;
+  info.floating_sel          = NULL;
+  info.floating_sel_offset   = 0;
+  info.swap_num              = 0;
+  info.ref_count             = NULL;
+  info.compression           = COMPRESS_RLE;
+  info.lazy_source           = NULL;
+  info.mapped_file           = NULL;
+  info.save_state            = NULL;
+
+  xcf_save_choose_format (&info, image);
+
+  if (GIMP_CORE_CONFIG (gimp->config)->xcf_incremental_save)
+    append = xcf_save_begin_incremental (&info, image);
+
+  /*  don't pull the file from under lazily loaded layers, appending
+   *  leaves the pixels they read from alone
+   */
+  if (! append)
+    xcf_load_lazy_flush (filename);
+
+  info.fp = g_fopen (filename, append ? "r+b" : "wb");
 
   if (info.fp)
     {
-      info.gimp                  = gimp;
-      info.progress              = progress;
-      info.cp                    = 0;
-      info.filename              = filename;
-      info.active_layer          = NULL;
-      info.active_channel        = NULL;
-      info.floating_sel_drawable = NULL;
-      info.floating_sel          = NULL;
-      info.floating_sel_offset   = 0;
-      info.swap_num              = 0;
-      info.ref_count             = NULL;
-      info.compression           = COMPRESS_RLE;
-
       if (progress)
         {
           gchar *name = g_filename_display_name (filename);
@@ -389,8 +423,6 @@ xcf_save_invoker (GimpProcedure         *procedure,
           g_free (name);
         }
 
-      xcf_save_choose_format (&info, image);
-
       success = xcf_save_image (&info, image, error);
 
       if (success)
@@ -424,10 +456,16 @@ xcf_save_invoker (GimpProcedure         *procedure,
                    gimp_filename_to_utf8 (filename), g_strerror (save_errno));
     }
 
+  if (info.save_state)
+    xcf_save_end_incremental (&info, image, success);
+
   return_vals = gimp_procedure_get_return_values (procedure, success,
                                                   error ? *error : NULL);
 
   gimp_unset_busy (gimp);
 
+  GIMP_TRACE_END (trace_start, "xcf", append ? "save-incremental" : "save",
+                  filename);
+
   return return_vals;
 }
@@ -114,8 +114,6 @@
  **/
 
 
-#define TILE_MAP_SIZE (_tile_width * _tile_height * 4)
-
 #define ERRMSG_SHM_FAILED "Could not attach to gimp shared memory segment"
 
 /* Maybe this should go in a public header if we add other things to it */
@@ -131,7 +129,7 @@ typedef enum
   GIMP_DEBUG_DEFAULT        = (GIMP_DEBUG_RUN | GIMP_DEBUG_FATAL_WARNINGS)
 } GimpDebugFlag;
 
-#define WRITE_BUFFER_SIZE  1024
+#define WRITE_BUFFER_SIZE  4096
 
 void gimp_read_expect_msg   (GimpWireMessage *msg,
                              gint             type);
@@ -171,6 +169,7 @@ static void       gimp_set_pdb_error           (const GimpParam *return_vals,
 
 static GIOChannel *_readchannel  = NULL;
 GIOChannel *_writechannel = NULL;
+gsize       _shm_size     = 0;
 
 #ifdef USE_WIN32_SHM
 static HANDLE shm_handle;
@@ -192,6 +191,7 @@ static gchar         *_wm_class          = NULL;
 static gchar         *_display_name      = NULL;
 static gint           _monitor_number    = 0;
 static guint32        _timestamp         = 0;
+static gboolean       _resident          = FALSE;
 static const gchar   *progname           = NULL;
 
 static gchar          write_buffer[WRITE_BUFFER_SIZE];
@@ -201,6 +201,8 @@ static GimpStackTraceMode stack_trace_mode = GIMP_STACK_TRACE_NEVER;
 
 static GHashTable    *temp_proc_ht       = NULL;
 
+static gboolean       resident_enabled   = FALSE;
+
 static guint          gimp_debug_flags   = 0;
 
 static const GDebugKey gimp_debug_keys[] =
@@ -1500,6 +1502,29 @@ gimp_extension_process (guint timeout)
 #endif
 }
 
+/**
+ * gimp_resident_enable:
+ *
+ * Tells GIMP that the plug-in can run its procedures more than once
+ * in the same process.
+ *
+ * If GIMP allows it, the plug-in process then stays alive after the
+ * current procedure returned and serves the next call to one of its
+ * procedures, instead of being started again. GIMP ends idle plug-in
+ * processes after a while, or when they use too much memory.
+ *
+ * Only call this from a plug-in whose run procedure doesn't depend
+ * on being run in a fresh process, i.e. that doesn't rely on the
+ * initial values of static variables and that cleans up after itself.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_resident_enable (void)
+{
+  resident_enabled = TRUE;
+}
+
 /**
  * gimp_parasite_find:
  * @name: The name of the parasite to find.
@@ -1618,7 +1643,7 @@ gimp_close (void)
 #elif defined(USE_POSIX_SHM)
 
   if ((_shm_ID != -1) && (_shm_addr != MAP_FAILED))
-    munmap (_shm_addr, TILE_MAP_SIZE);
+    munmap (_shm_addr, _shm_size);
 
 #endif
 
@@ -1715,27 +1740,23 @@ gimp_write (GIOChannel   *channel,
             gulong        count,
             gpointer      user_data)
 {
-  gulong bytes;
-
-  while (count > 0)
+  if ((write_buffer_index + count) >= WRITE_BUFFER_SIZE)
     {
-      if ((write_buffer_index + count) >= WRITE_BUFFER_SIZE)
-        {
-          bytes = WRITE_BUFFER_SIZE - write_buffer_index;
-          memcpy (&write_buffer[write_buffer_index], buf, bytes);
-          write_buffer_index += bytes;
-          if (! gimp_wire_flush (channel, NULL))
-            return FALSE;
-        }
-      else
-        {
-          bytes = count;
-          memcpy (&write_buffer[write_buffer_index], buf, bytes);
-          write_buffer_index += bytes;
-        }
+      /*  send what we have buffered together with the new data,
+       *  instead of pushing the new data through the buffer
+       */
+      if (! gimp_wire_writev (channel,
+                              (const guint8 *) write_buffer,
+                              write_buffer_index,
+                              buf, count))
+        return FALSE;
 
-      buf += bytes;
-      count -= bytes;
+      write_buffer_index = 0;
+    }
+  else
+    {
+      memcpy (&write_buffer[write_buffer_index], buf, count);
+      write_buffer_index += count;
     }
 
   return TRUE;
@@ -1745,45 +1766,13 @@ static gboolean
 gimp_flush (GIOChannel *channel,
             gpointer    user_data)
 {
-  GIOStatus  status;
-  GError    *error = NULL;
-  gsize      count;
-  gsize      bytes;
-
   if (write_buffer_index > 0)
     {
-      count = 0;
-      while (count != write_buffer_index)
-        {
-          do
-            {
-              bytes = 0;
-              status = g_io_channel_write_chars (channel,
-                                                 &write_buffer[count],
-                                                 (write_buffer_index - count),
-                                                 &bytes,
-                                                 &error);
-            }
-          while (status == G_IO_STATUS_AGAIN);
-
-          if (status != G_IO_STATUS_NORMAL)
-            {
-              if (error)
-                {
-                  g_warning ("%s: gimp_flush(): error: %s",
-                             g_get_prgname (), error->message);
-                  g_error_free (error);
-                }
-              else
-                {
-                  g_warning ("%s: gimp_flush(): error", g_get_prgname ());
-                }
-
-              return FALSE;
-            }
-
-          count += bytes;
-        }
+      if (! gimp_wire_writev (channel,
+                              (const guint8 *) write_buffer,
+                              write_buffer_index,
+                              NULL, 0))
+        return FALSE;
 
       write_buffer_index = 0;
     }
@@ -1823,6 +1812,11 @@ gimp_loop (void)
 
         case GP_PROC_RUN:
           gimp_proc_run (msg.data);
+
+          /*  a resident plug-in waits for the next GP_PROC_RUN  */
+          if (_resident && resident_enabled)
+            break;
+
           gimp_wire_destroy (&msg);
           gimp_close ();
           return;
@@ -1877,6 +1871,7 @@ gimp_config (GPConfig *config)
   _tile_width       = config->tile_width;
   _tile_height      = config->tile_height;
   _shm_ID           = config->shm_ID;
+  _shm_size         = config->shm_size;
   _check_size       = config->check_size;
   _check_type       = config->check_type;
   _install_cmap     = config->install_cmap     ? TRUE : FALSE;
@@ -1884,6 +1879,11 @@ gimp_config (GPConfig *config)
   _show_help_button = config->show_help_button ? TRUE : FALSE;
   _min_colors       = config->min_colors;
   _gdisp_ID         = config->gdisp_ID;
+  _resident         = config->resident         ? TRUE : FALSE;
+
+  g_free (_wm_class);
+  g_free (_display_name);
+
   _wm_class         = g_strdup (config->wm_class);
   _display_name     = g_strdup (config->display_name);
   _monitor_number   = config->monitor_number;
@@ -1894,7 +1894,8 @@ gimp_config (GPConfig *config)
 
   gimp_cpu_accel_set_use (config->use_cpu_accel);
 
-  if (_shm_ID != -1)
+  /*  a resident plug-in gets the same segment with every GP_CONFIG  */
+  if (_shm_ID != -1 && ! _shm_addr)
     {
 #if defined(USE_SYSV_SHM)
 
@@ -1925,7 +1926,7 @@ gimp_config (GPConfig *config)
           /* Map the shared memory into our address space for use */
           _shm_addr = (guchar *) MapViewOfFile (shm_handle,
                                                 FILE_MAP_ALL_ACCESS,
-                                                0, 0, TILE_MAP_SIZE);
+                                                0, 0, _shm_size);
 
           /* Verify that we mapped our view */
           if (!_shm_addr)
@@ -1956,7 +1957,7 @@ gimp_config (GPConfig *config)
       if (shm_fd != -1)
         {
           /* Map the shared memory into our address space for use */
-          _shm_addr = (guchar *) mmap (NULL, TILE_MAP_SIZE,
+          _shm_addr = (guchar *) mmap (NULL, _shm_size,
                                        PROT_READ | PROT_WRITE, MAP_SHARED,
                                        shm_fd, 0);
 
@@ -1997,6 +1998,10 @@ gimp_proc_run (GPProcRun *proc_run)
       proc_return.nparams = n_return_vals;
       proc_return.params  = (GPParam *) return_vals;
 
+      if (_resident && resident_enabled &&
+          ! gp_resident_write (_writechannel, NULL))
+        gimp_quit ();
+
       if (! gp_proc_return_write (_writechannel, &proc_return, NULL))
         gimp_quit ();
     }
@@ -2042,8 +2047,13 @@ gimp_process_message (GimpWireMessage *msg)
     case GP_TILE_REQ:
     case GP_TILE_ACK:
     case GP_TILE_DATA:
+    case GP_REGION_REQ:
+    case GP_REGION_DATA:
       g_warning ("unexpected tile message received (should not happen)");
       break;
+    case GP_RESIDENT:
+      g_warning ("unexpected resident message received (should not happen)");
+      break;
     case GP_PROC_RUN:
       g_warning ("unexpected proc run message received (should not happen)");
       break;
@@ -48,6 +48,7 @@
 #include <libgimp/gimppalette.h>
 #include <libgimp/gimppalettes.h>
 #include <libgimp/gimppaletteselect.h>
+#include <libgimp/gimpparallel.h>
 #include <libgimp/gimppatterns.h>
 #include <libgimp/gimppatternselect.h>
 #include <libgimp/gimppixbuf.h>
@@ -280,6 +281,10 @@ void           gimp_extension_enable    (void);
  */
 void           gimp_extension_process   (guint            timeout);
 
+/* Allow the plug-in process to serve more than one procedure call
+ */
+void           gimp_resident_enable     (void);
+
 /* Run a procedure in the procedure database. The parameters are
  *  specified via the variable length argument list. The return
  *  values are returned in the 'GimpParam*' array.
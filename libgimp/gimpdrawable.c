@@ -117,31 +117,18 @@ gimp_drawable_detach (GimpDrawable *drawable)
 void
 gimp_drawable_flush (GimpDrawable *drawable)
 {
-  GimpTile *tiles;
-  gint      n_tiles;
-  gint      i;
+  gint n_tiles;
 
   g_return_if_fail (drawable != NULL);
 
-  if (drawable->tiles)
-    {
-      tiles   = drawable->tiles;
-      n_tiles = drawable->ntile_rows * drawable->ntile_cols;
+  n_tiles = drawable->ntile_rows * drawable->ntile_cols;
 
-      for (i = 0; i < n_tiles; i++)
-        if ((tiles[i].ref_count > 0) && tiles[i].dirty)
-          gimp_tile_flush (&tiles[i]);
-    }
+  /*  runs of dirty tiles are transferred in batches  */
+  if (drawable->tiles)
+    _gimp_tile_flush_run (drawable->tiles, n_tiles);
 
   if (drawable->shadow_tiles)
-    {
-      tiles   = drawable->shadow_tiles;
-      n_tiles = drawable->ntile_rows * drawable->ntile_cols;
-
-      for (i = 0; i < n_tiles; i++)
-        if ((tiles[i].ref_count > 0) && tiles[i].dirty)
-          gimp_tile_flush (&tiles[i]);
-    }
+    _gimp_tile_flush_run (drawable->shadow_tiles, n_tiles);
 
   /*  nuke all references to this drawable from the cache  */
   _gimp_tile_cache_flush_drawable (drawable);
@@ -229,6 +216,33 @@ gimp_drawable_get_tile2 (GimpDrawable *drawable,
   return gimp_drawable_get_tile (drawable, shadow, row, col);
 }
 
+/**
+ * gimp_drawable_set_sequential:
+ * @drawable:   a #GimpDrawable
+ * @sequential: whether the tiles of @drawable are accessed in order
+ *
+ * Tells libgimp that the plug-in is going to reference the tiles of
+ * @drawable in row-major order. When a tile of such a drawable has to
+ * be fetched from the core, the tiles following it in the same row
+ * are fetched along with it and kept in the tile cache, so the
+ * plug-in doesn't block on each of them. The plug-in must have a
+ * tile cache set up with gimp_tile_cache_ntiles() for this to have
+ * any effect.
+ *
+ * Pixel regions iterated with gimp_pixel_rgns_process() always read
+ * ahead like this.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_drawable_set_sequential (GimpDrawable *drawable,
+                              gboolean      sequential)
+{
+  g_return_if_fail (drawable != NULL);
+
+  drawable->sequential = sequential ? TRUE : FALSE;
+}
+
 void
 gimp_drawable_get_color_uchar (gint32         drawable_ID,
                                const GimpRGB *color,
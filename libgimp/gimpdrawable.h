@@ -39,6 +39,7 @@ struct _GimpDrawable
   guint     ntile_cols;    /* # of tile columns */
   GimpTile *tiles;         /* the normal tiles */
   GimpTile *shadow_tiles;  /* the shadow tiles */
+  gboolean  sequential;    /* tiles are accessed in row-major order */
 };
 
 
@@ -63,6 +64,9 @@ GimpTile     * gimp_drawable_get_tile2              (GimpDrawable  *drawable,
                                                      gboolean       shadow,
                                                      gint           x,
                                                      gint           y);
+GIMP_DEPRECATED
+void           gimp_drawable_set_sequential         (GimpDrawable  *drawable,
+                                                     gboolean       sequential);
 
 GIMP_DEPRECATED
 void           gimp_drawable_get_color_uchar        (gint32         drawable_ID,
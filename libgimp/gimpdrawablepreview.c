@@ -627,3 +627,54 @@ gimp_drawable_preview_draw_region (GimpDrawablePreview *preview,
         }
     }
 }
+
+/**
+ * gimp_drawable_preview_render_async:
+ * @preview:   a #GimpDrawablePreview widget
+ * @func:      the function rendering the preview
+ * @user_data: data to pass to @func
+ * @destroy:   function to free @user_data, or %NULL
+ *
+ * Reads the part of the drawable the @preview is showing and renders
+ * it with @func on a worker thread, see gimp_preview_render_async().
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_drawable_preview_render_async (GimpDrawablePreview   *preview,
+                                    GimpPreviewRenderFunc  func,
+                                    gpointer               user_data,
+                                    GDestroyNotify         destroy)
+{
+  GimpPreview  *gimp_preview;
+  GimpDrawable *drawable;
+  guchar       *buffer;
+  GimpPixelRgn  srcPR;
+
+  g_return_if_fail (GIMP_IS_DRAWABLE_PREVIEW (preview));
+  g_return_if_fail (preview->drawable != NULL);
+  g_return_if_fail (func != NULL);
+
+  gimp_preview = GIMP_PREVIEW (preview);
+  drawable     = preview->drawable;
+
+  buffer = g_new (guchar,
+                  gimp_preview->width * gimp_preview->height * drawable->bpp);
+
+  gimp_pixel_rgn_init (&srcPR, drawable,
+                       gimp_preview->xoff + gimp_preview->xmin,
+                       gimp_preview->yoff + gimp_preview->ymin,
+                       gimp_preview->width, gimp_preview->height,
+                       FALSE, FALSE);
+
+  gimp_pixel_rgn_get_rect (&srcPR, buffer,
+                           gimp_preview->xoff + gimp_preview->xmin,
+                           gimp_preview->yoff + gimp_preview->ymin,
+                           gimp_preview->width, gimp_preview->height);
+
+  gimp_preview_render_async (gimp_preview, buffer,
+                             gimp_preview->width, gimp_preview->height,
+                             drawable->bpp,
+                             func, user_data, destroy);
+  g_free (buffer);
+}
@@ -69,6 +69,11 @@ GimpDrawable * gimp_drawable_preview_get_drawable (GimpDrawablePreview *preview)
 void           gimp_drawable_preview_draw_region  (GimpDrawablePreview *preview,
                                                    const GimpPixelRgn  *region);
 
+void           gimp_drawable_preview_render_async (GimpDrawablePreview   *preview,
+                                                   GimpPreviewRenderFunc  func,
+                                                   gpointer               user_data,
+                                                   GDestroyNotify         destroy);
+
 /*  for internal use only  */
 G_GNUC_INTERNAL void      _gimp_drawable_preview_area_draw_thumb (GimpPreviewArea *area,
                                                                   GimpDrawable    *drawable,
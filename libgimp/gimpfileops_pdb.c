@@ -216,6 +216,176 @@ gimp_file_save (GimpRunMode  run_mode,
   return success;
 }
 
+/**
+ * gimp_file_save_batch:
+ * @run_mode: The run mode.
+ * @num_images: The number of images.
+ * @image_ids: The images to save.
+ * @num_filenames: The number of file names.
+ * @filenames: The names of the files to save the images in.
+ * @max_jobs: The most images to save at the same time, or 0.
+ * @merge_visible: Export the visible layers merged.
+ * @num_statuses: The number of statuses.
+ *
+ * Saves several images at the same time.
+ *
+ * This procedure saves each of the images to the file with the same
+ * index, using the save or export handler that file-save would use. Up
+ * to 'max_jobs' handlers run at the same time, 0 means one for each
+ * processor. Exported images are converted and flattened as the
+ * handler requires first, with 'merge_visible' they are saved as a
+ * single layer of their visible layers. The status of each save is
+ * returned in 'statuses', the procedure itself only fails on invalid
+ * arguments.
+ *
+ * Returns: The GimpPDBStatusType of each save.
+ *
+ * Since: GIMP 2.10
+ **/
+gint *
+gimp_file_save_batch (GimpRunMode   run_mode,
+                      gint          num_images,
+                      const gint32 *image_ids,
+                      gint          num_filenames,
+                      const gchar **filenames,
+                      gint          max_jobs,
+                      gboolean      merge_visible,
+                      gint         *num_statuses)
+{
+  GimpParam *return_vals;
+  gint nreturn_vals;
+  gint *statuses = NULL;
+
+  return_vals = gimp_run_procedure ("gimp-file-save-batch",
+                                    &nreturn_vals,
+                                    GIMP_PDB_INT32, run_mode,
+                                    GIMP_PDB_INT32, num_images,
+                                    GIMP_PDB_INT32ARRAY, image_ids,
+                                    GIMP_PDB_INT32, num_filenames,
+                                    GIMP_PDB_STRINGARRAY, filenames,
+                                    GIMP_PDB_INT32, max_jobs,
+                                    GIMP_PDB_INT32, merge_visible,
+                                    GIMP_PDB_END);
+
+  *num_statuses = 0;
+
+  if (return_vals[0].data.d_status == GIMP_PDB_SUCCESS)
+    {
+      *num_statuses = return_vals[1].data.d_int32;
+      statuses = g_new (gint32, *num_statuses);
+      memcpy (statuses,
+              return_vals[2].data.d_int32array,
+              *num_statuses * sizeof (gint32));
+    }
+
+  gimp_destroy_params (return_vals, nreturn_vals);
+
+  return statuses;
+}
+
+/**
+ * gimp_file_batch_run:
+ * @pattern: The glob pattern of the files to process.
+ * @procedure_name: The procedure to run on each image, or an empty string.
+ * @dest_dir: The directory to save into, or an empty string.
+ * @extension: The extension of the file type to save as.
+ * @max_jobs: The most files to work on at the same time, or 0.
+ * @merge_visible: Export the visible layers merged.
+ * @num_files: The number of files.
+ * @filenames: The files processed.
+ * @num_statuses: The number of statuses.
+ * @statuses: The GimpPDBStatusType of each file.
+ * @num_times: The number of times.
+ * @times: The seconds each file took from being opened to being saved.
+ * @num_errors: The number of error messages.
+ * @errors: The error message of each file, empty if there was none.
+ *
+ * Opens, processes and saves all files matching a pattern.
+ *
+ * This procedure opens each file matching 'pattern', which may contain
+ * wildcards in its last path component, runs 'procedure_name' on it
+ * and saves it with the same name and 'extension' to 'dest_dir', or
+ * next to the original if 'dest_dir' is empty. 'procedure_name' must
+ * take the run mode, image and drawable as its first arguments like
+ * filter plug-ins do, it runs non-interactively with the defaults for
+ * its other arguments. An empty 'procedure_name' only converts the
+ * files. Up to 'max_jobs' files are worked on at the same time, 0
+ * means one for each processor. The status, time in seconds and error
+ * message of each file are returned.
+ *
+ * Returns: TRUE on success.
+ *
+ * Since: GIMP 2.10
+ **/
+gboolean
+gimp_file_batch_run (const gchar   *pattern,
+                     const gchar   *procedure_name,
+                     const gchar   *dest_dir,
+                     const gchar   *extension,
+                     gint           max_jobs,
+                     gboolean       merge_visible,
+                     gint          *num_files,
+                     gchar       ***filenames,
+                     gint          *num_statuses,
+                     gint         **statuses,
+                     gint          *num_times,
+                     gdouble      **times,
+                     gint          *num_errors,
+                     gchar       ***errors)
+{
+  GimpParam *return_vals;
+  gint nreturn_vals;
+  gboolean success = TRUE;
+  gint i;
+
+  return_vals = gimp_run_procedure ("gimp-file-batch-run",
+                                    &nreturn_vals,
+                                    GIMP_PDB_STRING, pattern,
+                                    GIMP_PDB_STRING, procedure_name,
+                                    GIMP_PDB_STRING, dest_dir,
+                                    GIMP_PDB_STRING, extension,
+                                    GIMP_PDB_INT32, max_jobs,
+                                    GIMP_PDB_INT32, merge_visible,
+                                    GIMP_PDB_END);
+
+  *num_files = 0;
+  *filenames = NULL;
+  *num_statuses = 0;
+  *statuses = NULL;
+  *num_times = 0;
+  *times = NULL;
+  *num_errors = 0;
+  *errors = NULL;
+
+  success = return_vals[0].data.d_status == GIMP_PDB_SUCCESS;
+
+  if (success)
+    {
+      *num_files = return_vals[1].data.d_int32;
+      *filenames = g_new (gchar *, *num_files);
+      for (i = 0; i < *num_files; i++)
+        (*filenames)[i] = g_strdup (return_vals[2].data.d_stringarray[i]);
+      *num_statuses = return_vals[3].data.d_int32;
+      *statuses = g_new (gint32, *num_statuses);
+      memcpy (*statuses,
+              return_vals[4].data.d_int32array,
+              *num_statuses * sizeof (gint32));
+      *num_times = return_vals[5].data.d_int32;
+      *times = g_new (gdouble, *num_times);
+      memcpy (*times,
+              return_vals[6].data.d_floatarray,
+              *num_times * sizeof (gdouble));
+      *num_errors = return_vals[7].data.d_int32;
+      *errors = g_new (gchar *, *num_errors);
+      for (i = 0; i < *num_errors; i++)
+        (*errors)[i] = g_strdup (return_vals[8].data.d_stringarray[i]);
+    }
+
+  gimp_destroy_params (return_vals, nreturn_vals);
+
+  return success;
+}
+
 /**
  * gimp_file_save_thumbnail:
  * @image_ID: The image.
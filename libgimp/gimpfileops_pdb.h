@@ -47,6 +47,28 @@ gboolean gimp_file_save                   (GimpRunMode  run_mode,
                                            gint32       drawable_ID,
                                            const gchar *filename,
                                            const gchar *raw_filename);
+gint*    gimp_file_save_batch             (GimpRunMode   run_mode,
+                                           gint          num_images,
+                                           const gint32 *image_ids,
+                                           gint          num_filenames,
+                                           const gchar **filenames,
+                                           gint          max_jobs,
+                                           gboolean      merge_visible,
+                                           gint         *num_statuses);
+gboolean gimp_file_batch_run              (const gchar   *pattern,
+                                           const gchar   *procedure_name,
+                                           const gchar   *dest_dir,
+                                           const gchar   *extension,
+                                           gint           max_jobs,
+                                           gboolean       merge_visible,
+                                           gint          *num_files,
+                                           gchar       ***filenames,
+                                           gint          *num_statuses,
+                                           gint         **statuses,
+                                           gint          *num_times,
+                                           gdouble      **times,
+                                           gint          *num_errors,
+                                           gchar       ***errors);
 gboolean gimp_file_save_thumbnail         (gint32       image_ID,
                                            const gchar *filename);
 gchar*   gimp_temp_name                   (const gchar *extension);
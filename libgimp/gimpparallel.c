@@ -0,0 +1,179 @@
+/* LIBGIMP - The GIMP Library
+ * Copyright (C) 1995-2003 Peter Mattis and Spencer Kimball
+ *
+ * gimpparallel.c
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "gimp.h"
+
+
+typedef struct
+{
+  GimpParallelFunc  func;
+  gpointer          user_data;
+  gint              n_jobs;
+  gint              next_job;
+  gint              jobs_done;
+} GimpParallelJobs;
+
+typedef struct
+{
+  GimpParallelJobs *jobs;
+  gint              thread;
+} GimpParallelThread;
+
+
+static gboolean  gimp_parallel_run_next_job (GimpParallelJobs *jobs,
+                                             gint              thread);
+static gpointer  gimp_parallel_thread_func  (gpointer          data);
+
+
+/**
+ * gimp_parallel_get_n_threads:
+ *
+ * Returns the number of threads gimp_parallel_run() uses.  This
+ * follows the "num-processors" preference of the core, and is at most
+ * %GIMP_PARALLEL_MAX_THREADS.
+ *
+ * Plug-ins that keep scratch memory for each thread can allocate it
+ * for this many threads.  Call this function from the main thread.
+ *
+ * Return value: the number of threads, at least 1.
+ *
+ * Since: GIMP 2.10
+ **/
+gint
+gimp_parallel_get_n_threads (void)
+{
+  static gint n_threads = 0;
+
+  if (! n_threads)
+    {
+      gchar *value = gimp_gimprc_query ("num-processors");
+      gint   n     = 0;
+
+      if (value)
+        {
+          n = atoi (value);
+          g_free (value);
+        }
+
+      if (n < 1)
+        n = gimp_get_number_of_processors ();
+
+      n_threads = CLAMP (n, 1, GIMP_PARALLEL_MAX_THREADS);
+    }
+
+  return n_threads;
+}
+
+/**
+ * gimp_parallel_run:
+ * @n_jobs:        the number of jobs
+ * @func:          the function doing a job
+ * @user_data:     data passed to @func
+ * @show_progress: whether to update the progress as the jobs get done
+ *
+ * Calls @func for each of the @n_jobs jobs, spread over
+ * gimp_parallel_get_n_threads() threads.  The jobs are handed out in
+ * order, to the next thread that is done with its last one, and the
+ * calling thread takes its share.  The function returns when all the
+ * jobs are done.
+ *
+ * @func runs on other threads than the main one, so it must not call
+ * into libgimp.  Only the calling thread updates the progress, with
+ * the share of the jobs that are done, if @show_progress is %TRUE.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_parallel_run (gint              n_jobs,
+                   GimpParallelFunc  func,
+                   gpointer          user_data,
+                   gboolean          show_progress)
+{
+  GimpParallelJobs   jobs;
+  GimpParallelThread threads[GIMP_PARALLEL_MAX_THREADS];
+  GThread           *thread_ids[GIMP_PARALLEL_MAX_THREADS];
+  gint               n_threads;
+  gint               i;
+
+  g_return_if_fail (func != NULL);
+
+  if (n_jobs < 1)
+    return;
+
+  n_threads = MIN (gimp_parallel_get_n_threads (), n_jobs);
+
+  jobs.func      = func;
+  jobs.user_data = user_data;
+  jobs.n_jobs    = n_jobs;
+  jobs.next_job  = 0;
+  jobs.jobs_done = 0;
+
+  for (i = 1; i < n_threads; i++)
+    {
+      threads[i].jobs   = &jobs;
+      threads[i].thread = i;
+
+      thread_ids[i] = g_thread_new ("gimp-parallel",
+                                    gimp_parallel_thread_func, &threads[i]);
+    }
+
+  while (gimp_parallel_run_next_job (&jobs, 0))
+    {
+      if (show_progress)
+        gimp_progress_update ((gdouble) g_atomic_int_get (&jobs.jobs_done) /
+                              (gdouble) n_jobs);
+    }
+
+  for (i = 1; i < n_threads; i++)
+    g_thread_join (thread_ids[i]);
+}
+
+
+/*  private functions  */
+
+static gboolean
+gimp_parallel_run_next_job (GimpParallelJobs *jobs,
+                            gint              thread)
+{
+  gint job = g_atomic_int_add (&jobs->next_job, 1);
+
+  if (job >= jobs->n_jobs)
+    return FALSE;
+
+  jobs->func (job, jobs->n_jobs, thread, jobs->user_data);
+
+  g_atomic_int_inc (&jobs->jobs_done);
+
+  return TRUE;
+}
+
+static gpointer
+gimp_parallel_thread_func (gpointer data)
+{
+  GimpParallelThread *thread = data;
+
+  while (gimp_parallel_run_next_job (thread->jobs, thread->thread));
+
+  return NULL;
+}
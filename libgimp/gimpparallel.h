@@ -0,0 +1,73 @@
+/* LIBGIMP - The GIMP Library
+ * Copyright (C) 1995-2003 Peter Mattis and Spencer Kimball
+ *
+ * gimpparallel.h
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined (__GIMP_H_INSIDE__) && !defined (GIMP_COMPILATION)
+#error "Only <libgimp/gimp.h> can be included directly."
+#endif
+
+#ifndef __GIMP_PARALLEL_H__
+#define __GIMP_PARALLEL_H__
+
+G_BEGIN_DECLS
+
+/* For information look into the C source or the html documentation */
+
+
+/**
+ * GIMP_PARALLEL_MAX_THREADS:
+ *
+ * The maximum number of threads gimp_parallel_run() uses, and so the
+ * maximum value returned by gimp_parallel_get_n_threads().
+ *
+ * Since: GIMP 2.10
+ **/
+#define GIMP_PARALLEL_MAX_THREADS 16
+
+
+/**
+ * GimpParallelFunc:
+ * @job:       the index of the job to do
+ * @n_jobs:    the number of jobs passed to gimp_parallel_run()
+ * @thread:    the index of the thread doing the job, between 0 and
+ *             gimp_parallel_get_n_threads() - 1.  Thread 0 is the one
+ *             that called gimp_parallel_run().
+ * @user_data: the data passed to gimp_parallel_run()
+ *
+ * The function called by gimp_parallel_run() for each of the jobs.
+ *
+ * Since: GIMP 2.10
+ **/
+typedef void (* GimpParallelFunc) (gint     job,
+                                   gint     n_jobs,
+                                   gint     thread,
+                                   gpointer user_data);
+
+
+gint   gimp_parallel_get_n_threads (void);
+
+void   gimp_parallel_run           (gint              n_jobs,
+                                    GimpParallelFunc  func,
+                                    gpointer          user_data,
+                                    gboolean          show_progress);
+
+
+G_END_DECLS
+
+#endif /* __GIMP_PARALLEL_H__ */
@@ -20,6 +20,10 @@
 
 #include "config.h"
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 #define GIMP_DISABLE_DEPRECATION_WARNINGS
 
 #include "gimp.h"
@@ -35,9 +39,28 @@
  * special treatment for neighbourhoods which are completely inside a
  * tile is called for. It hides the special treatment of tile borders,
  * making plug-in code more readable and shorter.
+ *
+ * Plug-ins that look up many pixels at scattered positions, like the
+ * geometric distortions, should use gimp_pixel_fetcher_get_pixels() or
+ * gimp_pixel_fetcher_sample_pixels() on a whole row at a time. These
+ * sort the lookups by tile and fetch all the tiles that are missing
+ * from a tile row in one go.
  **/
 
 
+/*  the number of samples interpolated from one batch of pixels  */
+#define SAMPLE_CHUNK_SIZE 256
+
+
+typedef struct
+{
+  gint tile_num;
+  gint index;
+  gint x;
+  gint y;
+} GimpPixelFetcherRef;
+
+
 struct _GimpPixelFetcher
 {
   gint                      col, row;
@@ -52,6 +75,11 @@ struct _GimpPixelFetcher
   GimpTile                 *tile;
   gboolean                  tile_dirty;
   gboolean                  shadow;
+
+  GimpPixelFetcherRef      *refs;
+  gint                      n_refs;
+  gint                     *sample_coords;
+  guchar                   *sample_pixels;
 };
 
 
@@ -60,6 +88,17 @@ struct _GimpPixelFetcher
 static guchar * gimp_pixel_fetcher_provide_tile (GimpPixelFetcher *pf,
                                                  gint              x,
                                                  gint              y);
+static gboolean gimp_pixel_fetcher_map_edge     (GimpPixelFetcher *pf,
+                                                 gint             *x,
+                                                 gint             *y,
+                                                 guchar           *pixel);
+static gint     gimp_pixel_fetcher_ref_compare  (const void       *a,
+                                                 const void       *b);
+static void     gimp_pixel_fetcher_bicubic      (GimpPixelFetcher *pf,
+                                                 guchar           *dest,
+                                                 gdouble           x,
+                                                 gdouble           y,
+                                                 guchar           *values);
 
 
 /*  public functions  */
@@ -131,6 +170,10 @@ gimp_pixel_fetcher_destroy (GimpPixelFetcher *pf)
   if (pf->tile)
     gimp_tile_unref (pf->tile, pf->tile_dirty);
 
+  g_free (pf->refs);
+  g_free (pf->sample_coords);
+  g_free (pf->sample_pixels);
+
   g_slice_free (GimpPixelFetcher, pf);
 }
 
@@ -200,65 +243,245 @@ gimp_pixel_fetcher_get_pixel (GimpPixelFetcher *pf,
   g_return_if_fail (pf != NULL);
   g_return_if_fail (pixel != NULL);
 
-  if (pf->mode == GIMP_PIXEL_FETCHER_EDGE_NONE &&
-      (x < pf->sel_x1 || x >= pf->sel_x2 ||
-       y < pf->sel_y1 || y >= pf->sel_y2))
+  if (! gimp_pixel_fetcher_map_edge (pf, &x, &y, pixel))
+    return;
+
+  p = gimp_pixel_fetcher_provide_tile (pf, x, y);
+
+  i = pf->img_bpp;
+
+  do
     {
-      return;
+      *pixel++ = *p++;
     }
+  while (--i);
+}
+
+/**
+ * gimp_pixel_fetcher_get_pixels:
+ * @pf:       a pointer to a previously initialized #GimpPixelFetcher.
+ * @n_pixels: the number of pixels to get.
+ * @coords:   @n_pixels pairs of x and y coordinates.
+ * @pixels:   the memory location where to return the pixels, @n_pixels
+ *            times the drawable's bytes per pixel.
+ *
+ * Gets many pixels from the pixel region at once, with the same edge
+ * handling as gimp_pixel_fetcher_get_pixel(). The lookups are sorted
+ * by tile, and the tiles which are not in the plug-in's tile cache
+ * are fetched from the core a tile row at a time instead of one by
+ * one, so this is a lot faster for scattered coordinates.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_pixel_fetcher_get_pixels (GimpPixelFetcher *pf,
+                               gint              n_pixels,
+                               const gint       *coords,
+                               guchar           *pixels)
+{
+  gint n_refs = 0;
+  gint i;
+
+  g_return_if_fail (pf != NULL);
+  g_return_if_fail (n_pixels >= 0);
+  g_return_if_fail (n_pixels == 0 || (coords != NULL && pixels != NULL));
 
-  if (x < 0 || x >= pf->img_width ||
-      y < 0 || y >= pf->img_height)
+  if (n_pixels > pf->n_refs)
     {
-      switch (pf->mode)
+      pf->n_refs = n_pixels;
+      pf->refs   = g_renew (GimpPixelFetcherRef, pf->refs, pf->n_refs);
+    }
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      gint x = coords[i * 2];
+      gint y = coords[i * 2 + 1];
+
+      if (gimp_pixel_fetcher_map_edge (pf, &x, &y,
+                                       pixels + i * pf->img_bpp))
         {
-        case GIMP_PIXEL_FETCHER_EDGE_WRAP:
-          if (x < 0 || x >= pf->img_width)
-            {
-              x %= pf->img_width;
+          GimpPixelFetcherRef *ref = &pf->refs[n_refs++];
 
-              if (x < 0)
-                x += pf->img_width;
-            }
+          ref->tile_num = ((y / pf->tile_height) * pf->drawable->ntile_cols +
+                           (x / pf->tile_width));
+          ref->index    = i;
+          ref->x        = x % pf->tile_width;
+          ref->y        = y % pf->tile_height;
+        }
+    }
 
-          if (y < 0 || y >= pf->img_height)
-            {
-              y %= pf->img_height;
+  qsort (pf->refs, n_refs, sizeof (GimpPixelFetcherRef),
+         gimp_pixel_fetcher_ref_compare);
 
-              if (y < 0)
-                y += pf->img_height;
-            }
-          break;
+  i = 0;
 
-        case GIMP_PIXEL_FETCHER_EDGE_SMEAR:
-          x = CLAMP (x, 0, pf->img_width - 1);
-          y = CLAMP (y, 0, pf->img_height - 1);
-          break;
+  while (i < n_refs)
+    {
+      GimpTile *tiles;
+      gint      first = pf->refs[i].tile_num;
+      gint      last  = first;
+      gint      j;
 
-        case GIMP_PIXEL_FETCHER_EDGE_BLACK:
-          for (i = 0; i < pf->img_bpp; i++)
-            pixel[i] = 0;
-          return;
+      /*  find the run of tiles of this tile row that is needed  */
+      for (j = i + 1; j < n_refs; j++)
+        {
+          gint tile_num = pf->refs[j].tile_num;
 
-        case GIMP_PIXEL_FETCHER_EDGE_BACKGROUND:
-          for (i = 0; i < pf->img_bpp; i++)
-            pixel[i] = pf->bg_color[i];
-          return;
+          if (tile_num == last)
+            continue;
 
-        default:
-          return;
+          if (tile_num != last + 1 ||
+              tile_num % pf->drawable->ntile_cols == 0)
+            break;
+
+          last = tile_num;
+        }
+
+      tiles = gimp_drawable_get_tile (pf->drawable, pf->shadow,
+                                      first / pf->drawable->ntile_cols,
+                                      first % pf->drawable->ntile_cols);
+
+      _gimp_tile_ref_run (tiles, last - first + 1);
+
+      for (; i < j; i++)
+        {
+          const GimpPixelFetcherRef *ref  = &pf->refs[i];
+          const GimpTile            *tile = &tiles[ref->tile_num - first];
+          const guchar              *p;
+          guchar                    *pixel;
+          gint                       k;
+
+          p = tile->data + pf->img_bpp * (tile->ewidth * ref->y + ref->x);
+          pixel = pixels + ref->index * pf->img_bpp;
+
+          for (k = 0; k < pf->img_bpp; k++)
+            pixel[k] = p[k];
         }
+
+      _gimp_tile_unref_run (tiles, last - first + 1, FALSE);
     }
+}
 
-  p = gimp_pixel_fetcher_provide_tile (pf, x, y);
+/**
+ * gimp_pixel_fetcher_sample_pixels:
+ * @pf:            a pointer to a previously initialized #GimpPixelFetcher.
+ * @interpolation: how to interpolate between pixels.
+ * @n_samples:     the number of samples.
+ * @coords:        @n_samples pairs of x and y coordinates.
+ * @pixels:        the memory location where to return the samples,
+ *                 @n_samples times the drawable's bytes per pixel.
+ *
+ * Samples the pixel region at the subpixel positions in @coords. The
+ * pixel at column x and row y is at position (x, y).
+ *
+ * %GIMP_INTERPOLATION_NONE returns the pixel at the position rounded
+ * down, %GIMP_INTERPOLATION_LINEAR interpolates between the 2x2 pixels
+ * around it like gimp_bilinear_pixels_8() does, and the other types
+ * use a Catmull-Rom spline through the 4x4 pixels around it. Alpha is
+ * taken into account. Pixels outside the drawable are looked up with
+ * the edge mode of @pf and the neighbourhoods of the samples are read
+ * like with gimp_pixel_fetcher_get_pixels().
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_pixel_fetcher_sample_pixels (GimpPixelFetcher      *pf,
+                                  GimpInterpolationType  interpolation,
+                                  gint                   n_samples,
+                                  const gdouble         *coords,
+                                  guchar                *pixels)
+{
+  gint size;
+  gint offset;
+  gint start;
 
-  i = pf->img_bpp;
+  g_return_if_fail (pf != NULL);
+  g_return_if_fail (n_samples >= 0);
+  g_return_if_fail (n_samples == 0 || (coords != NULL && pixels != NULL));
 
-  do
+  switch (interpolation)
     {
-      *pixel++ = *p++;
+    case GIMP_INTERPOLATION_NONE:
+      size   = 1;
+      offset = 0;
+      break;
+
+    case GIMP_INTERPOLATION_LINEAR:
+      size   = 2;
+      offset = 0;
+      break;
+
+    default:
+      size   = 4;
+      offset = 1;
+      break;
+    }
+
+  if (! pf->sample_coords)
+    {
+      pf->sample_coords = g_new (gint, SAMPLE_CHUNK_SIZE * 16 * 2);
+      pf->sample_pixels = g_new (guchar, SAMPLE_CHUNK_SIZE * 16 * 4);
+    }
+
+  for (start = 0; start < n_samples; start += SAMPLE_CHUNK_SIZE)
+    {
+      gint  n = MIN (n_samples - start, SAMPLE_CHUNK_SIZE);
+      gint *c = pf->sample_coords;
+      gint  i;
+
+      for (i = 0; i < n; i++)
+        {
+          gint x0 = (gint) floor (coords[(start + i) * 2])     - offset;
+          gint y0 = (gint) floor (coords[(start + i) * 2 + 1]) - offset;
+          gint u, v;
+
+          for (v = 0; v < size; v++)
+            for (u = 0; u < size; u++)
+              {
+                *c++ = x0 + u;
+                *c++ = y0 + v;
+              }
+        }
+
+      /*  pixels outside the selection stay untouched with EDGE_NONE  */
+      memset (pf->sample_pixels, 0, n * size * size * pf->img_bpp);
+
+      gimp_pixel_fetcher_get_pixels (pf, n * size * size,
+                                     pf->sample_coords, pf->sample_pixels);
+
+      for (i = 0; i < n; i++)
+        {
+          const gdouble *xy     = coords + (start + i) * 2;
+          guchar        *dest   = pixels + (start + i) * pf->img_bpp;
+          guchar        *values = (pf->sample_pixels +
+                                   i * size * size * pf->img_bpp);
+          gint           k;
+
+          switch (size)
+            {
+            case 1:
+              for (k = 0; k < pf->img_bpp; k++)
+                dest[k] = values[k];
+              break;
+
+            case 2:
+              {
+                guchar *corners[4];
+
+                for (k = 0; k < 4; k++)
+                  corners[k] = values + k * pf->img_bpp;
+
+                gimp_bilinear_pixels_8 (dest, xy[0], xy[1], pf->img_bpp,
+                                        ! (pf->img_bpp & 1), corners);
+              }
+              break;
+
+            default:
+              gimp_pixel_fetcher_bicubic (pf, dest, xy[0], xy[1], values);
+              break;
+            }
+        }
     }
-  while (--i);
 }
 
 /**
@@ -304,6 +527,103 @@ gimp_pixel_fetcher_put_pixel (GimpPixelFetcher *pf,
 
 /*  private functions  */
 
+/*  Applies the edge mode to a position outside the drawable. Returns
+ *  FALSE if pixel has been filled in, or is to be left alone, and TRUE
+ *  if the pixel at the (possibly changed) position is to be read.
+ */
+static gboolean
+gimp_pixel_fetcher_map_edge (GimpPixelFetcher *pf,
+                             gint             *x,
+                             gint             *y,
+                             guchar           *pixel)
+{
+  gint i;
+
+  if (pf->mode == GIMP_PIXEL_FETCHER_EDGE_NONE &&
+      (*x < pf->sel_x1 || *x >= pf->sel_x2 ||
+       *y < pf->sel_y1 || *y >= pf->sel_y2))
+    {
+      return FALSE;
+    }
+
+  if (*x < 0 || *x >= pf->img_width ||
+      *y < 0 || *y >= pf->img_height)
+    {
+      switch (pf->mode)
+        {
+        case GIMP_PIXEL_FETCHER_EDGE_WRAP:
+          if (*x < 0 || *x >= pf->img_width)
+            {
+              *x %= pf->img_width;
+
+              if (*x < 0)
+                *x += pf->img_width;
+            }
+
+          if (*y < 0 || *y >= pf->img_height)
+            {
+              *y %= pf->img_height;
+
+              if (*y < 0)
+                *y += pf->img_height;
+            }
+          break;
+
+        case GIMP_PIXEL_FETCHER_EDGE_SMEAR:
+          *x = CLAMP (*x, 0, pf->img_width - 1);
+          *y = CLAMP (*y, 0, pf->img_height - 1);
+          break;
+
+        case GIMP_PIXEL_FETCHER_EDGE_BLACK:
+          for (i = 0; i < pf->img_bpp; i++)
+            pixel[i] = 0;
+          return FALSE;
+
+        case GIMP_PIXEL_FETCHER_EDGE_BACKGROUND:
+          for (i = 0; i < pf->img_bpp; i++)
+            pixel[i] = pf->bg_color[i];
+          return FALSE;
+
+        default:
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+static gint
+gimp_pixel_fetcher_ref_compare (const void *a,
+                                const void *b)
+{
+  const GimpPixelFetcherRef *ref_a = a;
+  const GimpPixelFetcherRef *ref_b = b;
+
+  if (ref_a->tile_num != ref_b->tile_num)
+    return ref_a->tile_num - ref_b->tile_num;
+
+  return ref_a->index - ref_b->index;
+}
+
+/*  Catmull-Rom interpolation of the 4x4 pixels in values around the
+ *  position.
+ */
+static void
+gimp_pixel_fetcher_bicubic (GimpPixelFetcher *pf,
+                            guchar           *dest,
+                            gdouble           x,
+                            gdouble           y,
+                            guchar           *values)
+{
+  gdouble pos[2];
+
+  pos[0] = 1.0 + (x - floor (x));
+  pos[1] = 1.0 + (y - floor (y));
+
+  gimp_bicubic_sample_8 (values, 4, 4, 4 * pf->img_bpp,
+                         pf->img_bpp, ! (pf->img_bpp & 1), 1, pos, dest);
+}
+
 static guchar *
 gimp_pixel_fetcher_provide_tile (GimpPixelFetcher *pf,
                                  gint              x,
@@ -66,6 +66,17 @@ void   gimp_pixel_fetcher_get_pixel     (GimpPixelFetcher         *pf,
                                          gint                      y,
                                          guchar                   *pixel);
 GIMP_DEPRECATED
+void   gimp_pixel_fetcher_get_pixels    (GimpPixelFetcher         *pf,
+                                         gint                      n_pixels,
+                                         const gint               *coords,
+                                         guchar                   *pixels);
+GIMP_DEPRECATED
+void   gimp_pixel_fetcher_sample_pixels (GimpPixelFetcher         *pf,
+                                         GimpInterpolationType     interpolation,
+                                         gint                      n_samples,
+                                         const gdouble            *coords,
+                                         guchar                   *pixels);
+GIMP_DEPRECATED
 void   gimp_pixel_fetcher_put_pixel     (GimpPixelFetcher         *pf,
                                          gint                      x,
                                          gint                      y,
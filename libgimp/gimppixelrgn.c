@@ -367,6 +367,16 @@ gimp_pixel_rgn_get_rect (GimpPixelRgn *pr,
   g_return_if_fail (width >= 0);
   g_return_if_fail (height >= 0);
 
+  /*  rectangles spanning several tiles are transferred in one go  */
+  if (width > 0 && height > 0 &&
+      (x / TILE_WIDTH  != (x + width  - 1) / TILE_WIDTH ||
+       y / TILE_HEIGHT != (y + height - 1) / TILE_HEIGHT))
+    {
+      _gimp_region_get (pr->drawable, pr->shadow, x, y, width, height,
+                        buf, width * pr->bpp);
+      return;
+    }
+
   bpp = pr->bpp;
   bufstride = bpp * width;
 
@@ -601,6 +611,16 @@ gimp_pixel_rgn_set_rect (GimpPixelRgn *pr,
   g_return_if_fail (width >= 0);
   g_return_if_fail (height >= 0);
 
+  /*  rectangles spanning several tiles are transferred in one go  */
+  if (width > 0 && height > 0 &&
+      (x / TILE_WIDTH  != (x + width  - 1) / TILE_WIDTH ||
+       y / TILE_HEIGHT != (y + height - 1) / TILE_HEIGHT))
+    {
+      _gimp_region_put (pr->drawable, pr->shadow, x, y, width, height,
+                        buf, width * pr->bpp);
+      return;
+    }
+
   bpp = pr->bpp;
   bufstride = bpp * width;
 
@@ -944,7 +964,9 @@ gimp_pixel_rgn_configure (GimpPixelRgnHolder   *prh,
                                       prh->pr->shadow,
                                       prh->pr->x,
                                       prh->pr->y);
-      gimp_tile_ref (tile);
+
+      /*  regions are iterated in row-major order, read ahead  */
+      _gimp_tile_ref_prefetch (tile);
 
       offx = prh->pr->x % TILE_WIDTH;
       offy = prh->pr->y % TILE_HEIGHT;
@@ -55,6 +55,8 @@ static void   gimp_temp_progress_run  (const gchar      *name,
 static GHashTable    * gimp_progress_ht      = NULL;
 static gdouble         gimp_progress_current = 0.0;
 static const gdouble   gimp_progress_step    = (1.0 / 256.0);
+static gint64          gimp_progress_time    = 0;
+static const gint64    gimp_progress_delay   = 20000; /* microseconds */
 
 
 /*  public functions  */
@@ -362,6 +364,19 @@ gimp_progress_update (gdouble percentage)
   if (! changed)
     return TRUE;
 
+  /*  Coalesce intermediate updates that come in faster than the
+   *  progress could be redrawn, each one is a round trip to the core.
+   */
+  if (percentage > 0.0 && percentage < 1.0)
+    {
+      gint64 now = g_get_monotonic_time ();
+
+      if (now - gimp_progress_time < gimp_progress_delay)
+        return TRUE;
+
+      gimp_progress_time = now;
+    }
+
   gimp_progress_current = percentage;
 
   return _gimp_progress_update (gimp_progress_current);
@@ -48,12 +48,27 @@
  */
 #define FREE_QUANTUM 0.1
 
+/*  Regions that don't go through shared memory are split into
+ *  messages of at most this many bytes.
+ */
+#define REGION_PIPE_SIZE (4 * 1024 * 1024)
+
+/*  This is the maximum number of tiles that are fetched ahead of
+ *  a tile of a sequentially accessed drawable.
+ */
+#define PREFETCH_N_TILES 8
+
 
 void         gimp_read_expect_msg   (GimpWireMessage *msg,
                                      gint             type);
 
-static void  gimp_tile_get          (GimpTile        *tile);
-static void  gimp_tile_put          (GimpTile        *tile);
+static void  gimp_tile_get          (GimpTile        *tiles,
+                                     gint             n_tiles);
+static void  gimp_tile_put          (GimpTile        *tiles,
+                                     gint             n_tiles);
+static gint  gimp_tile_prefetch_n_tiles
+                                    (GimpTile        *tile);
+static void  gimp_tile_cache_init   (void);
 static void  gimp_tile_cache_insert (GimpTile        *tile);
 static void  gimp_tile_cache_flush  (GimpTile        *tile);
 
@@ -75,11 +90,17 @@ gimp_tile_ref (GimpTile *tile)
 {
   g_return_if_fail (tile != NULL);
 
+  if (tile->drawable && tile->drawable->sequential)
+    {
+      _gimp_tile_ref_prefetch (tile);
+      return;
+    }
+
   tile->ref_count++;
 
   if (tile->ref_count == 1)
     {
-      gimp_tile_get (tile);
+      gimp_tile_get (tile, 1);
       tile->dirty = FALSE;
     }
 
@@ -124,7 +145,7 @@ gimp_tile_flush (GimpTile *tile)
 
   if (tile->data && tile->dirty)
     {
-      gimp_tile_put (tile);
+      gimp_tile_put (tile, 1);
       tile->dirty = FALSE;
     }
 }
@@ -165,6 +186,493 @@ gimp_tile_cache_ntiles (gulong ntiles)
                          gimp_tile_height () * 4 + 1023) / 1024);
 }
 
+/*  Like gimp_tile_ref(), but when tile has to be fetched, the tiles
+ *  following it in its row are fetched in the same exchange and left
+ *  in the cache, which holds the only reference to them.
+ */
+void
+_gimp_tile_ref_prefetch (GimpTile *tile)
+{
+  gint n_tiles;
+  gint i;
+
+  g_return_if_fail (tile != NULL);
+
+  tile->ref_count++;
+
+  if (tile->ref_count > 1)
+    {
+      gimp_tile_cache_insert (tile);
+      return;
+    }
+
+  n_tiles = 1 + gimp_tile_prefetch_n_tiles (tile);
+
+  for (i = 0; i < n_tiles; i++)
+    tile[i].dirty = FALSE;
+
+  gimp_tile_get (tile, n_tiles);
+
+  gimp_tile_cache_insert (tile);
+
+  for (i = 1; i < n_tiles; i++)
+    {
+      gimp_tile_cache_insert (&tile[i]);
+
+      /*  the cache had no room after all  */
+      if (tile[i].ref_count == 0)
+        {
+          g_free (tile[i].data);
+          tile[i].data = NULL;
+        }
+    }
+}
+
+/*  The _run() variants work on n_tiles consecutive tiles of a
+ *  drawable's tile array, and transfer the tiles that have to go
+ *  over the wire in as few messages as the shared memory allows.
+ */
+
+void
+_gimp_tile_ref_run (GimpTile *tiles,
+                    gint      n_tiles)
+{
+  gint start = -1;
+  gint i;
+
+  g_return_if_fail (tiles != NULL);
+
+  for (i = 0; i <= n_tiles; i++)
+    {
+      if (i < n_tiles)
+        {
+          tiles[i].ref_count++;
+
+          if (tiles[i].ref_count == 1)
+            {
+              tiles[i].dirty = FALSE;
+
+              if (start < 0)
+                start = i;
+
+              continue;
+            }
+        }
+
+      if (start >= 0)
+        {
+          gimp_tile_get (tiles + start, i - start);
+          start = -1;
+        }
+    }
+
+  for (i = 0; i < n_tiles; i++)
+    gimp_tile_cache_insert (&tiles[i]);
+}
+
+void
+_gimp_tile_unref_run (GimpTile *tiles,
+                      gint      n_tiles,
+                      gboolean  dirty)
+{
+  gint start = -1;
+  gint i;
+
+  g_return_if_fail (tiles != NULL);
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      g_return_if_fail (tiles[i].ref_count > 0);
+
+      tiles[i].ref_count--;
+      tiles[i].dirty |= dirty;
+    }
+
+  for (i = 0; i <= n_tiles; i++)
+    {
+      if (i < n_tiles && tiles[i].ref_count == 0)
+        {
+          if (start < 0)
+            start = i;
+
+          continue;
+        }
+
+      if (start >= 0)
+        {
+          gint j;
+
+          _gimp_tile_flush_run (tiles + start, i - start);
+
+          for (j = start; j < i; j++)
+            {
+              g_free (tiles[j].data);
+              tiles[j].data = NULL;
+            }
+
+          start = -1;
+        }
+    }
+}
+
+void
+_gimp_tile_flush_run (GimpTile *tiles,
+                      gint      n_tiles)
+{
+  gint start = -1;
+  gint i;
+
+  g_return_if_fail (tiles != NULL);
+
+  for (i = 0; i <= n_tiles; i++)
+    {
+      if (i < n_tiles && tiles[i].data && tiles[i].dirty)
+        {
+          tiles[i].dirty = FALSE;
+
+          if (start < 0)
+            start = i;
+
+          continue;
+        }
+
+      if (start >= 0)
+        {
+          gimp_tile_put (tiles + start, i - start);
+          start = -1;
+        }
+    }
+}
+
+/*  Calls func on each row of tiles of drawable that overlaps the
+ *  rectangle and has been allocated already.
+ */
+static void
+gimp_tile_foreach_row (GimpDrawable *drawable,
+                       gboolean      shadow,
+                       gint          x,
+                       gint          y,
+                       gint          width,
+                       gint          height,
+                       void        (*func) (GimpTile *tiles,
+                                            gint      n_tiles,
+                                            gint      x,
+                                            gint      y,
+                                            gint      width,
+                                            gint      height,
+                                            gpointer  data),
+                       gpointer      data)
+{
+  GimpTile *tiles = shadow ? drawable->shadow_tiles : drawable->tiles;
+  gint      col0;
+  gint      col1;
+  gint      row;
+
+  if (! tiles)
+    return;
+
+  col0 = x / gimp_tile_width ();
+  col1 = (x + width - 1) / gimp_tile_width ();
+
+  for (row = y / gimp_tile_height ();
+       row <= (y + height - 1) / gimp_tile_height ();
+       row++)
+    {
+      func (tiles + row * drawable->ntile_cols + col0, col1 - col0 + 1,
+            x, y, width, height, data);
+    }
+}
+
+static void
+gimp_tile_flush_row (GimpTile *tiles,
+                     gint      n_tiles,
+                     gint      x,
+                     gint      y,
+                     gint      width,
+                     gint      height,
+                     gpointer  data)
+{
+  _gimp_tile_flush_run (tiles, n_tiles);
+}
+
+typedef struct
+{
+  const guchar *src;
+  gint          rowstride;
+} GimpRegionSource;
+
+/*  Copies the part of the region src that overlaps each tile into
+ *  tiles which are referenced, so they stay in sync with the core.
+ */
+static void
+gimp_tile_update_row (GimpTile *tiles,
+                      gint      n_tiles,
+                      gint      x,
+                      gint      y,
+                      gint      width,
+                      gint      height,
+                      gpointer  data)
+{
+  GimpRegionSource *source = data;
+  gint              i;
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      GimpTile *tile = &tiles[i];
+      gint      tile_x;
+      gint      tile_y;
+      gint      x1, y1, x2, y2;
+      gint      row;
+
+      if (! tile->data)
+        continue;
+
+      tile_x = (tile->tile_num % tile->drawable->ntile_cols) * gimp_tile_width ();
+      tile_y = (tile->tile_num / tile->drawable->ntile_cols) * gimp_tile_height ();
+
+      x1 = MAX (x, tile_x);
+      y1 = MAX (y, tile_y);
+      x2 = MIN (x + width,  tile_x + tile->ewidth);
+      y2 = MIN (y + height, tile_y + tile->eheight);
+
+      for (row = y1; row < y2; row++)
+        memcpy (tile->data + tile->bpp * ((row - tile_y) * tile->ewidth +
+                                          (x1 - tile_x)),
+                source->src + (row - y) * source->rowstride +
+                tile->bpp * (x1 - x),
+                tile->bpp * (x2 - x1));
+    }
+}
+
+/*  Returns how many rows of a region fit into one message.  */
+static gint
+gimp_region_chunk_rows (gint width,
+                        gint bpp)
+{
+  extern gsize _shm_size;
+
+  gsize row_size = (gsize) width * bpp;
+  gsize rows     = 0;
+
+  if (gimp_shm_ID () != -1)
+    rows = _shm_size / row_size;
+
+  if (rows == 0)
+    rows = REGION_PIPE_SIZE / row_size;
+
+  return CLAMP (rows, 1, G_MAXINT);
+}
+
+/*  Copies n_rows rows of row_size bytes between buffers of
+ *  different rowstrides.
+ */
+static void
+gimp_region_copy_rows (guchar       *dest,
+                       gint          dest_stride,
+                       const guchar *src,
+                       gint          src_stride,
+                       gsize         row_size,
+                       gint          n_rows)
+{
+  if (dest_stride == row_size && src_stride == row_size)
+    {
+      memcpy (dest, src, row_size * n_rows);
+      return;
+    }
+
+  while (n_rows--)
+    {
+      memcpy (dest, src, row_size);
+
+      dest += dest_stride;
+      src  += src_stride;
+    }
+}
+
+/*  _gimp_region_get() and _gimp_region_put() transfer a rectangle of
+ *  a drawable with as few messages as possible, bypassing the tile
+ *  cache. buf holds rows of width * bpp bytes, rowstride bytes apart.
+ */
+
+void
+_gimp_region_get (GimpDrawable *drawable,
+                  gboolean      shadow,
+                  gint          x,
+                  gint          y,
+                  gint          width,
+                  gint          height,
+                  guchar       *buf,
+                  gint          rowstride)
+{
+  extern GIOChannel *_writechannel;
+
+  gint bpp = drawable->bpp;
+  gint chunk_rows;
+  gint row;
+
+  g_return_if_fail (drawable != NULL);
+  g_return_if_fail (buf != NULL);
+  g_return_if_fail (rowstride >= width * bpp);
+
+  if (width < 1 || height < 1)
+    return;
+
+  /*  the core has to see what the plug-in changed  */
+  gimp_tile_foreach_row (drawable, shadow, x, y, width, height,
+                         gimp_tile_flush_row, NULL);
+
+  chunk_rows = gimp_region_chunk_rows (width, bpp);
+
+  for (row = 0; row < height; row += chunk_rows)
+    {
+      GPRegionReq      region_req;
+      GPRegionData    *region_data;
+      GimpWireMessage  msg;
+      gint             n_rows = MIN (chunk_rows, height - row);
+      guchar          *dest   = buf + (gsize) row * rowstride;
+
+      region_req.drawable_ID = drawable->drawable_id;
+      region_req.shadow      = shadow;
+      region_req.x           = x;
+      region_req.y           = y + row;
+      region_req.width       = width;
+      region_req.height      = n_rows;
+
+      if (! gp_region_req_write (_writechannel, &region_req, NULL))
+        gimp_quit ();
+
+      gimp_read_expect_msg (&msg, GP_REGION_DATA);
+
+      region_data = msg.data;
+      if (region_data->drawable_ID != region_req.drawable_ID ||
+          region_data->shadow      != region_req.shadow      ||
+          region_data->x           != region_req.x           ||
+          region_data->y           != region_req.y           ||
+          region_data->width       != region_req.width       ||
+          region_data->height      != region_req.height      ||
+          region_data->bpp         != bpp)
+        {
+          g_message ("received region info did not match requested region");
+          gimp_quit ();
+        }
+
+      gimp_region_copy_rows (dest, rowstride,
+                             region_data->use_shm ?
+                             gimp_shm_addr () : region_data->data,
+                             width * bpp,
+                             (gsize) width * bpp, n_rows);
+
+      if (! gp_tile_ack_write (_writechannel, NULL))
+        gimp_quit ();
+
+      gimp_wire_destroy (&msg);
+    }
+}
+
+void
+_gimp_region_put (GimpDrawable *drawable,
+                  gboolean      shadow,
+                  gint          x,
+                  gint          y,
+                  gint          width,
+                  gint          height,
+                  const guchar *buf,
+                  gint          rowstride)
+{
+  extern GIOChannel *_writechannel;
+  extern gsize       _shm_size;
+
+  GimpRegionSource  source;
+  guchar           *packed = NULL;
+  gint              bpp    = drawable->bpp;
+  gint              chunk_rows;
+  gint              row;
+
+  g_return_if_fail (drawable != NULL);
+  g_return_if_fail (buf != NULL);
+  g_return_if_fail (rowstride >= width * bpp);
+
+  if (width < 1 || height < 1)
+    return;
+
+  chunk_rows = gimp_region_chunk_rows (width, bpp);
+
+  for (row = 0; row < height; row += chunk_rows)
+    {
+      GPRegionReq      region_req;
+      GPRegionData     region_data;
+      GPRegionData    *region_info;
+      GimpWireMessage  msg;
+      gint             n_rows = MIN (chunk_rows, height - row);
+      gsize            size   = (gsize) width * n_rows * bpp;
+      const guchar    *src    = buf + (gsize) row * rowstride;
+
+      region_req.drawable_ID = -1;
+      region_req.shadow      = 0;
+      region_req.x           = 0;
+      region_req.y           = 0;
+      region_req.width       = 0;
+      region_req.height      = 0;
+
+      if (! gp_region_req_write (_writechannel, &region_req, NULL))
+        gimp_quit ();
+
+      gimp_read_expect_msg (&msg, GP_REGION_DATA);
+
+      region_info = msg.data;
+
+      region_data.drawable_ID = drawable->drawable_id;
+      region_data.shadow      = shadow;
+      region_data.x           = x;
+      region_data.y           = y + row;
+      region_data.width       = width;
+      region_data.height      = n_rows;
+      region_data.bpp         = bpp;
+      region_data.use_shm     = (region_info->use_shm && size <= _shm_size);
+      region_data.data        = NULL;
+
+      if (region_data.use_shm)
+        {
+          gimp_region_copy_rows (gimp_shm_addr (), width * bpp,
+                                 src, rowstride,
+                                 (gsize) width * bpp, n_rows);
+        }
+      else if (rowstride != width * bpp)
+        {
+          /*  the pipe needs the rows back to back  */
+          if (! packed)
+            packed = g_malloc ((gsize) width * chunk_rows * bpp);
+
+          gimp_region_copy_rows (packed, width * bpp,
+                                 src, rowstride,
+                                 (gsize) width * bpp, n_rows);
+
+          region_data.data = packed;
+        }
+      else
+        {
+          region_data.data = (guchar *) src;
+        }
+
+      if (! gp_region_data_write (_writechannel, &region_data, NULL))
+        gimp_quit ();
+
+      gimp_wire_destroy (&msg);
+
+      gimp_read_expect_msg (&msg, GP_TILE_ACK);
+      gimp_wire_destroy (&msg);
+    }
+
+  g_free (packed);
+
+  source.src       = buf;
+  source.rowstride = rowstride;
+
+  /*  tiles the plug-in holds must not overwrite the new pixels  */
+  gimp_tile_foreach_row (drawable, shadow, x, y, width, height,
+                         gimp_tile_update_row, &source);
+}
+
 void
 _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
 {
@@ -187,112 +695,205 @@ _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
 
 /*  private functions  */
 
-static void
-gimp_tile_get (GimpTile *tile)
+/*  Returns how many of the tiles right of tile in its row are not
+ *  referenced yet, limited by what the cache can hold next to tile.
+ */
+static gint
+gimp_tile_prefetch_n_tiles (GimpTile *tile)
 {
-  extern GIOChannel *_writechannel;
+  GimpDrawable *drawable = tile->drawable;
+  gint          col;
+  gint          n_tiles;
+  gint          i;
 
-  GPTileReq        tile_req;
-  GPTileData      *tile_data;
-  GimpWireMessage  msg;
+  if (! drawable)
+    return 0;
 
-  tile_req.drawable_ID = tile->drawable->drawable_id;
-  tile_req.tile_num    = tile->tile_num;
-  tile_req.shadow      = tile->shadow;
+  gimp_tile_cache_init ();
 
-  if (! gp_tile_req_write (_writechannel, &tile_req, NULL))
-    gimp_quit ();
+  n_tiles = MIN (PREFETCH_N_TILES, (gint) (max_cache_size / max_tile_size) - 1);
 
-  gimp_read_expect_msg (&msg, GP_TILE_DATA);
+  col     = tile->tile_num % drawable->ntile_cols;
+  n_tiles = MIN (n_tiles, (gint) drawable->ntile_cols - col - 1);
 
-  tile_data = msg.data;
-  if (tile_data->drawable_ID != tile->drawable->drawable_id ||
-      tile_data->tile_num    != tile->tile_num              ||
-      tile_data->shadow      != tile->shadow                ||
-      tile_data->width       != tile->ewidth                ||
-      tile_data->height      != tile->eheight               ||
-      tile_data->bpp         != tile->bpp)
+  for (i = 1; i <= n_tiles; i++)
     {
-      g_message ("received tile info did not match computed tile info");
-      gimp_quit ();
+      if (tile[i].ref_count > 0)
+        break;
     }
 
-  if (tile_data->use_shm)
-    {
-      tile->data = g_memdup (gimp_shm_addr (),
-                             tile->ewidth * tile->eheight * tile->bpp);
-    }
-  else
-    {
-      tile->data = tile_data->data;
-      tile_data->data = NULL;
-    }
+  return i - 1;
+}
 
-  if (! gp_tile_ack_write (_writechannel, NULL))
-    gimp_quit ();
+/*  Returns how many tiles like tile fit into the shared memory
+ *  segment, at least one since tiles can always go over the pipe.
+ */
+static gint
+gimp_tile_shm_n_tiles (GimpTile *tile)
+{
+  extern gsize _shm_size;
+
+  gsize slot_size = gimp_tile_width () * gimp_tile_height () * tile->bpp;
 
-  gimp_wire_destroy (&msg);
+  if (gimp_shm_ID () == -1)
+    return 1;
+
+  return MAX (1, _shm_size / slot_size);
 }
 
 static void
-gimp_tile_put (GimpTile *tile)
+gimp_tile_get (GimpTile *tiles,
+               gint      n_tiles)
 {
   extern GIOChannel *_writechannel;
 
-  GPTileReq        tile_req;
-  GPTileData       tile_data;
-  GPTileData      *tile_info;
-  GimpWireMessage  msg;
+  gint slot_size = gimp_tile_width () * gimp_tile_height () * tiles->bpp;
 
-  tile_req.drawable_ID = -1;
-  tile_req.tile_num    = 0;
-  tile_req.shadow      = 0;
+  while (n_tiles > 0)
+    {
+      GPTileReq        tile_req;
+      GPTileData      *tile_data;
+      GimpWireMessage  msg;
+      gint             i;
+
+      tile_req.drawable_ID = tiles->drawable->drawable_id;
+      tile_req.tile_num    = tiles->tile_num;
+      tile_req.shadow      = tiles->shadow;
+      tile_req.n_tiles     = MIN (n_tiles, gimp_tile_shm_n_tiles (tiles));
+
+      if (! gp_tile_req_write (_writechannel, &tile_req, NULL))
+        gimp_quit ();
+
+      gimp_read_expect_msg (&msg, GP_TILE_DATA);
+
+      tile_data = msg.data;
+      if (tile_data->drawable_ID != tiles->drawable->drawable_id ||
+          tile_data->tile_num    != tiles->tile_num              ||
+          tile_data->shadow      != tiles->shadow                ||
+          tile_data->width       != tiles->ewidth                ||
+          tile_data->height      != tiles->eheight               ||
+          tile_data->bpp         != tiles->bpp                   ||
+          tile_data->n_tiles     <  1                            ||
+          tile_data->n_tiles     >  tile_req.n_tiles)
+        {
+          g_message ("received tile info did not match computed tile info");
+          gimp_quit ();
+        }
 
-  if (! gp_tile_req_write (_writechannel, &tile_req, NULL))
-    gimp_quit ();
+      if (tile_data->use_shm)
+        {
+          for (i = 0; i < tile_data->n_tiles; i++)
+            {
+              GimpTile *tile = &tiles[i];
 
-  gimp_read_expect_msg (&msg, GP_TILE_DATA);
+              tile->data = g_memdup (gimp_shm_addr () + i * slot_size,
+                                     tile->ewidth * tile->eheight * tile->bpp);
+            }
+        }
+      else
+        {
+          tiles->data = tile_data->data;
+          tile_data->data = NULL;
+        }
 
-  tile_info = msg.data;
+      tiles   += tile_data->n_tiles;
+      n_tiles -= tile_data->n_tiles;
 
-  tile_data.drawable_ID = tile->drawable->drawable_id;
-  tile_data.tile_num    = tile->tile_num;
-  tile_data.shadow      = tile->shadow;
-  tile_data.bpp         = tile->bpp;
-  tile_data.width       = tile->ewidth;
-  tile_data.height      = tile->eheight;
-  tile_data.use_shm     = tile_info->use_shm;
-  tile_data.data        = NULL;
+      if (! gp_tile_ack_write (_writechannel, NULL))
+        gimp_quit ();
 
-  if (tile_info->use_shm)
-    memcpy (gimp_shm_addr (),
-            tile->data,
-            tile->ewidth * tile->eheight * tile->bpp);
-  else
-    tile_data.data = tile->data;
+      gimp_wire_destroy (&msg);
+    }
+}
+
+static void
+gimp_tile_put (GimpTile *tiles,
+               gint      n_tiles)
+{
+  extern GIOChannel *_writechannel;
+
+  gint slot_size = gimp_tile_width () * gimp_tile_height () * tiles->bpp;
 
-  if (! gp_tile_data_write (_writechannel, &tile_data, NULL))
-    gimp_quit ();
+  while (n_tiles > 0)
+    {
+      GPTileReq        tile_req;
+      GPTileData       tile_data;
+      GPTileData      *tile_info;
+      GimpWireMessage  msg;
+      gint             i;
+
+      tile_req.drawable_ID = -1;
+      tile_req.tile_num    = 0;
+      tile_req.shadow      = 0;
+      tile_req.n_tiles     = 0;
+
+      if (! gp_tile_req_write (_writechannel, &tile_req, NULL))
+        gimp_quit ();
+
+      gimp_read_expect_msg (&msg, GP_TILE_DATA);
+
+      tile_info = msg.data;
+
+      tile_data.drawable_ID = tiles->drawable->drawable_id;
+      tile_data.tile_num    = tiles->tile_num;
+      tile_data.shadow      = tiles->shadow;
+      tile_data.bpp         = tiles->bpp;
+      tile_data.width       = tiles->ewidth;
+      tile_data.height      = tiles->eheight;
+      tile_data.use_shm     = tile_info->use_shm;
+      tile_data.n_tiles     = 1;
+      tile_data.data        = NULL;
+
+      if (tile_info->use_shm)
+        {
+          tile_data.n_tiles = MIN (n_tiles, gimp_tile_shm_n_tiles (tiles));
+
+          for (i = 0; i < tile_data.n_tiles; i++)
+            {
+              GimpTile *tile = &tiles[i];
+
+              memcpy (gimp_shm_addr () + i * slot_size,
+                      tile->data,
+                      tile->ewidth * tile->eheight * tile->bpp);
+            }
+        }
+      else
+        {
+          tile_data.data = tiles->data;
+        }
 
-  gimp_wire_destroy (&msg);
+      if (! gp_tile_data_write (_writechannel, &tile_data, NULL))
+        gimp_quit ();
 
-  gimp_read_expect_msg (&msg, GP_TILE_ACK);
-  gimp_wire_destroy (&msg);
+      gimp_wire_destroy (&msg);
+
+      gimp_read_expect_msg (&msg, GP_TILE_ACK);
+      gimp_wire_destroy (&msg);
+
+      tiles   += tile_data.n_tiles;
+      n_tiles -= tile_data.n_tiles;
+    }
 }
 
 /* This function is nearly identical to the function 'tile_cache_insert'
  *  in the file 'tile_cache.c' which is part of the main gimp application.
  */
 static void
-gimp_tile_cache_insert (GimpTile *tile)
+gimp_tile_cache_init (void)
 {
-  GList *list;
-
-  if (!tile_hash_table)
+  if (! tile_hash_table)
     {
       tile_hash_table = g_hash_table_new (g_direct_hash, NULL);
       max_tile_size = gimp_tile_width () * gimp_tile_height () * 4;
     }
+}
+
+static void
+gimp_tile_cache_insert (GimpTile *tile)
+{
+  GList *list;
+
+  gimp_tile_cache_init ();
 
   /* First check and see if the tile is already
    *  in the cache. In that case we will simply place
@@ -62,8 +62,34 @@ void    gimp_tile_cache_ntiles (gulong     ntiles);
 
 /*  private function  */
 
+G_GNUC_INTERNAL void _gimp_tile_ref_prefetch         (GimpTile     *tile);
+G_GNUC_INTERNAL void _gimp_tile_ref_run              (GimpTile     *tiles,
+                                                      gint          n_tiles);
+G_GNUC_INTERNAL void _gimp_tile_unref_run            (GimpTile     *tiles,
+                                                      gint          n_tiles,
+                                                      gboolean      dirty);
+G_GNUC_INTERNAL void _gimp_tile_flush_run            (GimpTile     *tiles,
+                                                      gint          n_tiles);
+
 G_GNUC_INTERNAL void _gimp_tile_cache_flush_drawable (GimpDrawable *drawable);
 
+G_GNUC_INTERNAL void _gimp_region_get                (GimpDrawable *drawable,
+                                                      gboolean      shadow,
+                                                      gint          x,
+                                                      gint          y,
+                                                      gint          width,
+                                                      gint          height,
+                                                      guchar       *buf,
+                                                      gint          rowstride);
+G_GNUC_INTERNAL void _gimp_region_put                (GimpDrawable *drawable,
+                                                      gboolean      shadow,
+                                                      gint          x,
+                                                      gint          y,
+                                                      gint          width,
+                                                      gint          height,
+                                                      const guchar *buf,
+                                                      gint          rowstride);
+
 
 G_END_DECLS
 
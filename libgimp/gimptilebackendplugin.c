@@ -150,6 +150,25 @@ gimp_tile_backend_plugin_command (GeglTileSource  *tile_store,
   return NULL;
 }
 
+/*  GEGL tiles are transferred with region messages straight into
+ *  and out of the GEGL tile's memory, the legacy GimpTiles would
+ *  only add another copy.
+ */
+static void
+gimp_tile_get_mul_rect (GimpTileBackendPlugin *backend_plugin,
+                        gint                   x,
+                        gint                   y,
+                        GeglRectangle         *rect)
+{
+  GimpDrawable *drawable = backend_plugin->priv->drawable;
+  gint          size     = backend_plugin->priv->mul * TILE_WIDTH;
+
+  rect->x      = x * size;
+  rect->y      = y * size;
+  rect->width  = CLAMP ((gint) drawable->width  - rect->x, 0, size);
+  rect->height = CLAMP ((gint) drawable->height - rect->y, 0, size);
+}
+
 static GeglTile *
 gimp_tile_read_mul (GimpTileBackendPlugin *backend_plugin,
                     gint                   x,
@@ -158,53 +177,19 @@ gimp_tile_read_mul (GimpTileBackendPlugin *backend_plugin,
   GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
   GeglTileBackend              *backend = GEGL_TILE_BACKEND (backend_plugin);
   GeglTile                     *tile;
+  GeglRectangle                 rect;
   gint                          tile_size;
-  gint                          u, v;
-  gint                          mul = priv->mul;
-  guchar                       *tile_data;
+  gint                          tile_stride;
 
-  x *= mul;
-  y *= mul;
+  tile_size   = gegl_tile_backend_get_tile_size (backend);
+  tile_stride = priv->mul * TILE_WIDTH * priv->drawable->bpp;
+  tile        = gegl_tile_new (tile_size);
 
-  tile_size  = gegl_tile_backend_get_tile_size (backend);
-  tile       = gegl_tile_new (tile_size);
-  tile_data  = gegl_tile_get_data (tile);
+  gimp_tile_get_mul_rect (backend_plugin, x, y, &rect);
 
-  for (u = 0; u < mul; u++)
-    {
-      for (v = 0; v < mul; v++)
-        {
-          GimpTile *gimp_tile;
-
-          if (x + u >= priv->drawable->ntile_cols ||
-              y + v >= priv->drawable->ntile_rows)
-            continue;
-
-          gimp_tile = gimp_drawable_get_tile (priv->drawable,
-                                              priv->shadow,
-                                              y + v, x + u);
-          gimp_tile_ref (gimp_tile);
-
-          {
-            gint ewidth           = gimp_tile->ewidth;
-            gint eheight          = gimp_tile->eheight;
-            gint bpp              = gimp_tile->bpp;
-            gint tile_stride      = mul * TILE_WIDTH * bpp;
-            gint gimp_tile_stride = ewidth * bpp;
-            gint row;
-
-            for (row = 0; row < eheight; row++)
-              {
-                memcpy (tile_data + (row + TILE_HEIGHT * v) *
-                        tile_stride + u * TILE_WIDTH * bpp,
-                        ((gchar *) gimp_tile->data) + row * gimp_tile_stride,
-                        gimp_tile_stride);
-              }
-          }
-
-          gimp_tile_unref (gimp_tile, FALSE);
-        }
-    }
+  _gimp_region_get (priv->drawable, priv->shadow,
+                    rect.x, rect.y, rect.width, rect.height,
+                    gegl_tile_get_data (tile), tile_stride);
 
   return tile;
 }
@@ -216,45 +201,16 @@ gimp_tile_write_mul (GimpTileBackendPlugin *backend_plugin,
                      guchar                *source)
 {
   GimpTileBackendPluginPrivate *priv = backend_plugin->priv;
-  gint                          u, v;
-  gint                          mul = priv->mul;
+  GeglRectangle                 rect;
+  gint                          tile_stride;
 
-  x *= mul;
-  y *= mul;
+  tile_stride = priv->mul * TILE_WIDTH * priv->drawable->bpp;
 
-  for (v = 0; v < mul; v++)
-    {
-      for (u = 0; u < mul; u++)
-        {
-          GimpTile *gimp_tile;
-
-          if (x + u >= priv->drawable->ntile_cols ||
-              y + v >= priv->drawable->ntile_rows)
-            continue;
-
-          gimp_tile = gimp_drawable_get_tile (priv->drawable,
-                                              priv->shadow,
-                                              y+v, x+u);
-          gimp_tile_ref (gimp_tile);
-
-          {
-            gint ewidth           = gimp_tile->ewidth;
-            gint eheight          = gimp_tile->eheight;
-            gint bpp              = gimp_tile->bpp;
-            gint tile_stride      = mul * TILE_WIDTH * bpp;
-            gint gimp_tile_stride = ewidth * bpp;
-            gint row;
-
-            for (row = 0; row < eheight; row++)
-              memcpy (((gchar *)gimp_tile->data) + row * gimp_tile_stride,
-                      source + (row + v * TILE_HEIGHT) *
-                      tile_stride + u * TILE_WIDTH * bpp,
-                      gimp_tile_stride);
-          }
-
-          gimp_tile_unref (gimp_tile, TRUE);
-        }
-    }
+  gimp_tile_get_mul_rect (backend_plugin, x, y, &rect);
+
+  _gimp_region_put (priv->drawable, priv->shadow,
+                    rect.x, rect.y, rect.width, rect.height,
+                    source, tile_stride);
 }
 
 GeglTileBackend *
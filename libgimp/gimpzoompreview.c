@@ -894,3 +894,47 @@ gimp_zoom_preview_get_source (GimpZoomPreview *preview,
       return NULL;
     }
 }
+
+/**
+ * gimp_zoom_preview_render_async:
+ * @preview:   a #GimpZoomPreview widget
+ * @func:      the function rendering the preview
+ * @user_data: data to pass to @func
+ * @destroy:   function to free @user_data, or %NULL
+ *
+ * Reads the scaled image data the @preview is currently showing, like
+ * gimp_zoom_preview_get_source() does, and renders it with @func on a
+ * worker thread, see gimp_preview_render_async(). @func works at the
+ * zoom of the @preview, so it should scale any size parameters by
+ * gimp_zoom_preview_get_factor().
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_zoom_preview_render_async (GimpZoomPreview       *preview,
+                                GimpPreviewRenderFunc  func,
+                                gpointer               user_data,
+                                GDestroyNotify         destroy)
+{
+  guchar *src;
+  gint    width;
+  gint    height;
+  gint    bpp;
+
+  g_return_if_fail (GIMP_IS_ZOOM_PREVIEW (preview));
+  g_return_if_fail (func != NULL);
+
+  src = gimp_zoom_preview_get_source (preview, &width, &height, &bpp);
+
+  if (src)
+    {
+      gimp_preview_render_async (GIMP_PREVIEW (preview), src,
+                                 width, height, bpp,
+                                 func, user_data, destroy);
+      g_free (src);
+    }
+  else if (destroy)
+    {
+      destroy (user_data);
+    }
+}
@@ -72,6 +72,10 @@ guchar        * gimp_zoom_preview_get_source     (GimpZoomPreview *preview,
                                                   gint            *width,
                                                   gint            *height,
                                                   gint            *bpp);
+void            gimp_zoom_preview_render_async   (GimpZoomPreview       *preview,
+                                                  GimpPreviewRenderFunc  func,
+                                                  gpointer               user_data,
+                                                  GDestroyNotify         destroy);
 
 GimpDrawable  * gimp_zoom_preview_get_drawable   (GimpZoomPreview *preview);
 GimpZoomModel * gimp_zoom_preview_get_model      (GimpZoomPreview *preview);
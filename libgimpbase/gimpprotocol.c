@@ -140,6 +140,30 @@ static void _gp_has_init_write           (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_has_init_destroy         (GimpWireMessage  *msg);
 
+static void _gp_resident_read            (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_resident_write           (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_resident_destroy         (GimpWireMessage  *msg);
+
+static void _gp_region_req_read          (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_region_req_write         (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_region_req_destroy       (GimpWireMessage  *msg);
+
+static void _gp_region_data_read         (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_region_data_write        (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_region_data_destroy      (GimpWireMessage  *msg);
+
 
 
 void
@@ -197,6 +221,18 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_REGION_REQ,
+                      _gp_region_req_read,
+                      _gp_region_req_write,
+                      _gp_region_req_destroy);
+  gimp_wire_register (GP_REGION_DATA,
+                      _gp_region_data_read,
+                      _gp_region_data_write,
+                      _gp_region_data_destroy);
+  gimp_wire_register (GP_RESIDENT,
+                      _gp_resident_read,
+                      _gp_resident_write,
+                      _gp_resident_destroy);
 }
 
 gboolean
@@ -292,6 +328,44 @@ gp_tile_data_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_region_req_write (GIOChannel  *channel,
+                     GPRegionReq *region_req,
+                     gpointer     user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_REGION_REQ;
+  msg.data = region_req;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_region_data_write (GIOChannel   *channel,
+                      GPRegionData *region_data,
+                      gpointer      user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_REGION_DATA;
+  msg.data = region_data;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 gboolean
 gp_proc_run_write (GIOChannel *channel,
                    GPProcRun  *proc_run,
@@ -442,6 +516,24 @@ gp_has_init_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_resident_write (GIOChannel *channel,
+                   gpointer    user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_RESIDENT;
+  msg.data = NULL;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 /*  quit  */
 
 static void
@@ -484,6 +576,9 @@ _gp_config_read (GIOChannel      *channel,
   if (! _gimp_wire_read_int32 (channel,
                                (guint32 *) &config->shm_ID, 1, user_data))
     goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &config->shm_size, 1, user_data))
+    goto cleanup;
   if (! _gimp_wire_read_int8 (channel,
                               (guint8 *) &config->check_size, 1, user_data))
     goto cleanup;
@@ -499,7 +594,7 @@ _gp_config_read (GIOChannel      *channel,
                               user_data))
     goto cleanup;
   if (! _gimp_wire_read_int8 (channel,
-                              (guint8 *) &config->gimp_reserved_5, 1,
+                              (guint8 *) &config->resident, 1,
                               user_data))
     goto cleanup;
   if (! _gimp_wire_read_int8 (channel,
@@ -574,6 +669,9 @@ _gp_config_write (GIOChannel      *channel,
                                 (const guint32 *) &config->shm_ID, 1,
                                 user_data))
     return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &config->shm_size, 1, user_data))
+    return;
   if (! _gimp_wire_write_int8 (channel,
                                (const guint8 *) &config->check_size, 1,
                                user_data))
@@ -591,7 +689,7 @@ _gp_config_write (GIOChannel      *channel,
                                user_data))
     return;
   if (! _gimp_wire_write_int8 (channel,
-                               (const guint8 *) &config->gimp_reserved_5, 1,
+                               (const guint8 *) &config->resident, 1,
                                user_data))
     return;
   if (! _gimp_wire_write_int8 (channel,
@@ -674,6 +772,9 @@ _gp_tile_req_read (GIOChannel      *channel,
   if (! _gimp_wire_read_int32 (channel,
                                &tile_req->shadow, 1, user_data))
     goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_req->n_tiles, 1, user_data))
+    goto cleanup;
 
   msg->data = tile_req;
   return;
@@ -700,6 +801,9 @@ _gp_tile_req_write (GIOChannel      *channel,
   if (! _gimp_wire_write_int32 (channel,
                                 &tile_req->shadow, 1, user_data))
     return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_req->n_tiles, 1, user_data))
+    return;
 }
 
 static void
@@ -763,6 +867,9 @@ _gp_tile_data_read (GIOChannel      *channel,
   if (! _gimp_wire_read_int32 (channel,
                                &tile_data->use_shm, 1, user_data))
     goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_data->n_tiles, 1, user_data))
+    goto cleanup;
 
   if (!tile_data->use_shm)
     {
@@ -814,6 +921,9 @@ _gp_tile_data_write (GIOChannel      *channel,
   if (! _gimp_wire_write_int32 (channel,
                                 &tile_data->use_shm, 1, user_data))
     return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_data->n_tiles, 1, user_data))
+    return;
 
   if (!tile_data->use_shm)
     {
@@ -1863,3 +1973,220 @@ static void
 _gp_has_init_destroy (GimpWireMessage *msg)
 {
 }
+
+/* resident */
+
+static void
+_gp_resident_read (GIOChannel      *channel,
+                   GimpWireMessage *msg,
+                   gpointer         user_data)
+{
+}
+
+static void
+_gp_resident_write (GIOChannel      *channel,
+                    GimpWireMessage *msg,
+                    gpointer         user_data)
+{
+}
+
+static void
+_gp_resident_destroy (GimpWireMessage *msg)
+{
+}
+
+/*  region_req  */
+
+static void
+_gp_region_req_read (GIOChannel      *channel,
+                     GimpWireMessage *msg,
+                     gpointer         user_data)
+{
+  GPRegionReq *region_req = g_slice_new0 (GPRegionReq);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &region_req->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &region_req->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &region_req->x, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &region_req->y, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &region_req->width, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &region_req->height, 1, user_data))
+    goto cleanup;
+
+  msg->data = region_req;
+  return;
+
+ cleanup:
+  g_slice_free (GPRegionReq, region_req);
+  msg->data = NULL;
+}
+
+static void
+_gp_region_req_write (GIOChannel      *channel,
+                      GimpWireMessage *msg,
+                      gpointer         user_data)
+{
+  GPRegionReq *region_req = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &region_req->drawable_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &region_req->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &region_req->x, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &region_req->y, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &region_req->width, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &region_req->height, 1, user_data))
+    return;
+}
+
+static void
+_gp_region_req_destroy (GimpWireMessage *msg)
+{
+  GPRegionReq *region_req = msg->data;
+
+  if (region_req)
+    g_slice_free (GPRegionReq, msg->data);
+}
+
+/*  region_data  */
+
+static void
+_gp_region_data_read (GIOChannel      *channel,
+                      GimpWireMessage *msg,
+                      gpointer         user_data)
+{
+  GPRegionData *region_data = g_slice_new0 (GPRegionData);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &region_data->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &region_data->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &region_data->x, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &region_data->y, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &region_data->width, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &region_data->height, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &region_data->bpp, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &region_data->use_shm, 1, user_data))
+    goto cleanup;
+
+  if (! region_data->use_shm)
+    {
+      gsize length = ((gsize) region_data->width * region_data->height *
+                      region_data->bpp);
+
+      /*  senders split larger regions  */
+      if (length > G_MAXINT)
+        goto cleanup;
+
+      region_data->data = g_new (guchar, length);
+
+      if (! _gimp_wire_read_int8 (channel,
+                                  (guint8 *) region_data->data, length,
+                                  user_data))
+        goto cleanup;
+    }
+
+  msg->data = region_data;
+  return;
+
+ cleanup:
+  g_free (region_data->data);
+  g_slice_free (GPRegionData, region_data);
+  msg->data = NULL;
+}
+
+static void
+_gp_region_data_write (GIOChannel      *channel,
+                       GimpWireMessage *msg,
+                       gpointer         user_data)
+{
+  GPRegionData *region_data = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &region_data->drawable_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &region_data->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &region_data->x, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &region_data->y, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &region_data->width, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &region_data->height, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &region_data->bpp, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &region_data->use_shm, 1, user_data))
+    return;
+
+  if (! region_data->use_shm)
+    {
+      gsize length = ((gsize) region_data->width * region_data->height *
+                      region_data->bpp);
+
+      if (! _gimp_wire_write_int8 (channel,
+                                   (const guint8 *) region_data->data, length,
+                                   user_data))
+        return;
+    }
+}
+
+static void
+_gp_region_data_destroy (GimpWireMessage *msg)
+{
+  GPRegionData *region_data = msg->data;
+
+  if (region_data)
+    {
+      g_free (region_data->data);
+      g_slice_free (GPRegionData, region_data);
+    }
+}
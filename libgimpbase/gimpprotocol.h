@@ -26,7 +26,7 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0014
+#define GIMP_PROTOCOL_VERSION  0x0017
 
 
 enum
@@ -43,7 +43,10 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_REGION_REQ,
+  GP_REGION_DATA,
+  GP_RESIDENT
 };
 
 
@@ -51,6 +54,8 @@ typedef struct _GPConfig        GPConfig;
 typedef struct _GPTileReq       GPTileReq;
 typedef struct _GPTileAck       GPTileAck;
 typedef struct _GPTileData      GPTileData;
+typedef struct _GPRegionReq     GPRegionReq;
+typedef struct _GPRegionData    GPRegionData;
 typedef struct _GPParam         GPParam;
 typedef struct _GPParamDef      GPParamDef;
 typedef struct _GPProcRun       GPProcRun;
@@ -59,17 +64,22 @@ typedef struct _GPProcInstall   GPProcInstall;
 typedef struct _GPProcUninstall GPProcUninstall;
 
 
+/*  If resident is set, a plug-in that supports it may send GP_RESIDENT
+ *  right before its GP_PROC_RETURN and then wait for another GP_CONFIG
+ *  and GP_PROC_RUN instead of exiting, until it receives GP_QUIT.
+ */
 struct _GPConfig
 {
   guint32  version;
   guint32  tile_width;
   guint32  tile_height;
   gint32   shm_ID;
+  guint32  shm_size;
   gint8    check_size;
   gint8    check_type;
   gint8    show_help_button;
   gint8    use_cpu_accel;
-  gint8    gimp_reserved_5;
+  gint8    resident;
   gint8    gimp_reserved_6;
   gint8    gimp_reserved_7;
   gint8    gimp_reserved_8;
@@ -84,11 +94,19 @@ struct _GPConfig
   guint32  timestamp;
 };
 
+/*  A GP_TILE_REQ or GP_TILE_DATA message covers n_tiles consecutive
+ *  tiles starting at tile_num. More than one tile can only be
+ *  transferred through shared memory, where the tiles are stored back
+ *  to back, each taking tile_width * tile_height * bpp bytes of the
+ *  shm_size bytes announced in GPConfig.
+ */
+
 struct _GPTileReq
 {
   gint32   drawable_ID;
   guint32  tile_num;
   guint32  shadow;
+  guint32  n_tiles;
 };
 
 struct _GPTileData
@@ -100,6 +118,36 @@ struct _GPTileData
   guint32  width;
   guint32  height;
   guint32  use_shm;
+  guint32  n_tiles;
+  guchar  *data;
+};
+
+/*  GP_REGION_REQ and GP_REGION_DATA work like their tile counterparts,
+ *  but transfer an arbitrary rectangle of a drawable, with rows of
+ *  width * bpp bytes. The data goes through shared memory if it fits
+ *  into the shm_size bytes announced in GPConfig.
+ */
+
+struct _GPRegionReq
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  gint32   x;
+  gint32   y;
+  guint32  width;
+  guint32  height;
+};
+
+struct _GPRegionData
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  gint32   x;
+  gint32   y;
+  guint32  width;
+  guint32  height;
+  guint32  bpp;
+  guint32  use_shm;
   guchar  *data;
 };
 
@@ -202,6 +250,12 @@ gboolean  gp_tile_ack_write         (GIOChannel      *channel,
 gboolean  gp_tile_data_write        (GIOChannel      *channel,
                                      GPTileData      *tile_data,
                                      gpointer         user_data);
+gboolean  gp_region_req_write       (GIOChannel      *channel,
+                                     GPRegionReq     *region_req,
+                                     gpointer         user_data);
+gboolean  gp_region_data_write      (GIOChannel      *channel,
+                                     GPRegionData    *region_data,
+                                     gpointer         user_data);
 gboolean  gp_proc_run_write         (GIOChannel      *channel,
                                      GPProcRun       *proc_run,
                                      gpointer         user_data);
@@ -224,6 +278,8 @@ gboolean  gp_extension_ack_write    (GIOChannel      *channel,
                                      gpointer         user_data);
 gboolean  gp_has_init_write         (GIOChannel      *channel,
                                      gpointer         user_data);
+gboolean  gp_resident_write         (GIOChannel      *channel,
+                                     gpointer         user_data);
 
 void      gp_params_destroy         (GPParam         *params,
                                      gint             nparams);
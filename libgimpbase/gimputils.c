@@ -24,8 +24,16 @@
 #include <string.h>
 #include <stdio.h>
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include <glib-object.h>
 
+#ifdef G_OS_WIN32
+#include <windows.h>
+#endif
+
 #include "gimpbasetypes.h"
 #include "gimputils.h"
 
@@ -383,6 +391,38 @@ gimp_canonicalize_identifier (const gchar *identifier)
   return canonicalized;
 }
 
+/**
+ * gimp_get_number_of_processors:
+ *
+ * Determines the number of processors available to the process, for
+ * sizing the number of threads to use.  Unlike g_get_num_processors(),
+ * this doesn't need GLib 2.36.
+ *
+ * Return value: the number of processors, at least 1.
+ *
+ * Since: GIMP 2.10
+ **/
+gint
+gimp_get_number_of_processors (void)
+{
+  gint retval = 1;
+
+#ifdef G_OS_UNIX
+#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+  retval = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+#endif
+#ifdef G_OS_WIN32
+  SYSTEM_INFO system_info;
+
+  GetSystemInfo (&system_info);
+
+  retval = system_info.dwNumberOfProcessors;
+#endif
+
+  return MAX (retval, 1);
+}
+
 /**
  * gimp_enum_get_desc:
  * @enum_class: a #GEnumClass
@@ -39,6 +39,8 @@ gchar         * gimp_escape_uline            (const gchar  *str) G_GNUC_MALLOC;
 
 gchar         * gimp_canonicalize_identifier (const gchar  *identifier) G_GNUC_MALLOC;
 
+gint            gimp_get_number_of_processors (void);
+
 GimpEnumDesc  * gimp_enum_get_desc           (GEnumClass   *enum_class,
                                               gint          value);
 gboolean        gimp_enum_get_value          (GType         enum_type,
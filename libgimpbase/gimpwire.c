@@ -18,10 +18,15 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <string.h>
 
 #include <glib-object.h>
 
+#ifndef G_OS_WIN32
+#include <sys/uio.h>
+#endif
+
 #include <libgimpcolor/gimpcolortypes.h>
 
 #include "gimpwire.h"
@@ -232,6 +237,130 @@ gimp_wire_flush (GIOChannel *channel,
   return FALSE;
 }
 
+#ifdef G_OS_WIN32
+static gboolean
+gimp_wire_write_chars (GIOChannel   *channel,
+                       const guint8 *buf,
+                       gsize         count)
+{
+  while (count > 0)
+    {
+      GIOStatus  status;
+      GError    *error = NULL;
+      gsize      bytes;
+
+      do
+        {
+          bytes = 0;
+          status = g_io_channel_write_chars (channel,
+                                             (const gchar *) buf, count,
+                                             &bytes,
+                                             &error);
+        }
+      while (G_UNLIKELY (status == G_IO_STATUS_AGAIN));
+
+      if (G_UNLIKELY (status != G_IO_STATUS_NORMAL))
+        {
+          if (error)
+            {
+              g_warning ("%s: gimp_wire_writev(): error: %s",
+                         g_get_prgname (), error->message);
+              g_error_free (error);
+            }
+          else
+            {
+              g_warning ("%s: gimp_wire_writev(): error",
+                         g_get_prgname ());
+            }
+
+          return FALSE;
+        }
+
+      count -= bytes;
+      buf   += bytes;
+    }
+
+  return TRUE;
+}
+#endif
+
+/**
+ * gimp_wire_writev:
+ * @channel:    an unbuffered #GIOChannel
+ * @head:       the first chunk of data
+ * @head_count: the size of @head in bytes
+ * @tail:       the second chunk of data
+ * @tail_count: the size of @tail in bytes
+ *
+ * Writes @head followed by @tail to @channel, using a single
+ * writev() call where the platform allows it. This is meant for the
+ * #GimpWireFlushFunc and #GimpWireIOFunc implementations, so that a
+ * buffered message header and a large payload don't need to be
+ * copied together or written with separate system calls.
+ *
+ * Returns: %TRUE on success.
+ *
+ * Since: GIMP 2.10
+ **/
+gboolean
+gimp_wire_writev (GIOChannel   *channel,
+                  const guint8 *head,
+                  gsize         head_count,
+                  const guint8 *tail,
+                  gsize         tail_count)
+{
+#ifndef G_OS_WIN32
+  struct iovec iov[2];
+  gint         fd;
+
+  iov[0].iov_base = (gpointer) head;
+  iov[0].iov_len  = head_count;
+  iov[1].iov_base = (gpointer) tail;
+  iov[1].iov_len  = tail_count;
+
+  fd = g_io_channel_unix_get_fd (channel);
+
+  while (iov[0].iov_len + iov[1].iov_len > 0)
+    {
+      struct iovec *vec   = iov[0].iov_len ? iov : iov + 1;
+      gint          n_vec = iov[0].iov_len ? 2 : 1;
+      gssize        bytes;
+
+      bytes = writev (fd, vec, n_vec);
+
+      if (G_UNLIKELY (bytes < 0))
+        {
+          if (errno == EINTR || errno == EAGAIN)
+            continue;
+
+          g_warning ("%s: gimp_wire_writev(): error: %s",
+                     g_get_prgname (), g_strerror (errno));
+
+          return FALSE;
+        }
+
+      if (bytes >= iov[0].iov_len)
+        {
+          bytes -= iov[0].iov_len;
+
+          iov[0].iov_len   = 0;
+          iov[1].iov_base  = (guint8 *) iov[1].iov_base + bytes;
+          iov[1].iov_len  -= bytes;
+        }
+      else
+        {
+          iov[0].iov_base  = (guint8 *) iov[0].iov_base + bytes;
+          iov[0].iov_len  -= bytes;
+        }
+    }
+
+  return TRUE;
+#else
+  return (gimp_wire_write_chars (channel, head, head_count) &&
+          gimp_wire_write_chars (channel, tail, tail_count));
+#endif
+}
+
 gboolean
 gimp_wire_error (void)
 {
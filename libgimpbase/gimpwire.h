@@ -67,6 +67,11 @@ gboolean  gimp_wire_write         (GIOChannel      *channel,
                                    gpointer         user_data);
 gboolean  gimp_wire_flush         (GIOChannel      *channel,
                                    gpointer         user_data);
+gboolean  gimp_wire_writev        (GIOChannel      *channel,
+                                   const guint8    *head,
+                                   gsize            head_count,
+                                   const guint8    *tail,
+                                   gsize            tail_count);
 
 gboolean  gimp_wire_error         (void);
 void      gimp_wire_clear_error   (void);
@@ -21,6 +21,7 @@
 #include <babl/babl.h>
 #include <glib-object.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
 
 #include "gimpcolortypes.h"
@@ -57,6 +58,39 @@ struct _GimpSampleType
   GimpRGB color;
 };
 
+typedef struct
+{
+  gint             width;
+  gint             sub_pixel_size;
+  GimpSampleType  *top_row;
+  GimpSampleType  *bot_row;
+  GimpSampleType **block;
+} GimpSupersampleRows;
+
+typedef struct
+{
+  gint              x1, y1, x2, y2;
+  gint              max_depth;
+  gdouble           threshold;
+  GimpRenderFunc    render_func;
+  gpointer          render_data;
+  GimpPutPixelFunc  put_pixel_func;
+  gpointer          put_pixel_data;
+  GimpProgressFunc  progress_func;
+  gpointer          progress_data;
+
+  gint              n_bands;
+  volatile gint     next_band;
+  volatile gint     rows_done;
+
+  GMutex            mutex;
+  gulong            num_samples;
+} GimpSupersampleContext;
+
+
+#define SUPERSAMPLE_BAND_HEIGHT  16
+#define SUPERSAMPLE_MAX_THREADS  16
+
 
 static gulong
 gimp_render_sub_pixel (gint             max_depth,
@@ -238,142 +272,218 @@ gimp_render_sub_pixel (gint             max_depth,
   return num_samples;
 }
 
-gulong
-gimp_adaptive_supersample_area (gint              x1,
-                                gint              y1,
-                                gint              x2,
-                                gint              y2,
-                                gint              max_depth,
-                                gdouble           threshold,
-                                GimpRenderFunc    render_func,
-                                gpointer          render_data,
-                                GimpPutPixelFunc  put_pixel_func,
-                                gpointer          put_pixel_data,
-                                GimpProgressFunc  progress_func,
-                                gpointer          progress_data)
+static void
+gimp_supersample_rows_init (GimpSupersampleRows *rows,
+                            gint                 width,
+                            gint                 max_depth)
 {
-  gint             x, y, width;                 /* Counters, width of region */
-  gint             xt, xtt, yt;                 /* Temporary counters */
-  gint             sub_pixel_size;              /* Number of samples per pixel (1D) */
-  GimpRGB          color;                       /* Rendered pixel's color */
-  GimpSampleType   tmp_sample;                  /* For swapping samples */
-  GimpSampleType  *top_row, *bot_row, *tmp_row; /* Sample rows */
-  GimpSampleType **block;                       /* Sample block matrix */
-  gulong           num_samples;
-
-  g_return_val_if_fail (render_func != NULL, 0);
-  g_return_val_if_fail (put_pixel_func != NULL, 0);
-
-  /* Initialize color */
-
-  gimp_rgba_set (&color, 0.0, 0.0, 0.0, 0.0);
+  gint x, y;
 
   /* Calculate sub-pixel size */
 
-  sub_pixel_size = 1 << max_depth;
+  rows->sub_pixel_size = 1 << max_depth;
+  rows->width          = width;
 
   /* Create row arrays */
 
-  width = x2 - x1 + 1;
-
-  top_row = g_new (GimpSampleType, sub_pixel_size * width + 1);
-  bot_row = g_new (GimpSampleType, sub_pixel_size * width + 1);
+  rows->top_row = g_new (GimpSampleType, rows->sub_pixel_size * width + 1);
+  rows->bot_row = g_new (GimpSampleType, rows->sub_pixel_size * width + 1);
 
-  for (x = 0; x < (sub_pixel_size * width + 1); x++)
+  for (x = 0; x < (rows->sub_pixel_size * width + 1); x++)
     {
-      top_row[x].ready = FALSE;
+      rows->top_row[x].ready = FALSE;
 
-      gimp_rgba_set (&top_row[x].color, 0.0, 0.0, 0.0, 0.0);
+      gimp_rgba_set (&rows->top_row[x].color, 0.0, 0.0, 0.0, 0.0);
 
-      bot_row[x].ready = FALSE;
+      rows->bot_row[x].ready = FALSE;
 
-      gimp_rgba_set (&bot_row[x].color, 0.0, 0.0, 0.0, 0.0);
+      gimp_rgba_set (&rows->bot_row[x].color, 0.0, 0.0, 0.0, 0.0);
     }
 
   /* Allocate block matrix */
 
-  block = g_new (GimpSampleType *, sub_pixel_size + 1); /* Rows */
+  rows->block = g_new (GimpSampleType *, rows->sub_pixel_size + 1); /* Rows */
 
-  for (y = 0; y < (sub_pixel_size + 1); y++)
+  for (y = 0; y < (rows->sub_pixel_size + 1); y++)
     {
-      block[y] = g_new (GimpSampleType, sub_pixel_size + 1); /* Columns */
+      rows->block[y] = g_new (GimpSampleType, rows->sub_pixel_size + 1); /* Columns */
 
-      for (x = 0; x < (sub_pixel_size + 1); x++)
+      for (x = 0; x < (rows->sub_pixel_size + 1); x++)
         {
-          block[y][x].ready = FALSE;
+          rows->block[y][x].ready = FALSE;
 
-          gimp_rgba_set (&block[y][x].color, 0.0, 0.0, 0.0, 0.0);
+          gimp_rgba_set (&rows->block[y][x].color, 0.0, 0.0, 0.0, 0.0);
         }
     }
+}
 
-  /* Render region */
+static void
+gimp_supersample_rows_reset (GimpSupersampleRows *rows)
+{
+  gint x;
 
-  num_samples = 0;
+  for (x = 0; x < (rows->sub_pixel_size * rows->width + 1); x++)
+    rows->top_row[x].ready = FALSE;
+}
 
-  for (y = y1; y <= y2; y++)
-    {
-      /* Clear the bottom row */
+static void
+gimp_supersample_rows_free (GimpSupersampleRows *rows)
+{
+  gint y;
 
-      for (xt = 0; xt < (sub_pixel_size * width + 1); xt++)
-        bot_row[xt].ready = FALSE;
+  for (y = 0; y < (rows->sub_pixel_size + 1); y++)
+    g_free (rows->block[y]);
 
-      /* Clear first column */
+  g_free (rows->block);
+  g_free (rows->top_row);
+  g_free (rows->bot_row);
+}
 
-      for (yt = 0; yt < (sub_pixel_size + 1); yt++)
-        block[yt][0].ready = FALSE;
+static gulong
+gimp_supersample_render_row (GimpSupersampleRows *rows,
+                             gint                 x1,
+                             gint                 x2,
+                             gint                 y,
+                             gint                 max_depth,
+                             gdouble              threshold,
+                             GimpRenderFunc       render_func,
+                             gpointer             render_data,
+                             GimpPutPixelFunc     put_pixel_func,
+                             gpointer             put_pixel_data)
+{
+  const gint        sub_pixel_size = rows->sub_pixel_size;
+  GimpSampleType  **block          = rows->block;
+  GimpSampleType   *top_row        = rows->top_row;
+  GimpSampleType   *bot_row        = rows->bot_row;
+  GimpSampleType    tmp_sample;                  /* For swapping samples */
+  GimpRGB           color;                       /* Rendered pixel's color */
+  gint              x;
+  gint              xt, xtt, yt;                 /* Temporary counters */
+  gulong            num_samples = 0;
 
-      /* Render row */
+  /* Initialize color */
 
-      for (x = x1; x <= x2; x++)
-        {
-          /* Initialize block by clearing all but first row/column */
+  gimp_rgba_set (&color, 0.0, 0.0, 0.0, 0.0);
 
-          for (yt = 1; yt < (sub_pixel_size + 1); yt++)
-            for (xt = 1; xt < (sub_pixel_size + 1); xt++)
-              block[yt][xt].ready = FALSE;
+  /* Clear the bottom row */
 
-          /* Copy samples from top row to block */
+  for (xt = 0; xt < (sub_pixel_size * rows->width + 1); xt++)
+    bot_row[xt].ready = FALSE;
 
-          for (xtt = 0, xt = (x - x1) * sub_pixel_size;
-               xtt < (sub_pixel_size + 1);
-               xtt++, xt++)
-            block[0][xtt] = top_row[xt];
+  /* Clear first column */
 
-          /* Render pixel on (x, y) */
+  for (yt = 0; yt < (sub_pixel_size + 1); yt++)
+    block[yt][0].ready = FALSE;
 
-          num_samples += gimp_render_sub_pixel (max_depth, 1, block, x, y, 0, 0,
-                                                sub_pixel_size, sub_pixel_size,
-                                                threshold, sub_pixel_size,
-                                                &color,
-                                                render_func, render_data);
+  /* Render row */
 
-          if (put_pixel_func)
-            (* put_pixel_func) (x, y, &color, put_pixel_data);
+  for (x = x1; x <= x2; x++)
+    {
+      /* Initialize block by clearing all but first row/column */
 
-          /* Copy block information to rows */
+      for (yt = 1; yt < (sub_pixel_size + 1); yt++)
+        for (xt = 1; xt < (sub_pixel_size + 1); xt++)
+          block[yt][xt].ready = FALSE;
 
-          top_row[(x - x1 + 1) * sub_pixel_size] = block[0][sub_pixel_size];
+      /* Copy samples from top row to block */
 
-          for (xtt = 0, xt = (x - x1) * sub_pixel_size;
-               xtt < (sub_pixel_size + 1);
-               xtt++, xt++)
-            bot_row[xt] = block[sub_pixel_size][xtt];
+      for (xtt = 0, xt = (x - x1) * sub_pixel_size;
+           xtt < (sub_pixel_size + 1);
+           xtt++, xt++)
+        block[0][xtt] = top_row[xt];
 
-          /* Swap first and last columns */
+      /* Render pixel on (x, y) */
 
-          for (yt = 0; yt < (sub_pixel_size + 1); yt++)
-            {
-              tmp_sample                = block[yt][0];
-              block[yt][0]              = block[yt][sub_pixel_size];
-              block[yt][sub_pixel_size] = tmp_sample;
-            }
+      num_samples += gimp_render_sub_pixel (max_depth, 1, block, x, y, 0, 0,
+                                            sub_pixel_size, sub_pixel_size,
+                                            threshold, sub_pixel_size,
+                                            &color,
+                                            render_func, render_data);
+
+      if (put_pixel_func)
+        (* put_pixel_func) (x, y, &color, put_pixel_data);
+
+      /* Copy block information to rows */
+
+      top_row[(x - x1 + 1) * sub_pixel_size] = block[0][sub_pixel_size];
+
+      for (xtt = 0, xt = (x - x1) * sub_pixel_size;
+           xtt < (sub_pixel_size + 1);
+           xtt++, xt++)
+        bot_row[xt] = block[sub_pixel_size][xtt];
+
+      /* Swap first and last columns */
+
+      for (yt = 0; yt < (sub_pixel_size + 1); yt++)
+        {
+          tmp_sample                = block[yt][0];
+          block[yt][0]              = block[yt][sub_pixel_size];
+          block[yt][sub_pixel_size] = tmp_sample;
         }
+    }
+
+  /* Swap rows */
+
+  rows->top_row = bot_row;
+  rows->bot_row = top_row;
+
+  return num_samples;
+}
+
+/**
+ * gimp_adaptive_supersample_area:
+ * @x1:             left edge of the area
+ * @y1:             top edge of the area
+ * @x2:             right edge of the area, inclusive
+ * @y2:             bottom edge of the area, inclusive
+ * @max_depth:      maximum number of subdivisions of a pixel
+ * @threshold:      color difference at which a pixel is subdivided
+ * @render_func:    function that renders a sample
+ * @render_data:    user data for @render_func
+ * @put_pixel_func: function that stores a pixel
+ * @put_pixel_data: user data for @put_pixel_func
+ * @progress_func:  function called after each row, or %NULL
+ * @progress_data:  user data for @progress_func
+ *
+ * Renders the area row by row, sampling each pixel at its corners and
+ * subdividing it where the samples differ by @threshold or more.
+ *
+ * Returns: the number of samples rendered.
+ **/
+gulong
+gimp_adaptive_supersample_area (gint              x1,
+                                gint              y1,
+                                gint              x2,
+                                gint              y2,
+                                gint              max_depth,
+                                gdouble           threshold,
+                                GimpRenderFunc    render_func,
+                                gpointer          render_data,
+                                GimpPutPixelFunc  put_pixel_func,
+                                gpointer          put_pixel_data,
+                                GimpProgressFunc  progress_func,
+                                gpointer          progress_data)
+{
+  GimpSupersampleRows rows;
+  gint                y;
+  gulong              num_samples;
+
+  g_return_val_if_fail (render_func != NULL, 0);
+  g_return_val_if_fail (put_pixel_func != NULL, 0);
 
-      /* Swap rows */
+  gimp_supersample_rows_init (&rows, x2 - x1 + 1, max_depth);
 
-      tmp_row = top_row;
-      top_row = bot_row;
-      bot_row = tmp_row;
+  /* Render region */
+
+  num_samples = 0;
+
+  for (y = y1; y <= y2; y++)
+    {
+      num_samples += gimp_supersample_render_row (&rows, x1, x2, y,
+                                                  max_depth, threshold,
+                                                  render_func, render_data,
+                                                  put_pixel_func,
+                                                  put_pixel_data);
 
       /* Call progress display function (if any) */
 
@@ -383,12 +493,176 @@ gimp_adaptive_supersample_area (gint              x1,
 
   /* Free memory */
 
-  for (y = 0; y < (sub_pixel_size + 1); y++)
-    g_free (block[y]);
-
-  g_free (block);
-  g_free (top_row);
-  g_free (bot_row);
+  gimp_supersample_rows_free (&rows);
 
   return num_samples;
 }
+
+static void
+gimp_supersample_render_bands (GimpSupersampleContext *ctx,
+                               gboolean                report_progress)
+{
+  GimpSupersampleRows rows;
+  gulong              num_samples = 0;
+  gint                band;
+
+  gimp_supersample_rows_init (&rows, ctx->x2 - ctx->x1 + 1, ctx->max_depth);
+
+  while ((band = g_atomic_int_add (&ctx->next_band, 1)) < ctx->n_bands)
+    {
+      gint y_start = ctx->y1 + band * SUPERSAMPLE_BAND_HEIGHT;
+      gint y_end   = MIN (y_start + SUPERSAMPLE_BAND_HEIGHT - 1, ctx->y2);
+      gint y;
+
+      /*  The top samples of a band are rendered again instead of being
+       *  taken from the band above, which is rendered at the same time.
+       *  They are at the same positions, so the pixels are the same.
+       */
+      gimp_supersample_rows_reset (&rows);
+
+      for (y = y_start; y <= y_end; y++)
+        {
+          num_samples += gimp_supersample_render_row (&rows,
+                                                      ctx->x1, ctx->x2, y,
+                                                      ctx->max_depth,
+                                                      ctx->threshold,
+                                                      ctx->render_func,
+                                                      ctx->render_data,
+                                                      ctx->put_pixel_func,
+                                                      ctx->put_pixel_data);
+
+          g_atomic_int_inc (&ctx->rows_done);
+
+          if (report_progress && ctx->progress_func)
+            (* ctx->progress_func) (ctx->y1, ctx->y2,
+                                    ctx->y1 +
+                                    g_atomic_int_get (&ctx->rows_done) - 1,
+                                    ctx->progress_data);
+        }
+    }
+
+  gimp_supersample_rows_free (&rows);
+
+  g_mutex_lock (&ctx->mutex);
+  ctx->num_samples += num_samples;
+  g_mutex_unlock (&ctx->mutex);
+}
+
+static gpointer
+gimp_supersample_thread (gpointer data)
+{
+  gimp_supersample_render_bands (data, FALSE);
+
+  return NULL;
+}
+
+/**
+ * gimp_adaptive_supersample_area_parallel:
+ * @x1:             left edge of the area
+ * @y1:             top edge of the area
+ * @x2:             right edge of the area, inclusive
+ * @y2:             bottom edge of the area, inclusive
+ * @max_depth:      maximum number of subdivisions of a pixel
+ * @threshold:      color difference at which a pixel is subdivided
+ * @render_func:    thread-safe function that renders a sample
+ * @render_data:    user data for @render_func
+ * @put_pixel_func: thread-safe function that stores a pixel
+ * @put_pixel_data: user data for @put_pixel_func
+ * @progress_func:  function called after each row, or %NULL
+ * @progress_data:  user data for @progress_func
+ * @n_threads:      the number of threads to use, or 0 to use one per
+ *                  processor
+ *
+ * Does the same as gimp_adaptive_supersample_area(), but renders
+ * bands of rows on several threads at once. @render_func and
+ * @put_pixel_func are called from all of these threads, possibly at
+ * the same time, while @progress_func is only called from the calling
+ * thread.
+ *
+ * The samples on the top edge of each band are rendered by the thread
+ * of that band, so as long as @render_func returns the same color for
+ * the same position, the result is identical to the one of
+ * gimp_adaptive_supersample_area(). Only the returned number of
+ * samples is slightly higher.
+ *
+ * Returns: the number of samples rendered.
+ *
+ * Since: GIMP 2.10
+ **/
+gulong
+gimp_adaptive_supersample_area_parallel (gint              x1,
+                                         gint              y1,
+                                         gint              x2,
+                                         gint              y2,
+                                         gint              max_depth,
+                                         gdouble           threshold,
+                                         GimpRenderFunc    render_func,
+                                         gpointer          render_data,
+                                         GimpPutPixelFunc  put_pixel_func,
+                                         gpointer          put_pixel_data,
+                                         GimpProgressFunc  progress_func,
+                                         gpointer          progress_data,
+                                         gint              n_threads)
+{
+  GimpSupersampleContext   ctx;
+  GThread                **threads;
+  gint                     i;
+
+  g_return_val_if_fail (render_func != NULL, 0);
+  g_return_val_if_fail (put_pixel_func != NULL, 0);
+  g_return_val_if_fail (n_threads >= 0, 0);
+
+  ctx.x1             = x1;
+  ctx.y1             = y1;
+  ctx.x2             = x2;
+  ctx.y2             = y2;
+  ctx.max_depth      = max_depth;
+  ctx.threshold      = threshold;
+  ctx.render_func    = render_func;
+  ctx.render_data    = render_data;
+  ctx.put_pixel_func = put_pixel_func;
+  ctx.put_pixel_data = put_pixel_data;
+  ctx.progress_func  = progress_func;
+  ctx.progress_data  = progress_data;
+  ctx.n_bands        = ((y2 - y1 + SUPERSAMPLE_BAND_HEIGHT) /
+                        SUPERSAMPLE_BAND_HEIGHT);
+  ctx.next_band      = 0;
+  ctx.rows_done      = 0;
+  ctx.num_samples    = 0;
+
+  if (n_threads == 0)
+    {
+      n_threads = 1;
+
+      n_threads = MIN (gimp_get_number_of_processors (), SUPERSAMPLE_MAX_THREADS);
+    }
+
+  n_threads = CLAMP (n_threads, 1, MAX (ctx.n_bands, 1));
+
+  if (n_threads == 1)
+    return gimp_adaptive_supersample_area (x1, y1, x2, y2,
+                                           max_depth, threshold,
+                                           render_func, render_data,
+                                           put_pixel_func, put_pixel_data,
+                                           progress_func, progress_data);
+
+  g_mutex_init (&ctx.mutex);
+
+  threads = g_new (GThread *, n_threads - 1);
+
+  for (i = 0; i < n_threads - 1; i++)
+    threads[i] = g_thread_new ("supersample", gimp_supersample_thread, &ctx);
+
+  gimp_supersample_render_bands (&ctx, TRUE);
+
+  for (i = 0; i < n_threads - 1; i++)
+    g_thread_join (threads[i]);
+
+  g_free (threads);
+  g_mutex_clear (&ctx.mutex);
+
+  if (progress_func != NULL)
+    (* progress_func) (y1, y2, y2, progress_data);
+
+  return ctx.num_samples;
+}
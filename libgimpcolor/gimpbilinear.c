@@ -33,9 +33,59 @@
  * @short_description: Utility functions for bilinear interpolation.
  *
  * Utility functions for bilinear interpolation.
+ *
+ * Besides the functions that interpolate a single value from its
+ * neighbours, there are functions that sample a whole array of
+ * positions in an 8-bit or floating point pixel buffer at once, with
+ * either bilinear or bicubic interpolation. These avoid a function
+ * call and the coordinate wrapping per value; planar buffers can be
+ * sampled one plane at a time with @bpp set to 1.
  **/
 
 
+#define SAMPLE_MAX_CHANNELS 4
+
+
+static inline void
+gimp_sample_row_col (const gdouble *coords,
+                     gint           width,
+                     gint           height,
+                     gint           offset,
+                     gint           size,
+                     gint          *cols,
+                     gint          *rows,
+                     gdouble       *fx,
+                     gdouble       *fy)
+{
+  gdouble x  = floor (coords[0]);
+  gdouble y  = floor (coords[1]);
+  gint    x0 = (gint) x - offset;
+  gint    y0 = (gint) y - offset;
+  gint    k;
+
+  *fx = coords[0] - x;
+  *fy = coords[1] - y;
+
+  /*  positions outside the buffer repeat its edge pixels  */
+  for (k = 0; k < size; k++)
+    {
+      cols[k] = CLAMP (x0 + k, 0, width  - 1);
+      rows[k] = CLAMP (y0 + k, 0, height - 1);
+    }
+}
+
+/*  Catmull-Rom weights, see the lens distortion plug-in  */
+static inline void
+gimp_cubic_weights (gdouble  t,
+                    gdouble *w)
+{
+  w[0] = ((-0.5 * t + 1.0) * t - 0.5) * t;
+  w[1] = (1.5 * t - 2.5) * t * t + 1.0;
+  w[2] = ((-1.5 * t + 2.0) * t + 0.5) * t;
+  w[3] = (0.5 * t - 0.5) * t * t;
+}
+
+
 gdouble
 gimp_bilinear (gdouble  x,
                gdouble  y,
@@ -311,3 +361,381 @@ gimp_bilinear_pixels_8 (guchar    *dest,
         }
     }
 }
+
+/**
+ * gimp_bilinear_sample_8:
+ * @src:           8-bit pixels, interleaved.
+ * @width:         width of @src in pixels.
+ * @height:        height of @src in pixels.
+ * @src_rowstride: bytes from one row of @src to the next.
+ * @bpp:           channels per pixel, 1 to 4.
+ * @has_alpha:     %TRUE if the last channel is an alpha channel.
+ * @n_samples:     number of samples.
+ * @coords:        @n_samples pairs of x and y positions in @src.
+ * @dest:          where to store the @n_samples pixels of @bpp bytes.
+ *
+ * Samples @src at the positions in @coords with bilinear
+ * interpolation. The pixel in column x and row y is at (x, y), and
+ * positions outside @src get the color of the nearest edge pixel.
+ *
+ * The results are the same as the ones of gimp_bilinear_pixels_8(),
+ * except that fully transparent results get all their channels set
+ * to 0.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_bilinear_sample_8 (const guchar  *src,
+                        gint           width,
+                        gint           height,
+                        gint           src_rowstride,
+                        guint          bpp,
+                        gboolean       has_alpha,
+                        gint           n_samples,
+                        const gdouble *coords,
+                        guchar        *dest)
+{
+  gint i;
+
+  g_return_if_fail (src != NULL || n_samples == 0);
+  g_return_if_fail (coords != NULL || n_samples == 0);
+  g_return_if_fail (dest != NULL || n_samples == 0);
+  g_return_if_fail (bpp >= 1 && bpp <= SAMPLE_MAX_CHANNELS);
+
+  for (i = 0; i < n_samples; i++, coords += 2, dest += bpp)
+    {
+      const guchar *p[4];
+      gint          cols[2];
+      gint          rows[2];
+      gdouble       x, y;
+      guint         c;
+
+      gimp_sample_row_col (coords, width, height, 0, 2, cols, rows, &x, &y);
+
+      p[0] = src + rows[0] * src_rowstride + cols[0] * bpp;
+      p[1] = src + rows[0] * src_rowstride + cols[1] * bpp;
+      p[2] = src + rows[1] * src_rowstride + cols[0] * bpp;
+      p[3] = src + rows[1] * src_rowstride + cols[1] * bpp;
+
+      if (has_alpha)
+        {
+          guint   ai     = bpp - 1;
+          gdouble alpha0 = p[0][ai];
+          gdouble alpha1 = p[1][ai];
+          gdouble alpha2 = p[2][ai];
+          gdouble alpha3 = p[3][ai];
+          gdouble alpha  = ((1.0 - y) * ((1.0 - x) * alpha0 + x * alpha1)
+                            + y * ((1.0 - x) * alpha2 + x * alpha3));
+
+          dest[ai] = (guchar) alpha;
+
+          for (c = 0; c < ai; c++)
+            {
+              if (dest[ai])
+                {
+                  gdouble m0 = ((1.0 - x) * p[0][c] * alpha0
+                                + x * p[1][c] * alpha1);
+                  gdouble m1 = ((1.0 - x) * p[2][c] * alpha2
+                                + x * p[3][c] * alpha3);
+
+                  dest[c] = (guchar) (((1.0 - y) * m0 + y * m1) / alpha);
+                }
+              else
+                {
+                  dest[c] = 0;
+                }
+            }
+        }
+      else
+        {
+          for (c = 0; c < bpp; c++)
+            {
+              gdouble m0 = (1.0 - x) * p[0][c] + x * p[1][c];
+              gdouble m1 = (1.0 - x) * p[2][c] + x * p[3][c];
+
+              dest[c] = (guchar) ((1.0 - y) * m0 + y * m1);
+            }
+        }
+    }
+}
+
+/**
+ * gimp_bilinear_sample_float:
+ * @src:           floating point pixels, interleaved.
+ * @width:         width of @src in pixels.
+ * @height:        height of @src in pixels.
+ * @src_rowstride: floats from one row of @src to the next.
+ * @bpp:           channels per pixel, 1 to 4.
+ * @has_alpha:     %TRUE if the last channel is an alpha channel.
+ * @n_samples:     number of samples.
+ * @coords:        @n_samples pairs of x and y positions in @src.
+ * @dest:          where to store the @n_samples pixels of @bpp floats.
+ *
+ * Does the same as gimp_bilinear_sample_8() on floating point
+ * pixels. The results are not clamped or rounded.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_bilinear_sample_float (const gfloat  *src,
+                            gint           width,
+                            gint           height,
+                            gint           src_rowstride,
+                            guint          bpp,
+                            gboolean       has_alpha,
+                            gint           n_samples,
+                            const gdouble *coords,
+                            gfloat        *dest)
+{
+  gint i;
+
+  g_return_if_fail (src != NULL || n_samples == 0);
+  g_return_if_fail (coords != NULL || n_samples == 0);
+  g_return_if_fail (dest != NULL || n_samples == 0);
+  g_return_if_fail (bpp >= 1 && bpp <= SAMPLE_MAX_CHANNELS);
+
+  for (i = 0; i < n_samples; i++, coords += 2, dest += bpp)
+    {
+      const gfloat *p[4];
+      gint          cols[2];
+      gint          rows[2];
+      gdouble       x, y;
+      guint         c;
+
+      gimp_sample_row_col (coords, width, height, 0, 2, cols, rows, &x, &y);
+
+      p[0] = src + rows[0] * src_rowstride + cols[0] * bpp;
+      p[1] = src + rows[0] * src_rowstride + cols[1] * bpp;
+      p[2] = src + rows[1] * src_rowstride + cols[0] * bpp;
+      p[3] = src + rows[1] * src_rowstride + cols[1] * bpp;
+
+      if (has_alpha)
+        {
+          guint   ai     = bpp - 1;
+          gdouble alpha0 = p[0][ai];
+          gdouble alpha1 = p[1][ai];
+          gdouble alpha2 = p[2][ai];
+          gdouble alpha3 = p[3][ai];
+          gdouble alpha  = ((1.0 - y) * ((1.0 - x) * alpha0 + x * alpha1)
+                            + y * ((1.0 - x) * alpha2 + x * alpha3));
+
+          dest[ai] = alpha;
+
+          for (c = 0; c < ai; c++)
+            {
+              if (alpha != 0.0)
+                {
+                  gdouble m0 = ((1.0 - x) * p[0][c] * alpha0
+                                + x * p[1][c] * alpha1);
+                  gdouble m1 = ((1.0 - x) * p[2][c] * alpha2
+                                + x * p[3][c] * alpha3);
+
+                  dest[c] = ((1.0 - y) * m0 + y * m1) / alpha;
+                }
+              else
+                {
+                  dest[c] = 0.0;
+                }
+            }
+        }
+      else
+        {
+          for (c = 0; c < bpp; c++)
+            {
+              gdouble m0 = (1.0 - x) * p[0][c] + x * p[1][c];
+              gdouble m1 = (1.0 - x) * p[2][c] + x * p[3][c];
+
+              dest[c] = (1.0 - y) * m0 + y * m1;
+            }
+        }
+    }
+}
+
+/**
+ * gimp_bicubic_sample_8:
+ * @src:           8-bit pixels, interleaved.
+ * @width:         width of @src in pixels.
+ * @height:        height of @src in pixels.
+ * @src_rowstride: bytes from one row of @src to the next.
+ * @bpp:           channels per pixel, 1 to 4.
+ * @has_alpha:     %TRUE if the last channel is an alpha channel.
+ * @n_samples:     number of samples.
+ * @coords:        @n_samples pairs of x and y positions in @src.
+ * @dest:          where to store the @n_samples pixels of @bpp bytes.
+ *
+ * Samples @src at the positions in @coords with a Catmull-Rom spline
+ * through the 4x4 pixels around each position, with the colors
+ * weighted by their alpha if @has_alpha is %TRUE. Positions are
+ * handled like by gimp_bilinear_sample_8(), and the results are
+ * rounded and clamped to 0..255.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_bicubic_sample_8 (const guchar  *src,
+                       gint           width,
+                       gint           height,
+                       gint           src_rowstride,
+                       guint          bpp,
+                       gboolean       has_alpha,
+                       gint           n_samples,
+                       const gdouble *coords,
+                       guchar        *dest)
+{
+  gint i;
+
+  g_return_if_fail (src != NULL || n_samples == 0);
+  g_return_if_fail (coords != NULL || n_samples == 0);
+  g_return_if_fail (dest != NULL || n_samples == 0);
+  g_return_if_fail (bpp >= 1 && bpp <= SAMPLE_MAX_CHANNELS);
+
+  for (i = 0; i < n_samples; i++, coords += 2, dest += bpp)
+    {
+      gdouble sum[SAMPLE_MAX_CHANNELS] = { 0.0, 0.0, 0.0, 0.0 };
+      gdouble wx[4], wy[4];
+      gint    cols[4];
+      gint    rows[4];
+      gdouble x, y;
+      guint   ai = bpp - 1;
+      gint    u, v;
+      guint   c;
+
+      gimp_sample_row_col (coords, width, height, 1, 4, cols, rows, &x, &y);
+
+      gimp_cubic_weights (x, wx);
+      gimp_cubic_weights (y, wy);
+
+      for (v = 0; v < 4; v++)
+        {
+          const guchar *row = src + rows[v] * src_rowstride;
+
+          for (u = 0; u < 4; u++)
+            {
+              const guchar  *p = row + cols[u] * bpp;
+              const gdouble  w = wx[u] * wy[v];
+
+              if (has_alpha)
+                {
+                  for (c = 0; c < ai; c++)
+                    sum[c] += w * p[c] * p[ai];
+
+                  sum[ai] += w * p[ai];
+                }
+              else
+                {
+                  for (c = 0; c < bpp; c++)
+                    sum[c] += w * p[c];
+                }
+            }
+        }
+
+      if (has_alpha)
+        {
+          gdouble alpha = CLAMP (sum[ai], 0.0, 255.0);
+
+          dest[ai] = (guchar) (alpha + 0.5);
+
+          for (c = 0; c < ai; c++)
+            dest[c] = (alpha > 0.0 ?
+                       (guchar) CLAMP (sum[c] / alpha + 0.5, 0.0, 255.0) : 0);
+        }
+      else
+        {
+          for (c = 0; c < bpp; c++)
+            dest[c] = (guchar) CLAMP (sum[c] + 0.5, 0.0, 255.0);
+        }
+    }
+}
+
+/**
+ * gimp_bicubic_sample_float:
+ * @src:           floating point pixels, interleaved.
+ * @width:         width of @src in pixels.
+ * @height:        height of @src in pixels.
+ * @src_rowstride: floats from one row of @src to the next.
+ * @bpp:           channels per pixel, 1 to 4.
+ * @has_alpha:     %TRUE if the last channel is an alpha channel.
+ * @n_samples:     number of samples.
+ * @coords:        @n_samples pairs of x and y positions in @src.
+ * @dest:          where to store the @n_samples pixels of @bpp floats.
+ *
+ * Does the same as gimp_bicubic_sample_8() on floating point pixels.
+ * Only the alpha channel is clamped, to 0.0..1.0; colors may
+ * overshoot near sharp edges.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_bicubic_sample_float (const gfloat  *src,
+                           gint           width,
+                           gint           height,
+                           gint           src_rowstride,
+                           guint          bpp,
+                           gboolean       has_alpha,
+                           gint           n_samples,
+                           const gdouble *coords,
+                           gfloat        *dest)
+{
+  gint i;
+
+  g_return_if_fail (src != NULL || n_samples == 0);
+  g_return_if_fail (coords != NULL || n_samples == 0);
+  g_return_if_fail (dest != NULL || n_samples == 0);
+  g_return_if_fail (bpp >= 1 && bpp <= SAMPLE_MAX_CHANNELS);
+
+  for (i = 0; i < n_samples; i++, coords += 2, dest += bpp)
+    {
+      gdouble sum[SAMPLE_MAX_CHANNELS] = { 0.0, 0.0, 0.0, 0.0 };
+      gdouble wx[4], wy[4];
+      gint    cols[4];
+      gint    rows[4];
+      gdouble x, y;
+      guint   ai = bpp - 1;
+      gint    u, v;
+      guint   c;
+
+      gimp_sample_row_col (coords, width, height, 1, 4, cols, rows, &x, &y);
+
+      gimp_cubic_weights (x, wx);
+      gimp_cubic_weights (y, wy);
+
+      for (v = 0; v < 4; v++)
+        {
+          const gfloat *row = src + rows[v] * src_rowstride;
+
+          for (u = 0; u < 4; u++)
+            {
+              const gfloat  *p = row + cols[u] * bpp;
+              const gdouble  w = wx[u] * wy[v];
+
+              if (has_alpha)
+                {
+                  for (c = 0; c < ai; c++)
+                    sum[c] += w * p[c] * p[ai];
+
+                  sum[ai] += w * p[ai];
+                }
+              else
+                {
+                  for (c = 0; c < bpp; c++)
+                    sum[c] += w * p[c];
+                }
+            }
+        }
+
+      if (has_alpha)
+        {
+          gdouble alpha = CLAMP (sum[ai], 0.0, 1.0);
+
+          dest[ai] = alpha;
+
+          for (c = 0; c < ai; c++)
+            dest[c] = alpha > 0.0 ? sum[c] / alpha : 0.0;
+        }
+      else
+        {
+          for (c = 0; c < bpp; c++)
+            dest[c] = sum[c];
+        }
+    }
+}
@@ -56,6 +56,43 @@ void      gimp_bilinear_pixels_8 (guchar    *dest,
                                   gboolean   has_alpha,
                                   guchar   **values);
 
+void      gimp_bilinear_sample_8     (const guchar  *src,
+                                     gint           width,
+                                     gint           height,
+                                     gint           src_rowstride,
+                                     guint          bpp,
+                                     gboolean       has_alpha,
+                                     gint           n_samples,
+                                     const gdouble *coords,
+                                     guchar        *dest);
+void      gimp_bilinear_sample_float (const gfloat  *src,
+                                     gint           width,
+                                     gint           height,
+                                     gint           src_rowstride,
+                                     guint          bpp,
+                                     gboolean       has_alpha,
+                                     gint           n_samples,
+                                     const gdouble *coords,
+                                     gfloat        *dest);
+void      gimp_bicubic_sample_8      (const guchar  *src,
+                                     gint           width,
+                                     gint           height,
+                                     gint           src_rowstride,
+                                     guint          bpp,
+                                     gboolean       has_alpha,
+                                     gint           n_samples,
+                                     const gdouble *coords,
+                                     guchar        *dest);
+void      gimp_bicubic_sample_float  (const gfloat  *src,
+                                     gint           width,
+                                     gint           height,
+                                     gint           src_rowstride,
+                                     guint          bpp,
+                                     gboolean       has_alpha,
+                                     gint           n_samples,
+                                     const gdouble *coords,
+                                     gfloat        *dest);
+
 G_END_DECLS
 
 #endif  /* __GIMP_BILINEAR_H__ */
@@ -29,6 +29,11 @@
 #include "gimprgb.h"
 #include "gimphsv.h"
 
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define GIMP_COLOR_SPACE_SSE2 1
+#include <emmintrin.h>
+#endif
+
 
 
 /**
@@ -1101,3 +1106,555 @@ gimp_hsv_to_rgb4 (guchar  *rgb,
   rgb[1] = ROUND (saturation * 255.0);
   rgb[2] = ROUND (value      * 255.0);
 }
+
+
+/*  gfloat array functions  */
+
+static inline void
+gimp_rgb_to_hsv_float (const gfloat *rgb,
+                       gfloat       *hsv)
+{
+  gfloat r = rgb[0];
+  gfloat g = rgb[1];
+  gfloat b = rgb[2];
+  gfloat max, min, delta;
+
+  max = MAX (r, MAX (g, b));
+  min = MIN (r, MIN (g, b));
+
+  delta = max - min;
+
+  if (delta > 0.0001f)
+    {
+      gfloat h;
+
+      if (r == max)
+        {
+          h = (g - b) / delta;
+          if (h < 0.0f)
+            h += 6.0f;
+        }
+      else if (g == max)
+        {
+          h = 2.0f + (b - r) / delta;
+        }
+      else
+        {
+          h = 4.0f + (r - g) / delta;
+        }
+
+      hsv[0] = h / 6.0f;
+      hsv[1] = delta / max;
+    }
+  else
+    {
+      hsv[0] = 0.0f;
+      hsv[1] = 0.0f;
+    }
+
+  hsv[2] = max;
+  hsv[3] = rgb[3];
+}
+
+static inline void
+gimp_hsv_to_rgb_float (const gfloat *hsv,
+                       gfloat       *rgb)
+{
+  gfloat h = hsv[0];
+  gfloat s = hsv[1];
+  gfloat v = hsv[2];
+
+  rgb[3] = hsv[3];
+
+  if (s == 0.0f)
+    {
+      rgb[0] = v;
+      rgb[1] = v;
+      rgb[2] = v;
+    }
+  else
+    {
+      gint   i;
+      gfloat f, w, q, t;
+
+      if (h == 1.0f)
+        h = 0.0f;
+
+      h *= 6.0f;
+
+      i = (gint) h;
+      f = h - i;
+      w = v * (1.0f - s);
+      q = v * (1.0f - (s * f));
+      t = v * (1.0f - (s * (1.0f - f)));
+
+      switch (i)
+        {
+        case 0:
+          rgb[0] = v; rgb[1] = t; rgb[2] = w;
+          break;
+        case 1:
+          rgb[0] = q; rgb[1] = v; rgb[2] = w;
+          break;
+        case 2:
+          rgb[0] = w; rgb[1] = v; rgb[2] = t;
+          break;
+        case 3:
+          rgb[0] = w; rgb[1] = q; rgb[2] = v;
+          break;
+        case 4:
+          rgb[0] = t; rgb[1] = w; rgb[2] = v;
+          break;
+        default:
+          rgb[0] = v; rgb[1] = w; rgb[2] = q;
+          break;
+        }
+    }
+}
+
+static inline void
+gimp_rgb_to_hsl_float (const gfloat *rgb,
+                       gfloat       *hsl)
+{
+  gfloat r = rgb[0];
+  gfloat g = rgb[1];
+  gfloat b = rgb[2];
+  gfloat max, min, l;
+
+  max = MAX (r, MAX (g, b));
+  min = MIN (r, MIN (g, b));
+
+  l = (max + min) / 2.0f;
+
+  if (max == min)
+    {
+      hsl[0] = GIMP_HSL_UNDEFINED;
+      hsl[1] = 0.0f;
+    }
+  else
+    {
+      gfloat delta = max - min;
+      gfloat h;
+
+      if (l <= 0.5f)
+        hsl[1] = delta / (max + min);
+      else
+        hsl[1] = delta / (2.0f - max - min);
+
+      if (r == max)
+        h = (g - b) / delta;
+      else if (g == max)
+        h = 2.0f + (b - r) / delta;
+      else
+        h = 4.0f + (r - g) / delta;
+
+      h /= 6.0f;
+
+      if (h < 0.0f)
+        h += 1.0f;
+
+      hsl[0] = h;
+    }
+
+  hsl[2] = l;
+  hsl[3] = rgb[3];
+}
+
+static inline gfloat
+gimp_hsl_value_float (gfloat n1,
+                      gfloat n2,
+                      gfloat hue)
+{
+  if (hue > 6.0f)
+    hue -= 6.0f;
+  else if (hue < 0.0f)
+    hue += 6.0f;
+
+  if (hue < 1.0f)
+    return n1 + (n2 - n1) * hue;
+  else if (hue < 3.0f)
+    return n2;
+  else if (hue < 4.0f)
+    return n1 + (n2 - n1) * (4.0f - hue);
+  else
+    return n1;
+}
+
+static inline void
+gimp_hsl_to_rgb_float (const gfloat *hsl,
+                       gfloat       *rgb)
+{
+  gfloat h = hsl[0];
+  gfloat s = hsl[1];
+  gfloat l = hsl[2];
+
+  rgb[3] = hsl[3];
+
+  if (s == 0.0f)
+    {
+      rgb[0] = l;
+      rgb[1] = l;
+      rgb[2] = l;
+    }
+  else
+    {
+      gfloat m1, m2;
+
+      if (l <= 0.5f)
+        m2 = l * (1.0f + s);
+      else
+        m2 = l + s - l * s;
+
+      m1 = 2.0f * l - m2;
+
+      rgb[0] = gimp_hsl_value_float (m1, m2, h * 6.0f + 2.0f);
+      rgb[1] = gimp_hsl_value_float (m1, m2, h * 6.0f);
+      rgb[2] = gimp_hsl_value_float (m1, m2, h * 6.0f - 2.0f);
+    }
+}
+
+#ifdef GIMP_COLOR_SPACE_SSE2
+
+/*  The SSE2 versions below convert four pixels at once, transposed so
+ *  that each register holds one channel of all four.  The branches of
+ *  the scalar code become masks selecting between the candidate
+ *  results, which are all computed.
+ */
+
+#define SELECT(mask, a, b) \
+  _mm_or_ps (_mm_and_ps ((mask), (a)), _mm_andnot_ps ((mask), (b)))
+
+#define INT_MASK(i, n) \
+  _mm_castsi128_ps (_mm_cmpeq_epi32 ((i), _mm_set1_epi32 (n)))
+
+static inline void
+gimp_rgb_to_hsv_sse2 (const gfloat *src,
+                      gfloat       *dest)
+{
+  __m128 r = _mm_loadu_ps (src);
+  __m128 g = _mm_loadu_ps (src + 4);
+  __m128 b = _mm_loadu_ps (src + 8);
+  __m128 a = _mm_loadu_ps (src + 12);
+  __m128 max, min, delta, inv, chroma, r_max, g_max;
+  __m128 h, h_r, h_g, h_b, s;
+
+  _MM_TRANSPOSE4_PS (r, g, b, a);
+
+  max    = _mm_max_ps (r, _mm_max_ps (g, b));
+  min    = _mm_min_ps (r, _mm_min_ps (g, b));
+  delta  = _mm_sub_ps (max, min);
+  chroma = _mm_cmpgt_ps (delta, _mm_set1_ps (0.0001f));
+
+  /*  divide by one where the result is thrown away anyway  */
+  inv = _mm_div_ps (_mm_set1_ps (1.0f),
+                    SELECT (chroma, delta, _mm_set1_ps (1.0f)));
+
+  h_r = _mm_mul_ps (_mm_sub_ps (g, b), inv);
+  h_r = _mm_add_ps (h_r, _mm_and_ps (_mm_cmplt_ps (h_r, _mm_setzero_ps ()),
+                                     _mm_set1_ps (6.0f)));
+  h_g = _mm_add_ps (_mm_set1_ps (2.0f), _mm_mul_ps (_mm_sub_ps (b, r), inv));
+  h_b = _mm_add_ps (_mm_set1_ps (4.0f), _mm_mul_ps (_mm_sub_ps (r, g), inv));
+
+  r_max = _mm_cmpeq_ps (r, max);
+  g_max = _mm_cmpeq_ps (g, max);
+
+  h = SELECT (r_max, h_r, SELECT (g_max, h_g, h_b));
+  h = _mm_and_ps (chroma, _mm_mul_ps (h, _mm_set1_ps (1.0f / 6.0f)));
+
+  s = _mm_and_ps (chroma,
+                  _mm_div_ps (delta, SELECT (chroma, max, _mm_set1_ps (1.0f))));
+
+  _MM_TRANSPOSE4_PS (h, s, max, a);
+
+  _mm_storeu_ps (dest,      h);
+  _mm_storeu_ps (dest + 4,  s);
+  _mm_storeu_ps (dest + 8,  max);
+  _mm_storeu_ps (dest + 12, a);
+}
+
+static inline void
+gimp_hsv_to_rgb_sse2 (const gfloat *src,
+                      gfloat       *dest)
+{
+  __m128  h = _mm_loadu_ps (src);
+  __m128  s = _mm_loadu_ps (src + 4);
+  __m128  v = _mm_loadu_ps (src + 8);
+  __m128  a = _mm_loadu_ps (src + 12);
+  __m128  one = _mm_set1_ps (1.0f);
+  __m128  f, w, q, t, gray;
+  __m128  m0, m1, m2, m3, m4;
+  __m128  r, g, b;
+  __m128i i;
+
+  _MM_TRANSPOSE4_PS (h, s, v, a);
+
+  gray = _mm_cmpeq_ps (s, _mm_setzero_ps ());
+
+  h = _mm_andnot_ps (_mm_cmpeq_ps (h, one), h);
+  h = _mm_mul_ps (h, _mm_set1_ps (6.0f));
+
+  i = _mm_cvttps_epi32 (h);
+  f = _mm_sub_ps (h, _mm_cvtepi32_ps (i));
+  w = _mm_mul_ps (v, _mm_sub_ps (one, s));
+  q = _mm_mul_ps (v, _mm_sub_ps (one, _mm_mul_ps (s, f)));
+  t = _mm_mul_ps (v, _mm_sub_ps (one, _mm_mul_ps (s, _mm_sub_ps (one, f))));
+
+  m0 = INT_MASK (i, 0);
+  m1 = INT_MASK (i, 1);
+  m2 = INT_MASK (i, 2);
+  m3 = INT_MASK (i, 3);
+  m4 = INT_MASK (i, 4);
+
+  /*  sector 5 is the fallback, like the default case of the scalar code  */
+  r = SELECT (m0, v, SELECT (m1, q, SELECT (_mm_or_ps (m2, m3), w,
+                                            SELECT (m4, t, v))));
+  g = SELECT (m0, t, SELECT (_mm_or_ps (m1, m2), v, SELECT (m3, q, w)));
+  b = SELECT (_mm_or_ps (m0, m1), w, SELECT (m2, t,
+                                             SELECT (_mm_or_ps (m3, m4), v,
+                                                     q)));
+
+  r = SELECT (gray, v, r);
+  g = SELECT (gray, v, g);
+  b = SELECT (gray, v, b);
+
+  _MM_TRANSPOSE4_PS (r, g, b, a);
+
+  _mm_storeu_ps (dest,      r);
+  _mm_storeu_ps (dest + 4,  g);
+  _mm_storeu_ps (dest + 8,  b);
+  _mm_storeu_ps (dest + 12, a);
+}
+
+static inline void
+gimp_rgb_to_hsl_sse2 (const gfloat *src,
+                      gfloat       *dest)
+{
+  __m128 r = _mm_loadu_ps (src);
+  __m128 g = _mm_loadu_ps (src + 4);
+  __m128 b = _mm_loadu_ps (src + 8);
+  __m128 a = _mm_loadu_ps (src + 12);
+  __m128 one = _mm_set1_ps (1.0f);
+  __m128 max, min, sum, delta, inv, gray;
+  __m128 h, s, l;
+
+  _MM_TRANSPOSE4_PS (r, g, b, a);
+
+  max   = _mm_max_ps (r, _mm_max_ps (g, b));
+  min   = _mm_min_ps (r, _mm_min_ps (g, b));
+  sum   = _mm_add_ps (max, min);
+  delta = _mm_sub_ps (max, min);
+  gray  = _mm_cmpeq_ps (max, min);
+
+  l = _mm_mul_ps (sum, _mm_set1_ps (0.5f));
+
+  s = SELECT (_mm_cmple_ps (l, _mm_set1_ps (0.5f)),
+              sum, _mm_sub_ps (_mm_sub_ps (_mm_set1_ps (2.0f), max), min));
+  s = _mm_andnot_ps (gray,
+                     _mm_div_ps (delta, SELECT (gray, one, s)));
+
+  inv = _mm_div_ps (one, SELECT (gray, one, delta));
+
+  h = SELECT (_mm_cmpeq_ps (r, max),
+              _mm_mul_ps (_mm_sub_ps (g, b), inv),
+              SELECT (_mm_cmpeq_ps (g, max),
+                      _mm_add_ps (_mm_set1_ps (2.0f),
+                                  _mm_mul_ps (_mm_sub_ps (b, r), inv)),
+                      _mm_add_ps (_mm_set1_ps (4.0f),
+                                  _mm_mul_ps (_mm_sub_ps (r, g), inv))));
+  h = _mm_mul_ps (h, _mm_set1_ps (1.0f / 6.0f));
+  h = _mm_add_ps (h, _mm_and_ps (_mm_cmplt_ps (h, _mm_setzero_ps ()), one));
+  h = SELECT (gray, _mm_set1_ps (GIMP_HSL_UNDEFINED), h);
+
+  _MM_TRANSPOSE4_PS (h, s, l, a);
+
+  _mm_storeu_ps (dest,      h);
+  _mm_storeu_ps (dest + 4,  s);
+  _mm_storeu_ps (dest + 8,  l);
+  _mm_storeu_ps (dest + 12, a);
+}
+
+static inline __m128
+gimp_hsl_value_sse2 (__m128 n1,
+                     __m128 n2,
+                     __m128 hue)
+{
+  __m128 six = _mm_set1_ps (6.0f);
+  __m128 ramp_up, ramp_down;
+
+  hue = _mm_sub_ps (hue, _mm_and_ps (_mm_cmpgt_ps (hue, six), six));
+  hue = _mm_add_ps (hue, _mm_and_ps (_mm_cmplt_ps (hue, _mm_setzero_ps ()),
+                                     six));
+
+  ramp_up   = _mm_add_ps (n1, _mm_mul_ps (_mm_sub_ps (n2, n1), hue));
+  ramp_down = _mm_add_ps (n1, _mm_mul_ps (_mm_sub_ps (n2, n1),
+                                          _mm_sub_ps (_mm_set1_ps (4.0f),
+                                                      hue)));
+
+  return SELECT (_mm_cmplt_ps (hue, _mm_set1_ps (1.0f)), ramp_up,
+                 SELECT (_mm_cmplt_ps (hue, _mm_set1_ps (3.0f)), n2,
+                         SELECT (_mm_cmplt_ps (hue, _mm_set1_ps (4.0f)),
+                                 ramp_down, n1)));
+}
+
+static inline void
+gimp_hsl_to_rgb_sse2 (const gfloat *src,
+                      gfloat       *dest)
+{
+  __m128 h = _mm_loadu_ps (src);
+  __m128 s = _mm_loadu_ps (src + 4);
+  __m128 l = _mm_loadu_ps (src + 8);
+  __m128 a = _mm_loadu_ps (src + 12);
+  __m128 m1, m2, gray;
+  __m128 r, g, b;
+
+  _MM_TRANSPOSE4_PS (h, s, l, a);
+
+  gray = _mm_cmpeq_ps (s, _mm_setzero_ps ());
+
+  m2 = SELECT (_mm_cmple_ps (l, _mm_set1_ps (0.5f)),
+               _mm_mul_ps (l, _mm_add_ps (_mm_set1_ps (1.0f), s)),
+               _mm_sub_ps (_mm_add_ps (l, s), _mm_mul_ps (l, s)));
+  m1 = _mm_sub_ps (_mm_add_ps (l, l), m2);
+
+  h = _mm_mul_ps (h, _mm_set1_ps (6.0f));
+
+  r = gimp_hsl_value_sse2 (m1, m2, _mm_add_ps (h, _mm_set1_ps (2.0f)));
+  g = gimp_hsl_value_sse2 (m1, m2, h);
+  b = gimp_hsl_value_sse2 (m1, m2, _mm_sub_ps (h, _mm_set1_ps (2.0f)));
+
+  r = SELECT (gray, l, r);
+  g = SELECT (gray, l, g);
+  b = SELECT (gray, l, b);
+
+  _MM_TRANSPOSE4_PS (r, g, b, a);
+
+  _mm_storeu_ps (dest,      r);
+  _mm_storeu_ps (dest + 4,  g);
+  _mm_storeu_ps (dest + 8,  b);
+  _mm_storeu_ps (dest + 12, a);
+}
+
+#undef SELECT
+#undef INT_MASK
+
+#define CONVERT_PIXELS(src, dest, n_pixels, sse2_func, float_func) \
+  G_STMT_START                                                     \
+    {                                                              \
+      for (; n_pixels >= 4; n_pixels -= 4)                         \
+        {                                                          \
+          sse2_func (src, dest);                                   \
+          src  += 16;                                              \
+          dest += 16;                                              \
+        }                                                          \
+      for (; n_pixels > 0; n_pixels--)                             \
+        {                                                          \
+          float_func (src, dest);                                  \
+          src  += 4;                                               \
+          dest += 4;                                               \
+        }                                                          \
+    }                                                              \
+  G_STMT_END
+
+#else /* ! GIMP_COLOR_SPACE_SSE2 */
+
+#define CONVERT_PIXELS(src, dest, n_pixels, sse2_func, float_func) \
+  G_STMT_START                                                     \
+    {                                                              \
+      for (; n_pixels > 0; n_pixels--)                             \
+        {                                                          \
+          float_func (src, dest);                                  \
+          src  += 4;                                               \
+          dest += 4;                                               \
+        }                                                          \
+    }                                                              \
+  G_STMT_END
+
+#endif /* GIMP_COLOR_SPACE_SSE2 */
+
+/**
+ * gimp_rgb_to_hsv_pixels:
+ * @rgba:     @n_pixels RGBA pixels, four floats each
+ * @hsva:     returns @n_pixels HSVA pixels, may be the same as @rgba
+ * @n_pixels: the number of pixels to convert
+ *
+ * Converts an array of pixels from RGB to HSV, like calling
+ * gimp_rgb_to_hsv() on each of them.  Alpha is copied.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_rgb_to_hsv_pixels (const gfloat *rgba,
+                        gfloat       *hsva,
+                        gint          n_pixels)
+{
+  g_return_if_fail (n_pixels == 0 || (rgba != NULL && hsva != NULL));
+
+  CONVERT_PIXELS (rgba, hsva, n_pixels,
+                  gimp_rgb_to_hsv_sse2, gimp_rgb_to_hsv_float);
+}
+
+/**
+ * gimp_hsv_to_rgb_pixels:
+ * @hsva:     @n_pixels HSVA pixels, four floats each
+ * @rgba:     returns @n_pixels RGBA pixels, may be the same as @hsva
+ * @n_pixels: the number of pixels to convert
+ *
+ * Converts an array of pixels from HSV to RGB, like calling
+ * gimp_hsv_to_rgb() on each of them.  Alpha is copied.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_hsv_to_rgb_pixels (const gfloat *hsva,
+                        gfloat       *rgba,
+                        gint          n_pixels)
+{
+  g_return_if_fail (n_pixels == 0 || (hsva != NULL && rgba != NULL));
+
+  CONVERT_PIXELS (hsva, rgba, n_pixels,
+                  gimp_hsv_to_rgb_sse2, gimp_hsv_to_rgb_float);
+}
+
+/**
+ * gimp_rgb_to_hsl_pixels:
+ * @rgba:     @n_pixels RGBA pixels, four floats each
+ * @hsla:     returns @n_pixels HSLA pixels, may be the same as @rgba
+ * @n_pixels: the number of pixels to convert
+ *
+ * Converts an array of pixels from RGB to HSL, like calling
+ * gimp_rgb_to_hsl() on each of them.  Alpha is copied.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_rgb_to_hsl_pixels (const gfloat *rgba,
+                        gfloat       *hsla,
+                        gint          n_pixels)
+{
+  g_return_if_fail (n_pixels == 0 || (rgba != NULL && hsla != NULL));
+
+  CONVERT_PIXELS (rgba, hsla, n_pixels,
+                  gimp_rgb_to_hsl_sse2, gimp_rgb_to_hsl_float);
+}
+
+/**
+ * gimp_hsl_to_rgb_pixels:
+ * @hsla:     @n_pixels HSLA pixels, four floats each
+ * @rgba:     returns @n_pixels RGBA pixels, may be the same as @hsla
+ * @n_pixels: the number of pixels to convert
+ *
+ * Converts an array of pixels from HSL to RGB, like calling
+ * gimp_hsl_to_rgb() on each of them.  Alpha is copied.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_hsl_to_rgb_pixels (const gfloat *hsla,
+                        gfloat       *rgba,
+                        gint          n_pixels)
+{
+  g_return_if_fail (n_pixels == 0 || (hsla != NULL && rgba != NULL));
+
+  CONVERT_PIXELS (hsla, rgba, n_pixels,
+                  gimp_hsl_to_rgb_sse2, gimp_hsl_to_rgb_float);
+}
@@ -99,6 +99,22 @@ void    gimp_hsv_to_rgb4        (guchar       *rgb,
                                  gdouble       value);
 
 
+/*  gfloat array functions  */
+
+void    gimp_rgb_to_hsv_pixels  (const gfloat *rgba,
+                                 gfloat       *hsva,
+                                 gint          n_pixels);
+void    gimp_hsv_to_rgb_pixels  (const gfloat *hsva,
+                                 gfloat       *rgba,
+                                 gint          n_pixels);
+void    gimp_rgb_to_hsl_pixels  (const gfloat *rgba,
+                                 gfloat       *hsla,
+                                 gint          n_pixels);
+void    gimp_hsl_to_rgb_pixels  (const gfloat *hsla,
+                                 gfloat       *rgba,
+                                 gint          n_pixels);
+
+
 G_END_DECLS
 
 #endif  /* __GIMP_COLOR_SPACE_H__ */
@@ -109,6 +109,26 @@ struct _GimpVector4
 };
 
 
+typedef struct _GimpRandomStream GimpRandomStream;
+
+/**
+ * GimpRandomStream:
+ *
+ * The random numbers for one seed and position, see
+ * gimp_random_stream_init(). All fields are private.
+ *
+ * Since: GIMP 2.10
+ **/
+struct _GimpRandomStream
+{
+  /*< private >*/
+  guint32 key[2];
+  guint32 counter[4];
+  guint32 block[4];
+  gint    index;
+};
+
+
 G_END_DECLS
 
 #endif /* __GIMP_MATH_TYPES_H__ */
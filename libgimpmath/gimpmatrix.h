@@ -116,6 +116,11 @@ void          gimp_matrix3_transform_point (const GimpMatrix3 *matrix,
                                             gdouble            y,
                                             gdouble           *newx,
                                             gdouble           *newy);
+void          gimp_matrix3_transform_points
+                                           (const GimpMatrix3 *matrix,
+                                            const GimpVector2 *points,
+                                            gint               n_points,
+                                            GimpVector2       *new_points);
 
 
 /*****************/
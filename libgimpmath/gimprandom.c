@@ -0,0 +1,227 @@
+/* LIBGIMP - The GIMP Library
+ * Copyright (C) 1995-1997 Peter Mattis and Spencer Kimball
+ *
+ * gimprandom.c
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "gimpmathtypes.h"
+
+#include "gimprandom.h"
+
+
+/**
+ * SECTION: gimprandom
+ * @title: GimpRandom
+ * @short_description: Random numbers keyed on a seed and a position
+ *
+ * A #GimpRandomStream gives the same random numbers for a given seed
+ * and pixel position, no matter in which order the pixels are
+ * processed, or on how many threads. Filters can use it instead of
+ * drawing from one #GRand in scan order, which only gives
+ * reproducible results when the whole image is processed in one go,
+ * in a fixed order.
+ *
+ * The numbers come from the Philox4x32-10 counter-based generator
+ * (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3",
+ * SC11), with the seed as the key and the position as the counter.
+ **/
+
+
+#define PHILOX_M0  0xD2511F53
+#define PHILOX_M1  0xCD9E8D57
+#define PHILOX_W0  0x9E3779B9
+#define PHILOX_W1  0xBB67AE85
+
+
+static void
+gimp_random_stream_next_block (GimpRandomStream *stream)
+{
+  guint32 c0 = stream->counter[0];
+  guint32 c1 = stream->counter[1];
+  guint32 c2 = stream->counter[2];
+  guint32 c3 = stream->counter[3];
+  guint32 k0 = stream->key[0];
+  guint32 k1 = stream->key[1];
+  gint    round;
+
+  for (round = 0; round < 10; round++)
+    {
+      guint64 p0 = (guint64) PHILOX_M0 * c0;
+      guint64 p1 = (guint64) PHILOX_M1 * c2;
+
+      c0 = (guint32) (p1 >> 32) ^ c1 ^ k0;
+      c1 = (guint32) p1;
+      c2 = (guint32) (p0 >> 32) ^ c3 ^ k1;
+      c3 = (guint32) p0;
+
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+    }
+
+  stream->block[0] = c0;
+  stream->block[1] = c1;
+  stream->block[2] = c2;
+  stream->block[3] = c3;
+  stream->index    = 0;
+
+  /*  the third word counts the blocks drawn at this position  */
+  if (++stream->counter[2] == 0)
+    stream->counter[3]++;
+}
+
+/**
+ * gimp_random_stream_init:
+ * @stream: a #GimpRandomStream
+ * @seed:   the seed
+ * @x:      the horizontal position
+ * @y:      the vertical position
+ *
+ * Sets up @stream to give the random numbers for @seed and the pixel
+ * at @x, @y. The stream is cheap to set up, so it is usually done
+ * again for each pixel.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_random_stream_init (GimpRandomStream *stream,
+                         guint32           seed,
+                         gint              x,
+                         gint              y)
+{
+  g_return_if_fail (stream != NULL);
+
+  stream->key[0]     = seed;
+  stream->key[1]     = 0;
+  stream->counter[0] = x;
+  stream->counter[1] = y;
+  stream->counter[2] = 0;
+  stream->counter[3] = 0;
+  stream->index      = G_N_ELEMENTS (stream->block);
+}
+
+/**
+ * gimp_random_stream_int:
+ * @stream: a #GimpRandomStream
+ *
+ * Return value: the next random #guint32 of @stream, equally
+ *               distributed over the whole range.
+ *
+ * Since: GIMP 2.10
+ **/
+guint32
+gimp_random_stream_int (GimpRandomStream *stream)
+{
+  if (stream->index == G_N_ELEMENTS (stream->block))
+    gimp_random_stream_next_block (stream);
+
+  return stream->block[stream->index++];
+}
+
+/**
+ * gimp_random_stream_int_range:
+ * @stream: a #GimpRandomStream
+ * @begin:  lower closed bound of the interval
+ * @end:    upper open bound of the interval
+ *
+ * Return value: the next random #gint32 of @stream, equally
+ *               distributed over [@begin..@end-1], like
+ *               g_rand_int_range().
+ *
+ * Since: GIMP 2.10
+ **/
+gint32
+gimp_random_stream_int_range (GimpRandomStream *stream,
+                              gint32            begin,
+                              gint32            end)
+{
+  guint32 dist;
+  guint64 m;
+
+  g_return_val_if_fail (end > begin, begin);
+
+  dist = (guint32) end - (guint32) begin;
+  m    = (guint64) gimp_random_stream_int (stream) * dist;
+
+  /*  reject the few values that would make some results more likely
+   *  than others
+   */
+  if ((guint32) m < dist)
+    {
+      guint32 threshold = -dist % dist;
+
+      while ((guint32) m < threshold)
+        m = (guint64) gimp_random_stream_int (stream) * dist;
+    }
+
+  return begin + (gint32) (m >> 32);
+}
+
+/**
+ * gimp_random_stream_double:
+ * @stream: a #GimpRandomStream
+ *
+ * Return value: the next random #gdouble of @stream, equally
+ *               distributed over [0..1).
+ *
+ * Since: GIMP 2.10
+ **/
+gdouble
+gimp_random_stream_double (GimpRandomStream *stream)
+{
+  guint32 a = gimp_random_stream_int (stream) >> 5;
+  guint32 b = gimp_random_stream_int (stream) >> 6;
+
+  /*  53 random bits, as many as a double can hold  */
+  return (a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * gimp_random_stream_double_range:
+ * @stream: a #GimpRandomStream
+ * @begin:  lower closed bound of the interval
+ * @end:    upper open bound of the interval
+ *
+ * Return value: the next random #gdouble of @stream, equally
+ *               distributed over [@begin..@end).
+ *
+ * Since: GIMP 2.10
+ **/
+gdouble
+gimp_random_stream_double_range (GimpRandomStream *stream,
+                                 gdouble           begin,
+                                 gdouble           end)
+{
+  return begin + gimp_random_stream_double (stream) * (end - begin);
+}
+
+/**
+ * gimp_random_stream_boolean:
+ * @stream: a #GimpRandomStream
+ *
+ * Return value: the next random #gboolean of @stream.
+ *
+ * Since: GIMP 2.10
+ **/
+gboolean
+gimp_random_stream_boolean (GimpRandomStream *stream)
+{
+  return (gimp_random_stream_int (stream) & (1 << 15)) != 0;
+}
@@ -52,6 +52,9 @@ enum
 /*  #define DUMP_DB 1  */
 
 
+#define CACHE_GROUP "GimpModuleDB"
+
+
 static void         gimp_module_db_finalize            (GObject      *object);
 
 static void         gimp_module_db_module_initialize   (const GimpDatafileData *file_data,
@@ -60,6 +63,14 @@ static void         gimp_module_db_module_initialize   (const GimpDatafileData *
 static GimpModule * gimp_module_db_module_find_by_path (GimpModuleDB *db,
                                                         const char   *fullpath);
 
+static void         gimp_module_db_cache_read          (GimpModuleDB *db);
+static void         gimp_module_db_cache_write         (GimpModuleDB *db);
+static GimpModule * gimp_module_db_cache_lookup        (GimpModuleDB *db,
+                                                        const GimpDatafileData *file_data);
+static void         gimp_module_db_cache_store         (GimpModuleDB *db,
+                                                        GimpModule   *module,
+                                                        const GimpDatafileData *file_data);
+
 #ifdef DUMP_DB
 static void         gimp_module_db_dump_module         (gpointer      data,
                                                         gpointer      user_data);
@@ -127,6 +138,9 @@ gimp_module_db_init (GimpModuleDB *db)
   db->modules      = NULL;
   db->load_inhibit = NULL;
   db->verbose      = FALSE;
+  db->cache_file   = NULL;
+  db->cache        = NULL;
+  db->cache_dirty  = FALSE;
 }
 
 static void
@@ -146,6 +160,18 @@ gimp_module_db_finalize (GObject *object)
       db->load_inhibit = NULL;
     }
 
+  if (db->cache_file)
+    {
+      g_free (db->cache_file);
+      db->cache_file = NULL;
+    }
+
+  if (db->cache)
+    {
+      g_key_file_free (db->cache);
+      db->cache = NULL;
+    }
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -255,6 +281,35 @@ gimp_module_db_get_load_inhibit (GimpModuleDB *db)
   return db->load_inhibit;
 }
 
+/**
+ * gimp_module_db_set_cache_file:
+ * @db:       A #GimpModuleDB.
+ * @filename: The file to cache module information in, or %NULL.
+ *
+ * Makes @db remember the metadata and the types of every module it
+ * loads in @filename. When a module's modification time matches the
+ * cached one on the next gimp_module_db_load(), its types are
+ * registered from the cache and the module itself is only opened
+ * once one of them is actually used.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_module_db_set_cache_file (GimpModuleDB *db,
+                               const gchar  *filename)
+{
+  g_return_if_fail (GIMP_IS_MODULE_DB (db));
+
+  g_free (db->cache_file);
+  db->cache_file = g_strdup (filename);
+
+  if (db->cache)
+    {
+      g_key_file_free (db->cache);
+      db->cache = NULL;
+    }
+}
+
 /**
  * gimp_module_db_load:
  * @db:          A #GimpModuleDB.
@@ -273,10 +328,16 @@ gimp_module_db_load (GimpModuleDB *db,
   g_return_if_fail (module_path != NULL);
 
   if (g_module_supported ())
-    gimp_datafiles_read_directories (module_path,
-                                     G_FILE_TEST_EXISTS,
-                                     gimp_module_db_module_initialize,
-                                     db);
+    {
+      gimp_module_db_cache_read (db);
+
+      gimp_datafiles_read_directories (module_path,
+                                       G_FILE_TEST_EXISTS,
+                                       gimp_module_db_module_initialize,
+                                       db);
+
+      gimp_module_db_cache_write (db);
+    }
 
 #ifdef DUMP_DB
   g_list_foreach (db->modules, gimp_module_db_dump_module, NULL);
@@ -315,18 +376,22 @@ gimp_module_db_refresh (GimpModuleDB *db,
   g_list_free (kill_list);
 
   /* walk filesystem and add new things we find */
+  gimp_module_db_cache_read (db);
+
   gimp_datafiles_read_directories (module_path,
                                    G_FILE_TEST_EXISTS,
                                    gimp_module_db_module_initialize,
                                    db);
+
+  gimp_module_db_cache_write (db);
 }
 
 static void
 gimp_module_db_module_initialize (const GimpDatafileData *file_data,
                                   gpointer                user_data)
 {
-  GimpModuleDB *db = GIMP_MODULE_DB (user_data);
-  GimpModule   *module;
+  GimpModuleDB *db     = GIMP_MODULE_DB (user_data);
+  GimpModule   *module = NULL;
   gboolean      load_inhibit;
 
   if (! gimp_datafiles_check_extension (file_data->filename,
@@ -340,9 +405,17 @@ gimp_module_db_module_initialize (const GimpDatafileData *file_data,
   load_inhibit = is_in_inhibit_list (file_data->filename,
                                      db->load_inhibit);
 
-  module = gimp_module_new (file_data->filename,
-                            load_inhibit,
-                            db->verbose);
+  if (! load_inhibit)
+    module = gimp_module_db_cache_lookup (db, file_data);
+
+  if (! module)
+    {
+      module = gimp_module_new (file_data->filename,
+                                load_inhibit,
+                                db->verbose);
+
+      gimp_module_db_cache_store (db, module, file_data);
+    }
 
   g_signal_connect (module, "modified",
                     G_CALLBACK (gimp_module_db_module_modified),
@@ -369,6 +442,292 @@ gimp_module_db_module_find_by_path (GimpModuleDB *db,
   return NULL;
 }
 
+static void
+gimp_module_db_cache_read (GimpModuleDB *db)
+{
+  GError *error = NULL;
+
+  if (! db->cache_file || db->cache)
+    return;
+
+  db->cache = g_key_file_new ();
+
+  if (! g_key_file_load_from_file (db->cache, db->cache_file,
+                                   G_KEY_FILE_NONE, &error))
+    {
+      if (! g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_printerr ("Could not read module cache '%s': %s\n",
+                    gimp_filename_to_utf8 (db->cache_file), error->message);
+
+      g_clear_error (&error);
+    }
+
+  /*  forget everything if the cache was written for another ABI  */
+  if (g_key_file_get_integer (db->cache, CACHE_GROUP,
+                              "abi-version", NULL) != GIMP_MODULE_ABI_VERSION)
+    {
+      g_key_file_free (db->cache);
+
+      db->cache = g_key_file_new ();
+      g_key_file_set_integer (db->cache, CACHE_GROUP,
+                              "abi-version", GIMP_MODULE_ABI_VERSION);
+
+      db->cache_dirty = TRUE;
+    }
+}
+
+static void
+gimp_module_db_cache_write (GimpModuleDB *db)
+{
+  gchar  **groups;
+  gchar   *data;
+  gsize    length;
+  GError  *error = NULL;
+  gint     i;
+
+  if (! db->cache || ! db->cache_dirty)
+    return;
+
+  /*  drop the entries of modules that went away  */
+  groups = g_key_file_get_groups (db->cache, NULL);
+
+  for (i = 0; groups[i]; i++)
+    {
+      if (strcmp (groups[i], CACHE_GROUP) &&
+          ! gimp_module_db_module_find_by_path (db, groups[i]))
+        {
+          g_key_file_remove_group (db->cache, groups[i], NULL);
+        }
+    }
+
+  g_strfreev (groups);
+
+  data = g_key_file_to_data (db->cache, &length, NULL);
+
+  if (db->verbose)
+    g_print ("Writing '%s'\n", gimp_filename_to_utf8 (db->cache_file));
+
+  if (! g_file_set_contents (db->cache_file, data, length, &error))
+    {
+      g_printerr ("Could not write module cache '%s': %s\n",
+                  gimp_filename_to_utf8 (db->cache_file), error->message);
+      g_clear_error (&error);
+    }
+
+  g_free (data);
+
+  db->cache_dirty = FALSE;
+}
+
+/*  creates a module whose types are registered from the cache without
+ *  opening the module, GTypeModule will load it and let it register
+ *  the real type infos as soon as one of the types is used
+ */
+static GimpModule *
+gimp_module_db_cache_lookup (GimpModuleDB           *db,
+                             const GimpDatafileData *file_data)
+{
+  static const GTypeInfo  lazy_type_info = { 0, };
+
+  const gchar  *group   = file_data->filename;
+  GimpModule   *module  = NULL;
+  gchar       **types   = NULL;
+  gchar       **parents = NULL;
+  gint         *flags   = NULL;
+  gchar        *purpose;
+  gchar        *author;
+  gchar        *version;
+  gchar        *copyright;
+  gchar        *date;
+  gsize         n_types;
+  gsize         n_parents;
+  gsize         n_flags;
+  gsize         i;
+
+  if (! db->cache || ! g_key_file_has_group (db->cache, group))
+    return NULL;
+
+  if (g_key_file_get_int64 (db->cache, group, "mtime", NULL) !=
+      (gint64) file_data->mtime)
+    return NULL;
+
+  types   = g_key_file_get_string_list  (db->cache, group, "types",
+                                         &n_types, NULL);
+  parents = g_key_file_get_string_list  (db->cache, group, "parents",
+                                         &n_parents, NULL);
+  flags   = g_key_file_get_integer_list (db->cache, group, "flags",
+                                         &n_flags, NULL);
+
+  if (! types || ! parents || ! flags ||
+      n_parents != n_types || n_flags != n_types)
+    goto out;
+
+  /*  only use the entry if all its types can be registered, parents
+   *  are either known already or come earlier in the list
+   */
+  for (i = 0; i < n_types; i++)
+    {
+      gsize j;
+
+      if (g_type_from_name (types[i]))
+        goto out;
+
+      if (! g_type_from_name (parents[i]))
+        {
+          for (j = 0; j < i; j++)
+            if (! strcmp (parents[i], types[j]))
+              break;
+
+          if (j == i)
+            goto out;
+        }
+    }
+
+  if (db->verbose)
+    g_print ("Registering module '%s' from cache\n",
+             gimp_filename_to_utf8 (file_data->filename));
+
+  module = g_object_new (GIMP_TYPE_MODULE, NULL);
+
+  module->filename = g_strdup (file_data->filename);
+  module->verbose  = db->verbose;
+  module->on_disk  = TRUE;
+  module->state    = GIMP_MODULE_STATE_NOT_LOADED;
+
+  purpose   = g_key_file_get_string (db->cache, group, "purpose",   NULL);
+  author    = g_key_file_get_string (db->cache, group, "author",    NULL);
+  version   = g_key_file_get_string (db->cache, group, "version",   NULL);
+  copyright = g_key_file_get_string (db->cache, group, "copyright", NULL);
+  date      = g_key_file_get_string (db->cache, group, "date",      NULL);
+
+  module->info = gimp_module_info_new (GIMP_MODULE_ABI_VERSION,
+                                       purpose, author, version,
+                                       copyright, date);
+
+  g_free (purpose);
+  g_free (author);
+  g_free (version);
+  g_free (copyright);
+  g_free (date);
+
+  for (i = 0; i < n_types; i++)
+    g_type_module_register_type (G_TYPE_MODULE (module),
+                                 g_type_from_name (parents[i]),
+                                 types[i],
+                                 &lazy_type_info,
+                                 flags[i]);
+
+ out:
+  g_strfreev (types);
+  g_strfreev (parents);
+  g_free (flags);
+
+  return module;
+}
+
+static void
+gimp_module_db_collect_types (GType        type,
+                              GTypePlugin *plugin,
+                              GArray      *types)
+{
+  GType *children;
+  guint  n_children;
+  guint  i;
+
+  if (g_type_get_plugin (type) == plugin)
+    g_array_append_val (types, type);
+
+  children = g_type_children (type, &n_children);
+
+  for (i = 0; i < n_children; i++)
+    gimp_module_db_collect_types (children[i], plugin, types);
+
+  g_free (children);
+}
+
+static void
+gimp_module_db_cache_store (GimpModuleDB           *db,
+                            GimpModule             *module,
+                            const GimpDatafileData *file_data)
+{
+  const GType   roots[] = { G_TYPE_INTERFACE, G_TYPE_OBJECT,
+                            G_TYPE_ENUM, G_TYPE_FLAGS };
+  const gchar  *group   = file_data->filename;
+  GArray       *types;
+  const gchar **names;
+  const gchar **parents;
+  gint         *flags;
+  guint         i;
+
+  if (! db->cache)
+    return;
+
+  if (g_key_file_has_group (db->cache, group))
+    {
+      g_key_file_remove_group (db->cache, group, NULL);
+      db->cache_dirty = TRUE;
+    }
+
+  /*  only cache modules which registered successfully  */
+  if (module->load_inhibit                         ||
+      module->state != GIMP_MODULE_STATE_NOT_LOADED ||
+      ! module->info)
+    return;
+
+  types = g_array_new (FALSE, FALSE, sizeof (GType));
+
+  for (i = 0; i < G_N_ELEMENTS (roots); i++)
+    gimp_module_db_collect_types (roots[i], G_TYPE_PLUGIN (module), types);
+
+  names   = g_new (const gchar *, types->len);
+  parents = g_new (const gchar *, types->len);
+  flags   = g_new (gint, types->len);
+
+  for (i = 0; i < types->len; i++)
+    {
+      GType type = g_array_index (types, GType, i);
+
+      names[i]   = g_type_name (type);
+      parents[i] = g_type_name (g_type_parent (type));
+      flags[i]   = ((G_TYPE_IS_ABSTRACT (type) ?
+                     G_TYPE_FLAG_ABSTRACT : 0) |
+                    (G_TYPE_IS_VALUE_ABSTRACT (type) ?
+                     G_TYPE_FLAG_VALUE_ABSTRACT : 0));
+    }
+
+  g_key_file_set_int64 (db->cache, group, "mtime", file_data->mtime);
+
+  if (module->info->purpose)
+    g_key_file_set_string (db->cache, group,
+                           "purpose", module->info->purpose);
+  if (module->info->author)
+    g_key_file_set_string (db->cache, group,
+                           "author", module->info->author);
+  if (module->info->version)
+    g_key_file_set_string (db->cache, group,
+                           "version", module->info->version);
+  if (module->info->copyright)
+    g_key_file_set_string (db->cache, group,
+                           "copyright", module->info->copyright);
+  if (module->info->date)
+    g_key_file_set_string (db->cache, group,
+                           "date", module->info->date);
+
+  g_key_file_set_string_list  (db->cache, group, "types",
+                               names, types->len);
+  g_key_file_set_string_list  (db->cache, group, "parents",
+                               parents, types->len);
+  g_key_file_set_integer_list (db->cache, group, "flags",
+                               flags, types->len);
+
+  g_free (names);
+  g_free (parents);
+  g_free (flags);
+  g_array_free (types, TRUE);
+
+  db->cache_dirty = TRUE;
+}
+
 #ifdef DUMP_DB
 static void
 gimp_module_db_dump_module (gpointer data,
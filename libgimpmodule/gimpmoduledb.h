@@ -45,6 +45,10 @@ struct _GimpModuleDB
 
   gchar    *load_inhibit;
   gboolean  verbose;
+
+  gchar    *cache_file;
+  GKeyFile *cache;
+  gboolean  cache_dirty;
 };
 
 struct _GimpModuleDBClass
@@ -73,6 +77,9 @@ void           gimp_module_db_set_load_inhibit (GimpModuleDB *db,
                                                 const gchar  *load_inhibit);
 const gchar  * gimp_module_db_get_load_inhibit (GimpModuleDB *db);
 
+void           gimp_module_db_set_cache_file   (GimpModuleDB *db,
+                                                const gchar  *filename);
+
 void           gimp_module_db_load             (GimpModuleDB *db,
                                                 const gchar  *module_path);
 void           gimp_module_db_refresh          (GimpModuleDB *db,
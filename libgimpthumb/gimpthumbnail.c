@@ -83,6 +83,12 @@
 #define TAG_THUMB_GIMP_TYPE       "tEXt::Thumb::X-GIMP::Type"
 #define TAG_THUMB_GIMP_LAYERS     "tEXt::Thumb::X-GIMP::Layers"
 
+/*  the most thumbnail headers kept in memory  */
+#define MAX_CACHED_HEADERS        4096
+
+/*  bigger text chunks are not thumbnail keys  */
+#define MAX_TEXT_CHUNK_SIZE       65536
+
 
 enum
 {
@@ -100,6 +106,21 @@ enum
 };
 
 
+/*  the text keys of a thumbnail file, as GdkPixbuf options, and what
+ *  is needed to tell if the file changed since they were read
+ */
+typedef struct
+{
+  guint64     inode;
+  gint64      mtime;
+  gint64      filesize;
+  GHashTable *options;
+} GimpThumbHeader;
+
+typedef const gchar * (* GimpThumbOptionFunc) (gpointer     data,
+                                               const gchar *key);
+
+
 static void      gimp_thumbnail_finalize     (GObject        *object);
 static void      gimp_thumbnail_set_property (GObject        *object,
                                               guint           property_id,
@@ -110,6 +131,14 @@ static void      gimp_thumbnail_get_property (GObject        *object,
                                               GValue         *value,
                                               GParamSpec     *pspec);
 static void      gimp_thumbnail_reset_info   (GimpThumbnail  *thumbnail);
+static void      gimp_thumbnail_set_info     (GimpThumbnail       *thumbnail,
+                                              GimpThumbOptionFunc  get_option,
+                                              gpointer             data);
+static GimpThumbState
+                 gimp_thumbnail_validate     (GimpThumbnail       *thumbnail,
+                                              GimpThumbOptionFunc  get_option,
+                                              gpointer             data);
+static GHashTable * gimp_thumbnail_read_header (const gchar       *filename);
 
 static void      gimp_thumbnail_update_image (GimpThumbnail  *thumbnail);
 static void      gimp_thumbnail_update_thumb (GimpThumbnail  *thumbnail,
@@ -132,6 +161,11 @@ G_DEFINE_TYPE (GimpThumbnail, gimp_thumbnail, G_TYPE_OBJECT)
 #define parent_class gimp_thumbnail_parent_class
 
 
+/*  thumbnail filename -> GimpThumbHeader  */
+static GHashTable *header_cache = NULL;
+G_LOCK_DEFINE_STATIC (header_cache);
+
+
 static void
 gimp_thumbnail_class_init (GimpThumbnailClass *klass)
 {
@@ -594,23 +628,81 @@ GimpThumbState
 gimp_thumbnail_check_thumb (GimpThumbnail *thumbnail,
                             GimpThumbSize  size)
 {
-  GdkPixbuf *pixbuf;
+  GimpThumbState  state;
+  GHashTable     *options;
 
   g_return_val_if_fail (GIMP_IS_THUMBNAIL (thumbnail), FALSE);
 
   GIMP_THUMB_DEBUG_CALL (thumbnail);
 
-  if (gimp_thumbnail_peek_thumb (thumbnail, size) == GIMP_THUMB_STATE_OK)
+  state = gimp_thumbnail_peek_thumb (thumbnail, size);
+
+  if (state == GIMP_THUMB_STATE_OK)
     return GIMP_THUMB_STATE_OK;
 
-  pixbuf = gimp_thumbnail_load_thumb (thumbnail, size, NULL);
+  if (state < GIMP_THUMB_STATE_EXISTS || state == GIMP_THUMB_STATE_FAILED)
+    return state;
 
-  if (pixbuf)
-    g_object_unref (pixbuf);
+  /*  the keys are usually in front of the image data, only fall
+   *  back to loading the whole thumbnail if they aren't
+   */
+  options = gimp_thumbnail_read_header (thumbnail->thumb_filename);
+
+  if (options)
+    {
+      g_object_freeze_notify (G_OBJECT (thumbnail));
+
+      gimp_thumbnail_validate (thumbnail,
+                               (GimpThumbOptionFunc) g_hash_table_lookup,
+                               options);
+
+      g_object_thaw_notify (G_OBJECT (thumbnail));
+
+      g_hash_table_unref (options);
+    }
+  else
+    {
+      GdkPixbuf *pixbuf = gimp_thumbnail_load_thumb (thumbnail, size, NULL);
+
+      if (pixbuf)
+        g_object_unref (pixbuf);
+    }
 
   return thumbnail->thumb_state;
 }
 
+/**
+ * gimp_thumbnail_check_thumbs:
+ * @thumbnails: an array of #GimpThumbnail objects
+ * @n_thumbnails: the number of objects in @thumbnails
+ * @size: the preferred size of the thumbnail images
+ *
+ * Does what gimp_thumbnail_check_thumb() does for each of the
+ * @thumbnails. Only the text keys at the start of the thumbnail
+ * files are read, and they are kept in memory until the files
+ * change, so this is cheap enough to validate long lists of
+ * thumbnails, like the document history. Use
+ * gimp_thumbnail_load_thumb() for the ones that are actually shown.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_thumbnail_check_thumbs (GimpThumbnail **thumbnails,
+                             gint            n_thumbnails,
+                             GimpThumbSize   size)
+{
+  gint i;
+
+  g_return_if_fail (thumbnails != NULL || n_thumbnails == 0);
+
+  for (i = 0; i < n_thumbnails; i++)
+    {
+      g_return_if_fail (GIMP_IS_THUMBNAIL (thumbnails[i]));
+
+      gimp_thumbnail_check_thumb (thumbnails[i], size);
+    }
+}
+
 static void
 gimp_thumbnail_update_image (GimpThumbnail *thumbnail)
 {
@@ -769,8 +861,9 @@ gimp_thumbnail_reset_info (GimpThumbnail *thumbnail)
 }
 
 static void
-gimp_thumbnail_set_info_from_pixbuf (GimpThumbnail *thumbnail,
-                                     GdkPixbuf     *pixbuf)
+gimp_thumbnail_set_info (GimpThumbnail       *thumbnail,
+                         GimpThumbOptionFunc  get_option,
+                         gpointer             data)
 {
   const gchar  *option;
   gint          num;
@@ -781,26 +874,295 @@ gimp_thumbnail_set_info_from_pixbuf (GimpThumbnail *thumbnail,
 
   g_free (thumbnail->image_mimetype);
   thumbnail->image_mimetype =
-    g_strdup (gdk_pixbuf_get_option (pixbuf, TAG_THUMB_MIMETYPE));
+    g_strdup (get_option (data, TAG_THUMB_MIMETYPE));
 
-  option = gdk_pixbuf_get_option (pixbuf, TAG_THUMB_IMAGE_WIDTH);
+  option = get_option (data, TAG_THUMB_IMAGE_WIDTH);
   if (option && sscanf (option, "%d", &num) == 1)
     thumbnail->image_width = num;
 
-  option = gdk_pixbuf_get_option (pixbuf, TAG_THUMB_IMAGE_HEIGHT);
+  option = get_option (data, TAG_THUMB_IMAGE_HEIGHT);
   if (option && sscanf (option, "%d", &num) == 1)
     thumbnail->image_height = num;
 
   thumbnail->image_type =
-    g_strdup (gdk_pixbuf_get_option (pixbuf, TAG_THUMB_GIMP_TYPE));
+    g_strdup (get_option (data, TAG_THUMB_GIMP_TYPE));
 
-  option = gdk_pixbuf_get_option (pixbuf, TAG_THUMB_GIMP_LAYERS);
+  option = get_option (data, TAG_THUMB_GIMP_LAYERS);
   if (option && sscanf (option, "%d", &num) == 1)
     thumbnail->image_num_layers = num;
 
   g_object_thaw_notify (G_OBJECT (thumbnail));
 }
 
+/*  Checks the thumbnail's keys against the image file, sets the
+ *  thumb-state and returns it
+ */
+static GimpThumbState
+gimp_thumbnail_validate (GimpThumbnail       *thumbnail,
+                         GimpThumbOptionFunc  get_option,
+                         gpointer             data)
+{
+  GimpThumbState  state = thumbnail->thumb_state;
+  const gchar    *option;
+  gint64          image_mtime;
+  gint64          image_size;
+
+  /* URI and mtime from the thumbnail need to match our file */
+  option = get_option (data, TAG_THUMB_URI);
+  if (!option)
+    goto finish;
+
+  if (strcmp (option, thumbnail->image_uri))
+    {
+      /*  might be a local thumbnail, try if the local part matches  */
+      const gchar *baseuri = strrchr (thumbnail->image_uri, '/');
+
+      if (!baseuri || strcmp (option, baseuri))
+        goto finish;
+    }
+
+  state = GIMP_THUMB_STATE_OLD;
+
+  option = get_option (data, TAG_THUMB_MTIME);
+  if (!option || sscanf (option, "%" G_GINT64_FORMAT, &image_mtime) != 1)
+    goto finish;
+
+  option = get_option (data, TAG_THUMB_FILESIZE);
+  if (option && sscanf (option, "%" G_GINT64_FORMAT, &image_size) != 1)
+    goto finish;
+
+  /* TAG_THUMB_FILESIZE is optional but must match if present */
+  if (image_mtime == thumbnail->image_mtime &&
+      (option == NULL || image_size == thumbnail->image_filesize))
+    {
+      if (thumbnail->thumb_size == GIMP_THUMB_SIZE_FAIL)
+        state = GIMP_THUMB_STATE_FAILED;
+      else
+        state = GIMP_THUMB_STATE_OK;
+    }
+
+  if (state == GIMP_THUMB_STATE_FAILED)
+    gimp_thumbnail_reset_info (thumbnail);
+  else
+    gimp_thumbnail_set_info (thumbnail, get_option, data);
+
+ finish:
+  g_object_set (thumbnail,
+                "thumb-state", state,
+                NULL);
+
+  return state;
+}
+
+static guint32
+gimp_thumb_read_uint32 (const guchar *buf)
+{
+  return ((guint32) buf[0] << 24 | (guint32) buf[1] << 16 |
+          (guint32) buf[2] << 8  | (guint32) buf[3]);
+}
+
+static gchar *
+gimp_thumb_text_chunk_value (const gchar *text,
+                             gsize        len,
+                             gboolean     latin1)
+{
+  if (latin1)
+    return g_convert (text, len, "UTF-8", "ISO-8859-1", NULL, NULL, NULL);
+
+  if (! g_utf8_validate (text, len, NULL))
+    return NULL;
+
+  return g_strndup (text, len);
+}
+
+/*  Reads the text chunks in front of the image data of a PNG file,
+ *  and returns them with the keys GdkPixbuf would use for its
+ *  options. Returns NULL if a compressed text chunk is in the way or
+ *  there is no Thumb::URI, the caller needs to load the file with
+ *  GdkPixbuf then.
+ */
+static GHashTable *
+gimp_thumbnail_parse_header (const gchar *filename)
+{
+  static const guchar  signature[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+  GHashTable          *options;
+  FILE                *fp;
+  guchar               buf[8];
+
+  fp = g_fopen (filename, "rb");
+  if (! fp)
+    return NULL;
+
+  if (fread (buf, 1, 8, fp) != 8 || memcmp (buf, signature, 8))
+    {
+      fclose (fp);
+      return NULL;
+    }
+
+  options = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  while (fread (buf, 1, 8, fp) == 8)
+    {
+      guint32  length = gimp_thumb_read_uint32 (buf);
+      gboolean text   = ! memcmp (buf + 4, "tEXt", 4);
+      gboolean itext  = ! memcmp (buf + 4, "iTXt", 4);
+      gchar   *chunk;
+      gchar   *key_end;
+      gchar   *value = NULL;
+
+      if (! memcmp (buf + 4, "IDAT", 4) || ! memcmp (buf + 4, "IEND", 4))
+        break;
+
+      if (! memcmp (buf + 4, "zTXt", 4))
+        goto fail;
+
+      if ((! text && ! itext) || length > MAX_TEXT_CHUNK_SIZE)
+        {
+          /*  skip the chunk and its CRC  */
+          if (fseek (fp, (glong) length + 4, SEEK_CUR) != 0)
+            goto fail;
+
+          continue;
+        }
+
+      chunk = g_malloc (length + 1);
+
+      if (fread (chunk, 1, length, fp) != length ||
+          fseek (fp, 4, SEEK_CUR) != 0)
+        {
+          g_free (chunk);
+          goto fail;
+        }
+
+      chunk[length] = '\0';
+
+      key_end = memchr (chunk, '\0', length);
+
+      if (key_end && text)
+        {
+          value = gimp_thumb_text_chunk_value (key_end + 1,
+                                               length - (key_end + 1 - chunk),
+                                               TRUE);
+        }
+      else if (key_end && itext)
+        {
+          /*  compression flag and method, language tag, translated key  */
+          gchar *p   = key_end + 1;
+          gchar *end = chunk + length;
+
+          if (end - p < 2)
+            goto next;
+
+          if (p[0] != 0)
+            {
+              g_free (chunk);
+              goto fail;
+            }
+
+          p += 2;
+
+          if (! (p = memchr (p, '\0', end - p)) ||
+              ! (p = memchr (p + 1, '\0', end - (p + 1))))
+            goto next;
+
+          p++;
+
+          value = gimp_thumb_text_chunk_value (p, end - p, FALSE);
+        }
+
+      if (value)
+        g_hash_table_insert (options,
+                             g_strconcat ("tEXt::", chunk, NULL), value);
+
+    next:
+      g_free (chunk);
+    }
+
+  /*  some writers put the keys behind the image data  */
+  if (! g_hash_table_lookup (options, TAG_THUMB_URI))
+    goto fail;
+
+  fclose (fp);
+
+  return options;
+
+ fail:
+  fclose (fp);
+  g_hash_table_unref (options);
+
+  return NULL;
+}
+
+static void
+gimp_thumb_header_free (GimpThumbHeader *header)
+{
+  g_hash_table_unref (header->options);
+
+  g_slice_free (GimpThumbHeader, header);
+}
+
+/*  Returns a reference to the text keys of the thumbnail file, from
+ *  the cache if the file didn't change since they were read
+ */
+static GHashTable *
+gimp_thumbnail_read_header (const gchar *filename)
+{
+  GimpThumbHeader *header;
+  GHashTable      *options = NULL;
+  struct stat      s;
+
+  if (g_stat (filename, &s) != 0)
+    return NULL;
+
+  G_LOCK (header_cache);
+
+  if (header_cache)
+    {
+      header = g_hash_table_lookup (header_cache, filename);
+
+      if (header                         &&
+          header->inode    == s.st_ino   &&
+          header->mtime    == s.st_mtime &&
+          header->filesize == s.st_size)
+        {
+          options = g_hash_table_ref (header->options);
+        }
+    }
+
+  G_UNLOCK (header_cache);
+
+  if (options)
+    return options;
+
+  options = gimp_thumbnail_parse_header (filename);
+
+  if (! options)
+    return NULL;
+
+  header = g_slice_new (GimpThumbHeader);
+
+  header->inode    = s.st_ino;
+  header->mtime    = s.st_mtime;
+  header->filesize = s.st_size;
+  header->options  = g_hash_table_ref (options);
+
+  G_LOCK (header_cache);
+
+  if (! header_cache)
+    header_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free,
+                                          (GDestroyNotify) gimp_thumb_header_free);
+
+  if (g_hash_table_size (header_cache) >= MAX_CACHED_HEADERS)
+    g_hash_table_remove_all (header_cache);
+
+  g_hash_table_insert (header_cache, g_strdup (filename), header);
+
+  G_UNLOCK (header_cache);
+
+  return options;
+}
+
 static gboolean
 gimp_thumbnail_save (GimpThumbnail  *thumbnail,
                      GimpThumbSize   size,
@@ -1006,9 +1368,6 @@ gimp_thumbnail_load_thumb (GimpThumbnail  *thumbnail,
 {
   GimpThumbState  state;
   GdkPixbuf      *pixbuf;
-  const gchar    *option;
-  gint64          image_mtime;
-  gint64          image_size;
 
   g_return_val_if_fail (GIMP_IS_THUMBNAIL (thumbnail), NULL);
 
@@ -1032,46 +1391,10 @@ gimp_thumbnail_load_thumb (GimpThumbnail  *thumbnail,
 
   g_object_freeze_notify (G_OBJECT (thumbnail));
 
-  /* URI and mtime from the thumbnail need to match our file */
-  option = gdk_pixbuf_get_option (pixbuf, TAG_THUMB_URI);
-  if (!option)
-    goto finish;
+  state = gimp_thumbnail_validate (thumbnail,
+                                   (GimpThumbOptionFunc) gdk_pixbuf_get_option,
+                                   pixbuf);
 
-  if (strcmp (option, thumbnail->image_uri))
-    {
-      /*  might be a local thumbnail, try if the local part matches  */
-      const gchar *baseuri = strrchr (thumbnail->image_uri, '/');
-
-      if (!baseuri || strcmp (option, baseuri))
-        goto finish;
-    }
-
-  state = GIMP_THUMB_STATE_OLD;
-
-  option = gdk_pixbuf_get_option (pixbuf, TAG_THUMB_MTIME);
-  if (!option || sscanf (option, "%" G_GINT64_FORMAT, &image_mtime) != 1)
-    goto finish;
-
-  option = gdk_pixbuf_get_option (pixbuf, TAG_THUMB_FILESIZE);
-  if (option && sscanf (option, "%" G_GINT64_FORMAT, &image_size) != 1)
-    goto finish;
-
-  /* TAG_THUMB_FILESIZE is optional but must match if present */
-  if (image_mtime == thumbnail->image_mtime &&
-      (option == NULL || image_size == thumbnail->image_filesize))
-    {
-      if (thumbnail->thumb_size == GIMP_THUMB_SIZE_FAIL)
-        state = GIMP_THUMB_STATE_FAILED;
-      else
-        state = GIMP_THUMB_STATE_OK;
-    }
-
-  if (state == GIMP_THUMB_STATE_FAILED)
-    gimp_thumbnail_reset_info (thumbnail);
-  else
-    gimp_thumbnail_set_info_from_pixbuf (thumbnail, pixbuf);
-
- finish:
   if (thumbnail->thumb_size == GIMP_THUMB_SIZE_FAIL ||
       (state != GIMP_THUMB_STATE_OLD && state != GIMP_THUMB_STATE_OK))
     {
@@ -1079,10 +1402,6 @@ gimp_thumbnail_load_thumb (GimpThumbnail  *thumbnail,
       pixbuf = NULL;
     }
 
-  g_object_set (thumbnail,
-                "thumb-state", state,
-                NULL);
-
   g_object_thaw_notify (G_OBJECT (thumbnail));
 
   return pixbuf;
@@ -1375,12 +1694,15 @@ gimp_thumbnail_delete_others (GimpThumbnail *thumbnail,
 gboolean
 gimp_thumbnail_has_failed (GimpThumbnail *thumbnail)
 {
-  GdkPixbuf   *pixbuf;
-  const gchar *option;
-  gchar       *filename;
-  gint64       image_mtime;
-  gint64       image_size;
-  gboolean     failed = FALSE;
+  GimpThumbOptionFunc  get_option;
+  gpointer             data;
+  GHashTable          *options;
+  GdkPixbuf           *pixbuf = NULL;
+  const gchar         *option;
+  gchar               *filename;
+  gint64               image_mtime;
+  gint64               image_size;
+  gboolean             failed = FALSE;
 
   g_return_val_if_fail (GIMP_IS_THUMBNAIL (thumbnail), FALSE);
   g_return_val_if_fail (thumbnail->image_uri != NULL, FALSE);
@@ -1392,25 +1714,39 @@ gimp_thumbnail_has_failed (GimpThumbnail *thumbnail)
   if (! filename)
     return FALSE;
 
-  pixbuf = gdk_pixbuf_new_from_file (filename, NULL);
+  options = gimp_thumbnail_read_header (filename);
+
+  if (options)
+    {
+      get_option = (GimpThumbOptionFunc) g_hash_table_lookup;
+      data       = options;
+    }
+  else
+    {
+      pixbuf = gdk_pixbuf_new_from_file (filename, NULL);
+
+      get_option = (GimpThumbOptionFunc) gdk_pixbuf_get_option;
+      data       = pixbuf;
+    }
+
   g_free (filename);
 
-  if (! pixbuf)
+  if (! data)
     return FALSE;
 
   if (gimp_thumbnail_peek_image (thumbnail) < GIMP_THUMB_STATE_EXISTS)
     goto finish;
 
   /* URI and mtime from the thumbnail need to match our file */
-  option = gdk_pixbuf_get_option (pixbuf, TAG_THUMB_URI);
+  option = get_option (data, TAG_THUMB_URI);
   if (! option || strcmp (option, thumbnail->image_uri))
     goto finish;
 
-  option = gdk_pixbuf_get_option (pixbuf, TAG_THUMB_MTIME);
+  option = get_option (data, TAG_THUMB_MTIME);
   if (!option || sscanf (option, "%" G_GINT64_FORMAT, &image_mtime) != 1)
     goto finish;
 
-  option = gdk_pixbuf_get_option (pixbuf, TAG_THUMB_FILESIZE);
+  option = get_option (data, TAG_THUMB_FILESIZE);
   if (option && sscanf (option, "%" G_GINT64_FORMAT, &image_size) != 1)
     goto finish;
 
@@ -1422,7 +1758,11 @@ gimp_thumbnail_has_failed (GimpThumbnail *thumbnail)
     }
 
  finish:
-  g_object_unref (pixbuf);
+  if (options)
+    g_hash_table_unref (options);
+
+  if (pixbuf)
+    g_object_unref (pixbuf);
 
   return failed;
 }
@@ -106,6 +106,9 @@ GimpThumbState   gimp_thumbnail_peek_thumb       (GimpThumbnail  *thumbnail,
 
 GimpThumbState   gimp_thumbnail_check_thumb      (GimpThumbnail  *thumbnail,
                                                   GimpThumbSize   size);
+void             gimp_thumbnail_check_thumbs     (GimpThumbnail **thumbnails,
+                                                  gint            n_thumbnails,
+                                                  GimpThumbSize   size);
 
 GdkPixbuf      * gimp_thumbnail_load_thumb       (GimpThumbnail  *thumbnail,
                                                   GimpThumbSize   size,
@@ -22,6 +22,7 @@
 
 #include <gtk/gtk.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
 
 #include "gimpwidgets.h"
@@ -58,11 +59,32 @@ enum
   PROP_UPDATE
 };
 
+typedef struct _GimpPreviewRenderJob GimpPreviewRenderJob;
+
 typedef struct
 {
-  GtkWidget *controls;
+  GtkWidget            *controls;
+
+  GimpPreviewRenderJob *render_job;
+  gboolean              render_async;
 } GimpPreviewPrivate;
 
+struct _GimpPreviewRenderJob
+{
+  GimpPreview           *preview;
+  GCancellable          *cancellable;
+
+  guchar                *src;
+  guchar                *dest;
+  gint                   width;
+  gint                   height;
+  gint                   bpp;
+
+  GimpPreviewRenderFunc  func;
+  gpointer               user_data;
+  GDestroyNotify         destroy;
+};
+
 #define GIMP_PREVIEW_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GIMP_TYPE_PREVIEW, GimpPreviewPrivate))
 
 
@@ -112,11 +134,18 @@ static void      gimp_preview_real_untransform    (GimpPreview      *preview,
                                                    gint             *dest_x,
                                                    gint             *dest_y);
 
+static void      gimp_preview_render_thread       (GimpPreviewRenderJob *job,
+                                                   gpointer              data);
+static gboolean  gimp_preview_render_done         (GimpPreviewRenderJob *job);
+static void      gimp_preview_render_job_free     (GimpPreviewRenderJob *job);
+
 
 static guint preview_signals[LAST_SIGNAL] = { 0 };
 
 static GtkBoxClass *parent_class = NULL;
 
+static GThreadPool *render_pool  = NULL;
+
 
 GType
 gimp_preview_get_type (void)
@@ -309,6 +338,8 @@ gimp_preview_dispose (GObject *object)
       preview->timeout_id = 0;
     }
 
+  gimp_preview_cancel_render (preview);
+
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
@@ -484,7 +515,11 @@ gimp_preview_invalidate_now (GimpPreview *preview)
   GtkWidget        *toplevel = gtk_widget_get_toplevel (GTK_WIDGET (preview));
   GimpPreviewClass *class    = GIMP_PREVIEW_GET_CLASS (preview);
 
-  gimp_preview_draw (preview);
+  /*  keep showing the last rendered result while the next one is
+   *  computed asynchronously, instead of flashing the original
+   */
+  if (! GIMP_PREVIEW_GET_PRIVATE (preview)->render_async)
+    gimp_preview_draw (preview);
 
   preview->timeout_id = 0;
 
@@ -499,7 +534,10 @@ gimp_preview_invalidate_now (GimpPreview *preview)
 
       g_signal_emit (preview, preview_signals[INVALIDATED], 0);
 
-      class->set_cursor (preview);
+      /*  an asynchronous render resets the cursor when it is done  */
+      if (! GIMP_PREVIEW_GET_PRIVATE (preview)->render_job)
+        class->set_cursor (preview);
+
       gdk_window_set_cursor (gtk_widget_get_window (toplevel), NULL);
     }
   else
@@ -510,6 +548,55 @@ gimp_preview_invalidate_now (GimpPreview *preview)
   return FALSE;
 }
 
+static void
+gimp_preview_render_thread (GimpPreviewRenderJob *job,
+                            gpointer              data)
+{
+  if (! g_cancellable_is_cancelled (job->cancellable))
+    job->func (job->src, job->dest,
+               job->width, job->height, job->bpp,
+               job->cancellable, job->user_data);
+
+  g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                   (GSourceFunc) gimp_preview_render_done,
+                   job,
+                   (GDestroyNotify) gimp_preview_render_job_free);
+}
+
+static gboolean
+gimp_preview_render_done (GimpPreviewRenderJob *job)
+{
+  GimpPreview        *preview = job->preview;
+  GimpPreviewPrivate *priv    = GIMP_PREVIEW_GET_PRIVATE (preview);
+
+  if (priv->render_job != job)
+    return FALSE;
+
+  priv->render_job = NULL;
+
+  if (! g_cancellable_is_cancelled (job->cancellable))
+    gimp_preview_draw_buffer (preview, job->dest, job->width * job->bpp);
+
+  GIMP_PREVIEW_GET_CLASS (preview)->set_cursor (preview);
+
+  return FALSE;
+}
+
+static void
+gimp_preview_render_job_free (GimpPreviewRenderJob *job)
+{
+  if (job->destroy)
+    job->destroy (job->user_data);
+
+  g_object_unref (job->cancellable);
+  g_object_unref (job->preview);
+
+  g_free (job->src);
+  g_free (job->dest);
+
+  g_slice_free (GimpPreviewRenderJob, job);
+}
+
 static void
 gimp_preview_real_set_cursor (GimpPreview *preview)
 {
@@ -797,6 +884,9 @@ gimp_preview_invalidate (GimpPreview *preview)
 
   if (preview->update_preview)
     {
+      /*  whatever is being rendered is out of date now  */
+      gimp_preview_cancel_render (preview);
+
       if (preview->timeout_id)
         g_source_remove (preview->timeout_id);
 
@@ -807,6 +897,111 @@ gimp_preview_invalidate (GimpPreview *preview)
     }
 }
 
+/**
+ * gimp_preview_render_async:
+ * @preview:   a #GimpPreview widget
+ * @src:       the source pixels, the size of the preview
+ * @width:     the width of @src
+ * @height:    the height of @src
+ * @bpp:       the number of bytes per pixel of @src
+ * @func:      the function rendering the preview
+ * @user_data: data to pass to @func
+ * @destroy:   function to free @user_data, or %NULL
+ *
+ * Runs @func on a worker thread to render a preview from a copy of
+ * @src, and draws the result using gimp_preview_draw_buffer() once
+ * it is done. Until then, the last result stays on display.
+ *
+ * A render still running is canceled when a new one is started, and
+ * when the @preview is invalidated. @func should check its
+ * #GCancellable regularly and return early when it is cancelled; its
+ * result is thrown away then.
+ *
+ * @func must not call any libgimp functions talking to the core,
+ * they can only be used from the main thread. Fetch the pixels you
+ * need before calling this function. Similarly, @user_data is read
+ * while the dialog stays responsive, so you should pass a copy of
+ * your parameters and a @destroy function to free it.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_preview_render_async (GimpPreview           *preview,
+                           const guchar          *src,
+                           gint                   width,
+                           gint                   height,
+                           gint                   bpp,
+                           GimpPreviewRenderFunc  func,
+                           gpointer               user_data,
+                           GDestroyNotify         destroy)
+{
+  GimpPreviewPrivate   *priv;
+  GimpPreviewRenderJob *job;
+
+  g_return_if_fail (GIMP_IS_PREVIEW (preview));
+  g_return_if_fail (src != NULL);
+  g_return_if_fail (width > 0 && height > 0 && bpp > 0);
+  g_return_if_fail (func != NULL);
+
+  priv = GIMP_PREVIEW_GET_PRIVATE (preview);
+
+  gimp_preview_cancel_render (preview);
+
+  if (! render_pool)
+    render_pool = g_thread_pool_new ((GFunc) gimp_preview_render_thread,
+                                     NULL, gimp_get_number_of_processors (),
+                                     FALSE, NULL);
+
+  job = g_slice_new0 (GimpPreviewRenderJob);
+
+  job->preview     = g_object_ref (preview);
+  job->cancellable = g_cancellable_new ();
+  job->src         = g_memdup (src, width * height * bpp);
+  job->dest        = g_new (guchar, width * height * bpp);
+  job->width       = width;
+  job->height      = height;
+  job->bpp         = bpp;
+  job->func        = func;
+  job->user_data   = user_data;
+  job->destroy     = destroy;
+
+  priv->render_job   = job;
+  priv->render_async = TRUE;
+
+  /*  only the area gets a busy cursor, the dialog stays usable  */
+  if (gtk_widget_get_realized (preview->area))
+    gdk_window_set_cursor (gtk_widget_get_window (preview->area),
+                           preview->cursor_busy);
+
+  g_thread_pool_push (render_pool, job, NULL);
+}
+
+/**
+ * gimp_preview_cancel_render:
+ * @preview: a #GimpPreview widget
+ *
+ * Cancels the render started with gimp_preview_render_async(), if it
+ * hasn't finished yet. The last result stays on display.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_preview_cancel_render (GimpPreview *preview)
+{
+  GimpPreviewPrivate *priv;
+
+  g_return_if_fail (GIMP_IS_PREVIEW (preview));
+
+  priv = GIMP_PREVIEW_GET_PRIVATE (preview);
+
+  if (priv->render_job)
+    {
+      /*  the job frees itself once the worker has noticed  */
+      g_cancellable_cancel (priv->render_job->cancellable);
+      priv->render_job = NULL;
+    }
+}
+
 /**
  * gimp_preview_set_default_cursor:
  * @preview: a #GimpPreview widget
@@ -41,6 +41,14 @@ G_BEGIN_DECLS
 
 typedef struct _GimpPreviewClass  GimpPreviewClass;
 
+typedef void (* GimpPreviewRenderFunc) (const guchar *src,
+                                        guchar       *dest,
+                                        gint          width,
+                                        gint          height,
+                                        gint          bpp,
+                                        GCancellable *cancellable,
+                                        gpointer      user_data);
+
 struct _GimpPreview
 {
   GtkBox        parent_instance;
@@ -138,6 +146,16 @@ void        gimp_preview_draw_buffer        (GimpPreview  *preview,
 
 void        gimp_preview_invalidate         (GimpPreview  *preview);
 
+void        gimp_preview_render_async       (GimpPreview           *preview,
+                                             const guchar          *src,
+                                             gint                   width,
+                                             gint                   height,
+                                             gint                   bpp,
+                                             GimpPreviewRenderFunc  func,
+                                             gpointer               user_data,
+                                             GDestroyNotify         destroy);
+void        gimp_preview_cancel_render      (GimpPreview  *preview);
+
 void        gimp_preview_set_default_cursor (GimpPreview  *preview,
                                              GdkCursor    *cursor);
 
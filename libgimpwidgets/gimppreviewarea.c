@@ -30,6 +30,11 @@
 
 #include "libgimp/libgimp-intl.h"
 
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define GIMP_PREVIEW_AREA_SSE2 1
+#include <emmintrin.h>
+#endif
+
 
 /**
  * SECTION: gimppreviewarea
@@ -52,9 +57,18 @@ enum
 #define DEFAULT_CHECK_SIZE  GIMP_CHECK_SIZE_MEDIUM_CHECKS
 #define DEFAULT_CHECK_TYPE  GIMP_CHECK_TYPE_GRAY_CHECKS
 
-#define CHECK_COLOR(area, row, col)        \
-  (((((area)->offset_y + (row)) & size) ^  \
-    (((area)->offset_x + (col)) & size)) ? dark : light)
+/*  picks the row of shades made by gimp_preview_area_checks_new()
+ *  for the given row of the preview
+ */
+#define CHECK_ROW(area, checks, row, width)                         \
+  ((((area)->offset_y + (row)) & (1 << (2 + (area)->check_size))) ? \
+   (checks) + (width) : (checks))
+
+
+typedef void (* GimpPreviewAreaCompositeFunc) (const guchar *src,
+                                               const guchar *checks,
+                                               guchar       *dest,
+                                               gint          width);
 
 
 static void      gimp_preview_area_finalize         (GObject         *object);
@@ -79,6 +93,12 @@ static void      gimp_preview_area_queue_draw       (GimpPreviewArea *area,
                                                      gint             height);
 static gint      gimp_preview_area_image_type_bytes (GimpImageType    type);
 
+static guchar  * gimp_preview_area_checks_new       (GimpPreviewArea *area,
+                                                     gint             x,
+                                                     gint             width);
+static GimpPreviewAreaCompositeFunc
+                 gimp_preview_area_get_composite_func (void);
+
 
 G_DEFINE_TYPE (GimpPreviewArea, gimp_preview_area, GTK_TYPE_DRAWING_AREA)
 
@@ -233,6 +253,7 @@ gimp_preview_area_expose (GtkWidget      *widget,
   GtkAllocation    allocation;
   GdkPixbuf       *pixbuf;
   GdkRectangle     rect;
+  GdkRectangle     render_rect;
   cairo_t         *cr;
 
   if (! area->buf)
@@ -245,12 +266,20 @@ gimp_preview_area_expose (GtkWidget      *widget,
   rect.width  = area->width;
   rect.height = area->height;
 
-  pixbuf = gdk_pixbuf_new_from_data (area->buf,
+  /*  only hand the exposed part to cairo, it converts all of the
+   *  pixbuf it gets, which is slow for partial updates of big previews
+   */
+  if (! gdk_rectangle_intersect (&rect, &event->area, &render_rect))
+    return FALSE;
+
+  pixbuf = gdk_pixbuf_new_from_data (area->buf +
+                                     (render_rect.x - rect.x) * 3 +
+                                     (render_rect.y - rect.y) * area->rowstride,
                                      GDK_COLORSPACE_RGB,
                                      FALSE,
                                      8,
-                                     rect.width,
-                                     rect.height,
+                                     render_rect.width,
+                                     render_rect.height,
                                      area->rowstride,
                                      NULL, NULL);
   cr = gdk_cairo_create (gtk_widget_get_window (widget));
@@ -258,7 +287,7 @@ gimp_preview_area_expose (GtkWidget      *widget,
   gdk_cairo_region (cr, event->region);
   cairo_clip (cr);
 
-  gdk_cairo_set_source_pixbuf (cr, pixbuf, rect.x, rect.y);
+  gdk_cairo_set_source_pixbuf (cr, pixbuf, render_rect.x, render_rect.y);
   cairo_paint (cr);
 
   cairo_destroy (cr);
@@ -310,6 +339,254 @@ gimp_preview_area_image_type_bytes (GimpImageType type)
     }
 }
 
+/*  Returns two rows of @width check shades, starting at @x. The first
+ *  row is used for the even rows of checks, the second one for the odd
+ *  rows, see CHECK_ROW().
+ */
+static guchar *
+gimp_preview_area_checks_new (GimpPreviewArea *area,
+                              gint             x,
+                              gint             width)
+{
+  guchar *checks = g_new (guchar, 2 * width);
+  guint   size   = 1 << (2 + area->check_size);
+  guchar  light;
+  guchar  dark;
+  gint    col;
+
+  gimp_checks_get_shades (area->check_type, &light, &dark);
+
+  for (col = 0; col < width; col++)
+    {
+      if ((area->offset_x + x + col) & size)
+        {
+          checks[col]         = dark;
+          checks[width + col] = light;
+        }
+      else
+        {
+          checks[col]         = light;
+          checks[width + col] = dark;
+        }
+    }
+
+  return checks;
+}
+
+/*  The composite kernels blend a row of RGBA pixels over the row of
+ *  check shades and write RGB pixels. They give the same results as
+ *  ((check << 8) + (src - check) * (alpha + 1)) >> 8, except that fully
+ *  transparent pixels show the plain check.
+ */
+static void
+gimp_preview_area_composite_row_scalar (const guchar *src,
+                                        const guchar *checks,
+                                        guchar       *dest,
+                                        gint          width)
+{
+  gint i;
+
+  for (i = 0; i < width; i++, src += 4, dest += 3)
+    {
+      guint alpha = src[3] + (src[3] != 0);
+      guint check = checks[i] * (256 - alpha);
+
+      dest[0] = (check + src[0] * alpha) >> 8;
+      dest[1] = (check + src[1] * alpha) >> 8;
+      dest[2] = (check + src[2] * alpha) >> 8;
+    }
+}
+
+#ifdef GIMP_PREVIEW_AREA_SSE2
+
+static inline __m128i
+gimp_preview_area_composite_sse2 (__m128i src,
+                                  __m128i check)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i one  = _mm_set1_epi16 (1);
+  __m128i       alpha;
+  __m128i       inv_alpha;
+
+  alpha = _mm_shufflelo_epi16 (src,   _MM_SHUFFLE (3, 3, 3, 3));
+  alpha = _mm_shufflehi_epi16 (alpha, _MM_SHUFFLE (3, 3, 3, 3));
+  alpha = _mm_add_epi16 (alpha,
+                         _mm_andnot_si128 (_mm_cmpeq_epi16 (alpha, zero),
+                                           one));
+
+  inv_alpha = _mm_sub_epi16 (_mm_set1_epi16 (256), alpha);
+
+  /*  at most 255 * 256, so this fits into 16 bits  */
+  return _mm_srli_epi16 (_mm_add_epi16 (_mm_mullo_epi16 (check, inv_alpha),
+                                        _mm_mullo_epi16 (src,   alpha)),
+                         8);
+}
+
+static void
+gimp_preview_area_composite_row_sse2 (const guchar *src,
+                                      const guchar *checks,
+                                      guchar       *dest,
+                                      gint          width)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  gint          i;
+
+  /*  four pixels at a time, each one is stored as four bytes, the last
+   *  of which is overwritten by the next pixel, hence the extra pixel
+   *  the loop leaves to the scalar version
+   */
+  for (i = 0; i + 4 < width; i += 4, src += 16, checks += 4, dest += 12)
+    {
+      __m128i s = _mm_loadu_si128 ((const __m128i *) src);
+      __m128i c;
+      __m128i lo;
+      __m128i hi;
+      guint32 v;
+      gint    k;
+
+      memcpy (&v, checks, 4);
+
+      c = _mm_cvtsi32_si128 (v);
+      c = _mm_unpacklo_epi8 (c, c);
+      c = _mm_unpacklo_epi16 (c, c);
+
+      lo = gimp_preview_area_composite_sse2 (_mm_unpacklo_epi8 (s, zero),
+                                             _mm_unpacklo_epi8 (c, zero));
+      hi = gimp_preview_area_composite_sse2 (_mm_unpackhi_epi8 (s, zero),
+                                             _mm_unpackhi_epi8 (c, zero));
+
+      s = _mm_packus_epi16 (lo, hi);
+
+      for (k = 0; k < 4; k++)
+        {
+          v = _mm_cvtsi128_si32 (s);
+          memcpy (dest + 3 * k, &v, 4);
+
+          s = _mm_srli_si128 (s, 4);
+        }
+    }
+
+  gimp_preview_area_composite_row_scalar (src, checks, dest, width - i);
+}
+
+#endif /* GIMP_PREVIEW_AREA_SSE2 */
+
+static GimpPreviewAreaCompositeFunc
+gimp_preview_area_get_composite_func (void)
+{
+  static GimpPreviewAreaCompositeFunc func = NULL;
+
+  if (! func)
+    {
+      func = gimp_preview_area_composite_row_scalar;
+
+#ifdef GIMP_PREVIEW_AREA_SSE2
+      if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+        func = gimp_preview_area_composite_row_sse2;
+#endif
+    }
+
+  return func;
+}
+
+/*  convert a row of GRAYA or INDEXEDA pixels to RGBA for compositing  */
+static void
+gimp_preview_area_expand_graya (const guchar *src,
+                                guchar       *dest,
+                                gint          width)
+{
+  gint i;
+
+  for (i = 0; i < width; i++, src += 2, dest += 4)
+    {
+      dest[0] = dest[1] = dest[2] = src[0];
+      dest[3] = src[1];
+    }
+}
+
+static void
+gimp_preview_area_expand_indexeda (const guchar *src,
+                                   const guchar *colormap,
+                                   guchar       *dest,
+                                   gint          width)
+{
+  gint i;
+
+  for (i = 0; i < width; i++, src += 2, dest += 4)
+    {
+      const guchar *color = colormap + 3 * src[0];
+
+      dest[0] = color[0];
+      dest[1] = color[1];
+      dest[2] = color[2];
+      dest[3] = src[1];
+    }
+}
+
+/*  blends two pixels with alpha by @opacity and writes an RGBA pixel,
+ *  @n_channels is 1 for gray and 3 for color pixels
+ */
+static inline void
+gimp_preview_area_blend_pixel (const guchar *src1,
+                               gint          alpha1,
+                               const guchar *src2,
+                               gint          alpha2,
+                               gint          n_channels,
+                               gint          opacity,
+                               guchar       *dest)
+{
+  gint i;
+
+  switch (opacity)
+    {
+    case 0:
+      for (i = 0; i < n_channels; i++)
+        dest[i] = src1[i];
+
+      dest[3] = alpha1;
+      break;
+
+    case 255:
+      for (i = 0; i < n_channels; i++)
+        dest[i] = src2[i];
+
+      dest[3] = alpha2;
+      break;
+
+    default:
+      if (alpha1 == alpha2)
+        {
+          for (i = 0; i < n_channels; i++)
+            dest[i] = ((src1[i] << 8) + (src2[i] - src1[i]) * opacity) >> 8;
+
+          dest[3] = alpha1;
+        }
+      else
+        {
+          dest[3] = ((alpha1 << 8) + (alpha2 - alpha1) * opacity) >> 8;
+
+          for (i = 0; i < n_channels; i++)
+            {
+              if (dest[3])
+                {
+                  gint a = src1[i] * alpha1;
+                  gint b = src2[i] * alpha2;
+
+                  dest[i] = (((a << 8) + (b - a) * opacity) >> 8) / dest[3];
+                }
+              else
+                {
+                  dest[i] = 0;
+                }
+            }
+        }
+      break;
+    }
+
+  if (n_channels == 1)
+    dest[1] = dest[2] = dest[0];
+}
+
 /**
  * gimp_preview_area_new:
  *
@@ -350,13 +627,13 @@ gimp_preview_area_draw (GimpPreviewArea *area,
                         const guchar    *buf,
                         gint             rowstride)
 {
-  const guchar *src;
-  guchar       *dest;
-  guint         size;
-  guchar        light;
-  guchar        dark;
-  gint          row;
-  gint          col;
+  const guchar                 *src;
+  guchar                       *dest;
+  guchar                       *checks = NULL;
+  guchar                       *inter  = NULL;
+  GimpPreviewAreaCompositeFunc  composite;
+  gint                          row;
+  gint                          col;
 
   g_return_if_fail (GIMP_IS_PREVIEW_AREA (area));
   g_return_if_fail (width >= 0 && height >= 0);
@@ -403,8 +680,7 @@ gimp_preview_area_draw (GimpPreviewArea *area,
       area->buf = g_new (guchar, area->rowstride * area->height);
     }
 
-  size = 1 << (2 + area->check_size);
-  gimp_checks_get_shades (area->check_type, &light, &dark);
+  composite = gimp_preview_area_get_composite_func ();
 
   src  = buf;
   dest = area->buf + x * 3 + y * area->rowstride;
@@ -422,42 +698,16 @@ gimp_preview_area_draw (GimpPreviewArea *area,
       break;
 
     case GIMP_RGBA_IMAGE:
-       for (row = y; row < y + height; row++)
-        {
-          const guchar *s = src;
-          guchar       *d = dest;
+      checks = gimp_preview_area_checks_new (area, x, width);
 
-          for (col = x; col < x + width; col++, s += 4, d+= 3)
-            {
-              switch (s[3])
-                {
-                case 0:
-                  d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                  break;
-
-                case 255:
-                  d[0] = s[0];
-                  d[1] = s[1];
-                  d[2] = s[2];
-                  break;
-
-                default:
-                  {
-                    register guint alpha = s[3] + 1;
-                    register guint check = CHECK_COLOR (area, row, col);
-
-                    d[0] = ((check << 8) + (s[0] - check) * alpha) >> 8;
-                    d[1] = ((check << 8) + (s[1] - check) * alpha) >> 8;
-                    d[2] = ((check << 8) + (s[2] - check) * alpha) >> 8;
-                  }
-                  break;
-                }
-            }
+      for (row = y; row < y + height; row++)
+        {
+          composite (src, CHECK_ROW (area, checks, row, width), dest, width);
 
           src  += rowstride;
           dest += area->rowstride;
         }
-       break;
+      break;
 
     case GIMP_GRAY_IMAGE:
       for (row = 0; row < height; row++)
@@ -476,34 +726,14 @@ gimp_preview_area_draw (GimpPreviewArea *area,
       break;
 
     case GIMP_GRAYA_IMAGE:
+      checks = gimp_preview_area_checks_new (area, x, width);
+      inter  = g_new (guchar, 4 * width);
+
       for (row = y; row < y + height; row++)
         {
-          const guchar *s = src;
-          guchar       *d = dest;
+          gimp_preview_area_expand_graya (src, inter, width);
 
-          for (col = x; col < x + width; col++, s += 2, d+= 3)
-            {
-              switch (s[1])
-                {
-                case 0:
-                  d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                  break;
-
-                case 255:
-                  d[0] = d[1] = d[2] = s[0];
-                  break;
-
-                default:
-                  {
-                    register guint alpha = s[1] + 1;
-                    register guint check = CHECK_COLOR (area, row, col);
-
-                    d[0] = d[1] = d[2] =
-                      ((check << 8) + (s[0] - check) * alpha) >> 8;
-                  }
-                  break;
-                }
-            }
+          composite (inter, CHECK_ROW (area, checks, row, width), dest, width);
 
           src  += rowstride;
           dest += area->rowstride;
@@ -533,39 +763,15 @@ gimp_preview_area_draw (GimpPreviewArea *area,
 
     case GIMP_INDEXEDA_IMAGE:
       g_return_if_fail (area->colormap != NULL);
+
+      checks = gimp_preview_area_checks_new (area, x, width);
+      inter  = g_new (guchar, 4 * width);
+
       for (row = y; row < y + height; row++)
         {
-          const guchar *s = src;
-          guchar       *d = dest;
+          gimp_preview_area_expand_indexeda (src, area->colormap, inter, width);
 
-          for (col = x; col < x + width; col++, s += 2, d += 3)
-            {
-              const guchar *colormap  = area->colormap + 3 * s[0];
-
-              switch (s[1])
-                {
-                case 0:
-                  d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                  break;
-
-                case 255:
-                  d[0] = colormap[0];
-                  d[1] = colormap[1];
-                  d[2] = colormap[2];
-                  break;
-
-                default:
-                  {
-                    register guint alpha = s[3] + 1;
-                    register guint check = CHECK_COLOR (area, row, col);
-
-                    d[0] = ((check << 8) + (colormap[0] - check) * alpha) >> 8;
-                    d[1] = ((check << 8) + (colormap[1] - check) * alpha) >> 8;
-                    d[2] = ((check << 8) + (colormap[2] - check) * alpha) >> 8;
-                  }
-                  break;
-                }
-            }
+          composite (inter, CHECK_ROW (area, checks, row, width), dest, width);
 
           src  += rowstride;
           dest += area->rowstride;
@@ -573,6 +779,9 @@ gimp_preview_area_draw (GimpPreviewArea *area,
       break;
     }
 
+  g_free (inter);
+  g_free (checks);
+
   gimp_preview_area_queue_draw (area, x, y, width, height);
 }
 
@@ -610,15 +819,14 @@ gimp_preview_area_blend (GimpPreviewArea *area,
                          gint             rowstride2,
                          guchar           opacity)
 {
-  const guchar *src1;
-  const guchar *src2;
-  guchar       *dest;
-  guint         size;
-  guchar        light;
-  guchar        dark;
-  gint          row;
-  gint          col;
-  gint          i;
+  const guchar                 *src1;
+  const guchar                 *src2;
+  guchar                       *dest;
+  guchar                       *checks = NULL;
+  guchar                       *inter  = NULL;
+  GimpPreviewAreaCompositeFunc  composite;
+  gint                          row;
+  gint                          col;
 
   g_return_if_fail (GIMP_IS_PREVIEW_AREA (area));
   g_return_if_fail (width >= 0 && height >= 0);
@@ -685,8 +893,7 @@ gimp_preview_area_blend (GimpPreviewArea *area,
       area->buf = g_new (guchar, area->rowstride * area->height);
     }
 
-  size = 1 << (2 + area->check_size);
-  gimp_checks_get_shades (area->check_type, &light, &dark);
+  composite = gimp_preview_area_get_composite_func ();
 
   src1 = buf1;
   src2 = buf2;
@@ -715,64 +922,20 @@ gimp_preview_area_blend (GimpPreviewArea *area,
       break;
 
     case GIMP_RGBA_IMAGE:
+      checks = gimp_preview_area_checks_new (area, x, width);
+      inter  = g_new (guchar, 4 * width);
+
       for (row = y; row < y + height; row++)
         {
           const guchar *s1 = src1;
           const guchar *s2 = src2;
-          guchar       *d  = dest;
+          guchar       *t  = inter;
 
-          for (col = x; col < x + width; col++, s1 += 4, s2 += 4, d+= 3)
-            {
-              guchar inter[4];
+          for (col = 0; col < width; col++, s1 += 4, s2 += 4, t += 4)
+            gimp_preview_area_blend_pixel (s1, s1[3], s2, s2[3], 3,
+                                           opacity, t);
 
-              if (s1[3] == s2[3])
-                {
-                  inter[0] = ((s1[0] << 8) + (s2[0] - s1[0]) * opacity) >> 8;
-                  inter[1] = ((s1[1] << 8) + (s2[1] - s1[1]) * opacity) >> 8;
-                  inter[2] = ((s1[2] << 8) + (s2[2] - s1[2]) * opacity) >> 8;
-                  inter[3] = s1[3];
-                }
-              else
-                {
-                  inter[3] = ((s1[3] << 8) + (s2[3] - s1[3]) * opacity) >> 8;
-
-                  if (inter[3])
-                    {
-                      for (i = 0; i < 3; i++)
-                        {
-                          gushort a = s1[i] * s1[3];
-                          gushort b = s2[i] * s2[3];
-
-                          inter[i] =
-                            (((a << 8) + (b  - a) * opacity) >> 8) / inter[3];
-                        }
-                    }
-
-                  switch (inter[3])
-                    {
-                    case 0:
-                      d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                      break;
-
-                    case 255:
-                      d[0] = inter[0];
-                      d[1] = inter[1];
-                      d[2] = inter[2];
-                      break;
-
-                    default:
-                      {
-                        register guint alpha = inter[3] + 1;
-                        register guint check = CHECK_COLOR (area, row, col);
-
-                        d[0] = ((check << 8) + (inter[0] - check) * alpha) >> 8;
-                        d[1] = ((check << 8) + (inter[1] - check) * alpha) >> 8;
-                        d[2] = ((check << 8) + (inter[2] - check) * alpha) >> 8;
-                      }
-                      break;
-                    }
-                }
-            }
+          composite (inter, CHECK_ROW (area, checks, row, width), dest, width);
 
           src1 += rowstride1;
           src2 += rowstride2;
@@ -800,56 +963,20 @@ gimp_preview_area_blend (GimpPreviewArea *area,
       break;
 
     case GIMP_GRAYA_IMAGE:
+      checks = gimp_preview_area_checks_new (area, x, width);
+      inter  = g_new (guchar, 4 * width);
+
       for (row = y; row < y + height; row++)
         {
           const guchar *s1 = src1;
           const guchar *s2 = src2;
-          guchar       *d  = dest;
-
-          for (col = x; col < x + width; col++, s1 += 2, s2 += 2, d+= 3)
-            {
-              guchar inter[2] = { 0, };
-
-              if (s1[1] == s2[1])
-                {
-                  inter[0] = ((s1[0] << 8) + (s2[0] - s1[0]) * opacity) >> 8;
-                  inter[1] = s1[1];
-                }
-              else
-                {
-                  inter[1] = ((s1[1] << 8) + (s2[1] - s1[1]) * opacity) >> 8;
+          guchar       *t  = inter;
 
-                  if (inter[1])
-                    {
-                      gushort a = s1[0] * s1[1];
-                      gushort b = s2[0] * s2[1];
+          for (col = 0; col < width; col++, s1 += 2, s2 += 2, t += 4)
+            gimp_preview_area_blend_pixel (s1, s1[1], s2, s2[1], 1,
+                                           opacity, t);
 
-                      inter[0] =
-                        (((a << 8) + (b  - a) * opacity) >> 8) / inter[1];
-                    }
-                }
-
-              switch (inter[1])
-                {
-                case 0:
-                  d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                  break;
-
-                case 255:
-                  d[0] = d[1] = d[2] = inter[0];
-                  break;
-
-                default:
-                  {
-                    register guint alpha = inter[1] + 1;
-                    register guint check = CHECK_COLOR (area, row, col);
-
-                    d[0] = d[1] = d[2] =
-                      ((check << 8) + (inter[0] - check) * alpha) >> 8;
-                  }
-                  break;
-                }
-            }
+          composite (inter, CHECK_ROW (area, checks, row, width), dest, width);
 
           src1 += rowstride1;
           src2 += rowstride2;
@@ -883,69 +1010,22 @@ gimp_preview_area_blend (GimpPreviewArea *area,
 
     case GIMP_INDEXEDA_IMAGE:
       g_return_if_fail (area->colormap != NULL);
+
+      checks = gimp_preview_area_checks_new (area, x, width);
+      inter  = g_new (guchar, 4 * width);
+
       for (row = y; row < y + height; row++)
         {
           const guchar *s1 = src1;
           const guchar *s2 = src2;
-          guchar       *d  = dest;
-
-          for (col = x; col < x + width; col++, s1 += 2, s2 += 2, d += 3)
-            {
-              const guchar *cmap1  = area->colormap + 3 * s1[0];
-              const guchar *cmap2  = area->colormap + 3 * s2[0];
-              guchar        inter[4];
+          guchar       *t  = inter;
 
-              if (s1[1] == s2[1])
-                {
-                  inter[0] = (((cmap1[0] << 8) +
-                               (cmap2[0] - cmap1[0]) * opacity) >> 8);
-                  inter[1] = (((cmap1[1] << 8) +
-                               (cmap2[1] - cmap1[1]) * opacity) >> 8);
-                  inter[2] = (((cmap1[2] << 8) +
-                               (cmap2[2] - cmap1[2]) * opacity) >> 8);
-                  inter[3] = s1[1];
-                }
-              else
-                {
-                  inter[3] = ((s1[1] << 8) + (s2[1] - s1[1]) * opacity) >> 8;
-
-                  if (inter[3])
-                    {
-                      for (i = 0; i < 3; i++)
-                        {
-                          gushort a = cmap1[i] * s1[1];
-                          gushort b = cmap2[i] * s2[1];
-
-                          inter[i] =
-                            (((a << 8) + (b  - a) * opacity) >> 8) / inter[3];
-                        }
-                    }
-                }
+          for (col = 0; col < width; col++, s1 += 2, s2 += 2, t += 4)
+            gimp_preview_area_blend_pixel (area->colormap + 3 * s1[0], s1[1],
+                                           area->colormap + 3 * s2[0], s2[1],
+                                           3, opacity, t);
 
-              switch (inter[3])
-                {
-                case 0:
-                  d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                  break;
-
-                case 255:
-                  d[0] = inter[0];
-                  d[1] = inter[1];
-                  d[2] = inter[2];
-                  break;
-
-                default:
-                  {
-                    register guint alpha = inter[3] + 1;
-                    register guint check = CHECK_COLOR (area, row, col);
-
-                    d[0] = ((check << 8) + (inter[0] - check) * alpha) >> 8;
-                    d[1] = ((check << 8) + (inter[1] - check) * alpha) >> 8;
-                    d[2] = ((check << 8) + (inter[2] - check) * alpha) >> 8;
-                  }
-                  break;
-                }
-            }
+          composite (inter, CHECK_ROW (area, checks, row, width), dest, width);
 
           src1 += rowstride1;
           src2 += rowstride2;
@@ -954,6 +1034,9 @@ gimp_preview_area_blend (GimpPreviewArea *area,
       break;
     }
 
+  g_free (inter);
+  g_free (checks);
+
   gimp_preview_area_queue_draw (area, x, y, width, height);
 }
 
@@ -994,16 +1077,15 @@ gimp_preview_area_mask (GimpPreviewArea *area,
                         const guchar    *mask,
                         gint             rowstride_mask)
 {
-  const guchar *src1;
-  const guchar *src2;
-  const guchar *src_mask;
-  guchar       *dest;
-  guint         size;
-  guchar        light;
-  guchar        dark;
-  gint          row;
-  gint          col;
-  gint          i;
+  const guchar                 *src1;
+  const guchar                 *src2;
+  const guchar                 *src_mask;
+  guchar                       *dest;
+  guchar                       *checks = NULL;
+  guchar                       *inter  = NULL;
+  GimpPreviewAreaCompositeFunc  composite;
+  gint                          row;
+  gint                          col;
 
   g_return_if_fail (GIMP_IS_PREVIEW_AREA (area));
   g_return_if_fail (width >= 0 && height >= 0);
@@ -1058,8 +1140,7 @@ gimp_preview_area_mask (GimpPreviewArea *area,
       area->buf = g_new (guchar, area->rowstride * area->height);
     }
 
-  size = 1 << (2 + area->check_size);
-  gimp_checks_get_shades (area->check_type, &light, &dark);
+  composite = gimp_preview_area_get_composite_func ();
 
   src1     = buf1;
   src2     = buf2;
@@ -1091,134 +1172,27 @@ gimp_preview_area_mask (GimpPreviewArea *area,
       break;
 
     case GIMP_RGBA_IMAGE:
-       for (row = y; row < y + height; row++)
+      checks = gimp_preview_area_checks_new (area, x, width);
+      inter  = g_new (guchar, 4 * width);
+
+      for (row = y; row < y + height; row++)
         {
           const guchar *s1 = src1;
           const guchar *s2 = src2;
-          const guchar *m  = src_mask;
-          guchar       *d  = dest;
+          guchar       *t  = inter;
 
-          for (col = x; col < x + width; col++, s1 += 4, s2 += 4, m++, d+= 3)
-            {
-              switch (m[0])
-                {
-                case 0:
-                  switch (s1[3])
-                    {
-                    case 0:
-                      d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                      break;
-
-                    case 255:
-                      d[0] = s1[0];
-                      d[1] = s1[1];
-                      d[2] = s1[2];
-                      break;
-
-                    default:
-                      {
-                        register guint alpha = s1[3] + 1;
-                        register guint check = CHECK_COLOR (area, row, col);
-
-                        d[0] = ((check << 8) + (s1[0] - check) * alpha) >> 8;
-                        d[1] = ((check << 8) + (s1[1] - check) * alpha) >> 8;
-                        d[2] = ((check << 8) + (s1[2] - check) * alpha) >> 8;
-                      }
-                      break;
-                    }
-                  break;
-
-                case 255:
-                  switch (s2[3])
-                    {
-                    case 0:
-                      d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                      break;
-
-                    case 255:
-                      d[0] = s2[0];
-                      d[1] = s2[1];
-                      d[2] = s2[2];
-                      break;
-
-                    default:
-                      {
-                        register guint alpha = s2[3] + 1;
-                        register guint check = CHECK_COLOR (area, row, col);
-
-                        d[0] = ((check << 8) + (s2[0] - check) * alpha) >> 8;
-                        d[1] = ((check << 8) + (s2[1] - check) * alpha) >> 8;
-                        d[2] = ((check << 8) + (s2[2] - check) * alpha) >> 8;
-                      }
-                      break;
-                    }
-                  break;
-
-                default:
-                  {
-                    guchar inter[4];
-
-                    if (s1[3] == s2[3])
-                      {
-                        inter[0] = ((s1[0] << 8) + (s2[0] - s1[0]) * m[0]) >> 8;
-                        inter[1] = ((s1[1] << 8) + (s2[1] - s1[1]) * m[0]) >> 8;
-                        inter[2] = ((s1[2] << 8) + (s2[2] - s1[2]) * m[0]) >> 8;
-                        inter[3] = s1[3];
-                     }
-                    else
-                      {
-                        inter[3] = ((s1[3] << 8) + (s2[3] - s1[3]) * m[0]) >> 8;
-
-                        if (inter[3])
-                          {
-                            for (i = 0; i < 3; i++)
-                             {
-                               gushort a = s1[i] * s1[3];
-                               gushort b = s2[i] * s2[3];
-
-                               inter[i] =
-                                 (((a << 8) + (b  - a) * m[0]) >> 8) / inter[3];
-                             }
-                         }
-                      }
-
-                    switch (inter[3])
-                      {
-                      case 0:
-                        d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                        break;
-
-                      case 255:
-                        d[0] = inter[0];
-                        d[1] = inter[1];
-                        d[2] = inter[2];
-                        break;
-
-                      default:
-                        {
-                          register guint alpha = inter[3] + 1;
-                          register guint check = CHECK_COLOR (area, row, col);
-
-                          d[0] = (((check << 8) +
-                                   (inter[0] - check) * alpha) >> 8);
-                          d[1] = (((check << 8) +
-                                   (inter[1] - check) * alpha) >> 8);
-                          d[2] = (((check << 8) +
-                                   (inter[2] - check) * alpha) >> 8);
-                        }
-                        break;
-                      }
-                  }
-                  break;
-                }
-            }
+          for (col = 0; col < width; col++, s1 += 4, s2 += 4, t += 4)
+            gimp_preview_area_blend_pixel (s1, s1[3], s2, s2[3], 3,
+                                           src_mask[col], t);
+
+          composite (inter, CHECK_ROW (area, checks, row, width), dest, width);
 
           src1     += rowstride1;
           src2     += rowstride2;
           src_mask += rowstride_mask;
           dest     += area->rowstride;
         }
-       break;
+      break;
 
     case GIMP_GRAY_IMAGE:
       for (row = 0; row < height; row++)
@@ -1239,110 +1213,20 @@ gimp_preview_area_mask (GimpPreviewArea *area,
       break;
 
     case GIMP_GRAYA_IMAGE:
+      checks = gimp_preview_area_checks_new (area, x, width);
+      inter  = g_new (guchar, 4 * width);
+
       for (row = y; row < y + height; row++)
         {
           const guchar *s1 = src1;
           const guchar *s2 = src2;
-          const guchar *m  = src_mask;
-          guchar       *d  = dest;
+          guchar       *t  = inter;
 
-          for (col = x; col < x + width; col++, s1 += 2, s2 += 2, m++, d+= 3)
-            {
-              switch (m[0])
-                {
-                case 0:
-                  switch (s1[1])
-                    {
-                    case 0:
-                      d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                      break;
-
-                    case 255:
-                      d[0] = d[1] = d[2] = s1[0];
-                      break;
-
-                    default:
-                      {
-                        register guint alpha = s1[1] + 1;
-                        register guint check = CHECK_COLOR (area, row, col);
-
-                        d[0] = d[1] = d[2] =
-                          ((check << 8) + (s1[0] - check) * alpha) >> 8;
-                      }
-                      break;
-                    }
-                  break;
-
-                case 255:
-                  switch (s2[1])
-                    {
-                    case 0:
-                      d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                      break;
-
-                    case 255:
-                      d[0] = d[1] = d[2] = s2[0];
-                      break;
-
-                    default:
-                      {
-                        register guint alpha = s2[1] + 1;
-                        register guint check = CHECK_COLOR (area, row, col);
-
-                        d[0] = d[1] = d[2] =
-                          ((check << 8) + (s2[0] - check) * alpha) >> 8;
-                      }
-                      break;
-                    }
-                  break;
-
-                default:
-                  {
-                    guchar inter[2] = { 0, };
-
-                    if (s1[1] == s2[1])
-                      {
-                        inter[0] = ((s1[0] << 8) + (s2[0] - s1[0]) * m[0]) >> 8;
-                        inter[1] = s1[1];
-                      }
-                    else
-                      {
-                        inter[1] = ((s1[1] << 8) + (s2[1] - s1[1]) * m[0]) >> 8;
-
-                        if (inter[1])
-                          {
-                            gushort a = s1[0] * s1[1];
-                            gushort b = s2[0] * s2[1];
-
-                            inter[0] =
-                              (((a << 8) + (b  - a) * m[0]) >> 8) / inter[1];
-                          }
-                      }
-
-                    switch (inter[1])
-                      {
-                      case 0:
-                        d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                        break;
-
-                      case 255:
-                        d[0] = d[1] = d[2] = inter[0];
-                        break;
-
-                      default:
-                        {
-                          register guint alpha = inter[1] + 1;
-                          register guint check = CHECK_COLOR (area, row, col);
-
-                          d[0] = d[1] = d[2] =
-                            ((check << 8) + (inter[0] - check) * alpha) >> 8;
-                        }
-                        break;
-                      }
-                  }
-                  break;
-                }
-            }
+          for (col = 0; col < width; col++, s1 += 2, s2 += 2, t += 4)
+            gimp_preview_area_blend_pixel (s1, s1[1], s2, s2[1], 1,
+                                           src_mask[col], t);
+
+          composite (inter, CHECK_ROW (area, checks, row, width), dest, width);
 
           src1     += rowstride1;
           src2     += rowstride2;
@@ -1379,133 +1263,22 @@ gimp_preview_area_mask (GimpPreviewArea *area,
 
     case GIMP_INDEXEDA_IMAGE:
       g_return_if_fail (area->colormap != NULL);
+
+      checks = gimp_preview_area_checks_new (area, x, width);
+      inter  = g_new (guchar, 4 * width);
+
       for (row = y; row < y + height; row++)
         {
           const guchar *s1 = src1;
           const guchar *s2 = src2;
-          const guchar *m  = src_mask;
-          guchar       *d  = dest;
+          guchar       *t  = inter;
 
-          for (col = x; col < x + width; col++, s1 += 2, s2 += 2, m++, d += 3)
-            {
-              const guchar *cmap1  = area->colormap + 3 * s1[0];
-              const guchar *cmap2  = area->colormap + 3 * s2[0];
+          for (col = 0; col < width; col++, s1 += 2, s2 += 2, t += 4)
+            gimp_preview_area_blend_pixel (area->colormap + 3 * s1[0], s1[1],
+                                           area->colormap + 3 * s2[0], s2[1],
+                                           3, src_mask[col], t);
 
-              switch (m[0])
-                {
-                case 0:
-                  switch (s1[1])
-                    {
-                    case 0:
-                      d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                      break;
-
-                    case 255:
-                      d[0] = cmap1[0];
-                      d[1] = cmap1[1];
-                      d[2] = cmap1[2];
-                      break;
-
-                    default:
-                      {
-                        register guint alpha = s1[1] + 1;
-                        register guint check = CHECK_COLOR (area, row, col);
-
-                        d[0] = ((check << 8) + (cmap1[0] - check) * alpha) >> 8;
-                        d[1] = ((check << 8) + (cmap1[1] - check) * alpha) >> 8;
-                        d[2] = ((check << 8) + (cmap1[2] - check) * alpha) >> 8;
-                      }
-                      break;
-                    }
-                  break;
-
-                case 255:
-                  switch (s2[1])
-                    {
-                    case 0:
-                      d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                      break;
-
-                    case 255:
-                      d[0] = cmap2[0];
-                      d[1] = cmap2[1];
-                      d[2] = cmap2[2];
-                      break;
-
-                    default:
-                      {
-                        register guint alpha = s2[1] + 1;
-                        register guint check = CHECK_COLOR (area, row, col);
-
-                        d[0] = ((check << 8) + (cmap2[0] - check) * alpha) >> 8;
-                        d[1] = ((check << 8) + (cmap2[1] - check) * alpha) >> 8;
-                        d[2] = ((check << 8) + (cmap2[2] - check) * alpha) >> 8;
-                      }
-                      break;
-                    }
-                  break;
-
-                default:
-                  {
-                    guchar inter[4];
-
-                    if (s1[1] == s2[1])
-                      {
-                        inter[0] = (((cmap1[0] << 8) +
-                                     (cmap2[0] - cmap1[0]) * m[0]) >> 8);
-                        inter[1] = (((cmap1[1] << 8) +
-                                     (cmap2[1] - cmap1[1]) * m[0]) >> 8);
-                        inter[2] = (((cmap1[2] << 8) +
-                                     (cmap2[2] - cmap1[2]) * m[0]) >> 8);
-                        inter[3] = s1[1];
-                      }
-                    else
-                      {
-                        inter[3] = ((s1[1] << 8) + (s2[1] - s1[1]) * m[0]) >> 8;
-
-                        if (inter[3])
-                          {
-                            for (i = 0 ; i < 3 ; i++)
-                              {
-                                gushort a = cmap1[i] * s1[1];
-                                gushort b = cmap2[i] * s2[1];
-
-                                inter[i] = ((((a << 8) + (b  - a) * m[0]) >> 8)
-                                            / inter[3]);
-                              }
-                          }
-                      }
-
-                    switch (inter[3])
-                      {
-                      case 0:
-                        d[0] = d[1] = d[2] = CHECK_COLOR (area, row, col);
-                        break;
-
-                      case 255:
-                        d[0] = inter[0];
-                        d[1] = inter[1];
-                        d[2] = inter[2];
-                        break;
-
-                      default:
-                        {
-                          register guint alpha = inter[3] + 1;
-                          register guint check = CHECK_COLOR (area, row, col);
-
-                          d[0] =
-                            ((check << 8) + (inter[0] - check) * alpha) >> 8;
-                          d[1] =
-                            ((check << 8) + (inter[1] - check) * alpha) >> 8;
-                          d[2] =
-                            ((check << 8) + (inter[2] - check) * alpha) >> 8;
-                        }
-                        break;
-                      }
-                  }
-                  break;
-                }
-            }
+          composite (inter, CHECK_ROW (area, checks, row, width), dest, width);
 
           src1     += rowstride1;
           src2     += rowstride2;
@@ -1515,6 +1288,9 @@ gimp_preview_area_mask (GimpPreviewArea *area,
       break;
     }
 
+  g_free (inter);
+  g_free (checks);
+
   gimp_preview_area_queue_draw (area, x, y, width, height);
 }
 
@@ -26,6 +26,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 
 #include <linux/input.h>
 
@@ -41,6 +43,7 @@
 #include "libgimpwidgets/gimpcontroller.h"
 
 #include "gimpinputdevicestore.h"
+#include "controller-reader.h"
 
 #include "libgimp/libgimp-intl.h"
 
@@ -133,8 +136,8 @@ struct _ControllerLinuxInput
 
   GimpInputDeviceStore *store;
   gchar                *device;
-  GIOChannel           *io;
-  guint                 io_id;
+  gint                  fd;
+  ControllerReader     *reader;
 };
 
 struct _ControllerLinuxInputClass
@@ -166,9 +169,9 @@ static void          linux_input_device_changed   (ControllerLinuxInput *control
                                                    const gchar          *udi);
 static gboolean      linux_input_set_device       (ControllerLinuxInput *controller,
                                                    const gchar          *device);
-static gboolean      linux_input_read_event       (GIOChannel           *io,
-                                                   GIOCondition          cond,
-                                                   gpointer              data);
+static gboolean      linux_input_read_event       (ControllerReader     *reader,
+                                                   gpointer              data,
+                                                   GError              **error);
 
 
 static const GimpModuleInfo linux_input_info =
@@ -243,6 +246,7 @@ controller_linux_input_class_finalize (ControllerLinuxInputClass *klass)
 static void
 controller_linux_input_init (ControllerLinuxInput *controller)
 {
+  controller->fd    = -1;
   controller->store = gimp_input_device_store_new ();
 
   if (controller->store)
@@ -495,13 +499,16 @@ linux_input_set_device (ControllerLinuxInput *controller,
 {
   gchar *filename;
 
-  if (controller->io)
+  if (controller->reader)
     {
-      g_source_remove (controller->io_id);
-      controller->io_id = 0;
+      controller_reader_free (controller->reader);
+      controller->reader = NULL;
+    }
 
-      g_io_channel_unref (controller->io);
-      controller->io = NULL;
+  if (controller->fd >= 0)
+    {
+      close (controller->fd);
+      controller->fd = -1;
     }
 
   if (controller->device)
@@ -535,7 +542,9 @@ linux_input_set_device (ControllerLinuxInput *controller,
 
       if (fd >= 0)
         {
-          gchar name[256];
+          struct pollfd  pfd   = { fd, POLLIN, 0 };
+          GError        *error = NULL;
+          gchar          name[256];
 
           name[0] = '\0';
           if (ioctl (fd, EVIOCGNAME (sizeof (name)), name) >= 0 &&
@@ -553,15 +562,31 @@ linux_input_set_device (ControllerLinuxInput *controller,
 
           g_free (filename);
 
-          controller->io = g_io_channel_unix_new (fd);
-          g_io_channel_set_close_on_unref (controller->io, TRUE);
-          g_io_channel_set_encoding (controller->io, NULL, NULL);
+          /*  read on a thread of its own so that events don't pile up
+           *  while the main loop is busy
+           */
+          controller->fd     = fd;
+          controller->reader =
+            controller_reader_new (GIMP_CONTROLLER (controller),
+                                   linux_input_get_n_events (GIMP_CONTROLLER (controller)),
+                                   &pfd, 1,
+                                   linux_input_read_event, controller,
+                                   &error);
+
+          if (controller->reader)
+            return TRUE;
+
+          close (fd);
+          controller->fd = -1;
+
+          state = g_strdup_printf (_("Device not available: %s"),
+                                   error->message);
+          g_object_set (controller, "state", state, NULL);
+          g_free (state);
+
+          g_clear_error (&error);
 
-          controller->io_id = g_io_add_watch (controller->io,
-                                              G_IO_IN,
-                                              linux_input_read_event,
-                                              controller);
-          return TRUE;
+          return FALSE;
         }
       else
         {
@@ -591,74 +616,49 @@ linux_input_set_device (ControllerLinuxInput *controller,
   return FALSE;
 }
 
+/*  runs on the reader thread  */
 static gboolean
-linux_input_read_event (GIOChannel   *io,
-                        GIOCondition  cond,
-                        gpointer      data)
+linux_input_read_event (ControllerReader  *reader,
+                        gpointer           data,
+                        GError           **error)
 {
   ControllerLinuxInput *input = CONTROLLER_LINUX_INPUT (data);
-  GIOStatus             status;
-  GError               *error = NULL;
-  struct input_event    ev;
-  gsize                 n_bytes;
+  struct input_event    ev[64];
+  gssize                n_bytes;
+  gint                  n;
 
-  status = g_io_channel_read_chars (io,
-                                    (gchar *) &ev,
-                                    sizeof (struct input_event), &n_bytes,
-                                    &error);
+  n_bytes = read (input->fd, ev, sizeof (ev));
 
-  switch (status)
+  if (n_bytes < 0)
     {
-    case G_IO_STATUS_ERROR:
-    case G_IO_STATUS_EOF:
-      g_source_remove (input->io_id);
-      input->io_id = 0;
-
-      g_io_channel_unref (input->io);
-      input->io = NULL;
+      if (errno == EINTR || errno == EAGAIN)
+        return TRUE;
 
-      if (error)
-        {
-          gchar *state = g_strdup_printf (_("Device not available: %s"),
-                                          error->message);
-          g_object_set (input, "state", state, NULL);
-          g_free (state);
-
-          g_clear_error (&error);
-        }
-      else
-        {
-          g_object_set (input, "state", _("End of file"), NULL);
-        }
+      g_set_error_literal (error, G_FILE_ERROR,
+                           g_file_error_from_errno (errno),
+                           g_strerror (errno));
+      return FALSE;
+    }
+  else if (n_bytes == 0)
+    {
       return FALSE;
-      break;
-
-    case G_IO_STATUS_AGAIN:
-      return TRUE;
-
-    default:
-      break;
     }
 
-  if (n_bytes == sizeof (struct input_event))
+  for (n = 0; n < n_bytes / sizeof (struct input_event); n++)
     {
-      GimpController      *controller = GIMP_CONTROLLER (data);
-      GimpControllerEvent  cevent     = { 0, };
-      gint                 i;
+      gint64 timestamp = ((gint64) ev[n].time.tv_sec * G_USEC_PER_SEC +
+                          ev[n].time.tv_usec);
+      gint   i;
 
-      switch (ev.type)
+      switch (ev[n].type)
         {
         case EV_KEY:
-          g_print ("%s: EV_KEY code = 0x%02x\n", G_STRFUNC, ev.code);
+          g_print ("%s: EV_KEY code = 0x%02x\n", G_STRFUNC, ev[n].code);
 
           for (i = 0; i < G_N_ELEMENTS (key_events); i++)
-            if (ev.code == key_events[i].code)
+            if (ev[n].code == key_events[i].code)
               {
-                cevent.any.type     = GIMP_CONTROLLER_EVENT_TRIGGER;
-                cevent.any.source   = controller;
-                cevent.any.event_id = i;
-
-                gimp_controller_event (controller, &cevent);
+                controller_reader_trigger (reader, i, timestamp);
 
                 break;
               }
@@ -666,39 +666,31 @@ linux_input_read_event (GIOChannel   *io,
 
         case EV_REL:
           g_print ("%s: EV_REL code = 0x%02x (value = %d)\n", G_STRFUNC,
-                   ev.code, ev.value);
+                   ev[n].code, ev[n].value);
 
           for (i = 0; i < G_N_ELEMENTS (rel_events); i++)
-            if (ev.code == rel_events[i].code)
+            if (ev[n].code == rel_events[i].code)
               {
-                cevent.any.type     = GIMP_CONTROLLER_EVENT_VALUE;
-                cevent.any.source   = controller;
-                cevent.any.event_id = G_N_ELEMENTS (key_events) + i;
-
-                g_value_init (&cevent.value.value, G_TYPE_DOUBLE);
-
-                if (ev.value < 0)
-                  {
-                    g_value_set_double (&cevent.value.value, -ev.value);
-                  }
+                gint event_id = G_N_ELEMENTS (key_events) + i;
+
+                /*  wheel deltas that arrive faster than the main loop
+                 *  takes them add up to a single event
+                 */
+                if (ev[n].value < 0)
+                  controller_reader_value (reader, event_id, -ev[n].value,
+                                           CONTROLLER_READER_ACCUMULATE,
+                                           timestamp);
                 else
-                  {
-                    cevent.any.event_id++;
-
-                    g_value_set_double (&cevent.value.value, ev.value);
-                  }
-
-                gimp_controller_event (controller, &cevent);
-
-                g_value_unset (&cevent.value.value);
-
-               break;
+                  controller_reader_value (reader, event_id + 1, ev[n].value,
+                                           CONTROLLER_READER_ACCUMULATE,
+                                           timestamp);
+                break;
               }
           break;
 
         case EV_ABS:
           g_print ("%s: EV_ABS code = 0x%02x (value = %d)\n", G_STRFUNC,
-                   ev.code, ev.value);
+                   ev[n].code, ev[n].value);
           break;
 
         default:
@@ -24,10 +24,12 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <glib/gstdio.h>
 
@@ -44,6 +46,8 @@
 #define GIMP_ENABLE_CONTROLLER_UNDER_CONSTRUCTION
 #include "libgimpwidgets/gimpcontroller.h"
 
+#include "controller-reader.h"
+
 #include "libgimp/libgimp-intl.h"
 
 
@@ -74,27 +78,26 @@ typedef struct _ControllerMidiClass ControllerMidiClass;
 
 struct _ControllerMidi
 {
-  GimpController  parent_instance;
+  GimpController    parent_instance;
 
-  gchar          *device;
-  gint            midi_channel;
+  gchar            *device;
+  gint              midi_channel;
 
-  GIOChannel     *io;
-  guint           io_id;
+  gint              fd;
+  ControllerReader *reader;
 
 #ifdef HAVE_ALSA
-  snd_seq_t      *sequencer;
-  guint           seq_id;
+  snd_seq_t        *sequencer;
 #endif
 
   /* midi status */
-  gboolean        swallow;
-  gint            command;
-  gint            channel;
-  gint            key;
-  gint            velocity;
-  gint            msb;
-  gint            lsb;
+  gboolean          swallow;
+  gint              command;
+  gint              channel;
+  gint              key;
+  gint              velocity;
+  gint              msb;
+  gint              lsb;
 };
 
 struct _ControllerMidiClass
@@ -123,38 +126,20 @@ static const gchar * midi_get_event_blurb     (GimpController *controller,
 
 static gboolean      midi_set_device          (ControllerMidi *controller,
                                                const gchar    *device);
-static void          midi_event               (ControllerMidi *midi,
-                                               gint            channel,
-                                               gint            event_id,
-                                               gdouble         value);
+static void          midi_event               (ControllerMidi       *midi,
+                                               gint                  channel,
+                                               gint                  event_id,
+                                               gdouble               value,
+                                               ControllerReaderMode  mode);
 
-static gboolean      midi_read_event          (GIOChannel     *io,
-                                               GIOCondition    cond,
-                                               gpointer        data);
+static gboolean      midi_read_event          (ControllerReader  *reader,
+                                               gpointer           data,
+                                               GError           **error);
 
 #ifdef HAVE_ALSA
-static gboolean      midi_alsa_prepare        (GSource        *source,
-                                               gint           *timeout);
-static gboolean      midi_alsa_check          (GSource        *source);
-static gboolean      midi_alsa_dispatch       (GSource        *source,
-                                               GSourceFunc     callback,
-                                               gpointer        user_data);
-
-static GSourceFuncs alsa_source_funcs =
-{
-  midi_alsa_prepare,
-  midi_alsa_check,
-  midi_alsa_dispatch,
-  NULL
-};
-
-typedef struct _GAlsaSource GAlsaSource;
-
-struct _GAlsaSource
-{
-  GSource         source;
-  ControllerMidi *controller;
-};
+static gboolean      midi_alsa_read_event     (ControllerReader  *reader,
+                                               gpointer           data,
+                                               GError           **error);
 #endif /* HAVE_ALSA */
 
 static const GimpModuleInfo midi_info =
@@ -241,11 +226,10 @@ controller_midi_init (ControllerMidi *midi)
 {
   midi->device       = NULL;
   midi->midi_channel = -1;
-  midi->io           = NULL;
-  midi->io_id        = 0;
+  midi->fd           = -1;
+  midi->reader       = NULL;
 #ifdef HAVE_ALSA
   midi->sequencer    = NULL;
-  midi->seq_id       = 0;
 #endif
 
   midi->swallow      = TRUE; /* get rid of data bytes at start of stream */
@@ -371,34 +355,37 @@ static gboolean
 midi_set_device (ControllerMidi *midi,
                  const gchar    *device)
 {
-  midi->swallow  = TRUE;
-  midi->command  = 0x0;
-  midi->channel  = 0x0;
-  midi->key      = -1;
-  midi->velocity = -1;
-  midi->msb      = -1;
-  midi->lsb      = -1;
+  GError *error = NULL;
 
-  if (midi->io)
+  /*  stop the reader thread before touching the midi status  */
+  if (midi->reader)
     {
-      g_source_remove (midi->io_id);
-      midi->io_id = 0;
+      controller_reader_free (midi->reader);
+      midi->reader = NULL;
+    }
 
-      g_io_channel_unref (midi->io);
-      midi->io = NULL;
+  if (midi->fd >= 0)
+    {
+      close (midi->fd);
+      midi->fd = -1;
     }
 
 #ifdef HAVE_ALSA
-  if (midi->seq_id)
+  if (midi->sequencer)
     {
-      g_source_remove (midi->seq_id);
-      midi->seq_id = 0;
-
       snd_seq_close (midi->sequencer);
       midi->sequencer = NULL;
     }
 #endif /* HAVE_ALSA */
 
+  midi->swallow  = TRUE;
+  midi->command  = 0x0;
+  midi->channel  = 0x0;
+  midi->key      = -1;
+  midi->velocity = -1;
+  midi->msb      = -1;
+  midi->lsb      = -1;
+
   if (midi->device)
     g_free (midi->device);
 
@@ -413,10 +400,11 @@ midi_set_device (ControllerMidi *midi,
 #ifdef HAVE_ALSA
       if (! g_ascii_strcasecmp (midi->device, "alsa"))
         {
-          GSource *event_source;
-          gchar   *alsa;
-          gchar   *state;
-          gint     ret;
+          struct pollfd *pfds;
+          gint           n_pfds;
+          gchar         *alsa;
+          gchar         *state;
+          gint           ret;
 
           ret = snd_seq_open (&midi->sequencer, "default",
                               SND_SEQ_OPEN_INPUT, 0);
@@ -456,15 +444,34 @@ midi_set_device (ControllerMidi *midi,
           g_object_set (midi, "state", state, NULL);
           g_free (state);
 
-          event_source = g_source_new (&alsa_source_funcs,
-                                       sizeof (GAlsaSource));
+          snd_seq_nonblock (midi->sequencer, 1);
+
+          n_pfds = snd_seq_poll_descriptors_count (midi->sequencer, POLLIN);
+          pfds   = g_new0 (struct pollfd, n_pfds);
+
+          snd_seq_poll_descriptors (midi->sequencer, pfds, n_pfds, POLLIN);
+
+          midi->reader = controller_reader_new (GIMP_CONTROLLER (midi),
+                                                midi_get_n_events (GIMP_CONTROLLER (midi)),
+                                                pfds, n_pfds,
+                                                midi_alsa_read_event, midi,
+                                                &error);
+          g_free (pfds);
+
+          if (midi->reader)
+            return TRUE;
+
+          snd_seq_close (midi->sequencer);
+          midi->sequencer = NULL;
 
-          ((GAlsaSource *) event_source)->controller = midi;
+          state = g_strdup_printf (_("Device not available: %s"),
+                                   error->message);
+          g_object_set (midi, "state", state, NULL);
+          g_free (state);
 
-          midi->seq_id = g_source_attach (event_source, NULL);
-          g_source_unref (event_source);
+          g_clear_error (&error);
 
-          return TRUE;
+          return FALSE;
         }
 #endif /* HAVE_ALSA */
 
@@ -476,20 +483,34 @@ midi_set_device (ControllerMidi *midi,
 
       if (fd >= 0)
         {
-          gchar *state = g_strdup_printf (_("Reading from %s"), midi->device);
+          struct pollfd  pfd   = { fd, POLLIN, 0 };
+          gchar         *state = g_strdup_printf (_("Reading from %s"),
+                                                  midi->device);
           g_object_set (midi, "state", state, NULL);
           g_free (state);
 
-          midi->io = g_io_channel_unix_new (fd);
-          g_io_channel_set_close_on_unref (midi->io, TRUE);
-          g_io_channel_set_encoding (midi->io, NULL, NULL);
+          /*  read on a thread of its own so that events don't pile up
+           *  while the main loop is busy
+           */
+          midi->fd     = fd;
+          midi->reader = controller_reader_new (GIMP_CONTROLLER (midi),
+                                                midi_get_n_events (GIMP_CONTROLLER (midi)),
+                                                &pfd, 1,
+                                                midi_read_event, midi,
+                                                &error);
+
+          if (midi->reader)
+            return TRUE;
 
-          midi->io_id = g_io_add_watch (midi->io,
-                                        G_IO_IN  | G_IO_ERR |
-                                        G_IO_HUP | G_IO_NVAL,
-                                        midi_read_event,
-                                        midi);
-          return TRUE;
+          close (fd);
+          midi->fd = -1;
+
+          state = g_strdup_printf (_("Device not available: %s"),
+                                   error->message);
+          g_object_set (midi, "state", state, NULL);
+          g_free (state);
+
+          g_clear_error (&error);
         }
       else
         {
@@ -507,82 +528,53 @@ midi_set_device (ControllerMidi *midi,
   return FALSE;
 }
 
+/*  runs on the reader thread, notes are queued one by one while
+ *  controller changes replace the ones not yet delivered
+ */
 static void
-midi_event (ControllerMidi *midi,
-            gint            channel,
-            gint            event_id,
-            gdouble         value)
+midi_event (ControllerMidi       *midi,
+            gint                  channel,
+            gint                  event_id,
+            gdouble               value,
+            ControllerReaderMode  mode)
 {
   if (channel == -1            ||
       midi->midi_channel == -1 ||
       channel == midi->midi_channel)
     {
-      GimpControllerEvent event = { 0, };
-
-      event.any.type     = GIMP_CONTROLLER_EVENT_VALUE;
-      event.any.source   = GIMP_CONTROLLER (midi);
-      event.any.event_id = event_id;
-
-      g_value_init (&event.value.value, G_TYPE_DOUBLE);
-      g_value_set_double (&event.value.value, value);
-
-      gimp_controller_event (GIMP_CONTROLLER (midi), &event);
-
-      g_value_unset (&event.value.value);
+      controller_reader_value (midi->reader, event_id, value, mode,
+                               g_get_monotonic_time ());
     }
 }
 
 
 #define D(stmnt) stmnt;
 
-gboolean
-midi_read_event (GIOChannel   *io,
-                 GIOCondition  cond,
-                 gpointer      data)
+static gboolean
+midi_read_event (ControllerReader  *reader,
+                 gpointer           data,
+                 GError           **error)
 {
   ControllerMidi *midi = CONTROLLER_MIDI (data);
-  GIOStatus       status;
-  GError         *error = NULL;
-  guchar          buf[0xf];
-  gsize           size;
+  guchar          buf[0xff];
+  gssize          size;
   gint            pos = 0;
 
-  status = g_io_channel_read_chars (io,
-                                    (gchar *) buf,
-                                    sizeof (buf), &size,
-                                    &error);
+  size = read (midi->fd, buf, sizeof (buf));
 
-  switch (status)
+  if (size < 0)
     {
-    case G_IO_STATUS_ERROR:
-    case G_IO_STATUS_EOF:
-      g_source_remove (midi->io_id);
-      midi->io_id = 0;
-
-      g_io_channel_unref (midi->io);
-      midi->io = NULL;
-
-      if (error)
-        {
-          gchar *state = g_strdup_printf (_("Device not available: %s"),
-                                          error->message);
-          g_object_set (midi, "state", state, NULL);
-          g_free (state);
+      if (errno == EINTR || errno == EAGAIN)
+        return TRUE;
 
-          g_clear_error (&error);
-        }
-      else
-        {
-          g_object_set (midi, "state", _("End of file"), NULL);
-        }
+      g_set_error_literal (error, G_FILE_ERROR,
+                           g_file_error_from_errno (errno),
+                           g_strerror (errno));
+      return FALSE;
+    }
+  else if (size == 0)
+    {
       return FALSE;
-      break;
-
-    case G_IO_STATUS_AGAIN:
-      return TRUE;
-
-    default:
-      break;
     }
 
   while (pos < size)
@@ -713,7 +705,8 @@ midi_read_event (GIOChannel   *io,
                           midi->key, midi->velocity));
 
               midi_event (midi, midi->channel, midi->key,
-                          (gdouble) midi->velocity / 127.0);
+                          (gdouble) midi->velocity / 127.0,
+                          CONTROLLER_READER_KEEP);
             }
           else if (midi->command == 0x8)
             {
@@ -721,7 +714,8 @@ midi_read_event (GIOChannel   *io,
                           midi->channel, midi->key, midi->velocity));
 
               midi_event (midi, midi->channel, midi->key + 128,
-                          (gdouble) midi->velocity / 127.0);
+                          (gdouble) midi->velocity / 127.0,
+                          CONTROLLER_READER_KEEP);
             }
           else
             {
@@ -748,7 +742,8 @@ midi_read_event (GIOChannel   *io,
                       midi->channel, midi->key, midi->velocity));
 
           midi_event (midi, midi->channel, midi->key + 128 + 128,
-                      (gdouble) midi->velocity / 127.0);
+                      (gdouble) midi->velocity / 127.0,
+                      CONTROLLER_READER_REPLACE);
 
           midi->key      = -1;
           midi->velocity = -1;
@@ -799,41 +794,19 @@ midi_read_event (GIOChannel   *io,
 
 #ifdef HAVE_ALSA
 static gboolean
-midi_alsa_prepare (GSource *source,
-                   gint    *timeout)
-{
-  ControllerMidi *midi = CONTROLLER_MIDI (((GAlsaSource *) source)->controller);
-  gboolean        ready;
-
-  ready = snd_seq_event_input_pending (midi->sequencer, 1) > 0;
-  *timeout = ready ? 1 : 10;
-
-  return ready;
-}
-
-static gboolean
-midi_alsa_check (GSource *source)
-{
-  ControllerMidi *midi = CONTROLLER_MIDI (((GAlsaSource *) source)->controller);
-
-  return snd_seq_event_input_pending (midi->sequencer, 1) > 0;
-}
-
-static gboolean
-midi_alsa_dispatch (GSource     *source,
-                    GSourceFunc  callback,
-                    gpointer     user_data)
+midi_alsa_read_event (ControllerReader  *reader,
+                      gpointer           data,
+                      GError           **error)
 {
-  ControllerMidi *midi = CONTROLLER_MIDI (((GAlsaSource *) source)->controller);
+  ControllerMidi *midi = CONTROLLER_MIDI (data);
 
   snd_seq_event_t       *event;
   snd_seq_client_info_t *client_info;
   snd_seq_port_info_t   *port_info;
+  gint                   ret;
 
-  if (snd_seq_event_input_pending (midi->sequencer, 1) > 0)
+  while ((ret = snd_seq_event_input (midi->sequencer, &event)) >= 0)
     {
-      snd_seq_event_input (midi->sequencer, &event);
-
       if (event->type == SND_SEQ_EVENT_NOTEON &&
           event->data.note.velocity == 0)
         event->type = SND_SEQ_EVENT_NOTEOFF;
@@ -843,19 +816,22 @@ midi_alsa_dispatch (GSource     *source,
         case SND_SEQ_EVENT_NOTEON:
           midi_event (midi, event->data.note.channel,
                       event->data.note.note,
-                      (gdouble) event->data.note.velocity / 127.0);
+                      (gdouble) event->data.note.velocity / 127.0,
+                      CONTROLLER_READER_KEEP);
           break;
 
         case SND_SEQ_EVENT_NOTEOFF:
           midi_event (midi, event->data.note.channel,
                       event->data.note.note + 128,
-                      (gdouble) event->data.note.velocity / 127.0);
+                      (gdouble) event->data.note.velocity / 127.0,
+                      CONTROLLER_READER_KEEP);
           break;
 
         case SND_SEQ_EVENT_CONTROLLER:
           midi_event (midi, event->data.control.channel,
                       event->data.control.param + 256,
-                      (gdouble) event->data.control.value / 127.0);
+                      (gdouble) event->data.control.value / 127.0,
+                      CONTROLLER_READER_REPLACE);
           break;
 
         case SND_SEQ_EVENT_PORT_SUBSCRIBED:
@@ -883,10 +859,15 @@ midi_alsa_dispatch (GSource     *source,
         default:
           break;
         }
-
-      return TRUE;
     }
 
+  /*  nothing left to read, or the input buffer overran  */
+  if (ret == -EAGAIN || ret == -ENOSPC)
+    return TRUE;
+
+  g_set_error_literal (error, G_FILE_ERROR,
+                       g_file_error_from_errno (-ret),
+                       snd_strerror (ret));
   return FALSE;
 }
 #endif /* HAVE_ALSA */
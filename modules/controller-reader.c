@@ -0,0 +1,378 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995-1997 Spencer Kimball and Peter Mattis
+ *
+ * controller-reader.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+#include <gtk/gtk.h>
+
+#include "libgimpwidgets/gimpwidgets.h"
+
+#define GIMP_ENABLE_CONTROLLER_UNDER_CONSTRUCTION
+#include "libgimpwidgets/gimpcontroller.h"
+
+#include "controller-reader.h"
+
+#include "libgimp/libgimp-intl.h"
+
+
+typedef struct
+{
+  GimpControllerEventType type;
+  gint                    event_id;
+  gdouble                 value;
+  gint64                  time;
+} ReaderEvent;
+
+struct _ControllerReader
+{
+  GimpController       *controller;
+  gint                  n_events;
+
+  struct pollfd        *fds;      /*  the last one is the wakeup pipe  */
+  gint                  n_fds;
+  gint                  wakeup[2];
+
+  ControllerReaderFunc  func;
+  gpointer              user_data;
+
+  GThread              *thread;
+
+  /*  protected by mutex  */
+  GMutex                mutex;
+  GQueue                queue;
+  GList               **pending;  /*  coalescable events, by event_id  */
+  guint                 idle_id;
+  gboolean              done;
+  GError               *error;
+};
+
+
+static gpointer  controller_reader_thread   (gpointer          data);
+static gboolean  controller_reader_dispatch (gpointer          data);
+static void      controller_reader_schedule (ControllerReader *reader);
+
+
+/*  public functions  */
+
+ControllerReader *
+controller_reader_new (GimpController       *controller,
+                       gint                  n_events,
+                       const struct pollfd  *fds,
+                       gint                  n_fds,
+                       ControllerReaderFunc  func,
+                       gpointer              user_data,
+                       GError              **error)
+{
+  ControllerReader *reader;
+  gint              wakeup[2];
+
+  g_return_val_if_fail (GIMP_IS_CONTROLLER (controller), NULL);
+  g_return_val_if_fail (n_events > 0, NULL);
+  g_return_val_if_fail (fds != NULL && n_fds > 0, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (! g_unix_open_pipe (wakeup, FD_CLOEXEC, error))
+    return NULL;
+
+  reader = g_slice_new0 (ControllerReader);
+
+  reader->controller = controller;
+  reader->n_events   = n_events;
+
+  reader->fds   = g_new0 (struct pollfd, n_fds + 1);
+  reader->n_fds = n_fds;
+
+  memcpy (reader->fds, fds, n_fds * sizeof (struct pollfd));
+
+  reader->fds[n_fds].fd     = wakeup[0];
+  reader->fds[n_fds].events = POLLIN;
+
+  reader->wakeup[0] = wakeup[0];
+  reader->wakeup[1] = wakeup[1];
+
+  reader->func      = func;
+  reader->user_data = user_data;
+
+  g_mutex_init (&reader->mutex);
+  g_queue_init (&reader->queue);
+
+  reader->pending = g_new0 (GList *, n_events);
+
+  reader->thread = g_thread_new ("controller-reader",
+                                 controller_reader_thread, reader);
+
+  return reader;
+}
+
+void
+controller_reader_free (ControllerReader *reader)
+{
+  ReaderEvent *event;
+  ssize_t      n_written;
+
+  g_return_if_fail (reader != NULL);
+
+  do
+    n_written = write (reader->wakeup[1], "q", 1);
+  while (n_written < 0 && errno == EINTR);
+
+  g_thread_join (reader->thread);
+
+  /*  the thread is gone, nothing can schedule a dispatch any longer  */
+  if (reader->idle_id)
+    g_source_remove (reader->idle_id);
+
+  while ((event = g_queue_pop_head (&reader->queue)))
+    g_slice_free (ReaderEvent, event);
+
+  g_clear_error (&reader->error);
+
+  close (reader->wakeup[0]);
+  close (reader->wakeup[1]);
+
+  g_mutex_clear (&reader->mutex);
+
+  g_free (reader->pending);
+  g_free (reader->fds);
+
+  g_slice_free (ControllerReader, reader);
+}
+
+/*  to be called from the ControllerReaderFunc only  */
+
+void
+controller_reader_trigger (ControllerReader *reader,
+                           gint              event_id,
+                           gint64            time)
+{
+  ReaderEvent *event;
+
+  g_return_if_fail (reader != NULL);
+
+  event = g_slice_new (ReaderEvent);
+
+  event->type     = GIMP_CONTROLLER_EVENT_TRIGGER;
+  event->event_id = event_id;
+  event->value    = 0.0;
+  event->time     = time;
+
+  g_mutex_lock (&reader->mutex);
+
+  g_queue_push_tail (&reader->queue, event);
+  controller_reader_schedule (reader);
+
+  g_mutex_unlock (&reader->mutex);
+}
+
+void
+controller_reader_value (ControllerReader     *reader,
+                         gint                  event_id,
+                         gdouble               value,
+                         ControllerReaderMode  mode,
+                         gint64                time)
+{
+  ReaderEvent *event;
+
+  g_return_if_fail (reader != NULL);
+
+  if (event_id < 0 || event_id >= reader->n_events)
+    mode = CONTROLLER_READER_KEEP;
+
+  g_mutex_lock (&reader->mutex);
+
+  if (mode != CONTROLLER_READER_KEEP && reader->pending[event_id])
+    {
+      GList *link = reader->pending[event_id];
+
+      event = link->data;
+
+      if (mode == CONTROLLER_READER_ACCUMULATE)
+        event->value += value;
+      else
+        event->value = value;
+
+      event->time = time;
+
+      /*  keep the queue in the order of the last change  */
+      g_queue_unlink (&reader->queue, link);
+      g_queue_push_tail_link (&reader->queue, link);
+    }
+  else
+    {
+      event = g_slice_new (ReaderEvent);
+
+      event->type     = GIMP_CONTROLLER_EVENT_VALUE;
+      event->event_id = event_id;
+      event->value    = value;
+      event->time     = time;
+
+      g_queue_push_tail (&reader->queue, event);
+
+      if (mode != CONTROLLER_READER_KEEP)
+        reader->pending[event_id] = reader->queue.tail;
+    }
+
+  controller_reader_schedule (reader);
+
+  g_mutex_unlock (&reader->mutex);
+}
+
+
+/*  private functions  */
+
+static gpointer
+controller_reader_thread (gpointer data)
+{
+  ControllerReader *reader  = data;
+  GError           *error   = NULL;
+  gboolean          running = TRUE;
+
+  while (running)
+    {
+      gint i;
+
+      if (poll (reader->fds, reader->n_fds + 1, -1) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          g_set_error_literal (&error, G_FILE_ERROR,
+                               g_file_error_from_errno (errno),
+                               g_strerror (errno));
+          break;
+        }
+
+      /*  controller_reader_free() wants us to go away  */
+      if (reader->fds[reader->n_fds].revents)
+        return NULL;
+
+      for (i = 0; i < reader->n_fds; i++)
+        {
+          if (reader->fds[i].revents)
+            {
+              running = reader->func (reader, reader->user_data, &error);
+              break;
+            }
+        }
+    }
+
+  g_mutex_lock (&reader->mutex);
+
+  reader->done  = TRUE;
+  reader->error = error;
+  controller_reader_schedule (reader);
+
+  g_mutex_unlock (&reader->mutex);
+
+  return NULL;
+}
+
+static gboolean
+controller_reader_dispatch (gpointer data)
+{
+  ControllerReader *reader     = data;
+  GimpController   *controller = reader->controller;
+  GQueue            queue;
+  ReaderEvent      *event;
+  gboolean          done;
+  GError           *error;
+
+  g_mutex_lock (&reader->mutex);
+
+  queue = reader->queue;
+  g_queue_init (&reader->queue);
+
+  memset (reader->pending, 0, reader->n_events * sizeof (GList *));
+
+  reader->idle_id = 0;
+
+  done  = reader->done;
+  error = reader->error;
+
+  reader->done  = FALSE;
+  reader->error = NULL;
+
+  g_mutex_unlock (&reader->mutex);
+
+  g_object_ref (controller);
+
+  while ((event = g_queue_pop_head (&queue)))
+    {
+      GimpControllerEvent cevent = { 0, };
+
+      cevent.any.type     = event->type;
+      cevent.any.source   = controller;
+      cevent.any.event_id = event->event_id;
+
+      if (event->type == GIMP_CONTROLLER_EVENT_VALUE)
+        {
+          g_value_init (&cevent.value.value, G_TYPE_DOUBLE);
+          g_value_set_double (&cevent.value.value, event->value);
+
+          gimp_controller_event (controller, &cevent);
+
+          g_value_unset (&cevent.value.value);
+        }
+      else
+        {
+          gimp_controller_event (controller, &cevent);
+        }
+
+      g_slice_free (ReaderEvent, event);
+    }
+
+  if (done)
+    {
+      if (error)
+        {
+          gchar *state = g_strdup_printf (_("Device not available: %s"),
+                                          error->message);
+          g_object_set (controller, "state", state, NULL);
+          g_free (state);
+
+          g_error_free (error);
+        }
+      else
+        {
+          g_object_set (controller, "state", _("End of file"), NULL);
+        }
+    }
+
+  g_object_unref (controller);
+
+  return FALSE;
+}
+
+/*  called with the mutex held  */
+static void
+controller_reader_schedule (ControllerReader *reader)
+{
+  if (! reader->idle_id)
+    reader->idle_id = g_idle_add_full (G_PRIORITY_DEFAULT,
+                                       controller_reader_dispatch,
+                                       reader, NULL);
+}
@@ -0,0 +1,68 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995-1997 Spencer Kimball and Peter Mattis
+ *
+ * controller-reader.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CONTROLLER_READER_H__
+#define __CONTROLLER_READER_H__
+
+
+/*  Reads a controller's device on a thread of its own and queues the
+ *  events for the main loop, so that they don't pile up while the
+ *  main thread is busy.  Value events which are still in the queue
+ *  when a new value for the same event arrives are coalesced, only
+ *  the latest state is delivered.  Include <poll.h> before this file.
+ */
+
+typedef struct _ControllerReader ControllerReader;
+
+typedef enum
+{
+  CONTROLLER_READER_KEEP,       /*  queue every value                    */
+  CONTROLLER_READER_REPLACE,    /*  keep the latest of queued values     */
+  CONTROLLER_READER_ACCUMULATE  /*  sum up queued values (relative axes) */
+} ControllerReaderMode;
+
+/*  Called on the reader thread when one of the polled fds becomes
+ *  readable.  Return FALSE to stop reading, with @error set unless
+ *  the end of the stream was reached.
+ */
+typedef gboolean (* ControllerReaderFunc) (ControllerReader  *reader,
+                                           gpointer           user_data,
+                                           GError           **error);
+
+
+ControllerReader * controller_reader_new     (GimpController       *controller,
+                                              gint                  n_events,
+                                              const struct pollfd  *fds,
+                                              gint                  n_fds,
+                                              ControllerReaderFunc  func,
+                                              gpointer              user_data,
+                                              GError              **error);
+void               controller_reader_free    (ControllerReader     *reader);
+
+void               controller_reader_trigger (ControllerReader     *reader,
+                                              gint                  event_id,
+                                              gint64                time);
+void               controller_reader_value   (ControllerReader     *reader,
+                                              gint                  event_id,
+                                              gdouble               value,
+                                              ControllerReaderMode  mode,
+                                              gint64                time);
+
+
+#endif /* __CONTROLLER_READER_H__ */
@@ -0,0 +1,351 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995-1997 Spencer Kimball and Peter Mattis
+ *
+ * display-filter-clut.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>  /* lcms.h uses the "inline" keyword */
+
+#ifdef G_OS_WIN32
+#define STRICT
+#include <windows.h>
+#define LCMS_WIN_TYPES_ALREADY_DEFINED
+#endif
+
+#include <lcms.h>
+
+#include <cairo.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpcolor/gimpcolor.h"
+
+#include "display-filter-clut.h"
+
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define CDISPLAY_CLUT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+/*  number of grid points per channel  */
+#define CLUT_GRID     33
+
+/*  the table holds 8 bit values in 8.7 fixed point, so that a value
+ *  times an interpolation weight (0 - 256) fits into 16 bit math
+ */
+#define CLUT_SHIFT    7
+#define WEIGHT_SHIFT  8
+
+#define STRIDE_B      4
+#define STRIDE_G      (STRIDE_B * CLUT_GRID)
+#define STRIDE_R      (STRIDE_G * CLUT_GRID)
+
+
+struct _CdisplayClut
+{
+  gint16  *table;       /*  R, G, B and padding for every grid point     */
+  gint     offset[256]; /*  table offset of the cell below each value    */
+  gint     weight[256]; /*  the value's position in that cell, 0 - 256   */
+  gboolean use_sse2;
+};
+
+
+/**
+ * cdisplay_clut_new:
+ * @transform: an lcms transform from %TYPE_RGB_16 to %TYPE_RGB_16
+ *
+ * Samples @transform on a regular grid.  The transform is not needed
+ * afterwards.
+ *
+ * Return value: the lookup table, free with cdisplay_clut_free().
+ **/
+CdisplayClut *
+cdisplay_clut_new (cmsHTRANSFORM transform)
+{
+  CdisplayClut *clut;
+  WORD         *samples;
+  gint          n_points = CLUT_GRID * CLUT_GRID * CLUT_GRID;
+  gint          r, g, b;
+  gint          i;
+
+  g_return_val_if_fail (transform != NULL, NULL);
+
+  clut = g_slice_new0 (CdisplayClut);
+
+  clut->table = g_new (gint16, 4 * n_points);
+
+  samples = g_new (WORD, 3 * n_points);
+
+  for (r = 0, i = 0; r < CLUT_GRID; r++)
+    for (g = 0; g < CLUT_GRID; g++)
+      for (b = 0; b < CLUT_GRID; b++, i += 3)
+        {
+          samples[i + 0] = r * 65535 / (CLUT_GRID - 1);
+          samples[i + 1] = g * 65535 / (CLUT_GRID - 1);
+          samples[i + 2] = b * 65535 / (CLUT_GRID - 1);
+        }
+
+  cmsDoTransform (transform, samples, samples, n_points);
+
+  for (i = 0; i < n_points; i++)
+    {
+      gint c;
+
+      for (c = 0; c < 3; c++)
+        clut->table[4 * i + c] = (((guint) samples[3 * i + c] *
+                                   (255 << CLUT_SHIFT) + 32767) / 65535);
+
+      clut->table[4 * i + 3] = 0;
+    }
+
+  g_free (samples);
+
+  for (i = 0; i < 256; i++)
+    {
+      gint pos  = i * (CLUT_GRID - 1);
+      gint cell = pos / 255;
+
+      /*  keep the top value in the last cell, so cell + 1 exists  */
+      if (cell == CLUT_GRID - 1)
+        {
+          clut->offset[i] = (cell - 1) * STRIDE_B;
+          clut->weight[i] = 1 << WEIGHT_SHIFT;
+        }
+      else
+        {
+          clut->offset[i] = cell * STRIDE_B;
+          clut->weight[i] = (((pos % 255) << WEIGHT_SHIFT) + 127) / 255;
+        }
+    }
+
+#ifdef CDISPLAY_CLUT_SSE2
+  clut->use_sse2 = (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2);
+#endif
+
+  return clut;
+}
+
+void
+cdisplay_clut_free (CdisplayClut *clut)
+{
+  g_return_if_fail (clut != NULL);
+
+  g_free (clut->table);
+
+  g_slice_free (CdisplayClut, clut);
+}
+
+/*  Picks the tetrahedron of the cell containing r, g, b and the
+ *  weights of its four corners.
+ */
+static inline const gint16 *
+cdisplay_clut_tetrahedron (const CdisplayClut  *clut,
+                           guint                r,
+                           guint                g,
+                           guint                b,
+                           const gint16       **c1,
+                           const gint16       **c2,
+                           const gint16       **c3,
+                           gint                *w)
+{
+  const gint16 *c0;
+  gint          fr = clut->weight[r];
+  gint          fg = clut->weight[g];
+  gint          fb = clut->weight[b];
+
+  c0 = clut->table + (clut->offset[r] * CLUT_GRID * CLUT_GRID +
+                      clut->offset[g] * CLUT_GRID +
+                      clut->offset[b]);
+
+  *c3 = c0 + STRIDE_R + STRIDE_G + STRIDE_B;
+
+  if (fr >= fg)
+    {
+      if (fg >= fb)
+        {
+          *c1 = c0 + STRIDE_R;
+          *c2 = c0 + STRIDE_R + STRIDE_G;
+          w[0] = 256 - fr; w[1] = fr - fg; w[2] = fg - fb; w[3] = fb;
+        }
+      else if (fr >= fb)
+        {
+          *c1 = c0 + STRIDE_R;
+          *c2 = c0 + STRIDE_R + STRIDE_B;
+          w[0] = 256 - fr; w[1] = fr - fb; w[2] = fb - fg; w[3] = fg;
+        }
+      else
+        {
+          *c1 = c0 + STRIDE_B;
+          *c2 = c0 + STRIDE_R + STRIDE_B;
+          w[0] = 256 - fb; w[1] = fb - fr; w[2] = fr - fg; w[3] = fg;
+        }
+    }
+  else
+    {
+      if (fb >= fg)
+        {
+          *c1 = c0 + STRIDE_B;
+          *c2 = c0 + STRIDE_G + STRIDE_B;
+          w[0] = 256 - fb; w[1] = fb - fg; w[2] = fg - fr; w[3] = fr;
+        }
+      else if (fb >= fr)
+        {
+          *c1 = c0 + STRIDE_G;
+          *c2 = c0 + STRIDE_G + STRIDE_B;
+          w[0] = 256 - fg; w[1] = fg - fb; w[2] = fb - fr; w[3] = fr;
+        }
+      else
+        {
+          *c1 = c0 + STRIDE_G;
+          *c2 = c0 + STRIDE_R + STRIDE_G;
+          w[0] = 256 - fg; w[1] = fg - fr; w[2] = fr - fb; w[3] = fb;
+        }
+    }
+
+  return c0;
+}
+
+#define CLUT_ROUND  (1 << (CLUT_SHIFT + WEIGHT_SHIFT - 1))
+
+static inline void
+cdisplay_clut_lookup (const CdisplayClut *clut,
+                      guint              *r,
+                      guint              *g,
+                      guint              *b)
+{
+  const gint16 *c0, *c1, *c2, *c3;
+  gint          w[4];
+
+  c0 = cdisplay_clut_tetrahedron (clut, *r, *g, *b, &c1, &c2, &c3, w);
+
+#define INTERPOLATE(c) \
+  ((w[0] * c0[c] + w[1] * c1[c] + w[2] * c2[c] + w[3] * c3[c] + \
+    CLUT_ROUND) >> (CLUT_SHIFT + WEIGHT_SHIFT))
+
+  *r = INTERPOLATE (0);
+  *g = INTERPOLATE (1);
+  *b = INTERPOLATE (2);
+
+#undef INTERPOLATE
+}
+
+#ifdef CDISPLAY_CLUT_SSE2
+static inline void
+cdisplay_clut_lookup_sse2 (const CdisplayClut *clut,
+                           guint              *r,
+                           guint              *g,
+                           guint              *b)
+{
+  const gint16 *c0, *c1, *c2, *c3;
+  gint          w[4];
+  __m128i       v01, v23;
+  __m128i       sum;
+  guint32       rgb;
+
+  c0 = cdisplay_clut_tetrahedron (clut, *r, *g, *b, &c1, &c2, &c3, w);
+
+  /*  interleave the corners pairwise, so a multiply-add of each pair
+   *  of 16 bit lanes does two corners of a channel at once
+   */
+  v01 = _mm_unpacklo_epi16 (_mm_loadl_epi64 ((const __m128i *) c0),
+                            _mm_loadl_epi64 ((const __m128i *) c1));
+  v23 = _mm_unpacklo_epi16 (_mm_loadl_epi64 ((const __m128i *) c2),
+                            _mm_loadl_epi64 ((const __m128i *) c3));
+
+  sum = _mm_add_epi32 (_mm_madd_epi16 (v01,
+                                       _mm_set1_epi32 (w[0] | (w[1] << 16))),
+                       _mm_madd_epi16 (v23,
+                                       _mm_set1_epi32 (w[2] | (w[3] << 16))));
+
+  sum = _mm_srli_epi32 (_mm_add_epi32 (sum, _mm_set1_epi32 (CLUT_ROUND)),
+                        CLUT_SHIFT + WEIGHT_SHIFT);
+
+  sum = _mm_packs_epi32 (sum, sum);
+  sum = _mm_packus_epi16 (sum, sum);
+
+  rgb = _mm_cvtsi128_si32 (sum);
+
+  *r = rgb & 0xff;
+  *g = (rgb >> 8) & 0xff;
+  *b = (rgb >> 16) & 0xff;
+}
+#endif
+
+/**
+ * cdisplay_clut_convert_surface:
+ * @clut:    a #CdisplayClut
+ * @surface: a %CAIRO_FORMAT_ARGB32 image surface
+ *
+ * Maps the colors of @surface through the lookup table.  Opaque
+ * pixels, the common case on the canvas, skip the conversion from
+ * and to premultiplied alpha.
+ **/
+void
+cdisplay_clut_convert_surface (CdisplayClut    *clut,
+                               cairo_surface_t *surface)
+{
+  gint    width  = cairo_image_surface_get_width (surface);
+  gint    height = cairo_image_surface_get_height (surface);
+  gint    stride = cairo_image_surface_get_stride (surface);
+  guchar *buf    = cairo_image_surface_get_data (surface);
+  gint    x, y;
+
+  g_return_if_fail (clut != NULL);
+
+  if (cairo_image_surface_get_format (surface) != CAIRO_FORMAT_ARGB32)
+    return;
+
+  for (y = 0; y < height; y++, buf += stride)
+    {
+      guint32 *pixel = (guint32 *) buf;
+
+      for (x = 0; x < width; x++)
+        {
+          guint32 p = pixel[x];
+          guint   r, g, b, a;
+
+          a = p >> 24;
+
+          if (a == 0)
+            continue;
+
+          if (a == 255)
+            {
+              r = (p >> 16) & 0xff;
+              g = (p >>  8) & 0xff;
+              b =  p        & 0xff;
+            }
+          else
+            {
+              GIMP_CAIRO_ARGB32_GET_PIXEL (buf + 4 * x, r, g, b, a);
+            }
+
+#ifdef CDISPLAY_CLUT_SSE2
+          if (clut->use_sse2)
+            cdisplay_clut_lookup_sse2 (clut, &r, &g, &b);
+          else
+#endif
+            cdisplay_clut_lookup (clut, &r, &g, &b);
+
+          if (a == 255)
+            pixel[x] = 0xff000000 | (r << 16) | (g << 8) | b;
+          else
+            GIMP_CAIRO_ARGB32_SET_PIXEL (buf + 4 * x, r, g, b, a);
+        }
+    }
+}
@@ -0,0 +1,38 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995-1997 Spencer Kimball and Peter Mattis
+ *
+ * display-filter-clut.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DISPLAY_FILTER_CLUT_H__
+#define __DISPLAY_FILTER_CLUT_H__
+
+
+/*  A 3D color lookup table sampled from an lcms transform, applied
+ *  with tetrahedral interpolation.  Include <lcms.h> before this file.
+ */
+
+typedef struct _CdisplayClut CdisplayClut;
+
+
+CdisplayClut * cdisplay_clut_new             (cmsHTRANSFORM    transform);
+void           cdisplay_clut_free            (CdisplayClut    *clut);
+
+void           cdisplay_clut_convert_surface (CdisplayClut    *clut,
+                                              cairo_surface_t *surface);
+
+
+#endif /* __DISPLAY_FILTER_CLUT_H__ */
@@ -42,6 +42,8 @@
 #include "libgimpmodule/gimpmodule.h"
 #include "libgimpwidgets/gimpwidgets.h"
 
+#include "display-filter-clut.h"
+
 #include "libgimp/libgimp-intl.h"
 
 
@@ -60,6 +62,7 @@ struct _CdisplayLcms
   GimpColorDisplay  parent_instance;
 
   cmsHTRANSFORM     transform;
+  CdisplayClut     *clut;
 };
 
 struct _CdisplayLcmsClass
@@ -147,6 +150,7 @@ static void
 cdisplay_lcms_init (CdisplayLcms *lcms)
 {
   lcms->transform = NULL;
+  lcms->clut      = NULL;
 }
 
 static void
@@ -160,6 +164,12 @@ cdisplay_lcms_finalize (GObject *object)
       lcms->transform = NULL;
     }
 
+  if (lcms->clut)
+    {
+      cdisplay_clut_free (lcms->clut);
+      lcms->clut = NULL;
+    }
+
   G_OBJECT_CLASS (cdisplay_lcms_parent_class)->finalize (object);
 }
 
@@ -270,6 +280,12 @@ cdisplay_lcms_convert_surface (GimpColorDisplay *display,
   if (fmt != CAIRO_FORMAT_ARGB32)
     return;
 
+  if (lcms->clut)
+    {
+      cdisplay_clut_convert_surface (lcms->clut, surface);
+      return;
+    }
+
   if (! lcms->transform)
     return;
 
@@ -322,6 +338,12 @@ cdisplay_lcms_changed (GimpColorDisplay *display)
       lcms->transform = NULL;
     }
 
+  if (lcms->clut)
+    {
+      cdisplay_clut_free (lcms->clut);
+      lcms->clut = NULL;
+    }
+
   if (! config)
     return;
 
@@ -373,6 +395,25 @@ cdisplay_lcms_changed (GimpColorDisplay *display)
                                                     config->simulation_intent,
                                                     config->display_intent,
                                                     flags);
+
+      /*  the gamut alarm color can't be interpolated  */
+      if (! (flags & cmsFLAGS_GAMUTCHECK))
+        {
+          cmsHTRANSFORM transform;
+
+          transform = cmsCreateProofingTransform (src_profile, TYPE_RGB_16,
+                                                  dest_profile, TYPE_RGB_16,
+                                                  proof_profile,
+                                                  config->simulation_intent,
+                                                  config->display_intent,
+                                                  flags);
+          if (transform)
+            {
+              lcms->clut = cdisplay_clut_new (transform);
+              cmsDeleteTransform (transform);
+            }
+        }
+
       cmsCloseProfile (proof_profile);
     }
   else if (src_profile || dest_profile)
@@ -387,6 +428,21 @@ cdisplay_lcms_changed (GimpColorDisplay *display)
                                             dest_profile, TYPE_ARGB_8,
                                             config->display_intent,
                                             flags);
+
+      if (lcms->transform)
+        {
+          cmsHTRANSFORM transform;
+
+          transform = cmsCreateTransform (src_profile, TYPE_RGB_16,
+                                          dest_profile, TYPE_RGB_16,
+                                          config->display_intent,
+                                          flags);
+          if (transform)
+            {
+              lcms->clut = cdisplay_clut_new (transform);
+              cmsDeleteTransform (transform);
+            }
+        }
     }
 
   if (dest_profile)
@@ -31,6 +31,8 @@
 #include "libgimpmodule/gimpmodule.h"
 #include "libgimpwidgets/gimpwidgets.h"
 
+#include "display-filter-clut.h"
+
 #include "libgimp/libgimp-intl.h"
 
 #define CDISPLAY_TYPE_PROOF            (cdisplay_proof_get_type ())
@@ -52,6 +54,7 @@ struct _CdisplayProof
   gchar            *profile;
 
   cmsHTRANSFORM     transform;
+  CdisplayClut     *clut;
 };
 
 struct _CdisplayProofClass
@@ -159,6 +162,7 @@ static void
 cdisplay_proof_init (CdisplayProof *proof)
 {
   proof->transform = NULL;
+  proof->clut      = NULL;
   proof->profile   = NULL;
 }
 
@@ -179,6 +183,12 @@ cdisplay_proof_finalize (GObject *object)
       proof->transform = NULL;
     }
 
+  if (proof->clut)
+    {
+      cdisplay_clut_free (proof->clut);
+      proof->clut = NULL;
+    }
+
   G_OBJECT_CLASS (cdisplay_proof_parent_class)->finalize (object);
 }
 
@@ -252,6 +262,12 @@ cdisplay_proof_convert_surface (GimpColorDisplay *display,
   if (fmt != CAIRO_FORMAT_ARGB32)
     return;
 
+  if (proof->clut)
+    {
+      cdisplay_clut_convert_surface (proof->clut, surface);
+      return;
+    }
+
   if (! proof->transform)
     return;
 
@@ -457,6 +473,12 @@ cdisplay_proof_changed (GimpColorDisplay *display)
       proof->transform = NULL;
     }
 
+  if (proof->clut)
+    {
+      cdisplay_clut_free (proof->clut);
+      proof->clut = NULL;
+    }
+
   if (! proof->profile)
     return;
 
@@ -478,6 +500,23 @@ cdisplay_proof_changed (GimpColorDisplay *display)
                                                      proof->intent,
                                                      flags);
 
+      if (proof->transform)
+        {
+          cmsHTRANSFORM transform;
+
+          transform = cmsCreateProofingTransform (rgbProfile, TYPE_RGB_16,
+                                                  rgbProfile, TYPE_RGB_16,
+                                                  proofProfile,
+                                                  proof->intent,
+                                                  proof->intent,
+                                                  flags);
+          if (transform)
+            {
+              proof->clut = cdisplay_clut_new (transform);
+              cmsDeleteTransform (transform);
+            }
+        }
+
       cmsCloseProfile (proofProfile);
     }
 
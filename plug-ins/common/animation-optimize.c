@@ -35,6 +35,11 @@
 
 #include "libgimp/stdplugins-intl.h"
 
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define OPTIMIZE_SSE2 1
+#include <emmintrin.h>
+#endif
+
 
 #define OPTIMIZE_PROC        "plug-in-animationoptimize"
 #define OPTIMIZE_DIFF_PROC   "plug-in-animationoptimize-diff"
@@ -42,6 +47,10 @@
 #define REMOVE_BACKDROP_PROC "plug-in-animation-remove-backdrop"
 #define FIND_BACKDROP_PROC   "plug-in-animation-find-backdrop"
 
+/* Rows, or columns, handed to the threads at a time */
+#define OPTIMIZE_BAND_HEIGHT  32
+#define OPTIMIZE_BAND_WIDTH   64
+
 
 typedef enum
 {
@@ -60,6 +69,56 @@ typedef enum
 } operatingMode;
 
 
+typedef void (* OptimizeBandFunc) (gint     start,
+                                   gint     end,
+                                   gpointer data);
+
+typedef struct
+{
+  OptimizeBandFunc func;
+  gpointer         data;
+  gint             n_items;
+  gint             band_size;
+} OptimizeDistribute;
+
+
+typedef struct
+{
+  gint32 left, top, right, bottom;
+} OptimizeBox;
+
+/* What changed in a band of rows since the last frame */
+typedef struct
+{
+  OptimizeBox  bbox;         /* pixels to keep                   */
+  OptimizeBox  rbox;         /* opaque pixels                    */
+  gboolean     can_combine;  /* no opaque pixel became clear     */
+} OptimizeDiff;
+
+typedef struct
+{
+  guchar        *this_frame;
+  const guchar  *last_frame;
+  guchar        *opti_frame;
+  const guchar  *back_frame;  /* NULL unless removing the background */
+  gboolean       diff;        /* compare with last_frame             */
+  OptimizeDiff  *bands;
+} OptimizeFrame;
+
+/* The statistical mode of the pixels of a row over all frames */
+typedef struct
+{
+  guchar **these_rows;
+  guchar **red;
+  guchar **green;
+  guchar **blue;
+  guint  **count;
+  guint   *num_colours;
+  guchar  *back_row;
+  gint     n_empty;
+} OptimizeBackground;
+
+
 /* Declare local functions. */
 static  void query (void);
 static  void run   (const gchar      *name,
@@ -390,6 +449,351 @@ compose_row (gint          frame_num,
 }
 
 
+/* Threading */
+
+/* Runs a band, called by gimp_parallel_run() */
+static void
+optimize_band (gint                band,
+               gint                n_bands,
+               gint                thread,
+               OptimizeDistribute *dist)
+{
+  gint start = band * dist->band_size;
+
+  dist->func (start, MIN (start + dist->band_size, dist->n_items), dist->data);
+}
+
+/* Calls func for bands of band_size of n_items, on as many threads as
+ * there are processors.  func must not talk to the core.
+ */
+static void
+optimize_distribute (gint             n_items,
+                     gint             band_size,
+                     OptimizeBandFunc func,
+                     gpointer         data)
+{
+  OptimizeDistribute dist;
+
+  dist.func      = func;
+  dist.data      = data;
+  dist.n_items   = n_items;
+  dist.band_size = band_size;
+
+  gimp_parallel_run ((n_items + band_size - 1) / band_size,
+                     (GimpParallelFunc) optimize_band, &dist, FALSE);
+}
+
+
+/* Frame differencing */
+
+static inline void
+optimize_box_add (OptimizeBox *box,
+                  gint32       x,
+                  gint32       y)
+{
+  if (x < box->left)   box->left   = x;
+  if (x > box->right)  box->right  = x;
+  if (y < box->top)    box->top    = y;
+  if (y > box->bottom) box->bottom = y;
+}
+
+static void
+optimize_box_merge (OptimizeBox       *box,
+                    const OptimizeBox *other)
+{
+  box->left   = MIN (box->left,   other->left);
+  box->top    = MIN (box->top,    other->top);
+  box->right  = MAX (box->right,  other->right);
+  box->bottom = MAX (box->bottom, other->bottom);
+}
+
+/* Returns how many of the first n pixels are the same in a and b */
+static gint
+count_equal_pixels (const guchar *a,
+                    const guchar *b,
+                    gint          n)
+{
+  gint i = 0;
+  gint byteit;
+
+#ifdef OPTIMIZE_SSE2
+  /*  16 bytes are 4 or 8 whole pixels  */
+  gint chunk = 16 / pixelstep;
+
+  for (; i + chunk <= n; i += chunk)
+    {
+      __m128i va = _mm_loadu_si128 ((const __m128i *) (a + i * pixelstep));
+      __m128i vb = _mm_loadu_si128 ((const __m128i *) (b + i * pixelstep));
+
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (va, vb)) != 0xffff)
+        break;
+    }
+#endif
+
+  for (; i < n; i++)
+    {
+      for (byteit = 0; byteit < pixelstep; byteit++)
+        {
+          if (a[i * pixelstep + byteit] != b[i * pixelstep + byteit])
+            return i;
+        }
+    }
+
+  return i;
+}
+
+static void
+diff_rows (OptimizeFrame *frame,
+           gint           y1,
+           gint           y2,
+           OptimizeDiff  *diff)
+{
+  gint xit, yit, byteit;
+
+  diff->bbox.left   = width;
+  diff->bbox.top    = height;
+  diff->bbox.right  = 0;
+  diff->bbox.bottom = 0;
+  diff->rbox        = diff->bbox;
+  diff->can_combine = TRUE;
+
+  for (yit = y1; yit < y2; yit++)
+    {
+      const guchar *this_row = frame->this_frame + yit * width * pixelstep;
+      const guchar *last_row = frame->last_frame + yit * width * pixelstep;
+      guchar       *opti_row = frame->opti_frame + yit * width * pixelstep;
+
+      xit = 0;
+
+      while (xit < width)
+        {
+          gint     end;
+          gboolean keep_pix;
+          gboolean opaq_pix;
+
+          /* Pixels which are the same in 'this' and 'last' aren't
+           *  kept, but the opaque ones are still part of the frame.
+           */
+          end = xit + count_equal_pixels (this_row + xit * pixelstep,
+                                          last_row + xit * pixelstep,
+                                          width - xit);
+
+          for (; xit < end; xit++)
+            {
+              if (this_row[xit*pixelstep + pixelstep-1]&128)
+                optimize_box_add (&diff->rbox, xit, yit);
+
+              opti_row[xit*pixelstep + pixelstep-1] = 0;
+            }
+
+          if (xit == width)
+            break;
+
+          /* Check if 'this' and 'last' are transparent */
+          if (!(this_row[xit*pixelstep + pixelstep-1]&128)
+              &&
+              !(last_row[xit*pixelstep + pixelstep-1]&128))
+            {
+              keep_pix = FALSE;
+              opaq_pix = FALSE;
+              goto decided;
+            }
+          /* Check if just 'this' is transparent */
+          if ((last_row[xit*pixelstep + pixelstep-1]&128)
+              &&
+              !(this_row[xit*pixelstep + pixelstep-1]&128))
+            {
+              keep_pix = TRUE;
+              opaq_pix = FALSE;
+              diff->can_combine = FALSE;
+              goto decided;
+            }
+          /* Check if just 'last' is transparent */
+          if (!(last_row[xit*pixelstep + pixelstep-1]&128)
+              &&
+              (this_row[xit*pixelstep + pixelstep-1]&128))
+            {
+              keep_pix = TRUE;
+              opaq_pix = TRUE;
+              goto decided;
+            }
+          /* If 'last' and 'this' are opaque, we have
+           *  to check if they're the same colour - we
+           *  only have to keep the pixel if 'last' or
+           *  'this' are opaque and different.
+           */
+          keep_pix = FALSE;
+          opaq_pix = TRUE;
+          for (byteit=0; byteit<pixelstep-1; byteit++)
+            {
+              if (last_row[xit*pixelstep + byteit] !=
+                  this_row[xit*pixelstep + byteit])
+                {
+                  keep_pix = TRUE;
+                  goto decided;
+                }
+            }
+        decided:
+          if (opaq_pix)
+            optimize_box_add (&diff->rbox, xit, yit);
+
+          if (keep_pix)
+            {
+              optimize_box_add (&diff->bbox, xit, yit);
+            }
+          else
+            {
+              /* pixel didn't change this frame - make
+               *  it transparent in our optimized buffer!
+               */
+              opti_row[xit*pixelstep + pixelstep-1] = 0;
+            }
+
+          xit++;
+        }
+    }
+}
+
+/* Removes the background from, copies and compares a band of rows of
+ * the frame
+ */
+static void
+frame_rows (gint     y1,
+            gint     y2,
+            gpointer data)
+{
+  OptimizeFrame *frame     = data;
+  gint           rowstride = width * pixelstep;
+  gint           xit, yit, byteit;
+
+  if (frame->back_frame)
+    {
+      for (yit=y1; yit<y2; yit++)
+        {
+          for (xit=0; xit<width; xit++)
+            {
+              for (byteit=0; byteit<pixelstep-1; byteit++)
+                {
+                  if (frame->back_frame[yit*rowstride + xit*pixelstep
+                                        + byteit]
+                      !=
+                      frame->this_frame[yit*rowstride + xit*pixelstep
+                                        + byteit])
+                    {
+                      goto enough;
+                    }
+                }
+              frame->this_frame[yit*rowstride + xit*pixelstep
+                                + pixelstep - 1] = 0;
+            enough:
+              /* nop */;
+            }
+        }
+    }
+
+  /* copy 'this' frame into a buffer which we can safely molest */
+  memcpy (frame->opti_frame + y1 * rowstride,
+          frame->this_frame + y1 * rowstride,
+          (y2 - y1) * rowstride);
+
+  if (frame->diff)
+    diff_rows (frame, y1, y2, &frame->bands[y1 / OPTIMIZE_BAND_HEIGHT]);
+}
+
+
+/* Background detection */
+
+/* Finds the most frequent colour of some columns of the current row */
+static void
+find_background_columns (gint     x1,
+                         gint     x2,
+                         gpointer data)
+{
+  OptimizeBackground *bg = data;
+  gint                this_frame_num;
+  gint                i, j;
+
+  for (i=x1; i<x2; i++)
+    bg->num_colours[i] = 0;
+
+  for (this_frame_num=0; this_frame_num<total_frames; this_frame_num++)
+    {
+      const guchar *this_row = bg->these_rows[this_frame_num];
+
+      for (i=x1; i<x2; i++)
+        {
+          if (this_row[i * pixelstep + pixelstep -1] >= 128)
+            {
+              for (j=0; j<bg->num_colours[i]; j++)
+                {
+                  switch (pixelstep)
+                    {
+                    case 4:
+                      if (this_row[i * 4 +0] == bg->red[j][i] &&
+                          this_row[i * 4 +1] == bg->green[j][i] &&
+                          this_row[i * 4 +2] == bg->blue[j][i])
+                        {
+                          (bg->count[j][i])++;
+                          goto same;
+                        }
+                      break;
+                    case 2:
+                      if (this_row[i * 2 +0] == bg->red[j][i])
+                        {
+                          (bg->count[j][i])++;
+                          goto same;
+                        }
+                      break;
+                    default:
+                      g_error ("Eeep!");
+                      break;
+                    }
+                }
+
+              bg->count[bg->num_colours[i]][i] = 1;
+              bg->red[bg->num_colours[i]][i] = this_row[i * pixelstep];
+              if (pixelstep == 4)
+                {
+                  bg->green[bg->num_colours[i]][i] = this_row[i * 4 +1];
+                  bg->blue[bg->num_colours[i]][i]  = this_row[i * 4 +2];
+                }
+              bg->num_colours[i]++;
+            }
+        same:
+          /* nop */;
+        }
+    }
+
+  for (i=x1; i<x2; i++)
+    {
+      guint  best_count = 0;
+      guchar best_r = 255, best_g = 0, best_b = 255;
+
+      for (j=0; j<bg->num_colours[i]; j++)
+        {
+          if (bg->count[j][i] > best_count)
+            {
+              best_count = bg->count[j][i];
+              best_r = bg->red[j][i];
+              best_g = bg->green[j][i];
+              best_b = bg->blue[j][i];
+            }
+        }
+
+      bg->back_row[i*pixelstep + 0] = best_r;
+      if (pixelstep == 4)
+        {
+          bg->back_row[i*pixelstep + 1] = best_g;
+          bg->back_row[i*pixelstep + 2] = best_b;
+        }
+      bg->back_row[i*pixelstep + pixelstep-1] = (best_count == 0) ? 0 : 255;
+
+      if (best_count == 0)
+        g_atomic_int_add (&bg->n_empty, 1);
+    }
+}
+
+
 static gint32
 do_optimizations (GimpRunMode run_mode,
                   gboolean    diff_only)
@@ -420,6 +824,9 @@ do_optimizations (GimpRunMode run_mode,
   gint32         bbox_top, bbox_bottom, bbox_left, bbox_right;
   gint32         rbox_top, rbox_bottom, rbox_left, rbox_right;
 
+  OptimizeFrame  frame;
+  gint           n_bands;
+
   switch (opmode)
     {
     case OPUNOPTIMIZE:
@@ -462,6 +869,13 @@ do_optimizations (GimpRunMode run_mode,
   total_alpha (this_frame, width*height, pixelstep);
   total_alpha (last_frame, width*height, pixelstep);
 
+  n_bands = (height + OPTIMIZE_BAND_HEIGHT - 1) / OPTIMIZE_BAND_HEIGHT;
+
+  frame.this_frame = this_frame;
+  frame.last_frame = last_frame;
+  frame.opti_frame = opti_frame;
+  frame.bands      = g_new (OptimizeDiff, n_bands);
+
   new_image_id = gimp_image_new(width, height, imagetype);
   gimp_image_undo_disable (new_image_id);
 
@@ -477,37 +891,29 @@ do_optimizations (GimpRunMode run_mode,
     {
       /* iterate through all rows of all frames, find statistical
          mode for each pixel position. */
-      gint     i,j;
-      guchar **these_rows;
-      guchar **red;
-      guchar **green;
-      guchar **blue;
-      guint  **count;
-      guint   *num_colours;
-
-      these_rows = g_new (guchar *, total_frames);
-      red =        g_new (guchar *, total_frames);
-      green =      g_new (guchar *, total_frames);
-      blue =       g_new (guchar *, total_frames);
-      count =      g_new (guint *, total_frames);
-
-      num_colours = g_new (guint, width);
+      OptimizeBackground bg;
+
+      bg.these_rows = g_new (guchar *, total_frames);
+      bg.red =        g_new (guchar *, total_frames);
+      bg.green =      g_new (guchar *, total_frames);
+      bg.blue =       g_new (guchar *, total_frames);
+      bg.count =      g_new (guint *, total_frames);
+
+      bg.num_colours = g_new (guint, width);
 
       for (this_frame_num=0; this_frame_num<total_frames; this_frame_num++)
         {
-          these_rows[this_frame_num] = g_malloc(width * pixelstep);
+          bg.these_rows[this_frame_num] = g_malloc(width * pixelstep);
 
-          red[this_frame_num]   = g_new (guchar, width);
-          green[this_frame_num] = g_new (guchar, width);
-          blue[this_frame_num]  = g_new (guchar, width);
+          bg.red[this_frame_num]   = g_new (guchar, width);
+          bg.green[this_frame_num] = g_new (guchar, width);
+          bg.blue[this_frame_num]  = g_new (guchar, width);
 
-          count[this_frame_num] = g_new0(guint, width);
+          bg.count[this_frame_num] = g_new0(guint, width);
         }
 
       for (row = 0; row < height; row++)
         {
-          memset(num_colours, 0, width * sizeof(guint));
-
           for (this_frame_num=0; this_frame_num<total_frames; this_frame_num++)
             {
               drawable =
@@ -518,7 +924,7 @@ do_optimizations (GimpRunMode run_mode,
               compose_row(this_frame_num,
                           dispose,
                           row,
-                          these_rows[this_frame_num],
+                          bg.these_rows[this_frame_num],
                           width,
                           drawable,
                           FALSE
@@ -527,91 +933,16 @@ do_optimizations (GimpRunMode run_mode,
               gimp_drawable_detach(drawable);
             }
 
-          for (this_frame_num=0; this_frame_num<total_frames; this_frame_num++)
-            {
-              for (i=0; i<width; i++)
-                {
-                  if (these_rows[this_frame_num][i * pixelstep + pixelstep -1]
-                      >= 128)
-                    {
-                      for (j=0; j<num_colours[i]; j++)
-                        {
+          /* the columns are independent, so the threads count them */
+          bg.back_row = &back_frame[width * pixelstep * row];
+          bg.n_empty  = 0;
 
-                          switch (pixelstep)
-                            {
-                            case 4:
-                              if (these_rows[this_frame_num][i * 4 +0] ==
-                                  red[j][i] &&
-                                  these_rows[this_frame_num][i * 4 +1] ==
-                                  green[j][i] &&
-                                  these_rows[this_frame_num][i * 4 +2] ==
-                                  blue[j][i])
-                                {
-                                  (count[j][i])++;
-                                  goto same;
-                                }
-                              break;
-                            case 2:
-                              if (these_rows[this_frame_num][i * 2 +0] ==
-                                  red[j][i])
-                                {
-                                  (count[j][i])++;
-                                  goto same;
-                                }
-                              break;
-                            default:
-                              g_error ("Eeep!");
-                              break;
-                            }
-                        }
+          optimize_distribute (width, OPTIMIZE_BAND_WIDTH,
+                               find_background_columns, &bg);
 
-                      count[num_colours[i]][i] = 1;
-                      red[num_colours[i]][i] =
-                        these_rows[this_frame_num][i * pixelstep];
-                      if (pixelstep == 4)
-                        {
-                          green[num_colours[i]][i] =
-                            these_rows[this_frame_num][i * 4 +1];
-                          blue[num_colours[i]][i] =
-                            these_rows[this_frame_num][i * 4 +2];
-                        }
-                      num_colours[i]++;
-                    }
-                same:
-                  /* nop */;
-                }
-            }
-
-          for (i=0; i<width; i++)
-            {
-              guint  best_count = 0;
-              guchar best_r = 255, best_g = 0, best_b = 255;
+          if (bg.n_empty > 0)
+            g_warning("yayyyy!");
 
-              for (j=0; j<num_colours[i]; j++)
-                {
-                  if (count[j][i] > best_count)
-                    {
-                      best_count = count[j][i];
-                      best_r = red[j][i];
-                      best_g = green[j][i];
-                      best_b = blue[j][i];
-                    }
-                }
-
-              back_frame[width * pixelstep * row +i*pixelstep + 0] = best_r;
-              if (pixelstep == 4)
-                {
-                  back_frame[width * pixelstep * row +i*pixelstep + 1] =
-                    best_g;
-                  back_frame[width * pixelstep * row +i*pixelstep + 2] =
-                    best_b;
-                }
-              back_frame[width * pixelstep * row +i*pixelstep +pixelstep-1] =
-                (best_count == 0) ? 0 : 255;
-
-              if (best_count == 0)
-                g_warning("yayyyy!");
-            }
           /*      memcpy(&back_frame[width * pixelstep * row],
                   these_rows[0],
                   width * pixelstep);*/
@@ -619,19 +950,19 @@ do_optimizations (GimpRunMode run_mode,
 
       for (this_frame_num=0; this_frame_num<total_frames; this_frame_num++)
         {
-          g_free (these_rows[this_frame_num]);
-          g_free (red[this_frame_num]);
-          g_free (green[this_frame_num]);
-          g_free (blue[this_frame_num]);
-          g_free (count[this_frame_num]);
+          g_free (bg.these_rows[this_frame_num]);
+          g_free (bg.red[this_frame_num]);
+          g_free (bg.green[this_frame_num]);
+          g_free (bg.blue[this_frame_num]);
+          g_free (bg.count[this_frame_num]);
         }
 
-      g_free (these_rows);
-      g_free (red);
-      g_free (green);
-      g_free (blue);
-      g_free (count);
-      g_free (num_colours);
+      g_free (bg.these_rows);
+      g_free (bg.red);
+      g_free (bg.green);
+      g_free (bg.blue);
+      g_free (bg.count);
+      g_free (bg.num_colours);
     }
 #endif
 
@@ -695,33 +1026,6 @@ do_optimizations (GimpRunMode run_mode,
           gimp_drawable_detach(drawable);
 
 
-          if (opmode == OPFOREGROUND)
-            {
-              gint xit, yit, byteit;
-
-              for (yit=0; yit<height; yit++)
-                {
-                  for (xit=0; xit<width; xit++)
-                    {
-                      for (byteit=0; byteit<pixelstep-1; byteit++)
-                        {
-                          if (back_frame[yit*width*pixelstep + xit*pixelstep
-                                        + byteit]
-                              !=
-                              this_frame[yit*width*pixelstep + xit*pixelstep
-                                        + byteit])
-                            {
-                              goto enough;
-                            }
-                        }
-                      this_frame[yit*width*pixelstep + xit*pixelstep
-                                + pixelstep - 1] = 0;
-                    enough:
-                      /* nop */;
-                    }
-                }
-            }
-
           can_combine = FALSE;
           bbox_left   = 0;
           bbox_top    = 0;
@@ -732,120 +1036,56 @@ do_optimizations (GimpRunMode run_mode,
           rbox_right  = width;
           rbox_bottom = height;
 
-          /* copy 'this' frame into a buffer which we can safely molest */
-          memcpy (opti_frame, this_frame, frame_sizebytes);
+          /* Remove the background, copy 'this' frame into opti_frame
+           *  and compare it with 'last', a band of rows per thread.
+           */
+          frame.back_frame = (opmode == OPFOREGROUND) ? back_frame : NULL;
+          frame.diff       = ((this_frame_num != 0) /* Can't delta bottom! */
+                              && (opmode == OPOPTIMIZE));
+
+          optimize_distribute (height, OPTIMIZE_BAND_HEIGHT,
+                               frame_rows, &frame);
+
           /*
            *
            * OPTIMIZE HERE!
            *
            */
-          if (
-              (this_frame_num != 0) /* Can't delta bottom frame! */
-              && (opmode == OPOPTIMIZE)
-              )
+          if (frame.diff)
             {
-              gint xit, yit, byteit;
+              OptimizeBox bbox;
+              OptimizeBox rbox;
+              gint        xit, yit, byteit;
+              gint        band;
 
               can_combine = TRUE;
 
               /*
                * SEARCH FOR BOUNDING BOX
                */
-              bbox_left   = width;
-              bbox_top    = height;
-              bbox_right  = 0;
-              bbox_bottom = 0;
-              rbox_left   = width;
-              rbox_top    = height;
-              rbox_right  = 0;
-              rbox_bottom = 0;
-
-              for (yit=0; yit<height; yit++)
+              bbox.left   = width;
+              bbox.top    = height;
+              bbox.right  = 0;
+              bbox.bottom = 0;
+              rbox        = bbox;
+
+              for (band = 0; band < n_bands; band++)
                 {
-                  for (xit=0; xit<width; xit++)
-                    {
-                      gboolean keep_pix;
-                      gboolean opaq_pix;
-
-                      /* Check if 'this' and 'last' are transparent */
-                      if (!(this_frame[yit*width*pixelstep + xit*pixelstep
-                                      + pixelstep-1]&128)
-                          &&
-                          !(last_frame[yit*width*pixelstep + xit*pixelstep
-                                      + pixelstep-1]&128))
-                        {
-                          keep_pix = FALSE;
-                          opaq_pix = FALSE;
-                          goto decided;
-                        }
-                      /* Check if just 'this' is transparent */
-                      if ((last_frame[yit*width*pixelstep + xit*pixelstep
-                                     + pixelstep-1]&128)
-                          &&
-                          !(this_frame[yit*width*pixelstep + xit*pixelstep
-                                      + pixelstep-1]&128))
-                        {
-                          keep_pix = TRUE;
-                          opaq_pix = FALSE;
-                          can_combine = FALSE;
-                          goto decided;
-                        }
-                      /* Check if just 'last' is transparent */
-                      if (!(last_frame[yit*width*pixelstep + xit*pixelstep
-                                      + pixelstep-1]&128)
-                          &&
-                          (this_frame[yit*width*pixelstep + xit*pixelstep
-                                     + pixelstep-1]&128))
-                        {
-                          keep_pix = TRUE;
-                          opaq_pix = TRUE;
-                          goto decided;
-                        }
-                      /* If 'last' and 'this' are opaque, we have
-                       *  to check if they're the same colour - we
-                       *  only have to keep the pixel if 'last' or
-                       *  'this' are opaque and different.
-                       */
-                      keep_pix = FALSE;
-                      opaq_pix = TRUE;
-                      for (byteit=0; byteit<pixelstep-1; byteit++)
-                        {
-                          if ((last_frame[yit*width*pixelstep + xit*pixelstep
-                                         + byteit]
-                               !=
-                               this_frame[yit*width*pixelstep + xit*pixelstep
-                                         + byteit])
-                              )
-                            {
-                              keep_pix = TRUE;
-                              goto decided;
-                            }
-                        }
-                    decided:
-                      if (opaq_pix)
-                        {
-                          if (xit<rbox_left) rbox_left=xit;
-                          if (xit>rbox_right) rbox_right=xit;
-                          if (yit<rbox_top) rbox_top=yit;
-                          if (yit>rbox_bottom) rbox_bottom=yit;
-                        }
-                      if (keep_pix)
-                        {
-                          if (xit<bbox_left) bbox_left=xit;
-                          if (xit>bbox_right) bbox_right=xit;
-                          if (yit<bbox_top) bbox_top=yit;
-                          if (yit>bbox_bottom) bbox_bottom=yit;
-                        }
-                      else
-                        {
-                          /* pixel didn't change this frame - make
-                           *  it transparent in our optimized buffer!
-                           */
-                          opti_frame[yit*width*pixelstep + xit*pixelstep
-                                    + pixelstep-1] = 0;
-                        }
-                    } /* xit */
-                } /* yit */
+                  optimize_box_merge (&bbox, &frame.bands[band].bbox);
+                  optimize_box_merge (&rbox, &frame.bands[band].rbox);
+
+                  if (! frame.bands[band].can_combine)
+                    can_combine = FALSE;
+                }
+
+              bbox_left   = bbox.left;
+              bbox_top    = bbox.top;
+              bbox_right  = bbox.right;
+              bbox_bottom = bbox.bottom;
+              rbox_left   = rbox.left;
+              rbox_top    = rbox.top;
+              rbox_right  = rbox.right;
+              rbox_bottom = rbox.bottom;
 
               if (!can_combine)
                 {
@@ -984,10 +1224,6 @@ do_optimizations (GimpRunMode run_mode,
                     }
                 }
             } /* !bot frame? */
-          else
-            {
-              memcpy (opti_frame, this_frame, frame_sizebytes);
-            }
 
           /*
            *
@@ -1110,6 +1346,8 @@ do_optimizations (GimpRunMode run_mode,
   g_free (back_frame);
   back_frame = NULL;
 
+  g_free (frame.bands);
+
   return new_image_id;
 }
 
@@ -47,6 +47,9 @@
 #define PLUG_IN_ROLE   "gimp-animation-play"
 #define DITHERTYPE     GDK_RGB_DITHER_NORMAL
 
+/* how much memory the pre-rendered frames may take */
+#define FRAME_CACHE_MAX_BYTES  (512 << 20)
+
 
 typedef enum
 {
@@ -84,7 +87,17 @@ static gboolean    repaint_da                (GtkWidget       *darea,
                                               GdkEventExpose  *event,
                                               gpointer         data);
 
+static gboolean    composite_frame           (gint32           whichframe,
+                                              guchar          *dest,
+                                              gchar           *mask,
+                                              gint            *top,
+                                              gint            *bottom);
+static void        draw_frame                (gint             top,
+                                              gint             bottom);
 static void        render_frame              (gint32           whichframe);
+static gboolean    frame_cache_idle          (gpointer         data);
+static void        frame_cache_fill          (void);
+static void        frame_cache_clear         (void);
 static void        show_frame                (void);
 static void        total_alpha_preview       (guchar          *ptr);
 static void        init_preview              (void);
@@ -140,6 +153,12 @@ static gint               ncolours;
 static gint               duration_index = 3;
 static gint               default_frame_duration = 100; /* ms */
 
+/* pre-rendered frames, preview data followed by the shape mask */
+static guchar           **frame_cache         = NULL;
+static gint               frame_cache_next    = 0;
+static gsize              frame_cache_bytes   = 0;
+static guint              frame_cache_idle_id = 0;
+
 
 /* for shaping */
 typedef struct
@@ -797,17 +816,27 @@ do_playback (void)
   render_frame (0);
   show_frame ();
 
+  frame_cache_fill ();
+
   gtk_main ();
+
+  frame_cache_clear ();
 }
 
 
 /* Rendering Functions */
 
-static void
-render_frame (gint32 whichframe)
+/*  Composites frame "whichframe" on top of "dest", which holds the
+ *  previous frame, and adds its shape to "mask" unless that is NULL.
+ *  The rows that changed are returned in "top" and "bottom".
+ */
+static gboolean
+composite_frame (gint32   whichframe,
+                 guchar  *dest,
+                 gchar   *mask,
+                 gint    *top,
+                 gint    *bottom)
 {
-  GtkStyle      *shape_style   = gtk_widget_get_style (shape_drawing_area);
-  GtkStyle      *drawing_style = gtk_widget_get_style (drawing_area);
   GimpPixelRgn   pixel_rgn;
   static guchar *rawframe = NULL;
   static gint    rawwidth = 0, rawheight = 0, rawbpp = 0;
@@ -830,10 +859,10 @@ render_frame (gint32 whichframe)
     {
       gimp_message (_("Tried to display an invalid layer."));
       gtk_main_quit ();
-      return;
+      return FALSE;
     }
 
-  dispose = get_frame_disposal (frame_number);
+  dispose = get_frame_disposal (whichframe);
 
   /* Image has been closed/etc since we got the layer list? */
   /* FIXME - How do we tell if a gimp_drawable_get() fails? */
@@ -843,7 +872,10 @@ render_frame (gint32 whichframe)
   if (((dispose == DISPOSE_REPLACE) || (whichframe == 0)) &&
       gimp_drawable_has_alpha (drawable->drawable_id))
     {
-      total_alpha_preview (preview_data);
+      total_alpha_preview (dest);
+
+      if (mask)
+        memset (mask, 0, (width * height) / 8 + height);
     }
 
 
@@ -895,7 +927,7 @@ render_frame (gint32 whichframe)
 
           if (gimp_drawable_has_alpha (drawable->drawable_id))
             {
-              destptr = preview_data;
+              destptr = dest;
               srcptr  = rawframe;
 
               i = rawwidth * rawheight;
@@ -916,7 +948,7 @@ render_frame (gint32 whichframe)
                 }
 
               /* calculate the shape mask */
-              if (detached)
+              if (mask)
                 {
                   srcptr = rawframe + 3;
 
@@ -927,7 +959,7 @@ render_frame (gint32 whichframe)
                       for (i = 0; i < rawwidth; i++)
                         {
                           if ((*srcptr) & 128)
-                            shape_preview_mask[k + i/8] |= (1 << (i&7));
+                            mask[k + i/8] |= (1 << (i&7));
 
                           srcptr += 4;
                         }
@@ -937,37 +969,15 @@ render_frame (gint32 whichframe)
           else /* no alpha */
             {
               if ((rawwidth == width) && (rawheight == height))
-                memcpy (preview_data, rawframe, width * height * 3);
+                memcpy (dest, rawframe, width * height * 3);
 
-              if (detached)
+              if (mask)
                 {
                   /* opacify the shape mask */
-                  memset (shape_preview_mask, 255,
+                  memset (mask, 255,
                           (rawwidth * rawheight) / 8 + rawheight);
                 }
             }
-
-          /* Display the preview buffer... finally. */
-          if (detached)
-            {
-              reshape_from_bitmap (shape_preview_mask);
-              gdk_draw_rgb_image (gtk_widget_get_window (shape_drawing_area),
-                                  shape_style->white_gc,
-                                  0, 0, width, height,
-                                  (total_frames == 1 ?
-                                   GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                  preview_data, width * 3);
-            }
-          else
-            {
-              reshape_from_bitmap (shape_preview_mask);
-              gdk_draw_rgb_image (gtk_widget_get_window (drawing_area),
-                                  drawing_style->white_gc,
-                                  0, 0, width, height,
-                                  (total_frames == 1 ?
-                                   GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                  preview_data, width * 3);
-            }
         }
       else
         {
@@ -988,9 +998,9 @@ render_frame (gint32 whichframe)
                         {
                           if (srcptr[3] & 128)
                             {
-                              preview_data[(j * width + i) * 3    ] = *(srcptr);
-                              preview_data[(j * width + i) * 3 + 1] = *(srcptr + 1);
-                              preview_data[(j * width + i) * 3 + 2] = *(srcptr + 2);
+                              dest[(j * width + i) * 3    ] = *(srcptr);
+                              dest[(j * width + i) * 3 + 1] = *(srcptr + 1);
+                              dest[(j * width + i) * 3 + 2] = *(srcptr + 2);
                             }
                         }
 
@@ -998,7 +1008,7 @@ render_frame (gint32 whichframe)
                     }
                 }
 
-              if (detached)
+              if (mask)
                 {
                   srcptr = rawframe + 3;
 
@@ -1012,7 +1022,7 @@ render_frame (gint32 whichframe)
                               (j>=0 && j<height))
                             {
                               if ((*srcptr) & 128)
-                                shape_preview_mask[k + i/8] |= (1 << (i&7));
+                                mask[k + i/8] |= (1 << (i&7));
                             }
 
                           srcptr += 4;
@@ -1033,69 +1043,15 @@ render_frame (gint32 whichframe)
                       if ((i >= 0 && i < width) &&
                           (j >= 0 && j < height))
                         {
-                          preview_data[(j * width + i) * 3    ] = *(srcptr);
-                          preview_data[(j * width + i) * 3 + 1] = *(srcptr + 1);
-                          preview_data[(j * width + i) * 3 + 2] = *(srcptr + 2);
+                          dest[(j * width + i) * 3    ] = *(srcptr);
+                          dest[(j * width + i) * 3 + 1] = *(srcptr + 1);
+                          dest[(j * width + i) * 3 + 2] = *(srcptr + 2);
                         }
 
                       srcptr += 3;
                     }
                 }
             }
-
-          /* Display the preview buffer... finally. */
-          if (detached)
-            {
-              if ((dispose != DISPOSE_REPLACE) && (whichframe != 0))
-                {
-                  gint top    = MAX (rawy, 0);
-                  gint bottom = MIN (rawy + rawheight, height);
-
-                  reshape_from_bitmap (shape_preview_mask);
-                  gdk_draw_rgb_image (gtk_widget_get_window (shape_drawing_area),
-                                      shape_style->white_gc,
-                                      0, top, width, bottom - top,
-                                      (total_frames == 1 ?
-                                       GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                      preview_data + 3 * top * width,
-                                      width * 3);
-                }
-              else
-                {
-                  reshape_from_bitmap (shape_preview_mask);
-                  gdk_draw_rgb_image (gtk_widget_get_window (shape_drawing_area),
-                                      shape_style->white_gc,
-                                      0, 0, width, height,
-                                      (total_frames == 1 ?
-                                       GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                      preview_data, width * 3);
-                }
-            }
-          else
-            {
-              if ((dispose != DISPOSE_REPLACE) && (whichframe != 0))
-                {
-                  gint top    = MAX (rawy, 0);
-                  gint bottom = MIN (rawy + rawheight, height);
-
-                  gdk_draw_rgb_image (gtk_widget_get_window (drawing_area),
-                                      drawing_style->white_gc,
-                                      0, top, width, bottom - top,
-                                      (total_frames == 1 ?
-                                       GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                      preview_data + 3 * top * width,
-                                      width * 3);
-                }
-              else
-                {
-                  gdk_draw_rgb_image (gtk_widget_get_window (drawing_area),
-                                      drawing_style->white_gc,
-                                      0, 0, width, height,
-                                      (total_frames == 1 ?
-                                       GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                      preview_data, width * 3);
-                }
-            }
         }
       break;
 
@@ -1112,7 +1068,7 @@ render_frame (gint32 whichframe)
 
           if (gimp_drawable_has_alpha (drawable->drawable_id))
             {
-              destptr = preview_data;
+              destptr = dest;
               srcptr  = rawframe;
 
               i = rawwidth * rawheight;
@@ -1134,7 +1090,7 @@ render_frame (gint32 whichframe)
                 }
 
               /* calculate the shape mask */
-              if (detached)
+              if (mask)
                 {
                   srcptr = rawframe + 1;
 
@@ -1145,7 +1101,7 @@ render_frame (gint32 whichframe)
                       for (i = 0; i < rawwidth; i++)
                         {
                           if (*srcptr)
-                            shape_preview_mask[k + i/8] |= (1 << (i&7));
+                            mask[k + i/8] |= (1 << (i&7));
 
                           srcptr += 2;
                         }
@@ -1154,7 +1110,7 @@ render_frame (gint32 whichframe)
             }
           else /* no alpha */
             {
-              destptr = preview_data;
+              destptr = dest;
               srcptr  = rawframe;
 
               i = rawwidth * rawheight;
@@ -1168,34 +1124,13 @@ render_frame (gint32 whichframe)
                   srcptr++;
                 }
 
-              if (detached)
+              if (mask)
                 {
                   /* opacify the shape mask */
-                  memset (shape_preview_mask, 255,
+                  memset (mask, 255,
                           (rawwidth * rawheight) / 8 + rawheight);
                 }
             }
-
-          /* Display the preview buffer... finally. */
-          if (detached)
-            {
-              reshape_from_bitmap (shape_preview_mask);
-              gdk_draw_rgb_image (gtk_widget_get_window (shape_drawing_area),
-                                  shape_style->white_gc,
-                                  0, 0, width, height,
-                                  (total_frames == 1 ?
-                                   GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                  preview_data, width * 3);
-            }
-          else
-            {
-              gdk_draw_rgb_image (gtk_widget_get_window (drawing_area),
-                                  drawing_style->white_gc,
-                                  0, 0, width, height,
-                                  (total_frames == 1 ?
-                                   GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                  preview_data, width * 3);
-            }
         }
       else
         {
@@ -1216,11 +1151,11 @@ render_frame (gint32 whichframe)
                         {
                           if (*(srcptr+1))
                             {
-                              preview_data[(j * width + i) * 3 + 0] =
+                              dest[(j * width + i) * 3 + 0] =
                                 palette[0 + 3 * (*(srcptr))];
-                              preview_data[(j * width + i) * 3 + 1] =
+                              dest[(j * width + i) * 3 + 1] =
                                 palette[1 + 3 * (*(srcptr))];
-                              preview_data[(j * width + i) * 3 + 2] =
+                              dest[(j * width + i) * 3 + 2] =
                                 palette[2 + 3 * (*(srcptr))];
                             }
                         }
@@ -1229,7 +1164,7 @@ render_frame (gint32 whichframe)
                     }
                 }
 
-              if (detached)
+              if (mask)
                 {
                   srcptr = rawframe + 1;
 
@@ -1243,7 +1178,7 @@ render_frame (gint32 whichframe)
                               (j >= 0 && j < height))
                             {
                               if (*srcptr)
-                                shape_preview_mask[k + i/8] |= (1 << (i&7));
+                                mask[k + i/8] |= (1 << (i&7));
                             }
 
                           srcptr += 2;
@@ -1263,11 +1198,11 @@ render_frame (gint32 whichframe)
                       if ((i >= 0 && i < width) &&
                           (j >= 0 && j < height))
                         {
-                          preview_data[(j * width + i) * 3 + 0] =
+                          dest[(j * width + i) * 3 + 0] =
                             palette[0 + 3 * (*(srcptr))];
-                          preview_data[(j * width + i) * 3 + 1] =
+                          dest[(j * width + i) * 3 + 1] =
                             palette[1 + 3 * (*(srcptr))];
-                          preview_data[(j * width + i) * 3 + 2] =
+                          dest[(j * width + i) * 3 + 2] =
                             palette[2 + 3 * (*(srcptr))];
                         }
 
@@ -1275,67 +1210,164 @@ render_frame (gint32 whichframe)
                     }
                 }
             }
-
-          /* Display the preview buffer... finally. */
-          if (detached)
-            {
-              if ((dispose != DISPOSE_REPLACE) && (whichframe != 0))
-                {
-                  gint top    = MAX (rawy, 0);
-                  gint bottom = MIN (rawy + rawheight, height);
-
-                  reshape_from_bitmap (shape_preview_mask);
-                  gdk_draw_rgb_image (gtk_widget_get_window (shape_drawing_area),
-                                      shape_style->white_gc,
-                                      0, top, width, bottom - top,
-                                      (total_frames == 1 ?
-                                       GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                      preview_data + 3 * top * width,
-                                      width * 3);
-                }
-              else
-                {
-                  reshape_from_bitmap (shape_preview_mask);
-                  gdk_draw_rgb_image (gtk_widget_get_window (shape_drawing_area),
-                                      shape_style->white_gc,
-                                      0, 0, width, height,
-                                      (total_frames == 1 ?
-                                       GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                      preview_data, width * 3);
-                }
-            }
-          else
-            {
-              if ((dispose != DISPOSE_REPLACE) && (whichframe != 0))
-                {
-                  gint top    = MAX (rawy, 0);
-                  gint bottom = MIN (rawy + rawheight, height);
-
-                  gdk_draw_rgb_image (gtk_widget_get_window (drawing_area),
-                                      drawing_style->white_gc,
-                                      0, top, width, bottom - top,
-                                      (total_frames == 1 ?
-                                       GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                      preview_data + 3 * top * width,
-                                      width * 3);
-                }
-              else
-                {
-                  gdk_draw_rgb_image (gtk_widget_get_window (drawing_area),
-                                      drawing_style->white_gc,
-                                      0, 0, width, height,
-                                      (total_frames == 1 ?
-                                       GDK_RGB_DITHER_MAX : DITHERTYPE),
-                                      preview_data, width * 3);
-                }
-            }
         }
       break;
 
     }
 
+  *top    = 0;
+  *bottom = height;
+
+  if (((rawwidth != width) || (rawheight != height) ||
+       (rawx != 0) || (rawy != 0)) &&
+      (dispose != DISPOSE_REPLACE) && (whichframe != 0))
+    {
+      *top    = MAX (rawy, 0);
+      *bottom = MIN (rawy + rawheight, height);
+    }
+
   /* clean up */
   gimp_drawable_detach (drawable);
+
+  return TRUE;
+}
+
+static void
+draw_frame (gint top,
+            gint bottom)
+{
+  GtkWidget *area;
+
+  if (bottom <= top)
+    return;
+
+  if (detached)
+    {
+      reshape_from_bitmap (shape_preview_mask);
+      area = shape_drawing_area;
+    }
+  else
+    {
+      area = drawing_area;
+    }
+
+  gdk_draw_rgb_image (gtk_widget_get_window (area),
+                      gtk_widget_get_style (area)->white_gc,
+                      0, top, width, bottom - top,
+                      (total_frames == 1 ? GDK_RGB_DITHER_MAX : DITHERTYPE),
+                      preview_data + 3 * top * width,
+                      width * 3);
+}
+
+static void
+render_frame (gint32 whichframe)
+{
+  gint top;
+  gint bottom;
+
+  if (frame_cache && frame_cache[whichframe])
+    {
+      /*  a pre-rendered frame is only a copy away  */
+      memcpy (preview_data, frame_cache[whichframe], width * height * 3);
+
+      if (detached)
+        memcpy (shape_preview_mask,
+                frame_cache[whichframe] + width * height * 3,
+                (width * height) / 8 + height);
+
+      top    = 0;
+      bottom = height;
+    }
+  else if (! composite_frame (whichframe, preview_data,
+                              detached ? shape_preview_mask : NULL,
+                              &top, &bottom))
+    {
+      return;
+    }
+
+  draw_frame (top, bottom);
+}
+
+/*  The frames are pre-rendered in playback order from an idle handler,
+ *  each one composited on a copy of the one before, until they are all
+ *  cached or the cache is full.  Pixels can only be fetched from the
+ *  core on the main thread, so this is not done on a thread of its own.
+ */
+static gboolean
+frame_cache_idle (gpointer data)
+{
+  gsize   rgb_size   = (gsize) width * height * 3;
+  gsize   frame_size = rgb_size + (width * height) / 8 + height;
+  guchar *frame;
+  gint    top;
+  gint    bottom;
+
+  if (frame_cache_next >= total_frames ||
+      frame_cache_bytes + frame_size > FRAME_CACHE_MAX_BYTES)
+    {
+      frame_cache_idle_id = 0;
+      return FALSE;
+    }
+
+  frame = g_malloc (frame_size);
+
+  if (frame_cache_next == 0)
+    {
+      total_alpha_preview (frame);
+      memset (frame + rgb_size, 0, frame_size - rgb_size);
+    }
+  else
+    {
+      memcpy (frame, frame_cache[frame_cache_next - 1], frame_size);
+    }
+
+  if (! composite_frame (frame_cache_next, frame, (gchar *) frame + rgb_size,
+                         &top, &bottom))
+    {
+      g_free (frame);
+
+      frame_cache_idle_id = 0;
+      return FALSE;
+    }
+
+  frame_cache[frame_cache_next++] = frame;
+  frame_cache_bytes += frame_size;
+
+  return TRUE;
+}
+
+static void
+frame_cache_fill (void)
+{
+  if (! frame_cache)
+    frame_cache = g_new0 (guchar *, total_frames);
+
+  if (! frame_cache_idle_id)
+    frame_cache_idle_id = g_idle_add (frame_cache_idle, NULL);
+}
+
+static void
+frame_cache_clear (void)
+{
+  gint i;
+
+  if (frame_cache_idle_id)
+    {
+      g_source_remove (frame_cache_idle_id);
+      frame_cache_idle_id = 0;
+    }
+
+  if (frame_cache)
+    {
+      for (i = 0; i < total_frames; i++)
+        g_free (frame_cache[i]);
+
+      g_free (frame_cache);
+      frame_cache = NULL;
+    }
+
+  frame_cache_next  = 0;
+  frame_cache_bytes = 0;
 }
 
 static void
@@ -1431,6 +1463,8 @@ window_destroy (GtkWidget *widget)
   if (playing)
     remove_timer ();
 
+  frame_cache_clear ();
+
   if (shape_window)
     gtk_widget_destroy (GTK_WIDGET (shape_window));
 
@@ -1544,8 +1578,14 @@ rewind_callback (GtkAction *action)
     gtk_action_activate (gtk_ui_manager_get_action (ui_manager,
                                                     "/anim-play-toolbar/play"));
   frame_number = 0;
+
+  /*  start over from the image, so that changes to it show up  */
+  frame_cache_clear ();
+
   render_frame (frame_number);
   show_frame ();
+
+  frame_cache_fill ();
 }
 
 static void
@@ -24,6 +24,11 @@
 
 #include "libgimp/stdplugins-intl.h"
 
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define GAUSS_SSE2 1
+#include <emmintrin.h>
+#endif
+
 #define GAUSS_PROC      "plug-in-gauss"
 #define GAUSS_IIR_PROC  "plug-in-gauss-iir"
 #define GAUSS_IIR2_PROC "plug-in-gauss-iir2"
@@ -870,335 +875,412 @@ do_full_lre (const gint *src,
     }
 }
 
-static void
-gauss_iir (GimpDrawable *drawable,
-           gdouble       horz,
-           gdouble       vert,
-           BlurMethod    method,
-           guchar       *preview_buffer,
-           gint          x1,
-           gint          y1,
-           gint          width,
-           gint          height)
+/*
+ * The blur itself works on strips of GAUSS_STRIP_SIZE lines: a strip
+ * is read with a single gimp_pixel_rgn_get_rect() call, the lines of
+ * it are blurred in place by gimp_parallel_run(), and it is written
+ * back with gimp_pixel_rgn_set_rect().  All the libgimp calls stay on
+ * the main thread.  For the vertical pass, the strip is
+ * transposed so that the columns are contiguous in memory, which is a
+ * lot cheaper than fetching every column on its own.
+ */
+
+#define GAUSS_STRIP_SIZE   64
+#define GAUSS_BLOCK_SIZE   16
+
+typedef struct
 {
-  GimpPixelRgn  src_rgn, dest_rgn;
-  gint          bytes;
-  gint          has_alpha;
-  guchar       *dest;
-  guchar       *src,  *sp_p, *sp_m;
-  gdouble       n_p[5], n_m[5];
-  gdouble       d_p[5], d_m[5];
-  gdouble       bd_p[5], bd_m[5];
-  gdouble      *val_p = NULL;
-  gdouble      *val_m = NULL;
-  gdouble      *vp, *vm;
-  gint          i, j;
-  gint          row, col, b;
-  gint          terms;
-  gdouble       progress, max_progress;
-  gint          initial_p[4];
-  gint          initial_m[4];
-  gdouble       std_dev;
-  gboolean      direct;
-  gint          progress_step;
+  BlurMethod  method;
 
-  direct = (preview_buffer == NULL);
+  /*  BLUR_IIR  */
+  gdouble     n_p[5], n_m[5];
+  gdouble     d_p[5], d_m[5];
+  gdouble     bd_p[5], bd_m[5];
 
-  bytes = drawable->bpp;
-  has_alpha = gimp_drawable_has_alpha (drawable->drawable_id);
+  /*  BLUR_RLE  */
+  gint       *curve;
+  gint       *sum;
+  gint        length;
+  gint        total;
+} GaussFilter;
 
-  val_p = g_new (gdouble, MAX (width, height) * bytes);
-  val_m = g_new (gdouble, MAX (width, height) * bytes);
+typedef struct
+{
+  const GaussFilter *filter;
+  guchar            *lines;
+  gint               n_lines;
+  gint               len;
+  gint               bytes;
+  gboolean           has_alpha;
+} GaussJob;
 
-  src =  g_new (guchar, MAX (width, height) * bytes);
-  dest = g_new (guchar, MAX (width, height) * bytes);
 
-  gimp_pixel_rgn_init (&src_rgn,
-                       drawable, 0, 0, drawable->width, drawable->height,
-                       FALSE, FALSE);
-  if (direct)
-    {
-      gimp_pixel_rgn_init (&dest_rgn,
-                           drawable, 0, 0, drawable->width, drawable->height,
-                           TRUE, TRUE);
-    }
+static void
+gauss_filter_init (GaussFilter *filter,
+                   BlurMethod   method,
+                   gdouble      radius)
+{
+  gdouble std_dev;
 
+  radius  = fabs (radius) + 1.0;
+  std_dev = sqrt (-(radius * radius) / (2 * log (1.0 / 255.0)));
 
-  progress = 0.0;
-  max_progress  = (horz <= 0.0) ? 0 : width * height * horz;
-  max_progress += (vert <= 0.0) ? 0 : width * height * vert;
+  memset (filter, 0, sizeof (GaussFilter));
 
+  filter->method = method;
 
-  /*  First the vertical pass  */
-  if (vert > 0.0)
-    {
-      vert = fabs (vert) + 1.0;
-      std_dev = sqrt (-(vert * vert) / (2 * log (1.0 / 255.0)));
+  /*  derive the constants for calculating the gaussian from the std dev  */
+  if (method == BLUR_IIR)
+    find_iir_constants (filter->n_p, filter->n_m,
+                        filter->d_p, filter->d_m,
+                        filter->bd_p, filter->bd_m,
+                        std_dev);
+  else
+    make_rle_curve (std_dev,
+                    &filter->curve, &filter->length,
+                    &filter->sum, &filter->total);
+}
 
-      /* We do not want too many progress updates because they
-       * can slow down the processing significantly for very
-       * large images
-       */
-      progress_step = width / 16;
+static void
+gauss_filter_clear (GaussFilter *filter)
+{
+  if (filter->curve)
+    free_rle_curve (filter->curve, filter->length, filter->sum);
 
-      if (progress_step < 5)
-        progress_step = 5;
+  filter->curve = NULL;
+  filter->sum   = NULL;
+}
 
-      /*  derive the constants for calculating the gaussian
-       *  from the std dev
-       */
+/*  Blurs one line of 'len' pixels in place.  'val_p' and 'val_m' hold
+ *  len * bytes values and 'val_s' gets a copy of the line as doubles.
+ */
+static void
+gauss_iir_line (const GaussFilter *filter,
+                guchar            *line,
+                gint               len,
+                gint               bytes,
+                gdouble           *val_p,
+                gdouble           *val_m,
+                gdouble           *val_s)
+{
+  const gdouble *n_p  = filter->n_p;
+  const gdouble *n_m  = filter->n_m;
+  const gdouble *d_p  = filter->d_p;
+  const gdouble *d_m  = filter->d_m;
+  const gdouble *bd_p = filter->bd_p;
+  const gdouble *bd_m = filter->bd_m;
+  const guchar  *sp_p = line;
+  const guchar  *sp_m = line + (len - 1) * bytes;
+  const gdouble *ss_p = val_s;
+  const gdouble *ss_m = val_s + (len - 1) * bytes;
+  gdouble       *vp   = val_p;
+  gdouble       *vm   = val_m + (len - 1) * bytes;
+  gint           initial_p[4];
+  gint           initial_m[4];
+  gint           i, j, k, b;
+#ifdef GAUSS_SSE2
+  __m128d        np[5], nm[5], dp[5], dm[5];
 
-      find_iir_constants (n_p, n_m, d_p, d_m, bd_p, bd_m, std_dev);
+  for (i = 0; i <= 4; i++)
+    {
+      np[i] = _mm_set1_pd (n_p[i]);
+      nm[i] = _mm_set1_pd (n_m[i]);
+      dp[i] = _mm_set1_pd (d_p[i]);
+      dm[i] = _mm_set1_pd (d_m[i]);
+    }
+#endif
 
-      for (col = 0; col < width; col++)
-        {
-          memset (val_p, 0, height * bytes * sizeof (gdouble));
-          memset (val_m, 0, height * bytes * sizeof (gdouble));
+  memset (val_p, 0, len * bytes * sizeof (gdouble));
+  memset (val_m, 0, len * bytes * sizeof (gdouble));
 
-          gimp_pixel_rgn_get_col (&src_rgn, src, col + x1, y1, height);
+  for (i = 0; i < len * bytes; i++)
+    val_s[i] = line[i];
 
-          if (has_alpha)
-            multiply_alpha (src, height, bytes);
+  /*  Set up the first vals  */
+  for (b = 0; b < bytes; b++)
+    {
+      initial_p[b] = sp_p[b];
+      initial_m[b] = sp_m[b];
+    }
 
-          sp_p = src;
-          sp_m = src + (height - 1) * bytes;
-          vp = val_p;
-          vm = val_m + (height - 1) * bytes;
+  /*  The first four pixels from either end also take the boundary
+   *  terms into account
+   */
+  for (k = 0; k < MIN (len, 4); k++)
+    {
+      for (b = 0; b < bytes; b++)
+        {
+          gdouble *vpptr = vp + b;
+          gdouble *vmptr = vm + b;
 
-          /*  Set up the first vals  */
-          for (i = 0; i < bytes; i++)
+          for (i = 0; i <= k; i++)
             {
-              initial_p[i] = sp_p[i];
-              initial_m[i] = sp_m[i];
+              *vpptr += n_p[i] * sp_p[(-i * bytes) + b] -
+                d_p[i] * vp[(-i * bytes) + b];
+              *vmptr += n_m[i] * sp_m[(i * bytes) + b] -
+                d_m[i] * vm[(i * bytes) + b];
             }
-
-          for (row = 0; row < height; row++)
+          for (j = i; j <= 4; j++)
             {
-              gdouble *vpptr, *vmptr;
-              terms = (row < 4) ? row : 4;
-
-              for (b = 0; b < bytes; b++)
-                {
-                  vpptr = vp + b; vmptr = vm + b;
-                  for (i = 0; i <= terms; i++)
-                    {
-                      *vpptr += n_p[i] * sp_p[(-i * bytes) + b] - d_p[i] * vp[(-i * bytes) + b];
-                      *vmptr += n_m[i] * sp_m[(i * bytes) + b] - d_m[i] * vm[(i * bytes) + b];
-                    }
-                  for (j = i; j <= 4; j++)
-                    {
-                      *vpptr += (n_p[j] - bd_p[j]) * initial_p[b];
-                      *vmptr += (n_m[j] - bd_m[j]) * initial_m[b];
-                    }
-                }
-
-              sp_p += bytes;
-              sp_m -= bytes;
-              vp += bytes;
-              vm -= bytes;
+              *vpptr += (n_p[j] - bd_p[j]) * initial_p[b];
+              *vmptr += (n_m[j] - bd_m[j]) * initial_m[b];
             }
+        }
 
-          transfer_pixels (val_p, val_m, dest, bytes, height);
+      sp_p += bytes;
+      sp_m -= bytes;
+      ss_p += bytes;
+      ss_m -= bytes;
+      vp   += bytes;
+      vm   -= bytes;
+    }
 
+  /*  The rest of the line is the plain recurrence.  The terms are
+   *  added in the same order as above, so the SSE2 code, which does
+   *  two channels at once, gives exactly the same values as the
+   *  scalar code.
+   */
+  for (; k < len; k++)
+    {
+      b = 0;
 
-          if (has_alpha)
-            separate_alpha (dest, height, bytes);
+#ifdef GAUSS_SSE2
+      for (; b + 1 < bytes; b += 2)
+        {
+          __m128d acc_p = _mm_mul_pd (np[0], _mm_loadu_pd (ss_p + b));
+          __m128d acc_m = _mm_mul_pd (nm[0], _mm_loadu_pd (ss_m + b));
 
-          if (direct)
+          for (i = 1; i <= 4; i++)
             {
-              gimp_pixel_rgn_set_col(&dest_rgn, dest, col + x1, y1, height);
+              __m128d s_p = _mm_loadu_pd (ss_p - i * bytes + b);
+              __m128d s_m = _mm_loadu_pd (ss_m + i * bytes + b);
+              __m128d v_p = _mm_loadu_pd (vp - i * bytes + b);
+              __m128d v_m = _mm_loadu_pd (vm + i * bytes + b);
+
+              acc_p = _mm_add_pd (acc_p,
+                                  _mm_sub_pd (_mm_mul_pd (np[i], s_p),
+                                              _mm_mul_pd (dp[i], v_p)));
+              acc_m = _mm_add_pd (acc_m,
+                                  _mm_sub_pd (_mm_mul_pd (nm[i], s_m),
+                                              _mm_mul_pd (dm[i], v_m)));
+            }
 
-              progress += height * vert;
+          _mm_storeu_pd (vp + b, acc_p);
+          _mm_storeu_pd (vm + b, acc_m);
+        }
+#endif
 
-              if ((col % progress_step) == 0)
-                gimp_progress_update (progress / max_progress);
-            }
-          else
+      for (; b < bytes; b++)
+        {
+          gdouble acc_p = n_p[0] * ss_p[b];
+          gdouble acc_m = n_m[0] * ss_m[b];
+
+          for (i = 1; i <= 4; i++)
             {
-              for (row = 0; row < height; row++)
-                memcpy (preview_buffer + (row * width + col) * bytes,
-                        dest + row * bytes,
-                        bytes);
+              acc_p += (n_p[i] * ss_p[(-i * bytes) + b] -
+                        d_p[i] * vp[(-i * bytes) + b]);
+              acc_m += (n_m[i] * ss_m[(i * bytes) + b] -
+                        d_m[i] * vm[(i * bytes) + b]);
             }
+
+          vp[b] = acc_p;
+          vm[b] = acc_m;
         }
 
-      /*  prepare for the horizontal pass  */
-      gimp_pixel_rgn_init (&src_rgn,
-                           drawable,
-                           0, 0,
-                           drawable->width, drawable->height,
-                           FALSE, TRUE);
-    }
-  else if (!direct)
-    {
-      gimp_pixel_rgn_get_rect (&src_rgn,
-                               preview_buffer,
-                               x1, y1,
-                               width, height);
+      ss_p += bytes;
+      ss_m -= bytes;
+      vp   += bytes;
+      vm   -= bytes;
     }
 
-  /*  Now the horizontal pass  */
-  if (horz > 0.0)
-    {
+  transfer_pixels (val_p, val_m, line, bytes, len);
+}
 
-      /* We do not want too many progress updates because they
-       * can slow down the processing significantly for very
-       * large images
-       */
-      progress_step = height / 16;
+/*  Blurs one line of 'len' pixels in place.  'rle' and 'pix' hold
+ *  len + 2 * length values each.
+ */
+static void
+gauss_rle_line (const GaussFilter *filter,
+                guchar            *line,
+                gint               len,
+                gint               bytes,
+                gint              *rle,
+                gint              *pix)
+{
+  gint length = filter->length;
+  gint b;
 
-      if (progress_step < 5)
-        progress_step = 5;
+  /*  rle[] and pix[] extend from -length to len+length-1  */
+  rle += length;
+  pix += length;
 
-      horz = fabs (horz) + 1.0;
+  for (b = 0; b < bytes; b++)
+    {
+      gint same = run_length_encode (line + b, rle, pix, bytes,
+                                     len, length, TRUE);
 
-      if (horz != vert)
+      if (same > (3 * len) / 4)
         {
-          std_dev = sqrt (-(horz * horz) / (2 * log (1.0 / 255.0)));
-
-          /*  derive the constants for calculating the gaussian
-           *  from the std dev
+          /* encoded_rle is only fastest if there are a lot of
+           * repeating pixels
            */
-          find_iir_constants (n_p, n_m, d_p, d_m, bd_p, bd_m, std_dev);
-
+          do_encoded_lre (rle, pix, line + b, len, length, bytes,
+                          filter->curve, filter->total, filter->sum);
         }
-
-
-      for (row = 0; row < height; row++)
+      else
         {
+          /* else a full but more simple algorithm is better */
+          do_full_lre (pix, line + b, len, length, bytes,
+                       filter->curve, filter->total);
+        }
+    }
+}
 
-          memset (val_p, 0, width * bytes * sizeof (gdouble));
-          memset (val_m, 0, width * bytes * sizeof (gdouble));
-
-          if (direct)
-            {
-              gimp_pixel_rgn_get_row (&src_rgn, src, x1, row + y1, width);
-            }
-          else
-            {
-              memcpy (src,
-                      preview_buffer + row * width * bytes,
-                      width * bytes);
-            }
-
+/*  Blurs the job'th share of the lines  */
+static void
+gauss_job_func (gint      job,
+                gint      n_jobs,
+                gint      thread,
+                GaussJob *lines)
+{
+  gint      len   = lines->len;
+  gint      bytes = lines->bytes;
+  gint      first = (gint64) lines->n_lines * job / n_jobs;
+  gint      last  = (gint64) lines->n_lines * (job + 1) / n_jobs;
+  gdouble  *val_p = NULL;
+  gdouble  *val_m = NULL;
+  gdouble  *val_s = NULL;
+  gint     *rle   = NULL;
+  gint     *pix   = NULL;
+  gint      i;
+
+  if (lines->filter->method == BLUR_IIR)
+    {
+      val_p = g_new (gdouble, len * bytes);
+      val_m = g_new (gdouble, len * bytes);
+      val_s = g_new (gdouble, len * bytes);
+    }
+  else
+    {
+      rle = g_new (gint, len + 2 * lines->filter->length);
+      pix = g_new (gint, len + 2 * lines->filter->length);
+    }
 
-          if (has_alpha)
-            multiply_alpha (src, width, bytes);
+  for (i = first; i < last; i++)
+    {
+      guchar *line = lines->lines + i * len * bytes;
 
+      if (lines->has_alpha)
+        multiply_alpha (line, len, bytes);
 
-          sp_p = src;
-          sp_m = src + (width - 1) * bytes;
-          vp = val_p;
-          vm = val_m + (width - 1) * bytes;
+      if (lines->filter->method == BLUR_IIR)
+        gauss_iir_line (lines->filter, line, len, bytes, val_p, val_m, val_s);
+      else
+        gauss_rle_line (lines->filter, line, len, bytes, rle, pix);
 
-          /*  Set up the first vals  */
-          for (i = 0; i < bytes; i++)
-            {
-              initial_p[i] = sp_p[i];
-              initial_m[i] = sp_m[i];
-            }
+      if (lines->has_alpha)
+        separate_alpha (line, len, bytes);
+    }
 
-          for (col = 0; col < width; col++)
-            {
-              gdouble *vpptr, *vmptr;
-
-              terms = (col < 4) ? col : 4;
-
-              for (b = 0; b < bytes; b++)
-                {
-                  vpptr = vp + b; vmptr = vm + b;
-
-                  for (i = 0; i <= terms; i++)
-                    {
-                      *vpptr += n_p[i] * sp_p[(-i * bytes) + b] -
-                        d_p[i] * vp[(-i * bytes) + b];
-                      *vmptr += n_m[i] * sp_m[(i * bytes) + b] -
-                        d_m[i] * vm[(i * bytes) + b];
-                    }
-                  for (j = i; j <= 4; j++)
-                    {
-                      *vpptr += (n_p[j] - bd_p[j]) * initial_p[b];
-                      *vmptr += (n_m[j] - bd_m[j]) * initial_m[b];
-                    }
-                }
-
-              sp_p += bytes;
-              sp_m -= bytes;
-              vp += bytes;
-              vm -= bytes;
-            }
+  g_free (val_p);
+  g_free (val_m);
+  g_free (val_s);
+  g_free (rle);
+  g_free (pix);
+}
 
-          transfer_pixels (val_p, val_m, dest, bytes, width);
+/*  Blurs 'n_lines' contiguous lines of 'len' pixels in place, spread
+ *  over the available processors.
+ */
+static void
+gauss_lines (const GaussFilter *filter,
+             guchar            *lines,
+             gint               n_lines,
+             gint               len,
+             gint               bytes,
+             gboolean           has_alpha)
+{
+  GaussJob job;
 
-          if (has_alpha)
-            separate_alpha (dest, width, bytes);
+  job.filter    = filter;
+  job.lines     = lines;
+  job.n_lines   = n_lines;
+  job.len       = len;
+  job.bytes     = bytes;
+  job.has_alpha = has_alpha;
 
-          if (direct)
-            {
-              gimp_pixel_rgn_set_row (&dest_rgn, dest, x1, row + y1, width);
+  gimp_parallel_run (MIN (gimp_parallel_get_n_threads (), n_lines),
+                     (GimpParallelFunc) gauss_job_func, &job, FALSE);
+}
 
-              progress += width * horz;
+/*  Copies the 'width' x 'height' pixels of 'src' transposed into
+ *  'dest', a block at a time so that both stay in the cache.
+ */
+static void
+gauss_transpose (const guchar *src,
+                 guchar       *dest,
+                 gint          width,
+                 gint          height,
+                 gint          bytes)
+{
+  gint bx, by;
 
-              if ((row % progress_step) == 0)
-                gimp_progress_update (progress / max_progress);
-            }
-          else
-            {
-              memcpy (preview_buffer + row * width * bytes,
-                      dest,
-                      width * bytes);
-            }
-        }
-    }
+  for (by = 0; by < height; by += GAUSS_BLOCK_SIZE)
+    for (bx = 0; bx < width; bx += GAUSS_BLOCK_SIZE)
+      {
+        gint x_end = MIN (bx + GAUSS_BLOCK_SIZE, width);
+        gint y_end = MIN (by + GAUSS_BLOCK_SIZE, height);
+        gint x, y;
 
-  /*  free up buffers  */
+        for (y = by; y < y_end; y++)
+          {
+            const guchar *s = src + (y * width + bx) * bytes;
 
-  g_free (val_p);
-  g_free (val_m);
+            for (x = bx; x < x_end; x++, s += bytes)
+              {
+                guchar *d = dest + (x * height + y) * bytes;
+                gint    b;
 
-  g_free (src);
-  g_free (dest);
+                for (b = 0; b < bytes; b++)
+                  d[b] = s[b];
+              }
+          }
+      }
 }
 
-
 static void
-gauss_rle (GimpDrawable *drawable,
-           gdouble       horz,
-           gdouble       vert,
-           BlurMethod    method,
-           guchar       *preview_buffer,
-           gint          x1,
-           gint          y1,
-           gint          width,
-           gint          height)
+gauss_blur (GimpDrawable *drawable,
+            gdouble       horz,
+            gdouble       vert,
+            BlurMethod    method,
+            guchar       *preview_buffer,
+            gint          x1,
+            gint          y1,
+            gint          width,
+            gint          height)
 {
   GimpPixelRgn  src_rgn, dest_rgn;
+  GaussFilter   filter;
   gint          bytes;
   gboolean      has_alpha;
-  guchar       *dest;
-  guchar       *src;
-  gint          row, col, b;
+  guchar       *strip;
+  guchar       *lines;
+  gint          row, col;
   gdouble       progress, max_progress;
-  gdouble       std_dev;
-  gint          total = 1;
-  gint         *curve = NULL;
-  gint         *sum   = NULL;
-  gint          length;
   gboolean      direct;
-  gint          progress_step;
+  gboolean      have_filter = FALSE;
 
   direct = (preview_buffer == NULL);
 
   bytes = drawable->bpp;
   has_alpha = gimp_drawable_has_alpha (drawable->drawable_id);
 
-  src  = g_new (guchar, MAX (width, height) * bytes);
-  dest = g_new (guchar, MAX (width, height) * bytes);
+  strip = g_new (guchar, GAUSS_STRIP_SIZE * MAX (width, height) * bytes);
+  lines = g_new (guchar, GAUSS_STRIP_SIZE * height * bytes);
 
   gimp_pixel_rgn_init (&src_rgn,
                        drawable, 0, 0, drawable->width, drawable->height,
                        FALSE, FALSE);
-
   if (direct)
     gimp_pixel_rgn_init (&dest_rgn,
                          drawable, 0, 0, drawable->width, drawable->height,
@@ -1208,93 +1290,46 @@ gauss_rle (GimpDrawable *drawable,
   max_progress  = (horz <= 0.0) ? 0 : width * height * horz;
   max_progress += (vert <= 0.0) ? 0 : width * height * vert;
 
-
   /*  First the vertical pass  */
   if (vert > 0.0)
     {
-      gint   * rle = NULL;
-      gint   * pix = NULL;
-
-      vert = fabs (vert) + 1.0;
-      std_dev = sqrt (-(vert * vert) / (2 * log (1.0 / 255.0)));
-
-      /* Insure that we do not have too many progress updates for
-       * images with a lot of rows or columns
-       */
-      progress_step = width / 16;
+      gauss_filter_init (&filter, method, vert);
+      have_filter = TRUE;
 
-      if (progress_step < 5)
-        progress_step = 5;
-
-      make_rle_curve (std_dev, &curve, &length, &sum, &total);
-
-      rle = g_new (gint, height + 2 * length);
-      rle += length; /* rle[] extends from -length to height+length-1 */
-
-      pix = g_new (gint, height + 2 * length);
-      pix += length; /* pix[] extends from -length to height+length-1 */
-
-      for (col = 0; col < width; col++)
+      for (col = 0; col < width; col += GAUSS_STRIP_SIZE)
         {
+          gint w = MIN (GAUSS_STRIP_SIZE, width - col);
 
-          gimp_pixel_rgn_get_col (&src_rgn, src, col + x1, y1, height);
+          gimp_pixel_rgn_get_rect (&src_rgn, strip, col + x1, y1, w, height);
 
-          if (has_alpha)
-            multiply_alpha (src, height, bytes);
-
-          for (b = 0; b < bytes; b++)
-            {
-              gint same =  run_length_encode (src + b, rle, pix, bytes,
-                                              height, length, TRUE);
-
-              if (same > (3 * height) / 4)
-                {
-                  /* encoded_rle is only fastest if there are a lot of
-                   * repeating pixels
-                   */
-                  do_encoded_lre (rle, pix, dest + b, height, length, bytes,
-                                  curve, total, sum);
-                }
-              else
-                {
-                  /* else a full but more simple algorithm is better */
-                  do_full_lre (pix, dest + b, height, length, bytes,
-                               curve, total);
-                }
-            }
-
-          if (has_alpha)
-            separate_alpha (dest, height, bytes);
+          gauss_transpose (strip, lines, w, height, bytes);
+          gauss_lines (&filter, lines, w, height, bytes, has_alpha);
+          gauss_transpose (lines, strip, height, w, bytes);
 
           if (direct)
             {
-              gimp_pixel_rgn_set_col (&dest_rgn, dest, col + x1, y1, height);
+              gimp_pixel_rgn_set_rect (&dest_rgn, strip,
+                                       col + x1, y1, w, height);
 
-              progress += height * vert;
+              progress += w * height * vert;
 
-              if ((col % progress_step) == 0)
-                gimp_progress_update (progress / max_progress);
+              gimp_progress_update (progress / max_progress);
             }
           else
             {
               for (row = 0; row < height; row++)
                 memcpy (preview_buffer + (row * width + col) * bytes,
-                        dest + row * bytes,
-                        bytes);
+                        strip + row * w * bytes,
+                        w * bytes);
             }
-
         }
 
-
-      g_free (rle - length);
-      g_free (pix - length);
-
-      /* prepare for the horizontal pass  */
+      /*  prepare for the horizontal pass  */
       gimp_pixel_rgn_init (&src_rgn,
                            drawable, 0, 0, drawable->width, drawable->height,
                            FALSE, TRUE);
     }
-  else if (!direct)
+  else if (! direct)
     {
       gimp_pixel_rgn_get_rect (&src_rgn,
                                preview_buffer, x1, y1, width, height);
@@ -1303,108 +1338,48 @@ gauss_rle (GimpDrawable *drawable,
   /*  Now the horizontal pass  */
   if (horz > 0.0)
     {
-      gint   * rle = NULL;
-      gint   * pix = NULL;
-
-      /* Insure that we do not have too many progress updates for
-       * images with a lot of rows or columns
-       */
-      progress_step = height / 16;
-
-      if (progress_step < 5) {
-        progress_step = 5;
-      }
-
-      horz = fabs (horz) + 1.0;
-
-      /* euse the same curve if possible else recompute a new one */
+      /*  reuse the same filter if possible else compute a new one  */
       if (horz != vert)
         {
+          if (have_filter)
+            gauss_filter_clear (&filter);
 
-          std_dev = sqrt (-(horz * horz) / (2 * log (1.0 / 255.0)));
-
-          if (curve != NULL) {
-            free_rle_curve(curve, length, sum);
-          }
-
-          make_rle_curve(std_dev, &curve, &length, &sum, &total);
-
+          gauss_filter_init (&filter, method, horz);
+          have_filter = TRUE;
         }
 
-
-      rle = g_new (gint, width+2*length);
-      rle += length; /* so rle[] extends from -width to width+length-1 */
-
-      pix = g_new (gint, width+2*length);
-      pix += length; /* so pix[] extends from -width to width+length-1 */
-
-      for (row = 0; row < height; row++)
+      for (row = 0; row < height; row += GAUSS_STRIP_SIZE)
         {
-          if (direct)
-            {
-              gimp_pixel_rgn_get_row (&src_rgn, src, x1, row + y1, width);
-            }
-          else
-            {
-              memcpy (src,
-                      preview_buffer + row * width * bytes,
-                      width * bytes);
-            }
-
-          if (has_alpha)
-            multiply_alpha (src, width, bytes);
+          gint h = MIN (GAUSS_STRIP_SIZE, height - row);
 
-          for (b = 0; b < bytes; b++)
+          if (direct)
             {
-              gint same = run_length_encode (src + b, rle, pix, bytes,
-                                             width, length, TRUE);
-
-              if (same > (3 * width) / 4)
-                {
-                  /* encoded_rle is only fastest if there are a lot of
-                   * repeating pixels
-                   */
-                  do_encoded_lre (rle, pix, dest + b, width, length, bytes,
-                                  curve, total, sum);
-                }
-              else
-                {
-                  /* else a full but more simple algorithm is better */
-                  do_full_lre (pix, dest + b, width, length, bytes,
-                               curve, total);
-                }
-            }
+              gimp_pixel_rgn_get_rect (&src_rgn, strip,
+                                       x1, row + y1, width, h);
 
+              gauss_lines (&filter, strip, h, width, bytes, has_alpha);
 
-          if (has_alpha)
-            separate_alpha (dest, width, bytes);
+              gimp_pixel_rgn_set_rect (&dest_rgn, strip,
+                                       x1, row + y1, width, h);
 
-          if (direct)
-            {
-              gimp_pixel_rgn_set_row (&dest_rgn, dest, x1, row + y1, width);
-
-              progress += width * horz;
+              progress += width * h * horz;
 
-              if ((row % progress_step) == 0)
-                gimp_progress_update (progress / max_progress);
+              gimp_progress_update (progress / max_progress);
             }
           else
             {
-              memcpy (preview_buffer + row * width * bytes,
-                      dest,
-                      width * bytes);
+              gauss_lines (&filter,
+                           preview_buffer + row * width * bytes,
+                           h, width, bytes, has_alpha);
             }
         }
-
-      g_free (rle - length);
-      g_free (pix - length);
     }
 
-  if (curve)
-    free_rle_curve (curve, length, sum);
+  if (have_filter)
+    gauss_filter_clear (&filter);
 
-  g_free (src);
-  g_free (dest);
+  g_free (strip);
+  g_free (lines);
 }
 
 
@@ -1449,12 +1424,8 @@ gauss (GimpDrawable *drawable,
     }
 
 
-  if (method == BLUR_IIR)
-    gauss_iir (drawable,
-               horz, vert, method, preview_buffer, x, y, width, height);
-  else
-    gauss_rle (drawable,
-               horz, vert, method, preview_buffer, x, y, width, height);
+  gauss_blur (drawable,
+              horz, vert, method, preview_buffer, x, y, width, height);
 
   if (preview)
     {
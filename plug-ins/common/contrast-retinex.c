@@ -69,6 +69,40 @@ typedef struct
   gdouble b[4];
 } gauss3_coefs;
 
+/*
+ * The columns are filtered in blocks of adjacent columns, so that the
+ * filters walk along the rows of the image instead of jumping from row
+ * to row, and the lines of the image are spread over several threads.
+ */
+#define RETINEX_BLOCK_SIZE   16
+
+typedef void (* RetinexFunc) (gpointer data,
+                              gint     start,
+                              gint     end);
+
+typedef struct
+{
+  RetinexFunc  func;
+  gpointer     data;
+  gint         n;
+} RetinexJob;
+
+/* One filtering of one channel at one scale */
+typedef struct
+{
+  const guchar       *src;
+  gfloat             *dst;
+  gint                bytes;
+  gint                channel;
+  gfloat              weight;
+  const gdouble      *log_src;  /* log (v + 1.0) for each value v */
+  const gfloat       *in;
+  gfloat             *out;
+  gint                width;
+  gint                height;
+  const gauss3_coefs *coef;
+} RetinexPass;
+
 
 /*
  * Declare local functions.
@@ -101,11 +135,21 @@ static void     compute_mean_var            (gfloat       *src,
 static void     compute_coefs3              (gauss3_coefs *c,
                                              gfloat        sigma);
 
-static void     gausssmooth                 (gfloat       *in,
+static void     gausssmooth                 (const gfloat *in,
+                                             gfloat       *out,
+                                             gint          size,
+                                             gint          rowtride,
+                                             const gauss3_coefs *c,
+                                             gfloat       *w1,
+                                             gfloat       *w2);
+static void     gausssmooth_block           (const gfloat *in,
                                              gfloat       *out,
                                              gint          size,
                                              gint          rowtride,
-                                             gauss3_coefs *c);
+                                             gint          n_lines,
+                                             const gauss3_coefs *c,
+                                             gfloat       *w1,
+                                             gfloat       *w2);
 
 /*
  * MSRCR = MultiScale Retinex with Color Restoration
@@ -556,8 +600,17 @@ compute_coefs3 (gauss3_coefs *c, gfloat sigma)
 */
 }
 
+/*
+ * 'w1' and 'w2' are two buffers of size + 3 values.
+ */
 static void
-gausssmooth (gfloat *in, gfloat *out, gint size, gint rowstride, gauss3_coefs *c)
+gausssmooth (const gfloat       *in,
+             gfloat             *out,
+             gint                size,
+             gint                rowstride,
+             const gauss3_coefs *c,
+             gfloat             *w1,
+             gfloat             *w2)
 {
   /*
    * Papers:  "Recursive Implementation of the gaussian filter.",
@@ -566,14 +619,10 @@ gausssmooth (gfloat *in, gfloat *out, gint size, gint rowstride, gauss3_coefs *c
    *          9b        backward filter
    *          fig7      algorithm
    */
-  gint i,n, bufsize;
-  gfloat *w1,*w2;
+  gint i,n;
 
   /* forward pass */
-  bufsize = size+3;
   size -= 1;
-  w1 = (gfloat *) g_try_malloc (bufsize * sizeof (gfloat));
-  w2 = (gfloat *) g_try_malloc (bufsize * sizeof (gfloat));
   w1[0] = in[0];
   w1[1] = in[0];
   w1[2] = in[0];
@@ -596,11 +645,167 @@ gausssmooth (gfloat *in, gfloat *out, gint size, gint rowstride, gauss3_coefs *c
                                              c->b[2]*w2[n+2] +
                                              c->b[3]*w2[n+3] ) / c->b[0]));
     }
+}
+
+/*
+ * The same as gausssmooth() for 'n_lines' adjacent lines at once, in
+ * and out point to the first value of the first line.  'w1' and 'w2'
+ * are two buffers of (size + 3) * n_lines values.
+ */
+static void
+gausssmooth_block (const gfloat       *in,
+                   gfloat             *out,
+                   gint                size,
+                   gint                rowstride,
+                   gint                n_lines,
+                   const gauss3_coefs *c,
+                   gfloat             *w1,
+                   gfloat             *w2)
+{
+  const gint nl = n_lines;
+  gint       i, n, k;
+
+  /* forward pass */
+  size -= 1;
+  for (k = 0; k < nl; k++)
+    {
+      w1[0 * nl + k] = in[k];
+      w1[1 * nl + k] = in[k];
+      w1[2 * nl + k] = in[k];
+    }
+  for (i = 0, n = 3; i <= size; i++, n++)
+    {
+      const gfloat *p = in + i * rowstride;
+      gfloat       *w = w1 + n * nl;
+
+      for (k = 0; k < nl; k++)
+        w[k] = (gfloat)(c->B*p[k] +
+                        ((c->b[1]*w[k - nl] +
+                          c->b[2]*w[k - 2 * nl] +
+                          c->b[3]*w[k - 3 * nl] ) / c->b[0]));
+    }
+
+  /* backward pass */
+  for (k = 0; k < nl; k++)
+    {
+      w2[(size + 1) * nl + k] = w1[(size + 3) * nl + k];
+      w2[(size + 2) * nl + k] = w1[(size + 3) * nl + k];
+      w2[(size + 3) * nl + k] = w1[(size + 3) * nl + k];
+    }
+  for (i = size, n = i; i >= 0; i--, n--)
+    {
+      gfloat       *p = out + i * rowstride;
+      gfloat       *w = w2 + n * nl;
+      const gfloat *v = w1 + (n + 3) * nl;
+
+      for (k = 0; k < nl; k++)
+        w[k] = p[k] = (gfloat)(c->B*v[k] +
+                               ((c->b[1]*w[k + nl] +
+                                 c->b[2]*w[k + 2 * nl] +
+                                 c->b[3]*w[k + 3 * nl] ) / c->b[0]));
+    }
+}
+
+static void
+retinex_job_func (gint        job,
+                  gint        n_jobs,
+                  gint        thread,
+                  RetinexJob *range)
+{
+  range->func (range->data,
+               (gint64) range->n * job       / n_jobs,
+               (gint64) range->n * (job + 1) / n_jobs);
+}
+
+/*
+ * Calls 'func' on ranges of [0, n) on the available processors.
+ */
+static void
+retinex_parallel (RetinexFunc func,
+                  gpointer    data,
+                  gint        n)
+{
+  RetinexJob range;
+
+  range.func = func;
+  range.data = data;
+  range.n    = n;
+
+  gimp_parallel_run (MIN (gimp_parallel_get_n_threads (), n),
+                     (GimpParallelFunc) retinex_job_func, &range, FALSE);
+}
+
+/* Filters the rows [start, end) */
+static void
+retinex_filter_rows (gpointer data,
+                     gint     start,
+                     gint     end)
+{
+  RetinexPass *pass = data;
+  gfloat      *w1   = g_new (gfloat, pass->width + 3);
+  gfloat      *w2   = g_new (gfloat, pass->width + 3);
+  gint         row;
+
+  for (row = start; row < end; row++)
+    {
+      gint pos = row * pass->width;
+
+      gausssmooth (pass->in + pos, pass->out + pos, pass->width, 1,
+                   pass->coef, w1, w2);
+    }
 
   g_free (w1);
   g_free (w2);
 }
 
+/* Filters the blocks of columns [start, end) */
+static void
+retinex_filter_cols (gpointer data,
+                     gint     start,
+                     gint     end)
+{
+  RetinexPass *pass = data;
+  gsize        size = (gsize) (pass->height + 3) * RETINEX_BLOCK_SIZE;
+  gfloat      *w1   = g_new (gfloat, size);
+  gfloat      *w2   = g_new (gfloat, size);
+  gint         block;
+
+  for (block = start; block < end; block++)
+    {
+      gint col = block * RETINEX_BLOCK_SIZE;
+
+      gausssmooth_block (pass->in + col, pass->out + col,
+                         pass->height, pass->width,
+                         MIN (RETINEX_BLOCK_SIZE, pass->width - col),
+                         pass->coef, w1, w2);
+    }
+
+  g_free (w1);
+  g_free (w2);
+}
+
+/*
+ * Summarize the filtered values of the pixels [start, end).
+ * In fact one calculates a ratio between the original values and the
+ * filtered values.
+ */
+static void
+retinex_accumulate (gpointer data,
+                    gint     start,
+                    gint     end)
+{
+  RetinexPass *pass = data;
+  gint         i, pos;
+
+  for (i = start, pos = start * pass->bytes + pass->channel;
+       i < end;
+       i++, pos += pass->bytes)
+    {
+      pass->dst[pos] += pass->weight * (pass->log_src[pass->src[pos]] -
+                                        log (pass->out[i]));
+    }
+}
+
 /*
  * This function is the heart of the algo.
  * (a)  Filterings at several scales and sumarize the results.
@@ -610,7 +815,7 @@ static void
 MSRCR (guchar *src, gint width, gint height, gint bytes, gboolean preview_mode)
 {
 
-  gint          scale,row,col;
+  gint          scale;
   gint          i,j;
   gint          size;
   gint          channel;
@@ -621,6 +826,10 @@ MSRCR (guchar *src, gint width, gint height, gint bytes, gboolean preview_mode)
   gint          channelsize;            /* Float memory cache for one channel */
   gfloat        weight;
   gauss3_coefs  coef;
+  RetinexPass   pass;
+  gdouble       log_src[256];           /* log (v + 1) */
+  gdouble       log_alpha_src[256];     /* log (alpha * (v + 1)) */
+  gdouble       log_sum[3 * 255 + 1];   /* log (r + g + b + 3) */
   gfloat        mean, var;
   gfloat        mini, range, maxi;
   gfloat        alpha;
@@ -662,6 +871,18 @@ MSRCR (guchar *src, gint width, gint height, gint bytes, gboolean preview_mode)
       return; /* do some clever stuff */
     }
 
+  alpha  = 128.;
+  gain   = 1.;
+  offset = 0.;
+
+  for (i = 0; i < 256; i++)
+    {
+      log_src[i]       = log (i + 1.);
+      log_alpha_src[i] = log (alpha * (i + 1.));
+    }
+
+  for (i = 0; i < (gint) G_N_ELEMENTS (log_sum); i++)
+    log_sum[i] = log ((gfloat) i + 3.);
 
   /*
      Calculate the scales of filtering according to the
@@ -678,6 +899,15 @@ MSRCR (guchar *src, gint width, gint height, gint bytes, gboolean preview_mode)
   */
   weight = 1./ (gfloat) rvals.nscales;
 
+  pass.src     = src;
+  pass.dst     = dst;
+  pass.bytes   = bytes;
+  pass.weight  = weight;
+  pass.log_src = log_src;
+  pass.width   = width;
+  pass.height  = height;
+  pass.coef    = &coef;
+
   /*
     The recursive filtering algorithm needs different coefficients according
     to the selected scale (~ = standard deviation of Gaussian).
@@ -691,42 +921,42 @@ MSRCR (guchar *src, gint width, gint height, gint bytes, gboolean preview_mode)
             /* 0-255 => 1-256 */
             in[i] = (gfloat)(src[pos] + 1.0);
          }
+
+      pass.channel = channel;
+
       for (scale = 0; scale < rvals.nscales; scale++)
         {
+          gfloat *tmp;
+
           compute_coefs3 (&coef, RetinexScales[scale]);
           /*
            *  Filtering (smoothing) Gaussian recursive.
            *
            *  Filter rows first
            */
-          for (row=0 ;row < height; row++)
-            {
-              pos =  row * width;
-              gausssmooth (in + pos, out + pos, width, 1, &coef);
-            }
+          pass.in  = in;
+          pass.out = out;
+          retinex_parallel (retinex_filter_rows, &pass, height);
 
-          memcpy(in,  out, channelsize * sizeof(gfloat));
-          memset(out, 0  , channelsize * sizeof(gfloat));
+          /*  The rows filtered become the input of the columns, and
+           *  of the rows of the next scale
+           */
+          tmp = in;
+          in  = out;
+          out = tmp;
 
           /*
            *  Filtering (smoothing) Gaussian recursive.
            *
            *  Second columns
            */
-          for (col=0; col < width; col++)
-            {
-              pos = col;
-              gausssmooth(in + pos, out + pos, height, width, &coef);
-            }
+          pass.in  = in;
+          pass.out = out;
+          retinex_parallel (retinex_filter_cols, &pass,
+                            (width + RETINEX_BLOCK_SIZE - 1) /
+                            RETINEX_BLOCK_SIZE);
 
-          /*
-             Summarize the filtered values.
-             In fact one calculates a ratio between the original values and the filtered values.
-           */
-          for (i = 0, pos = channel; i < channelsize; i++, pos += bytes)
-            {
-              dst[pos] += weight * (log (src[pos] + 1.) - log (out[i]));
-            }
+          retinex_parallel (retinex_accumulate, &pass, channelsize);
 
            if (!preview_mode)
              gimp_progress_update ((channel * rvals.nscales + scale) /
@@ -742,10 +972,6 @@ MSRCR (guchar *src, gint width, gint height, gint bytes, gboolean preview_mode)
   */
   /* Ci(x,y)=log[a Ii(x,y)]-log[ Ei=1-s Ii(x,y)] */
 
-  alpha  = 128.;
-  gain   = 1.;
-  offset = 0.;
-
   for (i = 0; i < size; i += bytes)
     {
       gfloat logl;
@@ -753,11 +979,11 @@ MSRCR (guchar *src, gint width, gint height, gint bytes, gboolean preview_mode)
       psrc = src+i;
       pdst = dst+i;
 
-      logl = log((gfloat)psrc[0] + (gfloat)psrc[1] + (gfloat)psrc[2] + 3.);
+      logl = log_sum[psrc[0] + psrc[1] + psrc[2]];
 
-      pdst[0] = gain * ((log(alpha * (psrc[0]+1.)) - logl) * pdst[0]) + offset;
-      pdst[1] = gain * ((log(alpha * (psrc[1]+1.)) - logl) * pdst[1]) + offset;
-      pdst[2] = gain * ((log(alpha * (psrc[2]+1.)) - logl) * pdst[2]) + offset;
+      pdst[0] = gain * ((log_alpha_src[psrc[0]] - logl) * pdst[0]) + offset;
+      pdst[1] = gain * ((log_alpha_src[psrc[1]] - logl) * pdst[1]) + offset;
+      pdst[2] = gain * ((log_alpha_src[psrc[2]] - logl) * pdst[2]) + offset;
     }
 
 /*  if (!preview_mode)
@@ -26,6 +26,11 @@
 
 #include "libgimp/stdplugins-intl.h"
 
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define CONVOLVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
 
 #define PLUG_IN_PROC   "plug-in-convmatrix"
 #define PLUG_IN_BINARY "convolution-matrix"
@@ -46,10 +51,12 @@
 
 #define HALF_WINDOW   (MATRIX_SIZE/2)
 #define MATRIX_CELLS  (MATRIX_SIZE*MATRIX_SIZE)
-#define DEST_ROWS     (MATRIX_SIZE/2 + 1)
 #define CHANNELS      (5)
 #define BORDER_MODES  (3)
 
+/* Rows of a band, the unit of work handed to the threads */
+#define CONVOLVE_BAND_HEIGHT  64
+
 
 
 typedef enum
@@ -90,10 +97,6 @@ static void      convolve_image        (GimpDrawable  *drawable,
 
 static void      check_config          (GimpDrawable  *drawable);
 
-static gfloat    convolve_pixel        (guchar       **src_row,
-                                        gint           x_offset,
-                                        gint           channel,
-                                        GimpDrawable  *drawable);
 
 const GimpPlugInInfo PLUG_IN_INFO =
 {
@@ -116,6 +119,20 @@ typedef struct
   gboolean   autoset;
 } config_struct;
 
+typedef struct
+{
+  guchar   *src;       /* The area, with HALF_WINDOW pixels of border */
+  guchar   *dst;
+  gint      width;
+  gint      height;
+  gint      bpp;
+  gboolean  chanmask[CHANNELS - 1];
+  gfloat    matrixsum;
+  gboolean  separable;
+  gfloat    u[MATRIX_SIZE]; /* matrix[x][y] == u[x] * v[y] if separable */
+  gfloat    v[MATRIX_SIZE];
+} ConvolveContext;
+
 #ifndef BIG_MATRIX
 static const config_struct default_config =
 {
@@ -461,77 +478,282 @@ my_get_row (GimpPixelRgn *PR,
     }
 }
 
-static gfloat
-convolve_pixel (guchar       **src_row,
-                gint           x_offset,
-                gint           channel,
-                GimpDrawable  *drawable)
+/* Looks for vectors u and v with matrix[x][y] == u[x] * v[y], in which
+ * case the matrix can be applied as a horizontal and a vertical pass.
+ * Returns FALSE if the matrix isn't separable, or if two passes
+ * wouldn't take fewer operations than one.
+ */
+static gboolean
+convolve_separate (gfloat u[MATRIX_SIZE],
+                   gfloat v[MATRIX_SIZE])
 {
-  static gfloat matrixsum = 0; /* FIXME: this certainly breaks the preview */
-  static gint bpp         = 0;
-
-  gfloat sum              = 0;
-  gfloat alphasum         = 0;
+  gfloat max = 0.0;
+  gint   pivot_x = 0, pivot_y = 0;
+  gint   n_taps = 0, n_taps_uv = 0;
   gint   x, y;
-  gint   alpha_channel;
 
-  if (!bpp)
-    {
-      bpp = drawable->bpp;
+  for (y = 0; y < MATRIX_SIZE; y++)
+    for (x = 0; x < MATRIX_SIZE; x++)
+      {
+        if (config.matrix[x][y] != 0.0)
+          n_taps++;
 
-      for (y = 0; y < MATRIX_SIZE; y++)
-        for (x = 0; x < MATRIX_SIZE; x++)
-          matrixsum += ABS (config.matrix[x][y]);
-    }
+        if (ABS (config.matrix[x][y]) > max)
+          {
+            max     = ABS (config.matrix[x][y]);
+            pivot_x = x;
+            pivot_y = y;
+          }
+      }
 
-  alpha_channel = bpp - 1;
+  if (max == 0.0)
+    return FALSE;
+
+  for (x = 0; x < MATRIX_SIZE; x++)
+    u[x] = config.matrix[x][pivot_y];
+
+  for (y = 0; y < MATRIX_SIZE; y++)
+    v[y] = config.matrix[pivot_x][y] / config.matrix[pivot_x][pivot_y];
 
   for (y = 0; y < MATRIX_SIZE; y++)
     for (x = 0; x < MATRIX_SIZE; x++)
-      {
-        gfloat temp = config.matrix[x][y];
+      if (ABS (config.matrix[x][y] - u[x] * v[y]) > max * 1e-5)
+        return FALSE;
+
+  for (x = 0; x < MATRIX_SIZE; x++)
+    {
+      if (u[x] != 0.0)
+        n_taps_uv++;
+      if (v[x] != 0.0)
+        n_taps_uv++;
+    }
+
+  return n_taps_uv < n_taps;
+}
+
+/* dest[i] += coeff * src[i], the inner loop of both the full and the
+ * separated convolution
+ */
+static inline void
+convolve_add_row (gfloat       *dest,
+                  const gfloat *src,
+                  gfloat        coeff,
+                  gint          n)
+{
+  gint i = 0;
 
-        if (channel != alpha_channel && config.alpha_weighting == 1)
+#ifdef CONVOLVE_SSE2
+  __m128 c = _mm_set1_ps (coeff);
+
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps (dest + i,
+                   _mm_add_ps (_mm_loadu_ps (dest + i),
+                               _mm_mul_ps (c, _mm_loadu_ps (src + i))));
+#endif
+
+  for (; i < n; i++)
+    dest[i] += coeff * src[i];
+}
+
+/* Convolves one channel of the rows y1 to y2 of the context */
+static void
+convolve_band_channel (ConvolveContext *ctx,
+                       gint             y1,
+                       gint             y2,
+                       gint             channel,
+                       gfloat          *values,
+                       gfloat          *weights,
+                       gfloat          *sums,
+                       gfloat          *alphasums)
+{
+  const gint  bpp           = ctx->bpp;
+  const gint  alpha_channel = bpp - 1;
+  const gint  src_w         = ctx->width + 2 * HALF_WINDOW;
+  const gint  n_rows        = y2 - y1 + 2 * HALF_WINDOW;
+  gboolean    weighted;
+  gfloat     *h_values  = NULL;
+  gfloat     *h_weights = NULL;
+  gint        x, y, i, j;
+
+  weighted = (channel != alpha_channel && config.alpha_weighting == 1);
+
+  /* Gather the channel, and its weight, as floats */
+  for (y = 0; y < n_rows; y++)
+    {
+      const guchar *s = ctx->src + ((y1 + y) * src_w) * bpp;
+      gfloat       *d = values + y * src_w;
+      gfloat       *w = weights + y * src_w;
+
+      for (x = 0; x < src_w; x++, s += bpp)
+        {
+          if (weighted)
+            {
+              w[x] = s[alpha_channel];
+              d[x] = s[channel] * w[x];
+            }
+          else
+            {
+              d[x] = s[channel];
+            }
+        }
+    }
+
+  if (ctx->separable)
+    {
+      /* Run the horizontal pass over all the rows, and then the
+       * vertical pass over its results
+       */
+      h_values  = g_new0 (gfloat, n_rows * ctx->width);
+      h_weights = weighted ? g_new0 (gfloat, n_rows * ctx->width) : NULL;
+
+      for (y = 0; y < n_rows; y++)
+        for (i = 0; i < MATRIX_SIZE; i++)
           {
-            temp *= src_row[y][x_offset + x * bpp + alpha_channel - channel];
-            alphasum += ABS (temp);
+            if (ctx->u[i] == 0.0)
+              continue;
+
+            convolve_add_row (h_values + y * ctx->width,
+                              values + y * src_w + i,
+                              ctx->u[i], ctx->width);
+
+            if (weighted)
+              convolve_add_row (h_weights + y * ctx->width,
+                                weights + y * src_w + i,
+                                ABS (ctx->u[i]), ctx->width);
           }
+    }
 
-        temp *= src_row[y][x_offset + x * bpp];
-        sum += temp;
-      }
+  for (y = 0; y < y2 - y1; y++)
+    {
+      guchar *d = ctx->dst + ((y1 + y) * ctx->width) * bpp + channel;
 
-  sum /= config.divisor;
+      memset (sums, 0, ctx->width * sizeof (gfloat));
+      if (weighted)
+        memset (alphasums, 0, ctx->width * sizeof (gfloat));
 
-  if (channel != alpha_channel && config.alpha_weighting == 1)
+      for (j = 0; j < MATRIX_SIZE; j++)
+        {
+          if (ctx->separable)
+            {
+              if (ctx->v[j] == 0.0)
+                continue;
+
+              convolve_add_row (sums, h_values + (y + j) * ctx->width,
+                                ctx->v[j], ctx->width);
+
+              if (weighted)
+                convolve_add_row (alphasums,
+                                  h_weights + (y + j) * ctx->width,
+                                  ABS (ctx->v[j]), ctx->width);
+            }
+          else
+            {
+              for (i = 0; i < MATRIX_SIZE; i++)
+                {
+                  if (config.matrix[i][j] == 0.0)
+                    continue;
+
+                  convolve_add_row (sums, values + (y + j) * src_w + i,
+                                    config.matrix[i][j], ctx->width);
+
+                  if (weighted)
+                    convolve_add_row (alphasums,
+                                      weights + (y + j) * src_w + i,
+                                      ABS (config.matrix[i][j]), ctx->width);
+                }
+            }
+        }
+
+      for (x = 0; x < ctx->width; x++, d += bpp)
+        {
+          gfloat sum = sums[x] / config.divisor;
+          gint   result;
+
+          if (weighted)
+            {
+              if (alphasums[x] != 0)
+                sum = sum * ctx->matrixsum / alphasums[x];
+              else
+                sum = 0;
+            }
+
+          sum += config.offset;
+
+          result = ROUND (sum);
+          *d = CLAMP (result, 0, 255);
+        }
+    }
+
+  g_free (h_values);
+  g_free (h_weights);
+}
+
+/* Convolves a band, called by gimp_parallel_run() */
+static void
+convolve_band (gint             band,
+               gint             n_bands,
+               gint             thread,
+               ConvolveContext *ctx)
+{
+  gint    src_w = ctx->width + 2 * HALF_WINDOW;
+  gint    y1    = band * CONVOLVE_BAND_HEIGHT;
+  gint    y2    = MIN (y1 + CONVOLVE_BAND_HEIGHT, ctx->height);
+  gint    n_rows;
+  gint    channel, x, y;
+  gfloat *values;
+  gfloat *weights;
+  gfloat *sums;
+  gfloat *alphasums;
+
+  n_rows    = y2 - y1 + 2 * HALF_WINDOW;
+  values    = g_new (gfloat, n_rows * src_w);
+  weights   = g_new (gfloat, n_rows * src_w);
+  sums      = g_new (gfloat, ctx->width);
+  alphasums = g_new (gfloat, ctx->width);
+
+  for (channel = 0; channel < ctx->bpp; channel++)
     {
-      if (alphasum != 0)
-        sum = sum * matrixsum / alphasum;
+      if (ctx->chanmask[channel])
+        {
+          convolve_band_channel (ctx, y1, y2, channel,
+                                 values, weights, sums, alphasums);
+        }
       else
-        sum = 0;
+        {
+          /* copy unmodified pixels */
+          for (y = y1; y < y2; y++)
+            {
+              const guchar *s = ctx->src + (((y + HALF_WINDOW) * src_w +
+                                             HALF_WINDOW) * ctx->bpp +
+                                            channel);
+              guchar       *d = ctx->dst + (y * ctx->width * ctx->bpp +
+                                            channel);
+
+              for (x = 0; x < ctx->width; x++)
+                d[x * ctx->bpp] = s[x * ctx->bpp];
+            }
+        }
     }
 
-  sum += config.offset;
-
-  return sum;
+  g_free (values);
+  g_free (weights);
+  g_free (sums);
+  g_free (alphasums);
 }
 
 static void
 convolve_image (GimpDrawable *drawable,
                 GimpPreview  *preview)
 {
-  GimpPixelRgn  srcPR, destPR;
-  gint          width, height, row, col;
-  gint          src_w, src_row_w, src_h, i;
-  gint          src_x1, src_y1, src_x2, src_y2;
-  gint          x1, x2, y1, y2;
-  guchar       *dest_row[DEST_ROWS];
-  guchar       *src_row[MATRIX_SIZE];
-  guchar       *tmp_row;
-  gint          x_offset;
-  gboolean      chanmask[CHANNELS - 1];
-  gint          bpp;
-  gint          alpha_channel;
+  ConvolveContext  ctx;
+  GimpPixelRgn     srcPR, destPR;
+  gint             width, height;
+  gint             src_w, src_row_w, src_h, i;
+  gint             src_x1, src_y1, src_x2, src_y2;
+  gint             x1, x2, y1, y2;
+  gint             x, y;
+  gint             bpp;
+  gint             alpha_channel;
 
   /* Get the input area. This is the bounding box of the selection in
    *  the image (or the entire image if there is no selection). Only
@@ -562,26 +784,36 @@ convolve_image (GimpDrawable *drawable,
   bpp  = drawable->bpp;
   alpha_channel = bpp - 1;
 
+  memset (ctx.chanmask, 0, sizeof (ctx.chanmask));
+
   if (gimp_drawable_is_rgb (drawable->drawable_id))
     {
       for (i = 0; i < CHANNELS - 1; i++)
-        chanmask[i] = config.channels[i + 1];
+        ctx.chanmask[i] = config.channels[i + 1];
     }
   else /* Grayscale */
     {
-      chanmask[0] = config.channels[0];
+      ctx.chanmask[0] = config.channels[0];
     }
 
   if (gimp_drawable_has_alpha (drawable->drawable_id))
-    chanmask[alpha_channel] = config.channels[4];
+    ctx.chanmask[alpha_channel] = config.channels[4];
 
-  src_row_w = src_w + HALF_WINDOW + HALF_WINDOW;
+  ctx.matrixsum = 0.0;
+
+  for (y = 0; y < MATRIX_SIZE; y++)
+    for (x = 0; x < MATRIX_SIZE; x++)
+      ctx.matrixsum += ABS (config.matrix[x][y]);
+
+  ctx.separable = convolve_separate (ctx.u, ctx.v);
 
-  for (i = 0; i < MATRIX_SIZE; i++)
-    src_row[i] = g_new (guchar, src_row_w * bpp);
+  src_row_w = src_w + HALF_WINDOW + HALF_WINDOW;
 
-  for (i = 0; i < DEST_ROWS; i++)
-    dest_row[i]= g_new (guchar, src_w * bpp);
+  ctx.src    = g_new (guchar, src_row_w * (src_h + 2 * HALF_WINDOW) * bpp);
+  ctx.dst    = g_new (guchar, src_w * src_h * bpp);
+  ctx.width  = src_w;
+  ctx.height = src_h;
+  ctx.bpp    = bpp;
 
   /*  initialize the pixel regions  */
   x1 = MAX (src_x1 - HALF_WINDOW, 0);
@@ -594,82 +826,25 @@ convolve_image (GimpDrawable *drawable,
                        src_x1, src_y1, src_w, src_h,
                        preview == NULL, TRUE);
 
-  /* initialize source arrays */
-  for (i = 0; i < MATRIX_SIZE; i++)
-    my_get_row (&srcPR, src_row[i], src_x1 - HALF_WINDOW,
-                src_y1 - HALF_WINDOW + i , src_row_w);
-
-  for (row = src_y1; row < src_y2; row++)
-    {
-      gint channel;
-
-      x_offset = 0;
-
-      for (col = src_x1; col < src_x2; col++)
-        for (channel = 0; channel < bpp; channel++)
-          {
-            guchar d;
-
-            if (chanmask[channel])
-              {
-                gint result;
-
-                result = ROUND (convolve_pixel (src_row,
-                                                x_offset, channel, drawable));
-                d = CLAMP (result, 0, 255);
-              }
-            else
-              {
-                /* copy unmodified pixel */
-                d = src_row[HALF_WINDOW][x_offset + HALF_WINDOW * bpp];
-              }
-
-            dest_row[HALF_WINDOW][x_offset] = d;
-            x_offset++;
-          }
-
-      if (row >= src_y1 + HALF_WINDOW)
-        gimp_pixel_rgn_set_row (&destPR,
-                                dest_row[0], src_x1, row - HALF_WINDOW, src_w);
-
-      if (row < src_y2 - 1)
-        {
-          tmp_row = dest_row[0];
-
-          for (i = 0; i < DEST_ROWS - 1; i++)
-            dest_row[i] = dest_row[i + 1];
-
-          dest_row[DEST_ROWS - 1] = tmp_row;
-
-          tmp_row = src_row[0];
-
-          for (i = 0; i < MATRIX_SIZE - 1; i++)
-            src_row[i] = src_row[i + 1];
-
-          src_row[MATRIX_SIZE-1] = tmp_row;
-
-          my_get_row (&srcPR, src_row[MATRIX_SIZE - 1],
-                      src_x1 - HALF_WINDOW, row + HALF_WINDOW + 1, src_row_w);
-        }
-
-      if ((row % 10 == 0) && !preview)
-        gimp_progress_update ((double) (row - src_y1) / src_h);
-    }
-
-  /* put the remaining rows in the buffer in place */
-  for (i = 1; i <  DEST_ROWS; i++)
-    gimp_pixel_rgn_set_row (&destPR, dest_row[i],
-                            src_x1, src_y2 + i - 1 - HALF_WINDOW, src_w);
+  /* The source rows, with their borders, are read up front, since the
+   * threads can't talk to the core
+   */
+  for (i = 0; i < src_h + 2 * HALF_WINDOW; i++)
+    my_get_row (&srcPR, ctx.src + i * src_row_w * bpp,
+                src_x1 - HALF_WINDOW, src_y1 - HALF_WINDOW + i, src_row_w);
 
+  gimp_parallel_run ((src_h + CONVOLVE_BAND_HEIGHT - 1) / CONVOLVE_BAND_HEIGHT,
+                     (GimpParallelFunc) convolve_band, &ctx, ! preview);
 
   /*  update the region  */
   if (preview)
     {
-      gimp_drawable_preview_draw_region (GIMP_DRAWABLE_PREVIEW (preview),
-                                         &destPR);
+      gimp_preview_draw_buffer (preview, ctx.dst, src_w * bpp);
     }
   else
     {
+      gimp_pixel_rgn_set_rect (&destPR, ctx.dst, src_x1, src_y1, src_w, src_h);
+
       gimp_progress_update (1.0);
       gimp_drawable_flush (drawable);
       gimp_drawable_merge_shadow (drawable->drawable_id, TRUE);
@@ -677,11 +852,8 @@ convolve_image (GimpDrawable *drawable,
                             src_x1, src_y1, src_x2 - src_x1, src_y2 - src_y1);
     }
 
-  for (i = 0; i < MATRIX_SIZE; i++)
-    g_free (src_row[i]);
-
-  for (i = 0; i < DEST_ROWS; i++)
-    g_free (dest_row[i]);
+  g_free (ctx.src);
+  g_free (ctx.dst);
 }
 
 /***************************************************
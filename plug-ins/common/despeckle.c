@@ -23,12 +23,18 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
 
 #include "libgimp/stdplugins-intl.h"
 
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define DESPECKLE_SSE2 1
+#include <emmintrin.h>
+#endif
+
 
 /*
  * Constants...
@@ -50,32 +56,34 @@
 #define black_level      (despeckle_vals[2])    /* Black level */
 #define white_level      (despeckle_vals[3])    /* White level */
 
-/* List that stores pixels falling in to the same luma bucket */
-#define MAX_LIST_ELEMS SQR(2 * MAX_RADIUS + 1)
+/* Rows of a band, the unit of work handed to the threads */
+#define DESPECKLE_BAND_HEIGHT  128
 
+/* Luminance histogram of the pixels around the target pixel.  The
+ * counts fit in 16 bits, since a window has at most
+ * SQR (2 * MAX_RADIUS + 1) pixels, and the coarse bins, each the sum
+ * of 16 fine bins, make finding the median cheap.
+ */
 typedef struct
 {
-  const guchar *elems[MAX_LIST_ELEMS];
-  gint          start;
-  gint          count;
-} PixelsList;
+  guint16  fine[256];
+  guint16  coarse[16];
+  gint     n_low;    /* Less than or equal to the black level    */
+  gint     n_high;   /* More than or equal to the white level    */
+  gint     n_rest;   /* From the black level to the white level  */
+} DespeckleHistogram;
 
 typedef struct
 {
-  gint       elems[256]; /* Number of pixels that fall into each luma bucket */
-  PixelsList origs[256]; /* Original pixels */
-  gint       xmin;
-  gint       ymin;
-  gint       xmax;
-  gint       ymax; /* Source rect */
-} DespeckleHistogram;
-
-/* Number of pixels in actual histogram falling into each category */
-static gint                hist0;    /* Less than min treshold */
-static gint                hist255;  /* More than max treshold */
-static gint                histrest; /* From min to max        */
-
-static DespeckleHistogram  histogram;
+  guchar        *src;
+  guchar        *dst;
+  guchar        *luma;       /* Luminance of each pixel of src */
+  gint           width;
+  gint           height;
+  gint           bpp;
+  gint           radius;
+  gint           band_height;
+} DespeckleContext;
 
 
 /*
@@ -373,8 +381,9 @@ pixel_copy (guchar       *dest,
  * 'despeckle()' - Despeckle an image using a median filter.
  *
  * A median filter basically collects pixel values in a region around the
- * target pixel, sorts them, and uses the median value. This code uses a
- * circular row buffer to improve performance.
+ * target pixel, sorts them, and uses the median value. This code keeps
+ * luminance histograms of the region, and filters bands of rows on
+ * several threads.
  *
  * The adaptive filter is based on the median filter but analizes the histogram
  * of the region around the target pixel and adjusts the despeckle diameter
@@ -634,145 +643,172 @@ dialog_recursive_callback (GtkWidget *widget,
 
 
 static inline void
-list_add_elem (PixelsList   *list,
-               const guchar *elem)
+histogram_clean (DespeckleHistogram *hist)
 {
-  const gint pos = list->start + list->count++;
-
-  list->elems[pos >= MAX_LIST_ELEMS ? pos - MAX_LIST_ELEMS : pos] = elem;
+  memset (hist, 0, sizeof (DespeckleHistogram));
 }
 
 static inline void
-list_del_elem (PixelsList* list)
-{
-  list->count--;
-  list->start++;
-
-  if (list->start >= MAX_LIST_ELEMS)
-    list->start = 0;
-}
-
-static inline const guchar *
-list_get_random_elem (PixelsList *list)
+histogram_add (DespeckleHistogram *hist,
+               guchar              value)
 {
-  const gint pos = list->start + rand () % list->count;
-
-  if (pos >= MAX_LIST_ELEMS)
-    return list->elems[pos - MAX_LIST_ELEMS];
+  hist->fine[value]++;
+  hist->coarse[value >> 4]++;
 
-  return list->elems[pos];
-}
+  if (value > black_level && value < white_level)
+    {
+      hist->n_rest++;
+    }
+  else
+    {
+      if (value <= black_level)
+        hist->n_low++;
 
-static inline void
-histogram_add (DespeckleHistogram *hist,
-               guchar              val,
-               const guchar       *orig)
-{
-  hist->elems[val]++;
-  list_add_elem (&hist->origs[val], orig);
+      if (value >= white_level)
+        hist->n_high++;
+    }
 }
 
 static inline void
 histogram_remove (DespeckleHistogram *hist,
-                  guchar              val)
+                  guchar              value)
 {
-  hist->elems[val]--;
-  list_del_elem (&hist->origs[val]);
+  hist->fine[value]--;
+  hist->coarse[value >> 4]--;
+
+  if (value > black_level && value < white_level)
+    {
+      hist->n_rest--;
+    }
+  else
+    {
+      if (value <= black_level)
+        hist->n_low--;
+
+      if (value >= white_level)
+        hist->n_high--;
+    }
 }
 
+/* Adds (sign 1) or subtracts (sign -1) the histogram 'src' to 'hist' */
 static inline void
-histogram_clean (DespeckleHistogram *hist)
+histogram_merge (DespeckleHistogram       *hist,
+                 const DespeckleHistogram *src,
+                 gint                      sign)
 {
   gint i;
 
-  for (i = 0; i < 256; i++)
+#ifdef DESPECKLE_SSE2
+  if (sign > 0)
     {
-      hist->elems[i] = 0;
-      hist->origs[i].count = 0;
+      for (i = 0; i < 256; i += 8)
+        _mm_storeu_si128 ((__m128i *) (hist->fine + i),
+                          _mm_add_epi16 (_mm_loadu_si128 ((const __m128i *) (hist->fine + i)),
+                                         _mm_loadu_si128 ((const __m128i *) (src->fine + i))));
+      for (i = 0; i < 16; i += 8)
+        _mm_storeu_si128 ((__m128i *) (hist->coarse + i),
+                          _mm_add_epi16 (_mm_loadu_si128 ((const __m128i *) (hist->coarse + i)),
+                                         _mm_loadu_si128 ((const __m128i *) (src->coarse + i))));
     }
+  else
+    {
+      for (i = 0; i < 256; i += 8)
+        _mm_storeu_si128 ((__m128i *) (hist->fine + i),
+                          _mm_sub_epi16 (_mm_loadu_si128 ((const __m128i *) (hist->fine + i)),
+                                         _mm_loadu_si128 ((const __m128i *) (src->fine + i))));
+      for (i = 0; i < 16; i += 8)
+        _mm_storeu_si128 ((__m128i *) (hist->coarse + i),
+                          _mm_sub_epi16 (_mm_loadu_si128 ((const __m128i *) (hist->coarse + i)),
+                                         _mm_loadu_si128 ((const __m128i *) (src->coarse + i))));
+    }
+#else
+  for (i = 0; i < 256; i++)
+    hist->fine[i] += sign * src->fine[i];
+
+  for (i = 0; i < 16; i++)
+    hist->coarse[i] += sign * src->coarse[i];
+#endif
+
+  hist->n_low  += sign * src->n_low;
+  hist->n_high += sign * src->n_high;
+  hist->n_rest += sign * src->n_rest;
 }
 
-static inline const guchar *
-histogram_get_median (DespeckleHistogram *hist,
-                      const guchar       *_default)
+/* Returns the median luminance of the pixels between the black and
+ * white levels, or -1 if there are none.
+ */
+static inline gint
+histogram_get_median (const DespeckleHistogram *hist)
 {
-  gint count = histrest;
+  gint count = hist->n_rest;
+  gint sum   = 0;
   gint i;
-  gint sum = 0;
 
   if (! count)
-    return _default;
+    return -1;
 
-  count = (count + 1) / 2;
+  /* Since the pixels below the black level are all in the first
+   * bins, the median is the pixel at this position of the whole
+   * histogram
+   */
+  count = hist->n_low + (count + 1) / 2;
 
   i = 0;
-  while ((sum += hist->elems[i]) < count)
+  while (sum + hist->coarse[i] < count)
+    sum += hist->coarse[i++];
+
+  i <<= 4;
+  while ((sum += hist->fine[i]) < count)
     i++;
 
-  return list_get_random_elem (&hist->origs[i]);
+  return i;
 }
 
-static inline void
-add_val (DespeckleHistogram *hist,
-         const guchar       *src,
-         gint                width,
-         gint                bpp,
-         gint                x,
-         gint                y)
+/* Finds a pixel of luminance 'value' in the rect, trying the rows
+ * nearest to row 'y' first.
+ */
+static inline const guchar *
+find_pixel (const DespeckleContext *ctx,
+            guchar                  value,
+            gint                    y,
+            gint                    xmin,
+            gint                    ymin,
+            gint                    xmax,
+            gint                    ymax)
 {
-  const gint pos   = (x + (y * width)) * bpp;
-  const gint value = pixel_luminance (src + pos, bpp);
+  gint d;
 
-  if (value > black_level && value < white_level)
-  {
-    histogram_add (hist, value, src + pos);
-    histrest++;
-  }
-  else
-  {
-    if (value <= black_level)
-      hist0++;
+  for (d = 0; y - d >= ymin || y + d <= ymax; d++)
+    {
+      gint i;
 
-    if (value >= white_level)
-      hist255++;
-  }
-}
+      for (i = 0; i < 2; i++)
+        {
+          const gint    row = i ? y + d : y - d;
+          const guchar *luma;
+          const guchar *p;
 
-static inline void
-del_val (DespeckleHistogram *hist,
-         const guchar       *src,
-         gint                width,
-         gint                bpp,
-         gint                x,
-         gint                y)
-{
-  const gint pos   = (x + (y * width)) * bpp;
-  const gint value = pixel_luminance (src + pos, bpp);
+          if (row < ymin || row > ymax || (i && d == 0))
+            continue;
 
-  if (value > black_level && value < white_level)
-  {
-    histogram_remove (hist, value);
-    histrest--;
-  }
-  else
-  {
-    if (value <= black_level)
-      hist0--;
+          luma = ctx->luma + row * ctx->width;
+          p    = memchr (luma + xmin, value, xmax - xmin + 1);
+
+          if (p)
+            return ctx->src + (p - ctx->luma) * ctx->bpp;
+        }
+    }
 
-    if (value >= white_level)
-      hist255--;
-  }
+  return NULL;
 }
 
 static inline void
-add_vals (DespeckleHistogram *hist,
-          const guchar       *src,
-          gint                width,
-          gint                bpp,
-          gint                xmin,
-          gint                ymin,
-          gint                xmax,
-          gint                ymax)
+add_vals (DespeckleHistogram     *hist,
+          const DespeckleContext *ctx,
+          gint                    xmin,
+          gint                    ymin,
+          gint                    xmax,
+          gint                    ymax)
 {
   gint x;
   gint y;
@@ -782,22 +818,20 @@ add_vals (DespeckleHistogram *hist,
 
   for (y = ymin; y <= ymax; y++)
     {
+      const guchar *luma = ctx->luma + y * ctx->width;
+
       for (x = xmin; x <= xmax; x++)
-        {
-          add_val (hist, src, width, bpp, x, y);
-        }
+        histogram_add (hist, luma[x]);
     }
 }
 
 static inline void
-del_vals (DespeckleHistogram *hist,
-          const guchar       *src,
-          gint                width,
-          gint                bpp,
-          gint                xmin,
-          gint                ymin,
-          gint                xmax,
-          gint                ymax)
+del_vals (DespeckleHistogram     *hist,
+          const DespeckleContext *ctx,
+          gint                    xmin,
+          gint                    ymin,
+          gint                    xmax,
+          gint                    ymax)
 {
   gint x;
   gint y;
@@ -807,136 +841,280 @@ del_vals (DespeckleHistogram *hist,
 
   for (y = ymin; y <= ymax; y++)
     {
+      const guchar *luma = ctx->luma + y * ctx->width;
+
       for (x = xmin; x <= xmax; x++)
-        {
-          del_val (hist, src, width, bpp, x, y);
-        }
+        histogram_remove (hist, luma[x]);
     }
 }
 
+/* Moves the source rect of 'hist' from (*hxmin, *hymin, *hxmax, *hymax)
+ * to (xmin, ymin, xmax, ymax).
+ */
 static inline void
-update_histogram (DespeckleHistogram *hist,
-                  const guchar       *src,
-                  gint                width,
-                  gint                bpp,
-                  gint                xmin,
-                  gint                ymin,
-                  gint                xmax,
-                  gint                ymax)
+update_histogram (DespeckleHistogram     *hist,
+                  const DespeckleContext *ctx,
+                  gint                   *hxmin,
+                  gint                   *hymin,
+                  gint                   *hxmax,
+                  gint                   *hymax,
+                  gint                    xmin,
+                  gint                    ymin,
+                  gint                    xmax,
+                  gint                    ymax)
 {
   /* assuming that radious of the box can change no more than one
      pixel in each call */
   /* assuming that box is moving either right or down */
 
-  del_vals (hist,
-            src, width, bpp, hist->xmin, hist->ymin, xmin - 1, hist->ymax);
-  del_vals (hist, src, width, bpp, xmin, hist->ymin, xmax, ymin - 1);
-  del_vals (hist, src, width, bpp, xmin, ymax + 1, xmax, hist->ymax);
+  del_vals (hist, ctx, *hxmin, *hymin, xmin - 1, *hymax);
+  del_vals (hist, ctx, xmin, *hymin, xmax, ymin - 1);
+  del_vals (hist, ctx, xmin, ymax + 1, xmax, *hymax);
 
-  add_vals (hist, src, width, bpp, hist->xmax + 1, ymin, xmax, ymax);
-  add_vals (hist, src, width, bpp, xmin, ymin, hist->xmax, hist->ymin - 1);
-  add_vals (hist,
-            src, width, bpp, hist->xmin, hist->ymax + 1, hist->xmax, ymax);
+  add_vals (hist, ctx, *hxmax + 1, ymin, xmax, ymax);
+  add_vals (hist, ctx, xmin, ymin, *hxmax, *hymin - 1);
+  add_vals (hist, ctx, *hxmin, *hymax + 1, *hxmax, ymax);
 
-  hist->xmin = xmin;
-  hist->ymin = ymin;
-  hist->xmax = xmax;
-  hist->ymax = ymax;
+  *hxmin = xmin;
+  *hymin = ymin;
+  *hxmax = xmax;
+  *hymax = ymax;
 }
 
+/* Writes the median pixel of 'hist' for (x, y), and in recursive mode
+ * puts it back into the source.  Returns the replaced luminance, or
+ * -1 if the source is unchanged.
+ */
+static inline gint
+despeckle_pixel (DespeckleContext         *ctx,
+                 const DespeckleHistogram *hist,
+                 gint                      x,
+                 gint                      y,
+                 gint                      xmin,
+                 gint                      ymin,
+                 gint                      xmax,
+                 gint                      ymax)
+{
+  const gint    pos    = x + y * ctx->width;
+  const gint    median = histogram_get_median (hist);
+  const guchar *pixel  = NULL;
+  gint          old    = -1;
+
+  if (median >= 0)
+    pixel = find_pixel (ctx, median, y, xmin, ymin, xmax, ymax);
+
+  if (! pixel)
+    pixel = ctx->src + pos * ctx->bpp;
+
+  if ((filter_type & FILTER_RECURSIVE) && median >= 0)
+    {
+      if (ctx->luma[pos] != median)
+        {
+          old = ctx->luma[pos];
+          ctx->luma[pos] = median;
+        }
+
+      pixel_copy (ctx->src + pos * ctx->bpp, pixel, ctx->bpp);
+
+      pixel = ctx->src + pos * ctx->bpp;
+    }
+
+  pixel_copy (ctx->dst + pos * ctx->bpp, pixel, ctx->bpp);
+
+  return old;
+}
 
+/* The median of a fixed size window, after Perreault and Hébert: each
+ * column keeps a histogram of its 2 * radius + 1 pixels around the
+ * current row, so moving the window right only adds one column
+ * histogram and subtracts another.
+ */
 static void
-despeckle_median (guchar   *src,
-                  guchar   *dst,
-                  gint      width,
-                  gint      height,
-                  gint      bpp,
-                  gint      radius,
-                  gboolean  preview)
+despeckle_band_fixed (DespeckleContext *ctx,
+                      gint              y1,
+                      gint              y2)
 {
-  guint  progress;
-  guint  max_progress;
-  gint   x, y;
-  gint   adapt_radius;
-  gint   pos;
-  gint   ymin;
-  gint   ymax;
-  gint   xmin;
-  gint   xmax;
-
-  memset (&histogram, 0, sizeof(histogram));
-  progress     = 0;
-  max_progress = width * height;
+  const gint          width  = ctx->width;
+  const gint          radius = ctx->radius;
+  DespeckleHistogram *cols   = g_new0 (DespeckleHistogram, width);
+  DespeckleHistogram  hist;
+  gint                top    = MAX (0, y1 - radius);
+  gint                bottom = top - 1;
+  gint                x, y;
+
+  for (y = y1; y < y2; y++)
+    {
+      const gint ymin = MAX (0, y - radius);
+      const gint ymax = MIN (ctx->height - 1, y + radius);
 
-  if (! preview)
-    gimp_progress_init(_("Despeckle"));
+      while (bottom < ymax)
+        {
+          const guchar *luma = ctx->luma + ++bottom * width;
 
-  adapt_radius = radius;
-  for (y = 0; y < height; y++)
-    {
-      x = 0;
-      ymin = MAX (0, y - adapt_radius);
-      ymax = MIN (height - 1, y + adapt_radius);
-      xmin = MAX (0, x - adapt_radius);
-      xmax = MIN (width - 1, x + adapt_radius);
-      hist0   = 0;
-      histrest = 0;
-      hist255 = 0;
-      histogram_clean (&histogram);
-      histogram.xmin = xmin;
-      histogram.ymin = ymin;
-      histogram.xmax = xmax;
-      histogram.ymax = ymax;
-      add_vals (&histogram,
-                src, width, bpp,
-                histogram.xmin, histogram.ymin, histogram.xmax, histogram.ymax);
+          for (x = 0; x < width; x++)
+            histogram_add (&cols[x], luma[x]);
+        }
+
+      while (top < ymin)
+        {
+          const guchar *luma = ctx->luma + top++ * width;
+
+          for (x = 0; x < width; x++)
+            histogram_remove (&cols[x], luma[x]);
+        }
+
+      histogram_clean (&hist);
+
+      for (x = 0; x <= MIN (width - 1, radius); x++)
+        histogram_merge (&hist, &cols[x], 1);
 
       for (x = 0; x < width; x++)
         {
-          const guchar *pixel;
+          const gint xmin = MAX (0, x - radius);
+          const gint xmax = MIN (width - 1, x + radius);
+          gint       old;
 
-          ymin = MAX (0, y - adapt_radius); /* update ymin, ymax when adapt_radius changed (FILTER_ADAPTIVE) */
-          ymax = MIN (height - 1, y + adapt_radius);
-          xmin = MAX (0, x - adapt_radius);
-          xmax = MIN (width - 1, x + adapt_radius);
+          if (x > 0)
+            {
+              if (x + radius < width)
+                histogram_merge (&hist, &cols[x + radius], 1);
 
-          update_histogram (&histogram,
-                            src, width, bpp, xmin, ymin, xmax, ymax);
+              if (x - radius - 1 >= 0)
+                histogram_merge (&hist, &cols[x - radius - 1], -1);
+            }
 
-          pos = (x + (y * width)) * bpp;
-          pixel = histogram_get_median (&histogram, src + pos);
+          old = despeckle_pixel (ctx, &hist, x, y, xmin, ymin, xmax, ymax);
 
-          if (filter_type & FILTER_RECURSIVE)
+          if (old >= 0)
             {
-              del_val (&histogram, src, width, bpp, x, y);
-              pixel_copy (src + pos, pixel, bpp);
-              add_val (&histogram, src, width, bpp, x, y);
+              const guchar value = ctx->luma[x + y * width];
+
+              histogram_remove (&hist, old);
+              histogram_add (&hist, value);
+
+              histogram_remove (&cols[x], old);
+              histogram_add (&cols[x], value);
             }
+        }
+    }
 
-          pixel_copy (dst + pos, pixel, bpp);
+  g_free (cols);
+}
+
+/* The adaptive filter changes the size of the window from one pixel
+ * to the next, so it moves a single histogram around instead.
+ */
+static void
+despeckle_band_adaptive (DespeckleContext *ctx,
+                         gint              y1,
+                         gint              y2)
+{
+  const gint          width        = ctx->width;
+  const gint          height       = ctx->height;
+  const gint          radius       = ctx->radius;
+  gint                adapt_radius = radius;
+  DespeckleHistogram  hist;
+  gint                x, y;
+
+  for (y = y1; y < y2; y++)
+    {
+      gint hxmin = 0;
+      gint hymin = MAX (0, y - adapt_radius);
+      gint hxmax = MIN (width - 1, adapt_radius);
+      gint hymax = MIN (height - 1, y + adapt_radius);
+
+      histogram_clean (&hist);
+      add_vals (&hist, ctx, hxmin, hymin, hxmax, hymax);
+
+      for (x = 0; x < width; x++)
+        {
+          /* update ymin, ymax when adapt_radius changed */
+          const gint ymin = MAX (0, y - adapt_radius);
+          const gint ymax = MIN (height - 1, y + adapt_radius);
+          const gint xmin = MAX (0, x - adapt_radius);
+          const gint xmax = MIN (width - 1, x + adapt_radius);
+          gint       old;
+
+          update_histogram (&hist, ctx, &hxmin, &hymin, &hxmax, &hymax,
+                            xmin, ymin, xmax, ymax);
+
+          old = despeckle_pixel (ctx, &hist, x, y, xmin, ymin, xmax, ymax);
+
+          if (old >= 0)
+            {
+              histogram_remove (&hist, old);
+              histogram_add (&hist, ctx->luma[x + y * width]);
+            }
 
           /*
            * Check the histogram and adjust the diameter accordingly...
            */
-          if (filter_type & FILTER_ADAPTIVE)
+          if (hist.n_low >= adapt_radius || hist.n_high >= adapt_radius)
             {
-              if (hist0 >= adapt_radius || hist255 >= adapt_radius)
-                {
-                  if (adapt_radius < radius)
-                    adapt_radius++;
-                }
-              else if (adapt_radius > 1)
-                {
-                  adapt_radius--;
-                }
+              if (adapt_radius < radius)
+                adapt_radius++;
+            }
+          else if (adapt_radius > 1)
+            {
+              adapt_radius--;
             }
         }
+    }
+}
 
-      progress += width;
+/* Despeckles a band, called by gimp_parallel_run() */
+static void
+despeckle_band (gint              band,
+                gint              n_bands,
+                gint              thread,
+                DespeckleContext *ctx)
+{
+  gint y1 = band * ctx->band_height;
+  gint y2 = MIN (y1 + ctx->band_height, ctx->height);
 
-      if (! preview && y % 32 == 0)
-        gimp_progress_update ((gdouble) progress / (gdouble) max_progress);
-    }
+  if (filter_type & FILTER_ADAPTIVE)
+    despeckle_band_adaptive (ctx, y1, y2);
+  else
+    despeckle_band_fixed (ctx, y1, y2);
+}
+
+static void
+despeckle_median (guchar   *src,
+                  guchar   *dst,
+                  gint      width,
+                  gint      height,
+                  gint      bpp,
+                  gint      radius,
+                  gboolean  preview)
+{
+  DespeckleContext  ctx;
+  gint              i;
+
+  if (! preview)
+    gimp_progress_init(_("Despeckle"));
+
+  ctx.src         = src;
+  ctx.dst         = dst;
+  ctx.luma        = g_new (guchar, width * height);
+  ctx.width       = width;
+  ctx.height      = height;
+  ctx.bpp         = bpp;
+  ctx.radius      = radius;
+  ctx.band_height = DESPECKLE_BAND_HEIGHT;
+
+  for (i = 0; i < width * height; i++)
+    ctx.luma[i] = pixel_luminance (src + i * bpp, bpp);
+
+  /* The recursive filter works on the pixels it has already filtered,
+   * so it can only be done in a single pass over the whole image
+   */
+  if (filter_type & FILTER_RECURSIVE)
+    ctx.band_height = height;
+
+  gimp_parallel_run ((height + ctx.band_height - 1) / ctx.band_height,
+                     (GimpParallelFunc) despeckle_band, &ctx, ! preview);
+
+  g_free (ctx.luma);
 
   if (! preview)
     gimp_progress_update (1.0);
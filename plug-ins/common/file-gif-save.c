@@ -44,14 +44,8 @@
 #define PLUG_IN_ROLE   "gimp-file-gif-save"
 
 
-/* Define only one of these to determine which kind of gif's you would like.
- * GIF_UN means use uncompressed gifs.  These will be large, but no
- * patent problems.
- * GIF_RLE uses Run-length-encoding, which should not be covered by the
- * patent, but this is not legal advice.
- */
-/* #define GIF_UN */
-/* #define GIF_RLE */
+/* the most threads encoding frames at the same time */
+#define MAX_ENCODER_THREADS 16
 
 /* uncomment the line below for a little debugging info */
 /* #define GIFDEBUG yesplease */
@@ -87,6 +81,28 @@ typedef struct
   gboolean as_animation;
 } GIFSaveVals;
 
+typedef struct
+{
+  guchar     *pixels;       /* the palette indices, width x height */
+  gint        width;
+  gint        height;
+  gint        offset_x;
+  gint        offset_y;
+  gboolean    interlace;
+  gint        bpp;
+  gint        transparent;
+  gint        disposal;
+  gint        delay;
+  GByteArray *data;         /* the LZW compressed image data */
+  gboolean    encoded;
+} GIFFrame;
+
+typedef struct
+{
+  GMutex      mutex;
+  GCond       cond;
+} GIFFrameEncoder;
+
 
 /* Declare some local functions.
  */
@@ -119,10 +135,6 @@ static GimpRunMode run_mode;
 static GimpParasite * comment_parasite = NULL;
 #endif
 
-/* For compression code */
-static gint Interlace;
-
-
 const GimpPlugInInfo PLUG_IN_INFO =
 {
   NULL,  /* init_proc  */
@@ -349,23 +361,6 @@ static gchar * globalcomment = NULL;
 
 #define MAXCOLORS 256
 
-/*
- * Pointer to function returning an int
- */
-typedef int (*ifunptr) (int, int);
-
-/*
- * a code_int must be able to hold 2**BITS values of type int, and also -1
- */
-typedef int code_int;
-
-#ifdef SIGNED_COMPARE_SLOW
-typedef unsigned long int count_int;
-typedef unsigned short int count_short;
-#else /*SIGNED_COMPARE_SLOW */
-typedef long int count_int;
-#endif /*SIGNED_COMPARE_SLOW */
-
 
 
 static gint find_unused_ia_colour   (const guchar *pixels,
@@ -378,43 +373,25 @@ static void special_flatten_indexed_alpha (guchar *pixels,
                                            gint    numpixels);
 static int colors_to_bpp  (int);
 static int bpp_to_colors  (int);
-static int get_pixel      (int, int);
-static int gif_next_pixel (ifunptr);
-static void bump_pixel    (void);
 
 static void gif_encode_header              (FILE *, gboolean, int, int, int, int,
-                                            int *, int *, int *, ifunptr);
-static void gif_encode_graphic_control_ext (FILE *, int, int, int, int,
-                                            int, int, int, ifunptr);
+                                            int *, int *, int *);
+static void gif_encode_graphic_control_ext (FILE *, int, int, int, int, int);
 static void gif_encode_image_data          (FILE *, int, int, int, int,
-                                            ifunptr, gint, gint);
+                                            const GByteArray *, gint, gint);
 static void gif_encode_close               (FILE *);
 static void gif_encode_loop_ext            (FILE *, guint);
 static void gif_encode_comment_ext         (FILE *, const gchar *comment);
 
-static gint     rowstride;
-static guchar  *pixels;
-static gint     cur_progress;
-static gint     max_progress;
-
-#ifdef GIF_UN
-static void no_compress     (int, FILE *, ifunptr);
-#else
-#ifdef GIF_RLE
-static void rle_compress    (int, FILE *, ifunptr);
-#else
-static void normal_compress (int, FILE *, ifunptr);
-#endif
-#endif
-static void put_word   (int, FILE *);
-static void compress   (int, FILE *, ifunptr);
-static void output     (code_int);
-static void cl_block   (void);
-static void cl_hash    (count_int);
-static void write_err  (void);
-static void char_init  (void);
-static void char_out   (int);
-static void flush_char (void);
+static int  gif_init_code_size (int);
+static void put_word           (int, FILE *);
+
+static void gif_lzw_encode (const guchar *pixels,
+                            gint          width,
+                            gint          height,
+                            gboolean      interlace,
+                            gint          init_code_size,
+                            GByteArray   *out);
 
 
 
@@ -630,6 +607,49 @@ sanity_check (const gchar  *filename,
 }
 
 
+/*
+ * encoder threads
+ */
+static void
+gif_encode_frame (GIFFrame        *frame,
+                  GIFFrameEncoder *encoder)
+{
+  GByteArray *data = g_byte_array_new ();
+
+  gif_lzw_encode (frame->pixels, frame->width, frame->height,
+                  frame->interlace, gif_init_code_size (frame->bpp), data);
+
+  g_free (frame->pixels);
+  frame->pixels = NULL;
+
+  g_mutex_lock (&encoder->mutex);
+
+  frame->data    = data;
+  frame->encoded = TRUE;
+
+  g_cond_broadcast (&encoder->cond);
+  g_mutex_unlock (&encoder->mutex);
+}
+
+static void
+gif_write_frame (FILE     *outfile,
+                 GIFFrame *frame,
+                 gboolean  is_gif89,
+                 gint      nlayers)
+{
+  if (is_gif89)
+    gif_encode_graphic_control_ext (outfile, frame->disposal, frame->delay,
+                                    nlayers, frame->transparent, frame->bpp);
+
+  gif_encode_image_data (outfile, frame->width, frame->height,
+                         frame->interlace, frame->bpp, frame->data,
+                         frame->offset_x, frame->offset_y);
+
+  g_byte_array_free (frame->data, TRUE);
+  frame->data = NULL;
+}
+
+
 static gboolean
 save_image (const gchar *filename,
             gint32       image_ID,
@@ -641,6 +661,7 @@ save_image (const gchar *filename,
   GimpDrawable *drawable;
   GimpImageType drawable_type;
   FILE *outfile;
+  guchar *pixels;
   gint Red[MAXCOLORS];
   gint Green[MAXCOLORS];
   gint Blue[MAXCOLORS];
@@ -655,6 +676,14 @@ save_image (const gchar *filename,
   gint32 *layers;
   gint    nlayers;
 
+  GIFFrame        *frames;
+  GIFFrameEncoder  encoder;
+  GThreadPool     *pool      = NULL;
+  gint             n_threads = 1;
+  gint             max_pending;
+  gint             n_frames  = 0;
+  gint             n_written = 0;
+
   gboolean is_gif89 = FALSE;
 
   gint   Delay89;
@@ -813,9 +842,8 @@ save_image (const gchar *filename,
 
   cols = gimp_image_width (image_ID);
   rows = gimp_image_height (image_ID);
-  Interlace = gsvals.interlace;
   gif_encode_header (outfile, is_gif89, cols, rows, bgindex,
-                     BitsPerPixel, Red, Green, Blue, get_pixel);
+                     BitsPerPixel, Red, Green, Blue);
 
 
   /* If the image has multiple layers it'll be made into an
@@ -833,17 +861,34 @@ save_image (const gchar *filename,
   /*** Now for each layer in the image, save an image in a compound GIF ***/
   /************************************************************************/
 
-  cur_progress = 0;
-  max_progress = nlayers * rows;
+  /* The frames are prepared here, in order, because the transparent
+   * index of each one depends on the ones before it. They are LZW
+   * compressed on other threads and written here as soon as they are
+   * done.
+   */
+  n_threads = MIN (gimp_get_number_of_processors (), MAX_ENCODER_THREADS);
+
+  g_mutex_init (&encoder.mutex);
+  g_cond_init (&encoder.cond);
+
+  if (n_threads > 1 && nlayers > 1)
+    pool = g_thread_pool_new ((GFunc) gif_encode_frame, &encoder,
+                              n_threads, FALSE, NULL);
+
+  /* Don't keep too many uncompressed frames around */
+  max_pending = 2 * n_threads;
 
-  for (i = nlayers - 1; i >= 0; i--, cur_progress = (nlayers - i) * rows)
+  frames = g_new0 (GIFFrame, nlayers);
+
+  for (i = nlayers - 1; i >= 0; i--)
     {
+      GIFFrame *frame = &frames[n_frames];
+
       drawable_type = gimp_drawable_type (layers[i]);
       drawable = gimp_drawable_get (layers[i]);
       gimp_drawable_offsets (layers[i], &offset_x, &offset_y);
       cols = drawable->width;
       rows = drawable->height;
-      rowstride = drawable->width;
 
       gimp_pixel_rgn_init (&pixel_rgn, drawable, 0, 0,
                            drawable->width, drawable->height, FALSE, FALSE);
@@ -935,27 +980,79 @@ save_image (const gchar *filename,
               Delay89 = 1;
             }
 
-          gif_encode_graphic_control_ext (outfile, Disposal, Delay89, nlayers,
-                                          cols, rows,
-                                          transparent,
-                                          useBPP,
-                                          get_pixel);
+          frame->disposal = Disposal;
+          frame->delay    = Delay89;
         }
 
-      gif_encode_image_data (outfile, cols, rows,
-                             (rows > 4) ? gsvals.interlace : 0,
-                             useBPP,
-                             get_pixel,
-                             offset_x, offset_y);
-      gimp_progress_update (1.0);
+      frame->pixels      = pixels;
+      frame->width       = cols;
+      frame->height      = rows;
+      frame->offset_x    = offset_x;
+      frame->offset_y    = offset_y;
+      frame->interlace   = (rows > 4) ? gsvals.interlace : 0;
+      frame->bpp         = useBPP;
+      frame->transparent = transparent;
 
       gimp_drawable_detach (drawable);
 
-      g_free (pixels);
+      if (pool)
+        g_thread_pool_push (pool, frame, NULL);
+      else
+        gif_encode_frame (frame, &encoder);
+
+      n_frames++;
+
+      /* Write the frames that are done, and wait for the oldest one
+       * if too many are pending
+       */
+      while (n_written < n_frames)
+        {
+          GIFFrame *next = &frames[n_written];
+          gboolean  encoded;
+
+          g_mutex_lock (&encoder.mutex);
+
+          while (! next->encoded && n_frames - n_written >= max_pending)
+            g_cond_wait (&encoder.cond, &encoder.mutex);
+
+          encoded = next->encoded;
+
+          g_mutex_unlock (&encoder.mutex);
+
+          if (! encoded)
+            break;
+
+          gif_write_frame (outfile, next, is_gif89, nlayers);
+          n_written++;
+
+          gimp_progress_update ((gdouble) n_written / (gdouble) nlayers);
+        }
     }
 
+  /* Wait for the encoder threads */
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (; n_written < n_frames; n_written++)
+    gif_write_frame (outfile, &frames[n_written], is_gif89, nlayers);
+
+  gimp_progress_update (1.0);
+
+  g_mutex_clear (&encoder.mutex);
+  g_cond_clear (&encoder.cond);
+
+  g_free (frames);
   g_free(layers);
 
+  if (ferror (outfile))
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Could not write '%s': %s"),
+                   gimp_filename_to_utf8 (filename), g_strerror (errno));
+      fclose (outfile);
+      return FALSE;
+    }
+
   gif_encode_close (outfile);
 
   return TRUE;
@@ -1274,14 +1371,6 @@ bpp_to_colors (int bpp)
 
 
 
-static int
-get_pixel (int x,
-           int y)
-{
-  return *(pixels + (rowstride * (long) y) + (long) x);
-}
-
-
 /*****************************************************************************
  *
  * GIFENCODE.C    - GIF Image compression interface
@@ -1291,98 +1380,6 @@ get_pixel (int x,
  *
  *****************************************************************************/
 
-static gint  Width, Height;
-static gint  curx, cury;
-static glong CountDown;
-static gint  Pass = 0;
-
-/*
- * Bump the 'curx' and 'cury' to point to the next pixel
- */
-static void
-bump_pixel (void)
-{
-  /*
-   * Bump the current X position
-   */
-  curx++;
-
-  /*
-   * If we are at the end of a scan line, set curx back to the beginning
-   * If we are interlaced, bump the cury to the appropriate spot,
-   * otherwise, just increment it.
-   */
-  if (curx == Width)
-    {
-      cur_progress++;
-
-      if ((cur_progress % 20) == 0)
-        gimp_progress_update ((gdouble) cur_progress / (gdouble) max_progress);
-
-      curx = 0;
-
-      if (! Interlace)
-        ++cury;
-      else
-        {
-          switch (Pass)
-            {
-
-            case 0:
-              cury += 8;
-              if (cury >= Height)
-                {
-                  Pass++;
-                  cury = 4;
-                }
-              break;
-
-            case 1:
-              cury += 8;
-              if (cury >= Height)
-                {
-                  Pass++;
-                  cury = 2;
-                }
-              break;
-
-            case 2:
-              cury += 4;
-              if (cury >= Height)
-                {
-                  Pass++;
-                  cury = 1;
-                }
-              break;
-
-            case 3:
-              cury += 2;
-              break;
-            }
-        }
-    }
-}
-
-/*
- * Return the next pixel from the image
- */
-static int
-gif_next_pixel (ifunptr getpixel)
-{
-  int r;
-
-  if (CountDown == 0)
-    return EOF;
-
-  --CountDown;
-
-  r = (*getpixel) (curx, cury);
-
-  bump_pixel ();
-
-  return r;
-}
-
 /* public */
 
 static void
@@ -1394,8 +1391,7 @@ gif_encode_header (FILE     *fp,
                    int       BitsPerPixel,
                    int       Red[],
                    int       Green[],
-                   int       Blue[],
-                   ifunptr   get_pixel)
+                   int       Blue[])
 {
   int B;
   int RWidth, RHeight;
@@ -1405,26 +1401,11 @@ gif_encode_header (FILE     *fp,
 
   ColorMapSize = 1 << BitsPerPixel;
 
-  RWidth = Width = GWidth;
-  RHeight = Height = GHeight;
+  RWidth = GWidth;
+  RHeight = GHeight;
 
   Resolution = BitsPerPixel;
 
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width *(long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-
   /*
    * Write the Magic header
    */
@@ -1483,30 +1464,9 @@ gif_encode_graphic_control_ext (FILE    *fp,
                                 int      Disposal,
                                 int      Delay89,
                                 int      NumFramesInImage,
-                                int      GWidth,
-                                int      GHeight,
                                 int      Transparent,
-                                int      BitsPerPixel,
-                                ifunptr  get_pixel)
+                                int      BitsPerPixel)
 {
-  Width = GWidth;
-  Height = GHeight;
-
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width *(long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-
   /*
    * Write out extension for transparent colour index, if necessary.
    */
@@ -1540,49 +1500,33 @@ gif_encode_graphic_control_ext (FILE    *fp,
 }
 
 
-static void
-gif_encode_image_data (FILE    *fp,
-                       int      GWidth,
-                       int      GHeight,
-                       int      GInterlace,
-                       int      BitsPerPixel,
-                       ifunptr  get_pixel,
-                       gint     offset_x,
-                       gint     offset_y)
+/*
+ * The initial code size of the LZW compressed image data
+ */
+static int
+gif_init_code_size (int BitsPerPixel)
 {
-  int LeftOfs, TopOfs;
-  int InitCodeSize;
-
-  Interlace = GInterlace;
-
-  Width = GWidth;
-  Height = GHeight;
-  LeftOfs = (int) offset_x;
-  TopOfs = (int) offset_y;
-
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width * (long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
-  /*
-   * The initial code size
-   */
   if (BitsPerPixel <= 1)
-    InitCodeSize = 2;
+    return 2;
   else
-    InitCodeSize = BitsPerPixel;
+    return BitsPerPixel;
+}
 
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
 
+/*
+ * Write the image descriptor and the image data, which was compressed
+ * by gif_lzw_encode()
+ */
+static void
+gif_encode_image_data (FILE             *fp,
+                       int               GWidth,
+                       int               GHeight,
+                       int               GInterlace,
+                       int               BitsPerPixel,
+                       const GByteArray *data,
+                       gint              offset_x,
+                       gint              offset_y)
+{
   /*
    * Write an Image separator
    */
@@ -1592,15 +1536,15 @@ gif_encode_image_data (FILE    *fp,
    * Write the Image header
    */
 
-  put_word (LeftOfs, fp);
-  put_word (TopOfs, fp);
-  put_word (Width, fp);
-  put_word (Height, fp);
+  put_word (offset_x, fp);
+  put_word (offset_y, fp);
+  put_word (GWidth, fp);
+  put_word (GHeight, fp);
 
   /*
    * Write out whether or not the image is interlaced
    */
-  if (Interlace)
+  if (GInterlace)
     fputc (0x40, fp);
   else
     fputc (0x00, fp);
@@ -1608,39 +1552,17 @@ gif_encode_image_data (FILE    *fp,
   /*
    * Write out the initial code size
    */
-  fputc (InitCodeSize, fp);
+  fputc (gif_init_code_size (BitsPerPixel), fp);
 
   /*
-   * Go and actually compress the data
+   * Write out the compressed data
    */
-  compress (InitCodeSize + 1, fp, get_pixel);
+  fwrite (data->data, 1, data->len, fp);
 
   /*
    * Write out a Zero-length packet (to end the series)
    */
   fputc (0, fp);
-
-#if 0
-  /***************************/
-  Interlace = GInterlace;
-  Width = GWidth;
-  Height = GHeight;
-  LeftOfs = TopOfs = 0;
-
-  CountDown = (long) Width *(long) Height;
-  Pass = 0;
-  /*
-   * The initial code size
-   */
-  if (BitsPerPixel <= 1)
-    InitCodeSize = 2;
-  else
-    InitCodeSize = BitsPerPixel;
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-#endif
 }
 
 
@@ -1711,657 +1633,198 @@ put_word (int   w,
 }
 
 
-/***************************************************************************
- *
- *  GIFCOMPR.C       - GIF Image compression routines
- *
- *  Lempel-Ziv compression based on 'compress'.  GIF modifications by
- *  David Rowley (mgardi@watdcsu.waterloo.edu)
- *
- ***************************************************************************/
-
-/*
- * General DEFINEs
- */
-
-#define GIF_BITS    12
-
-#define HSIZE  5003                /* 80% occupancy */
-
-#ifdef NO_UCHAR
-typedef char char_type;
-#else /*NO_UCHAR */
-typedef unsigned char char_type;
-#endif /*NO_UCHAR */
-
-/*
-
- * GIF Image compression - modified 'compress'
- *
- * Based on: compress.c - File compression ala IEEE Computer, June 1984.
- *
- * By Authors:  Spencer W. Thomas       (decvax!harpo!utah-cs!utah-gr!thomas)
- *              Jim McKie               (decvax!mcvax!jim)
- *              Steve Davies            (decvax!vax135!petsd!peora!srd)
- *              Ken Turkowski           (decvax!decwrl!turtlevax!ken)
- *              James A. Woods          (decvax!ihnp4!ames!jaw)
- *              Joe Orost               (decvax!vax135!petsd!joe)
- *
- */
-
-static int n_bits;                /* number of bits/code */
-static int maxbits = GIF_BITS;        /* user settable max # bits/code */
-static code_int maxcode;        /* maximum code, given n_bits */
-static code_int maxmaxcode = (code_int) 1 << GIF_BITS;        /* should NEVER generate this code */
-#ifdef COMPATIBLE                /* But wrong! */
-#define MAXCODE(Mn_bits)        ((code_int) 1 << (Mn_bits) - 1)
-#else /*COMPATIBLE */
-#define MAXCODE(Mn_bits)        (((code_int) 1 << (Mn_bits)) - 1)
-#endif /*COMPATIBLE */
-
-static count_int htab[HSIZE];
-static unsigned short codetab[HSIZE];
-#define HashTabOf(i)       htab[i]
-#define CodeTabOf(i)    codetab[i]
-
-static const code_int hsize = HSIZE; /* the original reason for this being
-                                        variable was "for dynamic table sizing",
-                                        but since it was never actually changed
-                                        I made it const   --Adam. */
-
-static code_int free_ent = 0;        /* first unused entry */
-
 /*
- * block compression parameters -- after all codes are used up,
- * and compression rate changes, start over.
+ * Table driven LZW encoder: the string table is an open addressed hash
+ * of (prefix code, pixel) pairs with linear probing, and the codes are
+ * packed straight into the image data sub-blocks. All state is in the
+ * GifLzw struct, so frames can be encoded on several threads.
  */
-static int clear_flg = 0;
 
-static int offset;
-static long int in_count = 1;        /* length of input */
-static long int out_count = 0;        /* # of codes output (for debugging) */
+#define GIF_BITS       12
+#define GIF_MAX_CODE   (1 << GIF_BITS)
+#define GIF_HASH_BITS  13
+#define GIF_HASH_SIZE  (1 << GIF_HASH_BITS)   /* at most 50% occupancy */
 
-/*
- * compress stdin to stdout
- *
- * Algorithm:  use open addressing double hashing (no chaining) on the
- * prefix code / next character combination.  We do a variant of Knuth's
- * algorithm D (vol. 3, sec. 6.4) along with G. Knott's relatively-prime
- * secondary probe.  Here, the modular division first probe is gives way
- * to a faster exclusive-or manipulation.  Also do block compression with
- * an adaptive reset, whereby the code table is cleared when the compression
- * ratio decreases, but after the table fills.  The variable-length output
- * codes are re-sized at this point, and a special CLEAR code is generated
- * for the decompressor.  Late addition:  construct the table according to
- * file size for noticeable speed improvement on small files.  Please direct
- * questions about this implementation to ames!jaw.
- */
-
-static int g_init_bits;
-static FILE *g_outfile;
-
-static int ClearCode;
-static int EOFCode;
-
-
-static unsigned long cur_accum;
-static int cur_bits;
-
-static unsigned long masks[] =
-{0x0000, 0x0001, 0x0003, 0x0007,
- 0x000F, 0x001F, 0x003F, 0x007F,
- 0x00FF, 0x01FF, 0x03FF, 0x07FF,
- 0x0FFF, 0x1FFF, 0x3FFF, 0x7FFF,
- 0xFFFF};
-
-
-static void
-compress (int      init_bits,
-          FILE    *outfile,
-          ifunptr  ReadValue)
+typedef struct
 {
-#ifdef GIF_UN
-        no_compress(init_bits, outfile, ReadValue);
-#else
-#ifdef GIF_RLE
-        rle_compress(init_bits, outfile, ReadValue);
-#else
-        normal_compress(init_bits, outfile, ReadValue);
-#endif
-#endif
-}
-
-#ifdef GIF_UN
-static void
-no_compress (int      init_bits,
-             FILE    *outfile,
-             ifunptr  ReadValue)
+  guint32     keys[GIF_HASH_SIZE];   /* (prefix << 8 | pixel) + 1, 0 if empty */
+  guint16     codes[GIF_HASH_SIZE];
+
+  gint        init_bits;
+  gint        n_bits;
+  gint        max_code;
+  gint        free_code;
+  gint        clear_code;
+  gint        eof_code;
+  gboolean    clear_flag;
+
+  guint32     accum;
+  gint        accum_bits;
+  guchar      packet[256];
+  gint        packet_len;
+  GByteArray *out;
+} GifLzw;
+
+static inline guint
+gif_lzw_hash (guint32 key)
 {
-  register long fcode;
-  register code_int i /* = 0 */ ;
-  register int c;
-  register code_int ent;
-  register code_int hsize_reg;
-  register int hshift;
-
-
-  /*
-   * Set up the globals:  g_init_bits - initial number of bits
-   *                      g_outfile   - pointer to output file
-   */
-  g_init_bits = init_bits;
-  g_outfile = outfile;
-
-  cur_bits = 0;
-  cur_accum = 0;
-
-  /*
-   * Set up the necessary values
-   */
-  offset = 0;
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
-
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
-
-
-  /* Had some problems here... should be okay now.  --Adam */
-  n_bits = g_init_bits;
-  maxcode = MAXCODE (n_bits);
-
-
-
-  char_init ();
-
-  ent = gif_next_pixel (ReadValue);
-
-  hshift = 0;
-  for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
-    ++hshift;
-  hshift = 8 - hshift;                /* set hash code range bound */
-
-  hsize_reg = hsize;
-  cl_hash ((count_int) hsize_reg);        /* clear hash table */
-
-  output ((code_int) ClearCode);
-
-
-#ifdef SIGNED_COMPARE_SLOW
-  while ((c = gif_next_pixel (ReadValue)) != (unsigned) EOF)
-    {
-#else /*SIGNED_COMPARE_SLOW */
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
-    {                                /* } */
-#endif /*SIGNED_COMPARE_SLOW */
-
-      ++in_count;
-
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((code_int) c << hshift) ^ ent);        /* xor hashing */
-
-      output ((code_int) ent);
-      ++out_count;
-      ent = c;
-#ifdef SIGNED_COMPARE_SLOW
-      if ((unsigned) free_ent < (unsigned) maxmaxcode)
-        {
-#else /*SIGNED_COMPARE_SLOW */
-      if (free_ent < maxmaxcode)
-        {                        /* } */
-#endif /*SIGNED_COMPARE_SLOW */
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
-          HashTabOf (i) = fcode;
-        }
-      else
-        cl_block ();
-    }
-
-  /*
-   * Put out the final code.
-   */
-  output ((code_int) ent);
-  ++out_count;
-  output ((code_int) EOFCode);
+  return (key * 2654435761u) >> (32 - GIF_HASH_BITS);
 }
-#else
-#ifdef GIF_RLE
 
 static void
-rle_compress (int      init_bits,
-              FILE    *outfile,
-              ifunptr  ReadValue)
+gif_lzw_clear_table (GifLzw *lzw)
 {
-  register long fcode;
-  register code_int i /* = 0 */ ;
-  register int c, last;
-  register code_int ent;
-  register code_int disp;
-  register code_int hsize_reg;
-  register int hshift;
-
-
-  /*
-   * Set up the globals:  g_init_bits - initial number of bits
-   *                      g_outfile   - pointer to output file
-   */
-  g_init_bits = init_bits;
-  g_outfile = outfile;
-
-  cur_bits = 0;
-  cur_accum = 0;
-
-  /*
-   * Set up the necessary values
-   */
-  offset = 0;
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
-
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
-
-
-  /* Had some problems here... should be okay now.  --Adam */
-  n_bits = g_init_bits;
-  maxcode = MAXCODE (n_bits);
-
-
-
-  char_init ();
-
-  last = ent = gif_next_pixel (ReadValue);
-
-  hshift = 0;
-  for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
-    ++hshift;
-  hshift = 8 - hshift;                /* set hash code range bound */
-
-  hsize_reg = hsize;
-  cl_hash ((count_int) hsize_reg);        /* clear hash table */
-
-  output ((code_int) ClearCode);
-
-
-
-#ifdef SIGNED_COMPARE_SLOW
-  while ((c = gif_next_pixel (ReadValue)) != (unsigned) EOF)
-    {
-#else /*SIGNED_COMPARE_SLOW */
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
-    {                                /* } */
-#endif /*SIGNED_COMPARE_SLOW */
-
-      ++in_count;
-
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((code_int) c << hshift) ^ ent);        /* xor hashing */
-
-
-      if (last == c) {
-        if (HashTabOf (i) == fcode)
-          {
-            ent = CodeTabOf (i);
-            continue;
-          }
-        else if ((long) HashTabOf (i) < 0)        /* empty slot */
-          goto nomatch;
-        disp = hsize_reg - i;        /* secondary hash (after G. Knott) */
-        if (i == 0)
-          disp = 1;
-      probe:
-        if ((i -= disp) < 0)
-          i += hsize_reg;
-
-        if (HashTabOf (i) == fcode)
-          {
-            ent = CodeTabOf (i);
-            continue;
-          }
-        if ((long) HashTabOf (i) > 0)
-          goto probe;
-        }
-    nomatch:
-      output ((code_int) ent);
-      ++out_count;
-      last = ent = c;
-#ifdef SIGNED_COMPARE_SLOW
-      if ((unsigned) free_ent < (unsigned) maxmaxcode)
-        {
-#else /*SIGNED_COMPARE_SLOW */
-      if (free_ent < maxmaxcode)
-        {                        /* } */
-#endif /*SIGNED_COMPARE_SLOW */
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
-          HashTabOf (i) = fcode;
-        }
-      else
-        cl_block ();
-    }
-
-  /*
-   * Put out the final code.
-   */
-  output ((code_int) ent);
-  ++out_count;
-  output ((code_int) EOFCode);
+  memset (lzw->keys, 0, sizeof (lzw->keys));
 }
 
-#else
-
-static void
-normal_compress (int      init_bits,
-                 FILE    *outfile,
-                 ifunptr  ReadValue)
+static inline void
+gif_lzw_put_byte (GifLzw *lzw,
+                  guchar  c)
 {
-  register long fcode;
-  register code_int i /* = 0 */ ;
-  register int c;
-  register code_int ent;
-  register code_int disp;
-  register code_int hsize_reg;
-  register int hshift;
-
-
-  /*
-   * Set up the globals:  g_init_bits - initial number of bits
-   *                      g_outfile   - pointer to output file
-   */
-  g_init_bits = init_bits;
-  g_outfile = outfile;
-
-  cur_bits = 0;
-  cur_accum = 0;
-
-  /*
-   * Set up the necessary values
-   */
-  offset = 0;
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
-
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
-
-
-  /* Had some problems here... should be okay now.  --Adam */
-  n_bits = g_init_bits;
-  maxcode = MAXCODE (n_bits);
-
-
-
-  char_init ();
-
-  ent = gif_next_pixel (ReadValue);
-
-  hshift = 0;
-  for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
-    ++hshift;
-  hshift = 8 - hshift;                /* set hash code range bound */
-
-  hsize_reg = hsize;
-  cl_hash ((count_int) hsize_reg);        /* clear hash table */
-
-  output ((code_int) ClearCode);
-
+  lzw->packet[1 + lzw->packet_len++] = c;
 
-
-#ifdef SIGNED_COMPARE_SLOW
-  while ((c = gif_next_pixel (ReadValue)) != (unsigned) EOF)
+  if (lzw->packet_len == 254)
     {
-#else /*SIGNED_COMPARE_SLOW */
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
-    {                                /* } */
-#endif /*SIGNED_COMPARE_SLOW */
-
-      ++in_count;
-
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((code_int) c << hshift) ^ ent);        /* xor hashing */
-
-      if (HashTabOf (i) == fcode)
-        {
-          ent = CodeTabOf (i);
-          continue;
-        }
-      else if ((long) HashTabOf (i) < 0)        /* empty slot */
-        goto nomatch;
-      disp = hsize_reg - i;        /* secondary hash (after G. Knott) */
-      if (i == 0)
-        disp = 1;
-    probe:
-      if ((i -= disp) < 0)
-        i += hsize_reg;
-
-      if (HashTabOf (i) == fcode)
-        {
-          ent = CodeTabOf (i);
-          continue;
-        }
-      if ((long) HashTabOf (i) > 0)
-        goto probe;
-    nomatch:
-      output ((code_int) ent);
-      ++out_count;
-      ent = c;
-#ifdef SIGNED_COMPARE_SLOW
-      if ((unsigned) free_ent < (unsigned) maxmaxcode)
-        {
-#else /*SIGNED_COMPARE_SLOW */
-      if (free_ent < maxmaxcode)
-        {                        /* } */
-#endif /*SIGNED_COMPARE_SLOW */
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
-          HashTabOf (i) = fcode;
-        }
-      else
-        cl_block ();
+      lzw->packet[0] = lzw->packet_len;
+      g_byte_array_append (lzw->out, lzw->packet, 1 + lzw->packet_len);
+      lzw->packet_len = 0;
     }
-
-  /*
-   * Put out the final code.
-   */
-  output ((code_int) ent);
-  ++out_count;
-  output ((code_int) EOFCode);
 }
-#endif
-#endif
-
-
 
-/*****************************************************************
- * TAG( output )
- *
- * Output the given code.
- * Inputs:
- *      code:   A n_bits-bit integer.  If == -1, then EOF.  This assumes
- *              that n_bits =< (long)wordsize - 1.
- * Outputs:
- *      Outputs code to the file.
- * Assumptions:
- *      Chars are 8 bits long.
- * Algorithm:
- *      Maintain a GIF_BITS character long buffer (so that 8 codes will
- * fit in it exactly).  Use the VAX insv instruction to insert each
- * code in turn.  When the buffer fills up empty it and start over.
- */
-
-static void
-output (code_int code)
+static inline void
+gif_lzw_output (GifLzw *lzw,
+                gint    code)
 {
-  cur_accum &= masks[cur_bits];
-
-  if (cur_bits > 0)
-    cur_accum |= ((long) code << cur_bits);
-  else
-    cur_accum = code;
+  lzw->accum |= (guint32) code << lzw->accum_bits;
+  lzw->accum_bits += lzw->n_bits;
 
-  cur_bits += n_bits;
-
-  while (cur_bits >= 8)
+  while (lzw->accum_bits >= 8)
     {
-      char_out ((unsigned int) (cur_accum & 0xff));
-      cur_accum >>= 8;
-      cur_bits -= 8;
+      gif_lzw_put_byte (lzw, lzw->accum & 0xff);
+      lzw->accum >>= 8;
+      lzw->accum_bits -= 8;
     }
 
-  /*
-   * If the next entry is going to be too big for the code size,
-   * then increase it, if possible.
+  /* If the next code is going to be too big for the code size,
+   * increase it, if possible.
    */
-  if (free_ent > maxcode || clear_flg)
+  if (lzw->free_code > lzw->max_code || lzw->clear_flag)
     {
-      if (clear_flg)
+      if (lzw->clear_flag)
         {
-
-          maxcode = MAXCODE (n_bits = g_init_bits);
-          clear_flg = 0;
-
+          lzw->n_bits     = lzw->init_bits;
+          lzw->max_code   = (1 << lzw->n_bits) - 1;
+          lzw->clear_flag = FALSE;
         }
       else
         {
+          lzw->n_bits++;
 
-          ++n_bits;
-          if (n_bits == maxbits)
-            maxcode = maxmaxcode;
+          if (lzw->n_bits == GIF_BITS)
+            lzw->max_code = GIF_MAX_CODE;
           else
-            maxcode = MAXCODE (n_bits);
+            lzw->max_code = (1 << lzw->n_bits) - 1;
         }
     }
-
-  if (code == EOFCode)
-    {
-      /*
-       * At EOF, write the rest of the buffer.
-       */
-      while (cur_bits > 0)
-        {
-          char_out ((unsigned int) (cur_accum & 0xff));
-          cur_accum >>= 8;
-          cur_bits -= 8;
-        }
-
-      flush_char ();
-
-      fflush (g_outfile);
-
-      if (ferror (g_outfile))
-        write_err ();
-    }
 }
 
-/*
- * Clear out the hash table
+/* Appends the LZW compressed pixels of a frame, as image data
+ * sub-blocks without the terminator, to out. The rows are taken in
+ * GIF interlace order if interlace is set.
  */
 static void
-cl_block (void)                        /* table clear for block compress */
-{
-  cl_hash ((count_int) hsize);
-  free_ent = ClearCode + 2;
-  clear_flg = 1;
-
-  output ((code_int) ClearCode);
-}
-
-static void
-cl_hash (count_int hsize)        /* reset code table */
+gif_lzw_encode (const guchar *pixels,
+                gint          width,
+                gint          height,
+                gboolean      interlace,
+                gint          init_code_size,
+                GByteArray   *out)
 {
+  static const gint pass_start[] = { 0, 4, 2, 1 };
+  static const gint pass_step[]  = { 8, 8, 4, 2 };
+  GifLzw  *lzw    = g_new (GifLzw, 1);
+  gint     n_pass = interlace ? 4 : 1;
+  gint     prefix = -1;
+  gint     pass;
+
+  lzw->init_bits  = init_code_size + 1;
+  lzw->n_bits     = lzw->init_bits;
+  lzw->max_code   = (1 << lzw->n_bits) - 1;
+  lzw->clear_code = 1 << init_code_size;
+  lzw->eof_code   = lzw->clear_code + 1;
+  lzw->free_code  = lzw->clear_code + 2;
+  lzw->clear_flag = FALSE;
+  lzw->accum      = 0;
+  lzw->accum_bits = 0;
+  lzw->packet_len = 0;
+  lzw->out        = out;
+
+  gif_lzw_clear_table (lzw);
+  gif_lzw_output (lzw, lzw->clear_code);
+
+  for (pass = 0; pass < n_pass; pass++)
+    {
+      gint y;
 
-  register count_int *htab_p = htab + hsize;
+      for (y = interlace ? pass_start[pass] : 0;
+           y < height;
+           y += interlace ? pass_step[pass] : 1)
+        {
+          const guchar *p   = pixels + (gsize) y * width;
+          const guchar *end = p + width;
 
-  register long i;
-  register long m1 = -1;
+          if (prefix < 0)
+            prefix = *p++;
 
-  i = hsize - 16;
-  do
-    {                                /* might use Sys V memset(3) here */
-      *(htab_p - 16) = m1;
-      *(htab_p - 15) = m1;
-      *(htab_p - 14) = m1;
-      *(htab_p - 13) = m1;
-      *(htab_p - 12) = m1;
-      *(htab_p - 11) = m1;
-      *(htab_p - 10) = m1;
-      *(htab_p - 9) = m1;
-      *(htab_p - 8) = m1;
-      *(htab_p - 7) = m1;
-      *(htab_p - 6) = m1;
-      *(htab_p - 5) = m1;
-      *(htab_p - 4) = m1;
-      *(htab_p - 3) = m1;
-      *(htab_p - 2) = m1;
-      *(htab_p - 1) = m1;
-      htab_p -= 16;
-    }
-  while ((i -= 16) >= 0);
+          for (; p < end; p++)
+            {
+              guint32 key = (((guint32) prefix << 8) | *p) + 1;
+              guint   i   = gif_lzw_hash (key);
 
-  for (i += 16; i > 0; --i)
-    *--htab_p = m1;
-}
+              while (lzw->keys[i] && lzw->keys[i] != key)
+                i = (i + 1) & (GIF_HASH_SIZE - 1);
 
-static void
-write_err (void)
-{
-  g_message (_("Error writing output file."));
-  return;
-}
+              if (lzw->keys[i])
+                {
+                  prefix = lzw->codes[i];
+                  continue;
+                }
 
-/******************************************************************************
- *
- * GIF Specific routines
- *
- ******************************************************************************/
+              gif_lzw_output (lzw, prefix);
+              prefix = *p;
 
-/*
- * Number of characters so far in this 'packet'
- */
-static int a_count;
+              if (lzw->free_code < GIF_MAX_CODE)
+                {
+                  lzw->keys[i]  = key;
+                  lzw->codes[i] = lzw->free_code++;
+                }
+              else
+                {
+                  /* the table is full, start over */
+                  gif_lzw_clear_table (lzw);
+                  lzw->free_code  = lzw->clear_code + 2;
+                  lzw->clear_flag = TRUE;
 
-/*
- * Set up the 'byte output' routine
- */
-static void
-char_init (void)
-{
-  a_count = 0;
-}
+                  gif_lzw_output (lzw, lzw->clear_code);
+                }
+            }
+        }
+    }
 
-/*
- * Define the storage for the packet accumulator
- */
-static char accum[256];
+  gif_lzw_output (lzw, prefix);
+  gif_lzw_output (lzw, lzw->eof_code);
 
-/*
- * Add a character to the end of the current packet, and if it is 254
- * characters, flush the packet to disk.
- */
-static void
-char_out (int c)
-{
-  accum[a_count++] = c;
-  if (a_count >= 254)
-    flush_char ();
-}
+  /* write the rest of the bits */
+  if (lzw->accum_bits > 0)
+    gif_lzw_put_byte (lzw, lzw->accum & 0xff);
 
-/*
- * Flush the packet to disk, and reset the accumulator
- */
-static void
-flush_char (void)
-{
-  if (a_count > 0)
+  if (lzw->packet_len > 0)
     {
-      fputc (a_count, g_outfile);
-      fwrite (accum, 1, a_count, g_outfile);
-      a_count = 0;
+      lzw->packet[0] = lzw->packet_len;
+      g_byte_array_append (lzw->out, lzw->packet, 1 + lzw->packet_len);
     }
+
+  g_free (lzw);
 }
 
 
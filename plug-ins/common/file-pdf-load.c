@@ -42,6 +42,8 @@
 
 #define THUMBNAIL_SIZE  128
 
+#define MAX_RENDER_THREADS 16
+
 
 /* Structs for the load dialog */
 typedef struct
@@ -64,6 +66,40 @@ typedef struct
   gint *pages;
 } PdfSelectedPages;
 
+/* A page rendered by one of the render threads */
+typedef struct
+{
+  cairo_surface_t *surface;
+  gchar           *label;
+  gint             width;
+  gint             height;
+  gboolean         done;
+} PdfRenderedPage;
+
+/* The pages are rendered on several threads, each with its own
+ * document, and added to the image in order on the main thread. At
+ * most max_queued rendered pages wait to be added.
+ */
+typedef struct
+{
+  PdfSelectedPages *pages;
+  gdouble           scale;
+  gboolean          antialias;
+  PdfRenderedPage  *rendered;
+  gint              next_page;
+  gint              n_added;
+  gint              max_queued;
+  GMutex            mutex;
+  GCond             cond;
+} PdfRenderer;
+
+typedef struct
+{
+  PdfRenderer     *renderer;
+  PopplerDocument *doc;
+  GThread         *thread;
+} PdfRenderThread;
+
 /* Declare local functions */
 static void              query             (void);
 static void              run               (const gchar            *name,
@@ -837,6 +873,61 @@ render_page_to_pixbuf (PopplerPage *page,
 
 #endif
 
+static gpointer
+render_thread (gpointer data)
+{
+  PdfRenderThread *thread   = data;
+  PdfRenderer     *renderer = thread->renderer;
+
+  g_mutex_lock (&renderer->mutex);
+
+  while (renderer->next_page < renderer->pages->n_pages)
+    {
+      PdfRenderedPage  rendered = { NULL, };
+      PopplerPage     *page;
+      gdouble          page_width;
+      gdouble          page_height;
+      gint             i        = renderer->next_page;
+
+      /* don't run too far ahead of the pages added to the image */
+      if (i >= renderer->n_added + renderer->max_queued)
+        {
+          g_cond_wait (&renderer->cond, &renderer->mutex);
+          continue;
+        }
+
+      renderer->next_page++;
+
+      g_mutex_unlock (&renderer->mutex);
+
+      page = poppler_document_get_page (thread->doc, renderer->pages->pages[i]);
+
+      poppler_page_get_size (page, &page_width, &page_height);
+      rendered.width  = page_width  * renderer->scale;
+      rendered.height = page_height * renderer->scale;
+
+      g_object_get (G_OBJECT (page), "label", &rendered.label, NULL);
+
+      rendered.surface = render_page_to_surface (page,
+                                                 rendered.width,
+                                                 rendered.height,
+                                                 renderer->scale,
+                                                 renderer->antialias);
+      rendered.done = TRUE;
+
+      g_object_unref (page);
+
+      g_mutex_lock (&renderer->mutex);
+
+      renderer->rendered[i] = rendered;
+      g_cond_broadcast (&renderer->cond);
+    }
+
+  g_mutex_unlock (&renderer->mutex);
+
+  return NULL;
+}
+
 static gint32
 load_image (PopplerDocument        *doc,
             const gchar            *filename,
@@ -846,11 +937,14 @@ load_image (PopplerDocument        *doc,
             gboolean                antialias,
             PdfSelectedPages       *pages)
 {
-  gint32   image_ID = 0;
-  gint32  *images   = NULL;
-  gint     i;
-  gdouble  scale;
-  gdouble  doc_progress = 0;
+  PdfRenderer      renderer;
+  PdfRenderThread  threads[MAX_RENDER_THREADS];
+  gint             n_threads = 1;
+  gint32           image_ID  = 0;
+  gint32          *images    = NULL;
+  gint             i;
+  gdouble          scale;
+  gdouble          doc_progress = 0;
 
   if (target == GIMP_PAGE_SELECTOR_TARGET_IMAGES)
     images = g_new0 (gint32, pages->n_pages);
@@ -860,36 +954,65 @@ load_image (PopplerDocument        *doc,
 
   scale = resolution / gimp_unit_get_factor (GIMP_UNIT_POINT);
 
-  /* read the file */
+  /* render the pages */
 
-  for (i = 0; i < pages->n_pages; i++)
+  n_threads = CLAMP (gimp_get_number_of_processors (), 1, MAX_RENDER_THREADS);
+  n_threads = MIN (n_threads, pages->n_pages);
+
+  renderer.pages      = pages;
+  renderer.scale      = scale;
+  renderer.antialias  = antialias;
+  renderer.rendered   = g_new0 (PdfRenderedPage, pages->n_pages);
+  renderer.next_page  = 0;
+  renderer.n_added    = 0;
+  renderer.max_queued = 2 * n_threads;
+
+  g_mutex_init (&renderer.mutex);
+  g_cond_init (&renderer.cond);
+
+  /* Poppler documents can't be shared between threads, the first
+   * thread uses ours, the others open their own
+   */
+  threads[0].doc = g_object_ref (doc);
+
+  for (i = 1; i < n_threads; i++)
     {
-      PopplerPage *page;
-      gchar       *page_label;
-      gdouble      page_width;
-      gdouble      page_height;
+      threads[i].doc = open_document (filename, NULL);
 
-      cairo_surface_t *surface;
-      gint             width;
-      gint             height;
+      if (! threads[i].doc)
+        break;
+    }
 
-      page = poppler_document_get_page (doc, pages->pages[i]);
+  n_threads = i;
 
-      poppler_page_get_size (page, &page_width, &page_height);
-      width  = page_width  * scale;
-      height = page_height * scale;
+  for (i = 0; i < n_threads; i++)
+    {
+      threads[i].renderer = &renderer;
+      threads[i].thread   = g_thread_new ("pdf-render", render_thread,
+                                          &threads[i]);
+    }
+
+  for (i = 0; i < pages->n_pages; i++)
+    {
+      PdfRenderedPage *rendered = &renderer.rendered[i];
+
+      g_mutex_lock (&renderer.mutex);
 
-      g_object_get (G_OBJECT (page), "label", &page_label, NULL);
+      while (! rendered->done)
+        g_cond_wait (&renderer.cond, &renderer.mutex);
+
+      g_mutex_unlock (&renderer.mutex);
 
       if (! image_ID)
         {
           gchar *name;
 
-          image_ID = gimp_image_new (width, height, GIMP_RGB);
+          image_ID = gimp_image_new (rendered->width, rendered->height,
+                                     GIMP_RGB);
           gimp_image_undo_disable (image_ID);
 
           if (target == GIMP_PAGE_SELECTOR_TARGET_IMAGES)
-            name = g_strdup_printf (_("%s-%s"), filename, page_label);
+            name = g_strdup_printf (_("%s-%s"), filename, rendered->label);
           else
             name = g_strdup_printf (_("%s-pages"), filename);
 
@@ -899,13 +1022,17 @@ load_image (PopplerDocument        *doc,
           gimp_image_set_resolution (image_ID, resolution, resolution);
         }
 
-      surface = render_page_to_surface (page, width, height, scale, antialias);
-
-      layer_from_surface (image_ID, page_label, i, surface,
+      layer_from_surface (image_ID, rendered->label, i, rendered->surface,
                           doc_progress, 1.0 / pages->n_pages);
 
-      g_free (page_label);
-      cairo_surface_destroy (surface);
+      g_free (rendered->label);
+      cairo_surface_destroy (rendered->surface);
+
+      /* let the render threads go on */
+      g_mutex_lock (&renderer.mutex);
+      renderer.n_added++;
+      g_cond_broadcast (&renderer.cond);
+      g_mutex_unlock (&renderer.mutex);
 
       doc_progress = (double) (i + 1) / pages->n_pages;
       gimp_progress_update (doc_progress);
@@ -920,6 +1047,17 @@ load_image (PopplerDocument        *doc,
           image_ID = 0;
         }
     }
+
+  for (i = 0; i < n_threads; i++)
+    {
+      g_thread_join (threads[i].thread);
+      g_object_unref (threads[i].doc);
+    }
+
+  g_mutex_clear (&renderer.mutex);
+  g_cond_clear (&renderer.cond);
+  g_free (renderer.rendered);
+
   gimp_progress_update (1.0);
 
   if (image_ID)
@@ -1154,7 +1292,7 @@ load_dialog (PopplerDocument  *doc,
   thread_data.selector          = GIMP_PAGE_SELECTOR (selector);
   thread_data.stop_thumbnailing = FALSE;
 
-  thread = g_thread_create (thumbnail_thread, &thread_data, TRUE, NULL);
+  thread = g_thread_new ("pdf-thumbnails", thumbnail_thread, &thread_data);
 
   /* Resolution */
 
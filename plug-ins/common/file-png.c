@@ -29,6 +29,7 @@
  *   offsets_dialog()            - Asks the user about offsets when loading.
  *   respin_cmap()               - Re-order a Gimp colormap for PNG tRNS
  *   save_image()                - Save the specified image to a PNG file.
+ *   deflater_*()                - Filter and deflate row blocks in parallel.
  *   save_compression_callback() - Update the image compression level.
  *   save_interlace_update()     - Update the interlacing option.
  *   save_dialog()               - Pop up the save dialog.
@@ -41,6 +42,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
 #include <glib/gstdio.h>
@@ -49,6 +51,7 @@
 #include <libgimp/gimpui.h>
 
 #include <png.h>                /* PNG library definitions */
+#include <zlib.h>
 
 #include "libgimp/stdplugins-intl.h"
 
@@ -119,6 +122,51 @@ typedef struct
 }
 PngGlobals;
 
+typedef struct _PngDeflater PngDeflater;
+
+/* A block of rows that is filtered and deflated on its own thread. */
+typedef struct
+{
+  PngDeflater  *deflater;
+  const guchar *prev_row;       /* Last row of the previous block, or NULL */
+  guchar       *rows;           /* Rows as they are stored in the file */
+  gint          n_rows;
+  gboolean      last;           /* Last block of the image? */
+
+  guchar       *data;           /* Deflated rows */
+  gsize         data_len;
+  uLong         adler;          /* Adler-32 of the filtered rows */
+  gsize         filtered_len;
+  gboolean      success;
+}
+PngBlock;
+
+/* Writes the IDAT chunks of a non-interlaced image from blocks of rows
+ * that are deflated in parallel, each ending on a sync flush so their
+ * data can simply be concatenated, like pigz does.
+ */
+struct _PngDeflater
+{
+  png_structp   pp;
+  gint          width;
+  gint          height;
+  gint          bit_depth;
+  gboolean      palette;
+  gsize         row_bytes;      /* Bytes per row in the file */
+  gint          filter_bpp;     /* Bytes per pixel for filtering, >= 1 */
+  gint          level;
+
+  gint          n_threads;
+  gint          block_rows;
+  PngBlock     *blocks;         /* One batch, n_threads blocks */
+  gint          n_blocks;       /* Blocks started in the batch */
+  gint          rows;           /* Rows added so far */
+
+  guchar       *prev_row;       /* Last row of the previous batch */
+  gboolean      have_prev_row;
+  uLong         adler;
+};
+
 /*
  * Local functions...
  */
@@ -139,6 +187,19 @@ static gboolean  save_image                (const gchar      *filename,
                                             gint32            orig_image_ID,
                                             GError          **error);
 
+static PngDeflater * deflater_new         (png_structp       pp,
+                                            gint              width,
+                                            gint              height,
+                                            gint              bit_depth,
+                                            gint              color_type,
+                                            gint              bpp,
+                                            gint              level);
+static gboolean  deflater_add_rows         (PngDeflater      *deflater,
+                                            guchar          **pixels,
+                                            gint              num,
+                                            gint              bpp);
+static void      deflater_free             (PngDeflater      *deflater);
+
 static int       respin_cmap               (png_structp       pp,
                                             png_infop         info,
                                             guchar           *remap,
@@ -1031,10 +1092,11 @@ load_image (const gchar  *filename,
   buffer = gimp_drawable_get_buffer (layer);
 
   /*
-   * Temporary buffer...
+   * Temporary buffer, for one row of the buffer's tiles, so each
+   * tile is written once and in full...
    */
 
-  tile_height = gimp_tile_height ();
+  g_object_get (buffer, "tile-height", &tile_height, NULL);
   pixel = g_new0 (guchar, tile_height * width * bpp);
   pixels = g_new (guchar *, tile_height);
 
@@ -1085,6 +1147,13 @@ load_image (const gchar  *filename,
                            pixel,
                            GEGL_AUTO_ROWSTRIDE);
 
+          /* Send the finished tiles to the core right away, instead of
+           * letting the whole image pile up in the tile cache, unless
+           * the next pass needs them again.
+           */
+          if (num_passes == 1)
+            gegl_buffer_flush (buffer);
+
           gimp_progress_update
             (((gdouble) pass +
               (gdouble) end / (gdouble) height) /
@@ -1329,6 +1398,7 @@ save_image (const gchar  *filename,
   guchar remap[256];            /* Re-mapping for the palette */
 
   png_textp  text = NULL;
+  PngDeflater *deflater = NULL; /* Parallel IDAT writer */
 
   if (gimp_image_get_precision (image_ID) == GIMP_PRECISION_U8)
     bit_depth = 8;
@@ -1627,6 +1697,14 @@ save_image (const gchar  *filename,
    * Allocate memory for "tile_height" rows and save the image...
    */
 
+  /*
+   * Deflate blocks of rows on all cores if that's possible...
+   */
+
+  if (! pngvals.interlaced)
+    deflater = deflater_new (pp, width, height, bit_depth, color_type, bpp,
+                             pngvals.compression_level);
+
   tile_height = gimp_tile_height ();
   pixel = g_new (guchar, tile_height * width * bpp);
   pixels = g_new (guchar *, tile_height);
@@ -1720,7 +1798,21 @@ save_image (const gchar  *filename,
                 }
             }
 
-          png_write_rows (pp, pixels, num);
+          if (deflater)
+            {
+              if (! deflater_add_rows (deflater, pixels, num, bpp))
+                {
+                  g_set_error (error, 0, 0,
+                               _("Error while saving '%s'. Could not save image."),
+                               gimp_filename_to_utf8 (filename));
+                  deflater_free (deflater);
+                  return FALSE;
+                }
+            }
+          else
+            {
+              png_write_rows (pp, pixels, num);
+            }
 
           gimp_progress_update (((double) pass + (double) end /
                                  (double) height) /
@@ -1730,7 +1822,17 @@ save_image (const gchar  *filename,
 
   gimp_progress_update (1.0);
 
-  png_write_end (pp, info);
+  if (deflater)
+    {
+      /* libpng didn't see the IDAT chunks, so it can't end the file */
+      deflater_free (deflater);
+      png_write_chunk (pp, (png_bytep) "IEND", NULL, 0);
+    }
+  else
+    {
+      png_write_end (pp, info);
+    }
+
   png_destroy_write_struct (&pp, &info);
 
   g_free (pixel);
@@ -1754,6 +1856,428 @@ save_image (const gchar  *filename,
   return TRUE;
 }
 
+/*
+ * Parallel deflate of row blocks...
+ */
+
+/* About the size of a block of rows, big enough that starting each
+ * block with an empty deflate window costs little compression.
+ */
+#define DEFLATER_BLOCK_SIZE  (1 << 20)
+
+static PngDeflater *
+deflater_new (png_structp pp,
+              gint        width,
+              gint        height,
+              gint        bit_depth,
+              gint        color_type,
+              gint        bpp,
+              gint        level)
+{
+  PngDeflater *deflater;
+  gboolean     palette  = (color_type == PNG_COLOR_TYPE_PALETTE);
+  gsize        row_bytes;
+  gint         block_rows;
+  gint         n_threads = gimp_parallel_get_n_threads ();
+  gint         i;
+
+  if (palette)
+    row_bytes = ((gsize) width * bit_depth + 7) / 8;
+  else
+    row_bytes = (gsize) width * bpp;
+
+  block_rows = MAX (1, DEFLATER_BLOCK_SIZE / row_bytes);
+
+  /* Not worth it unless there are blocks to spread over the threads */
+  if (n_threads < 2 || height <= block_rows)
+    return NULL;
+
+  deflater = g_new0 (PngDeflater, 1);
+
+  deflater->pp         = pp;
+  deflater->width      = width;
+  deflater->height     = height;
+  deflater->bit_depth  = bit_depth;
+  deflater->palette    = palette;
+  deflater->row_bytes  = row_bytes;
+  deflater->filter_bpp = palette ? 1 : bpp;
+  deflater->level      = level;
+  deflater->n_threads  = n_threads;
+  deflater->block_rows = block_rows;
+  deflater->blocks     = g_new0 (PngBlock, n_threads);
+  deflater->prev_row   = g_new (guchar, row_bytes);
+  deflater->adler      = adler32 (0, NULL, 0);
+
+  for (i = 0; i < n_threads; i++)
+    {
+      deflater->blocks[i].deflater = deflater;
+      deflater->blocks[i].rows     = g_new (guchar, block_rows * row_bytes);
+    }
+
+  return deflater;
+}
+
+static void
+deflater_free (PngDeflater *deflater)
+{
+  gint i;
+
+  for (i = 0; i < deflater->n_threads; i++)
+    {
+      g_free (deflater->blocks[i].rows);
+      g_free (deflater->blocks[i].data);
+    }
+
+  g_free (deflater->blocks);
+  g_free (deflater->prev_row);
+  g_free (deflater);
+}
+
+static inline guchar
+deflater_paeth (guchar a,
+                guchar b,
+                guchar c)
+{
+  gint p  = a + b - c;
+  gint pa = abs (p - a);
+  gint pb = abs (p - b);
+  gint pc = abs (p - c);
+
+  if (pa <= pb && pa <= pc)
+    return a;
+  else if (pb <= pc)
+    return b;
+  else
+    return c;
+}
+
+/* Applies one of the five PNG filters, prev is NULL for the first row */
+static void
+deflater_filter_row (const guchar *row,
+                     const guchar *prev,
+                     gsize         row_bytes,
+                     gint          bpp,
+                     gint          type,
+                     guchar       *dest)
+{
+  gsize i;
+
+  dest[0] = type;
+  dest++;
+
+  for (i = 0; i < row_bytes; i++)
+    {
+      guchar left     = i >= bpp ? row[i - bpp] : 0;
+      guchar up       = prev ? prev[i] : 0;
+      guchar up_left  = (prev && i >= bpp) ? prev[i - bpp] : 0;
+
+      switch (type)
+        {
+        case PNG_FILTER_VALUE_NONE:
+          dest[i] = row[i];
+          break;
+        case PNG_FILTER_VALUE_SUB:
+          dest[i] = row[i] - left;
+          break;
+        case PNG_FILTER_VALUE_UP:
+          dest[i] = row[i] - up;
+          break;
+        case PNG_FILTER_VALUE_AVG:
+          dest[i] = row[i] - ((left + up) >> 1);
+          break;
+        case PNG_FILTER_VALUE_PAETH:
+          dest[i] = row[i] - deflater_paeth (left, up, up_left);
+          break;
+        }
+    }
+}
+
+/* Picks the filter of each row like libpng does by default: none for
+ * palette images, otherwise the one with the smallest sum of absolute
+ * (signed) values.
+ */
+static guchar *
+deflater_filter_block (PngBlock *block,
+                       gsize    *len)
+{
+  PngDeflater *deflater  = block->deflater;
+  gsize        row_bytes = deflater->row_bytes;
+  guchar      *filtered  = g_new (guchar, block->n_rows * (row_bytes + 1));
+  guchar      *candidate = NULL;
+  gint         y;
+
+  if (! deflater->palette)
+    candidate = g_new (guchar, row_bytes + 1);
+
+  for (y = 0; y < block->n_rows; y++)
+    {
+      const guchar *row  = block->rows + y * row_bytes;
+      const guchar *prev = y > 0 ? row - row_bytes : block->prev_row;
+      guchar       *dest = filtered + y * (row_bytes + 1);
+      gint          type;
+      guint64       best = G_MAXUINT64;
+
+      if (deflater->palette)
+        {
+          deflater_filter_row (row, prev, row_bytes, deflater->filter_bpp,
+                               PNG_FILTER_VALUE_NONE, dest);
+          continue;
+        }
+
+      for (type = PNG_FILTER_VALUE_NONE; type < PNG_FILTER_VALUE_LAST; type++)
+        {
+          guint64 sum = 0;
+          gsize   i;
+
+          deflater_filter_row (row, prev, row_bytes, deflater->filter_bpp,
+                               type, candidate);
+
+          for (i = 1; i <= row_bytes; i++)
+            sum += candidate[i] < 128 ? candidate[i] : 256 - candidate[i];
+
+          if (sum < best)
+            {
+              best = sum;
+              memcpy (dest, candidate, row_bytes + 1);
+            }
+        }
+    }
+
+  g_free (candidate);
+
+  *len = block->n_rows * (row_bytes + 1);
+
+  return filtered;
+}
+
+/* Deflates a block as raw deflate data, leaving room for the zlib
+ * header before it and the Adler-32 after it.
+ */
+static void
+deflater_block_func (gint         i,
+                     gint         n_blocks,
+                     gint         thread,
+                     PngDeflater *deflater)
+{
+  PngBlock    *block    = &deflater->blocks[i];
+  z_stream     zs       = { 0, };
+  guchar      *filtered;
+  gsize        size;
+  gint         flush    = block->last ? Z_FINISH : Z_SYNC_FLUSH;
+  gint         ret;
+
+  block->success = FALSE;
+
+  filtered = deflater_filter_block (block, &block->filtered_len);
+
+  block->adler = adler32 (adler32 (0, NULL, 0),
+                          filtered, block->filtered_len);
+
+  if (deflateInit2 (&zs, deflater->level, Z_DEFLATED, -15, 8,
+                    deflater->palette ? Z_DEFAULT_STRATEGY : Z_FILTERED) != Z_OK)
+    {
+      g_free (filtered);
+      return;
+    }
+
+  size = 2 + deflateBound (&zs, block->filtered_len) + 16 + 4;
+
+  g_free (block->data);
+  block->data = g_malloc (size);
+
+  zs.next_in   = filtered;
+  zs.avail_in  = block->filtered_len;
+  zs.next_out  = block->data + 2;
+  zs.avail_out = size - 2 - 4;
+
+  for (;;)
+    {
+      ret = deflate (&zs, flush);
+
+      if (ret == Z_STREAM_ERROR)
+        break;
+
+      if (block->last ? ret == Z_STREAM_END : zs.avail_out > 0)
+        {
+          block->success = TRUE;
+          break;
+        }
+
+      if (zs.avail_out == 0)
+        {
+          gsize used = zs.next_out - block->data;
+
+          size *= 2;
+          block->data = g_realloc (block->data, size);
+
+          zs.next_out  = block->data + used;
+          zs.avail_out = size - used - 4;
+        }
+    }
+
+  block->data_len = zs.next_out - (block->data + 2);
+
+  deflateEnd (&zs);
+  g_free (filtered);
+}
+
+/* Deflates the blocks of the batch and writes them in order */
+static gboolean
+deflater_flush (PngDeflater *deflater)
+{
+  gboolean  success = TRUE;
+  gint      i;
+
+  for (i = 0; i < deflater->n_blocks; i++)
+    {
+      PngBlock *block = &deflater->blocks[i];
+
+      if (i > 0)
+        block->prev_row = (deflater->blocks[i - 1].rows +
+                           (deflater->blocks[i - 1].n_rows - 1) *
+                           deflater->row_bytes);
+      else
+        block->prev_row = deflater->have_prev_row ? deflater->prev_row : NULL;
+    }
+
+  gimp_parallel_run (deflater->n_blocks,
+                     (GimpParallelFunc) deflater_block_func, deflater, FALSE);
+
+  for (i = 0; i < deflater->n_blocks; i++)
+    {
+      PngBlock *block = &deflater->blocks[i];
+      guchar   *data  = block->data + 2;
+      gsize     len   = block->data_len;
+
+      success = success && block->success;
+
+      if (! success)
+        continue;
+
+      deflater->adler = adler32_combine (deflater->adler, block->adler,
+                                         block->filtered_len);
+
+      if (! deflater->have_prev_row && i == 0)
+        {
+          /* The zlib header, see RFC 1950 */
+          guint header = (Z_DEFLATED + (7 << 4)) << 8;
+
+          if (deflater->level >= 7)
+            header |= 3 << 6;
+          else if (deflater->level == 6)
+            header |= 2 << 6;
+          else if (deflater->level >= 2)
+            header |= 1 << 6;
+
+          header += 31 - (header % 31);
+
+          data -= 2;
+          len  += 2;
+
+          data[0] = header >> 8;
+          data[1] = header & 0xff;
+        }
+
+      if (block->last)
+        {
+          guchar *end = block->data + 2 + block->data_len;
+
+          end[0] = deflater->adler >> 24;
+          end[1] = deflater->adler >> 16;
+          end[2] = deflater->adler >> 8;
+          end[3] = deflater->adler;
+
+          len += 4;
+        }
+
+      png_write_chunk (deflater->pp, (png_bytep) "IDAT", data, len);
+    }
+
+  if (deflater->n_blocks > 0)
+    {
+      PngBlock *block = &deflater->blocks[deflater->n_blocks - 1];
+
+      memcpy (deflater->prev_row,
+              block->rows + (block->n_rows - 1) * deflater->row_bytes,
+              deflater->row_bytes);
+
+      deflater->have_prev_row = TRUE;
+    }
+
+  for (i = 0; i < deflater->n_blocks; i++)
+    deflater->blocks[i].n_rows = 0;
+
+  deflater->n_blocks = 0;
+
+  return success;
+}
+
+/* Adds rows as they would go to png_write_rows(), and converts them to
+ * what libpng's swap and packing transforms would write.
+ */
+static gboolean
+deflater_add_rows (PngDeflater  *deflater,
+                   guchar      **pixels,
+                   gint          num,
+                   gint          bpp)
+{
+  gint y;
+
+  for (y = 0; y < num; y++)
+    {
+      PngBlock *block = &deflater->blocks[deflater->n_blocks];
+      guchar   *row   = block->rows + block->n_rows * deflater->row_bytes;
+
+      if (deflater->palette && deflater->bit_depth < 8)
+        {
+          gint bits = deflater->bit_depth;
+          gint x;
+
+          memset (row, 0, deflater->row_bytes);
+
+          for (x = 0; x < deflater->width; x++)
+            row[x * bits / 8] |= pixels[y][x] << (8 - bits - (x * bits) % 8);
+        }
+      else if (deflater->palette)
+        {
+          memcpy (row, pixels[y], deflater->row_bytes);
+        }
+      else if (deflater->bit_depth == 16 && G_BYTE_ORDER == G_LITTLE_ENDIAN)
+        {
+          gsize i;
+
+          for (i = 0; i < deflater->row_bytes; i += 2)
+            {
+              row[i]     = pixels[y][i + 1];
+              row[i + 1] = pixels[y][i];
+            }
+        }
+      else
+        {
+          memcpy (row, pixels[y], deflater->row_bytes);
+        }
+
+      block->n_rows++;
+      deflater->rows++;
+
+      if (deflater->rows == deflater->height)
+        block->last = TRUE;
+
+      if (block->n_rows == deflater->block_rows || block->last)
+        {
+          deflater->n_blocks++;
+
+          if (deflater->n_blocks == deflater->n_threads || block->last)
+            {
+              if (! deflater_flush (deflater))
+                return FALSE;
+            }
+        }
+    }
+
+  return TRUE;
+}
+
 static gboolean
 ia_has_transparent_pixels (GeglBuffer *buffer)
 {
@@ -75,6 +75,8 @@
 #define PLUG_IN_BINARY "file-tiff-load"
 #define PLUG_IN_ROLE   "gimp-file-tiff-load"
 
+#define TIFF_MAX_DECODER_THREADS 16
+
 
 typedef struct
 {
@@ -99,6 +101,28 @@ typedef struct
   gint *pages;
 } TiffSelectedPages;
 
+/* Tiles or strips of a contiguous image, decoded on threads that each
+ * have their own TIFF handle, libtiff handles can't be shared.
+ */
+typedef struct
+{
+  const gchar  *filename;
+  tdir_t        directory;
+  gboolean      tiled;
+  uint32        n_units;
+  tsize_t       unit_size;
+  volatile gint next_unit;
+  GAsyncQueue  *free_units;
+  GAsyncQueue  *decoded_units;
+} TiffDecoder;
+
+typedef struct
+{
+  uint32    index;
+  gboolean  success;
+  guchar   *data;
+} TiffUnit;
+
 /* Declare some local functions.
  */
 static void   query     (void);
@@ -119,10 +143,27 @@ static gint32    load_image       (const gchar        *filename,
 static void      load_rgba        (TIFF         *tif,
                                    channel_data *channel);
 static void      load_interleaved (TIFF         *tif,
+                                   const gchar  *filename,
                                    channel_data *channel,
                                    gushort       bps,
                                    gushort       spp,
                                    gint          extra);
+static void      load_contiguous  (TIFF         *tif,
+                                   const gchar  *filename,
+                                   channel_data *channel,
+                                   const Babl   *src_format,
+                                   gint          extra);
+static void      load_contiguous_unit
+                                  (channel_data *channel,
+                                   const Babl   *src_format,
+                                   gint          extra,
+                                   const guchar *data,
+                                   gint          rowstride,
+                                   gint          x,
+                                   gint          y,
+                                   gint          cols,
+                                   gint          rows);
+static gpointer  tiff_decoder_thread (gpointer   data);
 static void      load_paths       (TIFF         *tif,
                                    gint          image);
 
@@ -167,6 +208,9 @@ static GimpPageSelectorTarget  target        = GIMP_PAGE_SELECTOR_TARGET_LAYERS;
 
 static guchar       bit2byte[256 * 8];
 
+/* Set on the decoder threads, which must not send messages to GIMP */
+static GPrivate     tiff_decoder_thread_key = G_PRIVATE_INIT (NULL);
+
 
 MAIN ()
 
@@ -375,8 +419,10 @@ tiff_warning (const gchar *module,
   if (tag >= 32768)
     return;
 
-  /* Other unknown fields are only reported to stderr. */
-  if (tag > 0)
+  /* Other unknown fields, and everything from the decoder threads, are
+   * only reported to stderr.
+   */
+  if (tag > 0 || g_private_get (&tiff_decoder_thread_key))
     {
       gchar *msg = g_strdup_vprintf (fmt, ap);
 
@@ -399,6 +445,16 @@ tiff_error (const gchar *module,
   if (! strcmp (fmt, "Compression algorithm does not support random access"))
     return;
 
+  if (g_private_get (&tiff_decoder_thread_key))
+    {
+      gchar *msg = g_strdup_vprintf (fmt, ap);
+
+      g_printerr ("%s\n", msg);
+      g_free (msg);
+
+      return;
+    }
+
   g_logv (G_LOG_DOMAIN, G_LOG_LEVEL_MESSAGE, fmt, ap);
 }
 
@@ -1014,7 +1070,7 @@ load_image (const gchar        *filename,
         }
       else
         {
-          load_interleaved (tif, channel, bps, spp, extra);
+          load_interleaved (tif, filename, channel, bps, spp, extra);
         }
 
       if (TIFFGetField (tif, TIFFTAG_ORIENTATION, &orientation))
@@ -1369,6 +1425,7 @@ load_paths (TIFF *tif, gint image)
 
 static void
 load_interleaved (TIFF         *tif,
+                  const gchar  *filename,
                   channel_data *channel,
                   gushort       bps,
                   gushort       spp,
@@ -1379,9 +1436,7 @@ load_interleaved (TIFF         *tif,
   uint32  tileWidth, tileLength;
   uint32  x, y, rows, cols;
   int bytes_per_pixel;
-  GeglBuffer *src_buf;
   const Babl *src_format;
-  GeglBufferIterator *iter;
   guchar *buffer;
   gdouble progress = 0.0, one_row;
   gint    i;
@@ -1392,6 +1447,25 @@ load_interleaved (TIFF         *tif,
   TIFFGetField (tif, TIFFTAG_IMAGEWIDTH, &imageWidth);
   TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &imageLength);
 
+  if (bps <= 8)
+    src_format = babl_format_n (babl_type ("u8"), spp);
+  else
+    src_format = babl_format_n (babl_type ("u16"), spp);
+
+  /* consistency check */
+  bytes_per_pixel = 0;
+  for (i = 0; i <= extra; i++)
+    bytes_per_pixel += babl_format_get_bytes_per_pixel (channel[i].format);
+
+  g_printerr ("bytes_per_pixel: %d, format: %d\n", bytes_per_pixel,
+              babl_format_get_bytes_per_pixel (src_format));
+
+  if (planar == PLANARCONFIG_CONTIG)
+    {
+      load_contiguous (tif, filename, channel, src_format, extra);
+      return;
+    }
+
   tileWidth = imageWidth;
 
   if (TIFFIsTiled (tif))
@@ -1409,24 +1483,11 @@ load_interleaved (TIFF         *tif,
 
   one_row = (gdouble) tileLength / (gdouble) imageLength;
 
-  if (bps <= 8)
-    src_format = babl_format_n (babl_type ("u8"), spp);
-  else
-    src_format = babl_format_n (babl_type ("u16"), spp);
-
-  /* consistency check */
-  bytes_per_pixel = 0;
-  for (i = 0; i <= extra; i++)
-    bytes_per_pixel += babl_format_get_bytes_per_pixel (channel[i].format);
-
-  g_printerr ("bytes_per_pixel: %d, format: %d\n", bytes_per_pixel,
-              babl_format_get_bytes_per_pixel (src_format));
-
   for (y = 0; y < imageLength; y += tileLength)
     {
       for (x = 0; x < imageWidth; x += tileWidth)
         {
-          int offset;
+          guchar *bufptr = buffer;
 
           gimp_progress_update (progress + one_row *
                                 ( (gdouble) x / (gdouble) imageWidth));
@@ -1434,78 +1495,267 @@ load_interleaved (TIFF         *tif,
           if (TIFFIsTiled (tif))
             TIFFReadTile (tif, buffer, x, y, 0, 0);
           else
-            TIFFReadScanline (tif, buffer, y + i, 0);
+            TIFFReadScanline (tif, buffer, y, 0);
 
           cols = MIN (imageWidth - x, tileWidth);
           rows = MIN (imageLength - y, tileLength);
 
-          if (planar == PLANARCONFIG_CONTIG)
-            {
-              src_buf = gegl_buffer_linear_new_from_data (buffer,
-                                                          src_format,
-                                                          GEGL_RECTANGLE (0, 0, cols, rows),
-                                                          GEGL_AUTO_ROWSTRIDE,
-                                                          NULL, NULL);
-             
-              offset = 0;
-             
-              for (i = 0; i <= extra; i++)
-                {
-                  int src_bpp, dest_bpp;
-             
-                  src_bpp = babl_format_get_bytes_per_pixel (src_format);
-                  dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
-             
-                  iter = gegl_buffer_iterator_new (src_buf,
-                                                   GEGL_RECTANGLE (0, 0, cols, rows),
-                                                   0, NULL,
-                                                   GEGL_BUFFER_READ,
-                                                   GEGL_ABYSS_NONE);
-                  gegl_buffer_iterator_add (iter, channel[i].buffer,
-                                            GEGL_RECTANGLE (x, y, cols, rows),
-                                            0, NULL,
-                                            GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
-             
-                  while (gegl_buffer_iterator_next (iter))
-                    {
-                      guchar *s = ((guchar *) iter->data[0]) + offset;
-                      guchar *d = iter->data[1];
-                      gint length = iter->length;
-             
-                      while (length--)
-                        {
-                          memcpy (d, s, dest_bpp);
-                          d += dest_bpp;
-                          s += src_bpp;
-                        }
-                    }
-             
-                  offset += dest_bpp;
-                }
+          /* this does not work - the image data is planar as well */
 
-              g_object_unref (src_buf);
-            }
-          else  /* PLANARCONFIG_SEPARATE */
+          g_printerr ("GEGL_RECTANGLE (%d, %d, %d, %d)\n", x, y, cols, rows);
+          for (i = 0; i <= extra; i++)
             {
-              guchar *bufptr = buffer;
+              gegl_buffer_set (channel[i].buffer,
+                               GEGL_RECTANGLE (x, y, cols, rows),
+                               0, channel[i].format,
+                               bufptr,
+                               GEGL_AUTO_ROWSTRIDE);
+              bufptr += babl_format_get_bytes_per_pixel (channel[i].format) * cols * rows;
+            }
+        }
+
+      progress += one_row;
+    }
 
-              /* this does not work - the image data is planar as well */
+  g_free (buffer);
+}
 
-              g_printerr ("GEGL_RECTANGLE (%d, %d, %d, %d)\n", x, y, cols, rows);
-              for (i = 0; i <= extra; i++)
-                {
-                  gegl_buffer_set (channel[i].buffer,
-                                   GEGL_RECTANGLE (x, y, cols, rows),
-                                   0, channel[i].format,
-                                   bufptr,
-                                   GEGL_AUTO_ROWSTRIDE);
-                  bufptr += babl_format_get_bytes_per_pixel (channel[i].format) * cols * rows;
-                }
+/* Reads whole tiles or strips, decoded with TIFFReadEncodedTile() or
+ * TIFFReadEncodedStrip() on a few threads: with deflate or LZW most
+ * of the loading time goes into decompressing.  The GeglBuffers are
+ * only written from this thread, they talk to GIMP.
+ */
+static void
+load_contiguous (TIFF         *tif,
+                 const gchar  *filename,
+                 channel_data *channel,
+                 const Babl   *src_format,
+                 gint          extra)
+{
+  TiffDecoder  decoder;
+  GThread     *threads[TIFF_MAX_DECODER_THREADS];
+  TiffUnit    *units;
+  uint32       imageWidth, imageLength;
+  uint32       unitWidth, unitLength;
+  uint32       across;
+  gint         rowstride;
+  gint         n_threads = 1;
+  gint         n_units;
+  gboolean     warned    = FALSE;
+  uint32       n;
+  gint         i;
+
+  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH, &imageWidth);
+  TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &imageLength);
+
+  decoder.filename  = filename;
+  decoder.directory = TIFFCurrentDirectory (tif);
+  decoder.tiled     = TIFFIsTiled (tif);
+  decoder.next_unit = 0;
+
+  if (decoder.tiled)
+    {
+      TIFFGetField (tif, TIFFTAG_TILEWIDTH, &unitWidth);
+      TIFFGetField (tif, TIFFTAG_TILELENGTH, &unitLength);
+
+      decoder.n_units   = TIFFNumberOfTiles (tif);
+      decoder.unit_size = TIFFTileSize (tif);
+    }
+  else
+    {
+      unitWidth = imageWidth;
+
+      TIFFGetFieldDefaulted (tif, TIFFTAG_ROWSPERSTRIP, &unitLength);
+      unitLength = MIN (unitLength, imageLength);
+
+      decoder.n_units   = TIFFNumberOfStrips (tif);
+      decoder.unit_size = TIFFStripSize (tif);
+    }
+
+  across    = (imageWidth + unitWidth - 1) / unitWidth;
+  rowstride = unitWidth * babl_format_get_bytes_per_pixel (src_format);
+
+  n_threads = CLAMP (gimp_get_number_of_processors (), 1, TIFF_MAX_DECODER_THREADS);
+
+  n_threads = MIN (n_threads, decoder.n_units);
+
+  /* a few units per thread keep the threads busy while this one writes */
+  n_units = 2 * n_threads;
+  units   = g_new (TiffUnit, n_units);
+
+  decoder.free_units    = g_async_queue_new ();
+  decoder.decoded_units = g_async_queue_new ();
+
+  for (i = 0; i < n_units; i++)
+    {
+      units[i].data = g_malloc (decoder.unit_size);
+      g_async_queue_push (decoder.free_units, &units[i]);
+    }
+
+  for (i = 0; i < n_threads; i++)
+    threads[i] = g_thread_new ("tiff-decoder", tiff_decoder_thread, &decoder);
+
+  for (n = 0; n < decoder.n_units; n++)
+    {
+      TiffUnit *unit = g_async_queue_pop (decoder.decoded_units);
+      uint32    x;
+      uint32    y;
+
+      if (decoder.tiled)
+        {
+          x = (unit->index % across) * unitWidth;
+          y = (unit->index / across) * unitLength;
+        }
+      else
+        {
+          x = 0;
+          y = unit->index * unitLength;
+        }
+
+      if (unit->success && x < imageWidth && y < imageLength)
+        {
+          load_contiguous_unit (channel, src_format, extra,
+                                unit->data, rowstride,
+                                x, y,
+                                MIN (imageWidth  - x, unitWidth),
+                                MIN (imageLength - y, unitLength));
+        }
+      else if (! unit->success && ! warned)
+        {
+          g_message (_("Could not read all of the image data"));
+          warned = TRUE;
+        }
+
+      g_async_queue_push (decoder.free_units, unit);
+
+      if ((n % 16) == 0)
+        gimp_progress_update ((gdouble) n / (gdouble) decoder.n_units);
+    }
+
+  for (i = 0; i < n_threads; i++)
+    g_thread_join (threads[i]);
+
+  for (i = 0; i < n_units; i++)
+    g_free (units[i].data);
+
+  g_free (units);
+
+  g_async_queue_unref (decoder.free_units);
+  g_async_queue_unref (decoder.decoded_units);
+}
+
+static void
+load_contiguous_unit (channel_data *channel,
+                      const Babl   *src_format,
+                      gint          extra,
+                      const guchar *data,
+                      gint          rowstride,
+                      gint          x,
+                      gint          y,
+                      gint          cols,
+                      gint          rows)
+{
+  GeglBuffer *src_buf;
+  gint        src_bpp = babl_format_get_bytes_per_pixel (src_format);
+  gint        offset  = 0;
+  gint        i;
+
+  src_buf = gegl_buffer_linear_new_from_data (data,
+                                              src_format,
+                                              GEGL_RECTANGLE (0, 0, cols, rows),
+                                              rowstride,
+                                              NULL, NULL);
+
+  for (i = 0; i <= extra; i++)
+    {
+      GeglBufferIterator *iter;
+      gint                dest_bpp;
+
+      dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
+
+      iter = gegl_buffer_iterator_new (src_buf,
+                                       GEGL_RECTANGLE (0, 0, cols, rows),
+                                       0, NULL,
+                                       GEGL_BUFFER_READ,
+                                       GEGL_ABYSS_NONE);
+      gegl_buffer_iterator_add (iter, channel[i].buffer,
+                                GEGL_RECTANGLE (x, y, cols, rows),
+                                0, NULL,
+                                GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          guchar *s = ((guchar *) iter->data[0]) + offset;
+          guchar *d = iter->data[1];
+          gint length = iter->length;
+
+          while (length--)
+            {
+              memcpy (d, s, dest_bpp);
+              d += dest_bpp;
+              s += src_bpp;
             }
         }
 
-      progress += one_row;
+      offset += dest_bpp;
     }
+
+  g_object_unref (src_buf);
+}
+
+static gpointer
+tiff_decoder_thread (gpointer data)
+{
+  TiffDecoder *decoder = data;
+  TIFF        *tif     = NULL;
+  gint         fd;
+
+  g_private_set (&tiff_decoder_thread_key, decoder);
+
+  fd = g_open (decoder->filename, O_RDONLY | _O_BINARY, 0);
+
+  if (fd != -1)
+    {
+      tif = TIFFFdOpen (fd, decoder->filename, "r");
+
+      if (! tif)
+        {
+          close (fd);
+        }
+      else if (! TIFFSetDirectory (tif, decoder->directory))
+        {
+          TIFFClose (tif);
+          tif = NULL;
+        }
+    }
+
+  for (;;)
+    {
+      gint      index = g_atomic_int_add (&decoder->next_unit, 1);
+      TiffUnit *unit;
+
+      if (index >= (gint) decoder->n_units)
+        break;
+
+      unit = g_async_queue_pop (decoder->free_units);
+
+      unit->index   = index;
+      unit->success = FALSE;
+
+      if (tif && decoder->tiled)
+        unit->success = TIFFReadEncodedTile (tif, index, unit->data,
+                                             decoder->unit_size) != -1;
+      else if (tif)
+        unit->success = TIFFReadEncodedStrip (tif, index, unit->data,
+                                              decoder->unit_size) != -1;
+
+      g_async_queue_push (decoder->decoded_units, unit);
+    }
+
+  if (tif)
+    TIFFClose (tif);
+
+  return NULL;
 }
 
 
@@ -65,6 +65,10 @@
 
 #include <tiffio.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
 
@@ -76,14 +80,57 @@
 #define PLUG_IN_BINARY "file-tiff-save"
 #define PLUG_IN_ROLE   "gimp-file-tiff-save"
 
+#define TILE_SIZE           256
+#define MAX_ENCODER_THREADS 16
+
+/* Above this much pixel data, the classic format's 32 bit offsets
+ * might not be enough, leave some room for the rest of the file and
+ * for data that doesn't compress.
+ */
+#define BIGTIFF_THRESHOLD   G_GUINT64_CONSTANT (0xE0000000)
+
 
 typedef struct
 {
   gint      compression;
   gint      fillorder;
   gboolean  save_transp_pixels;
+  gboolean  tiled;
 } TiffSaveVals;
 
+typedef struct _TiffWriter TiffWriter;
+
+/* A tile or strip, filled from the image and then compressed */
+typedef struct
+{
+  TiffWriter *writer;
+  ttile_t     index;
+  guchar     *data;
+  gsize       size;
+  gint        rows;
+  guchar     *encoded;
+  gsize       encoded_size;
+  gboolean    success;
+} TiffUnit;
+
+/* Writes the tiles or strips in order, with libtiff's codecs or, for
+ * deflate, compressing a batch of them on several threads and writing
+ * the results with TIFFWriteRawTile() or TIFFWriteRawStrip().
+ */
+struct _TiffWriter
+{
+  TIFF     *tif;
+  gboolean  tiled;
+  gboolean  parallel;
+  gint      predictor_bpp;  /* Bytes per pixel if we apply predictor 2 */
+  gsize     row_bytes;      /* Bytes per row of a unit */
+  gsize     unit_size;
+  gint      n_threads;
+  TiffUnit *units;          /* One batch in parallel mode */
+  gint      n_units;
+  ttile_t   next_index;
+};
+
 typedef struct
 {
   gint32        ID;
@@ -123,6 +170,18 @@ static void      byte2bit               (const guchar *byteline,
                                          guchar       *bitline,
                                          gboolean      invert);
 
+static TiffWriter * tiff_writer_new     (TIFF         *tif,
+                                         gboolean      tiled,
+                                         gushort       compression,
+                                         gint          predictor_bpp,
+                                         gsize         row_bytes,
+                                         gsize         unit_size);
+static gboolean  tiff_writer_add        (TiffWriter   *writer,
+                                         const guchar *data,
+                                         gint          rows);
+static gboolean  tiff_writer_flush      (TiffWriter   *writer);
+static void      tiff_writer_free       (TiffWriter   *writer);
+
 static void      tiff_warning           (const gchar *module,
                                          const gchar *fmt,
                                          va_list      ap);
@@ -159,7 +218,7 @@ query (void)
     { GIMP_PDB_DRAWABLE, "drawable",     "Drawable to save" },\
     { GIMP_PDB_STRING,   "filename",     "The name of the file to save the image in" },\
     { GIMP_PDB_STRING,   "raw-filename", "The name of the file to save the image in" },\
-    { GIMP_PDB_INT32,    "compression",  "Compression type: { NONE (0), LZW (1), PACKBITS (2), DEFLATE (3), JPEG (4), CCITT G3 Fax (5), CCITT G4 Fax (6) }" }
+    { GIMP_PDB_INT32,    "compression",  "Compression type: { NONE (0), LZW (1), PACKBITS (2), DEFLATE (3), JPEG (4), CCITT G3 Fax (5), CCITT G4 Fax (6), ZSTD (7, if libtiff supports it) }" }
 
   static const GimpParamDef save_args_old[] =
   {
@@ -309,6 +368,9 @@ run (const gchar      *name,
                 case 4: tsvals.compression = COMPRESSION_JPEG;      break;
                 case 5: tsvals.compression = COMPRESSION_CCITTFAX3; break;
                 case 6: tsvals.compression = COMPRESSION_CCITTFAX4; break;
+#ifdef COMPRESSION_ZSTD
+                case 7: tsvals.compression = COMPRESSION_ZSTD;      break;
+#endif
                 default: status = GIMP_PDB_CALLING_ERROR; break;
                 }
 
@@ -648,7 +710,12 @@ save_image (const gchar  *filename,
   gshort         samplesperpixel;
   gshort         bitspersample;
   gint           bytesperrow;
+  gint           outbytesperrow;
+  gint           tilebytesperrow = 0;
   guchar        *t, *src, *data;
+  guchar        *band;
+  guchar        *tile = NULL;
+  TiffWriter    *writer;
   guchar        *cmap;
   gint           num_colors;
   gint           success;
@@ -656,8 +723,11 @@ save_image (const gchar  *filename,
   GimpImageType  drawable_type;
   GimpPixelRgn   pixel_rgn;
   gint           tile_height;
+  gint           unit_rows;
   gint           y, yend;
   gint           fd;
+  gboolean       tiled;
+  gboolean       bigtiff  = FALSE;
   gboolean       is_bw    = FALSE;
   gboolean       invert   = TRUE;
   const guchar   bw_map[] = { 0, 0, 0, 255, 255, 255 };
@@ -686,14 +756,9 @@ save_image (const gchar  *filename,
       return FALSE;
     }
 
-  tif = TIFFFdOpen (fd, filename, "w");
-
   TIFFSetWarningHandler (tiff_warning);
   TIFFSetErrorHandler (tiff_error);
 
-  gimp_progress_init_printf (_("Saving '%s'"),
-                             gimp_filename_to_utf8 (filename));
-
   drawable = gimp_drawable_get (layer);
   drawable_type = gimp_drawable_type (layer);
   gimp_pixel_rgn_init (&pixel_rgn, drawable,
@@ -702,7 +767,38 @@ save_image (const gchar  *filename,
   cols = drawable->width;
   rows = drawable->height;
 
-  gimp_tile_cache_ntiles (1 + drawable->width / gimp_tile_width ());
+  tiled = tsvals.tiled;
+
+#ifdef TIFF_BIGTIFF_VERSION
+  /* Too big for 32 bit offsets, BigTIFF readers all handle tiles */
+  if ((guint64) cols * rows * drawable->bpp >= BIGTIFF_THRESHOLD)
+    {
+      bigtiff = TRUE;
+      tiled   = TRUE;
+    }
+#endif
+
+  tif = TIFFFdOpen (fd, filename, bigtiff ? "w8" : "w");
+
+  if (! tif)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   _("Could not open '%s' for writing: %s"),
+                   gimp_filename_to_utf8 (filename),
+                   "TIFFFdOpen() failed");
+      close (fd);
+      gimp_drawable_detach (drawable);
+      return FALSE;
+    }
+
+  gimp_progress_init_printf (_("Saving '%s'"),
+                             gimp_filename_to_utf8 (filename));
+
+  unit_rows = tiled ? TILE_SIZE : rowsperstrip;
+
+  /* Keep the tile rows of a band in the cache */
+  gimp_tile_cache_ntiles ((1 + drawable->width / gimp_tile_width ()) *
+                          ((unit_rows + tile_height - 1) / tile_height + 1));
 
   switch (drawable_type)
     {
@@ -799,6 +895,14 @@ save_image (const gchar  *filename,
         }
     }
 
+  if (! TIFFIsCODECConfigured (compression))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   "%s",
+                   "This compression is not supported by libtiff.");
+      return FALSE;
+    }
+
   /* Set TIFF parameters. */
   TIFFSetField (tif, TIFFTAG_SUBFILETYPE, 0);
   TIFFSetField (tif, TIFFTAG_IMAGEWIDTH, cols);
@@ -807,7 +911,11 @@ save_image (const gchar  *filename,
   TIFFSetField (tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
   TIFFSetField (tif, TIFFTAG_COMPRESSION, compression);
 
-  if ((compression == COMPRESSION_LZW || compression == COMPRESSION_DEFLATE)
+  if ((compression == COMPRESSION_LZW ||
+#ifdef COMPRESSION_ZSTD
+       compression == COMPRESSION_ZSTD ||
+#endif
+       compression == COMPRESSION_DEFLATE)
       && (predictor != 0))
     {
       TIFFSetField (tif, TIFFTAG_PREDICTOR, predictor);
@@ -826,7 +934,16 @@ save_image (const gchar  *filename,
   TIFFSetField (tif, TIFFTAG_PHOTOMETRIC, photometric);
   TIFFSetField (tif, TIFFTAG_DOCUMENTNAME, filename);
   TIFFSetField (tif, TIFFTAG_SAMPLESPERPIXEL, samplesperpixel);
-  TIFFSetField (tif, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
+
+  if (tiled)
+    {
+      TIFFSetField (tif, TIFFTAG_TILEWIDTH, TILE_SIZE);
+      TIFFSetField (tif, TIFFTAG_TILELENGTH, TILE_SIZE);
+    }
+  else
+    {
+      TIFFSetField (tif, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
+    }
   /* TIFFSetField( tif, TIFFTAG_STRIPBYTECOUNTS, rows / rowsperstrip ); */
   TIFFSetField (tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
 
@@ -936,38 +1053,56 @@ save_image (const gchar  *filename,
   if (!is_bw && drawable_type == GIMP_INDEXED_IMAGE)
     TIFFSetField (tif, TIFFTAG_COLORMAP, red, grn, blu);
 
-  /* array to rearrange data */
-  src = g_new (guchar, bytesperrow * tile_height);
-  data = g_new (guchar, bytesperrow);
+  /* bytes per row of the converted image data */
+  outbytesperrow = is_bw ? (cols + 7) / 8 : bytesperrow;
+
+  if (tiled)
+    {
+      tilebytesperrow = is_bw ? TILE_SIZE / 8 : TILE_SIZE * samplesperpixel;
+
+      writer = tiff_writer_new (tif, TRUE, compression,
+                                predictor ? samplesperpixel : 0,
+                                tilebytesperrow,
+                                tilebytesperrow * TILE_SIZE);
+      tile = g_new (guchar, tilebytesperrow * TILE_SIZE);
+    }
+  else
+    {
+      writer = tiff_writer_new (tif, FALSE, compression,
+                                predictor ? samplesperpixel : 0,
+                                outbytesperrow,
+                                outbytesperrow * rowsperstrip);
+    }
 
-  /* Now write the TIFF data. */
+  /* arrays to rearrange data */
+  src  = g_new (guchar, bytesperrow * unit_rows);
+  band = g_new (guchar, outbytesperrow * unit_rows);
+
+  /* Now write the TIFF data, one band of tiles or one strip at a time. */
   for (y = 0; y < rows; y = yend)
     {
-      yend = y + tile_height;
+      yend = y + unit_rows;
       yend = MIN (yend, rows);
 
       gimp_pixel_rgn_get_rect (&pixel_rgn, src, 0, y, cols, yend - y);
 
       for (row = y; row < yend; row++)
         {
-          t = src + bytesperrow * (row - y);
+          t    = src  + bytesperrow    * (row - y);
+          data = band + outbytesperrow * (row - y);
 
           switch (drawable_type)
             {
             case GIMP_INDEXED_IMAGE:
               if (is_bw)
-                {
-                  byte2bit (t, bytesperrow, data, invert);
-                  success = (TIFFWriteScanline (tif, data, row, 0) >= 0);
-                }
+                byte2bit (t, bytesperrow, data, invert);
               else
-                {
-                  success = (TIFFWriteScanline (tif, t, row, 0) >= 0);
-                }
+                memcpy (data, t, bytesperrow);
               break;
 
             case GIMP_GRAY_IMAGE:
-              success = (TIFFWriteScanline (tif, t, row, 0) >= 0);
+            case GIMP_RGB_IMAGE:
+              memcpy (data, t, bytesperrow);
               break;
 
             case GIMP_GRAYA_IMAGE:
@@ -985,12 +1120,6 @@ save_image (const gchar  *filename,
 
                   data[col + 1] = t[col + 1];  /* alpha channel */
                 }
-
-              success = (TIFFWriteScanline (tif, data, row, 0) >= 0);
-              break;
-
-            case GIMP_RGB_IMAGE:
-              success = (TIFFWriteScanline (tif, t, row, 0) >= 0);
               break;
 
             case GIMP_RGBA_IMAGE:
@@ -1012,24 +1141,69 @@ save_image (const gchar  *filename,
 
                   data[col+3] = t[col + 3];  /* alpha channel */
                 }
-
-              success = (TIFFWriteScanline (tif, data, row, 0) >= 0);
               break;
 
             default:
-              success = FALSE;
               break;
             }
+        }
+
+      if (tiled)
+        {
+          gint x;
+
+          success = TRUE;
 
-          if (!success)
+          for (x = 0; x < cols && success; x += TILE_SIZE)
             {
-              g_message ("Failed a scanline write on row %d", row);
-              return FALSE;
+              gint   width = MIN (TILE_SIZE, cols - x);
+              gsize  offset;
+              gsize  length;
+
+              if (is_bw)
+                {
+                  offset = x / 8;
+                  length = (width + 7) / 8;
+                }
+              else
+                {
+                  offset = x * samplesperpixel;
+                  length = width * samplesperpixel;
+                }
+
+              /* partial tiles are padded with zeros */
+              memset (tile, 0, tilebytesperrow * TILE_SIZE);
+
+              for (row = y; row < yend; row++)
+                memcpy (tile + tilebytesperrow * (row - y),
+                        band + outbytesperrow * (row - y) + offset,
+                        length);
+
+              success = tiff_writer_add (writer, tile, TILE_SIZE);
             }
         }
+      else
+        {
+          success = tiff_writer_add (writer, band, yend - y);
+        }
+
+      if (!success)
+        {
+          g_message ("Failed a data write on row %d", y);
+          tiff_writer_free (writer);
+          return FALSE;
+        }
+
+      gimp_progress_update ((gdouble) yend / (gdouble) rows);
+    }
 
-      if ((row % 32) == 0)
-        gimp_progress_update ((gdouble) row / (gdouble) rows);
+  success = tiff_writer_flush (writer);
+  tiff_writer_free (writer);
+
+  if (!success)
+    {
+      g_message ("Failed a data write on row %d", rows);
+      return FALSE;
     }
 
   TIFFFlushData (tif);
@@ -1039,7 +1213,9 @@ save_image (const gchar  *filename,
   gimp_progress_update (1.0);
 
   gimp_drawable_detach (drawable);
-  g_free (data);
+  g_free (src);
+  g_free (band);
+  g_free (tile);
 
   return TRUE;
 }
@@ -1057,6 +1233,9 @@ save_dialog (gboolean has_alpha,
   GtkWidget *toggle;
   GtkWidget *g3;
   GtkWidget *g4;
+#ifdef COMPRESSION_ZSTD
+  GtkWidget *zstd;
+#endif
   gboolean   run;
 
   dialog = gimp_export_dialog_new (_("TIFF"), PLUG_IN_BINARY, SAVE_PROC);
@@ -1078,9 +1257,16 @@ save_dialog (gboolean has_alpha,
                                     _("_JPEG"),      COMPRESSION_JPEG,     NULL,
                                     _("CCITT Group _3 fax"), COMPRESSION_CCITTFAX3, &g3,
                                     _("CCITT Group _4 fax"), COMPRESSION_CCITTFAX4, &g4,
+#ifdef COMPRESSION_ZSTD
+                                    _("_Zstandard"), COMPRESSION_ZSTD,     &zstd,
+#endif
 
                                     NULL);
 
+#ifdef COMPRESSION_ZSTD
+  gtk_widget_set_sensitive (zstd, TIFFIsCODECConfigured (COMPRESSION_ZSTD));
+#endif
+
   gtk_widget_set_sensitive (g3, is_monochrome);
   gtk_widget_set_sensitive (g4, is_monochrome);
 
@@ -1110,6 +1296,22 @@ save_dialog (gboolean has_alpha,
                     G_CALLBACK (gimp_toggle_button_update),
                     &tsvals.save_transp_pixels);
 
+  /* Tiles instead of strips */
+  toggle = gtk_check_button_new_with_mnemonic (_("Save in _tiles"));
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (toggle), tsvals.tiled);
+  gtk_box_pack_start (GTK_BOX (vbox), toggle, FALSE, FALSE, 0);
+  gtk_widget_show (toggle);
+
+  gimp_help_set_help_data (toggle,
+                           _("Tiles load faster in programs that show "
+                             "parts of huge images, but not every program "
+                             "can read them"),
+                           NULL);
+
+  g_signal_connect (toggle, "toggled",
+                    G_CALLBACK (gimp_toggle_button_update),
+                    &tsvals.tiled);
+
   /* comment entry */
   hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
   gtk_box_pack_start (GTK_BOX (vbox), hbox, FALSE, FALSE, 0);
@@ -1190,3 +1392,174 @@ byte2bit (const guchar *byteline,
       *bitline = invert ? ~bitval & (0xff << (8 - width)) : bitval;
     }
 }
+
+static TiffWriter *
+tiff_writer_new (TIFF         *tif,
+                 gboolean      tiled,
+                 gushort       compression,
+                 gint          predictor_bpp,
+                 gsize         row_bytes,
+                 gsize         unit_size)
+{
+  TiffWriter *writer = g_new0 (TiffWriter, 1);
+
+  writer->tif           = tif;
+  writer->tiled         = tiled;
+  writer->predictor_bpp = predictor_bpp;
+  writer->row_bytes     = row_bytes;
+  writer->unit_size     = unit_size;
+
+#ifdef HAVE_ZLIB
+  {
+    gint n_threads = 1;
+    gint n_units;
+    gint i;
+
+    n_threads = MIN (gimp_get_number_of_processors (), MAX_ENCODER_THREADS);
+
+    n_units = tiled ? TIFFNumberOfTiles (tif) : TIFFNumberOfStrips (tif);
+
+    /* libtiff compresses one tile or strip after the other, for
+     * deflate we can do the compression ourselves and write the raw
+     * data
+     */
+    if (compression == COMPRESSION_DEFLATE && n_threads > 1 && n_units > 1)
+      {
+        writer->parallel  = TRUE;
+        writer->n_threads = MIN (n_threads, n_units);
+        writer->units     = g_new0 (TiffUnit, writer->n_threads);
+
+        for (i = 0; i < writer->n_threads; i++)
+          writer->units[i].data = g_new (guchar, unit_size);
+      }
+  }
+#endif
+
+  return writer;
+}
+
+#ifdef HAVE_ZLIB
+static gpointer
+tiff_writer_unit_thread (gpointer data)
+{
+  TiffUnit   *unit   = data;
+  TiffWriter *writer = unit->writer;
+  uLongf      size;
+
+  /* Horizontal differencing, as TIFFTAG_PREDICTOR 2 tells the reader */
+  if (writer->predictor_bpp)
+    {
+      gint row;
+
+      for (row = 0; row < unit->rows; row++)
+        {
+          guchar *p   = unit->data + row * writer->row_bytes;
+          gsize   bpp = writer->predictor_bpp;
+          gsize   i;
+
+          for (i = writer->row_bytes - 1; i >= bpp; i--)
+            p[i] -= p[i - bpp];
+        }
+    }
+
+  size = compressBound (unit->size);
+
+  unit->encoded = g_realloc (unit->encoded, size);
+  unit->success = (compress2 (unit->encoded, &size, unit->data, unit->size,
+                              Z_DEFAULT_COMPRESSION) == Z_OK);
+  unit->encoded_size = size;
+
+  return NULL;
+}
+#endif
+
+/* Adds the next tile or strip, rows is only used for the last strip */
+static gboolean
+tiff_writer_add (TiffWriter   *writer,
+                 const guchar *data,
+                 gint          rows)
+{
+  gsize size = writer->tiled ? writer->unit_size : writer->row_bytes * rows;
+
+  if (writer->parallel)
+    {
+      TiffUnit *unit = &writer->units[writer->n_units++];
+
+      unit->writer = writer;
+      unit->index  = writer->next_index++;
+      unit->rows   = writer->tiled ? TILE_SIZE : rows;
+      unit->size   = size;
+
+      memcpy (unit->data, data, size);
+
+      if (writer->n_units == writer->n_threads)
+        return tiff_writer_flush (writer);
+
+      return TRUE;
+    }
+
+  if (writer->tiled)
+    return TIFFWriteEncodedTile (writer->tif, writer->next_index++,
+                                 (guchar *) data, size) >= 0;
+  else
+    return TIFFWriteEncodedStrip (writer->tif, writer->next_index++,
+                                  (guchar *) data, size) >= 0;
+}
+
+/* Compresses the batch of tiles or strips, and writes them in order */
+static gboolean
+tiff_writer_flush (TiffWriter *writer)
+{
+#ifdef HAVE_ZLIB
+  GThread  *threads[MAX_ENCODER_THREADS];
+  gboolean  success = TRUE;
+  gint      i;
+
+  if (! writer->parallel || writer->n_units == 0)
+    return TRUE;
+
+  for (i = 1; i < writer->n_units; i++)
+    threads[i] = g_thread_new ("tiff-deflate", tiff_writer_unit_thread,
+                               &writer->units[i]);
+
+  tiff_writer_unit_thread (&writer->units[0]);
+
+  for (i = 1; i < writer->n_units; i++)
+    g_thread_join (threads[i]);
+
+  for (i = 0; i < writer->n_units && success; i++)
+    {
+      TiffUnit *unit = &writer->units[i];
+
+      success = unit->success;
+
+      if (success && writer->tiled)
+        success = TIFFWriteRawTile (writer->tif, unit->index,
+                                    unit->encoded, unit->encoded_size) >= 0;
+      else if (success)
+        success = TIFFWriteRawStrip (writer->tif, unit->index,
+                                     unit->encoded, unit->encoded_size) >= 0;
+    }
+
+  writer->n_units = 0;
+
+  return success;
+#else
+  return TRUE;
+#endif
+}
+
+static void
+tiff_writer_free (TiffWriter *writer)
+{
+  gint i;
+
+  for (i = 0; i < writer->n_threads; i++)
+    {
+      g_free (writer->units[i].data);
+      g_free (writer->units[i].encoded);
+    }
+
+  g_free (writer->units);
+  g_free (writer);
+}
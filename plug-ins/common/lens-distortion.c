@@ -308,62 +308,87 @@ lens_cubic_interpolate (const guchar *src,
     }
 }
 
+/*  Renders n_pixels pixels at the positions in pos. The 4x4 source
+ *  pixels around all of them are fetched in one go; coords and pixels
+ *  need room for 16 times n_pixels of them.
+ */
 static void
-lens_distort_func (gint              ix,
-                   gint              iy,
-                   guchar           *dest,
-                   gint              bpp,
-                   GimpPixelFetcher *pft)
+lens_distort_pixels (GimpPixelFetcher *pft,
+                     gint              n_pixels,
+                     const gint       *pos,
+                     guchar           *dest,
+                     gint              bpp,
+                     gint             *coords,
+                     guchar           *pixels)
 {
-  gdouble  src_x, src_y, mag;
-  gdouble  brighten;
-  guchar   pixel_buffer[16 * LENS_MAX_PIXEL_DEPTH];
-  guchar  *pixel;
-  gdouble  dx, dy;
-  gint     x_int, y_int;
-  gint     x, y;
-
-  lens_get_source_coords (ix, iy, &src_x, &src_y, &mag);
+  gint *c = coords;
+  gint  i;
 
-  brighten = 1.0 + mag * calc_vals.brighten;
-  x_int = floor (src_x);
-  dx = src_x - x_int;
+  for (i = 0; i < n_pixels; i++)
+    {
+      gdouble src_x, src_y, mag;
+      gint    x_int, y_int;
+      gint    x, y;
+
+      lens_get_source_coords (pos[i * 2], pos[i * 2 + 1],
+                              &src_x, &src_y, &mag);
+
+      x_int = floor (src_x);
+      y_int = floor (src_y);
+
+      for (y = y_int - 1; y <= y_int + 2; y++)
+        for (x = x_int -1; x <= x_int + 2; x++)
+          {
+            *c++ = x;
+            *c++ = y;
+          }
+    }
 
-  y_int = floor (src_y);
-  dy = src_y - y_int;
+  gimp_pixel_fetcher_get_pixels (pft, n_pixels * 16, coords, pixels);
 
-  pixel = pixel_buffer;
-  for (y = y_int - 1; y <= y_int + 2; y++)
+  for (i = 0; i < n_pixels * 16; i++)
     {
-      for (x = x_int -1; x <= x_int + 2; x++)
-        {
-          if (x >= 0  && y >= 0 &&
-              x < drawable_width &&  y < drawable_height)
-            {
-              gimp_pixel_fetcher_get_pixel (pft, x, y, pixel);
-            }
-          else
-            {
-              gint i;
-
-              for (i = 0; i < bpp; i++)
-                pixel[i] = background_color[i];
-            }
-
-          pixel += bpp;
-        }
+      gint x = coords[i * 2];
+      gint y = coords[i * 2 + 1];
+
+      if (x < 0 || y < 0 || x >= drawable_width || y >= drawable_height)
+        memcpy (pixels + i * bpp, background_color, bpp);
     }
 
-  lens_cubic_interpolate (pixel_buffer, bpp * 4, bpp,
-                          dest, bpp, dx, dy, brighten);
+  for (i = 0; i < n_pixels; i++)
+    {
+      gdouble src_x, src_y, mag;
+      gdouble brighten;
+
+      lens_get_source_coords (pos[i * 2], pos[i * 2 + 1],
+                              &src_x, &src_y, &mag);
+
+      brighten = 1.0 + mag * calc_vals.brighten;
+
+      lens_cubic_interpolate (pixels + i * 16 * bpp, bpp * 4, bpp,
+                              dest + i * bpp, bpp,
+                              src_x - floor (src_x), src_y - floor (src_y),
+                              brighten);
+    }
 }
 
 static void
 lens_distort (GimpDrawable *drawable)
 {
-  GimpRgnIterator  *iter;
+  GimpPixelRgn      dest_rgn;
   GimpPixelFetcher *pft;
   GimpRGB           background;
+  gint              x1, y1, width, height;
+  gint             *pos;
+  gint             *coords;
+  guchar           *pixels;
+  guchar           *row;
+  gint              bpp;
+  gint              x, y;
+
+  if (! gimp_drawable_mask_intersect (drawable->drawable_id,
+                                      &x1, &y1, &width, &height))
+    return;
 
   lens_setup_calc (drawable->width, drawable->height);
 
@@ -376,11 +401,43 @@ lens_distort (GimpDrawable *drawable)
 
   gimp_progress_init (_("Lens distortion"));
 
-  iter = gimp_rgn_iterator_new (drawable, 0);
-  gimp_rgn_iterator_dest (iter, (GimpRgnFuncDest) lens_distort_func, pft);
-  gimp_rgn_iterator_free (iter);
+  bpp = drawable->bpp;
+
+  gimp_pixel_rgn_init (&dest_rgn, drawable, x1, y1, width, height, TRUE, TRUE);
+
+  pos    = g_new (gint, width * 2);
+  coords = g_new (gint, width * 16 * 2);
+  pixels = g_new (guchar, width * 16 * bpp);
+  row    = g_new (guchar, width * bpp);
+
+  for (y = 0; y < height; y++)
+    {
+      for (x = 0; x < width; x++)
+        {
+          pos[x * 2]     = x1 + x;
+          pos[x * 2 + 1] = y1 + y;
+        }
+
+      lens_distort_pixels (pft, width, pos, row, bpp, coords, pixels);
+
+      gimp_pixel_rgn_set_row (&dest_rgn, row, x1, y1 + y, width);
+
+      if (y % 16 == 0)
+        gimp_progress_update ((gdouble) y / height);
+    }
+
+  gimp_progress_update (1.0);
+
+  g_free (pos);
+  g_free (coords);
+  g_free (pixels);
+  g_free (row);
 
   gimp_pixel_fetcher_destroy (pft);
+
+  gimp_drawable_flush (drawable);
+  gimp_drawable_merge_shadow (drawable->drawable_id, TRUE);
+  gimp_drawable_update (drawable->drawable_id, x1, y1, width, height);
 }
 
 static void
@@ -388,9 +445,11 @@ lens_distort_preview (GimpDrawable *drawable,
                       GimpPreview  *preview)
 {
   guchar               *dest;
-  guchar               *pixel;
   gint                  width, height, bpp;
   gint                  x, y;
+  gint                 *pos;
+  gint                 *coords;
+  guchar               *pixels;
   GimpPixelFetcher     *pft;
   GimpRGB               background;
 
@@ -405,22 +464,24 @@ lens_distort_preview (GimpDrawable *drawable,
 
   dest = gimp_zoom_preview_get_source (GIMP_ZOOM_PREVIEW (preview),
                                        &width, &height, &bpp);
-  pixel = dest;
+
+  pos    = g_new (gint, width * 2);
+  coords = g_new (gint, width * 16 * 2);
+  pixels = g_new (guchar, width * 16 * bpp);
 
   for (y = 0; y < height; y++)
     {
       for (x = 0; x < width; x++)
-        {
-          gint sx, sy;
+        gimp_preview_untransform (preview, x, y, &pos[x * 2], &pos[x * 2 + 1]);
 
-          gimp_preview_untransform (preview, x, y, &sx, &sy);
-
-          lens_distort_func (sx, sy, pixel, bpp, pft);
-
-          pixel += bpp;
-        }
+      lens_distort_pixels (pft, width, pos, dest + y * width * bpp, bpp,
+                           coords, pixels);
     }
 
+  g_free (pos);
+  g_free (coords);
+  g_free (pixels);
+
   gimp_pixel_fetcher_destroy (pft);
 
   gimp_preview_draw_buffer (preview, dest, width * bpp);
@@ -48,11 +48,13 @@ static void     scatter_hsv         (GimpDrawable     *drawable);
 static gboolean scatter_hsv_dialog  (GimpDrawable     *drawable);
 static void     scatter_hsv_preview (GimpPreview      *preview);
 
-static void     scatter_hsv_scatter (guchar           *r,
+static void     scatter_hsv_scatter (GimpRandomStream *stream,
+                                     guchar           *r,
                                      guchar           *g,
                                      guchar           *b);
 
-static gint     randomize_value     (gint              now,
+static gint     randomize_value     (GimpRandomStream *stream,
+                                     gint              now,
                                      gint              min,
                                      gint              max,
                                      gboolean          wraps_around,
@@ -83,6 +85,9 @@ static ValueType VALS =
   10
 };
 
+/*  the noise of each pixel only depends on this and its position  */
+static guint32 hsv_seed;
+
 MAIN ()
 
 static void
@@ -143,6 +148,8 @@ run (const gchar      *name,
   run_mode = param[0].data.d_int32;
   drawable = gimp_drawable_get (param[2].data.d_int32);
 
+  hsv_seed = g_random_int ();
+
   *nreturn_vals = 1;
   *return_vals  = values;
 
@@ -186,18 +193,23 @@ run (const gchar      *name,
 }
 
 static void
-scatter_hsv_func (const guchar *src,
+scatter_hsv_func (gint          x,
+                  gint          y,
+                  const guchar *src,
                   guchar       *dest,
                   gint          bpp,
                   gpointer      data)
 {
-  guchar h, s, v;
+  GimpRandomStream stream;
+  guchar           h, s, v;
+
+  gimp_random_stream_init (&stream, hsv_seed, x, y);
 
   h = src[0];
   s = src[1];
   v = src[2];
 
-  scatter_hsv_scatter (&h, &s, &v);
+  scatter_hsv_scatter (&stream, &h, &s, &v);
 
   dest[0] = h;
   dest[1] = s;
@@ -210,36 +222,41 @@ scatter_hsv_func (const guchar *src,
 static void
 scatter_hsv (GimpDrawable *drawable)
 {
+  GimpRgnIterator *iter;
+
   gimp_tile_cache_ntiles (2 * (drawable->width / gimp_tile_width () + 1));
 
   gimp_progress_init (_("HSV Noise"));
 
-  gimp_rgn_iterate2 (drawable, 0 /* unused */, scatter_hsv_func, NULL);
+  iter = gimp_rgn_iterator_new (drawable, 0 /* unused */);
+  gimp_rgn_iterator_src_dest (iter, scatter_hsv_func, NULL);
+  gimp_rgn_iterator_free (iter);
 
   gimp_drawable_detach (drawable);
 }
 
 static gint
-randomize_value (gint     now,
-                 gint     min,
-                 gint     max,
-                 gboolean wraps_around,
-                 gint     rand_max)
+randomize_value (GimpRandomStream *stream,
+                 gint              now,
+                 gint              min,
+                 gint              max,
+                 gboolean          wraps_around,
+                 gint              rand_max)
 {
   gint    flag, steps, index;
   gdouble rand_val, new;
 
   steps = max - min + 1;
-  rand_val = g_random_double ();
+  rand_val = gimp_random_stream_double (stream);
 
   for (index = 1; index < VALS.holdness; index++)
     {
-      double tmp = g_random_double ();
+      double tmp = gimp_random_stream_double (stream);
       if (tmp < rand_val)
         rand_val = tmp;
     }
 
-  if (g_random_double () < 0.5)
+  if (gimp_random_stream_double (stream) < 0.5)
     flag = -1;
   else
     flag = 1;
@@ -266,9 +283,10 @@ randomize_value (gint     now,
 }
 
 static void
-scatter_hsv_scatter (guchar *r,
-                     guchar *g,
-                     guchar *b)
+scatter_hsv_scatter (GimpRandomStream *stream,
+                     guchar           *r,
+                     guchar           *g,
+                     guchar           *b)
 {
   gint h, s, v;
   gint h1, s1, v1;
@@ -280,17 +298,17 @@ scatter_hsv_scatter (guchar *r,
 
   /* there is no need for scattering hue of desaturated pixels here */
   if ((VALS.hue_distance > 0) && (s > 0))
-    h = randomize_value (h, 0, 359, TRUE,  VALS.hue_distance);
+    h = randomize_value (stream, h, 0, 359, TRUE,  VALS.hue_distance);
 
   /* desaturated pixels get random hue before increasing saturation */
   if (VALS.saturation_distance > 0) {
     if (s == 0)
-      h = g_random_int_range (0, 360);
-    s = randomize_value (s, 0, 255, FALSE, VALS.saturation_distance);
+      h = gimp_random_stream_int_range (stream, 0, 360);
+    s = randomize_value (stream, s, 0, 255, FALSE, VALS.saturation_distance);
   }
 
   if (VALS.value_distance > 0)
-    v = randomize_value (v, 0, 255, FALSE, VALS.value_distance);
+    v = randomize_value (stream, v, 0, 255, FALSE, VALS.value_distance);
 
   h1 = h; s1 = s; v1 = v;
 
@@ -316,7 +334,7 @@ scatter_hsv_preview (GimpPreview *preview)
   GimpDrawable *drawable;
   GimpPixelRgn  src_rgn;
   guchar       *src, *dst;
-  gint          i;
+  gint          x, y;
   gint          x1, y1;
   gint          width, height;
   gint          bpp;
@@ -337,8 +355,13 @@ scatter_hsv_preview (GimpPreview *preview)
                        FALSE, FALSE);
   gimp_pixel_rgn_get_rect (&src_rgn, src, x1, y1, width, height);
 
-  for (i = 0; i < width * height; i++)
-    scatter_hsv_func (src + i * bpp, dst + i * bpp, bpp, NULL);
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        gint i = (y * width + x) * bpp;
+
+        scatter_hsv_func (x1 + x, y1 + y, src + i, dst + i, bpp, NULL);
+      }
 
   gimp_preview_draw_buffer (preview, dst, width * bpp);
 
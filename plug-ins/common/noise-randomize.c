@@ -125,7 +125,7 @@ typedef struct
   gdouble  rndm_pct;     /* likelihood of randomization (as %age) */
   gdouble  rndm_rcount;  /* repeat count */
   gboolean randomize;    /* Whether to use a random seed */
-  guint    seed;         /* seed value for g_rand_set_seed() function */
+  guint    seed;         /* seed value for the random streams */
 } RandomizeVals;
 
 static RandomizeVals pivals =
@@ -136,8 +136,6 @@ static RandomizeVals pivals =
   SEED_DEFAULT
 };
 
-static GRand  *gr; /* The GRand object which generates the
-                    * random numbers */
 
 /*********************************
  *
@@ -307,7 +305,6 @@ run (const gchar      *name,
   values[0].type          = GIMP_PDB_STATUS;
   values[0].data.d_status = status;
 
-  gr = g_rand_new ();
   /*
    *  Make sure the drawable type is appropriate.
    */
@@ -379,11 +376,6 @@ run (const gchar      *name,
         {
           gimp_progress_init_printf ("%s", gettext (RNDM_NAME[rndm_type - 1]));
 
-          /*
-           *  Initialize the g_rand() function seed
-           */
-          g_rand_set_seed (gr, pivals.seed);
-
           randomize (drawable, NULL);
           /*
            *  If we ran interactively (even repeating) update the display.
@@ -414,7 +406,6 @@ run (const gchar      *name,
    *  Set the status where GIMP can see it, and let go
    *  of the drawable.
    */
-  g_rand_free (gr);
   values[0].data.d_status = status;
   gimp_drawable_detach(drawable);
 }
@@ -483,6 +474,8 @@ randomize (GimpDrawable *drawable,
   gint x, y;
   gint cnt;
   gint i, j, k;
+  GimpRandomStream stream;
+  guint32 pass_seed;
 
   if (preview)
     {
@@ -522,6 +515,12 @@ randomize (GimpDrawable *drawable,
 
   for (cnt = 1; cnt <= pivals.rndm_rcount; cnt++)
     {
+      /*
+       *  the random numbers only depend on the seed, the pass and the
+       *  position of the pixel, so the preview matches the result
+       */
+      pass_seed = pivals.seed ^ (cnt * 0x9E3779B9);
+
       /*
        *  prepare the first row and previous row
        */
@@ -538,7 +537,10 @@ randomize (GimpDrawable *drawable,
           d = dest;
           for (col = 0; col < width; col++)
             {
-              if (g_rand_int_range (gr, 0, 100) <= (gint) pivals.rndm_pct)
+              gimp_random_stream_init (&stream, pass_seed, x + col, row);
+
+              if (gimp_random_stream_int_range (&stream, 0, 100) <=
+                  (gint) pivals.rndm_pct)
                 {
                   switch (rndm_type)
                     {
@@ -548,14 +550,14 @@ randomize (GimpDrawable *drawable,
                        */
                     case RNDM_HURL:
                       for (j = 0; j < bytes; j++)
-                        *d++ = g_rand_int_range (gr, 0, 256);
+                        *d++ = gimp_random_stream_int_range (&stream, 0, 256);
                       break;
                       /*
                        *  PICK
                        *      pick at random from a neighboring pixel.
                        */
                     case RNDM_PICK:
-                      k = g_rand_int_range (gr, 0, 9);
+                      k = gimp_random_stream_int_range (&stream, 0, 9);
                       for (j = 0; j < bytes; j++)
                         {
                           i = col * bytes + j;
@@ -599,7 +601,7 @@ randomize (GimpDrawable *drawable,
                        *      10% from above right.
                        */
                     case RNDM_SLUR:
-                      k = g_rand_int_range (gr, 0, 10);
+                      k = gimp_random_stream_int_range (&stream, 0, 10);
                       for (j = 0; j < bytes; j++)
                         {
                           i = col*bytes + j;
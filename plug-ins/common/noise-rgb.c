@@ -71,7 +71,9 @@ static void     run          (const gchar      *name,
                               GimpParam       **return_vals);
 
 
-static void     noisify_func (const guchar     *src,
+static void     noisify_func (gint              x,
+                              gint              y,
+                              const guchar     *src,
                               guchar           *dest,
                               gint              bpp,
                               gpointer          data);
@@ -79,7 +81,7 @@ static void     noisify_func (const guchar     *src,
 static void     noisify      (GimpPreview      *preview);
 
 
-static gdouble  gauss                            (GRand         *gr);
+static gdouble  gauss                            (GimpRandomStream *stream);
 
 static gboolean noisify_dialog                   (GimpDrawable  *drawable,
                                                   gint           channels);
@@ -108,7 +110,10 @@ static NoisifyInterface noise_int =
   { NULL, NULL, NULL, NULL }
 };
 
-static GRand *noise_gr ; /* Global random number object */
+/*  The noise of each pixel only depends on this seed and the pixel's
+ *  position, so the preview shows the same noise as the result
+ */
+static guint32 noise_seed;
 
 MAIN ()
 
@@ -198,7 +203,7 @@ run (const gchar      *name,
   values[0].type          = GIMP_PDB_STATUS;
   values[0].data.d_status = status;
 
-  noise_gr = g_rand_new ();
+  noise_seed = g_random_int ();
 
   /*  Get the specified drawable  */
   drawable = gimp_drawable_get (param[2].data.d_drawable);
@@ -217,7 +222,6 @@ run (const gchar      *name,
       if (! noisify_dialog (drawable, drawable->bpp))
         {
           gimp_drawable_detach (drawable);
-          g_rand_free (noise_gr);
           return;
         }
       break;
@@ -280,10 +284,13 @@ run (const gchar      *name,
 
   if (status == GIMP_PDB_SUCCESS)
     {
+      GimpRgnIterator *iter;
+
       gimp_progress_init (_("Adding noise"));
 
-      /*  compute the luminosity which exceeds the luminosity threshold  */
-      gimp_rgn_iterate2 (drawable, 0 /* unused */, noisify_func, noise_gr);
+      iter = gimp_rgn_iterator_new (drawable, 0 /* unused */);
+      gimp_rgn_iterator_src_dest (iter, noisify_func, NULL);
+      gimp_rgn_iterator_free (iter);
 
       if (run_mode != GIMP_RUN_NONINTERACTIVE)
         gimp_displays_flush ();
@@ -300,24 +307,27 @@ run (const gchar      *name,
   values[0].data.d_status = status;
 
   gimp_drawable_detach (drawable);
-  g_rand_free (noise_gr);
 }
 
 static void
-noisify_func (const guchar *src,
+noisify_func (gint          x,
+              gint          y,
+              const guchar *src,
               guchar       *dest,
               gint          bpp,
               gpointer      data)
 {
-  GRand   *gr    = data;
-  gdouble  noise = 0;
-  gint     b;
+  GimpRandomStream stream;
+  gdouble          noise = 0;
+  gint             b;
+
+  gimp_random_stream_init (&stream, noise_seed, x, y);
 
   for (b = 0; b < bpp; b++)
     {
       if (b == 0 || nvals.independent ||
           (b == 1 && bpp == 2) || (b == 3 && bpp == 4))
-        noise = nvals.noise[b] * gauss (gr) * 127;
+        noise = nvals.noise[b] * gauss (&stream) * 127;
 
       if (nvals.noise[b] > 0.0)
         {
@@ -347,11 +357,10 @@ noisify (GimpPreview *preview)
   GimpDrawable *drawable;
   GimpPixelRgn  src_rgn;
   guchar       *src, *dst;
-  gint          i;
+  gint          x, y;
   gint          x1, y1;
   gint          width, height;
   gint          bpp;
-  GRand        *gr = g_rand_copy (noise_gr);
 
   drawable =
     gimp_drawable_preview_get_drawable (GIMP_DRAWABLE_PREVIEW (preview));
@@ -369,14 +378,18 @@ noisify (GimpPreview *preview)
                        FALSE, FALSE);
   gimp_pixel_rgn_get_rect (&src_rgn, src, x1, y1, width, height);
 
-  for (i = 0; i < width * height; i++)
-    noisify_func (src + i * bpp, dst + i * bpp, bpp, gr);
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        gint i = (y * width + x) * bpp;
+
+        noisify_func (x1 + x, y1 + y, src + i, dst + i, bpp, NULL);
+      }
 
   gimp_preview_draw_buffer (preview, dst, width * bpp);
 
   g_free (src);
   g_free (dst);
-  g_rand_free (gr);
 }
 
 static void
@@ -576,16 +589,16 @@ noisify_dialog (GimpDrawable *drawable,
  * K+M, ACM Trans Math Software 3 (1977) 257-260.
 */
 static gdouble
-gauss (GRand *gr)
+gauss (GimpRandomStream *stream)
 {
   gdouble u, v, x;
 
   do
     {
-      v = g_rand_double (gr);
+      v = gimp_random_stream_double (stream);
 
       do
-        u = g_rand_double (gr);
+        u = gimp_random_stream_double (stream);
       while (u == 0);
 
       /* Const 1.715... = sqrt(8/e) */
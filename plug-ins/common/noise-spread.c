@@ -67,6 +67,11 @@ static SpreadValues spvals =
   5    /*  vertical spread amount    */
 };
 
+/*  where a pixel is moved only depends on this and its position, so
+ *  the preview shows the same result as the filter
+ */
+static guint32 spread_seed;
+
 /***** Functions *****/
 
 MAIN ()
@@ -123,6 +128,8 @@ run (const gchar      *name,
   image_ID = param[1].data.d_image;
   drawable = gimp_drawable_get (param[2].data.d_drawable);
 
+  spread_seed = g_random_int ();
+
   /*  set the tile cache size  */
   gimp_tile_cache_ntiles (TILE_CACHE_SIZE);
 
@@ -203,7 +210,7 @@ run (const gchar      *name,
 typedef struct
 {
   GimpPixelFetcher *pft;
-  GRand            *gr;
+  guint32           seed;
   gint              x_amount;
   gint              y_amount;
   gint              width;
@@ -232,19 +239,24 @@ spread_func (gint      x,
              gint      bpp,
              gpointer  data)
 {
-  SpreadParam_t *param = (SpreadParam_t*) data;
-  gdouble        angle;
-  gint           xdist, ydist;
-  gint           xi, yi;
+  SpreadParam_t    *param = (SpreadParam_t*) data;
+  GimpRandomStream  stream;
+  gdouble           angle;
+  gint              xdist, ydist;
+  gint              xi, yi;
+
+  gimp_random_stream_init (&stream, param->seed, x, y);
 
   /* get random angle, x distance, and y distance */
   xdist = (param->x_amount > 0
-           ? g_rand_int_range (param->gr, -param->x_amount, param->x_amount)
+           ? gimp_random_stream_int_range (&stream,
+                                           -param->x_amount, param->x_amount)
            : 0);
   ydist = (param->y_amount > 0
-           ? g_rand_int_range (param->gr, -param->y_amount, param->y_amount)
+           ? gimp_random_stream_int_range (&stream,
+                                           -param->y_amount, param->y_amount)
            : 0);
-  angle = g_rand_double_range (param->gr, -G_PI, G_PI);
+  angle = gimp_random_stream_double_range (&stream, -G_PI, G_PI);
 
   xi = x + floor (sin (angle) * xdist);
   yi = y + floor (cos (angle) * ydist);
@@ -267,7 +279,7 @@ spread (GimpDrawable *drawable)
   SpreadParam_t    param;
 
   param.pft      = gimp_pixel_fetcher_new (drawable, FALSE);
-  param.gr       = g_rand_new ();
+  param.seed     = spread_seed;
   param.x_amount = (spvals.spread_amount_x + 1) / 2;
   param.y_amount = (spvals.spread_amount_y + 1) / 2;
   param.width    = drawable->width;
@@ -277,8 +289,6 @@ spread (GimpDrawable *drawable)
   iter = gimp_rgn_iterator_new (drawable, 0);
   gimp_rgn_iterator_dest (iter, spread_func, &param);
   gimp_rgn_iterator_free (iter);
-
-  g_rand_free (param.gr);
 }
 
 static void
@@ -296,7 +306,7 @@ spread_preview_update (GimpPreview *preview,
     gimp_drawable_preview_get_drawable (GIMP_DRAWABLE_PREVIEW (preview));
 
   param.pft      = gimp_pixel_fetcher_new (drawable, FALSE);
-  param.gr       = g_rand_new ();
+  param.seed     = spread_seed;
   param.x_amount = (gimp_size_entry_get_refval (GIMP_SIZE_ENTRY (size),
                                                 0) + 1) / 2;
   param.y_amount = (gimp_size_entry_get_refval (GIMP_SIZE_ENTRY (size),
@@ -322,7 +332,6 @@ spread_preview_update (GimpPreview *preview,
   gimp_preview_draw_buffer (preview, buffer, width * bpp);
 
   g_free (buffer);
-  g_rand_free (param.gr);
 }
 
 static gboolean
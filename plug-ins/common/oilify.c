@@ -29,6 +29,11 @@
 
 #include "libgimp/stdplugins-intl.h"
 
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define OILIFY_SSE2 1
+#include <emmintrin.h>
+#endif
+
 
 #define PLUG_IN_PROC          "plug-in-oilify"
 #define PLUG_IN_ENHANCED_PROC "plug-in-oilify-enhanced"
@@ -41,6 +46,8 @@
 #define MODE_RGB         0
 #define MODE_INTEN       1
 
+#define OILIFY_BAND_HEIGHT  32
+
 
 typedef struct
 {
@@ -53,6 +60,21 @@ typedef struct
   gint     mode;
 } OilifyVals;
 
+typedef struct
+{
+  const guchar *src;         /* Source pixels of the selection bounds    */
+  const guchar *inten;       /* Their intensity, NULL in MODE_RGB        */
+  const guchar *msmap;       /* Mask-size map pixels, or NULL            */
+  const guchar *emap;        /* Exponent map pixels, or NULL             */
+  guchar       *dest;
+  gint          width;
+  gint          height;
+  gint          bpp;
+  gint          msmap_bpp;
+  gint          emap_bpp;
+  gint          max_radius;
+} OilifyContext;
+
 
 /* Declare local functions.
  */
@@ -326,27 +348,53 @@ fast_powf (gfloat x, gint y)
   return value;
 }
 
+#ifdef OILIFY_SSE2
 /*
- * For each i in [0, HISTSIZE), hist[i] is the number of occurrences of the
- * value i. Return a value in [0, HISTSIZE) weighted heavily toward the
- * most frequent values in the histogram.
- *
- * Assuming that hist_max is the maximum number of occurrences for any
- * one value in the histogram, the weight given to each value i is
+ * fast_powf() of four values at once.  The multiplications are done in
+ * the same order, so the results are the same as fast_powf()'s.
+ */
+static inline __m128
+fast_powf_sse2 (__m128 x, gint y)
+{
+  __m128 value;
+  guint  y_uint = (guint) y;
+  guint  bitmask;
+
+  if (y_uint & 0x01)
+    value = x;
+  else
+    value = _mm_set1_ps (1.0);
+
+  for (bitmask = 0x02; bitmask <= y_uint; bitmask <<= 1)
+    {
+      x = _mm_mul_ps (x, x);
+
+      if (y_uint & bitmask)
+        value = _mm_mul_ps (value, x);
+    }
+
+  return value;
+}
+#endif
+
+/*
+ * For each i in [0, HISTSIZE), set weights[i] to the weight given to
+ * the value i of the histogram.  Assuming that hist_max is the maximum
+ * number of occurrences for any one value in the histogram, the weight
+ * given to each value i is
  *
  *         weight = (hist[i] / hist_max)^exponent
  *
  * (i.e. the normalized histogram frequency raised to some power)
  */
-static inline guchar
-weighted_average_value (gint hist[HISTSIZE], gfloat exponent)
+static inline void
+get_weights (const gint hist[HISTSIZE],
+             gfloat     exponent,
+             gfloat     weights[HISTSIZE])
 {
-  gint   i;
-  gint   hist_max = 1;
-  gint   exponent_int = 0;
-  gfloat sum = 0.0;
-  gfloat div = 1.0e-6;
-  gint   value;
+  gint i;
+  gint hist_max = 1;
+  gint exponent_int = 0;
 
   for (i = 0; i < HISTSIZE; i++)
     hist_max = MAX (hist_max, hist[i]);
@@ -354,18 +402,54 @@ weighted_average_value (gint hist[HISTSIZE], gfloat exponent)
   if ((exponent - floor (exponent)) < 0.001 && exponent <= 255.0)
     exponent_int = (gint) exponent;
 
+#ifdef OILIFY_SSE2
+  if (exponent_int)
+    {
+      const __m128 max = _mm_set1_ps ((gfloat) hist_max);
+
+      for (i = 0; i < HISTSIZE; i += 4)
+        {
+          __m128i h     = _mm_loadu_si128 ((const __m128i *) (hist + i));
+          __m128  ratio = _mm_div_ps (_mm_cvtepi32_ps (h), max);
+
+          _mm_storeu_ps (weights + i, fast_powf_sse2 (ratio, exponent_int));
+        }
+
+      return;
+    }
+#endif
+
   for (i = 0; i < HISTSIZE; i++)
     {
       gfloat ratio = (gfloat) hist[i] / (gfloat) hist_max;
-      gfloat weight;
 
       if (exponent_int)
-        weight = fast_powf (ratio, exponent_int);
+        weights[i] = fast_powf (ratio, exponent_int);
       else
-        weight = pow (ratio, exponent);
+        weights[i] = pow (ratio, exponent);
+    }
+}
 
-      sum += weight * (gfloat) i;
-      div += weight;
+/*
+ * For each i in [0, HISTSIZE), hist[i] is the number of occurrences of the
+ * value i. Return a value in [0, HISTSIZE) weighted heavily toward the
+ * most frequent values in the histogram, see get_weights().
+ */
+static inline guchar
+weighted_average_value (gint hist[HISTSIZE], gfloat exponent)
+{
+  gfloat weights[HISTSIZE];
+  gint   i;
+  gfloat sum = 0.0;
+  gfloat div = 1.0e-6;
+  gint   value;
+
+  get_weights (hist, exponent, weights);
+
+  for (i = 0; i < HISTSIZE; i++)
+    {
+      sum += weights[i] * (gfloat) i;
+      div += weights[i];
     }
 
   value = (gint) (sum / div);
@@ -390,27 +474,16 @@ weighted_average_color (gint    hist[HISTSIZE],
                         guchar *dest,
                         gint    bpp)
 {
+  gfloat weights[HISTSIZE];
   gint   i, b;
-  gint   hist_max = 1;
-  gint   exponent_int = 0;
   gfloat div = 1.0e-6;
   gfloat color[4] = { 0.0, 0.0, 0.0, 0.0 };
 
-  for (i = 0; i < HISTSIZE; i++)
-    hist_max = MAX (hist_max, hist[i]);
-
-  if ((exponent - floor (exponent)) < 0.001 && exponent <= 255.0)
-    exponent_int = (gint) exponent;
+  get_weights (hist, exponent, weights);
 
   for (i = 0; i < HISTSIZE; i++)
     {
-      gfloat ratio = (gfloat) hist[i] / (gfloat) hist_max;
-      gfloat weight;
-
-      if (exponent_int)
-        weight = fast_powf (ratio, exponent_int);
-      else
-        weight = pow (ratio, exponent);
+      gfloat weight = weights[i];
 
       if (hist[i] > 0)
         for (b = 0; b < bpp; b++)
@@ -432,35 +505,183 @@ weighted_average_color (gint    hist[HISTSIZE],
  * with a weighted average of the most frequently occurring
  * values in a circle of mask_size diameter centered at (x,y).
  */
+
+/*
+ * Add (sign 1) or remove (sign -1) the source pixel at (x,y) to the
+ * histograms
+ */
+static inline void
+oilify_hist_update (const OilifyContext *ctx,
+                    gint                 hist[HISTSIZE],
+                    gint                 hist_rgb[4][HISTSIZE],
+                    gint                 x,
+                    gint                 y,
+                    gint                 sign)
+{
+  const gint    offset = y * ctx->width + x;
+  const guchar *src    = ctx->src + offset * ctx->bpp;
+  gint          b;
+
+  if (ctx->inten)
+    {
+      gint inten = ctx->inten[offset];
+
+      hist[inten] += sign;
+      for (b = 0; b < ctx->bpp; b++)
+        hist_rgb[b][inten] += sign * src[b];
+    }
+  else
+    {
+      for (b = 0; b < ctx->bpp; b++)
+        hist_rgb[b][src[b]] += sign;
+    }
+}
+
+/*
+ * Oilify the rows [y_start, y_end).  The histograms of the circle are
+ * built once at the start of each row and then moved along the row,
+ * removing the leftmost pixel and adding a new rightmost pixel on each
+ * line of the circle.  They are only built again where the mask-size
+ * map changes the radius.
+ */
+static void
+oilify_band (OilifyContext *ctx,
+             gint           y_start,
+             gint           y_end)
+{
+  const gint  width  = ctx->width;
+  const gint  height = ctx->height;
+  const gint  bpp    = ctx->bpp;
+  gint        hist[HISTSIZE];
+  gint        hist_rgb[4][HISTSIZE];
+  gint       *half_width;
+  gint        y;
+
+  /*  For each line dy of the circle, the largest dx inside the circle  */
+  half_width = g_new (gint, 2 * ctx->max_radius + 1);
+
+  for (y = y_start; y < y_end; y++)
+    {
+      guchar *dest        = ctx->dest + y * width * bpp;
+      gint    hist_radius = -1;
+      gint    x;
+
+      for (x = 0; x < width; x++, dest += bpp)
+        {
+          gint   radius;
+          gfloat exponent;
+          gint   dy;
+
+          if (ctx->msmap)
+            {
+              gfloat factor = get_map_value (ctx->msmap +
+                                             (y * width + x) * ctx->msmap_bpp,
+                                             ctx->msmap_bpp);
+
+              radius = ROUND (factor * (0.5 * ovals.mask_size));
+            }
+          else
+            {
+              radius = (gint) ovals.mask_size / 2;
+            }
+
+          exponent = ovals.exponent;
+          if (ctx->emap)
+            exponent *= get_map_value (ctx->emap +
+                                       (y * width + x) * ctx->emap_bpp,
+                                       ctx->emap_bpp);
+
+          if (radius == hist_radius)
+            {
+              /*  Move the circle one pixel to the right  */
+              for (dy = MAX (-radius, -y); dy <= MIN (radius, height - 1 - y); dy++)
+                {
+                  const gint dx = half_width[dy + radius];
+
+                  if (x - 1 - dx >= 0)
+                    oilify_hist_update (ctx, hist, hist_rgb,
+                                        x - 1 - dx, y + dy, -1);
+
+                  if (x + dx < width)
+                    oilify_hist_update (ctx, hist, hist_rgb,
+                                        x + dx, y + dy, 1);
+                }
+            }
+          else
+            {
+              if (ctx->inten)
+                memset (hist, 0, sizeof (hist));
+
+              memset (hist_rgb, 0, sizeof (hist_rgb));
+
+              for (dy = -radius; dy <= radius; dy++)
+                {
+                  gint dx = radius;
+
+                  /*  Stay inside a circular mask area  */
+                  while (SQR (dx) + SQR (dy) > SQR (radius))
+                    dx--;
+
+                  half_width[dy + radius] = dx;
+                }
+
+              for (dy = MAX (-radius, -y); dy <= MIN (radius, height - 1 - y); dy++)
+                {
+                  const gint dx      = half_width[dy + radius];
+                  const gint mask_x2 = MIN (x + dx, width - 1);
+                  gint       mask_x;
+
+                  for (mask_x = MAX (x - dx, 0); mask_x <= mask_x2; mask_x++)
+                    oilify_hist_update (ctx, hist, hist_rgb,
+                                        mask_x, y + dy, 1);
+                }
+
+              hist_radius = radius;
+            }
+
+          if (ctx->inten)
+            {
+              weighted_average_color (hist, hist_rgb, exponent, dest, bpp);
+            }
+          else
+            {
+              gint b;
+
+              for (b = 0; b < bpp; b++)
+                dest[b] = weighted_average_value (hist_rgb[b], exponent);
+            }
+        }
+    }
+
+  g_free (half_width);
+}
+
+/*  Oilify a band, called by gimp_parallel_run()  */
+static void
+oilify_band_func (gint           band,
+                  gint           n_bands,
+                  gint           thread,
+                  OilifyContext *ctx)
+{
+  gint y_start = band * OILIFY_BAND_HEIGHT;
+  gint y_end   = MIN (y_start + OILIFY_BAND_HEIGHT, ctx->height);
+
+  oilify_band (ctx, y_start, y_end);
+}
+
 static void
 oilify (GimpDrawable *drawable,
         GimpPreview  *preview)
 {
-  gboolean      use_inten;
-  gboolean      use_msmap = FALSE;
-  gboolean      use_emap = FALSE;
-  GimpDrawable *mask_size_map_drawable = NULL;
-  GimpDrawable *exponent_map_drawable = NULL;
-  GimpPixelRgn  mask_size_map_rgn;
-  GimpPixelRgn  exponent_map_rgn;
-  gint          msmap_bpp = 0;
-  gint          emap_bpp = 0;
-  GimpPixelRgn  dest_rgn;
-  GimpPixelRgn *regions[3];
-  gint          n_regions;
-  gint          bpp;
-  gint         *sqr_lut;
-  gint          x1, y1, x2, y2;
-  gint          width, height;
-  gint          Hist[HISTSIZE];
-  gint          Hist_rgb[4][HISTSIZE];
-  gpointer      pr;
-  gint          progress, max_progress;
-  guchar       *src_buf;
-  guchar       *src_inten_buf = NULL;
-  gint          i;
-
-  use_inten = (ovals.mode == MODE_INTEN);
+  OilifyContext  ctx      = { 0, };
+  GimpDrawable  *mask_size_map_drawable = NULL;
+  GimpDrawable  *exponent_map_drawable = NULL;
+  GimpPixelRgn   src_rgn;
+  GimpPixelRgn   dest_rgn;
+  gint           x1, y1, x2, y2;
+  gint           width, height;
+  gint           bpp;
+  gint           i;
 
   /*  Get the selection bounds  */
   if (preview)
@@ -478,58 +699,59 @@ oilify (GimpDrawable *drawable,
       height = y2 - y1;
     }
 
-  progress = 0;
-  max_progress = width * height;
-
   bpp = drawable->bpp;
 
-  /*
-   * Look-up-table implementation of the square function, for use in the
-   * VERY TIGHT inner loops
-   */
-  {
-    gint lut_size = (gint) ovals.mask_size / 2 + 1;
-
-    sqr_lut = g_new (gint, lut_size);
-
-    for (i = 0; i < lut_size; i++)
-      sqr_lut[i] = SQR (i);
-  }
+  ctx.width      = width;
+  ctx.height     = height;
+  ctx.bpp        = bpp;
+  ctx.max_radius = MAX ((gint) ovals.mask_size / 2,
+                        ROUND (0.5 * ovals.mask_size));
 
   /*  Get the map drawables, if applicable  */
 
   if (ovals.use_mask_size_map && ovals.mask_size_map >= 0)
     {
-      use_msmap = TRUE;
+      GimpPixelRgn  mask_size_map_rgn;
+      guchar       *msmap;
 
       mask_size_map_drawable = gimp_drawable_get (ovals.mask_size_map);
       gimp_pixel_rgn_init (&mask_size_map_rgn, mask_size_map_drawable,
                            x1, y1, width, height, FALSE, FALSE);
 
-      msmap_bpp = mask_size_map_drawable->bpp;
+      ctx.msmap_bpp = mask_size_map_drawable->bpp;
+
+      msmap = g_new (guchar, width * height * ctx.msmap_bpp);
+      gimp_pixel_rgn_get_rect (&mask_size_map_rgn, msmap,
+                               x1, y1, width, height);
+      ctx.msmap = msmap;
     }
 
   if (ovals.use_exponent_map && ovals.exponent_map >= 0)
     {
-      use_emap = TRUE;
+      GimpPixelRgn  exponent_map_rgn;
+      guchar       *emap;
 
       exponent_map_drawable = gimp_drawable_get (ovals.exponent_map);
       gimp_pixel_rgn_init (&exponent_map_rgn, exponent_map_drawable,
                            x1, y1, width, height, FALSE, FALSE);
 
-      emap_bpp = exponent_map_drawable->bpp;
-    }
+      ctx.emap_bpp = exponent_map_drawable->bpp;
 
-  gimp_pixel_rgn_init (&dest_rgn, drawable,
-                       x1, y1, width, height, (preview == NULL), TRUE);
+      emap = g_new (guchar, width * height * ctx.emap_bpp);
+      gimp_pixel_rgn_get_rect (&exponent_map_rgn, emap,
+                               x1, y1, width, height);
+      ctx.emap = emap;
+    }
 
   {
-    GimpPixelRgn src_rgn;
+    guchar *src_buf;
 
     gimp_pixel_rgn_init (&src_rgn, drawable,
                          x1, y1, width, height, FALSE, FALSE);
     src_buf = g_new (guchar, width * height * bpp);
     gimp_pixel_rgn_get_rect (&src_rgn, src_buf, x1, y1, width, height);
+
+    ctx.src = src_buf;
   }
 
   /*
@@ -537,15 +759,16 @@ oilify (GimpDrawable *drawable,
    * map of the source image. This way, we can avoid calculating the
    * intensity of any given source pixel more than once.
    */
-  if (use_inten)
+  if (ovals.mode == MODE_INTEN)
     {
-      guchar *src;
-      guchar *dest;
+      const guchar *src;
+      guchar       *dest;
+      guchar       *src_inten_buf;
 
       src_inten_buf = g_new (guchar, width * height);
 
       for (i = 0,
-           src = src_buf,
+           src = ctx.src,
            dest = src_inten_buf
            ;
            i < (width * height)
@@ -556,165 +779,25 @@ oilify (GimpDrawable *drawable,
         {
           *dest = (guchar) GIMP_RGB_LUMINANCE (src[0], src[1], src[2]);
         }
-    }
-
-  n_regions = 0;
-  regions[n_regions++] = &dest_rgn;
-  if (use_msmap)
-    regions[n_regions++] = &mask_size_map_rgn;
-  if (use_emap)
-    regions[n_regions++] = &exponent_map_rgn;
-
-  for (pr = gimp_pixel_rgns_register2 (n_regions, regions);
-       pr != NULL;
-       pr = gimp_pixel_rgns_process (pr))
-    {
-      gint    y;
-      guchar *dest_row;
-      guchar *src_msmap_row = NULL;
-      guchar *src_emap_row = NULL;
-
-      for (y = dest_rgn.y,
-           dest_row = dest_rgn.data,
-           src_msmap_row = mask_size_map_rgn.data,  /* valid iff use_msmap */
-           src_emap_row = exponent_map_rgn.data     /* valid iff use_emap */
-           ;
-           y < (gint) (dest_rgn.y + dest_rgn.h)
-           ;
-           y++,
-           dest_row += dest_rgn.rowstride,
-           src_msmap_row += mask_size_map_rgn.rowstride,  /* valid iff use_msmap */
-           src_emap_row += exponent_map_rgn.rowstride)    /* valid iff use_emap */
-        {
-          gint    x;
-          guchar *dest;
-          guchar *src_msmap = NULL;
-          guchar *src_emap = NULL;
-
-          for (x = dest_rgn.x,
-               dest = dest_row,
-               src_msmap = src_msmap_row,  /* valid iff use_msmap */
-               src_emap = src_emap_row     /* valid iff use_emap */
-               ;
-               x < (gint) (dest_rgn.x + dest_rgn.w)
-               ;
-               x++,
-               dest += bpp,
-               src_msmap += msmap_bpp,  /* valid iff use_msmap */
-               src_emap += emap_bpp)    /* valid iff use_emap */
-            {
-              gint    radius, radius_squared;
-              gfloat  exponent;
-              gint    mask_x1, mask_y1;
-              gint    mask_x2, mask_y2;
-              gint    mask_y;
-              gint    src_offset;
-              guchar *src_row;
-              guchar *src_inten_row = NULL;
-
-              if (use_msmap)
-                {
-                  gfloat factor = get_map_value (src_msmap, msmap_bpp);
-
-                  radius = ROUND (factor * (0.5 * ovals.mask_size));
-                }
-              else
-                {
-                  radius = (gint) ovals.mask_size / 2;
-                }
-
-              radius_squared = SQR (radius);
 
-              exponent = ovals.exponent;
-              if (use_emap)
-                exponent *= get_map_value (src_emap, emap_bpp);
-
-              if (use_inten)
-                memset (Hist, 0, sizeof (Hist));
-
-              memset (Hist_rgb, 0, sizeof (Hist_rgb));
-
-              mask_x1 = CLAMP ((x - radius), x1, x2);
-              mask_y1 = CLAMP ((y - radius), y1, y2);
-              mask_x2 = CLAMP ((x + radius + 1), x1, x2);
-              mask_y2 = CLAMP ((y + radius + 1), y1, y2);
-
-              src_offset = (mask_y1 - y1) * width + (mask_x1 - x1);
-
-              for (mask_y = mask_y1,
-                   src_row = src_buf + src_offset * bpp,
-                   src_inten_row = src_inten_buf + src_offset  /* valid iff use_inten */
-                   ;
-                   mask_y < mask_y2
-                   ;
-                   mask_y++,
-                   src_row += width * bpp,
-                   src_inten_row += width)  /* valid iff use_inten */
-                {
-                  guchar *src;
-                  guchar *src_inten = NULL;
-                  gint    dy_squared = sqr_lut[ABS (mask_y - y)];
-                  gint    mask_x;
-
-                  for (mask_x = mask_x1,
-                       src = src_row,
-                       src_inten = src_inten_row  /* valid iff use_inten */
-                       ;
-                       mask_x < mask_x2
-                       ;
-                       mask_x++,
-                       src += bpp,
-                       src_inten++)  /* valid iff use_inten */
-                    {
-                      gint dx_squared = sqr_lut[ABS (mask_x - x)];
-                      gint b;
-
-                      /*  Stay inside a circular mask area  */
-                      if ((dx_squared + dy_squared) > radius_squared)
-                        continue;
-
-                      if (use_inten)
-                        {
-                          gint inten = *src_inten;
-                          ++Hist[inten];
-                          for (b = 0; b < bpp; b++)
-                            Hist_rgb[b][inten] += src[b];
-                        }
-                      else
-                        {
-                          for (b = 0; b < bpp; b++)
-                            ++Hist_rgb[b][src[b]];
-                        }
-
-                    } /* for mask_x */
-                } /* for mask_y */
-
-              if (use_inten)
-                {
-                  weighted_average_color (Hist, Hist_rgb, exponent, dest, bpp);
-                }
-              else
-                {
-                  gint b;
+      ctx.inten = src_inten_buf;
+    }
 
-                  for (b = 0; b < bpp; b++)
-                    dest[b] = weighted_average_value (Hist_rgb[b], exponent);
-                }
+  ctx.dest = g_new (guchar, width * height * bpp);
 
-            } /* for x */
-        } /* for y */
+  gimp_parallel_run ((height + OILIFY_BAND_HEIGHT - 1) / OILIFY_BAND_HEIGHT,
+                     (GimpParallelFunc) oilify_band_func, &ctx, ! preview);
 
-      if (preview)
-        {
-          gimp_drawable_preview_draw_region (GIMP_DRAWABLE_PREVIEW (preview),
-                                             &dest_rgn);
-        }
-      else
-        {
-          progress += dest_rgn.w * dest_rgn.h;
-          gimp_progress_update ((gdouble) progress / (gdouble) max_progress);
-        }
-    } /* for pr */
+  if (preview)
+    {
+      gimp_preview_draw_buffer (preview, ctx.dest, width * bpp);
+    }
+  else
+    {
+      gimp_pixel_rgn_init (&dest_rgn, drawable,
+                           x1, y1, width, height, TRUE, TRUE);
+      gimp_pixel_rgn_set_rect (&dest_rgn, ctx.dest, x1, y1, width, height);
+    }
 
   /*  Detach from the map drawables  */
   if (mask_size_map_drawable)
@@ -723,11 +806,11 @@ oilify (GimpDrawable *drawable,
   if (exponent_map_drawable)
     gimp_drawable_detach (exponent_map_drawable);
 
-  if (src_inten_buf)
-    g_free (src_inten_buf);
-
-  g_free (src_buf);
-  g_free (sqr_lut);
+  g_free ((guchar *) ctx.msmap);
+  g_free ((guchar *) ctx.emap);
+  g_free ((guchar *) ctx.inten);
+  g_free ((guchar *) ctx.src);
+  g_free (ctx.dest);
 
   if (!preview)
     {
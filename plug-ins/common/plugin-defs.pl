@@ -51,7 +51,6 @@
     'file-desktop-link' => {},
     'file-dicom' => { ui => 1, cflags => '-fno-strict-aliasing' },
     'file-gbr' => { ui => 1 },
-    'file-gegl' => { ui => 1, gegl => 1 },
     'file-gif-load' => {},
     'file-gif-save' => { ui => 1 },
     'file-gih' => { ui => 1 },
@@ -63,7 +62,7 @@
     'file-pat' => { ui => 1, gegl => 1 },
     'file-pcx' => { ui => 1 },
     'file-pix' => { ui => 1 },
-    'file-png' => { ui => 1, gegl => 1, optional => 1, libs => 'PNG_LIBS', cflags => 'PNG_CFLAGS' },
+    'file-png' => { ui => 1, gegl => 1, optional => 1, libs => 'PNG_LIBS', libdep => 'z', cflags => 'PNG_CFLAGS' },
     'file-pnm' => { ui => 1 },
     'file-pdf-load' => { ui => 1, optional => 1, libs => 'POPPLER_LIBS', cflags => 'POPPLER_CFLAGS' },
     'file-pdf-save' => { ui => 1, optional => 1, libs => 'CAIRO_PDF_LIBS', cflags => 'CAIRO_PDF_CFLAGS' },
@@ -74,7 +73,7 @@
     'file-svg' => { ui => 1, optional => 1, libs => 'SVG_LIBS', cflags => 'SVG_CFLAGS' },
     'file-tga' => { ui => 1 },
     'file-tiff-load' => { ui => 1, gegl => 1, optional => 1, libs => 'TIFF_LIBS' },
-    'file-tiff-save' => { ui => 1, optional => 1, libs => 'TIFF_LIBS' },
+    'file-tiff-save' => { ui => 1, optional => 1, libs => 'TIFF_LIBS', libdep => 'z' },
     'file-wmf' => { ui => 1, optional => 1, libs => 'WMF_LIBS', cflags => 'WMF_CFLAGS' },
     'file-xbm' => { ui => 1 },
     'file-xmc' => { ui => 1, optional => 1, libs => 'XMC_LIBS' },
@@ -250,21 +250,24 @@ typedef struct
   gint              width;
   gint              height;
   gboolean          has_alpha;
+  gint             *coords;
+  guchar           *pixels;
+  gdouble          *frac;
 } RippleParam_t;
 
+/*  Finds the two source pixels of the pixel at (x, y) and the weight of
+ *  the second one. Source pixels outside the image are black.
+ */
 static void
-ripple_vertical (gint      x,
-                 gint      y,
-                 guchar   *dest,
-                 gint      bpp,
-                 gpointer  data)
+ripple_vertical (gint           x,
+                 gint           y,
+                 gint          *coords,
+                 gdouble       *frac,
+                 RippleParam_t *param)
 {
-  RippleParam_t    *param  = data;
-  GimpPixelFetcher *pft    = param->pft;
-  const gint        height = param->height;
-  guchar            pixel[2][4];
-  gdouble           needy;
-  gint              yi, yi_a;
+  const gint height = param->height;
+  gdouble    needy;
+  gint       yi, yi_a;
 
   needy = y + displace_amount (x);
   yi = floor (needy);
@@ -295,42 +298,24 @@ ripple_vertical (gint      x,
       yi_a  = CLAMP (yi_a,  0, height - 1);
     }
 
-  if (rvals.antialias)
-    {
-      if (yi >= 0 && yi < height)
-        gimp_pixel_fetcher_get_pixel (pft, x, yi  , pixel[0]);
-      else
-        memset (pixel[0], 0, 4);
-
-      if (yi_a >= 0 && yi_a < height)
-        gimp_pixel_fetcher_get_pixel (pft, x, yi_a, pixel[1]);
-      else
-        memset (pixel[1], 0, 4);
+  coords[0] = x;
+  coords[1] = yi;
+  coords[2] = x;
+  coords[3] = yi_a;
 
-      average_two_pixels (dest, pixel, needy - yi, bpp, param->has_alpha);
-    }
-  else
-    {
-      if (yi >= 0 && yi < height)
-        gimp_pixel_fetcher_get_pixel (pft, x, yi, dest);
-      else
-        memset (dest, 0, bpp);
-    }
+  *frac = needy - yi;
 }
 
 static void
-ripple_horizontal (gint      x,
-                   gint      y,
-                   guchar   *dest,
-                   gint      bpp,
-                   gpointer  data)
+ripple_horizontal (gint           x,
+                   gint           y,
+                   gint          *coords,
+                   gdouble       *frac,
+                   RippleParam_t *param)
 {
-  RippleParam_t    *param = data;
-  GimpPixelFetcher *pft   = param->pft;
-  const gint        width = param->width;
-  guchar            pixel[2][4];
-  gdouble           needx;
-  gint              xi, xi_a;
+  const gint width = param->width;
+  gdouble    needx;
+  gint       xi, xi_a;
 
   needx = x + displace_amount (y);
   xi = floor (needx);
@@ -361,27 +346,60 @@ ripple_horizontal (gint      x,
       xi_a  = CLAMP (xi_a,  0, width - 1);
     }
 
-  if (rvals.antialias)
+  coords[0] = xi;
+  coords[1] = y;
+  coords[2] = xi_a;
+  coords[3] = y;
+
+  *frac = needx - xi;
+}
+
+/*  Renders width pixels of row y starting at x1. The source pixels of
+ *  the whole row are fetched in one go.
+ */
+static void
+ripple_row (RippleParam_t *param,
+            gint           x1,
+            gint           y,
+            gint           width,
+            guchar        *dest,
+            gint           bpp)
+{
+  const gint n_coords = rvals.antialias ? 2 : 1;
+  gint       x;
+
+  for (x = 0; x < width; x++)
     {
-      if (xi >= 0 && xi < width)
-        gimp_pixel_fetcher_get_pixel (pft, xi,   y, pixel[0]);
-      else
-        memset (pixel[0], 0, 4);
+      gint coords[4];
 
-      if (xi_a >= 0 && xi_a < width)
-        gimp_pixel_fetcher_get_pixel (pft, xi_a, y, pixel[1]);
+      if (rvals.orientation == GIMP_ORIENTATION_VERTICAL)
+        ripple_vertical (x1 + x, y, coords, &param->frac[x], param);
       else
-        memset (pixel[1], 0, 4);
+        ripple_horizontal (x1 + x, y, coords, &param->frac[x], param);
 
-      average_two_pixels (dest, pixel, needx - xi, bpp, param->has_alpha);
+      memcpy (param->coords + x * n_coords * 2, coords,
+              n_coords * 2 * sizeof (gint));
     }
 
+  gimp_pixel_fetcher_get_pixels (param->pft, width * n_coords,
+                                 param->coords, param->pixels);
+
+  if (rvals.antialias)
+    {
+      for (x = 0; x < width; x++)
+        {
+          guchar pixel[2][4];
+
+          memcpy (pixel[0], param->pixels + (x * 2) * bpp,     bpp);
+          memcpy (pixel[1], param->pixels + (x * 2 + 1) * bpp, bpp);
+
+          average_two_pixels (dest + x * bpp, pixel, param->frac[x],
+                              bpp, param->has_alpha);
+        }
+    }
   else
     {
-      if (xi >= 0 && xi < width)
-        gimp_pixel_fetcher_get_pixel (pft, xi, y, dest);
-      else
-        memset (dest, 0, bpp);
+      memcpy (dest, param->pixels, width * bpp);
     }
 }
 
@@ -392,12 +410,16 @@ ripple (GimpDrawable *drawable,
   RippleParam_t param;
   gint          edges;
   gint          period;
+  gint          bpp = gimp_drawable_bpp (drawable->drawable_id);
 
   param.pft       = gimp_pixel_fetcher_new (drawable, FALSE);
   param.has_alpha = gimp_drawable_has_alpha (drawable->drawable_id);
   param.width     = drawable->width;
   param.height    = drawable->height;
 
+  /*  source pixels outside the image are black  */
+  gimp_pixel_fetcher_set_edge_mode (param.pft, GIMP_PIXEL_FETCHER_EDGE_BLACK);
+
   edges  = rvals.edges;
   period = rvals.period;
 
@@ -412,49 +434,76 @@ ripple (GimpDrawable *drawable,
 
   if (preview)
     {
-      guchar *buffer, *d;
-      gint    bpp = gimp_drawable_bpp (drawable->drawable_id);
+      guchar *buffer;
       gint    width, height;
-      gint    x, y;
+      gint    y;
       gint    x1, y1;
 
       gimp_preview_get_position (preview, &x1, &y1);
       gimp_preview_get_size (preview, &width, &height);
 
-      d = buffer = g_new (guchar, width * height * bpp);
+      buffer = g_new0 (guchar, width * height * bpp);
 
-      for (y = 0; y < height ; y++)
-        for (x = 0; x < width ; x++)
-          {
-            if (rvals.orientation == GIMP_ORIENTATION_VERTICAL)
-              ripple_vertical (x1 + x, y1 + y, d, bpp, &param);
-            else
-              ripple_horizontal (x1 + x, y1 + y, d, bpp, &param);
+      param.coords = g_new (gint, width * 4);
+      param.pixels = g_new (guchar, width * 2 * bpp);
+      param.frac   = g_new (gdouble, width);
 
-            d += bpp;
-          }
+      for (y = 0; y < height ; y++)
+        ripple_row (&param, x1, y1 + y, width, buffer + y * width * bpp, bpp);
 
       gimp_preview_draw_buffer (preview, buffer, width * bpp);
       g_free (buffer);
     }
   else
     {
-      GimpRgnIterator *iter;
+      GimpPixelRgn  dest_rgn;
+      guchar       *row;
+      gint          x1, y1, width, height;
+      gint          y;
+
+      if (gimp_drawable_mask_intersect (drawable->drawable_id,
+                                        &x1, &y1, &width, &height))
+        {
+          gimp_pixel_rgn_init (&dest_rgn, drawable,
+                               x1, y1, width, height, TRUE, TRUE);
 
-      iter = gimp_rgn_iterator_new (drawable, 0);
+          row = g_new0 (guchar, width * bpp);
 
-      gimp_rgn_iterator_dest (iter,
-                              rvals.orientation == GIMP_ORIENTATION_VERTICAL ?
-                              ripple_vertical :
-                              ripple_horizontal,
-                              &param);
+          param.coords = g_new (gint, width * 4);
+          param.pixels = g_new (guchar, width * 2 * bpp);
+          param.frac   = g_new (gdouble, width);
 
-      gimp_rgn_iterator_free (iter);
+          for (y = 0; y < height; y++)
+            {
+              ripple_row (&param, x1, y1 + y, width, row, bpp);
+
+              gimp_pixel_rgn_set_row (&dest_rgn, row, x1, y1 + y, width);
+
+              if (y % 16 == 0)
+                gimp_progress_update ((gdouble) y / height);
+            }
+
+          g_free (row);
+
+          gimp_drawable_flush (drawable);
+          gimp_drawable_merge_shadow (drawable->drawable_id, TRUE);
+          gimp_drawable_update (drawable->drawable_id, x1, y1, width, height);
+        }
+      else
+        {
+          param.coords = NULL;
+          param.pixels = NULL;
+          param.frac   = NULL;
+        }
     }
 
   rvals.edges  = edges;
   rvals.period = period;
 
+  g_free (param.coords);
+  g_free (param.pixels);
+  g_free (param.frac);
+
   gimp_pixel_fetcher_destroy (param.pft);
 }
 
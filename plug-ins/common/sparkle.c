@@ -89,21 +89,21 @@ static gint      compute_lum_threshold (GimpDrawable *drawable,
                                         gdouble       percentile);
 static void      sparkle               (GimpDrawable *drawable,
                                         GimpPreview  *preview);
-static void      fspike                (GimpPixelRgn *src_rgn,
-                                        GimpPixelRgn *dest_rgn,
-                                        gint          x1,
-                                        gint          y1,
-                                        gint          x2,
-                                        gint          y2,
-                                        gint          xr,
-                                        gint          yr,
-                                        gint          tile_width,
-                                        gint          tile_height,
-                                        gdouble       inten,
-                                        gdouble       length,
-                                        gdouble       angle,
-                                        GRand        *gr,
-                                        guchar       *dest_buf);
+static void      fspike                (GimpPixelRgn     *src_rgn,
+                                        GimpPixelRgn     *dest_rgn,
+                                        gint              x1,
+                                        gint              y1,
+                                        gint              x2,
+                                        gint              y2,
+                                        gint              xr,
+                                        gint              yr,
+                                        gint              tile_width,
+                                        gint              tile_height,
+                                        gdouble           inten,
+                                        gdouble           length,
+                                        gdouble           angle,
+                                        GimpRandomStream *stream,
+                                        guchar           *dest_buf);
 static GimpTile * rpnt                 (GimpDrawable *drawable,
                                         GimpTile     *tile,
                                         gint          x1,
@@ -148,6 +148,11 @@ static SparkleVals svals =
 
 static gint num_sparkles;
 
+/*  the sparkles only depend on this seed and their position, so the
+ *  preview shows the same ones as the result
+ */
+static guint32 sparkle_seed;
+
 
 MAIN ()
 
@@ -218,6 +223,8 @@ run (const gchar      *name,
 
   /*  Get the specified drawable  */
   drawable = gimp_drawable_get (param[2].data.d_drawable);
+
+  sparkle_seed = g_random_int ();
   if (! gimp_drawable_mask_intersect (drawable->drawable_id, &x, &y, &w, &h))
     {
       g_message (_("Region selected for filter is empty"));
@@ -699,11 +706,8 @@ sparkle (GimpDrawable *drawable,
   gint         bytes;
   gpointer     pr;
   gint         tile_width, tile_height;
-  GRand       *gr;
   guchar      *dest_buf = NULL;
 
-  gr = g_rand_new ();
-
   bytes = drawable->bpp;
 
   if (preview)
@@ -837,6 +841,11 @@ sparkle (GimpDrawable *drawable,
 
               if (lum >= threshold)
                 {
+                  GimpRandomStream stream;
+
+                  gimp_random_stream_init (&stream, sparkle_seed,
+                                           x + src_rgn.x, y + src_rgn.y);
+
                   nfrac = fabs ((gdouble) (lum + 1 - threshold) /
                                 (gdouble) (256 - threshold));
                   length = ((gdouble) svals.spike_len *
@@ -848,16 +857,18 @@ sparkle (GimpDrawable *drawable,
                     {
                       /* major spikes */
                       if (svals.spike_angle == -1)
-                        spike_angle = g_rand_double_range (gr, 0, 360.0);
+                        spike_angle = gimp_random_stream_double_range (&stream,
+                                                                       0, 360.0);
                       else
                         spike_angle = svals.spike_angle;
 
-                      if (g_rand_double (gr) <= svals.density)
+                      if (gimp_random_stream_double (&stream) <= svals.density)
                         {
                           fspike (&src_rgn, &dest_rgn, x1, y1, x2, y2,
                                   x + src_rgn.x, y + src_rgn.y,
                                   tile_width, tile_height,
-                                  inten, length, spike_angle, gr, dest_buf);
+                                  inten, length, spike_angle,
+                                  &stream, dest_buf);
 
                           /* minor spikes */
                           fspike (&src_rgn, &dest_rgn, x1, y1, x2, y2,
@@ -865,7 +876,7 @@ sparkle (GimpDrawable *drawable,
                                   tile_width, tile_height,
                                   inten * 0.7, length * 0.7,
                                   ((gdouble)spike_angle+180.0/svals.spike_pts),
-                                  gr, dest_buf);
+                                  &stream, dest_buf);
                         }
                     }
                   if (!preview)
@@ -898,8 +909,6 @@ sparkle (GimpDrawable *drawable,
       gimp_drawable_merge_shadow (drawable->drawable_id, TRUE);
       gimp_drawable_update (drawable->drawable_id, x1, y1, width, height);
     }
-
-  g_rand_free (gr);
 }
 
 static inline GimpTile *
@@ -997,21 +1006,21 @@ rpnt (GimpDrawable *drawable,
 }
 
 static void
-fspike (GimpPixelRgn *src_rgn,
-        GimpPixelRgn *dest_rgn,
-        gint          x1,
-        gint          y1,
-        gint          x2,
-        gint          y2,
-        gint          xr,
-        gint          yr,
-        gint          tile_width,
-        gint          tile_height,
-        gdouble       inten,
-        gdouble       length,
-        gdouble       angle,
-        GRand        *gr,
-        guchar       *dest_buf)
+fspike (GimpPixelRgn     *src_rgn,
+        GimpPixelRgn     *dest_rgn,
+        gint              x1,
+        gint              y1,
+        gint              x2,
+        gint              y2,
+        gint              xr,
+        gint              yr,
+        gint              tile_width,
+        gint              tile_height,
+        gdouble           inten,
+        gdouble           length,
+        gdouble           angle,
+        GimpRandomStream *stream,
+        guchar           *dest_buf)
 {
   const gdouble  efac = 2.0;
   gdouble        xrt, yrt, dx, dy;
@@ -1088,7 +1097,7 @@ fspike (GimpPixelRgn *src_rgn,
 
           gimp_rgb_to_hsv_int (&r, &g, &b);
 
-          r += svals.random_hue * g_rand_double_range (gr, -0.5, 0.5) * 255;
+          r += svals.random_hue * gimp_random_stream_double_range (stream, -0.5, 0.5) * 255;
 
           if (r >= 255)
             r -= 255;
@@ -1096,7 +1105,7 @@ fspike (GimpPixelRgn *src_rgn,
             r += 255;
 
           b += (svals.random_saturation *
-                g_rand_double_range (gr, -1.0, 1.0)) * 255;
+                gimp_random_stream_double_range (stream, -1.0, 1.0)) * 255;
 
           if (b > 255)
             b = 255;
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
@@ -34,6 +35,9 @@
 #define SCALE_WIDTH   120
 #define ENTRY_WIDTH     5
 
+#define UNSHARP_STRIP_SIZE   64  /* lines per strip, one tile           */
+#define UNSHARP_BLOCK_SIZE   16  /* pixels per side of a transpose block */
+
 /* Uncomment this line to get a rough estimate of how long the plug-in
  * takes to run.
  */
@@ -53,6 +57,23 @@ typedef struct
   gboolean  run;
 } UnsharpMaskInterface;
 
+typedef struct
+{
+  gboolean  box_blur;        /* three pass box blur instead of a gaussian */
+  gint      box_width;
+  gdouble  *cmatrix;         /* convolution matrix, for the gaussian      */
+  gint      cmatrix_length;
+} UnsharpBlur;
+
+typedef struct
+{
+  const UnsharpBlur *blur;
+  guchar            *lines;
+  gint               n_lines;
+  gint               len;
+  gint               bpp;
+} UnsharpJob;
+
 /* local function prototypes */
 static void      query (void);
 static void      run   (const gchar      *name,
@@ -549,9 +570,129 @@ unsharp_mask (GimpDrawable *drawable,
   gimp_drawable_update (drawable->drawable_id, x1, y1, x2 - x1, y2 - y1);
 }
 
+/* Blurs the job'th share of the lines in place, with its own scratch
+ * line.
+ */
+static void
+unsharp_job_func (gint        job,
+                  gint        n_jobs,
+                  gint        thread,
+                  UnsharpJob *lines)
+{
+  const UnsharpBlur *blur  = lines->blur;
+  const gint         len   = lines->len;
+  const gint         bpp   = lines->bpp;
+  const gint         first = (gint64) lines->n_lines * job / n_jobs;
+  const gint         last  = (gint64) lines->n_lines * (job + 1) / n_jobs;
+  guchar            *tmp   = g_new (guchar, len * bpp);
+  gint               i;
+
+  for (i = first; i < last; i++)
+    {
+      guchar *line = lines->lines + i * len * bpp;
+
+      if (blur->box_blur)
+        {
+          /* Odd-width box blur: repeat 3 times, centered on output pixel.
+           * Swap back and forth between the buffers. */
+          if (blur->box_width % 2)
+            {
+              box_blur_line (blur->box_width, 0, line, tmp, len, bpp);
+              box_blur_line (blur->box_width, 0, tmp, line, len, bpp);
+              box_blur_line (blur->box_width, 0, line, tmp, len, bpp);
+            }
+          /* Even-width box blur:
+           * This method is suggested by the specification for SVG.
+           * One pass with width n, centered between output and right pixel
+           * One pass with width n, centered between output and left pixel
+           * One pass with width n+1, centered on output pixel
+           * Swap back and forth between buffers.
+           */
+          else
+            {
+              box_blur_line (blur->box_width,  -1, line, tmp, len, bpp);
+              box_blur_line (blur->box_width,   1, tmp, line, len, bpp);
+              box_blur_line (blur->box_width+1, 0, line, tmp, len, bpp);
+            }
+        }
+      else
+        {
+          /* Gaussian blur */
+          gaussian_blur_line (blur->cmatrix, blur->cmatrix_length,
+                              line, tmp, len, bpp);
+        }
+
+      memcpy (line, tmp, len * bpp);
+    }
+
+  g_free (tmp);
+}
+
+/* Blurs 'n_lines' contiguous lines of 'len' pixels in place, spread
+ * over the available processors.
+ */
+static void
+unsharp_blur_lines (const UnsharpBlur *blur,
+                    guchar            *lines,
+                    gint               n_lines,
+                    gint               len,
+                    gint               bpp)
+{
+  UnsharpJob job;
+
+  job.blur    = blur;
+  job.lines   = lines;
+  job.n_lines = n_lines;
+  job.len     = len;
+  job.bpp     = bpp;
+
+  gimp_parallel_run (MIN (gimp_parallel_get_n_threads (), n_lines),
+                     (GimpParallelFunc) unsharp_job_func, &job, FALSE);
+}
+
+/* Copies the 'width' x 'height' pixels of 'src' transposed into 'dest',
+ * a block at a time so that both stay in the cache.
+ */
+static void
+unsharp_transpose (const guchar *src,
+                   guchar       *dest,
+                   gint          width,
+                   gint          height,
+                   gint          bpp)
+{
+  gint bx, by;
+
+  for (by = 0; by < height; by += UNSHARP_BLOCK_SIZE)
+    for (bx = 0; bx < width; bx += UNSHARP_BLOCK_SIZE)
+      {
+        gint x_end = MIN (bx + UNSHARP_BLOCK_SIZE, width);
+        gint y_end = MIN (by + UNSHARP_BLOCK_SIZE, height);
+        gint x, y;
+
+        for (y = by; y < y_end; y++)
+          {
+            const guchar *s = src + (y * width + bx) * bpp;
+
+            for (x = bx; x < x_end; x++, s += bpp)
+              {
+                guchar *d = dest + (x * height + y) * bpp;
+                gint    b;
+
+                for (b = 0; b < bpp; b++)
+                  d[b] = s[b];
+              }
+          }
+      }
+}
+
 /* Perform an unsharp mask on the region, given a source region, dest.
  * region, width and height of the regions, and corner coordinates of
  * a subregion to act upon.  Everything outside the subregion is unaffected.
+ *
+ * The region is processed in strips of UNSHARP_STRIP_SIZE rows, and
+ * then columns, each read and written with a single rect call; the
+ * lines of a strip are blurred on several threads.  The merge with
+ * the source is done on the column strips.
  */
 static void
 unsharp_region (GimpPixelRgn *srcPR,
@@ -565,17 +706,14 @@ unsharp_region (GimpPixelRgn *srcPR,
                 gint          y2,
                 gboolean      show_progress)
 {
-  guchar     *src;                /* Temporary copy of source row/col      */
-  guchar     *dest;               /* Temporary copy of destination row/col */
-  const gint  width   = x2 - x1;
-  const gint  height  = y2 - y1;
-  gdouble    *cmatrix = NULL;     /* Convolution matrix (for gaussian)     */
-  gint        cmatrix_length = 0;
-  gint        row, col;           /* Row, column counters                  */
-  const gint  threshold = unsharp_params.threshold;
-  gboolean    box_blur;           /* If we want to use a three pass box
-                                     blur instead of a gaussian blur       */
-  gint        box_width = 0;
+  guchar      *strip;              /* A strip of rows or columns            */
+  guchar      *lines;              /* The column strip, transposed          */
+  guchar      *orig;               /* The source pixels of a column strip   */
+  const gint   width   = x2 - x1;
+  const gint   height  = y2 - y1;
+  UnsharpBlur  blur    = { 0, };
+  gint         row, col;           /* Row, column counters                  */
+  const gint   threshold = unsharp_params.threshold;
 
   if (show_progress)
     gimp_progress_init (_("Blurring"));
@@ -588,143 +726,83 @@ unsharp_region (GimpPixelRgn *srcPR,
    */
   if (radius < 10)
     {
-      box_blur = FALSE;
+      blur.box_blur = FALSE;
       /* If true gaussian, generate convolution matrix
          and make sure it's smaller than each dimension */
-      cmatrix_length = gen_convolve_matrix (radius, &cmatrix);
+      blur.cmatrix_length = gen_convolve_matrix (radius, &blur.cmatrix);
     }
   else
     {
-      box_blur = TRUE;
+      blur.box_blur = TRUE;
       /* Three box blurs of this width approximate a gaussian */
-      box_width = ROUND (radius * 3 * sqrt (2 * G_PI) / 4);
+      blur.box_width = ROUND (radius * 3 * sqrt (2 * G_PI) / 4);
     }
 
-  /* Allocate buffers temporary copies of a row/column */
-  src  = g_new (guchar, MAX (width, height) * bpp);
-  dest = g_new (guchar, MAX (width, height) * bpp);
+  /* Allocate buffers for a strip of rows or columns */
+  strip = g_new (guchar, UNSHARP_STRIP_SIZE * MAX (width, height) * bpp);
+  lines = g_new (guchar, UNSHARP_STRIP_SIZE * height * bpp);
+  orig  = g_new (guchar, UNSHARP_STRIP_SIZE * height * bpp);
 
   /* Blur the rows */
-  for (row = 0; row < height; row++)
+  for (row = 0; row < height; row += UNSHARP_STRIP_SIZE)
     {
-      gimp_pixel_rgn_get_row (srcPR, src, x1, y1 + row, width);
+      gint h = MIN (UNSHARP_STRIP_SIZE, height - row);
 
-      if (box_blur)
-        {
-          /* Odd-width box blur: repeat 3 times, centered on output pixel.
-           * Swap back and forth between the buffers. */
-          if (box_width % 2)
-            {
-              box_blur_line (box_width, 0, src, dest, width, bpp);
-              box_blur_line (box_width, 0, dest, src, width, bpp);
-              box_blur_line (box_width, 0, src, dest, width, bpp);
-            }
-          /* Even-width box blur:
-           * This method is suggested by the specification for SVG.
-           * One pass with width n, centered between output and right pixel
-           * One pass with width n, centered between output and left pixel
-           * One pass with width n+1, centered on output pixel
-           * Swap back and forth between buffers.
-           */
-          else
-            {
-              box_blur_line (box_width,  -1, src, dest, width, bpp);
-              box_blur_line (box_width,   1, dest, src, width, bpp);
-              box_blur_line (box_width+1, 0, src, dest, width, bpp);
-            }
-        }
-      else
-        {
-          /* Gaussian blur */
-          gaussian_blur_line (cmatrix, cmatrix_length, src, dest, width, bpp);
-        }
-
-      gimp_pixel_rgn_set_row (destPR, dest, x1, y1 + row, width);
-
-      if (show_progress && row % 64 == 0)
-        gimp_progress_update ((gdouble) row / (3 * height));
-    }
-
-  /* Blur the cols. Essentially same as above. */
-  for (col = 0; col < width; col++)
-    {
-      gimp_pixel_rgn_get_col (destPR, src, x1 + col, y1, height);
+      gimp_pixel_rgn_get_rect (srcPR, strip, x1, y1 + row, width, h);
 
-      if (box_blur)
-        {
-          /* Odd-width box blur */
-          if (box_width % 2)
-            {
-              box_blur_line (box_width, 0, src, dest, height, bpp);
-              box_blur_line (box_width, 0, dest, src, height, bpp);
-              box_blur_line (box_width, 0, src, dest, height, bpp);
-            }
-          /* Even-width box blur */
-          else
-            {
-              box_blur_line (box_width,  -1, src, dest, height, bpp);
-              box_blur_line (box_width,   1, dest, src, height, bpp);
-              box_blur_line (box_width+1, 0, src, dest, height, bpp);
-            }
-        }
-      else
-        {
-          /* Gaussian blur */
-          gaussian_blur_line (cmatrix, cmatrix_length, src, dest,height, bpp);
-        }
+      unsharp_blur_lines (&blur, strip, h, width, bpp);
 
-      gimp_pixel_rgn_set_col (destPR, dest, x1 + col, y1, height);
+      gimp_pixel_rgn_set_rect (destPR, strip, x1, y1 + row, width, h);
 
-      if (show_progress && col % 64 == 0)
-        gimp_progress_update ((gdouble) col / (3 * width) + 0.33);
+      if (show_progress)
+        gimp_progress_update ((gdouble) (row + h) / (2 * height));
     }
 
-  if (show_progress)
-    gimp_progress_set_text (_("Merging"));
-
-  /* merge the source and destination (which currently contains
-     the blurred version) images */
-  for (row = 0; row < height; row++)
+  /* Blur the cols, then merge the source and destination (which
+   * currently contains the blurred version) images
+   */
+  for (col = 0; col < width; col += UNSHARP_STRIP_SIZE)
     {
-      const guchar *s = src;
-      guchar       *d = dest;
-      gint          u, v;
+      gint          w = MIN (UNSHARP_STRIP_SIZE, width - col);
+      const guchar *s = orig;
+      guchar       *d = strip;
+      gint          u;
 
-      /* get source row */
-      gimp_pixel_rgn_get_row (srcPR, src, x1, y1 + row, width);
+      gimp_pixel_rgn_get_rect (destPR, strip, x1 + col, y1, w, height);
 
-      /* get dest row */
-      gimp_pixel_rgn_get_row (destPR, dest, x1, y1 + row, width);
+      unsharp_transpose (strip, lines, w, height, bpp);
+      unsharp_blur_lines (&blur, lines, w, height, bpp);
+      unsharp_transpose (lines, strip, height, w, bpp);
+
+      gimp_pixel_rgn_get_rect (srcPR, orig, x1 + col, y1, w, height);
 
       /* combine the two */
-      for (u = 0; u < width; u++)
+      for (u = 0; u < w * height * bpp; u++)
         {
-          for (v = 0; v < bpp; v++)
-            {
-              gint value;
-              gint diff = *s - *d;
+          gint value;
+          gint diff = *s - *d;
 
-              /* do tresholding */
-              if (abs (2 * diff) < threshold)
-                diff = 0;
+          /* do tresholding */
+          if (abs (2 * diff) < threshold)
+            diff = 0;
 
-              value = *s++ + amount * diff;
-              *d++ = CLAMP (value, 0, 255);
-            }
+          value = *s++ + amount * diff;
+          *d++ = CLAMP (value, 0, 255);
         }
 
-      if (show_progress && row % 64 == 0)
-        gimp_progress_update ((gdouble) row / (3 * height) + 0.67);
+      gimp_pixel_rgn_set_rect (destPR, strip, x1 + col, y1, w, height);
 
-      gimp_pixel_rgn_set_row (destPR, dest, x1, y1 + row, width);
+      if (show_progress)
+        gimp_progress_update ((gdouble) (col + w) / (2 * width) + 0.5);
     }
 
   if (show_progress)
     gimp_progress_update (1.0);
 
-  g_free (dest);
-  g_free (src);
-  g_free (cmatrix);
+  g_free (strip);
+  g_free (lines);
+  g_free (orig);
+  g_free (blur.cmatrix);
 }
 
 /* generates a 1-D convolution matrix to be used for each pass of
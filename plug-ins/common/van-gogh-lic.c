@@ -37,6 +37,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
 
@@ -54,6 +56,9 @@
 #define PLUG_IN_BINARY "van-gogh-lic"
 #define PLUG_IN_ROLE   "gimp-van-gogh-lic"
 
+/* Rows of a band, the unit of work handed to the threads */
+#define LIC_BAND_HEIGHT  16
+
 typedef enum
 {
   LIC_HUE,
@@ -83,6 +88,17 @@ typedef struct
 
 static LicValues licvals;
 
+typedef struct
+{
+  const guchar *src;        /* The pixels of the selection bounds      */
+  guchar       *dest;
+  const gfloat *field;      /* The direction to convolve along at each
+                             * pixel, as pairs of vx and vy          */
+  gint          width;
+  gint          height;
+  gint          bpp;
+} LicContext;
+
 static gdouble l      = 10.0;
 static gdouble dx     =  2.0;
 static gdouble dy     =  2.0;
@@ -102,27 +118,28 @@ static GtkWidget *dialog;
 /************************/
 
 static void
-peek (GimpPixelRgn *src_rgn,
-      gint          x,
-      gint          y,
-      GimpRGB      *color)
+peek (const LicContext *ctx,
+      gint              x,
+      gint              y,
+      GimpRGB          *color)
 {
-  static guchar data[4] = { 0, };
+  const guchar *data = ctx->src + (y * ctx->width + x) * ctx->bpp;
 
-  gimp_pixel_rgn_get_pixel (src_rgn, data, x, y);
-  gimp_rgba_set_uchar (color, data[0], data[1], data[2], data[3]);
+  gimp_rgba_set_uchar (color, data[0], data[1], data[2],
+                       ctx->bpp > 3 ? data[3] : 255);
 }
 
 static void
-poke (GimpPixelRgn *dest_rgn,
-      gint          x,
-      gint          y,
-      GimpRGB      *color)
+poke (LicContext *ctx,
+      gint        x,
+      gint        y,
+      GimpRGB    *color)
 {
-  static guchar data[4];
+  guchar *dest = ctx->dest + (y * ctx->width + x) * ctx->bpp;
+  guchar  data[4];
 
   gimp_rgba_get_uchar (color, &data[0], &data[1], &data[2], &data[3]);
-  gimp_pixel_rgn_set_pixel (dest_rgn, data, x, y);
+  memcpy (dest, data, ctx->bpp);
 }
 
 static gint
@@ -327,17 +344,17 @@ lic_noise (gint    x,
 }
 
 static void
-getpixel (GimpPixelRgn *src_rgn,
-          GimpRGB      *p,
-          gdouble       u,
-          gdouble       v)
+getpixel (const LicContext *ctx,
+          GimpRGB          *p,
+          gdouble           u,
+          gdouble           v)
 {
   register gint x1, y1, x2, y2;
   gint width, height;
-  static GimpRGB pp[4];
+  GimpRGB pp[4];
 
-  width = src_rgn->w;
-  height = src_rgn->h;
+  width = ctx->width;
+  height = ctx->height;
 
   x1 = (gint)u;
   y1 = (gint)v;
@@ -355,10 +372,10 @@ getpixel (GimpPixelRgn *src_rgn,
   x2 = (x1 + 1) % width;
   y2 = (y1 + 1) % height;
 
-  peek (src_rgn, x1, y1, &pp[0]);
-  peek (src_rgn, x2, y1, &pp[1]);
-  peek (src_rgn, x1, y2, &pp[2]);
-  peek (src_rgn, x2, y2, &pp[3]);
+  peek (ctx, x1, y1, &pp[0]);
+  peek (ctx, x2, y1, &pp[1]);
+  peek (ctx, x1, y2, &pp[2]);
+  peek (ctx, x2, y2, &pp[3]);
 
   if (source_drw_has_alpha)
     *p = gimp_bilinear_rgba (u, v, pp);
@@ -367,12 +384,12 @@ getpixel (GimpPixelRgn *src_rgn,
 }
 
 static void
-lic_image (GimpPixelRgn *src_rgn,
-           gint          x,
-           gint          y,
-           gdouble       vx,
-           gdouble       vy,
-           GimpRGB      *color)
+lic_image (const LicContext *ctx,
+           gint              x,
+           gint              y,
+           gdouble           vx,
+           gdouble           vy,
+           GimpRGB          *color)
 {
   gdouble u, step = 2.0 * l / isteps;
   gdouble xx = (gdouble) x, yy = (gdouble) y;
@@ -389,7 +406,7 @@ lic_image (GimpPixelRgn *src_rgn,
   /* Calculate integral numerically */
   /* ============================== */
 
-  getpixel (src_rgn, &col1, xx + l * c, yy + l * s);
+  getpixel (ctx, &col1, xx + l * c, yy + l * s);
   if (source_drw_has_alpha)
     gimp_rgba_multiply (&col1, filter (-l));
   else
@@ -397,7 +414,7 @@ lic_image (GimpPixelRgn *src_rgn,
 
   for (u = -l + step; u <= l; u += step)
     {
-      getpixel (src_rgn, &col2, xx - u * c, yy - u * s);
+      getpixel (ctx, &col2, xx - u * c, yy - u * s);
       if (source_drw_has_alpha)
         {
           gimp_rgba_multiply (&col2, filter (u));
@@ -485,29 +502,23 @@ rgb_to_hsl (GimpDrawable     *drawable,
 }
 
 
-static void
-compute_lic (GimpDrawable *drawable,
-             const guchar *scalarfield,
-             gboolean      rotate)
+/* Computes the direction to convolve along at each pixel, from the
+ * derivatives of the effect image
+ */
+static gfloat *
+compute_field (const guchar *scalarfield,
+               gint          width,
+               gint          height,
+               gboolean      rotate)
 {
-  gint xcount, ycount;
-  GimpRGB color;
+  gfloat *field = g_new (gfloat, 2 * width * height);
+  gfloat *f     = field;
+  gint    xcount, ycount;
   gdouble vx, vy, tmp;
-  GimpPixelRgn src_rgn, dest_rgn;
-
-  gimp_pixel_rgn_init (&src_rgn, drawable,
-                       border_x1, border_y1,
-                       border_x2 - border_x1,
-                       border_y2 - border_y1, FALSE, FALSE);
 
-  gimp_pixel_rgn_init (&dest_rgn, drawable,
-                       border_x1, border_y1,
-                       border_x2 - border_x1,
-                       border_y2 - border_y1, TRUE, TRUE);
-
-  for (ycount = 0; ycount < src_rgn.h; ycount++)
+  for (ycount = 0; ycount < height; ycount++)
     {
-      for (xcount = 0; xcount < src_rgn.w; xcount++)
+      for (xcount = 0; xcount < width; xcount++)
         {
           /* Get derivative at (x,y) and normalize it */
           /* ============================================================== */
@@ -531,13 +542,35 @@ compute_lic (GimpDrawable *drawable,
               vy *= tmp;
             }
 
+          *f++ = vx;
+          *f++ = vy;
+        }
+    }
+
+  return field;
+}
+
+static void
+compute_lic_band (LicContext *ctx,
+                  gint        y1,
+                  gint        y2)
+{
+  const gfloat *f = ctx->field + 2 * y1 * ctx->width;
+  gint          xcount, ycount;
+  GimpRGB       color;
+  gdouble       tmp;
+
+  for (ycount = y1; ycount < y2; ycount++)
+    {
+      for (xcount = 0; xcount < ctx->width; xcount++, f += 2)
+        {
           /* Convolve with the LIC at (x,y) */
           /* ============================== */
 
           if (licvals.effect_convolve == 0)
             {
-              peek (&src_rgn, xcount, ycount, &color);
-              tmp = lic_noise (xcount, ycount, vx, vy);
+              peek (ctx, xcount, ycount, &color);
+              tmp = lic_noise (xcount, ycount, f[0], f[1]);
               if (source_drw_has_alpha)
                 gimp_rgba_multiply (&color, tmp);
               else
@@ -545,14 +578,73 @@ compute_lic (GimpDrawable *drawable,
             }
           else
             {
-              lic_image (&src_rgn, xcount, ycount, vx, vy, &color);
+              lic_image (ctx, xcount, ycount, f[0], f[1], &color);
             }
-          poke (&dest_rgn, xcount, ycount, &color);
+          poke (ctx, xcount, ycount, &color);
         }
-
-      gimp_progress_update ((gfloat) ycount / (gfloat) src_rgn.h);
     }
+}
+
+/* Computes a band, called by gimp_parallel_run() */
+static void
+compute_lic_band_func (gint        band,
+                       gint        n_bands,
+                       gint        thread,
+                       LicContext *ctx)
+{
+  gint y1 = band * LIC_BAND_HEIGHT;
+  gint y2 = MIN (y1 + LIC_BAND_HEIGHT, ctx->height);
+
+  compute_lic_band (ctx, y1, y2);
+}
+
+static void
+compute_lic (GimpDrawable *drawable,
+             const guchar *scalarfield,
+             gboolean      rotate)
+{
+  LicContext    ctx;
+  GimpPixelRgn  src_rgn, dest_rgn;
+  guchar       *src;
+  gfloat       *field;
+
+  gimp_pixel_rgn_init (&src_rgn, drawable,
+                       border_x1, border_y1,
+                       border_x2 - border_x1,
+                       border_y2 - border_y1, FALSE, FALSE);
+
+  gimp_pixel_rgn_init (&dest_rgn, drawable,
+                       border_x1, border_y1,
+                       border_x2 - border_x1,
+                       border_y2 - border_y1, TRUE, TRUE);
+
+  /* The threads can't talk to the core, so they work on copies of the
+   * pixels, and of the field
+   */
+  src   = g_new (guchar, src_rgn.w * src_rgn.h * src_rgn.bpp);
+  field = compute_field (scalarfield, src_rgn.w, src_rgn.h, rotate);
+
+  gimp_pixel_rgn_get_rect (&src_rgn, src,
+                           border_x1, border_y1, src_rgn.w, src_rgn.h);
+
+  ctx.src    = src;
+  ctx.dest   = g_new (guchar, src_rgn.w * src_rgn.h * src_rgn.bpp);
+  ctx.field  = field;
+  ctx.width  = src_rgn.w;
+  ctx.height = src_rgn.h;
+  ctx.bpp    = src_rgn.bpp;
+
+  gimp_parallel_run ((src_rgn.h + LIC_BAND_HEIGHT - 1) / LIC_BAND_HEIGHT,
+                     (GimpParallelFunc) compute_lic_band_func, &ctx, TRUE);
+
+  gimp_pixel_rgn_set_rect (&dest_rgn, ctx.dest,
+                           border_x1, border_y1, src_rgn.w, src_rgn.h);
+
   gimp_progress_update (1.0);
+
+  g_free (src);
+  g_free (ctx.dest);
+  g_free (field);
 }
 
 static void
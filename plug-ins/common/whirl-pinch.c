@@ -298,42 +298,42 @@ whirl_pinch (GimpDrawable *drawable)
   guchar           *top_row, *bot_row;
   guchar           *top_p, *bot_p;
   gint              row, col;
-  guchar          **pixel;
+  gint             *coords;
+  guchar           *pixels;
+  gboolean         *inside;
+  gdouble          *sample;
   gdouble           whirl;
   gdouble           cx, cy;
   gint              ix, iy;
   gint              i;
-  GimpPixelFetcher *pft, *pfb;
+  GimpPixelFetcher *pf;
   GimpRGB           background;
 
   /* Initialize rows */
   top_row = g_new (guchar, img_bpp * sel_width);
   bot_row = g_new (guchar, img_bpp * sel_width);
-  pixel = g_new (guchar *, 4);
-  for (i = 0; i < 4; i++)
-    pixel[i] = g_new (guchar, 4);
+
+  /* The 2x2 source pixels of every top and bottom row pixel, which are
+   * fetched for a whole row at once
+   */
+  coords = g_new (gint, 2 * sel_width * 4 * 2);
+  pixels = g_new (guchar, 2 * sel_width * 4 * img_bpp);
+  inside = g_new (gboolean, 2 * sel_width);
+  sample = g_new (gdouble, 2 * sel_width * 2);
 
   /* Initialize pixel region */
   gimp_pixel_rgn_init (&dest_rgn, drawable,
                        sel_x1, sel_y1, sel_width, sel_height, TRUE, TRUE);
 
-  pft = gimp_pixel_fetcher_new (drawable, FALSE);
-  pfb = gimp_pixel_fetcher_new (drawable, FALSE);
+  pf = gimp_pixel_fetcher_new (drawable, FALSE);
 
   gimp_context_get_background (&background);
-  gimp_pixel_fetcher_set_bg_color (pft, &background);
-  gimp_pixel_fetcher_set_bg_color (pfb, &background);
+  gimp_pixel_fetcher_set_bg_color (pf, &background);
 
   if (gimp_drawable_has_alpha (drawable->drawable_id))
-    {
-      gimp_pixel_fetcher_set_edge_mode (pft, GIMP_PIXEL_FETCHER_EDGE_BLACK);
-      gimp_pixel_fetcher_set_edge_mode (pfb, GIMP_PIXEL_FETCHER_EDGE_BLACK);
-    }
+    gimp_pixel_fetcher_set_edge_mode (pf, GIMP_PIXEL_FETCHER_EDGE_BLACK);
   else
-    {
-      gimp_pixel_fetcher_set_edge_mode (pft, GIMP_PIXEL_FETCHER_EDGE_BACKGROUND);
-      gimp_pixel_fetcher_set_edge_mode (pfb, GIMP_PIXEL_FETCHER_EDGE_BACKGROUND);
-    }
+    gimp_pixel_fetcher_set_edge_mode (pf, GIMP_PIXEL_FETCHER_EDGE_BACKGROUND);
 
   progress     = 0;
   max_progress = sel_width * sel_height;
@@ -345,84 +345,113 @@ whirl_pinch (GimpDrawable *drawable)
 
   for (row = sel_y1; row <= ((sel_y1 + sel_y2) / 2); row++)
     {
-      top_p = top_row;
-      bot_p = bot_row + img_bpp * (sel_width - 1);
+      gint *c = coords;
 
+      /* Collect the source pixels of the row pair; samples 2 * i and
+       * 2 * i + 1 are the top and bottom pixels for column sel_x1 + i
+       */
       for (col = sel_x1; col < sel_x2; col++)
         {
-          if (calc_undistorted_coords (col, row, whirl, wpvals.pinch, &cx, &cy))
-            {
-              /* We are inside the distortion area */
+          gint     n = 2 * (col - sel_x1);
+          gdouble *s = sample + 2 * n;
 
-              /* Top */
+          inside[n] = calc_undistorted_coords (col, row,
+                                               whirl, wpvals.pinch, &cx, &cy);
 
-              if (cx >= 0.0)
-                ix = (int) cx;
-              else
-                ix = -((int) -cx + 1);
+          if (inside[n])
+            {
+              /* We are inside the distortion area */
 
-              if (cy >= 0.0)
-                iy = (int) cy;
-              else
-                iy = -((int) -cy + 1);
+              s[0] = cx;
+              s[1] = cy;
+              s[2] = cen_x + (cen_x - cx);
+              s[3] = cen_y + (cen_y - cy);
+
+              for (i = 0; i < 2; i++)
+                {
+                  cx = s[i * 2];
+                  cy = s[i * 2 + 1];
+
+                  if (cx >= 0.0)
+                    ix = (int) cx;
+                  else
+                    ix = -((int) -cx + 1);
+
+                  if (cy >= 0.0)
+                    iy = (int) cy;
+                  else
+                    iy = -((int) -cy + 1);
+
+                  *c++ = ix;     *c++ = iy;
+                  *c++ = ix + 1; *c++ = iy;
+                  *c++ = ix;     *c++ = iy + 1;
+                  *c++ = ix + 1; *c++ = iy + 1;
+                }
+            }
+          else
+            {
+              /*  We are outside the distortion area;
+               *  just copy the source pixels
+               */
 
-              gimp_pixel_fetcher_get_pixel (pft, ix,     iy,     pixel[0]);
-              gimp_pixel_fetcher_get_pixel (pft, ix + 1, iy,     pixel[1]);
-              gimp_pixel_fetcher_get_pixel (pft, ix,     iy + 1, pixel[2]);
-              gimp_pixel_fetcher_get_pixel (pft, ix + 1, iy + 1, pixel[3]);
+              ix = (sel_x2 - 1) - (col - sel_x1);
+              iy = (sel_y2 - 1) - (row - sel_y1);
 
-              gimp_bilinear_pixels_8 (top_p, cx, cy, img_bpp, img_has_alpha,
-                                      pixel);
-              top_p += img_bpp;
-              /* Bottom */
+              for (i = 0; i < 4; i++)
+                {
+                  *c++ = col;
+                  *c++ = row;
+                }
 
-              cx = cen_x + (cen_x - cx);
-              cy = cen_y + (cen_y - cy);
+              for (i = 0; i < 4; i++)
+                {
+                  *c++ = ix;
+                  *c++ = iy;
+                }
+            }
+        }
 
-              if (cx >= 0.0)
-                ix = (int) cx;
-              else
-                ix = -((int) -cx + 1);
+      gimp_pixel_fetcher_get_pixels (pf, 2 * sel_width * 4, coords, pixels);
 
-              if (cy >= 0.0)
-                iy = (int) cy;
-              else
-                iy = -((int) -cy + 1);
+      top_p = top_row;
+      bot_p = bot_row + img_bpp * (sel_width - 1);
 
-              gimp_pixel_fetcher_get_pixel (pfb, ix,     iy,     pixel[0]);
-              gimp_pixel_fetcher_get_pixel (pfb, ix + 1, iy,     pixel[1]);
-              gimp_pixel_fetcher_get_pixel (pfb, ix,     iy + 1, pixel[2]);
-              gimp_pixel_fetcher_get_pixel (pfb, ix + 1, iy + 1, pixel[3]);
+      for (col = sel_x1; col < sel_x2; col++)
+        {
+          gint     n = 2 * (col - sel_x1);
+          guchar  *p = pixels + n * 4 * img_bpp;
+          guchar  *values[4];
 
-              gimp_bilinear_pixels_8 (bot_p, cx, cy, img_bpp, img_has_alpha,
-                                      pixel);
-              bot_p -= img_bpp;
-            }
-          else
+          if (inside[n])
             {
-              /*  We are outside the distortion area;
-               *  just copy the source pixels
-               */
-
               /* Top */
 
-              gimp_pixel_fetcher_get_pixel (pft, col, row, pixel[0]);
+              for (i = 0; i < 4; i++)
+                values[i] = p + i * img_bpp;
 
-              for (i = 0; i < img_bpp; i++)
-                *top_p++ = pixel[0][i];
+              gimp_bilinear_pixels_8 (top_p, sample[2 * n], sample[2 * n + 1],
+                                      img_bpp, img_has_alpha, values);
 
               /* Bottom */
 
-              gimp_pixel_fetcher_get_pixel (pfb,
-                                       (sel_x2 - 1) - (col - sel_x1),
-                                       (sel_y2 - 1) - (row - sel_y1),
-                                       pixel[0]);
+              for (i = 0; i < 4; i++)
+                values[i] = p + (4 + i) * img_bpp;
 
+              gimp_bilinear_pixels_8 (bot_p,
+                                      sample[2 * n + 2], sample[2 * n + 3],
+                                      img_bpp, img_has_alpha, values);
+            }
+          else
+            {
               for (i = 0; i < img_bpp; i++)
-                *bot_p++ = pixel[0][i];
-
-              bot_p -= 2 * img_bpp; /* We move backwards! */
+                {
+                  top_p[i] = p[i];
+                  bot_p[i] = p[4 * img_bpp + i];
+                }
             }
+
+          top_p += img_bpp;
+          bot_p -= img_bpp; /* We move backwards! */
         }
 
       /* Paint rows to image */
@@ -438,12 +467,12 @@ whirl_pinch (GimpDrawable *drawable)
     }
 
   gimp_progress_update (1.0);
-  gimp_pixel_fetcher_destroy (pft);
-  gimp_pixel_fetcher_destroy (pfb);
+  gimp_pixel_fetcher_destroy (pf);
 
-  for (i = 0; i < 4; i++)
-    g_free (pixel[i]);
-  g_free (pixel);
+  g_free (coords);
+  g_free (pixels);
+  g_free (inside);
+  g_free (sample);
   g_free (top_row);
   g_free (bot_row);
 
@@ -624,16 +653,15 @@ dialog_update_preview (GimpDrawable *drawable,
   gint                  j;
   gint                  bpp;
   GimpPixelFetcher     *pft;
-  guchar                in_pixels[4][4];
+  gint                 *coords;
+  gdouble              *sample;
+  guchar               *in_pixels;
   guchar               *in_values[4];
   gdouble               whirl;
 
   whirl   = wpvals.whirl * G_PI / 180.0;
   radius2 = radius * radius * wpvals.radius;
 
-  for (j = 0; j < 4; j++)
-    in_values[j] = in_pixels[j];
-
   pft = gimp_pixel_fetcher_new (drawable, FALSE);
 
   gimp_context_get_background (&background);
@@ -644,10 +672,16 @@ dialog_update_preview (GimpDrawable *drawable,
   dest = gimp_zoom_preview_get_source (GIMP_ZOOM_PREVIEW (preview),
                                        &width, &height, &bpp);
 
+  coords    = g_new (gint, width * 4 * 2);
+  sample    = g_new (gdouble, width * 2);
+  in_pixels = g_new (guchar, width * 4 * bpp);
+
   pixel = dest;
 
   for (y = 0; y < height; y++)
     {
+      gint *c = coords;
+
       for (x = 0; x < width; x++)
         {
           gimp_preview_untransform (preview, x, y, &sx, &sy);
@@ -655,12 +689,23 @@ dialog_update_preview (GimpDrawable *drawable,
                                    whirl, wpvals.pinch,
                                    &cx, &cy);
 
-          gimp_pixel_fetcher_get_pixel (pft, cx, cy, in_pixels[0]);
-          gimp_pixel_fetcher_get_pixel (pft, cx + 1, cy, in_pixels[1]);
-          gimp_pixel_fetcher_get_pixel (pft, cx, cy + 1, in_pixels[2]);
-          gimp_pixel_fetcher_get_pixel (pft, cx + 1, cy + 1, in_pixels[3]);
+          sample[x * 2]     = cx;
+          sample[x * 2 + 1] = cy;
+
+          *c++ = cx;     *c++ = cy;
+          *c++ = cx + 1; *c++ = cy;
+          *c++ = cx;     *c++ = cy + 1;
+          *c++ = cx + 1; *c++ = cy + 1;
+        }
+
+      gimp_pixel_fetcher_get_pixels (pft, width * 4, coords, in_pixels);
+
+      for (x = 0; x < width; x++)
+        {
+          for (j = 0; j < 4; j++)
+            in_values[j] = in_pixels + (x * 4 + j) * bpp;
 
-          gimp_bilinear_pixels_8 (pixel, cx, cy, bpp,
+          gimp_bilinear_pixels_8 (pixel, sample[x * 2], sample[x * 2 + 1], bpp,
                                   img_has_alpha, in_values);
 
           pixel += bpp;
@@ -669,6 +714,10 @@ dialog_update_preview (GimpDrawable *drawable,
 
   gimp_pixel_fetcher_destroy (pft);
 
+  g_free (coords);
+  g_free (sample);
+  g_free (in_pixels);
+
   gimp_preview_draw_buffer (preview, dest, width * bpp);
   g_free (dest);
 }
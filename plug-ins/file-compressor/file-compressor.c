@@ -88,6 +88,14 @@
 #include <zlib.h>
 #include <bzlib.h>
 
+
+/* the uncompressed size of the blocks deflated on their own */
+#define GZIP_BLOCK_SIZE        (256 * 1024)
+/* the dictionary each block is primed with */
+#define GZIP_WINDOW_SIZE       (32 * 1024)
+/* the most threads compressing at the same time */
+#define MAX_COMPRESSOR_THREADS 16
+
 /* Author 1: Josh MacDonald (url.c)          */
 /* Author 2: Daniel Risacher (gz.c)          */
 /* Author 3: Michael Natterer (compressor.c) */
@@ -102,6 +110,28 @@ typedef gboolean (*LoadFn) (const char *infile,
 typedef gboolean (*SaveFn) (const char *infile,
                             const char *outfile);
 
+typedef struct _GzipBlock      GzipBlock;
+typedef struct _GzipCompressor GzipCompressor;
+
+struct _GzipBlock
+{
+  guchar   *in;
+  gsize     in_len;
+  guchar   *dict;
+  gsize     dict_len;
+
+  guchar   *out;
+  gsize     out_len;
+  gulong    crc;
+  gboolean  done;
+};
+
+struct _GzipCompressor
+{
+  GMutex    mutex;
+  GCond     cond;
+};
+
 typedef struct _Compressor Compressor;
 
 struct _Compressor
@@ -587,62 +617,237 @@ gzip_load (const char *infile,
   return ret;
 }
 
+/*
+ * gzip compressor threads
+ *
+ * The input is cut into blocks that are deflated on their own, each
+ * primed with the last 32k of the block before it as dictionary, and
+ * ending on a sync flush so that they can simply be concatenated.
+ * The result is a single ordinary gzip member.
+ */
+static void
+gzip_compress_block (GzipBlock      *block,
+                     GzipCompressor *compressor)
+{
+  z_stream  zs  = { 0, };
+  guchar   *out = NULL;
+  gsize     out_size = 0;
+  gboolean  ok  = FALSE;
+
+  if (deflateInit2 (&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                    -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK)
+    {
+      if (block->dict_len > 0)
+        deflateSetDictionary (&zs, block->dict, block->dict_len);
+
+      /* room for the sync flush marker */
+      out_size = deflateBound (&zs, block->in_len) + 16;
+      out      = g_malloc (out_size);
+
+      zs.next_in   = block->in;
+      zs.avail_in  = block->in_len;
+      zs.next_out  = out;
+      zs.avail_out = out_size;
+
+      if (deflate (&zs, Z_SYNC_FLUSH) == Z_OK &&
+          zs.avail_in == 0 && zs.avail_out > 0)
+        ok = TRUE;
+
+      deflateEnd (&zs);
+    }
+
+  block->crc = crc32 (0, block->in, block->in_len);
+
+  g_free (block->in);
+  g_free (block->dict);
+  block->in   = NULL;
+  block->dict = NULL;
+
+  if (! ok)
+    {
+      g_free (out);
+      out = NULL;
+    }
+
+  g_mutex_lock (&compressor->mutex);
+
+  block->out     = out;
+  block->out_len = ok ? out_size - zs.avail_out : 0;
+  block->done    = TRUE;
+
+  g_cond_broadcast (&compressor->cond);
+  g_mutex_unlock (&compressor->mutex);
+}
+
 static gboolean
 gzip_save (const char *infile,
            const char *outfile)
 {
-  gboolean ret;
-  FILE *in;
-  int fd;
-  gzFile out;
-  char buf[16384];
-  int len;
-
-  ret = FALSE;
-  in = NULL;
-  out = NULL;
+  /* the header of a gzip member without file name and time stamp,
+   * and the empty final block that ends the deflate stream
+   */
+  static const guchar  header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+  static const guchar  final[2]   = { 0x03, 0x00 };
+  GzipCompressor       compressor;
+  GThreadPool         *pool      = NULL;
+  GQueue               pending   = G_QUEUE_INIT;
+  guchar              *window    = NULL;
+  gsize                window_len = 0;
+  gulong               crc       = crc32 (0, NULL, 0);
+  guint32              total     = 0;
+  gint                 n_threads = 1;
+  gint                 max_pending;
+  gboolean             eof       = FALSE;
+  gboolean             ret       = FALSE;
+  FILE                *in;
+  FILE                *out       = NULL;
+  guchar               trailer[8];
 
   in = g_fopen (infile, "rb");
   if (!in)
+    return FALSE;
+
+  out = g_fopen (outfile, "wb");
+  if (!out)
     goto out;
 
-  fd = g_open (outfile, O_CREAT | O_WRONLY | _O_BINARY, 0664);
-  if (fd == -1)
+  if (fwrite (header, 1, sizeof header, out) != sizeof header)
     goto out;
 
-  out = gzdopen (fd, "wb");
-  if (!out)
-    {
-      close (fd);
-      goto out;
-    }
+  n_threads = MIN (gimp_get_number_of_processors (), MAX_COMPRESSOR_THREADS);
 
-  while (TRUE)
+  g_mutex_init (&compressor.mutex);
+  g_cond_init (&compressor.cond);
+
+  if (n_threads > 1)
+    pool = g_thread_pool_new ((GFunc) gzip_compress_block, &compressor,
+                              n_threads, FALSE, NULL);
+
+  /* Don't keep too many uncompressed blocks around */
+  max_pending = 2 * n_threads;
+
+  ret = TRUE;
+
+  while (ret && (! eof || ! g_queue_is_empty (&pending)))
     {
-      len = fread (buf, 1, sizeof buf, in);
-      if (ferror (in))
-        break;
+      GzipBlock *block;
+      gboolean   done;
 
-      if (len < 0)
-        break;
-      else if (len == 0)
+      if (! eof)
         {
-          ret = TRUE;
-          break;
+          block = g_slice_new0 (GzipBlock);
+
+          block->in     = g_malloc (GZIP_BLOCK_SIZE);
+          block->in_len = fread (block->in, 1, GZIP_BLOCK_SIZE, in);
+
+          if (ferror (in))
+            {
+              g_free (block->in);
+              g_slice_free (GzipBlock, block);
+              ret = FALSE;
+              break;
+            }
+
+          if (block->in_len < GZIP_BLOCK_SIZE)
+            eof = TRUE;
+
+          if (block->in_len == 0)
+            {
+              g_free (block->in);
+              g_slice_free (GzipBlock, block);
+            }
+          else
+            {
+              gsize tail = MIN (block->in_len, GZIP_WINDOW_SIZE);
+
+              block->dict     = window;
+              block->dict_len = window_len;
+
+              window     = g_memdup (block->in + block->in_len - tail, tail);
+              window_len = tail;
+
+              g_queue_push_tail (&pending, block);
+
+              if (pool)
+                g_thread_pool_push (pool, block, NULL);
+              else
+                gzip_compress_block (block, &compressor);
+            }
         }
 
-      if (gzwrite (out, buf, len) != len)
-        break;
+      /* Write the blocks that are done, and wait for the oldest one
+       * if too many are pending or all of the input has been read
+       */
+      while (ret && (block = g_queue_peek_head (&pending)))
+        {
+          g_mutex_lock (&compressor.mutex);
+
+          while (! block->done &&
+                 (eof || g_queue_get_length (&pending) >= max_pending))
+            g_cond_wait (&compressor.cond, &compressor.mutex);
+
+          done = block->done;
+
+          g_mutex_unlock (&compressor.mutex);
+
+          if (! done)
+            break;
+
+          g_queue_pop_head (&pending);
+
+          if (! block->out ||
+              fwrite (block->out, 1, block->out_len, out) != block->out_len)
+            ret = FALSE;
+
+          crc    = crc32_combine (crc, block->crc, block->in_len);
+          total += block->in_len;
+
+          g_free (block->out);
+          g_slice_free (GzipBlock, block);
+        }
+    }
+
+  /* Wait for the compressor threads */
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  while (! g_queue_is_empty (&pending))
+    {
+      GzipBlock *block = g_queue_pop_head (&pending);
+
+      g_free (block->in);
+      g_free (block->dict);
+      g_free (block->out);
+      g_slice_free (GzipBlock, block);
+    }
+
+  g_free (window);
+
+  g_mutex_clear (&compressor.mutex);
+  g_cond_clear (&compressor.cond);
+
+  if (ret)
+    {
+      trailer[0] = crc & 0xff;
+      trailer[1] = (crc >> 8) & 0xff;
+      trailer[2] = (crc >> 16) & 0xff;
+      trailer[3] = (crc >> 24) & 0xff;
+      trailer[4] = total & 0xff;
+      trailer[5] = (total >> 8) & 0xff;
+      trailer[6] = (total >> 16) & 0xff;
+      trailer[7] = (total >> 24) & 0xff;
+
+      if (fwrite (final, 1, sizeof final, out) != sizeof final ||
+          fwrite (trailer, 1, sizeof trailer, out) != sizeof trailer)
+        ret = FALSE;
     }
 
  out:
   if (in)
     fclose (in);
 
-  /* There is no need to close(fd) as it is closed by gzclose(). */
-  if (out)
-    if (gzclose (out) != Z_OK)
-      ret = FALSE;
+  if (out && fclose (out) != 0)
+    ret = FALSE;
 
   return ret;
 }
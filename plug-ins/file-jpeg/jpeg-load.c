@@ -49,6 +49,27 @@
 #endif
 
 
+/*  Converts the CMYK strips on a thread of its own, while the next
+ *  strip is being decoded.
+ */
+typedef struct
+{
+  GThread     *thread;
+  GAsyncQueue *todo;
+  GAsyncQueue *done;
+  gpointer     transform;
+  gint         width;
+} JpegCmykConverter;
+
+typedef struct
+{
+  guchar  *buf;
+  guchar **rowbuf;
+  gint     start;
+  gint     scanlines;
+} JpegLoadStrip;
+
+
 static void  jpeg_load_resolution           (gint32    image_ID,
                                              struct jpeg_decompress_struct
                                                        *cinfo);
@@ -66,16 +87,28 @@ static void      jpeg_load_cmyk_to_rgb      (guchar   *buf,
                                              glong     pixels,
                                              gpointer  transform);
 
+static JpegCmykConverter *
+                 jpeg_load_cmyk_converter_new  (gpointer           transform,
+                                                gint               width);
+static void      jpeg_load_cmyk_converter_free (JpegCmykConverter *converter);
+static gpointer  jpeg_load_cmyk_converter_thread
+                                               (gpointer           data);
+
 
 GimpDrawable    *drawable_global;
 gint32 volatile  preview_image_ID;
 gint32           preview_layer_ID;
 
 
+/*  With a size > 0, the image is decoded at 1/2, 1/4 or 1/8 of its
+ *  size, as small as possible while its larger side stays at least
+ *  size pixels. libjpeg can then skip most of the inverse DCT.
+ */
 gint32
 load_image (const gchar  *filename,
             GimpRunMode   runmode,
             gboolean      preview,
+            gint          size,
             GError      **error)
 {
   GimpPixelRgn     pixel_rgn;
@@ -88,19 +121,20 @@ load_image (const gchar  *filename,
   FILE            *infile;
   guchar          *buf;
   guchar         **rowbuf;
+  JpegLoadStrip    strips[2];
+  JpegLoadStrip   *pending = NULL;
+  gint             n_strips;
+  gint             current = 0;
   gint             image_type;
   gint             layer_type;
   gint             tile_height;
-  gint             scanlines;
-  gint             i, start, end;
+  gint             row_bytes;
+  gint             i, end;
 #ifdef HAVE_LIBEXIF
   gint             orientation = 0;
 #endif
-#ifdef HAVE_LCMS
-  cmsHTRANSFORM    cmyk_transform = NULL;
-#else
-  gpointer         cmyk_transform = NULL;
-#endif
+  gpointer                     cmyk_transform = NULL;
+  JpegCmykConverter * volatile converter      = NULL;
 
   /* We set up the normal JPEG error routines. */
   cinfo.err = jpeg_std_error (&jerr.pub);
@@ -135,6 +169,9 @@ load_image (const gchar  *filename,
       if (infile)
         fclose (infile);
 
+      if (converter)
+        jpeg_load_cmyk_converter_free (converter);
+
       if (image_ID != -1 && !preview)
         gimp_image_delete (image_ID);
 
@@ -175,9 +212,17 @@ load_image (const gchar  *filename,
 
   /* Step 4: set parameters for decompression */
 
-  /* In this example, we don't need to change any of the defaults set by
-   * jpeg_read_header(), so we do nothing here.
-   */
+  if (size > 0)
+    {
+      gint max = MAX (cinfo.image_width, cinfo.image_height);
+
+      /* the output size is rounded up */
+      cinfo.scale_num   = 1;
+      cinfo.scale_denom = 1;
+
+      while (cinfo.scale_denom < 8 && max / (cinfo.scale_denom * 2) >= size)
+        cinfo.scale_denom *= 2;
+    }
 
   /* Step 5: Start decompressor */
 
@@ -189,15 +234,24 @@ load_image (const gchar  *filename,
    * if we asked for color quantization.
    */
 
-  /* temporary buffer */
+  /* temporary buffer, CMYK images decode one strip while the other one
+   * is being converted
+   */
   tile_height = gimp_tile_height ();
-  buf = g_new (guchar,
-               tile_height * cinfo.output_width * cinfo.output_components);
+  row_bytes   = cinfo.output_width * cinfo.output_components;
+  n_strips    = cinfo.out_color_space == JCS_CMYK ? 2 : 1;
 
-  rowbuf = g_new (guchar *, tile_height);
+  buf    = g_new (guchar, n_strips * tile_height * row_bytes);
+  rowbuf = g_new (guchar *, n_strips * tile_height);
 
-  for (i = 0; i < tile_height; i++)
-    rowbuf[i] = buf + cinfo.output_width * cinfo.output_components * i;
+  for (i = 0; i < n_strips * tile_height; i++)
+    rowbuf[i] = buf + row_bytes * i;
+
+  for (i = 0; i < n_strips; i++)
+    {
+      strips[i].buf    = rowbuf[i * tile_height];
+      strips[i].rowbuf = rowbuf + i * tile_height;
+    }
 
   switch (cinfo.output_components)
     {
@@ -417,29 +471,68 @@ load_image (const gchar  *filename,
   /* Here we use the library's state variable cinfo.output_scanline as the
    * loop counter, so that we don't have to keep track ourselves.
    */
+  if (cinfo.out_color_space == JCS_CMYK)
+    converter = jpeg_load_cmyk_converter_new (cmyk_transform,
+                                              cinfo.output_width);
+
   while (cinfo.output_scanline < cinfo.output_height)
     {
-      start = cinfo.output_scanline;
-      end   = cinfo.output_scanline + tile_height;
-      end   = MIN (end, cinfo.output_height);
+      JpegLoadStrip *strip = &strips[current];
 
-      scanlines = end - start;
+      strip->start = cinfo.output_scanline;
+      end          = cinfo.output_scanline + tile_height;
+      end          = MIN (end, cinfo.output_height);
 
-      for (i = 0; i < scanlines; i++)
-        jpeg_read_scanlines (&cinfo, (JSAMPARRAY) &rowbuf[i], 1);
+      strip->scanlines = end - strip->start;
 
-      if (cinfo.out_color_space == JCS_CMYK)
-        jpeg_load_cmyk_to_rgb (buf, drawable->width * scanlines,
-                               cmyk_transform);
+      for (i = 0; i < strip->scanlines; i++)
+        jpeg_read_scanlines (&cinfo, (JSAMPARRAY) &strip->rowbuf[i], 1);
 
-      gimp_pixel_rgn_set_rect (&pixel_rgn, buf,
-                               0, start, drawable->width, scanlines);
+      if (converter)
+        {
+          JpegLoadStrip *decoded = strip;
+
+          /* hand this strip over, and store the previous one while the
+           * thread converts it
+           */
+          g_async_queue_push (converter->todo, decoded);
+
+          current = (current + 1) % n_strips;
+
+          if (! pending)
+            {
+              pending = decoded;
+              continue;
+            }
+
+          strip   = g_async_queue_pop (converter->done);
+          pending = decoded;
+        }
+
+      gimp_pixel_rgn_set_rect (&pixel_rgn, strip->buf,
+                               0, strip->start, drawable->width,
+                               strip->scanlines);
 
       if (! preview && (cinfo.output_scanline % 32) == 0)
         gimp_progress_update ((gdouble) cinfo.output_scanline /
                               (gdouble) cinfo.output_height);
     }
 
+  if (converter)
+    {
+      if (pending)
+        {
+          JpegLoadStrip *strip = g_async_queue_pop (converter->done);
+
+          gimp_pixel_rgn_set_rect (&pixel_rgn, strip->buf,
+                                   0, strip->start, drawable->width,
+                                   strip->scanlines);
+        }
+
+      jpeg_load_cmyk_converter_free (converter);
+      converter = NULL;
+    }
+
   /* Step 7: Finish decompression */
 
   jpeg_finish_decompress (&cinfo);
@@ -447,10 +540,9 @@ load_image (const gchar  *filename,
    * with the stdio data source.
    */
 
-#ifdef HAVE_LCMS
-  if (cmyk_transform)
-    cmsDeleteTransform (cmyk_transform);
-#endif
+  /* cmyk_transform is kept by jpeg_load_cmyk_transform() for the next
+   * image with the same profiles
+   */
 
   /* Step 8: Release JPEG decompression object */
 
@@ -652,8 +744,80 @@ term_source (j_decompress_ptr cinfo)
 {
 }
 
+static gboolean
+jpeg_load_image_size (const gchar *filename,
+                      gint        *width,
+                      gint        *height,
+                      GError     **error)
+{
+  struct jpeg_decompress_struct cinfo;
+  struct my_error_mgr           jerr;
+  FILE                         *infile;
+
+  if ((infile = g_fopen (filename, "rb")) == NULL)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Could not open '%s' for reading: %s"),
+                   gimp_filename_to_utf8 (filename), g_strerror (errno));
+      return FALSE;
+    }
+
+  cinfo.err = jpeg_std_error (&jerr.pub);
+  jerr.pub.error_exit     = my_error_exit;
+  jerr.pub.output_message = my_output_message;
+
+  if (setjmp (jerr.setjmp_buffer))
+    {
+      jpeg_destroy_decompress (&cinfo);
+      fclose (infile);
+
+      return FALSE;
+    }
+
+  jpeg_create_decompress (&cinfo);
+
+  jpeg_stdio_src (&cinfo, infile);
+
+  jpeg_read_header (&cinfo, TRUE);
+
+  *width  = cinfo.image_width;
+  *height = cinfo.image_height;
+
+  jpeg_destroy_decompress (&cinfo);
+
+  fclose (infile);
+
+  return TRUE;
+}
+
+/*  Used when there is no useful EXIF thumbnail, decoding the image at
+ *  a reduced size is still a lot faster than loading all of it.
+ */
+static gint32
+load_scaled_thumbnail_image (const gchar   *filename,
+                             gint           thumb_size,
+                             gint          *width,
+                             gint          *height,
+                             GimpImageType *type,
+                             GError       **error)
+{
+  gint32 image_ID;
+
+  if (! jpeg_load_image_size (filename, width, height, error))
+    return -1;
+
+  image_ID = load_image (filename, GIMP_RUN_NONINTERACTIVE, FALSE,
+                         MAX (thumb_size, 1), error);
+
+  if (image_ID != -1)
+    *type = gimp_drawable_type (gimp_image_get_active_drawable (image_ID));
+
+  return image_ID;
+}
+
 gint32
 load_thumbnail_image (const gchar   *filename,
+                      gint           thumb_size,
                       gint          *width,
                       gint          *height,
                       GimpImageType *type,
@@ -675,13 +839,18 @@ load_thumbnail_image (const gchar   *filename,
   gint             i, start, end;
   gint             orientation;
   my_src_ptr       src;
-  FILE            *infile;
 
   image_ID = -1;
   exif_data = jpeg_exif_data_new_from_file (filename, NULL);
 
   if (! ((exif_data) && (exif_data->data) && (exif_data->size > 0)))
-    return -1;
+    {
+      if (exif_data)
+        exif_data_unref (exif_data);
+
+      return load_scaled_thumbnail_image (filename, thumb_size,
+                                          width, height, type, error);
+    }
 
   orientation = jpeg_exif_get_orientation (exif_data);
 
@@ -741,6 +910,15 @@ load_thumbnail_image (const gchar   *filename,
 
   jpeg_read_header (&cinfo, TRUE);
 
+  if (MAX (cinfo.image_width, cinfo.image_height) < thumb_size)
+    {
+      jpeg_destroy_decompress (&cinfo);
+      exif_data_unref (exif_data);
+
+      return load_scaled_thumbnail_image (filename, thumb_size,
+                                          width, height, type, error);
+    }
+
   /* Step 4: set parameters for decompression */
 
   /* In this example, we don't need to change any of the defaults set by
@@ -880,71 +1058,14 @@ load_thumbnail_image (const gchar   *filename,
   /* NOW to get the dimensions of the actual image to return the
    * calling app
    */
-  cinfo.err = jpeg_std_error (&jerr.pub);
-  jerr.pub.error_exit = my_error_exit;
-  jerr.pub.output_message = my_output_message;
-
-  if ((infile = g_fopen (filename, "rb")) == NULL)
-    {
-      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
-                   _("Could not open '%s' for reading: %s"),
-                   gimp_filename_to_utf8 (filename), g_strerror (errno));
-
-      if (exif_data)
-        {
-          exif_data_unref (exif_data);
-          exif_data = NULL;
-        }
-
-      return -1;
-    }
-
-  /* Establish the setjmp return context for my_error_exit to use. */
-  if (setjmp (jerr.setjmp_buffer))
+  if (! jpeg_load_image_size (filename, width, height, error))
     {
-      /* If we get here, the JPEG code has signaled an error.  We
-       * need to clean up the JPEG object, close the input file,
-       * and return.
-       */
-      jpeg_destroy_decompress (&cinfo);
-
-      if (image_ID != -1)
-        gimp_image_delete (image_ID);
-
-      if (exif_data)
-        {
-          exif_data_unref (exif_data);
-          exif_data = NULL;
-        }
+      gimp_image_delete (image_ID);
+      exif_data_unref (exif_data);
 
       return -1;
     }
 
-  /* Now we can initialize the JPEG decompression object. */
-  jpeg_create_decompress (&cinfo);
-
-  /* Step 2: specify data source (eg, a file) */
-
-  jpeg_stdio_src (&cinfo, infile);
-
-  /* Step 3: read file parameters with jpeg_read_header() */
-
-  jpeg_read_header (&cinfo, TRUE);
-
-  jpeg_start_decompress (&cinfo);
-
-  *width  = cinfo.output_width;
-  *height = cinfo.output_height;
-
-  /* Step 4: Release JPEG decompression object */
-
-  /* This is an important step since it will release a good deal
-   * of memory.
-   */
-  jpeg_destroy_decompress (&cinfo);
-
-  fclose (infile);
-
   if (exif_data)
     {
       exif_data_unref (exif_data);
@@ -961,6 +1082,17 @@ load_thumbnail_image (const gchar   *filename,
 #endif /* HAVE_LIBEXIF */
 
 
+#ifdef HAVE_LCMS
+
+/*  the number of transforms kept, a resident plug-in loads image after
+ *  image, mostly with the same few profiles
+ */
+#define JPEG_LOAD_MAX_CMYK_TRANSFORMS 8
+
+static GHashTable *cmyk_transforms = NULL;
+
+#endif  /* HAVE_LCMS */
+
 static gpointer
 jpeg_load_cmyk_transform (guint8 *profile_data,
                           gsize   profile_len)
@@ -971,6 +1103,41 @@ jpeg_load_cmyk_transform (guint8 *profile_data,
   cmsHPROFILE      rgb_profile  = NULL;
   DWORD            flags        = 0;
   cmsHTRANSFORM    transform;
+  gchar           *checksum     = NULL;
+  gchar           *key;
+
+  if (config->display_intent ==
+      GIMP_COLOR_RENDERING_INTENT_RELATIVE_COLORIMETRIC)
+    {
+      flags |= cmsFLAGS_BLACKPOINTCOMPENSATION;
+    }
+
+  /*  creating the transform takes longer than converting most images  */
+  if (profile_data)
+    checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+                                            profile_data, profile_len);
+
+  key = g_strdup_printf ("%s|%s|%s|%d",
+                         checksum            ? checksum            : "",
+                         config->cmyk_profile ? config->cmyk_profile : "",
+                         config->rgb_profile  ? config->rgb_profile  : "",
+                         config->display_intent);
+  g_free (checksum);
+
+  if (! cmyk_transforms)
+    cmyk_transforms = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free,
+                                             (GDestroyNotify) cmsDeleteTransform);
+
+  transform = g_hash_table_lookup (cmyk_transforms, key);
+
+  if (transform)
+    {
+      g_free (key);
+      g_object_unref (config);
+
+      return transform;
+    }
 
   /*  try to load the embedded CMYK profile  */
   if (profile_data)
@@ -1002,6 +1169,7 @@ jpeg_load_cmyk_transform (guint8 *profile_data,
   /*  bail out if we can't load any CMYK profile  */
   if (! cmyk_profile)
     {
+      g_free (key);
       g_object_unref (config);
       return NULL;
     }
@@ -1024,12 +1192,6 @@ jpeg_load_cmyk_transform (guint8 *profile_data,
       rgb_profile = cmsCreate_sRGBProfile ();
     }
 
-  if (config->display_intent ==
-      GIMP_COLOR_RENDERING_INTENT_RELATIVE_COLORIMETRIC)
-    {
-      flags |= cmsFLAGS_BLACKPOINTCOMPENSATION;
-    }
-
   transform = cmsCreateTransform (cmyk_profile, TYPE_CMYK_8_REV,
                                   rgb_profile,  TYPE_RGB_8,
                                   config->display_intent,
@@ -1038,6 +1200,18 @@ jpeg_load_cmyk_transform (guint8 *profile_data,
   cmsCloseProfile (cmyk_profile);
   cmsCloseProfile (rgb_profile);
 
+  if (transform)
+    {
+      if (g_hash_table_size (cmyk_transforms) >= JPEG_LOAD_MAX_CMYK_TRANSFORMS)
+        g_hash_table_remove_all (cmyk_transforms);
+
+      g_hash_table_insert (cmyk_transforms, key, transform);
+    }
+  else
+    {
+      g_free (key);
+    }
+
   g_object_unref (config);
 
   return transform;
@@ -1078,3 +1252,54 @@ jpeg_load_cmyk_to_rgb (guchar   *buf,
       dest += 3;
     }
 }
+
+
+static JpegCmykConverter *
+jpeg_load_cmyk_converter_new (gpointer transform,
+                              gint     width)
+{
+  JpegCmykConverter *converter = g_slice_new (JpegCmykConverter);
+
+  converter->todo      = g_async_queue_new ();
+  converter->done      = g_async_queue_new ();
+  converter->transform = transform;
+  converter->width     = width;
+  converter->thread    = g_thread_new ("jpeg-cmyk",
+                                       jpeg_load_cmyk_converter_thread,
+                                       converter);
+
+  return converter;
+}
+
+static void
+jpeg_load_cmyk_converter_free (JpegCmykConverter *converter)
+{
+  /*  the converter itself is the sign to stop  */
+  g_async_queue_push (converter->todo, converter);
+  g_thread_join (converter->thread);
+
+  g_async_queue_unref (converter->todo);
+  g_async_queue_unref (converter->done);
+
+  g_slice_free (JpegCmykConverter, converter);
+}
+
+static gpointer
+jpeg_load_cmyk_converter_thread (gpointer data)
+{
+  JpegCmykConverter *converter = data;
+  gpointer           item;
+
+  while ((item = g_async_queue_pop (converter->todo)) != converter)
+    {
+      JpegLoadStrip *strip = item;
+
+      jpeg_load_cmyk_to_rgb (strip->buf,
+                             (glong) converter->width * strip->scanlines,
+                             converter->transform);
+
+      g_async_queue_push (converter->done, strip);
+    }
+
+  return NULL;
+}
@@ -21,12 +21,14 @@
 gint32 load_image           (const gchar  *filename,
                              GimpRunMode   runmode,
                              gboolean      preview,
+                             gint          size,
                              GError      **error);
 
 
 #ifdef HAVE_LIBEXIF
 
 gint32 load_thumbnail_image (const gchar   *filename,
+                             gint           thumb_size,
                              gint          *width,
                              gint          *height,
                              GimpImageType *type,
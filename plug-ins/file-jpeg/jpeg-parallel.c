@@ -0,0 +1,511 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The entropy-coded data of a sequential JPEG file is cut by the restart
+ * markers into intervals which don't depend on each other: the DC
+ * predictions are reset and the bits are flushed at each marker, the
+ * same way they are at the end of the scan.  So a stripe of whole
+ * intervals, encoded on its own as a small image with the same tables,
+ * gives exactly the bytes it would have in the whole image, except
+ * that its markers are numbered from RST0.
+ *
+ * The stripes are encoded on as many threads as there are processors,
+ * and then written out in order with their markers renumbered and a
+ * marker between each of them.  The tables and the frame header of the
+ * first stripe are used for the whole file, with the height fixed.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include <jpeglib.h>
+#include <jerror.h>
+
+#include <libgimp/gimp.h>
+
+#include "jpeg.h"
+#include "jpeg-parallel.h"
+
+
+/* Rows of a stripe, the unit of work handed to the threads; stripes
+ * are rounded to whole restart intervals
+ */
+#define JPEG_PARALLEL_STRIPE_HEIGHT  256
+#define JPEG_PARALLEL_BUFFER_SIZE   4096
+
+#define JPEG_PARALLEL_SOF0          0xc0
+#define JPEG_PARALLEL_SOF2          0xc2
+#define JPEG_PARALLEL_SOS           0xda
+
+
+typedef struct
+{
+  struct jpeg_destination_mgr  pub;
+  GByteArray                  *data;
+  JOCTET                       buffer[JPEG_PARALLEL_BUFFER_SIZE];
+} JpegParallelDest;
+
+typedef struct
+{
+  guchar      *pixels;     /* The rows of the stripe, as in the drawable */
+  gint         height;
+  GByteArray  *data;       /* The stripe, encoded as a complete file     */
+  gboolean     failed;
+  gchar        message[JMSG_LENGTH_MAX];
+} JpegParallelStripe;
+
+typedef struct
+{
+  j_compress_ptr      cinfo;   /* The parameters for all the stripes */
+  gint                bpp;
+  gboolean            has_alpha;
+  JpegParallelStripe *stripes;
+} JpegParallelContext;
+
+
+static void
+jpeg_parallel_init_destination (j_compress_ptr cinfo)
+{
+  JpegParallelDest *dest = (JpegParallelDest *) cinfo->dest;
+
+  dest->pub.next_output_byte = dest->buffer;
+  dest->pub.free_in_buffer   = JPEG_PARALLEL_BUFFER_SIZE;
+}
+
+static boolean
+jpeg_parallel_empty_output_buffer (j_compress_ptr cinfo)
+{
+  JpegParallelDest *dest = (JpegParallelDest *) cinfo->dest;
+
+  g_byte_array_append (dest->data, dest->buffer, JPEG_PARALLEL_BUFFER_SIZE);
+
+  dest->pub.next_output_byte = dest->buffer;
+  dest->pub.free_in_buffer   = JPEG_PARALLEL_BUFFER_SIZE;
+
+  return TRUE;
+}
+
+static void
+jpeg_parallel_term_destination (j_compress_ptr cinfo)
+{
+  JpegParallelDest *dest = (JpegParallelDest *) cinfo->dest;
+
+  g_byte_array_append (dest->data, dest->buffer,
+                       JPEG_PARALLEL_BUFFER_SIZE - dest->pub.free_in_buffer);
+
+  dest->pub.next_output_byte = dest->buffer;
+  dest->pub.free_in_buffer   = JPEG_PARALLEL_BUFFER_SIZE;
+}
+
+static GByteArray *
+jpeg_parallel_set_dest (j_compress_ptr cinfo)
+{
+  JpegParallelDest *dest;
+
+  dest = (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_PERMANENT,
+                                     sizeof (JpegParallelDest));
+
+  dest->pub.init_destination    = jpeg_parallel_init_destination;
+  dest->pub.empty_output_buffer = jpeg_parallel_empty_output_buffer;
+  dest->pub.term_destination    = jpeg_parallel_term_destination;
+  dest->data                    = g_byte_array_new ();
+
+  cinfo->dest = (struct jpeg_destination_mgr *) dest;
+
+  return dest->data;
+}
+
+/* Like my_error_exit(), but leaves the message to the main thread */
+static void
+jpeg_parallel_error_exit (j_common_ptr cinfo)
+{
+  my_error_ptr myerr = (my_error_ptr) cinfo->err;
+
+  longjmp (myerr->setjmp_buffer, 1);
+}
+
+static gint
+jpeg_parallel_get_mcu_height (j_compress_ptr cinfo)
+{
+  gint max_v_samp_factor = 1;
+  gint i;
+
+  /*  a single component isn't interleaved, its MCUs are single blocks  */
+  if (cinfo->num_components == 1)
+    return DCTSIZE;
+
+  for (i = 0; i < cinfo->num_components; i++)
+    max_v_samp_factor = MAX (max_v_samp_factor,
+                             cinfo->comp_info[i].v_samp_factor);
+
+  return DCTSIZE * max_v_samp_factor;
+}
+
+gboolean
+jpeg_parallel_possible (j_compress_ptr cinfo)
+{
+  gint  max_h_samp_factor = 1;
+  gint  mcu_width;
+  glong mcus_per_row;
+  gint  i;
+
+  /*  the stripes have to share the Huffman tables, and must not look
+   *  at the rows of their neighbours
+   */
+  if (cinfo->optimize_coding  ||
+      cinfo->scan_info        ||
+      cinfo->smoothing_factor ||
+      cinfo->restart_interval ||
+      cinfo->restart_in_rows <= 0)
+    return FALSE;
+
+  for (i = 0; i < cinfo->num_components; i++)
+    max_h_samp_factor = MAX (max_h_samp_factor,
+                             cinfo->comp_info[i].h_samp_factor);
+
+  mcu_width = (cinfo->num_components == 1 ?
+               DCTSIZE : DCTSIZE * max_h_samp_factor);
+
+  /*  libjpeg clamps the interval, it then no longer is whole MCU rows  */
+  mcus_per_row = (cinfo->image_width + mcu_width - 1) / mcu_width;
+
+  if (cinfo->restart_in_rows * mcus_per_row > 65535)
+    return FALSE;
+
+  return (cinfo->image_height >
+          cinfo->restart_in_rows * jpeg_parallel_get_mcu_height (cinfo));
+}
+
+void
+jpeg_parallel_dest (j_compress_ptr cinfo)
+{
+  jpeg_parallel_set_dest (cinfo);
+}
+
+static void
+jpeg_parallel_encode_stripe (JpegParallelContext *ctx,
+                             JpegParallelStripe  *stripe)
+{
+  j_compress_ptr       params     = ctx->cinfo;
+  j_compress_ptr       cinfo;
+  struct my_error_mgr  jerr;
+  gint                 components = params->input_components;
+  guchar              *row;
+  gint                 i, y;
+
+  /*  nothing that is changed after the setjmp() lives on the stack  */
+  cinfo = g_new0 (struct jpeg_compress_struct, 1);
+  row   = g_new (guchar, params->image_width * components);
+
+  cinfo->err = jpeg_std_error (&jerr.pub);
+  jerr.pub.error_exit = jpeg_parallel_error_exit;
+
+  if (setjmp (jerr.setjmp_buffer))
+    {
+      (*cinfo->err->format_message) ((j_common_ptr) cinfo, stripe->message);
+      stripe->failed = TRUE;
+
+      jpeg_destroy_compress (cinfo);
+      g_free (cinfo);
+      g_free (row);
+
+      return;
+    }
+
+  jpeg_create_compress (cinfo);
+
+  stripe->data = jpeg_parallel_set_dest (cinfo);
+
+  cinfo->image_width      = params->image_width;
+  cinfo->image_height     = stripe->height;
+  cinfo->input_components = params->input_components;
+  cinfo->in_color_space   = params->in_color_space;
+
+  jpeg_set_defaults (cinfo);
+
+  for (i = 0; i < NUM_QUANT_TBLS; i++)
+    {
+      if (! params->quant_tbl_ptrs[i])
+        continue;
+
+      if (! cinfo->quant_tbl_ptrs[i])
+        cinfo->quant_tbl_ptrs[i] = jpeg_alloc_quant_table ((j_common_ptr) cinfo);
+
+      memcpy (cinfo->quant_tbl_ptrs[i]->quantval,
+              params->quant_tbl_ptrs[i]->quantval,
+              sizeof (params->quant_tbl_ptrs[i]->quantval));
+      cinfo->quant_tbl_ptrs[i]->sent_table = FALSE;
+    }
+
+  for (i = 0; i < params->num_components; i++)
+    {
+      cinfo->comp_info[i].h_samp_factor = params->comp_info[i].h_samp_factor;
+      cinfo->comp_info[i].v_samp_factor = params->comp_info[i].v_samp_factor;
+      cinfo->comp_info[i].quant_tbl_no  = params->comp_info[i].quant_tbl_no;
+    }
+
+  cinfo->dct_method         = params->dct_method;
+  cinfo->restart_interval   = 0;
+  cinfo->restart_in_rows    = params->restart_in_rows;
+
+  /*  only the tables and the scan are used  */
+  cinfo->write_JFIF_header  = FALSE;
+  cinfo->write_Adobe_marker = FALSE;
+
+  jpeg_start_compress (cinfo, TRUE);
+
+  for (y = 0; y < stripe->height; y++)
+    {
+      const guchar *s = stripe->pixels + y * params->image_width * ctx->bpp;
+      guchar       *t = row;
+      gint          x;
+
+      for (x = 0; x < params->image_width; x++)
+        {
+          for (i = 0; i < components; i++)
+            *t++ = *s++;
+          if (ctx->has_alpha)  /* ignore alpha channel */
+            s++;
+        }
+
+      jpeg_write_scanlines (cinfo, (JSAMPARRAY) &row, 1);
+    }
+
+  jpeg_finish_compress (cinfo);
+  jpeg_destroy_compress (cinfo);
+
+  g_free (cinfo);
+  g_free (row);
+}
+
+/* Encodes a stripe of the round, called by gimp_parallel_run() */
+static void
+jpeg_parallel_stripe_func (gint                 stripe,
+                           gint                 n_stripes,
+                           gint                 thread,
+                           JpegParallelContext *ctx)
+{
+  jpeg_parallel_encode_stripe (ctx, &ctx->stripes[stripe]);
+}
+
+/* Returns the offset of the entropy-coded data in a complete file, or
+ * 0 if there is none.  The segments before it, other than the APPn
+ * and COM markers, are appended to header if it isn't NULL, with the
+ * height of the frame set to height.
+ */
+static guint
+jpeg_parallel_find_scan (GByteArray *data,
+                         GByteArray *header,
+                         gint        height)
+{
+  guint pos = 2;  /* after SOI */
+
+  while (pos + 4 <= data->len && data->data[pos] == 0xff)
+    {
+      guchar marker = data->data[pos + 1];
+      guint  length = ((data->data[pos + 2] << 8) | data->data[pos + 3]) + 2;
+
+      if (pos + length > data->len)
+        return 0;
+
+      if (header                                              &&
+          ! (marker >= JPEG_APP0 && marker <= JPEG_APP0 + 15) &&
+          marker != JPEG_COM)
+        {
+          guint start = header->len;
+
+          g_byte_array_append (header, data->data + pos, length);
+
+          if (marker >= JPEG_PARALLEL_SOF0 && marker <= JPEG_PARALLEL_SOF2)
+            {
+              header->data[start + 5] = (height >> 8) & 0xff;
+              header->data[start + 6] = height & 0xff;
+            }
+        }
+
+      pos += length;
+
+      if (marker == JPEG_PARALLEL_SOS)
+        return pos;
+    }
+
+  return 0;
+}
+
+/* Renumbers the restart markers of a stripe whose first interval is
+ * the given one of the whole image
+ */
+static void
+jpeg_parallel_renumber (guchar *scan,
+                        guint   length,
+                        gint    first_interval)
+{
+  guint i;
+
+  /*  0xff in the data itself is always followed by a stuffed 0x00  */
+  for (i = 0; i + 1 < length; i++)
+    {
+      if (scan[i] == 0xff &&
+          scan[i + 1] >= JPEG_RST0 && scan[i + 1] <= JPEG_RST0 + 7)
+        {
+          scan[i + 1] = JPEG_RST0 + ((scan[i + 1] - JPEG_RST0 +
+                                      first_interval) & 7);
+          i++;
+        }
+    }
+}
+
+gboolean
+jpeg_parallel_save (j_compress_ptr  cinfo,
+                    GimpPixelRgn   *pixel_rgn,
+                    gboolean        has_alpha,
+                    FILE           *outfile,
+                    gboolean        show_progress)
+{
+  JpegParallelContext  ctx;
+  JpegParallelDest    *dest = (JpegParallelDest *) cinfo->dest;
+  GByteArray          *header;
+  const guchar         eoi[2] = { 0xff, JPEG_EOI };
+  gint                 n_threads = gimp_parallel_get_n_threads ();
+  gint                 n_round;
+  gint                 interval_height;
+  gint                 stripe_height;
+  gint                 n_stripes;
+  gint                 first;
+  gint                 interval  = 0;
+  gboolean             success   = TRUE;
+  gint                 i;
+
+  g_return_val_if_fail (dest->pub.init_destination ==
+                        jpeg_parallel_init_destination, FALSE);
+
+  /*  the markers written so far, SOI and the APPn and COM markers  */
+  jpeg_parallel_term_destination (cinfo);
+  header = dest->data;
+
+  interval_height = cinfo->restart_in_rows * jpeg_parallel_get_mcu_height (cinfo);
+  stripe_height   = interval_height * MAX (1, (JPEG_PARALLEL_STRIPE_HEIGHT /
+                                               interval_height));
+  n_stripes       = (cinfo->image_height + stripe_height - 1) / stripe_height;
+
+  ctx.cinfo     = cinfo;
+  ctx.bpp       = pixel_rgn->bpp;
+  ctx.has_alpha = has_alpha;
+  ctx.stripes   = g_new0 (JpegParallelStripe, n_threads);
+
+  /*  the pixels can only be read on this thread, so the stripes are
+   *  done a round of n_threads at a time
+   */
+  for (first = 0; first < n_stripes && success; first += n_threads)
+    {
+      n_round = MIN (n_threads, n_stripes - first);
+
+      for (i = 0; i < n_round; i++)
+        {
+          JpegParallelStripe *stripe = &ctx.stripes[i];
+          gint                y      = (first + i) * stripe_height;
+
+          stripe->height = MIN (stripe_height, cinfo->image_height - y);
+          stripe->pixels = g_new (guchar, (cinfo->image_width * ctx.bpp *
+                                           stripe->height));
+          stripe->data   = NULL;
+          stripe->failed = FALSE;
+
+          gimp_pixel_rgn_get_rect (pixel_rgn, stripe->pixels,
+                                   0, y, cinfo->image_width, stripe->height);
+        }
+
+      gimp_parallel_run (n_round,
+                         (GimpParallelFunc) jpeg_parallel_stripe_func, &ctx,
+                         FALSE);
+
+      for (i = 0; i < n_round; i++)
+        {
+          JpegParallelStripe *stripe = &ctx.stripes[i];
+
+          if (success && stripe->failed)
+            {
+              g_message ("%s", stripe->message);
+              success = FALSE;
+            }
+
+          if (success)
+            {
+              guint scan;
+
+              if (first + i == 0)
+                {
+                  scan = jpeg_parallel_find_scan (stripe->data, header,
+                                                  cinfo->image_height);
+
+                  fwrite (header->data, 1, header->len, outfile);
+                }
+              else
+                {
+                  const guchar rst[2] = { 0xff,
+                                          JPEG_RST0 + ((interval - 1) & 7) };
+
+                  scan = jpeg_parallel_find_scan (stripe->data, NULL, 0);
+
+                  fwrite (rst, 1, sizeof (rst), outfile);
+                }
+
+              /*  the scan ends with EOI  */
+              if (scan == 0 || scan + 2 > stripe->data->len)
+                {
+                  g_warning ("jpeg-save: could not find the scan of a stripe");
+                  success = FALSE;
+                }
+              else
+                {
+                  jpeg_parallel_renumber (stripe->data->data + scan,
+                                          stripe->data->len - scan - 2,
+                                          interval);
+
+                  fwrite (stripe->data->data + scan,
+                          1, stripe->data->len - scan - 2, outfile);
+                }
+
+              interval += ((stripe->height + interval_height - 1) /
+                           interval_height);
+            }
+
+          g_free (stripe->pixels);
+
+          if (stripe->data)
+            g_byte_array_free (stripe->data, TRUE);
+        }
+
+      if (show_progress)
+        gimp_progress_update ((gdouble) (first + n_round) /
+                              (gdouble) n_stripes);
+    }
+
+  if (success)
+    fwrite (eoi, 1, sizeof (eoi), outfile);
+
+  g_byte_array_free (header, TRUE);
+  dest->data = NULL;
+
+  g_free (ctx.stripes);
+
+  return success && ! ferror (outfile);
+}
@@ -0,0 +1,43 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __JPEG_PARALLEL_H__
+#define __JPEG_PARALLEL_H__
+
+/*
+ * Saving in parallel works for sequential images with restart markers:
+ *
+ * 1. After setting the compression parameters, check that
+ *    jpeg_parallel_possible() returns TRUE, and install the parallel
+ *    destination with jpeg_parallel_dest().
+ *
+ * 2. Call jpeg_start_compress() and write any markers as usual.
+ *
+ * 3. Instead of writing the scanlines, call jpeg_parallel_save(), which
+ *    encodes stripes of whole restart intervals on several threads and
+ *    writes the complete file to outfile, and then destroy cinfo.
+ */
+
+gboolean jpeg_parallel_possible (j_compress_ptr  cinfo);
+void     jpeg_parallel_dest     (j_compress_ptr  cinfo);
+gboolean jpeg_parallel_save     (j_compress_ptr  cinfo,
+                                 GimpPixelRgn   *pixel_rgn,
+                                 gboolean        has_alpha,
+                                 FILE           *outfile,
+                                 gboolean        show_progress);
+
+#endif /* __JPEG_PARALLEL_H__ */
@@ -45,6 +45,7 @@
 #include "jpeg.h"
 #include "jpeg-icc.h"
 #include "jpeg-load.h"
+#include "jpeg-parallel.h"
 #include "jpeg-save.h"
 #include "jpeg-settings.h"
 #ifdef HAVE_LIBEXIF
@@ -164,6 +165,39 @@ background_error_exit (j_common_ptr cinfo)
   (*cinfo->err->output_message) (cinfo);
 }
 
+/* Shows the size of a saved preview file and loads it, then removes it */
+static void
+preview_show_file (const gchar *file_name,
+                   gboolean     saved)
+{
+  /* display the preview stuff */
+  if (saved)
+    {
+      struct stat  buf;
+      gchar       *text;
+      gchar       *size_text;
+
+      g_stat (file_name, &buf);
+
+      size_text = g_format_size (buf.st_size);
+      text = g_strdup_printf (_("File size: %s"), size_text);
+
+      gtk_label_set_text (GTK_LABEL (preview_size), text);
+
+      g_free (text);
+      g_free (size_text);
+
+      /* and load the preview */
+      load_image (file_name, GIMP_RUN_NONINTERACTIVE, TRUE, 0, NULL);
+    }
+
+  /* we cleanup here (load_image doesn't run in the background) */
+  g_unlink (file_name);
+
+  gimp_displays_flush ();
+  gdk_flush ();
+}
+
 static gboolean
 background_jpeg_save (PreviewPersistent *pp)
 {
@@ -193,36 +227,11 @@ background_jpeg_save (PreviewPersistent *pp)
       if (pp->drawable)
         gimp_drawable_detach (pp->drawable);
 
-      /* display the preview stuff */
-      if (!pp->abort_me)
-        {
-          struct stat  buf;
-          gchar       *text;
-          gchar       *size_text;
-
-          g_stat (pp->file_name, &buf);
-
-          size_text = g_format_size (buf.st_size);
-          text = g_strdup_printf (_("File size: %s"), size_text);
-
-          gtk_label_set_text (GTK_LABEL (preview_size), text);
-
-          g_free (text);
-          g_free (size_text);
-
-          /* and load the preview */
-          load_image (pp->file_name, GIMP_RUN_NONINTERACTIVE, TRUE, NULL);
-        }
-
-      /* we cleanup here (load_image doesn't run in the background) */
-      g_unlink (pp->file_name);
+      preview_show_file (pp->file_name, ! pp->abort_me);
 
       g_free (pp);
       prev_p = NULL;
 
-      gimp_displays_flush ();
-      gdk_flush ();
-
       return FALSE;
     }
   else
@@ -277,6 +286,7 @@ save_image (const gchar  *filename,
   guchar   *data;
   guchar   *src, *s;
   gboolean  has_alpha;
+  gboolean  parallel;
   gint      rowstride, yend;
   gint      i, j;
 
@@ -506,6 +516,15 @@ save_image (const gchar  *filename,
       }
   }
 
+  /* Sequential images with restart markers are encoded in stripes on
+   * several threads, which is also fast enough to do the preview in one
+   * go.  The markers are collected in memory until then.
+   */
+  parallel = jpeg_parallel_possible (&cinfo);
+
+  if (parallel)
+    jpeg_parallel_dest (&cinfo);
+
   /* Step 4: Start compressor */
 
   /* TRUE ensures that we will write a complete interchange-JPEG file.
@@ -639,6 +658,26 @@ save_image (const gchar  *filename,
       gimp_parasite_free (parasite);
     }
 
+  if (parallel)
+    {
+      gboolean success;
+
+      success = jpeg_parallel_save (&cinfo, &pixel_rgn, has_alpha, outfile,
+                                    ! preview);
+
+      fclose (outfile);
+      jpeg_destroy_compress (&cinfo);
+
+      gimp_drawable_detach (drawable);
+
+      if (preview)
+        preview_show_file (filename, success);
+      else
+        gimp_progress_update (1.0);
+
+      return success;
+    }
+
   /* Step 5: while (scan lines remain to be written) */
   /*           jpeg_write_scanlines(...); */
 
@@ -96,6 +96,14 @@ query (void)
     { GIMP_PDB_IMAGE,   "image",         "Output image" }
   };
 
+  static const GimpParamDef load_scaled_args[] =
+  {
+    { GIMP_PDB_INT32,    "run-mode",     "The run mode { RUN-INTERACTIVE (0), RUN-NONINTERACTIVE (1) }" },
+    { GIMP_PDB_STRING,   "filename",     "The name of the file to load" },
+    { GIMP_PDB_STRING,   "raw-filename", "The name of the file to load" },
+    { GIMP_PDB_INT32,    "size",         "The size the larger side of the image needs at least (0 = full size)" }
+  };
+
 #ifdef HAVE_LIBEXIF
 
   static const GimpParamDef thumb_args[] =
@@ -149,11 +157,30 @@ query (void)
                                     "",
                                     "6,string,JFIF,6,string,Exif");
 
+  gimp_install_procedure (LOAD_SCALED_PROC,
+                          "loads files in the JPEG file format at a reduced size",
+                          "Like file-jpeg-load, but lets the decoder scale "
+                          "the image down by 2, 4 or 8, as much as possible "
+                          "while the larger side stays at least 'size' "
+                          "pixels. This skips most of the decoding work "
+                          "when the image is going to be scaled down anyway.",
+                          "Spencer Kimball, Peter Mattis & others",
+                          "Spencer Kimball & Peter Mattis",
+                          "2016",
+                          NULL,
+                          NULL,
+                          GIMP_PLUGIN,
+                          G_N_ELEMENTS (load_scaled_args),
+                          G_N_ELEMENTS (load_return_vals),
+                          load_scaled_args, load_return_vals);
+
 #ifdef HAVE_LIBEXIF
 
   gimp_install_procedure (LOAD_THUMB_PROC,
                           "Loads a thumbnail from a JPEG image",
-                          "Loads a thumbnail from a JPEG image (only if it exists)",
+                          "Loads the thumbnail embedded in a JPEG image, "
+                          "or decodes the image at a reduced size if there "
+                          "is none or it is smaller than thumb-size",
                           "Mukund Sivaraman <muks@mukund.org>, Sven Neumann <sven@gimp.org>",
                           "Mukund Sivaraman <muks@mukund.org>, Sven Neumann <sven@gimp.org>",
                           "November 15, 2004",
@@ -217,9 +244,26 @@ run (const gchar      *name,
   orig_quality = 0;
   orig_subsmp = JPEG_SUBSAMPLING_2x2_1x1_1x1;
   num_quant_tables = 0;
+  undo_touched = FALSE;
+
+  /*  everything above is reset with every call, so the process can
+   *  serve the next one and keep its CMYK transforms
+   */
+  gimp_resident_enable ();
 
-  if (strcmp (name, LOAD_PROC) == 0)
+  if (strcmp (name, LOAD_PROC) == 0 ||
+      strcmp (name, LOAD_SCALED_PROC) == 0)
     {
+      gint size = 0;
+
+      if (strcmp (name, LOAD_SCALED_PROC) == 0)
+        {
+          if (nparams < 4)
+            status = GIMP_PDB_CALLING_ERROR;
+          else
+            size = MAX (param[3].data.d_int32, 0);
+        }
+
       switch (run_mode)
         {
         case GIMP_RUN_INTERACTIVE:
@@ -232,19 +276,22 @@ run (const gchar      *name,
           break;
         }
 
-      image_ID = load_image (param[1].data.d_string, run_mode, FALSE, &error);
-
-      if (image_ID != -1)
-        {
-          *nreturn_vals = 2;
-          values[1].type         = GIMP_PDB_IMAGE;
-          values[1].data.d_image = image_ID;
-        }
-      else
+      if (status == GIMP_PDB_SUCCESS)
         {
-          status = GIMP_PDB_EXECUTION_ERROR;
-        }
+          image_ID = load_image (param[1].data.d_string, run_mode, FALSE,
+                                 size, &error);
 
+          if (image_ID != -1)
+            {
+              *nreturn_vals = 2;
+              values[1].type         = GIMP_PDB_IMAGE;
+              values[1].data.d_image = image_ID;
+            }
+          else
+            {
+              status = GIMP_PDB_EXECUTION_ERROR;
+            }
+        }
     }
 
 #ifdef HAVE_LIBEXIF
@@ -262,8 +309,8 @@ run (const gchar      *name,
           gint          height   = 0;
           GimpImageType type     = -1;
 
-          image_ID = load_thumbnail_image (filename, &width, &height, &type,
-                                           &error);
+          image_ID = load_thumbnail_image (filename, param[1].data.d_int32,
+                                           &width, &height, &type, &error);
 
           if (image_ID != -1)
             {
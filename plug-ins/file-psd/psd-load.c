@@ -37,6 +37,30 @@
 
 #define COMP_MODE_SIZE sizeof(guint16)
 
+#define MAX_DECODER_THREADS 16
+
+
+/* The channel data of a layer, read from the file, then decoded */
+typedef struct
+{
+  PSDchannel  **lyr_chn;
+  gchar       **chn_src;              /* Channel data from the file */
+  guint16      *chn_comp_mode;
+  guint16     **chn_rle_pack_len;
+  guint16       num_channels;
+  guint16       bps;
+  gboolean      empty;
+  gboolean      empty_mask;
+  gboolean      decoded;
+  GError       *error;
+} PSDlayerdata;
+
+typedef struct
+{
+  GMutex        mutex;
+  GCond         cond;
+} PSDlayerdecoder;
+
 
 /*  Local function prototypes  */
 static gint             read_header_block          (PSDimage     *img_a,
@@ -52,6 +76,7 @@ static gint             read_image_resource_block  (PSDimage     *img_a,
                                                     GError      **error);
 
 static PSDlayer **      read_layer_block           (PSDimage     *img_a,
+                                                    gboolean      merged_image_only,
                                                     FILE         *f,
                                                     GError      **error);
 
@@ -76,6 +101,30 @@ static gint             add_layers                 (const gint32  image_id,
                                                     FILE         *f,
                                                     GError      **error);
 
+static gint             read_layer_channels        (PSDimage      *img_a,
+                                                    PSDlayer      *lyr_a,
+                                                    PSDlayerdata  *lyr_data,
+                                                    FILE          *f,
+                                                    GError       **error);
+
+static void             decode_layer_channels      (PSDlayerdata    *lyr_data,
+                                                    PSDlayerdecoder *decoder);
+
+static void             free_layer_data            (PSDlayerdata  *lyr_data);
+
+static gint             add_decoded_layer          (const gint32   image_id,
+                                                    PSDimage      *img_a,
+                                                    PSDlayer      *lyr_a,
+                                                    PSDlayerdata  *lyr_data,
+                                                    GArray        *parent_group_stack,
+                                                    GError       **error);
+
+static void             add_layer                  (const gint32   image_id,
+                                                    PSDimage      *img_a,
+                                                    PSDlayer      *lyr_a,
+                                                    PSDlayerdata  *lyr_data,
+                                                    GArray        *parent_group_stack);
+
 static gint             add_merged_image           (const gint32  image_id,
                                                     PSDimage     *img_a,
                                                     FILE         *f,
@@ -89,6 +138,11 @@ static void             psd_to_gimp_color_map      (guchar       *map256);
 static GimpImageType    get_gimp_image_type        (const GimpImageBaseType image_base_type,
                                                     const gboolean          alpha);
 
+static gint             get_channel_readline_len   (PSDchannel     *channel,
+                                                    const guint16   bps,
+                                                    guint32        *readline_len,
+                                                    GError        **error);
+
 static gint             read_channel_data          (PSDchannel     *channel,
                                                     const guint16   bps,
                                                     const guint16   compression,
@@ -96,6 +150,13 @@ static gint             read_channel_data          (PSDchannel     *channel,
                                                     FILE           *f,
                                                     GError        **error);
 
+static gint             decode_channel_data        (PSDchannel     *channel,
+                                                    const guint16   bps,
+                                                    const guint16   compression,
+                                                    const guint16  *rle_pack_len,
+                                                    const gchar    *src,
+                                                    GError        **error);
+
 static void             convert_16_bit             (const gchar *src,
                                                     gchar       *dst,
                                                     guint32      len);
@@ -109,6 +170,7 @@ static void             convert_1_bit              (const gchar *src,
 /* Main file load function */
 gint32
 load_image (const gchar  *filename,
+            gboolean      merged_image_only,
             GError      **load_error)
 {
   FILE                 *f;
@@ -155,7 +217,7 @@ load_image (const gchar  *filename,
 
   /* ----- Read the PSD file Layer & Mask block ----- */
   IFDBG(2) g_debug ("Read layer & mask block");
-  lyr_a = read_layer_block (&img_a, f, &error);
+  lyr_a = read_layer_block (&img_a, merged_image_only, f, &error);
   if (img_a.num_layers != 0 && lyr_a == NULL)
     goto load_error;
   gimp_progress_update (0.4);
@@ -464,6 +526,7 @@ read_image_resource_block (PSDimage  *img_a,
 
 static PSDlayer **
 read_layer_block (PSDimage  *img_a,
+                  gboolean   merged_image_only,
                   FILE      *f,
                   GError   **error)
 {
@@ -516,6 +579,23 @@ read_layer_block (PSDimage  *img_a,
           img_a->num_layers = -img_a->num_layers;
         }
 
+      /* Only the merged image is wanted, skip the layer records and
+       * their channel data, add_merged_image() then treats the file as
+       * a Photoshop 2 style one
+       */
+      if (merged_image_only && img_a->num_layers)
+        {
+          IFDBG(2) g_debug ("Skip %d layers", img_a->num_layers);
+          img_a->num_layers = 0;
+
+          if (fseek (f, block_end, SEEK_SET) < 0)
+            {
+              psd_set_error (feof (f), errno, error);
+              img_a->num_layers = -1;
+            }
+          return NULL;
+        }
+
       if (img_a->num_layers)
         {
           /* Read layer records */
@@ -1006,21 +1086,257 @@ add_image_resources (const gint32  image_id,
 }
 
 static gint
-add_layers (const gint32  image_id,
-            PSDimage     *img_a,
-            PSDlayer    **lyr_a,
-            FILE         *f,
-            GError      **error)
+read_layer_channels (PSDimage      *img_a,
+                     PSDlayer      *lyr_a,
+                     PSDlayerdata  *lyr_data,
+                     FILE          *f,
+                     GError       **error)
 {
-  PSDchannel          **lyr_chn;
-  GArray               *parent_group_stack;
-  gint32                parent_group_id = -1;
+  PSDchannel **lyr_chn;
+  guint32      readline_len;
+  guint32      src_len;
+  gint         cidx;                  /* Channel index */
+  gint         rowi;                  /* Row index */
+
+  /* Empty layer */
+  if (lyr_a->bottom - lyr_a->top == 0
+      || lyr_a->right - lyr_a->left == 0)
+      lyr_data->empty = TRUE;
+  else
+      lyr_data->empty = FALSE;
+
+  /* Empty mask */
+  if (lyr_a->layer_mask.bottom - lyr_a->layer_mask.top == 0
+      || lyr_a->layer_mask.right - lyr_a->layer_mask.left == 0)
+      lyr_data->empty_mask = TRUE;
+  else
+      lyr_data->empty_mask = FALSE;
+
+  IFDBG(3) g_debug ("Empty mask %d, size %d %d", lyr_data->empty_mask,
+                    lyr_a->layer_mask.bottom - lyr_a->layer_mask.top,
+                    lyr_a->layer_mask.right - lyr_a->layer_mask.left);
+
+  /* Load layer channel data */
+  IFDBG(2) g_debug ("Number of channels: %d", lyr_a->num_channels);
+  /* Create pointer array for the channel records */
+  lyr_chn = g_new (PSDchannel *, lyr_a->num_channels);
+
+  lyr_data->lyr_chn          = lyr_chn;
+  lyr_data->num_channels     = lyr_a->num_channels;
+  lyr_data->bps              = img_a->bps;
+  lyr_data->chn_src          = g_new0 (gchar *, lyr_a->num_channels);
+  lyr_data->chn_comp_mode    = g_new0 (guint16, lyr_a->num_channels);
+  lyr_data->chn_rle_pack_len = g_new0 (guint16 *, lyr_a->num_channels);
+
+  for (cidx = 0; cidx < lyr_a->num_channels; ++cidx)
+    {
+      guint16 comp_mode = PSD_COMP_RAW;
+
+      /* Allocate channel record */
+      lyr_chn[cidx] = g_malloc0 (sizeof (PSDchannel) );
+
+      lyr_chn[cidx]->id = lyr_a->chn_info[cidx].channel_id;
+      lyr_chn[cidx]->rows = lyr_a->bottom - lyr_a->top;
+      lyr_chn[cidx]->columns = lyr_a->right - lyr_a->left;
+
+      if (lyr_chn[cidx]->id == PSD_CHANNEL_MASK)
+        {
+          /* Works around a bug in panotools psd files where the layer mask
+             size is given as 0 but data exists. Set mask size to layer size.
+          */
+          if (lyr_data->empty_mask && lyr_a->chn_info[cidx].data_len - 2 > 0)
+            {
+              lyr_data->empty_mask = FALSE;
+              if (lyr_a->layer_mask.top == lyr_a->layer_mask.bottom)
+                {
+                  lyr_a->layer_mask.top = lyr_a->top;
+                  lyr_a->layer_mask.bottom = lyr_a->bottom;
+                }
+              if (lyr_a->layer_mask.right == lyr_a->layer_mask.left)
+                {
+                  lyr_a->layer_mask.right = lyr_a->right;
+                  lyr_a->layer_mask.left = lyr_a->left;
+                }
+            }
+          lyr_chn[cidx]->rows = (lyr_a->layer_mask.bottom -
+                                lyr_a->layer_mask.top);
+          lyr_chn[cidx]->columns = (lyr_a->layer_mask.right -
+                                   lyr_a->layer_mask.left);
+        }
+
+      IFDBG(3) g_debug ("Channel id %d, %dx%d",
+                        lyr_chn[cidx]->id,
+                        lyr_chn[cidx]->columns,
+                        lyr_chn[cidx]->rows);
+
+      /* Only read channel data if there is any channel
+       * data. Note that the channel data can contain a
+       * compression method but no actual data.
+       */
+      if (lyr_a->chn_info[cidx].data_len >= COMP_MODE_SIZE)
+        {
+          if (fread (&comp_mode, COMP_MODE_SIZE, 1, f) < 1)
+            {
+              psd_set_error (feof (f), errno, error);
+              return -1;
+            }
+          comp_mode = GUINT16_FROM_BE (comp_mode);
+          IFDBG(3) g_debug ("Compression mode: %d", comp_mode);
+        }
+      if (lyr_a->chn_info[cidx].data_len > COMP_MODE_SIZE)
+        {
+          if (get_channel_readline_len (lyr_chn[cidx], img_a->bps,
+                                        &readline_len, error) < 1)
+            return -1;
+
+          switch (comp_mode)
+            {
+              case PSD_COMP_RAW:        /* Planar raw data */
+                IFDBG(3) g_debug ("Raw data length: %d",
+                                  lyr_a->chn_info[cidx].data_len - 2);
+                src_len = readline_len * lyr_chn[cidx]->rows;
+                break;
+
+              case PSD_COMP_RLE:        /* Packbits */
+                IFDBG(3) g_debug ("RLE channel length %d, RLE length data: %d, "
+                                  "RLE data block: %d",
+                                  lyr_a->chn_info[cidx].data_len - 2,
+                                  lyr_chn[cidx]->rows * 2,
+                                  (lyr_a->chn_info[cidx].data_len - 2 -
+                                   lyr_chn[cidx]->rows * 2));
+                lyr_data->chn_rle_pack_len[cidx] =
+                  g_malloc (lyr_chn[cidx]->rows * 2);
+                src_len = 0;
+                for (rowi = 0; rowi < lyr_chn[cidx]->rows; ++rowi)
+                  {
+                    guint16 *rle_pack_len = lyr_data->chn_rle_pack_len[cidx];
+
+                    if (fread (&rle_pack_len[rowi], 2, 1, f) < 1)
+                      {
+                        psd_set_error (feof (f), errno, error);
+                        return -1;
+                      }
+                    rle_pack_len[rowi] = GUINT16_FROM_BE (rle_pack_len[rowi]);
+                    src_len += rle_pack_len[rowi];
+                  }
+                break;
+
+              case PSD_COMP_ZIP:                 /* ? */
+              case PSD_COMP_ZIP_PRED:
+              default:
+                g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                            _("Unsupported compression mode: %d"), comp_mode);
+                return -1;
+                break;
+            }
+
+          /* The data is decoded later, maybe on another thread */
+          lyr_data->chn_comp_mode[cidx] = comp_mode;
+          lyr_data->chn_src[cidx] = g_malloc (MAX (src_len, 1));
+
+          if (src_len > 0 && fread (lyr_data->chn_src[cidx], src_len, 1, f) < 1)
+            {
+              psd_set_error (feof (f), errno, error);
+              return -1;
+            }
+        }
+    }
+  g_free (lyr_a->chn_info);
+
+  return 0;
+}
+
+/* Decodes the channels read by read_layer_channels(), runs on the
+ * decoder threads
+ */
+static void
+decode_layer_channels (PSDlayerdata    *lyr_data,
+                       PSDlayerdecoder *decoder)
+{
+  GError *error = NULL;
+  gint    cidx;
+
+  for (cidx = 0; cidx < lyr_data->num_channels && ! error; ++cidx)
+    {
+      if (lyr_data->chn_src[cidx])
+        {
+          decode_channel_data (lyr_data->lyr_chn[cidx], lyr_data->bps,
+                               lyr_data->chn_comp_mode[cidx],
+                               lyr_data->chn_rle_pack_len[cidx],
+                               lyr_data->chn_src[cidx], &error);
+
+          g_free (lyr_data->chn_src[cidx]);
+          g_free (lyr_data->chn_rle_pack_len[cidx]);
+          lyr_data->chn_src[cidx]          = NULL;
+          lyr_data->chn_rle_pack_len[cidx] = NULL;
+        }
+    }
+
+  g_mutex_lock (&decoder->mutex);
+
+  lyr_data->error   = error;
+  lyr_data->decoded = TRUE;
+
+  g_cond_broadcast (&decoder->cond);
+  g_mutex_unlock (&decoder->mutex);
+}
+
+static void
+free_layer_data (PSDlayerdata *lyr_data)
+{
+  gint cidx;
+
+  for (cidx = 0; cidx < lyr_data->num_channels; ++cidx)
+    {
+      g_free (lyr_data->chn_src[cidx]);
+      g_free (lyr_data->chn_rle_pack_len[cidx]);
+    }
+
+  g_free (lyr_data->chn_src);
+  g_free (lyr_data->chn_comp_mode);
+  g_free (lyr_data->chn_rle_pack_len);
+}
+
+static gint
+add_decoded_layer (const gint32   image_id,
+                   PSDimage      *img_a,
+                   PSDlayer      *lyr_a,
+                   PSDlayerdata  *lyr_data,
+                   GArray        *parent_group_stack,
+                   GError       **error)
+{
+  if (lyr_data->error)
+    {
+      g_propagate_error (error, lyr_data->error);
+      lyr_data->error = NULL;
+      return -1;
+    }
+
+  if (! lyr_a->drop)
+    {
+      add_layer (image_id, img_a, lyr_a, lyr_data, parent_group_stack);
+      free_layer_data (lyr_data);
+    }
+
+  g_free (lyr_a);
+
+  return 0;
+}
+
+static void
+add_layer (const gint32   image_id,
+           PSDimage      *img_a,
+           PSDlayer      *lyr_a,
+           PSDlayerdata  *lyr_data,
+           GArray        *parent_group_stack)
+{
+  PSDchannel          **lyr_chn = lyr_data->lyr_chn;
+  gint32                parent_group_id;
   guchar               *pixels;
   guint16               alpha_chn;
   guint16               user_mask_chn;
   guint16               layer_channels;
   guint16               channel_idx[MAX_CHANNELS];
-  guint16              *rle_pack_len;
   gint32                l_x;                   /* Layer x */
   gint32                l_y;                   /* Layer y */
   gint32                l_w;                   /* Layer width */
@@ -1032,20 +1348,296 @@ add_layers (const gint32  image_id,
   gint32                layer_size;
   gint32                layer_id = -1;
   gint32                mask_id = -1;
-  gint                  lidx;                  /* Layer index */
   gint                  cidx;                  /* Channel index */
   gint                  rowi;                  /* Row index */
   gint                  coli;                  /* Column index */
   gint                  i;
   gboolean              alpha;
   gboolean              user_mask;
-  gboolean              empty;
-  gboolean              empty_mask;
   GimpDrawable         *drawable;
   GimpPixelRgn          pixel_rgn;
   GimpImageType         image_type;
   GimpLayerModeEffects  layer_mode;
 
+  if (lyr_a->group_type != 0)
+    {
+      if (lyr_a->group_type == 3)
+        {
+          /* the </Layer group> marker layers are used to
+             assemble the layer structure in a single pass */
+          layer_id = gimp_layer_group_new (image_id);
+        }
+      else /* group-type == 1 || group_type == 2 */
+        {
+          layer_id = g_array_index (parent_group_stack, gint32,
+                                    parent_group_stack->len-1);
+          /* since the layers are stored in reverse, the group
+             layer start marker actually means we're done with
+             that layer group */
+          g_array_remove_index (parent_group_stack,
+                                parent_group_stack->len-1);
+        }
+    }
+
+  /* Draw layer */
+
+  alpha = FALSE;
+  alpha_chn = -1;
+  user_mask = FALSE;
+  user_mask_chn = -1;
+  layer_channels = 0;
+  l_x = 0;
+  l_y = 0;
+  l_w = img_a->columns;
+  l_h = img_a->rows;
+  parent_group_id = g_array_index (parent_group_stack, gint32,
+                                   parent_group_stack->len-1);
+
+  IFDBG(3) g_debug ("Re-hash channel indices");
+  for (cidx = 0; cidx < lyr_a->num_channels; ++cidx)
+    {
+      if (lyr_chn[cidx]->id == PSD_CHANNEL_MASK)
+        {
+          user_mask = TRUE;
+          user_mask_chn = cidx;
+        }
+      else if (lyr_chn[cidx]->id == PSD_CHANNEL_ALPHA)
+        {
+          alpha = TRUE;
+          alpha_chn = cidx;
+        }
+      else
+        {
+          channel_idx[layer_channels] = cidx;   /* Assumes in sane order */
+          layer_channels++;                     /* RGB, Lab, CMYK etc.   */
+        }
+    }
+  if (alpha)
+    {
+      channel_idx[layer_channels] = alpha_chn;
+      layer_channels++;
+    }
+
+  if (lyr_a->group_type != 0)
+    {
+      if (lyr_a->group_type == 3)
+        {
+          IFDBG(2) g_debug ("Create placeholder group layer");
+          g_free (lyr_a->name);
+          gimp_image_insert_layer (image_id, layer_id, parent_group_id, 0);
+          /* add this group layer as the new parent */
+          g_array_append_val (parent_group_stack, layer_id);
+        }
+      else
+        {
+          IFDBG(2) g_debug ("End group layer id %d.", layer_id);
+          drawable = gimp_drawable_get (layer_id);
+          layer_mode = psd_to_gimp_blend_mode (lyr_a->blend_mode);
+          gimp_layer_set_mode (layer_id, layer_mode);
+          gimp_layer_set_opacity (layer_id, 
+                                  lyr_a->opacity * 100 / 255);
+          gimp_item_set_name (drawable->drawable_id, lyr_a->name);
+          g_free (lyr_a->name);
+          gimp_item_set_visible (drawable->drawable_id,
+                                 lyr_a->layer_flags.visible);
+          if (lyr_a->id)
+            gimp_item_set_tattoo (drawable->drawable_id,
+                                  lyr_a->id);
+          gimp_drawable_flush (drawable);
+          gimp_drawable_detach (drawable);
+        }
+    }
+  else if (lyr_data->empty)
+    {
+      IFDBG(2) g_debug ("Create blank layer");
+      image_type = get_gimp_image_type (img_a->base_type, TRUE);
+      layer_id = gimp_layer_new (image_id, lyr_a->name,
+                                 img_a->columns, img_a->rows,
+                                 image_type, 0, GIMP_NORMAL_MODE);
+      g_free (lyr_a->name);
+      gimp_image_insert_layer (image_id, layer_id, parent_group_id, -1);
+      drawable = gimp_drawable_get (layer_id);
+      gimp_drawable_fill (drawable->drawable_id, GIMP_TRANSPARENT_FILL);
+      gimp_item_set_visible (drawable->drawable_id, lyr_a->layer_flags.visible);
+      if (lyr_a->id)
+        gimp_item_set_tattoo (drawable->drawable_id, lyr_a->id);
+      if (lyr_a->layer_flags.irrelevant)
+        gimp_item_set_visible (drawable->drawable_id, FALSE);
+      gimp_drawable_flush (drawable);
+      gimp_drawable_detach (drawable);
+    }
+  else
+    {
+      l_x = lyr_a->left;
+      l_y = lyr_a->top;
+      l_w = lyr_a->right - lyr_a->left;
+      l_h = lyr_a->bottom - lyr_a->top;
+
+      IFDBG(3) g_debug ("Draw layer");
+      image_type = get_gimp_image_type (img_a->base_type, alpha);
+      IFDBG(3) g_debug ("Layer type %d", image_type);
+      layer_size = l_w * l_h;
+      pixels = g_malloc (layer_size * layer_channels);
+      for (cidx = 0; cidx < layer_channels; ++cidx)
+        {
+          IFDBG(3) g_debug ("Start channel %d", channel_idx[cidx]);
+          for (i = 0; i < layer_size; ++i)
+            pixels[(i * layer_channels) + cidx] = lyr_chn[channel_idx[cidx]]->data[i];
+          g_free (lyr_chn[channel_idx[cidx]]->data);
+        }
+
+      layer_mode = psd_to_gimp_blend_mode (lyr_a->blend_mode);
+      layer_id = gimp_layer_new (image_id, lyr_a->name, l_w, l_h,
+                                 image_type, lyr_a->opacity * 100 / 255,
+                                 layer_mode);
+      IFDBG(3) g_debug ("Layer tattoo: %d", layer_id);
+      g_free (lyr_a->name);
+      gimp_image_insert_layer (image_id, layer_id, parent_group_id, -1);
+      gimp_layer_set_offsets (layer_id, l_x, l_y);
+      gimp_layer_set_lock_alpha  (layer_id, lyr_a->layer_flags.trans_prot);
+      drawable = gimp_drawable_get (layer_id);
+      gimp_pixel_rgn_init (&pixel_rgn, drawable, 0, 0,
+                           drawable->width, drawable->height, TRUE, FALSE);
+      gimp_pixel_rgn_set_rect (&pixel_rgn, pixels,
+                               0, 0, drawable->width, drawable->height);
+      gimp_item_set_visible (drawable->drawable_id, lyr_a->layer_flags.visible);
+      if (lyr_a->id)
+        gimp_item_set_tattoo (drawable->drawable_id, lyr_a->id);
+      gimp_drawable_flush (drawable);
+      gimp_drawable_detach (drawable);
+      g_free (pixels);
+    }
+
+  /* Layer mask */
+  if (user_mask && lyr_a->group_type == 0)
+    {
+      if (lyr_data->empty_mask)
+        {
+          IFDBG(3) g_debug ("Create empty mask");
+          if (lyr_a->layer_mask.def_color == 255)
+            mask_id = gimp_layer_create_mask (layer_id, GIMP_ADD_WHITE_MASK);
+          else
+            mask_id = gimp_layer_create_mask (layer_id, GIMP_ADD_BLACK_MASK);
+          gimp_layer_add_mask (layer_id, mask_id);
+          gimp_layer_set_apply_mask (layer_id,
+            ! lyr_a->layer_mask.mask_flags.disabled);
+        }
+      else
+        {
+          /* Load layer mask data */
+          if (lyr_a->layer_mask.mask_flags.relative_pos)
+            {
+              lm_x = lyr_a->layer_mask.left;
+              lm_y = lyr_a->layer_mask.top;
+              lm_w = lyr_a->layer_mask.right - lyr_a->layer_mask.left;
+              lm_h = lyr_a->layer_mask.bottom - lyr_a->layer_mask.top;
+            }
+          else
+            {
+              lm_x = lyr_a->layer_mask.left - l_x;
+              lm_y = lyr_a->layer_mask.top - l_y;
+              lm_w = lyr_a->layer_mask.right - lyr_a->layer_mask.left;
+              lm_h = lyr_a->layer_mask.bottom - lyr_a->layer_mask.top;
+            }
+          IFDBG(3) g_debug ("Mask channel index %d", user_mask_chn);
+          IFDBG(3) g_debug ("Relative pos %d",
+                            lyr_a->layer_mask.mask_flags.relative_pos);
+          layer_size = lm_w * lm_h;
+          pixels = g_malloc (layer_size);
+          IFDBG(3) g_debug ("Allocate Pixels %d", layer_size);
+          /* Crop mask at layer boundry */
+          IFDBG(3) g_debug ("Original Mask %d %d %d %d", lm_x, lm_y, lm_w, lm_h);
+          if (lm_x < 0
+              || lm_y < 0
+              || lm_w + lm_x > l_w
+              || lm_h + lm_y > l_h)
+            {
+              if (CONVERSION_WARNINGS)
+                g_message ("Warning\n"
+                           "The layer mask is partly outside the "
+                           "layer boundary. The mask will be "
+                           "cropped which may result in data loss.");
+              i = 0;
+              for (rowi = 0; rowi < lm_h; ++rowi)
+                {
+                  if (rowi + lm_y >= 0 && rowi + lm_y < l_h)
+                    {
+                      for (coli = 0; coli < lm_w; ++coli)
+                        {
+                          if (coli + lm_x >= 0 && coli + lm_x < l_w)
+                            {
+                              pixels[i] =
+                                lyr_chn[user_mask_chn]->data[(rowi * lm_w) + coli];
+                              i++;
+                            }
+                        }
+                    }
+                }
+              if (lm_x < 0)
+                {
+                  lm_w += lm_x;
+                  lm_x = 0;
+                }
+              if (lm_y < 0)
+                {
+                  lm_h += lm_y;
+                  lm_y = 0;
+                }
+              if (lm_w + lm_x > l_w)
+                lm_w = l_w - lm_x;
+              if (lm_h + lm_y > l_h)
+                lm_h = l_h - lm_y;
+            }
+          else
+            memcpy (pixels, lyr_chn[user_mask_chn]->data, layer_size);
+          g_free (lyr_chn[user_mask_chn]->data);
+          /* Draw layer mask data */
+          IFDBG(3) g_debug ("Layer %d %d %d %d", l_x, l_y, l_w, l_h);
+          IFDBG(3) g_debug ("Mask %d %d %d %d", lm_x, lm_y, lm_w, lm_h);
+
+          if (lyr_a->layer_mask.def_color == 255)
+            mask_id = gimp_layer_create_mask (layer_id, GIMP_ADD_WHITE_MASK);
+          else
+            mask_id = gimp_layer_create_mask (layer_id, GIMP_ADD_BLACK_MASK);
+
+          IFDBG(3) g_debug ("New layer mask %d", mask_id);
+          gimp_layer_add_mask (layer_id, mask_id);
+          drawable = gimp_drawable_get (mask_id);
+          gimp_pixel_rgn_init (&pixel_rgn, drawable, 0 , 0,
+                               drawable->width, drawable->height, TRUE, FALSE);
+          gimp_pixel_rgn_set_rect (&pixel_rgn, pixels, lm_x, lm_y, lm_w, lm_h);
+          gimp_drawable_flush (drawable);
+          gimp_drawable_detach (drawable);
+          gimp_layer_set_apply_mask (layer_id,
+            ! lyr_a->layer_mask.mask_flags.disabled);
+          g_free (pixels);
+        }
+    }
+  for (cidx = 0; cidx < lyr_a->num_channels; ++cidx)
+    if (lyr_chn[cidx])
+      g_free (lyr_chn[cidx]);
+  g_free (lyr_chn);
+}
+
+static gint
+add_layers (const gint32  image_id,
+            PSDimage     *img_a,
+            PSDlayer    **lyr_a,
+            FILE         *f,
+            GError      **error)
+{
+  PSDlayerdecoder       decoder;
+  PSDlayerdata         *lyr_data;
+  GThreadPool          *pool = NULL;
+  GArray               *parent_group_stack;
+  gint32                parent_group_id = -1;
+  gint                  n_threads = 1;
+  gint                  max_pending;
+  gint                  next_layer = 0;        /* Next layer to add */
+  gint                  lidx;                  /* Layer index */
+  gint                  cidx;                  /* Channel index */
+  gint                  ret = 0;
+
 
   IFDBG(2) g_debug ("Number of layers: %d", img_a->num_layers);
 
@@ -1066,7 +1658,25 @@ add_layers (const gint32  image_id,
   parent_group_stack = g_array_new (FALSE, FALSE, sizeof(gint32));
   g_array_append_val (parent_group_stack, parent_group_id);
 
-  for (lidx = 0; lidx < img_a->num_layers; ++lidx)
+  /* The channel data is read here in file order and decoded on other
+   * threads, the layers are added on this thread, in order, as soon
+   * as their data is decoded.
+   */
+  n_threads = MIN (gimp_get_number_of_processors (), MAX_DECODER_THREADS);
+
+  g_mutex_init (&decoder.mutex);
+  g_cond_init (&decoder.cond);
+
+  if (n_threads > 1)
+    pool = g_thread_pool_new ((GFunc) decode_layer_channels, &decoder,
+                              n_threads, FALSE, NULL);
+
+  /* Don't read too far ahead of the layers that were added */
+  max_pending = 2 * n_threads;
+
+  lyr_data = g_new0 (PSDlayerdata, img_a->num_layers);
+
+  for (lidx = 0; lidx < img_a->num_layers && ret == 0; ++lidx)
     {
       IFDBG(2) g_debug ("Process Layer No %d.", lidx);
 
@@ -1080,403 +1690,73 @@ add_layers (const gint32  image_id,
               if (fseek (f, lyr_a[lidx]->chn_info[cidx].data_len, SEEK_CUR) < 0)
                 {
                   psd_set_error (feof (f), errno, error);
-                  return -1;
+                  ret = -1;
+                  break;
                 }
             }
           g_free (lyr_a[lidx]->chn_info);
           g_free (lyr_a[lidx]->name);
+
+          lyr_data[lidx].decoded = TRUE;
+        }
+      else if (read_layer_channels (img_a, lyr_a[lidx], &lyr_data[lidx],
+                                    f, error) < 0)
+        {
+          ret = -1;
+        }
+      else if (pool)
+        {
+          g_thread_pool_push (pool, &lyr_data[lidx], NULL);
         }
       else
         {
-          if (lyr_a[lidx]->group_type != 0)
-            {
-              if (lyr_a[lidx]->group_type == 3)
-                {
-                  /* the </Layer group> marker layers are used to
-                     assemble the layer structure in a single pass */
-                  layer_id = gimp_layer_group_new (image_id);
-                }
-              else /* group-type == 1 || group_type == 2 */
-                {
-                  layer_id = g_array_index (parent_group_stack, gint32,
-                                            parent_group_stack->len-1);
-                  /* since the layers are stored in reverse, the group
-                     layer start marker actually means we're done with
-                     that layer group */
-                  g_array_remove_index (parent_group_stack,
-                                        parent_group_stack->len-1);
-                }
-            }
+          decode_layer_channels (&lyr_data[lidx], &decoder);
+        }
 
-          /* Empty layer */
-          if (lyr_a[lidx]->bottom - lyr_a[lidx]->top == 0
-              || lyr_a[lidx]->right - lyr_a[lidx]->left == 0)
-              empty = TRUE;
-          else
-              empty = FALSE;
+      /* Add the layers that are done, and wait for the oldest one
+       * if too many are pending
+       */
+      while (ret == 0 && next_layer <= lidx)
+        {
+          PSDlayerdata *data = &lyr_data[next_layer];
 
-          /* Empty mask */
-          if (lyr_a[lidx]->layer_mask.bottom - lyr_a[lidx]->layer_mask.top == 0
-              || lyr_a[lidx]->layer_mask.right - lyr_a[lidx]->layer_mask.left == 0)
-              empty_mask = TRUE;
-          else
-              empty_mask = FALSE;
+          gboolean      decoded;
 
-          IFDBG(3) g_debug ("Empty mask %d, size %d %d", empty_mask,
-                            lyr_a[lidx]->layer_mask.bottom - lyr_a[lidx]->layer_mask.top,
-                            lyr_a[lidx]->layer_mask.right - lyr_a[lidx]->layer_mask.left);
+          g_mutex_lock (&decoder.mutex);
 
-          /* Load layer channel data */
-          IFDBG(2) g_debug ("Number of channels: %d", lyr_a[lidx]->num_channels);
-          /* Create pointer array for the channel records */
-          lyr_chn = g_new (PSDchannel *, lyr_a[lidx]->num_channels);
-          for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
-            {
-              guint16 comp_mode = PSD_COMP_RAW;
+          while (! data->decoded && lidx - next_layer >= max_pending)
+            g_cond_wait (&decoder.cond, &decoder.mutex);
 
-              /* Allocate channel record */
-              lyr_chn[cidx] = g_malloc (sizeof (PSDchannel) );
+          decoded = data->decoded;
 
-              lyr_chn[cidx]->id = lyr_a[lidx]->chn_info[cidx].channel_id;
-              lyr_chn[cidx]->rows = lyr_a[lidx]->bottom - lyr_a[lidx]->top;
-              lyr_chn[cidx]->columns = lyr_a[lidx]->right - lyr_a[lidx]->left;
+          g_mutex_unlock (&decoder.mutex);
 
-              if (lyr_chn[cidx]->id == PSD_CHANNEL_MASK)
-                {
-                  /* Works around a bug in panotools psd files where the layer mask
-                     size is given as 0 but data exists. Set mask size to layer size.
-                  */
-                  if (empty_mask && lyr_a[lidx]->chn_info[cidx].data_len - 2 > 0)
-                    {
-                      empty_mask = FALSE;
-                      if (lyr_a[lidx]->layer_mask.top == lyr_a[lidx]->layer_mask.bottom)
-                        {
-                          lyr_a[lidx]->layer_mask.top = lyr_a[lidx]->top;
-                          lyr_a[lidx]->layer_mask.bottom = lyr_a[lidx]->bottom;
-                        }
-                      if (lyr_a[lidx]->layer_mask.right == lyr_a[lidx]->layer_mask.left)
-                        {
-                          lyr_a[lidx]->layer_mask.right = lyr_a[lidx]->right;
-                          lyr_a[lidx]->layer_mask.left = lyr_a[lidx]->left;
-                        }
-                    }
-                  lyr_chn[cidx]->rows = (lyr_a[lidx]->layer_mask.bottom -
-                                        lyr_a[lidx]->layer_mask.top);
-                  lyr_chn[cidx]->columns = (lyr_a[lidx]->layer_mask.right -
-                                           lyr_a[lidx]->layer_mask.left);
-                }
+          if (! decoded)
+            break;
 
-              IFDBG(3) g_debug ("Channel id %d, %dx%d",
-                                lyr_chn[cidx]->id,
-                                lyr_chn[cidx]->columns,
-                                lyr_chn[cidx]->rows);
+          ret = add_decoded_layer (image_id, img_a, lyr_a[next_layer], data,
+                                   parent_group_stack, error);
+          next_layer++;
+        }
+    }
 
-              /* Only read channel data if there is any channel
-               * data. Note that the channel data can contain a
-               * compression method but no actual data.
-               */
-              if (lyr_a[lidx]->chn_info[cidx].data_len >= COMP_MODE_SIZE)
-                {
-                  if (fread (&comp_mode, COMP_MODE_SIZE, 1, f) < 1)
-                    {
-                      psd_set_error (feof (f), errno, error);
-                      return -1;
-                    }
-                  comp_mode = GUINT16_FROM_BE (comp_mode);
-                  IFDBG(3) g_debug ("Compression mode: %d", comp_mode);
-                }
-              if (lyr_a[lidx]->chn_info[cidx].data_len > COMP_MODE_SIZE)
-                {
-                  switch (comp_mode)
-                    {
-                      case PSD_COMP_RAW:        /* Planar raw data */
-                        IFDBG(3) g_debug ("Raw data length: %d",
-                                          lyr_a[lidx]->chn_info[cidx].data_len - 2);
-                        if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                            PSD_COMP_RAW, NULL, f, error) < 1)
-                          return -1;
-                        break;
-
-                      case PSD_COMP_RLE:        /* Packbits */
-                        IFDBG(3) g_debug ("RLE channel length %d, RLE length data: %d, "
-                                          "RLE data block: %d",
-                                          lyr_a[lidx]->chn_info[cidx].data_len - 2,
-                                          lyr_chn[cidx]->rows * 2,
-                                          (lyr_a[lidx]->chn_info[cidx].data_len - 2 -
-                                           lyr_chn[cidx]->rows * 2));
-                        rle_pack_len = g_malloc (lyr_chn[cidx]->rows * 2);
-                        for (rowi = 0; rowi < lyr_chn[cidx]->rows; ++rowi)
-                          {
-                            if (fread (&rle_pack_len[rowi], 2, 1, f) < 1)
-                              {
-                                psd_set_error (feof (f), errno, error);
-                                g_free (rle_pack_len);
-                                return -1;
-                              }
-                            rle_pack_len[rowi] = GUINT16_FROM_BE (rle_pack_len[rowi]);
-                          }
-
-                        IFDBG(3) g_debug ("RLE decode - data");
-                        if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                            PSD_COMP_RLE, rle_pack_len, f, error) < 1)
-                          return -1;
-
-                        g_free (rle_pack_len);
-                        break;
-
-                      case PSD_COMP_ZIP:                 /* ? */
-                      case PSD_COMP_ZIP_PRED:
-                      default:
-                        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                                    _("Unsupported compression mode: %d"), comp_mode);
-                        return -1;
-                        break;
-                    }
-                }
-            }
-          g_free (lyr_a[lidx]->chn_info);
+  /* Wait for the decoder threads */
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
 
-          /* Draw layer */
-
-          alpha = FALSE;
-          alpha_chn = -1;
-          user_mask = FALSE;
-          user_mask_chn = -1;
-          layer_channels = 0;
-          l_x = 0;
-          l_y = 0;
-          l_w = img_a->columns;
-          l_h = img_a->rows;
-          parent_group_id = g_array_index (parent_group_stack, gint32,
-                                           parent_group_stack->len-1);
-
-          IFDBG(3) g_debug ("Re-hash channel indices");
-          for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
-            {
-              if (lyr_chn[cidx]->id == PSD_CHANNEL_MASK)
-                {
-                  user_mask = TRUE;
-                  user_mask_chn = cidx;
-                }
-              else if (lyr_chn[cidx]->id == PSD_CHANNEL_ALPHA)
-                {
-                  alpha = TRUE;
-                  alpha_chn = cidx;
-                }
-              else
-                {
-                  channel_idx[layer_channels] = cidx;   /* Assumes in sane order */
-                  layer_channels++;                     /* RGB, Lab, CMYK etc.   */
-                }
-            }
-          if (alpha)
-            {
-              channel_idx[layer_channels] = alpha_chn;
-              layer_channels++;
-            }
+  for (; ret == 0 && next_layer < img_a->num_layers; next_layer++)
+    ret = add_decoded_layer (image_id, img_a, lyr_a[next_layer],
+                             &lyr_data[next_layer], parent_group_stack,
+                             error);
 
-          if (lyr_a[lidx]->group_type != 0)
-            {
-              if (lyr_a[lidx]->group_type == 3)
-                {
-                  IFDBG(2) g_debug ("Create placeholder group layer");
-                  g_free (lyr_a[lidx]->name);
-                  gimp_image_insert_layer (image_id, layer_id, parent_group_id, 0);
-                  /* add this group layer as the new parent */
-                  g_array_append_val (parent_group_stack, layer_id);
-                }
-              else
-                {
-                  IFDBG(2) g_debug ("End group layer id %d.", layer_id);
-                  drawable = gimp_drawable_get (layer_id);
-                  layer_mode = psd_to_gimp_blend_mode (lyr_a[lidx]->blend_mode);
-                  gimp_layer_set_mode (layer_id, layer_mode);
-                  gimp_layer_set_opacity (layer_id, 
-                                          lyr_a[lidx]->opacity * 100 / 255);
-                  gimp_item_set_name (drawable->drawable_id, lyr_a[lidx]->name);
-                  g_free (lyr_a[lidx]->name);
-                  gimp_item_set_visible (drawable->drawable_id,
-                                         lyr_a[lidx]->layer_flags.visible);
-                  if (lyr_a[lidx]->id)
-                    gimp_item_set_tattoo (drawable->drawable_id,
-                                          lyr_a[lidx]->id);
-                  gimp_drawable_flush (drawable);
-                  gimp_drawable_detach (drawable);
-                }
-            }
-          else if (empty)
-            {
-              IFDBG(2) g_debug ("Create blank layer");
-              image_type = get_gimp_image_type (img_a->base_type, TRUE);
-              layer_id = gimp_layer_new (image_id, lyr_a[lidx]->name,
-                                         img_a->columns, img_a->rows,
-                                         image_type, 0, GIMP_NORMAL_MODE);
-              g_free (lyr_a[lidx]->name);
-              gimp_image_insert_layer (image_id, layer_id, parent_group_id, -1);
-              drawable = gimp_drawable_get (layer_id);
-              gimp_drawable_fill (drawable->drawable_id, GIMP_TRANSPARENT_FILL);
-              gimp_item_set_visible (drawable->drawable_id, lyr_a[lidx]->layer_flags.visible);
-              if (lyr_a[lidx]->id)
-                gimp_item_set_tattoo (drawable->drawable_id, lyr_a[lidx]->id);
-              if (lyr_a[lidx]->layer_flags.irrelevant)
-                gimp_item_set_visible (drawable->drawable_id, FALSE);
-              gimp_drawable_flush (drawable);
-              gimp_drawable_detach (drawable);
-            }
-          else
-            {
-              l_x = lyr_a[lidx]->left;
-              l_y = lyr_a[lidx]->top;
-              l_w = lyr_a[lidx]->right - lyr_a[lidx]->left;
-              l_h = lyr_a[lidx]->bottom - lyr_a[lidx]->top;
-
-              IFDBG(3) g_debug ("Draw layer");
-              image_type = get_gimp_image_type (img_a->base_type, alpha);
-              IFDBG(3) g_debug ("Layer type %d", image_type);
-              layer_size = l_w * l_h;
-              pixels = g_malloc (layer_size * layer_channels);
-              for (cidx = 0; cidx < layer_channels; ++cidx)
-                {
-                  IFDBG(3) g_debug ("Start channel %d", channel_idx[cidx]);
-                  for (i = 0; i < layer_size; ++i)
-                    pixels[(i * layer_channels) + cidx] = lyr_chn[channel_idx[cidx]]->data[i];
-                  g_free (lyr_chn[channel_idx[cidx]]->data);
-                }
+  g_mutex_clear (&decoder.mutex);
+  g_cond_clear (&decoder.cond);
 
-              layer_mode = psd_to_gimp_blend_mode (lyr_a[lidx]->blend_mode);
-              layer_id = gimp_layer_new (image_id, lyr_a[lidx]->name, l_w, l_h,
-                                         image_type, lyr_a[lidx]->opacity * 100 / 255,
-                                         layer_mode);
-              IFDBG(3) g_debug ("Layer tattoo: %d", layer_id);
-              g_free (lyr_a[lidx]->name);
-              gimp_image_insert_layer (image_id, layer_id, parent_group_id, -1);
-              gimp_layer_set_offsets (layer_id, l_x, l_y);
-              gimp_layer_set_lock_alpha  (layer_id, lyr_a[lidx]->layer_flags.trans_prot);
-              drawable = gimp_drawable_get (layer_id);
-              gimp_pixel_rgn_init (&pixel_rgn, drawable, 0, 0,
-                                   drawable->width, drawable->height, TRUE, FALSE);
-              gimp_pixel_rgn_set_rect (&pixel_rgn, pixels,
-                                       0, 0, drawable->width, drawable->height);
-              gimp_item_set_visible (drawable->drawable_id, lyr_a[lidx]->layer_flags.visible);
-              if (lyr_a[lidx]->id)
-                gimp_item_set_tattoo (drawable->drawable_id, lyr_a[lidx]->id);
-              gimp_drawable_flush (drawable);
-              gimp_drawable_detach (drawable);
-              g_free (pixels);
-            }
+  g_free (lyr_data);
+
+  if (ret < 0)
+    return -1;
 
-          /* Layer mask */
-          if (user_mask && lyr_a[lidx]->group_type == 0)
-            {
-              if (empty_mask)
-                {
-                  IFDBG(3) g_debug ("Create empty mask");
-                  if (lyr_a[lidx]->layer_mask.def_color == 255)
-                    mask_id = gimp_layer_create_mask (layer_id, GIMP_ADD_WHITE_MASK);
-                  else
-                    mask_id = gimp_layer_create_mask (layer_id, GIMP_ADD_BLACK_MASK);
-                  gimp_layer_add_mask (layer_id, mask_id);
-                  gimp_layer_set_apply_mask (layer_id,
-                    ! lyr_a[lidx]->layer_mask.mask_flags.disabled);
-                }
-              else
-                {
-                  /* Load layer mask data */
-                  if (lyr_a[lidx]->layer_mask.mask_flags.relative_pos)
-                    {
-                      lm_x = lyr_a[lidx]->layer_mask.left;
-                      lm_y = lyr_a[lidx]->layer_mask.top;
-                      lm_w = lyr_a[lidx]->layer_mask.right - lyr_a[lidx]->layer_mask.left;
-                      lm_h = lyr_a[lidx]->layer_mask.bottom - lyr_a[lidx]->layer_mask.top;
-                    }
-                  else
-                    {
-                      lm_x = lyr_a[lidx]->layer_mask.left - l_x;
-                      lm_y = lyr_a[lidx]->layer_mask.top - l_y;
-                      lm_w = lyr_a[lidx]->layer_mask.right - lyr_a[lidx]->layer_mask.left;
-                      lm_h = lyr_a[lidx]->layer_mask.bottom - lyr_a[lidx]->layer_mask.top;
-                    }
-                  IFDBG(3) g_debug ("Mask channel index %d", user_mask_chn);
-                  IFDBG(3) g_debug ("Relative pos %d",
-                                    lyr_a[lidx]->layer_mask.mask_flags.relative_pos);
-                  layer_size = lm_w * lm_h;
-                  pixels = g_malloc (layer_size);
-                  IFDBG(3) g_debug ("Allocate Pixels %d", layer_size);
-                  /* Crop mask at layer boundry */
-                  IFDBG(3) g_debug ("Original Mask %d %d %d %d", lm_x, lm_y, lm_w, lm_h);
-                  if (lm_x < 0
-                      || lm_y < 0
-                      || lm_w + lm_x > l_w
-                      || lm_h + lm_y > l_h)
-                    {
-                      if (CONVERSION_WARNINGS)
-                        g_message ("Warning\n"
-                                   "The layer mask is partly outside the "
-                                   "layer boundary. The mask will be "
-                                   "cropped which may result in data loss.");
-                      i = 0;
-                      for (rowi = 0; rowi < lm_h; ++rowi)
-                        {
-                          if (rowi + lm_y >= 0 && rowi + lm_y < l_h)
-                            {
-                              for (coli = 0; coli < lm_w; ++coli)
-                                {
-                                  if (coli + lm_x >= 0 && coli + lm_x < l_w)
-                                    {
-                                      pixels[i] =
-                                        lyr_chn[user_mask_chn]->data[(rowi * lm_w) + coli];
-                                      i++;
-                                    }
-                                }
-                            }
-                        }
-                      if (lm_x < 0)
-                        {
-                          lm_w += lm_x;
-                          lm_x = 0;
-                        }
-                      if (lm_y < 0)
-                        {
-                          lm_h += lm_y;
-                          lm_y = 0;
-                        }
-                      if (lm_w + lm_x > l_w)
-                        lm_w = l_w - lm_x;
-                      if (lm_h + lm_y > l_h)
-                        lm_h = l_h - lm_y;
-                    }
-                  else
-                    memcpy (pixels, lyr_chn[user_mask_chn]->data, layer_size);
-                  g_free (lyr_chn[user_mask_chn]->data);
-                  /* Draw layer mask data */
-                  IFDBG(3) g_debug ("Layer %d %d %d %d", l_x, l_y, l_w, l_h);
-                  IFDBG(3) g_debug ("Mask %d %d %d %d", lm_x, lm_y, lm_w, lm_h);
-
-                  if (lyr_a[lidx]->layer_mask.def_color == 255)
-                    mask_id = gimp_layer_create_mask (layer_id, GIMP_ADD_WHITE_MASK);
-                  else
-                    mask_id = gimp_layer_create_mask (layer_id, GIMP_ADD_BLACK_MASK);
-
-                  IFDBG(3) g_debug ("New layer mask %d", mask_id);
-                  gimp_layer_add_mask (layer_id, mask_id);
-                  drawable = gimp_drawable_get (mask_id);
-                  gimp_pixel_rgn_init (&pixel_rgn, drawable, 0 , 0,
-                                       drawable->width, drawable->height, TRUE, FALSE);
-                  gimp_pixel_rgn_set_rect (&pixel_rgn, pixels, lm_x, lm_y, lm_w, lm_h);
-                  gimp_drawable_flush (drawable);
-                  gimp_drawable_detach (drawable);
-                  gimp_layer_set_apply_mask (layer_id,
-                    ! lyr_a[lidx]->layer_mask.mask_flags.disabled);
-                  g_free (pixels);
-                }
-            }
-          for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
-            if (lyr_chn[cidx])
-              g_free (lyr_chn[cidx]);
-          g_free (lyr_chn);
-        }
-      g_free (lyr_a[lidx]);
-    }
   g_free (lyr_a);
   g_array_free (parent_group_stack, FALSE);
 
@@ -1852,26 +2132,18 @@ get_gimp_image_type (const GimpImageBaseType image_base_type,
 }
 
 static gint
-read_channel_data (PSDchannel     *channel,
-                   const guint16   bps,
-                   const guint16   compression,
-                   const guint16  *rle_pack_len,
-                   FILE           *f,
-                   GError        **error)
+get_channel_readline_len (PSDchannel     *channel,
+                          const guint16   bps,
+                          guint32        *readline_len,
+                          GError        **error)
 {
-  gchar    *raw_data;
-  gchar    *src;
-  gchar    *dst;
-  guint32   readline_len;
-  gint      i;
-
   if (bps == 1)
-    readline_len = ((channel->columns + 7) >> 3);
+    *readline_len = ((channel->columns + 7) >> 3);
   else
-    readline_len = (channel->columns * bps >> 3);
+    *readline_len = (channel->columns * bps >> 3);
 
-  IFDBG(3) g_debug ("raw data size %d x %d = %d", readline_len,
-                    channel->rows, readline_len * channel->rows);
+  IFDBG(3) g_debug ("raw data size %d x %d = %d", *readline_len,
+                    channel->rows, *readline_len * channel->rows);
 
   /* sanity check, int overflow check (avoid divisions by zero) */
   if ((channel->rows == 0) || (channel->columns == 0) ||
@@ -1882,41 +2154,93 @@ read_channel_data (PSDchannel     *channel,
       return -1;
     }
 
-  raw_data = g_malloc (readline_len * channel->rows);
+  return 1;
+}
+
+static gint
+read_channel_data (PSDchannel     *channel,
+                   const guint16   bps,
+                   const guint16   compression,
+                   const guint16  *rle_pack_len,
+                   FILE           *f,
+                   GError        **error)
+{
+  gchar    *src;
+  guint32   readline_len;
+  guint32   src_len = 0;
+  gint      i;
+  gint      ret;
+
+  if (get_channel_readline_len (channel, bps, &readline_len, error) < 1)
+    return -1;
+
   switch (compression)
     {
       case PSD_COMP_RAW:
-        if (fread (raw_data, readline_len, channel->rows, f) < 1)
-          {
-            psd_set_error (feof (f), errno, error);
-            return -1;
-          }
+        src_len = readline_len * channel->rows;
         break;
 
       case PSD_COMP_RLE:
         for (i = 0; i < channel->rows; ++i)
-          {
-            src = g_malloc (rle_pack_len[i]);
-            dst = g_malloc (readline_len);
+          src_len += rle_pack_len[i];
+        break;
+    }
+
 /*      FIXME check for over-run
-            if (ftell (f) + rle_pack_len[i] > block_end)
+            if (ftell (f) + src_len > block_end)
               {
                 psd_set_error (TRUE, errno, error);
                 return -1;
               }
 */
-            if (fread (src, rle_pack_len[i], 1, f) < 1)
-              {
-                psd_set_error (feof (f), errno, error);
-                g_free (src);
-                g_free (dst);
-                return -1;
-              }
+  src = g_malloc (MAX (src_len, 1));
+
+  if (src_len > 0 && fread (src, src_len, 1, f) < 1)
+    {
+      psd_set_error (feof (f), errno, error);
+      g_free (src);
+      return -1;
+    }
+
+  ret = decode_channel_data (channel, bps, compression, rle_pack_len,
+                             src, error);
+  g_free (src);
+
+  return ret;
+}
+
+/* Decodes channel data that was read from the file, doesn't use any
+ * PDB calls so it can run on any thread
+ */
+static gint
+decode_channel_data (PSDchannel     *channel,
+                     const guint16   bps,
+                     const guint16   compression,
+                     const guint16  *rle_pack_len,
+                     const gchar    *src,
+                     GError        **error)
+{
+  gchar    *raw_data;
+  guint32   readline_len;
+  gint      i;
+
+  if (get_channel_readline_len (channel, bps, &readline_len, error) < 1)
+    return -1;
+
+  raw_data = g_malloc (readline_len * channel->rows);
+  switch (compression)
+    {
+      case PSD_COMP_RAW:
+        memcpy (raw_data, src, readline_len * channel->rows);
+        break;
+
+      case PSD_COMP_RLE:
+        for (i = 0; i < channel->rows; ++i)
+          {
             /* FIXME check for errors returned from decode packbits */
-            decode_packbits (src, dst, rle_pack_len[i], readline_len);
-            g_free (src);
-            memcpy (raw_data + i * readline_len, dst, readline_len);
-            g_free (dst);
+            decode_packbits (src, raw_data + i * readline_len,
+                             rle_pack_len[i], readline_len);
+            src += rle_pack_len[i];
           }
         break;
     }
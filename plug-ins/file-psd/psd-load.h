@@ -23,6 +23,7 @@
 
 
 gint32  load_image (const gchar  *filename,
+                    gboolean      merged_image_only,
                     GError      **error);
 
 
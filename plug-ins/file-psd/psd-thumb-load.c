@@ -29,6 +29,7 @@
 #include "psd.h"
 #include "psd-util.h"
 #include "psd-image-res-load.h"
+#include "psd-load.h"
 #include "psd-thumb-load.h"
 
 #include "libgimp/stdplugins-intl.h"
@@ -65,6 +66,7 @@ load_thumbnail_image (const gchar  *filename,
   struct stat  st;
   PSDimage     img_a;
   gint32       image_id = -1;
+  gint         status;
   GError      *error    = NULL;
 
   /* ----- Open PSD file ----- */
@@ -110,8 +112,27 @@ load_thumbnail_image (const gchar  *filename,
 
   /* ----- Add image resources ----- */
   IFDBG(2) g_debug ("Add image resources");
-  if (add_image_resources (image_id, &img_a, f, &error) < 1)
+  status = add_image_resources (image_id, &img_a, f, &error);
+  if (status < 0)
     goto load_error;
+
+  /* No embedded thumbnail, fall back to the merged image, which is
+   * still much faster to load than the layers
+   */
+  if (status == 0)
+    {
+      IFDBG(2) g_debug ("No thumbnail resource, load merged image");
+      gimp_image_delete (image_id);
+      fclose (f);
+
+      image_id = load_image (filename, TRUE, load_error);
+      if (image_id < 0)
+        return -1;
+
+      *width = img_a.columns;
+      *height = img_a.rows;
+      return image_id;
+    }
   gimp_progress_update (1.0);
 
   gimp_image_clean_all (image_id);
@@ -140,6 +140,24 @@ query (void)
 
   gimp_register_thumbnail_loader (LOAD_PROC, LOAD_THUMB_PROC);
 
+  /* Merged image load */
+  gimp_install_procedure (LOAD_MERGED_PROC,
+                          "Loads the merged image of a Photoshop PSD file",
+                          "This plug-in loads only the merged (composite) "
+                          "image of an Adobe Photoshop (TM) PSD file, as a "
+                          "single layer. The layers are skipped without "
+                          "being read, which is much faster for previews "
+                          "and for flattening the file.",
+                          "John Marshall",
+                          "John Marshall",
+                          "2007",
+                          NULL,
+                          NULL,
+                          GIMP_PLUGIN,
+                          G_N_ELEMENTS (load_args),
+                          G_N_ELEMENTS (load_return_vals),
+                          load_args, load_return_vals);
+
 #ifdef PSD_SAVE
   /* File save*/
   gimp_install_procedure (SAVE_PROC,
@@ -185,9 +203,12 @@ run (const gchar      *name,
   values[0].data.d_status = GIMP_PDB_EXECUTION_ERROR;
 
   /* File load */
-  if (strcmp (name, LOAD_PROC) == 0)
+  if (strcmp (name, LOAD_PROC) == 0 ||
+      strcmp (name, LOAD_MERGED_PROC) == 0)
     {
-      image_ID = load_image (param[1].data.d_string, &error);
+      image_ID = load_image (param[1].data.d_string,
+                             strcmp (name, LOAD_MERGED_PROC) == 0,
+                             &error);
 
       if (image_ID != -1)
         {
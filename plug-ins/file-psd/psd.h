@@ -39,6 +39,7 @@
 
 #define LOAD_PROC                       "file-psd-load"
 #define LOAD_THUMB_PROC                 "file-psd-load-thumb"
+#define LOAD_MERGED_PROC                "file-psd-load-merged"
 #define SAVE_PROC                       "file-psd-save"
 #define PLUG_IN_BINARY                  "file-psd"
 #define PLUG_IN_ROLE                    "gimp-file-psd"
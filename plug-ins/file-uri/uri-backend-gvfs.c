@@ -173,6 +173,32 @@ uri_backend_map_image (const gchar  *uri,
   return path;
 }
 
+gchar *
+uri_backend_get_etag (const gchar  *uri,
+                      GimpRunMode   run_mode)
+{
+  GFile     *file = g_file_new_for_uri (uri);
+  GFileInfo *info;
+  gchar     *etag = NULL;
+
+  if (! file)
+    return NULL;
+
+  info = g_file_query_info (file, G_FILE_ATTRIBUTE_ETAG_VALUE,
+                            G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+  if (info)
+    {
+      etag = g_strdup (g_file_info_get_etag (info));
+
+      g_object_unref (info);
+    }
+
+  g_object_unref (file);
+
+  return etag;
+}
+
 
 /*  private functions  */
 
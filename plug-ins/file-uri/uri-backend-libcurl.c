@@ -142,6 +142,36 @@ progress_callback (void   *clientp,
 }
 
 
+/*  picks the ETag out of the response headers, after redirects only
+ *  the one of the last response counts
+ */
+static size_t
+header_callback (void   *ptr,
+                 size_t  size,
+                 size_t  nmemb,
+                 void   *data)
+{
+  gchar       **etag   = data;
+  const gchar  *header = ptr;
+  gsize         len    = size * nmemb;
+
+  if (len > 5 && ! g_ascii_strncasecmp (header, "HTTP/", 5))
+    {
+      g_free (*etag);
+      *etag = NULL;
+    }
+  else if (len > 5 && ! g_ascii_strncasecmp (header, "ETag:", 5))
+    {
+      gchar *value = g_strndup (header + 5, len - 5);
+
+      g_free (*etag);
+      *etag = g_strstrip (value);
+    }
+
+  return len;
+}
+
+
 gboolean
 uri_backend_load_image (const gchar  *uri,
                         const gchar  *tmpname,
@@ -273,3 +303,36 @@ uri_backend_map_image (const gchar  *uri,
 {
   return NULL;
 }
+
+gchar *
+uri_backend_get_etag (const gchar  *uri,
+                      GimpRunMode   run_mode)
+{
+  CURL  *curl_handle;
+  gchar *etag = NULL;
+  glong  response_code;
+
+  curl_handle = curl_easy_init ();
+  curl_easy_setopt (curl_handle, CURLOPT_URL, uri);
+  curl_easy_setopt (curl_handle, CURLOPT_NOBODY, TRUE);
+  curl_easy_setopt (curl_handle, CURLOPT_HEADERFUNCTION, header_callback);
+  curl_easy_setopt (curl_handle, CURLOPT_HEADERDATA, &etag);
+  curl_easy_setopt (curl_handle, CURLOPT_USERAGENT, user_agent);
+
+  curl_easy_setopt (curl_handle, CURLOPT_FOLLOWLOCATION, TRUE);
+  curl_easy_setopt (curl_handle, CURLOPT_MAXREDIRS, 10);
+  curl_easy_setopt (curl_handle, CURLOPT_SSL_VERIFYPEER, FALSE);
+
+  if (curl_easy_perform (curl_handle) != 0 ||
+      curl_easy_getinfo (curl_handle, CURLINFO_RESPONSE_CODE,
+                         &response_code) != 0 ||
+      response_code != 200)
+    {
+      g_free (etag);
+      etag = NULL;
+    }
+
+  curl_easy_cleanup (curl_handle);
+
+  return etag;
+}
@@ -452,3 +452,10 @@ uri_backend_map_image (const gchar  *uri,
 {
   return NULL;
 }
+
+gchar *
+uri_backend_get_etag (const gchar  *uri,
+                      GimpRunMode   run_mode)
+{
+  return NULL;
+}
@@ -41,6 +41,8 @@ gboolean      uri_backend_save_image         (const gchar  *uri,
                                               GError      **error);
 gchar       * uri_backend_map_image          (const gchar  *uri,
                                               GimpRunMode   run_mode);
+gchar       * uri_backend_get_etag           (const gchar  *uri,
+                                              GimpRunMode   run_mode);
 
 
 #endif /* __URI_BACKEND_H__ */
@@ -0,0 +1,259 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * Local cache of the files downloaded by the URI plug-in
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Downloaded files are kept in the "uricache" folder of the user's
+ *  gimp directory, named after the MD5 of their URI. Next to each is
+ *  a ".etag" file with the entity tag the server sent for it, a cached
+ *  file is only used while the server still reports that tag. The
+ *  least recently used files are dropped when the cache grows beyond
+ *  URI_CACHE_MAX_SIZE.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include <libgimp/gimp.h>
+
+#include "uri-cache.h"
+
+
+#define URI_CACHE_MAX_SIZE  ((goffset) 1 << 30)
+#define URI_CACHE_ETAG_EXT  ".etag"
+
+
+typedef struct
+{
+  gchar   *path;
+  gchar   *etag_path;
+  time_t   atime;
+  goffset  size;
+} CacheEntry;
+
+
+static gchar * uri_cache_get_path (const gchar *uri,
+                                   const gchar *extension,
+                                   gchar      **etag_path);
+static void    uri_cache_prune    (goffset      max_size);
+
+
+/*  public functions  */
+
+gchar *
+uri_cache_lookup (const gchar *uri,
+                  const gchar *etag,
+                  const gchar *extension)
+{
+  gchar       *etag_path;
+  gchar       *path   = uri_cache_get_path (uri, extension, &etag_path);
+  gchar       *cached = NULL;
+  struct stat  buf;
+
+  if (g_file_get_contents (etag_path, &cached, NULL, NULL) &&
+      strcmp (cached, etag) == 0                           &&
+      g_stat (path, &buf) == 0 && buf.st_size > 0)
+    {
+      /*  mark it as recently used  */
+      g_utime (etag_path, NULL);
+    }
+  else
+    {
+      g_free (path);
+      path = NULL;
+    }
+
+  g_free (cached);
+  g_free (etag_path);
+
+  return path;
+}
+
+gchar *
+uri_cache_store (const gchar *uri,
+                 const gchar *etag,
+                 const gchar *extension,
+                 const gchar *tmpname)
+{
+  gchar       *etag_path;
+  gchar       *path = uri_cache_get_path (uri, extension, &etag_path);
+  gchar       *dir  = g_path_get_dirname (path);
+  struct stat  buf;
+
+  if (g_stat (tmpname, &buf) != 0         ||
+      buf.st_size > URI_CACHE_MAX_SIZE / 2 ||
+      g_mkdir_with_parents (dir, 0700) != 0)
+    goto fail;
+
+  uri_cache_remove (uri, extension);
+  uri_cache_prune (URI_CACHE_MAX_SIZE - buf.st_size);
+
+  /*  the temp folder is in the gimp directory as well, so this is
+   *  usually just a rename
+   */
+  if (g_rename (tmpname, path) != 0)
+    goto fail;
+
+  if (! g_file_set_contents (etag_path, etag, -1, NULL))
+    {
+      g_rename (path, tmpname);
+      goto fail;
+    }
+
+  g_free (etag_path);
+  g_free (dir);
+
+  return path;
+
+ fail:
+  g_free (path);
+  g_free (etag_path);
+  g_free (dir);
+
+  return NULL;
+}
+
+void
+uri_cache_remove (const gchar *uri,
+                  const gchar *extension)
+{
+  gchar *etag_path;
+  gchar *path = uri_cache_get_path (uri, extension, &etag_path);
+
+  g_unlink (etag_path);
+  g_unlink (path);
+
+  g_free (path);
+  g_free (etag_path);
+}
+
+
+/*  private functions  */
+
+static gchar *
+uri_cache_get_path (const gchar  *uri,
+                    const gchar  *extension,
+                    gchar       **etag_path)
+{
+  gchar *checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+  gchar *name;
+  gchar *path;
+
+  name = g_strconcat (checksum, ".", extension, NULL);
+  path = g_build_filename (gimp_directory (), "uricache", name, NULL);
+  g_free (name);
+
+  name = g_strconcat (checksum, URI_CACHE_ETAG_EXT, NULL);
+  *etag_path = g_build_filename (gimp_directory (), "uricache", name, NULL);
+  g_free (name);
+
+  g_free (checksum);
+
+  return path;
+}
+
+static gint
+cache_entry_compare (const CacheEntry *a,
+                     const CacheEntry *b)
+{
+  return (a->atime > b->atime) - (a->atime < b->atime);
+}
+
+static void
+uri_cache_prune (goffset max_size)
+{
+  gchar       *dirname = g_build_filename (gimp_directory (), "uricache", NULL);
+  GDir        *dir     = g_dir_open (dirname, 0, NULL);
+  GSList      *entries = NULL;
+  GSList      *list;
+  goffset      total   = 0;
+  const gchar *name;
+
+  if (! dir)
+    {
+      g_free (dirname);
+      return;
+    }
+
+  /*  collect the cached files, with the time their ETag was last used  */
+  while ((name = g_dir_read_name (dir)))
+    {
+      CacheEntry  *entry;
+      struct stat  buf;
+      const gchar *ext;
+      gchar       *path;
+      gchar       *stem;
+
+      if (g_str_has_suffix (name, URI_CACHE_ETAG_EXT))
+        continue;
+
+      path = g_build_filename (dirname, name, NULL);
+
+      if (g_stat (path, &buf) != 0)
+        {
+          g_free (path);
+          continue;
+        }
+
+      ext  = strchr (name, '.');
+      stem = ext ? g_strndup (name, ext - name) : g_strdup (name);
+
+      entry = g_slice_new (CacheEntry);
+
+      entry->path      = path;
+      entry->etag_path = g_strconcat (dirname, G_DIR_SEPARATOR_S,
+                                      stem, URI_CACHE_ETAG_EXT, NULL);
+      entry->size      = buf.st_size;
+      entry->atime     = (g_stat (entry->etag_path, &buf) == 0 ?
+                          buf.st_mtime : 0);
+
+      g_free (stem);
+
+      total += entry->size;
+
+      entries = g_slist_prepend (entries, entry);
+    }
+
+  g_dir_close (dir);
+
+  entries = g_slist_sort (entries, (GCompareFunc) cache_entry_compare);
+
+  for (list = entries; list; list = g_slist_next (list))
+    {
+      CacheEntry *entry = list->data;
+
+      if (total > max_size)
+        {
+          g_unlink (entry->etag_path);
+          g_unlink (entry->path);
+
+          total -= entry->size;
+        }
+
+      g_free (entry->path);
+      g_free (entry->etag_path);
+      g_slice_free (CacheEntry, entry);
+    }
+
+  g_slist_free (entries);
+  g_free (dirname);
+}
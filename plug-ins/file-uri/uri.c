@@ -33,6 +33,7 @@
 #include <libgimp/gimpui.h>
 
 #include "uri-backend.h"
+#include "uri-cache.h"
 
 #include "libgimp/stdplugins-intl.h"
 
@@ -59,6 +60,7 @@ static GimpPDBStatusType   save_image    (const gchar      *uri,
                                           gint32            run_mode,
                                           GError          **error);
 
+static gchar             * get_extension (const gchar      *uri);
 static gchar             * get_temp_name (const gchar      *uri,
                                           gboolean         *name_image);
 static gboolean            valid_file    (const gchar      *filename);
@@ -238,7 +240,10 @@ load_image (const gchar  *uri,
   gint32    image_ID   = -1;
   gboolean  name_image = FALSE;
   gchar    *tmpname;
+  gchar    *etag       = NULL;
+  gchar    *ext        = NULL;
   gboolean  mapped     = FALSE;
+  gboolean  cached     = FALSE;
 
   tmpname = uri_backend_map_image (uri, run_mode);
 
@@ -248,10 +253,48 @@ load_image (const gchar  *uri,
     }
   else
     {
-      tmpname = get_temp_name (uri, &name_image);
+      /*  reuse an earlier download if the server still has the
+       *  same version of the file
+       */
+      ext  = get_extension (uri);
+      etag = uri_backend_get_etag (uri, run_mode);
 
-      if (! uri_backend_load_image (uri, tmpname, run_mode, error))
-        return -1;
+      if (etag)
+        tmpname = uri_cache_lookup (uri, etag, ext ? ext : "xxx");
+
+      if (tmpname)
+        {
+          cached     = TRUE;
+          name_image = (ext != NULL);
+        }
+      else
+        {
+          tmpname = get_temp_name (uri, &name_image);
+
+          if (! uri_backend_load_image (uri, tmpname, run_mode, error))
+            {
+              g_unlink (tmpname);
+              g_free (tmpname);
+              g_free (etag);
+              g_free (ext);
+
+              return -1;
+            }
+
+          if (etag)
+            {
+              gchar *cache_name = uri_cache_store (uri, etag,
+                                                   ext ? ext : "xxx",
+                                                   tmpname);
+
+              if (cache_name)
+                {
+                  g_free (tmpname);
+                  tmpname = cache_name;
+                  cached  = TRUE;
+                }
+            }
+        }
     }
 
   image_ID = gimp_file_load (run_mode, tmpname, tmpname);
@@ -267,12 +310,18 @@ load_image (const gchar  *uri,
     {
       g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                    "%s", gimp_get_pdb_error ());
+
+      /*  don't keep a file around that can't be loaded  */
+      if (cached)
+        uri_cache_remove (uri, ext ? ext : "xxx");
     }
 
-  if (! mapped)
+  if (! mapped && ! cached)
     g_unlink (tmpname);
 
   g_free (tmpname);
+  g_free (etag);
+  g_free (ext);
 
   return image_ID;
 }
@@ -320,31 +369,43 @@ save_image (const gchar  *uri,
   return status;
 }
 
+static gchar *
+get_extension (const gchar *uri)
+{
+  gchar *basename = g_path_get_basename (uri);
+  gchar *ext      = NULL;
+
+  if (basename)
+    {
+      gchar *dot = strchr (basename, '.');
+
+      if (dot && strlen (dot + 1))
+        ext = g_strdup (dot + 1);
+
+      g_free (basename);
+    }
+
+  return ext;
+}
+
 static gchar *
 get_temp_name (const gchar *uri,
                gboolean    *name_image)
 {
-  gchar *basename;
+  gchar *ext     = get_extension (uri);
   gchar *tmpname = NULL;
 
   if (name_image)
     *name_image = FALSE;
 
-  basename = g_path_get_basename (uri);
-
-  if (basename)
+  if (ext)
     {
-      gchar *ext = strchr (basename, '.');
-
-      if (ext && strlen (ext))
-        {
-          tmpname = gimp_temp_name (ext + 1);
+      tmpname = gimp_temp_name (ext);
 
-          if (name_image)
-            *name_image = TRUE;
-        }
+      if (name_image)
+        *name_image = TRUE;
 
-      g_free (basename);
+      g_free (ext);
     }
 
   if (! tmpname)
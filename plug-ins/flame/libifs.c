@@ -27,20 +27,21 @@
 
 #define CHOOSE_XFORM_GRAIN 100
 
-static int    flam3_random_bit (void);
-static double flam3_random01   (void);
+static double flam3_random01   (GRand *rand);
 
 /*
  * run the function system described by CP forward N generations.
  * store the n resulting 3 vectors in POINTS.  the initial point is passed
- * in POINTS[0].  ignore the first FUSE iterations.
+ * in POINTS[0].  ignore the first FUSE iterations.  all random numbers
+ * come from RAND, so threads with their own RAND can iterate in parallel.
  */
 
 void
 iterate (control_point *cp,
          int            n,
          int            fuse,
-         point         *points)
+         point         *points,
+         GRand         *rand)
 {
   int    i, j, count_large = 0, count_nan = 0;
   int    xform_distrib[CHOOSE_XFORM_GRAIN];
@@ -76,7 +77,7 @@ iterate (control_point *cp,
   for (i = -fuse; i < n; i++)
     {
       /* FIXME: the following is supported only by gcc and c99 */
-      int fn = xform_distrib[g_random_int_range (0, CHOOSE_XFORM_GRAIN)];
+      int fn = xform_distrib[g_rand_int_range (rand, 0, CHOOSE_XFORM_GRAIN)];
       double tx, ty, v;
 
       if (p[0] > 100.0 || p[0] < -100.0 ||
@@ -317,7 +318,7 @@ iterate (control_point *cp,
             theta = atan2 (tx, ty);
           else
             theta = 0.0;
-          if (flam3_random_bit ())
+          if (g_rand_boolean (rand))
             theta += G_PI;
           r2 = pow (tx * tx + ty * ty, 0.25);
           nx = r2 * cos (theta);
@@ -491,10 +492,10 @@ iterate (control_point *cp,
         {
           /* noise */
           double rx, sinr, cosr, nois;
-          rx = flam3_random01 () * 2 * G_PI;
+          rx = flam3_random01 (rand) * 2 * G_PI;
           sinr = sin (rx);
           cosr = cos (rx);
-          nois = flam3_random01 ();
+          nois = flam3_random01 (rand);
           p[0] += v * nois * tx * cosr;
           p[1] += v * nois * ty * sinr;
         }
@@ -504,10 +505,10 @@ iterate (control_point *cp,
         {
           /* blur */
           double rx, sinr, cosr, nois;
-          rx = flam3_random01 () * 2 * G_PI;
+          rx = flam3_random01 (rand) * 2 * G_PI;
           sinr = sin (rx);
           cosr = cos (rx);
-          nois = flam3_random01 ();
+          nois = flam3_random01 (rand);
           p[0] += v * nois * cosr;
           p[1] += v * nois * sinr;
         }
@@ -517,11 +518,11 @@ iterate (control_point *cp,
         {
           /* gaussian */
           double ang, sina, cosa, r2;
-          ang = flam3_random01 () * 2 * G_PI;
+          ang = flam3_random01 (rand) * 2 * G_PI;
           sina = sin (ang);
           cosa = cos (ang);
-          r2 = v * (flam3_random01 () + flam3_random01 () + flam3_random01 () +
-                    flam3_random01 () - 2.0);
+          r2 = v * (flam3_random01 (rand) + flam3_random01 (rand) + flam3_random01 (rand) +
+                    flam3_random01 (rand) - 2.0);
           p[0] += r2 * cosa;
           p[1] += r2 * sina;
         }
@@ -1210,7 +1211,9 @@ estimate_bounding_box (control_point *cp,
   int    high_target = batch - low_target;
   point  min, max, delta;
   point *points = malloc (sizeof (point) * batch);
-  iterate (cp, batch, 20, points);
+  GRand *rand = g_rand_new_with_seed (g_random_int ());
+  iterate (cp, batch, 20, points, rand);
+  g_rand_free (rand);
 
   min[0] = min[1] =  1e10;
   max[0] = max[1] = -1e10;
@@ -1289,26 +1292,8 @@ standard_metric (control_point *cp1,
   return dist;
 }
 
-static int
-flam3_random_bit (void)
-{
-  static int n = 0;
-  static int l;
-  if (n == 0)
-    {
-      l = g_random_int ();
-      n = 20;
-    }
-  else
-    {
-      l = l >> 1;
-      n--;
-    }
-  return l & 1;
-}
-
 static double
-flam3_random01 (void)
+flam3_random01 (GRand *rand)
 {
-  return (g_random_int () & 0xfffffff) / (double) 0xfffffff;
+  return (g_rand_int (rand) & 0xfffffff) / (double) 0xfffffff;
 }
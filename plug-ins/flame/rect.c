@@ -20,6 +20,8 @@
 
 #include <string.h>
 
+#include <libgimp/gimp.h>
+
 
 /* for batch
  *   interpolate
@@ -61,11 +63,38 @@ typedef accum_t abucket[4];
 #define PREFILTER_WHITE (MAXBUCKET>>4)
 
 
+/* iterate on the threads of gimp_parallel_run(), but don't spend
+   more than this much memory on their private buckets */
+#define MAX_THREAD_BUCKET_MEMORY (256 << 20)
+
+
 #define bump_no_overflow(dest, delta, type) { \
    type tt_ = dest + delta;            \
    if (tt_ > dest) dest = tt_;                 \
 }
 
+/* what the iterating threads share for one batch */
+typedef struct {
+   control_point *cp;
+   bucket        *cmap;
+   double        *bounds;
+   double        *size;
+   int            width, height;
+   guint32        seed[2];           /* render seed, batch */
+   int            nsub_batches;
+   int            next_sub_batch;    /* accessed atomically */
+   int            sub_batches_done;  /* accessed atomically */
+   int            batch_size;
+   int          (*progress)(double);
+} batch_spec;
+
+typedef struct {
+   batch_spec *batch;
+   bucket     *buckets;
+   point      *points;
+   GRand      *rand;
+} thread_spec;
+
 /* sum of entries of vector to 1 */
 static void
 normalize_vector(double *v,
@@ -80,6 +109,96 @@ normalize_vector(double *v,
     v[i] *= t;
 }
 
+/* iterate the next sub batch into BUCKETS, return 0 if there was none.
+ * every sub batch seeds RAND from its own number, so the samples don't
+ * depend on which thread did the work. */
+static int
+render_sub_batch (batch_spec *batch,
+                  bucket     *buckets,
+                  point      *points,
+                  GRand      *rand)
+{
+  int      j, width = batch->width, height = batch->height;
+  double  *bounds = batch->bounds, *size = batch->size;
+  bucket  *cmap = batch->cmap;
+  guint32  seed[3];
+  int      sub_batch = g_atomic_int_add (&batch->next_sub_batch, 1);
+
+  if (sub_batch >= batch->nsub_batches)
+    return 0;
+
+  seed[0] = batch->seed[0];
+  seed[1] = batch->seed[1];
+  seed[2] = sub_batch;
+  g_rand_set_seed_array (rand, seed, 3);
+
+  /* generate a sub_batch_size worth of samples */
+  points[0][0] = g_rand_double_range (rand, -1, 1);
+  points[0][1] = g_rand_double_range (rand, -1, 1);
+  points[0][2] = g_rand_double (rand);
+  iterate (batch->cp, SUB_BATCH_SIZE, FUSE, points, rand);
+
+  /* merge them into buckets, looking up colors */
+  for (j = 0; j < SUB_BATCH_SIZE; j++)
+    {
+      int k, color_index;
+      double *p = points[j];
+      bucket *b;
+
+      /* Note that we must test if p[0] and p[1] is "within"
+       * the valid bounds rather than "not outside", because
+       * p[0] and p[1] might be NaN.
+       */
+      if (p[0] >= bounds[0] &&
+          p[1] >= bounds[1] &&
+          p[0] <= bounds[2] &&
+          p[1] <= bounds[3])
+        {
+          color_index = (int) (p[2] * CMAP_SIZE);
+
+          if (color_index < 0)
+            color_index = 0;
+          else if (color_index > CMAP_SIZE - 1)
+            color_index = CMAP_SIZE - 1;
+
+          b = buckets +
+              (int) (width * (p[0] - bounds[0]) * size[0]) +
+              width * (int) (height * (p[1] - bounds[1]) * size[1]);
+
+          for (k = 0; k < 4; k++)
+            bump_no_overflow(b[0][k], cmap[color_index][k], short);
+        }
+    }
+
+  g_atomic_int_inc (&batch->sub_batches_done);
+
+  return 1;
+}
+
+/* iterate sub batches into the buckets of one slot of THREADS until
+ * there are none left.  only the thread that called
+ * gimp_parallel_run() shows the progress. */
+static void
+render_slot (int          slot,
+             int          nslots,
+             int          thread,
+             thread_spec *threads)
+{
+  thread_spec *spec  = &threads[slot];
+  batch_spec  *batch = spec->batch;
+  int          j;
+
+  for (j = 0;
+       render_sub_batch (batch, spec->buckets, spec->points, spec->rand);
+       j++)
+    {
+      if (thread == 0 && batch->progress && (j % 32) == 0)
+        (*batch->progress)(0.5 * SUB_BATCH_SIZE *
+                           g_atomic_int_get (&batch->sub_batches_done) /
+                           (double) batch->batch_size);
+    }
+}
+
 void
 render_rectangle (frame_spec    *spec,
                   unsigned char *out,
@@ -88,7 +207,7 @@ render_rectangle (frame_spec    *spec,
                   int            nchan,
                   int progress(double))
 {
-  int      i, j, k, nsamples, nbuckets, batch_size, batch_num, sub_batch;
+  int      i, j, k, nsamples, nbuckets, batch_size, batch_num;
   bucket  *buckets;
   abucket *accumulate;
   point   *points;
@@ -101,7 +220,10 @@ render_rectangle (frame_spec    *spec,
   int      nbatches = spec->cps[0].nbatches;
   bucket   cmap[CMAP_SIZE];
   int      gutter_width;
-  int      sbc;
+  int      nthreads = 1;
+  guint32  seed = g_random_int ();
+  thread_spec threads[GIMP_PARALLEL_MAX_THREADS];
+  GRand   *rand = g_rand_new ();
 
   image_width = spec->cps[0].width;
   if (field)
@@ -187,6 +309,21 @@ render_rectangle (frame_spec    *spec,
       points = (point *)  (last_block + (sizeof (bucket) + sizeof (abucket)) * nbuckets);
     }
 
+  /* the first thread iterates into the shared buckets, the others
+     have their own, merged into them at the end of each batch */
+  nthreads = CLAMP (gimp_parallel_get_n_threads (), 1,
+                    1 + MAX_THREAD_BUCKET_MEMORY / (sizeof (bucket) * nbuckets));
+
+  threads[0].buckets = buckets;
+  threads[0].points  = points;
+  threads[0].rand    = rand;
+  for (i = 1; i < nthreads; i++)
+    {
+      threads[i].buckets = g_new (bucket, nbuckets);
+      threads[i].points  = g_new (point, SUB_BATCH_SIZE);
+      threads[i].rand    = g_rand_new ();
+    }
+
   memset ((char *) accumulate, 0, sizeof (abucket) * nbuckets);
   for (batch_num = 0; batch_num < nbatches; batch_num++)
     {
@@ -254,49 +391,45 @@ render_rectangle (frame_spec    *spec,
                         (oversample * oversample));
       batch_size = nsamples / cp.nbatches;
 
-      sbc = 0;
-      for (sub_batch = 0;
-           sub_batch < batch_size;
-           sub_batch += SUB_BATCH_SIZE)
+      if (1)
         {
-          if (progress && (sbc++ % 32) == 0)
-              (*progress)(0.5 * sub_batch / (double) batch_size);
-          /* generate a sub_batch_size worth of samples */
-          points[0][0] = random_uniform11 ();
-          points[0][1] = random_uniform11 ();
-          points[0][2] = random_uniform01 ();
-          iterate (&cp, SUB_BATCH_SIZE, FUSE, points);
-
-          /* merge them into buckets, looking up colors */
-          for (j = 0; j < SUB_BATCH_SIZE; j++)
+          batch_spec batch;
+          int        nbatch_threads;
+
+          batch.cp               = &cp;
+          batch.cmap             = cmap;
+          batch.bounds           = bounds;
+          batch.size             = size;
+          batch.width            = width;
+          batch.height           = height;
+          batch.seed[0]          = seed;
+          batch.seed[1]          = batch_num;
+          batch.nsub_batches     = ((batch_size + SUB_BATCH_SIZE - 1) /
+                                    SUB_BATCH_SIZE);
+          batch.next_sub_batch   = 0;
+          batch.sub_batches_done = 0;
+          batch.batch_size       = batch_size;
+          batch.progress         = progress;
+
+          nbatch_threads = CLAMP (nthreads, 1, MAX (batch.nsub_batches, 1));
+
+          threads[0].batch = &batch;
+          for (i = 1; i < nbatch_threads; i++)
             {
-              int k, color_index;
-              double *p = points[j];
-              bucket *b;
-
-              /* Note that we must test if p[0] and p[1] is "within"
-               * the valid bounds rather than "not outside", because
-               * p[0] and p[1] might be NaN.
-               */
-              if (p[0] >= bounds[0] &&
-                  p[1] >= bounds[1] &&
-                  p[0] <= bounds[2] &&
-                  p[1] <= bounds[3])
-                {
-                  color_index = (int) (p[2] * CMAP_SIZE);
+              memset ((char *) threads[i].buckets, 0, sizeof (bucket) * nbuckets);
+              threads[i].batch = &batch;
+            }
 
-                  if (color_index < 0)
-                    color_index = 0;
-                  else if (color_index > CMAP_SIZE - 1)
-                    color_index = CMAP_SIZE - 1;
+          gimp_parallel_run (nbatch_threads, (GimpParallelFunc) render_slot,
+                             threads, FALSE);
 
-                  b = buckets +
-                      (int) (width * (p[0] - bounds[0]) * size[0]) +
-                      width * (int) (height * (p[1] - bounds[1]) * size[1]);
+          for (i = 1; i < nbatch_threads; i++)
+            {
+              bucket *b = threads[i].buckets;
 
-                  for (k = 0; k < 4; k++)
-                    bump_no_overflow(b[0][k], cmap[color_index][k], short);
-                }
+              for (j = 0; j < nbuckets; j++)
+                for (k = 0; k < 4; k++)
+                  bump_no_overflow(buckets[j][k], b[j][k], short);
             }
         }
 
@@ -391,6 +524,14 @@ render_rectangle (frame_spec    *spec,
         }
     }
 
+  for (i = 1; i < nthreads; i++)
+    {
+      g_free (threads[i].buckets);
+      g_free (threads[i].points);
+      g_rand_free (threads[i].rand);
+    }
+  g_rand_free (rand);
+
   free (filter);
   free (temporal_filter);
 }
@@ -1223,9 +1223,6 @@ explorer_dialog (void)
 void
 dialog_update_preview (void)
 {
-  gint     ycoord;
-  guchar  *p_ul;
-
   if (NULL == wint.preview)
     return;
 
@@ -1240,17 +1237,8 @@ dialog_update_preview (void)
       xdiff = (xmax - xmin) / xbild;
       ydiff = (ymax - ymin) / ybild;
 
-      p_ul = wint.wimage;
-
-      for (ycoord = 0; ycoord < preview_height; ycoord++)
-        {
-          explorer_render_row (NULL,
-                               p_ul,
-                               ycoord,
-                               preview_width,
-                               3);
-          p_ul += preview_width * 3;
-        }
+      explorer_render_rows (wint.wimage, preview_width * 3,
+                            0, preview_height, preview_width, 3, FALSE);
 
       preview_redraw ();
     }
@@ -69,6 +69,11 @@
 
 #include "libgimp/stdplugins-intl.h"
 
+#if defined (ARCH_X86) && defined (__SSE2__)
+#define FRACTAL_EXPLORER_SSE2 1
+#include <emmintrin.h>
+#endif
+
 
 /**********************************************************************
   Global variables
@@ -397,18 +402,15 @@ run (const gchar      *name,
 static void
 explorer (GimpDrawable * drawable)
 {
-  GimpPixelRgn  srcPR;
   GimpPixelRgn  destPR;
   gint          width;
   gint          height;
   gint          bpp;
-  gint          row;
   gint          x1;
   gint          y1;
   gint          x2;
   gint          y2;
-  guchar       *src_row;
-  guchar       *dest_row;
+  guchar       *dest;
 
   /* Get the input area. This is the bounding box of the selection in
    *  the image (or the entire image if there is no selection). Only
@@ -425,12 +427,12 @@ explorer (GimpDrawable * drawable)
   height = drawable->height;
   bpp  = drawable->bpp;
 
-  /*  allocate row buffers  */
-  src_row  = g_new (guchar, bpp * (x2 - x1));
-  dest_row = g_new (guchar, bpp * (x2 - x1));
+  /*  the fractal doesn't depend on the source pixels, so the whole
+   *  area is rendered into memory and written back in one go
+   */
+  dest = g_new (guchar, (gsize) bpp * (x2 - x1) * (y2 - y1));
 
   /*  initialize the pixel regions  */
-  gimp_pixel_rgn_init (&srcPR, drawable, 0, 0, width, height, FALSE, FALSE);
   gimp_pixel_rgn_init (&destPR, drawable, 0, 0, width, height, TRUE, TRUE);
 
   xbild = width;
@@ -448,22 +450,12 @@ explorer (GimpDrawable * drawable)
                                             colormap[i].b);
     }
 
-  for (row = y1; row < y2; row++)
-    {
-      gimp_pixel_rgn_get_row (&srcPR, src_row, x1, row, (x2 - x1));
-
-      explorer_render_row (src_row,
-                           dest_row,
-                           row,
-                           (x2 - x1),
-                           bpp);
+  explorer_render_rows (dest, bpp * (x2 - x1),
+                        y1, (y2 - y1), (x2 - x1), bpp, TRUE);
 
-      /*  store the dest  */
-      gimp_pixel_rgn_set_row (&destPR, dest_row, x1, row, (x2 - x1));
+  /*  store the dest  */
+  gimp_pixel_rgn_set_rect (&destPR, dest, x1, y1, (x2 - x1), (y2 - y1));
 
-      if ((row % 10) == 0)
-        gimp_progress_update ((double) row / (double) (y2 - y1));
-    }
   gimp_progress_update (1.0);
 
   /*  update the processed region  */
@@ -471,24 +463,25 @@ explorer (GimpDrawable * drawable)
   gimp_drawable_merge_shadow (drawable->drawable_id, TRUE);
   gimp_drawable_update (drawable->drawable_id, x1, y1, (x2 - x1), (y2 - y1));
 
-  g_free (src_row);
-  g_free (dest_row);
+  g_free (dest);
 }
 
 /**********************************************************************
- FUNCTION: explorer_render_row
+ FUNCTION: explorer_iterate
  *********************************************************************/
 
-void
-explorer_render_row (const guchar *src_row,
-                     guchar       *dest_row,
-                     gint          row,
-                     gint          row_width,
-                     gint          bpp)
+/* Runs the escape-time loop for the point (a, b), returns the number
+ * of iterations and leaves the last orbit point in *x and *y.
+ */
+static gint
+explorer_iterate (gdouble  a,
+                  gdouble  b,
+                  gint     iteration,
+                  gdouble  cx,
+                  gdouble  cy,
+                  gdouble *x_out,
+                  gdouble *y_out)
 {
-  gint    col;
-  gdouble a;
-  gdouble b;
   gdouble x;
   gdouble y;
   gdouble oldx;
@@ -502,181 +495,388 @@ explorer_render_row (const guchar *src_row,
   gdouble foldyinitx;
   gdouble foldyinity;
   gdouble xx = 0;
-  gdouble adjust;
-  gdouble cx;
-  gdouble cy;
   gint    counter;
-  gint    color;
-  gint    iteration;
-  gint    useloglog;
-  gdouble log2;
 
-  cx = wvals.cx;
-  cy = wvals.cy;
-  useloglog = wvals.useloglog;
-  iteration = wvals.iter;
-  log2 = log (2.0);
+  if (wvals.fractaltype != 0)
+    {
+      tmpx = x = a;
+      tmpy = y = b;
+    }
+  else
+    {
+      x = 0;
+      y = 0;
+    }
 
-  for (col = 0; col < row_width; col++)
+  for (counter = 0; counter < iteration; counter++)
     {
-      a = xmin + (double) col * xdiff;
-      b = ymin + (double) row * ydiff;
-      if (wvals.fractaltype != 0)
-        {
-          tmpx = x = a;
-          tmpy = y = b;
-        }
-      else
-        {
-          x = 0;
-          y = 0;
-        }
+      oldx=x;
+      oldy=y;
 
-      for (counter = 0; counter < iteration; counter++)
+      switch (wvals.fractaltype)
         {
-          oldx=x;
-          oldy=y;
-
-          switch (wvals.fractaltype)
+        case TYPE_MANDELBROT:
+          xx = x * x - y * y + a;
+          y = 2.0 * x * y + b;
+          break;
+
+        case TYPE_JULIA:
+          xx = x * x - y * y + cx;
+          y = 2.0 * x * y + cy;
+          break;
+
+        case TYPE_BARNSLEY_1:
+          foldxinitx = oldx * cx;
+          foldyinity = oldy * cy;
+          foldxinity = oldx * cy;
+          foldyinitx = oldy * cx;
+          /* orbit calculation */
+          if (oldx >= 0)
+            {
+              xx = (foldxinitx - cx - foldyinity);
+              y  = (foldyinitx - cy + foldxinity);
+            }
+          else
+            {
+              xx = (foldxinitx + cx - foldyinity);
+              y  = (foldyinitx + cy + foldxinity);
+            }
+          break;
+
+        case TYPE_BARNSLEY_2:
+          foldxinitx = oldx * cx;
+          foldyinity = oldy * cy;
+          foldxinity = oldx * cy;
+          foldyinitx = oldy * cx;
+          /* orbit calculation */
+          if (foldxinity + foldyinitx >= 0)
+            {
+              xx = foldxinitx - cx - foldyinity;
+              y  = foldyinitx - cy + foldxinity;
+            }
+          else
+            {
+              xx = foldxinitx + cx - foldyinity;
+              y  = foldyinitx + cy + foldxinity;
+            }
+          break;
+
+        case TYPE_BARNSLEY_3:
+          foldxinitx  = oldx * oldx;
+          foldyinity  = oldy * oldy;
+          foldxinity  = oldx * oldy;
+          /* orbit calculation */
+          if (oldx > 0)
+            {
+              xx = foldxinitx - foldyinity - 1.0;
+              y  = foldxinity * 2;
+            }
+          else
             {
-            case TYPE_MANDELBROT:
-              xx = x * x - y * y + a;
-              y = 2.0 * x * y + b;
-              break;
-
-            case TYPE_JULIA:
-              xx = x * x - y * y + cx;
-              y = 2.0 * x * y + cy;
-              break;
-
-            case TYPE_BARNSLEY_1:
-              foldxinitx = oldx * cx;
-              foldyinity = oldy * cy;
-              foldxinity = oldx * cy;
-              foldyinitx = oldy * cx;
-              /* orbit calculation */
-              if (oldx >= 0)
-                {
-                  xx = (foldxinitx - cx - foldyinity);
-                  y  = (foldyinitx - cy + foldxinity);
-                }
-              else
-                {
-                  xx = (foldxinitx + cx - foldyinity);
-                  y  = (foldyinitx + cy + foldxinity);
-                }
-              break;
-
-            case TYPE_BARNSLEY_2:
-              foldxinitx = oldx * cx;
-              foldyinity = oldy * cy;
-              foldxinity = oldx * cy;
-              foldyinitx = oldy * cx;
-              /* orbit calculation */
-              if (foldxinity + foldyinitx >= 0)
-                {
-                  xx = foldxinitx - cx - foldyinity;
-                  y  = foldyinitx - cy + foldxinity;
-                }
-              else
-                {
-                  xx = foldxinitx + cx - foldyinity;
-                  y  = foldyinitx + cy + foldxinity;
-                }
-              break;
-
-            case TYPE_BARNSLEY_3:
-              foldxinitx  = oldx * oldx;
-              foldyinity  = oldy * oldy;
-              foldxinity  = oldx * oldy;
-              /* orbit calculation */
-              if (oldx > 0)
-                {
-                  xx = foldxinitx - foldyinity - 1.0;
-                  y  = foldxinity * 2;
-                }
-              else
-                {
-                  xx = foldxinitx - foldyinity -1.0 + cx * oldx;
-                  y  = foldxinity * 2;
-                  y += cy * oldx;
-                }
-              break;
-
-            case TYPE_SPIDER:
-              /* { c=z=pixel: z=z*z+c; c=c/2+z, |z|<=4 } */
-              xx = x*x - y*y + tmpx + cx;
-              y = 2 * oldx * oldy + tmpy +cy;
-              tmpx = tmpx/2 + xx;
-              tmpy = tmpy/2 + y;
-              break;
-
-            case TYPE_MAN_O_WAR:
-              xx = x*x - y*y + tmpx + cx;
-              y = 2.0 * x * y + tmpy + cy;
-              tmpx = oldx;
-              tmpy = oldy;
-              break;
-
-            case TYPE_LAMBDA:
-              tempsqrx = x * x;
-              tempsqry = y * y;
-              tempsqrx = oldx - tempsqrx + tempsqry;
-              tempsqry = -(oldy * oldx);
-              tempsqry += tempsqry + oldy;
-              xx = cx * tempsqrx - cy * tempsqry;
-              y = cx * tempsqry + cy * tempsqrx;
-              break;
-
-            case TYPE_SIERPINSKI:
-              xx = oldx + oldx;
-              y = oldy + oldy;
-              if (oldy > .5)
-                y = y - 1;
-              else if (oldx > .5)
-                xx = xx - 1;
-              break;
-
-            default:
-              break;
+              xx = foldxinitx - foldyinity -1.0 + cx * oldx;
+              y  = foldxinity * 2;
+              y += cy * oldx;
             }
+          break;
+
+        case TYPE_SPIDER:
+          /* { c=z=pixel: z=z*z+c; c=c/2+z, |z|<=4 } */
+          xx = x*x - y*y + tmpx + cx;
+          y = 2 * oldx * oldy + tmpy +cy;
+          tmpx = tmpx/2 + xx;
+          tmpy = tmpy/2 + y;
+          break;
+
+        case TYPE_MAN_O_WAR:
+          xx = x*x - y*y + tmpx + cx;
+          y = 2.0 * x * y + tmpy + cy;
+          tmpx = oldx;
+          tmpy = oldy;
+          break;
+
+        case TYPE_LAMBDA:
+          tempsqrx = x * x;
+          tempsqry = y * y;
+          tempsqrx = oldx - tempsqrx + tempsqry;
+          tempsqry = -(oldy * oldx);
+          tempsqry += tempsqry + oldy;
+          xx = cx * tempsqrx - cy * tempsqry;
+          y = cx * tempsqry + cy * tempsqrx;
+          break;
+
+        case TYPE_SIERPINSKI:
+          xx = oldx + oldx;
+          y = oldy + oldy;
+          if (oldy > .5)
+            y = y - 1;
+          else if (oldx > .5)
+            xx = xx - 1;
+          break;
+
+        default:
+          break;
+        }
 
-          x = xx;
+      x = xx;
 
-          if (((x * x) + (y * y)) >= 4.0)
-            break;
-        }
+      if (((x * x) + (y * y)) >= 4.0)
+        break;
+    }
+
+  *x_out = x;
+  *y_out = y;
+
+  return counter;
+}
+
+#ifdef FRACTAL_EXPLORER_SSE2
+/**********************************************************************
+ FUNCTION: explorer_iterate_quadratic_sse2
+ *********************************************************************/
+
+/* The Mandelbrot and Julia loops for two adjacent pixels at once.
+ * A pixel that escapes keeps its orbit point while the other one
+ * carries on, and every operation is done in the same order as in
+ * explorer_iterate(), so the results are identical.
+ */
+static void
+explorer_iterate_quadratic_sse2 (gdouble  a0,
+                                 gdouble  a1,
+                                 gdouble  b,
+                                 gint     iteration,
+                                 gdouble  cx,
+                                 gdouble  cy,
+                                 gint     counter_out[2],
+                                 gdouble  x_out[2],
+                                 gdouble  y_out[2])
+{
+  const __m128d two  = _mm_set1_pd (2.0);
+  const __m128d four = _mm_set1_pd (4.0);
+  __m128d       x;
+  __m128d       y;
+  __m128d       ca;
+  __m128d       cb;
+  __m128d       active;
+  gint          counter;
+
+  if (wvals.fractaltype == TYPE_MANDELBROT)
+    {
+      x  = _mm_setzero_pd ();
+      y  = _mm_setzero_pd ();
+      ca = _mm_set_pd (a1, a0);
+      cb = _mm_set1_pd (b);
+    }
+  else
+    {
+      x  = _mm_set_pd (a1, a0);
+      y  = _mm_set1_pd (b);
+      ca = _mm_set1_pd (cx);
+      cb = _mm_set1_pd (cy);
+    }
+
+  counter_out[0] = counter_out[1] = iteration;
+
+  active = _mm_castsi128_pd (_mm_set1_epi32 (-1));
+
+  for (counter = 0; counter < iteration; counter++)
+    {
+      __m128d xx;
+      __m128d yy;
+      __m128d escaped;
+      gint    bits;
+
+      xx = _mm_add_pd (_mm_sub_pd (_mm_mul_pd (x, x), _mm_mul_pd (y, y)), ca);
+      yy = _mm_add_pd (_mm_mul_pd (_mm_mul_pd (two, x), y), cb);
+
+      x = _mm_or_pd (_mm_and_pd (active, xx), _mm_andnot_pd (active, x));
+      y = _mm_or_pd (_mm_and_pd (active, yy), _mm_andnot_pd (active, y));
 
-      if (useloglog)
+      escaped = _mm_and_pd (active,
+                            _mm_cmpge_pd (_mm_add_pd (_mm_mul_pd (xx, xx),
+                                                      _mm_mul_pd (yy, yy)),
+                                          four));
+      bits = _mm_movemask_pd (escaped);
+
+      if (bits)
         {
-          gdouble modulus_square = (x * x) + (y * y);
+          if (bits & 1)
+            counter_out[0] = counter;
+          if (bits & 2)
+            counter_out[1] = counter;
 
-          if (modulus_square > (G_E * G_E))
-              adjust = log (log (modulus_square) / 2.0) / log2;
-          else
-              adjust = 0.0;
+          active = _mm_andnot_pd (escaped, active);
+
+          if (! _mm_movemask_pd (active))
+            break;
         }
+    }
+
+  _mm_storeu_pd (x_out, x);
+  _mm_storeu_pd (y_out, y);
+}
+#endif /* FRACTAL_EXPLORER_SSE2 */
+
+/**********************************************************************
+ FUNCTION: explorer_put_pixel
+ *********************************************************************/
+
+static inline void
+explorer_put_pixel (guchar  *dest,
+                    gint     counter,
+                    gdouble  x,
+                    gdouble  y,
+                    gint     iteration,
+                    gint     bpp)
+{
+  gdouble adjust;
+  gint    color;
+
+  if (wvals.useloglog)
+    {
+      gdouble modulus_square = (x * x) + (y * y);
+
+      if (modulus_square > (G_E * G_E))
+          adjust = log (log (modulus_square) / 2.0) / G_LN2;
       else
-        {
           adjust = 0.0;
-        }
+    }
+  else
+    {
+      adjust = 0.0;
+    }
+
+  color = (int) (((counter - adjust) * (wvals.ncolors - 1)) / iteration);
+  if (bpp >= 3)
+    {
+      dest[0] = colormap[color].r;
+      dest[1] = colormap[color].g;
+      dest[2] = colormap[color].b;
+    }
+  else
+      dest[0] = valuemap[color];
 
-      color = (int) (((counter - adjust) * (wvals.ncolors - 1)) / iteration);
-      if (bpp >= 3)
+  if (! ( bpp % 2))
+    dest[bpp - 1] = 255;
+}
+
+/**********************************************************************
+ FUNCTION: explorer_render_row
+ *********************************************************************/
+
+void
+explorer_render_row (const guchar *src_row,
+                     guchar       *dest_row,
+                     gint          row,
+                     gint          row_width,
+                     gint          bpp)
+{
+  gint    col = 0;
+  gdouble b;
+  gdouble x;
+  gdouble y;
+  gdouble cx;
+  gdouble cy;
+  gint    counter;
+  gint    iteration;
+
+  cx = wvals.cx;
+  cy = wvals.cy;
+  iteration = wvals.iter;
+
+  b = ymin + (double) row * ydiff;
+
+#ifdef FRACTAL_EXPLORER_SSE2
+  if (wvals.fractaltype == TYPE_MANDELBROT ||
+      wvals.fractaltype == TYPE_JULIA)
+    {
+      for (; col + 1 < row_width; col += 2)
         {
-          dest_row[col * bpp + 0] = colormap[color].r;
-          dest_row[col * bpp + 1] = colormap[color].g;
-          dest_row[col * bpp + 2] = colormap[color].b;
+          gint    counters[2];
+          gdouble xs[2];
+          gdouble ys[2];
+
+          explorer_iterate_quadratic_sse2 (xmin + (double) col * xdiff,
+                                           xmin + (double) (col + 1) * xdiff,
+                                           b, iteration, cx, cy,
+                                           counters, xs, ys);
+
+          explorer_put_pixel (dest_row + col * bpp,
+                              counters[0], xs[0], ys[0], iteration, bpp);
+          explorer_put_pixel (dest_row + (col + 1) * bpp,
+                              counters[1], xs[1], ys[1], iteration, bpp);
         }
-      else
-          dest_row[col * bpp + 0] = valuemap[color];
+    }
+#endif
 
-      if (! ( bpp % 2))
-        dest_row [col * bpp + bpp - 1] = 255;
+  for (; col < row_width; col++)
+    {
+      counter = explorer_iterate (xmin + (double) col * xdiff, b,
+                                  iteration, cx, cy, &x, &y);
 
+      explorer_put_pixel (dest_row + col * bpp,
+                          counter, x, y, iteration, bpp);
     }
 }
 
+/**********************************************************************
+ FUNCTION: explorer_render_rows
+ *********************************************************************/
+
+typedef struct
+{
+  guchar *dest;
+  gint    rowstride;
+  gint    row;
+  gint    n_rows;
+  gint    row_width;
+  gint    bpp;
+} RenderContext;
+
+static void
+explorer_render_band (gint           band,
+                      gint           n_bands,
+                      gint           thread,
+                      RenderContext *ctx)
+{
+  gint start = band * FRACTAL_BAND_HEIGHT;
+  gint end   = MIN (start + FRACTAL_BAND_HEIGHT, ctx->n_rows);
+  gint i;
+
+  for (i = start; i < end; i++)
+    explorer_render_row (NULL,
+                         ctx->dest + (gsize) i * ctx->rowstride,
+                         ctx->row + i,
+                         ctx->row_width,
+                         ctx->bpp);
+}
+
+/* Renders n_rows rows starting at image row "row" into dest.  Every
+ * pixel only depends on its coordinates and on the read-only globals,
+ * so bands of rows are spread over the available processors.
+ */
+void
+explorer_render_rows (guchar   *dest,
+                      gint      rowstride,
+                      gint      row,
+                      gint      n_rows,
+                      gint      row_width,
+                      gint      bpp,
+                      gboolean  show_progress)
+{
+  RenderContext ctx;
+
+  ctx.dest      = dest;
+  ctx.rowstride = rowstride;
+  ctx.row       = row;
+  ctx.n_rows    = n_rows;
+  ctx.row_width = row_width;
+  ctx.bpp       = bpp;
+
+  gimp_parallel_run ((n_rows + FRACTAL_BAND_HEIGHT - 1) / FRACTAL_BAND_HEIGHT,
+                     (GimpParallelFunc) explorer_render_band, &ctx,
+                     show_progress);
+}
+
 static void
 delete_dialog_callback (GtkWidget *widget,
                         gboolean   delete,
@@ -15,6 +15,8 @@
 #define MAXNCOLORS 8192
 #define MAXSTRLEN 256
 
+#define FRACTAL_BAND_HEIGHT 8
+
 #define PLUG_IN_PROC   "plug-in-fractalexplorer"
 #define PLUG_IN_BINARY "fractal-explorer"
 #define PLUG_IN_ROLE   "gimp-fractal-explorer"
@@ -213,4 +215,11 @@ void explorer_render_row (const guchar *src_row,
                           gint          row,
                           gint          row_width,
                           gint          bpp);
+void explorer_render_rows (guchar       *dest,
+                           gint          rowstride,
+                           gint          row,
+                           gint          n_rows,
+                           gint          row_width,
+                           gint          bpp,
+                           gboolean      show_progress);
 #endif
@@ -36,6 +36,26 @@
 
 #include <libgimp/stdplugins-intl.h>
 
+
+#define PAINT_BAND_HEIGHT  32
+
+typedef struct
+{
+  int tx, ty;
+  int n;
+  int r, g, b;
+} stroke_t;
+
+typedef struct
+{
+  ppm_t     *brushes;
+  ppm_t     *shadows;
+  ppm_t     *p;
+  ppm_t     *a;
+  stroke_t  *strokes;
+  GArray   **buckets;
+} paint_context_t;
+
 static gimpressionist_vals_t runningvals;
 
 static double
@@ -224,11 +244,15 @@ choose_best_brush (ppm_t *p, ppm_t *a, int tx, int ty,
   return best;
 }
 
+/* Paints one stroke, only touching the rows from y1 up to y2, so that
+ * strokes can be painted band by band.
+ */
 static void
 apply_brush (ppm_t *brush,
              ppm_t *shadow,
              ppm_t *p, ppm_t *a,
-             int tx, int ty, int r, int g, int b)
+             int tx, int ty, int r, int g, int b,
+             int y1, int y2)
 {
   ppm_t  tmp;
   ppm_t  atmp;
@@ -255,9 +279,9 @@ apply_brush (ppm_t *brush,
         {
           guchar *row, *arow = NULL;
 
-          if ((sy + y) < 0)
+          if ((sy + y) < MAX (y1, 0))
             continue;
-          if ((sy + y) >= tmp.height)
+          if ((sy + y) >= MIN (y2, tmp.height))
             break;
           row = tmp.col + (sy + y) * tmp.width * 3;
 
@@ -288,7 +312,7 @@ apply_brush (ppm_t *brush,
         }
     }
 
-  for (y = 0; y < brush->height; y++)
+  for (y = MAX (y1 - ty, 0); y < MIN (y2 - ty, brush->height); y++)
     {
       guchar *row = tmp.col + (ty + y) * tmp.width * 3;
       guchar *arow = NULL;
@@ -327,7 +351,7 @@ apply_brush (ppm_t *brush,
 
   if (relief > 0.001)
     {
-      for (y = 1; y < brush->height; y++)
+      for (y = MAX (y1 - ty, 1); y < MIN (y2 - ty, brush->height); y++)
         {
           guchar *row = tmp.col + (ty + y) * tmp.width * 3;
 
@@ -346,55 +370,248 @@ apply_brush (ppm_t *brush,
     }
 }
 
-void
-repaint (ppm_t *p, ppm_t *a)
+static void
+add_stroke (GArray *strokes,
+            int n, int tx, int ty, int r, int g, int b)
 {
-  int         x, y;
-  int         tx = 0, ty = 0;
-  ppm_t       tmp = {0, 0, NULL};
-  ppm_t       atmp = {0, 0, NULL};
-  int         r, g, b, h, i, j, on, sn;
-  int         num_brushes, maxbrushwidth, maxbrushheight;
-  guchar      back[3] = {0, 0, 0};
-  ppm_t      *brushes, *shadows;
-  ppm_t      *brush, *shadow = NULL;
-  double     *brushes_sum;
-  int         cx, cy, maxdist;
-  double      scale, relief, startangle, anglespan, density, bgamma;
-  int         max_progress;
-  ppm_t       paper_ppm = {0, 0, NULL};
-  ppm_t       dirmap = {0, 0, NULL};
-  ppm_t       sizmap = {0, 0, NULL};
-  int        *xpos = NULL, *ypos = NULL;
-  int         progstep;
-  static int  running = 0;
+  stroke_t stroke;
+
+  stroke.tx = tx;
+  stroke.ty = ty;
+  stroke.n  = n;
+  stroke.r  = r;
+  stroke.g  = g;
+  stroke.b  = b;
+
+  g_array_append_val (strokes, stroke);
+}
+
+static void
+paint_show_progress (gdouble done)
+{
+  if (runningvals.run)
+    {
+      gimp_progress_update (0.4 + 0.4 * done);
+    }
+  else
+    {
+      char tmps[40];
+
+      g_snprintf (tmps, sizeof (tmps), "%.1f %%", 50 + 50 * done);
+      preview_set_button_label (tmps);
+
+      while (gtk_events_pending ())
+        gtk_main_iteration ();
+    }
+}
+
+static void
+paint_band (gint             band,
+            gint             n_bands,
+            gint             thread,
+            paint_context_t *ctx)
+{
+  GArray *bucket = ctx->buckets[band];
+  int     y1     = band * PAINT_BAND_HEIGHT;
+  int     y2     = y1 + PAINT_BAND_HEIGHT;
+  guint   i;
+
+  for (i = 0; i < bucket->len; i++)
+    {
+      stroke_t *stroke = &ctx->strokes[g_array_index (bucket, int, i)];
+
+      apply_brush (&ctx->brushes[stroke->n],
+                   ctx->shadows ? &ctx->shadows[stroke->n] : NULL,
+                   ctx->p, ctx->a,
+                   stroke->tx, stroke->ty,
+                   stroke->r, stroke->g, stroke->b,
+                   y1, y2);
+    }
+
+  /* The bands are handed out in order, so the calling thread can show
+   * the progress from the band it is done with
+   */
+  if (thread == 0)
+    paint_show_progress ((gdouble) (band + 1) / n_bands);
+}
+
+/* Paints the strokes in bands of rows.  Every band gets the list of
+ * the strokes that touch it, in painting order, so each pixel sees the
+ * same strokes in the same order as if they were painted one by one,
+ * and the bands can be painted at the same time.
+ */
+static void
+paint_strokes (GArray *strokes,
+               ppm_t  *brushes,
+               ppm_t  *shadows,
+               ppm_t  *p,
+               ppm_t  *a)
+{
+  paint_context_t  ctx         = { 0, };
+  int              n_bands     = (p->height + PAINT_BAND_HEIGHT - 1) /
+                                 PAINT_BAND_HEIGHT;
+  int              shadowdepth = pcvals.general_shadow_depth;
+  int              shadowblur  = pcvals.general_shadow_blur;
+  int              band;
+  int              i;
+
+  ctx.brushes = brushes;
+  ctx.shadows = shadows;
+  ctx.p       = p;
+  ctx.a       = a;
+  ctx.strokes = (stroke_t *) strokes->data;
+  ctx.buckets = g_new (GArray *, n_bands);
+
+  for (band = 0; band < n_bands; band++)
+    ctx.buckets[band] = g_array_new (FALSE, FALSE, sizeof (int));
+
+  for (i = 0; i < (int) strokes->len; i++)
+    {
+      stroke_t *stroke = &ctx.strokes[i];
+      int       y1     = stroke->ty;
+      int       y2     = stroke->ty + brushes[stroke->n].height;
+
+      if (shadows)
+        {
+          int sy = stroke->ty + shadowdepth - shadowblur * 2;
+
+          y1 = MIN (y1, sy);
+          y2 = MAX (y2, sy + shadows[stroke->n].height);
+        }
+
+      y1 = MAX (y1, 0);
+      y2 = MIN (y2, p->height);
+
+      for (band = y1 / PAINT_BAND_HEIGHT;
+           band * PAINT_BAND_HEIGHT < y2;
+           band++)
+        {
+          g_array_append_val (ctx.buckets[band], i);
+        }
+    }
+
+  gimp_parallel_run (n_bands, (GimpParallelFunc) paint_band, &ctx, FALSE);
+
+  for (band = 0; band < n_bands; band++)
+    g_array_free (ctx.buckets[band], TRUE);
+
+  g_free (ctx.buckets);
+}
+
+/* The oriented and scaled brushes only depend on the selected brush
+ * and on a few of the settings, so they are kept from one run to the
+ * next, e.g. while the preview is updated for other changes.
+ */
+typedef struct
+{
+  ppm_t   source;
+  double  brush_aspect;
+  double  brushgamma;
+  double  size_first;
+  double  size_last;
+  int     size_num;
+  double  orient_first;
+  double  orient_last;
+  int     orient_num;
+  int     color_brushes;
+  int     drop_shadow;
+  int     shadow_blur;
+
+  int     num_brushes;
+  ppm_t  *brushes;
+  ppm_t  *shadows;
+  double *brushes_sum;
+  int     maxbrushwidth;
+  int     maxbrushheight;
+} brush_cache_t;
+
+static brush_cache_t brush_cache = { { 0, 0, NULL }, };
+
+static gboolean
+brush_cache_is_valid (ppm_t *source)
+{
+  return (brush_cache.brushes                                          &&
+          brush_cache.source.width    == source->width                 &&
+          brush_cache.source.height   == source->height                &&
+          brush_cache.brush_aspect    == runningvals.brush_aspect      &&
+          brush_cache.brushgamma      == runningvals.brushgamma        &&
+          brush_cache.size_first      == runningvals.size_first        &&
+          brush_cache.size_last       == runningvals.size_last         &&
+          brush_cache.size_num        == runningvals.size_num          &&
+          brush_cache.orient_first    == runningvals.orient_first      &&
+          brush_cache.orient_last     == runningvals.orient_last       &&
+          brush_cache.orient_num      == runningvals.orient_num        &&
+          brush_cache.color_brushes   == runningvals.color_brushes     &&
+          brush_cache.drop_shadow     == pcvals.general_drop_shadow    &&
+          brush_cache.shadow_blur     == pcvals.general_shadow_blur    &&
+          ! memcmp (brush_cache.source.col, source->col,
+                    source->width * source->height * 3));
+}
+
+static void
+brush_cache_free (void)
+{
+  int i;
+
+  for (i = 0; i < brush_cache.num_brushes; i++)
+    {
+      ppm_kill (&brush_cache.brushes[i]);
+      if (brush_cache.shadows)
+        ppm_kill (&brush_cache.shadows[i]);
+    }
+  g_free (brush_cache.brushes);
+  g_free (brush_cache.shadows);
+  g_free (brush_cache.brushes_sum);
+
+  ppm_kill (&brush_cache.source);
+
+  brush_cache.num_brushes = 0;
+  brush_cache.brushes     = NULL;
+  brush_cache.shadows     = NULL;
+  brush_cache.brushes_sum = NULL;
+}
+
+static void
+brush_cache_update (void)
+{
+  ppm_t   source = {0, 0, NULL};
+  int     num_brushes, maxbrushwidth, maxbrushheight;
+  ppm_t  *brushes, *shadows;
+  double *brushes_sum;
+  double  scale, startangle, anglespan, bgamma;
+  guchar  back[3] = {0, 0, 0};
+  int     h, i, j;
 
   int dropshadow = pcvals.general_drop_shadow;
   int shadowblur = pcvals.general_shadow_blur;
 
-  if (running)
-    return;
-  running++;
+  brush_get_selected (&source);
 
-  runningvals = pcvals;
+  if (brush_cache_is_valid (&source))
+    {
+      ppm_kill (&source);
+      return;
+    }
 
-  /* Shouldn't be necessary, but... */
-  if (img_has_alpha)
-    if ((p->width != a->width) || (p->height != a->height))
-      {
-        g_printerr ("Huh? Image size != alpha size?\n");
-        return;
-      }
+  brush_cache_free ();
+
+  brush_cache.source         = source;
+  brush_cache.brush_aspect   = runningvals.brush_aspect;
+  brush_cache.brushgamma     = runningvals.brushgamma;
+  brush_cache.size_first     = runningvals.size_first;
+  brush_cache.size_last      = runningvals.size_last;
+  brush_cache.size_num       = runningvals.size_num;
+  brush_cache.orient_first   = runningvals.orient_first;
+  brush_cache.orient_last    = runningvals.orient_last;
+  brush_cache.orient_num     = runningvals.orient_num;
+  brush_cache.color_brushes  = runningvals.color_brushes;
+  brush_cache.drop_shadow    = dropshadow;
+  brush_cache.shadow_blur    = shadowblur;
 
   num_brushes = runningvals.orient_num * runningvals.size_num;
   startangle = runningvals.orient_first;
   anglespan = runningvals.orient_last;
 
-  density = runningvals.brush_density;
-
-  if (runningvals.place_type == PLACEMENT_TYPE_EVEN_DIST)
-    density /= 3.0;
-
   bgamma = runningvals.brushgamma;
 
   brushes = g_malloc (num_brushes * sizeof (ppm_t));
@@ -406,7 +623,7 @@ repaint (ppm_t *p, ppm_t *a)
     shadows = NULL;
 
   brushes[0].col = NULL;
-  brush_get_selected (&brushes[0]);
+  ppm_copy (&brush_cache.source, &brushes[0]);
 
   resize (&brushes[0],
           brushes[0].width,
@@ -463,7 +680,6 @@ repaint (ppm_t *p, ppm_t *a)
       brushes_sum[i] = sum_brush (&brushes[i]);
     }
 
-  brush = &brushes[0];
 
   maxbrushwidth = maxbrushheight = 0;
   for (i = 0; i < num_brushes; i++)
@@ -506,6 +722,65 @@ repaint (ppm_t *p, ppm_t *a)
 #endif
     }
 
+  brush_cache.num_brushes    = num_brushes;
+  brush_cache.brushes        = brushes;
+  brush_cache.shadows        = shadows;
+  brush_cache.brushes_sum    = brushes_sum;
+  brush_cache.maxbrushwidth  = maxbrushwidth;
+  brush_cache.maxbrushheight = maxbrushheight;
+}
+
+void
+repaint (ppm_t *p, ppm_t *a)
+{
+  int         x, y;
+  int         tx = 0, ty = 0;
+  ppm_t       tmp = {0, 0, NULL};
+  ppm_t       atmp = {0, 0, NULL};
+  int         r, g, b, h, i, on, sn;
+  int         num_brushes, maxbrushwidth, maxbrushheight;
+  ppm_t      *brushes, *shadows;
+  ppm_t      *brush;
+  double     *brushes_sum;
+  GArray     *strokes;
+  int         cx, cy, maxdist;
+  double      scale, relief, density;
+  int         max_progress;
+  ppm_t       paper_ppm = {0, 0, NULL};
+  ppm_t       dirmap = {0, 0, NULL};
+  ppm_t       sizmap = {0, 0, NULL};
+  int        *xpos = NULL, *ypos = NULL;
+  int         progstep;
+  static int  running = 0;
+
+  if (running)
+    return;
+  running++;
+
+  runningvals = pcvals;
+
+  /* Shouldn't be necessary, but... */
+  if (img_has_alpha)
+    if ((p->width != a->width) || (p->height != a->height))
+      {
+        g_printerr ("Huh? Image size != alpha size?\n");
+        return;
+      }
+
+  density = runningvals.brush_density;
+
+  if (runningvals.place_type == PLACEMENT_TYPE_EVEN_DIST)
+    density /= 3.0;
+
+  brush_cache_update ();
+
+  num_brushes    = brush_cache.num_brushes;
+  brushes        = brush_cache.brushes;
+  shadows        = brush_cache.shadows;
+  brushes_sum    = brush_cache.brushes_sum;
+  maxbrushwidth  = brush_cache.maxbrushwidth;
+  maxbrushheight = brush_cache.maxbrushheight;
+
   /* For extra annoying debugging :-) */
 #if 0
   ppm_save (brushes, "/tmp/__brush.ppm");
@@ -824,6 +1099,12 @@ repaint (ppm_t *p, ppm_t *a)
         }
     }
 
+  /* The stroke placement, brush choice and colors only depend on the
+   * source image and on the random sequence, so they are all worked out
+   * first, and in the same order as ever.  The painting is done later.
+   */
+  strokes = g_array_sized_new (FALSE, FALSE, sizeof (stroke_t), i);
+
   for (; i; i--)
     {
       int n;
@@ -833,14 +1114,14 @@ repaint (ppm_t *p, ppm_t *a)
         {
           if(runningvals.run)
             {
-              gimp_progress_update (0.8 - 0.8 * ((double)i / max_progress));
+              gimp_progress_update (0.4 - 0.4 * ((double)i / max_progress));
             }
           else
             {
               char tmps[40];
 
               g_snprintf (tmps, sizeof (tmps),
-                          "%.1f %%", 100 * (1.0 - ((double)i / max_progress)));
+                          "%.1f %%", 50 * (1.0 - ((double)i / max_progress)));
               preview_set_button_label (tmps);
 
               while(gtk_events_pending())
@@ -971,8 +1252,6 @@ repaint (ppm_t *p, ppm_t *a)
       ty -= maxbrushheight/2;
 
       brush = &brushes[n];
-      if (dropshadow)
-        shadow = &shadows[n];
       thissum = brushes_sum[n];
 
       /* Calculate color - avg. of in-brush pixels */
@@ -1033,7 +1312,7 @@ repaint (ppm_t *p, ppm_t *a)
 #undef MYASSIGN
         }
 
-      apply_brush (brush, shadow, &tmp, &atmp, tx,ty, r,g,b);
+      add_stroke (strokes, n, tx,ty, r,g,b);
 
       if (runningvals.general_tileable && runningvals.general_paint_edges)
         {
@@ -1043,42 +1322,39 @@ repaint (ppm_t *p, ppm_t *a)
 
           if (tx < maxbrushwidth)
             {
-              apply_brush (brush, shadow, &tmp, &atmp, tx+orig_width,ty, r,g,b);
+              add_stroke (strokes, n, tx+orig_width,ty, r,g,b);
               dox = -1;
             }
           else if (tx > orig_width)
             {
-              apply_brush (brush, shadow, &tmp, &atmp, tx-orig_width,ty, r,g,b);
+              add_stroke (strokes, n, tx-orig_width,ty, r,g,b);
               dox = 1;
             }
           if (ty < maxbrushheight)
             {
-              apply_brush (brush, shadow, &tmp, &atmp, tx,ty+orig_height, r,g,b);
+              add_stroke (strokes, n, tx,ty+orig_height, r,g,b);
               doy = 1;
             }
           else if (ty > orig_height)
             {
-              apply_brush (brush, shadow, &tmp, &atmp, tx,ty-orig_height, r,g,b);
+              add_stroke (strokes, n, tx,ty-orig_height, r,g,b);
               doy = -1;
             }
           if (doy)
             {
               if (dox < 0)
-                apply_brush (brush, shadow, &tmp, &atmp,
+                add_stroke (strokes, n,
                              tx+orig_width, ty + doy * orig_height, r, g, b);
               if (dox > 0)
-                apply_brush (brush, shadow, &tmp, &atmp,
+                add_stroke (strokes, n,
                              tx-orig_width, ty + doy * orig_height, r, g, b);
             }
         }
     }
-  for (i = 0; i < num_brushes; i++)
-    {
-      ppm_kill (&brushes[i]);
-    }
-  g_free (brushes);
-  g_free (shadows);
-  g_free (brushes_sum);
+
+  paint_strokes (strokes, brushes, shadows, &tmp, &atmp);
+
+  g_array_free (strokes, TRUE);
 
   g_free (xpos);
   g_free (ypos);
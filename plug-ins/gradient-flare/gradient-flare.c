@@ -287,6 +287,14 @@ typedef struct
   /* these values don't belong to drawable, though. */
 } DrawableInfo;
 
+typedef struct
+{
+  guchar *src;                  /* source pixels around the mask bounds */
+  gint    src_x, src_y;
+  gint    src_width, src_height;
+  guchar *dest;                 /* rendered pixels of the mask bounds */
+} AsupsampleBuffers;
+
 typedef struct _GradientMenu GradientMenu;
 typedef void (* GradientMenuCallback) (const gchar *gradient_name,
                                        gpointer     data);
@@ -557,8 +565,6 @@ static const gchar *gflare_menu_modes[] =
 static gint32              image_ID;
 static GimpDrawable       *drawable;
 static DrawableInfo        dinfo;
-static GimpPixelFetcher   *tk_read;
-static GimpPixelFetcher   *tk_write;
 static GFlareDialog       *dlg = NULL;
 static GFlareEditor       *ed = NULL;
 static GList              *gflares_list = NULL;
@@ -1088,24 +1094,52 @@ plugin_do_non_asupsample (void)
 static void
 plugin_do_asupsample (void)
 {
-  tk_read  = gimp_pixel_fetcher_new (drawable, FALSE);
-  gimp_pixel_fetcher_set_edge_mode (tk_read, GIMP_PIXEL_FETCHER_EDGE_BLACK);
+  AsupsampleBuffers buffers;
+  GimpPixelRgn      src_rgn;
+  GimpPixelRgn      dest_rgn;
+  gint              width  = dinfo.x2 - dinfo.x1;
+  gint              height = dinfo.y2 - dinfo.y1;
+
+  /*  The samples of the last column and row round to the pixels right
+   *  of and below the mask bounds, so read those too. The render and
+   *  put pixel functions only touch these buffers, which is what lets
+   *  them run on several threads.
+   */
+  buffers.src_x      = dinfo.x1;
+  buffers.src_y      = dinfo.y1;
+  buffers.src_width  = MIN (width + 1,  drawable->width  - dinfo.x1);
+  buffers.src_height = MIN (height + 1, drawable->height - dinfo.y1);
 
-  tk_write = gimp_pixel_fetcher_new (drawable, TRUE);
+  buffers.src  = g_new (guchar,
+                        buffers.src_width * buffers.src_height * drawable->bpp);
+  buffers.dest = g_new0 (guchar, width * height * drawable->bpp);
 
-  gimp_adaptive_supersample_area (dinfo.x1, dinfo.y1,
-                                  dinfo.x2 - 1, dinfo.y2 - 1,
-                                  pvals.asupsample_max_depth,
-                                  pvals.asupsample_threshold,
-                                  plugin_render_func,
-                                  NULL,
-                                  plugin_put_pixel_func,
-                                  NULL,
-                                  plugin_progress_func,
-                                  NULL);
+  gimp_pixel_rgn_init (&src_rgn, drawable,
+                       buffers.src_x, buffers.src_y,
+                       buffers.src_width, buffers.src_height, FALSE, FALSE);
+  gimp_pixel_rgn_get_rect (&src_rgn, buffers.src,
+                           buffers.src_x, buffers.src_y,
+                           buffers.src_width, buffers.src_height);
+
+  gimp_adaptive_supersample_area_parallel (dinfo.x1, dinfo.y1,
+                                           dinfo.x2 - 1, dinfo.y2 - 1,
+                                           pvals.asupsample_max_depth,
+                                           pvals.asupsample_threshold,
+                                           plugin_render_func,
+                                           &buffers,
+                                           plugin_put_pixel_func,
+                                           &buffers,
+                                           plugin_progress_func,
+                                           NULL,
+                                           0);
 
-  gimp_pixel_fetcher_destroy (tk_write);
-  gimp_pixel_fetcher_destroy (tk_read);
+  gimp_pixel_rgn_init (&dest_rgn, drawable,
+                       dinfo.x1, dinfo.y1, width, height, TRUE, TRUE);
+  gimp_pixel_rgn_set_rect (&dest_rgn, buffers.dest,
+                           dinfo.x1, dinfo.y1, width, height);
+
+  g_free (buffers.src);
+  g_free (buffers.dest);
 }
 
 /*
@@ -1121,18 +1155,29 @@ plugin_render_func (gdouble   x,
                     GimpRGB  *color,
                     gpointer  data)
 {
-  guchar        src_pix[4];
-  guchar        flare_pix[4];
-  guchar        src[4];
-  gint          b;
-  gint          ix, iy;
+  AsupsampleBuffers *buffers = data;
+  guchar             src_pix[4];
+  guchar             flare_pix[4];
+  guchar             src[4] = { 0, 0, 0, 0 };
+  gint               b;
+  gint               ix, iy;
 
   /* translate (0.5, 0.5) before convert to `int' so that it can surely
      point the center of pixel */
   ix = floor (x + 0.5);
   iy = floor (y + 0.5);
 
-  gimp_pixel_fetcher_get_pixel (tk_read, ix, iy, src);
+  /* pixels outside the drawable are black */
+  ix -= buffers->src_x;
+  iy -= buffers->src_y;
+
+  if (ix >= 0 && ix < buffers->src_width &&
+      iy >= 0 && iy < buffers->src_height)
+    {
+      memcpy (src,
+              buffers->src + (iy * buffers->src_width + ix) * drawable->bpp,
+              drawable->bpp);
+    }
 
   for (b = 0; b < 3; b++)
     src_pix[b] = dinfo.is_color ? src[b] : src[0];
@@ -1152,7 +1197,11 @@ plugin_put_pixel_func (gint      ix,
                        GimpRGB  *color,
                        gpointer  data)
 {
-  guchar dest[4];
+  AsupsampleBuffers *buffers = data;
+  guchar            *dest;
+
+  dest = buffers->dest + ((iy - dinfo.y1) * (dinfo.x2 - dinfo.x1) +
+                          (ix - dinfo.x1)) * drawable->bpp;
 
   if (dinfo.is_color)
     {
@@ -1167,8 +1216,6 @@ plugin_put_pixel_func (gint      ix,
 
   if (dinfo.has_alpha)
     dest[drawable->bpp - 1] = color->a * 255;
-
-  gimp_pixel_fetcher_put_pixel (tk_write, ix, iy, dest);
 }
 
 static void
@@ -16,6 +16,85 @@
 #include "libgimp/stdplugins-intl.h"
 
 
+#define LIGHTING_BAND_HEIGHT 64
+
+
+typedef struct
+{
+  get_ray_func  ray_func;
+  gboolean      bump_mapped;
+  guchar       *dest;
+  gint          obpp;
+  gboolean      has_alpha;
+
+  /* the bump map normals, one set for each thread */
+  PrecomputeState states[GIMP_PARALLEL_MAX_THREADS];
+} LightingContext;
+
+
+/********************************************/
+/* Render the rows y_start..y_end - 1 using */
+/* the thread's own bump map normals.       */
+/********************************************/
+
+static void
+render_band (LightingContext *ctx,
+             PrecomputeState *state,
+             gint             y_start,
+             gint             y_end)
+{
+  gint        xcount, ycount;
+  GimpRGB     color;
+  GimpVector3 p;
+
+  precompute_init (state, width, height);
+
+  /* The normals roll down the image, so start two rows  */
+  /* above the band to get the ones a single top to     */
+  /* bottom pass would have had here.                   */
+  /* ================================================== */
+
+  if (ctx->bump_mapped)
+    {
+      for (ycount = MAX (y_start - 2, 0); ycount < y_start; ycount++)
+        precompute_normals (state, 0, width, ycount);
+    }
+
+  for (ycount = y_start; ycount < y_end; ycount++)
+    {
+      guchar *row = ctx->dest + (gsize) ycount * width * ctx->obpp;
+
+      if (ctx->bump_mapped)
+        precompute_normals (state, 0, width, ycount);
+
+      for (xcount = 0; xcount < width; xcount++)
+        {
+          p = int_to_pos (xcount, ycount);
+          color = (* ctx->ray_func) (state, &p);
+
+          *row++ = (guchar) (color.r * 255.0);
+          *row++ = (guchar) (color.g * 255.0);
+          *row++ = (guchar) (color.b * 255.0);
+
+          if (ctx->has_alpha)
+            *row++ = (guchar) (color.a * 255.0);
+        }
+    }
+}
+
+/* Render a band, called by gimp_parallel_run() */
+static void
+render_band_func (gint             band,
+                  gint             n_bands,
+                  gint             thread,
+                  LightingContext *ctx)
+{
+  gint y_start = band * LIGHTING_BAND_HEIGHT;
+  gint y_end   = MIN (y_start + LIGHTING_BAND_HEIGHT, height);
+
+  render_band (ctx, &ctx->states[thread], y_start, y_end);
+}
+
 /*************/
 /* Main loop */
 /*************/
@@ -23,19 +102,10 @@
 void
 compute_image (void)
 {
-  gint         xcount, ycount;
-  GimpRGB       color;
-  glong        progress_counter = 0;
-  GimpVector3  p;
-  gint32       new_image_id = -1;
-  gint32       new_layer_id = -1;
-  gint32       index;
-  guchar      *row = NULL;
-  guchar       obpp;
-  gboolean     has_alpha;
-  get_ray_func ray_func;
-
-
+  LightingContext  ctx          = { 0, };
+  gint32           new_image_id = -1;
+  gint32           new_layer_id = -1;
+  gint             i;
 
   if (mapvals.create_new_image == TRUE ||
       (mapvals.transparent_background == TRUE &&
@@ -73,70 +143,49 @@ compute_image (void)
       output_drawable = gimp_drawable_get (new_layer_id);
     }
 
-  if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1)
-    {
-      gimp_pixel_rgn_init (&bump_region, gimp_drawable_get (mapvals.bumpmap_id),
-			   0, 0, width, height, FALSE, FALSE);
-    }
+  ctx.bump_mapped = (mapvals.bump_mapped == TRUE &&
+                     mapvals.bumpmap_id != -1);
 
-  precompute_init (width, height);
+  if (ctx.bump_mapped)
+    image_buffer_load (&bump_image, mapvals.bumpmap_id);
 
   if (!mapvals.env_mapped || mapvals.envmap_id == -1)
     {
-      ray_func = get_ray_color;
+      ctx.ray_func = get_ray_color;
     }
   else
     {
       env_width = gimp_drawable_width (mapvals.envmap_id);
       env_height = gimp_drawable_height (mapvals.envmap_id);
-      gimp_pixel_rgn_init (&env_region, gimp_drawable_get (mapvals.envmap_id),
-			   0, 0, env_width, env_height, FALSE, FALSE);
-      ray_func = get_ray_color_ref;
+      image_buffer_load (&env_image, mapvals.envmap_id);
+      ctx.ray_func = get_ray_color_ref;
     }
 
   gimp_pixel_rgn_init (&dest_region, output_drawable,
 		       0, 0, width, height, TRUE, TRUE);
 
-  obpp = gimp_drawable_bpp (output_drawable->drawable_id);
-  has_alpha = gimp_drawable_has_alpha (output_drawable->drawable_id);
-
-  row = g_new (guchar, obpp * width);
+  ctx.obpp      = gimp_drawable_bpp (output_drawable->drawable_id);
+  ctx.has_alpha = gimp_drawable_has_alpha (output_drawable->drawable_id);
+  ctx.dest      = g_new (guchar, (gsize) width * height * ctx.obpp);
 
   gimp_progress_init (_("Lighting Effects"));
 
-/*  if (mapvals.antialiasing==FALSE)
-    { */
+  /* All pixels are fetched from memory, so the bands can be */
+  /* rendered in parallel. The antialiasing option has never */
+  /* been implemented here.                                  */
+  /* ======================================================= */
 
-  for (ycount = 0; ycount < height; ycount++)
-    {
-      if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1)
-	precompute_normals (0, width, ycount);
+  gimp_parallel_run ((height + LIGHTING_BAND_HEIGHT - 1) / LIGHTING_BAND_HEIGHT,
+                     (GimpParallelFunc) render_band_func, &ctx, TRUE);
 
-      index = 0;
-
-      for (xcount = 0; xcount < width; xcount++)
-	{
-	  p = int_to_pos (xcount, ycount);
-	  color = (* ray_func) (&p);
+  for (i = 0; i < GIMP_PARALLEL_MAX_THREADS; i++)
+    precompute_free (&ctx.states[i]);
 
-	  row[index++] = (guchar) (color.r * 255.0);
-	  row[index++] = (guchar) (color.g * 255.0);
-	  row[index++] = (guchar) (color.b * 255.0);
-
-	  if (has_alpha)
-	    row[index++] = (guchar) (color.a * 255.0);
-
-	  if ((progress_counter++ % width) == 0)
-	    gimp_progress_update ((gdouble) progress_counter /
-				  (gdouble) maxcounter);
-	}
-
-      gimp_pixel_rgn_set_row (&dest_region, row, 0, ycount, width);
-    }
+  gimp_pixel_rgn_set_rect (&dest_region, ctx.dest, 0, 0, width, height);
 
   gimp_progress_update (1.0);
 
-  g_free (row);
+  g_free (ctx.dest);
 
   /* Update image */
   /* ============ */
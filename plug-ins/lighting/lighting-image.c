@@ -15,13 +15,11 @@
 
 
 GimpDrawable *input_drawable,*output_drawable;
-GimpPixelRgn  source_region, dest_region;
+GimpPixelRgn  dest_region;
 
-GimpDrawable *bump_drawable = NULL;
-GimpPixelRgn  bump_region;
-
-GimpDrawable *env_drawable = NULL;
-GimpPixelRgn  env_region;
+ImageBuffer   source_image = { -1, 0, 0, 0, NULL };
+ImageBuffer   bump_image   = { -1, 0, 0, 0, NULL };
+ImageBuffer   env_image    = { -1, 0, 0, 0, NULL };
 
 guchar          *preview_rgb_data = NULL;
 gint             preview_rgb_stride;
@@ -65,10 +63,11 @@ GimpRGB
 peek (gint x,
       gint y)
 {
-  guchar data[4];
-  GimpRGB color;
+  const guchar *data;
+  GimpRGB       color;
 
-  gimp_pixel_rgn_get_pixel (&source_region,data, x, y);
+  data = (source_image.pixels +
+          ((gsize) y * source_image.width + x) * source_image.bpp);
 
   color.r = (gdouble) (data[0]) / 255.0;
   color.g = (gdouble) (data[1]) / 255.0;
@@ -93,8 +92,8 @@ GimpRGB
 peek_env_map (gint x,
 	      gint y)
 {
-  guchar data[4];
-  GimpRGB color;
+  const guchar *data;
+  GimpRGB       color;
 
   if (x < 0)
     x = 0;
@@ -105,7 +104,8 @@ peek_env_map (gint x,
   else if (y >= env_height)
     y = env_height - 1;
 
-  gimp_pixel_rgn_get_pixel (&env_region, data, x, y);
+  data = (env_image.pixels +
+          ((gsize) y * env_image.width + x) * env_image.bpp);
 
   color.r = (gdouble) (data[0]) / 255.0;
   color.g = (gdouble) (data[1]) / 255.0;
@@ -361,8 +361,7 @@ image_setup (GimpDrawable *drawable,
   width  = input_drawable->width;
   height = input_drawable->height;
 
-  gimp_pixel_rgn_init (&source_region, input_drawable,
-		       0, 0, width, height, FALSE, FALSE);
+  image_buffer_load (&source_image, input_drawable->drawable_id);
 
   maxcounter = (glong) width * (glong) height;
 
@@ -387,3 +386,46 @@ image_setup (GimpDrawable *drawable,
 
   return TRUE;
 }
+
+/*************************************************/
+/* Read a drawable into memory, unless the same  */
+/* drawable is already loaded into the buffer.   */
+/*************************************************/
+
+void
+image_buffer_load (ImageBuffer *buffer,
+                   gint32       drawable_id)
+{
+  GimpDrawable *drawable;
+  GimpPixelRgn  region;
+
+  if (buffer->pixels && buffer->drawable_id == drawable_id)
+    return;
+
+  image_buffer_free (buffer);
+
+  drawable = gimp_drawable_get (drawable_id);
+
+  buffer->drawable_id = drawable_id;
+  buffer->width       = drawable->width;
+  buffer->height      = drawable->height;
+  buffer->bpp         = drawable->bpp;
+  buffer->pixels      = g_new (guchar, ((gsize) buffer->width *
+                                        buffer->height * buffer->bpp));
+
+  gimp_pixel_rgn_init (&region, drawable,
+                       0, 0, buffer->width, buffer->height, FALSE, FALSE);
+  gimp_pixel_rgn_get_rect (&region, buffer->pixels,
+                           0, 0, buffer->width, buffer->height);
+
+  gimp_drawable_detach (drawable);
+}
+
+void
+image_buffer_free (ImageBuffer *buffer)
+{
+  g_free (buffer->pixels);
+
+  buffer->drawable_id = -1;
+  buffer->pixels      = NULL;
+}
@@ -4,14 +4,25 @@
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
 
-extern GimpDrawable *input_drawable,*output_drawable;
-extern GimpPixelRgn  source_region, dest_region;
+/* A drawable read into memory, so the renderer threads can fetch */
+/* pixels without going through the (single threaded) tile cache.  */
+/* =============================================================== */
+
+typedef struct
+{
+  gint32  drawable_id;
+  gint    width;
+  gint    height;
+  gint    bpp;
+  guchar *pixels;
+} ImageBuffer;
 
-extern GimpDrawable *bump_drawable;
-extern GimpPixelRgn  bump_region;
+extern GimpDrawable *input_drawable,*output_drawable;
+extern GimpPixelRgn  dest_region;
 
-extern GimpDrawable *env_drawable;
-extern GimpPixelRgn  env_region;
+extern ImageBuffer   source_image;
+extern ImageBuffer   bump_image;
+extern ImageBuffer   env_image;
 
 extern guchar          *preview_rgb_data;
 extern gint             preview_rgb_stride;
@@ -58,5 +69,8 @@ gdouble        get_map_value   (GimpPixelRgn *region,
 				gint         *inside);
 gint           image_setup     (GimpDrawable *drawable,
 				gint          interactive);
+void           image_buffer_load (ImageBuffer *buffer,
+				gint32        drawable_id);
+void           image_buffer_free (ImageBuffer *buffer);
 
 #endif  /* __LIGHTING_IMAGE_H__ */
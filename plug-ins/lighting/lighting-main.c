@@ -321,6 +321,10 @@ run (const gchar      *name,
 
   g_free (xpostab);
   g_free (ypostab);
+
+  image_buffer_free (&source_image);
+  image_buffer_free (&bump_image);
+  image_buffer_free (&env_image);
 }
 
 const GimpPlugInInfo PLUG_IN_INFO =
@@ -4,6 +4,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gtk/gtk.h>
 
 #include <libgimp/gimp.h>
@@ -20,6 +22,10 @@
 
 #define LIGHT_SYMBOL_SIZE 8
 
+/* The preview first shows one ray per PREVIEW_COARSE_STEP squared */
+/* pixels, the full resolution pass follows when the UI is idle.   */
+#define PREVIEW_COARSE_STEP 4
+
 static gint handle_xpos = 0, handle_ypos = 0;
 
 /* g_free()'ed on exit */
@@ -32,17 +38,28 @@ static gint ypostab_size = -1;
 static gboolean    light_hit           = FALSE;
 static gboolean    left_button_pressed = FALSE;
 static guint preview_update_timer = 0;
+static guint preview_refine_idle  = 0;
+
+static PrecomputeState preview_state = { { NULL, }, };
 
 
 /* Protos */
 /* ====== */
 static gboolean
 interactive_preview_timer_callback ( gpointer data );
+static gboolean
+preview_refine_callback ( gpointer data );
+
+/*************************************************************/
+/* Compute the preview, casting one ray for each step x step */
+/* block of pixels, the others in the block are copied.      */
+/*************************************************************/
 
 static void
-compute_preview (gint startx, gint starty, gint w, gint h)
+compute_preview (gint startx, gint starty, gint w, gint h, gint step)
 {
   gint xcnt, ycnt, f1, f2;
+  gboolean inside;
   guchar r, g, b;
   gdouble imagex, imagey;
   gint32 index = 0;
@@ -86,7 +103,7 @@ compute_preview (gint startx, gint starty, gint w, gint h)
   for (ycnt = 0; ycnt < h; ycnt++)
     ypostab[ycnt] = (gdouble) height *((gdouble) ycnt / (gdouble) h);
 
-  precompute_init (width, height);
+  precompute_init (&preview_state, width, height);
 
   gimp_rgba_set (&lightcheck,
                  GIMP_CHECK_LIGHT, GIMP_CHECK_LIGHT, GIMP_CHECK_LIGHT,
@@ -96,9 +113,7 @@ compute_preview (gint startx, gint starty, gint w, gint h)
 
   if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1)
     {
-      gimp_pixel_rgn_init (&bump_region,
-                           gimp_drawable_get (mapvals.bumpmap_id),
-                           0, 0, width, height, FALSE, FALSE);
+      image_buffer_load (&bump_image, mapvals.bumpmap_id);
     }
 
   imagey = 0;
@@ -113,9 +128,7 @@ compute_preview (gint startx, gint starty, gint w, gint h)
       env_width = gimp_drawable_width (mapvals.envmap_id);
       env_height = gimp_drawable_height (mapvals.envmap_id);
 
-      gimp_pixel_rgn_init (&env_region,
-                           gimp_drawable_get (mapvals.envmap_id), 0,
-                           0, env_width, env_height, FALSE, FALSE);
+      image_buffer_load (&env_image, mapvals.envmap_id);
 
       if (mapvals.previewquality)
         ray_func = get_ray_color_ref;
@@ -130,8 +143,28 @@ compute_preview (gint startx, gint starty, gint w, gint h)
       index = ycnt * preview_rgb_stride;
       for (xcnt = 0; xcnt < PREVIEW_WIDTH; xcnt++)
         {
-          if ((ycnt >= starty && ycnt < (starty + h)) &&
-              (xcnt >= startx && xcnt < (startx + w)))
+          inside = ((ycnt >= starty && ycnt < (starty + h)) &&
+                    (xcnt >= startx && xcnt < (startx + w)));
+
+          if (inside && (ycnt - starty) % step != 0)
+            {
+              /* Copy the row of blocks above */
+              /* ============================ */
+
+              memcpy (preview_rgb_data + index,
+                      preview_rgb_data + index - preview_rgb_stride, 4);
+              index += 4;
+            }
+          else if (inside && (xcnt - startx) % step != 0)
+            {
+              /* Copy the pixel to the left */
+              /* ========================== */
+
+              memcpy (preview_rgb_data + index,
+                      preview_rgb_data + index - 4, 4);
+              index += 4;
+            }
+          else if (inside)
             {
               imagex = xpostab[xcnt - startx];
               imagey = ypostab[ycnt - starty];
@@ -142,10 +175,10 @@ compute_preview (gint startx, gint starty, gint w, gint h)
                   xcnt == startx)
                 {
                   pos_to_float (pos.x, pos.y, &imagex, &imagey);
-                  precompute_normals (0, width, RINT (imagey));
+                  precompute_normals (&preview_state, 0, width, RINT (imagey));
                 }
 
-              color = (*ray_func) (&pos);
+              color = (*ray_func) (&preview_state, &pos);
 
               if (color.a < 1.0)
                 {
@@ -391,7 +424,17 @@ preview_compute (void)
   gdk_window_set_cursor (gtk_widget_get_window (previewarea), cursor);
   gdk_cursor_unref (cursor);
 
-  compute_preview (startx, starty, pw, ph);
+  /* Show a coarse preview right away, and refine it once */
+  /* there are no more pending events.                    */
+  /* ==================================================== */
+
+  if (preview_refine_idle != 0)
+    g_source_remove (preview_refine_idle);
+
+  compute_preview (startx, starty, pw, ph, PREVIEW_COARSE_STEP);
+
+  preview_refine_idle = g_idle_add (preview_refine_callback, NULL);
+
   cursor = gdk_cursor_new_for_display (display, GDK_HAND2);
   gdk_window_set_cursor (gtk_widget_get_window (previewarea), cursor);
   gdk_cursor_unref (cursor);
@@ -472,6 +515,33 @@ interactive_preview_callback (GtkWidget *widget)
                                         interactive_preview_timer_callback, NULL);
 }
 
+void
+preview_cleanup (void)
+{
+  if (preview_refine_idle != 0)
+    {
+      g_source_remove (preview_refine_idle);
+      preview_refine_idle = 0;
+    }
+
+  precompute_free (&preview_state);
+}
+
+static gboolean
+preview_refine_callback (gpointer data)
+{
+  gint startx, starty, pw, ph;
+
+  compute_preview_rectangle (&startx, &starty, &pw, &ph);
+  compute_preview (startx, starty, pw, ph, 1);
+
+  gtk_widget_queue_draw (previewarea);
+
+  preview_refine_idle = 0;
+
+  return FALSE;
+}
+
 static gboolean
 interactive_preview_timer_callback (gpointer data)
 {
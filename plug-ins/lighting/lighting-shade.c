@@ -11,27 +11,19 @@
 #include "lighting-shade.h"
 
 
-static GimpVector3 *triangle_normals[2] = { NULL, NULL };
-static GimpVector3 *vertex_normals[3]   = { NULL, NULL, NULL };
-static gdouble     *heights[3] = { NULL, NULL, NULL };
-static gdouble      xstep, ystep;
-static guchar      *bumprow = NULL;
-
-static gint pre_w = -1;
-static gint pre_h = -1;
-
 /*****************/
 /* Phong shading */
 /*****************/
 
 static GimpRGB
-phong_shade (GimpVector3 *position,
-             GimpVector3 *viewpoint,
-             GimpVector3 *normal,
-             GimpVector3 *lightposition,
-             GimpRGB      *diff_col,
-             GimpRGB      *light_col,
-             LightType    light_type)
+phong_shade (GimpVector3            *position,
+             GimpVector3            *viewpoint,
+             GimpVector3            *normal,
+             GimpVector3            *lightposition,
+             GimpRGB                *diff_col,
+             GimpRGB                *light_col,
+             LightType               light_type,
+             const MaterialSettings *material)
 {
   GimpRGB       diffuse_color, specular_color;
   gdouble      nl, rv, dist;
@@ -75,27 +67,27 @@ phong_shade (GimpVector3 *position,
       gimp_vector3_normalize (&h);
 
       rv = MAX (0.01, gimp_vector3_inner_product (&n, &h));
-      rv = pow (rv, mapvals.material.highlight);
+      rv = pow (rv, material->highlight);
       rv *= nl;
 
       /* Compute diffuse and specular intensity contribution */
       /* =================================================== */
 
       diffuse_color = *light_col;
-      gimp_rgb_multiply (&diffuse_color, mapvals.material.diffuse_int);
+      gimp_rgb_multiply (&diffuse_color, material->diffuse_int);
       diffuse_color.r *= diff_col->r;
       diffuse_color.g *= diff_col->g;
       diffuse_color.b *= diff_col->b;
       gimp_rgb_multiply (&diffuse_color, nl);
 
       specular_color = *light_col;
-      if (mapvals.material.metallic)  /* for metals, specular color = diffuse color */
+      if (material->metallic)  /* for metals, specular color = diffuse color */
         {
           specular_color.r *= diff_col->r;
           specular_color.g *= diff_col->g;
           specular_color.b *= diff_col->b;
         }
-      gimp_rgb_multiply (&specular_color, mapvals.material.specular_ref);
+      gimp_rgb_multiply (&specular_color, material->specular_ref);
       gimp_rgb_multiply (&specular_color, rv);
 
       gimp_rgb_add (&diffuse_color, &specular_color);
@@ -108,62 +100,65 @@ phong_shade (GimpVector3 *position,
 }
 
 void
-precompute_init (gint w,
-                 gint h)
+precompute_init (PrecomputeState *state,
+                 gint             w,
+                 gint             h)
 {
   gint n;
-  gint bpp=1;
 
-  xstep = 1.0 / (gdouble) width;
-  ystep = 1.0 / (gdouble) height;
+  precompute_free (state);
+
+  state->xstep = 1.0 / (gdouble) width;
+  state->ystep = 1.0 / (gdouble) height;
 
-  pre_w = w;
-  pre_h = h;
+  state->pre_w = w;
+  state->pre_h = h;
 
   for (n = 0; n < 3; n++)
     {
-      if (vertex_normals[n] != NULL)
-        g_free (vertex_normals[n]);
-      if (heights[n] != NULL)
-        g_free (heights[n]);
-
-      heights[n] = g_new (gdouble, w);
-      vertex_normals[n] = g_new (GimpVector3, w);
+      state->heights[n] = g_new (gdouble, w);
+      state->vertex_normals[n] = g_new (GimpVector3, w);
     }
 
-  for (n = 0; n < 2; n++)
-    if (triangle_normals[n] != NULL)
-      g_free (triangle_normals[n]);
+  state->triangle_normals[0] = g_new (GimpVector3, (w << 1) + 2);
+  state->triangle_normals[1] = g_new (GimpVector3, (w << 1) + 2);
 
-  if (bumprow != NULL)
+  for (n = 0; n < (w << 1) + 1; n++)
     {
-      g_free (bumprow);
-      bumprow = NULL;
+      gimp_vector3_set (&state->triangle_normals[0][n], 0.0, 0.0, 1.0);
+      gimp_vector3_set (&state->triangle_normals[1][n], 0.0, 0.0, 1.0);
     }
-  if (mapvals.bumpmap_id != -1)
+
+  for (n = 0; n < w; n++)
     {
-      bpp = gimp_drawable_bpp(mapvals.bumpmap_id);
+      gimp_vector3_set (&state->vertex_normals[0][n], 0.0, 0.0, 1.0);
+      gimp_vector3_set (&state->vertex_normals[1][n], 0.0, 0.0, 1.0);
+      gimp_vector3_set (&state->vertex_normals[2][n], 0.0, 0.0, 1.0);
+      state->heights[0][n] = 0.0;
+      state->heights[1][n] = 0.0;
+      state->heights[2][n] = 0.0;
     }
+}
 
-  bumprow = g_new (guchar, w * bpp);
-
-  triangle_normals[0] = g_new (GimpVector3, (w << 1) + 2);
-  triangle_normals[1] = g_new (GimpVector3, (w << 1) + 2);
+void
+precompute_free (PrecomputeState *state)
+{
+  gint n;
 
-  for (n = 0; n < (w << 1) + 1; n++)
+  for (n = 0; n < 3; n++)
     {
-      gimp_vector3_set (&triangle_normals[0][n], 0.0, 0.0, 1.0);
-      gimp_vector3_set (&triangle_normals[1][n], 0.0, 0.0, 1.0);
+      g_free (state->vertex_normals[n]);
+      g_free (state->heights[n]);
+
+      state->vertex_normals[n] = NULL;
+      state->heights[n]        = NULL;
     }
 
-  for (n = 0; n < w; n++)
+  for (n = 0; n < 2; n++)
     {
-      gimp_vector3_set (&vertex_normals[0][n], 0.0, 0.0, 1.0);
-      gimp_vector3_set (&vertex_normals[1][n], 0.0, 0.0, 1.0);
-      gimp_vector3_set (&vertex_normals[2][n], 0.0, 0.0, 1.0);
-      heights[0][n] = 0.0;
-      heights[1][n] = 0.0;
-      heights[2][n] = 0.0;
+      g_free (state->triangle_normals[n]);
+
+      state->triangle_normals[n] = NULL;
     }
 }
 
@@ -172,16 +167,21 @@ precompute_init (gint w,
 /********************************************/
 
 void
-precompute_normals (gint x1,
-                    gint x2,
-                    gint y)
+precompute_normals (PrecomputeState *state,
+                    gint             x1,
+                    gint             x2,
+                    gint             y)
 {
-  GimpVector3 *tmpv, p1, p2, p3, normal;
-  gdouble     *tmpd;
-  gint         n, i, nv;
-  guchar      *map = NULL;
-  gint bpp = 1;
-  guchar mapval;
+  GimpVector3 **triangle_normals = state->triangle_normals;
+  GimpVector3 **vertex_normals   = state->vertex_normals;
+  gdouble     **heights          = state->heights;
+  GimpVector3  *tmpv, p1, p2, p3, normal;
+  gdouble      *tmpd;
+  gint          n, i, nv;
+  guchar       *map = NULL;
+  const guchar *bumprow;
+  gint          bpp = bump_image.bpp;
+  guchar        mapval;
 
 
   /* First, compute the heights */
@@ -201,12 +201,8 @@ precompute_normals (gint x1,
   heights[1] = heights[2];
   heights[2] = tmpd;
 
-  if (mapvals.bumpmap_id != -1)
-    {
-      bpp = gimp_drawable_bpp(mapvals.bumpmap_id);
-    }
-
-  gimp_pixel_rgn_get_row (&bump_region, bumprow, x1, y, x2 - x1);
+  bumprow = (bump_image.pixels +
+             ((gsize) y * bump_image.width + x1) * bpp);
 
   if (mapvals.bumpmaptype > 0)
     {
@@ -260,14 +256,14 @@ precompute_normals (gint x1,
   for (n = 0; n < (x2 - x1 - 1); n++)
     {
       p1.x = 0.0;
-      p1.y = ystep;
+      p1.y = state->ystep;
       p1.z = heights[2][n] - heights[1][n];
 
-      p2.x = xstep;
-      p2.y = ystep;
+      p2.x = state->xstep;
+      p2.y = state->ystep;
       p2.z = heights[2][n+1] - heights[1][n];
 
-      p3.x = xstep;
+      p3.x = state->xstep;
       p3.y = 0.0;
       p3.z = heights[1][n+1] - heights[1][n];
 
@@ -299,14 +295,14 @@ precompute_normals (gint x1,
               nv += 2;
             }
 
-          if (y < pre_h)
+          if (y < state->pre_h)
             {
               gimp_vector3_add (&normal, &normal, &triangle_normals[1][i-1]);
               nv++;
             }
         }
 
-      if (n <pre_w)
+      if (n < state->pre_w)
         {
           if (y > 0)
             {
@@ -315,7 +311,7 @@ precompute_normals (gint x1,
               nv += 2;
             }
 
-          if (y < pre_h)
+          if (y < state->pre_h)
             {
               gimp_vector3_add (&normal, &normal, &triangle_normals[1][i]);
               gimp_vector3_add (&normal, &normal, &triangle_normals[1][i+1]);
@@ -362,10 +358,10 @@ sphere_to_image (GimpVector3 *normal,
                  gdouble     *u,
                  gdouble     *v)
 {
-  static gdouble     alpha, fac;
-  static GimpVector3 cross_prod;
-  static GimpVector3 firstaxis  = { 1.0, 0.0, 0.0 };
-  static GimpVector3 secondaxis = { 0.0, 1.0, 0.0 };
+  static const GimpVector3 firstaxis  = { 1.0, 0.0, 0.0 };
+  static const GimpVector3 secondaxis = { 0.0, 1.0, 0.0 };
+  gdouble                  alpha, fac;
+  GimpVector3              cross_prod;
 
   alpha = acos (-gimp_vector3_inner_product (&secondaxis, normal));
 
@@ -401,7 +397,8 @@ sphere_to_image (GimpVector3 *normal,
 /*********************************************************************/
 
 GimpRGB
-get_ray_color (GimpVector3 *position)
+get_ray_color (PrecomputeState *state,
+               GimpVector3     *position)
 {
   GimpRGB       color;
   GimpRGB       color_int;
@@ -416,7 +413,7 @@ get_ray_color (GimpVector3 *position)
 
   x = RINT (xf);
 
-  if (mapvals.transparent_background && heights[1][x] == 0)
+  if (mapvals.transparent_background && state->heights[1][x] == 0)
     {
       gimp_rgb_set_alpha (&color_sum, 0.0);
     }
@@ -448,11 +445,12 @@ get_ray_color (GimpVector3 *position)
                                          p,
                                          &color,
                                          &color_int,
-                                         mapvals.lightsource[k].type);
+                                         mapvals.lightsource[k].type,
+                                         &mapvals.material);
             }
           else
             {
-              normal = vertex_normals[1][(gint) RINT (xf)];
+              normal = state->vertex_normals[1][(gint) RINT (xf)];
 
               light_color = phong_shade (position,
                                          &mapvals.viewpoint,
@@ -460,7 +458,8 @@ get_ray_color (GimpVector3 *position)
                                          p,
                                          &color,
                                          &color_int,
-                                         mapvals.lightsource[k].type);
+                                         mapvals.lightsource[k].type,
+                                         &mapvals.material);
             }
 
           gimp_rgb_add (&color_sum, &light_color);
@@ -472,17 +471,18 @@ get_ray_color (GimpVector3 *position)
 }
 
 GimpRGB
-get_ray_color_ref (GimpVector3 *position)
+get_ray_color_ref (PrecomputeState *state,
+                   GimpVector3     *position)
 {
-  GimpRGB      color_sum;
-  GimpRGB      color_int;
-  GimpRGB      light_color;
-  GimpRGB      color, env_color;
-  gint         x, f;
-  gdouble      xf, yf;
-  GimpVector3  normal, *p, v, r;
-  gint         k;
-  gdouble      tmpval;
+  GimpRGB          color_sum;
+  GimpRGB          color_int;
+  GimpRGB          light_color;
+  GimpRGB          color, env_color;
+  gint             x, f;
+  gdouble          xf, yf;
+  GimpVector3      normal, *p, v, r;
+  gint             k;
+  MaterialSettings material;
 
   pos_to_float (position->x, position->y, &xf, &yf);
 
@@ -491,10 +491,10 @@ get_ray_color_ref (GimpVector3 *position)
   if (mapvals.bump_mapped == FALSE || mapvals.bumpmap_id == -1)
     normal = mapvals.planenormal;
   else
-    normal = vertex_normals[1][(gint) RINT (xf)];
+    normal = state->vertex_normals[1][(gint) RINT (xf)];
   gimp_vector3_normalize (&normal);
 
-  if (mapvals.transparent_background && heights[1][x] == 0)
+  if (mapvals.transparent_background && state->heights[1][x] == 0)
     {
       gimp_rgb_set_alpha (&color_sum, 0.0);
     }
@@ -523,7 +523,8 @@ get_ray_color_ref (GimpVector3 *position)
                                      p,
                                      &color,
                                      &color_int,
-                                     mapvals.lightsource[0].type);
+                                     mapvals.lightsource[0].type,
+                                     &mapvals.material);
         }
 
       gimp_vector3_sub (&v, &mapvals.viewpoint, position);
@@ -538,8 +539,8 @@ get_ray_color_ref (GimpVector3 *position)
       env_color = peek_env_map (RINT (env_width * xf),
                                 RINT (env_height * yf));
 
-      tmpval = mapvals.material.diffuse_int;
-      mapvals.material.diffuse_int = 0.;
+      material = mapvals.material;
+      material.diffuse_int = 0.;
 
       light_color = phong_shade (position,
                                  &mapvals.viewpoint,
@@ -547,9 +548,8 @@ get_ray_color_ref (GimpVector3 *position)
                                  &r,
                                  &color,
                                  &env_color,
-                                 DIRECTIONAL_LIGHT);
-
-      mapvals.material.diffuse_int = tmpval;
+                                 DIRECTIONAL_LIGHT,
+                                 &material);
 
       gimp_rgb_add (&color_sum, &light_color);
     }
@@ -559,7 +559,8 @@ get_ray_color_ref (GimpVector3 *position)
 }
 
 GimpRGB
-get_ray_color_no_bilinear (GimpVector3 *position)
+get_ray_color_no_bilinear (PrecomputeState *state,
+                           GimpVector3     *position)
 {
   GimpRGB       color;
   GimpRGB       color_int;
@@ -575,7 +576,7 @@ get_ray_color_no_bilinear (GimpVector3 *position)
 
   x = RINT (xf);
 
-  if (mapvals.transparent_background && heights[1][x] == 0)
+  if (mapvals.transparent_background && state->heights[1][x] == 0)
     {
       gimp_rgb_set_alpha (&color_sum, 0.0);
     }
@@ -607,11 +608,12 @@ get_ray_color_no_bilinear (GimpVector3 *position)
                                          p,
                                          &color,
                                          &color_int,
-                                         mapvals.lightsource[k].type);
+                                         mapvals.lightsource[k].type,
+                                         &mapvals.material);
             }
           else
             {
-              normal = vertex_normals[1][x];
+              normal = state->vertex_normals[1][x];
 
               light_color = phong_shade (position,
                                          &mapvals.viewpoint,
@@ -619,7 +621,8 @@ get_ray_color_no_bilinear (GimpVector3 *position)
                                          p,
                                          &color,
                                          &color_int,
-                                         mapvals.lightsource[k].type);
+                                         mapvals.lightsource[k].type,
+                                         &mapvals.material);
             }
 
           gimp_rgb_add (&color_sum, &light_color);
@@ -631,17 +634,18 @@ get_ray_color_no_bilinear (GimpVector3 *position)
 }
 
 GimpRGB
-get_ray_color_no_bilinear_ref (GimpVector3 *position)
+get_ray_color_no_bilinear_ref (PrecomputeState *state,
+                               GimpVector3     *position)
 {
-  GimpRGB      color_sum;
-  GimpRGB      color_int;
-  GimpRGB      light_color;
-  GimpRGB      color, env_color;
-  gint         x;
-  gdouble      xf, yf;
-  GimpVector3  normal, *p, v, r;
-  gint         k;
-  gdouble      tmpval;
+  GimpRGB          color_sum;
+  GimpRGB          color_int;
+  GimpRGB          light_color;
+  GimpRGB          color, env_color;
+  gint             x;
+  gdouble          xf, yf;
+  GimpVector3      normal, *p, v, r;
+  gint             k;
+  MaterialSettings material;
 
   pos_to_float (position->x, position->y, &xf, &yf);
 
@@ -650,10 +654,10 @@ get_ray_color_no_bilinear_ref (GimpVector3 *position)
   if (mapvals.bump_mapped == FALSE || mapvals.bumpmap_id == -1)
     normal = mapvals.planenormal;
   else
-    normal = vertex_normals[1][(gint) RINT (xf)];
+    normal = state->vertex_normals[1][(gint) RINT (xf)];
   gimp_vector3_normalize (&normal);
 
-  if (mapvals.transparent_background && heights[1][x] == 0)
+  if (mapvals.transparent_background && state->heights[1][x] == 0)
     {
       gimp_rgb_set_alpha (&color_sum, 0.0);
     }
@@ -682,7 +686,8 @@ get_ray_color_no_bilinear_ref (GimpVector3 *position)
                                          p,
                                          &color,
                                          &color_int,
-                                         mapvals.lightsource[0].type);
+                                         mapvals.lightsource[0].type,
+                                         &mapvals.material);
         }
 
       gimp_vector3_sub (&v, &mapvals.viewpoint, position);
@@ -697,8 +702,8 @@ get_ray_color_no_bilinear_ref (GimpVector3 *position)
       env_color = peek_env_map (RINT (env_width * xf),
                                 RINT (env_height * yf));
 
-      tmpval = mapvals.material.diffuse_int;
-      mapvals.material.diffuse_int = 0.;
+      material = mapvals.material;
+      material.diffuse_int = 0.;
 
       light_color = phong_shade (position,
                                  &mapvals.viewpoint,
@@ -706,9 +711,8 @@ get_ray_color_no_bilinear_ref (GimpVector3 *position)
                                  &r,
                                  &color,
                                  &env_color,
-                                 DIRECTIONAL_LIGHT);
-
-      mapvals.material.diffuse_int = tmpval;
+                                 DIRECTIONAL_LIGHT,
+                                 &material);
 
       gimp_rgb_add (&color_sum, &light_color);
     }
@@ -1,17 +1,38 @@
 #ifndef __LIGHTING_SHADE_H__
 #define __LIGHTING_SHADE_H__
 
-typedef GimpRGB (* get_ray_func) (GimpVector3 *vector);
+/* The rolling rows of bump map heights and normals. Every rendering */
+/* thread keeps its own, the shading functions only read from it.    */
+/* ================================================================= */
 
-GimpRGB get_ray_color                 (GimpVector3 *position);
-GimpRGB get_ray_color_no_bilinear     (GimpVector3 *position);
-GimpRGB get_ray_color_ref             (GimpVector3 *position);
-GimpRGB get_ray_color_no_bilinear_ref (GimpVector3 *position);
+typedef struct
+{
+  GimpVector3 *triangle_normals[2];
+  GimpVector3 *vertex_normals[3];
+  gdouble     *heights[3];
+  gdouble      xstep, ystep;
+  gint         pre_w, pre_h;
+} PrecomputeState;
 
-void    precompute_init               (gint         w,
-				       gint         h);
-void    precompute_normals            (gint         x1,
-				       gint         x2,
-				       gint         y);
+typedef GimpRGB (* get_ray_func) (PrecomputeState *state,
+				  GimpVector3     *vector);
+
+GimpRGB get_ray_color                 (PrecomputeState *state,
+				       GimpVector3     *position);
+GimpRGB get_ray_color_no_bilinear     (PrecomputeState *state,
+				       GimpVector3     *position);
+GimpRGB get_ray_color_ref             (PrecomputeState *state,
+				       GimpVector3     *position);
+GimpRGB get_ray_color_no_bilinear_ref (PrecomputeState *state,
+				       GimpVector3     *position);
+
+void    precompute_init               (PrecomputeState *state,
+				       gint             w,
+				       gint             h);
+void    precompute_free               (PrecomputeState *state);
+void    precompute_normals            (PrecomputeState *state,
+				       gint             x1,
+				       gint             x2,
+				       gint             y);
 
 #endif  /* __LIGHTING_SHADE_H__ */
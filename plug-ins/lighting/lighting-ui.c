@@ -1125,6 +1125,8 @@ main_dialog (GimpDrawable *drawable)
   if (gimp_dialog_run (GIMP_DIALOG (appwin)) == GTK_RESPONSE_OK)
     run = TRUE;
 
+  preview_cleanup ();
+
   if (preview_rgb_data != NULL)
     g_free (preview_rgb_data);
 
@@ -19,6 +19,15 @@
 #include "libgimp/stdplugins-intl.h"
 
 
+#define MAPOBJECT_BAND_HEIGHT 32
+
+
+typedef struct
+{
+  ImageBuffer  dest;
+} MapObjectContext;
+
+
 /*************/
 /* Main loop */
 /*************/
@@ -128,19 +137,11 @@ init_compute (void)
 
         memcpy (rotmat, b, sizeof (gfloat) * 16);
 
-        /* Set up pixel regions for the box face images */
-        /* ============================================ */
+        /* Read the box face images into memory */
+        /* ==================================== */
 
         for (i = 0; i < 6; i++)
-          {
-            box_drawables[i] = gimp_drawable_get (mapvals.boxmap_id[i]);
-
-            gimp_pixel_rgn_init (&box_regions[i], box_drawables[i],
-                                 0, 0,
-                                 box_drawables[i]->width,
-                                 box_drawables[i]->height,
-                                 FALSE, FALSE);
-          }
+          image_buffer_load (&box_images[i], mapvals.boxmap_id[i]);
 
         break;
 
@@ -169,20 +170,11 @@ init_compute (void)
 
         memcpy (rotmat, b, sizeof (gfloat) * 16);
 
-        /* Set up pixel regions for the cylinder cap images */
-        /* ================================================ */
+        /* Read the cylinder cap images into memory */
+        /* ======================================== */
 
         for (i = 0; i < 2; i++)
-          {
-            cylinder_drawables[i] =
-              gimp_drawable_get (mapvals.cylindermap_id[i]);
-
-            gimp_pixel_rgn_init (&cylinder_regions[i], cylinder_drawables[i],
-                                 0, 0,
-                                 cylinder_drawables[i]->width,
-                                 cylinder_drawables[i]->height,
-                                 FALSE, FALSE);
-          }
+          image_buffer_load (&cylinder_images[i], mapvals.cylindermap_id[i]);
 
         break;
     }
@@ -205,13 +197,62 @@ render (gdouble   x,
   *col = get_ray_color (&pos);
 }
 
+/*********************************************************/
+/* Render the rows y_start..y_end - 1, all pixel fetches */
+/* go to memory so this runs in any thread.              */
+/*********************************************************/
+
 static void
-show_progress (gint     min,
-               gint     max,
-               gint     curr,
-               gpointer data)
+render_band (MapObjectContext *ctx,
+             gint              y_start,
+             gint              y_end)
 {
-  gimp_progress_update ((gdouble) curr / (gdouble) max);
+  gint         xcount, ycount;
+  GimpRGB      color;
+  GimpVector3  p;
+
+  if (mapvals.antialiasing == FALSE)
+    {
+      for (ycount = y_start; ycount < y_end; ycount++)
+        {
+          for (xcount = 0; xcount < width; xcount++)
+            {
+              p = int_to_pos (xcount, ycount);
+              color = (* get_ray_color) (&p);
+              poke (xcount, ycount, &color, &ctx->dest);
+            }
+        }
+    }
+  else
+    {
+      /* Each pixel is supersampled on its own corners, */
+      /* so splitting the area gives the same pixels.   */
+      /* ============================================== */
+
+      gimp_adaptive_supersample_area (0, y_start,
+                                      width - 1, y_end - 1,
+                                      max_depth,
+                                      mapvals.pixeltreshold,
+                                      render,
+                                      NULL,
+                                      poke,
+                                      &ctx->dest,
+                                      NULL,
+                                      NULL);
+    }
+}
+
+/* Render a band, called by gimp_parallel_run() */
+static void
+render_band_func (gint              band,
+                  gint              n_bands,
+                  gint              thread,
+                  MapObjectContext *ctx)
+{
+  gint y_start = band * MAPOBJECT_BAND_HEIGHT;
+  gint y_end   = MIN (y_start + MAPOBJECT_BAND_HEIGHT, height);
+
+  render_band (ctx, y_start, y_end);
 }
 
 /**************************************************/
@@ -222,13 +263,10 @@ show_progress (gint     min,
 void
 compute_image (void)
 {
-  gint         xcount, ycount;
-  GimpRGB      color;
-  glong        progress_counter = 0;
-  GimpVector3  p;
-  gint32       new_image_id = -1;
-  gint32       new_layer_id = -1;
-  gboolean     insert_layer = FALSE;
+  MapObjectContext  ctx          = { { 0, }, };
+  gint32            new_image_id = -1;
+  gint32            new_layer_id = -1;
+  gboolean          insert_layer = FALSE;
 
   init_compute ();
 
@@ -282,35 +320,20 @@ compute_image (void)
         break;
     }
 
-  if (mapvals.antialiasing == FALSE)
-    {
-      for (ycount = 0; ycount < height; ycount++)
-        {
-          for (xcount = 0; xcount < width; xcount++)
-            {
-              p = int_to_pos (xcount, ycount);
-              color = (* get_ray_color) (&p);
-              poke (xcount, ycount, &color, NULL);
+  ctx.dest.drawable_id = output_drawable->drawable_id;
+  ctx.dest.width       = width;
+  ctx.dest.height      = height;
+  ctx.dest.bpp         = output_drawable->bpp;
+  ctx.dest.pixels      = g_new (guchar, (gsize) width * height * ctx.dest.bpp);
+
+  gimp_parallel_run ((height + MAPOBJECT_BAND_HEIGHT - 1) /
+                     MAPOBJECT_BAND_HEIGHT,
+                     (GimpParallelFunc) render_band_func, &ctx, TRUE);
+
+  gimp_pixel_rgn_set_rect (&dest_region, ctx.dest.pixels,
+                           0, 0, width, height);
+  g_free (ctx.dest.pixels);
 
-              if ((progress_counter++ % width) == 0)
-                gimp_progress_update ((gdouble) progress_counter /
-                                      (gdouble) maxcounter);
-            }
-        }
-    }
-  else
-    {
-      gimp_adaptive_supersample_area (0, 0,
-                                      width - 1, height - 1,
-                                      max_depth,
-                                      mapvals.pixeltreshold,
-                                      render,
-                                      NULL,
-                                      poke,
-                                      NULL,
-                                      show_progress,
-                                      NULL);
-    }
   gimp_progress_update (1.0);
 
   /* Update the region */
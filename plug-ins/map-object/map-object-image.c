@@ -24,13 +24,11 @@
 
 
 GimpDrawable *input_drawable, *output_drawable;
-GimpPixelRgn source_region,dest_region;
+GimpPixelRgn dest_region;
 
-GimpDrawable *box_drawables[6];
-GimpPixelRgn box_regions[6];
-
-GimpDrawable *cylinder_drawables[2];
-GimpPixelRgn cylinder_regions[2];
+ImageBuffer  source_image = { -1, 0, 0, 0, FALSE, NULL };
+ImageBuffer  box_images[6];
+ImageBuffer  cylinder_images[2];
 
 guchar          *preview_rgb_data = NULL;
 gint             preview_rgb_stride;
@@ -51,11 +49,11 @@ GimpRGB
 peek (gint x,
       gint y)
 {
-  static guchar data[4];
-
-  GimpRGB color;
+  const guchar *data;
+  GimpRGB       color;
 
-  gimp_pixel_rgn_get_pixel (&source_region, data, x, y);
+  data = (source_image.pixels +
+          ((gsize) y * source_image.width + x) * source_image.bpp);
 
   color.r = (gdouble) (data[0]) / 255.0;
   color.g = (gdouble) (data[1]) / 255.0;
@@ -81,19 +79,19 @@ peek_box_image (gint image,
                 gint x,
                 gint y)
 {
-  static guchar data[4];
-
-  GimpRGB color;
+  const ImageBuffer *buffer = &box_images[image];
+  const guchar      *data;
+  GimpRGB            color;
 
-  gimp_pixel_rgn_get_pixel (&box_regions[image], data, x, y);
+  data = buffer->pixels + ((gsize) y * buffer->width + x) * buffer->bpp;
 
   color.r = (gdouble) (data[0]) / 255.0;
   color.g = (gdouble) (data[1]) / 255.0;
   color.b = (gdouble) (data[2]) / 255.0;
 
-  if (box_drawables[image]->bpp == 4)
+  if (buffer->bpp == 4)
     {
-      if (gimp_drawable_has_alpha (box_drawables[image]->drawable_id))
+      if (buffer->has_alpha)
         color.a = (gdouble) (data[3]) / 255.0;
       else
         color.a = 1.0;
@@ -111,19 +109,19 @@ peek_cylinder_image (gint image,
                      gint x,
                      gint y)
 {
-  static guchar data[4];
+  const ImageBuffer *buffer = &cylinder_images[image];
+  const guchar      *data;
+  GimpRGB            color;
 
-  GimpRGB color;
-
-  gimp_pixel_rgn_get_pixel (&cylinder_regions[image],data, x, y);
+  data = buffer->pixels + ((gsize) y * buffer->width + x) * buffer->bpp;
 
   color.r = (gdouble) (data[0]) / 255.0;
   color.g = (gdouble) (data[1]) / 255.0;
   color.b = (gdouble) (data[2]) / 255.0;
 
-  if (cylinder_drawables[image]->bpp == 4)
+  if (buffer->bpp == 4)
     {
-      if (gimp_drawable_has_alpha (cylinder_drawables[image]->drawable_id))
+      if (buffer->has_alpha)
         color.a = (gdouble) (data[3]) / 255.0;
       else
         color.a = 1.0;
@@ -136,17 +134,20 @@ peek_cylinder_image (gint image,
   return color;
 }
 
+/* Store a pixel in the ImageBuffer passed as data */
 void
 poke (gint      x,
       gint      y,
       GimpRGB  *color,
       gpointer  data)
 {
-  static guchar col[4];
+  ImageBuffer *buffer = data;
+  guchar       col[4];
 
   gimp_rgba_get_uchar (color, &col[0], &col[1], &col[2], &col[3]);
 
-  gimp_pixel_rgn_set_pixel (&dest_region, col, x, y);
+  memcpy (buffer->pixels + ((gsize) y * buffer->width + x) * buffer->bpp,
+          col, buffer->bpp);
 }
 
 gint
@@ -166,8 +167,8 @@ checkbounds_box_image (gint image,
 {
   gint w, h;
 
-  w = box_drawables[image]->width;
-  h = box_drawables[image]->height;
+  w = box_images[image].width;
+  h = box_images[image].height;
 
   if (x < 0 || y < 0 || x >= w || y >= h)
     return FALSE ;
@@ -182,8 +183,8 @@ checkbounds_cylinder_image (gint image,
 {
   gint w, h;
 
-  w = cylinder_drawables[image]->width;
-  h = cylinder_drawables[image]->height;
+  w = cylinder_images[image].width;
+  h = cylinder_images[image].height;
 
   if (x < 0 || y < 0 || x >= w || y >= h)
     return FALSE;
@@ -286,8 +287,8 @@ get_box_image_color (gint    image,
   gint    x1, y1, x2, y2;
   GimpRGB p[4];
 
-  w = box_drawables[image]->width;
-  h = box_drawables[image]->height;
+  w = box_images[image].width;
+  h = box_images[image].height;
 
   x1 = (gint) ((u * (gdouble) w));
   y1 = (gint) ((v * (gdouble) h));
@@ -318,8 +319,8 @@ get_cylinder_image_color (gint    image,
   gint    x1, y1, x2, y2;
   GimpRGB p[4];
 
-  w = cylinder_drawables[image]->width;
-  h = cylinder_drawables[image]->height;
+  w = cylinder_images[image].width;
+  h = cylinder_images[image].height;
 
   x1 = (gint) ((u * (gdouble) w));
   y1 = (gint) ((v * (gdouble) h));
@@ -367,8 +368,7 @@ image_setup (GimpDrawable *drawable,
   width  = input_drawable->width;
   height = input_drawable->height;
 
-  gimp_pixel_rgn_init (&source_region, input_drawable,
-                       0, 0, width, height, FALSE, FALSE);
+  image_buffer_load (&source_image, input_drawable->drawable_id);
 
   maxcounter = (glong) width * (glong) height;
 
@@ -403,3 +403,47 @@ image_setup (GimpDrawable *drawable,
 
   return TRUE;
 }
+
+/*************************************************/
+/* Read a drawable into memory, unless the same  */
+/* drawable is already loaded into the buffer.   */
+/*************************************************/
+
+void
+image_buffer_load (ImageBuffer *buffer,
+                   gint32       drawable_id)
+{
+  GimpDrawable *drawable;
+  GimpPixelRgn  region;
+
+  if (buffer->pixels && buffer->drawable_id == drawable_id)
+    return;
+
+  image_buffer_free (buffer);
+
+  drawable = gimp_drawable_get (drawable_id);
+
+  buffer->drawable_id = drawable_id;
+  buffer->width       = drawable->width;
+  buffer->height      = drawable->height;
+  buffer->bpp         = drawable->bpp;
+  buffer->has_alpha   = gimp_drawable_has_alpha (drawable_id);
+  buffer->pixels      = g_new (guchar, ((gsize) buffer->width *
+                                        buffer->height * buffer->bpp));
+
+  gimp_pixel_rgn_init (&region, drawable,
+                       0, 0, buffer->width, buffer->height, FALSE, FALSE);
+  gimp_pixel_rgn_get_rect (&region, buffer->pixels,
+                           0, 0, buffer->width, buffer->height);
+
+  gimp_drawable_detach (drawable);
+}
+
+void
+image_buffer_free (ImageBuffer *buffer)
+{
+  g_free (buffer->pixels);
+
+  buffer->drawable_id = -1;
+  buffer->pixels      = NULL;
+}
@@ -1,17 +1,29 @@
 #ifndef __MAPOBJECT_IMAGE_H__
 #define __MAPOBJECT_IMAGE_H__
 
+/* A drawable read into memory, so the renderer threads can fetch */
+/* pixels without going through the (single threaded) tile cache.  */
+/* =============================================================== */
+
+typedef struct
+{
+  gint32    drawable_id;
+  gint      width;
+  gint      height;
+  gint      bpp;
+  gboolean  has_alpha;
+  guchar   *pixels;
+} ImageBuffer;
+
 /* Externally visible variables */
 /* ============================ */
 
 extern GimpDrawable *input_drawable, *output_drawable;
-extern GimpPixelRgn  source_region,dest_region;
-
-extern GimpDrawable *box_drawables[6];
-extern GimpPixelRgn  box_regions[6];
+extern GimpPixelRgn  dest_region;
 
-extern GimpDrawable *cylinder_drawables[2];
-extern GimpPixelRgn  cylinder_regions[2];
+extern ImageBuffer   source_image;
+extern ImageBuffer   box_images[6];
+extern ImageBuffer   cylinder_images[2];
 
 extern guchar          *preview_rgb_data;
 extern gint             preview_rgb_stride;
@@ -31,6 +43,9 @@ extern GimpTile *current_in_tile, *current_out_tile;
 
 extern gint        image_setup              (GimpDrawable *drawable,
                                              gint          interactive);
+extern void        image_buffer_load        (ImageBuffer  *buffer,
+                                             gint32        drawable_id);
+extern void        image_buffer_free        (ImageBuffer  *buffer);
 extern glong       in_xy_to_index           (gint          x,
                                              gint          y);
 extern glong       out_xy_to_index          (gint          x,
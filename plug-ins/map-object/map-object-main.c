@@ -321,6 +321,14 @@ run (const gchar      *name,
     gimp_displays_flush ();
 
   gimp_drawable_detach (drawable);
+
+  image_buffer_free (&source_image);
+
+  for (i = 0; i < 6; i++)
+    image_buffer_free (&box_images[i]);
+
+  for (i = 0; i < 2; i++)
+    image_buffer_free (&cylinder_images[i]);
 }
 
 const GimpPlugInInfo PLUG_IN_INFO =
@@ -4,6 +4,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gtk/gtk.h>
 
 #include <libgimp/gimp.h>
@@ -17,9 +19,15 @@
 #include "map-object-preview.h"
 
 
+/* The preview first shows one ray per PREVIEW_COARSE_STEP squared */
+/* pixels, the full resolution pass follows when the UI is idle.   */
+#define PREVIEW_COARSE_STEP 4
+
 gdouble mat[3][4];
 gint    lightx, lighty;
 
+static guint preview_refine_idle = 0;
+
 /* Protos */
 /* ====== */
 
@@ -28,7 +36,9 @@ static void compute_preview         (gint x,
                                      gint w,
                                      gint h,
                                      gint pw,
-                                     gint ph);
+                                     gint ph,
+                                     gint step);
+static gboolean preview_refine_callback (gpointer data);
 static void draw_light_marker       (cairo_t *cr,
                                      gint xpos,
                                      gint ypos);
@@ -73,6 +83,7 @@ static void draw_wireframe_cylinder (cairo_t *cr,
 /**************************************************************/
 /* Computes a preview of the rectangle starting at (x,y) with */
 /* dimensions (w,h), placing the result in preview_RGB_data.  */
+/* One ray is cast for each step x step block of pixels.      */
 /**************************************************************/
 
 static void
@@ -81,7 +92,8 @@ compute_preview (gint x,
                  gint w,
                  gint h,
                  gint pw,
-                 gint ph)
+                 gint ph,
+                 gint step)
 {
   gdouble      xpostab[PREVIEW_WIDTH];
   gdouble      ypostab[PREVIEW_HEIGHT];
@@ -137,6 +149,27 @@ compute_preview (gint x,
       index = ycnt * preview_rgb_stride;
       for (xcnt = 0; xcnt < pw; xcnt++)
         {
+          if (ycnt % step != 0)
+            {
+              /* Copy the row of blocks above */
+              /* ============================ */
+
+              memcpy (preview_rgb_data + index,
+                      preview_rgb_data + index - preview_rgb_stride, 4);
+              index += 4;
+              continue;
+            }
+          else if (xcnt % step != 0)
+            {
+              /* Copy the pixel to the left */
+              /* ========================== */
+
+              memcpy (preview_rgb_data + index,
+                      preview_rgb_data + index - 4, 4);
+              index += 4;
+              continue;
+            }
+
           p1.x = xpostab[xcnt];
           p1.y = ypostab[ycnt];
 
@@ -291,13 +324,49 @@ compute_preview_image (void)
   gdk_window_set_cursor (gtk_widget_get_window (previewarea), cursor);
   gdk_cursor_unref (cursor);
 
-  compute_preview (0, 0, width - 1, height - 1, pw, ph);
+  /* Show a coarse preview right away, and refine it once */
+  /* there are no more pending events.                    */
+  /* ==================================================== */
+
+  if (preview_refine_idle != 0)
+    g_source_remove (preview_refine_idle);
+
+  compute_preview (0, 0, width - 1, height - 1, pw, ph, PREVIEW_COARSE_STEP);
+
+  preview_refine_idle = g_idle_add (preview_refine_callback, NULL);
 
   cursor = gdk_cursor_new_for_display (display, GDK_HAND2);
   gdk_window_set_cursor(gtk_widget_get_window (previewarea), cursor);
   gdk_cursor_unref (cursor);
 }
 
+static gboolean
+preview_refine_callback (gpointer data)
+{
+  gint pw, ph;
+
+  pw = PREVIEW_WIDTH * mapvals.zoom;
+  ph = PREVIEW_HEIGHT * mapvals.zoom;
+
+  compute_preview (0, 0, width - 1, height - 1, pw, ph, 1);
+
+  gtk_widget_queue_draw (previewarea);
+
+  preview_refine_idle = 0;
+
+  return FALSE;
+}
+
+void
+preview_cleanup (void)
+{
+  if (preview_refine_idle != 0)
+    {
+      g_source_remove (preview_refine_idle);
+      preview_refine_idle = 0;
+    }
+}
+
 gboolean
 preview_expose (GtkWidget      *widget,
                 GdkEventExpose *eevent)
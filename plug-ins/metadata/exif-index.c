@@ -0,0 +1,368 @@
+/* exif-index.c - look up single tags in an Exif block
+ *
+ * Copyright (C) 2008, Róman Joost <romanofski@gimp.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Unlike exif_data_new_from_data(), which loads every entry of every
+ * IFD (and the thumbnail), the index only validates the TIFF header.
+ * IFDs are located when a tag is first looked up in them, and only
+ * the entry that was asked for is copied and handed to libexif for
+ * formatting, so the values are the same as those merged into the
+ * XMP model by xmp_merge_from_exifbuffer().
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include "exif-index.h"
+
+
+#define EXIF_HEADER     "Exif\0\0"
+#define EXIF_HEADER_LEN 6
+
+#define ENTRY_SIZE      12
+
+
+struct _ExifIndex
+{
+  const guchar  *data;     /*  the TIFF header and what follows  */
+  gsize          length;
+  ExifByteOrder  order;
+
+  /*  offsets of the IFDs, 0 if there is no such IFD  */
+  guint32        ifd[EXIF_IFD_COUNT];
+  gboolean       located[EXIF_IFD_COUNT];
+};
+
+
+/*  local function prototypes  */
+
+static guint32        exif_index_locate       (ExifIndex    *index,
+                                               ExifIfd       ifd);
+static const guchar * exif_index_find_entry   (ExifIndex    *index,
+                                               ExifIfd       ifd,
+                                               ExifTag       tag);
+static guint32        exif_index_get_pointer  (ExifIndex    *index,
+                                               ExifIfd       ifd,
+                                               ExifTag       tag);
+static gchar        * exif_index_format_entry (ExifIndex    *index,
+                                               ExifIfd       ifd,
+                                               const guchar *entry,
+                                               ExifTag       tag);
+
+
+/*  the order in which the IFDs are searched for a tag  */
+static const ExifIfd search_order[] =
+{
+  EXIF_IFD_0,
+  EXIF_IFD_EXIF,
+  EXIF_IFD_GPS,
+  EXIF_IFD_INTEROPERABILITY,
+  EXIF_IFD_1
+};
+
+
+/* public functions */
+
+/**
+ * exif_index_new:
+ * @data: an Exif block, as stored in the "exif-data" parasite
+ * @length: the size of @data
+ * @error: return location for a #GError
+ *
+ * Checks the TIFF header of @data and prepares for looking up single
+ * tags.  @data must stay valid as long as the index is used.
+ *
+ * Return value: a new #ExifIndex, or %NULL if @data is no Exif block
+ **/
+ExifIndex *
+exif_index_new (const guchar  *data,
+                gsize          length,
+                GError       **error)
+{
+  ExifIndex     *index;
+  ExifByteOrder  order;
+  guint32        offset;
+
+  g_return_val_if_fail (data != NULL || length == 0, NULL);
+
+  if (length >= EXIF_HEADER_LEN &&
+      ! memcmp (data, EXIF_HEADER, EXIF_HEADER_LEN))
+    {
+      data   += EXIF_HEADER_LEN;
+      length -= EXIF_HEADER_LEN;
+    }
+
+  if (length < 8)
+    goto invalid;
+
+  if (! memcmp (data, "II*", 4))
+    order = EXIF_BYTE_ORDER_INTEL;
+  else if (! memcmp (data, "MM\0*", 4))
+    order = EXIF_BYTE_ORDER_MOTOROLA;
+  else
+    goto invalid;
+
+  offset = exif_get_long (data + 4, order);
+
+  if (offset < 8 || offset > length - 2)
+    goto invalid;
+
+  index = g_slice_new0 (ExifIndex);
+
+  index->data   = data;
+  index->length = length;
+  index->order  = order;
+
+  index->ifd[EXIF_IFD_0]     = offset;
+  index->located[EXIF_IFD_0] = TRUE;
+
+  return index;
+
+ invalid:
+  g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                       "Not a valid Exif block");
+
+  return NULL;
+}
+
+void
+exif_index_free (ExifIndex *index)
+{
+  g_return_if_fail (index != NULL);
+
+  g_slice_free (ExifIndex, index);
+}
+
+/**
+ * exif_index_get_value:
+ * @index: an #ExifIndex
+ * @tag: the tag to look up
+ *
+ * Looks for @tag in the IFDs in which it is defined and formats the
+ * first entry found with exif_entry_get_value().
+ *
+ * Return value: the newly allocated value, or %NULL if the Exif block
+ * has no such entry
+ **/
+gchar *
+exif_index_get_value (ExifIndex *index,
+                      ExifTag    tag)
+{
+  gint i;
+
+  g_return_val_if_fail (index != NULL, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (search_order); i++)
+    {
+      ExifIfd       ifd = search_order[i];
+      const guchar *entry;
+
+      if (! exif_tag_get_name_in_ifd (tag, ifd))
+        continue;
+
+      entry = exif_index_find_entry (index, ifd, tag);
+
+      if (entry)
+        return exif_index_format_entry (index, ifd, entry, tag);
+    }
+
+  return NULL;
+}
+
+
+/* private functions */
+
+static guint32
+exif_index_locate (ExifIndex *index,
+                   ExifIfd    ifd)
+{
+  guint32 offset = 0;
+
+  if (index->located[ifd])
+    return index->ifd[ifd];
+
+  /*  mark it first, the pointers might form a loop  */
+  index->located[ifd] = TRUE;
+
+  switch (ifd)
+    {
+    case EXIF_IFD_EXIF:
+      offset = exif_index_get_pointer (index, EXIF_IFD_0,
+                                       EXIF_TAG_EXIF_IFD_POINTER);
+      break;
+
+    case EXIF_IFD_GPS:
+      offset = exif_index_get_pointer (index, EXIF_IFD_0,
+                                       EXIF_TAG_GPS_INFO_IFD_POINTER);
+      break;
+
+    case EXIF_IFD_INTEROPERABILITY:
+      offset = exif_index_get_pointer (index, EXIF_IFD_EXIF,
+                                       EXIF_TAG_INTEROPERABILITY_IFD_POINTER);
+      break;
+
+    case EXIF_IFD_1:
+      {
+        /*  IFD 1 is linked from the end of IFD 0  */
+        guint32 ifd0 = index->ifd[EXIF_IFD_0];
+        guint16 n    = exif_get_short (index->data + ifd0, index->order);
+        gsize   next = ifd0 + 2 + (gsize) n * ENTRY_SIZE;
+
+        if (next + 4 <= index->length)
+          offset = exif_get_long (index->data + next, index->order);
+      }
+      break;
+
+    default:
+      break;
+    }
+
+  if (offset < 8 || offset > index->length - 2)
+    offset = 0;
+
+  index->ifd[ifd] = offset;
+
+  return offset;
+}
+
+static const guchar *
+exif_index_find_entry (ExifIndex *index,
+                       ExifIfd    ifd,
+                       ExifTag    tag)
+{
+  guint32       offset = exif_index_locate (index, ifd);
+  const guchar *entry;
+  guint16       n;
+  gint          i;
+
+  if (! offset)
+    return NULL;
+
+  n = exif_get_short (index->data + offset, index->order);
+
+  /*  clip truncated directories  */
+  n = MIN (n, (index->length - offset - 2) / ENTRY_SIZE);
+
+  /*  entries should be sorted by tag, but don't rely on it  */
+  for (i = 0, entry = index->data + offset + 2;
+       i < n;
+       i++, entry += ENTRY_SIZE)
+    {
+      if (exif_get_short (entry, index->order) == tag)
+        return entry;
+    }
+
+  return NULL;
+}
+
+static guint32
+exif_index_get_pointer (ExifIndex *index,
+                        ExifIfd    ifd,
+                        ExifTag    tag)
+{
+  const guchar *entry = exif_index_find_entry (index, ifd, tag);
+
+  if (! entry)
+    return 0;
+
+  return exif_get_long (entry + 8, index->order);
+}
+
+static gchar *
+exif_index_format_entry (ExifIndex    *index,
+                         ExifIfd       ifd,
+                         const guchar *entry,
+                         ExifTag       tag)
+{
+  ExifFormat    format;
+  guint32       components;
+  guint         format_size;
+  guint32       size;
+  const guchar *value;
+  ExifMem      *mem;
+  ExifData     *exif_data;
+  ExifEntry    *exif_entry;
+  gchar         buffer[1024];
+  gchar        *result = NULL;
+
+  format      = exif_get_short (entry + 2, index->order);
+  components  = exif_get_long (entry + 4, index->order);
+  format_size = exif_format_get_size (format);
+
+  if (! format_size || components > G_MAXUINT32 / format_size)
+    return NULL;
+
+  size = format_size * components;
+
+  if (size <= 4)
+    {
+      value = entry + 8;
+    }
+  else
+    {
+      guint32 offset = exif_get_long (entry + 8, index->order);
+
+      if (offset > index->length || size > index->length - offset)
+        return NULL;
+
+      value = index->data + offset;
+    }
+
+  /*  exif_entry_get_value() takes the byte order from the ExifData
+   *  the entry belongs to, so give it an otherwise empty one
+   */
+  mem        = exif_mem_new_default ();
+  exif_data  = exif_data_new_mem (mem);
+  exif_entry = exif_entry_new_mem (mem);
+
+  if (exif_data && exif_entry)
+    {
+      exif_data_set_byte_order (exif_data, index->order);
+
+      exif_entry->tag        = tag;
+      exif_entry->format     = format;
+      exif_entry->components = components;
+      exif_entry->size       = size;
+      exif_entry->data       = exif_mem_alloc (mem, MAX (size, 1));
+
+      if (exif_entry->data)
+        {
+          memcpy (exif_entry->data, value, size);
+
+          exif_content_add_entry (exif_data->ifd[ifd], exif_entry);
+
+          if (exif_entry_get_value (exif_entry, buffer, sizeof (buffer)))
+            result = g_strdup (buffer);
+        }
+    }
+
+  if (exif_entry)
+    exif_entry_unref (exif_entry);
+
+  if (exif_data)
+    exif_data_unref (exif_data);
+
+  exif_mem_unref (mem);
+
+  return result;
+}
@@ -34,6 +34,7 @@
 #include "xmp-encode.h"
 #include "interface.h"
 #include "exif-decode.h"
+#include "exif-index.h"
 /* FIXME: uncomment when these are working
 #include "exif-encode.h"
 #include "iptc-decode.h"
@@ -53,6 +54,10 @@ static void  run   (const gchar      *name,
                     gint             *nreturn_vals,
                     GimpParam       **return_vals);
 
+static GimpPDBStatusType get_exif_tag (gint32       image_ID,
+                                       const gchar *tag_name,
+                                       GimpParam   *value);
+
 
 /* local variables */
 const GimpPlugInInfo PLUG_IN_INFO =
@@ -152,6 +157,16 @@ query (void)
     { GIMP_PDB_STRING,      "value",     "XMP property value"           }
   };
 
+  static const GimpParamDef get_exif_args[] =
+  {
+    { GIMP_PDB_IMAGE,       "image",     "Input image"                  },
+    { GIMP_PDB_STRING,      "tag",       "EXIF tag name"                }
+  };
+  static const GimpParamDef get_exif_return_vals[] =
+  {
+    { GIMP_PDB_STRING,      "value",     "EXIF tag value"               }
+  };
+
 /* FIXME: uncomment when these are working
   static const GimpParamDef delete_args[] =
   {
@@ -322,6 +337,25 @@ query (void)
                           G_N_ELEMENTS (set_simple_args), 0,
                           set_simple_args, NULL);
 
+  gimp_install_procedure (GET_EXIF_PROC,
+                          "Retrieve the value of an EXIF tag",
+                          "Retrieve the value of a single tag, such as "
+                          "\"Orientation\" or \"XResolution\", from the "
+                          "EXIF block attached to the image.  Only the "
+                          "requested entry is read, the XMP metadata is "
+                          "neither built nor updated, which makes this "
+                          "much faster than plug_in_metadata_get_simple() "
+                          "for looking up a few tags.",
+                          "Róman Joost <romanofski@gimp.org>",
+                          "Róman Joost <romanofski@gimp.org>",
+                          "2008",
+                          NULL,
+                          NULL,
+                          GIMP_PLUGIN,
+                          G_N_ELEMENTS (get_exif_args),
+                          G_N_ELEMENTS (get_exif_return_vals),
+                          get_exif_args, get_exif_return_vals);
+
   gimp_install_procedure (IMPORT_PROC,
                           "Import XMP from a file into the current image",
                           "Load an XMP packet from a file and import it into "
@@ -377,6 +411,18 @@ run (const gchar      *name,
   INIT_I18N();
   g_type_init();
 
+  /* single EXIF tags are looked up without building the XMP model */
+  if (! strcmp (name, GET_EXIF_PROC))
+    {
+      values[0].data.d_status = get_exif_tag (param[0].data.d_image,
+                                              param[1].data.d_string,
+                                              &values[1]);
+      if (values[0].data.d_status == GIMP_PDB_SUCCESS)
+        *nreturn_vals = 2;
+
+      return;
+    }
+
   if (! strcmp (name, EDITOR_PROC))
     image_ID = param[1].data.d_image;
   else
@@ -564,3 +610,51 @@ run (const gchar      *name,
 
   values[0].data.d_status = status;
 }
+
+static GimpPDBStatusType
+get_exif_tag (gint32       image_ID,
+              const gchar *tag_name,
+              GimpParam   *value)
+{
+  GimpParasite *parasite;
+  ExifIndex    *index;
+  ExifTag       tag;
+  gchar        *tag_value = NULL;
+  GError       *error     = NULL;
+
+  if (! tag_name)
+    return GIMP_PDB_CALLING_ERROR;
+
+  /* 0 is GPSVersionID, but also what unknown names map to */
+  tag = exif_tag_from_name (tag_name);
+  if (! tag && strcmp (tag_name, exif_tag_get_name_in_ifd (0, EXIF_IFD_GPS)))
+    return GIMP_PDB_CALLING_ERROR;
+
+  parasite = gimp_image_get_parasite (image_ID, "exif-data");
+  if (! parasite)
+    return GIMP_PDB_EXECUTION_ERROR;
+
+  index = exif_index_new (gimp_parasite_data (parasite),
+                          gimp_parasite_data_size (parasite),
+                          &error);
+  if (index)
+    {
+      tag_value = exif_index_get_value (index, tag);
+      exif_index_free (index);
+    }
+  else
+    {
+      g_printerr ("\nEXIF data seems to be corrupt: %s\n", error->message);
+      g_error_free (error);
+    }
+
+  gimp_parasite_free (parasite);
+
+  if (! tag_value)
+    return GIMP_PDB_EXECUTION_ERROR;
+
+  value->type          = GIMP_PDB_STRING;
+  value->data.d_string = tag_value;
+
+  return GIMP_PDB_SUCCESS;
+}
@@ -30,6 +30,7 @@
 #define SET_PROC            "plug-in-metadata-set"
 #define GET_SIMPLE_PROC     "plug-in-metadata-get-simple"
 #define SET_SIMPLE_PROC     "plug-in-metadata-set-simple"
+#define GET_EXIF_PROC       "plug-in-metadata-get-exif"
 #define IMPORT_PROC         "plug-in-metadata-import"
 #define EXPORT_PROC         "plug-in-metadata-export"
 #define PLUG_IN_BINARY      "metadata"
@@ -28,29 +28,56 @@
 #include "libgimp/stdplugins-intl.h"
 
 
-static cairo_surface_t * print_surface_from_drawable (gint32  drawable_ID);
+/*  the pixels are read, converted and drawn in bands of this many rows,
+ *  so that only one band has to be kept in memory
+ */
+#define PRINT_BAND_HEIGHT  128
 
-static void              print_draw_crop_marks       (GtkPrintContext *context,
-                                                      gdouble          x,
-                                                      gdouble          y,
-                                                      gdouble          w,
-                                                      gdouble          h);
 
-gboolean
-print_draw_page (GtkPrintContext *context,
-                 PrintData       *data)
+typedef struct
 {
-  cairo_t         *cr = gtk_print_context_get_cairo_context (context);
+  PrintData       *data;
+  cairo_t         *cr;
+  GimpDrawable    *drawable;
+  GimpPixelRgn     region;
+  GimpImageType    image_type;
+  cairo_format_t   format;
+  guchar           cmap[3 * 256];
+  guchar          *buffer;
   cairo_surface_t *surface;
-  gint             width;
-  gint             height;
-  gdouble          scale_x;
-  gdouble          scale_y;
+  gint             y;
+} PrintBands;
+
 
-  surface = print_surface_from_drawable (data->drawable_id);
+static gboolean     print_draw_thumbnail  (cairo_t         *cr,
+                                           PrintData       *data,
+                                           gint             width,
+                                           gint             height,
+                                           gdouble          scale_x,
+                                           gdouble          scale_y);
 
-  width  = cairo_image_surface_get_width (surface);
-  height = cairo_image_surface_get_height (surface);
+static PrintBands * print_bands_new       (cairo_t         *cr,
+                                           PrintData       *data);
+static gboolean     print_bands_draw_next (PrintBands      *bands);
+static void         print_bands_free      (PrintBands      *bands);
+static gboolean     print_bands_idle      (PrintBands      *bands);
+
+static void         print_draw_crop_marks (GtkPrintContext *context,
+                                           gdouble          x,
+                                           gdouble          y,
+                                           gdouble          w,
+                                           gdouble          h);
+
+gboolean
+print_draw_page (GtkPrintContext *context,
+                 PrintData       *data)
+{
+  cairo_t    *cr     = gtk_print_context_get_cairo_context (context);
+  gint        width  = gimp_drawable_width  (data->drawable_id);
+  gint        height = gimp_drawable_height (data->drawable_id);
+  PrintBands *bands;
+  gdouble     scale_x;
+  gdouble     scale_y;
 
   scale_x = gtk_print_context_get_dpi_x (context) / data->xres;
   scale_y = gtk_print_context_get_dpi_y (context) / data->yres;
@@ -62,15 +89,141 @@ print_draw_page (GtkPrintContext *context,
                            0, 0, width * scale_x, height * scale_y);
 
   cairo_scale (cr, scale_x, scale_y);
-  cairo_rectangle (cr, 0, 0, width, height);
-  cairo_set_source_surface (cr, surface, 0, 0);
-  cairo_fill (cr);
 
-  cairo_surface_destroy (surface);
+  /*  the print preview only needs as many pixels as it displays  */
+  if (data->preview &&
+      print_draw_thumbnail (cr, data, width, height, scale_x, scale_y))
+    {
+      gimp_progress_update (1.0);
+
+      return TRUE;
+    }
+
+  bands = print_bands_new (cr, data);
+
+  if (data->preview)
+    {
+      while (print_bands_draw_next (bands));
+
+      print_bands_free (bands);
+    }
+  else
+    {
+      /*  draw the bands from the main loop, so that the print dialog
+       *  and the progress stay alive while a large image is printed
+       */
+      gtk_print_operation_set_defer_drawing (data->operation);
+
+      g_idle_add ((GSourceFunc) print_bands_idle, bands);
+    }
 
   return TRUE;
 }
 
+/*  This thumbnail code should eventually end up in libgimpui.  */
+
+cairo_surface_t *
+print_surface_from_thumbnail (gint32 drawable_ID,
+                              gint   width,
+                              gint   height)
+{
+  cairo_surface_t *surface;
+  cairo_format_t   format;
+  guchar          *data;
+  guchar          *dest;
+  const guchar    *src;
+  gint             src_stride;
+  gint             dest_stride;
+  gint             y;
+  gint             bpp;
+
+  g_return_val_if_fail (width  > 0 && width  <= 1024, NULL);
+  g_return_val_if_fail (height > 0 && height <= 1024, NULL);
+
+  data = gimp_drawable_get_thumbnail_data (drawable_ID,
+                                           &width, &height, &bpp);
+
+  switch (bpp)
+    {
+    case 1:
+    case 3:
+      format = CAIRO_FORMAT_RGB24;
+      break;
+
+    case 2:
+    case 4:
+      format = CAIRO_FORMAT_ARGB32;
+      break;
+
+    default:
+      g_assert_not_reached ();
+      break;
+    }
+
+  surface = cairo_image_surface_create (format, width, height);
+
+  src         = data;
+  src_stride  = width * bpp;
+
+  dest        = cairo_image_surface_get_data (surface);
+  dest_stride = cairo_image_surface_get_stride (surface);
+
+  for (y = 0; y < height; y++)
+    {
+      const guchar *s = src;
+      guchar       *d = dest;
+      gint          w = width;
+
+      switch (bpp)
+        {
+        case 1:
+          while (w--)
+            {
+              GIMP_CAIRO_RGB24_SET_PIXEL (d, s[0], s[0], s[0]);
+              s += 1;
+              d += 4;
+            }
+          break;
+
+        case 2:
+          while (w--)
+            {
+              GIMP_CAIRO_ARGB32_SET_PIXEL (d, s[0], s[0], s[0], s[1]);
+              s += 2;
+              d += 4;
+            }
+          break;
+
+        case 3:
+          while (w--)
+            {
+              GIMP_CAIRO_RGB24_SET_PIXEL (d, s[0], s[1], s[2]);
+              s += 3;
+              d += 4;
+            }
+          break;
+
+        case 4:
+          while (w--)
+            {
+              GIMP_CAIRO_ARGB32_SET_PIXEL (d, s[0], s[1], s[2], s[3]);
+              s += 4;
+              d += 4;
+            }
+          break;
+        }
+
+      src  += src_stride;
+      dest += dest_stride;
+    }
+
+  g_free (data);
+
+  cairo_surface_mark_dirty (surface);
+
+  return surface;
+}
+
 
 static inline void
 convert_from_rgb (const guchar *src,
@@ -168,21 +321,60 @@ convert_from_indexeda (const guchar *src,
     }
 }
 
-static cairo_surface_t *
-print_surface_from_drawable (gint32 drawable_ID)
+static gboolean
+print_draw_thumbnail (cairo_t   *cr,
+                      PrintData *data,
+                      gint       width,
+                      gint       height,
+                      gdouble    scale_x,
+                      gdouble    scale_y)
 {
-  GimpDrawable    *drawable      = gimp_drawable_get (drawable_ID);
-  GimpPixelRgn     region;
-  GimpImageType    image_type    = gimp_drawable_type (drawable_ID);
   cairo_surface_t *surface;
-  const gint       width         = drawable->width;
-  const gint       height        = drawable->height;
-  guchar           cmap[3 * 256] = { 0, };
-  guchar          *pixels;
-  gint             stride;
-  guint            count         = 0;
-  guint            done          = 0;
-  gpointer         pr;
+  gint             thumb_width  = ceil (width  * scale_x);
+  gint             thumb_height = ceil (height * scale_y);
+
+  if (thumb_width >= width && thumb_height >= height)
+    return FALSE;
+
+  surface = print_surface_from_thumbnail (data->drawable_id,
+                                          CLAMP (thumb_width,  1, 1024),
+                                          CLAMP (thumb_height, 1, 1024));
+  if (! surface)
+    return FALSE;
+
+  cairo_save (cr);
+
+  cairo_scale (cr,
+               (gdouble) width  / cairo_image_surface_get_width (surface),
+               (gdouble) height / cairo_image_surface_get_height (surface));
+
+  cairo_rectangle (cr,
+                   0, 0,
+                   cairo_image_surface_get_width (surface),
+                   cairo_image_surface_get_height (surface));
+  cairo_set_source_surface (cr, surface, 0, 0);
+  cairo_fill (cr);
+
+  cairo_restore (cr);
+
+  cairo_surface_destroy (surface);
+
+  return TRUE;
+}
+
+static PrintBands *
+print_bands_new (cairo_t   *cr,
+                 PrintData *data)
+{
+  PrintBands *bands       = g_slice_new0 (PrintBands);
+  gint32      drawable_ID = data->drawable_id;
+
+  bands->data       = data;
+  bands->cr         = cr;
+  bands->drawable   = gimp_drawable_get (drawable_ID);
+  bands->image_type = gimp_drawable_type (drawable_ID);
+  bands->format     = (gimp_drawable_has_alpha (drawable_ID) ?
+                       CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24);
 
   if (gimp_drawable_is_indexed (drawable_ID))
     {
@@ -191,74 +383,130 @@ print_surface_from_drawable (gint32 drawable_ID)
 
       colors = gimp_image_get_colormap (gimp_item_get_image (drawable_ID),
                                         &num_colors);
-      memcpy (cmap, colors, 3 * num_colors);
+      memcpy (bands->cmap, colors, 3 * num_colors);
       g_free (colors);
     }
 
-  surface = cairo_image_surface_create (gimp_drawable_has_alpha (drawable_ID) ?
-                                        CAIRO_FORMAT_ARGB32 :
-                                        CAIRO_FORMAT_RGB24,
-                                        width, height);
+  gimp_pixel_rgn_init (&bands->region, bands->drawable,
+                       0, 0, bands->drawable->width, bands->drawable->height,
+                       FALSE, FALSE);
 
-  pixels = cairo_image_surface_get_data (surface);
-  stride = cairo_image_surface_get_stride (surface);
+  bands->buffer = g_new (guchar, (bands->drawable->width  *
+                                  bands->drawable->bpp    *
+                                  PRINT_BAND_HEIGHT));
 
-  gimp_pixel_rgn_init (&region, drawable, 0, 0, width, height, FALSE, FALSE);
+  return bands;
+}
 
-  for (pr = gimp_pixel_rgns_register (1, &region);
-       pr != NULL;
-       pr = gimp_pixel_rgns_process (pr))
-    {
-      const guchar *src  = region.data;
-      guchar       *dest = pixels + region.y * stride + region.x * 4;
-      gint          y;
+/*  Reads, converts and draws the next band of rows, returns FALSE
+ *  when the last one has been drawn.
+ */
+static gboolean
+print_bands_draw_next (PrintBands *bands)
+{
+  cairo_t         *cr          = bands->cr;
+  const gint       width       = bands->drawable->width;
+  const gint       height      = bands->drawable->height;
+  const gint       rowstride   = width * bands->drawable->bpp;
+  const gint       band_height = MIN (PRINT_BAND_HEIGHT, height - bands->y);
+  cairo_surface_t *surface;
+  const guchar    *src;
+  guchar          *dest;
+  gint             stride;
+  gint             y;
 
-      for (y = 0; y < region.h; y++)
-        {
-          switch (image_type)
-            {
-            case GIMP_RGB_IMAGE:
-              convert_from_rgb (src, dest, region.w);
-              break;
+  gimp_pixel_rgn_get_rect (&bands->region, bands->buffer,
+                           0, bands->y, width, band_height);
+
+  surface = cairo_image_surface_create (bands->format, width, band_height);
+
+  src    = bands->buffer;
+  dest   = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
 
-            case GIMP_RGBA_IMAGE:
-              convert_from_rgba (src, dest, region.w);
-              break;
+  for (y = 0; y < band_height; y++)
+    {
+      switch (bands->image_type)
+        {
+        case GIMP_RGB_IMAGE:
+          convert_from_rgb (src, dest, width);
+          break;
 
-            case GIMP_GRAY_IMAGE:
-              convert_from_gray (src, dest, region.w);
-              break;
+        case GIMP_RGBA_IMAGE:
+          convert_from_rgba (src, dest, width);
+          break;
 
-            case GIMP_GRAYA_IMAGE:
-              convert_from_graya (src, dest, region.w);
-              break;
+        case GIMP_GRAY_IMAGE:
+          convert_from_gray (src, dest, width);
+          break;
 
-            case GIMP_INDEXED_IMAGE:
-              convert_from_indexed (src, dest, region.w, cmap);
-              break;
+        case GIMP_GRAYA_IMAGE:
+          convert_from_graya (src, dest, width);
+          break;
 
-            case GIMP_INDEXEDA_IMAGE:
-              convert_from_indexeda (src, dest, region.w, cmap);
-              break;
-            }
+        case GIMP_INDEXED_IMAGE:
+          convert_from_indexed (src, dest, width, bands->cmap);
+          break;
 
-          src  += region.rowstride;
-          dest += stride;
+        case GIMP_INDEXEDA_IMAGE:
+          convert_from_indexeda (src, dest, width, bands->cmap);
+          break;
         }
 
-      done += region.h * region.w;
-
-      if (count++ % 16 == 0)
-        gimp_progress_update ((gdouble) done / (width * height));
+      src  += rowstride;
+      dest += stride;
     }
 
+  cairo_surface_mark_dirty (surface);
+
+  /*  pad the band and don't antialias its edges, so that there are
+   *  no seams between neighbouring bands
+   */
+  cairo_save (cr);
+
+  cairo_set_antialias (cr, CAIRO_ANTIALIAS_NONE);
+
+  cairo_rectangle (cr, 0, bands->y, width, band_height);
+  cairo_set_source_surface (cr, surface, 0, bands->y);
+  cairo_pattern_set_extend (cairo_get_source (cr), CAIRO_EXTEND_PAD);
+  cairo_fill (cr);
+
+  cairo_restore (cr);
+
+  cairo_surface_destroy (surface);
+
+  bands->y += band_height;
+
+  gimp_progress_update ((gdouble) bands->y / height);
+
+  return bands->y < height;
+}
+
+static void
+print_bands_free (PrintBands *bands)
+{
   gimp_progress_update (1.0);
 
-  gimp_drawable_detach (drawable);
+  gimp_drawable_detach (bands->drawable);
 
-  cairo_surface_mark_dirty (surface);
+  g_free (bands->buffer);
 
-  return surface;
+  g_slice_free (PrintBands, bands);
+}
+
+static gboolean
+print_bands_idle (PrintBands *bands)
+{
+  GtkPrintOperation *operation = bands->data->operation;
+
+  if (print_bands_draw_next (bands))
+    return TRUE;
+
+  print_bands_free (bands);
+
+  gtk_print_operation_draw_page_finish (operation);
+
+  return FALSE;
 }
 
 static void
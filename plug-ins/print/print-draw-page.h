@@ -15,5 +15,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-gboolean print_draw_page (GtkPrintContext *context,
-                          PrintData       *data);
+gboolean          print_draw_page              (GtkPrintContext *context,
+                                                PrintData       *data);
+
+cairo_surface_t * print_surface_from_thumbnail (gint32           drawable_ID,
+                                                gint             width,
+                                                gint             height);
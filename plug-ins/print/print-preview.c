@@ -20,6 +20,8 @@
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
 
+#include "print.h"
+#include "print-draw-page.h"
 #include "print-preview.h"
 
 
@@ -107,9 +109,6 @@ static void      print_preview_get_page_margins     (PrintPreview     *preview,
                                                      gdouble          *right_margin,
                                                      gdouble          *top_margin,
                                                      gdouble          *bottom_margin);
-static cairo_surface_t * print_preview_get_thumbnail (GimpDrawable    *drawable,
-                                                      gint             width,
-                                                      gint             height);
 
 
 G_DEFINE_TYPE (PrintPreview, print_preview, GTK_TYPE_EVENT_BOX)
@@ -484,9 +483,9 @@ print_preview_expose_event (GtkWidget      *widget,
       gimp_item_is_valid (preview->drawable->drawable_id))
     {
       preview->thumbnail =
-        print_preview_get_thumbnail (preview->drawable,
-                                     MIN (allocation.width,  1024),
-                                     MIN (allocation.height, 1024));
+        print_surface_from_thumbnail (preview->drawable->drawable_id,
+                                      MIN (allocation.width,  1024),
+                                      MIN (allocation.height, 1024));
     }
 
   if (preview->thumbnail != NULL)
@@ -779,108 +778,3 @@ print_preview_get_page_margins (PrintPreview *preview,
                                                          GTK_UNIT_POINTS);
     }
 }
-
-
-/*  This thumbnail code should eventually end up in libgimpui.  */
-
-static cairo_surface_t *
-print_preview_get_thumbnail (GimpDrawable *drawable,
-                             gint          width,
-                             gint          height)
-{
-  cairo_surface_t *surface;
-  cairo_format_t   format;
-  guchar          *data;
-  guchar          *dest;
-  const guchar    *src;
-  gint             src_stride;
-  gint             dest_stride;
-  gint             y;
-  gint             bpp;
-
-  g_return_val_if_fail (width  > 0 && width  <= 1024, NULL);
-  g_return_val_if_fail (height > 0 && height <= 1024, NULL);
-
-  data = gimp_drawable_get_thumbnail_data (drawable->drawable_id,
-                                           &width, &height, &bpp);
-
-  switch (bpp)
-    {
-    case 1:
-    case 3:
-      format = CAIRO_FORMAT_RGB24;
-      break;
-
-    case 2:
-    case 4:
-      format = CAIRO_FORMAT_ARGB32;
-      break;
-
-    default:
-      g_assert_not_reached ();
-      break;
-    }
-
-  surface = cairo_image_surface_create (format, width, height);
-
-  src         = data;
-  src_stride  = width * bpp;
-
-  dest        = cairo_image_surface_get_data (surface);
-  dest_stride = cairo_image_surface_get_stride (surface);
-
-  for (y = 0; y < height; y++)
-    {
-      const guchar *s = src;
-      guchar       *d = dest;
-      gint          w = width;
-
-      switch (bpp)
-        {
-        case 1:
-          while (w--)
-            {
-              GIMP_CAIRO_RGB24_SET_PIXEL (d, s[0], s[0], s[0]);
-              s += 1;
-              d += 4;
-            }
-          break;
-
-        case 2:
-          while (w--)
-            {
-              GIMP_CAIRO_ARGB32_SET_PIXEL (d, s[0], s[0], s[0], s[1]);
-              s += 2;
-              d += 4;
-            }
-          break;
-
-        case 3:
-          while (w--)
-            {
-              GIMP_CAIRO_RGB24_SET_PIXEL (d, s[0], s[1], s[2]);
-              s += 3;
-              d += 4;
-            }
-          break;
-
-        case 4:
-          while (w--)
-            {
-              GIMP_CAIRO_ARGB32_SET_PIXEL (d, s[0], s[1], s[2], s[3]);
-              s += 4;
-              d += 4;
-            }
-          break;
-        }
-
-      src  += src_stride;
-      dest += dest_stride;
-    }
-
-  g_free (data);
-
-  cairo_surface_mark_dirty (surface);
-
-  return surface;
-}
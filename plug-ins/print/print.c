@@ -61,6 +61,11 @@ static void        draw_page                (GtkPrintOperation *print,
                                              GtkPrintContext   *context,
                                              gint               page_nr,
                                              PrintData         *data);
+static gboolean    preview                  (GtkPrintOperation *operation,
+                                             GtkPrintOperationPreview *print_preview,
+                                             GtkPrintContext   *context,
+                                             GtkWindow         *parent,
+                                             PrintData         *data);
 
 static GtkWidget * create_custom_widget     (GtkPrintOperation *operation,
                                              PrintData         *data);
@@ -181,6 +186,7 @@ print_image (gint32     image_ID,
   data.center          = CENTER_BOTH;
   data.use_full_page   = FALSE;
   data.draw_crop_marks = FALSE;
+  data.preview         = FALSE;
   data.operation       = operation;
 
   gimp_image_get_resolution (image_ID, &data.xres, &data.yres);
@@ -198,6 +204,9 @@ print_image (gint32     image_ID,
   g_signal_connect (operation, "end-print",
                     G_CALLBACK (end_print),
                     &layer);
+  g_signal_connect (operation, "preview",
+                    G_CALLBACK (preview),
+                    &data);
 
   if (interactive)
     {
@@ -317,8 +326,19 @@ draw_page (GtkPrintOperation *operation,
            PrintData         *data)
 {
   print_draw_page (context, data);
+}
+
+static gboolean
+preview (GtkPrintOperation        *operation,
+         GtkPrintOperationPreview *print_preview,
+         GtkPrintContext          *context,
+         GtkWindow                *parent,
+         PrintData                *data)
+{
+  /* let draw_page know, then continue with the default preview */
+  data->preview = TRUE;
 
-  gimp_progress_update (1.0);
+  return FALSE;
 }
 
 /*
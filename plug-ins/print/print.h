@@ -37,5 +37,6 @@ typedef struct
   PrintCenterMode     center;
   gboolean            use_full_page;
   gboolean            draw_crop_marks;
+  gboolean            preview;
   GtkPrintOperation  *operation;
 } PrintData;
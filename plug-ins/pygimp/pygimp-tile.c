@@ -252,6 +252,86 @@ static PyMappingMethods tile_as_mapping = {
     (objobjargproc)tile_ass_sub, /*ass_sub*/
 };
 
+/* The buffer interface exposes the tile data itself, so that numpy and
+ * friends can work on it without copying through strings.  Handing out
+ * a writable buffer marks the tile dirty.
+ */
+
+static Py_ssize_t
+tile_get_read_buffer(PyGimpTile *self, Py_ssize_t segment, void **ptr)
+{
+    GimpTile *tile = self->tile;
+
+    if (segment != 0) {
+	PyErr_SetString(PyExc_SystemError, "accessing non-existent tile segment");
+	return -1;
+    }
+
+    *ptr = tile->data;
+
+    return tile->ewidth * tile->eheight * tile->bpp;
+}
+
+static Py_ssize_t
+tile_get_write_buffer(PyGimpTile *self, Py_ssize_t segment, void **ptr)
+{
+    Py_ssize_t len = tile_get_read_buffer(self, segment, ptr);
+
+    if (len >= 0)
+	self->tile->dirty = TRUE;
+
+    return len;
+}
+
+static Py_ssize_t
+tile_get_segcount(PyGimpTile *self, Py_ssize_t *lenp)
+{
+    GimpTile *tile = self->tile;
+
+    if (lenp)
+	*lenp = tile->ewidth * tile->eheight * tile->bpp;
+
+    return 1;
+}
+
+static Py_ssize_t
+tile_get_char_buffer(PyGimpTile *self, Py_ssize_t segment, char **ptr)
+{
+    return tile_get_read_buffer(self, segment, (void **)ptr);
+}
+
+#if PY_VERSION_HEX >= 0x02060000
+static int
+tile_get_buffer(PyGimpTile *self, Py_buffer *view, int flags)
+{
+    GimpTile *tile = self->tile;
+
+    if (flags & PyBUF_WRITABLE)
+	tile->dirty = TRUE;
+
+    return PyBuffer_FillInfo(view, (PyObject *)self, tile->data,
+			     tile->ewidth * tile->eheight * tile->bpp,
+			     0, flags);
+}
+#endif
+
+static PyBufferProcs tile_as_buffer = {
+    (readbufferproc)tile_get_read_buffer,	/* bf_getreadbuffer */
+    (writebufferproc)tile_get_write_buffer,	/* bf_getwritebuffer */
+    (segcountproc)tile_get_segcount,		/* bf_getsegcount */
+    (charbufferproc)tile_get_char_buffer,	/* bf_getcharbuffer */
+#if PY_VERSION_HEX >= 0x02060000
+    (getbufferproc)tile_get_buffer,		/* bf_getbuffer */
+    (releasebufferproc)0,			/* bf_releasebuffer */
+#endif
+};
+
+#if PY_VERSION_HEX >= 0x02060000
+#  define TILE_TPFLAGS (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER)
+#else
+#  define TILE_TPFLAGS Py_TPFLAGS_DEFAULT
+#endif
+
 PyTypeObject PyGimpTile_Type = {
     PyObject_HEAD_INIT(NULL)
     0,                                  /* ob_size */
@@ -273,8 +353,8 @@ PyTypeObject PyGimpTile_Type = {
     (reprfunc)0,                        /* tp_str */
     (getattrofunc)0,                    /* tp_getattro */
     (setattrofunc)0,                    /* tp_setattro */
-    0,					/* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT,	                /* tp_flags */
+    &tile_as_buffer,			/* tp_as_buffer */
+    TILE_TPFLAGS,			/* tp_flags */
     NULL, /* Documentation string */
     (traverseproc)0,			/* tp_traverse */
     (inquiry)0,				/* tp_clear */
@@ -315,8 +395,49 @@ pr_resize(PyGimpPixelRgn *self, PyObject *args)
 
 
 
+static PyObject *
+pr_read_into(PyGimpPixelRgn *self, PyObject *args, PyObject *kwargs)
+{
+    GimpPixelRgn *pr = &(self->pr);
+    PyObject *buffer;
+    void *buf;
+    Py_ssize_t len;
+    int x, y, w, h;
+    static char *kwlist[] = { "buffer", "x", "y", "width", "height", NULL };
+
+    x = pr->x;
+    y = pr->y;
+    w = pr->w;
+    h = pr->h;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+                                     "O|iiii:read_into", kwlist,
+                                     &buffer, &x, &y, &w, &h))
+        return NULL;
+
+    if (x < pr->x || y < pr->y || w <= 0 || h <= 0 ||
+        x + w > pr->x + pr->w || y + h > pr->y + pr->h) {
+        PyErr_SetString(PyExc_IndexError, "rectangle out of range");
+        return NULL;
+    }
+
+    if (PyObject_AsWriteBuffer(buffer, &buf, &len) < 0)
+        return NULL;
+
+    if (len < (Py_ssize_t) pr->bpp * w * h) {
+        PyErr_SetString(PyExc_ValueError, "buffer is too small");
+        return NULL;
+    }
+
+    gimp_pixel_rgn_get_rect(pr, buf, x, y, w, h);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 static PyMethodDef pr_methods[] = {
     {"resize",	(PyCFunction)pr_resize,	METH_VARARGS},
+    {"read_into", (PyCFunction)pr_read_into, METH_VARARGS | METH_KEYWORDS},
 
     {NULL,		NULL}		/* sentinel */
 };
@@ -504,8 +625,11 @@ pr_ass_sub(PyGimpPixelRgn *self, PyObject *v, PyObject *w)
         return -1;
     }
 
-    if (!PyString_Check(w)) {
-        PyErr_SetString(PyExc_TypeError, "must assign string to subscript");
+    /* any object with the buffer interface is accepted, so arrays
+     * can be assigned without converting them to a string first */
+    if (!PyString_Check(w) && !PyObject_CheckReadBuffer(w)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "must assign string or buffer to subscript");
         return -1;
     }
 
@@ -517,9 +641,8 @@ pr_ass_sub(PyGimpPixelRgn *self, PyObject *v, PyObject *w)
     if (!PyArg_ParseTuple(v, "OO", &x, &y))
         return -1;
 
-    buf = (const guchar *)PyString_AsString(w);
-    len = PyString_Size(w);
-    if (!buf || len > INT_MAX) {
+    if (PyObject_AsReadBuffer(w, (const void **)&buf, &len) < 0 ||
+        len > INT_MAX) {
         return -1;
     }
 
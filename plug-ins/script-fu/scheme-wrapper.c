@@ -49,10 +49,22 @@
 
 #undef cons
 
+typedef struct
+{
+  gint          n_params;
+  gint          n_return_vals;
+  GimpParamDef *params;       /*  only the types are kept  */
+  GimpParamDef *return_vals;
+} SFProcInfo;
+
 static void     ts_init_constants                (scheme    *sc);
 static void     ts_init_procedures               (scheme    *sc,
                                                   gboolean   register_scipts);
 static void     convert_string                   (gchar     *str);
+static SFProcInfo *
+                script_fu_lookup_proc_info       (const gchar *proc_name,
+                                                  gboolean    *cached);
+static void     script_fu_proc_info_free         (SFProcInfo  *info);
 static pointer  script_fu_marshal_procedure_call (scheme    *sc,
                                                   pointer    a);
 static void     script_fu_marshal_destroy_args   (GimpParam *params,
@@ -67,7 +79,8 @@ static pointer  script_fu_quit_call              (scheme    *sc,
 static pointer  script_fu_nil_call               (scheme    *sc,
                                                   pointer    a);
 
-static gboolean ts_load_file                     (const gchar *dirname,
+static gboolean ts_load_file                     (scheme      *sc,
+                                                  const gchar *dirname,
                                                   const gchar *basename);
 
 typedef struct
@@ -207,50 +220,75 @@ static const NamedConstant const old_constants[] =
 };
 
 
-static scheme sc;
+static scheme   *current_sc       = NULL;
+static GHashTable *proc_info_cache = NULL;
+static gchar    *ts_path          = NULL;
+static gboolean  ts_register      = FALSE;
+static gint      ts_run_mode      = -1;
 
 
 void
 tinyscheme_init (const gchar *path,
                  gboolean     register_scripts)
 {
+  scheme *sc;
+
+  g_free (ts_path);
+  ts_path     = g_strdup (path);
+  ts_register = register_scripts;
+
+  sc = ts_interpreter_new ();
+
+  if (sc)
+    ts_set_interpreter (sc);
+}
+
+/* Create an interpreter that is set up like the one created by
+ * tinyscheme_init(). It is not made the current interpreter.
+ */
+scheme *
+ts_interpreter_new (void)
+{
+  scheme *sc = g_new0 (scheme, 1);
+
   /* init the interpreter */
-  if (! scheme_init (&sc))
+  if (! scheme_init (sc))
     {
       g_message ("Could not initialize TinyScheme!");
-      return;
+      g_free (sc);
+      return NULL;
     }
 
-  scheme_set_input_port_file (&sc, stdin);
-  scheme_set_output_port_file (&sc, stdout);
+  scheme_set_input_port_file (sc, stdin);
+  scheme_set_output_port_file (sc, stdout);
   ts_register_output_func (ts_stdout_output_func, NULL);
 
   /* Initialize the TinyScheme extensions */
-  init_ftx (&sc);
-  script_fu_regex_init (&sc);
+  init_ftx (sc);
+  script_fu_regex_init (sc);
 
   /* register in the interpreter the gimp functions and types. */
-  ts_init_constants (&sc);
-  ts_init_procedures (&sc, register_scripts);
+  ts_init_constants (sc);
+  ts_init_procedures (sc, ts_register);
 
-  if (path)
+  if (ts_path)
     {
-      GList *dir_list = gimp_path_parse (path, 16, TRUE, NULL);
+      GList *dir_list = gimp_path_parse (ts_path, 16, TRUE, NULL);
       GList *list;
 
       for (list = dir_list; list; list = g_list_next (list))
         {
-          if (ts_load_file (list->data, "script-fu.init"))
+          if (ts_load_file (sc, list->data, "script-fu.init"))
             {
               /*  To improve compatibility with older Script-Fu scripts,
                *  load script-fu-compat.init from the same directory.
                */
-              ts_load_file (list->data, "script-fu-compat.init");
+              ts_load_file (sc, list->data, "script-fu-compat.init");
 
               /*  To improve compatibility with older GIMP version,
                *  load plug-in-compat.init from the same directory.
                */
-              ts_load_file (list->data, "plug-in-compat.init");
+              ts_load_file (sc, list->data, "plug-in-compat.init");
 
               break;
             }
@@ -261,6 +299,49 @@ tinyscheme_init (const gchar *path,
 
       gimp_path_free (dir_list);
     }
+
+  /*  interpreters created after the first one also load the scripts,
+   *  they are never registered more than once
+   */
+  if (current_sc && ! ts_register)
+    {
+      scheme *prev = current_sc;
+
+      current_sc = sc;
+
+      if (ts_run_mode >= 0)
+        ts_set_run_mode (ts_run_mode);
+
+      script_fu_find_scripts (ts_path);
+
+      current_sc = prev;
+    }
+
+  return sc;
+}
+
+void
+ts_interpreter_free (scheme *sc)
+{
+  g_return_if_fail (sc != NULL);
+  g_return_if_fail (sc != current_sc);
+
+  scheme_deinit (sc);
+  g_free (sc);
+}
+
+scheme *
+ts_get_interpreter (void)
+{
+  return current_sc;
+}
+
+void
+ts_set_interpreter (scheme *sc)
+{
+  g_return_if_fail (sc != NULL);
+
+  current_sc = sc;
 }
 
 /* Create an SF-RUN-MODE constant for use in scripts.
@@ -271,16 +352,19 @@ ts_set_run_mode (GimpRunMode run_mode)
 {
   pointer symbol;
 
-  symbol = sc.vptr->mk_symbol (&sc, "SF-RUN-MODE");
-  sc.vptr->scheme_define (&sc, sc.global_env, symbol,
-                          sc.vptr->mk_integer (&sc, run_mode));
-  sc.vptr->setimmutable (symbol);
+  ts_run_mode = run_mode;
+
+  symbol = current_sc->vptr->mk_symbol (current_sc, "SF-RUN-MODE");
+  current_sc->vptr->scheme_define (current_sc, current_sc->global_env, symbol,
+                                   current_sc->vptr->mk_integer (current_sc,
+                                                                 run_mode));
+  current_sc->vptr->setimmutable (symbol);
 }
 
 void
 ts_set_print_flag (gint print_flag)
 {
-  sc.print_output = print_flag;
+  current_sc->print_output = print_flag;
 }
 
 void
@@ -295,27 +379,27 @@ ts_print_welcome (void)
 void
 ts_interpret_stdin (void)
 {
-  scheme_load_file (&sc, stdin);
+  scheme_load_file (current_sc, stdin);
 }
 
 gint
 ts_interpret_string (const gchar *expr)
 {
 #if DEBUG_SCRIPTS
-  sc.print_output = 1;
-  sc.tracing = 1;
+  current_sc->print_output = 1;
+  current_sc->tracing = 1;
 #endif
 
-  sc.vptr->load_string (&sc, (char *) expr);
+  current_sc->vptr->load_string (current_sc, (char *) expr);
 
-  return sc.retcode;
+  return current_sc->retcode;
 }
 
 const gchar *
 ts_get_success_msg (void)
 {
-  if (sc.vptr->is_string (sc.value))
-    return sc.vptr->string_value (sc.value);
+  if (current_sc->vptr->is_string (current_sc->value))
+    return current_sc->vptr->string_value (current_sc->value);
 
   return "Success";
 }
@@ -508,65 +592,26 @@ ts_init_procedures (scheme   *sc,
   gimp_procedural_db_query (".*", ".*", ".*", ".*", ".*", ".*", ".*",
                             &num_procs, &proc_list);
 
-  /*  Register each procedure as a scheme func  */
+  /*  Register each procedure as a scheme func. The argument count
+   *  is checked by the marshaller, so there is no need to query each
+   *  procedure here, which would cost a round trip to the core per
+   *  procedure on every start
+   */
   for (i = 0; i < num_procs; i++)
     {
-      gchar           *proc_blurb;
-      gchar           *proc_help;
-      gchar           *proc_author;
-      gchar           *proc_copyright;
-      gchar           *proc_date;
-      GimpPDBProcType  proc_type;
-      gint             n_params;
-      gint             n_return_vals;
-      GimpParamDef    *params;
-      GimpParamDef    *return_vals;
-
-      /*  lookup the procedure  */
-      if (gimp_procedural_db_proc_info (proc_list[i],
-                                        &proc_blurb,
-                                        &proc_help,
-                                        &proc_author,
-                                        &proc_copyright,
-                                        &proc_date,
-                                        &proc_type,
-                                        &n_params, &n_return_vals,
-                                        &params, &return_vals))
-        {
-          gchar *buff;
-
-          /* Build a define that will call the foreign function.
-           * The Scheme statement was suggested by Simon Budig.
-           */
-          if (n_params == 0)
-            {
-              buff = g_strdup_printf (" (define (%s)"
-                                      " (gimp-proc-db-call \"%s\"))",
-                                      proc_list[i], proc_list[i]);
-            }
-          else
-            {
-              buff = g_strdup_printf (" (define %s (lambda x"
-                                      " (apply gimp-proc-db-call (cons \"%s\" x))))",
-                                      proc_list[i], proc_list[i]);
-            }
-
-          /*  Execute the 'define'  */
-          sc->vptr->load_string (sc, buff);
-
-          g_free (buff);
+      gchar *buff;
 
-          /*  free the queried information  */
-          g_free (proc_blurb);
-          g_free (proc_help);
-          g_free (proc_author);
-          g_free (proc_copyright);
-          g_free (proc_date);
+      /* Build a define that will call the foreign function.
+       * The Scheme statement was suggested by Simon Budig.
+       */
+      buff = g_strdup_printf (" (define %s (lambda x"
+                              " (apply gimp-proc-db-call (cons \"%s\" x))))",
+                              proc_list[i], proc_list[i]);
 
-          gimp_destroy_paramdefs (params, n_params);
-          gimp_destroy_paramdefs (return_vals, n_return_vals);
-        }
+      /*  Execute the 'define'  */
+      sc->vptr->load_string (sc, buff);
 
+      g_free (buff);
       g_free (proc_list[i]);
     }
 
@@ -574,7 +619,8 @@ ts_init_procedures (scheme   *sc,
 }
 
 static gboolean
-ts_load_file (const gchar *dirname,
+ts_load_file (scheme      *sc,
+              const gchar *dirname,
               const gchar *basename)
 {
   gchar *filename;
@@ -588,7 +634,7 @@ ts_load_file (const gchar *dirname,
 
   if (fin)
     {
-      scheme_load_file (&sc, fin);
+      scheme_load_file (sc, fin);
       fclose (fin);
 
       return TRUE;
@@ -612,24 +658,19 @@ static pointer
 script_fu_marshal_procedure_call (scheme  *sc,
                                   pointer  a)
 {
-  GimpParam       *args;
-  GimpParam       *values = NULL;
-  gint             nvalues;
-  gchar           *proc_name;
-  gchar           *proc_blurb;
-  gchar           *proc_help;
-  gchar           *proc_author;
-  gchar           *proc_copyright;
-  gchar           *proc_date;
-  GimpPDBProcType  proc_type;
-  gint             nparams;
-  gint             nreturn_vals;
-  GimpParamDef    *params;
-  GimpParamDef    *return_vals;
-  gchar            error_str[1024];
-  gint             i;
-  gint             success = TRUE;
-  pointer          return_val = sc->NIL;
+  GimpParam          *args;
+  GimpParam          *values = NULL;
+  gint                nvalues;
+  gchar              *proc_name;
+  SFProcInfo         *proc_info;
+  gboolean            proc_info_cached;
+  gint                nparams;
+  const GimpParamDef *params;
+  const GimpParamDef *return_vals;
+  gchar               error_str[1024];
+  gint                i;
+  gint                success = TRUE;
+  pointer             return_val = sc->NIL;
 
 #if DEBUG_MARSHALL
 /* These three #defines are from Tinyscheme (tinyscheme/scheme.c) */
@@ -671,15 +712,9 @@ script_fu_marshal_procedure_call (scheme  *sc,
   script_fu_interface_report_cc (proc_name);
 
   /*  Attempt to fetch the procedure from the database  */
-  if (! gimp_procedural_db_proc_info (proc_name,
-                                      &proc_blurb,
-                                      &proc_help,
-                                      &proc_author,
-                                      &proc_copyright,
-                                      &proc_date,
-                                      &proc_type,
-                                      &nparams, &nreturn_vals,
-                                      &params, &return_vals))
+  proc_info = script_fu_lookup_proc_info (proc_name, &proc_info_cached);
+
+  if (! proc_info)
     {
 #ifdef DEBUG_MARSHALL
       g_printerr ("  Invalid procedure name\n");
@@ -689,17 +724,9 @@ script_fu_marshal_procedure_call (scheme  *sc,
       return foreign_error (sc, error_str, 0);
     }
 
-  /* Free the name and the description which are of no use here.  */
-  for (i = 0; i < nparams; i++)
-    {
-      g_free (params[i].name);
-      g_free (params[i].description);
-    }
-  for (i = 0; i < nreturn_vals; i++)
-    {
-      g_free (return_vals[i].name);
-      g_free (return_vals[i].description);
-    }
+  nparams     = proc_info->n_params;
+  params      = proc_info->params;
+  return_vals = proc_info->return_vals;
 
   /*  Check the supplied number of arguments  */
   if ((sc->vptr->list_length (sc, a) - 1) != nparams)
@@ -1612,14 +1639,8 @@ script_fu_marshal_procedure_call (scheme  *sc,
   /*  free up arguments and values  */
   script_fu_marshal_destroy_args (args, nparams);
 
-  /*  free the query information  */
-  g_free (proc_blurb);
-  g_free (proc_help);
-  g_free (proc_author);
-  g_free (proc_copyright);
-  g_free (proc_date);
-  g_free (params);
-  g_free (return_vals);
+  if (! proc_info_cached)
+    script_fu_proc_info_free (proc_info);
 
   /*  if we're in server mode, listen for additional commands for 10 ms  */
   if (script_fu_server_get_mode ())
@@ -1634,6 +1655,94 @@ script_fu_marshal_procedure_call (scheme  *sc,
   return return_val;
 }
 
+static void
+script_fu_proc_info_free (SFProcInfo *info)
+{
+  g_free (info->params);
+  g_free (info->return_vals);
+  g_slice_free (SFProcInfo, info);
+}
+
+/*  Procedure signatures are cached so that each call only costs a
+ *  single round trip to the core. Temporary procedures come and go,
+ *  so they are looked up every time and *cached is set to FALSE, the
+ *  caller has to free their info.
+ */
+static SFProcInfo *
+script_fu_lookup_proc_info (const gchar *proc_name,
+                            gboolean    *cached)
+{
+  SFProcInfo      *info;
+  gchar           *proc_blurb;
+  gchar           *proc_help;
+  gchar           *proc_author;
+  gchar           *proc_copyright;
+  gchar           *proc_date;
+  GimpPDBProcType  proc_type;
+  gint             i;
+
+  if (! proc_info_cache)
+    proc_info_cache =
+      g_hash_table_new_full (g_str_hash, g_str_equal,
+                             (GDestroyNotify) g_free,
+                             (GDestroyNotify) script_fu_proc_info_free);
+
+  info = g_hash_table_lookup (proc_info_cache, proc_name);
+
+  *cached = (info != NULL);
+
+  if (info)
+    return info;
+
+  info = g_slice_new0 (SFProcInfo);
+
+  if (! gimp_procedural_db_proc_info (proc_name,
+                                      &proc_blurb,
+                                      &proc_help,
+                                      &proc_author,
+                                      &proc_copyright,
+                                      &proc_date,
+                                      &proc_type,
+                                      &info->n_params,
+                                      &info->n_return_vals,
+                                      &info->params,
+                                      &info->return_vals))
+    {
+      g_slice_free (SFProcInfo, info);
+      return NULL;
+    }
+
+  g_free (proc_blurb);
+  g_free (proc_help);
+  g_free (proc_author);
+  g_free (proc_copyright);
+  g_free (proc_date);
+
+  /* Free the name and the description which are of no use here.  */
+  for (i = 0; i < info->n_params; i++)
+    {
+      g_free (info->params[i].name);
+      g_free (info->params[i].description);
+      info->params[i].name        = NULL;
+      info->params[i].description = NULL;
+    }
+  for (i = 0; i < info->n_return_vals; i++)
+    {
+      g_free (info->return_vals[i].name);
+      g_free (info->return_vals[i].description);
+      info->return_vals[i].name        = NULL;
+      info->return_vals[i].description = NULL;
+    }
+
+  if (proc_type != GIMP_TEMPORARY)
+    {
+      g_hash_table_insert (proc_info_cache, g_strdup (proc_name), info);
+      *cached = TRUE;
+    }
+
+  return info;
+}
+
 static void
 script_fu_marshal_destroy_args (GimpParam *params,
                                 gint       n_params)
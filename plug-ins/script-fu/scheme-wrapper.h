@@ -23,6 +23,11 @@
 void          tinyscheme_init         (const gchar  *path,
                                        gboolean      register_scripts);
 
+scheme      * ts_interpreter_new      (void);
+void          ts_interpreter_free     (scheme       *sc);
+scheme      * ts_get_interpreter      (void);
+void          ts_set_interpreter      (scheme       *sc);
+
 void          ts_set_run_mode         (GimpRunMode   run_mode);
 
 void          ts_set_print_flag       (gint          print_flag);
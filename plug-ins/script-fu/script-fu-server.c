@@ -78,6 +78,9 @@ typedef short sa_family_t;	/* Not defined by winsock */
 #define RESPONSE_HEADER 4
 #define MAGIC           'G'
 
+/*  the number of interpreters that clients are spread over  */
+#define N_INTERPRETERS  4
+
 #ifndef HAVE_DIFFTIME
 #define difftime(a,b) (((gdouble)(a)) - ((gdouble)(b)))
 #endif
@@ -123,11 +126,26 @@ typedef short sa_family_t;	/* Not defined by winsock */
 
 typedef struct
 {
-  gchar *command;
-  gint   filedes;
-  gint   request_no;
+  gchar   *command;
+  gint     request_no;
+  gint64   queued;       /*  when the command was received  */
 } SFCommand;
 
+typedef struct
+{
+  gint      filedes;
+  gchar    *address;
+  GQueue    commands;    /*  pending SFCommands of this client  */
+  scheme   *interpreter;
+
+  gboolean  running;     /*  one of its commands is being executed  */
+  gboolean  closed;      /*  disconnected while running             */
+
+  gint      n_requests;
+  gint64    wait_time;
+  gint64    run_time;
+} SFClient;
+
 typedef struct
 {
   GtkWidget *port_entry;
@@ -154,8 +172,11 @@ typedef union
 
 static void      server_start       (gint         port,
                                      const gchar *logfile);
-static gboolean  execute_command    (SFCommand   *cmd);
-static gint      read_from_client   (gint         filedes);
+static gboolean  execute_command    (SFClient    *client,
+                                     SFCommand   *cmd);
+static gint      read_from_client   (SFClient    *client);
+static void      client_free        (SFClient    *client);
+static scheme  * client_interpreter (void);
 static gint      make_socket        (const struct addrinfo
                                                  *ai);
 static void      server_log         (const gchar *format,
@@ -175,9 +196,11 @@ static gint         server_socks[2],
                     server_socks_used = 0;
 static const gint   server_socks_len = sizeof (server_socks) /
                                        sizeof (server_socks[0]);
-static GList       *command_queue   = NULL;
+static GQueue       ready_clients   = G_QUEUE_INIT;
 static gint         queue_length    = 0;
 static gint         request_no      = 0;
+static scheme      *interpreters[N_INTERPRETERS] = { NULL, };
+static gint         n_clients       = 0;
 static FILE        *server_log_file = NULL;
 static GHashTable  *clients         = NULL;
 static gboolean     script_fu_done  = FALSE;
@@ -273,27 +296,15 @@ script_fu_server_read_fd (gpointer key,
                           gpointer value,
                           gpointer data)
 {
-  gint fd = GPOINTER_TO_INT (key);
+  SFClient *client = value;
 
-  if (FD_ISSET (fd, (SELECT_MASK *) data))
+  if (FD_ISSET (client->filedes, (SELECT_MASK *) data))
     {
-      if (read_from_client (fd) < 0)
+      if (read_from_client (client) < 0)
         {
-          GList *list;
-
-          server_log ("Server: disconnect from host %s.\n", (gchar *) value);
-
-          CLOSESOCKET (fd);
+          server_log ("Server: disconnect from host %s.\n", client->address);
 
-          /*  Invalidate the file descriptor for pending commands
-              from the disconnected client.  */
-          for (list = command_queue; list; list = list->next)
-            {
-              SFCommand *cmd = (SFCommand *) command_queue->data;
-
-              if (cmd->filedes == fd)
-                cmd->filedes = -1;
-            }
+          CLOSESOCKET (client->filedes);
 
           return TRUE;  /*  remove this client from the hash table  */
         }
@@ -314,7 +325,14 @@ script_fu_server_listen (gint timeout)
   if (timeout)
     {
       tv.tv_sec  = timeout / 1000;
-      tv.tv_usec = timeout % 1000;
+      tv.tv_usec = (timeout % 1000) * 1000;
+      tvp = &tv;
+    }
+  else if (! g_queue_is_empty (&ready_clients))
+    {
+      /*  don't block while other clients' commands are waiting  */
+      tv.tv_sec  = 0;
+      tv.tv_usec = 0;
       tvp = &tv;
     }
 
@@ -367,8 +385,17 @@ script_fu_server_listen (gint timeout)
       (void) getnameinfo (&(client.sa), size, clientname, sizeof (clientname),
                           NULL, 0, NI_NUMERICHOST);
 
-      g_hash_table_insert (clients, GINT_TO_POINTER (new),
-                           g_strdup (clientname));
+      {
+        SFClient *sf_client = g_slice_new0 (SFClient);
+
+        sf_client->filedes     = new;
+        sf_client->address     = g_strdup (clientname);
+        sf_client->interpreter = client_interpreter ();
+
+        g_queue_init (&sf_client->commands);
+
+        g_hash_table_insert (clients, GINT_TO_POINTER (new), sf_client);
+      }
 
       /* Determine port number */
       switch (client.family)
@@ -497,7 +524,10 @@ server_start (gint         port,
 
   /*  Set up the clientname hash table  */
   clients = g_hash_table_new_full (g_direct_hash, NULL,
-                                   NULL, (GDestroyNotify) g_free);
+                                   NULL, (GDestroyNotify) client_free);
+
+  /*  the first client shares the interpreter the server was started in  */
+  interpreters[0] = ts_get_interpreter ();
 
   progress = server_progress_install ();
 
@@ -506,23 +536,37 @@ server_start (gint         port,
   /*  Loop until the server is finished  */
   while (! script_fu_done)
     {
+      SFClient  *client;
+      SFCommand *cmd;
+
       script_fu_server_listen (0);
 
-      while (command_queue)
-        {
-          SFCommand *cmd = (SFCommand *) command_queue->data;
+      /*  Clients take turns, one command each, so a client with a
+       *  long queue doesn't hold back the others
+       */
+      client = g_queue_pop_head (&ready_clients);
 
-          /*  Process the command  */
-          execute_command (cmd);
+      if (! client)
+        continue;
 
-          /*  Remove the command from the list  */
-          command_queue = g_list_remove (command_queue, cmd);
-          queue_length--;
+      cmd = g_queue_pop_head (&client->commands);
+      queue_length--;
 
-          /*  Free the request  */
-          g_free (cmd->command);
-          g_free (cmd);
-      }
+      client->running = TRUE;
+
+      /*  Process the command  */
+      execute_command (client, cmd);
+
+      client->running = FALSE;
+
+      if (client->closed)
+        client_free (client);
+      else if (! g_queue_is_empty (&client->commands))
+        g_queue_push_tail (&ready_clients, client);
+
+      /*  Free the request  */
+      g_free (cmd->command);
+      g_slice_free (SFCommand, cmd);
     }
 
   server_progress_uninstall (progress);
@@ -531,21 +575,29 @@ server_start (gint         port,
 }
 
 static gboolean
-execute_command (SFCommand *cmd)
+execute_command (SFClient  *client,
+                 SFCommand *cmd)
 {
   guchar    buffer[RESPONSE_HEADER];
   GString  *response;
-  time_t    clock1;
-  time_t    clock2;
+  scheme   *prev;
+  gint64    start;
+  gint64    wait_time;
+  gint64    run_time;
   gboolean  error;
   gint      i;
 
+  start     = g_get_monotonic_time ();
+  wait_time = start - cmd->queued;
+
   server_log ("Processing request #%d\n", cmd->request_no);
-  time (&clock1);
 
   response = g_string_new (NULL);
   ts_register_output_func (ts_gstring_output_func, response);
 
+  prev = ts_get_interpreter ();
+  ts_set_interpreter (client->interpreter);
+
   /*  run the command  */
   if (ts_interpret_string (cmd->command) != 0)
     {
@@ -557,12 +609,22 @@ execute_command (SFCommand *cmd)
       error = FALSE;
 
       g_string_assign (response, ts_get_success_msg ());
-
-      time (&clock2);
-      server_log ("Request #%d processed in %f seconds, finishing on %s",
-                  cmd->request_no, difftime (clock2, clock1), ctime (&clock2));
     }
 
+  ts_set_interpreter (prev);
+
+  run_time = g_get_monotonic_time () - start;
+
+  client->n_requests++;
+  client->wait_time += wait_time;
+  client->run_time  += run_time;
+
+  server_log ("Request #%d %s: waited %.3f seconds in the queue, "
+              "ran for %.3f seconds\n",
+              cmd->request_no, error ? "failed" : "processed",
+              (gdouble) wait_time / G_USEC_PER_SEC,
+              (gdouble) run_time  / G_USEC_PER_SEC);
+
   buffer[MAGIC_BYTE]     = MAGIC;
   buffer[ERROR_BYTE]     = error ? TRUE : FALSE;
   buffer[RSP_LEN_H_BYTE] = (guchar) (response->len >> 8);
@@ -570,18 +632,20 @@ execute_command (SFCommand *cmd)
 
   /*  Write the response to the client  */
   for (i = 0; i < RESPONSE_HEADER; i++)
-    if (cmd->filedes > 0 && send (cmd->filedes, buffer + i, 1, 0) < 0)
+    if (! client->closed && send (client->filedes, buffer + i, 1, 0) < 0)
       {
         /*  Write error  */
         print_socket_api_error ("send");
+        g_string_free (response, TRUE);
         return FALSE;
       }
 
   for (i = 0; i < response->len; i++)
-    if (cmd->filedes > 0 && send (cmd->filedes, response->str + i, 1, 0) < 0)
+    if (! client->closed && send (client->filedes, response->str + i, 1, 0) < 0)
       {
         /*  Write error  */
         print_socket_api_error ("send");
+        g_string_free (response, TRUE);
         return FALSE;
       }
 
@@ -591,12 +655,12 @@ execute_command (SFCommand *cmd)
 }
 
 static gint
-read_from_client (gint filedes)
+read_from_client (SFClient *client)
 {
   SFCommand *cmd;
   guchar     buffer[COMMAND_HEADER];
   gchar     *command;
-  gchar     *clientaddr;
+  gint       filedes = client->filedes;
   time_t     clock;
   gint       command_len;
   gint       nbytes;
@@ -651,28 +715,78 @@ read_from_client (gint filedes)
     }
 
   command[command_len] = '\0';
-  cmd = g_new (SFCommand, 1);
+  cmd = g_slice_new (SFCommand);
 
-  cmd->filedes    = filedes;
   cmd->command    = command;
   cmd->request_no = request_no ++;
+  cmd->queued     = g_get_monotonic_time ();
 
-  /*  Add the command to the queue  */
-  command_queue = g_list_append (command_queue, cmd);
+  /*  Add the command to the client's queue  */
+  if (g_queue_is_empty (&client->commands) && ! client->running)
+    g_queue_push_tail (&ready_clients, client);
+
+  g_queue_push_tail (&client->commands, cmd);
   queue_length ++;
 
-  /*  Get the client address from the address/socket table  */
-  clientaddr = g_hash_table_lookup (clients, GINT_TO_POINTER (cmd->filedes));
   time (&clock);
   server_log ("Received request #%d from IP address %s: %s on %s,"
               "[Request queue length: %d]",
-              cmd->request_no,
-                  clientaddr ? clientaddr : "<invalid>",
-                      cmd->command, ctime (&clock), queue_length);
+              cmd->request_no, client->address,
+              cmd->command, ctime (&clock), queue_length);
 
   return 0;
 }
 
+static void
+client_free (SFClient *client)
+{
+  SFCommand *cmd;
+
+  while ((cmd = g_queue_pop_head (&client->commands)))
+    {
+      g_free (cmd->command);
+      g_slice_free (SFCommand, cmd);
+      queue_length--;
+    }
+
+  g_queue_remove (&ready_clients, client);
+
+  /*  the main loop frees it once its command is done  */
+  if (client->running)
+    {
+      client->closed = TRUE;
+      return;
+    }
+
+  if (client->n_requests > 0)
+    server_log ("Server: %d requests from host %s, "
+                "%.3f seconds queued, %.3f seconds running.\n",
+                client->n_requests, client->address,
+                (gdouble) client->wait_time / G_USEC_PER_SEC,
+                (gdouble) client->run_time  / G_USEC_PER_SEC);
+
+  g_free (client->address);
+  g_slice_free (SFClient, client);
+}
+
+/*  Clients are spread over a small pool of interpreters round-robin,
+ *  so that independent clients don't see each other's definitions
+ */
+static scheme *
+client_interpreter (void)
+{
+  gint i = n_clients++ % N_INTERPRETERS;
+
+  if (! interpreters[i])
+    interpreters[i] = ts_interpreter_new ();
+
+  /*  fall back to the server's own interpreter  */
+  if (! interpreters[i])
+    return interpreters[0];
+
+  return interpreters[i];
+}
+
 static gint
 make_socket (const struct addrinfo *ai)
 {
@@ -775,17 +889,19 @@ server_quit (void)
       clients = NULL;
     }
 
-  while (command_queue)
-    {
-      SFCommand *cmd = command_queue->data;
+  g_queue_clear (&ready_clients);
+  queue_length = 0;
 
-      g_free (cmd->command);
-      g_free (cmd);
+  for (sockno = 1; sockno < N_INTERPRETERS; sockno++)
+    {
+      if (interpreters[sockno])
+        {
+          ts_interpreter_free (interpreters[sockno]);
+          interpreters[sockno] = NULL;
+        }
     }
 
-  g_list_free (command_queue);
-  command_queue = NULL;
-  queue_length  = 0;
+  interpreters[0] = NULL;
 
   /*  Close the server log file  */
   if (server_log_file != stdout)